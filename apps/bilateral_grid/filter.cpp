@@ -33,7 +33,11 @@ int main(int argc, char **argv) {
         bilateral_grid(input, r_sigma, output);
     });
     printf("Time: %gms\n", min_t * 1e3);
+    // The bandwidth counts reading the input and writing the output once.
+    printf("%gms/frame, %gGB/s\n", min_t * 1e3,
+           (input.size_in_bytes() + output.size_in_bytes()) / min_t * 1e-9);
 
+    output.copy_to_host();
     save_image(output, argv[2]);
 
     return 0;
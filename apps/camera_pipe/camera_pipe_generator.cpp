@@ -176,6 +176,20 @@ std::pair<Func, Scheduler> CameraPipe::demosaic(Func deinterleaved) {
 
     Scheduler scheduler = [=](Func processed) mutable {
         assert(g_r.defined());
+        if (get_target().has_gpu_feature()) {
+            // Compute the green channel at the red and blue pixels in
+            // its own kernel, as everything else in the demosaic
+            // depends on it, and the output of the demosaic in
+            // another.
+            g_r.compute_root().gpu_tile(x, y, xi, yi, 16, 8);
+            g_b.compute_root().gpu_tile(x, y, xi, yi, 16, 8);
+            output.compute_root()
+                .reorder(c, x, y)
+                .bound(c, 0, 3)
+                .unroll(c)
+                .gpu_tile(x, y, xi, yi, 32, 8);
+            return;
+        }
         int vec = get_target().natural_vector_size(UInt(16));
         if (get_target().has_feature(Target::HVX_64)) {
             vec = 32;
@@ -321,6 +335,35 @@ Func CameraPipe::build() {
     } else if (get_target().has_feature(Target::HVX_128)) {
         vec = 64;
     }
+
+    if (get_target().has_gpu_feature()) {
+        // The gpu schedule. Each stage that is read at neighbouring
+        // pixels gets its own kernel, and the pointwise stages are
+        // inlined into the kernel that consumes them. The output is
+        // computed in 32x8 tiles, so the bounds below still divide
+        // the output.
+        vec = 16;
+        strip_size = 8;
+        denoised.compute_root().gpu_tile(x, y, xi, yi, 32, 8);
+        deinterleaved.compute_root()
+            .reorder(c, x, y)
+            .bound(c, 0, 4)
+            .unroll(c)
+            .gpu_tile(x, y, xi, yi, 16, 8);
+        processed.compute_root()
+            .reorder(c, x, y)
+            .unroll(c)
+            .gpu_tile(x, y, xi, yi, 2*vec, strip_size);
+        demosaiced_scheduler(processed);
+
+        processed
+            .bound(c, 0, 3)
+            .bound(x, 0, ((out_width)/(2*vec))*(2*vec))
+            .bound(y, 0, (out_height/strip_size)*strip_size);
+
+        return processed;
+    }
+
     denoised.compute_at(processed, yi).store_at(processed, yo)
         .prefetch(y, 2)
         .fold_storage(y, 8)
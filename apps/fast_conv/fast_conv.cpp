@@ -0,0 +1,397 @@
+// Fast algorithms for the convolution layers of CNNs and for large
+// blurs. The Winograd transforms are those of Lavin and Gray, "Fast
+// Algorithms for Convolutional Neural Networks",
+// https://arxiv.org/abs/1509.09308. The FFT convolution uses the FFTs
+// in apps/fft.
+
+#include "fast_conv.h"
+
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+#include "complex.h"
+#include "fft.h"
+
+using namespace Halide;
+
+using std::string;
+using std::vector;
+
+namespace {
+
+typedef vector<vector<float>> Matrix;
+
+// The matrices of a Winograd transform F(m x m, 3 x 3): the input
+// transform B^T, the filter transform G, and the output transform A^T.
+// The tiles of the input are (m + 2) x (m + 2), and overlap by 2.
+struct WinogradTransform {
+    int m;
+    Matrix BT, G, AT;
+};
+
+WinogradTransform winograd_transform(int m) {
+    WinogradTransform w;
+    w.m = m;
+    if (m == 2) {
+        w.BT = {{1,  0, -1,  0},
+                {0,  1,  1,  0},
+                {0, -1,  1,  0},
+                {0,  1,  0, -1}};
+        w.G = {{1.0f,  0.0f, 0.0f},
+               {0.5f,  0.5f, 0.5f},
+               {0.5f, -0.5f, 0.5f},
+               {0.0f,  0.0f, 1.0f}};
+        w.AT = {{1, 1,  1,  0},
+                {0, 1, -1, -1}};
+    } else {
+        // m == 4
+        w.BT = {{4,  0, -5,  0, 1, 0},
+                {0, -4, -4,  1, 1, 0},
+                {0,  4, -4, -1, 1, 0},
+                {0, -2, -1,  2, 1, 0},
+                {0,  2, -1, -2, 1, 0},
+                {0,  4,  0, -5, 0, 1}};
+        w.G = {{ 1.0f / 4,          0,         0},
+               {-1.0f / 6, -1.0f / 6, -1.0f / 6},
+               {-1.0f / 6,  1.0f / 6, -1.0f / 6},
+               { 1.0f / 24, 1.0f / 12, 1.0f / 6},
+               { 1.0f / 24, -1.0f / 12, 1.0f / 6},
+               {         0,         0,      1.0f}};
+        w.AT = {{1, 1,  1, 1,  1, 0},
+                {0, 1, -1, 2, -2, 0},
+                {0, 1,  1, 4,  4, 0},
+                {0, 1, -1, 8, -8, 1}};
+    }
+    return w;
+}
+
+// The dot product of a row of a transform matrix with f, skipping the
+// zeros.
+Expr matrix_row(const vector<float> &row, const std::function<Expr(int)> &f) {
+    Expr result;
+    for (size_t j = 0; j < row.size(); j++) {
+        if (row[j] == 0) {
+            continue;
+        }
+        Expr term = f(j);
+        if (row[j] == -1) {
+            term = -term;
+        } else if (row[j] != 1) {
+            term = term * row[j];
+        }
+        result = result.defined() ? result + term : term;
+    }
+    return result;
+}
+
+// Row i of the product of a transform matrix with f. The rows are
+// selected by i, so that once the loop over i is unrolled, each
+// iteration has only the arithmetic of its own row.
+Expr apply_matrix(const Matrix &m, Expr i, const std::function<Expr(int)> &f) {
+    Expr result = matrix_row(m.back(), f);
+    for (int r = (int)m.size() - 2; r >= 0; r--) {
+        result = select(i == r, matrix_row(m[r], f), result);
+    }
+    return result;
+}
+
+int default_tiles_per_task(const ConvDesc &desc, int tile_size) {
+    if (desc.tiles_per_task > 0) {
+        return desc.tiles_per_task;
+    }
+    return std::max(1, 8 / tile_size);
+}
+
+void conv2d_direct(Func output, Func input, Func filter, int kernel_size, Expr channels_in,
+                   const Target &target, const ConvDesc &desc, const string &prefix) {
+    Var x("x"), y("y"), co("co");
+    const int r = kernel_size / 2;
+
+    RDom rk(0, kernel_size, 0, kernel_size, 0, channels_in, prefix + "rk");
+    Func accum(prefix + "accum");
+    accum(x, y, co) = 0.0f;
+    accum(x, y, co) += input(x + rk.x - r, y + rk.y - r, rk.z) * filter(rk.x, rk.y, rk.z, co);
+    output(x, y, co) = accum(x, y, co);
+
+    if (target.has_gpu_feature()) {
+        Var xo("xo"), yo("yo"), xi("xi"), yi("yi");
+        output.gpu_tile(x, y, xo, yo, xi, yi, 16, 16)
+            .gpu_blocks(co);
+        accum.compute_at(output, xi);
+    } else {
+        const int vec = target.natural_vector_size<float>();
+        Var yo("yo"), yi("yi");
+        output.split(y, yo, yi, default_tiles_per_task(desc, 1))
+            .reorder(x, yi, co, yo)
+            .vectorize(x, vec)
+            .parallel(yo);
+        // Accumulate each vector of the output in a register.
+        accum.compute_at(output, x)
+            .vectorize(x, vec)
+            .update()
+            .vectorize(x, vec);
+        if (desc.schedule_input) {
+            input.compute_at(output, yo)
+                .vectorize(input.args()[0], vec);
+        }
+    }
+}
+
+void conv2d_winograd(Func output, Func input, Func filter, int m, Expr channels_in,
+                     const Target &target, const ConvDesc &desc, const string &prefix) {
+    const WinogradTransform w = winograd_transform(m);
+
+    Var x("x"), y("y"), ci("ci"), co("co");
+    Var ax("ax"), ay("ay"), ey("ey"), ox("ox"), oy("oy"), tx("tx"), ty("ty");
+
+    // Transform the filter: U = G g G^T.
+    Func U(prefix + "filter_transform");
+    U(ax, ay, ci, co) = apply_matrix(w.G, ay, [&](int j) {
+        return apply_matrix(w.G, ax, [&](int i) { return filter(i, j, ci, co); });
+    });
+
+    // Transform the tiles of the input: V = B^T d B, one dimension at a
+    // time.
+    Func input_x(prefix + "input_transform_x");
+    input_x(ax, ey, tx, ty, ci) = apply_matrix(w.BT, ax, [&](int i) {
+        return input(tx * m + i - 1, ty * m + ey - 1, ci);
+    });
+    Func V(prefix + "input_transform");
+    V(ax, ay, tx, ty, ci) = apply_matrix(w.BT, ay, [&](int j) { return input_x(ax, j, tx, ty, ci); });
+
+    // Multiply the transformed tiles and filters pointwise, and sum
+    // over the input channels. For each point of the transformed tiles,
+    // this is a matrix multiply of tiles x input channels by input
+    // channels x output channels.
+    RDom rc(0, channels_in, prefix + "rc");
+    Func M(prefix + "products");
+    M(ax, ay, tx, ty, co) = 0.0f;
+    M(ax, ay, tx, ty, co) += V(ax, ay, tx, ty, rc) * U(ax, ay, rc, co);
+
+    // Transform the products back to the output: Y = A^T M A.
+    Func output_x(prefix + "output_transform_x");
+    output_x(ox, ay, tx, ty, co) = apply_matrix(w.AT, ox, [&](int i) { return M(i, ay, tx, ty, co); });
+    Func Y(prefix + "output_transform");
+    Y(ox, oy, tx, ty, co) = apply_matrix(w.AT, oy, [&](int j) { return output_x(ox, j, tx, ty, co); });
+
+    output(x, y, co) = Y(x % m, y % m, x / m, y / m, co);
+
+    // The loops over the rows of the transform matrices are always
+    // unrolled, so that the selects in apply_matrix go away.
+    if (target.has_gpu_feature()) {
+        // One thread per tile, with each thread's transforms and
+        // products held in registers.
+        Var xo("xo"), yo("yo"), xi("xi"), yi("yi");
+        Var txo("txo"), tyo("tyo"), txi("txi"), tyi("tyi");
+        Var cio("cio"), coo("coo"), cii("cii"), coi("coi");
+        output.gpu_tile(x, y, xo, yo, xi, yi, 16, 16)
+            .gpu_blocks(co);
+
+        U.compute_root()
+            .reorder(ax, ay, ci, co)
+            .unroll(ax).unroll(ay)
+            .gpu_tile(ci, co, cio, coo, cii, coi, 16, 16);
+
+        V.compute_root()
+            .reorder(ax, ay, tx, ty, ci)
+            .unroll(ax).unroll(ay)
+            .gpu_tile(tx, ty, txo, tyo, txi, tyi, 16, 16)
+            .gpu_blocks(ci);
+        input_x.compute_at(V, txi)
+            .unroll(ax).unroll(ey);
+
+        Y.compute_root()
+            .reorder(ox, oy, tx, ty, co)
+            .unroll(ox).unroll(oy)
+            .gpu_tile(tx, ty, txo, tyo, txi, tyi, 16, 16)
+            .gpu_blocks(co);
+        output_x.compute_at(Y, txi)
+            .unroll(ox).unroll(ay);
+        M.compute_at(Y, txi)
+            .unroll(ax).unroll(ay)
+            .update()
+            .reorder(ax, ay, rc)
+            .unroll(ax).unroll(ay);
+    } else {
+        // Compute blocks of two vectors of tiles across by
+        // tiles_per_task tiles down, for all the channels at once. The
+        // tiles are the innermost dimension of each stage, so that each
+        // vector holds the same point of several tiles.
+        const int vec = target.natural_vector_size<float>();
+        const int tiles = default_tiles_per_task(desc, m);
+        Var xo("xo"), yo("yo"), xi("xi"), yi("yi"), txo("txo"), txi("txi"), coi("coi");
+        output.tile(x, y, xo, yo, xi, yi, m * vec * 2, m * tiles)
+            .reorder(xi, yi, co, xo, yo)
+            .vectorize(xi, vec)
+            .parallel(yo);
+
+        // The filter transform is computed once, up front.
+        U.compute_root()
+            .reorder(ax, ay, ci, co)
+            .unroll(ax).unroll(ay)
+            .parallel(co);
+
+        input_x.compute_at(output, xo)
+            .reorder_storage(tx, ax, ey, ty, ci)
+            .reorder(tx, ax, ey, ty, ci)
+            .vectorize(tx, vec)
+            .unroll(ax);
+        V.compute_at(output, xo)
+            .reorder_storage(tx, ax, ay, ty, ci)
+            .reorder(tx, ax, ay, ty, ci)
+            .vectorize(tx, vec)
+            .unroll(ay);
+
+        // As in the batched GEMM in apps/linear_algebra, accumulate a
+        // vector of tiles by 4 output channels in registers.
+        M.compute_at(output, xo)
+            .reorder_storage(tx, ax, ay, ty, co)
+            .reorder(tx, ax, ay, ty, co)
+            .vectorize(tx, vec);
+        M.update()
+            .split(tx, txo, txi, vec, TailStrategy::GuardWithIf)
+            .split(co, co, coi, 4, TailStrategy::GuardWithIf)
+            .reorder(txi, coi, rc, txo, ax, ay, ty, co)
+            .vectorize(txi)
+            .unroll(coi);
+
+        output_x.compute_at(output, xo)
+            .reorder_storage(tx, ox, ay, ty, co)
+            .reorder(tx, ox, ay, ty, co)
+            .vectorize(tx, vec)
+            .unroll(ox);
+        Y.compute_at(output, xo)
+            .reorder_storage(tx, ox, oy, ty, co)
+            .reorder(tx, ox, oy, ty, co)
+            .vectorize(tx, vec)
+            .unroll(oy);
+
+        if (desc.schedule_input) {
+            input.compute_at(output, xo)
+                .vectorize(input.args()[0], vec);
+        }
+    }
+}
+
+void conv2d_fft(Func output, Func input, Func filter, int kernel_size, Expr channels_in,
+                const Target &target, const ConvDesc &desc, const string &prefix) {
+    _halide_user_assert(!target.has_gpu_feature())
+        << "The FFT convolution has no GPU schedule. Use the direct or Winograd algorithms instead.\n";
+
+    int N = desc.fft_size;
+    if (N <= 0) {
+        N = 16;
+        while (N < 4 * kernel_size) {
+            N *= 2;
+        }
+    }
+    _halide_user_assert(N >= kernel_size && N % 2 == 0)
+        << "The FFT size " << N << " must be even, and at least the kernel size "
+        << kernel_size << "\n";
+
+    // Each N x N FFT computes a T x T tile of the output, and the tiles
+    // of the input overlap by kernel_size - 1.
+    const int T = N - kernel_size + 1;
+    const int r = kernel_size / 2;
+
+    Var x("x"), y("y"), ci("ci"), co("co"), n0("n0"), n1("n1"), tx("tx"), ty("ty");
+
+    Func tiles(prefix + "tiles");
+    tiles(n0, n1, tx, ty, ci) = input(tx * T + n0 - r, ty * T + n1 - r, ci);
+
+    // The filter, flipped and zero padded to the size of the FFT, so
+    // that the circular convolution of a tile with it is the
+    // cross-correlation in the first T x T points.
+    Func padded(prefix + "padded_filter");
+    Expr kx = (N - n0) % N, ky = (N - n1) % N;
+    padded(n0, n1, ci, co) = select(kx < kernel_size && ky < kernel_size,
+                                    filter(min(kx, kernel_size - 1), min(ky, kernel_size - 1), ci, co),
+                                    0.0f);
+
+    Fft2dDesc tiles_desc, filter_desc, inverse_desc;
+    tiles_desc.name = prefix + "dft_tiles";
+    filter_desc.name = prefix + "dft_filter";
+    inverse_desc.name = prefix + "idft";
+    inverse_desc.gain = 1.0f / (N * N);
+
+    ComplexFunc dft_tiles = fft2d_r2c(tiles, N, N, target, tiles_desc);
+    ComplexFunc dft_filter = fft2d_r2c(padded, N, N, target, filter_desc);
+
+    RDom rc(0, channels_in, prefix + "rc");
+    ComplexFunc dft_products(prefix + "dft_products");
+    dft_products(n0, n1, tx, ty, co) = ComplexExpr(0.0f, 0.0f);
+    dft_products(n0, n1, tx, ty, co) += dft_tiles(n0, n1, tx, ty, rc) * dft_filter(n0, n1, rc, co);
+
+    Func products = fft2d_c2r(dft_products, N, N, target, inverse_desc);
+
+    output(x, y, co) = products(x % T, y % T, x / T, y / T, co);
+
+    // Compute one tile of the output at a time, for all the channels.
+    const int vec = target.natural_vector_size<float>();
+    Var xo("xo"), yo("yo"), xi("xi"), yi("yi");
+    output.tile(x, y, xo, yo, xi, yi, T, T * default_tiles_per_task(desc, T))
+        .reorder(xi, yi, co, xo, yo)
+        .vectorize(xi, vec)
+        .parallel(yo);
+
+    // The DFTs of the filter are computed once, up front.
+    dft_filter.compute_root();
+
+    dft_tiles.compute_at(output, xo);
+    dft_products.compute_at(output, xo)
+        .vectorize(n0, vec);
+    dft_products.update()
+        .reorder(n0, n1, rc)
+        .vectorize(n0, vec);
+    products.compute_at(output, xo);
+
+    if (desc.schedule_input) {
+        input.compute_at(output, xo)
+            .vectorize(input.args()[0], vec);
+    }
+}
+
+}  // namespace
+
+ConvAlgorithm choose_conv_algorithm(int kernel_size, const Target &target) {
+    if (kernel_size == 3) {
+        return target.has_gpu_feature() ? ConvAlgorithm::Winograd2x2 : ConvAlgorithm::Winograd4x4;
+    }
+    if (kernel_size > 7 && !target.has_gpu_feature()) {
+        return ConvAlgorithm::FFT;
+    }
+    return ConvAlgorithm::Direct;
+}
+
+void conv2d(Func output, Func input, Func filter, int kernel_size, Expr channels_in,
+            const Target &target, const ConvDesc &desc) {
+    _halide_user_assert(kernel_size > 0 && kernel_size % 2 == 1)
+        << "The kernel size must be odd, not " << kernel_size << "\n";
+
+    const string prefix = desc.name.empty() ? "conv_" : desc.name + "_";
+
+    ConvAlgorithm algorithm = desc.algorithm;
+    if (algorithm == ConvAlgorithm::Auto) {
+        algorithm = choose_conv_algorithm(kernel_size, target);
+    }
+
+    switch (algorithm) {
+    case ConvAlgorithm::Direct:
+        conv2d_direct(output, input, filter, kernel_size, channels_in, target, desc, prefix);
+        break;
+    case ConvAlgorithm::Winograd2x2:
+    case ConvAlgorithm::Winograd4x4:
+        _halide_user_assert(kernel_size == 3)
+            << "The Winograd algorithms only support 3x3 kernels, not "
+            << kernel_size << "x" << kernel_size << "\n";
+        conv2d_winograd(output, input, filter, algorithm == ConvAlgorithm::Winograd2x2 ? 2 : 4,
+                        channels_in, target, desc, prefix);
+        break;
+    case ConvAlgorithm::FFT:
+        conv2d_fft(output, input, filter, kernel_size, channels_in, target, desc, prefix);
+        break;
+    default:
+        _halide_user_assert(false) << "Unknown convolution algorithm\n";
+    }
+}
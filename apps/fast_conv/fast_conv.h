@@ -0,0 +1,89 @@
+#ifndef FAST_CONV_H
+#define FAST_CONV_H
+
+#include <map>
+#include <string>
+
+#include "Halide.h"
+
+// The ways to compute a convolution.
+enum class ConvAlgorithm {
+    // Choose one from the size of the kernel and the target; see
+    // choose_conv_algorithm.
+    Auto,
+    // Sum the k * k products for each output, as an RDom update.
+    Direct,
+    // Winograd minimal filtering F(2x2, 3x3), which computes each 2x2
+    // tile of the output with 16 multiplies per input channel rather
+    // than 36. Only for 3x3 kernels.
+    Winograd2x2,
+    // Winograd minimal filtering F(4x4, 3x3), which uses 36 multiplies
+    // per 4x4 tile rather than 144, at some cost in accuracy. Only for
+    // 3x3 kernels.
+    Winograd4x4,
+    // Overlap-save convolution with 2D real FFTs, which costs about the
+    // same for any size of kernel that fits in the FFT.
+    FFT,
+};
+
+inline std::map<std::string, ConvAlgorithm> conv_algorithm_enum_map() {
+    return { { "auto", ConvAlgorithm::Auto },
+             { "direct", ConvAlgorithm::Direct },
+             { "winograd_2x2", ConvAlgorithm::Winograd2x2 },
+             { "winograd_4x4", ConvAlgorithm::Winograd4x4 },
+             { "fft", ConvAlgorithm::FFT } };
+}
+
+// This is an optional extra description for the details of computing a
+// convolution.
+struct ConvDesc {
+    ConvAlgorithm algorithm = ConvAlgorithm::Auto;
+
+    // The size of the FFTs used by the FFT algorithm. Each FFT computes
+    // fft_size - kernel_size + 1 rows and columns of the output. 0
+    // chooses the smallest power of two at least four times the kernel
+    // size, which wastes less than a quarter of each FFT on the overlap
+    // between tiles.
+    int fft_size = 0;
+
+    // The number of rows of output tiles (rows of the output, for the
+    // direct algorithm) that each parallel task computes. 0 chooses
+    // about 8 rows of the output per task.
+    int tiles_per_task = 0;
+
+    // This option will schedule the input to the convolution at the
+    // innermost location that makes sense.
+    bool schedule_input = false;
+
+    // A name to prepend to the name of the Funcs the convolution defines.
+    std::string name = "";
+};
+
+// Pick the algorithm to use for a kernel of the given size. 3x3 kernels
+// use Winograd transforms (F(4x4, 3x3) on CPUs, and F(2x2, 3x3) on GPUs,
+// where the 36 accumulators of the larger transform don't fit in the
+// registers of a thread). Kernels larger than 7x7 use FFTs on CPUs. The
+// rest are computed directly.
+ConvAlgorithm choose_conv_algorithm(int kernel_size, const Halide::Target &target);
+
+// Define output as the cross-correlation of the first two dimensions of
+// input with a kernel_size x kernel_size filter centered on each output,
+// summed over the channels_in channels of the input, as in a layer of a
+// CNN:
+//
+//   output(x, y, co) = sum(input(x + kx - kernel_size / 2,
+//                                y + ky - kernel_size / 2, ci) *
+//                          filter(kx, ky, ci, co))
+//
+// kx and ky range over [0, kernel_size), and ci over [0, channels_in).
+// output must be an undefined Func. Its three dimensions are scheduled
+// for the target, along with the Funcs the convolution computes. The
+// input must be defined wherever the convolution reads it, which may
+// extend a little past the kernel footprint of the output, to the edges
+// of the tiles the fast algorithms work on.
+void conv2d(Halide::Func output, Halide::Func input, Halide::Func filter,
+            int kernel_size, Halide::Expr channels_in,
+            const Halide::Target &target,
+            const ConvDesc &desc = ConvDesc());
+
+#endif
@@ -0,0 +1,111 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "HalideBuffer.h"
+#include "benchmark.h"
+
+#include "conv3x3_direct.h"
+#include "conv3x3_winograd_2x2.h"
+#include "conv3x3_winograd_4x4.h"
+#include "conv15x15_direct.h"
+#include "conv15x15_fft.h"
+
+using Halide::Runtime::Buffer;
+
+typedef int (*ConvFunc)(buffer_t *, buffer_t *, buffer_t *);
+
+// The convolution in double precision, with zeros outside the input.
+Buffer<double> reference_conv(const Buffer<float> &in, const Buffer<float> &filter) {
+    const int k = filter.width();
+    const int r = k / 2;
+    Buffer<double> out(in.width(), in.height(), filter.dim(3).extent());
+    out.for_each_element([&](int x, int y, int co) {
+        double sum = 0;
+        for (int ci = 0; ci < in.channels(); ci++) {
+            for (int ky = 0; ky < k; ky++) {
+                int iy = y + ky - r;
+                if (iy < 0 || iy >= in.height()) continue;
+                for (int kx = 0; kx < k; kx++) {
+                    int ix = x + kx - r;
+                    if (ix < 0 || ix >= in.width()) continue;
+                    sum += (double)in(ix, iy, ci) * filter(kx, ky, ci, co);
+                }
+            }
+        }
+        out(x, y, co) = sum;
+    });
+    return out;
+}
+
+// Run a convolution, and check that its error relative to the largest
+// output is within the tolerance of its algorithm.
+bool check(const char *name, ConvFunc conv, Buffer<float> in, Buffer<float> filter,
+           const Buffer<double> &correct, double tolerance) {
+    Buffer<float> out(correct.width(), correct.height(), correct.channels());
+    if (conv(in, filter, out) != 0) {
+        printf("%s failed\n", name);
+        return false;
+    }
+    out.copy_to_host();
+
+    double max_error = 0, max_output = 0;
+    correct.for_each_element([&](int x, int y, int c) {
+        max_error = std::max(max_error, std::abs(out(x, y, c) - correct(x, y, c)));
+        max_output = std::max(max_output, std::abs(correct(x, y, c)));
+    });
+    double error = max_error / max_output;
+
+    double t = benchmark(10, 10, [&]() {
+        conv(in, filter, out);
+        out.device_sync();
+    });
+    printf("%-22s %10.3f ms, relative error %g\n", name, t * 1e3, error);
+
+    if (!(error <= tolerance)) {
+        printf("%s has a relative error of %g, more than %g\n", name, error, tolerance);
+        return false;
+    }
+    return true;
+}
+
+Buffer<float> random_buffer(std::vector<int> sizes) {
+    Buffer<float> b(sizes);
+    b.for_each_value([](float &v) { v = (float)rand() / RAND_MAX - 0.5f; });
+    return b;
+}
+
+int main(int argc, char **argv) {
+    const int W = 131, H = 97;
+    bool success = true;
+
+    // A CNN layer.
+    {
+        Buffer<float> in = random_buffer({W, H, 16});
+        Buffer<float> filter = random_buffer({3, 3, 16, 24});
+        Buffer<double> correct = reference_conv(in, filter);
+        success &= check("conv3x3_direct", conv3x3_direct, in, filter, correct, 1e-5);
+        success &= check("conv3x3_winograd_2x2", conv3x3_winograd_2x2, in, filter, correct, 1e-5);
+        // The larger transform has larger coefficients, so it loses
+        // more precision.
+        success &= check("conv3x3_winograd_4x4", conv3x3_winograd_4x4, in, filter, correct, 1e-4);
+    }
+
+    // A large blur of a few channels.
+    {
+        Buffer<float> in = random_buffer({W, H, 3});
+        Buffer<float> filter = random_buffer({15, 15, 3, 3});
+        Buffer<double> correct = reference_conv(in, filter);
+        success &= check("conv15x15_direct", conv15x15_direct, in, filter, correct, 1e-5);
+        success &= check("conv15x15_fft", conv15x15_fft, in, filter, correct, 1e-4);
+    }
+
+    if (!success) {
+        return -1;
+    }
+
+    printf("Success!\n");
+    return 0;
+}
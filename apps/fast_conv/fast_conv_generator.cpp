@@ -0,0 +1,61 @@
+#include "Halide.h"
+
+#include "fast_conv.h"
+
+namespace {
+
+using namespace Halide;
+
+class FastConvGenerator : public Halide::Generator<FastConvGenerator> {
+public:
+    // The algorithm to use. "auto" chooses one from the kernel size and
+    // the target; see choose_conv_algorithm.
+    GeneratorParam<ConvAlgorithm> algorithm{"algorithm", ConvAlgorithm::Auto,
+        conv_algorithm_enum_map() };
+
+    // The width and height of the filter, which must be odd.
+    GeneratorParam<int32_t> kernel_size{"kernel_size", 3};
+
+    // The size of the FFTs used by the FFT algorithm. 0 chooses it from
+    // the kernel size.
+    GeneratorParam<int32_t> fft_size{"fft_size", 0};
+
+    // The number of rows of tiles of the output each parallel task
+    // computes. 0 chooses it from the size of the tiles.
+    GeneratorParam<int32_t> tiles_per_task{"tiles_per_task", 0};
+
+    // The input, indexed by x, y and input channel. It is zero outside
+    // its bounds, so the output is the same size as the input.
+    Input<Buffer<float>> input{"input", 3};
+    // The filter, indexed by kernel x, kernel y, input channel and
+    // output channel.
+    Input<Buffer<float>> filter{"filter", 4};
+    // The output, indexed by x, y and output channel.
+    Output<Buffer<float>> output{"output", 3};
+
+    void generate() {
+        Func padded = BoundaryConditions::constant_exterior(input, 0.0f,
+                                                            input.dim(0).min(), input.dim(0).extent(),
+                                                            input.dim(1).min(), input.dim(1).extent());
+
+        ConvDesc desc;
+        desc.algorithm = algorithm;
+        desc.fft_size = fft_size;
+        desc.tiles_per_task = tiles_per_task;
+        // The boundary condition is cheaper to apply once per point of
+        // the input than once per use.
+        desc.schedule_input = true;
+
+        conv2d(output, padded, filter, kernel_size, input.dim(2).extent(), target, desc);
+    }
+
+    void schedule() {
+        filter.dim(0).set_bounds(0, kernel_size)
+              .dim(1).set_bounds(0, kernel_size)
+              .dim(2).set_bounds(0, input.dim(2).extent());
+    }
+};
+
+Halide::RegisterGenerator<FastConvGenerator> register_fast_conv{"fast_conv"};
+
+}
@@ -413,6 +413,86 @@ ComplexFunc fft_dim1(ComplexFunc x,
     return x;
 }
 
+// Compute the N point DFT of dimension 1 of x like fft_dim1, but if N
+// is larger than max_pass_size, use the four-step algorithm: view the
+// N = N1 * N2 points as an N1 x N2 matrix, take the N1 point DFTs of
+// the columns, apply twiddle factors, and take the N2 point DFTs of the
+// rows. Each of these smaller DFTs works on a block of data that fits
+// in the cache, where the passes of one large DFT would not.
+ComplexFunc fft_dim1_blocked(ComplexFunc x,
+                             const vector<int>& NR,
+                             int sign,
+                             int extent_0,
+                             Expr gain,
+                             bool parallel,
+                             const string& prefix,
+                             const Target& target,
+                             TwiddleFactorSet* twiddle_cache,
+                             int max_pass_size) {
+    int N = product(NR);
+    if (max_pass_size <= 0 || N <= max_pass_size || NR.size() < 2) {
+        return fft_dim1(x, NR, sign, extent_0, gain, parallel, prefix, target, twiddle_cache);
+    }
+
+    // Split the radices into two passes of about sqrt(N) points each.
+    vector<int> NR1, NR2;
+    int N1 = 1;
+    for (int R : NR) {
+        if (N1 * N1 < N) {
+            NR1.push_back(R);
+            N1 *= R;
+        } else {
+            NR2.push_back(R);
+        }
+    }
+    if (NR2.empty()) {
+        N1 /= NR1.back();
+        NR2.push_back(NR1.back());
+        NR1.pop_back();
+    }
+    int N2 = N / N1;
+
+    vector<Var> args = x.args();
+    Var n0(args[0]), n1(args[1]);
+    args.erase(args.begin());
+    args.erase(args.begin());
+
+    Var a(n1.name() + "_a"), b(n1.name() + "_b");
+
+    // x(N2 * a + b) is element (a, b) of the matrix. Take the DFTs
+    // of the columns...
+    ComplexFunc columns(prefix + "columns_" + n1.name());
+    columns(A({n0, a, b}, args)) = x(A({n0, N2 * a + b}, args));
+    ComplexFunc dft_columns = fft_dim1(columns, NR1, sign, extent_0, 1.0f, false,
+                                       prefix, target, twiddle_cache);
+
+    // ...apply the twiddle factors, and take the DFTs of the rows.
+    ComplexFunc W = twiddle_factors(N, 1.0f, sign, prefix, twiddle_cache);
+    ComplexFunc rows(prefix + "rows_" + n1.name());
+    rows(A({n0, b, a}, args)) = dft_columns(A({n0, a, b}, args)) * W(a * b);
+    ComplexFunc dft_rows = fft_dim1(rows, NR2, sign, extent_0, gain, false,
+                                    prefix, target, twiddle_cache);
+
+    // Element (a, b) of the result is element a + N1 * b of the DFT.
+    ComplexFunc dft(prefix + "four_step_" + n1.name());
+    dft(A({n0, n1}, args)) = dft_rows(A({n0, n1 / N1, n1 % N1}, args));
+    dft.bound(n1, 0, N);
+
+    // Like fft_dim1, the result is computed in groups of DFTs. Both
+    // passes of a group are computed per group.
+    int vector_width = std::min(target.natural_vector_size<float>(), extent_0);
+    dft.split(n0, group, n0, vector_width)
+        .reorder(n0, n1, group)
+        .vectorize(n0);
+    if (parallel) {
+        dft.parallel(group);
+    }
+    dft_columns.compute_at(dft, group);
+    dft_rows.compute_at(dft, group);
+
+    return dft;
+}
+
 // transpose the first two dimensions of x.
 template <typename FuncType>
 FuncType transpose(FuncType f) {
@@ -498,30 +578,32 @@ ComplexFunc fft2d_c2c(ComplexFunc x,
     std::tie(xT, x_tiled) = tiled_transpose(x, N1, target, prefix);
 
     // Compute the DFT of dimension 1 (originally dimension 0).
-    ComplexFunc dft1T = fft_dim1(xT,
-                                 R0,
-                                 sign,
-                                 N1,  // extent of dim 0.
-                                 1.0f,
-                                 desc.parallel,
-                                 prefix,
-                                 target,
-                                 &twiddle_cache);
+    ComplexFunc dft1T = fft_dim1_blocked(xT,
+                                         R0,
+                                         sign,
+                                         N1,  // extent of dim 0.
+                                         1.0f,
+                                         desc.parallel,
+                                         prefix,
+                                         target,
+                                         &twiddle_cache,
+                                         desc.max_pass_size);
 
     // transpose back.
     ComplexFunc dft1, dft1_tiled;
     std::tie(dft1, dft1_tiled) = tiled_transpose(dft1T, N0, target, prefix);
 
     // Compute the DFT of dimension 1.
-    ComplexFunc dft = fft_dim1(dft1,
-                               R1,
-                               sign,
-                               N0,  // extent of dim 0
-                               desc.gain,
-                               desc.parallel,
-                               prefix,
-                               target,
-                               &twiddle_cache);
+    ComplexFunc dft = fft_dim1_blocked(dft1,
+                                       R1,
+                                       sign,
+                                       N0,  // extent of dim 0
+                                       desc.gain,
+                                       desc.parallel,
+                                       prefix,
+                                       target,
+                                       &twiddle_cache,
+                                       desc.max_pass_size);
 
     // Schedule the tiled transposes at each group.
     if (dft1_tiled.defined()) {
@@ -711,15 +793,16 @@ ComplexFunc fft2d_r2c(Func r,
                     r(A({zip_n0 + zip_width, n1}, args)));
 
     // DFT down the columns first.
-    ComplexFunc dft1 = fft_dim1(zipped,
-                                R1,
-                                -1,  // sign
-                                std::min(zip_width, N0 / 2),  // extent of dim 0
-                                1.0f,
-                                false,  // We parallelize unzipped below instead.
-                                prefix,
-                                target,
-                                &twiddle_cache);
+    ComplexFunc dft1 = fft_dim1_blocked(zipped,
+                                        R1,
+                                        -1,  // sign
+                                        std::min(zip_width, N0 / 2),  // extent of dim 0
+                                        1.0f,
+                                        false,  // We parallelize unzipped below instead.
+                                        prefix,
+                                        target,
+                                        &twiddle_cache,
+                                        desc.max_pass_size);
 
     // Unzip the two groups of real DFTs we zipped together above. For more
     // information about the unzipping operation, see the large comment above this
@@ -754,15 +837,16 @@ ComplexFunc fft2d_r2c(Func r,
     std::tie(unzippedT, unzippedT_tiled) = tiled_transpose(zipped_0, zipped_extent0, target, prefix);
 
     // DFT down the columns again (the rows of the original).
-    ComplexFunc dftT = fft_dim1(unzippedT,
-                                R0,
-                                -1,  // sign
-                                zipped_extent0,
-                                gain,
-                                desc.parallel,
-                                prefix,
-                                target,
-                                &twiddle_cache);
+    ComplexFunc dftT = fft_dim1_blocked(unzippedT,
+                                        R0,
+                                        -1,  // sign
+                                        zipped_extent0,
+                                        gain,
+                                        desc.parallel,
+                                        prefix,
+                                        target,
+                                        &twiddle_cache,
+                                        desc.max_pass_size);
 
     // transpose the result back to the original orientation, unless the caller
     // requested a transposed DFT.
@@ -893,15 +977,16 @@ Func fft2d_c2r(ComplexFunc c,
             tiled_transpose(c_zipped, zipped_extent0, target, prefix);
 
     // Take the inverse DFT of the columns (rows in the final result).
-    ComplexFunc dft0T = fft_dim1(cT,
-                                 R0,
-                                 1,  // sign
-                                 zipped_extent0,
-                                 1.0f,
-                                 desc.parallel,
-                                 prefix,
-                                 target,
-                                 &twiddle_cache);
+    ComplexFunc dft0T = fft_dim1_blocked(cT,
+                                         R0,
+                                         1,  // sign
+                                         zipped_extent0,
+                                         1.0f,
+                                         desc.parallel,
+                                         prefix,
+                                         target,
+                                         &twiddle_cache,
+                                         desc.max_pass_size);
 
     // The vector width of the zipping performed below.
     int zip_width = desc.vector_width;
@@ -950,15 +1035,16 @@ Func fft2d_c2r(ComplexFunc c,
     }
 
     // Take the inverse DFT of the columns again.
-    ComplexFunc dft = fft_dim1(zipped,
-                               R1,
-                               1,  // sign
-                               std::min(zip_width, N0 / 2),  // extent of dim 0
-                               desc.gain,
-                               desc.parallel,
-                               prefix,
-                               target,
-                               &twiddle_cache);
+    ComplexFunc dft = fft_dim1_blocked(zipped,
+                                       R1,
+                                       1,  // sign
+                                       std::min(zip_width, N0 / 2),  // extent of dim 0
+                                       desc.gain,
+                                       desc.parallel,
+                                       prefix,
+                                       target,
+                                       &twiddle_cache,
+                                       desc.max_pass_size);
 
     ComplexFunc dft_padded = ComplexFunc(repeat_edge((Func)dft, Expr(), Expr(), Expr(0), Expr(N1)));
 
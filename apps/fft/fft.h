@@ -34,6 +34,11 @@ struct Fft2dDesc {
     // that makes sense.
     bool schedule_input = false;
 
+    // 1D DFTs larger than this are computed with the four-step algorithm,
+    // which splits them into two passes of DFTs that each fit in the cache.
+    // This only makes sense to use on large FFTs. 0 indicates no limit.
+    int max_pass_size = 0;
+
     // A name to prepend to the name of the Funcs the FFT defines.
     std::string name = "";
 };
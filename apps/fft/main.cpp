@@ -71,6 +71,9 @@ int main(int argc, char **argv) {
     Fft2dDesc fwd_desc;
     Fft2dDesc inv_desc;
     inv_desc.gain = 1.0f/(W*H);
+    // Use four-step passes for DFTs that don't fit in the cache.
+    fwd_desc.max_pass_size = 256;
+    inv_desc.max_pass_size = 256;
 
     Func filtered_c2c;
     {
@@ -131,6 +134,52 @@ int main(int argc, char **argv) {
         }
     }
 
+#ifdef WITH_FFTW
+    {
+        // Check the c2c and r2c DFTs of the input against FFTW. FFTW's
+        // arrays are row major, so the dimensions are reversed.
+        std::vector<std::pair<float, float>> fftw_in(W * H);
+        std::vector<std::pair<float, float>> fftw_out(W * H);
+        for (int y = 0; y < H; y++) {
+            for (int x = 0; x < W; x++) {
+                fftw_in[y * W + x] = std::make_pair(in(x, y), 0.0f);
+            }
+        }
+        fftwf_plan plan = fftwf_plan_dft_2d(H, W, (fftwf_complex*)&fftw_in[0], (fftwf_complex*)&fftw_out[0], FFTW_FORWARD, FFTW_ESTIMATE);
+        fftwf_execute(plan);
+        fftwf_destroy_plan(plan);
+
+        Func dft_c2c = fft2d_c2c(make_complex(in), W, H, -1, target, fwd_desc);
+        Func dft_r2c = fft2d_r2c(make_real(in), W, H, target, fwd_desc);
+        Realization R_c2c = dft_c2c.realize(W, H, target);
+        Realization R_r2c = dft_r2c.realize(W, H/2 + 1, target);
+        Buffer<float> re_c2c = R_c2c[0], im_c2c = R_c2c[1];
+        Buffer<float> re_r2c = R_r2c[0], im_r2c = R_r2c[1];
+
+        // The error of the DFT grows with its size, relative to the DC
+        // component, which is about W*H/2.
+        const float tolerance = 1e-5f * W * H;
+        for (int y = 0; y < H; y++) {
+            for (int x = 0; x < W; x++) {
+                std::pair<float, float> correct = fftw_out[y * W + x];
+                if (fabs(re_c2c(x, y) - correct.first) > tolerance ||
+                    fabs(im_c2c(x, y) - correct.second) > tolerance) {
+                    printf("dft_c2c(%d, %d) = (%f, %f) instead of (%f, %f)\n", x, y,
+                           re_c2c(x, y), im_c2c(x, y), correct.first, correct.second);
+                    return -1;
+                }
+                if (y > H/2) continue;
+                if (fabs(re_r2c(x, y) - correct.first) > tolerance ||
+                    fabs(im_r2c(x, y) - correct.second) > tolerance) {
+                    printf("dft_r2c(%d, %d) = (%f, %f) instead of (%f, %f)\n", x, y,
+                           re_r2c(x, y), im_r2c(x, y), correct.first, correct.second);
+                    return -1;
+                }
+            }
+        }
+    }
+#endif
+
     // For a description of the methodology used here, see
     // http://www.fftw.org/speed/method.html
 
@@ -7,7 +7,7 @@
 // Accepted values for subroutine are:
 //    L1: scal, copy, axpy, dot, nrm2
 //    L2: gemv_notrans, gemv_trans
-//    L3: gemm_notrans, gemm_trans_A, gemm_trans_B, gemm_trans_AB
+//    L3: gemm_notrans, gemm_trans_A, gemm_trans_B, gemm_trans_AB, gemm_batched
 //
 
 #include <iomanip>
@@ -64,6 +64,14 @@ struct BenchmarksBase {
         return buff;
     }
 
+    Matrix random_matrix_batch(int N, int batch) {
+        Matrix buff(N * N * batch);
+        for (int i=0; i<N*N*batch; ++i) {
+            buff[i] = random_scalar();
+        }
+        return buff;
+    }
+
     BenchmarksBase(std::string n) : name(n) {}
 
     void run(std::string benchmark, int size) {
@@ -91,6 +99,8 @@ struct BenchmarksBase {
             this->bench_gemm_transB(size);
         } else if (benchmark == "gemm_transAB") {
             this->bench_gemm_transAB(size);
+        } else if (benchmark == "gemm_batched") {
+            this->bench_gemm_batched(size);
         }
     }
 
@@ -106,6 +116,7 @@ struct BenchmarksBase {
     virtual void bench_gemm_transA(int N) =0;
     virtual void bench_gemm_transB(int N) =0;
     virtual void bench_gemm_transAB(int N) =0;
+    virtual void bench_gemm_batched(int N) =0;
 };
 
 struct BenchmarksFloat : public BenchmarksBase<float> {
@@ -147,6 +158,16 @@ struct BenchmarksFloat : public BenchmarksBase<float> {
     L3Benchmark(gemm_transAB, "s", cblas_sgemm(CblasColMajor, CblasTrans, CblasTrans, N, N, N,
                                                alpha, &(A[0]), N, &(B[0]), N,
                                                beta, &(C[0]), N))
+
+    // Cblas has no batched gemm, so give it one matrix per thread,
+    // like the Halide kernel.
+    L3BatchedBenchmark(gemm_batched, "s",
+                       _Pragma("omp parallel for")
+                       for (int i = 0; i < batch; i++) {
+                           cblas_sgemm(CblasColMajor, CblasNoTrans, CblasNoTrans, N, N, N,
+                                       alpha, &(A[i * N * N]), N, &(B[i * N * N]), N,
+                                       beta, &(C[i * N * N]), N);
+                       })
 };
 
 struct BenchmarksDouble : public BenchmarksBase<double> {
@@ -188,6 +209,14 @@ struct BenchmarksDouble : public BenchmarksBase<double> {
     L3Benchmark(gemm_transAB, "d", cblas_dgemm(CblasColMajor, CblasTrans, CblasTrans, N, N, N,
                                                alpha, &(A[0]), N, &(B[0]), N,
                                                beta, &(C[0]), N))
+
+    L3BatchedBenchmark(gemm_batched, "d",
+                       _Pragma("omp parallel for")
+                       for (int i = 0; i < batch; i++) {
+                           cblas_dgemm(CblasColMajor, CblasNoTrans, CblasNoTrans, N, N, N,
+                                       alpha, &(A[i * N * N]), N, &(B[i * N * N]), N,
+                                       beta, &(C[i * N * N]), N);
+                       })
 };
 
 int main(int argc, char* argv[]) {
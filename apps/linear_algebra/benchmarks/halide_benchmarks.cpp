@@ -7,7 +7,8 @@
 // Accepted values for subroutine are:
 //    L1: scal, copy, axpy, dot, nrm2
 //    L2: gemv_notrans, gemv_trans
-//    L3: gemm_notrans, gemm_trans_A, gemm_trans_B, gemm_trans_AB
+//    L3: gemm_notrans, gemm_trans_A, gemm_trans_B, gemm_trans_AB, gemm_batched,
+//        gemm_packed
 //
 
 #include <iomanip>
@@ -54,6 +55,15 @@ struct BenchmarksBase {
         return buff;
     }
 
+    Matrix random_matrix_batch(int N, int batch) {
+        Matrix buff(N, N, batch);
+        Scalar *A = (Scalar*)buff.data();
+        for (int i=0; i<N*N*batch; ++i) {
+            A[i] = random_scalar();
+        }
+        return buff;
+    }
+
     BenchmarksBase(std::string n) : name(n) {}
 
     void run(std::string benchmark, int size) {
@@ -81,6 +91,10 @@ struct BenchmarksBase {
             bench_gemm_transB(size);
         } else if (benchmark == "gemm_transAB") {
             bench_gemm_transAB(size);
+        } else if (benchmark == "gemm_batched") {
+            bench_gemm_batched(size);
+        } else if (benchmark == "gemm_packed") {
+            bench_gemm_packed(size);
         }
     }
 
@@ -96,6 +110,8 @@ struct BenchmarksBase {
     virtual void bench_gemm_transA(int N) =0;
     virtual void bench_gemm_transB(int N) =0;
     virtual void bench_gemm_transAB(int N) =0;
+    virtual void bench_gemm_batched(int N) =0;
+    virtual void bench_gemm_packed(int N) =0;
 };
 
 struct BenchmarksFloat : public BenchmarksBase<float> {
@@ -131,6 +147,12 @@ struct BenchmarksFloat : public BenchmarksBase<float> {
 
     L3Benchmark(gemm_transAB, "s", halide_sgemm(true, true, alpha, A.raw_buffer(),
                                                 B.raw_buffer(), beta, C.raw_buffer()))
+
+    L3BatchedBenchmark(gemm_batched, "s", halide_sgemm_batched(false, false, alpha, A.raw_buffer(),
+                                                              B.raw_buffer(), beta, C.raw_buffer()))
+
+    L3Benchmark(gemm_packed, "s", halide_sgemm_packed(false, false, alpha, A.raw_buffer(),
+                                                    B.raw_buffer(), beta, C.raw_buffer()))
 };
 
 struct BenchmarksDouble : public BenchmarksBase<double> {
@@ -166,6 +188,12 @@ struct BenchmarksDouble : public BenchmarksBase<double> {
 
     L3Benchmark(gemm_transAB, "d", halide_dgemm(true, true, alpha, A.raw_buffer(),
                                                 B.raw_buffer(), beta, C.raw_buffer()))
+
+    L3BatchedBenchmark(gemm_batched, "d", halide_dgemm_batched(false, false, alpha, A.raw_buffer(),
+                                                              B.raw_buffer(), beta, C.raw_buffer()))
+
+    L3Benchmark(gemm_packed, "d", halide_dgemm_packed(false, false, alpha, A.raw_buffer(),
+                                                    B.raw_buffer(), beta, C.raw_buffer()))
 };
 
 int main(int argc, char* argv[]) {
@@ -68,3 +68,24 @@
                   << std::setw(20) << L3GFLOPS(N)                       \
                   << std::endl;                                         \
     }
+
+// Batched gemm benchmarks run a batch of L3_BATCH_SIZE small matrices.
+#define L3_BATCH_SIZE 256
+#define L3BatchedBenchmark(benchmark, type, code)                       \
+    virtual void bench_##benchmark(int N) {                             \
+        const int batch = L3_BATCH_SIZE;                                \
+        Scalar alpha = random_scalar();                                 \
+        Scalar beta = random_scalar();                                  \
+        Matrix A(random_matrix_batch(N, batch));                        \
+        Matrix B(random_matrix_batch(N, batch));                        \
+        Matrix C(random_matrix_batch(N, batch));                        \
+                                                                        \
+        time_it(code)                                                   \
+                                                                        \
+        std::cout << std::setw(8) << name                               \
+                  << std::setw(15) << type << #benchmark                \
+                  << std::setw(8) << std::to_string(N)                  \
+                  << std::setw(20) << std::to_string(elapsed)           \
+                  << std::setw(20) << batch * L3GFLOPS(N)               \
+                  << std::endl;                                         \
+    }
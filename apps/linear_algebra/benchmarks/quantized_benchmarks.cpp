@@ -0,0 +1,107 @@
+// USAGE: quantized_benchmarks <subroutine> <size>
+//
+// Benchmarks the 8-bit gemm kernels against the reference
+// implementation in quantized_reference.h. Will construct random
+// size x size matrices to test the subroutine with.
+//
+// Accepted values for subroutine are:
+//    u8gemm, s8gemm, u8gemm_requantized, s8gemm_requantized
+//
+
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include "HalideBuffer.h"
+#include "halide_blas.h"
+#include "quantized_reference.h"
+#include "clock.h"
+#include "macros.h"
+
+#define QuantizedGOPS(N) 2.0 * N * N * N * 1e-3 / elapsed
+
+template<class T>
+struct QuantizedBenchmarks {
+    typedef Halide::Runtime::Buffer<T> Matrix;
+
+    std::random_device rand_dev;
+    std::default_random_engine rand_eng{rand_dev()};
+
+    Matrix random_matrix(int N) {
+        std::uniform_int_distribution<int> uniform_dist(std::numeric_limits<T>::min(),
+                                                        std::numeric_limits<T>::max());
+        Matrix buff(N, N);
+        buff.for_each_value([&](T &x) { x = (T)uniform_dist(rand_eng); });
+        return buff;
+    }
+
+    void report(const std::string &name, const std::string &subroutine, int N, double elapsed) {
+        std::cout << std::setw(8) << name
+                  << std::setw(15) << subroutine
+                  << std::setw(8) << std::to_string(N)
+                  << std::setw(20) << std::to_string(elapsed)
+                  << std::setw(20) << QuantizedGOPS(N)
+                  << std::endl;
+    }
+
+    void run(const std::string &subroutine, int N, bool requantize,
+             int (*halide_gemm)(int32_t, buffer_t *, int32_t, buffer_t *, buffer_t *, buffer_t *),
+             int (*halide_requantized_gemm)(int32_t, buffer_t *, int32_t, buffer_t *, buffer_t *,
+                                            buffer_t *, buffer_t *, int32_t, buffer_t *)) {
+        const int32_t a_offset = 3, b_offset = 5, c_offset = 7;
+        Matrix A(random_matrix(N)), B(random_matrix(N));
+        Halide::Runtime::Buffer<int32_t> bias(N), multiplier(N), shift(N), C32(N, N);
+        Matrix C(N, N);
+        bias.fill(100);
+        multiplier.fill(1 << 30);
+        shift.fill(8);
+
+        {
+            time_it(
+                if (requantize) {
+                    reference_requantized_gemm(N, N, N, a_offset, A.data(), b_offset, B.data(),
+                                               bias.data(), multiplier.data(), shift.data(),
+                                               c_offset, C.data());
+                } else {
+                    reference_quantized_gemm(N, N, N, a_offset, A.data(), b_offset, B.data(),
+                                             bias.data(), C32.data());
+                })
+            report("Ref", subroutine, N, elapsed);
+        }
+
+        {
+            time_it(
+                if (requantize) {
+                    halide_requantized_gemm(a_offset, A.raw_buffer(), b_offset, B.raw_buffer(),
+                                            bias.raw_buffer(), multiplier.raw_buffer(),
+                                            shift.raw_buffer(), c_offset, C.raw_buffer());
+                } else {
+                    halide_gemm(a_offset, A.raw_buffer(), b_offset, B.raw_buffer(),
+                                bias.raw_buffer(), C32.raw_buffer());
+                })
+            report("Halide", subroutine, N, elapsed);
+        }
+    }
+};
+
+int main(int argc, char* argv[]) {
+    if (argc != 3) {
+        std::cout << "USAGE: quantized_benchmarks <subroutine> <size>\n";
+        return 0;
+    }
+
+    std::string subroutine = argv[1];
+    int size = std::stoi(argv[2]);
+
+    if (subroutine == "u8gemm") {
+        QuantizedBenchmarks<uint8_t>().run(subroutine, size, false, halide_u8gemm, nullptr);
+    } else if (subroutine == "s8gemm") {
+        QuantizedBenchmarks<int8_t>().run(subroutine, size, false, halide_s8gemm, nullptr);
+    } else if (subroutine == "u8gemm_requantized") {
+        QuantizedBenchmarks<uint8_t>().run(subroutine, size, true, nullptr, halide_u8gemm_requantized);
+    } else if (subroutine == "s8gemm_requantized") {
+        QuantizedBenchmarks<int8_t>().run(subroutine, size, true, nullptr, halide_s8gemm_requantized);
+    }
+
+    return 0;
+}
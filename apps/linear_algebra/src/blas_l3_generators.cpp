@@ -160,7 +160,243 @@ class GEMMGenerator :
     }
 };
 
+// Generator class for batches of small BLAS gemm operations, with
+// the matrices stacked along a third dimension. Any stride between
+// the matrices of the batch is allowed.
+template<class T>
+class BatchedGEMMGenerator :
+        public Generator<BatchedGEMMGenerator<T>> {
+  public:
+    typedef Generator<BatchedGEMMGenerator<T>> Base;
+    using Base::target;
+    using Base::get_target;
+    using Base::natural_vector_size;
+
+    GeneratorParam<bool> transpose_A_ = {"transpose_A", false};
+    GeneratorParam<bool> transpose_B_ = {"transpose_B", false};
+
+    // Standard ordering of parameters in GEMM functions.
+    Param<T>   a_ = {"a", 1.0};
+    ImageParam A_ = {type_of<T>(), 3, "A"};
+    ImageParam B_ = {type_of<T>(), 3, "B"};
+    Param<T>   b_ = {"b", 1.0};
+    ImageParam C_ = {type_of<T>(), 3, "C"};
+
+    Func build() {
+        // Matrices are interpreted as column-major by default.
+        const Expr num_rows = transpose_A_ ? A_.height() : A_.width();
+        const Expr num_cols = transpose_B_ ? B_.width() : B_.height();
+        const Expr sum_size = transpose_A_ ? A_.width() : A_.height();
+        const Expr batch_size = C_.channels();
+
+        const int vec = natural_vector_size(a_.type());
+
+        Var i("i"), j("j"), k("k"), ii("ii"), ji("ji"), batch("batch");
+
+        Func A("A"), B("B");
+        if (transpose_A_) {
+            A(i, k, batch) = A_(k, i, batch);
+        } else {
+            A(i, k, batch) = A_(i, k, batch);
+        }
+        if (transpose_B_) {
+            B(k, j, batch) = B_(j, k, batch);
+        } else {
+            B(k, j, batch) = B_(k, j, batch);
+        }
+
+        Func AB("AB");
+        RDom rv(0, sum_size);
+        AB(i, j, batch) += A(i, rv, batch) * B(rv, j, batch);
+
+        Func result("result");
+        result(i, j, batch) = a_ * AB(i, j, batch) + b_ * C_(i, j, batch);
+
+        // The matrices are too small to be worth splitting across
+        // cores, so give each core whole matrices, and accumulate
+        // each vec x 4 tile of the result in registers.
+        result.tile(i, j, ii, ji, vec, 4, TailStrategy::GuardWithIf)
+            .vectorize(ii).unroll(ji)
+            .parallel(batch);
+
+        AB.compute_at(result, i)
+            .bound_extent(j, 4).unroll(j)
+            .bound_extent(i, vec).vectorize(i)
+            .update()
+            .reorder(i, j, rv).unroll(j).vectorize(i);
+
+        // Give the tiles dense vector loads of A.
+        if (transpose_A_) {
+            A.compute_at(result, batch)
+                .vectorize(i, vec, TailStrategy::GuardWithIf);
+        }
+
+        A_.set_min(0, 0).set_min(1, 0).set_min(2, 0);
+        B_.set_min(0, 0).set_min(1, 0).set_min(2, 0);
+        C_.set_bounds(0, 0, num_rows).set_bounds(1, 0, num_cols).set_min(2, 0);
+        result.output_buffer()
+            .set_bounds(0, 0, num_rows).set_bounds(1, 0, num_cols).set_bounds(2, 0, batch_size);
+
+        return result;
+    }
+};
+
+// Generator class for BLAS gemm operations on large matrices. This
+// uses the three levels of blocking of Goto's algorithm: a block_depth
+// x block_cols panel of B is packed to live in the L3 cache, a
+// block_rows x block_depth block of A is packed to live in the L2
+// cache, and a micro_rows x micro_cols tile of the result is held in
+// registers while it is multiplied by slivers of the packed A and B
+// that live in the L1 cache. The packed A and B are laid out in the
+// order the inner loops read them, and are padded with zeros to whole
+// micro tiles so that the inner loops need no tails.
+template<class T>
+class PackedGEMMGenerator :
+        public Generator<PackedGEMMGenerator<T>> {
+  public:
+    typedef Generator<PackedGEMMGenerator<T>> Base;
+    using Base::target;
+    using Base::get_target;
+    using Base::natural_vector_size;
+
+    GeneratorParam<bool> transpose_A_ = {"transpose_A", false};
+    GeneratorParam<bool> transpose_B_ = {"transpose_B", false};
+
+    // The micro tile and block depth determine the layout of the
+    // packed panels, so they are GeneratorParams. Zero means pick a
+    // size for the target.
+    GeneratorParam<int> micro_rows_ = {"micro_rows", 0};
+    GeneratorParam<int> micro_cols_ = {"micro_cols", 0};
+    GeneratorParam<int> block_depth_ = {"block_depth", 0};
+
+    // The sizes of the blocks of A and B that are packed at a time.
+    ScheduleParam<int> block_rows_ = {"block_rows", 0};
+    ScheduleParam<int> block_cols_ = {"block_cols", 0};
+
+    // Standard ordering of parameters in GEMM functions.
+    GeneratorInput<T>         a_ = {"a", 1.0};
+    GeneratorInput<Buffer<T>> A_ = {"A", 2};
+    GeneratorInput<Buffer<T>> B_ = {"B", 2};
+    GeneratorInput<T>         b_ = {"b", 1.0};
+    GeneratorInput<Buffer<T>> C_ = {"C", 2};
+
+    GeneratorOutput<Buffer<T>> result_ = {"result", 2};
+
+    void generate() {
+        const int vec = natural_vector_size(type_of<T>());
+
+        // Two vectors of rows by enough columns to use most of the
+        // vector registers as accumulators.
+        mr = micro_rows_ > 0 ? (int)micro_rows_ : 2 * vec;
+        if (micro_cols_ > 0) {
+            nr = micro_cols_;
+        } else if (get_target().arch == Target::ARM) {
+            nr = get_target().bits == 64 ? 8 : 4;
+        } else {
+            nr = get_target().has_feature(Target::AVX512) ? 8 : 6;
+        }
+        // Enough depth that the slivers of A and B fill about half of
+        // a 32k L1 cache.
+        kc = block_depth_ > 0 ? (int)block_depth_ : 1024 / (int)sizeof(T);
+
+        // Matrices are interpreted as column-major by default.
+        num_rows = transpose_A_ ? A_.dim(1).extent() : A_.dim(0).extent();
+        num_cols = transpose_B_ ? B_.dim(0).extent() : B_.dim(1).extent();
+        sum_size = transpose_A_ ? A_.dim(0).extent() : A_.dim(1).extent();
+
+        Func A("A"), B("B");
+        if (transpose_A_) {
+            A(i, k) = A_(k, i);
+        } else {
+            A(i, k) = A_(i, k);
+        }
+        if (transpose_B_) {
+            B(k, j) = B_(j, k);
+        } else {
+            B(k, j) = B_(k, j);
+        }
+
+        // Slivers of micro_rows rows of A, and of micro_cols columns of
+        // B, each contiguous along k.
+        Expr row = io * mr + ii;
+        Apack(ii, k, io) = select(row < num_rows && k < sum_size,
+                                  A(min(row, num_rows - 1), min(k, sum_size - 1)),
+                                  cast<T>(0));
+        Expr col = jo * nr + ji;
+        Bpack(ji, k, jo) = select(col < num_cols && k < sum_size,
+                                  B(min(k, sum_size - 1), min(col, num_cols - 1)),
+                                  cast<T>(0));
+
+        // The product of one block_depth slice of a sliver of A and a
+        // sliver of B, indexed by micro tile.
+        rki = RDom(0, kc, "rki");
+        Expr kk = ko * kc + rki;
+        ABk(ii, ji, io, jo, ko) += Apack(ii, kk, io) * Bpack(ji, kk, jo);
+
+        // Accumulate the slices into the result, like C += A*B.
+        rko = RDom(0, (sum_size + kc - 1) / kc, "rko");
+        result_(i, j) = b_ * C_(i, j);
+        result_(i, j) += a_ * ABk(i % mr, j % nr, i / mr, j / nr, rko);
+
+        A_.dim(0).set_min(0).dim(1).set_min(0);
+        B_.dim(0).set_min(0).dim(1).set_min(0);
+        C_.dim(0).set_bounds(0, num_rows).dim(1).set_bounds(0, num_cols);
+        result_.dim(0).set_bounds(0, num_rows).dim(1).set_bounds(0, num_cols);
+    }
+
+    void schedule() {
+        const int vec = natural_vector_size(type_of<T>());
+
+        // Blocks of A of about 128k, and panels of B of about 1M.
+        int mc = block_rows_ > 0 ? (int)block_rows_ : 128;
+        int nc = block_cols_ > 0 ? (int)block_cols_ : (1 << 20) / ((int)sizeof(T) * kc);
+        mc = std::max(mr, mc / mr * mr);
+        nc = std::max(nr, nc / nr * nr);
+
+        Func result = result_;
+        Var jb("jb"), ib("ib");
+
+        result.vectorize(i, vec, TailStrategy::GuardWithIf).parallel(j);
+
+        // The loop nest of Goto's algorithm. The blocks of A are
+        // independent, so give them to different cores.
+        result.update()
+            .split(j, jb, j, nc)
+            .split(i, ib, i, mc)
+            .split(i, io, ii, mr)
+            .split(j, jo, ji, nr)
+            .reorder(ii, ji, io, jo, ib, rko, jb)
+            .vectorize(ii, vec).unroll(ii).unroll(ji)
+            .parallel(ib);
+
+        Bpack.compute_at(result, rko)
+            .bound_extent(ji, nr).unroll(ji)
+            .vectorize(k, vec, TailStrategy::GuardWithIf);
+
+        Apack.compute_at(result, ib)
+            .bound_extent(ii, mr).vectorize(ii, vec).unroll(ii);
+
+        // The micro tile, held in registers.
+        ABk.compute_at(result, io)
+            .bound_extent(ii, mr).bound_extent(ji, nr)
+            .vectorize(ii, vec).unroll(ii).unroll(ji)
+            .update()
+            .reorder(ii, ji, rki).vectorize(ii, vec).unroll(ii).unroll(ji);
+    }
+
+  private:
+    Var i{"i"}, j{"j"}, k{"k"}, ii{"ii"}, io{"io"}, ji{"ji"}, jo{"jo"}, ko{"ko"};
+    RDom rki, rko;
+    Func Apack{"Apack"}, Bpack{"Bpack"}, ABk{"ABk"};
+    Expr num_rows, num_cols, sum_size;
+    int mr = 0, nr = 0, kc = 0;
+};
+
 RegisterGenerator<GEMMGenerator<float>>    register_sgemm("sgemm");
 RegisterGenerator<GEMMGenerator<double>>   register_dgemm("dgemm");
+RegisterGenerator<BatchedGEMMGenerator<float>>    register_sgemm_batched("sgemm_batched");
+RegisterGenerator<BatchedGEMMGenerator<double>>   register_dgemm_batched("dgemm_batched");
+RegisterGenerator<PackedGEMMGenerator<float>>    register_sgemm_packed("sgemm_packed");
+RegisterGenerator<PackedGEMMGenerator<double>>   register_dgemm_packed("dgemm_packed");
 
 }  // namespace
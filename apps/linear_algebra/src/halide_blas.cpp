@@ -12,6 +12,10 @@ using Halide::Runtime::Buffer;
 
 namespace {
 
+// Matrices with all dimensions at least this large use the packed
+// gemm kernels.
+const int packed_gemm_min_size = 256;
+
 template<typename T>
 Buffer<T> init_scalar_buffer(T *x) {
     return Buffer<T>(x, {});
@@ -29,6 +33,13 @@ Buffer<T> init_matrix_buffer(const int M, const int N, T *A, const int lda) {
     return Buffer<T>(A, 2, shape);
 }
 
+template<typename T>
+Buffer<T> init_matrix_batch_buffer(const int M, const int N, T *A, const int lda,
+                                   const int stride, const int batch_count) {
+    halide_dimension_t shape[] = {{0, M, 1}, {0, N, lda}, {0, batch_count, stride}};
+    return Buffer<T>(A, 3, shape);
+}
+
 }
 
 #ifdef __cplusplus
@@ -247,7 +258,11 @@ void hblas_sgemm(const enum HBLAS_ORDER Order, const enum HBLAS_TRANSPOSE TransA
     auto buff_B = init_matrix_buffer(tB ? N : K, tB ? K : N, B, ldb);
     auto buff_C = init_matrix_buffer(M, N, C, ldc);
 
-    assert_no_error(halide_sgemm(tA, tB, alpha, buff_A, buff_B, beta, buff_C));
+    if (M >= packed_gemm_min_size && N >= packed_gemm_min_size && K >= packed_gemm_min_size) {
+        assert_no_error(halide_sgemm_packed(tA, tB, alpha, buff_A, buff_B, beta, buff_C));
+    } else {
+        assert_no_error(halide_sgemm(tA, tB, alpha, buff_A, buff_B, beta, buff_C));
+    }
 }
 
 void hblas_dgemm(const enum HBLAS_ORDER Order, const enum HBLAS_TRANSPOSE TransA,
@@ -276,7 +291,75 @@ void hblas_dgemm(const enum HBLAS_ORDER Order, const enum HBLAS_TRANSPOSE TransA
     auto buff_B = init_matrix_buffer(tB ? N : K, tB ? K : N, B, ldb);
     auto buff_C = init_matrix_buffer(M, N, C, ldc);
 
-    assert_no_error(halide_dgemm(tA, tB, alpha, buff_A, buff_B, beta, buff_C));
+    if (M >= packed_gemm_min_size && N >= packed_gemm_min_size && K >= packed_gemm_min_size) {
+        assert_no_error(halide_dgemm_packed(tA, tB, alpha, buff_A, buff_B, beta, buff_C));
+    } else {
+        assert_no_error(halide_dgemm(tA, tB, alpha, buff_A, buff_B, beta, buff_C));
+    }
+}
+
+//////////////////
+// batched gemm //
+//////////////////
+
+void hblas_sgemm_strided_batched(const enum HBLAS_ORDER Order, const enum HBLAS_TRANSPOSE TransA,
+                 const enum HBLAS_TRANSPOSE TransB, const int M, const int N,
+                 const int K, const float alpha, const float *A,
+                 const int lda, const int strideA, const float *B,
+                 const int ldb, const int strideB, const float beta,
+                 float *C, const int ldc, const int strideC, const int batch_count) {
+    bool tA = false, tB = false;
+    switch (TransA) {
+    case HblasNoTrans:
+        tA = false; break;
+    case HblasConjTrans:
+    case HblasTrans:
+        tA = true; break;
+    };
+
+    switch (TransB) {
+    case HblasNoTrans:
+        tB = false; break;
+    case HblasConjTrans:
+    case HblasTrans:
+        tB = true; break;
+    };
+
+    auto buff_A = init_matrix_batch_buffer(tA ? K : M, tA ? M : K, A, lda, strideA, batch_count);
+    auto buff_B = init_matrix_batch_buffer(tB ? N : K, tB ? K : N, B, ldb, strideB, batch_count);
+    auto buff_C = init_matrix_batch_buffer(M, N, C, ldc, strideC, batch_count);
+
+    assert_no_error(halide_sgemm_batched(tA, tB, alpha, buff_A, buff_B, beta, buff_C));
+}
+
+void hblas_dgemm_strided_batched(const enum HBLAS_ORDER Order, const enum HBLAS_TRANSPOSE TransA,
+                 const enum HBLAS_TRANSPOSE TransB, const int M, const int N,
+                 const int K, const double alpha, const double *A,
+                 const int lda, const int strideA, const double *B,
+                 const int ldb, const int strideB, const double beta,
+                 double *C, const int ldc, const int strideC, const int batch_count) {
+    bool tA = false, tB = false;
+    switch (TransA) {
+    case HblasNoTrans:
+        tA = false; break;
+    case HblasConjTrans:
+    case HblasTrans:
+        tA = true; break;
+    };
+
+    switch (TransB) {
+    case HblasNoTrans:
+        tB = false; break;
+    case HblasConjTrans:
+    case HblasTrans:
+        tB = true; break;
+    };
+
+    auto buff_A = init_matrix_batch_buffer(tA ? K : M, tA ? M : K, A, lda, strideA, batch_count);
+    auto buff_B = init_matrix_batch_buffer(tB ? N : K, tB ? K : N, B, ldb, strideB, batch_count);
+    auto buff_C = init_matrix_batch_buffer(M, N, C, ldc, strideC, batch_count);
+
+    assert_no_error(halide_dgemm_batched(tA, tB, alpha, buff_A, buff_B, beta, buff_C));
 }
 
 
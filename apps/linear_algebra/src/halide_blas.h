@@ -28,6 +28,26 @@
 #include "halide_dgemm_transB.h"
 #include "halide_sgemm_transAB.h"
 #include "halide_dgemm_transAB.h"
+#include "halide_sgemm_batched_notrans.h"
+#include "halide_dgemm_batched_notrans.h"
+#include "halide_sgemm_batched_transA.h"
+#include "halide_dgemm_batched_transA.h"
+#include "halide_sgemm_batched_transB.h"
+#include "halide_dgemm_batched_transB.h"
+#include "halide_sgemm_batched_transAB.h"
+#include "halide_dgemm_batched_transAB.h"
+#include "halide_sgemm_packed_notrans.h"
+#include "halide_dgemm_packed_notrans.h"
+#include "halide_sgemm_packed_transA.h"
+#include "halide_dgemm_packed_transA.h"
+#include "halide_sgemm_packed_transB.h"
+#include "halide_dgemm_packed_transB.h"
+#include "halide_sgemm_packed_transAB.h"
+#include "halide_dgemm_packed_transAB.h"
+#include "halide_u8gemm.h"
+#include "halide_s8gemm.h"
+#include "halide_u8gemm_requantized.h"
+#include "halide_s8gemm_requantized.h"
 
 inline int halide_scopy(buffer_t *x, buffer_t *y) {
     return halide_scopy_impl(0, x, nullptr, y);
@@ -103,6 +123,62 @@ inline int halide_dgemm(bool transA, bool transB, double a, buffer_t *A, buffer_
     return -1;
 }
 
+// The batched gemm kernels take the matrices of the batch stacked
+// along a third dimension, with any stride between them.
+inline int halide_sgemm_batched(bool transA, bool transB, float a, buffer_t *A, buffer_t *B, float b, buffer_t *C) {
+    if (transA && transB) {
+        return halide_sgemm_batched_transAB(a, A, B, b, C, C);
+    } else if (transA) {
+        return halide_sgemm_batched_transA(a, A, B, b, C, C);
+    } else if (transB) {
+        return halide_sgemm_batched_transB(a, A, B, b, C, C);
+    } else {
+        return halide_sgemm_batched_notrans(a, A, B, b, C, C);
+    }
+    return -1;
+}
+
+inline int halide_dgemm_batched(bool transA, bool transB, double a, buffer_t *A, buffer_t *B, double b, buffer_t *C) {
+    if (transA && transB) {
+        return halide_dgemm_batched_transAB(a, A, B, b, C, C);
+    } else if (transA) {
+        return halide_dgemm_batched_transA(a, A, B, b, C, C);
+    } else if (transB) {
+        return halide_dgemm_batched_transB(a, A, B, b, C, C);
+    } else {
+        return halide_dgemm_batched_notrans(a, A, B, b, C, C);
+    }
+    return -1;
+}
+
+// The packed gemm kernels are faster on large matrices, where
+// blocking for the caches matters more than the cost of packing.
+inline int halide_sgemm_packed(bool transA, bool transB, float a, buffer_t *A, buffer_t *B, float b, buffer_t *C) {
+    if (transA && transB) {
+        return halide_sgemm_packed_transAB(a, A, B, b, C, C);
+    } else if (transA) {
+        return halide_sgemm_packed_transA(a, A, B, b, C, C);
+    } else if (transB) {
+        return halide_sgemm_packed_transB(a, A, B, b, C, C);
+    } else {
+        return halide_sgemm_packed_notrans(a, A, B, b, C, C);
+    }
+    return -1;
+}
+
+inline int halide_dgemm_packed(bool transA, bool transB, double a, buffer_t *A, buffer_t *B, double b, buffer_t *C) {
+    if (transA && transB) {
+        return halide_dgemm_packed_transAB(a, A, B, b, C, C);
+    } else if (transA) {
+        return halide_dgemm_packed_transA(a, A, B, b, C, C);
+    } else if (transB) {
+        return halide_dgemm_packed_transB(a, A, B, b, C, C);
+    } else {
+        return halide_dgemm_packed_notrans(a, A, B, b, C, C);
+    }
+    return -1;
+}
+
 enum HBLAS_ORDER {HblasRowMajor=101, HblasColMajor=102};
 enum HBLAS_TRANSPOSE {HblasNoTrans=111, HblasTrans=112, HblasConjTrans=113};
 enum HBLAS_UPLO {HblasUpper=121, HblasLower=122};
@@ -244,6 +320,20 @@ void hblas_dgemm(const enum HBLAS_ORDER Order, const enum HBLAS_TRANSPOSE TransA
                  const int lda, const double *B, const int ldb,
                  const double beta, double *C, const int ldc);
 
+void hblas_sgemm_strided_batched(const enum HBLAS_ORDER Order, const enum HBLAS_TRANSPOSE TransA,
+                 const enum HBLAS_TRANSPOSE TransB, const int M, const int N,
+                 const int K, const float alpha, const float *A,
+                 const int lda, const int strideA, const float *B,
+                 const int ldb, const int strideB, const float beta,
+                 float *C, const int ldc, const int strideC, const int batch_count);
+
+void hblas_dgemm_strided_batched(const enum HBLAS_ORDER Order, const enum HBLAS_TRANSPOSE TransA,
+                 const enum HBLAS_TRANSPOSE TransB, const int M, const int N,
+                 const int K, const double alpha, const double *A,
+                 const int lda, const int strideA, const double *B,
+                 const int ldb, const int strideB, const double beta,
+                 double *C, const int ldc, const int strideC, const int batch_count);
+
 #ifdef __cplusplus
 }
 #endif
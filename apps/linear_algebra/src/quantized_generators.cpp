@@ -0,0 +1,157 @@
+#include <vector>
+#include "Halide.h"
+
+using namespace Halide;
+
+namespace {
+
+// The int32 product of two matrices of 8-bit values with zero points,
+// plus a bias per row, as in gemmlowp. The raw products are summed
+// four at a time so that they can use the widening multiply-add
+// instructions (pmaddwd, sdot/udot, vrmpy), and the zero points are
+// applied afterwards using the row sums of A and the column sums of
+// B. The matrices are column-major, and A is m x k.
+class QuantizedProduct {
+  public:
+    Var i{"i"}, j{"j"}, k{"k"}, ii{"ii"}, ji{"ji"};
+    Func A{"A"}, B{"B"}, AB{"AB"}, row_sum_A{"row_sum_A"}, col_sum_B{"col_sum_B"}, result{"result"};
+    RDom rv;
+
+    QuantizedProduct(ImageParam A_, Expr a_offset, ImageParam B_, Expr b_offset, ImageParam bias) {
+        const Expr num_rows = A_.width();
+        const Expr sum_size = A_.height();
+
+        // Pad the sum to a multiple of four with products of zero.
+        A(i, k) = select(k < sum_size, A_(i, min(k, sum_size - 1)), cast(A_.type(), 0));
+        B(k, j) = select(k < sum_size, B_(min(k, sum_size - 1), j), cast(B_.type(), 0));
+
+        auto prod = [&](Expr kk) {
+            return cast<int32_t>(A(i, kk)) * cast<int32_t>(B(kk, j));
+        };
+        rv = RDom(0, (sum_size + 3) / 4);
+        Expr k0 = rv * 4;
+        // Group the products in pairs, which is the pattern pmaddwd
+        // matches. The ARM and Hexagon patterns regroup them.
+        AB(i, j) += ((prod(k0) + prod(k0 + 1)) + (prod(k0 + 2) + prod(k0 + 3)));
+
+        RDom rk(0, sum_size);
+        row_sum_A(i) += cast<int32_t>(A(i, rk));
+        col_sum_B(j) += cast<int32_t>(B(rk, j));
+
+        result(i, j) = (AB(i, j) - b_offset * row_sum_A(i) - a_offset * col_sum_B(j) +
+                        sum_size * a_offset * b_offset + bias(i));
+
+        A_.set_min(0, 0).set_min(1, 0);
+        B_.set_bounds(0, 0, sum_size).set_min(1, 0);
+        bias.set_bounds(0, 0, num_rows);
+    }
+
+    // Accumulate each vec x 4 tile of the result in registers, and
+    // compute the result into the given tile of the output.
+    void schedule(Func output, int vec) {
+        output.tile(i, j, ii, ji, vec, 4, TailStrategy::GuardWithIf)
+            .vectorize(ii).unroll(ji)
+            .parallel(j);
+
+        AB.compute_at(output, i)
+            .bound_extent(j, 4).unroll(j)
+            .bound_extent(i, vec).vectorize(i)
+            .update()
+            .reorder(i, j, rv).unroll(j).vectorize(i);
+
+        // Make padded copies of A and B, so the inner loop has no
+        // selects.
+        A.compute_root()
+            .vectorize(i, vec * 4, TailStrategy::GuardWithIf)
+            .parallel(k);
+        B.compute_root()
+            .vectorize(k, vec * 4, TailStrategy::GuardWithIf)
+            .parallel(j);
+
+        row_sum_A.compute_root()
+            .vectorize(i, vec, TailStrategy::GuardWithIf)
+            .update()
+            .vectorize(i, vec, TailStrategy::GuardWithIf);
+        col_sum_B.compute_root();
+    }
+};
+
+// Generator class for the int32 product of 8-bit matrices.
+template<class T>
+class QuantizedGEMMGenerator :
+        public Generator<QuantizedGEMMGenerator<T>> {
+  public:
+    typedef Generator<QuantizedGEMMGenerator<T>> Base;
+    using Base::target;
+    using Base::get_target;
+    using Base::natural_vector_size;
+
+    Param<int32_t> a_offset_ = {"a_offset", 0};
+    ImageParam     A_        = {type_of<T>(), 2, "A"};
+    Param<int32_t> b_offset_ = {"b_offset", 0};
+    ImageParam     B_        = {type_of<T>(), 2, "B"};
+    ImageParam     bias_     = {Int(32), 1, "bias"};
+
+    Func build() {
+        QuantizedProduct p(A_, a_offset_, B_, b_offset_, bias_);
+
+        Func output("output");
+        output(p.i, p.j) = p.result(p.i, p.j);
+        p.schedule(output, natural_vector_size(Int(32)));
+
+        output.output_buffer()
+            .set_bounds(0, 0, A_.width()).set_bounds(1, 0, B_.height());
+
+        return output;
+    }
+};
+
+// Generator class for the product of 8-bit matrices requantized to
+// 8 bits, with a fixed point multiplier and shift per row, i.e. per
+// output channel when A holds the weights.
+template<class T>
+class RequantizedGEMMGenerator :
+        public Generator<RequantizedGEMMGenerator<T>> {
+  public:
+    typedef Generator<RequantizedGEMMGenerator<T>> Base;
+    using Base::target;
+    using Base::get_target;
+    using Base::natural_vector_size;
+
+    Param<int32_t> a_offset_   = {"a_offset", 0};
+    ImageParam     A_          = {type_of<T>(), 2, "A"};
+    Param<int32_t> b_offset_   = {"b_offset", 0};
+    ImageParam     B_          = {type_of<T>(), 2, "B"};
+    ImageParam     bias_       = {Int(32), 1, "bias"};
+    // The result of row i is multiplied by multiplier(i) / 2^31, with
+    // rounding, and then shifted right by shift(i), with rounding.
+    ImageParam     multiplier_ = {Int(32), 1, "multiplier"};
+    ImageParam     shift_      = {Int(32), 1, "shift"};
+    Param<int32_t> c_offset_   = {"c_offset", 0};
+
+    Func build() {
+        QuantizedProduct p(A_, a_offset_, B_, b_offset_, bias_);
+
+        Expr shift = 31 + shift_(p.i);
+        Expr scaled = cast<int64_t>(p.result(p.i, p.j)) * multiplier_(p.i);
+        scaled = (scaled + (cast<int64_t>(1) << (shift - 1))) >> shift;
+
+        Func output("output");
+        output(p.i, p.j) = saturating_cast<T>(c_offset_ + cast<int32_t>(scaled));
+        p.schedule(output, natural_vector_size(Int(32)));
+
+        multiplier_.set_bounds(0, 0, A_.width());
+        shift_.set_bounds(0, 0, A_.width());
+        output.output_buffer()
+            .set_bounds(0, 0, A_.width()).set_bounds(1, 0, B_.height());
+
+        return output;
+    }
+};
+
+RegisterGenerator<QuantizedGEMMGenerator<uint8_t>>   register_u8gemm("u8gemm");
+RegisterGenerator<QuantizedGEMMGenerator<int8_t>>    register_s8gemm("s8gemm");
+RegisterGenerator<RequantizedGEMMGenerator<uint8_t>> register_u8gemm_requantized("u8gemm_requantized");
+RegisterGenerator<RequantizedGEMMGenerator<int8_t>>  register_s8gemm_requantized("s8gemm_requantized");
+
+}  // namespace
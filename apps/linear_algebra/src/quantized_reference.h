@@ -0,0 +1,54 @@
+#ifndef QUANTIZED_REFERENCE_H
+#define QUANTIZED_REFERENCE_H
+
+// Straightforward implementations of the 8-bit gemm kernels, with the
+// same semantics as gemmlowp's reference implementation. These are
+// what the tests check the kernels against, and the baseline for the
+// benchmarks. All matrices are column-major and dense, A is M x K, B
+// is K x N, and the bias, multiplier and shift have one entry per row.
+
+#include <stdint.h>
+#include <algorithm>
+#include <limits>
+
+template<typename T>
+void reference_quantized_gemm(int M, int N, int K,
+                              int32_t a_offset, const T *A,
+                              int32_t b_offset, const T *B,
+                              const int32_t *bias, int32_t *C) {
+    #pragma omp parallel for
+    for (int j = 0; j < N; j++) {
+        for (int i = 0; i < M; i++) {
+            int32_t acc = bias[i];
+            for (int k = 0; k < K; k++) {
+                acc += ((int32_t)A[i + k * M] - a_offset) * ((int32_t)B[k + j * K] - b_offset);
+            }
+            C[i + j * M] = acc;
+        }
+    }
+}
+
+template<typename T>
+void reference_requantized_gemm(int M, int N, int K,
+                                int32_t a_offset, const T *A,
+                                int32_t b_offset, const T *B,
+                                const int32_t *bias, const int32_t *multiplier,
+                                const int32_t *shift, int32_t c_offset, T *C) {
+    #pragma omp parallel for
+    for (int j = 0; j < N; j++) {
+        for (int i = 0; i < M; i++) {
+            int32_t acc = bias[i];
+            for (int k = 0; k < K; k++) {
+                acc += ((int32_t)A[i + k * M] - a_offset) * ((int32_t)B[k + j * K] - b_offset);
+            }
+            int s = 31 + shift[i];
+            int64_t scaled = ((int64_t)acc * multiplier[i] + ((int64_t)1 << (s - 1))) >> s;
+            int64_t result = c_offset + (int32_t)scaled;
+            result = std::max<int64_t>(result, std::numeric_limits<T>::min());
+            result = std::min<int64_t>(result, std::numeric_limits<T>::max());
+            C[i + j * M] = (T)result;
+        }
+    }
+}
+
+#endif  // QUANTIZED_REFERENCE_H
@@ -6,6 +6,7 @@
 #include <string>
 #include <cblas.h>
 #include <halide_blas.h>
+#include "quantized_reference.h"
 #include "Halide.h"
 
 #define RUN_TEST(method)                                                \
@@ -112,6 +113,33 @@
         return compareMatrices(N, eC, aC);      \
     }
 
+#define L3_BATCHED_TEST(method, cblas_code, hblas_code) \
+    bool test_##method(int N) {                         \
+        const int batch = 5;                            \
+        Scalar alpha = random_scalar();                 \
+        Scalar beta = random_scalar();                  \
+        Matrix eA(random_matrix(N, batch));             \
+        Matrix eB(random_matrix(N, batch));             \
+        Matrix eC(random_matrix(N, batch));             \
+        Matrix aA(eA), aB(eB), aC(eC);                  \
+                                                        \
+        for (int i = 0; i < batch; ++i) {               \
+            Scalar *A = &(eA[i * N * N]);               \
+            Scalar *B = &(eB[i * N * N]);               \
+            Scalar *C = &(eC[i * N * N]);               \
+            cblas_code;                                 \
+        }                                               \
+                                                        \
+        {                                               \
+            Scalar *A = &(aA[0]);                       \
+            Scalar *B = &(aB[0]);                       \
+            Scalar *C = &(aC[0]);                       \
+            hblas_code;                                 \
+        }                                               \
+                                                        \
+        return compareMatrices(N, eC, aC, batch);       \
+    }
+
 
 template<class T>
 struct BLASTestBase {
@@ -137,9 +165,9 @@ struct BLASTestBase {
         return buff;
     }
 
-    Matrix random_matrix(int N) {
-        Matrix buff(N * N);
-        for (int i=0; i<N*N; ++i) {
+    Matrix random_matrix(int N, int batch = 1) {
+        Matrix buff(N * N * batch);
+        for (int i=0; i<N*N*batch; ++i) {
             buff[i] = random_scalar();
         }
         return buff;
@@ -183,12 +211,12 @@ struct BLASTestBase {
         return equal;
     }
 
-    bool compareMatrices(int N, const Matrix &A, const Matrix &B,
+    bool compareMatrices(int N, const Matrix &A, const Matrix &B, int batch = 1,
                          Scalar epsilon = 16 * std::numeric_limits<Scalar>::epsilon()) {
         bool equal = true;
-        for (int i = 0; i < N*N; ++i) {
+        for (int i = 0; i < N*N*batch; ++i) {
             if (!compareScalars(A[i], B[i], epsilon)) {
-                std::cerr << "Matrices differ at coords: (" << i%N << ", " << i/N << ")\n";
+                std::cerr << "Matrices differ at coords: (" << i%N << ", " << (i/N)%N << ", " << i/(N*N) << ")\n";
                 equal = false;
                 break;
             }
@@ -211,6 +239,10 @@ struct BLASFloatTests : public BLASTestBase<float> {
         RUN_TEST(sgemm_transA);
         RUN_TEST(sgemm_transB);
         RUN_TEST(sgemm_transAB);
+        RUN_TEST(sgemm_batched_notrans);
+        RUN_TEST(sgemm_batched_transA);
+        RUN_TEST(sgemm_batched_transB);
+        RUN_TEST(sgemm_batched_transAB);
     }
 
     L1_VECTOR_TEST(scopy, scopy(N, x, 1, y, 1))
@@ -242,6 +274,22 @@ struct BLASFloatTests : public BLASTestBase<float> {
     L3_TEST(sgemm_transAB,
             cblas_sgemm(CblasColMajor, CblasTrans, CblasTrans, N, N, N, alpha, A, N, B, N, beta, C, N),
             hblas_sgemm(HblasColMajor, HblasTrans, HblasTrans, N, N, N, alpha, A, N, B, N, beta, C, N));
+    L3_BATCHED_TEST(sgemm_batched_notrans,
+            cblas_sgemm(CblasColMajor, CblasNoTrans, CblasNoTrans, N, N, N, alpha, A, N, B, N, beta, C, N),
+            hblas_sgemm_strided_batched(HblasColMajor, HblasNoTrans, HblasNoTrans, N, N, N, alpha, A, N, N * N,
+                                         B, N, N * N, beta, C, N, N * N, batch));
+    L3_BATCHED_TEST(sgemm_batched_transA,
+            cblas_sgemm(CblasColMajor, CblasTrans, CblasNoTrans, N, N, N, alpha, A, N, B, N, beta, C, N),
+            hblas_sgemm_strided_batched(HblasColMajor, HblasTrans, HblasNoTrans, N, N, N, alpha, A, N, N * N,
+                                         B, N, N * N, beta, C, N, N * N, batch));
+    L3_BATCHED_TEST(sgemm_batched_transB,
+            cblas_sgemm(CblasColMajor, CblasNoTrans, CblasTrans, N, N, N, alpha, A, N, B, N, beta, C, N),
+            hblas_sgemm_strided_batched(HblasColMajor, HblasNoTrans, HblasTrans, N, N, N, alpha, A, N, N * N,
+                                         B, N, N * N, beta, C, N, N * N, batch));
+    L3_BATCHED_TEST(sgemm_batched_transAB,
+            cblas_sgemm(CblasColMajor, CblasTrans, CblasTrans, N, N, N, alpha, A, N, B, N, beta, C, N),
+            hblas_sgemm_strided_batched(HblasColMajor, HblasTrans, HblasTrans, N, N, N, alpha, A, N, N * N,
+                                         B, N, N * N, beta, C, N, N * N, batch));
 };
 
 struct BLASDoubleTests : public BLASTestBase<double> {
@@ -258,6 +306,10 @@ struct BLASDoubleTests : public BLASTestBase<double> {
         RUN_TEST(dgemm_transA);
         RUN_TEST(dgemm_transB);
         RUN_TEST(dgemm_transAB);
+        RUN_TEST(dgemm_batched_notrans);
+        RUN_TEST(dgemm_batched_transA);
+        RUN_TEST(dgemm_batched_transB);
+        RUN_TEST(dgemm_batched_transAB);
     }
 
     L1_VECTOR_TEST(dcopy, dcopy(N, x, 1, y, 1))
@@ -289,11 +341,116 @@ struct BLASDoubleTests : public BLASTestBase<double> {
     L3_TEST(dgemm_transAB,
             cblas_dgemm(CblasColMajor, CblasTrans, CblasTrans, N, N, N, alpha, A, N, B, N, beta, C, N),
             hblas_dgemm(HblasColMajor, HblasTrans, HblasTrans, N, N, N, alpha, A, N, B, N, beta, C, N));
+    L3_BATCHED_TEST(dgemm_batched_notrans,
+            cblas_dgemm(CblasColMajor, CblasNoTrans, CblasNoTrans, N, N, N, alpha, A, N, B, N, beta, C, N),
+            hblas_dgemm_strided_batched(HblasColMajor, HblasNoTrans, HblasNoTrans, N, N, N, alpha, A, N, N * N,
+                                         B, N, N * N, beta, C, N, N * N, batch));
+    L3_BATCHED_TEST(dgemm_batched_transA,
+            cblas_dgemm(CblasColMajor, CblasTrans, CblasNoTrans, N, N, N, alpha, A, N, B, N, beta, C, N),
+            hblas_dgemm_strided_batched(HblasColMajor, HblasTrans, HblasNoTrans, N, N, N, alpha, A, N, N * N,
+                                         B, N, N * N, beta, C, N, N * N, batch));
+    L3_BATCHED_TEST(dgemm_batched_transB,
+            cblas_dgemm(CblasColMajor, CblasNoTrans, CblasTrans, N, N, N, alpha, A, N, B, N, beta, C, N),
+            hblas_dgemm_strided_batched(HblasColMajor, HblasNoTrans, HblasTrans, N, N, N, alpha, A, N, N * N,
+                                         B, N, N * N, beta, C, N, N * N, batch));
+    L3_BATCHED_TEST(dgemm_batched_transAB,
+            cblas_dgemm(CblasColMajor, CblasTrans, CblasTrans, N, N, N, alpha, A, N, B, N, beta, C, N),
+            hblas_dgemm_strided_batched(HblasColMajor, HblasTrans, HblasTrans, N, N, N, alpha, A, N, N * N,
+                                         B, N, N * N, beta, C, N, N * N, batch));
+};
+
+// Checks the 8-bit gemm kernels against the reference
+// implementation, with a sum size that is not a multiple of four.
+struct QuantizedTests {
+    std::random_device rand_dev;
+    std::default_random_engine rand_eng;
+
+    QuantizedTests() : rand_eng(rand_dev()) {}
+
+    template<typename T>
+    Halide::Runtime::Buffer<T> random_matrix(int M, int N) {
+        std::uniform_int_distribution<int> uniform_dist(std::numeric_limits<T>::min(),
+                                                        std::numeric_limits<T>::max());
+        Halide::Runtime::Buffer<T> buff(M, N);
+        buff.for_each_value([&](T &x) { x = (T)uniform_dist(rand_eng); });
+        return buff;
+    }
+
+    template<typename T>
+    bool compare(const Halide::Runtime::Buffer<T> &expected, const Halide::Runtime::Buffer<T> &actual) {
+        bool equal = true;
+        expected.for_each_element([&](int i, int j) {
+            if (equal && expected(i, j) != actual(i, j)) {
+                std::cerr << "Matrices differ at coords: (" << i << ", " << j << "): "
+                          << (int64_t)expected(i, j) << " vs " << (int64_t)actual(i, j) << "\n";
+                equal = false;
+            }
+        });
+        return equal;
+    }
+
+    template<typename T>
+    bool test_gemm(int N, int (*halide_gemm)(int32_t, buffer_t *, int32_t, buffer_t *,
+                                             buffer_t *, buffer_t *)) {
+        const int K = N - 1;
+        const int32_t a_offset = 3, b_offset = -5;
+        auto A = random_matrix<T>(N, K);
+        auto B = random_matrix<T>(K, N);
+        Halide::Runtime::Buffer<int32_t> bias(N), expected(N, N), actual(N, N);
+        for (int i = 0; i < N; i++) {
+            bias(i) = i * 17 - 1000;
+        }
+
+        reference_quantized_gemm(N, N, K, a_offset, A.data(), b_offset, B.data(),
+                                 bias.data(), expected.data());
+        halide_gemm(a_offset, A.raw_buffer(), b_offset, B.raw_buffer(),
+                    bias.raw_buffer(), actual.raw_buffer());
+        return compare(expected, actual);
+    }
+
+    template<typename T>
+    bool test_requantized_gemm(int N, int (*halide_gemm)(int32_t, buffer_t *, int32_t, buffer_t *,
+                                                         buffer_t *, buffer_t *, buffer_t *,
+                                                         int32_t, buffer_t *)) {
+        const int K = N - 1;
+        const int32_t a_offset = 3, b_offset = -5, c_offset = 10;
+        auto A = random_matrix<T>(N, K);
+        auto B = random_matrix<T>(K, N);
+        Halide::Runtime::Buffer<int32_t> bias(N), multiplier(N), shift(N);
+        std::uniform_int_distribution<int32_t> multiplier_dist(1 << 30, std::numeric_limits<int32_t>::max());
+        for (int i = 0; i < N; i++) {
+            bias(i) = i * 17 - 1000;
+            multiplier(i) = multiplier_dist(rand_eng);
+            shift(i) = 8 + i % 8;
+        }
+        Halide::Runtime::Buffer<T> expected(N, N), actual(N, N);
+
+        reference_requantized_gemm(N, N, K, a_offset, A.data(), b_offset, B.data(),
+                                   bias.data(), multiplier.data(), shift.data(),
+                                   c_offset, expected.data());
+        halide_gemm(a_offset, A.raw_buffer(), b_offset, B.raw_buffer(),
+                    bias.raw_buffer(), multiplier.raw_buffer(), shift.raw_buffer(),
+                    c_offset, actual.raw_buffer());
+        return compare(expected, actual);
+    }
+
+    bool test_u8gemm(int N) { return test_gemm<uint8_t>(N, halide_u8gemm); }
+    bool test_s8gemm(int N) { return test_gemm<int8_t>(N, halide_s8gemm); }
+    bool test_u8gemm_requantized(int N) { return test_requantized_gemm<uint8_t>(N, halide_u8gemm_requantized); }
+    bool test_s8gemm_requantized(int N) { return test_requantized_gemm<int8_t>(N, halide_s8gemm_requantized); }
+
+    void run_tests(int N) {
+        RUN_TEST(u8gemm);
+        RUN_TEST(s8gemm);
+        RUN_TEST(u8gemm_requantized);
+        RUN_TEST(s8gemm_requantized);
+    }
 };
 
 int main(int argc, char *argv[]) {
     BLASFloatTests  s;
     BLASDoubleTests d;
+    QuantizedTests  q;
 
 
     if (argc > 1) {
@@ -302,11 +459,13 @@ int main(int argc, char *argv[]) {
             std::cout << "Testing halide_blas with N = " << size << ":\n";
             s.run_tests(size);
             d.run_tests(size);
+            q.run_tests(size);
         }
     } else {
         int size = 64 * 7;
         std::cout << "Testing halide_blas with N = " << size << ":\n";
         s.run_tests(size);
         d.run_tests(size);
+        q.run_tests(size);
     }
 }
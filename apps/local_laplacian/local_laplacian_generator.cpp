@@ -94,7 +94,11 @@ public:
         if (get_target().has_gpu_feature()) {
             // gpu schedule
             Var xi, yi;
-            output.compute_root().gpu_tile(x, y, xi, yi, 16, 8);
+            output.compute_root().reorder(c, x, y).bound(c, 0, 3).unroll(c)
+                .gpu_tile(x, y, xi, yi, 16, 8);
+            // The luminance is read by every level of the processed
+            // pyramid, so compute it once rather than once per level.
+            gray.compute_root().gpu_tile(x, y, xi, yi, 16, 8);
             for (int j = 0; j < J; j++) {
                 int blockw = 16, blockh = 8;
                 if (j > 3) {
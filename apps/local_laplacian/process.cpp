@@ -28,10 +28,14 @@ int main(int argc, char **argv) {
         local_laplacian(input, levels, alpha/(levels-1), beta, output);
     });
     printf("%gus\n", best * 1e6);
+    // The bandwidth counts reading the input and writing the output once.
+    printf("%gms/frame, %gGB/s\n", best * 1e3,
+           (input.size_in_bytes() + output.size_in_bytes()) / best * 1e-9);
 
 
     local_laplacian(input, levels, alpha/(levels-1), beta, output);
 
+    output.copy_to_host();
     save_image(output, argv[6]);
 
     return 0;
@@ -0,0 +1,51 @@
+#include <cstdio>
+#include <cstdlib>
+
+#include "resize_uint8.h"
+#include "resize_uint16.h"
+#include "resize_float32.h"
+
+#include "benchmark.h"
+#include "HalideBuffer.h"
+#include "halide_image_io.h"
+
+using namespace Halide::Runtime;
+using namespace Halide::Tools;
+
+template<typename T>
+double time_resize(int (*resize)(buffer_t *, float, float, buffer_t *),
+                   const char *name, Buffer<T> input, Buffer<T> &output,
+                   float scale, int timing_iterations) {
+    output = Buffer<T>((int)(input.width() * scale), (int)(input.height() * scale),
+                       input.channels());
+    double best = benchmark(timing_iterations, 1, [&]() {
+        resize(input, scale, scale, output);
+    });
+    printf("%8s: %gms\n", name, best * 1e3);
+    return best;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 5) {
+        printf("Usage: ./process input.png scale timing_iterations output.png\n"
+               "e.g.: ./process input.png 0.25 10 output.png\n");
+        return 0;
+    }
+
+    float scale = atof(argv[2]);
+    int timing_iterations = atoi(argv[3]);
+
+    Buffer<uint8_t> output_u8;
+    Buffer<uint16_t> output_u16;
+    Buffer<float> output_f32;
+    time_resize<uint8_t>(resize_uint8, "uint8", load_image(argv[1]), output_u8,
+                         scale, timing_iterations);
+    time_resize<uint16_t>(resize_uint16, "uint16", load_image(argv[1]), output_u16,
+                          scale, timing_iterations);
+    time_resize<float>(resize_float32, "float32", load_image(argv[1]), output_f32,
+                       scale, timing_iterations);
+
+    save_image(output_u8, argv[4]);
+
+    return 0;
+}
@@ -0,0 +1,212 @@
+#include "Halide.h"
+
+using namespace Halide;
+
+namespace {
+
+enum class InterpolationType {
+    Box, Linear, Cubic, Lanczos
+};
+
+Expr kernel_box(Expr x) {
+    Expr xx = abs(x);
+    return select(xx <= 0.5f, 1.0f, 0.0f);
+}
+
+Expr kernel_linear(Expr x) {
+    Expr xx = abs(x);
+    return select(xx < 1.0f, 1.0f - xx, 0.0f);
+}
+
+Expr kernel_cubic(Expr x) {
+    Expr xx = abs(x);
+    Expr xx2 = xx * xx;
+    Expr xx3 = xx2 * xx;
+    float a = -0.5f;
+
+    return select(xx < 1.0f, (a + 2.0f) * xx3 - (a + 3.0f) * xx2 + 1,
+                  select (xx < 2.0f, a * xx3 - 5 * a * xx2 + 8 * a * xx - 4.0f * a,
+                          0.0f));
+}
+
+Expr sinc(Expr x) {
+    return sin(float(M_PI) * x) / x;
+}
+
+Expr kernel_lanczos(Expr x) {
+    Expr value = sinc(x) * sinc(x/3);
+    value = select(x == 0.0f, 1.0f, value); // Take care of singularity at zero
+    value = select(x > 3 || x < -3, 0.0f, value); // Clamp to zero out of bounds
+    return value;
+}
+
+struct KernelInfo {
+    const char *name;
+    float size;
+    Expr (*kernel)(Expr);
+};
+
+const KernelInfo kernel_info[] = {
+    { "box", 0.5f, kernel_box },
+    { "linear", 1.0f, kernel_linear },
+    { "cubic", 2.0f, kernel_cubic },
+    { "lanczos", 3.0f, kernel_lanczos }
+};
+
+// A separable resampling of a planar image by an arbitrary scale
+// factor in each dimension. This is the same algorithm as resize.cpp,
+// but the weights of the taps for each output column and row are
+// computed once into tables, rather than per pixel. 8 and 16-bit
+// images are resampled in fixed point.
+class Resize : public Halide::Generator<Resize> {
+public:
+    GeneratorParam<InterpolationType> interpolation_type{"interpolation_type", InterpolationType::Cubic,
+        {{"box", InterpolationType::Box},
+         {"linear", InterpolationType::Linear},
+         {"cubic", InterpolationType::Cubic},
+         {"lanczos", InterpolationType::Lanczos}}};
+    // The type of the input and output: uint8, uint16 or float32.
+    GeneratorParam<Type> input_type{"input_type", UInt(8)};
+
+    ImageParam input{UInt(8), 3, "input"};
+    Param<float> scale_x{"scale_x", 1.0f};
+    Param<float> scale_y{"scale_y", 1.0f};
+
+    Func build() {
+        input = ImageParam(input_type, input.dimensions(), input.name());
+        const Type t = input_type;
+        user_assert(t == UInt(8) || t == UInt(16) || t == Float(32))
+            << "Unsupported input_type " << t << "\n";
+
+        // The number of fractional bits of the weights, and of the
+        // horizontally resampled image, and its type. These are chosen
+        // so the sums of the products can't overflow 32 bits, even with
+        // the negative lobes of the cubic and Lanczos kernels.
+        int weight_bits = 0, intermediate_bits = 0;
+        Type intermediate_type = Float(32);
+        if (t == UInt(8)) {
+            weight_bits = 14;
+            intermediate_bits = 6;
+            intermediate_type = Int(16);
+        } else if (t == UInt(16)) {
+            weight_bits = 12;
+            intermediate_bits = 1;
+            intermediate_type = Int(32);
+        }
+        const Type accumulator_type = t.is_float() ? Float(32) : Int(32);
+
+        Func clamped = BoundaryConditions::repeat_edge(input);
+
+        Expr begin_x, taps_x, begin_y, taps_y;
+        Func weights_x("weights_x"), weights_y("weights_y");
+        make_taps(x, scale_x, weight_bits, weights_x, begin_x, taps_x);
+        make_taps(y, scale_y, weight_bits, weights_y, begin_y, taps_y);
+
+        // Resample the rows.
+        RDom rx(0, taps_x, "rx");
+        Func sum_x("sum_x"), resized_x("resized_x");
+        sum_x(x, y, c) = cast(accumulator_type, 0);
+        sum_x(x, y, c) += (cast(accumulator_type, weights_x(x, rx)) *
+                           cast(accumulator_type, clamped(begin_x + rx, y, c)));
+        resized_x(x, y, c) = round_shift(sum_x(x, y, c), weight_bits - intermediate_bits,
+                                         intermediate_type);
+
+        // Resample the columns.
+        RDom ry(0, taps_y, "ry");
+        Func sum_y("sum_y");
+        sum_y(x, y, c) = cast(accumulator_type, 0);
+        sum_y(x, y, c) += (cast(accumulator_type, weights_y(y, ry)) *
+                           cast(accumulator_type, resized_x(x, begin_y + ry, c)));
+
+        Func output("resize");
+        output(x, y, c) = round_shift(sum_y(x, y, c), weight_bits + intermediate_bits, t);
+
+        /* THE SCHEDULE */
+        int vec = natural_vector_size(intermediate_type);
+        if (get_target().has_feature(Target::HVX_64)) {
+            vec = 64 / intermediate_type.bytes();
+        } else if (get_target().has_feature(Target::HVX_128)) {
+            vec = 128 / intermediate_type.bytes();
+        }
+
+        // Compute strips of the output in parallel. The rows of the
+        // input each strip needs are resampled horizontally per strip.
+        Var yo("yo"), yi("yi");
+        output
+            .split(y, yo, yi, 32, TailStrategy::GuardWithIf)
+            .fuse(yo, c, yo)
+            .vectorize(x, vec, TailStrategy::GuardWithIf)
+            .parallel(yo);
+        sum_y.compute_at(output, x)
+            .vectorize(x, vec)
+            .update()
+            .reorder(x, ry)
+            .vectorize(x, vec);
+
+        resized_x.compute_at(output, yo)
+            .vectorize(x, vec);
+        sum_x.compute_at(resized_x, x)
+            .vectorize(x, vec)
+            .update()
+            .reorder(x, rx)
+            .vectorize(x, vec);
+
+        if (get_target().features_any_of({Target::HVX_64, Target::HVX_128})) {
+            output.hexagon();
+        }
+
+        return output;
+    }
+
+private:
+    Var x{"x"}, y{"y"}, c{"c"}, k{"k"};
+
+    // Round x from fixed point with the given number of fractional
+    // bits, and cast it to t. Floats are only cast.
+    Expr round_shift(Expr x, int bits, Type t) {
+        if (t.is_float() || bits == 0) {
+            return saturating_cast(t, x);
+        }
+        return saturating_cast(t, (x + (1 << (bits - 1))) >> bits);
+    }
+
+    // Output coordinate v is a weighted sum of the taps input
+    // coordinates starting at begin. Make a table of the weights, in
+    // fixed point with the given number of fractional bits if bits is
+    // not zero.
+    void make_taps(Var v, Expr scale, int bits,
+                   Func weights, Expr &begin, Expr &taps) {
+        const KernelInfo &info = kernel_info[(int)(InterpolationType)interpolation_type];
+
+        // For downscaling, widen the interpolation kernel to perform
+        // lowpass filtering.
+        Expr kernel_scaling = min(scale, 1.0f);
+        Expr kernel_size = info.size / kernel_scaling;
+        taps = cast<int>(2.0f * kernel_size) + 1;
+
+        // The (non-integer) coordinate inside the source image.
+        Expr source = (v + 0.5f) / scale;
+        begin = cast<int>(floor(source - kernel_size + 0.5f));
+
+        Func unnormalized("unnormalized_" + v.name());
+        unnormalized(v, k) = info.kernel((k + begin - source) * kernel_scaling);
+
+        RDom r(0, taps);
+        Func total("total_" + v.name());
+        total(v) += unnormalized(v, r);
+
+        Expr w = unnormalized(v, k) / total(v);
+        if (bits != 0) {
+            w = cast<int16_t>(round(w * (1 << bits)));
+        }
+        weights(v, k) = w;
+
+        weights.compute_root()
+            .vectorize(v, natural_vector_size<float>(), TailStrategy::GuardWithIf);
+        total.compute_at(weights, v);
+    }
+};
+
+Halide::RegisterGenerator<Resize> register_me{"resize"};
+
+}  // namespace
@@ -0,0 +1,193 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <map>
+#include <string>
+#include "HalideRuntime.h"
+#include "benchmark.h"
+#include "benchmark_headers.h"
+
+// Times each of the vector ops generated by simd_op_check, and some
+// representative kernels, and prints the results as csv:
+//
+//   name,target,seconds
+//
+// Given the output of a previous run (e.g. with the last Halide
+// release) as a baseline, it adds the baseline time and the ratio to
+// each line, and fails if anything got slower by more than the
+// threshold (10% by default):
+//
+//   ./benchmark-host > baseline.csv
+//   (rebuild Halide and this driver)
+//   ./benchmark-host baseline.csv 0.1
+
+extern "C" void *memalign(size_t alignment, size_t size);
+
+struct bench {
+    const char *name;
+    int (*fn)(buffer_t *, // float32
+              buffer_t *, // float64
+              buffer_t *, // int8
+              buffer_t *, // uint8
+              buffer_t *, // int16
+              buffer_t *, // uint16
+              buffer_t *, // int32
+              buffer_t *, // uint32
+              buffer_t *, // int64
+              buffer_t *, // uint64
+              buffer_t *); // output
+    const halide_filter_metadata_t *(*metadata)();
+    // The size of the output, or zero for the size of the ops in
+    // simd_op_check.
+    int width, height;
+};
+
+template<typename T>
+T rand_value() {
+    return (T)(rand() * 0.125) - 100;
+}
+
+// Even on android, we want errors to stdout
+extern "C" void halide_print(void *, const char *msg) {
+    printf("%s\n", msg);
+}
+
+buffer_t make_buffer(int w, int h, int elem_size) {
+    buffer_t buf = {0};
+    buf.host = (uint8_t *)memalign(128, w*h*elem_size);
+    buf.extent[0] = w;
+    buf.extent[1] = h;
+    buf.elem_size = elem_size;
+    buf.stride[0] = 1;
+    buf.stride[1] = w;
+    return buf;
+}
+
+template<typename T>
+buffer_t make_input(int w, int h) {
+    buffer_t buf = make_buffer(w, h, sizeof(T));
+    T *mem = (T *)buf.host;
+    for (int i = 0; i < w*h; i++) {
+        mem[i] = rand_value<T>();
+    }
+    return buf;
+}
+
+void free_buffer(buffer_t *buf) {
+    if (buf->dev) {
+        halide_device_free(NULL, buf);
+    }
+    free(buf->host);
+}
+
+int output_elem_size(const halide_filter_metadata_t *md) {
+    for (int i = 0; i < md->num_arguments; i++) {
+        const halide_filter_argument_t &arg = md->arguments[i];
+        if (arg.kind == halide_argument_kind_output_buffer) {
+            return (arg.type.bits + 7) / 8;
+        }
+    }
+    return 0;
+}
+
+#include "benchmarks.h"
+#include "kernels.h"
+
+// Read the times from the csv output of a previous run.
+std::map<std::string, double> read_baseline(const char *filename) {
+    std::map<std::string, double> times;
+    FILE *f = fopen(filename, "r");
+    if (!f) {
+        printf("Could not open %s\n", filename);
+        exit(-1);
+    }
+    char line[1024], name[1024];
+    double seconds;
+    while (fgets(line, sizeof(line), f)) {
+        if (sscanf(line, "%1023[^,],%*[^,],%lf", name, &seconds) == 2) {
+            times[name] = seconds;
+        }
+    }
+    fclose(f);
+    return times;
+}
+
+int main(int argc, char **argv) {
+    // The size of the ops in simd_op_check, and of their inputs.
+    const int W = 256*3, H = 128;
+    const int in_w = W*4 + H, in_h = H + 8;
+
+    std::map<std::string, double> baseline;
+    if (argc > 1) {
+        baseline = read_baseline(argv[1]);
+    }
+    double threshold = argc > 2 ? atof(argv[2]) : 0.1;
+
+    buffer_t bufs[] = {
+        make_input<float>(in_w, in_h),
+        make_input<double>(in_w, in_h),
+        make_input<int8_t>(in_w, in_h),
+        make_input<uint8_t>(in_w, in_h),
+        make_input<int16_t>(in_w, in_h),
+        make_input<uint16_t>(in_w, in_h),
+        make_input<int32_t>(in_w, in_h),
+        make_input<uint32_t>(in_w, in_h),
+        make_input<int64_t>(in_w, in_h),
+        make_input<uint64_t>(in_w, in_h)
+    };
+
+    int regressions = 0;
+    for (bench *list : {benchmarks, kernels}) {
+        for (int i = 0; list[i].fn; i++) {
+            bench b = list[i];
+            int w = b.width ? b.width : W;
+            int h = b.height ? b.height : H;
+            buffer_t out = make_buffer(w, h, output_elem_size(b.metadata()));
+
+            int error = 0;
+            double t = benchmark(10, 10, [&]() {
+                    error |= b.fn(bufs + 0,
+                                  bufs + 1,
+                                  bufs + 2,
+                                  bufs + 3,
+                                  bufs + 4,
+                                  bufs + 5,
+                                  bufs + 6,
+                                  bufs + 7,
+                                  bufs + 8,
+                                  bufs + 9,
+                                  &out);
+                    if (out.dev) {
+                        error |= halide_device_sync(NULL, &out);
+                    }
+                });
+            free_buffer(&out);
+            if (error) {
+                printf("Error: %s returned %d\n", b.name, error);
+                return -1;
+            }
+
+            printf("%s,%s,%g", b.name, b.metadata()->target, t);
+            auto it = baseline.find(b.name);
+            if (it != baseline.end()) {
+                double ratio = t / it->second;
+                printf(",%g,%g", it->second, ratio);
+                if (ratio > 1 + threshold) {
+                    regressions++;
+                }
+            }
+            printf("\n");
+        }
+    }
+
+    for (int i = 0; i < (int)(sizeof(bufs)/sizeof(buffer_t)); i++) {
+        free_buffer(bufs + i);
+    }
+
+    if (regressions) {
+        printf("Error: %d benchmarks are more than %g%% slower than the baseline\n",
+               regressions, threshold * 100);
+        return -1;
+    }
+    return 0;
+}
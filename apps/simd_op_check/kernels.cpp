@@ -0,0 +1,125 @@
+#include "Halide.h"
+#include <stdio.h>
+#include <fstream>
+
+using namespace Halide;
+using namespace Halide::ConciseCasts;
+
+// Compiles a few representative kernels for HL_TARGET, for the
+// benchmark driver to time alongside the individual ops from
+// simd_op_check. They all take the same ten input buffers as the ops,
+// and kernels.h lists them along with the size of their
+// outputs. They're deliberately single-threaded, so that they measure
+// the code we generate rather than the thread pool.
+
+Var x("x"), y("y"), xi("xi"), yi("yi");
+
+ImageParam in_f32, in_f64, in_i8, in_u8, in_i16, in_u16, in_i32, in_u32, in_i64, in_u64;
+
+Target target;
+
+std::ofstream table;
+
+void schedule(Func f, int vector_width) {
+    if (target.has_gpu_feature()) {
+        f.gpu_tile(x, y, xi, yi, 16, 16);
+    } else {
+        f.vectorize(x, vector_width);
+    }
+}
+
+void emit(Func f, int width, int height) {
+    std::vector<Argument> args {in_f32, in_f64, in_i8, in_u8, in_i16, in_u16, in_i32, in_u32, in_i64, in_u64};
+    f.bound(x, 0, width).bound(y, 0, height);
+    f.compile_to_file(f.name(), args, f.name(), target);
+    table << "{\"" << f.name() << "\", &" << f.name() << ", &" << f.name() << "_metadata, " << width << ", " << height << "},\n";
+}
+
+// A 3x3 box filter, as in apps/blur.
+void blur() {
+    Func blur_x("blur_x"), blur_y("kernel_blur");
+    blur_x(x, y) = (in_u16(x, y) + in_u16(x+1, y) + in_u16(x+2, y))/3;
+    blur_y(x, y) = (blur_x(x, y) + blur_x(x, y+1) + blur_x(x, y+2))/3;
+
+    int vector_width = target.natural_vector_size(UInt(16));
+    if (!target.has_gpu_feature()) {
+        blur_y.split(y, y, yi, 8);
+        blur_x.store_at(blur_y, y).compute_at(blur_y, yi).vectorize(x, vector_width);
+    }
+    schedule(blur_y, vector_width);
+    emit(blur_y, 768, 128);
+}
+
+// A bilinear downsample by a factor of 3/4 in each dimension, in
+// fixed point.
+void resize() {
+    Func resize_x("resize_x"), resize_y("kernel_resize");
+    Expr sx = (x*3)/4, fx = u16((x*3)%4);
+    Expr sy = (y*3)/4, fy = u16((y*3)%4);
+    resize_x(x, y) = u16(in_u8(sx, y)) * (4 - fx) + u16(in_u8(sx+1, y)) * fx;
+    resize_y(x, y) = u8((resize_x(x, sy) * (4 - fy) + resize_x(x, sy+1) * fy + 8)/16);
+
+    int vector_width = target.natural_vector_size(UInt(8));
+    if (!target.has_gpu_feature()) {
+        resize_x.compute_at(resize_y, y).vectorize(x, vector_width);
+    }
+    schedule(resize_y, vector_width);
+    emit(resize_y, 768, 128);
+}
+
+// A 5x5 binomial convolution.
+void convolve() {
+    const int taps[] = {1, 4, 6, 4, 1};
+    Expr sum = u16(0);
+    for (int j = 0; j < 5; j++) {
+        for (int i = 0; i < 5; i++) {
+            sum += u16(in_u8(x+i, y+j)) * u16(taps[i] * taps[j]);
+        }
+    }
+    Func conv("kernel_convolve");
+    conv(x, y) = u8((sum + 128)/256);
+
+    schedule(conv, target.natural_vector_size(UInt(8)));
+    emit(conv, 768, 128);
+}
+
+// A transpose.
+void transpose() {
+    Func t("kernel_transpose");
+    t(x, y) = in_u16(y, x);
+
+    if (target.has_gpu_feature()) {
+        schedule(t, 0);
+    } else {
+        t.tile(x, y, xi, yi, 8, 8).vectorize(xi).unroll(yi);
+    }
+    emit(t, 128, 768);
+}
+
+int main(int argc, char **argv) {
+    target = get_target_from_environment();
+    target.set_features({Target::NoBoundsQuery, Target::NoAsserts, Target::NoRuntime});
+
+    in_f32 = ImageParam(Float(32), 2, "in_f32");
+    in_f64 = ImageParam(Float(64), 2, "in_f64");
+    in_i8  = ImageParam(Int(8), 2, "in_i8");
+    in_u8  = ImageParam(UInt(8), 2, "in_u8");
+    in_i16 = ImageParam(Int(16), 2, "in_i16");
+    in_u16 = ImageParam(UInt(16), 2, "in_u16");
+    in_i32 = ImageParam(Int(32), 2, "in_i32");
+    in_u32 = ImageParam(UInt(32), 2, "in_u32");
+    in_i64 = ImageParam(Int(64), 2, "in_i64");
+    in_u64 = ImageParam(UInt(64), 2, "in_u64");
+
+    table.open("kernels.h");
+    table << "bench kernels[] = {\n";
+    blur();
+    resize();
+    convolve();
+    transpose();
+    table << "{NULL, NULL, NULL, 0, 0}};\n";
+    table.close();
+
+    printf("Success!\n");
+    return 0;
+}
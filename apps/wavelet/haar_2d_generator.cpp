@@ -0,0 +1,63 @@
+#include "Halide.h"
+
+namespace {
+
+Halide::Var x("x"), y("y"), c("c");
+
+// An N-level 2D Haar transform. Level j of the output, bands[j], has
+// four channels: the lowpass image of the level in channel 0, and the
+// horizontal, vertical and diagonal detail in channels 1-3. Each level
+// is computed from channel 0 of the previous level, so each level only
+// reads a quarter of the data the one before it did.
+class haar_2d : public Halide::Generator<haar_2d> {
+public:
+    GeneratorParam<int> levels{"levels", 3, 1, 16};
+
+    Input<Buffer<float>> in_{ "in", 2 };
+
+    // bands[j] is (in.width() + 2^(j+1) - 1) >> (j+1) wide, and likewise
+    // for the height.
+    Output<Func[]> bands{ "bands", Float(32), 3 };
+
+    void generate() {
+        bands.resize(levels);
+
+        Func in = Halide::BoundaryConditions::repeat_edge(
+            in_, {{in_.dim(0).min(), in_.dim(0).extent()},
+                  {in_.dim(1).min(), in_.dim(1).extent()}});
+
+        Func lowpass = in;
+        for (int j = 0; j < levels; j++) {
+            Expr a00 = lowpass(2*x, 2*y), a10 = lowpass(2*x+1, 2*y);
+            Expr a01 = lowpass(2*x, 2*y+1), a11 = lowpass(2*x+1, 2*y+1);
+            bands[j](x, y, c) = select(c == 0, a00 + a10 + a01 + a11,
+                                       c == 1, a00 - a10 + a01 - a11,
+                                       c == 2, a00 + a10 - a01 - a11,
+                                               a00 - a10 - a01 + a11) / 4;
+
+            // The next level reads the lowpass image of this one,
+            // repeating the last row and column when it has an odd
+            // size.
+            Expr width = (in_.dim(0).extent() + (2 << j) - 1) >> (j + 1);
+            Expr height = (in_.dim(1).extent() + (2 << j) - 1) >> (j + 1);
+            Func next("lowpass_" + std::to_string(j + 1));
+            next(x, y) = bands[j](clamp(x, 0, width - 1), clamp(y, 0, height - 1), 0);
+            lowpass = next;
+        }
+    }
+
+    void schedule() {
+        const int v = natural_vector_size<float>();
+        for (Func b : bands) {
+            b.reorder(c, x, y)
+                .bound(c, 0, 4)
+                .unroll(c)
+                .parallel(y, 8);
+            b.specialize(b.output_buffer().width() >= v).vectorize(x, v);
+        }
+    }
+};
+
+Halide::RegisterGenerator<haar_2d> register_my_gen{"haar_2d"};
+
+}  // namespace
@@ -0,0 +1,63 @@
+#include "Halide.h"
+
+namespace {
+
+Halide::Var x("x"), y("y"), c("c"), yo("yo"), yi("yi");
+
+// The inverse of haar_2d. The number of levels is the size of the
+// bands array, set with the generator argument bands.size=N, which
+// must match the levels haar_2d was generated with. All of the levels are computed in strips of the output, with
+// each level's storage folded to the rows the next finer level needs,
+// so the only memory traffic is reading the bands and writing the
+// output.
+class inverse_haar_2d : public Halide::Generator<inverse_haar_2d> {
+public:
+    Input<Func[]> bands{ "bands", Float(32), 3 };
+
+    Output<Func> out{ "out", Float(32), 2 };
+
+    void generate() {
+        const int levels = bands.size();
+
+        Func lowpass("lowpass_" + std::to_string(levels));
+        lowpass(x, y) = bands[levels - 1](x, y, 0);
+        for (int j = levels - 1; j >= 0; j--) {
+            Expr sx = select(x % 2 == 0, 1.0f, -1.0f);
+            Expr sy = select(y % 2 == 0, 1.0f, -1.0f);
+            Expr xh = x / 2, yh = y / 2;
+            Func finer("lowpass_" + std::to_string(j));
+            finer(x, y) = (lowpass(xh, yh) +
+                           sx * bands[j](xh, yh, 1) +
+                           sy * bands[j](xh, yh, 2) +
+                           sx * sy * bands[j](xh, yh, 3));
+            if (j > 0) {
+                intermediates.push_back(finer);
+            }
+            lowpass = finer;
+        }
+
+        out(x, y) = lowpass(x, y);
+    }
+
+    void schedule() {
+        const int v = natural_vector_size<float>();
+        const int strip = std::max(32, 1 << (int)bands.size());
+        Func output = out;
+        output.split(y, yo, yi, strip, TailStrategy::GuardWithIf)
+            .parallel(yo)
+            .vectorize(x, v);
+        for (Func f : intermediates) {
+            f.store_at(output, yo)
+                .compute_at(output, yi)
+                .vectorize(x, v);
+        }
+    }
+
+private:
+    // The levels finer than the coarsest, other than the output.
+    std::vector<Func> intermediates;
+};
+
+Halide::RegisterGenerator<inverse_haar_2d> register_my_gen{"inverse_haar_2d"};
+
+}  // namespace
@@ -1,9 +1,13 @@
+#include <math.h>
 #include <stdio.h>
+#include <vector>
 
 #include "haar_x.h"
 #include "inverse_haar_x.h"
 #include "daubechies_x.h"
 #include "inverse_daubechies_x.h"
+#include "haar_2d.h"
+#include "inverse_haar_2d.h"
 
 #include "HalideBuffer.h"
 #include "halide_image_io.h"
@@ -11,6 +15,11 @@
 using namespace Halide::Runtime;
 using namespace Halide::Tools;
 
+// The number of levels haar_2d and inverse_haar_2d were generated with.
+#ifndef LEVELS
+#define LEVELS 3
+#endif
+
 namespace {
 
 void _assert(bool condition, const char* fmt, ...) {
@@ -74,6 +83,38 @@ int main(int argc, char **argv) {
     _assert(inverse_daubechies_x(transformed, inverse_transformed) == 0, "inverse_daubechies_x failed");
     save_untransformed(inverse_transformed, dirname + "/inverse_daubechies_x.png");
 
+    // The 2D transforms take a buffer per level, so call them via
+    // their argv entry points.
+    std::vector<Buffer<float>> bands;
+    for (int j = 1; j <= LEVELS; j++) {
+        bands.emplace_back((input.width() + (1 << j) - 1) >> j,
+                           (input.height() + (1 << j) - 1) >> j, 4);
+    }
+    std::vector<void *> args;
+    args.push_back(input.raw_buffer());
+    for (Buffer<float> &b : bands) {
+        args.push_back(b.raw_buffer());
+    }
+    _assert(haar_2d_argv(args.data()) == 0, "haar_2d failed");
+    Buffer<float> &coarsest = bands.back();
+    Buffer<float> lowpass(coarsest.width(), coarsest.height(), 1);
+    lowpass.for_each_element([&](int x, int y, int c) {
+        lowpass(x, y, c) = clamp(coarsest(x, y, 0), 0.0f, 1.0f);
+    });
+    save_untransformed(lowpass, dirname + "/haar_2d.png");
+
+    args.erase(args.begin());
+    args.push_back(inverse_transformed.raw_buffer());
+    _assert(inverse_haar_2d_argv(args.data()) == 0, "inverse_haar_2d failed");
+    save_untransformed(inverse_transformed, dirname + "/inverse_haar_2d.png");
+    for (int y = 0; y < input.height(); y++) {
+        for (int x = 0; x < input.width(); x++) {
+            _assert(fabs(inverse_transformed(x, y, 0) - input(x, y)) < 1e-4f,
+                    "inverse_haar_2d(%d, %d) = %f instead of %f\n",
+                    x, y, inverse_transformed(x, y, 0), input(x, y));
+        }
+    }
+
     printf("Done.\n");
     return 0;
 }
@@ -112,8 +112,8 @@ ndarray from_data_impl(void *data,
     ndarray r(python::detail::new_reference(PyArray_NewFromDescr(&PyArray_Type,
                                                                  incref_dtype(dt),
                                                                  shape.size(),
-                                                                 const_cast<Py_intptr_t *>(&shape.front()),
-                                                                 const_cast<Py_intptr_t *>(&strides.front()),
+                                                                 const_cast<Py_intptr_t *>(shape.data()),
+                                                                 const_cast<Py_intptr_t *>(strides.data()),
                                                                  data,
                                                                  flags,
                                                                  NULL)));
@@ -0,0 +1,230 @@
+#include "AOT.h"
+
+// to avoid compiler confusion, python.hpp must be include before Halide headers
+#include <boost/python.hpp>
+#include <boost/python/raw_function.hpp>
+
+#include "../../src/Buffer.h"
+#include "../../src/Error.h"
+#include "../../src/IR.h"
+#include "../../src/Type.h"
+#include "Image.h"
+#include "Type.h"
+
+#include <dlfcn.h>
+
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace h = Halide;
+namespace p = boost::python;
+
+namespace {
+
+class ScopedGILRelease {
+    PyThreadState *state;
+
+public:
+    ScopedGILRelease() : state(PyEval_SaveThread()) {}
+    ~ScopedGILRelease() {
+        PyEval_RestoreThread(state);
+    }
+};
+
+const char *argument_kind_name(int32_t kind) {
+    switch (kind) {
+    case halide_argument_kind_input_scalar:
+        return "input_scalar";
+    case halide_argument_kind_input_buffer:
+        return "input_buffer";
+    case halide_argument_kind_output_buffer:
+        return "output_buffer";
+    default:
+        return "unknown";
+    }
+}
+
+}  // namespace
+
+/// A pipeline compiled ahead of time (e.g. by a Generator, or with
+/// compile_to_file) into a shared library. It is called through the
+/// argv entry point, with the arguments its metadata describes, in the
+/// same order, so the library must have been compiled with C name
+/// mangling. A static library or object file can't be loaded, but can
+/// be linked into a shared library, or into the process, which is
+/// searched if the path is empty.
+class AOTPipeline {
+    std::shared_ptr<void> library;
+    const halide_filter_metadata_t *metadata;
+    int (*argv_fn)(void **);
+
+public:
+    AOTPipeline(const std::string &path, const std::string &function_name) {
+        void *handle = dlopen(path.empty() ? nullptr : path.c_str(), RTLD_NOW | RTLD_LOCAL);
+        if (!handle) {
+            throw std::invalid_argument("AOTPipeline could not load " + path + ": " + dlerror());
+        }
+        library = std::shared_ptr<void>(handle, dlclose);
+
+        typedef const halide_filter_metadata_t *(*metadata_fn_t)();
+        metadata_fn_t metadata_fn = (metadata_fn_t)dlsym(handle, (function_name + "_metadata").c_str());
+        argv_fn = (int (*)(void **))dlsym(handle, (function_name + "_argv").c_str());
+        if (!metadata_fn || !argv_fn) {
+            throw std::invalid_argument("AOTPipeline could not find " + function_name + "_metadata and " +
+                                        function_name + "_argv in " + (path.empty() ? "the process" : path) +
+                                        " (was it compiled with C name mangling?)");
+        }
+        metadata = metadata_fn();
+    }
+
+    std::string name() const {
+        return metadata->name;
+    }
+
+    std::string target() const {
+        return metadata->target;
+    }
+
+    /// (name, kind, dimensions, type) of each argument, in the order
+    /// they are passed.
+    p::list arguments() const {
+        p::list result;
+        for (int i = 0; i < metadata->num_arguments; i++) {
+            const halide_filter_argument_t &a = metadata->arguments[i];
+            result.append(p::make_tuple(std::string(a.name), std::string(argument_kind_name(a.kind)),
+                                        a.dimensions, h::Type(a.type)));
+        }
+        return result;
+    }
+
+    void call(p::tuple args, p::dict kwargs) const {
+        const int n = metadata->num_arguments;
+        if (p::len(args) > n) {
+            throw std::invalid_argument("AOTPipeline " + name() + " takes " + std::to_string(n) +
+                                        " arguments, but was called with " +
+                                        std::to_string(p::len(args)));
+        }
+
+        std::vector<h::Buffer<>> buffers(n);
+        std::vector<halide_scalar_value_t> scalars(n);
+        std::vector<void *> argv(n);
+        for (int i = 0; i < n; i++) {
+            const halide_filter_argument_t &a = metadata->arguments[i];
+            const std::string arg_name = a.name;
+            const h::Type t(a.type);
+
+            p::object value;
+            bool given = true;
+            if (i < p::len(args)) {
+                value = args[i];
+            } else if (kwargs.has_key(arg_name)) {
+                value = kwargs[arg_name];
+            } else {
+                given = false;
+            }
+
+            if (a.kind != halide_argument_kind_input_scalar) {
+                if (!given) {
+                    throw std::invalid_argument("AOTPipeline " + name() + " was not given buffer " + arg_name);
+                }
+                buffers[i] = python_object_or_ndarray_to_buffer(value);
+                if (buffers[i].type() != t || buffers[i].dimensions() != a.dimensions) {
+                    throw std::invalid_argument("AOTPipeline " + name() + " expects buffer " + arg_name +
+                                                " to have type " + type_repr(t) + " and " +
+                                                std::to_string(a.dimensions) + " dimensions");
+                }
+                argv[i] = buffers[i].raw_buffer();
+                continue;
+            }
+
+            halide_scalar_value_t &s = scalars[i];
+            s.u.u64 = 0;
+            if (!given || value.is_none()) {
+                if (a.def) {
+                    s = *a.def;
+                } else if (!t.is_handle()) {
+                    throw std::invalid_argument("AOTPipeline " + name() + " was not given scalar " + arg_name);
+                }
+            } else if (t.is_float()) {
+                double v = p::extract<double>(value);
+                if (t.bits() == 32) {
+                    s.u.f32 = (float)v;
+                } else {
+                    s.u.f64 = v;
+                }
+            } else if (t.is_bool()) {
+                s.u.b = p::extract<bool>(value);
+            } else if (t.is_int() || t.is_uint() || t.is_handle()) {
+                // Pass an integer the way the argument's type stores it,
+                // after checking that it fits.
+                long long v = p::extract<long long>(value);
+                if (!t.is_handle() &&
+                    ((t.is_int() && t.bits() < 64 && (v < t.min().as<h::Internal::IntImm>()->value ||
+                                                      v > t.max().as<h::Internal::IntImm>()->value)) ||
+                     (t.is_uint() && (v < 0 || (t.bits() < 64 && (uint64_t)v > t.max().as<h::Internal::UIntImm>()->value))))) {
+                    throw std::invalid_argument("AOTPipeline " + name() + " was given " + std::to_string(v) +
+                                                " for scalar " + arg_name + ", which doesn't fit in its type");
+                }
+                switch (t.bits()) {
+                case 8:
+                    s.u.u8 = (uint8_t)v;
+                    break;
+                case 16:
+                    s.u.u16 = (uint16_t)v;
+                    break;
+                case 32:
+                    s.u.u32 = (uint32_t)v;
+                    break;
+                default:
+                    s.u.u64 = (uint64_t)v;
+                    break;
+                }
+            } else {
+                throw std::invalid_argument("AOTPipeline " + name() + " can't pass scalar " + arg_name);
+            }
+            argv[i] = &s;
+        }
+
+        int result;
+        {
+            ScopedGILRelease release;
+            result = argv_fn(argv.data());
+        }
+        if (result != 0) {
+            throw std::runtime_error("AOTPipeline " + name() + " failed with error code " + std::to_string(result));
+        }
+    }
+};
+
+namespace {
+
+p::object aot_pipeline_call(p::tuple args, p::dict kwargs) {
+    const AOTPipeline &self = p::extract<const AOTPipeline &>(args[0]);
+    self.call(p::tuple(args.slice(1, p::_)), kwargs);
+    return p::object();
+}
+
+}  // namespace
+
+void defineAOT() {
+    p::class_<AOTPipeline>("AOTPipeline",
+                           "A pipeline compiled ahead of time into a shared library, "
+                           "loaded with its metadata, and called with numpy arrays, "
+                           "Buffers and scalars in the order of its arguments (or by name). "
+                           "Scalars that aren't given get their default values.",
+                           p::init<std::string, std::string>(p::args("self", "library", "function_name"),
+                                                             "Load the pipeline with the given function name from "
+                                                             "the shared library at the given path, or from the "
+                                                             "process if the path is empty."))
+        .def("name", &AOTPipeline::name, p::arg("self"),
+             "The function name of the pipeline.")
+        .def("target", &AOTPipeline::target, p::arg("self"),
+             "The target the pipeline was compiled for, as a string.")
+        .def("arguments", &AOTPipeline::arguments, p::arg("self"),
+             "A list of the (name, kind, dimensions, type) of each argument of the pipeline, "
+             "in order. The kind is 'input_scalar', 'input_buffer' or 'output_buffer'.")
+        .def("__call__", p::raw_function(aot_pipeline_call, 1),
+             "Run the pipeline, and raise an exception if it fails.");
+}
@@ -0,0 +1,6 @@
+#ifndef AOT_H
+#define AOT_H
+
+void defineAOT();
+
+#endif  // AOT_H
@@ -47,27 +47,49 @@ h::Realization python_object_to_realization(p::object obj) {
     return h::Realization(buffers);
 }
 
+// Releases the GIL for as long as it's in scope, so that other
+// Python threads can run while Halide compiles or runs a
+// pipeline. Nothing in the scope may touch Python objects.
+class ScopedGILRelease {
+    PyThreadState *state;
+
+public:
+    ScopedGILRelease() : state(PyEval_SaveThread()) {}
+    ~ScopedGILRelease() {
+        PyEval_RestoreThread(state);
+    }
+};
+
 template <typename... Args>
 p::object func_realize(h::Func &f, Args... args) {
-    return realization_to_python_object(f.realize(args...));
+    h::Realization r = [&]() -> h::Realization {
+        ScopedGILRelease release;
+        return f.realize(args...);
+    }();
+    return realization_to_python_object(r);
 }
 
 template <typename... Args>
 void func_realize_into(h::Func &f, Args... args) {
+    ScopedGILRelease release;
     f.realize(args...);
 }
 
 template <typename... Args>
 void func_realize_tuple(h::Func &f, p::tuple obj, Args... args) {
-    f.realize(python_object_to_realization(obj), args...);
+    h::Realization r = python_object_to_realization(obj);
+    ScopedGILRelease release;
+    f.realize(r, args...);
 }
 
 void func_compile_jit0(h::Func &that) {
+    ScopedGILRelease release;
     that.compile_jit();
     return;
 }
 
 void func_compile_jit1(h::Func &that, const h::Target &target = h::get_target_from_environment()) {
+    ScopedGILRelease release;
     that.compile_jit(target);
     return;
 }
@@ -637,6 +659,14 @@ void defineFunc() {
                    p::return_internal_reference<1>(),
                    "Equivalent to Func.store_at, but schedules storage outside the outermost loop.");
 
+    // async is a reserved word in Python 3.7
+    func_class.def("async_", &Func::async, p::arg("self"),
+                   p::return_internal_reference<1>(),
+                   "Compute this function in a task of its own, so that it runs "
+                   "ahead of its consumer instead of taking turns with it. Only "
+                   "useful when storage is scheduled outside the compute level "
+                   "(e.g. g.compute_at(f, y).store_root().async_()).");
+
     func_class.def("compute_inline", &Func::compute_inline, p::arg("self"),
                    p::return_internal_reference<1>(),
                    "Aggressively inline all uses of this function. This is the "
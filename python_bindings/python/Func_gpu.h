@@ -31,6 +31,11 @@ FuncOrStage &func_gpu_threads2(FuncOrStage &that, hh::VarOrRVar thread_x, hh::Va
     return that.gpu_threads(thread_x, thread_y, thread_z, device_api);
 }
 
+template <typename FuncOrStage>
+FuncOrStage &func_gpu_lanes(FuncOrStage &that, hh::VarOrRVar thread_x, hh::DeviceAPI device_api) {
+    return that.gpu_lanes(thread_x, device_api);
+}
+
 template <typename FuncOrStage>
 FuncOrStage &func_gpu_blocks0(FuncOrStage &that, hh::VarOrRVar block_x, hh::DeviceAPI device_api) {
     return that.gpu_blocks(block_x, device_api);
@@ -167,7 +172,16 @@ void defineFuncOrStageGpuMethods(bp::class_<FuncOrStage> &func_or_stage_class) {
              (bp::arg("self"),
               bp::arg("thread_x"),
               bp::arg("device_api") = hh::DeviceAPI::Default_GPU),
-             bp::return_internal_reference<1>());
+             bp::return_internal_reference<1>())
+        .def("gpu_lanes", &func_gpu_lanes<FuncOrStage>,
+             (bp::arg("self"),
+              bp::arg("thread_x"),
+              bp::arg("device_api") = hh::DeviceAPI::Default_GPU),
+             bp::return_internal_reference<1>(),
+             "The given dimension corresponds to the lanes of a GPU warp. "
+             "Funcs computed and used only within gpu_lanes loops are stored "
+             "one element per lane, and loads of other lanes' elements become "
+             "warp shuffles on CUDA. Otherwise the same as gpu_threads.");
 
     func_or_stage_class
         .def("gpu_single_thread", &FuncOrStage::gpu_single_thread,
@@ -1,5 +1,6 @@
 #include <boost/python.hpp>
 
+#include "AOT.h"
 #include "Argument.h"
 #include "BoundaryConditions.h"
 #include "Error.h"
@@ -41,7 +42,12 @@ void defineLlvmHelpers()
 BOOST_PYTHON_MODULE(halide) {
     using namespace boost::python;
 
+    // realize and compile_jit release the GIL, which needs it to
+    // exist (only older Pythons create it lazily).
+    PyEval_InitThreads();
+
     // we include all the pieces and bits from the Halide API
+    defineAOT();
     defineArgument();
     defineBoundaryConditions();
     defineBuffer();
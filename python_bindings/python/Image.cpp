@@ -504,16 +504,31 @@ h::Type dtype_to_type(const bn::dtype &t) {
     return h::Type();
 }
 
-/// Will create a Halide::Buffer object pointing to the array data
+/// Will create a Halide::Buffer object pointing to the array data.
+/// The array may have any strides (including negative ones, e.g. from
+/// a reversed slice), so long as they are a whole number of elements.
 p::object ndarray_to_buffer(bn::ndarray &array) {
     h::Type t = dtype_to_type(array.get_dtype());
     const int dims = array.get_nd();
+    user_assert(dims <= 4)
+        << "ndarray_to_buffer received an array with " << dims
+        << " dimensions, but a Halide::Buffer can have at most 4";
     void *host = reinterpret_cast<void *>(array.get_data());
-    halide_dimension_t shape[dims];
+    halide_dimension_t shape[4];
     for (int i = 0; i < dims; i++) {
+        Py_intptr_t extent = array.shape(i);
+        Py_intptr_t stride = array.strides(i);
+        user_assert(stride % t.bytes() == 0)
+            << "ndarray_to_buffer received an array whose stride in dimension " << i
+            << " (" << stride << " bytes) is not a multiple of the element size ("
+            << t.bytes() << " bytes)";
+        user_assert(extent <= INT32_MAX && stride / t.bytes() <= INT32_MAX &&
+                    stride / t.bytes() >= INT32_MIN)
+            << "ndarray_to_buffer received an array whose shape in dimension " << i
+            << " does not fit in 32 bits";
         shape[i].min = 0;
-        shape[i].extent = array.shape(i);
-        shape[i].stride = array.strides(i) / t.bytes();
+        shape[i].extent = (int)extent;
+        shape[i].stride = (int)(stride / t.bytes());
     }
 
     return buffer_to_python_object(h::Buffer<>(t, host, dims, shape));
@@ -525,6 +540,12 @@ bn::ndarray buffer_to_ndarray(p::object buffer_object) {
     user_assert(im.data() != nullptr)
         << "buffer_to_ndarray received an buffer without host data";
 
+    // The ndarray shares the host memory, so make sure it's up to
+    // date if the Buffer was last written on a device.
+    if (im.device_dirty()) {
+        im.copy_to_host();
+    }
+
     std::vector<int32_t> extent(im.dimensions()), stride(im.dimensions());
     for (int i = 0; i < im.dimensions(); i++) {
         extent[i] = im.dim(i).extent();
@@ -541,6 +562,17 @@ bn::ndarray buffer_to_ndarray(p::object buffer_object) {
 
 #endif
 
+h::Buffer<> python_object_or_ndarray_to_buffer(p::object obj) {
+#ifdef USE_NUMPY
+    p::extract<bn::ndarray> array_extract(obj);
+    if (array_extract.check()) {
+        bn::ndarray array = array_extract();
+        return python_object_to_buffer(ndarray_to_buffer(array));
+    }
+#endif
+    return python_object_to_buffer(obj);
+}
+
 struct BufferFactory {
 
     template <typename T, typename... Args>
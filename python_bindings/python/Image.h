@@ -7,5 +7,8 @@
 void defineBuffer();
 boost::python::object buffer_to_python_object(const Halide::Buffer<> &);
 Halide::Buffer<> python_object_to_buffer(boost::python::object);
+// Like python_object_to_buffer, but also accepts numpy arrays, which
+// the Buffer refers to (without a copy).
+Halide::Buffer<> python_object_or_ndarray_to_buffer(boost::python::object);
 
 #endif  // IMAGE_H
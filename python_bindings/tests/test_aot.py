@@ -0,0 +1,64 @@
+#!/usr/bin/python3
+
+import os
+import subprocess
+
+import numpy as np
+
+import halide as h
+
+def main():
+    x, y = h.Var("x"), h.Var("y")
+
+    offset = h.Param(h.UInt(8), "offset", 10)
+    scale = h.Param(h.Float(32), "scale")
+    input = h.ImageParam(h.UInt(8), 2, "input")
+
+    f = h.Func("f")
+    f[x, y] = h.cast(h.Float(32), input[x, y] + offset) * scale
+
+    # The object file has the runtime in it, so it makes a shared
+    # library by itself.
+    f.compile_to_file("aot_f", [input, offset, scale], "aot_f")
+    subprocess.check_call(["cc", "-shared", "-o", "./libaot_f.so", "aot_f.o", "-lpthread", "-ldl"])
+    assert os.path.isfile("libaot_f.so")
+
+    aot_f = h.AOTPipeline(os.path.abspath("libaot_f.so"), "aot_f")
+    assert aot_f.name() == "aot_f"
+    args = aot_f.arguments()
+    assert [a[0] for a in args] == ["input", "offset", "scale", "f"]
+    assert [a[1] for a in args] == ["input_buffer", "input_scalar", "input_scalar", "output_buffer"]
+    assert args[0][2] == 2 and args[3][2] == 2
+    assert args[3][3] == h.Float(32)
+
+    input_data = np.empty((32, 16), dtype=np.uint8, order='F')
+    for yy in range(16):
+        for xx in range(32):
+            input_data[xx, yy] = xx + yy
+    output = np.empty((32, 16), dtype=np.float32, order='F')
+
+    aot_f(input_data, 3, 0.5, output)
+    assert output[5, 7] == (5 + 7 + 3) * 0.5
+
+    # Scalars can be given by name, and those with defaults left out.
+    aot_f(input_data, scale=2.0, f=output)
+    assert output[5, 7] == (5 + 7 + 10) * 2.0
+
+    # Arguments of the wrong type or size are rejected before the call.
+    try:
+        aot_f(input_data, 3, 0.5, np.empty((32, 16), dtype=np.uint8, order='F'))
+        assert False, "Output of the wrong type wasn't rejected"
+    except ValueError:
+        pass
+    try:
+        aot_f(input_data, 300, 0.5, output)
+        assert False, "Offset that doesn't fit in a uint8 wasn't rejected"
+    except ValueError:
+        pass
+
+    print("Success!")
+
+    return 0
+
+if __name__ == "__main__":
+    main()
@@ -270,6 +270,34 @@ def test_image_to_ndarray():
 
     return
 
+def test_ndarray_views():
+
+    if "ndarray_to_buffer" not in globals():
+        print("Skipping test_ndarray_views")
+        return
+
+    import numpy
+
+    # A Buffer made from a strided, reversed view of an array shares
+    # the array's memory.
+    a = numpy.arange(40 * 30, dtype=numpy.int32).reshape((40, 30))
+    view = a[::2, ::-3]
+    b = ndarray_to_buffer(view)
+    assert b.extent(0) == view.shape[0]
+    assert b.extent(1) == view.shape[1]
+    assert b(3, 4) == view[3, 4]
+    view[3, 4] = -17
+    assert b(3, 4) == -17
+
+    # And an ndarray made from a Buffer shares the Buffer's memory.
+    c = buffer_to_ndarray(b)
+    assert c.shape == view.shape
+    assert c.strides == view.strides
+    c[5, 6] = -42
+    assert a[10, 30 - 1 - 3 * 6] == -42
+
+    return
+
 def test_param_bug():
     "see https://github.com/rodrigob/Halide/issues/1"
 
@@ -297,6 +325,7 @@ if __name__ == "__main__":
     test_float_or_int()
     test_ndarray_to_image()
     test_image_to_ndarray()
+    test_ndarray_views()
     test_types()
     test_operator_order()
     test_basics()
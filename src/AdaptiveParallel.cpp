@@ -0,0 +1,75 @@
+#include <set>
+
+#include "AdaptiveParallel.h"
+#include "Function.h"
+#include "IRMutator.h"
+#include "Substitute.h"
+
+namespace Halide {
+namespace Internal {
+
+using std::map;
+using std::set;
+using std::string;
+
+namespace {
+
+class MarkAdaptiveParallelLoops : public IRMutator {
+    // The names of the loops to mark.
+    const set<string> &loops;
+
+    // Device code can't call into the thread pool.
+    bool in_device_code = false;
+
+    using IRMutator::visit;
+
+    void visit(const For *op) {
+        bool old_in_device_code = in_device_code;
+        if (op->device_api != DeviceAPI::None &&
+            op->device_api != DeviceAPI::Host) {
+            in_device_code = true;
+        }
+        IRMutator::visit(op);
+        in_device_code = old_in_device_code;
+
+        if (in_device_code ||
+            op->for_type != ForType::Parallel ||
+            !loops.count(op->name)) {
+            return;
+        }
+        const For *loop = stmt.as<For>();
+        internal_assert(loop);
+        string name = op->name + ".__adaptive";
+        Stmt body = substitute(op->name, Variable::make(Int(32), name), loop->body);
+        stmt = For::make(name, loop->min, loop->extent, loop->for_type, loop->device_api, body);
+    }
+
+public:
+    MarkAdaptiveParallelLoops(const set<string> &l) : loops(l) {}
+};
+
+}  // namespace
+
+Stmt mark_adaptive_parallel_loops(Stmt s, const map<string, Function> &env) {
+    set<string> loops;
+    for (const auto &p : env) {
+        const Function &f = p.second;
+        std::vector<Definition> defs = {f.definition()};
+        for (const Definition &u : f.updates()) {
+            defs.push_back(u);
+        }
+        for (size_t i = 0; i < defs.size(); i++) {
+            for (const string &v : defs[i].schedule().adaptive_parallel()) {
+                loops.insert(f.name() + ".s" + std::to_string(i) + "." + v);
+            }
+        }
+    }
+    if (loops.empty()) {
+        return s;
+    }
+
+    return MarkAdaptiveParallelLoops(loops).mutate(s);
+}
+
+}
+}
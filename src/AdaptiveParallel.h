@@ -0,0 +1,27 @@
+#ifndef HALIDE_ADAPTIVE_PARALLEL_H
+#define HALIDE_ADAPTIVE_PARALLEL_H
+
+/** \file
+ * Defines the lowering pass that marks the parallel loops scheduled
+ * with Func::parallel_adaptive.
+ */
+
+#include <map>
+
+#include "IR.h"
+
+namespace Halide {
+namespace Internal {
+
+class Function;
+
+/** Rename the parallel loops of the stages scheduled with
+ * parallel_adaptive to end in ".__adaptive", which tells codegen to
+ * run them with halide_do_par_for_adaptive. Loops inside device code
+ * are left alone. */
+Stmt mark_adaptive_parallel_loops(Stmt s, const std::map<std::string, Function> &env);
+
+}
+}
+
+#endif
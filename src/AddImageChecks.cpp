@@ -1,6 +1,7 @@
 #include "AddImageChecks.h"
 #include "Target.h"
 #include "IRVisitor.h"
+#include "IRMutator.h"
 #include "Substitute.h"
 #include "Simplify.h"
 
@@ -584,5 +585,55 @@ Stmt add_image_checks(Stmt s,
     return s;
 }
 
+namespace {
+
+/* Remove the assertions that call the error functions used by add_image_checks. */
+class StripImageChecks : public IRMutator {
+    using IRMutator::visit;
+
+    void visit(const AssertStmt *op) {
+        const Call *error = op->message.as<Call>();
+        if (error && error->call_type == Call::Extern &&
+            (error->name == "halide_error_bad_elem_size" ||
+             error->name == "halide_error_access_out_of_bounds" ||
+             error->name == "halide_error_buffer_allocation_too_large" ||
+             error->name == "halide_error_buffer_extents_too_large" ||
+             error->name == "halide_error_buffer_extents_negative" ||
+             error->name == "halide_error_constraints_make_required_region_smaller" ||
+             error->name == "halide_error_constraint_violated" ||
+             error->name == "halide_error_unaligned_host_ptr")) {
+            stmt = Evaluate::make(0);
+        } else {
+            stmt = op;
+        }
+    }
+};
+
+/* Discard every statement other than the lets, assertions and
+ * conditionals that the checks are made of. */
+class ExtractImageChecks : public IRMutator {
+    using IRMutator::visit;
+
+    void visit(const ProducerConsumer *op) { stmt = Evaluate::make(0); }
+    void visit(const For *op) { stmt = Evaluate::make(0); }
+    void visit(const Store *op) { stmt = Evaluate::make(0); }
+    void visit(const Provide *op) { stmt = Evaluate::make(0); }
+    void visit(const Allocate *op) { stmt = Evaluate::make(0); }
+    void visit(const Free *op) { stmt = Evaluate::make(0); }
+    void visit(const Realize *op) { stmt = Evaluate::make(0); }
+    void visit(const Evaluate *op) { stmt = Evaluate::make(0); }
+    void visit(const Atomic *op) { stmt = Evaluate::make(0); }
+};
+
+}
+
+Stmt strip_image_checks(Stmt s) {
+    return StripImageChecks().mutate(s);
+}
+
+Stmt extract_image_checks(Stmt s) {
+    return ExtractImageChecks().mutate(s);
+}
+
 }
 }
@@ -29,6 +29,17 @@ Stmt add_image_checks(Stmt s,
                       const std::map<std::string, Function> &env,
                       const FuncValueBounds &fb);
 
+/** Remove the assertions inserted by add_image_checks from a lowered
+ * statement, leaving the rest of the pipeline, and the checks on
+ * scalar parameters, in place. Used to make an entry point for callers
+ * who have already validated their buffers with one made by
+ * extract_image_checks. */
+Stmt strip_image_checks(Stmt s);
+
+/** Reduce a lowered statement to the lets, assertions and bounds query
+ * at its top level, discarding everything that does computation or
+ * allocates memory. */
+Stmt extract_image_checks(Stmt s);
 
 }
 }
@@ -0,0 +1,285 @@
+#include <cstdlib>
+
+#include "AffectedRegions.h"
+#include "FindCalls.h"
+#include "IRMutator.h"
+#include "IROperator.h"
+#include "RealizationOrder.h"
+#include "Simplify.h"
+#include "Solve.h"
+
+namespace Halide {
+namespace Internal {
+
+using std::map;
+using std::string;
+using std::vector;
+
+namespace {
+
+// Replace references to scalar params and to the shapes of buffers
+// with their current values.
+class SubstituteCurrentValues : public IRMutator {
+    using IRMutator::visit;
+
+    void visit(const Variable *op) {
+        expr = op;
+        if (op->param.defined() && !op->param.is_buffer()) {
+            Expr value = op->param.get_scalar_expr();
+            if (value.defined()) {
+                expr = value;
+            }
+            return;
+        }
+
+        Buffer<> buf = op->image;
+        if (!buf.defined() && op->param.defined()) {
+            buf = op->param.get_buffer();
+        }
+        if (!buf.defined()) {
+            return;
+        }
+
+        // The shape of buffer foo is referred to as foo.min.0,
+        // foo.extent.0, foo.stride.0, and so on.
+        size_t last_dot = op->name.rfind('.');
+        if (last_dot == string::npos || last_dot == 0) {
+            return;
+        }
+        size_t field_dot = op->name.rfind('.', last_dot - 1);
+        if (field_dot == string::npos) {
+            return;
+        }
+        string field = op->name.substr(field_dot + 1, last_dot - field_dot - 1);
+        int d = std::atoi(op->name.c_str() + last_dot + 1);
+        if (d < 0 || d >= buf.dimensions()) {
+            return;
+        }
+        if (field == "min") {
+            expr = make_const(op->type, buf.dim(d).min());
+        } else if (field == "extent") {
+            expr = make_const(op->type, buf.dim(d).extent());
+        } else if (field == "stride") {
+            expr = make_const(op->type, buf.dim(d).stride());
+        }
+    }
+};
+
+Expr current_value(Expr e) {
+    if (!e.defined()) {
+        return e;
+    }
+    return simplify(SubstituteCurrentValues().mutate(e));
+}
+
+// Loosen the bounds of an interval to constants, or to infinity if
+// there are none.
+Interval constant_bounds(Interval i) {
+    if (i.has_lower_bound()) {
+        i.min = find_constant_bound(simplify(i.min), Direction::Lower);
+        if (!i.min.defined()) {
+            i.min = Interval::neg_inf;
+        }
+    }
+    if (i.has_upper_bound()) {
+        i.max = find_constant_bound(simplify(i.max), Direction::Upper);
+        if (!i.max.defined()) {
+            i.max = Interval::pos_inf;
+        }
+    }
+    return i;
+}
+
+bool definitely_empty(const Interval &i) {
+    return i.is_empty() || (i.is_bounded() && can_prove(i.min > i.max));
+}
+
+// Whether interval a provably contains interval b. Unlike
+// box_contains, this copes with infinite bounds.
+bool interval_contains(const Interval &a, const Interval &b) {
+    bool min_ok = !a.has_lower_bound() || (b.has_lower_bound() && can_prove(a.min <= b.min));
+    bool max_ok = !a.has_upper_bound() || (b.has_upper_bound() && can_prove(a.max >= b.max));
+    return min_ok && max_ok;
+}
+
+// The condition under which a region required by a definition,
+// written in terms of the variables of the definition, overlaps an
+// affected region.
+Expr might_overlap(const Box &required, const Box &affected) {
+    Expr c = required.used.defined() ? required.used : const_true();
+    for (size_t i = 0; i < required.size() && i < affected.size(); i++) {
+        const Interval &r = required[i], &a = affected[i];
+        if (r.has_lower_bound() && a.has_upper_bound()) {
+            c = c && (r.min <= a.max);
+        }
+        if (r.has_upper_bound() && a.has_lower_bound()) {
+            c = c && (r.max >= a.min);
+        }
+    }
+    return c;
+}
+
+void add_definition(const Definition &def, vector<Definition> &defs) {
+    defs.push_back(def);
+    for (const Specialization &s : def.specializations()) {
+        add_definition(s.definition, defs);
+    }
+}
+
+// Find a box of the points of f a definition writes that may depend
+// on the affected boxes, or an empty box if there are none.
+Box box_affected_by(const Function &f, const Definition &def,
+                    const map<string, Box> &affected) {
+    map<string, Box> required;
+    auto add_required = [&](Expr e) {
+        if (!e.defined()) {
+            return;
+        }
+        for (const auto &r : boxes_required(current_value(e))) {
+            merge_boxes(required[r.first], r.second);
+        }
+    };
+    for (Expr e : def.values()) {
+        add_required(e);
+    }
+    for (Expr e : def.args()) {
+        add_required(e);
+    }
+    add_required(def.predicate());
+
+    Expr c = const_false();
+    for (const auto &r : required) {
+        auto a = affected.find(r.first);
+        if (a != affected.end()) {
+            c = c || might_overlap(r.second, a->second);
+        }
+    }
+    c = simplify(c);
+    if (is_zero(c)) {
+        return Box();
+    }
+
+    // The points written are those for which the condition might be
+    // true.
+    Scope<Interval> scope;
+    for (const string &v : f.args()) {
+        scope.push(v, constant_bounds(solve_for_outer_interval(c, v)));
+    }
+    for (const ReductionVariable &rv : def.schedule().rvars()) {
+        Expr min = current_value(rv.min);
+        Interval domain = constant_bounds(Interval(min, simplify(min + current_value(rv.extent) - 1)));
+        Interval i = constant_bounds(solve_for_outer_interval(c, rv.var));
+        scope.push(rv.var, Interval::make_intersection(i, domain));
+    }
+
+    Box result;
+    for (Expr arg : def.args()) {
+        Interval i = constant_bounds(bounds_of_expr_in_scope(current_value(arg), scope));
+        if (definitely_empty(i)) {
+            return Box();
+        }
+        result.push_back(i);
+    }
+    return result;
+}
+
+Box everything(int dimensions) {
+    return Box(vector<Interval>(dimensions, Interval::everything()));
+}
+
+}  // namespace
+
+map<string, Box> boxes_affected(const vector<Function> &outputs,
+                                const map<string, Box> &changed) {
+    map<string, Function> env;
+    for (Function f : outputs) {
+        env[f.name()] = f;
+        map<string, Function> calls = find_transitive_calls(f);
+        env.insert(calls.begin(), calls.end());
+    }
+    vector<string> order = realization_order(outputs, env);
+
+    map<string, Box> affected;
+    for (const auto &c : changed) {
+        Box b;
+        for (const Interval &i : c.second.bounds) {
+            b.push_back(constant_bounds(Interval(current_value(i.min), current_value(i.max))));
+        }
+        affected[c.first] = b;
+    }
+
+    for (const string &name : order) {
+        const Function &f = env[name];
+
+        if (f.has_extern_definition()) {
+            // Nothing is known about which points of its inputs an
+            // extern stage reads.
+            for (const ExternFuncArgument &arg : f.extern_arguments()) {
+                string input;
+                if (arg.is_func()) {
+                    input = Function(arg.func).name();
+                } else if (arg.is_buffer()) {
+                    input = arg.buffer.name();
+                } else if (arg.is_image_param()) {
+                    input = arg.image_param.name();
+                }
+                if (affected.count(input)) {
+                    affected[name] = everything(f.dimensions());
+                    break;
+                }
+            }
+            continue;
+        }
+
+        vector<Definition> pure;
+        add_definition(f.definition(), pure);
+        Box box = affected[name];
+        for (const Definition &def : pure) {
+            merge_boxes(box, box_affected_by(f, def, affected));
+        }
+        affected[name] = box;
+
+        for (const Definition &update : f.updates()) {
+            vector<Definition> defs;
+            add_definition(update, defs);
+            // An update that reads the function itself, such as a
+            // scan, spreads the affected region each time it is
+            // applied, so iterate until it stops growing.
+            const int max_iterations = 8;
+            for (int i = 0; ; i++) {
+                Box before = affected[name];
+                Box after = before;
+                for (const Definition &def : defs) {
+                    merge_boxes(after, box_affected_by(f, def, affected));
+                }
+                bool grew = before.empty() && !after.empty();
+                for (size_t d = 0; !before.empty() && d < after.size(); d++) {
+                    if (!interval_contains(before[d], after[d])) {
+                        grew = true;
+                        if (i == max_iterations) {
+                            after[d] = Interval::everything();
+                        }
+                    }
+                }
+                affected[name] = after;
+                if (!grew || i == max_iterations) {
+                    break;
+                }
+            }
+        }
+
+        if (affected[name].empty()) {
+            affected.erase(name);
+        }
+    }
+
+    for (const auto &c : changed) {
+        if (!env.count(c.first)) {
+            affected.erase(c.first);
+        }
+    }
+    return affected;
+}
+
+}
+}
@@ -0,0 +1,34 @@
+#ifndef HALIDE_AFFECTED_REGIONS_H
+#define HALIDE_AFFECTED_REGIONS_H
+
+/** \file
+ * Defines the analysis that finds which regions of the Funcs in a
+ * pipeline depend on a changed region of one of its inputs.
+ */
+
+#include <map>
+#include <vector>
+
+#include "Bounds.h"
+#include "Function.h"
+
+namespace Halide {
+namespace Internal {
+
+/** Given boxes of some inputs of the pipeline that computes the given
+ * outputs, keyed by the name of the image, ImageParam, or Function,
+ * find boxes of each function of the pipeline that cover every point
+ * whose value may depend on those boxes. The analysis is
+ * conservative: a box may contain points that don't depend on the
+ * changed ones, and a dimension for which nothing tighter can be
+ * shown is left unbounded. Functions that don't depend on the changed
+ * boxes at all are left out of the result. The scalar params and
+ * buffer shapes the pipeline refers to are replaced by their current
+ * values, so that the bounds of the boxes are constants. */
+std::map<std::string, Box> boxes_affected(const std::vector<Function> &outputs,
+                                          const std::map<std::string, Box> &changed);
+
+}
+}
+
+#endif
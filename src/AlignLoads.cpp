@@ -1,13 +1,19 @@
 #include <algorithm>
+#include <set>
 
 #include "AlignLoads.h"
+#include "CSE.h"
 #include "IRMutator.h"
 #include "IROperator.h"
+#include "IRVisitor.h"
+#include "LoopCarry.h"
 #include "Scope.h"
 #include "Bounds.h"
 #include "ModulusRemainder.h"
 #include "Simplify.h"
 
+using std::set;
+using std::string;
 using std::vector;
 
 namespace Halide {
@@ -26,12 +32,24 @@ Expr slice_vector(Expr vec, Expr start, Expr stride, int lanes) {
 // intended vector out of the aligned vector.
 class AlignLoads : public IRMutator {
 public:
-    AlignLoads(int alignment) : required_alignment(alignment) {}
+    AlignLoads(int alignment, const set<const Load *> *only = nullptr)
+        : required_alignment(alignment), only(only) {}
+
+    // The loops containing loads that were rewritten.
+    set<string> rewritten_loops;
 
 private:
     // The desired alignment of a vector load.
     int required_alignment;
 
+    // If not null, only rewrite these loads (and the loads they are
+    // rewritten into).
+    const set<const Load *> *only;
+    bool rewriting = false;
+
+    // The innermost enclosing loop.
+    string loop;
+
     // Alignment info for variables in scope.
     Scope<ModulusRemainder> alignment_info;
 
@@ -39,8 +57,20 @@ private:
 
     // Rewrite a load to have a new index, updating the type if necessary.
     Expr make_load(const Load *load, Expr index) {
-        return mutate(Load::make(load->type.with_lanes(index.type().lanes()), load->name,
-                                 index, load->image, load->param));
+        rewritten_loops.insert(loop);
+        bool old_rewriting = rewriting;
+        rewriting = true;
+        Expr result = mutate(Load::make(load->type.with_lanes(index.type().lanes()), load->name,
+                                        index, load->image, load->param));
+        rewriting = old_rewriting;
+        return result;
+    }
+
+    void visit(const For *op) {
+        string old_loop = loop;
+        loop = op->name;
+        IRMutator::visit(op);
+        loop = old_loop;
     }
 
     void visit(const Call *op) {
@@ -65,6 +95,11 @@ private:
             return;
         }
 
+        if (only && !rewriting && !only->count(op)) {
+            IRMutator::visit(op);
+            return;
+        }
+
         Expr index = mutate(op->index);
         const Ramp *ramp = index.as<Ramp>();
         const int64_t *const_stride = ramp ? as_const_int(ramp->stride) : nullptr;
@@ -184,11 +219,106 @@ private:
     void visit(const LetStmt *op) { visit_let(stmt, op); }
 };
 
+// Find the dense vector loads of one native vector in innermost
+// serial loops that overlap another such load of the same buffer, such
+// as the taps of a stencil at x - 1, x and x + 1.
+class FindOverlappingLoads : public IRVisitor {
+    int alignment;
+
+    // The candidate loads in the loop being visited.
+    vector<const Load *> loads;
+    bool in_loop = false, found_inner_loop = false;
+
+    using IRVisitor::visit;
+
+    void visit(const For *op) {
+        if (op->device_api != DeviceAPI::None && op->device_api != DeviceAPI::Host) {
+            // Leave code for other devices alone.
+            return;
+        }
+
+        vector<const Load *> old_loads;
+        old_loads.swap(loads);
+        bool old_in_loop = in_loop;
+        in_loop = op->for_type == ForType::Serial;
+        found_inner_loop = false;
+
+        IRVisitor::visit(op);
+
+        if (in_loop && !found_inner_loop) {
+            add_overlapping_loads();
+        }
+
+        loads.swap(old_loads);
+        in_loop = old_in_loop;
+        found_inner_loop = true;
+    }
+
+    void visit(const Call *op) {
+        // Loads inside an address_of aren't loads.
+        if (!op->is_intrinsic(Call::address_of)) {
+            IRVisitor::visit(op);
+        }
+    }
+
+    void visit(const Load *op) {
+        IRVisitor::visit(op);
+        const Ramp *ramp = op->index.as<Ramp>();
+        if (in_loop && ramp && is_one(ramp->stride) && !op->image.defined() &&
+            op->type.lanes() * op->type.bytes() == alignment) {
+            loads.push_back(op);
+        }
+    }
+
+    void add_overlapping_loads() {
+        for (size_t i = 0; i < loads.size(); i++) {
+            for (size_t j = i + 1; j < loads.size(); j++) {
+                const Load *a = loads[i], *b = loads[j];
+                if (a->name != b->name || a->type != b->type) {
+                    continue;
+                }
+                Expr diff = simplify(a->index.as<Ramp>()->base - b->index.as<Ramp>()->base);
+                const int64_t *offset = as_const_int(diff);
+                if (offset && *offset != 0 && std::abs(*offset) < a->type.lanes()) {
+                    result.insert(a);
+                    result.insert(b);
+                }
+            }
+        }
+    }
+
+public:
+    FindOverlappingLoads(int alignment) : alignment(alignment) {}
+
+    set<const Load *> result;
+};
+
 }  // namespace
 
 Stmt align_loads(Stmt s, int alignment) {
     return AlignLoads(alignment).mutate(s);
 }
 
+Stmt align_overlapping_loads(Stmt s, int alignment, int max_carried_values) {
+    FindOverlappingLoads find(alignment);
+    s.accept(&find);
+    if (find.result.empty()) {
+        return s;
+    }
+
+    AlignLoads align(alignment, &find.result);
+    s = align.mutate(s);
+    if (align.rewritten_loops.empty()) {
+        return s;
+    }
+
+    // Share the aligned vectors, and then reuse them on later loop
+    // iterations.
+    s = common_subexpression_elimination(s);
+    s = simplify(s);
+    s = loop_carry(s, max_carried_values, &align.rewritten_loops, alignment * 8);
+    return simplify(s);
+}
+
 }
 }
@@ -16,6 +16,17 @@ namespace Internal {
  * vectors. */
 Stmt align_loads(Stmt s, int alignment);
 
+/** Rewrite dense vector loads that overlap another load of the same
+ * buffer in an innermost serial loop, such as the taps of a stencil
+ * at x - 1, x and x + 1, into aligned loads of native vectors and
+ * slices of them, where the alignment can be proven from the schedule
+ * (e.g. align_bounds or align_storage) or from the host alignment of
+ * an input. The aligned vectors are then carried across iterations of
+ * those loops (see loop_carry), so each iteration loads about one new
+ * vector per buffer, using at most max_carried_values vector registers
+ * of alignment bytes each. Loads of other devices are left alone. */
+Stmt align_overlapping_loads(Stmt s, int alignment, int max_carried_values = 8);
+
 }
 }
 
@@ -0,0 +1,243 @@
+#include "AsyncProducers.h"
+#include "IRMutator.h"
+#include "IROperator.h"
+#include "Function.h"
+
+namespace Halide {
+namespace Internal {
+
+using std::map;
+using std::string;
+
+namespace {
+
+// Does a statement contain any produce or consume nodes for the given func?
+class UsesPipeline : public IRVisitor {
+    const string &func;
+
+    using IRVisitor::visit;
+
+    void visit(const ProducerConsumer *op) {
+        if (op->name == func) {
+            result = true;
+        } else {
+            IRVisitor::visit(op);
+        }
+    }
+
+public:
+    bool result = false;
+    UsesPipeline(const string &f) : func(f) {}
+};
+
+bool uses_pipeline(Stmt s, const string &func) {
+    UsesPipeline uses(func);
+    s.accept(&uses);
+    return uses.result;
+}
+
+// Both tasks run all of the statement they are forked from, except
+// for the pipeline of the async func. Check that the rest is safe to
+// run twice at once: that it contains nothing but loops and lets, and
+// that the loops are serial, so that both tasks visit the productions
+// in the same order.
+class CheckForkable : public IRVisitor {
+    const string &func;
+    string producing;
+    int loop_depth = 0;
+
+    using IRVisitor::visit;
+
+    void visit(const ProducerConsumer *op) {
+        if (op->name == func) {
+            user_assert(!op->is_producer || loop_depth > 0)
+                << "Func " << func << " is scheduled async, but it is stored at the same "
+                << "level it is computed at, so there is nothing for its producer to run "
+                << "ahead of. Use store_at or store_root to store it further out.\n";
+        } else if (op->is_producer) {
+            string old_producing = producing;
+            producing = op->name;
+            IRVisitor::visit(op);
+            producing = old_producing;
+        } else {
+            IRVisitor::visit(op);
+        }
+    }
+
+    void visit(const For *op) {
+        user_assert(op->for_type == ForType::Serial || op->for_type == ForType::Unrolled)
+            << "Func " << func << " is scheduled async, so the loop over " << op->name
+            << " between its store and compute levels must be serial.\n";
+        loop_depth++;
+        IRVisitor::visit(op);
+        loop_depth--;
+    }
+
+    void computed_here(const string &name) {
+        user_error << "Func " << func << " is scheduled async, so the loops between its store "
+                   << "and compute levels are run by two tasks at once, but " << name
+                   << " is also computed in those loops, outside of the consumer of "
+                   << func << ".\n";
+    }
+
+    void visit(const Provide *op) {
+        computed_here(op->name);
+    }
+
+    void visit(const Evaluate *op) {
+        // Extern stages.
+        const Call *call = op->value.as<Call>();
+        if (call && call->call_type == Call::Extern && !producing.empty()) {
+            computed_here(producing);
+        }
+        IRVisitor::visit(op);
+    }
+
+public:
+    CheckForkable(const string &f) : func(f) {}
+};
+
+Stmt acquire(Expr sem) {
+    string result_name = unique_name('t');
+    Expr result = Variable::make(Int(32), result_name);
+    Expr call = Call::make(Int(32), "halide_semaphore_acquire", {sem, 1}, Call::Extern);
+    return LetStmt::make(result_name, call, AssertStmt::make(result == 0, result));
+}
+
+Stmt release(Expr sem) {
+    return Evaluate::make(Call::make(Int(32), "halide_semaphore_release", {sem, 1}, Call::Extern));
+}
+
+// Make the copy of a statement run by either the producer or the
+// consumer task of an async func. The producer waits on a free slot
+// before each production, and signals that it's ready after. The
+// consumer waits for each production in place of computing it, and
+// frees its slot after consuming it.
+class MakeTask : public IRMutator {
+    const string &func;
+    bool producer;
+    Expr ready, space;
+
+    using IRMutator::visit;
+
+    void visit(const ProducerConsumer *op) {
+        if (op->name != func) {
+            IRMutator::visit(op);
+        } else if (op->is_producer) {
+            if (producer) {
+                stmt = Block::make({acquire(space), op, release(ready)});
+            } else {
+                stmt = acquire(ready);
+            }
+        } else {
+            if (producer) {
+                stmt = Evaluate::make(0);
+            } else {
+                stmt = Block::make(op, release(space));
+            }
+        }
+    }
+
+public:
+    MakeTask(const string &f, bool p, Expr r, Expr s) :
+        func(f), producer(p), ready(r), space(s) {}
+};
+
+Stmt fork_async_producer(const string &func, Stmt s) {
+    CheckForkable check(func);
+    s.accept(&check);
+
+    string ready_name = func + ".ready_semaphore";
+    string space_name = func + ".space_semaphore";
+    Expr ready = Variable::make(Handle(), ready_name);
+    Expr space = Variable::make(Handle(), space_name);
+
+    // Each task abandons the semaphore it releases when it exits, so
+    // that if it fails, the other task fails too rather than waiting
+    // on it forever.
+    Stmt producer = MakeTask(func, true, ready, space).mutate(s);
+    Expr abandon_ready = Call::make(Int(32), Call::register_destructor,
+                                    {Expr("halide_semaphore_abandon"), ready}, Call::Intrinsic);
+    producer = Block::make(Evaluate::make(abandon_ready), producer);
+
+    Stmt consumer = MakeTask(func, false, ready, space).mutate(s);
+    Expr abandon_space = Call::make(Int(32), Call::register_destructor,
+                                    {Expr("halide_semaphore_abandon"), space}, Call::Intrinsic);
+    consumer = Block::make(Evaluate::make(abandon_space), consumer);
+
+    // The loop name tells codegen to run the tasks concurrently,
+    // rather than as a parallel loop that might run them one after
+    // the other.
+    string task_name = func + ".__async";
+    Expr task = Variable::make(Int(32), task_name);
+    Stmt tasks = For::make(task_name, 0, 2, ForType::Parallel, DeviceAPI::Host,
+                           IfThenElse::make(task == 0, producer, consumer));
+
+    // There are two slots for productions, so the producer can run
+    // one production ahead. Storage folding has made room for that.
+    Expr init_ready = Call::make(Int(32), "halide_semaphore_init", {ready, 0}, Call::Extern);
+    Expr init_space = Call::make(Int(32), "halide_semaphore_init", {space, 2}, Call::Extern);
+    Stmt result = Block::make({Evaluate::make(init_ready), Evaluate::make(init_space), tasks});
+
+    Expr sem = Call::make(Handle(), Call::alloca, {(int)sizeof(halide_semaphore_t)}, Call::Intrinsic);
+    result = LetStmt::make(space_name, sem, result);
+    result = LetStmt::make(ready_name, sem, result);
+    return result;
+}
+
+// Find the outermost statement inside the realization of an async
+// func that contains all of its pipeline, and fork it.
+Stmt fork_pipeline(const string &func, Stmt s) {
+    if (const LetStmt *let = s.as<LetStmt>()) {
+        return LetStmt::make(let->name, let->value, fork_pipeline(func, let->body));
+    } else if (const ProducerConsumer *pc = s.as<ProducerConsumer>()) {
+        if (pc->name != func) {
+            return ProducerConsumer::make(pc->name, pc->is_producer, fork_pipeline(func, pc->body));
+        }
+    } else if (const Realize *r = s.as<Realize>()) {
+        return Realize::make(r->name, r->types, r->bounds, r->condition, fork_pipeline(func, r->body));
+    } else if (const Block *b = s.as<Block>()) {
+        bool in_first = uses_pipeline(b->first, func);
+        bool in_rest = uses_pipeline(b->rest, func);
+        if (!in_first) {
+            return Block::make(b->first, fork_pipeline(func, b->rest));
+        } else if (!in_rest) {
+            return Block::make(fork_pipeline(func, b->first), b->rest);
+        }
+    }
+    if (!uses_pipeline(s, func)) {
+        return s;
+    }
+    return fork_async_producer(func, s);
+}
+
+class ForkAsyncProducers : public IRMutator {
+    const map<string, Function> &env;
+
+    using IRMutator::visit;
+
+    void visit(const Realize *op) {
+        Stmt body = mutate(op->body);
+        auto it = env.find(op->name);
+        if (it != env.end() && it->second.schedule().async()) {
+            body = fork_pipeline(op->name, body);
+        }
+        if (body.same_as(op->body)) {
+            stmt = op;
+        } else {
+            stmt = Realize::make(op->name, op->types, op->bounds, op->condition, body);
+        }
+    }
+
+public:
+    ForkAsyncProducers(const map<string, Function> &e) : env(e) {}
+};
+
+}  // namespace
+
+Stmt fork_async_producers(Stmt s, const map<string, Function> &env) {
+    return ForkAsyncProducers(env).mutate(s);
+}
+
+}
+}
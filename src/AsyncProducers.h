@@ -0,0 +1,28 @@
+#ifndef HALIDE_ASYNC_PRODUCERS_H
+#define HALIDE_ASYNC_PRODUCERS_H
+
+/** \file
+ * Defines the lowering pass that runs the producers of Funcs
+ * scheduled async in tasks of their own.
+ */
+
+#include <map>
+
+#include "IR.h"
+
+namespace Halide {
+namespace Internal {
+
+/** Split the loops between the store and compute levels of each Func
+ * scheduled async into two copies that run concurrently: one that
+ * only computes the Func, and one that does everything else. The
+ * copies are kept in step by semaphores counting the productions
+ * ready to consume and the free slots of storage to produce into. See
+ * Func::async. Must run after storage folding, which makes room for
+ * two productions at once in the folded buffers of async Funcs. */
+Stmt fork_async_producers(Stmt s, const std::map<std::string, Function> &env);
+
+}
+}
+
+#endif
@@ -0,0 +1,597 @@
+#include <algorithm>
+#include <map>
+#include <set>
+#include <sstream>
+
+#include "AutoSchedule.h"
+#include "Bounds.h"
+#include "FindCalls.h"
+#include "Func.h"
+#include "IRMutator.h"
+#include "IROperator.h"
+#include "IRVisitor.h"
+#include "RealizationOrder.h"
+#include "Reduction.h"
+#include "Simplify.h"
+
+namespace Halide {
+
+MachineParams MachineParams::generic() {
+    return MachineParams(16, 16 * 1024 * 1024, 40);
+}
+
+namespace Internal {
+
+using std::map;
+using std::set;
+using std::string;
+using std::vector;
+
+namespace {
+
+// Count the operations done, and the calls made to Funcs and images,
+// by one evaluation of a definition.
+class CountOps : public IRVisitor {
+    using IRVisitor::visit;
+
+    template<typename T>
+    void visit_op(const T *op) {
+        ops++;
+        IRVisitor::visit(op);
+    }
+
+    void visit(const Cast *op) {visit_op(op);}
+    void visit(const Add *op) {visit_op(op);}
+    void visit(const Sub *op) {visit_op(op);}
+    void visit(const Mul *op) {visit_op(op);}
+    void visit(const Div *op) {visit_op(op);}
+    void visit(const Mod *op) {visit_op(op);}
+    void visit(const Min *op) {visit_op(op);}
+    void visit(const Max *op) {visit_op(op);}
+    void visit(const EQ *op) {visit_op(op);}
+    void visit(const NE *op) {visit_op(op);}
+    void visit(const LT *op) {visit_op(op);}
+    void visit(const LE *op) {visit_op(op);}
+    void visit(const GT *op) {visit_op(op);}
+    void visit(const GE *op) {visit_op(op);}
+    void visit(const And *op) {visit_op(op);}
+    void visit(const Or *op) {visit_op(op);}
+    void visit(const Not *op) {visit_op(op);}
+    void visit(const Select *op) {visit_op(op);}
+
+    void visit(const Call *op) {
+        if (op->call_type == Call::Halide || op->call_type == Call::Image) {
+            calls[op->name]++;
+            load_bytes += op->type.bytes();
+        } else {
+            ops++;
+        }
+        IRVisitor::visit(op);
+    }
+
+public:
+    int64_t ops = 0, load_bytes = 0;
+    map<string, int64_t> calls;
+};
+
+// Replace scalar parameters, and the mins and extents of buffer
+// parameters, with their estimates where they have one.
+class SubstituteEstimates : public IRMutator {
+    using IRMutator::visit;
+
+    void visit(const Variable *op) {
+        expr = op;
+        if (!op->param.defined()) {
+            return;
+        }
+        Expr estimate;
+        if (!op->param.is_buffer()) {
+            estimate = op->param.get_estimate();
+        } else {
+            for (int d = 0; d < op->param.dimensions(); d++) {
+                std::ostringstream min, extent;
+                min << op->param.name() << ".min." << d;
+                extent << op->param.name() << ".extent." << d;
+                if (op->name == min.str()) {
+                    estimate = op->param.min_estimate(d);
+                } else if (op->name == extent.str()) {
+                    estimate = op->param.extent_estimate(d);
+                }
+            }
+        }
+        if (estimate.defined()) {
+            expr = cast(op->type, estimate);
+        }
+    }
+};
+
+Expr substitute_estimates(Expr e) {
+    return simplify(SubstituteEstimates().mutate(e));
+}
+
+int64_t round_down_to_power_of_two(int64_t x) {
+    int64_t p = 1;
+    while (p * 2 <= x) {
+        p *= 2;
+    }
+    return p;
+}
+
+// Make a C++ identifier from the name of a Func or Var.
+string identifier(const string &name) {
+    string result;
+    for (char c : name) {
+        bool ok = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+            (c >= '0' && c <= '9') || c == '_';
+        result += ok ? c : '_';
+    }
+    if (result.empty() || (result[0] >= '0' && result[0] <= '9')) {
+        result = "_" + result;
+    }
+    return result;
+}
+
+struct FuncInfo {
+    Function func;
+
+    // The region of the Func required to compute the estimated
+    // regions of the outputs, and its extents if they're
+    // constant. The region is unknown if any consumer's is.
+    Box region;
+    bool region_unknown = false;
+    vector<int64_t> extents;
+    double points = 0;
+
+    // Per point, summed over the definitions: the operations done,
+    // the calls made to each Func and image, and the bytes loaded.
+    double ops = 0, load_bytes = 0;
+    map<string, double> calls;
+    // The bytes stored per point.
+    int bytes = 0;
+
+    // The Funcs that call this one.
+    set<string> consumers;
+
+    enum Choice {Inline, Root, Fused};
+    Choice choice = Inline;
+    string fused_into;
+
+    // The number of times the definition is evaluated, given how it
+    // and its consumers are scheduled.
+    double evaluations = 0;
+
+    // The tiling of the pure loops of a Func computed at root, or
+    // zero where a dimension isn't tiled.
+    int64_t tile[2] = {0, 0};
+
+    bool known() const {
+        return !extents.empty();
+    }
+};
+
+class AutoScheduler {
+    const Target &target;
+    const MachineParams &params;
+    map<string, Function> env;
+    vector<string> order;
+    set<string> outputs;
+    map<string, FuncInfo> funcs;
+
+    std::ostringstream source;
+    vector<string> new_vars;
+
+    Var new_var(const string &name) {
+        if (std::find(new_vars.begin(), new_vars.end(), name) == new_vars.end()) {
+            new_vars.push_back(name);
+        }
+        return Var(name);
+    }
+
+    // Find the region of each Func required, working back from the
+    // outputs, using the bounds of the values of each Func to bound
+    // data-dependent accesses.
+    void compute_regions(const vector<OutputEstimate> &estimates) {
+        for (const string &o : outputs) {
+            const OutputEstimate *estimate = nullptr;
+            for (const OutputEstimate &e : estimates) {
+                if (e.func == o) {
+                    estimate = &e;
+                }
+            }
+            FuncInfo &info = funcs[o];
+            if (estimate) {
+                user_assert((int)estimate->bounds.size() == info.func.dimensions())
+                    << "The estimate for output " << o << " has " << estimate->bounds.size()
+                    << " dimensions, but " << o << " has " << info.func.dimensions() << "\n";
+                for (const auto &b : estimate->bounds) {
+                    info.region.push_back(Interval(b.first, b.first + b.second - 1));
+                }
+                continue;
+            }
+
+            // Fall back to the bounds estimates of the output buffer.
+            const Parameter &buffer = info.func.output_buffers()[0];
+            for (int d = 0; d < info.func.dimensions(); d++) {
+                Expr min = buffer.min_estimate(d), extent = buffer.extent_estimate(d);
+                user_assert(min.defined() && extent.defined())
+                    << "auto_schedule needs an estimate of the region computed of output " << o
+                    << ", either passed in or set with set_bounds_estimate on each dimension"
+                    << " of its output buffer\n";
+                info.region.push_back(Interval(min, min + extent - 1));
+            }
+        }
+
+        FuncValueBounds func_bounds = compute_function_value_bounds(order, env);
+
+        for (size_t i = order.size(); i > 0; i--) {
+            FuncInfo &info = funcs[order[i - 1]];
+            const Function &f = info.func;
+
+            for (size_t d = 0; d < info.region.size(); d++) {
+                info.region[d].min = substitute_estimates(info.region[d].min);
+                info.region[d].max = substitute_estimates(info.region[d].max);
+            }
+            bool unknown = info.region_unknown || f.has_extern_definition() || info.region.empty();
+            if (!unknown) {
+                vector<int64_t> extents;
+                double points = 1;
+                for (size_t d = 0; d < info.region.size(); d++) {
+                    const Interval &in = info.region[d];
+                    const int64_t *min = as_const_int(in.min);
+                    const int64_t *max = as_const_int(in.max);
+                    if (!min || !max) {
+                        unknown = true;
+                        break;
+                    }
+                    extents.push_back(std::max((int64_t)1, *max - *min + 1));
+                    points *= extents.back();
+                }
+                if (!unknown) {
+                    info.extents = extents;
+                    info.points = points;
+                }
+            }
+
+            Scope<Interval> scope;
+            for (int d = 0; d < f.dimensions() && !unknown; d++) {
+                scope.push(f.args()[d], info.region[d]);
+            }
+
+            map<string, Box> required;
+            auto require = [&](Expr e) {
+                if (!e.defined()) {
+                    return;
+                }
+                CountOps count;
+                e.accept(&count);
+                info.ops += count.ops;
+                info.load_bytes += count.load_bytes;
+                for (const auto &c : count.calls) {
+                    info.calls[c.first] += c.second;
+                }
+                if (!unknown) {
+                    for (const auto &b : boxes_required(e, scope, func_bounds)) {
+                        merge_boxes(required[b.first], b.second);
+                    }
+                }
+            };
+
+            if (!f.has_extern_definition()) {
+                for (Expr v : f.values()) {
+                    require(v);
+                }
+                for (const Definition &def : f.updates()) {
+                    // Count the work of an update once per point of
+                    // the pure region, scaled by the size of its
+                    // reduction domain where that's known.
+                    double ops = info.ops, load_bytes = info.load_bytes;
+                    map<string, double> calls = info.calls;
+                    double domain = 1;
+                    for (const ReductionVariable &rv : def.schedule().rvars()) {
+                        scope.push(rv.var, Interval(rv.min, simplify(rv.min + rv.extent - 1)));
+                        if (const int64_t *e = as_const_int(substitute_estimates(rv.extent))) {
+                            domain *= std::max((int64_t)1, *e);
+                        }
+                    }
+                    for (Expr a : def.args()) {
+                        require(a);
+                    }
+                    for (Expr v : def.values()) {
+                        require(v);
+                    }
+                    require(def.predicate());
+                    for (const ReductionVariable &rv : def.schedule().rvars()) {
+                        scope.pop(rv.var);
+                    }
+                    info.ops = ops + (info.ops - ops) * domain;
+                    info.load_bytes = load_bytes + (info.load_bytes - load_bytes) * domain;
+                    for (auto &c : info.calls) {
+                        c.second = calls[c.first] + (c.second - calls[c.first]) * domain;
+                    }
+                }
+            }
+
+            for (Type t : f.output_types()) {
+                info.bytes += t.bytes();
+            }
+
+            for (const auto &callee : find_direct_calls(f)) {
+                if (callee.first == f.name()) {
+                    continue;
+                }
+                FuncInfo &producer = funcs[callee.first];
+                producer.consumers.insert(f.name());
+                auto it = required.find(callee.first);
+                if (unknown || it == required.end()) {
+                    producer.region_unknown = true;
+                } else {
+                    merge_boxes(producer.region, it->second);
+                }
+            }
+        }
+    }
+
+    // The Funcs that aren't inlined that a Func's values end up
+    // computed in.
+    void consuming_roots(const FuncInfo &f, set<string> &result) {
+        for (const string &c : f.consumers) {
+            const FuncInfo &consumer = funcs[c];
+            if (consumer.choice == FuncInfo::Inline) {
+                consuming_roots(consumer, result);
+            } else {
+                result.insert(c);
+            }
+        }
+    }
+
+    // Pick tile sizes for the pure loops of a Func computed at root,
+    // so that a tile fits in the cache along with the values
+    // loaded to compute it, and there are enough tiles to keep all
+    // the cores busy.
+    void choose_tiling(FuncInfo &f) {
+        if (!f.known() || f.func.has_extern_definition() || f.func.dimensions() == 0) {
+            return;
+        }
+        int vector_size = target.natural_vector_size(f.func.output_types()[0]);
+        double bytes = std::max(1.0, f.bytes + f.load_bytes);
+        int64_t area = std::max((int64_t)vector_size,
+                                (int64_t)(params.last_level_cache_size / (2 * bytes)));
+        int64_t tx = round_down_to_power_of_two(std::min(std::min(f.extents[0], (int64_t)256), area));
+        if (f.func.dimensions() == 1) {
+            while (tx >= 4 * vector_size && (f.extents[0] + tx - 1) / tx < params.parallelism) {
+                tx /= 2;
+            }
+            f.tile[0] = tx;
+        } else {
+            int64_t ty = round_down_to_power_of_two(std::min(f.extents[1], std::max((int64_t)1, area / tx)));
+            while (ty > 1 && (f.extents[1] + ty - 1) / ty < params.parallelism) {
+                ty /= 2;
+            }
+            f.tile[0] = tx;
+            f.tile[1] = ty;
+        }
+    }
+
+    // How much more of a producer is computed when it's computed
+    // per tile of its consumer, or zero if it can't be.
+    double recompute_factor(const FuncInfo &f, const FuncInfo &consumer) {
+        if (!f.known() || !consumer.known() || consumer.tile[0] == 0 ||
+            consumer.func.has_update_definition() ||
+            f.func.dimensions() != consumer.func.dimensions()) {
+            return 0;
+        }
+        double factor = 1;
+        for (int d = 0; d < f.func.dimensions(); d++) {
+            int64_t halo = f.extents[d] - consumer.extents[d];
+            if (halo < 0) {
+                return 0;
+            }
+            int64_t t = d < 2 && consumer.tile[d] ? consumer.tile[d] : 1;
+            factor *= (double)(t + halo) / t;
+        }
+        return factor;
+    }
+
+    void choose(FuncInfo &f) {
+        const string &name = f.func.name();
+        double evaluations = 0;
+        for (const string &c : f.consumers) {
+            const FuncInfo &consumer = funcs[c];
+            auto it = consumer.calls.find(name);
+            if (it != consumer.calls.end()) {
+                evaluations += it->second * consumer.evaluations;
+            }
+        }
+
+        if (outputs.count(name) || !f.func.can_be_inlined() || !f.known()) {
+            if (outputs.count(name) || !f.func.can_be_inlined()) {
+                f.choice = FuncInfo::Root;
+                f.evaluations = f.points;
+                choose_tiling(f);
+            } else {
+                f.evaluations = evaluations;
+            }
+            return;
+        }
+
+        // The cost of each choice, counting arithmetic as one, loads
+        // that hit in the cache as one, and loads that miss as the
+        // balance.
+        double work = f.ops + f.load_bytes / std::max(1, f.bytes);
+        double inline_cost = evaluations * work;
+
+        double footprint = f.points * f.bytes;
+        double load_cost = footprint <= params.last_level_cache_size ? 1 : params.balance;
+        double root_cost = f.points * work + (f.points + evaluations) * load_cost;
+
+        double fused_cost = -1, factor = 0;
+        set<string> roots;
+        consuming_roots(f, roots);
+        if (roots.size() == 1) {
+            factor = recompute_factor(f, funcs[*roots.begin()]);
+            if (factor > 0) {
+                fused_cost = f.points * factor * work + (f.points * factor + evaluations);
+            }
+        }
+
+        debug(2) << "auto_schedule: " << name << " costs " << inline_cost << " inlined, "
+                 << root_cost << " at root, " << fused_cost << " in tiles\n";
+
+        if (inline_cost <= root_cost && (fused_cost < 0 || inline_cost <= fused_cost)) {
+            f.choice = FuncInfo::Inline;
+            f.evaluations = evaluations;
+        } else if (fused_cost >= 0 && fused_cost <= root_cost) {
+            f.choice = FuncInfo::Fused;
+            f.fused_into = *roots.begin();
+            f.evaluations = f.points * factor;
+        } else {
+            f.choice = FuncInfo::Root;
+            f.evaluations = f.points;
+            choose_tiling(f);
+        }
+    }
+
+    // Apply the schedule chosen for a Func, and write it out.
+    void apply(const FuncInfo &f) {
+        if (f.choice == FuncInfo::Inline) {
+            return;
+        }
+        Func func(f.func);
+        const vector<string> args = f.func.args();
+        const string name = identifier(f.func.name());
+        int vector_size = target.natural_vector_size(f.func.output_types()[0]);
+        std::ostringstream directives;
+
+        if (f.choice == FuncInfo::Fused) {
+            const FuncInfo &consumer = funcs[f.fused_into];
+            string at = consumer.func.args()[0] + "_o";
+            func.compute_at(Func(consumer.func), new_var(at));
+            directives << "\n    .compute_at(" << identifier(f.fused_into) << ", " << identifier(at) << ")";
+            if (f.extents[0] >= vector_size) {
+                func.vectorize(Var(args[0]), vector_size);
+                directives << "\n    .vectorize(" << identifier(args[0]) << ", " << vector_size << ")";
+            }
+        } else {
+            if (!outputs.count(f.func.name())) {
+                func.compute_root();
+                directives << "\n    .compute_root()";
+            }
+            if (f.tile[1]) {
+                string xo = args[0] + "_o", yo = args[1] + "_o", xi = args[0] + "_i", yi = args[1] + "_i";
+                func.tile(Var(args[0]), Var(args[1]), new_var(xo), new_var(yo),
+                          new_var(xi), new_var(yi), (int)f.tile[0], (int)f.tile[1]);
+                directives << "\n    .tile(" << identifier(args[0]) << ", " << identifier(args[1]) << ", "
+                           << identifier(xo) << ", " << identifier(yo) << ", "
+                           << identifier(xi) << ", " << identifier(yi) << ", "
+                           << f.tile[0] << ", " << f.tile[1] << ")";
+                if (f.tile[0] >= vector_size) {
+                    func.vectorize(Var(xi), vector_size);
+                    directives << "\n    .vectorize(" << identifier(xi) << ", " << vector_size << ")";
+                }
+                func.parallel(Var(yo));
+                directives << "\n    .parallel(" << identifier(yo) << ")";
+            } else if (f.tile[0]) {
+                string xo = args[0] + "_o", xi = args[0] + "_i";
+                func.split(Var(args[0]), new_var(xo), new_var(xi), (int)f.tile[0]);
+                directives << "\n    .split(" << identifier(args[0]) << ", " << identifier(xo) << ", "
+                           << identifier(xi) << ", " << f.tile[0] << ")";
+                if (f.tile[0] >= vector_size) {
+                    func.vectorize(Var(xi), vector_size);
+                    directives << "\n    .vectorize(" << identifier(xi) << ", " << vector_size << ")";
+                }
+                func.parallel(Var(xo));
+                directives << "\n    .parallel(" << identifier(xo) << ")";
+            } else if (!args.empty() && !f.func.has_extern_definition()) {
+                func.parallel(Var(args.back()));
+                directives << "\n    .parallel(" << identifier(args.back()) << ")";
+            }
+        }
+
+        if (!directives.str().empty()) {
+            source << name << directives.str() << ";\n";
+        }
+
+        // Vectorize and parallelize the pure dimensions of the
+        // updates, which never race.
+        for (size_t u = 0; u < f.func.updates().size(); u++) {
+            const Definition &def = f.func.updates()[u];
+            vector<int> pure;
+            for (size_t d = 0; d < def.args().size(); d++) {
+                const Variable *v = def.args()[d].as<Variable>();
+                if (v && v->name == args[d]) {
+                    pure.push_back((int)d);
+                }
+            }
+            if (pure.empty()) {
+                continue;
+            }
+            Stage stage = func.update((int)u);
+            source << name << ".update(" << u << ")";
+            int inner = pure.front(), outer = pure.back();
+            bool vectorized = false;
+            if (f.known() && f.extents[inner] >= vector_size) {
+                stage.vectorize(Var(args[inner]), vector_size);
+                source << "\n    .vectorize(" << identifier(args[inner]) << ", " << vector_size << ")";
+                vectorized = true;
+            }
+            if (outer != inner || !vectorized) {
+                stage.parallel(Var(args[outer]));
+                source << "\n    .parallel(" << identifier(args[outer]) << ")";
+            }
+            source << ";\n";
+        }
+    }
+
+public:
+    AutoScheduler(const vector<Function> &output_funcs, const Target &target,
+                  const MachineParams &params) : target(target), params(params) {
+        for (Function f : output_funcs) {
+            map<string, Function> more_funcs = find_transitive_calls(f);
+            env.insert(more_funcs.begin(), more_funcs.end());
+            outputs.insert(f.name());
+        }
+        order = realization_order(output_funcs, env);
+        for (const string &name : order) {
+            funcs[name].func = env[name];
+        }
+    }
+
+    string run(const vector<OutputEstimate> &estimates) {
+        compute_regions(estimates);
+
+        // Consumers are scheduled before their producers, so that
+        // the number of times a producer is evaluated follows from
+        // how its consumers are scheduled.
+        for (size_t i = order.size(); i > 0; i--) {
+            choose(funcs[order[i - 1]]);
+        }
+        for (size_t i = order.size(); i > 0; i--) {
+            apply(funcs[order[i - 1]]);
+        }
+
+        std::ostringstream result;
+        result << "// Schedule chosen by Pipeline::auto_schedule for " << target.to_string() << "\n";
+        if (!new_vars.empty()) {
+            result << "Var ";
+            for (size_t i = 0; i < new_vars.size(); i++) {
+                result << (i ? ", " : "") << identifier(new_vars[i]) << "(\"" << new_vars[i] << "\")";
+            }
+            result << ";\n";
+        }
+        result << source.str();
+        return result.str();
+    }
+};
+
+}  // namespace
+
+string generate_schedules(const vector<Function> &outputs, const Target &target,
+                          const vector<OutputEstimate> &estimates,
+                          const MachineParams &params) {
+    string result = AutoScheduler(outputs, target, params).run(estimates);
+    debug(1) << result;
+    return result;
+}
+
+}
+}
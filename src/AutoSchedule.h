@@ -0,0 +1,31 @@
+#ifndef HALIDE_INTERNAL_AUTO_SCHEDULE_H
+#define HALIDE_INTERNAL_AUTO_SCHEDULE_H
+
+/** \file
+ *
+ * Defines the method that chooses schedules for a pipeline using a
+ * cost model. See Pipeline::auto_schedule.
+ */
+
+#include <string>
+#include <vector>
+
+#include "Function.h"
+#include "Pipeline.h"
+#include "Target.h"
+
+namespace Halide {
+namespace Internal {
+
+/** Schedule all the Funcs that the given outputs depend on, given
+ * estimates of the regions of the outputs computed. Returns the
+ * schedule as C++ source. */
+EXPORT std::string generate_schedules(const std::vector<Function> &outputs,
+                                      const Target &target,
+                                      const std::vector<OutputEstimate> &estimates,
+                                      const MachineParams &params);
+
+}
+}
+
+#endif
@@ -0,0 +1,129 @@
+#include "BoundSmallAllocations.h"
+#include "Bounds.h"
+#include "CodeGen_GPU_Dev.h"
+#include "CodeGen_Internal.h"
+#include "ExprUsesVar.h"
+#include "IRMutator.h"
+#include "IROperator.h"
+#include "Scope.h"
+#include "Simplify.h"
+#include "Substitute.h"
+
+namespace Halide {
+namespace Internal {
+
+using std::vector;
+
+class BoundSmallAllocations : public IRMutator {
+    using IRMutator::visit;
+
+    const Target &target;
+
+    // The bounds of the enclosing lets and loop variables.
+    Scope<Interval> scope;
+
+    // The enclosing lets, outermost first.
+    vector<std::pair<std::string, Expr>> lets;
+
+    void visit(const LetStmt *op) {
+        Interval b = bounds_of_expr_in_scope(op->value, scope);
+        scope.push(op->name, b);
+        lets.push_back({op->name, op->value});
+        IRMutator::visit(op);
+        lets.pop_back();
+        scope.pop(op->name);
+    }
+
+    // Find a constant upper bound for an allocation extent. Extents
+    // are usually a max minus a min, both of which depend on the
+    // enclosing loop variables, so first substitute in the enclosing
+    // lets and simplify so that those can cancel.
+    bool upper_bound(Expr e, int64_t *result) {
+        // Stop after a while, to keep the expression from blowing up.
+        // Any lets left in it still have bounds in the scope.
+        Expr expanded = e;
+        int substitutions = 0;
+        for (size_t i = lets.size(); i > 0 && substitutions < 64; i--) {
+            if (expr_uses_var(expanded, lets[i - 1].first)) {
+                expanded = substitute(lets[i - 1].first, lets[i - 1].second, expanded);
+                substitutions++;
+            }
+        }
+        expanded = simplify(expanded);
+        Expr candidates[] = {
+            simplify(bounds_of_expr_in_scope(expanded, scope).max),
+            simplify(bounds_of_expr_in_scope(e, scope).max),
+            find_constant_bound(expanded, Direction::Upper)
+        };
+        for (const Expr &bound : candidates) {
+            const int64_t *b = bound.defined() ? as_const_int(bound) : nullptr;
+            if (b) {
+                *result = *b;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void visit(const For *op) {
+        if (CodeGen_GPU_Dev::is_gpu_var(op->name) ||
+            (op->device_api != DeviceAPI::None &&
+             op->device_api != DeviceAPI::Host)) {
+            // Allocations on devices are handled by their own
+            // codegen.
+            stmt = op;
+            return;
+        }
+        Interval min_bounds = bounds_of_expr_in_scope(op->min, scope);
+        Interval extent_bounds = bounds_of_expr_in_scope(op->extent, scope);
+        Interval b = Interval::everything();
+        if (min_bounds.is_bounded() && extent_bounds.is_bounded()) {
+            b = Interval(min_bounds.min, min_bounds.max + extent_bounds.max - 1);
+        }
+        scope.push(op->name, b);
+        IRMutator::visit(op);
+        scope.pop(op->name);
+    }
+
+    void visit(const Allocate *op) {
+        if (op->new_expr.defined() ||
+            op->extents.empty() ||
+            op->constant_allocation_size() != 0) {
+            IRMutator::visit(op);
+            return;
+        }
+
+        vector<Expr> bounded_extents;
+        int64_t total_bytes = op->type.bytes();
+        for (Expr e : op->extents) {
+            int64_t b = 0;
+            if (!upper_bound(e, &b) || b <= 0 || b > 0x7fffffff ||
+                total_bytes > (int64_t)0x7fffffff / b) {
+                IRMutator::visit(op);
+                return;
+            }
+            total_bytes *= b;
+            bounded_extents.push_back(make_const(Int(32), b));
+        }
+
+        if (!can_allocation_fit_on_stack(total_bytes, target)) {
+            IRMutator::visit(op);
+            return;
+        }
+
+        debug(3) << "Bounding allocation " << op->name << " to " << total_bytes << " bytes\n";
+        Stmt body = mutate(op->body);
+        stmt = Allocate::make(op->name, op->type, op->memory_type, bounded_extents, op->condition,
+                              body, op->new_expr, op->free_function);
+    }
+
+public:
+    BoundSmallAllocations(const Target &t) : target(t) {}
+};
+
+Stmt bound_small_allocations(Stmt s, const Target &t) {
+    return BoundSmallAllocations(t).mutate(s);
+}
+
+}
+}
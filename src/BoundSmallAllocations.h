@@ -0,0 +1,26 @@
+#ifndef HALIDE_BOUND_SMALL_ALLOCATIONS_H
+#define HALIDE_BOUND_SMALL_ALLOCATIONS_H
+
+/** \file
+ * Defines the lowering pass that gives dynamically-sized allocations
+ * a constant size when they have a small enough upper bound, so that
+ * they can be placed on the stack.
+ */
+
+#include "IR.h"
+#include "Target.h"
+
+namespace Halide {
+namespace Internal {
+
+/** Find dynamically-sized allocations on the host whose extents have
+ * constant upper bounds given the enclosing lets and loops, and whose
+ * total size at those bounds fits on the stack for the target. Replace
+ * their extents with the constant bounds, so that codegen places them
+ * on the stack. Must be called after storage_flattening. */
+Stmt bound_small_allocations(Stmt s, const Target &t);
+
+}
+}
+
+#endif
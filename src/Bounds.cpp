@@ -13,6 +13,7 @@
 #include "ExprUsesVar.h"
 #include "IRMutator.h"
 #include "CSE.h"
+#include "FixedPointIntrinsics.h"
 
 namespace Halide {
 namespace Internal {
@@ -76,6 +77,53 @@ Expr find_constant_bound(Expr e, Direction d) {
     return Expr();
 }
 
+namespace {
+
+// The bounds of Exprs by node, holding on to each Expr to keep its
+// node alive.
+typedef map<const IRNode *, pair<Expr, Interval>> BoundsCache;
+
+// Count the nodes of an Expr as a tree, up to some limit.
+class CountTreeNodes : public IRGraphVisitor {
+    using IRGraphVisitor::visit;
+
+    void include(const Expr &e) {
+        if (count < limit) {
+            count++;
+            e.accept(this);
+        }
+    }
+
+public:
+    int count = 0;
+    const int limit;
+    CountTreeNodes(int l) : limit(l) {}
+};
+
+// Bounds of Exprs that share subexpressions share subexpressions
+// too. If a bound is large as a tree, let-bind its common
+// subexpressions, so that later passes that treat it as a tree (such
+// as simplification) stay linear in size of the DAG.
+Expr share_subexpressions(Expr e) {
+    if (!e.defined() || e.as<Variable>() || is_const(e)) {
+        return e;
+    }
+    CountTreeNodes c(1000);
+    e.accept(&c);
+    if (c.count < c.limit) {
+        return e;
+    }
+    return common_subexpression_elimination(e);
+}
+
+Interval share_subexpressions(Interval i) {
+    bool single_point = i.is_single_point();
+    i.min = share_subexpressions(i.min);
+    i.max = single_point ? i.min : share_subexpressions(i.max);
+    return i;
+}
+
+}  // namespace
 
 class Bounds : public IRVisitor {
 public:
@@ -83,11 +131,37 @@ public:
     Scope<Interval> scope;
     const FuncValueBounds &func_bounds;
 
-    Bounds(const Scope<Interval> *s, const FuncValueBounds &fb) :
-        func_bounds(fb) {
+    Bounds(const Scope<Interval> *s, const FuncValueBounds &fb, BoundsCache *c = nullptr) :
+        func_bounds(fb), cache(c ? c : &own_cache) {
         scope.set_containing_scope(s);
     }
+
+    // Compute the bounds of e, reusing the result if the same node
+    // has been seen before in the same scope. Inlining substitutes
+    // the same Expr for every use of a Func, so the expressions of
+    // deep pipelines share most of their subexpressions, and
+    // visiting them as trees is exponential in the depth.
+    void bounds_of(const Expr &e) {
+        if (e.as<Variable>() || is_const(e)) {
+            e.accept(this);
+            return;
+        }
+        BoundsCache::iterator iter = cache->find(e.get());
+        if (iter != cache->end()) {
+            interval = iter->second.second;
+            return;
+        }
+        e.accept(this);
+        (*cache)[e.get()] = std::make_pair(e, interval);
+    }
+
 private:
+    BoundsCache own_cache;
+    BoundsCache *cache;
+
+    // How many selects we're inside the values of, computing bounds
+    // piecewise.
+    int piecewise_depth = 0;
 
     // Compute the intrinsic bounds of a function.
     void bounds_of_func(string name, int value_index, Type t) {
@@ -133,7 +207,7 @@ private:
 
     void visit(const Cast *op) {
 
-        op->value.accept(this);
+        bounds_of(op->value);
         Interval a = interval;
 
         if (a.is_single_point(op->value)) {
@@ -210,9 +284,9 @@ private:
     }
 
     void visit(const Add *op) {
-        op->a.accept(this);
+        bounds_of(op->a);
         Interval a = interval;
-        op->b.accept(this);
+        bounds_of(op->b);
         Interval b = interval;
 
         if (a.is_single_point(op->a) && b.is_single_point(op->b)) {
@@ -249,9 +323,9 @@ private:
     }
 
     void visit(const Sub *op) {
-        op->a.accept(this);
+        bounds_of(op->a);
         Interval a = interval;
-        op->b.accept(this);
+        bounds_of(op->b);
         Interval b = interval;
 
         if (a.is_single_point(op->a) && b.is_single_point(op->b)) {
@@ -296,10 +370,10 @@ private:
 
     void visit(const Mul *op) {
 
-        op->a.accept(this);
+        bounds_of(op->a);
         Interval a = interval;
 
-        op->b.accept(this);
+        bounds_of(op->b);
         Interval b = interval;
 
         // Move constants to the right
@@ -355,10 +429,10 @@ private:
     }
 
     void visit(const Div *op) {
-        op->a.accept(this);
+        bounds_of(op->a);
         Interval a = interval;
 
-        op->b.accept(this);
+        bounds_of(op->b);
         Interval b = interval;
 
         if (!b.is_bounded()) {
@@ -402,10 +476,10 @@ private:
     }
 
     void visit(const Mod *op) {
-        op->a.accept(this);
+        bounds_of(op->a);
         Interval a = interval;
 
-        op->b.accept(this);
+        bounds_of(op->b);
         if (!interval.is_bounded()) {
             return;
         }
@@ -441,10 +515,10 @@ private:
     }
 
     void visit(const Min *op) {
-        op->a.accept(this);
+        bounds_of(op->a);
         Interval a = interval;
 
-        op->b.accept(this);
+        bounds_of(op->b);
         Interval b = interval;
 
         if (a.is_single_point(op->a) && b.is_single_point(op->b)) {
@@ -457,10 +531,10 @@ private:
 
 
     void visit(const Max *op) {
-        op->a.accept(this);
+        bounds_of(op->a);
         Interval a = interval;
 
-        op->b.accept(this);
+        bounds_of(op->b);
         Interval b = interval;
 
         if (a.is_single_point(op->a) && b.is_single_point(op->b)) {
@@ -507,18 +581,101 @@ private:
         bounds_of_type(op->type);
     }
 
+    // If the condition of a select compares a variable in scope with
+    // something that doesn't depend on the scope, then each value of
+    // the select only applies to part of the variable's interval, and
+    // the bounds of each value can be computed in that part
+    // alone. E.g. select(x < 10, x + 5, x - 5) for x in [0, 100] is in
+    // [5, 95] rather than [-5, 105]. Returns false if the condition
+    // isn't such a comparison.
+    bool piecewise_bounds_of_select(const Select *op, Interval *a, Interval *b) {
+        // Each level of this recomputes the bounds of the values of the
+        // select afresh, so don't nest too deeply.
+        if (piecewise_depth >= 4 || !op->condition.type().is_scalar()) {
+            return false;
+        }
+
+        const LT *lt = op->condition.as<LT>();
+        const LE *le = op->condition.as<LE>();
+        const GT *gt = op->condition.as<GT>();
+        const GE *ge = op->condition.as<GE>();
+        Expr lhs, rhs;
+        if (lt) {lhs = lt->a; rhs = lt->b;}
+        if (le) {lhs = le->a; rhs = le->b;}
+        if (gt) {lhs = gt->a; rhs = gt->b;}
+        if (ge) {lhs = ge->a; rhs = ge->b;}
+        if (!lhs.defined() || lhs.type() != Int(32)) {
+            return false;
+        }
+
+        // Put the variable on the left, so the condition is one of
+        // var < c, var <= c, var > c or var >= c.
+        const Variable *var = lhs.as<Variable>();
+        Expr c = rhs;
+        bool less = lt || le, or_equal = le || ge;
+        if (!var || !scope.contains(var->name) || expr_uses_vars(c, scope)) {
+            var = rhs.as<Variable>();
+            c = lhs;
+            less = !less;
+            if (!var || !scope.contains(var->name) || expr_uses_vars(c, scope)) {
+                return false;
+            }
+        }
+
+        // The parts of the interval where the condition is true and false.
+        Interval i = scope.get(var->name);
+        Interval true_i = i, false_i = i;
+        if (less) {
+            true_i.max = Interval::make_min(i.max, or_equal ? c : c - 1);
+            false_i.min = Interval::make_max(i.min, or_equal ? c + 1 : c);
+        } else {
+            true_i.min = Interval::make_max(i.min, or_equal ? c : c + 1);
+            false_i.max = Interval::make_min(i.max, or_equal ? c - 1 : c);
+        }
+
+        // The bounds of nodes in the values are only valid in each
+        // part, so start the cache afresh.
+        BoundsCache outer_cache;
+        outer_cache.swap(*cache);
+        piecewise_depth++;
+
+        scope.push(var->name, true_i);
+        bounds_of(op->true_value);
+        scope.pop(var->name);
+        *a = interval;
+        cache->clear();
+
+        scope.push(var->name, false_i);
+        bounds_of(op->false_value);
+        scope.pop(var->name);
+        *b = interval;
+
+        piecewise_depth--;
+        cache->swap(outer_cache);
+        return true;
+    }
+
     void visit(const Select *op) {
-        op->true_value.accept(this);
+        Interval a, b;
+        if (piecewise_bounds_of_select(op, &a, &b)) {
+            // One of the parts may be empty, but the bounds of the
+            // other are still right, so their union is too.
+            interval = Interval(Interval::make_min(a.min, b.min),
+                                Interval::make_max(a.max, b.max));
+            return;
+        }
+
+        bounds_of(op->true_value);
         if (!interval.is_bounded()) {
             return;
         }
-        Interval a = interval;
+        a = interval;
 
-        op->false_value.accept(this);
+        bounds_of(op->false_value);
         if (!interval.is_bounded()) {
             return;
         }
-        Interval b = interval;
+        b = interval;
 
         bool const_scalar_condition =
             (op->condition.type().is_scalar() &&
@@ -542,7 +699,7 @@ private:
     }
 
     void visit(const Load *op) {
-        op->index.accept(this);
+        bounds_of(op->index);
         if (interval.is_single_point()) {
             // If the index is const we can return the load of that index
             Expr load_min =
@@ -561,15 +718,23 @@ private:
         Expr lane = op->base + var * op->stride;
         scope.push(var_name, Interval(make_const(var.type(), 0),
                                       make_const(var.type(), op->lanes-1)));
-        lane.accept(this);
+        bounds_of(lane);
         scope.pop(var_name);
     }
 
     void visit(const Broadcast *op) {
-        op->value.accept(this);
+        bounds_of(op->value);
     }
 
     void visit(const Call *op) {
+        // The fixed-point intrinsics are bounded like the arithmetic
+        // they lower to.
+        Expr lowered = lower_fixed_point_intrinsic(op);
+        if (lowered.defined()) {
+            lowered.accept(this);
+            return;
+        }
+
         // If the args are const we can return the call of those args
         // for pure functions. For other types of functions, the same
         // call in two different places might produce different
@@ -578,7 +743,7 @@ private:
         std::vector<Expr> new_args(op->args.size());
         bool const_args = true;
         for (size_t i = 0; i < op->args.size() && const_args; i++) {
-            op->args[i].accept(this);
+            bounds_of(op->args[i]);
             if (interval.is_single_point()) {
                 new_args[i] = interval.min;
             } else {
@@ -619,21 +784,21 @@ private:
         } else if (op->is_intrinsic(Call::likely) ||
                    op->is_intrinsic(Call::likely_if_innermost)) {
             assert(op->args.size() == 1);
-            op->args[0].accept(this);
+            bounds_of(op->args[0]);
         } else if (op->is_intrinsic(Call::return_second)) {
             assert(op->args.size() == 2);
-            op->args[1].accept(this);
+            bounds_of(op->args[1]);
         } else if (op->is_intrinsic(Call::if_then_else)) {
             assert(op->args.size() == 3);
             // Probably more conservative than necessary
             Expr equivalent_select = Select::make(op->args[0], op->args[1], op->args[2]);
-            equivalent_select.accept(this);
+            bounds_of(equivalent_select);
         } else if (op->is_intrinsic(Call::shift_left) ||
                    op->is_intrinsic(Call::shift_right) ||
                    op->is_intrinsic(Call::bitwise_and)) {
             Expr simplified = simplify(op);
             if (!equal(simplified, op)) {
-                simplified.accept(this);
+                bounds_of(simplified);
             } else {
                 // Just use the bounds of the type
                 bounds_of_type(t);
@@ -666,7 +831,7 @@ private:
                                 Call::make(Int(32), Call::buffer_get_max, op->args, Call::Extern));
         } else if (op->is_intrinsic(Call::memoize_expr)) {
             internal_assert(op->args.size() >= 1);
-            op->args[0].accept(this);
+            bounds_of(op->args[0]);
         } else if (op->call_type == Call::Halide) {
             bounds_of_func(op->name, op->value_index, op->type);
         } else {
@@ -676,7 +841,7 @@ private:
     }
 
     void visit(const Let *op) {
-        op->value.accept(this);
+        bounds_of(op->value);
         Interval val = interval;
 
         // We'll either substitute the values in directly, or pass
@@ -706,9 +871,14 @@ private:
             }
         }
 
+        // The bounds of nodes in the body that use the let variable
+        // are only valid inside it, so start the cache afresh.
+        BoundsCache outer_cache;
+        outer_cache.swap(*cache);
         scope.push(op->name, var);
-        op->body.accept(this);
+        bounds_of(op->body);
         scope.pop(op->name);
+        cache->swap(outer_cache);
 
         if (interval.has_lower_bound()) {
             if (val.min.defined() && expr_uses_var(interval.min, min_name)) {
@@ -766,10 +936,16 @@ private:
     }
 };
 
-Interval bounds_of_expr_in_scope(Expr expr, const Scope<Interval> &scope, const FuncValueBounds &fb) {
+namespace {
+
+// The bounds of an Expr, reusing the bounds of any nodes in the cache,
+// which must have been computed in the same scope.
+Interval bounds_of_expr_with_cache(Expr expr, const Scope<Interval> &scope, const FuncValueBounds &fb,
+                                   BoundsCache *cache) {
     //debug(3) << "computing bounds_of_expr_in_scope " << expr << "\n";
-    Bounds b(&scope, fb);
-    expr.accept(&b);
+    Bounds b(&scope, fb, cache);
+    b.bounds_of(expr);
+    b.interval = share_subexpressions(b.interval);
     //debug(3) << "bounds_of_expr_in_scope " << expr << " = " << simplify(b.min) << ", " << simplify(b.max) << "\n";
     if (b.interval.has_lower_bound()) {
         internal_assert(b.interval.min.type().is_scalar())
@@ -784,6 +960,12 @@ Interval bounds_of_expr_in_scope(Expr expr, const Scope<Interval> &scope, const
     return b.interval;
 }
 
+}  // namespace
+
+Interval bounds_of_expr_in_scope(Expr expr, const Scope<Interval> &scope, const FuncValueBounds &fb) {
+    return bounds_of_expr_with_cache(expr, scope, fb, nullptr);
+}
+
 Region region_union(const Region &a, const Region &b) {
     internal_assert(a.size() == b.size()) << "Mismatched dimensionality in region union\n";
     Region result;
@@ -979,6 +1161,12 @@ private:
     Scope<Interval> scope;
     const FuncValueBounds &func_bounds;
 
+    // The bounds of the Exprs seen so far in the current scope. Calls
+    // to the same Func often have args in common, or args with
+    // subexpressions in common, so this is cleared whenever the scope
+    // changes, rather than for each call.
+    BoundsCache bounds_cache;
+
     using IRGraphVisitor::visit;
 
     void visit(const Call *op) {
@@ -1027,7 +1215,7 @@ private:
                 Box b(op->args.size());
                 b.used = const_true();
                 for (size_t i = 0; i < op->args.size(); i++) {
-                    b[i] = bounds_of_expr_in_scope(op->args[i], scope, func_bounds);
+                    b[i] = bounds_of_expr_with_cache(op->args[i], scope, func_bounds, &bounds_cache);
                 }
                 merge_boxes(boxes[op->name], b);
             }
@@ -1061,7 +1249,7 @@ private:
         if (consider_calls) {
             op->value.accept(this);
         }
-        Interval value_bounds = bounds_of_expr_in_scope(op->value, scope, func_bounds);
+        Interval value_bounds = bounds_of_expr_with_cache(op->value, scope, func_bounds, &bounds_cache);
 
         bool fixed = value_bounds.min.same_as(value_bounds.max);
         value_bounds.min = simplify(value_bounds.min);
@@ -1070,16 +1258,20 @@ private:
         if (is_small_enough_to_substitute(value_bounds.min) &&
             (fixed || is_small_enough_to_substitute(value_bounds.max))) {
             scope.push(op->name, value_bounds);
+            bounds_cache.clear();
             op->body.accept(this);
             scope.pop(op->name);
+            bounds_cache.clear();
         } else {
             string max_name = unique_name('t');
             string min_name = unique_name('t');
 
             scope.push(op->name, Interval(Variable::make(op->value.type(), min_name),
                                           Variable::make(op->value.type(), max_name)));
+            bounds_cache.clear();
             op->body.accept(this);
             scope.pop(op->name);
+            bounds_cache.clear();
 
             for (pair<const string, Box> &i : boxes) {
                 Box &box = i.second;
@@ -1178,6 +1370,7 @@ private:
                             }
                         }
                         scope.push(var_a->name, i);
+                        bounds_cache.clear();
                         var_to_pop = var_a->name;
                     } else if (var_b && scope.contains(var_b->name)) {
                         Interval i = scope.get(var_b->name);
@@ -1209,12 +1402,14 @@ private:
                             }
                         }
                         scope.push(var_b->name, i);
+                        bounds_cache.clear();
                         var_to_pop = var_b->name;
                     }
                 }
                 op->then_case.accept(this);
                 if (!var_to_pop.empty()) {
                     scope.pop(var_to_pop);
+                    bounds_cache.clear();
                 }
             } else {
                 // Just take the union over the branches
@@ -1290,8 +1485,10 @@ private:
         }
 
         scope.push(op->name, Interval(min_val, max_val));
+        bounds_cache.clear();
         op->body.accept(this);
         scope.pop(op->name);
+        bounds_cache.clear();
     }
 
     void visit(const Provide *op) {
@@ -1299,7 +1496,7 @@ private:
             if (op->name == func || func.empty()) {
                 Box b(op->args.size());
                 for (size_t i = 0; i < op->args.size(); i++) {
-                    b[i] = bounds_of_expr_in_scope(op->args[i], scope, func_bounds);
+                    b[i] = bounds_of_expr_with_cache(op->args[i], scope, func_bounds, &bounds_cache);
                 }
                 merge_boxes(boxes[op->name], b);
             }
@@ -1494,6 +1691,9 @@ void bounds_test() {
     check(scope, 5-x, -5, 5);
     check(scope, x*(5-x), -50, 50); // We don't expect bounds analysis to understand correlated terms
     check(scope, Select::make(x < 4, x, x+100), 0, 110);
+    check(scope, select(x < 5, x + 5, x - 5), 0, 9);
+    check(scope, select(3 <= x, 10 - x, x), 0, 7);
+    check(scope, select(x > 7, 2*x - 14, 14 - 2*x), 0, 14);
     check(scope, x+y, y, y+10);
     check(scope, x*y, select(y < 0, y*10, 0), select(y < 0, 0, y*10));
     check(scope, x/(x+y), Interval::neg_inf, Interval::pos_inf);
@@ -819,6 +819,17 @@ public:
                 }
 
                 output_box.push_back(Interval(min, (min + extent) - 1));
+
+                // A distributed output only computes this rank's
+                // slice of its buffer.
+                const Distribution &dist = output.schedule().distribution();
+                if (dist.defined() && output.args()[d] == dist.var) {
+                    Expr num_ranks = max(dist.num_ranks, 1);
+                    Expr slice = (extent + num_ranks - 1) / num_ranks;
+                    Expr slice_min = min + dist.rank * slice;
+                    Expr slice_max = Min::make(slice_min + slice, min + extent) - 1;
+                    output_box[d] = Interval(slice_min, slice_max);
+                }
             }
             for (size_t i = 0; i < stages.size(); i++) {
                 Stage &s = stages[i];
@@ -826,6 +837,17 @@ public:
                 s.bounds[make_pair(s.name, s.stage)] = output_box;
             }
         }
+
+        for (const Stage &s : stages) {
+            if (s.stage != 0 || !s.func.schedule().distribution().defined()) continue;
+            bool is_output = false;
+            for (const Function &output : outputs) {
+                is_output |= s.func.same_as(output);
+            }
+            user_assert(is_output)
+                << "Func " << s.func.name() << " is distributed, "
+                << "but only outputs of the pipeline can be distributed.\n";
+        }
     }
 
     using IRMutator::visit;
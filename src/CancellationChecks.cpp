@@ -0,0 +1,41 @@
+#include "CancellationChecks.h"
+#include "InjectHostDevBufferCopies.h"
+#include "IRMutator.h"
+
+namespace Halide {
+namespace Internal {
+
+namespace {
+
+class InjectCancellationChecks : public IRMutator {
+    using IRMutator::visit;
+
+    // Device code can't call into the runtime.
+    bool in_device_code = false;
+
+    void visit(const For *op) {
+        bool old_in_device_code = in_device_code;
+        if (op->device_api != DeviceAPI::None &&
+            op->device_api != DeviceAPI::Host) {
+            in_device_code = true;
+        }
+        IRMutator::visit(op);
+        in_device_code = old_in_device_code;
+    }
+
+    void visit(const ProducerConsumer *op) {
+        IRMutator::visit(op);
+        if (op->is_producer && !in_device_code) {
+            stmt = Block::make(call_extern_and_assert("halide_cancellation_check", {}), stmt);
+        }
+    }
+};
+
+}  // namespace
+
+Stmt inject_cancellation_checks(Stmt s) {
+    return InjectCancellationChecks().mutate(s);
+}
+
+}
+}
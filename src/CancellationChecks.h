@@ -0,0 +1,24 @@
+#ifndef HALIDE_CANCELLATION_CHECKS_H
+#define HALIDE_CANCELLATION_CHECKS_H
+
+/** \file
+ * Defines the lowering pass that makes a pipeline check whether it
+ * has been cancelled before producing each Func.
+ */
+
+#include "IR.h"
+
+namespace Halide {
+namespace Internal {
+
+/** Insert a call to halide_cancellation_check before each produce
+ * node that runs on the host, so that a cancelled pipeline returns
+ * halide_error_code_cancelled at the next one instead of running to
+ * completion. The thread pool separately checks before each parallel
+ * task. Used for targets with the cancellable feature. */
+Stmt inject_cancellation_checks(Stmt s);
+
+}
+}
+
+#endif
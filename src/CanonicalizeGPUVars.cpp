@@ -37,7 +37,8 @@ class CountGPUBlocksThreads : public IRVisitor {
         if (starts_with(op->name, prefix)) {
             if (op->for_type == ForType::GPUBlock) {
                 nblocks++;
-            } else if (op->for_type == ForType::GPUThread) {
+            } else if (op->for_type == ForType::GPUThread ||
+                       op->for_type == ForType::GPULane) {
                 nthreads++;
             }
         }
@@ -115,7 +116,8 @@ class CanonicalizeGPUVars : public IRMutator {
         Stmt body = mutate(op->body);
 
         if ((op->for_type == ForType::GPUBlock) ||
-            (op->for_type == ForType::GPUThread)) {
+            (op->for_type == ForType::GPUThread) ||
+            (op->for_type == ForType::GPULane)) {
 
             vector<string> v = split_string(op->name, ".");
             internal_assert(v.size() > 2);
@@ -130,6 +132,12 @@ class CanonicalizeGPUVars : public IRMutator {
             if (op->for_type == ForType::GPUBlock) {
                 name = gpu_name(v, get_block_name(counter.nblocks));
                 debug(5) << "Replacing " << op->name << " with GPU block name " << name << "\n";
+            } else if (op->for_type == ForType::GPULane) {
+                user_assert(counter.nthreads == 0)
+                    << "The gpu_lanes() loop " << op->name
+                    << " must be the innermost GPU thread loop of its stage.\n";
+                name = gpu_name(v, get_thread_name(0));
+                debug(5) << "Replacing " << op->name << " with GPU lane name " << name << "\n";
             } else if (op->for_type == ForType::GPUThread) {
                 name = gpu_name(v, get_thread_name(counter.nthreads));
                 debug(5) << "Replacing " << op->name << " with GPU thread name " << name << "\n";
@@ -30,11 +30,19 @@ CodeGen_ARM::CodeGen_ARM(Target target) : CodeGen_Posix(target) {
         user_error << "arm not enabled for this build of Halide.";
         #endif
         user_assert(llvm_ARM_enabled) << "llvm build not configured with ARM target enabled\n.";
+        user_assert(!target.has_feature(Target::ARMDotProd) &&
+                    !target.has_feature(Target::ARMFp16) &&
+                    !target.has_feature(Target::ARMSVE))
+            << "The arm_dot_prod, arm_fp16 and arm_sve target features are only supported on 64-bit arm.\n";
     } else {
         #if !(WITH_AARCH64)
         user_error << "aarch64 not enabled for this build of Halide.";
         #endif
         user_assert(llvm_AArch64_enabled) << "llvm build not configured with AArch64 target enabled.\n";
+        #if LLVM_VERSION < 50
+        user_assert(!target.has_feature(Target::ARMSVE))
+            << "The arm_sve target feature requires LLVM 5.0 or later.\n";
+        #endif
     }
 
     // Generate the cast patterns that can take vector types.  We need
@@ -428,7 +436,108 @@ void CodeGen_ARM::visit(const Div *op) {
     CodeGen_Posix::visit(op);
 }
 
+namespace {
+
+// Flatten a tree of Adds into its terms.
+void collect_terms(Expr e, vector<Expr> &terms) {
+    if (const Add *add = e.as<Add>()) {
+        collect_terms(add->a, terms);
+        collect_terms(add->b, terms);
+    } else {
+        terms.push_back(e);
+    }
+}
+
+// If e is a product of two things that are losslessly 8-bit, of the
+// given signedness, return those two things narrowed.
+bool is_widening_8_bit_product(Expr e, bool is_signed, Expr &a, Expr &b) {
+    const Mul *mul = e.as<Mul>();
+    if (!mul) return false;
+    Type narrow = (is_signed ? Int(8) : UInt(8)).with_lanes(e.type().lanes());
+    a = lossless_cast(narrow, mul->a);
+    b = lossless_cast(narrow, mul->b);
+    return a.defined() && b.defined();
+}
+
+}
+
+Value *CodeGen_ARM::call_dot_product(bool is_signed, Value *acc, Value *a, Value *b) {
+    // Each lane of the accumulator gets the sum of the products of
+    // the four bytes of a and b in that lane.
+    int lanes = acc->getType()->getVectorNumElements();
+    int intrin_lanes = lanes % 4 == 0 ? 4 : 2;
+    string name = string("llvm.aarch64.neon.") + (is_signed ? "sdot" : "udot") +
+        ".v" + std::to_string(intrin_lanes) + "i32.v" + std::to_string(intrin_lanes * 4) + "i8";
+    llvm::Type *acc_t = VectorType::get(i32_t, intrin_lanes);
+    llvm::Type *bytes_t = VectorType::get(i8_t, intrin_lanes * 4);
+    llvm::Function *fn = module->getFunction(name);
+    if (!fn) {
+        FunctionType *func_t = FunctionType::get(acc_t, {acc_t, bytes_t, bytes_t}, false);
+        fn = llvm::Function::Create(func_t, llvm::Function::ExternalLinkage, name, module.get());
+    }
+    vector<Value *> results;
+    for (int i = 0; i < lanes; i += intrin_lanes) {
+        results.push_back(builder->CreateCall(fn, {slice_vector(acc, i, intrin_lanes),
+                                                   slice_vector(a, i * 4, intrin_lanes * 4),
+                                                   slice_vector(b, i * 4, intrin_lanes * 4)}));
+    }
+    return slice_vector(concat_vectors(results), 0, lanes);
+}
+
 void CodeGen_ARM::visit(const Add *op) {
+    if (target.has_feature(Target::ARMDotProd) && target.bits == 64 &&
+        !neon_intrinsics_disabled() &&
+        op->type.is_vector() && !op->type.is_float() &&
+        op->type.bits() == 32 && op->type.lanes() % 2 == 0) {
+        // Sums of four or more widening 8-bit products can use
+        // sdot/udot, four products at a time. This is the inner
+        // product of quantized convolutions with the taps unrolled.
+        vector<Expr> terms;
+        collect_terms(op, terms);
+        for (bool is_signed : {false, true}) {
+            vector<Expr> a_args, b_args, rest;
+            for (const Expr &t : terms) {
+                Expr a, b;
+                if (is_widening_8_bit_product(t, is_signed, a, b)) {
+                    a_args.push_back(a);
+                    b_args.push_back(b);
+                } else {
+                    rest.push_back(t);
+                }
+            }
+            if (a_args.size() < 4) {
+                continue;
+            }
+            // Leftover products are added in the usual way.
+            while (a_args.size() % 4) {
+                rest.push_back(cast(op->type, a_args.back()) * cast(op->type, b_args.back()));
+                a_args.pop_back();
+                b_args.pop_back();
+            }
+
+            Value *acc;
+            if (rest.empty()) {
+                acc = Constant::getNullValue(llvm_type_of(op->type));
+            } else {
+                Expr e = rest[0];
+                for (size_t i = 1; i < rest.size(); i++) {
+                    e = e + rest[i];
+                }
+                acc = codegen(e);
+            }
+            for (size_t i = 0; i < a_args.size(); i += 4) {
+                vector<Value *> as, bs;
+                for (size_t j = i; j < i + 4; j++) {
+                    as.push_back(codegen(a_args[j]));
+                    bs.push_back(codegen(b_args[j]));
+                }
+                acc = call_dot_product(is_signed, acc, interleave_vectors(as), interleave_vectors(bs));
+            }
+            value = acc;
+            return;
+        }
+    }
+
     CodeGen_Posix::visit(op);
 }
 
@@ -958,6 +1067,66 @@ void CodeGen_ARM::visit(const Call *op) {
         }
     }
 
+    if (op->is_intrinsic(Call::vector_reduce_add) &&
+        target.has_feature(Target::ARMDotProd) && target.bits == 64 &&
+        !neon_intrinsics_disabled() &&
+        (op->type.is_int() || op->type.is_uint()) &&
+        op->type.bits() == 32 &&
+        op->args[0].type().lanes() % 16 == 0) {
+        // A sum of widening 8-bit products can be accumulated four
+        // products at a time with sdot/udot, and then reduced across
+        // the four lanes of the accumulator.
+        for (bool is_signed : {false, true}) {
+            Expr a, b;
+            if (is_widening_8_bit_product(op->args[0], is_signed, a, b)) {
+                Value *va = codegen(a), *vb = codegen(b);
+                Value *acc = Constant::getNullValue(VectorType::get(i32_t, 4));
+                for (int i = 0; i < a.type().lanes(); i += 16) {
+                    acc = call_dot_product(is_signed, acc, slice_vector(va, i, 16), slice_vector(vb, i, 16));
+                }
+                Expr sum = Call::make(op->type, Call::vector_reduce_add,
+                                      {Variable::make(op->type.with_lanes(4), "dot_product_acc")},
+                                      Call::PureIntrinsic);
+                sym_push("dot_product_acc", acc);
+                value = codegen(sum);
+                sym_pop("dot_product_acc");
+                return;
+            }
+        }
+    }
+
+    if (target.bits == 64 && !neon_intrinsics_disabled() &&
+        (op->type.is_int() || op->type.is_uint()) &&
+        op->type.bits() <= 32 &&
+        op->args.size() == 1 &&
+        op->args[0].type().lanes() * op->type.bits() == 128) {
+        // AArch64 has across-lanes reductions of full vectors: addv,
+        // sminv, umaxv, etc. They all return an i32.
+        const char *across = nullptr;
+        bool is_signed = op->type.is_int();
+        if (op->is_intrinsic(Call::vector_reduce_add)) {
+            across = is_signed ? "saddv" : "uaddv";
+        } else if (op->is_intrinsic(Call::vector_reduce_min)) {
+            across = is_signed ? "sminv" : "uminv";
+        } else if (op->is_intrinsic(Call::vector_reduce_max)) {
+            across = is_signed ? "smaxv" : "umaxv";
+        }
+        if (across) {
+            int lanes = op->args[0].type().lanes();
+            string name = "llvm.aarch64.neon." + string(across) + ".i32.v" +
+                std::to_string(lanes) + "i" + std::to_string(op->type.bits());
+            Value *arg = codegen(op->args[0]);
+            llvm::Function *fn = module->getFunction(name);
+            if (!fn) {
+                FunctionType *func_t = FunctionType::get(i32_t, {arg->getType()}, false);
+                fn = llvm::Function::Create(func_t, llvm::Function::ExternalLinkage, name, module.get());
+            }
+            value = builder->CreateCall(fn, {arg});
+            value = builder->CreateIntCast(value, llvm_type_of(op->type), is_signed);
+            return;
+        }
+    }
+
     CodeGen_Posix::visit(op);
 }
 
@@ -987,11 +1156,29 @@ string CodeGen_ARM::mattrs() const {
             return "-neon";
         }
     } else {
+        string features;
+        string separator;
         if (target.os == Target::IOS || target.os == Target::OSX) {
-            return "+reserve-x18";
-        } else {
-            return "";
+            features += "+reserve-x18";
+            separator = ",";
+        }
+        if (target.has_feature(Target::ARMDotProd)) {
+            features += separator + "+dotprod";
+            separator = ",";
+        }
+        if (target.has_feature(Target::ARMFp16)) {
+            // Float(16) arithmetic then stays in half-precision
+            // vectors rather than being promoted to float.
+            features += separator + "+fullfp16";
+            separator = ",";
+        }
+        if (target.has_feature(Target::ARMSVE)) {
+            // We still vectorize for 128-bit NEON; this lets LLVM
+            // use SVE where it knows how to.
+            features += separator + "+sve";
+            separator = ",";
         }
+        return features;
     }
 }
 
@@ -64,6 +64,11 @@ protected:
     llvm::Value *call_pattern(const Pattern &p, llvm::Type *t, const std::vector<llvm::Value *> &args);
     // @}
 
+    /** Accumulate into each 32-bit lane of acc the dot product of
+     * the four corresponding 8-bit lanes of a and b, using the
+     * ARMv8.2 sdot/udot instructions. */
+    llvm::Value *call_dot_product(bool is_signed, llvm::Value *acc, llvm::Value *a, llvm::Value *b);
+
     std::string mcpu() const;
     std::string mattrs() const;
     bool use_soft_float_abi() const;
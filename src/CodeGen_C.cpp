@@ -9,6 +9,7 @@
 #include "Var.h"
 #include "Lerp.h"
 #include "Simplify.h"
+#include "FixedPointIntrinsics.h"
 
 namespace Halide {
 namespace Internal {
@@ -62,9 +63,11 @@ const string globals =
     "void *halide_print(void *ctx, const void *str);\n"
     "void *halide_error(void *ctx, const void *str);\n"
     "int halide_debug_to_file(void *ctx, const char *filename, int, struct buffer_t *buf);\n"
+    "int halide_debug_to_file_flush(void *ctx);\n"
     "int halide_start_clock(void *ctx);\n"
     "int64_t halide_current_time_ns(void *ctx);\n"
     "void halide_profiler_pipeline_end(void *, void *);\n"
+    "void halide_profiler_release_thread_slot(void *, void *);\n"
     "}\n"
     "\n"
 
@@ -165,6 +168,101 @@ const string globals =
     " }\n"
     " return dst;\n"
     "}\n"
+    "\n"
+
+    // Vector types, for vectorized code. Arithmetic, bitwise ops and
+    // comparisons use the GCC/Clang vector extensions directly; these
+    // helpers do the rest a lane at a time, in loops the compiler
+    // turns back into vector instructions. Vectors of bools are
+    // vectors of uint8_t holding 0 or 1.
+    "#ifdef __GNUC__\n"
+    "template<int N> struct halide_vector_lanes {enum {value = 2 * halide_vector_lanes<(N + 1) / 2>::value};};\n"
+    "template<> struct halide_vector_lanes<1> {enum {value = 1};};\n"
+    "template<typename T, int N> struct halide_vector {\n"
+    "#ifdef __clang__\n"
+    " typedef T type __attribute__((ext_vector_type(N)));\n"
+    "#else\n"
+    " // GCC vectors must have a power of two lanes.\n"
+    " typedef T type __attribute__((vector_size(halide_vector_lanes<N>::value * sizeof(T))));\n"
+    "#endif\n"
+    "};\n"
+    "template<typename T, int N> inline typename halide_vector<T, N>::type halide_vector_broadcast(T x) {\n"
+    " typename halide_vector<T, N>::type r;\n"
+    " for (int i = 0; i < N; i++) r[i] = x;\n"
+    " return r;\n"
+    "}\n"
+    "template<typename T, int N> inline typename halide_vector<T, N>::type halide_vector_ramp(T base, T stride) {\n"
+    " typename halide_vector<T, N>::type r;\n"
+    " for (int i = 0; i < N; i++) r[i] = base + (T)i * stride;\n"
+    " return r;\n"
+    "}\n"
+    "template<typename T, int N> inline typename halide_vector<T, N>::type halide_vector_load(const T *p) {\n"
+    " typename halide_vector<T, N>::type r;\n"
+    " memcpy(&r, p, N * sizeof(T));\n"
+    " return r;\n"
+    "}\n"
+    "template<typename T, int N, typename V> inline void halide_vector_store(T *p, V v) {\n"
+    " memcpy(p, &v, N * sizeof(T));\n"
+    "}\n"
+    "template<typename T, int N, typename I> inline typename halide_vector<T, N>::type halide_vector_gather(const T *p, I idx) {\n"
+    " typename halide_vector<T, N>::type r;\n"
+    " for (int i = 0; i < N; i++) r[i] = p[idx[i]];\n"
+    " return r;\n"
+    "}\n"
+    "template<typename T, int N, typename I, typename V> inline void halide_vector_scatter(T *p, I idx, V v) {\n"
+    " for (int i = 0; i < N; i++) p[idx[i]] = v[i];\n"
+    "}\n"
+    "template<typename T, int N, typename I, typename M>\n"
+    "inline typename halide_vector<T, N>::type halide_vector_predicated_gather(const T *p, I idx, M m) {\n"
+    " typename halide_vector<T, N>::type r;\n"
+    " for (int i = 0; i < N; i++) r[i] = m[i] ? p[idx[i]] : (T)0;\n"
+    " return r;\n"
+    "}\n"
+    "template<typename T, int N, typename I, typename M, typename V>\n"
+    "inline void halide_vector_predicated_scatter(T *p, I idx, M m, V v) {\n"
+    " for (int i = 0; i < N; i++) if (m[i]) p[idx[i]] = v[i];\n"
+    "}\n"
+    "template<typename T, int N, typename V> inline typename halide_vector<T, N>::type halide_vector_cast(V v) {\n"
+    " typename halide_vector<T, N>::type r;\n"
+    " for (int i = 0; i < N; i++) r[i] = (T)v[i];\n"
+    " return r;\n"
+    "}\n"
+    "template<int N, typename M> inline typename halide_vector<uint8_t, N>::type halide_vector_mask(M m) {\n"
+    " typename halide_vector<uint8_t, N>::type r;\n"
+    " for (int i = 0; i < N; i++) r[i] = m[i] != 0;\n"
+    " return r;\n"
+    "}\n"
+    "template<int N, typename M> inline typename halide_vector<uint8_t, N>::type halide_vector_not(M m) {\n"
+    " typename halide_vector<uint8_t, N>::type r;\n"
+    " for (int i = 0; i < N; i++) r[i] = !m[i];\n"
+    " return r;\n"
+    "}\n"
+    "template<typename T, int N, typename M, typename V> inline V halide_vector_select(M m, V t, V f) {\n"
+    " V r;\n"
+    " for (int i = 0; i < N; i++) r[i] = m[i] ? t[i] : f[i];\n"
+    " return r;\n"
+    "}\n"
+    "template<typename T, int N, typename V> inline T halide_vector_reduce_add(V v) {\n"
+    " T r = v[0];\n"
+    " for (int i = 1; i < N; i++) r += v[i];\n"
+    " return r;\n"
+    "}\n"
+    "template<typename T, int N, typename V> inline T halide_vector_reduce_mul(V v) {\n"
+    " T r = v[0];\n"
+    " for (int i = 1; i < N; i++) r *= v[i];\n"
+    " return r;\n"
+    "}\n"
+    "template<typename T, int N, typename V> inline T halide_vector_reduce_min(V v) {\n"
+    " T r = v[0];\n"
+    " for (int i = 1; i < N; i++) r = v[i] < r ? v[i] : r;\n"
+    " return r;\n"
+    "}\n"
+    "template<typename T, int N, typename V> inline T halide_vector_reduce_max(V v) {\n"
+    " T r = v[0];\n"
+    " for (int i = 1; i < N; i++) r = v[i] > r ? v[i] : r;\n"
+    " return r;\n"
+    "}\n"
+    "#endif\n"
     "\n";
 }
 
@@ -186,6 +284,15 @@ CodeGen_C::CodeGen_C(ostream &s, OutputKind output_kind, const std::string &guar
     // (include HalideRuntime.h for the full goodness)
     stream << "struct halide_filter_metadata_t;\n";
 
+    if (is_header()) {
+        // Used by the inline _async wrappers.
+        stream << "#ifdef __cplusplus\n"
+               << "extern \"C\"\n"
+               << "#endif\n"
+               << "int halide_do_async(int (*argv_func)(void **), void **args,\n"
+               << "                    void (*callback)(void *, int), void *callback_context);\n";
+    }
+
     if (!is_header()) {
         stream << globals;
     }
@@ -209,7 +316,16 @@ namespace {
 string type_to_c_type(Type type, bool include_space, bool c_plus_plus = true) {
     bool needs_space = true;
     ostringstream oss;
-    user_assert(type.lanes() == 1) << "Can't use vector types when compiling to C (yet)\n";
+    if (type.is_vector()) {
+        // See halide_vector in the globals above.
+        user_assert(!type.is_handle()) << "Can't use vectors of handles when compiling to C\n";
+        Type elem = type.is_bool() ? UInt(8) : type.element_of();
+        oss << "halide_vector<" << type_to_c_type(elem, false) << ", " << type.lanes() << ">::type";
+        if (include_space) {
+            oss << " ";
+        }
+        return oss.str();
+    }
     if (type.is_float()) {
         if (type.bits() == 32) {
             oss << "float";
@@ -365,7 +481,9 @@ class ExternCallPrototypes : public IRGraphVisitor {
     }
 
     void emit_function_decl(ostream &stream, const Call *op, const std::string &name) {
-        stream << type_to_c_type(op->type, true) << " " << name << "(";
+        // Vector calls are made a lane at a time, so declare the
+        // scalar function.
+        stream << type_to_c_type(op->type.element_of(), true) << " " << name << "(";
         if (function_takes_user_context(name)) {
             stream << "void *";
             if (op->args.size()) {
@@ -379,7 +497,7 @@ class ExternCallPrototypes : public IRGraphVisitor {
             if (op->args[i].as<StringImm>()) {
                 stream << "const char *";
             } else {
-              stream << type_to_c_type(op->args[i].type(), true);
+              stream << type_to_c_type(op->args[i].type().element_of(), true);
             }
         }
         stream << ");\n";
@@ -446,6 +564,7 @@ public:
 }
 
 void CodeGen_C::compile(const Module &input) {
+    target = input.target();
     for (const auto &b : input.buffers()) {
         compile(b);
     }
@@ -591,6 +710,24 @@ void CodeGen_C::compile(const LoweredFunc &f) {
         // declare the argv function.
         stream << "int " << simple_name << "_argv(void **args) HALIDE_FUNCTION_ATTRS;\n";
 
+        // And a wrapper that schedules the argv function onto the
+        // thread pool and returns immediately. It's inline, so it only
+        // references the runtime if it is actually used.
+        stream << "// Runs " << simple_name << "_argv(args) on the Halide thread pool, then calls\n"
+               << "// callback(callback_context, result). args must stay valid until then.\n"
+               << "static inline int " << simple_name << "_async(void **args, "
+               << "void (*callback)(void *, int), void *callback_context) {\n"
+               << " return halide_do_async(" << simple_name << "_argv, args, callback, callback_context);\n"
+               << "}\n";
+
+        // And one that runs it on many argument arrays at once.
+        stream << "// Runs " << simple_name << "_argv on each of args[0] to args[count - 1] as a\n"
+               << "// parallel loop on the Halide thread pool. See halide_do_batch.\n"
+               << "static inline int " << simple_name << "_batch(void *user_context, void **args[], "
+               << "int count, int *results) {\n"
+               << " return halide_do_batch(user_context, " << simple_name << "_argv, args, count, results);\n"
+               << "}\n";
+
         // And also the metadata.
         stream << "// Result is never null and points to constant static data\n";
         stream << "const struct halide_filter_metadata_t *" << simple_name << "_metadata() HALIDE_FUNCTION_ATTRS;\n";
@@ -778,8 +915,57 @@ void CodeGen_C::visit(const Variable *op) {
     id = print_name(op->name);
 }
 
+string CodeGen_C::print_vector_args(Type t) {
+    Type elem = t.is_bool() ? UInt(8) : t.element_of();
+    return print_type(elem) + ", " + std::to_string(t.lanes());
+}
+
+string CodeGen_C::print_shuffle(Type t, const vector<Expr> &vecs, const vector<int> &indices) {
+    vector<string> ids(vecs.size());
+    for (size_t i = 0; i < vecs.size(); i++) {
+        ids[i] = print_expr(vecs[i]);
+    }
+
+    vector<string> lanes;
+    for (int idx : indices) {
+        size_t v = 0;
+        while (idx >= vecs[v].type().lanes()) {
+            idx -= vecs[v].type().lanes();
+            v++;
+            internal_assert(v < vecs.size()) << "Shuffle index out of range\n";
+        }
+        if (vecs[v].type().is_scalar()) {
+            lanes.push_back(ids[v]);
+        } else {
+            lanes.push_back(ids[v] + "[" + std::to_string(idx) + "]");
+        }
+    }
+
+    if (t.is_scalar()) {
+        internal_assert(lanes.size() == 1);
+        return print_assignment(t, lanes[0]);
+    }
+    ostringstream rhs;
+    rhs << "{";
+    for (size_t i = 0; i < lanes.size(); i++) {
+        if (i > 0) rhs << ", ";
+        rhs << lanes[i];
+    }
+    rhs << "}";
+    return print_assignment(t, rhs.str());
+}
+
 void CodeGen_C::visit(const Cast *op) {
-    print_assignment(op->type, "(" + print_type(op->type) + ")(" + print_expr(op->value) + ")");
+    if (op->type.is_vector() && uses_vector_extensions()) {
+        if (op->type.is_bool()) {
+            // Casts to bool are comparisons with zero, not truncations.
+            print_assignment(op->type, "halide_vector_mask<" + std::to_string(op->type.lanes()) + ">(" + print_expr(op->value) + ")");
+        } else {
+            print_assignment(op->type, "halide_vector_cast<" + print_vector_args(op->type) + ">(" + print_expr(op->value) + ")");
+        }
+    } else {
+        print_assignment(op->type, "(" + print_type(op->type) + ")(" + print_expr(op->value) + ")");
+    }
 }
 
 void CodeGen_C::visit_binop(Type t, Expr a, Expr b, const char * op) {
@@ -788,6 +974,18 @@ void CodeGen_C::visit_binop(Type t, Expr a, Expr b, const char * op) {
     print_assignment(t, sa + " " + op + " " + sb);
 }
 
+void CodeGen_C::visit_relop(Type t, Expr a, Expr b, const char *op) {
+    if (t.is_vector() && uses_vector_extensions()) {
+        // Vector comparisons make masks of all ones or all zeros as
+        // wide as the operands. Turn them into vectors of bools.
+        string sa = print_expr(a);
+        string sb = print_expr(b);
+        print_assignment(t, "halide_vector_mask<" + std::to_string(t.lanes()) + ">(" + sa + " " + op + " " + sb + ")");
+    } else {
+        visit_binop(t, a, b, op);
+    }
+}
+
 void CodeGen_C::visit(const Add *op) {
     visit_binop(op->type, op->a, op->b, "+");
 }
@@ -804,7 +1002,12 @@ void CodeGen_C::visit(const Div *op) {
     int bits;
     if (is_const_power_of_two_integer(op->b, &bits)) {
         ostringstream oss;
-        oss << print_expr(op->a) << " >> " << bits;
+        oss << print_expr(op->a) << " >> ";
+        if (op->type.is_vector() && uses_vector_extensions()) {
+            oss << print_expr(make_const(op->type, bits));
+        } else {
+            oss << bits;
+        }
         print_assignment(op->type, oss.str());
     } else if (op->type.is_int()) {
         print_expr(lower_euclidean_div(op->a, op->b));
@@ -817,7 +1020,12 @@ void CodeGen_C::visit(const Mod *op) {
     int bits;
     if (is_const_power_of_two_integer(op->b, &bits)) {
         ostringstream oss;
-        oss << print_expr(op->a) << " & " << ((1 << bits)-1);
+        oss << print_expr(op->a) << " & ";
+        if (op->type.is_vector() && uses_vector_extensions()) {
+            oss << print_expr(make_const(op->type, (1 << bits) - 1));
+        } else {
+            oss << ((1 << bits)-1);
+        }
         print_assignment(op->type, oss.str());
     } else if (op->type.is_int()) {
         print_expr(lower_euclidean_mod(op->a, op->b));
@@ -827,47 +1035,67 @@ void CodeGen_C::visit(const Mod *op) {
 }
 
 void CodeGen_C::visit(const Max *op) {
-    print_expr(Call::make(op->type, "max", {op->a, op->b}, Call::Extern));
+    if (op->type.is_vector() && uses_vector_extensions()) {
+        Expr a = Variable::make(op->type, print_expr(op->a));
+        Expr b = Variable::make(op->type, print_expr(op->b));
+        print_expr(Select::make(a > b, a, b));
+    } else {
+        print_expr(Call::make(op->type, "max", {op->a, op->b}, Call::Extern));
+    }
 }
 
 void CodeGen_C::visit(const Min *op) {
-    print_expr(Call::make(op->type, "min", {op->a, op->b}, Call::Extern));
+    if (op->type.is_vector() && uses_vector_extensions()) {
+        Expr a = Variable::make(op->type, print_expr(op->a));
+        Expr b = Variable::make(op->type, print_expr(op->b));
+        print_expr(Select::make(a < b, a, b));
+    } else {
+        print_expr(Call::make(op->type, "min", {op->a, op->b}, Call::Extern));
+    }
 }
 
 void CodeGen_C::visit(const EQ *op) {
-    visit_binop(op->type, op->a, op->b, "==");
+    visit_relop(op->type, op->a, op->b, "==");
 }
 
 void CodeGen_C::visit(const NE *op) {
-    visit_binop(op->type, op->a, op->b, "!=");
+    visit_relop(op->type, op->a, op->b, "!=");
 }
 
 void CodeGen_C::visit(const LT *op) {
-    visit_binop(op->type, op->a, op->b, "<");
+    visit_relop(op->type, op->a, op->b, "<");
 }
 
 void CodeGen_C::visit(const LE *op) {
-    visit_binop(op->type, op->a, op->b, "<=");
+    visit_relop(op->type, op->a, op->b, "<=");
 }
 
 void CodeGen_C::visit(const GT *op) {
-    visit_binop(op->type, op->a, op->b, ">");
+    visit_relop(op->type, op->a, op->b, ">");
 }
 
 void CodeGen_C::visit(const GE *op) {
-    visit_binop(op->type, op->a, op->b, ">=");
+    visit_relop(op->type, op->a, op->b, ">=");
 }
 
 void CodeGen_C::visit(const Or *op) {
-    visit_binop(op->type, op->a, op->b, "||");
+    // Vectors of bools hold 0 or 1, so bitwise ops on them are
+    // logical ops.
+    bool vector = op->type.is_vector() && uses_vector_extensions();
+    visit_binop(op->type, op->a, op->b, vector ? "|" : "||");
 }
 
 void CodeGen_C::visit(const And *op) {
-    visit_binop(op->type, op->a, op->b, "&&");
+    bool vector = op->type.is_vector() && uses_vector_extensions();
+    visit_binop(op->type, op->a, op->b, vector ? "&" : "&&");
 }
 
 void CodeGen_C::visit(const Not *op) {
-    print_assignment(op->type, "!(" + print_expr(op->a) + ")");
+    if (op->type.is_vector() && uses_vector_extensions()) {
+        print_assignment(op->type, "halide_vector_not<" + std::to_string(op->type.lanes()) + ">(" + print_expr(op->a) + ")");
+    } else {
+        print_assignment(op->type, "!(" + print_expr(op->a) + ")");
+    }
 }
 
 void CodeGen_C::visit(const IntImm *op) {
@@ -937,7 +1165,10 @@ void CodeGen_C::visit(const Call *op) {
     ostringstream rhs;
 
     // Handle intrinsics first
-    if (op->is_intrinsic(Call::debug_to_file)) {
+    Expr fixed_point = lower_fixed_point_intrinsic(op);
+    if (fixed_point.defined()) {
+        rhs << print_expr(fixed_point);
+    } else if (op->is_intrinsic(Call::debug_to_file)) {
         internal_assert(op->args.size() == 3);
         const StringImm *string_imm = op->args[0].as<StringImm>();
         internal_assert(string_imm);
@@ -1162,10 +1393,111 @@ void CodeGen_C::visit(const Call *op) {
             " Halide.\n";
     } else if (op->is_intrinsic(Call::indeterminate_expression)) {
         user_error << "Indeterminate expression occurred during constant-folding.\n";
+    } else if (op->is_intrinsic(Call::shuffle_vector)) {
+        internal_assert((int)op->args.size() == 1 + op->type.lanes());
+        vector<int> indices;
+        for (size_t i = 1; i < op->args.size(); i++) {
+            const int64_t *idx = as_const_int(op->args[i]);
+            internal_assert(idx);
+            indices.push_back((int)*idx);
+        }
+        rhs << print_shuffle(op->type, {op->args[0]}, indices);
+    } else if (op->is_intrinsic(Call::slice_vector)) {
+        internal_assert(op->args.size() == 4);
+        const int64_t *start = as_const_int(op->args[1]);
+        const int64_t *stride = as_const_int(op->args[2]);
+        internal_assert(start && stride) << "argument to slice_vector must be a constant.\n";
+        vector<int> indices;
+        for (int i = 0; i < op->type.lanes(); i++) {
+            indices.push_back((int)(*start + *stride * i));
+        }
+        rhs << print_shuffle(op->type, {op->args[0]}, indices);
+    } else if (op->is_intrinsic(Call::interleave_vectors)) {
+        int factor = (int)op->args.size();
+        int lanes = op->args[0].type().lanes();
+        vector<int> indices;
+        for (int i = 0; i < lanes; i++) {
+            for (int j = 0; j < factor; j++) {
+                indices.push_back(j * lanes + i);
+            }
+        }
+        rhs << print_shuffle(op->type, op->args, indices);
+    } else if (op->is_intrinsic(Call::concat_vectors)) {
+        vector<int> indices;
+        for (int i = 0; i < op->type.lanes(); i++) {
+            indices.push_back(i);
+        }
+        rhs << print_shuffle(op->type, op->args, indices);
+    } else if (op->is_intrinsic(Call::vector_reduce_add) ||
+               op->is_intrinsic(Call::vector_reduce_mul) ||
+               op->is_intrinsic(Call::vector_reduce_min) ||
+               op->is_intrinsic(Call::vector_reduce_max)) {
+        internal_assert(op->args.size() == 1 && op->type.is_scalar());
+        Type t = op->args[0].type();
+        string v = print_expr(op->args[0]);
+        if (t.is_scalar()) {
+            rhs << v;
+        } else {
+            // Call::vector_reduce_add is "vector_reduce_add", and so on.
+            rhs << "halide_" << op->name << "<" << print_vector_args(t) << ">(" << v << ")";
+        }
+    } else if (op->is_intrinsic(Call::predicated_load)) {
+        internal_assert(op->args.size() == 2);
+        const Call *addr = op->args[0].as<Call>();
+        internal_assert(addr && addr->is_intrinsic(Call::address_of));
+        const Load *l = addr->args[0].as<Load>();
+        internal_assert(l);
+        string idx = print_expr(l->index);
+        string pred = print_expr(op->args[1]);
+        Type elem = op->type.is_bool() ? UInt(8) : op->type.element_of();
+        rhs << "halide_vector_predicated_gather<" << print_vector_args(op->type) << ">((const "
+            << print_type(elem) << " *)" << print_name(l->name) << ", " << idx << ", " << pred << ")";
+    } else if (op->is_intrinsic(Call::predicated_store)) {
+        internal_assert(op->args.size() == 3);
+        const Call *addr = op->args[0].as<Call>();
+        internal_assert(addr && addr->is_intrinsic(Call::address_of));
+        const Load *l = addr->args[0].as<Load>();
+        internal_assert(l);
+        Type t = op->args[2].type();
+        string idx = print_expr(l->index);
+        string pred = print_expr(op->args[1]);
+        string value = print_expr(op->args[2]);
+        Type elem = t.is_bool() ? UInt(8) : t.element_of();
+        do_indent();
+        stream << "halide_vector_predicated_scatter<" << print_vector_args(t) << ">(("
+               << print_type(elem) << " *)" << print_name(l->name) << ", "
+               << idx << ", " << pred << ", " << value << ");\n";
+        cache.clear();
+        rhs << "0";
     } else if (op->call_type == Call::Intrinsic ||
                op->call_type == Call::PureIntrinsic) {
         // TODO: other intrinsics
         internal_error << "Unhandled intrinsic in C backend: " << op->name << '\n';
+    } else if (op->type.is_vector() && uses_vector_extensions()) {
+        // Make vector calls to extern functions a lane at a time.
+        vector<string> args(op->args.size());
+        for (size_t i = 0; i < op->args.size(); i++) {
+            args[i] = print_expr(op->args[i]);
+        }
+        string result_id = unique_name('_');
+        do_indent();
+        stream << print_type(op->type, AppendSpace) << result_id << ";\n";
+        for (int lane = 0; lane < op->type.lanes(); lane++) {
+            do_indent();
+            stream << result_id << "[" << lane << "] = " << op->name << "(";
+            if (function_takes_user_context(op->name)) {
+                stream << (have_user_context ? "__user_context_, " : "nullptr, ");
+            }
+            for (size_t i = 0; i < op->args.size(); i++) {
+                if (i > 0) stream << ", ";
+                stream << args[i];
+                if (op->args[i].type().is_vector()) {
+                    stream << "[" << lane << "]";
+                }
+            }
+            stream << ");\n";
+        }
+        rhs << result_id;
     } else {
         // Generic calls
         vector<string> args(op->args.size());
@@ -1191,6 +1523,21 @@ void CodeGen_C::visit(const Call *op) {
 void CodeGen_C::visit(const Load *op) {
 
     Type t = op->type;
+
+    if (t.is_vector() && uses_vector_extensions()) {
+        Type elem = t.is_bool() ? UInt(8) : t.element_of();
+        string ptr = "(const " + print_type(elem) + " *)" + print_name(op->name);
+        ostringstream rhs;
+        const Ramp *ramp = op->index.as<Ramp>();
+        if (ramp && is_one(ramp->stride)) {
+            rhs << "halide_vector_load<" << print_vector_args(t) << ">(" << ptr << " + " << print_expr(ramp->base) << ")";
+        } else {
+            rhs << "halide_vector_gather<" << print_vector_args(t) << ">(" << ptr << ", " << print_expr(op->index) << ")";
+        }
+        print_assignment(t, rhs.str());
+        return;
+    }
+
     bool type_cast_needed =
         !allocations.contains(op->name) ||
         allocations.get(op->name).type != t;
@@ -1216,6 +1563,26 @@ void CodeGen_C::visit(const Store *op) {
 
     Type t = op->value.type();
 
+    if (t.is_vector() && uses_vector_extensions()) {
+        Type elem = t.is_bool() ? UInt(8) : t.element_of();
+        string ptr = "(" + print_type(elem) + " *)" + print_name(op->name);
+        const Ramp *ramp = op->index.as<Ramp>();
+        string id_value = print_expr(op->value);
+        if (ramp && is_one(ramp->stride)) {
+            string id_base = print_expr(ramp->base);
+            do_indent();
+            stream << "halide_vector_store<" << print_vector_args(t) << ">("
+                   << ptr << " + " << id_base << ", " << id_value << ");\n";
+        } else {
+            string id_index = print_expr(op->index);
+            do_indent();
+            stream << "halide_vector_scatter<" << print_vector_args(t) << ">("
+                   << ptr << ", " << id_index << ", " << id_value << ");\n";
+        }
+        cache.clear();
+        return;
+    }
+
     bool type_cast_needed =
         t.is_handle() ||
         !allocations.contains(op->name) ||
@@ -1243,6 +1610,17 @@ void CodeGen_C::visit(const Store *op) {
     cache.clear();
 }
 
+void CodeGen_C::visit(const Ramp *op) {
+    string id_base = print_expr(op->base);
+    string id_stride = print_expr(op->stride);
+    print_assignment(op->type, "halide_vector_ramp<" + print_vector_args(op->type) + ">(" + id_base + ", " + id_stride + ")");
+}
+
+void CodeGen_C::visit(const Broadcast *op) {
+    string id_value = print_expr(op->value);
+    print_assignment(op->type, "halide_vector_broadcast<" + print_vector_args(op->type) + ">(" + id_value + ")");
+}
+
 void CodeGen_C::visit(const Let *op) {
     string id_value = print_expr(op->value);
     Expr new_var = Variable::make(op->value.type(), id_value);
@@ -1255,6 +1633,12 @@ void CodeGen_C::visit(const Select *op) {
     string true_val = print_expr(op->true_value);
     string false_val = print_expr(op->false_value);
     string cond = print_expr(op->condition);
+    if (op->condition.type().is_vector() && uses_vector_extensions()) {
+        rhs << "halide_vector_select<" << print_vector_args(op->type) << ">("
+            << cond << ", " << true_val << ", " << false_val << ")";
+        print_assignment(op->type, rhs.str());
+        return;
+    }
     rhs << "(" << print_type(op->type) << ")"
         << "(" << cond
         << " ? " << true_val
@@ -1298,9 +1682,16 @@ void CodeGen_C::visit(const ProducerConsumer *op) {
 }
 
 void CodeGen_C::visit(const For *op) {
+    user_assert(!ends_with(op->name, ".__async"))
+        << "Can't emit the async producer of " << op->name.substr(0, op->name.size() - 8)
+        << " to C, because its tasks must run concurrently\n";
     if (op->for_type == ForType::Parallel) {
         do_indent();
-        stream << "#pragma omp parallel for\n";
+        // OpenMP's guided schedule is the nearest thing to
+        // halide_do_par_for_adaptive.
+        stream << "#pragma omp parallel for"
+               << (ends_with(op->name, ".__adaptive") ? " schedule(guided)" : "")
+               << "\n";
     } else {
         internal_assert(op->for_type == ForType::Serial)
             << "Can only emit serial or parallel for loops to C\n";
@@ -1332,6 +1723,7 @@ void CodeGen_C::visit(const Provide *op) {
 }
 
 void CodeGen_C::visit(const Allocate *op) {
+    check_register_allocation(op);
     open_scope();
 
     // For sizes less than 8k, do a stack allocation
@@ -1355,11 +1747,13 @@ void CodeGen_C::visit(const Allocate *op) {
                            << op->name << " is constant but exceeds 2^31 - 1.\n";
             } else {
                 size_id = print_expr(Expr(static_cast<int32_t>(constant_size)));
-                if (can_allocation_fit_on_stack(stack_bytes)) {
+                if (allocation_goes_on_stack(op->name, op->memory_type, stack_bytes, target)) {
                     on_stack = true;
                 }
             }
         } else {
+            allocation_goes_on_stack(op->name, op->memory_type, 0, target);
+
             // Check that the allocation is not scalar (if it were scalar
             // it would have constant size).
             internal_assert(op->extents.size() > 0);
@@ -1481,6 +1875,11 @@ void CodeGen_C::visit(const Evaluate *op) {
     stream << "(void)" << id << ";\n";
 }
 
+void CodeGen_C::visit(const Atomic *op) {
+    user_error << "Can't emit the atomic update of " << op->name
+               << " as C. Atomic updates are only supported by the LLVM-based backends.\n";
+}
+
 void CodeGen_C::test() {
     LoweredArgument buffer_arg("buf", Argument::OutputBuffer, Int(32), 3);
     LoweredArgument float_arg("alpha", Argument::InputScalar, Float(32), 0);
@@ -1494,9 +1893,9 @@ void CodeGen_C::test() {
     Stmt s = Store::make("buf", e, x, Parameter());
     s = LetStmt::make("x", beta+1, s);
     s = Block::make(s, Free::make("tmp.stack"));
-    s = Allocate::make("tmp.stack", Int(32), {127}, const_true(), s);
+    s = Allocate::make("tmp.stack", Int(32), MemoryType::Stack, {127}, const_true(), s);
     s = Block::make(s, Free::make("tmp.heap"));
-    s = Allocate::make("tmp.heap", Int(32), {43, beta}, const_true(), s);
+    s = Allocate::make("tmp.heap", Int(32), MemoryType::Heap, {43, beta}, const_true(), s);
 
     Module m("", get_host_target());
     m.append(LoweredFunc("test1", args, s, LoweredFunc::External));
@@ -55,6 +55,9 @@ protected:
      * definitions and whether the interface us extern "C" or C++. */
     OutputKind output_kind;
 
+    /** The target of the module being compiled. */
+    Target target;
+
     /** A cache of generated values in scope */
     std::map<std::string, std::string> cache;
 
@@ -83,6 +86,20 @@ protected:
     /** Emit a statement to reinterpret an expression as another type */
     virtual std::string print_reinterpret(Type, Expr);
 
+    /** Whether vector types are emitted with the GCC/Clang vector
+     * extensions, with the operations they lack emulated a lane at a
+     * time. Subclasses emitting a language with vector types of its
+     * own return false, and print vectors themselves. */
+    virtual bool uses_vector_extensions() const { return true; }
+
+    /** Emit the template arguments of the vector helpers for a vector
+     * type, e.g. "int32_t, 4" */
+    std::string print_vector_args(Type t);
+
+    /** Emit the vector (or scalar) made of the given lanes of the
+     * concatenation of some vectors. */
+    std::string print_shuffle(Type t, const std::vector<Expr> &vecs, const std::vector<int> &indices);
+
     /** Emit a version of a string that is a valid identifier in C (. is replaced with _) */
     virtual std::string print_name(const std::string &);
 
@@ -167,6 +184,8 @@ protected:
     void visit(const Select *);
     void visit(const Load *);
     void visit(const Store *);
+    void visit(const Ramp *);
+    void visit(const Broadcast *);
     void visit(const Let *);
     void visit(const LetStmt *);
     void visit(const AssertStmt *);
@@ -178,8 +197,10 @@ protected:
     void visit(const Realize *);
     void visit(const IfThenElse *);
     void visit(const Evaluate *);
+    void visit(const Atomic *);
 
     void visit_binop(Type t, Expr a, Expr b, const char *op);
+    void visit_relop(Type t, Expr a, Expr b, const char *op);
 };
 
 }
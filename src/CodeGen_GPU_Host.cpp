@@ -12,6 +12,7 @@
 #include "CodeGen_Internal.h"
 #include "Util.h"
 #include "ExprUsesVar.h"
+#include "GPULaunchBounds.h"
 #include "Simplify.h"
 #include "VaryingAttributes.h"
 
@@ -240,6 +241,19 @@ void CodeGen_GPU_Host<CodeGen_CPU>::visit(const For *loop) {
                  << bounds.num_blocks[2] << ", "
                  << bounds.num_blocks[3] << ") blocks\n";
 
+        // Kernels promised to run with fewer threads per block than
+        // this will fail to launch.
+        GPULaunchBounds launch_bounds = gpu_launch_bounds_of_loop(loop->name);
+        if (launch_bounds.max_threads > 0) {
+            Expr threads = simplify(bounds.num_threads[0] * bounds.num_threads[1] *
+                                    bounds.num_threads[2] * bounds.num_threads[3]);
+            const int64_t *t = as_const_int(threads);
+            user_assert(!t || *t <= launch_bounds.max_threads)
+                << "A kernel for loop " << loop->name << " is launched with " << *t
+                << " threads per block, but its schedule promises at most "
+                << launch_bounds.max_threads << " with gpu_launch_bounds.\n";
+        }
+
         // compile the kernel
         string kernel_name = unique_name("kernel_" + loop->name);
         for (size_t i = 0; i < kernel_name.size(); i++) {
@@ -400,7 +414,15 @@ void CodeGen_GPU_Host<CodeGen_CPU>::visit(const For *loop) {
                                     0,
                                     i));
 
-            builder->CreateStore(ConstantInt::get(i8_t, closure_args[i].is_buffer),
+            // Any non-zero value marks a buffer. Buffers the kernel
+            // only reads are marked 2 instead of 1, so that runtimes
+            // tracking dependencies between kernels can let readers
+            // run concurrently.
+            int is_buffer = 0;
+            if (closure_args[i].is_buffer) {
+                is_buffer = (closure_args[i].read && !closure_args[i].write) ? 2 : 1;
+            }
+            builder->CreateStore(ConstantInt::get(i8_t, is_buffer),
                                  builder->CreateConstGEP2_32(
                                     gpu_arg_is_buffer_arr_type,
                                     gpu_arg_is_buffer_arr,
@@ -1,4 +1,5 @@
 #include <iostream>
+#include <mutex>
 #include <sstream>
 
 #include "LLVM_Headers.h"
@@ -16,6 +17,7 @@
 #include "AlignLoads.h"
 #include "CSE.h"
 #include "LoopCarry.h"
+#include "FixedPointIntrinsics.h"
 
 namespace Halide {
 namespace Internal {
@@ -51,6 +53,8 @@ CodeGen_Hexagon::CodeGen_Hexagon(Target t) : CodeGen_Posix(t) {
 std::unique_ptr<llvm::Module> CodeGen_Hexagon::compile(const Module &module) {
     auto llvm_module = CodeGen_Posix::compile(module);
     static bool options_processed = false;
+    static std::mutex options_mutex;
+    std::lock_guard<std::mutex> lock(options_mutex);
 
     // TODO: This should be set on the module itself, or some other
     // safer way to pass this through to the target specific lowering
@@ -162,9 +166,13 @@ void CodeGen_Hexagon::compile_func(const LoweredFunc &f,
     body = eliminate_bool_vectors(body);
     debug(2) << "Lowering after eliminating boolean vectors: " << body << "\n\n";
 
+    // The instruction selection below works on the arithmetic the
+    // fixed-point intrinsics lower to.
+    body = lower_fixed_point_intrinsics(body);
+
     // Optimize the IR for Hexagon.
     debug(1) << "Optimizing Hexagon instructions...\n";
-    body = optimize_hexagon_instructions(body);
+    body = optimize_hexagon_instructions(body, target);
 
     if (uses_hvx(body)) {
         debug(1) << "Adding calls to qurt_hvx_lock...\n";
@@ -473,6 +481,27 @@ void CodeGen_Hexagon::init_module() {
         define_hvx_intrinsic(i.id, i.ret_type, i.name, i.arg_types,
                              i.flags & HvxIntrinsic::BroadcastScalarsToWords);
     }
+
+#if LLVM_VERSION >= 50
+    // Instructions added in v62. Without these, the ops fall back to
+    // the v60 instructions above (e.g. max.vb.vb becomes a compare
+    // and a select).
+    HvxIntrinsic intrinsic_wrappers_v62[] = {
+        { IPICK(is_128B, Intrinsic::hexagon_V6_vmaxb), i8v1, "max.vb.vb", {i8v1, i8v1} },
+        { IPICK(is_128B, Intrinsic::hexagon_V6_vminb), i8v1, "min.vb.vb", {i8v1, i8v1} },
+
+        { IPICK(is_128B, Intrinsic::hexagon_V6_vaddbsat),  i8v1,  "satb_add.vb.vb",   {i8v1,  i8v1} },
+        { IPICK(is_128B, Intrinsic::hexagon_V6_vadduwsat), u32v1, "satuw_add.vuw.vuw", {u32v1, u32v1} },
+        { IPICK(is_128B, Intrinsic::hexagon_V6_vsubbsat),  i8v1,  "satb_sub.vb.vb",   {i8v1,  i8v1} },
+        { IPICK(is_128B, Intrinsic::hexagon_V6_vsubuwsat), u32v1, "satuw_sub.vuw.vuw", {u32v1, u32v1} },
+    };
+    if (target.has_feature(Target::HVX_v62)) {
+        for (HvxIntrinsic &i : intrinsic_wrappers_v62) {
+            define_hvx_intrinsic(i.id, i.ret_type, i.name, i.arg_types,
+                                 i.flags & HvxIntrinsic::BroadcastScalarsToWords);
+        }
+    }
+#endif
 }
 
 llvm::Function *CodeGen_Hexagon::define_hvx_intrinsic(int id, Type ret_ty, const string &name,
@@ -2,6 +2,7 @@
 #include "IROperator.h"
 #include "CSE.h"
 #include "Debug.h"
+#include "IRPrinter.h"
 
 namespace Halide {
 namespace Internal {
@@ -108,10 +109,14 @@ llvm::Type *llvm_type_of(LLVMContext *c, Halide::Type t) {
 // functions that takes a user_context pointer as its first parameter.
 bool function_takes_user_context(const std::string &name) {
     static const char *user_context_runtime_funcs[] = {
+        "halide_buffer_copy",
+        "halide_cancellation_check",
         "halide_copy_to_host",
         "halide_copy_to_device",
+        "halide_copy_to_device_region",
         "halide_current_time_ns",
         "halide_debug_to_file",
+        "halide_debug_to_file_flush",
         "halide_device_free",
         "halide_device_host_nop_free",
         "halide_device_free_as_destructor",
@@ -120,16 +125,22 @@ bool function_takes_user_context(const std::string &name) {
         "halide_device_malloc",
         "halide_device_and_host_malloc",
         "halide_device_sync",
+        "halide_do_concurrent_tasks",
         "halide_do_par_for",
+        "halide_do_par_for_adaptive",
         "halide_do_task",
         "halide_error",
         "halide_free",
         "halide_malloc",
+        "halide_merge_host_region",
+        "halide_pgo_register",
+        "halide_pgo_write_profile",
         "halide_print",
         "halide_profiler_memory_allocate",
         "halide_profiler_memory_free",
         "halide_profiler_pipeline_start",
         "halide_profiler_pipeline_end",
+        "halide_profiler_set_func_estimates",
         "halide_profiler_stack_peak_update",
         "halide_spawn_thread",
         "halide_device_release",
@@ -140,6 +151,8 @@ bool function_takes_user_context(const std::string &name) {
         "halide_memoization_cache_store",
         "halide_memoization_cache_release",
         "halide_cuda_run",
+        "halide_cuda_set_launch_device",
+        "halide_cuda_join_devices",
         "halide_opencl_run",
         "halide_opengl_run",
         "halide_openglcompute_run",
@@ -149,12 +162,18 @@ bool function_takes_user_context(const std::string &name) {
         "halide_msan_annotate_memory_is_initialized",
         "halide_hexagon_initialize_kernels",
         "halide_hexagon_run",
+        "halide_hexagon_run_async",
+        "halide_hexagon_wait",
         "halide_hexagon_device_release",
         "halide_hexagon_power_hvx_on",
         "halide_hexagon_power_hvx_on_mode",
         "halide_hexagon_power_hvx_on_perf",
         "halide_hexagon_power_hvx_off",
         "halide_hexagon_power_hvx_off_as_destructor",
+        "halide_hexagon_set_power_policy",
+        "halide_hexagon_set_arena_size",
+        "halide_vtcm_malloc",
+        "halide_vtcm_free",
         "halide_qurt_hvx_lock",
         "halide_qurt_hvx_unlock",
         "halide_qurt_hvx_unlock_as_destructor",
@@ -176,11 +195,87 @@ bool function_takes_user_context(const std::string &name) {
     return starts_with(name, "halide_error_");
 }
 
-bool can_allocation_fit_on_stack(int64_t size) {
+bool can_allocation_fit_on_stack(int64_t size, const Target &target) {
     user_assert(size > 0) << "Allocation size should be a positive number\n";
+    if (target.has_feature(Target::LargeStack)) {
+        return (size <= 1024 * 256);
+    }
     return (size <= 1024 * 16);
 }
 
+bool allocation_goes_on_stack(const string &name, MemoryType memory_type,
+                              int64_t constant_bytes, const Target &target) {
+    switch (memory_type) {
+    case MemoryType::Auto:
+        return constant_bytes > 0 && can_allocation_fit_on_stack(constant_bytes, target);
+    case MemoryType::Heap:
+        return false;
+    case MemoryType::Stack:
+    case MemoryType::Register:
+        user_assert(constant_bytes > 0)
+            << "Func " << name << " is stored in " << memory_type
+            << " memory, but the size of its allocation isn't constant. "
+            << "Use bound or bound_extent to make it constant.\n";
+        return true;
+    case MemoryType::GPUShared:
+        user_error << "Func " << name << " is stored in GPUShared memory, "
+                   << "but it isn't allocated inside a GPU kernel.\n";
+        break;
+    case MemoryType::VTCM:
+        user_assert(target.arch == Target::Hexagon)
+            << "Func " << name << " is stored in VTCM memory, "
+            << "but it isn't allocated inside a loop offloaded to Hexagon.\n";
+        return false;
+    }
+    return false;
+}
+
+namespace {
+
+class CheckRegisterAccesses : public IRVisitor {
+    const string &name;
+
+    using IRVisitor::visit;
+
+    void check(Expr index) {
+        if (const Ramp *r = index.as<Ramp>()) {
+            index = r->base;
+        } else if (const Broadcast *b = index.as<Broadcast>()) {
+            index = b->value;
+        }
+        user_assert(is_const(index))
+            << "Func " << name << " is stored in Register memory, but it is accessed at "
+            << "the index " << index << ", which isn't constant. Unroll or vectorize "
+            << "the loops over it.\n";
+    }
+
+    void visit(const Load *op) {
+        if (op->name == name) {
+            check(op->index);
+        }
+        IRVisitor::visit(op);
+    }
+
+    void visit(const Store *op) {
+        if (op->name == name) {
+            check(op->index);
+        }
+        IRVisitor::visit(op);
+    }
+
+public:
+    CheckRegisterAccesses(const string &n) : name(n) {}
+};
+
+}  // namespace
+
+void check_register_allocation(const Allocate *op) {
+    if (op->memory_type == MemoryType::Register) {
+        CheckRegisterAccesses check(op->name);
+        op->body.accept(&check);
+    }
+}
+
 Expr lower_euclidean_div(Expr a, Expr b) {
     internal_assert(a.type() == b.type());
     // IROperator's div_round_to_zero will replace this with a / b for
@@ -249,6 +344,22 @@ bool get_md_bool(llvm::Metadata *value, bool &result) {
     return true;
 }
 
+bool get_md_int(llvm::Metadata *value, int &result) {
+    if (!value) {
+        return false;
+    }
+    llvm::ConstantAsMetadata *cam = llvm::cast<llvm::ConstantAsMetadata>(value);
+    if (!cam) {
+        return false;
+    }
+    llvm::ConstantInt *c = llvm::cast<llvm::ConstantInt>(cam->getValue());
+    if (!c) {
+        return false;
+    }
+    result = (int)c->getSExtValue();
+    return true;
+}
+
 bool get_md_string(llvm::Metadata *value, std::string &result) {
     if (!value) {
         result = "";
@@ -316,6 +427,42 @@ void clone_target_options(const llvm::Module &from, llvm::Module &to) {
     if (get_md_string(from.getModuleFlag("halide_mattrs"), mattrs)) {
         to.addModuleFlag(llvm::Module::Warning, "halide_mattrs", llvm::MDString::get(context, mattrs));
     }
+
+    int opt_level = 0;
+    if (get_md_int(from.getModuleFlag("halide_opt_level"), opt_level)) {
+        to.addModuleFlag(llvm::Module::Warning, "halide_opt_level", opt_level);
+    }
+}
+
+int llvm_opt_level(const Target &t) {
+    if (t.has_feature(Target::LLVMOpt1)) {
+        return 1;
+    } else if (t.has_feature(Target::LLVMOpt2)) {
+        return 2;
+    } else {
+        return 3;
+    }
+}
+
+void configure_pass_manager_builder(llvm::PassManagerBuilder &b, const Target &t) {
+    b.OptLevel = llvm_opt_level(t);
+    b.Inliner = llvm::createFunctionInliningPass(b.OptLevel, 0);
+    b.LoopVectorize = !t.has_feature(Target::NoLLVMLoopVectorize);
+    b.SLPVectorize = !t.has_feature(Target::NoLLVMSLPVectorize);
+    b.DisableUnrollLoops = t.has_feature(Target::NoLLVMUnroll);
+}
+
+llvm::CodeGenOpt::Level get_codegen_opt_level(const llvm::Module &module) {
+    int opt_level = 3;
+    get_md_int(module.getModuleFlag("halide_opt_level"), opt_level);
+    switch (opt_level) {
+    case 1:
+        return llvm::CodeGenOpt::Less;
+    case 2:
+        return llvm::CodeGenOpt::Default;
+    default:
+        return llvm::CodeGenOpt::Aggressive;
+    }
 }
 
 std::unique_ptr<llvm::TargetMachine> make_target_machine(const llvm::Module &module) {
@@ -338,7 +485,20 @@ std::unique_ptr<llvm::TargetMachine> make_target_machine(const llvm::Module &mod
                                                 options,
                                                 llvm::Reloc::PIC_,
                                                 llvm::CodeModel::Default,
-                                                llvm::CodeGenOpt::Aggressive));
+                                                get_codegen_opt_level(module)));
+}
+
+bool report_pass_times() {
+    static bool enabled = []() {
+        size_t defined = 0;
+        std::string value = get_env_variable("HL_DEBUG_PASS_TIMES", defined);
+        bool e = defined && value != "0";
+        if (e) {
+            llvm::TimePassesIsEnabled = true;
+        }
+        return e;
+    }();
+    return enabled;
 }
 
 void set_function_attributes_for_target(llvm::Function *fn, Target t) {
@@ -347,6 +507,19 @@ void set_function_attributes_for_target(llvm::Function *fn, Target t) {
     // inaccurate even for us.
     fn->addFnAttr("reciprocal-estimates", "none");
     #endif
+
+    if (t.has_feature(Target::FastMath)) {
+        fn->addFnAttr("unsafe-fp-math", "true");
+        fn->addFnAttr("no-infs-fp-math", "true");
+        fn->addFnAttr("no-nans-fp-math", "true");
+        fn->addFnAttr("no-signed-zeros-fp-math", "true");
+        #if LLVM_VERSION >= 50
+        if (t.arch == Target::X86) {
+            // The prologue sets flush-to-zero and denormals-are-zero.
+            fn->addFnAttr("denormal-fp-math", "preserve-sign");
+        }
+        #endif
+    }
 }
 
 }
@@ -47,9 +47,21 @@ llvm::Type *llvm_type_of(llvm::LLVMContext *context, Halide::Type t);
 bool function_takes_user_context(const std::string &name);
 
 /** Given a size (in bytes), return True if the allocation size can fit
- * on the stack; otherwise, return False. This routine asserts if size is
- * non-positive. */
-bool can_allocation_fit_on_stack(int64_t size);
+ * on the stack for the given target; otherwise, return False. The
+ * limit is 16KB, or 256KB with the LargeStack feature. This routine
+ * asserts if size is non-positive. */
+bool can_allocation_fit_on_stack(int64_t size, const Target &target);
+
+/** Given the memory type of an allocation and its size in bytes if
+ * it's constant (or zero otherwise), return True if it should go on
+ * the stack for the given target. Raises a user error if the memory
+ * type can't be used for an allocation outside of a GPU kernel. */
+bool allocation_goes_on_stack(const std::string &name, MemoryType memory_type,
+                              int64_t constant_bytes, const Target &target);
+
+/** Raises a user error if an allocation stored in registers is
+ * loaded from or stored to at an index that isn't constant. */
+void check_register_allocation(const Allocate *op);
 
 /** Given a Halide Euclidean division/mod operation, define it in terms of
  * div_round_to_zero or mod_round_to_zero. */
@@ -67,9 +79,28 @@ void clone_target_options(const llvm::Module &from, llvm::Module &to);
 /** Given an llvm::Module, get or create an llvm:TargetMachine */
 std::unique_ptr<llvm::TargetMachine> make_target_machine(const llvm::Module &module);
 
+/** The level at which LLVM optimizes code for a Target: 3, or 1 or 2
+ * with the llvm_opt_1 or llvm_opt_2 features. */
+int llvm_opt_level(const Target &t);
+
+/** Set up a PassManagerBuilder for a Target's optimization level,
+ * with the inlining threshold for that level, and with LLVM's
+ * vectorizers and unrolling unless the Target turns them off. */
+void configure_pass_manager_builder(llvm::PassManagerBuilder &b, const Target &t);
+
+/** The level at which to generate machine code for a module, from the
+ * optimization level CodeGen_LLVM recorded in it. */
+llvm::CodeGenOpt::Level get_codegen_opt_level(const llvm::Module &module);
+
 /** Set the appropriate llvm Function attributes given a Target. */
 void set_function_attributes_for_target(llvm::Function *, Target);
 
+/** Whether HL_DEBUG_PASS_TIMES asks for a report of how long each
+ * step of compilation takes. The first call that returns true also
+ * turns on LLVM's per-pass timers, which LLVM reports when its pass
+ * managers are destroyed at exit. */
+bool report_pass_times();
+
 }}
 
 #endif
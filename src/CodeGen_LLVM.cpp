@@ -1,3 +1,6 @@
+#include <chrono>
+#include <fstream>
+#include <functional>
 #include <iostream>
 #include <limits>
 #include <sstream>
@@ -18,6 +21,10 @@
 #include "MatlabWrapper.h"
 #include "IntegerDivisionTable.h"
 #include "CSE.h"
+#include "Substitute.h"
+#include "IREquality.h"
+#include "MultiversionLoops.h"
+#include "FixedPointIntrinsics.h"
 
 #include "CodeGen_X86.h"
 #include "CodeGen_GPU_Host.h"
@@ -49,8 +56,12 @@ struct halide_c_type_to_name<struct halide_filter_metadata_t> {
 
 namespace Halide {
 
-std::unique_ptr<llvm::Module> codegen_llvm(const Module &module, llvm::LLVMContext &context) {
+std::unique_ptr<llvm::Module> codegen_llvm(const Module &module, llvm::LLVMContext &context,
+                                           const std::string &pgo_profile) {
     std::unique_ptr<Internal::CodeGen_LLVM> cg(Internal::CodeGen_LLVM::new_for_target(module.target(), context));
+    if (!pgo_profile.empty()) {
+        cg->set_pgo_profile(pgo_profile);
+    }
     return cg->compile(module);
 }
 
@@ -258,6 +269,8 @@ CodeGen_LLVM::CodeGen_LLVM(Target t) :
 
     min_f64(Float(64).min()),
     max_f64(Float(64).max()),
+    pgo_counters(nullptr),
+    pgo_counts(nullptr),
     destructor_block(nullptr) {
     initialize_llvm();
 }
@@ -490,6 +503,7 @@ std::unique_ptr<llvm::Module> CodeGen_LLVM::compile(const Module &input) {
     module->addModuleFlag(llvm::Module::Warning, "halide_use_soft_float_abi", use_soft_float_abi() ? 1 : 0);
     module->addModuleFlag(llvm::Module::Warning, "halide_mcpu", MDString::get(*context, mcpu()));
     module->addModuleFlag(llvm::Module::Warning, "halide_mattrs", MDString::get(*context, mattrs()));
+    module->addModuleFlag(llvm::Module::Warning, "halide_opt_level", llvm_opt_level(target));
 
     internal_assert(module && context && builder)
         << "The CodeGen_LLVM subclass should have made an initial module before calling CodeGen_LLVM::compile\n";
@@ -507,6 +521,8 @@ std::unique_ptr<llvm::Module> CodeGen_LLVM::compile(const Module &input) {
     scalar_value_t_type = module->getTypeByName("struct.halide_scalar_value_t");
     internal_assert(scalar_value_t_type) << "Did not find halide_scalar_value_t in initial module";
 
+    auto start = std::chrono::high_resolution_clock::now();
+
     // Generate the code for this module.
     debug(1) << "Generating llvm bitcode...\n";
     for (const auto &b : input.buffers()) {
@@ -521,7 +537,7 @@ std::unique_ptr<llvm::Module> CodeGen_LLVM::compile(const Module &input) {
         // (useful for calling from JIT and other machine interfaces).
         if (f.linkage == LoweredFunc::External) {
             llvm::Function *wrapper = add_argv_wrapper(names.argv_name);
-            llvm::Function *metadata_getter = embed_metadata_getter(names.metadata_name, names.simple_name, f.args);
+            llvm::Function *metadata_getter = embed_metadata_getter(names.metadata_name, names.simple_name, f.args, f.traffic);
 
             if (target.has_feature(Target::Matlab)) {
                 define_matlab_wrapper(module.get(), wrapper, metadata_getter);
@@ -535,9 +551,18 @@ std::unique_ptr<llvm::Module> CodeGen_LLVM::compile(const Module &input) {
     verifyModule(*module);
     debug(2) << "Done generating llvm bitcode\n";
 
+    auto generated = std::chrono::high_resolution_clock::now();
+
     // Optimize
     CodeGen_LLVM::optimize_module();
 
+    if (report_pass_times()) {
+        auto optimized = std::chrono::high_resolution_clock::now();
+        debug(0) << "LLVM times for " << input.name() << ": "
+                 << std::chrono::duration<double, std::milli>(generated - start).count() << " ms generating IR, "
+                 << std::chrono::duration<double, std::milli>(optimized - generated).count() << " ms optimizing\n";
+    }
+
     // Disown the module and return it.
     return std::move(module);
 }
@@ -578,6 +603,21 @@ void CodeGen_LLVM::begin_func(LoweredFunc::LinkageType linkage, const std::strin
     BasicBlock *block = BasicBlock::Create(*context, "entry", function);
     builder->SetInsertPoint(block);
 
+    // With fast math, mark all the floating-point instructions we
+    // make as allowing reassociation, contraction and so on, so that
+    // LLVM can vectorize float reductions.
+    if (target.has_feature(Target::FastMath)) {
+        llvm::FastMathFlags fast;
+        #if LLVM_VERSION >= 60
+        fast.setFast();
+        #else
+        fast.setUnsafeAlgebra();
+        #endif
+        builder->setFastMathFlags(fast);
+    } else {
+        builder->clearFastMathFlags();
+    }
+
     // Put the arguments in the symbol table
     {
         size_t i = 0;
@@ -594,6 +634,8 @@ void CodeGen_LLVM::begin_func(LoweredFunc::LinkageType linkage, const std::strin
             i++;
         }
     }
+
+    init_float_environment();
 }
 
 void CodeGen_LLVM::end_func(const std::vector<LoweredArgument>& args) {
@@ -622,6 +664,8 @@ void CodeGen_LLVM::compile_func(const LoweredFunc &f, const std::string &simple_
     // Generate the function declaration and argument unpacking code.
     begin_func(f.linkage, simple_name, extern_name, f.args);
 
+    begin_pgo(f);
+
     // If building with MSAN, ensure that calls to halide_msan_annotate_buffer_is_initialized()
     // happen for every output buffer if the function succeeds.
     if (f.linkage == LoweredFunc::External && target.has_feature(Target::MSAN)) {
@@ -641,6 +685,139 @@ void CodeGen_LLVM::compile_func(const LoweredFunc &f, const std::string &simple_
 
     // Clean up and return.
     end_func(f.args);
+
+    pgo_sites.clear();
+    pgo_counters = nullptr;
+    pgo_counts = nullptr;
+}
+
+namespace {
+
+// Number the branches and serial loops of a function body in the
+// order they appear, which is the same in the instrumented build of
+// a pipeline and in the build guided by its profile.
+class NumberPGOSites : public IRVisitor {
+    using IRVisitor::visit;
+
+    void add(const IRNode *op) {
+        // A node shared by two parts of the body is one site.
+        int id = (int)sites.size();
+        sites.emplace(op, id);
+    }
+
+    void visit(const IfThenElse *op) {
+        add(op);
+        IRVisitor::visit(op);
+    }
+
+    void visit(const For *op) {
+        if (op->for_type == ForType::Serial) {
+            add(op);
+        }
+        IRVisitor::visit(op);
+    }
+
+public:
+    std::map<const IRNode *, int> sites;
+};
+
+}  // namespace
+
+void CodeGen_LLVM::set_pgo_profile(const std::string &filename) {
+    std::ifstream f(filename);
+    user_assert(f.is_open()) << "Could not open profile " << filename << "\n";
+
+    // Each line holds the name of a function, the number of its
+    // counters, and the counters. A profile appended to by several
+    // runs has a line per function per run, which add up.
+    std::string name;
+    size_t num_counters;
+    while (f >> name >> num_counters) {
+        std::vector<uint64_t> counts(num_counters);
+        for (size_t i = 0; i < num_counters; i++) {
+            f >> counts[i];
+        }
+        user_assert(f) << "Profile " << filename << " ends in the middle of the counters of " << name << "\n";
+
+        auto it = pgo_profile.find(name);
+        if (it == pgo_profile.end()) {
+            pgo_profile[name] = counts;
+        } else if (it->second.size() == num_counters) {
+            for (size_t i = 0; i < num_counters; i++) {
+                it->second[i] += counts[i];
+            }
+        } else {
+            user_warning << "Profile " << filename << " has runs of " << name
+                         << " with different numbers of counters. Ignoring all but the first.\n";
+        }
+    }
+}
+
+void CodeGen_LLVM::begin_pgo(const LoweredFunc &f) {
+    NumberPGOSites numbering;
+    f.body.accept(&numbering);
+    pgo_sites.swap(numbering.sites);
+    pgo_counters = nullptr;
+    pgo_counts = nullptr;
+
+    if (pgo_sites.empty()) {
+        return;
+    }
+    int num_counters = 2 * (int)pgo_sites.size();
+
+    // Hexagon code runs on the DSP, away from the runtime that
+    // writes the profile.
+    if (target.has_feature(Target::PGOInstrument) && target.arch != Target::Hexagon) {
+        llvm::ArrayType *counters_t = ArrayType::get(i64_t, num_counters);
+        pgo_counters = new GlobalVariable(*module, counters_t, false, GlobalValue::PrivateLinkage,
+                                          ConstantAggregateZero::get(counters_t), f.name + ".pgo_counters");
+
+        llvm::Function *register_fn = module->getFunction("halide_pgo_register");
+        internal_assert(register_fn) << "Could not find halide_pgo_register in module\n";
+        Value *args[] = {get_user_context(),
+                         create_string_constant(f.name),
+                         builder->CreateConstInBoundsGEP2_32(counters_t, pgo_counters, 0, 0),
+                         ConstantInt::get(i32_t, num_counters)};
+        Value *result = builder->CreateCall(register_fn, args);
+        Value *did_succeed = builder->CreateICmpEQ(result, ConstantInt::get(i32_t, 0));
+        create_assertion(did_succeed, Expr(), result);
+    }
+
+    auto it = pgo_profile.find(f.name);
+    if (it != pgo_profile.end()) {
+        if (it->second.size() == (size_t)num_counters) {
+            pgo_counts = &it->second;
+        } else {
+            user_warning << "The profile of " << f.name << " has " << it->second.size()
+                         << " counters, but it needs " << num_counters << " now. "
+                         << "Ignoring its profile, which must be from a different version of it.\n";
+        }
+    }
+}
+
+int CodeGen_LLVM::pgo_site(const IRNode *op) const {
+    auto it = pgo_sites.find(op);
+    return it == pgo_sites.end() ? -1 : it->second;
+}
+
+void CodeGen_LLVM::pgo_increment(int site, int counter) {
+    if (!pgo_counters || site < 0) {
+        return;
+    }
+    Value *ptr = builder->CreateConstInBoundsGEP2_32(pgo_counters->getValueType(), pgo_counters,
+                                                     0, 2 * site + counter);
+    builder->CreateAtomicRMW(AtomicRMWInst::Add, ptr, ConstantInt::get(i64_t, 1), AtomicOrdering::Monotonic);
+}
+
+llvm::MDNode *CodeGen_LLVM::pgo_branch_weights(uint64_t taken, uint64_t not_taken) {
+    if (taken == 0 && not_taken == 0) {
+        return nullptr;
+    }
+    // Branch weights are 32 bits, so scale down counts too big for
+    // that.
+    uint64_t scale = std::max(taken, not_taken) / std::numeric_limits<uint32_t>::max() + 1;
+    llvm::MDBuilder md_builder(*context);
+    return md_builder.createBranchWeights((uint32_t)(taken / scale), (uint32_t)(not_taken / scale));
 }
 
 // Given a range of iterators of constant ints, get a corresponding vector of llvm::Constant.
@@ -852,7 +1029,8 @@ llvm::Function *CodeGen_LLVM::add_argv_wrapper(const std::string &name) {
 }
 
 llvm::Function *CodeGen_LLVM::embed_metadata_getter(const std::string &metadata_name,
-        const std::string &function_name, const std::vector<LoweredArgument> &args) {
+        const std::string &function_name, const std::vector<LoweredArgument> &args,
+        const std::vector<FuncTraffic> &traffic) {
     Constant *zero = ConstantInt::get(i32_t, 0);
 
     const int num_args = (int) args.size();
@@ -897,13 +1075,42 @@ llvm::Function *CodeGen_LLVM::embed_metadata_getter(const std::string &metadata_
         GlobalValue::PrivateLinkage,
         ConstantArray::get(arguments_array, arguments_array_entries));
 
+    StructType *func_metadata_t_type = module->getTypeByName("struct.halide_filter_func_metadata_t");
+    internal_assert(func_metadata_t_type) << "Did not find halide_filter_func_metadata_t in module.\n";
+
+    const int num_funcs = (int) traffic.size();
+    vector<Constant *> funcs_array_entries;
+    for (const FuncTraffic &t : traffic) {
+        Constant *func_fields[] = {
+            create_string_constant(t.name),
+            ConstantFP::get(f32_t, t.bytes_loaded),
+            ConstantFP::get(f32_t, t.bytes_stored),
+            ConstantFP::get(f32_t, t.ops)
+        };
+        funcs_array_entries.push_back(ConstantStruct::get(func_metadata_t_type, func_fields));
+    }
+
     Value *zeros[] = {zero, zero};
+    Constant *funcs = ConstantPointerNull::get(func_metadata_t_type->getPointerTo());
+    if (num_funcs > 0) {
+        llvm::ArrayType *funcs_array = ArrayType::get(func_metadata_t_type, num_funcs);
+        GlobalVariable *funcs_array_storage = new GlobalVariable(
+            *module,
+            funcs_array,
+            /*isConstant*/ true,
+            GlobalValue::PrivateLinkage,
+            ConstantArray::get(funcs_array, funcs_array_entries));
+        funcs = ConstantExpr::getInBoundsGetElementPtr(funcs_array, funcs_array_storage, zeros);
+    }
+
     Constant *metadata_fields[] = {
-        /* version */ zero,
+        /* version */ ConstantInt::get(i32_t, 1),
         /* num_arguments */ ConstantInt::get(i32_t, num_args),
         /* arguments */ ConstantExpr::getInBoundsGetElementPtr(arguments_array, arguments_array_storage, zeros),
         /* target */ create_string_constant(target.to_string()),
-        /* name */ create_string_constant(function_name)
+        /* name */ create_string_constant(function_name),
+        /* num_funcs */ ConstantInt::get(i32_t, num_funcs),
+        /* funcs */ funcs
     };
 
     GlobalVariable *metadata_storage = new GlobalVariable(
@@ -970,10 +1177,7 @@ void CodeGen_LLVM::optimize_module() {
     function_pass_manager.add(createTargetTransformInfoWrapperPass(TM ? TM->getTargetIRAnalysis() : TargetIRAnalysis()));
 
     PassManagerBuilder b;
-    b.OptLevel = 3;
-    b.Inliner = createFunctionInliningPass(b.OptLevel, 0);
-    b.LoopVectorize = true;
-    b.SLPVectorize = true;
+    configure_pass_manager_builder(b, target);
     b.populateFunctionPassManager(function_pass_manager);
     b.populateModulePassManager(module_pass_manager);
 
@@ -1784,6 +1988,39 @@ void CodeGen_LLVM::visit(const Load *op) {
             }
 
             value = shuffle_vectors(vec_a, vec_b, indices);
+        } else if (ramp && stride && (stride->value == 3 || stride->value == 4)) {
+            // Loads of one channel of interleaved RGB or RGBA
+            // data. Load everything from the first lane to the last
+            // as a dense vector, and shuffle out every stride-th
+            // element. The dense load ends at the last lane, so this
+            // never reads beyond the end of a buffer.
+            int s = (int)stride->value;
+            int span = (ramp->lanes - 1) * s + 1;
+            Expr dense_index = Ramp::make(ramp->base, make_one(ramp->base.type()), span);
+            Expr dense_load = Load::make(op->type.with_lanes(span), op->name, dense_index, op->image, op->param);
+            Value *dense = codegen(dense_load);
+
+            if (s == 4) {
+                // Take the even elements twice. Targets with
+                // deinterleaving instructions (e.g. vdeal and vpack on
+                // HVX) handle stride two shuffles of a pair of vectors
+                // well.
+                Value *v = slice_vector(dense, 0, ramp->lanes * 4);
+                for (int half = ramp->lanes * 2; half >= ramp->lanes; half /= 2) {
+                    vector<int> indices(half);
+                    for (int i = 0; i < half; i++) {
+                        indices[i] = i * 2;
+                    }
+                    v = shuffle_vectors(slice_vector(v, 0, half), slice_vector(v, half, half), indices);
+                }
+                value = v;
+            } else {
+                vector<int> indices(ramp->lanes);
+                for (int i = 0; i < ramp->lanes; i++) {
+                    indices[i] = i * s;
+                }
+                value = shuffle_vectors(dense, indices);
+            }
         } else if (ramp && stride && stride->value == -1) {
             // Load the vector and then flip it in-place
             Expr flipped_base = ramp->base - ramp->lanes + 1;
@@ -2205,6 +2442,15 @@ void CodeGen_LLVM::visit(const Call *op) {
                     op->call_type == Call::PureIntrinsic)
         << "Can only codegen extern calls and intrinsics\n";
 
+    // The fixed-point intrinsics become arithmetic on wider types,
+    // which the target-specific visitors then turn into the
+    // instructions they have for it.
+    Expr fixed_point = lower_fixed_point_intrinsic(op);
+    if (fixed_point.defined()) {
+        value = codegen(fixed_point);
+        return;
+    }
+
     // Some call nodes are actually injected at various stages as a
     // cue for llvm to generate particular ops. In general these are
     // handled in the standard library, but ones with e.g. varying
@@ -2242,6 +2488,39 @@ void CodeGen_LLVM::visit(const Call *op) {
         if (op->type.is_scalar()) {
             value = builder->CreateExtractElement(value, ConstantInt::get(i32_t, 0));
         }
+    } else if (op->is_intrinsic(Call::vector_reduce_add) ||
+               op->is_intrinsic(Call::vector_reduce_mul) ||
+               op->is_intrinsic(Call::vector_reduce_min) ||
+               op->is_intrinsic(Call::vector_reduce_max)) {
+        internal_assert(op->args.size() == 1);
+        Expr v = op->args[0];
+        int lanes = v.type().lanes();
+        if (lanes == 1) {
+            value = codegen(v);
+        } else {
+            // Combine the two halves pairwise, and reduce what's
+            // left. Targets with horizontal reductions of their own
+            // get to pick up the half-width vectors in their visit(Call).
+            auto combine = [&](Expr a, Expr b) {
+                if (op->is_intrinsic(Call::vector_reduce_add)) return a + b;
+                if (op->is_intrinsic(Call::vector_reduce_mul)) return a * b;
+                if (op->is_intrinsic(Call::vector_reduce_min)) return min(a, b);
+                return max(a, b);
+            };
+            auto slice = [&](Expr vec, int start, int n) {
+                return Call::make(vec.type().with_lanes(n), Call::slice_vector,
+                                  {vec, start, 1, n}, Call::PureIntrinsic);
+            };
+            string name = unique_name('t');
+            Expr var = Variable::make(v.type(), name);
+            int half = lanes / 2;
+            Expr result = combine(slice(var, 0, half), slice(var, half, half));
+            result = Call::make(op->type, op->name, {result}, Call::PureIntrinsic);
+            if (lanes % 2) {
+                result = combine(result, slice(var, lanes - 1, 1));
+            }
+            value = codegen(Let::make(name, v, result));
+        }
     } else if (op->is_intrinsic(Call::interleave_vectors)) {
         vector<Value *> args;
         args.reserve(op->args.size());
@@ -2811,10 +3090,14 @@ void CodeGen_LLVM::visit(const Call *op) {
         }
 
         llvm::CallInst *call = builder->CreateCall(base_fn->getFunctionType(), phi, call_args);
+        // The call only forwards this function's own arguments, so
+        // once the pointer is cached, the dispatch can be a load, a
+        // test and a jump.
+        call->setTailCall();
         value = call;
     } else if (op->is_intrinsic(Call::prefetch) ||
                op->is_intrinsic(Call::prefetch_2d)) {
-        // Convert to a no-op since prefetch was not supported by target
+        codegen_prefetch(op);
         value = ConstantInt::get(i32_t, 0);
     } else if (op->is_intrinsic(Call::signed_integer_overflow)) {
         user_error << "Signed integer overflow occurred during constant-folding. Signed"
@@ -3112,7 +3395,85 @@ void CodeGen_LLVM::visit(const ProducerConsumer *op) {
     codegen(op->body);
 }
 
+void CodeGen_LLVM::codegen_multiversioned_loop(const For *op, const Target &variant,
+                                               const std::string &loop_name) {
+    debug(3) << "Compiling loop over " << loop_name << " for " << variant.to_string() << "\n";
+
+    // The loop goes in a function of its own, so that llvm can
+    // compile it for a different subtarget from the rest of the
+    // module. Pass it everything it uses in a closure, as for the
+    // body of a parallel loop.
+    Closure closure(op, op->name);
+    StructType *closure_t = build_closure_type(closure, buffer_t_type, context);
+    Value *ptr = create_alloca_at_entry(closure_t, 1);
+    pack_closure(closure_t, ptr, closure, symbol_table, buffer_t_type, builder);
+
+    llvm::Type *voidPointerType = (llvm::Type *)(i8_t->getPointerTo());
+    llvm::Type *args_t[] = {voidPointerType, voidPointerType};
+    FunctionType *func_t = FunctionType::get(i32_t, args_t, false);
+    llvm::Function *containing_function = function;
+    function = llvm::Function::Create(func_t, llvm::Function::InternalLinkage,
+                                      "isa_" + function->getName() + "_" + op->name, module.get());
+    function->setDoesNotAlias(2);
+
+    // Generate the loop for the variant's features, both in our own
+    // choice of instructions and in llvm's.
+    Target saved_target = target;
+    target = variant;
+    set_function_attributes_for_target(function, target);
+    function->addFnAttr("target-cpu", mcpu());
+    function->addFnAttr("target-features", mattrs());
+
+    IRBuilderBase::InsertPoint call_site = builder->saveIP();
+    BasicBlock *block = BasicBlock::Create(*context, "entry", function);
+    builder->SetInsertPoint(block);
+
+    Value *user_context = get_user_context();
+
+    BasicBlock *parent_destructor_block = destructor_block;
+    destructor_block = nullptr;
+
+    Scope<Value *> saved_symbol_table;
+    symbol_table.swap(saved_symbol_table);
+
+    llvm::Function::arg_iterator iter = function->arg_begin();
+    sym_push("__user_context", iterator_to_pointer(iter));
+    ++iter;
+    iter->setName("closure");
+    Value *closure_handle = builder->CreatePointerCast(iterator_to_pointer(iter),
+                                                       closure_t->getPointerTo());
+    unpack_closure(closure, symbol_table, closure_t, closure_handle, builder);
+
+    // The loop runs over its original name, which the renamed loop
+    // variable is then an alias for.
+    Expr var = Variable::make(Int(32), loop_name);
+    codegen(For::make(loop_name, op->min, op->extent, op->for_type, op->device_api,
+                      LetStmt::make(op->name, var, op->body)));
+
+    return_with_error_code(ConstantInt::get(i32_t, 0));
+
+    llvm::Function *loop_function = function;
+    builder->restoreIP(call_site);
+    symbol_table.swap(saved_symbol_table);
+    function = containing_function;
+    destructor_block = parent_destructor_block;
+    target = saved_target;
+
+    ptr = builder->CreatePointerCast(ptr, i8_t->getPointerTo());
+    Value *result = builder->CreateCall(loop_function, {user_context, ptr});
+    Value *did_succeed = builder->CreateICmpEQ(result, ConstantInt::get(i32_t, 0));
+    create_assertion(did_succeed, Expr(), result);
+}
+
 void CodeGen_LLVM::visit(const For *op) {
+    Target variant;
+    std::string loop_name;
+    if (op->for_type == ForType::Serial &&
+        is_multiversioned_loop(op->name, target, &variant, &loop_name)) {
+        codegen_multiversioned_loop(op, variant, loop_name);
+        return;
+    }
+
     Value *min = codegen(op->min);
     Value *extent = codegen(op->extent);
 
@@ -3126,6 +3487,9 @@ void CodeGen_LLVM::visit(const For *op) {
         // Create the block that comes after the loop
         BasicBlock *after_bb = BasicBlock::Create(*context, std::string("end for ") + op->name, function);
 
+        int site = pgo_site(op);
+        pgo_increment(site, 0);
+
         // If min < max, fall through to the loop bb
         Value *enter_condition = builder->CreateICmpSLT(min, max);
         builder->CreateCondBr(enter_condition, loop_bb, after_bb, very_likely_branch);
@@ -3135,6 +3499,8 @@ void CodeGen_LLVM::visit(const For *op) {
         PHINode *phi = builder->CreatePHI(i32_t, 2);
         phi->addIncoming(min, preheader_bb);
 
+        pgo_increment(site, 1);
+
         // Within the loop, the variable is equal to the phi value
         sym_push(op->name, phi);
 
@@ -3147,9 +3513,16 @@ void CodeGen_LLVM::visit(const For *op) {
         // Add the back-edge to the phi node
         phi->addIncoming(next_var, builder->GetInsertBlock());
 
-        // Maybe exit the loop
+        // Maybe exit the loop. Each entry to the loop exits it once,
+        // and every other iteration goes around again.
+        MDNode *weights = nullptr;
+        if (pgo_counts && site >= 0) {
+            uint64_t entries = (*pgo_counts)[2 * site];
+            uint64_t iterations = (*pgo_counts)[2 * site + 1];
+            weights = pgo_branch_weights(iterations > entries ? iterations - entries : 0, entries);
+        }
         Value *end_condition = builder->CreateICmpNE(next_var, max);
-        builder->CreateCondBr(end_condition, loop_bb, after_bb);
+        builder->CreateCondBr(end_condition, loop_bb, after_bb, weights);
 
         builder->SetInsertPoint(after_bb);
 
@@ -3159,6 +3532,10 @@ void CodeGen_LLVM::visit(const For *op) {
 
         debug(3) << "Entering parallel for loop over " << op->name << "\n";
 
+        // Loops scheduled with parallel_adaptive are chunked by the
+        // runtime, so their tasks run a range of iterations.
+        bool adaptive = ends_with(op->name, ".__adaptive");
+
         // Find every symbol that the body of this loop refers to
         // and dump it into a closure
         Closure closure(op->body, op->name);
@@ -3170,14 +3547,18 @@ void CodeGen_LLVM::visit(const For *op) {
         // Fill in the closure
         pack_closure(closure_t, ptr, closure, symbol_table, buffer_t_type, builder);
 
-        // Make a new function that does one iteration of the body of the loop
+        // Make a new function that does one iteration of the body of
+        // the loop, or a range of iterations for an adaptive loop.
         llvm::Type *voidPointerType = (llvm::Type *)(i8_t->getPointerTo());
-        llvm::Type *args_t[] = {voidPointerType, i32_t, voidPointerType};
+        vector<llvm::Type *> args_t = {voidPointerType, i32_t, voidPointerType};
+        if (adaptive) {
+            args_t.insert(args_t.begin() + 2, i32_t);
+        }
         FunctionType *func_t = FunctionType::get(i32_t, args_t, false);
         llvm::Function *containing_function = function;
         function = llvm::Function::Create(func_t, llvm::Function::InternalLinkage,
                                           "par_for_" + function->getName() + "_" + op->name, module.get());
-        function->setDoesNotAlias(3);
+        function->setDoesNotAlias(adaptive ? 4 : 3);
         set_function_attributes_for_target(function, target);
 
         // Make the initial basic block and jump the builder into the new function
@@ -3205,11 +3586,19 @@ void CodeGen_LLVM::visit(const For *op) {
         llvm::Function::arg_iterator iter = function->arg_begin();
         sym_push("__user_context", iterator_to_pointer(iter));
 
-        // Next is the loop variable.
+        // Next is the loop variable, or the range of iterations to do.
+        string task_min_name = op->name + ".task_min";
+        string task_extent_name = op->name + ".task_extent";
         ++iter;
-        sym_push(op->name, iterator_to_pointer(iter));
+        if (adaptive) {
+            sym_push(task_min_name, iterator_to_pointer(iter));
+            ++iter;
+            sym_push(task_extent_name, iterator_to_pointer(iter));
+        } else {
+            sym_push(op->name, iterator_to_pointer(iter));
+        }
 
-        // The closure pointer is the third and last argument.
+        // The closure pointer is the last argument.
         ++iter;
         iter->setName("closure");
         Value *closure_handle = builder->CreatePointerCast(iterator_to_pointer(iter),
@@ -3217,16 +3606,31 @@ void CodeGen_LLVM::visit(const For *op) {
         // Load everything from the closure into the new scope
         unpack_closure(closure, symbol_table, closure_t, closure_handle, builder);
 
+        init_float_environment();
+
         // Generate the new function body
-        codegen(op->body);
+        if (adaptive) {
+            codegen(For::make(op->name,
+                              Variable::make(Int(32), task_min_name),
+                              Variable::make(Int(32), task_extent_name),
+                              ForType::Serial, DeviceAPI::None, op->body));
+        } else {
+            codegen(op->body);
+        }
 
         // Return success
         return_with_error_code(ConstantInt::get(i32_t, 0));
 
-        // Move the builder back to the main function and call do_par_for
+        // Move the builder back to the main function and call
+        // do_par_for. The tasks forked to run async producers
+        // alongside their consumers wait on each other, so they must
+        // all run at once instead.
         builder->restoreIP(call_site);
-        llvm::Function *do_par_for = module->getFunction("halide_do_par_for");
-        internal_assert(do_par_for) << "Could not find halide_do_par_for in initial module\n";
+        std::string do_par_for_name =
+            ends_with(op->name, ".__async") ? "halide_do_concurrent_tasks" :
+            adaptive ? "halide_do_par_for_adaptive" : "halide_do_par_for";
+        llvm::Function *do_par_for = module->getFunction(do_par_for_name);
+        internal_assert(do_par_for) << "Could not find " << do_par_for_name << " in initial module\n";
         do_par_for->setDoesNotAlias(5);
         //do_par_for->setDoesNotCapture(5);
         ptr = builder->CreatePointerCast(ptr, i8_t->getPointerTo());
@@ -3261,6 +3665,11 @@ void CodeGen_LLVM::visit(const Store *op) {
         return;
     }
 
+    if (op->name == atomic_func) {
+        codegen_atomic_store(op);
+        return;
+    }
+
     Halide::Type value_type = op->value.type();
     Value *val = codegen(op->value);
     bool is_external = (external_buffer.find(op->name) != external_buffer.end());
@@ -3373,9 +3782,19 @@ void CodeGen_LLVM::visit(const IfThenElse *op) {
     BasicBlock *true_bb = BasicBlock::Create(*context, "true_bb", function);
     BasicBlock *false_bb = BasicBlock::Create(*context, "false_bb", function);
     BasicBlock *after_bb = BasicBlock::Create(*context, "after_bb", function);
-    builder->CreateCondBr(codegen(op->condition), true_bb, false_bb);
+
+    int site = pgo_site(op);
+    pgo_increment(site, 0);
+    MDNode *weights = nullptr;
+    if (pgo_counts && site >= 0) {
+        uint64_t reached = (*pgo_counts)[2 * site];
+        uint64_t taken = std::min(reached, (*pgo_counts)[2 * site + 1]);
+        weights = pgo_branch_weights(taken, reached - taken);
+    }
+    builder->CreateCondBr(codegen(op->condition), true_bb, false_bb, weights);
 
     builder->SetInsertPoint(true_bb);
+    pgo_increment(site, 1);
     codegen(op->then_case);
     builder->CreateBr(after_bb);
 
@@ -3395,6 +3814,180 @@ void CodeGen_LLVM::visit(const Evaluate *op) {
     value = nullptr;
 }
 
+void CodeGen_LLVM::visit(const Atomic *op) {
+    string old_atomic_func = atomic_func;
+    atomic_func = op->name;
+    codegen(op->body);
+    atomic_func = old_atomic_func;
+}
+
+namespace {
+// Does an expression load from the given buffer at the given index?
+class LoadsSite : public IRVisitor {
+    const string &name;
+    const Expr &index;
+
+    using IRVisitor::visit;
+
+    void visit(const Load *op) {
+        if (op->name == name && equal(op->index, index)) {
+            result = true;
+        }
+        IRVisitor::visit(op);
+    }
+
+public:
+    bool result = false;
+    LoadsSite(const string &n, const Expr &i) : name(n), index(i) {}
+};
+}
+
+void CodeGen_LLVM::codegen_atomic_store(const Store *op) {
+    Halide::Type t = op->value.type();
+    internal_assert(t.is_scalar())
+        << "Vector atomic update of " << op->name << " should have been scalarized.\n";
+
+    // Look through any lets, so that the load of the site being
+    // updated can be matched against the store.
+    Expr value = substitute_in_all_lets(op->value);
+    Expr index = substitute_in_all_lets(op->index);
+    Expr site = Load::make(t, op->name, index, Buffer<>(), Parameter());
+
+    LoadsSite loads_site(op->name, index);
+    value.accept(&loads_site);
+    user_assert(loads_site.result)
+        << "The atomic update of " << op->name << " doesn't read the site it "
+        << "writes, so it can't be done as a read-modify-write. (Tracing "
+        << "atomic updates isn't supported.)\n";
+
+    Value *ptr = codegen_buffer_pointer(op->name, t, index);
+
+    // Integer adds, mins, and maxes have atomic read-modify-write
+    // instructions of their own.
+    if (t.is_int() || t.is_uint()) {
+        Expr other;
+        AtomicRMWInst::BinOp rmw_op = AtomicRMWInst::BAD_BINOP;
+        if (const Add *add = value.as<Add>()) {
+            rmw_op = AtomicRMWInst::Add;
+            other = equal(add->a, site) ? add->b : equal(add->b, site) ? add->a : Expr();
+        } else if (const Min *min = value.as<Min>()) {
+            rmw_op = t.is_int() ? AtomicRMWInst::Min : AtomicRMWInst::UMin;
+            other = equal(min->a, site) ? min->b : equal(min->b, site) ? min->a : Expr();
+        } else if (const Max *max = value.as<Max>()) {
+            rmw_op = t.is_int() ? AtomicRMWInst::Max : AtomicRMWInst::UMax;
+            other = equal(max->a, site) ? max->b : equal(max->b, site) ? max->a : Expr();
+        }
+        if (other.defined()) {
+            LoadsSite other_loads_site(op->name, index);
+            other.accept(&other_loads_site);
+            if (!other_loads_site.result) {
+                builder->CreateAtomicRMW(rmw_op, ptr, codegen(other), AtomicOrdering::Monotonic);
+                return;
+            }
+        }
+    }
+
+    // Otherwise, compute the new value from the old one and
+    // compare-and-swap it in, until no other thread has changed the
+    // site in between.
+    llvm::Type *int_t = llvm::Type::getIntNTy(*context, t.bytes() * 8);
+    Value *int_ptr = builder->CreatePointerCast(ptr, int_t->getPointerTo());
+    LoadInst *orig = builder->CreateAlignedLoad(int_ptr, t.bytes());
+    orig->setAtomic(AtomicOrdering::Monotonic);
+
+    BasicBlock *pre_bb = builder->GetInsertBlock();
+    BasicBlock *loop_bb = BasicBlock::Create(*context, "atomic_cas", function);
+    BasicBlock *after_bb = BasicBlock::Create(*context, "atomic_cas_done", function);
+    builder->CreateBr(loop_bb);
+    builder->SetInsertPoint(loop_bb);
+
+    PHINode *old_int = builder->CreatePHI(int_t, 2);
+    old_int->addIncoming(orig, pre_bb);
+    llvm::Type *val_t = llvm_type_of(t);
+    Value *old_val = t.bits() == t.bytes() * 8 ?
+        builder->CreateBitCast(old_int, val_t) : builder->CreateTrunc(old_int, val_t);
+
+    string old_name = unique_name('t');
+    sym_push(old_name, old_val);
+    Value *new_val = codegen(substitute(site, Variable::make(t, old_name), value));
+    sym_pop(old_name);
+    Value *new_int = t.bits() == t.bytes() * 8 ?
+        builder->CreateBitCast(new_val, int_t) : builder->CreateZExt(new_val, int_t);
+
+    Value *cmpxchg = builder->CreateAtomicCmpXchg(int_ptr, old_int, new_int,
+                                                  AtomicOrdering::Monotonic,
+                                                  AtomicOrdering::Monotonic);
+    Value *seen = builder->CreateExtractValue(cmpxchg, {0});
+    Value *success = builder->CreateExtractValue(cmpxchg, {1});
+    old_int->addIncoming(seen, builder->GetInsertBlock());
+    builder->CreateCondBr(success, after_bb, loop_bb);
+    builder->SetInsertPoint(after_bb);
+}
+
+void CodeGen_LLVM::codegen_prefetch(const Call *op) {
+    bool is_2d = op->is_intrinsic(Call::prefetch_2d);
+    internal_assert(op->args.size() == (is_2d ? 4u : 2u));
+
+    // Only emit prefetches for the architectures that have prefetch
+    // instructions. Others (e.g. GPUs) drop them.
+    llvm::Triple::ArchType arch = llvm::Triple(module->getTargetTriple()).getArch();
+    if (arch != llvm::Triple::x86 && arch != llvm::Triple::x86_64 &&
+        arch != llvm::Triple::arm && arch != llvm::Triple::aarch64 &&
+        arch != llvm::Triple::ppc64 && arch != llvm::Triple::ppc64le) {
+        return;
+    }
+
+    Value *base = builder->CreatePointerCast(codegen(op->args[0]), i8_t->getPointerTo());
+    Value *width_bytes = codegen(op->args[1]);
+    Value *rows = ConstantInt::get(i32_t, 1);
+    Value *stride_bytes = ConstantInt::get(i32_t, 0);
+    if (is_2d) {
+        rows = codegen(op->args[2]);
+        stride_bytes = codegen(op->args[3]);
+    }
+
+    // Prefetching any byte of a cache line fetches the whole line, so
+    // step through each row a line at a time. The rows need not be
+    // aligned to lines, so go one line past the end of the row to be
+    // sure of fetching its last byte.
+    int line_bytes = target.arch == Target::POWERPC ? 128 : 64;
+    Value *line_extent = builder->CreateNSWAdd(width_bytes, ConstantInt::get(i32_t, line_bytes - 1));
+
+    // A do-while loop from 0 to extent in steps of step.
+    auto make_loop = [&](const std::string &name, Value *extent, int step,
+                         std::function<void(Value *)> body) {
+        BasicBlock *preheader_bb = builder->GetInsertBlock();
+        BasicBlock *loop_bb = BasicBlock::Create(*context, name, function);
+        BasicBlock *after_bb = BasicBlock::Create(*context, "end " + name, function);
+        Value *zero = ConstantInt::get(i32_t, 0);
+        builder->CreateCondBr(builder->CreateICmpSLT(zero, extent), loop_bb, after_bb);
+        builder->SetInsertPoint(loop_bb);
+        PHINode *phi = builder->CreatePHI(i32_t, 2);
+        phi->addIncoming(zero, preheader_bb);
+        body(phi);
+        Value *next = builder->CreateNSWAdd(phi, ConstantInt::get(i32_t, step));
+        phi->addIncoming(next, builder->GetInsertBlock());
+        builder->CreateCondBr(builder->CreateICmpSLT(next, extent), loop_bb, after_bb);
+        builder->SetInsertPoint(after_bb);
+    };
+
+    // Prefetch for reading (0), with high temporal locality (3), into
+    // the data cache (1). The data is read by the next few iterations
+    // of the loop, so it should stay in all levels of the cache.
+    llvm::Function *prefetch_fn = Intrinsic::getDeclaration(module.get(), Intrinsic::prefetch);
+    Value *rw = ConstantInt::get(i32_t, 0);
+    Value *locality = ConstantInt::get(i32_t, 3);
+    Value *cache_type = ConstantInt::get(i32_t, 1);
+
+    make_loop("prefetch rows", rows, 1, [&](Value *row) {
+        Value *row_base = builder->CreateGEP(base, builder->CreateNSWMul(row, stride_bytes));
+        make_loop("prefetch lines", line_extent, line_bytes, [&](Value *offset) {
+            Value *addr = builder->CreateGEP(row_base, offset);
+            builder->CreateCall(prefetch_fn, {addr, rw, locality, cache_type});
+        });
+    });
+}
+
 Value *CodeGen_LLVM::create_alloca_at_entry(llvm::Type *t, int n, bool zero_initialize, const string &name) {
     IRBuilderBase::InsertPoint here = builder->saveIP();
     BasicBlock *entry = &builder->GetInsertBlock()->getParent()->getEntryBlock();
@@ -78,6 +78,11 @@ public:
     /** Initialize internal llvm state for the enabled targets. */
     static void initialize_llvm();
 
+    /** Weight the branches and loops of the functions compiled by
+     * the counts in a profile written by the same functions compiled
+     * with the pgo_instrument feature. See halide_pgo_register. */
+    void set_pgo_profile(const std::string &filename);
+
 protected:
     CodeGen_LLVM(Target t);
 
@@ -99,6 +104,12 @@ protected:
     virtual void end_func(const std::vector<LoweredArgument> &args);
     // @}
 
+    /** Called at the start of each function generated, including the
+     * bodies of parallel loops (which may run on other threads), to
+     * set up the floating-point environment the target wants. Does
+     * nothing by default. */
+    virtual void init_float_environment() {}
+
     /** What should be passed as -mcpu, -mattrs, and related for
      * compilation. The architecture-specific code generator should
      * define these. */
@@ -367,6 +378,11 @@ protected:
     virtual void visit(const Block *);
     virtual void visit(const IfThenElse *);
     virtual void visit(const Evaluate *);
+    virtual void visit(const Atomic *);
+
+    /** Generate a loop renamed by multiversion_loops in a function of
+     * its own, compiled for the given target. */
+    void codegen_multiversioned_loop(const For *op, const Target &variant, const std::string &loop_name);
     // @}
 
     /** Generate code for an allocate node. It has no default
@@ -471,6 +487,50 @@ private:
     /** Alignment info for Int(32) variables in scope. */
     Scope<ModulusRemainder> alignment_info;
 
+    /** The Func whose stores are currently being done atomically,
+     * if any. See Stage::atomic. */
+    std::string atomic_func;
+
+    /** Generate an atomic read-modify-write for a store inside an
+     * Atomic node. */
+    void codegen_atomic_store(const Store *);
+
+    /** Generate a prefetch or prefetch_2d intrinsic as a loop over
+     * the rows of the region, and the cache lines of each row, of
+     * llvm.prefetch calls. */
+    void codegen_prefetch(const Call *);
+
+    /** The counters of each function in the profile set by
+     * set_pgo_profile, summed over the runs in it. */
+    std::map<std::string, std::vector<uint64_t>> pgo_profile;
+
+    /** The branches and serial loops of the function being compiled,
+     * numbered in the order they appear in its body. Site i has two
+     * counters: 2*i counts the times the site was reached, and 2*i + 1
+     * counts the times the then case ran, or the loop iterations. */
+    std::map<const IRNode *, int> pgo_sites;
+
+    /** The counters of the function being compiled, if instrumenting
+     * it, and its counts from the profile, if it has any. */
+    llvm::GlobalVariable *pgo_counters;
+    const std::vector<uint64_t> *pgo_counts;
+
+    /** Number the sites of a function body, and set up its counters
+     * or its counts from the profile. */
+    void begin_pgo(const LoweredFunc &f);
+
+    /** Get the site number of a branch or loop, or -1 if it isn't one
+     * of the sites of the function being compiled. */
+    int pgo_site(const IRNode *op) const;
+
+    /** Bump one of the two counters of a site, if instrumenting
+     * it. */
+    void pgo_increment(int site, int counter);
+
+    /** Get the branch weights for a branch taken and not taken the
+     * given numbers of times, or null if neither happened. */
+    llvm::MDNode *pgo_branch_weights(uint64_t taken, uint64_t not_taken);
+
     /** String constants already emitted to the module. Tracked to
      * prevent emitting the same string many times. */
     std::map<std::string, llvm::Constant *> string_constants;
@@ -486,7 +546,8 @@ private:
      * pointer-to-constant-data.
      */
     llvm::Function* embed_metadata_getter(const std::string &metadata_getter_name,
-        const std::string &function_name, const std::vector<LoweredArgument> &args);
+        const std::string &function_name, const std::vector<LoweredArgument> &args,
+        const std::vector<FuncTraffic> &traffic);
 
     /** Embed a constant expression as a global variable. */
     llvm::Constant *embed_constant_expr(Expr e);
@@ -501,9 +562,11 @@ private:
 
 }
 
-/** Given a Halide module, generate an llvm::Module. */
+/** Given a Halide module, generate an llvm::Module, weighting its
+ * branches by the profile in the named file, if any. */
 EXPORT std::unique_ptr<llvm::Module> codegen_llvm(const Module &module,
-                                                  llvm::LLVMContext &context);
+                                                  llvm::LLVMContext &context,
+                                                  const std::string &pgo_profile = "");
 
 }
 
@@ -1,4 +1,7 @@
 #include "CodeGen_MIPS.h"
+#include "ConciseCasts.h"
+#include "IROperator.h"
+#include "IRMatch.h"
 #include "Util.h"
 #include "LLVM_Headers.h"
 
@@ -8,6 +11,7 @@ namespace Internal {
 using std::vector;
 using std::string;
 
+using namespace Halide::ConciseCasts;
 using namespace llvm;
 
 CodeGen_MIPS::CodeGen_MIPS(Target t) : CodeGen_Posix(t) {
@@ -17,6 +21,173 @@ CodeGen_MIPS::CodeGen_MIPS(Target t) : CodeGen_Posix(t) {
     user_assert(llvm_Mips_enabled) << "llvm build not configured with MIPS target enabled.\n";
 }
 
+namespace {
+
+// The MSA element size suffix for a type.
+const char *msa_type_suffix(const Type &t) {
+    switch (t.bits()) {
+    case  8: return "b";
+    case 16: return "h";
+    case 32: return "w";
+    case 64: return "d";
+    }
+    return nullptr;
+}
+
+// i16(i8_a)*i16(i8_b) + i16(i8_c)*i16(i8_d), and likewise for wider
+// types, can be done by interleaving a, c, and b, d, and then using
+// one of the MSA dot products, which sum adjacent pairs of widening
+// multiplies.
+bool should_use_dotp(Expr a, Expr b, vector<Expr> &result) {
+    Type t = a.type();
+    internal_assert(b.type() == t);
+
+    const Mul *ma = a.as<Mul>();
+    const Mul *mb = b.as<Mul>();
+
+    if (!(ma && mb && t.is_vector() && (t.is_int() || t.is_uint()) && t.bits() >= 16)) {
+        return false;
+    }
+
+    Type narrow = t.with_bits(t.bits() / 2);
+    vector<Expr> args = {lossless_cast(narrow, ma->a),
+                         lossless_cast(narrow, ma->b),
+                         lossless_cast(narrow, mb->a),
+                         lossless_cast(narrow, mb->b)};
+    if (!args[0].defined() || !args[1].defined() ||
+        !args[2].defined() || !args[3].defined()) {
+        return false;
+    }
+
+    result.swap(args);
+    return true;
+}
+
+}
+
+void CodeGen_MIPS::codegen_dotp(Type t, const vector<Expr> &args) {
+    vector<Value *> v(args.size());
+    for (size_t i = 0; i < args.size(); i++) {
+        v[i] = codegen(args[i]);
+    }
+
+    int intrin_lanes = 128 / t.bits();
+    string name = std::string("llvm.mips.dotp.") + (t.is_int() ? "s." : "u.") + msa_type_suffix(t);
+    llvm::Type *result_t = llvm_type_of(t.with_lanes(intrin_lanes));
+    vector<Value *> results;
+    for (int i = 0; i < t.lanes(); i += intrin_lanes) {
+        Value *ac = interleave_vectors({slice_vector(v[0], i, intrin_lanes),
+                                        slice_vector(v[2], i, intrin_lanes)});
+        Value *bd = interleave_vectors({slice_vector(v[1], i, intrin_lanes),
+                                        slice_vector(v[3], i, intrin_lanes)});
+        results.push_back(call_intrin(result_t, intrin_lanes, name, {ac, bd}));
+    }
+    value = slice_vector(concat_vectors(results), 0, t.lanes());
+}
+
+void CodeGen_MIPS::visit(const Add *op) {
+    vector<Expr> matches;
+    if (target.has_feature(Target::MSA) &&
+        should_use_dotp(op->a, op->b, matches)) {
+        codegen_dotp(op->type, matches);
+    } else {
+        CodeGen_Posix::visit(op);
+    }
+}
+
+void CodeGen_MIPS::visit(const Sub *op) {
+    vector<Expr> matches;
+    if (target.has_feature(Target::MSA) &&
+        op->type.is_int() &&
+        should_use_dotp(op->a, op->b, matches)) {
+        // Negate one of the factors in the second expression
+        if (is_const(matches[2])) {
+            matches[2] = -matches[2];
+        } else {
+            matches[3] = -matches[3];
+        }
+        codegen_dotp(op->type, matches);
+    } else {
+        CodeGen_Posix::visit(op);
+    }
+}
+
+void CodeGen_MIPS::visit(const Cast *op) {
+    if (!op->type.is_vector() || !target.has_feature(Target::MSA)) {
+        // We only have peephole optimizations for vectors in here.
+        CodeGen_Posix::visit(op);
+        return;
+    }
+
+    vector<Expr> matches;
+
+    struct Pattern {
+        bool wide_op;
+        Type type;
+        string intrin;
+        Expr pattern;
+    };
+
+    static Pattern patterns[] = {
+        {true, Int(8, 16), "llvm.mips.adds.s.b", i8_sat(wild_i16x_ + wild_i16x_)},
+        {true, Int(8, 16), "llvm.mips.subs.s.b", i8_sat(wild_i16x_ - wild_i16x_)},
+        {true, UInt(8, 16), "llvm.mips.adds.u.b", u8_sat(wild_u16x_ + wild_u16x_)},
+        {true, UInt(8, 16), "llvm.mips.subs.u.b", u8(max(wild_i16x_ - wild_i16x_, 0))},
+        {true, Int(16, 8), "llvm.mips.adds.s.h", i16_sat(wild_i32x_ + wild_i32x_)},
+        {true, Int(16, 8), "llvm.mips.subs.s.h", i16_sat(wild_i32x_ - wild_i32x_)},
+        {true, UInt(16, 8), "llvm.mips.adds.u.h", u16_sat(wild_u32x_ + wild_u32x_)},
+        {true, UInt(16, 8), "llvm.mips.subs.u.h", u16(max(wild_i32x_ - wild_i32x_, 0))},
+        {true, Int(32, 4), "llvm.mips.adds.s.w", i32_sat(wild_i64x_ + wild_i64x_)},
+        {true, Int(32, 4), "llvm.mips.subs.s.w", i32_sat(wild_i64x_ - wild_i64x_)},
+        {true, UInt(32, 4), "llvm.mips.adds.u.w", u32_sat(wild_u64x_ + wild_u64x_)},
+        {true, UInt(32, 4), "llvm.mips.subs.u.w", u32(max(wild_i64x_ - wild_i64x_, 0))},
+
+        // Rounding averages.
+        {true, Int(8, 16), "llvm.mips.aver.s.b", i8(((wild_i16x_ + wild_i16x_) + 1) / 2)},
+        {true, UInt(8, 16), "llvm.mips.aver.u.b", u8(((wild_u16x_ + wild_u16x_) + 1) / 2)},
+        {true, Int(16, 8), "llvm.mips.aver.s.h", i16(((wild_i32x_ + wild_i32x_) + 1) / 2)},
+        {true, UInt(16, 8), "llvm.mips.aver.u.h", u16(((wild_u32x_ + wild_u32x_) + 1) / 2)},
+        {true, Int(32, 4), "llvm.mips.aver.s.w", i32(((wild_i64x_ + wild_i64x_) + 1) / 2)},
+        {true, UInt(32, 4), "llvm.mips.aver.u.w", u32(((wild_u64x_ + wild_u64x_) + 1) / 2)},
+
+        // Truncating averages.
+        {true, Int(8, 16), "llvm.mips.ave.s.b", i8((wild_i16x_ + wild_i16x_) / 2)},
+        {true, UInt(8, 16), "llvm.mips.ave.u.b", u8((wild_u16x_ + wild_u16x_) / 2)},
+        {true, Int(16, 8), "llvm.mips.ave.s.h", i16((wild_i32x_ + wild_i32x_) / 2)},
+        {true, UInt(16, 8), "llvm.mips.ave.u.h", u16((wild_u32x_ + wild_u32x_) / 2)},
+        {true, Int(32, 4), "llvm.mips.ave.s.w", i32((wild_i64x_ + wild_i64x_) / 2)},
+        {true, UInt(32, 4), "llvm.mips.ave.u.w", u32((wild_u64x_ + wild_u64x_) / 2)},
+
+        // The high halves of widening multiplies, as fixed-point
+        // multiplies.
+        {true, Int(16, 8), "llvm.mips.mul.q.h", i16_sat((wild_i32x_ * wild_i32x_) / 32768)},
+        {true, Int(32, 4), "llvm.mips.mul.q.w", i32_sat((wild_i64x_ * wild_i64x_) / Expr((int64_t)1 << 31))},
+        {true, Int(16, 8), "llvm.mips.mulr.q.h", i16_sat((wild_i32x_ * wild_i32x_ + 16384) / 32768)},
+        {true, Int(32, 4), "llvm.mips.mulr.q.w", i32_sat((wild_i64x_ * wild_i64x_ + (1 << 30)) / Expr((int64_t)1 << 31))},
+    };
+
+    for (size_t i = 0; i < sizeof(patterns)/sizeof(patterns[0]); i++) {
+        const Pattern &pattern = patterns[i];
+
+        if (expr_match(pattern.pattern, op, matches)) {
+            bool match = true;
+            if (pattern.wide_op) {
+                // Try to narrow the matches to the target type.
+                for (size_t i = 0; i < matches.size(); i++) {
+                    matches[i] = lossless_cast(op->type, matches[i]);
+                    if (!matches[i].defined()) match = false;
+                }
+            }
+            if (match) {
+                value = call_intrin(op->type, pattern.type.lanes(), pattern.intrin, matches);
+                return;
+            }
+        }
+    }
+
+    CodeGen_Posix::visit(op);
+}
+
 string CodeGen_MIPS::mcpu() const {
     if (target.bits == 32) {
         return "";
@@ -27,9 +198,10 @@ string CodeGen_MIPS::mcpu() const {
 
 string CodeGen_MIPS::mattrs() const {
     if (target.bits == 32) {
-        return "";
+        // MSA needs release 5 and 64-bit floating point registers.
+        return target.has_feature(Target::MSA) ? "+mips32r5,+fp64,+msa" : "";
     } else {
-        return "mips64r6";
+        return target.has_feature(Target::MSA) ? "mips64r6,+msa" : "mips64r6";
     }
 }
 
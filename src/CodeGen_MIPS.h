@@ -27,6 +27,17 @@ protected:
     std::string mattrs() const;
     bool use_soft_float_abi() const;
     int native_vector_bits() const;
+
+    /** Nodes for which we want to emit specific MSA intrinsics */
+    // @{
+    void visit(const Cast *);
+    void visit(const Add *);
+    void visit(const Sub *);
+    // @}
+
+private:
+    /** Sum pairs of widening multiplies with an MSA dot product. */
+    void codegen_dotp(Type t, const std::vector<Expr> &args);
 };
 
 }}
@@ -51,6 +51,7 @@ protected:
 
     protected:
         using CodeGen_C::visit;
+        bool uses_vector_extensions() const { return false; }
         std::string print_type(Type type, AppendSpaceIfNeeded space_option = DoNotAppendSpace);
         // Vectors in Metal come in two varieties, regular and packed.
         // For storage allocations and pointers used in address arithmetic,
@@ -51,6 +51,7 @@ protected:
 
     protected:
         using CodeGen_C::visit;
+        bool uses_vector_extensions() const { return false; }
         std::string print_type(Type type, AppendSpaceIfNeeded append_space = DoNotAppendSpace);
         std::string print_reinterpret(Type type, Expr e);
 
@@ -1,4 +1,5 @@
 #include "CodeGen_OpenGLCompute_Dev.h"
+#include "Bounds.h"
 #include "IRMatch.h"
 #include "IRMutator.h"
 #include "IROperator.h"
@@ -112,6 +113,11 @@ void CodeGen_OpenGLCompute_Dev::CodeGen_OpenGLCompute_C::visit(const Cast *op) {
 
 void CodeGen_OpenGLCompute_Dev::CodeGen_OpenGLCompute_C::visit(const Call *op) {
     if (op->name == "halide_gpu_thread_barrier") {
+        // barrier() only synchronizes execution within the
+        // workgroup. The shared memory writes made before it must
+        // also be made visible to the other invocations.
+        do_indent();
+        stream << "memoryBarrierShared();\n";
         do_indent();
         stream << "barrier();\n";
     } else {
@@ -250,6 +256,23 @@ class FindSharedAllocations : public IRVisitor {
 public:
     vector<const Allocate *> allocs;
 };
+
+// GLSL arrays must have a size known at compile time, so use a
+// constant upper bound of the extent of the allocation.
+Expr constant_allocation_size(const Allocate *op) {
+    Expr extent = 1;
+    for (Expr e : op->extents) {
+        extent *= e;
+    }
+    extent = simplify(extent);
+    Expr bound = find_constant_bound(extent, Direction::Upper);
+    user_assert(bound.defined())
+        << "Allocation " << op->name << " has a dynamic size ("
+        << extent << ") with no constant upper bound. OpenGLCompute "
+        << "requires local and shared arrays to have a constant size. "
+        << "Consider using bound() or a constant split factor.\n";
+    return bound;
+}
 }
 
 void CodeGen_OpenGLCompute_Dev::CodeGen_OpenGLCompute_C::add_kernel(Stmt s,
@@ -289,11 +312,10 @@ void CodeGen_OpenGLCompute_Dev::CodeGen_OpenGLCompute_C::add_kernel(Stmt s,
     FindSharedAllocations fsa;
     s.accept(&fsa);
     for (const Allocate *op : fsa.allocs) {
-        internal_assert(op->extents.size() == 1 && is_const(op->extents[0]));
         stream << "shared "
                << print_type(op->type) << " "
                << print_name(op->name) << "["
-               << op->extents[0] << "];\n";
+               << constant_allocation_size(op) << "];\n";
     }
 
     // We'll figure out the workgroup size while traversing the stmt
@@ -331,18 +353,12 @@ void CodeGen_OpenGLCompute_Dev::CodeGen_OpenGLCompute_C::visit(const Allocate *o
     allocations.push(op->name, alloc);
 
     internal_assert(op->extents.size() >= 1);
-    Expr extent = 1;
-    for (Expr e : op->extents) {
-        extent *= e;
-    }
-    extent = simplify(extent);
-    internal_assert(is_const(extent));
 
     if (!starts_with(op->name, "__shared_")) {
         // Shared allocations were already declared at global scope.
         stream << print_type(op->type) << " "
                << print_name(op->name) << "["
-               << op->extents[0] << "];\n";
+               << constant_allocation_size(op) << "];\n";
     }
     op->body.accept(this);
 }
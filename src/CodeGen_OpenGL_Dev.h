@@ -59,6 +59,7 @@ public:
 
 protected:
     using CodeGen_C::visit;
+    bool uses_vector_extensions() const { return false; }
     void visit(const Max *op);
     void visit(const Min *op);
     void visit(const Div *op);
@@ -3,6 +3,7 @@
 #include "IROperator.h"
 #include "IRPrinter.h"
 #include "Debug.h"
+#include "GPULaunchBounds.h"
 #include "Target.h"
 #include "LLVM_Headers.h"
 #include "LLVM_Runtime_Linker.h"
@@ -66,10 +67,16 @@ void CodeGen_PTX_Dev::add_kernel(Stmt stmt,
     function = llvm::Function::Create(func_t, llvm::Function::ExternalLinkage, name, module.get());
     set_function_attributes_for_target(function, target);
 
-    // Mark the buffer args as no alias
+    // Mark the buffer args as no alias, and the ones the kernel never
+    // writes to as read-only. The NVPTX backend loads from pointers
+    // that are both through the read-only data cache (ld.global.nc)
+    // on targets that have one.
     for (size_t i = 0; i < args.size(); i++) {
         if (args[i].is_buffer) {
             function->setDoesNotAlias(i+1);
+            if (!args[i].write) {
+                function->addAttribute(i+1, Attribute::ReadOnly);
+            }
         }
     }
 
@@ -128,6 +135,30 @@ void CodeGen_PTX_Dev::add_kernel(Stmt stmt,
 
     module->getOrInsertNamedMetadata("nvvm.annotations")->addOperand(md_node);
 
+    // Pass on any launch bounds hints from the schedule, which become
+    // the .maxntid, .minnctapersm, and .maxnreg directives.
+    const For *loop = stmt.as<For>();
+    internal_assert(loop);
+    GPULaunchBounds bounds = gpu_launch_bounds_of_loop(loop->name);
+    const std::pair<const char *, int> hints[] = {
+        {"maxntidx", bounds.max_threads},
+        {"maxntidy", bounds.max_threads ? 1 : 0},
+        {"maxntidz", bounds.max_threads ? 1 : 0},
+        {"minctasm", bounds.min_blocks},
+        {"maxnreg", bounds.max_registers},
+    };
+    for (const auto &h : hints) {
+        if (h.second == 0) {
+            continue;
+        }
+        llvm::Metadata *hint_args[] = {
+            llvm::ValueAsMetadata::get(function),
+            MDString::get(*context, h.first),
+            llvm::ValueAsMetadata::get(ConstantInt::get(i32_t, h.second))
+        };
+        module->getOrInsertNamedMetadata("nvvm.annotations")->addOperand(MDNode::get(*context, hint_args));
+    }
+
 
     // Now verify the function is ok
     verifyFunction(*function);
@@ -235,7 +266,13 @@ string CodeGen_PTX_Dev::march() const {
 }
 
 string CodeGen_PTX_Dev::mcpu() const {
-    if (target.has_feature(Target::CUDACapability50)) {
+    if (target.has_feature(Target::CUDACapability70)) {
+        user_assert(LLVM_VERSION >= 60)
+            << "CUDA compute capability 7.0 requires LLVM 6.0 or later.\n";
+        return "sm_70";
+    } else if (target.has_feature(Target::CUDACapability61)) {
+        return "sm_61";
+    } else if (target.has_feature(Target::CUDACapability50)) {
         return "sm_50";
     } else if (target.has_feature(Target::CUDACapability35)) {
         return "sm_35";
@@ -249,7 +286,13 @@ string CodeGen_PTX_Dev::mcpu() const {
 }
 
 string CodeGen_PTX_Dev::mattrs() const {
-    if (target.features_any_of({Target::CUDACapability32,
+    if (target.has_feature(Target::CUDACapability70)) {
+        // Need ptx isa 6.0.
+        return "+ptx60";
+    } else if (target.has_feature(Target::CUDACapability61)) {
+        // Need ptx isa 5.0.
+        return "+ptx50";
+    } else if (target.features_any_of({Target::CUDACapability32,
                                 Target::CUDACapability50})) {
         // Need ptx isa 4.0.
         return "+ptx40";
@@ -337,10 +380,7 @@ vector<char> CodeGen_PTX_Dev::compile_to_src() {
     module_pass_manager.add(createNVVMReflectPass(reflect_mapping));
     
     PassManagerBuilder b;
-    b.OptLevel = 3;
-    b.Inliner = createFunctionInliningPass(b.OptLevel, 0);
-    b.LoopVectorize = true;
-    b.SLPVectorize = true;
+    configure_pass_manager_builder(b, target);
     b.populateFunctionPassManager(function_pass_manager);
     b.populateModulePassManager(module_pass_manager);
 
@@ -80,7 +80,7 @@ int CodeGen_Posix::allocation_padding(Type type) const {
     return type.bytes();
 }
 
-CodeGen_Posix::Allocation CodeGen_Posix::create_allocation(const std::string &name, Type type,
+CodeGen_Posix::Allocation CodeGen_Posix::create_allocation(const std::string &name, Type type, MemoryType memory_type,
                                                            const std::vector<Expr> &extents, Expr condition,
                                                            Expr new_expr, std::string free_function) {
     Value *llvm_size = nullptr;
@@ -93,11 +93,12 @@ CodeGen_Posix::Allocation CodeGen_Posix::create_allocation(const std::string &na
         if (stack_bytes > target.maximum_buffer_size()) {
             const string str_max_size = target.has_feature(Target::LargeBuffers) ? "2^63 - 1" : "2^31 - 1";
             user_error << "Total size for allocation " << name << " is constant but exceeds " << str_max_size << ".";
-        } else if (!can_allocation_fit_on_stack(stack_bytes)) {
+        } else if (!allocation_goes_on_stack(name, memory_type, stack_bytes, target)) {
             stack_bytes = 0;
             llvm_size = codegen(Expr(constant_bytes));
         }
     } else {
+        allocation_goes_on_stack(name, memory_type, 0, target);
         llvm_size = codegen_allocation_size(name, type, extents);
     }
 
@@ -125,7 +126,8 @@ CodeGen_Posix::Allocation CodeGen_Posix::create_allocation(const std::string &na
     allocation.destructor_function = nullptr;
     allocation.name = name;
 
-    if (!new_expr.defined() && extents.empty()) {
+    if (!new_expr.defined() && extents.empty() &&
+        memory_type != MemoryType::Heap && memory_type != MemoryType::VTCM) {
         // If it's a scalar allocation, don't try anything clever. We
         // want llvm to be able to promote it to a register.
         allocation.ptr = create_alloca_at_entry(llvm_type_of(type), 1, false, name);
@@ -173,15 +175,22 @@ CodeGen_Posix::Allocation CodeGen_Posix::create_allocation(const std::string &na
             allocation.ptr = codegen(new_expr);
         } else {
             // call malloc
-            llvm::Function *malloc_fn = module->getFunction("halide_malloc");
-            internal_assert(malloc_fn) << "Could not find halide_malloc in module\n";
+            string malloc_name = "halide_malloc";
+            if (memory_type == MemoryType::VTCM) {
+                malloc_name = "halide_vtcm_malloc";
+                if (free_function.empty()) {
+                    free_function = "halide_vtcm_free";
+                }
+            }
+            llvm::Function *malloc_fn = module->getFunction(malloc_name);
+            internal_assert(malloc_fn) << "Could not find " << malloc_name << " in module\n";
             malloc_fn->setDoesNotAlias(0);
 
             llvm::Function::arg_iterator arg_iter = malloc_fn->arg_begin();
             ++arg_iter;  // skip the user context *
             llvm_size = builder->CreateIntCast(llvm_size, arg_iter->getType(), false);
 
-            debug(4) << "Creating call to halide_malloc for allocation " << name
+            debug(4) << "Creating call to " << malloc_name << " for allocation " << name
                      << " of size " << type.bytes();
             for (Expr e : extents) {
                 debug(4) << " x " << e;
@@ -259,7 +268,8 @@ void CodeGen_Posix::visit(const Allocate *alloc) {
                    << alloc->name << "\n";
     }
 
-    Allocation allocation = create_allocation(alloc->name, alloc->type,
+    check_register_allocation(alloc);
+    Allocation allocation = create_allocation(alloc->name, alloc->type, alloc->memory_type,
                                               alloc->extents, alloc->condition,
                                               alloc->new_expr, alloc->free_function);
     sym_push(alloc->name + ".host", allocation.ptr);
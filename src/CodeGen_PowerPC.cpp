@@ -50,7 +50,7 @@ void CodeGen_PowerPC::visit(const Cast *op) {
     vector<Expr> matches;
 
     struct Pattern {
-        bool needs_vsx;
+        Target::Feature feature;
         bool wide_op;
         Type type;
         string intrin;
@@ -58,48 +58,48 @@ void CodeGen_PowerPC::visit(const Cast *op) {
     };
 
     static Pattern patterns[] = {
-        {false, true, Int(8, 16), "llvm.ppc.altivec.vaddsbs",
+        {Target::FeatureEnd, true, Int(8, 16), "llvm.ppc.altivec.vaddsbs",
          i8_sat(wild_i16x_ + wild_i16x_)},
-        {false, true, Int(8, 16), "llvm.ppc.altivec.vsubsbs",
+        {Target::FeatureEnd, true, Int(8, 16), "llvm.ppc.altivec.vsubsbs",
          i8_sat(wild_i16x_ - wild_i16x_)},
-        {false, true, UInt(8, 16), "llvm.ppc.altivec.vaddubs",
+        {Target::FeatureEnd, true, UInt(8, 16), "llvm.ppc.altivec.vaddubs",
          u8_sat(wild_u16x_ + wild_u16x_)},
-        {false, true, UInt(8, 16), "llvm.ppc.altivec.vsububs",
+        {Target::FeatureEnd, true, UInt(8, 16), "llvm.ppc.altivec.vsububs",
          u8(max(wild_i16x_ - wild_i16x_, 0))},
-        {false, true, Int(16, 8), "llvm.ppc.altivec.vaddshs",
+        {Target::FeatureEnd, true, Int(16, 8), "llvm.ppc.altivec.vaddshs",
          i16_sat(wild_i32x_ + wild_i32x_)},
-        {false, true, Int(16, 8), "llvm.ppc.altivec.vsubshs",
+        {Target::FeatureEnd, true, Int(16, 8), "llvm.ppc.altivec.vsubshs",
          i16_sat(wild_i32x_ - wild_i32x_)},
-        {false, true, UInt(16, 8), "llvm.ppc.altivec.vadduhs",
+        {Target::FeatureEnd, true, UInt(16, 8), "llvm.ppc.altivec.vadduhs",
          u16_sat(wild_u32x_ + wild_u32x_)},
-        {false, true, UInt(16, 8), "llvm.ppc.altivec.vsubuhs",
+        {Target::FeatureEnd, true, UInt(16, 8), "llvm.ppc.altivec.vsubuhs",
          u16(max(wild_i32x_ - wild_i32x_, 0))},
-        {false, true, Int(32, 4), "llvm.ppc.altivec.vaddsws",
+        {Target::FeatureEnd, true, Int(32, 4), "llvm.ppc.altivec.vaddsws",
          i32_sat(wild_i64x_ + wild_i64x_)},
-        {false, true, Int(32, 4), "llvm.ppc.altivec.vsubsws",
+        {Target::FeatureEnd, true, Int(32, 4), "llvm.ppc.altivec.vsubsws",
          i32_sat(wild_i64x_ - wild_i64x_)},
-        {false, true, UInt(32, 4), "llvm.ppc.altivec.vadduws",
+        {Target::FeatureEnd, true, UInt(32, 4), "llvm.ppc.altivec.vadduws",
          u32_sat(wild_u64x_ + wild_u64x_)},
-        {false, true, UInt(32, 4), "llvm.ppc.altivec.vsubuws",
+        {Target::FeatureEnd, true, UInt(32, 4), "llvm.ppc.altivec.vsubuws",
          u32(max(wild_i64x_ - wild_i64x_, 0))},
-        {false, true, Int(8, 16), "llvm.ppc.altivec.vavgsb",
+        {Target::FeatureEnd, true, Int(8, 16), "llvm.ppc.altivec.vavgsb",
          i8(((wild_i16x_ + wild_i16x_) + 1) / 2)},
-        {false, true, UInt(8, 16), "llvm.ppc.altivec.vavgub",
+        {Target::FeatureEnd, true, UInt(8, 16), "llvm.ppc.altivec.vavgub",
          u8(((wild_u16x_ + wild_u16x_) + 1) / 2)},
-        {false, true, Int(16, 8), "llvm.ppc.altivec.vavgsh",
+        {Target::FeatureEnd, true, Int(16, 8), "llvm.ppc.altivec.vavgsh",
          i16(((wild_i32x_ + wild_i32x_) + 1) / 2)},
-        {false, true, UInt(16, 8), "llvm.ppc.altivec.vavguh",
+        {Target::FeatureEnd, true, UInt(16, 8), "llvm.ppc.altivec.vavguh",
          u16(((wild_u32x_ + wild_u32x_) + 1) / 2)},
-        {false, true, Int(32, 4), "llvm.ppc.altivec.vavgsw",
+        {Target::FeatureEnd, true, Int(32, 4), "llvm.ppc.altivec.vavgsw",
          i32(((wild_i64x_ + wild_i64x_) + 1) / 2)},
-        {false, true, UInt(32, 4), "llvm.ppc.altivec.vavguw",
+        {Target::FeatureEnd, true, UInt(32, 4), "llvm.ppc.altivec.vavguw",
          u32(((wild_u64x_ + wild_u64x_) + 1) / 2)},
     };
 
     for (size_t i = 0; i < sizeof(patterns)/sizeof(patterns[0]); i++) {
         const Pattern &pattern = patterns[i];
 
-        if (!target.has_feature(Target::VSX) && pattern.needs_vsx) {
+        if (!target.has_feature(pattern.feature)) {
             continue;
         }
 
@@ -119,6 +119,97 @@ void CodeGen_PowerPC::visit(const Cast *op) {
         }
     }
 
+    // Saturating narrowing casts map to the pack instructions, which
+    // take two vectors of the wide type.
+    static Pattern pack_patterns[] = {
+        {Target::FeatureEnd, false, Int(8, 16), "llvm.ppc.altivec.vpkshss",
+         i8_sat(wild_i16x_)},
+        {Target::FeatureEnd, false, UInt(8, 16), "llvm.ppc.altivec.vpkshus",
+         u8_sat(wild_i16x_)},
+        {Target::FeatureEnd, false, UInt(8, 16), "llvm.ppc.altivec.vpkuhus",
+         u8_sat(wild_u16x_)},
+        {Target::FeatureEnd, false, Int(16, 8), "llvm.ppc.altivec.vpkswss",
+         i16_sat(wild_i32x_)},
+        {Target::FeatureEnd, false, UInt(16, 8), "llvm.ppc.altivec.vpkswus",
+         u16_sat(wild_i32x_)},
+        {Target::FeatureEnd, false, UInt(16, 8), "llvm.ppc.altivec.vpkuwus",
+         u16_sat(wild_u32x_)},
+        {Target::POWER_ARCH_2_07, false, Int(32, 4), "llvm.ppc.altivec.vpksdss",
+         i32_sat(wild_i64x_)},
+        {Target::POWER_ARCH_2_07, false, UInt(32, 4), "llvm.ppc.altivec.vpksdus",
+         u32_sat(wild_i64x_)},
+        {Target::POWER_ARCH_2_07, false, UInt(32, 4), "llvm.ppc.altivec.vpkudus",
+         u32_sat(wild_u64x_)},
+    };
+
+    for (size_t i = 0; i < sizeof(pack_patterns)/sizeof(pack_patterns[0]); i++) {
+        const Pattern &pattern = pack_patterns[i];
+
+        if (!target.has_feature(pattern.feature)) {
+            continue;
+        }
+
+        if (expr_match(pattern.pattern, op, matches)) {
+            value = call_pack(op->type, pattern.type.lanes(), pattern.intrin, codegen(matches[0]));
+            return;
+        }
+    }
+
+    CodeGen_Posix::visit(op);
+}
+
+Value *CodeGen_PowerPC::call_pack(Type t, int intrin_lanes, const string &name, Value *wide) {
+    // Each call packs a pair of wide vectors, each half the width of
+    // the result.
+    int lanes = t.lanes();
+    int half = intrin_lanes / 2;
+    llvm::Type *result_type = llvm_type_of(t.with_lanes(intrin_lanes));
+    vector<Value *> results;
+    for (int start = 0; start < lanes; start += intrin_lanes) {
+        Value *lo = slice_vector(wide, start, half);
+        Value *hi = slice_vector(wide, start + half, half);
+        // The pack instructions number lanes in big-endian order, so
+        // on little-endian targets the first operand supplies the
+        // upper lanes of the result.
+        if (target.bits == 64) {
+            std::swap(lo, hi);
+        }
+        results.push_back(call_intrin(result_type, intrin_lanes, name, {lo, hi}));
+    }
+    return slice_vector(concat_vectors(results), 0, lanes);
+}
+
+void CodeGen_PowerPC::visit(const Call *op) {
+    // POWER ISA 3.00 has absolute differences of unsigned
+    // integers. Signed integers are biased into unsigned ones by
+    // flipping their sign bits first, which doesn't change their
+    // differences.
+    Type t = op->type;
+    if (op->is_intrinsic(Call::absd) &&
+        t.is_vector() &&
+        target.has_feature(Target::POWER_ARCH_3_00) &&
+        LLVM_VERSION >= 40) {
+        Type arg_t = op->args[0].type();
+        const char *suffix = nullptr;
+        switch (arg_t.bits()) {
+        case  8: suffix = "ub"; break;
+        case 16: suffix = "uh"; break;
+        case 32: suffix = "uw"; break;
+        }
+        if (suffix && !arg_t.is_float()) {
+            vector<Expr> args = op->args;
+            if (arg_t.is_int()) {
+                Expr sign = make_const(t, (uint64_t)1 << (t.bits() - 1));
+                for (Expr &a : args) {
+                    a = reinterpret(t, a) ^ sign;
+                }
+            }
+            value = call_intrin(t, 128 / t.bits(),
+                                std::string("llvm.ppc.altivec.vabsd") + suffix, args);
+            return;
+        }
+    }
+
     CodeGen_Posix::visit(op);
 }
 
@@ -178,7 +269,9 @@ string CodeGen_PowerPC::mcpu() const {
     if (target.bits == 32) {
         return "ppc32";
     } else {
-        if (target.has_feature(Target::POWER_ARCH_2_07))
+        if (target.has_feature(Target::POWER_ARCH_3_00) && LLVM_VERSION >= 40)
+            return "pwr9";
+        else if (target.has_feature(Target::POWER_ARCH_2_07))
             return "pwr8";
         else if (target.has_feature(Target::VSX))
             return "pwr7";
@@ -209,6 +302,15 @@ string CodeGen_PowerPC::mattrs() const {
     features += separator + enable + "direct-move";
     separator = ",";
 
+    #if LLVM_VERSION >= 40
+    // POWER ISA 3.00 (POWER9) adds absolute differences, more
+    // flexible permutes, and byte reversal to the vector units.
+    enable = target.has_feature(Target::POWER_ARCH_3_00) ? "+" : "-";
+    features += separator + enable + "power9-altivec";
+    features += separator + enable + "power9-vector";
+    separator = ",";
+    #endif
+
     return features;
 }
 
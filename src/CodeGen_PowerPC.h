@@ -33,11 +33,16 @@ protected:
     void visit(const Cast *);
     void visit(const Min *);
     void visit(const Max *);
+    void visit(const Call *);
     // @}
 
     // Call an intrinsic as defined by a pattern. Dispatches to the
 private:
     static const char* altivec_int_type_name(const Type&);
+
+    /** Call one of the pack intrinsics, which narrow a pair of
+     * vectors into one, on a vector of the wide type. */
+    llvm::Value *call_pack(Type t, int intrin_lanes, const std::string &name, llvm::Value *wide);
 };
 
 }}
@@ -1,4 +1,5 @@
 #include <iostream>
+#include <algorithm>
 
 #include "CodeGen_X86.h"
 #include "ConciseCasts.h"
@@ -60,13 +61,108 @@ bool should_use_pmaddwd(Expr a, Expr b, vector<Expr> &result) {
     return true;
 }
 
+bool has_avx512(const Target &t) {
+    return (t.has_feature(Target::AVX512) ||
+            t.has_feature(Target::AVX512_KNL) ||
+            t.has_feature(Target::AVX512_Skylake) ||
+            t.has_feature(Target::AVX512_Cannonlake));
 }
 
+// AVX512BW, which has the 8- and 16-bit integer instructions.
+bool has_avx512bw(const Target &t) {
+    return (t.has_feature(Target::AVX512_Skylake) ||
+            t.has_feature(Target::AVX512_Cannonlake));
+}
+
+}
+
+void CodeGen_X86::init_float_environment() {
+    if (!target.has_feature(Target::FastMath)) {
+        return;
+    }
+
+    // Save MXCSR, to restore it on the way out, and set the FTZ and
+    // DAZ bits.
+    llvm::Type *void_ptr = i8_t->getPointerTo();
+    llvm::Function *stmxcsr = Intrinsic::getDeclaration(module.get(), Intrinsic::x86_sse_stmxcsr);
+    llvm::Function *ldmxcsr = Intrinsic::getDeclaration(module.get(), Intrinsic::x86_sse_ldmxcsr);
+    Value *saved = create_alloca_at_entry(i32_t, 1);
+    Value *saved_ptr = builder->CreatePointerCast(saved, void_ptr);
+    builder->CreateCall(stmxcsr, {saved_ptr});
+    Value *flush = builder->CreateOr(builder->CreateLoad(saved), ConstantInt::get(i32_t, 0x8040));
+    Value *flush_slot = create_alloca_at_entry(i32_t, 1);
+    builder->CreateStore(flush, flush_slot);
+    builder->CreateCall(ldmxcsr, {builder->CreatePointerCast(flush_slot, void_ptr)});
+
+    llvm::Function *restore = module->getFunction("halide_x86_set_mxcsr_as_destructor");
+    internal_assert(restore) << "Could not find halide_x86_set_mxcsr_as_destructor in initial module\n";
+    register_destructor(restore, saved_ptr, Always);
+}
+
+void CodeGen_X86::codegen_pmaddwd(Type t, const vector<Expr> &args) {
+    #if LLVM_VERSION >= 40
+    if (has_avx512bw(target) && t.lanes() % 16 == 0) {
+        // Do 16 lanes at a time in a zmm register, rather than
+        // leaving llvm to split the 4- and 8-wide versions in the
+        // initial module back up. The masked form of the intrinsic
+        // is the only one llvm has, so pass an all-true mask.
+        vector<Value *> v(args.size());
+        for (size_t i = 0; i < args.size(); i++) {
+            v[i] = codegen(args[i]);
+        }
+        llvm::Type *result_t = llvm::VectorType::get(i32_t, 16);
+        Value *passthru = Constant::getNullValue(result_t);
+        Value *mask = ConstantInt::get(i16_t, -1);
+        vector<Value *> results;
+        for (int i = 0; i < t.lanes(); i += 16) {
+            Value *ac = interleave_vectors({slice_vector(v[0], i, 16), slice_vector(v[2], i, 16)});
+            Value *bd = interleave_vectors({slice_vector(v[1], i, 16), slice_vector(v[3], i, 16)});
+            results.push_back(call_intrin(result_t, 16, "llvm.x86.avx512.mask.pmaddw.d.512",
+                                          {ac, bd, passthru, mask}));
+        }
+        value = concat_vectors(results);
+        return;
+    }
+    #endif
+    codegen(Call::make(t, "pmaddwd", args, Call::Extern));
+}
+
+
+void CodeGen_X86::codegen_f16c_cast(Type t, Expr e) {
+    // The intrinsics traffic in the bits of the halfs, as 8 x i16.
+    Value *v = codegen(e);
+    bool widening = t.bits() == 32;
+    if (widening) {
+        v = builder->CreateBitCast(v, llvm::VectorType::get(i16_t, t.lanes()));
+    }
+    int intrin_lanes = target.has_feature(Target::AVX) ? 8 : 4;
+    llvm::Type *i16x8_t = llvm::VectorType::get(i16_t, 8);
+    llvm::Type *f32_slice_t = llvm::VectorType::get(f32_t, intrin_lanes);
+    string suffix = intrin_lanes == 8 ? ".256" : ".128";
+    vector<Value *> results;
+    for (int i = 0; i < t.lanes(); i += intrin_lanes) {
+        if (widening) {
+            Value *slice = slice_vector(v, i, 8);
+            Value *r = call_intrin(f32_slice_t, intrin_lanes, "llvm.x86.vcvtph2ps" + suffix, {slice});
+            results.push_back(r);
+        } else {
+            // Round to nearest, ties to even.
+            Value *slice = slice_vector(v, i, intrin_lanes);
+            Value *r = call_intrin(i16x8_t, 8, "llvm.x86.vcvtps2ph" + suffix,
+                                   {slice, ConstantInt::get(i32_t, 0)});
+            results.push_back(slice_vector(r, 0, intrin_lanes));
+        }
+    }
+    value = slice_vector(concat_vectors(results), 0, t.lanes());
+    if (!widening) {
+        value = builder->CreateBitCast(value, llvm_type_of(t));
+    }
+}
 
 void CodeGen_X86::visit(const Add *op) {
     vector<Expr> matches;
     if (should_use_pmaddwd(op->a, op->b, matches)) {
-        codegen(Call::make(op->type, "pmaddwd", matches, Call::Extern));
+        codegen_pmaddwd(op->type, matches);
     } else {
         CodeGen_Posix::visit(op);
     }
@@ -82,7 +178,7 @@ void CodeGen_X86::visit(const Sub *op) {
         } else {
             matches[3] = -matches[3];
         }
-        codegen(Call::make(op->type, "pmaddwd", matches, Call::Extern));
+        codegen_pmaddwd(op->type, matches);
     } else {
         CodeGen_Posix::visit(op);
     }
@@ -207,6 +303,13 @@ void CodeGen_X86::visit(const Cast *op) {
         return;
     }
 
+    if (target.has_feature(Target::F16C) &&
+        ((op->type.element_of() == Float(32) && op->value.type().element_of() == Float(16)) ||
+         (op->type.element_of() == Float(16) && op->value.type().element_of() == Float(32)))) {
+        codegen_f16c_cast(op->type, op->value);
+        return;
+    }
+
     vector<Expr> matches;
 
     struct Pattern {
@@ -404,11 +507,138 @@ void CodeGen_X86::visit(const Call *op) {
                           cast(wider, op->args[0]) <<
                           cast(wider, op->args[1]));
         codegen(equiv);
+    } else if (op->is_intrinsic(Call::vector_reduce_add) &&
+               op->type.bits() >= 16 &&
+               (op->type.is_int() || op->type.is_uint())) {
+        // Sums of widened bytes can use psadbw, which sums each group
+        // of eight bytes into a 64-bit lane.
+        const Cast *cast = op->args[0].as<Cast>();
+        int lanes = op->args[0].type().lanes();
+        if (cast && cast->value.type().element_of() == UInt(8) && lanes % 16 == 0) {
+            llvm::Type *i64x2 = llvm::VectorType::get(i64_t, 2);
+            llvm::Type *i8x16 = llvm::VectorType::get(i8_t, 16);
+            llvm::Function *psadbw = module->getFunction("llvm.x86.sse2.psad.bw");
+            if (!psadbw) {
+                FunctionType *func_t = FunctionType::get(i64x2, {i8x16, i8x16}, false);
+                psadbw = llvm::Function::Create(func_t, llvm::Function::ExternalLinkage,
+                                                "llvm.x86.sse2.psad.bw", module.get());
+            }
+            Value *bytes = codegen(cast->value);
+            Value *zero = Constant::getNullValue(i8x16);
+            Value *sum = nullptr;
+            for (int i = 0; i < lanes; i += 16) {
+                Value *s = builder->CreateCall(psadbw, {slice_vector(bytes, i, 16), zero});
+                sum = sum ? builder->CreateAdd(sum, s) : s;
+            }
+            sum = builder->CreateAdd(builder->CreateExtractElement(sum, ConstantInt::get(i32_t, 0)),
+                                     builder->CreateExtractElement(sum, ConstantInt::get(i32_t, 1)));
+            value = builder->CreateIntCast(sum, llvm_type_of(op->type), false);
+        } else {
+            CodeGen_Posix::visit(op);
+        }
     } else {
         CodeGen_Posix::visit(op);
     }
 }
 
+Value *CodeGen_X86::shuffle_vectors(Value *a, Value *b, const vector<int> &indices) {
+    llvm::Type *elem_t = a->getType()->getScalarType();
+    int elem_bits = elem_t->getPrimitiveSizeInBits();
+    if (!has_avx512(target) || elem_bits < 8) {
+        return CodeGen_Posix::shuffle_vectors(a, b, indices);
+    }
+
+    // llvm already makes a good vpermt2 out of a shuffle of two
+    // native vectors, but shuffles of anything wider (e.g. the
+    // deinterleaves of wide loads) get legalized piecemeal. Instead,
+    // find the (at most) two native vectors of the source each native
+    // vector of the result draws from, and shuffle just those.
+    int native_lanes = 512 / elem_bits;
+    int src_lanes = a->getType()->getVectorNumElements();
+    if (src_lanes <= native_lanes || src_lanes % native_lanes != 0) {
+        return CodeGen_Posix::shuffle_vectors(a, b, indices);
+    }
+
+    vector<vector<int>> sources;
+    for (size_t i = 0; i < indices.size(); i += native_lanes) {
+        vector<int> blocks;
+        for (size_t j = i; j < std::min(indices.size(), i + native_lanes); j++) {
+            if (indices[j] < 0) continue;
+            int block = indices[j] / native_lanes;
+            if (std::find(blocks.begin(), blocks.end(), block) == blocks.end()) {
+                blocks.push_back(block);
+            }
+        }
+        if (blocks.size() > 2) {
+            return CodeGen_Posix::shuffle_vectors(a, b, indices);
+        }
+        sources.push_back(blocks);
+    }
+
+    // Everything below must call the base class shuffle, so that
+    // slicing and concatenating don't come back through here.
+    auto block_of = [&](int block) {
+        Value *v = block * native_lanes < src_lanes ? a : b;
+        int start = (block * native_lanes) % src_lanes;
+        vector<int> slice(native_lanes);
+        for (int i = 0; i < native_lanes; i++) {
+            slice[i] = start + i;
+        }
+        return CodeGen_Posix::shuffle_vectors(v, UndefValue::get(v->getType()), slice);
+    };
+
+    vector<Value *> results;
+    for (size_t c = 0; c < sources.size(); c++) {
+        const vector<int> &blocks = sources[c];
+        size_t begin = c * native_lanes;
+        vector<int> chunk(native_lanes, -1);
+        for (size_t j = begin; j < std::min(indices.size(), begin + native_lanes); j++) {
+            if (indices[j] < 0) continue;
+            int block = indices[j] / native_lanes;
+            int which = block == blocks[0] ? 0 : 1;
+            chunk[j - begin] = which * native_lanes + indices[j] % native_lanes;
+        }
+        Value *first = blocks.empty() ? UndefValue::get(VectorType::get(elem_t, native_lanes)) : block_of(blocks[0]);
+        Value *second = blocks.size() < 2 ? UndefValue::get(first->getType()) : block_of(blocks[1]);
+        results.push_back(CodeGen_Posix::shuffle_vectors(first, second, chunk));
+    }
+
+    while (results.size() > 1) {
+        vector<Value *> merged;
+        for (size_t i = 0; i + 1 < results.size(); i += 2) {
+            int lanes = results[i]->getType()->getVectorNumElements();
+            vector<int> concat(lanes * 2);
+            for (int j = 0; j < lanes * 2; j++) {
+                concat[j] = j;
+            }
+            merged.push_back(CodeGen_Posix::shuffle_vectors(results[i], results[i+1], concat));
+        }
+        if (results.size() & 1) {
+            // Pad the odd one out so that it can be merged with
+            // vectors of its width in the next round.
+            Value *last = results.back();
+            int lanes = last->getType()->getVectorNumElements();
+            vector<int> pad(lanes * 2);
+            for (int j = 0; j < lanes * 2; j++) {
+                pad[j] = j < lanes ? j : -1;
+            }
+            merged.push_back(CodeGen_Posix::shuffle_vectors(last, UndefValue::get(last->getType()), pad));
+        }
+        results.swap(merged);
+    }
+
+    // Trim off the padding.
+    int result_lanes = results[0]->getType()->getVectorNumElements();
+    if (result_lanes == (int)indices.size()) {
+        return results[0];
+    }
+    vector<int> trim(indices.size());
+    for (size_t i = 0; i < indices.size(); i++) {
+        trim[i] = i;
+    }
+    return CodeGen_Posix::shuffle_vectors(results[0], UndefValue::get(results[0]->getType()), trim);
+}
+
 string CodeGen_X86::mcpu() const {
     #if LLVM_VERSION >= 40
     if (target.has_feature(Target::AVX512_Cannonlake)) return "cannonlake";
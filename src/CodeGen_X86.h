@@ -31,6 +31,17 @@ protected:
 
     Expr mulhi_shr(Expr a, Expr b, int shr);
 
+    /** With fast math, flush denormals to zero (and treat denormal
+     * inputs as zero) until the function returns. */
+    void init_float_environment();
+
+    /** On AVX-512, break shuffles of sources wider than two native
+     * vectors into one two-source shuffle per native vector of the
+     * result, which each map to a single vpermt2. */
+    llvm::Value *shuffle_vectors(llvm::Value *a, llvm::Value *b,
+                                 const std::vector<int> &indices);
+    using CodeGen_Posix::shuffle_vectors;
+
     using CodeGen_Posix::visit;
 
     /** Nodes for which we want to emit specific sse/avx intrinsics */
@@ -49,6 +60,16 @@ protected:
     void visit(const NE *);
     void visit(const Select *);
     // @}
+
+private:
+    /** Generate a vector of pairwise i16 multiply-adds
+     * a*b + c*d. See should_use_pmaddwd. */
+    void codegen_pmaddwd(Type t, const std::vector<Expr> &args);
+
+    /** Convert a vector between Float(16) and Float(32) with the
+     * F16C instructions, 8 lanes at a time with AVX, or 4
+     * without. */
+    void codegen_f16c_cast(Type t, Expr e);
 };
 
 }}
@@ -0,0 +1,217 @@
+#include <algorithm>
+#include <functional>
+#include <sstream>
+
+#include "CodeSize.h"
+#include "Debug.h"
+#include "Function.h"
+#include "IROperator.h"
+#include "IRVisitor.h"
+#include "Simplify.h"
+#include "Util.h"
+
+namespace Halide {
+namespace Internal {
+
+using std::map;
+using std::set;
+using std::string;
+using std::vector;
+
+namespace {
+
+// Unknown extents are assumed to be this many iterations.
+const double unknown_trip_count = 16;
+
+// The small_code target feature's budget for the Funcs without one.
+const float small_code_budget = 2.0f;
+
+// Counts the IR nodes of a Stmt as a tree, in total and by the Func
+// of the innermost loop they are in.
+class CountCodeSize : public IRGraphVisitor {
+    using IRGraphVisitor::visit;
+
+    std::function<string(const string &)> func_of_loop;
+    string current_func;
+
+    void include(const Expr &e) {
+        count();
+        e.accept(this);
+    }
+
+    void include(const Stmt &s) {
+        count();
+        s.accept(this);
+    }
+
+    void count() {
+        total++;
+        if (!current_func.empty()) {
+            sizes[current_func]++;
+        }
+    }
+
+    void visit(const For *op) {
+        string old_func = current_func;
+        string f = func_of_loop(op->name);
+        if (!f.empty()) {
+            current_func = f;
+        }
+        IRGraphVisitor::visit(op);
+        current_func = old_func;
+    }
+
+public:
+    int64_t total = 0;
+    map<string, int64_t> sizes;
+
+    CountCodeSize(std::function<string(const string &)> func_of_loop)
+        : func_of_loop(func_of_loop) {}
+
+    void count(const Stmt &s) {
+        if (s.defined()) {
+            include(s);
+        }
+    }
+};
+
+// Prints each loop with its code size, indented by its depth.
+class PrintLoopNests : public IRVisitor {
+    using IRVisitor::visit;
+
+    int depth = 1;
+
+    void visit(const For *op) {
+        report << string(2 * depth, ' ') << op->name << ": " << code_size(op) << "\n";
+        depth++;
+        IRVisitor::visit(op);
+        depth--;
+    }
+
+public:
+    std::ostringstream report;
+};
+
+}  // namespace
+
+int64_t code_size(const Stmt &s) {
+    CountCodeSize counter([](const string &) { return string(); });
+    counter.count(s);
+    return counter.total;
+}
+
+CodeSizeBudget::CodeSizeBudget(const Stmt &s, const map<string, Function> &env, const Target &t) {
+    map<string, float> factors;
+    for (const auto &iter : env) {
+        funcs.push_back(iter.first);
+        float factor = iter.second.schedule().code_size_budget();
+        if (factor == 0 && t.has_feature(Target::SmallCode)) {
+            factor = small_code_budget;
+        }
+        if (factor > 0) {
+            factors[iter.first] = factor;
+        }
+    }
+    if (factors.empty()) {
+        return;
+    }
+
+    map<string, int64_t> sizes = func_sizes(s);
+    for (const auto &iter : factors) {
+        baseline[iter.first] = sizes[iter.first];
+        limits[iter.first] = (int64_t)(iter.second * sizes[iter.first]);
+    }
+}
+
+string CodeSizeBudget::func_of_loop(const string &loop) const {
+    // Loops are named <func>.s<stage>.<var>. Func names can contain
+    // dots, so take the longest one that matches.
+    string result;
+    for (const string &f : funcs) {
+        if (f.size() > result.size() && starts_with(loop, f + ".s")) {
+            result = f;
+        }
+    }
+    return result;
+}
+
+map<string, int64_t> CodeSizeBudget::func_sizes(const Stmt &s) const {
+    CountCodeSize counter([this](const string &loop) { return func_of_loop(loop); });
+    counter.count(s);
+    return counter.sizes;
+}
+
+set<string> CodeSizeBudget::deny(const Stmt &s, vector<Growth> growths, const string &pass) {
+    set<string> result;
+    if (empty()) {
+        return result;
+    }
+
+    // Growing the code of a loop is charged to the Func of the loop.
+    map<string, int64_t> sizes = func_sizes(s);
+    std::stable_sort(growths.begin(), growths.end(),
+                     [](const Growth &a, const Growth &b) { return a.trip_count > b.trip_count; });
+    for (const Growth &g : growths) {
+        auto limit = limits.find(func_of_loop(g.loop));
+        if (limit == limits.end()) {
+            continue;
+        }
+        int64_t &size = sizes[limit->first];
+        if (size + g.growth <= limit->second) {
+            size += g.growth;
+        } else {
+            debug(1) << "Not " << pass << " " << g.loop << ": it would grow the code of "
+                     << limit->first << " from " << size << " to " << size + g.growth
+                     << " IR nodes, over its budget of " << limit->second << "\n";
+            result.insert(g.loop);
+            denied.push_back({pass, g.loop});
+        }
+    }
+    return result;
+}
+
+double CodeSizeBudget::trip_count(const Expr &extent) {
+    const int64_t *e = as_const_int(simplify(extent));
+    return e ? std::max<int64_t>(*e, 1) : unknown_trip_count;
+}
+
+void CodeSizeBudget::report(const Stmt &s, const string &pipeline_name) const {
+    std::ostringstream report;
+    report << "Code size of " << pipeline_name << ": " << code_size(s) << " IR nodes\n"
+           << " Loop nests:\n";
+    PrintLoopNests loops;
+    s.accept(&loops);
+    report << loops.report.str();
+
+    report << " Funcs:\n";
+    map<string, int64_t> sizes = func_sizes(s);
+    for (const auto &iter : sizes) {
+        report << "  " << iter.first << ": " << iter.second;
+        auto limit = limits.find(iter.first);
+        if (limit != limits.end()) {
+            report << " (" << baseline.at(iter.first) << " before unrolling and partitioning, budget "
+                   << limit->second << ")";
+        }
+        report << "\n";
+    }
+
+    if (!denied.empty()) {
+        report << " Left alone to stay within budget:\n";
+        for (const auto &d : denied) {
+            report << "  " << d.second << " (not " << d.first << ")\n";
+        }
+    }
+    debug(0) << report.str();
+}
+
+bool report_code_size() {
+    static bool enabled = []() {
+        size_t defined = 0;
+        string value = get_env_variable("HL_CODE_SIZE_REPORT", defined);
+        return defined && value != "0";
+    }();
+    return enabled;
+}
+
+}
+}
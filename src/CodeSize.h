@@ -0,0 +1,90 @@
+#ifndef HALIDE_CODE_SIZE_H
+#define HALIDE_CODE_SIZE_H
+
+/** \file
+ * Defines a budget for how much the lowering passes that duplicate
+ * code (unrolling and loop partitioning) may grow the loop nests of
+ * each Func, and a report of the code size of each loop nest.
+ */
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "IR.h"
+#include "Target.h"
+
+namespace Halide {
+namespace Internal {
+
+class Function;
+
+/** The number of IR nodes in a Stmt, counted as a tree. This is
+ * roughly proportional to the size of the code it compiles to. */
+int64_t code_size(const Stmt &s);
+
+/** The code-size budgets of the Funcs of a pipeline. Each Func's
+ * budget is a multiple of the size of its code before unrolling and
+ * partitioning: the one set with Func::code_size_budget, or with the
+ * small_code target feature, 2 for the Funcs without one. The code
+ * of a Func is the IR in its loops, but not in the loops of other
+ * Funcs within them. */
+class CodeSizeBudget {
+public:
+    /** One way a pass could grow the code: by unrolling or
+     * partitioning the named loop, which adds growth IR nodes, in
+     * code that runs about trip_count times. */
+    struct Growth {
+        std::string loop;
+        int64_t growth;
+        double trip_count;
+    };
+
+    /** No budgets. */
+    CodeSizeBudget() {}
+
+    /** The budgets of the Funcs in env, relative to the size of their
+     * code in s. */
+    CodeSizeBudget(const Stmt &s, const std::map<std::string, Function> &env, const Target &t);
+
+    /** Whether any Func has a budget. */
+    bool empty() const {
+        return limits.empty();
+    }
+
+    /** Choose which of the given ways to grow the code of s to leave
+     * out, so that each Func stays within its budget. The ones in the
+     * hottest code (by trip count) are chosen first. Returns the
+     * names of the loops to leave alone. */
+    std::set<std::string> deny(const Stmt &s, std::vector<Growth> growths, const std::string &pass);
+
+    /** An estimate of the trip count of a loop from its extent. */
+    static double trip_count(const Expr &extent);
+
+    /** Print the code size of each loop nest in s, and of each Func
+     * against its budget, with debug(0). */
+    void report(const Stmt &s, const std::string &pipeline_name) const;
+
+private:
+    std::vector<std::string> funcs;
+    // The code size of each Func with a budget before unrolling and
+    // partitioning, and the most it may grow to.
+    std::map<std::string, int64_t> baseline, limits;
+    // The loops left alone, with the pass that left them.
+    std::vector<std::pair<std::string, std::string>> denied;
+
+    // The Func a loop belongs to, or the empty string.
+    std::string func_of_loop(const std::string &loop) const;
+    // The code size of each Func in s.
+    std::map<std::string, int64_t> func_sizes(const Stmt &s) const;
+};
+
+/** Whether HL_CODE_SIZE_REPORT is set, which makes lowering print
+ * CodeSizeBudget::report for each pipeline. */
+bool report_code_size();
+
+}
+}
+
+#endif
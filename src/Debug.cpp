@@ -1,10 +1,27 @@
+#include <mutex>
+
 #include "Debug.h"
 
 namespace Halide {
 namespace Internal {
 
 int debug::debug_level = 0;
-bool debug::initialized = false;
+std::atomic<bool> debug::initialized(false);
+
+void debug::initialize() {
+    static std::mutex initialize_mutex;
+    std::lock_guard<std::mutex> lock(initialize_mutex);
+    if (!initialized) {
+        size_t read;
+        std::string lvl = get_env_variable("HL_DEBUG_CODEGEN", read);
+        if (read) {
+            debug_level = atoi(lvl.c_str());
+        } else {
+            debug_level = 0;
+        }
+        initialized = true;
+    }
+}
 
 }
 }
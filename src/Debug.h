@@ -5,6 +5,7 @@
  * Defines functions for debug logging during code generation.
  */
 
+#include <atomic>
 #include <iostream>
 #include <string>
 #include <stdlib.h>
@@ -46,20 +47,16 @@ EXPORT std::ostream &operator << (std::ostream &, const LoweredFunc &);
 
 struct debug {
     EXPORT static int debug_level;
-    EXPORT static bool initialized;
+    EXPORT static std::atomic<bool> initialized;
     int verbosity;
 
+    /** Read the debug level from the environment. Safe to call from
+     * several threads at once. */
+    EXPORT static void initialize();
+
     debug(int v) : verbosity(v) {
         if (!initialized) {
-            // Read the debug level from the environment
-            size_t read;
-            std::string lvl = get_env_variable("HL_DEBUG_CODEGEN", read);
-            if (read) {
-                debug_level = atoi(lvl.c_str());
-            } else {
-                debug_level = 0;
-            }
-            initialized = true;
+            initialize();
         }
     }
 
@@ -3,6 +3,7 @@
 #include <sstream>
 
 #include "DebugToFile.h"
+#include "InjectHostDevBufferCopies.h"
 #include "IRMutator.h"
 #include "IROperator.h"
 
@@ -79,6 +80,7 @@ class DebugToFile : public IRMutator {
                                                     Call::Extern));
             body = LetStmt::make(call_result_name, call, body);
             body = Block::make(mutate(op->body), body);
+            found = true;
 
             stmt = Realize::make(op->name, op->types, op->bounds, op->condition, body);
 
@@ -88,7 +90,9 @@ class DebugToFile : public IRMutator {
     }
 
 public:
-    DebugToFile(const map<string, Function> &e) : env(e) {}
+    bool found;
+
+    DebugToFile(const map<string, Function> &e) : env(e), found(false) {}
 };
 
 class RemoveDummyRealizations : public IRMutator {
@@ -122,11 +126,17 @@ Stmt debug_to_file(Stmt s, const vector<Function> &outputs, const map<string, Fu
         }
         s = Realize::make(out.name(), out.output_types(), output_bounds, const_true(), s);
     }
-    s = DebugToFile(env).mutate(s);
+    DebugToFile injector(env);
+    s = injector.mutate(s);
 
     // Remove the realize node we wrapped around the output
     s = RemoveDummyRealizations(outputs).mutate(s);
 
+    // Wait for any asynchronous writes to finish before returning.
+    if (injector.found) {
+        s = Block::make(s, call_extern_and_assert("halide_debug_to_file_flush", {}));
+    }
+
     return s;
 }
 
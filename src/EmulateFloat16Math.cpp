@@ -0,0 +1,346 @@
+#include "EmulateFloat16Math.h"
+#include "Float16.h"
+#include "IRMutator.h"
+#include "IROperator.h"
+#include "Scope.h"
+#include "Util.h"
+
+namespace Halide {
+namespace Internal {
+
+using std::string;
+using std::vector;
+
+Expr float16_bits_to_float32(Expr bits) {
+    Type u = UInt(32, bits.type().lanes());
+    Type f = Float(32, bits.type().lanes());
+    Expr h = cast(u, bits);
+    Expr sign = (h & make_const(u, 0x8000)) << 16;
+    Expr exponent = (h >> 10) & make_const(u, 0x1f);
+
+    // Normal numbers just need their exponent rebiased. Infinities
+    // and NaNs need the maximum exponent instead.
+    Expr bias = select(exponent == make_const(u, 31),
+                       make_const(u, 224 << 23),
+                       make_const(u, 112 << 23));
+    Expr normal = (((h & make_const(u, 0x7fff)) << 13) + bias) | sign;
+
+    // Denormals (and zero) are their mantissa times 2^-24.
+    Expr denormal = cast(f, h & make_const(u, 0x3ff)) * make_const(f, 1.0 / (1 << 24));
+    denormal = reinterpret(u, denormal) | sign;
+
+    return reinterpret(f, select(exponent == make_const(u, 0), denormal, normal));
+}
+
+Expr float32_to_float16_bits(Expr value) {
+    Type u = UInt(32, value.type().lanes());
+    Type f = Float(32, value.type().lanes());
+    Expr bits = reinterpret(u, value);
+    Expr sign = bits & make_const(u, (uint64_t)0x80000000);
+    Expr a = bits ^ sign;
+
+    // Too big for a half (including infinities), or NaN.
+    Expr inf_or_nan = select(a > make_const(u, 0x7f800000),
+                             make_const(u, 0x7e00),
+                             make_const(u, 0x7c00));
+
+    // Results that are denormal as halfs are rounded by adding 0.5f,
+    // which puts the half's mantissa in the low bits of the float.
+    Expr denormal = reinterpret(u, reinterpret(f, a) + make_const(f, 0.5f)) - make_const(u, 0x3f000000);
+
+    // Otherwise, rebias the exponent and round the mantissa to
+    // nearest, ties to even. A carry out of the mantissa correctly
+    // bumps the exponent, all the way to infinity.
+    Expr odd = (a >> 13) & make_const(u, 1);
+    Expr normal = (a + make_const(u, (uint64_t)0xc8000fff) + odd) >> 13;
+
+    Expr result = select(a >= make_const(u, 0x47800000), inf_or_nan,
+                         select(a < make_const(u, 0x38800000), denormal, normal));
+    return cast(UInt(16, value.type().lanes()), result | (sign >> 16));
+}
+
+namespace {
+
+enum class Float16Support {
+    NativeArithmetic,
+    NativeConversions,
+    None
+};
+
+Float16Support float16_support(const Target &t, DeviceAPI device_api) {
+    switch (device_api) {
+    case DeviceAPI::Metal:
+    case DeviceAPI::GLSL:
+    case DeviceAPI::OpenGLCompute:
+        // These shading languages have half types of their own.
+        return Float16Support::NativeArithmetic;
+    case DeviceAPI::CUDA:
+        // The NVPTX backend only knows about halfs from llvm 5. Half
+        // arithmetic exists from sm_53, but it's only as fast as
+        // float arithmetic from sm_70.
+        if (LLVM_VERSION >= 60 && t.has_feature(Target::CUDACapability70)) {
+            return Float16Support::NativeArithmetic;
+        }
+        return LLVM_VERSION >= 50 ?
+            Float16Support::NativeConversions :
+            Float16Support::None;
+    case DeviceAPI::OpenCL:
+    case DeviceAPI::Hexagon:
+        return Float16Support::None;
+    default:
+        break;
+    }
+
+    if (t.arch == Target::ARM && t.bits == 64) {
+        return t.has_feature(Target::ARMFp16) ?
+            Float16Support::NativeArithmetic :
+            Float16Support::NativeConversions;
+    } else if (t.arch == Target::X86 && t.has_feature(Target::F16C)) {
+        return Float16Support::NativeConversions;
+    } else {
+        return Float16Support::None;
+    }
+}
+
+bool is_float16(Type t) {
+    return t.is_float() && t.bits() == 16;
+}
+
+Type bits_type(Type t) {
+    return t.with_code(Type::UInt);
+}
+
+Expr reinterpret_if_needed(Type t, Expr e) {
+    return e.type() == t ? e : reinterpret(t, e);
+}
+
+class EmulateFloat16Math : public IRMutator {
+    using IRMutator::visit;
+
+    const Target &target;
+    Float16Support support;
+
+    // Which Float(16) lets currently hold bits instead.
+    Scope<bool> bits_vars;
+
+    bool emulating() const {
+        return support != Float16Support::NativeArithmetic;
+    }
+
+    Expr to_float32(Expr bits) {
+        if (support == Float16Support::NativeConversions) {
+            Type t = bits.type();
+            return cast(Float(32, t.lanes()), reinterpret(Float(16, t.lanes()), bits));
+        } else {
+            return float16_bits_to_float32(bits);
+        }
+    }
+
+    Expr to_float16_bits(Expr value) {
+        Type t = value.type();
+        if (t.element_of() != Float(32)) {
+            // Note that this rounds twice when narrowing doubles.
+            value = cast(Float(32, t.lanes()), value);
+        }
+        if (support == Float16Support::NativeConversions) {
+            return reinterpret(UInt(16, t.lanes()), cast(Float(16, t.lanes()), value));
+        } else {
+            return float32_to_float16_bits(value);
+        }
+    }
+
+    // Mutate an Expr, widening it to a Float(32) if it was a Float(16).
+    Expr mutate_widened(Expr e) {
+        Expr m = mutate(e);
+        return is_float16(e.type()) ? to_float32(m) : m;
+    }
+
+    template<typename T>
+    void visit_binary(const T *op) {
+        if (emulating() && is_float16(op->a.type())) {
+            Expr e = T::make(mutate_widened(op->a), mutate_widened(op->b));
+            // Comparisons are already done.
+            expr = is_float16(op->type) ? to_float16_bits(e) : e;
+        } else {
+            IRMutator::visit(op);
+        }
+    }
+
+    void visit(const Add *op) { visit_binary(op); }
+    void visit(const Sub *op) { visit_binary(op); }
+    void visit(const Mul *op) { visit_binary(op); }
+    void visit(const Div *op) { visit_binary(op); }
+    void visit(const Mod *op) { visit_binary(op); }
+    void visit(const Min *op) { visit_binary(op); }
+    void visit(const Max *op) { visit_binary(op); }
+    void visit(const EQ *op) { visit_binary(op); }
+    void visit(const NE *op) { visit_binary(op); }
+    void visit(const LT *op) { visit_binary(op); }
+    void visit(const LE *op) { visit_binary(op); }
+    void visit(const GT *op) { visit_binary(op); }
+    void visit(const GE *op) { visit_binary(op); }
+
+    void visit(const FloatImm *op) {
+        if (emulating() && is_float16(op->type)) {
+            expr = UIntImm::make(UInt(16), float16_t(op->value).to_bits());
+        } else {
+            expr = op;
+        }
+    }
+
+    void visit(const Cast *op) {
+        if (!emulating()) {
+            IRMutator::visit(op);
+        } else if (is_float16(op->value.type())) {
+            Expr value = mutate_widened(op->value);
+            expr = is_float16(op->type) ? to_float16_bits(value) : cast(op->type, value);
+        } else if (is_float16(op->type)) {
+            expr = to_float16_bits(mutate(op->value));
+        } else {
+            IRMutator::visit(op);
+        }
+    }
+
+    void visit(const Ramp *op) {
+        if (emulating() && is_float16(op->type)) {
+            expr = to_float16_bits(Ramp::make(mutate_widened(op->base),
+                                              mutate_widened(op->stride),
+                                              op->lanes));
+        } else {
+            IRMutator::visit(op);
+        }
+    }
+
+    void visit(const Load *op) {
+        if (emulating() && is_float16(op->type)) {
+            expr = Load::make(bits_type(op->type), op->name, mutate(op->index), op->image, op->param);
+        } else {
+            IRMutator::visit(op);
+        }
+    }
+
+    void visit(const Variable *op) {
+        if (!is_float16(op->type)) {
+            expr = op;
+            return;
+        }
+        bool is_bits = bits_vars.contains(op->name) && bits_vars.get(op->name);
+        Expr bits_var = Variable::make(bits_type(op->type), op->name);
+        if (emulating()) {
+            // Anything not bound to bits here (e.g. a scalar
+            // parameter) is reinterpreted.
+            expr = is_bits ? bits_var : reinterpret(bits_type(op->type), op);
+        } else {
+            expr = is_bits ? reinterpret(op->type, bits_var) : op;
+        }
+    }
+
+    template<typename LetOrLetStmt, typename Body>
+    Body visit_let(const LetOrLetStmt *op, Body body) {
+        Expr value = mutate(op->value);
+        bool float16 = is_float16(op->value.type());
+        if (float16) {
+            bits_vars.push(op->name, value.type() != op->value.type());
+        }
+        Body new_body = mutate(body);
+        if (float16) {
+            bits_vars.pop(op->name);
+        }
+        if (value.same_as(op->value) && new_body.same_as(body)) {
+            return op;
+        }
+        return LetOrLetStmt::make(op->name, value, new_body);
+    }
+
+    void visit(const Let *op) {
+        expr = visit_let(op, op->body);
+    }
+
+    void visit(const LetStmt *op) {
+        stmt = visit_let(op, op->body);
+    }
+
+    void visit(const For *op) {
+        Float16Support old_support = support;
+        if (op->device_api != DeviceAPI::None) {
+            support = float16_support(target, op->device_api);
+        }
+        IRMutator::visit(op);
+        support = old_support;
+    }
+
+    void visit(const Call *op) {
+        bool float16_args = false;
+        for (Expr a : op->args) {
+            float16_args |= is_float16(a.type());
+        }
+        if (!emulating() || !(is_float16(op->type) || float16_args)) {
+            IRMutator::visit(op);
+            return;
+        }
+
+        vector<Expr> args(op->args.size());
+        if (op->is_intrinsic(Call::reinterpret)) {
+            Expr bits = mutate(op->args[0]);
+            expr = reinterpret_if_needed(is_float16(op->type) ? bits_type(op->type) : op->type, bits);
+        } else if (op->is_intrinsic(Call::abs)) {
+            // Clear the sign bit.
+            expr = mutate(op->args[0]) & make_const(bits_type(op->type), 0x7fff);
+        } else if (op->is_intrinsic(Call::absd) ||
+                   op->is_intrinsic(Call::lerp) ||
+                   op->is_intrinsic(Call::vector_reduce_add) ||
+                   op->is_intrinsic(Call::vector_reduce_mul) ||
+                   op->is_intrinsic(Call::vector_reduce_min) ||
+                   op->is_intrinsic(Call::vector_reduce_max) ||
+                   (op->call_type == Call::PureExtern && ends_with(op->name, "_f16"))) {
+            // Arithmetic, and the math library, is done in Float(32).
+            string name = op->name;
+            if (op->call_type == Call::PureExtern) {
+                name = name.substr(0, name.size() - 4) + "_f32";
+            }
+            for (size_t i = 0; i < args.size(); i++) {
+                args[i] = mutate_widened(op->args[i]);
+            }
+            Type t = op->type;
+            if (t.is_float()) {
+                t = t.with_bits(32);
+            }
+            Expr e = Call::make(t, name, args, op->call_type);
+            expr = is_float16(op->type) ? to_float16_bits(e) : e;
+        } else if (op->call_type == Call::Intrinsic ||
+                   op->call_type == Call::PureIntrinsic) {
+            // The remaining intrinsics just move values around
+            // (e.g. likely, if_then_else, or the vector shuffles), so
+            // they work on the bits as they are.
+            for (size_t i = 0; i < args.size(); i++) {
+                args[i] = mutate(op->args[i]);
+            }
+            Type t = is_float16(op->type) ? bits_type(op->type) : op->type;
+            expr = Call::make(t, op->name, args, op->call_type,
+                              op->func, op->value_index, op->image, op->param);
+        } else {
+            // Extern functions still get real Float(16) values.
+            for (size_t i = 0; i < args.size(); i++) {
+                args[i] = mutate(op->args[i]);
+                if (is_float16(op->args[i].type())) {
+                    args[i] = reinterpret_if_needed(op->args[i].type(), args[i]);
+                }
+            }
+            Expr e = Call::make(op->type, op->name, args, op->call_type,
+                                op->func, op->value_index, op->image, op->param);
+            expr = is_float16(op->type) ? reinterpret(bits_type(op->type), e) : e;
+        }
+    }
+
+public:
+    EmulateFloat16Math(const Target &t) : target(t), support(float16_support(t, DeviceAPI::Host)) {}
+};
+
+}
+
+Stmt emulate_float16_math(Stmt s, const Target &t) {
+    return EmulateFloat16Math(t).mutate(s);
+}
+
+}
+}
@@ -0,0 +1,39 @@
+#ifndef HALIDE_EMULATE_FLOAT16_MATH_H
+#define HALIDE_EMULATE_FLOAT16_MATH_H
+
+/** \file
+ * Defines a lowering pass that does half-precision arithmetic in
+ * single precision on targets that can't do it natively.
+ */
+
+#include "IR.h"
+#include "Target.h"
+
+namespace Halide {
+namespace Internal {
+
+/** Rewrite Float(16) values as their bits, stored as UInt(16), and
+ * do any arithmetic on them in Float(32), rounding back to
+ * half-precision after each operation. Buffers of Float(16) are then
+ * only ever loaded and stored as 16-bit integers, which every target
+ * can do, and vectorize like any other 16-bit type. The conversions
+ * use hardware instructions where the target (or the device API of
+ * the enclosing loop) has them: F16C on x86, and AArch64 and
+ * PTX. Elsewhere they are done with integer arithmetic. Loops on
+ * targets with native half-precision arithmetic (AArch64 with
+ * arm_fp16, and Metal) are left alone. */
+Stmt emulate_float16_math(Stmt s, const Target &t);
+
+/** Convert the bits of a half-precision float to a Float(32), or a
+ * Float(32) to the bits of the nearest (ties to even) half-precision
+ * float, with integer arithmetic. These handle denormals, infinities
+ * and NaNs. */
+// @{
+Expr float16_bits_to_float32(Expr bits);
+Expr float32_to_float16_bits(Expr value);
+// @}
+
+}
+}
+
+#endif
@@ -11,6 +11,7 @@
 #include "Debug.h"
 #include "Error.h"
 #include "Float16.h"
+#include "IRArena.h"
 #include "Type.h"
 #include "IntrusivePtr.h"
 #include "Util.h"
@@ -61,7 +62,8 @@ enum class IRNodeType {
     Realize,
     Block,
     IfThenElse,
-    Evaluate
+    Evaluate,
+    Atomic
 };
 
 /** The abstract base classes for a node in the Halide IR. */
@@ -75,6 +77,13 @@ struct IRNode {
     IRNode() {}
     virtual ~IRNode() {}
 
+    /** IR nodes are allocated through ir_node_allocate, so that they
+     * can come from an arena during lowering (see IRArena.h). */
+    // @{
+    static void *operator new(size_t size) {return ir_node_allocate(size);}
+    static void operator delete(void *ptr) {ir_node_free(ptr);}
+    // @}
+
     /** These classes are all managed with intrusive reference
        counting, so we also track a reference count. It's mutable
        so that we can do reference counting even through const
@@ -325,17 +334,53 @@ const DeviceAPI all_device_apis[] = {DeviceAPI::None,
                                      DeviceAPI::Metal,
                                      DeviceAPI::Hexagon};
 
+/** An enum describing the kinds of memory a Func can be stored
+ * in. Used by Func::store_in, and in the Allocate IR node. */
+enum class MemoryType {
+    /** Let Halide choose: the stack if the size is a small enough
+     * constant, and the heap otherwise. On GPUs, shared memory
+     * outside of the thread loops and per-thread memory within
+     * them. */
+    Auto,
+    /** The heap, using halide_malloc. */
+    Heap,
+    /** The stack. The size must be a compile-time constant. On GPUs,
+     * per-thread local memory. */
+    Stack,
+    /** Registers. Like Stack, but every access must also be at a
+     * constant index, so that the allocation can be promoted into
+     * registers. Unroll or vectorize the loops over it to get
+     * there. */
+    Register,
+    /** GPU shared memory, shared by the threads of a block. Must be
+     * computed at the GPU block level, outside of the thread
+     * loops. */
+    GPUShared,
+    /** Hexagon's vector tightly coupled memory, allocated with
+     * halide_vtcm_malloc. Only valid inside loops offloaded to
+     * Hexagon. Falls back to the heap if the DSP has no VTCM, or not
+     * enough of it free. */
+    VTCM
+};
+
 namespace Internal {
 
 /** An enum describing a type of loop traversal. Used in schedules, and in
- * the For loop IR node. GPUBlock and GPUThread are implicitly parallel */
+ * the For loop IR node. GPUBlock, GPUThread and GPULane are implicitly
+ * parallel. GPULane is a GPUThread loop over the lanes of a warp; it
+ * only survives until the warp shuffles are lowered, after which it's
+ * a GPUThread loop. Extern is only used in the schedules of extern
+ * Funcs, for dimensions traversed by the extern function itself; no
+ * For loop is ever made for it. */
 enum class ForType {
     Serial,
     Parallel,
     Vectorized,
     Unrolled,
     GPUBlock,
-    GPUThread
+    GPUThread,
+    GPULane,
+    Extern
 };
 
 
@@ -0,0 +1,133 @@
+#include <iostream>
+
+#include "FixedPointIntrinsics.h"
+#include "IREquality.h"
+#include "IRMutator.h"
+#include "IROperator.h"
+#include "Simplify.h"
+
+namespace Halide {
+namespace Internal {
+
+Expr lower_fixed_point_intrinsic(const Call *op) {
+    if (op->call_type != Call::PureIntrinsic || op->args.size() != 2) {
+        return Expr();
+    }
+    const Expr &a = op->args[0], &b = op->args[1];
+    Type t = a.type();
+    Type wide = t.with_bits(t.bits() * 2);
+
+    if (op->is_intrinsic(Call::widening_mul)) {
+        return cast(wide, a) * cast(wide, b);
+    } else if (op->is_intrinsic(Call::saturating_add)) {
+        return saturating_cast(t, cast(wide, a) + cast(wide, b));
+    } else if (op->is_intrinsic(Call::saturating_sub)) {
+        // The difference of unsigned values may be negative.
+        Type wide_signed = Int(t.bits() * 2, t.lanes());
+        Expr diff = cast(wide_signed, a) - cast(wide_signed, b);
+        if (t.is_uint()) {
+            // It can't exceed the maximum, so only clamp the bottom.
+            return cast(t, max(diff, make_zero(wide_signed)));
+        }
+        return saturating_cast(t, diff);
+    } else if (op->is_intrinsic(Call::halving_add)) {
+        return cast(t, (cast(wide, a) + cast(wide, b)) / make_two(wide));
+    } else if (op->is_intrinsic(Call::rounding_halving_add)) {
+        return cast(t, ((cast(wide, a) + cast(wide, b)) + make_one(wide)) / make_two(wide));
+    } else if (op->is_intrinsic(Call::rounding_shift_right)) {
+        // Add half of 2^b before shifting. There's no half when b is
+        // zero, and (1 << 0) >> 1 is zero.
+        Expr shift = cast(wide, b);
+        Expr round = (make_one(wide) << shift) >> make_one(wide);
+        return cast(t, (cast(wide, a) + round) >> shift);
+    }
+    return Expr();
+}
+
+namespace {
+
+class LowerFixedPointIntrinsics : public IRMutator {
+    using IRMutator::visit;
+
+    void visit(const Call *op) {
+        IRMutator::visit(op);
+        op = expr.as<Call>();
+        if (op) {
+            Expr lowered = lower_fixed_point_intrinsic(op);
+            if (lowered.defined()) {
+                expr = lowered;
+            }
+        }
+    }
+};
+
+}  // namespace
+
+Stmt lower_fixed_point_intrinsics(Stmt s) {
+    return LowerFixedPointIntrinsics().mutate(s);
+}
+
+namespace {
+
+void check_lowering(Expr e, Expr correct) {
+    const Call *call = e.as<Call>();
+    internal_assert(call);
+    Expr result = lower_fixed_point_intrinsic(call);
+    if (!equal(result, correct)) {
+        internal_error
+            << "Lowering of fixed-point intrinsic failure:\n"
+            << "Input: " << e << '\n'
+            << "Output: " << result << '\n'
+            << "Expected output: " << correct << '\n';
+    }
+}
+
+template<typename T>
+void check_value(Expr e, T correct) {
+    const Call *call = e.as<Call>();
+    internal_assert(call);
+    Expr result = simplify(lower_fixed_point_intrinsic(call));
+    if (!equal(result, make_const(type_of<T>(), correct))) {
+        internal_error
+            << "Evaluation of fixed-point intrinsic failure:\n"
+            << "Input: " << e << '\n'
+            << "Output: " << result << '\n'
+            << "Expected output: " << correct << '\n';
+    }
+}
+
+}  // namespace
+
+void fixed_point_intrinsics_test() {
+    Expr u8x = Variable::make(UInt(8, 16), "u8x"), u8y = Variable::make(UInt(8, 16), "u8y");
+    Expr i16x = Variable::make(Int(16, 8), "i16x"), i16y = Variable::make(Int(16, 8), "i16y");
+
+    // The lowered forms are the ones the backends match.
+    check_lowering(saturating_add(u8x, u8y), saturating_cast(UInt(8, 16), cast(UInt(16, 16), u8x) + cast(UInt(16, 16), u8y)));
+    check_lowering(saturating_sub(u8x, u8y), cast(UInt(8, 16), max(cast(Int(16, 16), u8x) - cast(Int(16, 16), u8y), 0)));
+    check_lowering(saturating_sub(i16x, i16y), saturating_cast(Int(16, 8), cast(Int(32, 8), i16x) - cast(Int(32, 8), i16y)));
+    check_lowering(rounding_halving_add(u8x, u8y), cast(UInt(8, 16), ((cast(UInt(16, 16), u8x) + cast(UInt(16, 16), u8y)) + 1) / 2));
+    check_lowering(halving_add(i16x, i16y), cast(Int(16, 8), (cast(Int(32, 8), i16x) + cast(Int(32, 8), i16y)) / 2));
+    check_lowering(widening_mul(i16x, i16y), cast(Int(32, 8), i16x) * cast(Int(32, 8), i16y));
+
+    Expr u8_200 = make_const(UInt(8), 200), u8_100 = make_const(UInt(8), 100);
+    Expr i8_100 = make_const(Int(8), 100), i8_m100 = make_const(Int(8), -100);
+    check_value(saturating_add(u8_200, u8_100), (uint8_t)255);
+    check_value(saturating_sub(u8_100, u8_200), (uint8_t)0);
+    check_value(saturating_add(i8_m100, i8_m100), (int8_t)-128);
+    check_value(saturating_sub(i8_100, i8_m100), (int8_t)127);
+    check_value(halving_add(u8_200, u8_100), (uint8_t)150);
+    check_value(halving_add(i8_m100, make_const(Int(8), -1)), (int8_t)-51);
+    check_value(rounding_halving_add(u8_200, make_const(UInt(8), 255)), (uint8_t)228);
+    check_value(widening_mul(u8_200, u8_100), (uint16_t)20000);
+    check_value(widening_mul(i8_m100, i8_100), (int16_t)-10000);
+    check_value(rounding_shift_right(make_const(UInt(8), 255), make_const(UInt(8), 4)), (uint8_t)16);
+    check_value(rounding_shift_right(make_const(Int(16), -24), make_const(Int(16), 4)), (int16_t)-1);
+    check_value(rounding_shift_right(make_const(Int(16), -25), make_const(Int(16), 4)), (int16_t)-2);
+    check_value(rounding_shift_right(make_const(Int(16), 7), make_const(Int(16), 0)), (int16_t)7);
+
+    std::cout << "Fixed-point intrinsics test passed" << std::endl;
+}
+
+}
+}
@@ -0,0 +1,31 @@
+#ifndef HALIDE_FIXED_POINT_INTRINSICS_H
+#define HALIDE_FIXED_POINT_INTRINSICS_H
+
+/** \file
+ * Defines the lowering of the fixed-point intrinsics (saturating_add,
+ * rounding_shift_right, etc.) to ordinary arithmetic.
+ */
+
+#include "IR.h"
+
+namespace Halide {
+namespace Internal {
+
+/** If a call is to one of the fixed-point intrinsics, return
+ * arithmetic on wider integers that computes the same thing.
+ * Otherwise return an undefined Expr. The arithmetic is written the
+ * way the backends' instruction selection recognizes, so codegen
+ * lowers these calls with this and then generates code for the
+ * result. */
+Expr lower_fixed_point_intrinsic(const Call *op);
+
+/** Lower all the fixed-point intrinsics in a Stmt, for backends that
+ * select instructions by rewriting the IR before codegen. */
+Stmt lower_fixed_point_intrinsics(Stmt s);
+
+EXPORT void fixed_point_intrinsics_test();
+
+}
+}
+
+#endif
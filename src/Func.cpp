@@ -29,6 +29,7 @@
 #include "Simplify.h"
 #include "Solve.h"
 #include "Associativity.h"
+#include "FindCalls.h"
 #include "ApplySplit.h"
 
 namespace Halide {
@@ -164,7 +165,27 @@ void Func::define_extern(const std::string &function_name,
                          const std::vector<Type> &types,
                          int dimensionality,
                          bool is_c_plus_plus) {
-    func.define_extern(function_name, args, types, dimensionality, is_c_plus_plus);
+    // Make some synthetic var names for the dimensions.
+    vector<string> arg_names(dimensionality);
+    for (int i = 0; i < dimensionality; i++) {
+        arg_names[i] = unique_name('e');
+    }
+    func.define_extern(function_name, args, types, arg_names, is_c_plus_plus);
+}
+
+void Func::define_extern(const std::string &function_name,
+                         const std::vector<ExternFuncArgument> &args,
+                         const std::vector<Type> &types,
+                         const std::vector<Var> &arguments,
+                         bool is_c_plus_plus) {
+    vector<string> arg_names;
+    for (const Var &v : arguments) {
+        user_assert(!v.is_implicit())
+            << "In extern definition for Func \"" << name() << "\":\n"
+            << "Implicit var " << v.name() << " can't name a dimension of an extern Func.\n";
+        arg_names.push_back(v.name());
+    }
+    func.define_extern(function_name, args, types, arg_names, is_c_plus_plus);
 }
 
 /** Get the types of the buffers returned by an extern definition. */
@@ -284,13 +305,17 @@ void Stage::set_dim_type(VarOrRVar var, ForType t) {
             // validate that this doesn't introduce a race condition.
             if (!dims[i].is_pure() && var.is_rvar &&
                 (t == ForType::Vectorized || t == ForType::Parallel ||
-                 t == ForType::GPUBlock || t == ForType::GPUThread)) {
-                user_assert(definition.schedule().allow_race_conditions())
+                 t == ForType::GPUBlock || t == ForType::GPUThread ||
+                 t == ForType::GPULane)) {
+                user_assert(definition.schedule().allow_race_conditions() ||
+                            definition.schedule().atomic())
                     << "In schedule for " << stage_name
                     << ", marking var " << var.name()
                     << " as parallel or vectorized may introduce a race"
                     << " condition resulting in incorrect output."
-                    << " It is possible to override this error using"
+                    << " If the update is associative, call atomic() on it"
+                    << " first to make each update atomic."
+                    << " It is also possible to override this error using"
                     << " the allow_race_conditions() method. Use this"
                     << " with great caution, and only when you are willing"
                     << " to accept non-deterministic output, or you can prove"
@@ -926,6 +951,11 @@ void Stage::split(const string &old, const string &outer, const string &inner, E
             dims.insert(dims.begin() + i, dims[i]);
             dims[i].var = inner_name;
             dims[i+1].var = outer_name;
+            // Splitting a dimension of an extern Func makes a loop
+            // over calls to the extern function.
+            if (dims[i+1].for_type == ForType::Extern) {
+                dims[i+1].for_type = ForType::Serial;
+            }
         }
     }
 
@@ -1356,16 +1386,88 @@ Stage &Stage::allow_race_conditions() {
     return *this;
 }
 
+Stage &Stage::atomic() {
+    user_assert(!definition.is_init()) << "atomic() must be called on an update definition\n";
+    user_assert(definition.values().size() == 1)
+        << "Failed to call atomic() on " << stage_name
+        << " since it updates a Tuple, which can't be done in one atomic operation\n";
+
+    string func_name;
+    {
+        vector<std::string> tmp = split_string(stage_name, ".update(");
+        internal_assert(!tmp.empty() && !tmp[0].empty());
+        func_name = tmp[0];
+    }
+
+    // The updates happen in no particular order, so the operator
+    // must be commutative as well as associative.
+    ProveAssociativityResult prover_result =
+        prove_associativity(func_name, definition.args(), definition.values());
+    user_assert(prover_result.is_associative && prover_result.is_commutative)
+        << "Failed to call atomic() on " << stage_name
+        << " since it can't prove associativity and commutativity of the operator\n";
+
+    definition.schedule().atomic() = true;
+    return *this;
+}
+
 Stage &Stage::serial(VarOrRVar var) {
     set_dim_type(var, ForType::Serial);
     return *this;
 }
 
 Stage &Stage::parallel(VarOrRVar var) {
+    if (var.is_rvar &&
+        !definition.schedule().allow_race_conditions() &&
+        !definition.schedule().atomic() &&
+        parallelize_with_rfactor(var.rvar)) {
+        return *this;
+    }
     set_dim_type(var, ForType::Parallel);
     return *this;
 }
 
+bool Stage::parallelize_with_rfactor(RVar r) {
+    if (definition.is_init() || !r.domain().defined()) {
+        return false;
+    }
+
+    // The RVar must still be a loop of this stage, not yet split or
+    // fused away.
+    bool found = false;
+    for (const Dim &d : definition.schedule().dims()) {
+        found |= (!d.is_pure() && var_name_match(d.var, r.name()));
+    }
+    if (!found) {
+        return false;
+    }
+
+    string func_name;
+    {
+        vector<std::string> tmp = split_string(stage_name, ".update(");
+        internal_assert(!tmp.empty() && !tmp[0].empty());
+        func_name = tmp[0];
+    }
+    if (!prove_associativity(func_name, definition.args(), definition.values()).is_associative) {
+        return false;
+    }
+
+    // Split the RVar into one slice per core, reduce each slice into
+    // an element of an intermediate in parallel, then merge the
+    // slices serially.
+    int tasks = MachineParams::generic().parallelism;
+    Expr factor = simplify((r.extent() + (tasks - 1)) / tasks);
+    RVar outer(r.name() + "_task"), inner(r.name() + "_in_task");
+    Var u(r.name() + "_task");
+    split(r, outer, inner, factor, TailStrategy::GuardWithIf);
+    Func intm = rfactor(outer, u);
+    intm.compute_root().update().parallel(u);
+
+    debug(2) << "Parallelized " << stage_name << " over " << r.name()
+             << " by rfactoring it into " << intm.name() << "\n";
+    return true;
+}
+
 Stage &Stage::vectorize(VarOrRVar var) {
     set_dim_type(var, ForType::Vectorized);
     return *this;
@@ -1388,6 +1490,22 @@ Stage &Stage::parallel(VarOrRVar var, Expr factor, TailStrategy tail) {
     return *this;
 }
 
+Stage &Stage::parallel_adaptive(VarOrRVar var) {
+    parallel(var);
+    // If the loop was parallelized by factoring out an intermediate
+    // instead, this stage has no parallel loop over var to chunk.
+    for (const Dim &d : definition.schedule().dims()) {
+        if (var_name_match(d.var, var.name()) && d.for_type == ForType::Parallel) {
+            vector<string> &adaptive = definition.schedule().adaptive_parallel();
+            if (std::find(adaptive.begin(), adaptive.end(), d.var) == adaptive.end()) {
+                adaptive.push_back(d.var);
+            }
+            break;
+        }
+    }
+    return *this;
+}
+
 Stage &Stage::vectorize(VarOrRVar var, int factor, TailStrategy tail) {
     if (var.is_rvar) {
         RVar tmp;
@@ -1497,6 +1615,12 @@ Stage &Stage::gpu_threads(VarOrRVar tx, DeviceAPI device_api) {
     return *this;
 }
 
+Stage &Stage::gpu_lanes(VarOrRVar tx, DeviceAPI device_api) {
+    set_dim_device_api(tx, device_api);
+    set_dim_type(tx, ForType::GPULane);
+    return *this;
+}
+
 Stage &Stage::gpu_threads(VarOrRVar tx, VarOrRVar ty, DeviceAPI device_api) {
     set_dim_device_api(tx, device_api);
     set_dim_device_api(ty, device_api);
@@ -1539,6 +1663,87 @@ Stage &Stage::gpu_blocks(VarOrRVar bx, VarOrRVar by, VarOrRVar bz, DeviceAPI dev
     return *this;
 }
 
+Stage &Stage::gpu_devices(int n) {
+    user_assert(n >= 1) << "In schedule for " << stage_name
+                        << ": gpu_devices requires at least one device\n";
+    definition.schedule().gpu_devices() = n;
+    return *this;
+}
+
+Stage &Stage::gpu_host_split(Expr host_fraction) {
+    user_assert(host_fraction.defined() && host_fraction.type().is_scalar())
+        << "In schedule for " << stage_name
+        << ": gpu_host_split requires a scalar fraction\n";
+    definition.schedule().host_fraction() = host_fraction;
+    return *this;
+}
+
+Stage &Stage::gpu_launch_bounds(int max_threads, int min_blocks_per_multiprocessor) {
+    user_assert(max_threads > 0 && min_blocks_per_multiprocessor >= 0)
+        << "In schedule for " << stage_name
+        << ": gpu_launch_bounds requires a positive number of threads "
+        << "and a non-negative number of blocks\n";
+    GPULaunchBounds &b = definition.schedule().gpu_launch_bounds();
+    b.max_threads = max_threads;
+    b.min_blocks = min_blocks_per_multiprocessor;
+    return *this;
+}
+
+Stage &Stage::gpu_max_registers(int n) {
+    user_assert(n > 0) << "In schedule for " << stage_name
+                       << ": gpu_max_registers requires a positive number of registers\n";
+    definition.schedule().gpu_launch_bounds().max_registers = n;
+    return *this;
+}
+
+Stage &Stage::multiversion(VarOrRVar var, const vector<Target::Feature> &features) {
+    user_assert(!features.empty()) << "In schedule for " << stage_name
+                                   << ": multiversion requires at least one set of target features\n";
+    const vector<Dim> &dims = definition.schedule().dims();
+    for (const Dim &d : dims) {
+        if (var_name_match(d.var, var.name())) {
+            user_assert(d.for_type == ForType::Serial)
+                << "In schedule for " << stage_name
+                << ", can't multiversion the loop over " << var.name()
+                << " because it is not serial\n";
+            definition.schedule().multiversion().var = d.var;
+            definition.schedule().multiversion().features = features;
+            return *this;
+        }
+    }
+    user_error << "In schedule for " << stage_name
+               << ", could not find dimension "
+               << var.name()
+               << " to multiversion in vars for function\n"
+               << dump_argument_list();
+    return *this;
+}
+
+namespace {
+// Split the name of a Stage, e.g. "f.update(2)", into the name of
+// the Func and the index of the stage.
+pair<string, int> parse_stage_name(const string &stage_name) {
+    size_t pos = stage_name.rfind(".update(");
+    if (pos == string::npos || stage_name.back() != ')') {
+        return {stage_name, 0};
+    }
+    string idx = stage_name.substr(pos + 8, stage_name.size() - pos - 9);
+    return {stage_name.substr(0, pos), atoi(idx.c_str()) + 1};
+}
+}
+
+Stage &Stage::compute_with(Stage s, VarOrRVar var) {
+    pair<string, int> parent = parse_stage_name(s.name());
+    pair<string, int> self = parse_stage_name(stage_name);
+    user_assert(parent.first != self.first)
+        << "In schedule for " << stage_name << ": can't compute a stage with "
+        << s.name() << ", which is a stage of the same Func.\n";
+    user_assert(var.name() != Var::outermost().name())
+        << "In schedule for " << stage_name << ": compute_with needs a loop variable to fuse down to.\n";
+    definition.schedule().fuse_level() = FuseLoopLevel(parent.first, var.name(), parent.second);
+    return *this;
+}
+
 Stage &Stage::gpu_single_thread(DeviceAPI device_api) {
     Var block;
     split(Var::outermost(), Var::outermost(), block, 1);
@@ -1709,8 +1914,8 @@ Stage &Stage::hexagon(VarOrRVar x) {
     return *this;
 }
 
-Stage &Stage::prefetch(VarOrRVar var, Expr offset) {
-    Prefetch prefetch = {var.name(), offset};
+Stage &Stage::prefetch(VarOrRVar var, Expr offset, PrefetchUnit unit) {
+    Prefetch prefetch = {var.name(), offset, unit};
     definition.schedule().prefetches().push_back(prefetch);
 
     return *this;
@@ -1824,6 +2029,77 @@ Func Func::in() {
     return Func(wrapper);
 }
 
+Func Func::in_gpu_shared(const Func &f) {
+    // The innermost block loop of f, and its thread loops, innermost
+    // first.
+    const vector<Dim> &dims = f.function().definition().schedule().dims();
+    const Dim *block = nullptr;
+    vector<const Dim *> threads;
+    for (const Dim &d : dims) {
+        if (d.for_type == ForType::GPUThread && !block) {
+            threads.push_back(&d);
+        } else if (d.for_type == ForType::GPUBlock && !block) {
+            block = &d;
+        }
+    }
+    user_assert(block)
+        << "Can't stage " << name() << " in GPU shared memory for " << f.name()
+        << ", because " << f.name() << " has no GPU block loops.\n";
+    user_assert(threads.size() <= 3)
+        << "Can't stage " << name() << " in GPU shared memory for " << f.name()
+        << ", because " << f.name() << " has more than three GPU thread loops.\n";
+
+    Func wrapper = in(f);
+    wrapper.compute_at(f, Var(block->var)).store_in(MemoryType::GPUShared);
+
+    // Load the footprint with as many threads as f has in each
+    // dimension, with consecutive threads loading consecutive
+    // elements, and the rest of the footprint in serial loops inside
+    // the thread loops. If the number of threads in a dimension isn't
+    // a known constant, use one thread per element instead.
+    const vector<Var> wrapper_args = wrapper.args();
+    const vector<Split> &splits = f.function().definition().schedule().splits();
+    vector<VarOrRVar> serial_vars, thread_vars, other_vars;
+    for (size_t i = 0; i < wrapper_args.size(); i++) {
+        const Var &v = wrapper_args[i];
+        if (i >= threads.size()) {
+            other_vars.push_back(v);
+            continue;
+        }
+        const int64_t *num_threads = nullptr;
+        for (const Split &s : splits) {
+            if (s.is_split() && s.inner == threads[i]->var) {
+                num_threads = as_const_int(s.factor);
+            }
+        }
+        if (num_threads) {
+            Var serial(v.name() + "_serial"), thread(v.name() + "_thread");
+            wrapper.split(v, serial, thread, (int)*num_threads, TailStrategy::GuardWithIf);
+            serial_vars.push_back(serial);
+            thread_vars.push_back(thread);
+        } else {
+            thread_vars.push_back(v);
+        }
+    }
+
+    vector<VarOrRVar> order = serial_vars;
+    order.insert(order.end(), other_vars.begin(), other_vars.end());
+    order.insert(order.end(), thread_vars.begin(), thread_vars.end());
+    if (order.size() > 1) {
+        wrapper.reorder(order);
+    }
+
+    DeviceAPI device_api = block->device_api;
+    if (thread_vars.size() == 1) {
+        wrapper.gpu_threads(thread_vars[0], device_api);
+    } else if (thread_vars.size() == 2) {
+        wrapper.gpu_threads(thread_vars[0], thread_vars[1], device_api);
+    } else if (thread_vars.size() == 3) {
+        wrapper.gpu_threads(thread_vars[0], thread_vars[1], thread_vars[2], device_api);
+    }
+    return wrapper;
+}
+
 Func &Func::split(VarOrRVar old, VarOrRVar outer, VarOrRVar inner, Expr factor, TailStrategy tail) {
     invalidate_cache();
     Stage(func.definition(), name(), args(), func.schedule().storage_dims()).split(old, outer, inner, factor, tail);
@@ -1847,9 +2123,64 @@ Func &Func::allow_race_conditions() {
     return *this;
 }
 
-Func &Func::memoize() {
+Func &Func::assume_injective() {
+    func.assume_injective();
+    return *this;
+}
+
+Func &Func::memoize(int priority, int64_t max_bytes) {
+    user_assert(max_bytes >= 0) << "The byte budget passed to memoize() for Func "
+                                << name() << " must not be negative.\n";
     invalidate_cache();
     func.schedule().memoized() = true;
+    func.schedule().memoize_priority() = priority;
+    func.schedule().memoize_max_bytes() = max_bytes;
+    return *this;
+}
+
+Func &Func::code_size_budget(float max_growth) {
+    user_assert(max_growth >= 1) << "The code size budget of Func " << name()
+                                 << " must be at least 1.\n";
+    invalidate_cache();
+    func.schedule().code_size_budget() = max_growth;
+    return *this;
+}
+
+Func &Func::async() {
+    invalidate_cache();
+    func.schedule().async() = true;
+    return *this;
+}
+
+Func &Func::store_in(MemoryType memory_type) {
+    invalidate_cache();
+    func.schedule().memory_type() = memory_type;
+    return *this;
+}
+
+Func &Func::store_tuple_interleaved() {
+    user_assert(defined())
+        << "Can't interleave the storage of undefined Func " << name() << ".\n";
+    user_assert(!func.has_extern_definition())
+        << "Can't interleave the storage of extern Func " << name() << ".\n";
+    const vector<Type> &types = func.output_types();
+    for (Type t : types) {
+        user_assert(t == types[0])
+            << "Can't interleave the storage of Func " << name()
+            << ", because its Tuple elements have different types ("
+            << types[0] << " and " << t << ").\n";
+    }
+    invalidate_cache();
+    func.schedule().tuple_interleaved() = true;
+    return *this;
+}
+
+Func &Func::compute_if(Expr condition) {
+    user_assert(condition.defined() && condition.type() == Bool())
+        << "The condition passed to compute_if for Func " << name()
+        << " must be a scalar boolean.\n";
+    invalidate_cache();
+    func.schedule().compute_condition() = condition;
     return *this;
 }
 
@@ -1888,6 +2219,239 @@ Func &Func::parallel(VarOrRVar var, Expr factor, TailStrategy tail) {
     return *this;
 }
 
+Func &Func::parallel_adaptive(VarOrRVar var) {
+    invalidate_cache();
+    Stage(func.definition(), name(), args(), func.schedule().storage_dims()).parallel_adaptive(var);
+    return *this;
+}
+
+namespace {
+
+// Rewrites the value of the update definition of a scan in terms of
+// the previous element of the scan. Calls to the element being
+// updated read the value it was initialized with, so they're
+// replaced with the pure definition. Any other call to the Func means
+// this isn't a scan.
+class ExpandScanSelfReferences : public IRMutator {
+    using IRMutator::visit;
+
+    const string &func;
+    const vector<Expr> &args, &prev_args;
+    Expr init;
+
+    bool same_args(const vector<Expr> &a, const vector<Expr> &b) {
+        if (a.size() != b.size()) {
+            return false;
+        }
+        for (size_t i = 0; i < a.size(); i++) {
+            if (!can_prove(a[i] == b[i])) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void visit(const Call *op) {
+        if (op->call_type != Call::Halide || op->name != func) {
+            IRMutator::visit(op);
+        } else if (same_args(op->args, prev_args)) {
+            expr = op;
+        } else if (init.defined() && same_args(op->args, args)) {
+            expr = init;
+        } else {
+            valid = false;
+            expr = op;
+        }
+    }
+
+public:
+    bool valid = true;
+
+    ExpandScanSelfReferences(const string &func, const vector<Expr> &args,
+                             const vector<Expr> &prev_args, Expr init)
+        : func(func), args(args), prev_args(prev_args), init(init) {}
+};
+
+}  // anonymous namespace
+
+Func &Func::parallel_scan(RVar r, Expr block_size, int vector_width) {
+    invalidate_cache();
+    user_assert(block_size.defined() && Int(32).can_represent(block_size.type()))
+        << "Can't represent block size of parallel_scan() in int32\n";
+    user_assert(!is_const(block_size) || can_prove(block_size > 0))
+        << "In schedule for " << name() << ", the block size of parallel_scan() must be positive\n";
+
+    // Find the update definition that scans along r.
+    int idx = -1;
+    for (size_t i = 0; idx < 0 && i < func.updates().size(); i++) {
+        for (const ReductionVariable &rv : func.updates()[i].schedule().rvars()) {
+            if (rv.var == r.name()) {
+                idx = (int)i;
+            }
+        }
+    }
+    user_assert(idx >= 0)
+        << "In schedule for " << name() << ", can't call parallel_scan() on "
+        << r.name() << " since no update definition of " << name()
+        << " reduces over it\n";
+
+    Stage scan = update(idx);
+    Definition &def = func.update(idx);
+    const string stage_name = scan.name();
+    user_assert(def.schedule().rvars().size() == 1 && is_one(def.predicate()))
+        << "In schedule for " << stage_name << ", parallel_scan() requires "
+        << "a one-dimensional reduction domain with no predicate\n";
+    user_assert(def.values().size() == 1)
+        << "In schedule for " << stage_name << ", parallel_scan() doesn't "
+        << "support Funcs that return Tuples\n";
+    user_assert(def.schedule().splits().empty() && def.specializations().empty())
+        << "In schedule for " << stage_name << ", parallel_scan() must be "
+        << "called before any other scheduling of the update definition\n";
+
+    // The scan must store to f(..., r, ...), with the pure Vars of
+    // f in all the other dimensions.
+    const vector<Expr> &args = def.args();
+    const vector<string> pure_args = func.args();
+    int d = -1;
+    for (size_t i = 0; i < args.size(); i++) {
+        const Variable *v = args[i].as<Variable>();
+        if (v && v->name == r.name() && d < 0) {
+            d = (int)i;
+        } else {
+            user_assert(v && v->name == pure_args[i])
+                << "In schedule for " << stage_name << ", parallel_scan() requires "
+                << "the update definition to store to " << r.name()
+                << " in one dimension, and the pure Vars of " << name()
+                << " in the others, but it stores to " << args[i]
+                << " in dimension " << i << "\n";
+        }
+    }
+    user_assert(d >= 0)
+        << "In schedule for " << stage_name << ", parallel_scan() requires "
+        << "the update definition to store to " << r.name() << "\n";
+
+    const ReductionVariable &rv = def.schedule().rvars()[0];
+    Expr rmin = rv.min, rext = rv.extent;
+    auto at = [&](Expr p) {
+        vector<Expr> a = args;
+        a[d] = p;
+        return a;
+    };
+    vector<Expr> prev_args = at(Expr(r) - 1);
+
+    // The first update of f reads the initial value of the element
+    // it's updating from the pure definition.
+    Expr init;
+    if (idx == 0 && !func.has_extern_definition() && !is_undef(func.definition().values()[0])) {
+        map<string, Expr> replacements;
+        for (size_t i = 0; i < args.size(); i++) {
+            replacements[pure_args[i]] = args[i];
+        }
+        init = substitute(replacements, func.definition().values()[0]);
+    }
+
+    ExpandScanSelfReferences expand(name(), args, prev_args, init);
+    Expr value = expand.mutate(def.values()[0]);
+    user_assert(expand.valid)
+        << "In schedule for " << stage_name << ", can't call parallel_scan() "
+        << "since the update definition reads elements of " << name()
+        << " other than the one before the element it's updating\n";
+
+    ProveAssociativityResult prover_result = prove_associativity(name(), prev_args, {value});
+    user_assert(prover_result.is_associative)
+        << "Failed to call parallel_scan() on " << stage_name
+        << " since it can't prove associativity of the operator\n";
+    internal_assert(prover_result.ops.size() == 1);
+    const AssociativeOp &op = prover_result.ops[0];
+    user_assert(!op.x.first.empty() && op.y.second.defined())
+        << "Failed to call parallel_scan() on " << stage_name
+        << " since the update definition doesn't combine the previous element"
+        << " of the scan with a new term\n";
+
+    Type t = value.type();
+    auto combine = [&](Expr a, Expr b) {
+        map<string, Expr> replacements = {{op.x.first, a}, {op.y.first, b}};
+        return substitute(replacements, op.op);
+    };
+    auto term = [&](Expr p) {
+        return substitute(r.name(), p, op.y.second);
+    };
+
+    // Scan each block of the reduction domain separately, in
+    // parallel. Block b starts at rmin + b * block_size.
+    Expr num_blocks = (rext + block_size - 1) / block_size;
+    vector<Var> vars = this->args();
+    Func in_block(name() + "_scan_in_block");
+    in_block(vars) = undef(t);
+    RDom rs(0, num_blocks, r.name() + "_block");
+    Expr start = rmin + rs.x * block_size;
+    in_block(at(start)) = term(start);
+    RDom rb(1, block_size - 1, 0, num_blocks, r.name() + "_in_block");
+    Expr p = rmin + rb.y * block_size + rb.x;
+    rb.where(p < rmin + rext);
+    in_block(at(p)) = combine(in_block(at(p - 1)), term(p));
+
+    // Then serially find the combined value of all of the blocks
+    // before each block.
+    Func carry(name() + "_scan_carry");
+    carry(vars) = op.identity;
+    RDom rc(1, num_blocks - 1, r.name() + "_carry");
+    carry(at(rc.x)) = combine(carry(at(rc.x - 1)), in_block(at(rmin + rc.x * block_size - 1)));
+
+    // The scan is then independent at every element.
+    Expr seed = Call::make(t, name(), at(rmin - 1), Call::Halide);
+    def.values()[0] = combine(seed, combine(carry(at((Expr(r) - rmin) / block_size)), in_block(args)));
+
+    // Keep the loops over dimensions before d innermost, as they are
+    // in memory, and vectorize the innermost one that doesn't carry
+    // a dependence.
+    auto loop_order = [&](VarOrRVar inner, VarOrRVar outer) {
+        vector<VarOrRVar> order;
+        for (int i = 0; i < d; i++) {
+            order.push_back(vars[i]);
+        }
+        order.push_back(inner);
+        for (int i = d + 1; i < (int)vars.size(); i++) {
+            order.push_back(vars[i]);
+        }
+        order.push_back(outer);
+        return order;
+    };
+
+    in_block.compute_root();
+    vector<VarOrRVar> starts_order;
+    for (int i = 0; i < (int)vars.size(); i++) {
+        if (i != d) {
+            starts_order.push_back(vars[i]);
+        }
+    }
+    starts_order.push_back(rs.x);
+    in_block.update(0).allow_race_conditions().reorder(starts_order).parallel(rs.x);
+    Stage s = in_block.update(1);
+    s.allow_race_conditions().reorder(loop_order(rb.x, rb.y)).parallel(rb.y);
+    if (vector_width > 1 && d > 0) {
+        s.vectorize(vars[0], vector_width, TailStrategy::GuardWithIf);
+    }
+    carry.compute_root();
+
+    RVar ro(r.name() + "_scan_block"), ri(r.name() + "_scan_in_block");
+    scan.allow_race_conditions()
+        .split(r, ro, ri, block_size, TailStrategy::GuardWithIf)
+        .reorder(loop_order(ri, ro))
+        .parallel(ro);
+    if (vector_width > 1) {
+        if (d > 0) {
+            scan.vectorize(vars[0], vector_width, TailStrategy::GuardWithIf);
+        } else {
+            scan.vectorize(ri, vector_width, TailStrategy::GuardWithIf);
+        }
+    }
+
+    debug(2) << "Parallelized the scan " << stage_name << " over " << r.name()
+             << " with blocks of " << block_size << "\n";
+    return *this;
+}
+
 Func &Func::vectorize(VarOrRVar var, int factor, TailStrategy tail) {
     invalidate_cache();
     Stage(func.definition(), name(), args(), func.schedule().storage_dims()).vectorize(var, factor, tail);
@@ -1963,6 +2527,32 @@ Func &Func::align_bounds(Var var, Expr modulus, Expr remainder) {
     return *this;
 }
 
+Func &Func::distribute(Var var, Expr rank, Expr num_ranks) {
+    user_assert(rank.defined() && num_ranks.defined()) << "rank or num_ranks is undefined\n";
+    user_assert(Int(32).can_represent(rank.type())) << "Can't represent rank as int32\n";
+    user_assert(Int(32).can_represent(num_ranks.type())) << "Can't represent num_ranks as int32\n";
+
+    invalidate_cache();
+
+    bool found = false;
+    for (size_t i = 0; i < func.args().size(); i++) {
+        if (var.name() == func.args()[i]) {
+            found = true;
+        }
+    }
+    user_assert(found)
+        << "Can't distribute variable " << var.name()
+        << " of function " << name()
+        << " because " << var.name()
+        << " is not one of the pure variables of " << name() << ".\n";
+
+    Distribution &d = func.schedule().distribution();
+    d.var = var.name();
+    d.rank = cast<int32_t>(rank);
+    d.num_ranks = cast<int32_t>(num_ranks);
+    return *this;
+}
+
 Func &Func::tile(VarOrRVar x, VarOrRVar y,
                  VarOrRVar xo, VarOrRVar yo,
                  VarOrRVar xi, VarOrRVar yi,
@@ -1982,6 +2572,25 @@ Func &Func::tile(VarOrRVar x, VarOrRVar y,
     return *this;
 }
 
+Func &Func::time_tile(const std::vector<Func> &iterations,
+                      Var x, Var y, Var xo, Var yo, Var xi, Var yi,
+                      Expr xfactor, Expr yfactor,
+                      TailStrategy tail) {
+    invalidate_cache();
+    map<string, Function> env = find_transitive_calls(func);
+    for (const Func &f : iterations) {
+        user_assert(f.name() != name() && env.count(f.name()))
+            << "In schedule for " << name() << ", can't time_tile " << f.name()
+            << " since " << name() << " doesn't depend on it\n";
+    }
+
+    tile(x, y, xo, yo, xi, yi, xfactor, yfactor, tail).parallel(yo);
+    for (Func f : iterations) {
+        f.store_at(*this, yo).compute_at(*this, xo);
+    }
+    return *this;
+}
+
 Func &Func::reorder(const std::vector<VarOrRVar> &vars) {
     invalidate_cache();
     Stage(func.definition(), name(), args(), func.schedule().storage_dims()).reorder(vars);
@@ -2006,6 +2615,12 @@ Func &Func::gpu_threads(VarOrRVar tx, VarOrRVar ty, VarOrRVar tz, DeviceAPI devi
     return *this;
 }
 
+Func &Func::gpu_lanes(VarOrRVar tx, DeviceAPI device_api) {
+    invalidate_cache();
+    Stage(func.definition(), name(), args(), func.schedule().storage_dims()).gpu_lanes(tx, device_api);
+    return *this;
+}
+
 Func &Func::gpu_blocks(VarOrRVar bx, DeviceAPI device_api) {
     invalidate_cache();
     Stage(func.definition(), name(), args(), func.schedule().storage_dims()).gpu_blocks(bx, device_api);
@@ -2024,6 +2639,42 @@ Func &Func::gpu_blocks(VarOrRVar bx, VarOrRVar by, VarOrRVar bz, DeviceAPI devic
     return *this;
 }
 
+Func &Func::gpu_devices(int n) {
+    invalidate_cache();
+    Stage(func.definition(), name(), args(), func.schedule().storage_dims()).gpu_devices(n);
+    return *this;
+}
+
+Func &Func::gpu_host_split(Expr host_fraction) {
+    invalidate_cache();
+    Stage(func.definition(), name(), args(), func.schedule().storage_dims()).gpu_host_split(host_fraction);
+    return *this;
+}
+
+Func &Func::gpu_launch_bounds(int max_threads, int min_blocks_per_multiprocessor) {
+    invalidate_cache();
+    Stage(func.definition(), name(), args(), func.schedule().storage_dims()).gpu_launch_bounds(max_threads, min_blocks_per_multiprocessor);
+    return *this;
+}
+
+Func &Func::gpu_max_registers(int n) {
+    invalidate_cache();
+    Stage(func.definition(), name(), args(), func.schedule().storage_dims()).gpu_max_registers(n);
+    return *this;
+}
+
+Func &Func::multiversion(VarOrRVar var, const vector<Target::Feature> &features) {
+    invalidate_cache();
+    Stage(func.definition(), name(), args(), func.schedule().storage_dims()).multiversion(var, features);
+    return *this;
+}
+
+Func &Func::compute_with(Stage s, VarOrRVar var) {
+    invalidate_cache();
+    Stage(func.definition(), name(), args(), func.schedule().storage_dims()).compute_with(s, var);
+    return *this;
+}
+
 Func &Func::gpu_single_thread(DeviceAPI device_api) {
     invalidate_cache();
     Stage(func.definition(), name(), args(), func.schedule().storage_dims()).gpu_single_thread(device_api);
@@ -2182,14 +2833,15 @@ Func &Func::hexagon(VarOrRVar x) {
     return *this;
 }
 
-Func &Func::prefetch(VarOrRVar var, Expr offset) {
+Func &Func::prefetch(VarOrRVar var, Expr offset, PrefetchUnit unit) {
     invalidate_cache();
-    Stage(func.definition(), name(), args(), func.schedule().storage_dims()).prefetch(var, offset);
+    Stage(func.definition(), name(), args(), func.schedule().storage_dims()).prefetch(var, offset, unit);
     return *this;
 }
 
 Func &Func::reorder_storage(Var x, Var y) {
     invalidate_cache();
+    func.schedule().storage_order_fixed() = true;
 
     vector<StorageDim> &dims = func.schedule().storage_dims();
     bool found_y = false;
@@ -2319,6 +2971,40 @@ Func &Func::trace_realizations() {
     return *this;
 }
 
+Func &Func::trace_region(Var var, Expr min, Expr extent) {
+    user_assert(min.defined() && extent.defined())
+        << "The trace region of " << name() << " needs both a min and an extent\n";
+    user_assert(Int(32).can_represent(min.type())) << "Can't represent min of trace region in int32\n";
+    user_assert(Int(32).can_represent(extent.type())) << "Can't represent extent of trace region in int32\n";
+
+    int dim = -1;
+    for (size_t i = 0; i < func.args().size(); i++) {
+        if (var.name() == func.args()[i]) {
+            dim = (int)i;
+        }
+    }
+    user_assert(dim >= 0)
+        << "Can't restrict the trace region of " << name()
+        << " along " << var.name()
+        << " because " << var.name()
+        << " is not one of the pure variables of " << name() << ".\n";
+
+    invalidate_cache();
+    vector<Expr> region = func.tracing_region();
+    region.resize(func.args().size() * 2);
+    region[dim * 2] = cast<int32_t>(min);
+    region[dim * 2 + 1] = cast<int32_t>(extent);
+    func.trace_region(region);
+    return *this;
+}
+
+Func &Func::trace_sample_rate(int n) {
+    user_assert(n >= 1) << "The trace sample rate of " << name() << " must be at least one\n";
+    invalidate_cache();
+    func.trace_sample_rate(n);
+    return *this;
+}
+
 void Func::debug_to_file(const string &filename) {
     invalidate_cache();
     func.debug_file() = filename;
@@ -2821,8 +3507,9 @@ void Func::compile_to_c(const string &filename, const vector<Argument> &args,
 void Func::compile_to_lowered_stmt(const string &filename,
                                    const vector<Argument> &args,
                                    StmtOutputFormat fmt,
-                                   const Target &target) {
-    pipeline().compile_to_lowered_stmt(filename, args, fmt, target);
+                                   const Target &target,
+                                   const std::string &profile_report) {
+    pipeline().compile_to_lowered_stmt(filename, args, fmt, target, profile_report);
 }
 
 void Func::print_loop_nest() {
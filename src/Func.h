@@ -59,6 +59,7 @@ class Stage {
                Expr factor, bool exact, TailStrategy tail);
     void remove(const std::string &var);
     Stage &purify(VarOrRVar old_name, VarOrRVar new_name);
+    bool parallelize_with_rfactor(RVar r);
 
 public:
     Stage(Internal::Definition d, const std::string &n, const std::vector<Var> &args,
@@ -166,8 +167,44 @@ public:
     EXPORT Func rfactor(RVar r, Var v);
     // @}
 
+    /** Do each update of this associative, commutative update
+     * definition as a single atomic read-modify-write, so that its
+     * RVars can be parallelized without a race condition, and
+     * without the per-task copies of the result that rfactor
+     * needs. This is made for scatters like histograms:
+     \code
+     hist(x) = 0;
+     hist(clamp(im(r.x, r.y), 0, 255)) += 1;
+     hist.update().atomic().parallel(r.y);
+     \endcode
+     *
+     * Integer additions, mins, and maxes become hardware atomic
+     * operations; anything else is done with a compare-and-swap loop.
+     * Vectorizing an RVar along which every lane updates the same
+     * site, as in a dot product or a sum along a row, accumulates
+     * the lanes in a vector and combines them with one horizontal
+     * reduction at the end:
+     *
+     \code
+     sum(y) += in(r.x, y);
+     sum.update().atomic().vectorize(r.x, 16);
+     \endcode
+     *
+     * Other vectorized updates are done one lane at a time. Call
+     * atomic() before parallelizing or vectorizing over RVars. The update must
+     * be a single value, and only the LLVM-based backends (including
+     * PTX) support it. */
+    EXPORT Stage &atomic();
+
     /** Scheduling calls that control how the domain of this stage is
-     * traversed. See the documentation for Func for the meanings. */
+     * traversed. See the documentation for Func for the meanings.
+     *
+     * Parallelizing over an RVar of the reduction domain of an
+     * associative update, which would otherwise be a race condition,
+     * rfactors it: the RVar is split into one slice per core (see
+     * MachineParams::generic), each slice is reduced into an element
+     * of a compute_root intermediate in parallel, and the slices are
+     * then merged serially. Call rfactor yourself for more control. */
     // @{
 
     EXPORT Stage &split(VarOrRVar old, VarOrRVar outer, VarOrRVar inner, Expr factor, TailStrategy tail = TailStrategy::Auto);
@@ -177,6 +214,7 @@ public:
     EXPORT Stage &vectorize(VarOrRVar var);
     EXPORT Stage &unroll(VarOrRVar var);
     EXPORT Stage &parallel(VarOrRVar var, Expr task_size, TailStrategy tail = TailStrategy::Auto);
+    EXPORT Stage &parallel_adaptive(VarOrRVar var);
     EXPORT Stage &vectorize(VarOrRVar var, int factor, TailStrategy tail = TailStrategy::Auto);
     EXPORT Stage &unroll(VarOrRVar var, int factor, TailStrategy tail = TailStrategy::Auto);
     EXPORT Stage &tile(VarOrRVar x, VarOrRVar y,
@@ -203,6 +241,7 @@ public:
     EXPORT Stage &gpu_threads(VarOrRVar thread_x, DeviceAPI device_api = DeviceAPI::Default_GPU);
     EXPORT Stage &gpu_threads(VarOrRVar thread_x, VarOrRVar thread_y, DeviceAPI device_api = DeviceAPI::Default_GPU);
     EXPORT Stage &gpu_threads(VarOrRVar thread_x, VarOrRVar thread_y, VarOrRVar thread_z, DeviceAPI device_api = DeviceAPI::Default_GPU);
+    EXPORT Stage &gpu_lanes(VarOrRVar thread_x, DeviceAPI device_api = DeviceAPI::Default_GPU);
     EXPORT Stage &gpu_single_thread(DeviceAPI device_api = DeviceAPI::Default_GPU);
 
     EXPORT Stage &gpu_blocks(VarOrRVar block_x, DeviceAPI device_api = DeviceAPI::Default_GPU);
@@ -277,9 +316,16 @@ public:
                            DeviceAPI device_api = DeviceAPI::Default_GPU);
 
     EXPORT Stage &allow_race_conditions();
+    EXPORT Stage &gpu_devices(int n);
+    EXPORT Stage &gpu_host_split(Expr host_fraction);
+    EXPORT Stage &gpu_launch_bounds(int max_threads, int min_blocks_per_multiprocessor = 0);
+    EXPORT Stage &gpu_max_registers(int n);
+    EXPORT Stage &multiversion(VarOrRVar var, const std::vector<Target::Feature> &features);
+    EXPORT Stage &compute_with(Stage s, VarOrRVar var);
 
     EXPORT Stage &hexagon(VarOrRVar x = Var::outermost());
-    EXPORT Stage &prefetch(VarOrRVar var, Expr offset = 1);
+    EXPORT Stage &prefetch(VarOrRVar var, Expr offset = 1,
+                           PrefetchUnit unit = PrefetchUnit::Iterations);
     // @}
 };
 
@@ -640,8 +686,9 @@ public:
 
     /** Statically compile this function to C source code. This is
      * useful for providing fallback code paths that will compile on
-     * many platforms. Vectorization will fail, and parallelization
-     * will produce serial code. */
+     * many platforms. Vectorized code uses the GCC/Clang vector
+     * extensions, so it needs one of those compilers, and
+     * parallelization will produce serial code. */
     EXPORT void compile_to_c(const std::string &filename,
                              const std::vector<Argument> &,
                              const std::string &fn_name = "",
@@ -649,11 +696,15 @@ public:
 
     /** Write out an internal representation of lowered code. Useful
      * for analyzing and debugging scheduling. Can emit html or plain
-     * text. */
+     * text. The html can be annotated with the time and memory each
+     * Func used, by passing the name of a file holding the JSON
+     * report from halide_profiler_format_report for a run of this
+     * pipeline compiled with the profile feature. */
     EXPORT void compile_to_lowered_stmt(const std::string &filename,
                                         const std::vector<Argument> &args,
                                         StmtOutputFormat fmt = Text,
-                                        const Target &target = get_target_from_environment());
+                                        const Target &target = get_target_from_environment(),
+                                        const std::string &profile_report = "");
 
     /** Write out the loop nests specified by the schedule for this
      * Function. Helpful for understanding what a schedule is
@@ -857,7 +908,14 @@ public:
      * 5, uint32_t = 6, int32_t = 7, uint64_t = 8, int64_t = 9. The
      * data follows the header, as a densely packed array of the given
      * size and the given type. If given the extension .tmp, this file
-     * format can be natively read by the program ImageStack. */
+     * format can be natively read by the program ImageStack.
+     *
+     * By default, the file is written before the pipeline continues.
+     * To avoid stalling large pipelines, set the environment variable
+     * HL_DEBUG_TO_FILE_ASYNC to 1 (or call the runtime function
+     * halide_set_debug_to_file_async) to write copies of the data in
+     * background threads instead. The pipeline still waits for the
+     * writes to finish before it returns. */
     EXPORT void debug_to_file(const std::string &filename);
 
     /** The name of this function, either given during construction,
@@ -915,7 +973,17 @@ public:
     /** Add an extern definition for this Func. This lets you define a
      * Func that represents an external pipeline stage. You can, for
      * example, use it to wrap a call to an extern library such as
-     * fftw. */
+     * fftw.
+     *
+     * The versions that take a list of Vars name the dimensions of
+     * the output, so that they can be scheduled. By default the
+     * extern function is called once on the whole region required
+     * of the Func. Splitting, tiling, reordering or parallelizing
+     * the dimensions makes loops instead, and the extern function is
+     * called once per iteration, with an output buffer cropped to
+     * the region covered by the dimensions that are left. So the
+     * extern function must be able to produce any sub-rectangle of
+     * the region it asks for in its bounds query. */
     // @{
     EXPORT void define_extern(const std::string &function_name,
                               const std::vector<ExternFuncArgument> &params,
@@ -929,6 +997,20 @@ public:
                               const std::vector<ExternFuncArgument> &params,
                               const std::vector<Type> &types,
                               int dimensionality, bool is_c_plus_plus = false);
+
+    EXPORT void define_extern(const std::string &function_name,
+                              const std::vector<ExternFuncArgument> &params,
+                              Type t,
+                              const std::vector<Var> &arguments,
+                              bool is_c_plus_plus = false) {
+        define_extern(function_name, params, std::vector<Type>{t}, arguments, is_c_plus_plus);
+    }
+
+    EXPORT void define_extern(const std::string &function_name,
+                              const std::vector<ExternFuncArgument> &params,
+                              const std::vector<Type> &types,
+                              const std::vector<Var> &arguments,
+                              bool is_c_plus_plus = false);
     // @}
 
     /** Get the types of the outputs of this Func. */
@@ -1081,6 +1163,26 @@ public:
     */
     EXPORT Func in();
 
+    /** Create a wrapper of this Func for the GPU Func 'f', and stage
+     * into it, in GPU shared memory, the region of this Func that each
+     * GPU block of f reads. The wrapper is computed at the innermost
+     * GPU block loop of f's pure definition, and loaded cooperatively
+     * by the same threads as f's: its first dimensions are split by
+     * the extents of f's gpu thread loops (when they are constant),
+     * with consecutive threads loading consecutive elements, so that
+     * the loads are coalesced, and each thread loading the rest of the
+     * footprint in serial loops. Barriers between the load and f's
+     * threads are added as for any Func computed at the block
+     * level. For example, for a 3x3 blur:
+     \code
+     blur.gpu_tile(x, y, xo, yo, xi, yi, 16, 16);
+     input.in_gpu_shared(blur);
+     \endcode
+     * stages an 18x18 tile of input for each 16x16 block of blur,
+     * loaded by its 16x16 threads. Returns the wrapper, which can be
+     * scheduled further. */
+    EXPORT Func in_gpu_shared(const Func &f);
+
     /** Split a dimension into inner and outer subdimensions with the
      * given names, where the inner dimension iterates from 0 to
      * factor-1. The inner and outer subdimensions can then be dealt
@@ -1109,6 +1211,39 @@ public:
      * manually. */
     EXPORT Func &parallel(VarOrRVar var, Expr task_size, TailStrategy tail = TailStrategy::Auto);
 
+    /** Mark a dimension to be traversed in parallel, in chunks chosen
+     * by the runtime as the loop runs rather than fixed in the
+     * schedule. The first chunks are large, and they shrink towards
+     * the end of the loop so that the threads finish together. The
+     * runtime also measures how long each iteration takes, and
+     * doesn't make chunks too small to be worth running on their own
+     * the next time the loop runs. This suits loops whose extent, or
+     * the cost of each iteration, varies too much from run to run for
+     * a single task_size to be right. Each chunk runs its iterations
+     * serially, so anything computed inside the loop is still computed
+     * per iteration. See halide_do_par_for_adaptive. */
+    EXPORT Func &parallel_adaptive(VarOrRVar var);
+
+    /** Parallelize a scan (a prefix sum, running max, etc.) along the
+     * RVar r. The update definition that reduces over r must store to
+     * f(..., r, ...), with the pure Vars of this Func in the other
+     * dimensions, and combine the element before it with a new term
+     * using an associative operator, e.g.:
+     \code
+     f(x) = in(x);
+     f(r) = f(r - 1) + f(r);
+     \endcode
+     * The update is rewritten as three passes. The first scans each
+     * block of block_size elements along r separately, with the
+     * blocks in parallel. The second serially combines the totals of
+     * the blocks, to find what each block must start from. The last
+     * combines each element with the total for the blocks before it,
+     * and is parallel over the blocks of r. If vector_width is
+     * greater than one the innermost loop of each pass that doesn't
+     * carry a dependence is vectorized by it. The other dimensions of
+     * the update can still be scheduled as usual afterwards. */
+    EXPORT Func &parallel_scan(RVar r, Expr block_size, int vector_width = 1);
+
     /** Mark a dimension to be computed all-at-once as a single
      * vector. The dimension should have constant extent -
      * e.g. because it is the inner dimension following a split by a
@@ -1133,7 +1268,11 @@ public:
     /** Split a dimension by the given factor, then unroll the inner
      * dimension. This is how you unroll a loop of unknown size by
      * some constant factor. After this call, var refers to the outer
-     * dimension of the split. */
+     * dimension of the split. With TailStrategy::GuardWithIf (the
+     * default for RVars), the copies of the body aren't guarded
+     * individually: each group of factor iterations checks once
+     * that it is complete, and the remaining iterations run in a
+     * serial loop. */
     EXPORT Func &unroll(VarOrRVar var, int factor, TailStrategy tail = TailStrategy::Auto);
 
     /** Statically declare that the range over which a function should
@@ -1164,6 +1303,19 @@ public:
      * means it can go on the stack. */
     EXPORT Func &bound_extent(Var var, Expr extent);
 
+    /** Partition the region of this Func realized along var into
+     * num_ranks contiguous slices, and compute only slice number rank,
+     * for running one pipeline across the ranks of a distributed job
+     * such as an MPI one. rank and num_ranks are typically Params set
+     * from the job's rank and size. Bounds inference then computes
+     * only the region of each producer, including halos, that this
+     * rank's slice needs, and input bounds queries report only the
+     * region of each input it reads, so each rank can load just that
+     * part. Each rank is still passed the whole output buffer, but
+     * only writes its own slice of it; gathering the slices is up to
+     * the caller. Only outputs of the pipeline can be distributed. */
+    EXPORT Func &distribute(Var var, Expr rank, Expr num_ranks);
+
     /** Split two dimensions at once by the given factors, and then
      * reorder the resulting dimensions to be xi, yi, xo, yo from
      * innermost outwards. This gives a tiled traversal. */
@@ -1180,6 +1332,26 @@ public:
                       Expr xfactor, Expr yfactor,
                       TailStrategy tail = TailStrategy::Auto);
 
+    /** Compute a chain of Funcs that this Func depends on, such as
+     * the iterations of a stencil applied several times, together in
+     * tiles of this Func, so that several iterations run on each
+     * tile while it is in cache rather than each making a pass over
+     * memory. This Func is tiled as with \ref tile and the rows of
+     * tiles are run in parallel. Bounds inference grows the region of
+     * each iteration computed per tile by the footprint of the ones
+     * after it, so the iterations form a trapezoid over each
+     * tile. Within a row of tiles, each iteration is stored at yo and
+     * computed at xo, so the part of a trapezoid that overlaps the
+     * one before it along x is reused rather than recomputed; only
+     * the overlap along y is recomputed. An update that iterates over
+     * time in place can't be tiled this way, since each of its steps
+     * reads all of the one before: give each iteration its own Func
+     * instead. */
+    EXPORT Func &time_tile(const std::vector<Func> &iterations,
+                           Var x, Var y, Var xo, Var yo, Var xi, Var yi,
+                           Expr xfactor, Expr yfactor,
+                           TailStrategy tail = TailStrategy::Auto);
+
     /** Reorder variables to have the given nesting order, from
      * innermost out */
     EXPORT Func &reorder(const std::vector<VarOrRVar> &vars);
@@ -1202,6 +1374,41 @@ public:
      * different values at different times or on different machines. */
     EXPORT Func &allow_race_conditions();
 
+    /** Promise that this Func never has the same value at two
+     * different coordinates, e.g. because it's a permutation. Halide
+     * then knows that update definitions of other Funcs that store to
+     * f(idx(r.x)) write to a different site on each iteration of r.x,
+     * so it's safe to parallelize over r.x. This must be called
+     * before those update definitions are defined. It isn't checked,
+     * so if it isn't true, parallelizing such an update may race. */
+    EXPORT Func &assume_injective();
+
+    /** Compute this Func in the same loop nest as a stage of another
+     * Func, fusing the loops of the two from the outermost down to
+     * and including the loop over var. The loop bodies then run one
+     * after the other within each fused iteration, so two passes over
+     * the same domain become one, and inputs shared between the two
+     * can be reused while they are still in cache. For example:
+     \code
+     f(x, y) = in(x, y) * 2;
+     g(x, y) = in(x, y) + 1;
+     f.compute_root();
+     g.compute_root().compute_with(f, y);
+     \endcode
+     * computes a row of f and then a row of g for each y. The two
+     * Funcs must be computed and stored at the same loop level, must
+     * not depend on each other, and must have the same loop types
+     * at the fused levels, which may not be vectorized. Fusing stops
+     * at var, so the loops inside it may be scheduled freely. If the
+     * two loop nests cover different ranges, the fused loops cover
+     * both, and each body is guarded to its own range.
+     *
+     * The update stages of this Func may also be computed with
+     * stages of the same other Func via Stage::compute_with, as long
+     * as every earlier stage of this Func is fused too, into the same
+     * or an earlier stage of the other Func. */
+    EXPORT Func &compute_with(Stage s, VarOrRVar var);
+
 
     /** Specialize a Func. This creates a special-case version of the
      * Func where the given condition is true. The most effective
@@ -1381,6 +1588,22 @@ public:
     EXPORT Func &gpu_threads(VarOrRVar thread_x, VarOrRVar thread_y, VarOrRVar thread_z, DeviceAPI device_api = DeviceAPI::Default_GPU);
     // @}
 
+    /** The given dimension corresponds to the lanes of a GPU
+     * warp. This is the same as gpu_threads(thread_x), except that
+     * Funcs computed inside the other GPU thread loops of the
+     * consumer, and computed and used only within gpu_lanes loops,
+     * are stored one element per lane in registers instead of in
+     * per-thread memory. Loads of another lane's elements become warp
+     * shuffles. The gpu_lanes loop must be the innermost GPU thread
+     * loop of its stage, and for such Funcs its extent must be a
+     * constant power of two no greater than the warp size (32), that
+     * divides the x extent of the thread block. Stores to those Funcs
+     * must be at the lane's own index within each warp-sized chunk,
+     * so split the producer's gpu_lanes dimension by the warp size
+     * with TailStrategy::RoundUp. Warp shuffles are only supported on
+     * CUDA; elsewhere this is just gpu_threads. */
+    EXPORT Func &gpu_lanes(VarOrRVar thread_x, DeviceAPI device_api = DeviceAPI::Default_GPU);
+
     /** Tell Halide to run this stage using a single gpu thread and
      * block. This is not an efficient use of your GPU, but it can be
      * useful to avoid copy-back for intermediate update stages that
@@ -1410,6 +1633,73 @@ public:
     EXPORT Func &gpu_blocks(VarOrRVar block_x, VarOrRVar block_y, VarOrRVar block_z, DeviceAPI device_api = DeviceAPI::Default_GPU);
     // @}
 
+    /** Split the outermost gpu_blocks loop of this Func across n
+     * GPU devices. Each device runs a contiguous slice of the blocks
+     * as its own kernel launch, and the slices run concurrently. The
+     * buffers stay on the first device and are reached from the
+     * others through peer access, so this pays off for compute-bound
+     * stages on devices with a fast interconnect. If fewer than n
+     * devices are present, slices share devices. Only supported for
+     * CUDA. */
+    EXPORT Func &gpu_devices(int n);
+
+    /** Run the last host_fraction of the blocks of the outermost
+     * gpu_blocks loop of this Func on the host, as a parallel loop,
+     * while the GPU runs the rest. What is inside each block runs
+     * serially on the host. The host writes its part of the output to
+     * the host allocation, and it is merged into the device
+     * allocation once both parts are done. host_fraction may depend on
+     * Params, so it can be tuned from run to run to balance the
+     * time taken on each side. For example:
+     \code
+     Param<float> cpu_share;
+     f.gpu_tile(x, y, xi, yi, 16, 16).gpu_host_split(cpu_share);
+     \endcode
+     * Only outputs and Funcs computed at root can be split, and Funcs
+     * computed inside the split loop are not supported, because the
+     * host part cannot run their GPU loops. If the merge can't be
+     * shown not to overwrite the GPU's part, the GPU's part is copied
+     * to the host before the host part runs, so the two no longer
+     * overlap. Splitting the outermost dimension of storage avoids
+     * that. If the target has no GPU, the whole loop runs on the
+     * host. */
+    EXPORT Func &gpu_host_split(Expr host_fraction);
+
+    /** Promise that the GPU kernels of this Func are launched with at
+     * most max_threads threads per block, and ask for enough of each
+     * multiprocessor's registers to be left free to run
+     * min_blocks_per_multiprocessor blocks of that size at once. This
+     * lets the compiler trade registers for occupancy in kernels with
+     * heavy register pressure. It is an error to launch more threads
+     * per block than promised. Only used by CUDA, where it becomes the
+     * .maxntid and .minnctapersm directives of the kernels. */
+    EXPORT Func &gpu_launch_bounds(int max_threads, int min_blocks_per_multiprocessor = 0);
+
+    /** Limit the GPU kernels of this Func to n registers per
+     * thread. Otherwise CUDA kernels are limited to 64, or to the value
+     * of the environment variable HL_CUDA_JIT_MAX_REGISTERS when the
+     * kernels are loaded. Only used by CUDA, where it becomes the
+     * .maxnreg directive of the kernels. */
+    EXPORT Func &gpu_max_registers(int n);
+
+    /** Compile the loop over var, and everything inside it, once for
+     * each of the given x86 instruction sets as well as for the
+     * target, and pick between them each time the loop is reached
+     * using the CPU features detected on first use. For example:
+     \code
+     f.vectorize(x, 16).multiversion(y, {Target::AVX512_Skylake, Target::AVX2});
+     \endcode
+     *
+     * Here the inner loops of f are compiled for AVX-512, AVX2, and
+     * whatever the target's own instruction set is, and the first
+     * of the three that the machine running the pipeline supports
+     * is used. Only this loop nest is compiled several times, so the
+     * rest of the pipeline, and the object file, stays small. Each
+     * feature brings the ones it implies with it (e.g. AVX2 implies
+     * AVX and SSE4.1). The loop must be serial. On targets other than
+     * x86 this does nothing. */
+    EXPORT Func &multiversion(VarOrRVar var, const std::vector<Target::Feature> &features);
+
     /** \deprecated Old name for #gpu_blocks. */
     // @{
     EXPORT Func &cuda_blocks(VarOrRVar block_x) {
@@ -1524,10 +1814,16 @@ public:
     EXPORT Func &hexagon(VarOrRVar x = Var::outermost());
 
     /** Prefetch data read by a subsequent loop iteration, at an
-     * optionally specified iteration offset. This is currently only
-     * implemented on Hexagon, prefetch directives are ignored on
-     * other targets. */
-    EXPORT Func &prefetch(VarOrRVar var, Expr offset = 1);
+     * optionally specified offset. The offset is a number of
+     * iterations of the loop over var, or with PrefetchUnit::Bytes, a
+     * number of bytes ahead in each buffer read, which is a more
+     * portable way to cover the latency of memory. Boxes of any
+     * dimensionality are prefetched. On Hexagon this uses the
+     * runtime's prefetch functions. On other targets the box is
+     * prefetched one cache line at a time with llvm.prefetch, which
+     * is dropped on architectures without prefetch instructions. */
+    EXPORT Func &prefetch(VarOrRVar var, Expr offset = 1,
+                          PrefetchUnit unit = PrefetchUnit::Iterations);
 
     /** Specify how the storage for the function is laid out. These
      * calls let you specify the nesting order of the dimensions. For
@@ -1542,7 +1838,14 @@ public:
      *
      * If you leave out some dimensions, those remain in the same
      * positions in the nesting order while the specified variables
-     * are reordered around them. */
+     * are reordered around them.
+     *
+     * If you don't call this, and the Func is computed at some level
+     * of another Func, Halide may store the dimension that vector
+     * loops most often stride across innermost instead, so that
+     * e.g. a vectorized transposed read of the Func is a dense
+     * load. Calling reorder_storage, even with the default order,
+     * turns this off for the Func. */
     // @{
     EXPORT Func &reorder_storage(const std::vector<Var> &dims);
 
@@ -1564,7 +1867,12 @@ public:
      *
      * For example, to guarantee that a function foo(x, y, c)
      * representing an image has scanlines starting on offsets
-     * aligned to multiples of 16, use foo.align_storage(x, 16). */
+     * aligned to multiples of 16, use foo.align_storage(x, 16).
+     *
+     * By default, the rows of constant-sized Funcs stored in GPU
+     * shared memory are padded by a word to avoid bank conflicts
+     * when accessing their columns. Aligning the innermost storage
+     * dimension turns this padding off. */
     EXPORT Func &align_storage(Var dim, Expr alignment);
 
     /** Store realizations of this function in a circular buffer of a
@@ -1719,8 +2027,114 @@ public:
     /** Use the halide_memoization_cache_... interface to store a
      *  computed version of this function across invocations of the
      *  Func.
+     *
+     *  When the cache is full, the default runtime evicts entries
+     *  that are cheap to recompute relative to their size first. The
+     *  recompute time is measured when an entry is stored. priority
+     *  scales that cost by a power of two: each step up makes this
+     *  Func's entries twice as valuable to keep. If max_bytes is
+     *  non-zero, it caps the total size of the cached results of this
+     *  Func; results that would exceed it after evicting this Func's
+     *  own unused entries are not cached.
      */
-    EXPORT Func &memoize();
+    EXPORT Func &memoize(int priority = 0, int64_t max_bytes = 0);
+
+    /** Limit how much unrolling and loop partitioning may grow the
+     * code of this Func's loop nests, to max_growth times their size
+     * without them (counted in IR nodes, as a proxy for machine
+     * code). When they would go over, the loops in the coldest code
+     * (by trip count) are left as they are: loops marked for
+     * unrolling stay loops, and loops aren't split into a prologue,
+     * steady state and epilogue. The small_code target feature gives
+     * every Func without one a budget of 2. Set HL_CODE_SIZE_REPORT=1
+     * to print the code size of each loop nest after lowering. */
+    EXPORT Func &code_size_budget(float max_growth);
+
+    /** Compute this Func in a task of its own, so that it runs
+     * ahead of its consumer instead of taking turns with it. The two
+     * tasks are kept in step by a pair of semaphores: one counting
+     * productions ready to be consumed, and one counting the slots of
+     * storage free to produce into. There are two slots, so the
+     * producer can fill the next one while the consumer reads the
+     * last. This only has something to overlap when the storage is
+     * outside the compute level, so schedule it with store_at or
+     * store_root too:
+     *
+     \code
+     g.compute_at(f, y).store_root().async();
+     \endcode
+     *
+     * Here each row of g is computed on one thread while f consumes
+     * the previous row on another. If g is also folded over y (see
+     * Func::fold_storage), the fold covers the two productions in
+     * flight. The loops between the storage and compute levels must
+     * be serial, and nothing else may be computed in them outside of
+     * g's consumer.
+     */
+    EXPORT Func &async();
+
+    /** Set the type of memory this Func is stored in. By default
+     * (MemoryType::Auto), small constant-sized allocations on the CPU
+     * go on the stack and the rest on the heap, and storage at the
+     * block level of a GPU kernel goes in shared memory. Stack and
+     * Register storage must have a constant size; Register storage
+     * must also only be accessed at constant indices, which usually
+     * means unrolling or vectorizing the loops over it, so that it
+     * can be held in registers:
+     *
+     \code
+     g.compute_at(f, x).store_in(MemoryType::Register).unroll(x);
+     \endcode
+     *
+     * Heap storage is always allocated with halide_malloc. GPUShared
+     * storage must be at the block level of a GPU kernel. VTCM
+     * storage must be inside a loop offloaded to Hexagon; it's best
+     * used for small intermediates computed at an inner loop, as the
+     * DSP only has a few hundred KB of it.
+     */
+    EXPORT Func &store_in(MemoryType memory_type);
+
+    /** Store the elements of this Tuple-valued Func interleaved in a
+     * single allocation (array-of-structs), rather than in one
+     * allocation per element (struct-of-arrays). This suits consumers
+     * that use all the elements together, such as the real and
+     * imaginary parts of a complex number, or the channels of an
+     * RGBA pixel: there's one address computation per access instead
+     * of one per element, and vectorized loads and stores of the
+     * elements become dense loads and stores followed by (or preceded
+     * by) shuffles. The elements must all have the same type. This
+     * has no effect on output Funcs, whose elements go to separate
+     * buffers, and can't be used on Funcs that extern stages consume
+     * or produce, or that are memoized.
+     */
+    EXPORT Func &store_tuple_interleaved();
+
+    /** Only compute this Func at its compute_at site when a
+     * condition holds. The condition may depend on data, such as a
+     * mask computed by an earlier stage, which is what makes this
+     * different from the skipping Halide does on its own. It may
+     * refer to the Vars of the loops containing the compute_at site,
+     * and may call Funcs that are computed at root and used elsewhere
+     * in the pipeline. Where the condition is false the values of
+     * this Func are undefined, so its consumers must not use them,
+     * for example by selecting on the same condition:
+     *
+     \code
+     Func empty;
+     RDom r(0, 16, 0, 16);
+     empty(x, y) = maximum(mask(16 * x + r.x, 16 * y + r.y)) == 0;
+     out(x, y) = select(empty(x / 16, y / 16), 0, expensive(x, y));
+
+     empty.compute_root();
+     out.tile(x, y, xo, yo, xi, yi, 16, 16, TailStrategy::GuardWithIf);
+     expensive.compute_at(out, xo).compute_if(!empty(xo, yo));
+     \endcode
+     *
+     * Note the GuardWithIf: a ShiftInwards tail would make the last
+     * tile overlap the previous one, which may not be empty. The Func
+     * must be stored at the same loop level it is computed at.
+     */
+    EXPORT Func &compute_if(Expr condition);
 
 
     /** Allocate storage for this function within f's loop over
@@ -1815,6 +2229,13 @@ public:
      * improves locality by reusing recently-accessed memory instead
      * of pulling new memory into cache.
      *
+     * If a loop between the store and compute levels is parallel,
+     * each of its tasks gets storage of its own instead. If there's
+     * no serial loop left to slide along within a task, the parallel
+     * loop is first split into (at most 16) serial strips, each of
+     * which computes its first iteration in full and then slides.
+     * For control over the strip size, split the loop yourself and
+     * compute within the inner loop.
      */
     EXPORT Func &store_at(Func f, Var var);
 
@@ -1877,6 +2298,22 @@ public:
      * halide_trace. */
     EXPORT Func &trace_realizations();
 
+    /** Only trace the loads from and stores to this Func (as enabled
+     * by trace_loads and trace_stores) at coordinates where the given
+     * pure Var lies in [min, min + extent). Call it once per
+     * dimension to restrict. The check is compiled into the pipeline,
+     * so points outside the region cost only the check. A vector load
+     * or store is traced if any of its lanes is inside the region. */
+    EXPORT Func &trace_region(Var var, Expr min, Expr extent);
+
+    /** Only trace about one in every n of the loads from and stores to
+     * this Func. The points traced are chosen by a hash of their
+     * coordinates rather than a counter, so they're the same from run
+     * to run and with any number of threads, and a point whose store
+     * is traced also has its loads traced. Combines with
+     * trace_region. */
+    EXPORT Func &trace_sample_rate(int n);
+
     /** Get a handle on the internal halide function that this Func
      * represents. Useful if you want to do introspection on Halide
      * functions */
@@ -49,11 +49,20 @@ struct FunctionContents {
 
     bool trace_loads, trace_stores, trace_realizations;
 
+    // Restrictions on which loads and stores are traced. The region is
+    // a min and extent per dimension, undefined where unrestricted.
+    std::vector<Expr> trace_region;
+    int trace_sample_rate;
+
     bool frozen;
 
+    // Whether the user promised that distinct coordinates have
+    // distinct values.
+    bool injective;
+
     FunctionContents() : extern_is_c_plus_plus(false), trace_loads(false),
                          trace_stores(false), trace_realizations(false),
-                         frozen(false) {}
+                         trace_sample_rate(1), frozen(false), injective(false) {}
 
     void accept(IRVisitor *visitor) const {
         init_def.accept(visitor);
@@ -71,6 +80,12 @@ struct FunctionContents {
             }
         }
 
+        for (Expr i : trace_region) {
+            if (i.defined()) {
+                i.accept(visitor);
+            }
+        }
+
         for (Parameter i : output_buffers) {
             for (size_t j = 0; j < init_def.args().size() && j < 4; j++) {
                 if (i.min_constraint(j).defined()) {
@@ -102,6 +117,12 @@ struct FunctionContents {
                 }
             }
         }
+
+        for (Expr &i : trace_region) {
+            if (i.defined()) {
+                i = mutator->mutate(i);
+            }
+        }
     }
 };
 
@@ -308,7 +329,10 @@ void deep_copy_function_contents_helper(const IntrusivePtr<FunctionContents> &sr
     dst->trace_loads = src->trace_loads;
     dst->trace_stores = src->trace_stores;
     dst->trace_realizations = src->trace_realizations;
+    dst->trace_region = src->trace_region;
+    dst->trace_sample_rate = src->trace_sample_rate;
     dst->frozen = src->frozen;
+    dst->injective = src->injective;
     dst->output_buffers = src->output_buffers;
 
     // Copy the pure definition
@@ -676,7 +700,7 @@ void Function::define_update(const vector<Expr> &_args, vector<Expr> values) {
 void Function::define_extern(const std::string &function_name,
                              const std::vector<ExternFuncArgument> &args,
                              const std::vector<Type> &types,
-                             int dimensionality,
+                             const std::vector<std::string> &pure_args,
                              bool is_c_plus_plus) {
 
     user_assert(!has_pure_definition() && !has_update_definition())
@@ -687,6 +711,15 @@ void Function::define_extern(const std::string &function_name,
         << "In extern definition for Func \"" << name() << "\":\n"
         << "Func already has an extern definition.\n";
 
+    for (size_t i = 0; i < pure_args.size(); i++) {
+        for (size_t j = 0; j < i; j++) {
+            user_assert(pure_args[i] != pure_args[j])
+                << "In extern definition for Func \"" << name() << "\":\n"
+                << "The dimension names must be unique, but " << pure_args[i]
+                << " appears more than once.\n";
+        }
+    }
+
     contents->extern_function_name = function_name;
     contents->extern_arguments = args;
     contents->output_types = types;
@@ -697,19 +730,29 @@ void Function::define_extern(const std::string &function_name,
         if (types.size() > 1) {
             buffer_name += '.' + std::to_string((int)i);
         }
-        Parameter output(types[i], true, dimensionality, buffer_name);
+        Parameter output(types[i], true, (int)pure_args.size(), buffer_name);
         contents->output_buffers.push_back(output);
     }
 
-    // Make some synthetic var names for scheduling purposes (e.g. reorder_storage).
+    // The pure args are for scheduling purposes (e.g. reorder_storage,
+    // or splitting the dimensions into tiles to call the extern
+    // function on). Splitting them makes loops; whatever is left as
+    // ForType::Extern is traversed by the extern function.
     auto &pure_def_args = contents->init_def.args();
-    pure_def_args.resize(dimensionality);
-    for (int i = 0; i < dimensionality; i++) {
-        string arg = unique_name('e');
-        pure_def_args[i] = Var(arg);
-        StorageDim sd = {arg};
+    pure_def_args.resize(pure_args.size());
+    for (size_t i = 0; i < pure_args.size(); i++) {
+        pure_def_args[i] = Var(pure_args[i]);
+        Dim d = {pure_args[i], ForType::Extern, DeviceAPI::None, Dim::Type::PureVar};
+        contents->init_def.schedule().dims().push_back(d);
+        StorageDim sd = {pure_args[i]};
         contents->init_def.schedule().storage_dims().push_back(sd);
     }
+
+    // Add the dummy outermost dim
+    {
+        Dim d = {Var::outermost().name(), ForType::Serial, DeviceAPI::None, Dim::Type::PureVar};
+        contents->init_def.schedule().dims().push_back(d);
+    }
 }
 
 void Function::accept(IRVisitor *visitor) const {
@@ -836,6 +879,18 @@ bool Function::is_tracing_stores() const {
 bool Function::is_tracing_realizations() const {
     return contents->trace_realizations;
 }
+void Function::trace_region(const std::vector<Expr> &region) {
+    contents->trace_region = region;
+}
+void Function::trace_sample_rate(int n) {
+    contents->trace_sample_rate = n;
+}
+const std::vector<Expr> &Function::tracing_region() const {
+    return contents->trace_region;
+}
+int Function::tracing_sample_rate() const {
+    return contents->trace_sample_rate;
+}
 
 void Function::freeze() {
     contents->frozen = true;
@@ -845,6 +900,14 @@ bool Function::frozen() const {
     return contents->frozen;
 }
 
+void Function::assume_injective() {
+    contents->injective = true;
+}
+
+bool Function::is_assumed_injective() const {
+    return contents->injective;
+}
+
 const map<string, IntrusivePtr<FunctionContents>> &Function::wrappers() const {
     return contents->init_def.schedule().wrappers();
 }
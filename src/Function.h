@@ -193,11 +193,12 @@ public:
     /** Check if the function has an extern definition */
     EXPORT bool extern_definition_is_c_plus_plus() const;
 
-    /** Add an external definition of this Func */
+    /** Add an external definition of this Func. The pure args name
+     * the dimensions of the output, for scheduling purposes. */
     EXPORT void define_extern(const std::string &function_name,
                               const std::vector<ExternFuncArgument> &args,
                               const std::vector<Type> &types,
-                              int dimensionality,
+                              const std::vector<std::string> &pure_args,
                               bool is_c_plus_plus);
 
     /** Retrive the arguments of the extern definition */
@@ -232,6 +233,10 @@ public:
     EXPORT bool is_tracing_loads() const;
     EXPORT bool is_tracing_stores() const;
     EXPORT bool is_tracing_realizations() const;
+    EXPORT void trace_region(const std::vector<Expr> &region);
+    EXPORT void trace_sample_rate(int n);
+    EXPORT const std::vector<Expr> &tracing_region() const;
+    EXPORT int tracing_sample_rate() const;
     // @}
 
     /** Mark function as frozen, which means it cannot accept new
@@ -242,6 +247,14 @@ public:
      * add new definitions. */
     EXPORT bool frozen() const;
 
+    /** Promise that distinct coordinates of this function have
+     * distinct values, and check whether that was promised. See
+     * Func::assume_injective. */
+    // @{
+    EXPORT void assume_injective();
+    EXPORT bool is_assumed_injective() const;
+    // @}
+
     /** Mark calls of this function by 'f' to be replaced with its wrapper
      * during the lowering stage. If the string 'f' is empty, it means replace
      * all calls to this function by all other functions (excluding itself) in
@@ -329,10 +329,24 @@ class ExtractSharedAllocations : public IRMutator {
             "(Memoization is not supported inside GPU kernels at present.)\n";
 
         if (in_threads) {
+            user_assert(op->memory_type != MemoryType::GPUShared &&
+                        op->memory_type != MemoryType::Heap &&
+                        op->memory_type != MemoryType::VTCM)
+                << "Func " << op->name << " is stored inside the thread loops of a GPU kernel, "
+                << "so it is private to each thread and can't be stored in "
+                << op->memory_type << " memory. Store it at the block level instead, "
+                << "or use MemoryType::Auto, Stack, or Register.\n";
             IRMutator::visit(op);
             return;
         }
 
+        user_assert(op->memory_type == MemoryType::Auto ||
+                    op->memory_type == MemoryType::GPUShared)
+            << "Func " << op->name << " is stored at the block level of a GPU kernel, "
+            << "so it is shared between threads and can't be stored in "
+            << op->memory_type << " memory. Use MemoryType::Auto or GPUShared, "
+            << "or store it inside the thread loops instead.\n";
+
         shared.emplace(op->name, IntInterval(barrier_stage, barrier_stage));
         IRMutator::visit(op);
         op = stmt.as<Allocate>();
@@ -520,7 +534,7 @@ public:
             // Individual shared allocations.
             for (SharedAllocation alloc : allocations) {
                 s = Allocate::make(shared_mem_name + "_" + alloc.name,
-                                   alloc.type, {alloc.size}, const_true(), s);
+                                   alloc.type, MemoryType::GPUShared, {alloc.size}, const_true(), s);
             }
         } else {
             // One big combined shared allocation.
@@ -546,7 +560,7 @@ public:
 
             // Add a dummy allocation at the end to get the total size
             Expr total_size = Variable::make(Int(32), "group_" + std::to_string(mem_allocs.size()-1) + ".shared_offset");
-            s = Allocate::make(shared_mem_name, UInt(8), {total_size}, const_true(), s);
+            s = Allocate::make(shared_mem_name, UInt(8), MemoryType::GPUShared, {total_size}, const_true(), s);
 
             // Define an offset for each allocation. The offsets are in
             // elements, not bytes, so that the stores and loads can use
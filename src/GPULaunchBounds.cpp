@@ -0,0 +1,98 @@
+#include <cstdlib>
+#include <cstring>
+
+#include "GPULaunchBounds.h"
+#include "CodeGen_GPU_Dev.h"
+#include "Function.h"
+#include "IRMutator.h"
+#include "IROperator.h"
+#include "Substitute.h"
+
+namespace Halide {
+namespace Internal {
+
+using std::map;
+using std::string;
+using std::vector;
+
+namespace {
+
+const char *launch_bounds_marker = ".__launch_bounds_";
+
+class MarkGPULaunchBounds : public IRMutator {
+    // The hints for each stage, keyed by the stage's loop prefix.
+    const map<string, GPULaunchBounds> &stages;
+
+    using IRMutator::visit;
+
+    void visit(const For *op) {
+        if (!CodeGen_GPU_Dev::is_gpu_block_var(op->name) ||
+            op->device_api == DeviceAPI::None ||
+            op->device_api == DeviceAPI::Host) {
+            IRMutator::visit(op);
+            return;
+        }
+
+        // This is the loop a kernel is launched for.
+        stmt = op;
+        for (const auto &i : stages) {
+            if (!starts_with(op->name, i.first)) {
+                continue;
+            }
+            const GPULaunchBounds &b = i.second;
+            size_t last_dot = op->name.rfind('.');
+            string name = (op->name.substr(0, last_dot) + launch_bounds_marker +
+                           std::to_string(b.max_threads) + "_" +
+                           std::to_string(b.min_blocks) + "_" +
+                           std::to_string(b.max_registers) +
+                           op->name.substr(last_dot));
+            Stmt body = substitute(op->name, Variable::make(Int(32), name), op->body);
+            stmt = For::make(name, op->min, op->extent, op->for_type, op->device_api, body);
+            break;
+        }
+    }
+
+public:
+    MarkGPULaunchBounds(const map<string, GPULaunchBounds> &s) : stages(s) {}
+};
+
+}  // namespace
+
+Stmt mark_gpu_launch_bounds(Stmt s, const map<string, Function> &env) {
+    map<string, GPULaunchBounds> stages;
+    for (const auto &p : env) {
+        const Function &f = p.second;
+        vector<Definition> defs = {f.definition()};
+        for (const Definition &u : f.updates()) {
+            defs.push_back(u);
+        }
+        for (size_t i = 0; i < defs.size(); i++) {
+            const GPULaunchBounds &b = defs[i].schedule().gpu_launch_bounds();
+            if (b.defined()) {
+                stages[f.name() + ".s" + std::to_string(i) + "."] = b;
+            }
+        }
+    }
+    if (stages.empty()) {
+        return s;
+    }
+
+    return MarkGPULaunchBounds(stages).mutate(s);
+}
+
+GPULaunchBounds gpu_launch_bounds_of_loop(const string &name) {
+    GPULaunchBounds b;
+    size_t pos = name.rfind(launch_bounds_marker);
+    if (pos == string::npos) {
+        return b;
+    }
+    const char *hints = name.c_str() + pos + strlen(launch_bounds_marker);
+    char *end = nullptr;
+    b.max_threads = (int)strtol(hints, &end, 10);
+    b.min_blocks = (int)strtol(end + 1, &end, 10);
+    b.max_registers = (int)strtol(end + 1, &end, 10);
+    return b;
+}
+
+}
+}
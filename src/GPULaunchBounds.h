@@ -0,0 +1,32 @@
+#ifndef HALIDE_GPU_LAUNCH_BOUNDS_H
+#define HALIDE_GPU_LAUNCH_BOUNDS_H
+
+/** \file
+ * Defines the lowering pass that passes the launch bounds hints of
+ * GPU stages on to codegen.
+ */
+
+#include <map>
+
+#include "IR.h"
+#include "Schedule.h"
+
+namespace Halide {
+namespace Internal {
+
+/** Rename the variable of the kernel launch loop of each stage
+ * scheduled with Stage::gpu_launch_bounds or Stage::gpu_max_registers
+ * to record the hints in it, as
+ * <prefix>.__launch_bounds_<max threads>_<min blocks>_<max registers>.<block var>,
+ * so that device codegen can find them. */
+Stmt mark_gpu_launch_bounds(Stmt s, const std::map<std::string, Function> &env);
+
+/** Get the launch bounds hints recorded in the variable name of a
+ * kernel launch loop by mark_gpu_launch_bounds, or no hints if there
+ * are none. */
+GPULaunchBounds gpu_launch_bounds_of_loop(const std::string &name);
+
+}
+}
+
+#endif
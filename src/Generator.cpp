@@ -1,5 +1,8 @@
+#include <chrono>
 #include <cmath>
 #include <fstream>
+#include <limits>
+#include <random>
 #include <set>
 
 #include "Generator.h"
@@ -74,6 +77,9 @@ Outputs compute_outputs(const Target &target,
         // and passed to LLVM.
         output_files.bitcode_name = base_path + get_extension(".bc", options);
     }
+    if (options.emit_thin_lto) {
+        output_files.thin_lto_bitcode_name = base_path + get_extension(".thinlto.bc", options);
+    }
     if (options.emit_h) {
         output_files.c_header_name = base_path + get_extension(".h", options);
     }
@@ -769,12 +775,16 @@ const std::map<std::string, LoopLevel> &get_halide_looplevel_enum_map() {
 }
 
 int generate_filter_main(int argc, char **argv, std::ostream &cerr) {
-    const char kUsage[] = "gengen [-g GENERATOR_NAME] [-f FUNCTION_NAME] [-o OUTPUT_DIR] [-r RUNTIME_NAME] [-e EMIT_OPTIONS] [-x EXTENSION_OPTIONS] [-n FILE_BASE_NAME] "
+    const char kUsage[] = "gengen [-g GENERATOR_NAME] [-f FUNCTION_NAME] [-o OUTPUT_DIR] [-r RUNTIME_NAME] [-e EMIT_OPTIONS] [-x EXTENSION_OPTIONS] [-n FILE_BASE_NAME] [-p PGO_PROFILE] "
                           "target=target-string[,target-string...] [generator_arg=value [...]]\n\n"
                           "  -e  A comma separated list of files to emit. Accepted values are "
-                          "[assembly, bitcode, cpp, h, html, o, static_library, stmt, cpp_stub]. If omitted, default value is [static_library, h].\n"
+                          "[assembly, bitcode, cpp, h, html, o, static_library, stmt, cpp_stub, thin_lto]. If omitted, default value is [static_library, h]. "
+                          "thin_lto is llvm bitcode with a ThinLTO summary, for linking into code built with -flto=thin; "
+                          "with the no_runtime target feature, -r and -e thin_lto make the runtime a ThinLTO module of its own.\n"
                           "  -x  A comma separated list of file extension pairs to substitute during file naming, "
-                          "in the form [.old=.new[,.old2=.new2]]\n";
+                          "in the form [.old=.new[,.old2=.new2]]\n"
+                          "  -p  A profile written by the generator's code compiled with the pgo_instrument target feature, "
+                          "to lay out its branches and loops by\n";
 
     std::map<std::string, std::string> flags_info = { { "-f", "" },
                                                       { "-g", "" },
@@ -782,6 +792,7 @@ int generate_filter_main(int argc, char **argv, std::ostream &cerr) {
                                                       { "-e", "" },
                                                       { "-n", "" },
                                                       { "-x", "" },
+                                                      { "-p", "" },
                                                       { "-r", "" }};
     std::map<std::string, std::string> generator_args;
 
@@ -886,9 +897,11 @@ int generate_filter_main(int argc, char **argv, std::ostream &cerr) {
                 emit_options.emit_static_library = true;
             } else if (opt == "cpp_stub") {
                 emit_options.emit_cpp_stub = true;
+            } else if (opt == "thin_lto") {
+                emit_options.emit_thin_lto = true;
             } else if (!opt.empty()) {
                 cerr << "Unrecognized emit option: " << opt
-                     << " not one of [assembly, bitcode, cpp, h, html, o, static_library, stmt, cpp_stub], ignoring.\n";
+                     << " not one of [assembly, bitcode, cpp, h, html, o, static_library, stmt, cpp_stub, thin_lto], ignoring.\n";
             }
         }
     }
@@ -940,6 +953,9 @@ int generate_filter_main(int argc, char **argv, std::ostream &cerr) {
         // Don't bother with this if we're just emitting a cpp_stub.
         if (!stub_only) {
             Outputs output_files = compute_outputs(targets[0], base_path, emit_options);
+            if (!flags_info["-p"].empty()) {
+                output_files = output_files.pgo_profile(flags_info["-p"]);
+            }
             auto module_producer = [&generator_name, &generator_args, &cerr]
                 (const std::string &name, const Target &target) -> Module {
                     auto sub_generator_args = generator_args;
@@ -963,6 +979,280 @@ int generate_filter_main(int argc, char **argv, std::ostream &cerr) {
     return 0;
 }
 
+namespace {
+
+// Time op the way apps/support/benchmark.h does: the minimum over
+// samples of the mean time of a number of iterations, in seconds.
+template<typename F>
+double benchmark(int samples, int iterations, F op) {
+    double best = std::numeric_limits<double>::infinity();
+    for (int i = 0; i < samples; i++) {
+        auto t1 = std::chrono::high_resolution_clock::now();
+        for (int j = 0; j < iterations; j++) {
+            op();
+        }
+        auto t2 = std::chrono::high_resolution_clock::now();
+        double dt = std::chrono::duration<double>(t2 - t1).count();
+        best = std::min(best, dt);
+    }
+    return best / iterations;
+}
+
+// The constant value of a bounds estimate, or false if there isn't one.
+bool const_estimate(Expr e, int *result) {
+    if (!e.defined()) {
+        return false;
+    }
+    const int64_t *i = as_const_int(simplify(e));
+    if (!i) {
+        return false;
+    }
+    *result = (int)*i;
+    return true;
+}
+
+// A buffer of the size estimated for a Parameter, or an OutputImageParam.
+Buffer<> make_estimated_buffer(Type t, const std::string &name,
+                               const std::vector<Expr> &mins, const std::vector<Expr> &extents) {
+    std::vector<int> min(mins.size()), extent(extents.size());
+    for (size_t d = 0; d < mins.size(); d++) {
+        user_assert(const_estimate(mins[d], &min[d]) && const_estimate(extents[d], &extent[d]))
+            << "gentune needs a constant bounds estimate for dimension " << d << " of " << name
+            << ". Set one with dim(" << d << ").set_bounds_estimate().\n";
+    }
+    Buffer<> b(t, extent, name);
+    b.translate(min);
+    return b;
+}
+
+}  // namespace
+
+int tune_filter_main(int argc, char **argv, std::ostream &cerr) {
+    const char kUsage[] = "gentune [-g GENERATOR_NAME] [-o OUTPUT_DIR] [-n MAX_VARIANTS] [-s SAMPLES] [-seed SEED] "
+                          "[target=target-string] [generator_arg=value [...]] [schedule_param=value[,value...] [...]]\n\n"
+                          "  Compiles variants of the Generator's schedule with the JIT, one for each combination of\n"
+                          "  the values given for its ScheduleParams, and benchmarks them on random inputs sized by the\n"
+                          "  bounds estimates of the inputs and outputs. ScheduleParams given no values try powers\n"
+                          "  of two in their range, both values of a bool, or every value of an enum. If there are more\n"
+                          "  than MAX_VARIANTS (default 64) combinations, a random sample of them is tried.\n"
+                          "  The fastest is written to OUTPUT_DIR/GENERATOR_NAME.TARGET.schedule as generator args.\n"
+                          "  -s  The number of timing samples for each variant. Defaults to 10.\n";
+
+    std::map<std::string, std::string> flags_info = { { "-g", "" },
+                                                      { "-o", "" },
+                                                      { "-n", "64" },
+                                                      { "-s", "10" },
+                                                      { "-seed", "0" }};
+    std::map<std::string, std::string> args;
+
+    for (int i = 1; i < argc; ++i) {
+        if (argv[i][0] != '-') {
+            std::vector<std::string> v = split_string(argv[i], "=");
+            if (v.size() != 2 || v[0].empty() || v[1].empty()) {
+                cerr << kUsage;
+                return 1;
+            }
+            args[v[0]] = v[1];
+            continue;
+        }
+        auto it = flags_info.find(argv[i]);
+        if (it != flags_info.end()) {
+            if (i + 1 >= argc) {
+                cerr << kUsage;
+                return 1;
+            }
+            it->second = argv[i + 1];
+            ++i;
+            continue;
+        }
+        cerr << "Unknown flag: " << argv[i] << "\n";
+        cerr << kUsage;
+        return 1;
+    }
+
+    std::vector<std::string> generator_names = GeneratorRegistry::enumerate();
+    std::string generator_name = flags_info["-g"];
+    if (generator_name.empty()) {
+        if (generator_names.size() != 1) {
+            cerr << "-g must be specified unless exactly one generator is registered:\n";
+            for (auto name : generator_names) {
+                cerr << "    " << name << "\n";
+            }
+            cerr << kUsage;
+            return 1;
+        }
+        generator_name = generator_names[0];
+    }
+
+    const int max_variants = std::max(1, parse_scalar<int>(flags_info["-n"]));
+    const int samples = std::max(1, parse_scalar<int>(flags_info["-s"]));
+    const unsigned seed = parse_scalar<unsigned>(flags_info["-seed"]);
+
+    if (args.find("target") == args.end()) {
+        args["target"] = get_jit_target_from_environment().to_string();
+    }
+    const Target target(args["target"]);
+
+    // Ask a Generator made with only the target which of the args
+    // are ScheduleParams, and what to try for each of those not given.
+    std::map<std::string, std::vector<std::string>> candidates;
+    {
+        auto gen = GeneratorRegistry::create(generator_name, {{"target", args["target"]}});
+        candidates = gen->get_schedule_param_candidates();
+    }
+    std::map<std::string, std::string> generator_args;
+    for (const auto &a : args) {
+        auto it = candidates.find(a.first);
+        if (it != candidates.end()) {
+            it->second = split_string(a.second, ",");
+        } else {
+            generator_args[a.first] = a.second;
+        }
+    }
+
+    // Enumerate the combinations, starting with the first value of
+    // each, or sample them if there are too many.
+    std::vector<std::string> names;
+    std::vector<size_t> radix;
+    double combinations = 1;
+    for (const auto &c : candidates) {
+        names.push_back(c.first);
+        radix.push_back(c.second.size());
+        combinations *= c.second.size();
+    }
+    std::vector<std::vector<size_t>> variants;
+    if (combinations <= max_variants) {
+        for (int i = 0; i < (int)combinations; i++) {
+            std::vector<size_t> v;
+            int rest = i;
+            for (size_t r : radix) {
+                v.push_back(rest % r);
+                rest /= r;
+            }
+            variants.push_back(v);
+        }
+    } else {
+        std::mt19937 rng(seed);
+        std::set<std::vector<size_t>> seen;
+        variants.push_back(std::vector<size_t>(radix.size(), 0));
+        seen.insert(variants.back());
+        for (int attempts = 0; (int)variants.size() < max_variants && attempts < 100 * max_variants; attempts++) {
+            std::vector<size_t> v;
+            for (size_t r : radix) {
+                v.push_back(rng() % r);
+            }
+            if (seen.insert(v).second) {
+                variants.push_back(v);
+            }
+        }
+    }
+
+    std::map<std::string, Buffer<>> input_buffers;
+    double best_time = std::numeric_limits<double>::infinity();
+    std::map<std::string, std::string> best;
+
+    for (size_t i = 0; i < variants.size(); i++) {
+        std::map<std::string, std::string> variant_args = generator_args;
+        std::map<std::string, std::string> schedule;
+        for (size_t p = 0; p < names.size(); p++) {
+            schedule[names[p]] = candidates[names[p]][variants[i][p]];
+            variant_args[names[p]] = schedule[names[p]];
+        }
+
+        std::ostringstream description;
+        for (const auto &s : schedule) {
+            description << " " << s.first << "=" << s.second;
+        }
+
+        double t = 0;
+#ifdef WITH_EXCEPTIONS
+        try {
+#endif
+            auto gen = GeneratorRegistry::create(generator_name, variant_args);
+            std::vector<Parameter> params;
+            Pipeline pipeline = gen->build_jit_pipeline(params);
+
+            // Make the inputs once, so that every variant sees the same data.
+            for (Parameter &p : params) {
+                if (!p.is_buffer()) {
+                    continue;
+                }
+                if (!input_buffers.count(p.name())) {
+                    std::vector<Expr> mins, extents;
+                    for (int d = 0; d < p.dimensions(); d++) {
+                        mins.push_back(p.min_estimate(d));
+                        extents.push_back(p.extent_estimate(d));
+                    }
+                    Buffer<> b = make_estimated_buffer(p.type(), p.name(), mins, extents);
+                    std::vector<Var> vars(p.dimensions());
+                    Func fill;
+                    fill(vars) = p.type().is_float() ? cast(p.type(), random_float()) : cast(p.type(), random_uint());
+                    fill.realize(b);
+                    input_buffers[p.name()] = b;
+                }
+                p.set_buffer(input_buffers[p.name()]);
+            }
+
+            std::vector<Buffer<>> outputs;
+            for (Func f : pipeline.outputs()) {
+                for (size_t v = 0; v < f.output_types().size(); v++) {
+                    OutputImageParam out = f.output_buffers()[v];
+                    std::vector<Expr> mins, extents;
+                    for (int d = 0; d < f.dimensions(); d++) {
+                        mins.push_back(out.dim(d).min_estimate());
+                        extents.push_back(out.dim(d).extent_estimate());
+                    }
+                    outputs.push_back(make_estimated_buffer(f.output_types()[v], out.name(), mins, extents));
+                }
+            }
+            Realization dst(outputs);
+
+            pipeline.compile_jit(target);
+            // Warm up, and pick a number of iterations that takes
+            // about a tenth of a second per sample.
+            double once = benchmark(1, 1, [&]() { pipeline.realize(dst, target); });
+            int iterations = std::max(1, (int)(0.1 / std::max(once, 1e-9)));
+            t = benchmark(samples, iterations, [&]() { pipeline.realize(dst, target); });
+#ifdef WITH_EXCEPTIONS
+        } catch (const Halide::Error &e) {
+            cerr << "Variant" << description.str() << " failed: " << e.what() << "\n";
+            continue;
+        }
+#endif
+        cerr << "Variant " << (i + 1) << "/" << variants.size() << ":" << description.str()
+             << ": " << t * 1e3 << " ms\n";
+        if (t < best_time) {
+            best_time = t;
+            best = schedule;
+        }
+    }
+
+    if (best_time == std::numeric_limits<double>::infinity()) {
+        cerr << "No variant of " << generator_name << " could be benchmarked\n";
+        return 1;
+    }
+
+    std::ostringstream result;
+    result << "# Fastest schedule for " << generator_name << " on " << target.to_string()
+           << ": " << best_time * 1e3 << " ms\n";
+    for (const auto &s : best) {
+        result << s.first << "=" << s.second << "\n";
+    }
+    cerr << result.str();
+
+    std::string output_dir = flags_info["-o"];
+    if (!output_dir.empty()) {
+        std::string path = output_dir + "/" + generator_name + "." + target.to_string() + ".schedule";
+        std::ofstream file(path);
+        file << result.str();
+        if (!file) {
+            cerr << "Unable to write " << path << "\n";
+            return 1;
+        }
+    }
+    return 0;
+}
+
 GeneratorParamBase::GeneratorParamBase(const std::string &name) : name(name) {
     ObjectInstanceRegistry::register_instance(this, 0, ObjectInstanceRegistry::GeneratorParam,
                                               this, nullptr);
@@ -1370,6 +1660,35 @@ Module GeneratorBase::build_module(const std::string &function_name,
     return pipeline.compile_to_module(filter_arguments, function_name, target, linkage_type);
 }
 
+std::map<std::string, std::vector<std::string>> GeneratorBase::get_schedule_param_candidates() {
+    build_params();
+    std::map<std::string, std::vector<std::string>> result;
+    for (auto param : generator_params) {
+        if (param->is_schedule_param()) {
+            result[param->name] = param->get_candidate_values();
+        }
+    }
+    return result;
+}
+
+Pipeline GeneratorBase::build_jit_pipeline(std::vector<Parameter> &inputs) {
+    build_params();
+    Pipeline pipeline = build_pipeline();
+    // Building the pipeline may mutate the Params/ImageParams (but not Inputs).
+    if (filter_params.size() > 0) {
+        build_params(true);
+    }
+    for (auto param : filter_params) {
+        inputs.push_back(*param);
+    }
+    for (auto input : filter_inputs) {
+        for (const auto &p : input->parameters_) {
+            inputs.push_back(p);
+        }
+    }
+    return pipeline;
+}
+
 void GeneratorBase::emit_cpp_stub(const std::string &stub_file_path) {
     user_assert(!generator_name.empty()) << "Generator has no name.\n";
     build_params();
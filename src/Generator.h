@@ -291,6 +291,14 @@ EXPORT std::string halide_type_to_c_type(const Type &t);
  * command-line utility for ahead-of-time filter compilation. */
 EXPORT int generate_filter_main(int argc, char **argv, std::ostream &cerr);
 
+/** tune_filter_main() is the autotuning counterpart of
+ * generate_filter_main(): it benchmarks variants of a Generator's
+ * schedule, made from the values of its ScheduleParams, with the JIT,
+ * and writes out the fastest. It can be trivially wrapped by a "real"
+ * main() (see tools/GenTune.cpp) and linked with Generators in the
+ * same way as GenGen.cpp. */
+EXPORT int tune_filter_main(int argc, char **argv, std::ostream &cerr);
+
 // select_type<> is to std::conditional as switch is to if:
 // it allows a multiway compile-time type definition via the form
 //
@@ -357,6 +365,12 @@ protected:
         return false;
     }
 
+    // The values that tune_filter_main() tries for a ScheduleParam,
+    // starting with the current value.
+    virtual std::vector<std::string> get_candidate_values() const {
+        return {to_string()};
+    }
+
 private:
     explicit GeneratorParamBase(const GeneratorParamBase &) = delete;
     void operator=(const GeneratorParamBase &) = delete;
@@ -474,6 +488,36 @@ public:
         }
     }
 
+    // Try the powers of two in the range, or within a factor of four
+    // of the current value if the range is unbounded, along with the
+    // ends of the range.
+    std::vector<std::string> get_candidate_values() const override {
+        std::vector<T> values = {this->value()};
+        bool bounded = min != std::numeric_limits<T>::lowest() && max != std::numeric_limits<T>::max();
+        double lo = bounded ? (double)min : (double)this->value() / 4;
+        double hi = bounded ? (double)max : (double)this->value() * 4;
+        if (bounded) {
+            values.push_back(min);
+        }
+        for (double p = 1; p <= hi && values.size() < 16; p *= 2) {
+            if (p >= lo && p >= (double)min && p <= (double)max) {
+                values.push_back((T)p);
+            }
+        }
+        if (bounded) {
+            values.push_back(max);
+        }
+        std::vector<std::string> result;
+        for (const T &v : values) {
+            std::ostringstream oss;
+            oss << v;
+            if (std::find(result.begin(), result.end(), oss.str()) == result.end()) {
+                result.push_back(oss.str());
+            }
+        }
+        return result;
+    }
+
 private:
     const T min, max;
 };
@@ -508,6 +552,10 @@ public:
     std::string get_c_type() const override {
         return "bool";
     }
+
+    std::vector<std::string> get_candidate_values() const override {
+        return {to_string(), this->value() ? "false" : "true"};
+    }
 };
 
 template<typename T>
@@ -538,6 +586,16 @@ public:
         return "Enum_" + this->name + "::" + enum_to_string(enum_map, this->value());
     }
 
+    std::vector<std::string> get_candidate_values() const override {
+        std::vector<std::string> result = {to_string()};
+        for (auto key_value : enum_map) {
+            if (key_value.first != result[0]) {
+                result.push_back(key_value.first);
+            }
+        }
+        return result;
+    }
+
     std::string get_type_decls() const override {
         std::ostringstream oss;
         oss << "enum class Enum_" << this->name << " {\n";
@@ -593,6 +651,10 @@ public:
     std::string get_type_decls() const override {
         return "";
     }
+
+    std::vector<std::string> get_candidate_values() const override {
+        return {this->to_string()};
+    }
 };
 
 template<typename T>
@@ -626,6 +688,12 @@ public:
         return this->value() != get_halide_undefined_looplevel();
     }
 
+    // Which LoopLevels make sense depends on the schedule, so only
+    // the current one is tried unless others are given.
+    std::vector<std::string> get_candidate_values() const override {
+        return {this->to_string()};
+    }
+
 private:
     const std::string def;
 };
@@ -959,19 +1027,30 @@ public:
         check_scheduled("realize");
         f.realize(dst, get_target());
     }
+
+    /** Use this output as an ordinary Func of the enclosing pipeline,
+     * which can then be inlined into its consumers or scheduled
+     * relative to them, instead of being materialized in full. Any
+     * constraints the Stub's Generator put on its output buffer don't
+     * apply to it. */
+    explicit operator Func() const {
+        return f;
+    }
 };
 
 /**
  * StubOutputBuffer is the placeholder that a Stub uses when it requires
  * a Buffer for an output (rather than merely a Func). It is constructed
- * to allow only two possible sorts of things:
+ * to allow only three possible sorts of things:
  * -- Assignment to an Output<Buffer<>>, with compatible type and dimensions,
  * essentially allowing us to pipe a parameter from the result of a Stub to an
  * enclosing Generator
  * -- Realization into a Buffer<>; this is useful only in JIT compilation modes
  * (and shouldn't be usable otherwise)
+ * -- Explicit conversion to a Func, to fuse the output into the enclosing
+ * Generator's pipeline like any other Func
  *
- * It is deliberate that StubOutputBuffer is not (easily) convertible to Func.
+ * It is deliberate that StubOutputBuffer is not implicitly convertible to Func.
  */
 template<typename T = void>
 class StubOutputBuffer : public StubOutputBufferBase {
@@ -1458,6 +1537,15 @@ public:
                               const TBase &max)
         : Super(array_size, name, def), min_(min), max_(max) {
     }
+
+    /** Set an estimate of the typical value of this Input, for tools
+     * such as Pipeline::auto_schedule. Generates no runtime
+     * checks. */
+    void set_estimate(const TBase &value) {
+        for (Parameter &p : this->parameters_) {
+            p.set_estimate(Internal::make_const(type_of<TBase>(), value));
+        }
+    }
 };
 
 template<typename>
@@ -1970,7 +2058,7 @@ public:
     GeneratorParam<Target> target{ "target", Halide::get_host_target() };
 
     struct EmitOptions {
-        bool emit_o, emit_h, emit_cpp, emit_assembly, emit_bitcode, emit_stmt, emit_stmt_html, emit_static_library, emit_cpp_stub;
+        bool emit_o, emit_h, emit_cpp, emit_assembly, emit_bitcode, emit_thin_lto, emit_stmt, emit_stmt_html, emit_static_library, emit_cpp_stub;
         // This is an optional map used to replace the default extensions generated for
         // a file: if an key matches an output extension, emit those files with the
         // corresponding value instead (e.g., ".s" -> ".assembly_text"). This is
@@ -1980,7 +2068,7 @@ public:
         std::map<std::string, std::string> substitutions;
         EmitOptions()
             : emit_o(false), emit_h(true), emit_cpp(false), emit_assembly(false),
-              emit_bitcode(false), emit_stmt(false), emit_stmt_html(false), emit_static_library(true), emit_cpp_stub(false) {}
+              emit_bitcode(false), emit_thin_lto(false), emit_stmt(false), emit_stmt_html(false), emit_static_library(true), emit_cpp_stub(false) {}
     };
 
     EXPORT virtual ~GeneratorBase();
@@ -2078,6 +2166,13 @@ private:
 
     EXPORT void set_inputs(const std::vector<std::vector<StubInput>> &inputs);
 
+    // Used by tune_filter_main(): the values to try for each
+    // ScheduleParam, and the Pipeline built for JIT compilation along
+    // with the Parameters of its inputs.
+    friend int tune_filter_main(int argc, char **argv, std::ostream &cerr);
+    std::map<std::string, std::vector<std::string>> get_schedule_param_candidates();
+    Pipeline build_jit_pipeline(std::vector<Parameter> &inputs);
+
     GeneratorBase(const GeneratorBase &) = delete;
     void operator=(const GeneratorBase &) = delete;
 };
@@ -1,17 +1,21 @@
+#include <algorithm>
 #include <iostream>
 #include <fstream>
 #include <memory>
+#include <set>
 
 #include "HexagonOffload.h"
 #include "Closure.h"
 #include "InjectHostDevBufferCopies.h"
 #include "IRMutator.h"
 #include "IROperator.h"
+#include "IRVisitor.h"
 #include "LLVM_Output.h"
 #include "LLVM_Headers.h"
 #include "Param.h"
 #include "RemoveTrivialForLoops.h"
 #include "Substitute.h"
+#include "Util.h"
 
 namespace Halide {
 namespace Internal {
@@ -73,11 +77,219 @@ Stmt power_hvx_on(Stmt stmt) {
     return stmt;
 }
 
+// Find the buffers some host code uses, and whether it queues any
+// asynchronous Hexagon runs.
+class FindHostBufferUses : public IRGraphVisitor {
+    using IRGraphVisitor::visit;
+
+    void visit(const Load *op) {
+        buffers.insert(op->name);
+        IRGraphVisitor::visit(op);
+    }
+
+    void visit(const Store *op) {
+        buffers.insert(op->name);
+        IRGraphVisitor::visit(op);
+    }
+
+    void visit(const Free *op) {
+        buffers.insert(op->name);
+    }
+
+    void visit(const Variable *op) {
+        if (op->type.is_handle()) {
+            for (const string suffix : {".buffer", ".host"}) {
+                if (ends_with(op->name, suffix)) {
+                    buffers.insert(op->name.substr(0, op->name.size() - suffix.size()));
+                }
+            }
+        }
+    }
+
+    void visit(const Call *op) {
+        runs |= op->name == "halide_hexagon_run_async";
+        IRGraphVisitor::visit(op);
+    }
+
+public:
+    std::set<string> buffers;
+    bool runs = false;
+};
+
+// Asynchronous Hexagon runs return before they are done. Insert calls
+// to halide_hexagon_wait before any host code that uses a buffer
+// that a queued run also uses, or before the buffer goes out of
+// scope. The runs themselves are run in order, so consecutive runs
+// don't need to wait for each other.
+class InjectHexagonWaits : public IRMutator {
+    using IRMutator::visit;
+
+    // The buffers used by runs queued since the last wait.
+    std::set<string> pending;
+
+    Stmt wait() {
+        pending.clear();
+        return call_extern_and_assert("halide_hexagon_wait", {});
+    }
+
+    template<typename StmtOrExpr>
+    bool needs_wait(StmtOrExpr s) {
+        if (pending.empty()) {
+            return false;
+        }
+        FindHostBufferUses uses;
+        s.accept(&uses);
+        for (const string &b : uses.buffers) {
+            if (pending.count(b)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    Stmt visit_leaf(Stmt s) {
+        if (needs_wait(s)) {
+            s = Block::make(wait(), s);
+        }
+        return s;
+    }
+
+    void visit(const Evaluate *op) { stmt = visit_leaf(op); }
+    void visit(const AssertStmt *op) { stmt = visit_leaf(op); }
+    void visit(const Store *op) { stmt = visit_leaf(op); }
+    void visit(const Free *op) { stmt = visit_leaf(op); }
+
+    void visit(const LetStmt *op) {
+        const Call *c = op->value.as<Call>();
+        if (c && c->name == "halide_hexagon_run_async") {
+            // Queue the run. The body just checks the result.
+            FindHostBufferUses uses;
+            c->accept(&uses);
+            pending.insert(uses.buffers.begin(), uses.buffers.end());
+            stmt = op;
+            return;
+        }
+        Stmt before;
+        if (needs_wait(op->value)) {
+            before = wait();
+        }
+        Stmt body = mutate(op->body);
+        if (body.same_as(op->body)) {
+            stmt = op;
+        } else {
+            stmt = LetStmt::make(op->name, op->value, body);
+        }
+        if (before.defined()) {
+            stmt = Block::make(before, stmt);
+        }
+    }
+
+    void visit(const Allocate *op) {
+        bool wait_first = needs_wait(op->condition);
+        for (Expr e : op->extents) {
+            wait_first |= needs_wait(e);
+        }
+        if (op->new_expr.defined()) {
+            wait_first |= needs_wait(op->new_expr);
+        }
+        Stmt before;
+        if (wait_first) {
+            before = wait();
+        }
+        Stmt body = mutate(op->body);
+        // Don't free the allocation while a run is using it.
+        if (pending.count(op->name)) {
+            body = Block::make(body, wait());
+        }
+        stmt = Allocate::make(op->name, op->type, op->memory_type, op->extents, op->condition, body,
+                              op->new_expr, op->free_function);
+        if (before.defined()) {
+            stmt = Block::make(before, stmt);
+        }
+    }
+
+    void visit(const For *op) {
+        FindHostBufferUses uses;
+        op->body.accept(&uses);
+        if (!uses.runs) {
+            stmt = visit_leaf(op);
+            return;
+        }
+
+        Stmt before;
+        if (needs_wait(op->min) || needs_wait(op->extent)) {
+            before = wait();
+        }
+
+        // Runs queued near the end of one iteration may still be
+        // pending at the start of the next, so iterate until the
+        // runs pending at the end of the body were accounted for at
+        // the start.
+        std::set<string> start = pending;
+        Stmt body;
+        while (true) {
+            pending = start;
+            body = mutate(op->body);
+            if (std::includes(start.begin(), start.end(), pending.begin(), pending.end())) {
+                break;
+            }
+            start.insert(pending.begin(), pending.end());
+        }
+        // The loop might not run at all.
+        pending = start;
+
+        stmt = For::make(op->name, op->min, op->extent, op->for_type, op->device_api, body);
+        if (before.defined()) {
+            stmt = Block::make(before, stmt);
+        }
+    }
+
+    void visit(const IfThenElse *op) {
+        FindHostBufferUses uses;
+        op->then_case.accept(&uses);
+        if (op->else_case.defined()) {
+            op->else_case.accept(&uses);
+        }
+        if (!uses.runs) {
+            stmt = visit_leaf(op);
+            return;
+        }
+
+        Stmt before;
+        if (needs_wait(op->condition)) {
+            before = wait();
+        }
+        std::set<string> start = pending;
+        Stmt then_case = mutate(op->then_case);
+        std::set<string> after_then = pending;
+        pending = start;
+        Stmt else_case = op->else_case.defined() ? mutate(op->else_case) : Stmt();
+        pending.insert(after_then.begin(), after_then.end());
+
+        stmt = IfThenElse::make(op->condition, then_case, else_case);
+        if (before.defined()) {
+            stmt = Block::make(before, stmt);
+        }
+    }
+
+public:
+    Stmt inject(Stmt s) {
+        s = mutate(s);
+        if (!pending.empty()) {
+            s = Block::make(s, wait());
+        }
+        return s;
+    }
+};
+
 class InjectHexagonRpc : public IRMutator {
     std::map<std::string, Expr> state_vars;
 
     Module device_code;
 
+    // Whether to queue the runs instead of waiting for each one.
+    bool async;
+
     /** Alignment info for Int(32) variables in scope, so we don't
      * lose the information when creating Hexagon kernels. */
     Scope<ModulusRemainder> alignment_info;
@@ -220,7 +432,7 @@ class InjectHexagonRpc : public IRMutator {
             params.push_back(Call::make(type_of<void**>(), Call::make_struct, arg_ptrs, Call::Intrinsic));
             params.push_back(Call::make(type_of<int*>(), Call::make_struct, arg_flags, Call::Intrinsic));
 
-            stmt = call_extern_and_assert("halide_hexagon_run", params);
+            stmt = call_extern_and_assert(async ? "halide_hexagon_run_async" : "halide_hexagon_run", params);
 
         } else {
             IRMutator::visit(loop);
@@ -252,7 +464,7 @@ class InjectHexagonRpc : public IRMutator {
     }
 
 public:
-    InjectHexagonRpc(const Target &target) : device_code("hexagon", target) {}
+    InjectHexagonRpc(const Target &target, bool async) : device_code("hexagon", target), async(async) {}
 
     Stmt inject(Stmt s) {
         s = mutate(s);
@@ -262,6 +474,10 @@ public:
             return s;
         }
 
+        if (async) {
+            s = InjectHexagonWaits().inject(s);
+        }
+
         // If we got here, it means the pipeline runs at least one
         // Hexagon kernel. To reduce overhead of individual
         // sub-pipelines running on Hexagon, we can power on HVX once
@@ -322,7 +538,7 @@ Stmt inject_hexagon_rpc(Stmt s, const Target &host_target) {
         }
     }
 
-    InjectHexagonRpc injector(target);
+    InjectHexagonRpc injector(target, host_target.has_feature(Target::HexagonAsync));
     s = injector.inject(s);
     return s;
 }
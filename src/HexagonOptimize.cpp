@@ -627,9 +627,24 @@ private:
             { i32(wild_i8x), i32(i16(wild_i8x)) },
         };
 
+        // Patterns for instructions added in v62.
+        static vector<Pattern> casts_v62 = {
+            // Saturating add/subtract
+            { "halide.hexagon.satb_add.vb.vb", i8_sat(wild_i16x + wild_i16x), Pattern::NarrowOps },
+            { "halide.hexagon.satuw_add.vuw.vuw", u32_sat(wild_u64x + wild_u64x), Pattern::NarrowOps },
+
+            { "halide.hexagon.satb_sub.vb.vb", i8_sat(wild_i16x - wild_i16x), Pattern::NarrowOps },
+            { "halide.hexagon.satuw_sub.vuw.vuw", u32_sat(wild_i64x - wild_i64x), Pattern::NarrowUnsignedOps },
+        };
+
         if (op->type.is_vector()) {
             Expr cast = op;
 
+            if (has_v62) {
+                expr = apply_patterns(cast, casts_v62, this);
+                if (!expr.same_as(cast)) return;
+            }
+
             expr = apply_patterns(cast, casts, this);
             if (!expr.same_as(cast)) return;
 
@@ -678,8 +693,14 @@ private:
         }
     }
 
+    bool has_v62;
+
 public:
-    OptimizePatterns() {}
+    OptimizePatterns(const Target &t) {
+        // LLVM only has intrinsics for the v62 instructions from
+        // version 5.0.
+        has_v62 = t.has_feature(Target::HVX_v62) && LLVM_VERSION >= 50;
+    }
 };
 
 // Attempt to cancel out redundant interleave/deinterleave pairs. The
@@ -1144,7 +1165,7 @@ class EliminateInterleaves : public IRMutator {
         }
 
         if (!body.same_as(op->body) || !condition.same_as(op->condition)) {
-            stmt = Allocate::make(op->name, op->type, op->extents, condition, body,
+            stmt = Allocate::make(op->name, op->type, op->memory_type, op->extents, condition, body,
                                   op->new_expr, op->free_function);
         } else {
             stmt = op;
@@ -1428,10 +1449,10 @@ Stmt optimize_hexagon_shuffles(Stmt s, int lut_alignment) {
     return OptimizeShuffles(lut_alignment).mutate(s);
 }
 
-Stmt optimize_hexagon_instructions(Stmt s) {
+Stmt optimize_hexagon_instructions(Stmt s, const Target &t) {
     // Peephole optimize for Hexagon instructions. These can generate
     // interleaves and deinterleaves alongside the HVX intrinsics.
-    s = OptimizePatterns().mutate(s);
+    s = OptimizePatterns(t).mutate(s);
 
     // Try to eliminate any redundant interleave/deinterleave pairs.
     s = EliminateInterleaves().mutate(s);
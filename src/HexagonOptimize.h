@@ -6,6 +6,7 @@
  */
 
 #include "IR.h"
+#include "Target.h"
 
 namespace Halide {
 namespace Internal {
@@ -18,8 +19,9 @@ EXPORT Stmt optimize_hexagon_shuffles(Stmt s, int lut_alignment);
  * interleaves when performing narrowing operations. This pass
  * rewrites widenings/narrowings to be explicit in the IR, and
  * attempts to simplify away most of the
- * interleaving/deinterleaving. */
-EXPORT Stmt optimize_hexagon_instructions(Stmt s);
+ * interleaving/deinterleaving. Instructions added in later versions
+ * of HVX are only used if the target has them. */
+EXPORT Stmt optimize_hexagon_instructions(Stmt s, const Target &t);
 
 /** Generate deinterleave or interleave operations, operating on
  * groups of vectors at a time. */
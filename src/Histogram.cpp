@@ -0,0 +1,59 @@
+#include "Histogram.h"
+#include "IROperator.h"
+#include "Pipeline.h"
+#include "Simplify.h"
+
+namespace Halide {
+
+using namespace Internal;
+
+Func histogram(RDom r, Expr bin, int num_bins, int vector_width, const std::string &name) {
+    user_assert(r.defined() && bin.defined())
+        << "histogram " << name << " needs a defined reduction domain and bin\n";
+    user_assert(num_bins > 0)
+        << "histogram " << name << " can't have " << num_bins << " bins\n";
+    user_assert(vector_width > 0)
+        << "histogram " << name << " can't have a vector width of " << vector_width << "\n";
+
+    Func hist(name);
+    Var b(name + "_bin"), u(name + "_task"), lane(name + "_lane");
+    hist(b) = 0;
+    hist(clamp(cast<int>(bin), 0, num_bins - 1)) += 1;
+
+    // Give each task a slice of the outermost dimension of r, and its
+    // own bins to count into.
+    Stage counts = hist.update();
+    RVar outer = r[r.dimensions() - 1];
+    RVar task(outer.name() + "_task"), in_task(outer.name() + "_in_task");
+    int tasks = MachineParams::generic().parallelism;
+    counts.split(outer, task, in_task, simplify((outer.extent() + (tasks - 1)) / tasks),
+                 TailStrategy::GuardWithIf);
+
+    // Within each task, give each vector lane its own bins too.
+    RVar inner = r.dimensions() == 1 ? in_task : RVar(r[0]);
+    RVar lanes(inner.name() + "_vectors"), in_lane(inner.name() + "_lane");
+    if (vector_width > 1) {
+        counts.split(inner, lanes, in_lane, vector_width, TailStrategy::GuardWithIf);
+    }
+
+    Func per_task = counts.rfactor(task, u);
+    per_task.compute_root();
+    if (vector_width > 1) {
+        Func per_lane = per_task.update().rfactor(in_lane, lane);
+        per_lane.compute_at(per_task, u).update().vectorize(lane);
+
+        // Sum the lanes of each task, and then the tasks, a vector
+        // of bins at a time.
+        per_task.update()
+            .reorder(b, in_lane, u)
+            .vectorize(b, vector_width, TailStrategy::GuardWithIf);
+        hist.update()
+            .reorder(b, task)
+            .vectorize(b, vector_width, TailStrategy::GuardWithIf);
+    }
+    per_task.update().parallel(u);
+
+    return hist;
+}
+
+}
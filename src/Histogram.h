@@ -0,0 +1,36 @@
+#ifndef HALIDE_HISTOGRAM_H
+#define HALIDE_HISTOGRAM_H
+
+#include "Func.h"
+#include "RDom.h"
+
+/** \file
+ * Defines a histogram that is computed in parallel.
+ */
+
+namespace Halide {
+
+/** Count how many points of the reduction domain r fall in each of
+ * num_bins bins. The bin of each point is given by the Expr bin,
+ * which should refer to r, and is clamped to [0, num_bins). E.g.:
+ \code
+ RDom r(input);
+ Func hist = histogram(r, input(r.x, r.y), 256, 8);
+ \endcode
+ *
+ * Written as a scatter into a single set of bins, a histogram is
+ * serial, and conflicts between the lanes of a vector keep it from
+ * being vectorized. Here each of several parallel tasks, each taking
+ * a slice of the outermost dimension of r, counts into its own copy
+ * of the bins. If vector_width is greater than one, each lane of a
+ * vector across the innermost dimension of r has a copy of the bins
+ * within each task too, so the scatter is vectorized with no
+ * conflicts. The copies are summed at the end. The result is a
+ * one-dimensional Func of int32 counts, defined over [0, num_bins),
+ * that can be scheduled like any other reduction. */
+EXPORT Func histogram(RDom r, Expr bin, int num_bins, int vector_width = 1,
+                      const std::string &name = "histogram");
+
+}
+
+#endif
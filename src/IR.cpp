@@ -366,7 +366,8 @@ Stmt Provide::make(std::string name, const std::vector<Expr> &values, const std:
     return node;
 }
 
-Stmt Allocate::make(std::string name, Type type, const std::vector<Expr> &extents,
+Stmt Allocate::make(std::string name, Type type, MemoryType memory_type,
+                    const std::vector<Expr> &extents,
                     Expr condition, Stmt body,
                     Expr new_expr, std::string free_function) {
     for (size_t i = 0; i < extents.size(); i++) {
@@ -380,6 +381,7 @@ Stmt Allocate::make(std::string name, Type type, const std::vector<Expr> &extent
     Allocate *node = new Allocate;
     node->name = name;
     node->type = type;
+    node->memory_type = memory_type;
     node->extents = extents;
     node->new_expr = new_expr;
     node->free_function = free_function;
@@ -498,6 +500,15 @@ Stmt Evaluate::make(Expr v) {
     return node;
 }
 
+Stmt Atomic::make(const std::string &name, Stmt body) {
+    internal_assert(body.defined()) << "Atomic of undefined\n";
+
+    Atomic *node = new Atomic;
+    node->name = name;
+    node->body = body;
+    return node;
+}
+
 Expr Call::make(Function func, const std::vector<Expr> &args, int idx) {
     internal_assert(idx >= 0 &&
                     idx < func.outputs())
@@ -590,6 +601,7 @@ template<> void StmtNode<Realize>::accept(IRVisitor *v) const { v->visit((const
 template<> void StmtNode<Block>::accept(IRVisitor *v) const { v->visit((const Block *)this); }
 template<> void StmtNode<IfThenElse>::accept(IRVisitor *v) const { v->visit((const IfThenElse *)this); }
 template<> void StmtNode<Evaluate>::accept(IRVisitor *v) const { v->visit((const Evaluate *)this); }
+template<> void StmtNode<Atomic>::accept(IRVisitor *v) const { v->visit((const Atomic *)this); }
 
 Call::ConstString Call::debug_to_file = "debug_to_file";
 Call::ConstString Call::shuffle_vector = "shuffle_vector";
@@ -639,6 +651,16 @@ Call::ConstString Call::indeterminate_expression = "indeterminate_expression";
 Call::ConstString Call::bool_to_mask = "bool_to_mask";
 Call::ConstString Call::cast_mask = "cast_mask";
 Call::ConstString Call::select_mask = "select_mask";
+Call::ConstString Call::vector_reduce_add = "vector_reduce_add";
+Call::ConstString Call::vector_reduce_mul = "vector_reduce_mul";
+Call::ConstString Call::vector_reduce_min = "vector_reduce_min";
+Call::ConstString Call::vector_reduce_max = "vector_reduce_max";
+Call::ConstString Call::widening_mul = "widening_mul";
+Call::ConstString Call::saturating_add = "saturating_add";
+Call::ConstString Call::saturating_sub = "saturating_sub";
+Call::ConstString Call::halving_add = "halving_add";
+Call::ConstString Call::rounding_halving_add = "rounding_halving_add";
+Call::ConstString Call::rounding_shift_right = "rounding_shift_right";
 
 Call::ConstString Call::buffer_get_min = "_halide_buffer_get_min";
 Call::ConstString Call::buffer_get_max = "_halide_buffer_get_max";
@@ -328,10 +328,12 @@ struct Provide : public StmtNode<Provide> {
  * size. The buffer lives for at most the duration of the body
  * statement, within which it is freed. It is an error for an allocate
  * node not to contain a free node of the same buffer. Allocation only
- * occurs if the condition evaluates to true. */
+ * occurs if the condition evaluates to true. The memory type says
+ * where it goes; see Func::store_in. */
 struct Allocate : public StmtNode<Allocate> {
     std::string name;
     Type type;
+    MemoryType memory_type;
     std::vector<Expr> extents;
     Expr condition;
 
@@ -346,7 +348,8 @@ struct Allocate : public StmtNode<Allocate> {
     std::string free_function;
     Stmt body;
 
-    EXPORT static Stmt make(std::string name, Type type, const std::vector<Expr> &extents,
+    EXPORT static Stmt make(std::string name, Type type, MemoryType memory_type,
+                            const std::vector<Expr> &extents,
                             Expr condition, Stmt body,
                             Expr new_expr = Expr(), std::string free_function = std::string());
 
@@ -431,6 +434,19 @@ struct Evaluate : public StmtNode<Evaluate> {
     static const IRNodeType _type_info = IRNodeType::Evaluate;
 };
 
+/** The stores in the body are the updates of an associative
+ * reduction of the named Func, and must each be done atomically, so
+ * that parallel iterations updating the same site don't race. See
+ * Stage::atomic. */
+struct Atomic : public StmtNode<Atomic> {
+    std::string name;
+    Stmt body;
+
+    EXPORT static Stmt make(const std::string &name, Stmt body);
+
+    static const IRNodeType _type_info = IRNodeType::Atomic;
+};
+
 /** A function call. This can represent a call to some extern function
  * (like sin), but it's also our multi-dimensional version of a Load,
  * so it can be a load from an input image, or a call to another
@@ -505,7 +521,17 @@ struct Call : public ExprNode<Call> {
         indeterminate_expression,
         bool_to_mask,
         cast_mask,
-        select_mask;
+        select_mask,
+        vector_reduce_add,
+        vector_reduce_mul,
+        vector_reduce_min,
+        vector_reduce_max,
+        widening_mul,
+        saturating_add,
+        saturating_sub,
+        halving_add,
+        rounding_halving_add,
+        rounding_shift_right;
 
     // We also declare some symbolic names for some of the runtime
     // functions that we want to construct Call nodes to here to avoid
@@ -638,7 +664,8 @@ struct For : public StmtNode<For> {
     bool is_parallel() const {
         return (for_type == ForType::Parallel ||
                 for_type == ForType::GPUBlock ||
-                for_type == ForType::GPUThread);
+                for_type == ForType::GPUThread ||
+                for_type == ForType::GPULane);
     }
 
     static const IRNodeType _type_info = IRNodeType::For;
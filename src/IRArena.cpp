@@ -0,0 +1,199 @@
+#include <atomic>
+#include <cstddef>
+#include <iostream>
+#include <stdint.h>
+#include <stdlib.h>
+#include <vector>
+
+#include "IRArena.h"
+#include "IR.h"
+#include "IREquality.h"
+#include "IROperator.h"
+
+namespace Halide {
+namespace Internal {
+
+namespace {
+
+class Arena;
+
+// Every node is preceded by a header saying where it came from, so
+// that it can be freed without knowing which arena, if any, is
+// active. Nodes not from an arena have a null arena.
+struct alignas(std::max_align_t) NodeHeader {
+    Arena *arena;
+    uint32_t size_class;
+};
+
+const size_t header_size = sizeof(NodeHeader);
+
+// Nodes (with their headers) are rounded up to a multiple of the
+// granularity. Anything larger than max_small_size comes from malloc.
+const size_t granularity = header_size;
+const size_t max_small_size = 256;
+const size_t num_size_classes = max_small_size / granularity;
+const size_t block_size = 64 * 1024;
+
+class Arena {
+    // The blocks that nodes are bump-allocated from.
+    std::vector<char *> blocks;
+    char *next = nullptr, *end = nullptr;
+
+    // Freed nodes of each size class, linked through their first
+    // word. Only the thread the arena is active on touches these.
+    void *free_lists[num_size_classes] = {};
+
+public:
+    // The number of nodes allocated from this arena and not yet freed,
+    // plus one while the scope that made it is alive. The arena is
+    // deleted when this reaches zero.
+    std::atomic<size_t> live;
+
+    Arena() : live(1) {}
+
+    ~Arena() {
+        for (char *b : blocks) {
+            free(b);
+        }
+    }
+
+    NodeHeader *allocate(uint32_t size_class) {
+        live++;
+        void *head = free_lists[size_class];
+        if (head) {
+            free_lists[size_class] = *(void **)head;
+            return (NodeHeader *)head;
+        }
+        size_t bytes = (size_class + 1) * granularity;
+        if (next + bytes > end) {
+            next = (char *)malloc(block_size);
+            internal_assert(next) << "Out of memory allocating IR nodes\n";
+            end = next + block_size;
+            blocks.push_back(next);
+        }
+        NodeHeader *h = (NodeHeader *)next;
+        next += bytes;
+        return h;
+    }
+
+    void recycle(NodeHeader *h) {
+        uint32_t size_class = h->size_class;
+        *(void **)h = free_lists[size_class];
+        free_lists[size_class] = h;
+        release();
+    }
+
+    void release() {
+        if (--live == 0) {
+            delete this;
+        }
+    }
+};
+
+thread_local Arena *current_arena = nullptr;
+
+bool arena_enabled_by_env() {
+    size_t defined = 0;
+    return get_env_variable("HL_IR_ARENA", defined) == "1";
+}
+
+std::atomic<bool> &arena_enabled() {
+    static std::atomic<bool> enabled(arena_enabled_by_env());
+    return enabled;
+}
+
+}  // namespace
+
+void *ir_node_allocate(size_t size) {
+    size_t bytes = size + header_size;
+    Arena *arena = current_arena;
+    NodeHeader *h;
+    if (arena && bytes <= max_small_size) {
+        uint32_t size_class = (uint32_t)((bytes + granularity - 1) / granularity - 1);
+        h = arena->allocate(size_class);
+        h->arena = arena;
+        h->size_class = size_class;
+    } else {
+        h = (NodeHeader *)malloc(bytes);
+        internal_assert(h) << "Out of memory allocating IR nodes\n";
+        h->arena = nullptr;
+        h->size_class = 0;
+    }
+    return (char *)h + header_size;
+}
+
+void ir_node_free(void *ptr) {
+    if (!ptr) {
+        return;
+    }
+    NodeHeader *h = (NodeHeader *)((char *)ptr - header_size);
+    Arena *arena = h->arena;
+    if (!arena) {
+        free(h);
+    } else if (arena == current_arena) {
+        arena->recycle(h);
+    } else {
+        // Another thread's arena, or one whose scope has ended. Its free
+        // lists aren't ours to touch, so just drop the reference.
+        arena->release();
+    }
+}
+
+void set_ir_arena_enabled(bool enabled) {
+    arena_enabled() = enabled;
+}
+
+IRArenaScope::IRArenaScope() : owner(current_arena == nullptr && arena_enabled()) {
+    if (owner) {
+        current_arena = new Arena;
+    }
+}
+
+IRArenaScope::~IRArenaScope() {
+    if (owner) {
+        Arena *arena = current_arena;
+        current_arena = nullptr;
+        arena->release();
+    }
+}
+
+void ir_arena_test() {
+    bool was_enabled = arena_enabled();
+    set_ir_arena_enabled(true);
+
+    Expr x = Variable::make(Int(32), "x");
+    Expr outlives_scope;
+    {
+        IRArenaScope scope;
+        internal_assert(current_arena) << "IRArenaScope did not make an arena\n";
+
+        {
+            IRArenaScope nested;
+            internal_assert(current_arena) << "Nested IRArenaScope released the arena\n";
+        }
+
+        // Freed nodes are reused by nodes of the same size.
+        const IRNode *first = Variable::make(Int(32), "y").get();
+        const IRNode *second = Variable::make(Int(32), "z").get();
+        internal_assert(first == second) << "Freed IR node was not recycled\n";
+
+        outlives_scope = x * 3 + 4;
+    }
+    internal_assert(!current_arena) << "IRArenaScope did not restore the arena\n";
+
+    // Nodes from the arena stay valid after the scope ends.
+    internal_assert(equal(outlives_scope, x * 3 + 4)) << "IR node did not outlive its arena\n";
+    outlives_scope = Expr();
+
+    set_ir_arena_enabled(false);
+    {
+        IRArenaScope scope;
+        internal_assert(!current_arena) << "Disabled IRArenaScope made an arena\n";
+    }
+
+    set_ir_arena_enabled(was_enabled);
+    std::cout << "IR arena test passed\n";
+}
+
+}
+}
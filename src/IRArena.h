@@ -0,0 +1,54 @@
+#ifndef HALIDE_IR_ARENA_H
+#define HALIDE_IR_ARENA_H
+
+/** \file
+ * Defines an optional arena allocator for IR nodes.
+ */
+
+#include <stddef.h>
+
+#include "Util.h"
+
+namespace Halide {
+namespace Internal {
+
+/** Allocate and free the memory for an IR node. IRNode's operator new
+ * and operator delete call these. While an IRArenaScope is active on
+ * the current thread, and arena allocation is enabled, small nodes
+ * come from free lists in that scope's arena instead of from
+ * malloc. A node may be freed on any thread, and may outlive the
+ * scope it was allocated in. */
+// @{
+EXPORT void *ir_node_allocate(size_t size);
+EXPORT void ir_node_free(void *ptr);
+// @}
+
+/** Turn arena allocation of IR nodes on or off for IRArenaScopes
+ * created from now on. The default is off, unless the environment
+ * variable HL_IR_ARENA is set to 1. */
+EXPORT void set_ir_arena_enabled(bool enabled);
+
+/** While an object of this class is alive, and arena allocation is
+ * enabled, IR nodes allocated on the current thread come from an
+ * arena, and nodes from that arena freed on the current thread are
+ * recycled. lower() holds one for the whole of lowering. Nested
+ * scopes share the outermost arena. The memory of the arena is
+ * released once the scope has ended and the last node allocated from
+ * it has been freed. */
+class IRArenaScope {
+    bool owner;
+
+    IRArenaScope(const IRArenaScope &) = delete;
+    IRArenaScope &operator=(const IRArenaScope &) = delete;
+
+public:
+    EXPORT IRArenaScope();
+    EXPORT ~IRArenaScope();
+};
+
+EXPORT void ir_arena_test();
+
+}
+}
+
+#endif
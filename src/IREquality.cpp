@@ -88,6 +88,7 @@ private:
     void visit(const Block *);
     void visit(const IfThenElse *);
     void visit(const Evaluate *);
+    void visit(const Atomic *);
 };
 
 template<typename T>
@@ -385,6 +386,7 @@ void IRComparer::visit(const Allocate *op) {
     const Allocate *s = stmt.as<Allocate>();
 
     compare_names(s->name, op->name);
+    compare_scalar(s->memory_type, op->memory_type);
     compare_expr_vector(s->extents, op->extents);
     compare_stmt(s->body, op->body);
     compare_expr(s->condition, op->condition);
@@ -436,6 +438,13 @@ void IRComparer::visit(const Evaluate *op) {
     compare_expr(s->value, op->value);
 }
 
+void IRComparer::visit(const Atomic *op) {
+    const Atomic *s = stmt.as<Atomic>();
+
+    compare_names(s->name, op->name);
+    compare_stmt(s->body, op->body);
+}
+
 } // namespace
 
 
@@ -247,7 +247,7 @@ void IRMutator::visit(const Allocate *op) {
         new_expr.same_as(op->new_expr)) {
         stmt = op;
     } else {
-        stmt = Allocate::make(op->name, op->type, new_extents, condition, body, new_expr, op->free_function);
+        stmt = Allocate::make(op->name, op->type, op->memory_type, new_extents, condition, body, new_expr, op->free_function);
     }
 }
 
@@ -315,6 +315,15 @@ void IRMutator::visit(const Evaluate *op) {
     }
 }
 
+void IRMutator::visit(const Atomic *op) {
+    Stmt body = mutate(op->body);
+    if (body.same_as(op->body)) {
+        stmt = op;
+    } else {
+        stmt = Atomic::make(op->name, body);
+    }
+}
+
 
 Stmt IRGraphMutator::mutate(Stmt s) {
     auto iter = stmt_replacements.find(s);
@@ -827,4 +827,46 @@ Expr saturating_cast(Type t, Expr e) {
     return e;
 }
 
+namespace {
+
+Expr make_fixed_point_intrinsic(const char *name, Expr a, Expr b, bool widens = false) {
+    user_assert(a.defined() && b.defined()) << name << " of undefined Expr\n";
+    Internal::match_types(a, b);
+    user_assert(a.type().is_int() || a.type().is_uint())
+        << "The arguments to " << name << " must be integers: " << a << ", " << b << "\n";
+    user_assert(a.type().bits() <= 32)
+        << "The arguments to " << name << " must have at most 32 bits: " << a << ", " << b << "\n";
+    Type t = a.type();
+    if (widens) {
+        t = t.with_bits(t.bits() * 2);
+    }
+    return Internal::Call::make(t, name, {a, b}, Internal::Call::PureIntrinsic);
+}
+
+}  // namespace
+
+Expr widening_mul(Expr a, Expr b) {
+    return make_fixed_point_intrinsic(Internal::Call::widening_mul, a, b, true);
+}
+
+Expr saturating_add(Expr a, Expr b) {
+    return make_fixed_point_intrinsic(Internal::Call::saturating_add, a, b);
+}
+
+Expr saturating_sub(Expr a, Expr b) {
+    return make_fixed_point_intrinsic(Internal::Call::saturating_sub, a, b);
+}
+
+Expr halving_add(Expr a, Expr b) {
+    return make_fixed_point_intrinsic(Internal::Call::halving_add, a, b);
+}
+
+Expr rounding_halving_add(Expr a, Expr b) {
+    return make_fixed_point_intrinsic(Internal::Call::rounding_halving_add, a, b);
+}
+
+Expr rounding_shift_right(Expr a, Expr b) {
+    return make_fixed_point_intrinsic(Internal::Call::rounding_shift_right, a, b);
+}
+
 }
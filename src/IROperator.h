@@ -1974,6 +1974,36 @@ Expr saturating_cast(Expr e) {
  * maximum values of the result type. */
 EXPORT Expr saturating_cast(Type t, Expr e);
 
+/** Fixed-point arithmetic on integers of up to 32 bits. The operands
+ * are converted to a common type as for the arithmetic operators, and
+ * the result has that type unless noted. They compute their results
+ * as if at twice the bit width, so they never overflow. Each backend
+ * lowers them to the instructions it has for these operations, which
+ * writing them out by hand doesn't always manage. */
+// @{
+
+/** The product of a and b, at twice their bit width. */
+EXPORT Expr widening_mul(Expr a, Expr b);
+
+/** The sum or difference of a and b, clamped to the range of their
+ * type. */
+// @{
+EXPORT Expr saturating_add(Expr a, Expr b);
+EXPORT Expr saturating_sub(Expr a, Expr b);
+// @}
+
+/** (a + b) / 2, rounded down or to nearest (with ties rounded up)
+ * respectively. */
+// @{
+EXPORT Expr halving_add(Expr a, Expr b);
+EXPORT Expr rounding_halving_add(Expr a, Expr b);
+// @}
+
+/** a >> b, rounded to nearest with ties rounded up, i.e. a / 2^b
+ * rounded rather than truncated. b must not be negative. */
+EXPORT Expr rounding_shift_right(Expr a, Expr b);
+// @}
+
 }
 
 #endif
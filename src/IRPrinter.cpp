@@ -87,6 +87,30 @@ ostream &operator<<(ostream &out, const DeviceAPI &api) {
     return out;
 }
 
+ostream &operator<<(ostream &out, const MemoryType &t) {
+    switch (t) {
+    case MemoryType::Auto:
+        out << "Auto";
+        break;
+    case MemoryType::Heap:
+        out << "Heap";
+        break;
+    case MemoryType::Stack:
+        out << "Stack";
+        break;
+    case MemoryType::Register:
+        out << "Register";
+        break;
+    case MemoryType::GPUShared:
+        out << "GPUShared";
+        break;
+    case MemoryType::VTCM:
+        out << "VTCM";
+        break;
+    }
+    return out;
+}
+
 namespace Internal {
 
 void IRPrinter::test() {
@@ -113,7 +137,7 @@ void IRPrinter::test() {
                                                          {string("y"), y, 3}, Call::Extern));
     Stmt block = Block::make(assertion, pipeline);
     Stmt let_stmt = LetStmt::make("y", 17, block);
-    Stmt allocate = Allocate::make("buf", f32, {1023}, const_true(), let_stmt);
+    Stmt allocate = Allocate::make("buf", f32, MemoryType::Auto, {1023}, const_true(), let_stmt);
 
     ostringstream source;
     source << allocate;
@@ -158,6 +182,12 @@ ostream &operator<<(ostream &out, const ForType &type) {
     case ForType::GPUThread:
         out << "gpu_thread";
         break;
+    case ForType::GPULane:
+        out << "gpu_lane";
+        break;
+    case ForType::Extern:
+        out << "extern";
+        break;
     }
     return out;
 }
@@ -556,6 +586,9 @@ void IRPrinter::visit(const Allocate *op) {
         print(op->extents[i]);
     }
     stream << "]";
+    if (op->memory_type != MemoryType::Auto) {
+        stream << " in " << op->memory_type;
+    }
     if (!is_one(op->condition)) {
         stream << " if ";
         print(op->condition);
@@ -644,4 +677,14 @@ void IRPrinter::visit(const Evaluate *op) {
     stream << "\n";
 }
 
+void IRPrinter::visit(const Atomic *op) {
+    do_indent();
+    stream << "atomic " << op->name << " {\n";
+    indent += 2;
+    print(op->body);
+    indent -= 2;
+    do_indent();
+    stream << "}\n";
+}
+
 }}
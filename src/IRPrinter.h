@@ -36,6 +36,9 @@ EXPORT std::ostream &operator<<(std::ostream &stream, const Module &);
 /** Emit a halide device api type in a human readable form */
 EXPORT std::ostream &operator<<(std::ostream &stream, const DeviceAPI &);
 
+/** Emit a halide memory type in a human readable form */
+EXPORT std::ostream &operator<<(std::ostream &stream, const MemoryType &);
+
 namespace Internal {
 
 /** Emit a halide statement on an output stream (such as std::cout) in
@@ -115,6 +118,7 @@ protected:
     void visit(const Block *);
     void visit(const IfThenElse *);
     void visit(const Evaluate *);
+    void visit(const Atomic *);
 };
 }
 }
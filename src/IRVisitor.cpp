@@ -223,6 +223,10 @@ void IRVisitor::visit(const Evaluate *op) {
     op->value.accept(this);
 }
 
+void IRVisitor::visit(const Atomic *op) {
+    op->body.accept(this);
+}
+
 void IRGraphVisitor::include(const Expr &e) {
     if (visited.count(e.get())) {
         return;
@@ -445,5 +449,9 @@ void IRGraphVisitor::visit(const Evaluate *op) {
     include(op->value);
 }
 
+void IRGraphVisitor::visit(const Atomic *op) {
+    include(op->body);
+}
+
 }
 }
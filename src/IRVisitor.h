@@ -62,6 +62,7 @@ public:
     EXPORT virtual void visit(const Block *);
     EXPORT virtual void visit(const IfThenElse *);
     EXPORT virtual void visit(const Evaluate *);
+    EXPORT virtual void visit(const Atomic *);
 };
 
 /** A base class for algorithms that walk recursively over the IR
@@ -126,6 +127,7 @@ public:
     EXPORT virtual void visit(const Block *);
     EXPORT virtual void visit(const IfThenElse *);
     EXPORT virtual void visit(const Evaluate *);
+    EXPORT virtual void visit(const Atomic *);
     // @}
 };
 
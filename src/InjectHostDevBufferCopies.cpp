@@ -4,6 +4,8 @@
 #include "IRPrinter.h"
 #include "CodeGen_GPU_Dev.h"
 #include "IROperator.h"
+#include "Bounds.h"
+#include "Simplify.h"
 #include <map>
 
 namespace Halide {
@@ -125,6 +127,109 @@ public:
     FindBuffersToTrack(const Target &t) : target(t), device_api(DeviceAPI::Host) {}
 };
 
+// Find the range of flattened indices of a buffer loaded by device
+// code within a statement, so that only that range of an input needs
+// to be copied to the device. The range is everything if it can't be
+// bounded, or if the buffer is used on the device other than by
+// loads, and empty if the device doesn't load the buffer at all. If
+// stores is set, it's the range stored to instead, and if on_host is
+// set, it's the host code's accesses that count rather than the
+// device code's.
+class FindAccessRange : public IRVisitor {
+    const string &buf;
+    const Target &target;
+    DeviceAPI device_api;
+    Scope<Interval> scope;
+    bool unbounded;
+    bool stores, on_host;
+
+    // Do accesses from the code being visited count?
+    bool counts() const {
+        return on_host == (device_api == DeviceAPI::Host);
+    }
+
+    void add_index(Expr index) {
+        Interval i = bounds_of_expr_in_scope(index, scope);
+        if (!i.is_bounded()) {
+            unbounded = true;
+        } else if (range.is_empty()) {
+            range = i;
+        } else {
+            range = Interval::make_union(range, i);
+        }
+    }
+
+    using IRVisitor::visit;
+
+    void visit(const For *op) {
+        op->min.accept(this);
+        op->extent.accept(this);
+        Interval min_bounds = bounds_of_expr_in_scope(op->min, scope);
+        Interval max_bounds = bounds_of_expr_in_scope(op->min + op->extent - 1, scope);
+        scope.push(op->name, Interval(min_bounds.min, max_bounds.max));
+        DeviceAPI old_device_api = device_api;
+        if (different_device_api(device_api, op->device_api, target)) {
+            device_api = fixup_device_api(op->device_api, target);
+            if (device_api == DeviceAPI::None) {
+                device_api = old_device_api;
+            }
+        }
+        op->body.accept(this);
+        device_api = old_device_api;
+        scope.pop(op->name);
+    }
+
+    void visit(const LetStmt *op) {
+        op->value.accept(this);
+        scope.push(op->name, bounds_of_expr_in_scope(op->value, scope));
+        op->body.accept(this);
+        scope.pop(op->name);
+    }
+
+    void visit(const Let *op) {
+        op->value.accept(this);
+        scope.push(op->name, bounds_of_expr_in_scope(op->value, scope));
+        op->body.accept(this);
+        scope.pop(op->name);
+    }
+
+    void visit(const Load *op) {
+        IRVisitor::visit(op);
+        if (op->name == buf && !stores && counts()) {
+            add_index(op->index);
+        }
+    }
+
+    void visit(const Store *op) {
+        IRVisitor::visit(op);
+        if (op->name == buf && stores && counts()) {
+            add_index(op->index);
+        }
+    }
+
+    void visit(const Variable *op) {
+        if (counts() &&
+            (op->name == buf || op->name == buf + ".buffer")) {
+            unbounded = true;
+        }
+    }
+
+public:
+    Interval range;
+
+    FindAccessRange(const string &b, const Target &t, Stmt s, bool stores = false, bool on_host = false) :
+        buf(b), target(t), device_api(DeviceAPI::Host), unbounded(false),
+        stores(stores), on_host(on_host), range(Interval::nothing()) {
+        s.accept(this);
+        if (unbounded) {
+            range = Interval::everything();
+        } else if (!range.is_empty()) {
+            range.min = simplify(range.min);
+            range.max = simplify(range.max);
+        }
+    }
+};
+
 class InjectBufferCopies : public IRMutator {
     using IRMutator::visit;
 
@@ -288,6 +393,12 @@ class InjectBufferCopies : public IRMutator {
             bool device_read = non_host_devices_reading_count > 0;
             bool device_wrote = non_host_devices_writing_count > 0;
 
+            // Whether the buffer is moving from one device to another.
+            bool device_move = (buf.dev_current &&
+                                buf.current_device != DeviceAPI::Host &&
+                                buf.current_device != touching_device &&
+                                !host_read && !host_wrote);
+
             // Update whether there needs to be a host or dev-side allocation
             buf.host_touched = host_wrote || host_read || buf.host_touched;
             if (!buf.dev_touched && (device_wrote || device_read)) {
@@ -356,7 +467,32 @@ class InjectBufferCopies : public IRMutator {
 
             if (direction != NoCopy && touching_device != DeviceAPI::Host) {
                 internal_assert(s.defined());
-                s = Block::make(make_buffer_copy(direction, i.first, touching_device), s);
+                Stmt copy;
+                if (direction == ToDevice && device_move) {
+                    // Let the runtime move the data between the devices
+                    // by the cheapest path it has.
+                    debug(4) << "Moving " << i.first << " to device " << static_cast<int>(touching_device) << "\n";
+                    copy = call_extern_and_assert("halide_buffer_copy",
+                                                  {buffer, make_device_interface_call(touching_device), buffer});
+                } else if (direction == ToDevice && !buf.internal && !device_wrote && !host_wrote) {
+                    // An input that the device only reads need only be
+                    // copied over the range the device loads. Inputs are
+                    // copied at every scope that reads them, and the
+                    // runtime tracks which ranges are already on the
+                    // device.
+                    Interval range = FindAccessRange(i.first, target, s).range;
+                    if (range.is_bounded()) {
+                        debug(4) << "Copying range [" << range.min << ", " << range.max
+                                 << "] of " << i.first << " to device\n";
+                        copy = call_extern_and_assert("halide_copy_to_device_region",
+                                                      {buffer, make_device_interface_call(touching_device),
+                                                       cast<int64_t>(range.min), cast<int64_t>(range.max)});
+                    }
+                }
+                if (!copy.defined()) {
+                    copy = make_buffer_copy(direction, i.first, touching_device);
+                }
+                s = Block::make(copy, s);
             }
 
             buf.on_single_device =
@@ -537,7 +673,7 @@ class InjectBufferCopies : public IRMutator {
         // If this buffer is only ever touched on gpu, nuke the host-side allocation.
         if (!buf_info.host_touched) {
             debug(4) << "Eliding host alloc for " << op->name << "\n";
-            stmt = Allocate::make(op->name, op->type, op->extents, const_false(), op->body);
+            stmt = Allocate::make(op->name, op->type, op->memory_type, op->extents, const_false(), op->body);
         } else if (buf_info.on_single_device &&
                    buf_info.dev_touched) {
             debug(4) << "Making combined host/device alloc for " << op->name << "\n";
@@ -565,7 +701,7 @@ class InjectBufferCopies : public IRMutator {
             // would be possible to keep a map between host pointers
             // and dev ones to facilitate this, but it seems better to
             // just register a destructor with the buffer creation.)
-            inner_body = Allocate::make(op->name, op->type, op->extents, op->condition, inner_body,
+            inner_body = Allocate::make(op->name, op->type, op->memory_type, op->extents, op->condition, inner_body,
                                         Call::make(Handle(), Call::buffer_get_host,
                                                    { Variable::make(type_of<struct buffer_t *>(), op->name + ".buffer") },
                                                    Call::Extern),
@@ -694,6 +830,83 @@ class InjectBufferCopies : public IRMutator {
         }
     }
 
+    // If a Block is a GPU loop followed by the host loop it was split
+    // with by Func::gpu_host_split, return the GPU loop.
+    const For *split_device_loop(const Block *op) {
+        Stmt first = op->first;
+        if (const IfThenElse *i = first.as<IfThenElse>()) {
+            if (!i->else_case.defined()) {
+                first = i->then_case;
+            }
+        }
+        const For *device_loop = first.as<For>();
+        const For *host_loop = op->rest.as<For>();
+        if (device_loop && host_loop &&
+            device_loop->name == host_loop->name &&
+            host_loop->device_api == DeviceAPI::Host &&
+            different_device_api(DeviceAPI::Host, device_loop->device_api, target)) {
+            return device_loop;
+        }
+        return nullptr;
+    }
+
+    // The host loop of a split made by Func::gpu_host_split runs
+    // while the GPU loop before it may still be running, and writes
+    // the parts of buffers the GPU loop doesn't. Rather than copying
+    // the GPU's results to the host first, merge the host's results
+    // into the device allocation afterwards. This works on ranges of
+    // flattened indices, so if the range the host writes might overlap
+    // the range the GPU writes, the GPU's results are brought back to
+    // the host first after all.
+    Stmt merge_split_host_writes(Stmt s, const For *device_loop, Stmt device_stmt) {
+        DeviceAPI device = fixup_device_api(device_loop->device_api, target);
+        for (pair<const string, BufferInfo> &i : state) {
+            BufferInfo &buf = i.second;
+            if (!buf.devices_writing.count(DeviceAPI::Host) ||
+                buf.devices_reading.count(DeviceAPI::Host)) {
+                continue;
+            }
+            user_assert(!buf.devices_writing.count(device))
+                << "Buffer " << i.first << " is written by a loop split with gpu_host_split, "
+                << "which is only supported for outputs and Funcs computed at root.\n";
+            if (buf.loop_level != loop_level ||
+                buf.devices_writing.size() != 1 || buf.host_current ||
+                !buf.dev_current || buf.current_device != device) {
+                continue;
+            }
+            Interval host_range = FindAccessRange(i.first, target, s, true, true).range;
+            if (!host_range.is_bounded()) {
+                continue;
+            }
+            Interval device_range = FindAccessRange(i.first, target, device_stmt, true).range;
+
+            debug(4) << "Merging range [" << host_range.min << ", " << host_range.max
+                     << "] of " << i.first << " written on the host into the device\n";
+            buf.devices_writing.erase(DeviceAPI::Host);
+            buf.host_touched = true;
+            Expr buffer = Variable::make(type_of<struct buffer_t *>(), i.first + ".buffer");
+            Stmt merge = call_extern_and_assert("halide_merge_host_region",
+                                                {buffer, make_device_interface_call(device),
+                                                 cast<int64_t>(host_range.min), cast<int64_t>(host_range.max)});
+            s = Block::make(s, merge);
+
+            Expr overlap = const_true();
+            if (device_range.is_empty()) {
+                overlap = const_false();
+            } else if (device_range.is_bounded()) {
+                overlap = (host_range.min <= host_range.max &&
+                           device_range.min <= device_range.max &&
+                           host_range.min <= device_range.max &&
+                           device_range.min <= host_range.max);
+                overlap = simplify(overlap);
+            }
+            if (!is_zero(overlap)) {
+                s = Block::make(IfThenElse::make(overlap, make_buffer_copy(ToHost, i.first, device)), s);
+            }
+        }
+        return s;
+    }
+
     void visit(const Block *op) {
         if (device_api != DeviceAPI::Host) {
             IRMutator::visit(op);
@@ -706,6 +919,9 @@ class InjectBufferCopies : public IRMutator {
         Stmt rest = op->rest;
         if (rest.defined()) {
             rest = mutate(rest);
+            if (const For *device_loop = split_device_loop(op)) {
+                rest = merge_split_host_writes(rest, device_loop, op->first);
+            }
             rest = do_copies(rest);
         }
 
@@ -143,7 +143,9 @@ private:
 
     void visit(const For *loop) {
         bool old_kernel_loop = inside_kernel_loop;
-        if ((loop->for_type == ForType::GPUBlock || loop->for_type == ForType::GPUThread) &&
+        if ((loop->for_type == ForType::GPUBlock ||
+             loop->for_type == ForType::GPUThread ||
+             loop->for_type == ForType::GPULane) &&
             loop->device_api == DeviceAPI::GLSL) {
             inside_kernel_loop = true;
         }
@@ -6,10 +6,13 @@
 #include "LLVM_Headers.h"
 #include "Error.h"
 
+#include <atomic>
+#include <mutex>
 #include <string>
 #include <iostream>
 #include <sstream>
 #include <stdio.h>
+#include <thread>
 
 // defines backtrace, which gets the call stack as instruction pointers
 #include <execinfo.h>
@@ -2176,12 +2179,154 @@ private:
 };
 
 namespace {
-DebugSections *debug_sections = nullptr;
+
+// The debug info is loaded on first use rather than when the first
+// compilation unit including Halide.h is initialized, because parsing
+// it can take seconds for a large binary. The compilation units to
+// test and any heap objects registered before then are kept until it
+// is.
+enum class Mode {
+    Lazy,        // Load on the first name or source location asked for.
+    Background,  // Start loading on a thread at static initialization.
+    ErrorsOnly,  // Only source locations for error messages; no names.
+    Off
+};
+
+struct CompilationUnit {
+    bool (*test)(bool (*)(const void *, const std::string &));
+    bool (*test_a)(const void *, const std::string &);
+    void (*calib)();
+};
+
+struct HeapObject {
+    size_t size;
+    const void *helper;
+};
+
+// Compilation units run test_compilation_unit at static
+// initialization, possibly before this one, so all of this is made on
+// first use and never destroyed (a background load may still be
+// running at exit).
+struct LoadState {
+    std::mutex mutex;
+    DebugSections *debug_sections = nullptr;
+    bool loaded = false;
+    vector<CompilationUnit> pending_units;
+    map<const void *, HeapObject> pending_heap_objects;
+};
+
+LoadState &load_state() {
+    static LoadState *state = new LoadState;
+    return *state;
+}
+
+// Set while this thread is loading the debug info and testing the
+// compilation units, which calls back into the functions below.
+thread_local bool loading = false;
+
+std::atomic<int> &mode_setting() {
+    static std::atomic<int> m(-1);
+    return m;
+}
+
+Mode mode() {
+    int m = mode_setting();
+    if (m < 0) {
+        size_t defined = 0;
+        std::string env = get_env_variable("HL_INTROSPECTION", defined);
+        if (env == "0" || env == "off") {
+            m = (int)Mode::Off;
+        } else if (env == "background") {
+            m = (int)Mode::Background;
+        } else if (env == "errors") {
+            m = (int)Mode::ErrorsOnly;
+        } else {
+            m = (int)Mode::Lazy;
+        }
+        mode_setting() = m;
+    }
+    return (Mode)m;
+}
+
+bool saves_frame_pointer(void *fn) {
+    // On x86-64, if we save the frame pointer, the first two instructions should be pushing the stack pointer and the frame pointer:
+    const uint8_t *ptr = (const uint8_t *)(fn);
+    return ptr[0] == 0x55; // push %rbp
+}
+
+void test_unit(DebugSections *debug_sections, const CompilationUnit &unit) {
+    if (!saves_frame_pointer(reinterpret_bits<void *>(&test_unit)) ||
+        !saves_frame_pointer(reinterpret_bits<void *>(unit.test))) {
+        // Make sure libHalide and the test compilation unit both save the frame pointer
+        debug_sections->working = false;
+        debug(5) << "Failed because frame pointer not saved\n";
+    } else if (debug_sections->working) {
+        debug_sections->calibrate_pc_offset(unit.calib);
+        if (!debug_sections->working) {
+            debug(5) << "Failed because offset calibration failed\n";
+            return;
+        }
+
+        debug_sections->working = (*unit.test)(unit.test_a);
+        if (!debug_sections->working) {
+            debug(5) << "Failed because test routine failed\n";
+            return;
+        }
+
+        debug(5) << "Test passed\n";
+    }
+}
+
+// Load the debug info if that hasn't happened yet, and test the
+// compilation units seen since. Must hold the mutex.
+void load_locked(LoadState &state) {
+    loading = true;
+    if (!state.debug_sections) {
+        char path[2048];
+        get_program_name(path, sizeof(path));
+        state.debug_sections = new DebugSections(path);
+    }
+    DebugSections *debug_sections = state.debug_sections;
+    for (const CompilationUnit &unit : state.pending_units) {
+        test_unit(debug_sections, unit);
+    }
+    state.pending_units.clear();
+    if (!state.loaded && debug_sections->working) {
+        for (const auto &obj : state.pending_heap_objects) {
+            debug_sections->register_heap_object(obj.first, obj.second.size, obj.second.helper);
+        }
+    }
+    state.pending_heap_objects.clear();
+    state.loaded = true;
+    loading = false;
+}
+
+// The loaded debug info, if it works.
+DebugSections *get_debug_sections() {
+    LoadState &state = load_state();
+    DebugSections *debug_sections = nullptr;
+    if (loading) {
+        debug_sections = state.debug_sections;
+    } else if (mode() != Mode::Off) {
+        std::lock_guard<std::mutex> lock(state.mutex);
+        if (!state.loaded || !state.pending_units.empty()) {
+            load_locked(state);
+        }
+        debug_sections = state.debug_sections;
+    }
+    return (debug_sections && debug_sections->working) ? debug_sections : nullptr;
+}
+
+}  // namespace
+
+void set_enabled(bool enabled) {
+    mode_setting() = (int)(enabled ? Mode::Lazy : Mode::Off);
 }
 
 std::string get_variable_name(const void *var, const std::string &expected_type) {
+    if (!loading && mode() == Mode::ErrorsOnly) return "";
+    DebugSections *debug_sections = get_debug_sections();
     if (!debug_sections) return "";
-    if (!debug_sections->working) return "";
     std::string name = debug_sections->get_stack_variable_name(var, expected_type);
     if (name.empty()) {
         // Maybe it's a member of a heap object.
@@ -2196,31 +2341,33 @@ std::string get_variable_name(const void *var, const std::string &expected_type)
 }
 
 std::string get_source_location() {
+    DebugSections *debug_sections = get_debug_sections();
     if (!debug_sections) return "";
-    if (!debug_sections->working) return "";
     return debug_sections->get_source_location();
 }
 
 void register_heap_object(const void *obj, size_t size, const void *helper) {
-    if (!debug_sections) return;
-    if (!debug_sections->working) return;
-    if (!helper) return;
-    debug_sections->register_heap_object(obj, size, helper);
+    if (!helper || loading || mode() == Mode::Off) return;
+    LoadState &state = load_state();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    if (!state.loaded) {
+        state.pending_heap_objects[obj] = {size, helper};
+    } else if (state.debug_sections->working) {
+        state.debug_sections->register_heap_object(obj, size, helper);
+    }
 }
 
 void deregister_heap_object(const void *obj, size_t size) {
-    if (!debug_sections) return;
-    if (!debug_sections->working) return;
-    debug_sections->deregister_heap_object(obj, size);
-}
-
-bool saves_frame_pointer(void *fn) {
-    // On x86-64, if we save the frame pointer, the first two instructions should be pushing the stack pointer and the frame pointer:
-    const uint8_t *ptr = (const uint8_t *)(fn);
-    return ptr[0] == 0x55; // push %rbp
+    if (loading || mode() == Mode::Off) return;
+    LoadState &state = load_state();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    if (!state.loaded) {
+        state.pending_heap_objects.erase(obj);
+    } else if (state.debug_sections->working) {
+        state.debug_sections->deregister_heap_object(obj, size);
+    }
 }
 
-
 void test_compilation_unit(bool (*test)(bool (*)(const void *, const std::string &)),
                            bool (*test_a)(const void *, const std::string &),
                            void (*calib)()) {
@@ -2233,36 +2380,28 @@ void test_compilation_unit(bool (*test)(bool (*)(const void *, const std::string
         return;
     }
 
-    debug(5) << "Testing compilation unit with offset_marker at " << reinterpret_bits<void *>(calib) << "\n";
-
-    if (!debug_sections) {
-        char path[2048];
-        get_program_name(path, sizeof(path));
-        debug_sections = new DebugSections(path);
+    Mode m = mode();
+    if (m == Mode::Off) {
+        return;
     }
 
-    if (!saves_frame_pointer(reinterpret_bits<void *>(&test_compilation_unit)) ||
-        !saves_frame_pointer(reinterpret_bits<void *>(test))) {
-        // Make sure libHalide and the test compilation unit both save the frame pointer
-        debug_sections->working = false;
-        debug(5) << "Failed because frame pointer not saved\n";
-    } else if (debug_sections->working) {
-        debug_sections->calibrate_pc_offset(calib);
-        if (!debug_sections->working) {
-            debug(5) << "Failed because offset calibration failed\n";
-            return;
-        }
-
-        debug_sections->working = (*test)(test_a);
-        if (!debug_sections->working) {
-            debug(5) << "Failed because test routine failed\n";
-            return;
-        }
+    debug(5) << "Queueing test of compilation unit with offset_marker at " << reinterpret_bits<void *>(calib) << "\n";
 
-        debug(5) << "Test passed\n";
+    LoadState &state = load_state();
+    bool start_loading = false;
+    {
+        std::lock_guard<std::mutex> lock(state.mutex);
+        start_loading = (m == Mode::Background && !state.loaded && state.pending_units.empty());
+        state.pending_units.push_back({test, test_a, calib});
     }
 
-    //debug_sections->dump();
+    if (start_loading) {
+        std::thread([]() {
+            LoadState &state = load_state();
+            std::lock_guard<std::mutex> lock(state.mutex);
+            load_locked(state);
+        }).detach();
+    }
 
     #endif
 }
@@ -2291,6 +2430,9 @@ void register_heap_object(const void *obj, size_t size, const void *helper) {
 void deregister_heap_object(const void *obj, size_t size) {
 }
 
+void set_enabled(bool enabled) {
+}
+
 void test_compilation_unit(bool (*test)(bool (*)(const void *, const std::string &)),
                            bool (*test_a)(const void *, const std::string &),
                            void (*calib)()) {
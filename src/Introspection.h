@@ -46,9 +46,18 @@ const void *get_introspection_helper() {
  * the Halide namespace. */
 EXPORT std::string get_source_location();
 
+/** Turn introspection on or off. When off, names and source locations
+ * are never looked up and the debug info is never loaded, as when
+ * HL_INTROSPECTION is set to 0. Other values of HL_INTROSPECTION are
+ * "errors", to only look up source locations for error messages, and
+ * "background", to start loading the debug info on a thread at static
+ * initialization instead of on first use. */
+EXPORT void set_enabled(bool enabled);
+
 // This gets called automatically by anyone who includes Halide.h by
-// the code below. It tests if this functionality works for the given
-// compilation unit, and disables it if not.
+// the code below. It queues a test of whether this functionality
+// works for the given compilation unit, run when the debug info is
+// loaded, which disables it if not.
 EXPORT void test_compilation_unit(bool (*test)(bool (*)(const void *, const std::string &)),
                                   bool (*test_a)(const void *, const std::string &),
                                   void (*calib)());
@@ -15,9 +15,18 @@
 namespace Halide {
 namespace Internal {
 
-/** A class representing a reference count to be used with IntrusivePtr */
+/** A class representing a reference count to be used with IntrusivePtr.
+ * Counts are atomic, unless HALIDE_SINGLE_THREADED_REFCOUNT is
+ * defined, which makes them cheaper but means that no reference
+ * counted object (including any Expr, Stmt or Func) may be shared
+ * between threads. It must be defined the same way for libHalide and
+ * for everything that includes Halide.h. */
 class RefCount {
+#ifdef HALIDE_SINGLE_THREADED_REFCOUNT
+    int count;
+#else
     std::atomic<int> count;
+#endif
 public:
     RefCount() : count(0) {}
     int increment() {return ++count;} // Increment and return new value
@@ -0,0 +1,330 @@
+#include <iostream>
+
+#include "InvariantDivision.h"
+#include "CodeGen_GPU_Dev.h"
+#include "ExprUsesVar.h"
+#include "IREquality.h"
+#include "IRMutator.h"
+#include "IROperator.h"
+#include "IRVisitor.h"
+#include "Scope.h"
+#include "Simplify.h"
+
+namespace Halide {
+namespace Internal {
+
+using std::string;
+using std::vector;
+
+namespace {
+
+/** Is an Expr pure integer arithmetic on variables and constants, and
+ * so safe to evaluate outside of the loops that use it? */
+bool is_pure_arithmetic(Expr e) {
+    if (e.as<Variable>() || is_const(e)) {
+        return true;
+    } else if (const Add *op = e.as<Add>()) {
+        return is_pure_arithmetic(op->a) && is_pure_arithmetic(op->b);
+    } else if (const Sub *op = e.as<Sub>()) {
+        return is_pure_arithmetic(op->a) && is_pure_arithmetic(op->b);
+    } else if (const Mul *op = e.as<Mul>()) {
+        return is_pure_arithmetic(op->a) && is_pure_arithmetic(op->b);
+    } else if (const Min *op = e.as<Min>()) {
+        return is_pure_arithmetic(op->a) && is_pure_arithmetic(op->b);
+    } else if (const Max *op = e.as<Max>()) {
+        return is_pure_arithmetic(op->a) && is_pure_arithmetic(op->b);
+    } else if (const Cast *op = e.as<Cast>()) {
+        return (op->type.is_int() || op->type.is_uint()) && is_pure_arithmetic(op->value);
+    } else {
+        return false;
+    }
+}
+
+/** A runtime divisor, and the names of the lets holding the
+ * multiplier and shifts that divide by it. The numbers are those of
+ * the round-up method for unsigned 32-bit division (see Granlund and
+ * Montgomery, "Division by invariant integers using
+ * multiplication"). For a divisor d, let l = ceil(log2(d)) and m =
+ * floor(2^32 * (2^l - d) / d) + 1. Then with t = mulhi(m, n), n / d
+ * = (t + ((n - t) >> min(l, 1))) >> max(l - 1, 0). Signed division
+ * divides the magnitudes, and fixes up the signs so that it rounds
+ * the way Halide division does. */
+struct Divisor {
+    // The scalar divisor, widened to 32 bits.
+    Expr value;
+    string name;
+
+    string magnitude() const {return name + ".magnitude";}
+    string log2() const {return name + ".log2";}
+    string multiplier() const {return name + ".multiplier";}
+    string shift1() const {return name + ".shift1";}
+    string shift2() const {return name + ".shift2";}
+    string negative() const {return name + ".negative";}
+
+    /** Wrap a Stmt in the lets that compute the multiplier and shifts. */
+    Stmt define(Stmt s) const {
+        Type u32 = UInt(32), u64 = UInt(64);
+        Expr d = Variable::make(u32, magnitude());
+        Expr l = Variable::make(u32, log2());
+
+        if (value.type().is_int()) {
+            s = LetStmt::make(negative(), value < 0, s);
+        }
+        s = LetStmt::make(shift2(), max(l, make_one(u32)) - make_one(u32), s);
+        s = LetStmt::make(shift1(), min(l, make_one(u32)), s);
+        Expr m = ((cast(u64, make_one(u32)) << cast(u64, l)) - cast(u64, d)) << make_const(u64, 32);
+        m = cast(u32, m / cast(u64, d) + make_one(u64));
+        s = LetStmt::make(multiplier(), m, s);
+        // ceil(log2(d)) is 32 - clz(d - 1), except that clz(0) isn't
+        // defined. Or-ing in a one doesn't change the answer for d > 2.
+        Expr log = select(d == make_one(u32), make_zero(u32),
+                          make_const(u32, 32) - count_leading_zeros((d - make_one(u32)) | make_one(u32)));
+        s = LetStmt::make(log2(), log, s);
+        Expr mag;
+        if (value.type().is_int()) {
+            mag = select(value < 0, make_zero(u32) - cast(u32, value), cast(u32, value));
+        } else {
+            mag = value;
+        }
+        s = LetStmt::make(magnitude(), max(mag, make_one(u32)), s);
+        return s;
+    }
+
+    /** Divide the 32-bit unsigned numerator by the magnitude of the
+     * divisor. */
+    Expr divide_magnitude(Expr n) const {
+        int lanes = n.type().lanes();
+        Type u32 = UInt(32, lanes), u64 = UInt(64, lanes);
+        auto var = [&](const string &name) {
+            Expr v = Variable::make(UInt(32), name);
+            return lanes > 1 ? Broadcast::make(v, lanes) : v;
+        };
+        Expr t = cast(u32, (cast(u64, n) * cast(u64, var(multiplier()))) >> make_const(u64, 32));
+        return (t + ((n - t) >> var(shift1()))) >> var(shift2());
+    }
+
+    /** Divide a 32-bit numerator by the divisor. */
+    Expr divide(Expr n) const {
+        int lanes = n.type().lanes();
+        if (n.type().is_uint()) {
+            return divide_magnitude(n);
+        }
+        // Round down by dividing the bitwise complement of negative
+        // numerators and complementing the result, and then negate
+        // for negative divisors.
+        Expr sign = n >> make_const(n.type(), 31);
+        Expr q = cast(n.type(), divide_magnitude(cast(UInt(32, lanes), n ^ sign))) ^ sign;
+        Expr negative = Variable::make(Bool(), this->negative());
+        if (lanes > 1) {
+            negative = Broadcast::make(negative, lanes);
+        }
+        return select(negative, make_zero(n.type()) - q, q);
+    }
+};
+
+/** Replace divisions in the body of a single loop by divisors that
+ * are invariant in that loop. */
+class ReplaceInvariantDivision : public IRMutator {
+    // Variables defined inside the loop, including the loop variable.
+    Scope<int> inner;
+
+    using IRMutator::visit;
+
+    /** If the divisor of an integer Div or Mod is a runtime value
+     * invariant in the loop, return its entry in divisors. */
+    const Divisor *invariant_divisor(Type t, Expr b) {
+        if (!(t.is_int() || t.is_uint()) || t.bits() > 32 || t.bits() < 8) {
+            return nullptr;
+        }
+        if (const Broadcast *bc = b.as<Broadcast>()) {
+            b = bc->value;
+        }
+        if (!b.type().is_scalar() || is_const(b) ||
+            !is_pure_arithmetic(b) || expr_uses_vars(b, inner)) {
+            return nullptr;
+        }
+
+        Expr value = cast(t.with_bits(32).element_of(), b);
+        for (const Divisor &d : divisors) {
+            if (equal(d.value, value)) {
+                return &d;
+            }
+        }
+        divisors.push_back({value, unique_name('d')});
+        return &divisors.back();
+    }
+
+    void visit(const Div *op) {
+        Expr a = mutate(op->a);
+        const Divisor *d = invariant_divisor(op->type, op->b);
+        if (!d) {
+            Expr b = mutate(op->b);
+            expr = (a.same_as(op->a) && b.same_as(op->b)) ? Expr(op) : Div::make(a, b);
+            return;
+        }
+        Type wide = op->type.with_bits(32);
+        expr = cast(op->type, d->divide(cast(wide, a)));
+    }
+
+    void visit(const Mod *op) {
+        Expr a = mutate(op->a);
+        const Divisor *d = invariant_divisor(op->type, op->b);
+        if (!d) {
+            Expr b = mutate(op->b);
+            expr = (a.same_as(op->a) && b.same_as(op->b)) ? Expr(op) : Mod::make(a, b);
+            return;
+        }
+        Type wide = op->type.with_bits(32);
+        a = cast(wide, a);
+        Expr b = cast(wide, op->b);
+        expr = cast(op->type, a - d->divide(a) * b);
+    }
+
+    void visit(const Let *op) {
+        inner.push(op->name, 0);
+        IRMutator::visit(op);
+        inner.pop(op->name);
+    }
+
+    void visit(const LetStmt *op) {
+        inner.push(op->name, 0);
+        IRMutator::visit(op);
+        inner.pop(op->name);
+    }
+
+    void visit(const For *op) {
+        bool offloaded = (op->device_api != DeviceAPI::None &&
+                          op->device_api != DeviceAPI::Host);
+        if (offloaded || CodeGen_GPU_Dev::is_gpu_var(op->name)) {
+            stmt = op;
+            return;
+        }
+        inner.push(op->name, 0);
+        IRMutator::visit(op);
+        inner.pop(op->name);
+    }
+
+public:
+    ReplaceInvariantDivision(const string &var) {
+        inner.push(var, 0);
+    }
+
+    vector<Divisor> divisors;
+};
+
+class DivideByInvariants : public IRMutator {
+    using IRMutator::visit;
+
+    void visit(const For *op) {
+        bool offloaded = (op->device_api != DeviceAPI::None &&
+                          op->device_api != DeviceAPI::Host);
+        if (offloaded || CodeGen_GPU_Dev::is_gpu_var(op->name)) {
+            stmt = op;
+            return;
+        }
+
+        Stmt body = op->body;
+        vector<Divisor> divisors;
+        if (!is_one(op->extent)) {
+            ReplaceInvariantDivision replace(op->name);
+            body = replace.mutate(body);
+            divisors.swap(replace.divisors);
+        }
+        // Divisors that vary in this loop may be invariant in inner ones.
+        body = mutate(body);
+
+        if (body.same_as(op->body)) {
+            stmt = op;
+        } else {
+            stmt = For::make(op->name, op->min, op->extent, op->for_type, op->device_api, body);
+        }
+
+        for (size_t i = divisors.size(); i > 0; i--) {
+            stmt = divisors[i-1].define(stmt);
+        }
+    }
+};
+
+}
+
+Stmt divide_by_invariants(Stmt s) {
+    return DivideByInvariants().mutate(s);
+}
+
+namespace {
+
+class CountDivisions : public IRVisitor {
+    using IRVisitor::visit;
+
+    void visit(const Div *op) {
+        count++;
+        IRVisitor::visit(op);
+    }
+
+    void visit(const Mod *op) {
+        count++;
+        IRVisitor::visit(op);
+    }
+
+public:
+    int count = 0;
+};
+
+void check_divisions(Stmt s, int expected) {
+    CountDivisions c;
+    s.accept(&c);
+    if (c.count != expected) {
+        internal_error
+            << "After dividing by invariants:\n" << s << "\n"
+            << "Expected " << expected << " divisions, found " << c.count << "\n";
+    }
+}
+
+}
+
+void invariant_division_test() {
+    Expr x = Variable::make(Int(32), "x");
+    Expr y = Variable::make(Int(32), "y");
+    Expr p = Variable::make(Int(32), "p");
+    Expr q = Variable::make(UInt(16), "q");
+
+    auto store = [](Expr e) {
+        return Store::make("buf", e, 0, Parameter());
+    };
+
+    // Division and modulus by p in a loop over x becomes a multiply
+    // and shifts, sharing the multiplier. Only the computation of the
+    // multiplier, outside the loop, divides.
+    Stmt s = For::make("x", 0, 100, ForType::Serial, DeviceAPI::None,
+                       Block::make(store(x / p), store(x % p + (x / q) + x / 7)));
+    s = divide_by_invariants(s);
+    const LetStmt *let = s.as<LetStmt>();
+    internal_assert(let) << "Divisor was not hoisted out of loop:\n" << s << "\n";
+    // One division for each of the two divisors, and the constant one.
+    check_divisions(s, 3);
+
+    // A divisor that depends on an outer loop is hoisted only as far
+    // as the inner loop.
+    s = For::make("y", 0, 10, ForType::Serial, DeviceAPI::None,
+                  For::make("x", 0, 100, ForType::Serial, DeviceAPI::None,
+                            store(x / (p + y))));
+    s = divide_by_invariants(s);
+    const For *outer = s.as<For>();
+    internal_assert(outer && outer->body.as<LetStmt>())
+        << "Divisor was not hoisted to the right loop:\n" << s << "\n";
+    check_divisions(s, 1);
+
+    // Divisors that vary within the loop, or that aren't pure
+    // arithmetic, are left alone.
+    Expr load = Load::make(Int(32), "buf", 0, Buffer<>(), Parameter());
+    s = For::make("x", 0, 100, ForType::Serial, DeviceAPI::None,
+                  Block::make(store(y / (x + p)), store(y / load)));
+    Stmt result = divide_by_invariants(s);
+    internal_assert(result.same_as(s))
+        << "Division should have been left alone:\n" << result << "\n";
+
+    std::cout << "Invariant division test passed\n";
+}
+
+}
+}
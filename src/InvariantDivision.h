@@ -0,0 +1,29 @@
+#ifndef HALIDE_INVARIANT_DIVISION_H
+#define HALIDE_INVARIANT_DIVISION_H
+
+/** \file
+ * Defines a lowering pass that replaces integer division by
+ * loop-invariant runtime values with multiplies and shifts.
+ */
+
+#include "Expr.h"
+
+namespace Halide {
+namespace Internal {
+
+/** Division by a constant is done with a multiply and shifts during
+ * codegen. Do the same for integer division (and modulus) by a
+ * runtime value in loops where that value doesn't change: compute the
+ * multiplier and shifts for each such divisor once, just outside the
+ * outermost loop in which it is invariant, and divide with them inside
+ * the loop. Only touches divisors of pure integer arithmetic, so
+ * nothing unsafe is hoisted, and leaves GPU kernels and offloaded
+ * loops alone. Division by zero is treated as division by one. */
+Stmt divide_by_invariants(Stmt s);
+
+EXPORT void invariant_division_test();
+
+}
+}
+
+#endif
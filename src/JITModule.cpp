@@ -1,7 +1,10 @@
+#include <algorithm>
 #include <string>
 #include <stdint.h>
+#include <stdio.h>
 #include <mutex>
 #include <set>
+#include <sstream>
 
 #ifndef _WIN32
 #include <sys/mman.h>
@@ -12,6 +15,7 @@
 #include "LLVM_Headers.h"
 #include "LLVM_Runtime_Linker.h"
 #include "Debug.h"
+#include "IRPrinter.h"
 #include "LLVM_Output.h"
 #include "CodeGen_LLVM.h"
 #include "Pipeline.h"
@@ -136,6 +140,7 @@ public:
     std::map<std::string, JITModule::Symbol> exports;
     llvm::LLVMContext context;
     ExecutionEngine *execution_engine;
+    std::unique_ptr<llvm::ObjectCache> object_cache;
     std::vector<JITModule> dependencies;
     JITModule::Symbol entrypoint;
     JITModule::Symbol argv_entrypoint;
@@ -167,15 +172,261 @@ JITModule::Symbol compile_and_get_function(ExecutionEngine &ee, const string &na
     return symbol;
 }
 
+// The directory to keep JIT-compiled object code in across runs, set
+// by HL_JIT_CACHE_DIR. Empty if there's no disk cache.
+string jit_cache_dir() {
+    size_t defined;
+    return get_env_variable("HL_JIT_CACHE_DIR", defined);
+}
+
+// The cache file for the code described by the given key. The hash
+// also covers how this build of Halide was made, so that code cached
+// by another version is never loaded.
+string jit_cache_path(const string &dir, const string &key, const Target &target) {
+    std::ostringstream full_key;
+    full_key << "LLVM " << LLVM_VERSION << ", Halide built " << __DATE__ << " " << __TIME__ << "\n"
+             << target.to_string() << "\n"
+             << key;
+    // 64-bit FNV-1a
+    uint64_t h = 14695981039346656037ULL;
+    for (char c : full_key.str()) {
+        h = (h ^ (uint8_t)c) * 1099511628211ULL;
+    }
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.o", (unsigned long long)h);
+    return dir + "/" + name;
+}
+
+// An llvm::ObjectCache that keeps the object code for a single module
+// in a file. When the file exists, MCJIT loads it instead of running
+// the code generator.
+class JITDiskCache : public llvm::ObjectCache {
+    string path;
+
+public:
+    JITDiskCache(const string &path) : path(path) {}
+
+    void notifyObjectCompiled(const llvm::Module *, llvm::MemoryBufferRef obj) override {
+        // Write to a temporary file and rename it into place, so that
+        // another process never reads a partial object.
+        int fd;
+        llvm::SmallString<256> tmp;
+        if (llvm::sys::fs::createUniqueFile(path + ".%%%%%%%%", fd, tmp)) {
+            debug(1) << "Couldn't create JIT cache file for " << path << "\n";
+            return;
+        }
+        bool ok;
+        {
+            llvm::raw_fd_ostream out(fd, true);
+            out.write(obj.getBufferStart(), obj.getBufferSize());
+            out.close();
+            ok = !out.has_error();
+            out.clear_error();
+        }
+        if (!ok || llvm::sys::fs::rename(tmp, path)) {
+            debug(1) << "Couldn't write JIT cache file " << path << "\n";
+            llvm::sys::fs::remove(tmp);
+            return;
+        }
+        debug(2) << "Saved JIT-compiled code to " << path << "\n";
+    }
+
+    std::unique_ptr<llvm::MemoryBuffer> getObject(const llvm::Module *) override {
+        auto buf = llvm::MemoryBuffer::getFile(path);
+        if (!buf) {
+            return nullptr;
+        }
+        debug(2) << "Loading JIT-compiled code from " << path << "\n";
+        return std::move(*buf);
+    }
+};
+
+// The code of all JIT modules goes in a few large regions, rather
+// than in pages mapped for each module, so that the hot code of many
+// pipelines shares fewer pages of the iTLB. Regions are mapped
+// read-write, and each page holds the code of only one module, which
+// is made executable once the module is finalized. With
+// HL_JIT_HUGE_PAGES=1, regions are instead mapped read-write-execute,
+// aligned to huge pages and advised to use them, and the code of all
+// modules is packed densely, as changing the protection of part of a
+// huge page would split it.
+class JITCodeArena {
+    static const size_t region_size = 32 << 20;
+    static const size_t page_size = 4096;
+    static const size_t huge_page_size = 2 << 20;
+
+    struct Region {
+        uint8_t *start;
+        size_t size, used;
+        // The number of allocations in the region not yet released.
+        int users;
+    };
+
+    std::mutex mutex;
+    // The last region is the one being allocated from.
+    std::vector<Region> regions;
+    int next_owner, last_owner;
+    bool huge_pages;
+
+    static size_t round_up(size_t x, size_t m) {
+        return (x + m - 1) / m * m;
+    }
+
+    uint8_t *map_region(size_t size) {
+#ifdef _WIN32
+        return nullptr;
+#else
+        int prot = PROT_READ | PROT_WRITE | (huge_pages ? PROT_EXEC : 0);
+        size_t padding = huge_pages ? huge_page_size : 0;
+        void *p = mmap(nullptr, size + padding, prot, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED) {
+            debug(1) << "Couldn't map " << size << " bytes for JIT code\n";
+            return nullptr;
+        }
+        uint8_t *start = (uint8_t *)p;
+        if (huge_pages) {
+            // Trim the mapping to a huge page boundary.
+            uint8_t *aligned = (uint8_t *)round_up((uintptr_t)start, huge_page_size);
+            if (aligned > start) {
+                munmap(start, aligned - start);
+            }
+            munmap(aligned + size, start + padding - aligned);
+            start = aligned;
+#ifdef MADV_HUGEPAGE
+            madvise(start, size, MADV_HUGEPAGE);
+#endif
+        }
+        return start;
+#endif
+    }
+
+    void unmap_region(const Region &r) {
+#ifndef _WIN32
+        munmap(r.start, r.size);
+#endif
+    }
+
+    JITCodeArena() : next_owner(0), last_owner(-1) {
+        size_t defined;
+        huge_pages = get_env_variable("HL_JIT_HUGE_PAGES", defined) == "1";
+    }
+
+public:
+    static JITCodeArena &get() {
+        // Leaked, as JIT modules may be destroyed at exit after it.
+        static JITCodeArena *arena = new JITCodeArena;
+        return *arena;
+    }
+
+    bool uses_huge_pages() const {
+        return huge_pages;
+    }
+
+    // A new id for a module to allocate code for.
+    int new_owner() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return next_owner++;
+    }
+
+    // Allocate code for a module, and return the start of the region
+    // it's in, to release it later. Returns null if no region could be
+    // mapped.
+    uint8_t *allocate(int owner, size_t size, size_t alignment, uint8_t **region_start) {
+        std::lock_guard<std::mutex> lock(mutex);
+        alignment = std::max(alignment, (size_t)16);
+        Region *r = regions.empty() ? nullptr : &regions.back();
+        size_t offset = 0;
+        if (r) {
+            offset = r->used;
+            if (!huge_pages && owner != last_owner) {
+                // Don't share a page with code that may already be
+                // executable.
+                offset = round_up(offset, page_size);
+            }
+            offset = round_up(offset, alignment);
+        }
+        if (!r || offset + size > r->size) {
+            size_t granule = huge_pages ? huge_page_size : page_size;
+            size_t new_size = std::max((size_t)region_size, round_up(size + alignment, granule));
+            uint8_t *start = map_region(new_size);
+            if (!start) {
+                return nullptr;
+            }
+            if (r && r->users == 0) {
+                unmap_region(*r);
+                regions.pop_back();
+            }
+            regions.push_back({start, new_size, 0, 0});
+            r = &regions.back();
+            offset = 0;
+        }
+        r->used = offset + size;
+        r->users++;
+        last_owner = owner;
+        *region_start = r->start;
+        return r->start + offset;
+    }
+
+    // Release an allocation in the region with the given start, once
+    // the module it was for is gone.
+    void release(uint8_t *region_start) {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (size_t i = 0; i < regions.size(); i++) {
+            Region &r = regions[i];
+            if (r.start != region_start) {
+                continue;
+            }
+            if (--r.users > 0) {
+                return;
+            }
+            if (i + 1 < regions.size()) {
+                unmap_region(r);
+                regions.erase(regions.begin() + i);
+            } else {
+                // Start the current region over.
+#ifndef _WIN32
+                if (!huge_pages) {
+                    mprotect(r.start, round_up(r.used, page_size), PROT_READ | PROT_WRITE);
+                }
+#endif
+                r.used = 0;
+                last_owner = -1;
+            }
+            return;
+        }
+        internal_error << "Released JIT code from an unknown region\n";
+    }
+};
+
 // Expand LLVM's search for symbols to include code contained in a set of JITModule.
 // TODO: Does this need to be conditionalized to llvm 3.6?
 class HalideJITMemoryManager : public SectionMemoryManager {
     std::vector<JITModule> modules;
-    std::vector<std::pair<uint8_t *, size_t>> code_pages;
+
+    struct CodePage {
+        uint8_t *start;
+        size_t size;
+        // Whether it's in a region of the JITCodeArena, mapped with
+        // huge pages.
+        bool packed;
+    };
+    std::vector<CodePage> code_pages;
+
+    int arena_owner;
+    // The regions of the JITCodeArena the code sections are in, once
+    // per section.
+    std::vector<uint8_t *> arena_regions;
 
 public:
 
-    HalideJITMemoryManager(const std::vector<JITModule> &modules) : modules(modules) {}
+    HalideJITMemoryManager(const std::vector<JITModule> &modules) :
+        modules(modules), arena_owner(JITCodeArena::get().new_owner()) {}
+
+    ~HalideJITMemoryManager() {
+        for (uint8_t *r : arena_regions) {
+            JITCodeArena::get().release(r);
+        }
+    }
 
     virtual uint64_t getSymbolAddress(const std::string &name) override {
         for (size_t i = 0; i < modules.size(); i++) {
@@ -192,19 +443,29 @@ public:
     }
 
     virtual uint8_t *allocateCodeSection(uintptr_t size, unsigned alignment, unsigned section_id, StringRef section_name) override {
-        uint8_t *result = SectionMemoryManager::allocateCodeSection(size, alignment, section_id, section_name);
-        code_pages.push_back({result, size});
+        JITCodeArena &arena = JITCodeArena::get();
+        uint8_t *region = nullptr;
+        uint8_t *result = arena.allocate(arena_owner, size, alignment, &region);
+        if (result) {
+            arena_regions.push_back(region);
+        } else {
+            result = SectionMemoryManager::allocateCodeSection(size, alignment, section_id, section_name);
+        }
+        code_pages.push_back({result, size, region && arena.uses_huge_pages()});
         return result;
     }
 
     void work_around_llvm_bugs() {
 
-        for (auto p : code_pages) {
-            uint8_t *start = p.first;
-            uint8_t *end = p.first + p.second;
+        for (const CodePage &p : code_pages) {
+            uint8_t *start = p.start;
+            uint8_t *end = p.start + p.size;
 
-            (void)start;
             (void)end;
+
+            // SectionMemoryManager only does this for the code it
+            // allocated itself.
+            llvm::sys::Memory::InvalidateInstructionCache(start, p.size);
 #ifdef __arm__
             // Flush each function from the dcache so that it gets pulled into
             // the icache correctly.
@@ -225,9 +486,12 @@ public:
             // as executable either.
             // https://llvm.org/bugs/show_bug.cgi?id=30905
 
-            start = (uint8_t *)(((uintptr_t)start) & ~4095);
-            end = (uint8_t *)(((uintptr_t)end + 4095) & ~4095);
-            mprotect((void *)start, end - start, PROT_READ | PROT_EXEC);
+            // Code packed into huge pages is already executable.
+            if (!p.packed) {
+                start = (uint8_t *)(((uintptr_t)start) & ~4095);
+                end = (uint8_t *)(((uintptr_t)end + 4095) & ~4095);
+                mprotect((void *)start, end - start, PROT_READ | PROT_EXEC);
+            }
 #endif
         }
     }
@@ -246,12 +510,26 @@ JITModule::JITModule(const Module &m, const LoweredFunc &fn,
     std::vector<JITModule> deps_with_runtime = dependencies;
     std::vector<JITModule> shared_runtime = JITSharedRuntime::get(llvm_module.get(), m.target());
     deps_with_runtime.insert(deps_with_runtime.end(), shared_runtime.begin(), shared_runtime.end());
-    compile_module(std::move(llvm_module), fn.name, m.target(), deps_with_runtime);
+
+    // The lowered module determines the object code, apart from the
+    // contents of any buffers embedded in it.
+    string cache_key;
+    if (!jit_cache_dir().empty()) {
+        std::ostringstream key;
+        key << m;
+        for (const Buffer<> &b : m.buffers()) {
+            key.write((const char *)b.begin(), b.size_in_bytes());
+        }
+        cache_key = key.str();
+    }
+    compile_module(std::move(llvm_module), fn.name, m.target(), deps_with_runtime,
+                   std::vector<std::string>(), cache_key);
 }
 
 void JITModule::compile_module(std::unique_ptr<llvm::Module> m, const string &function_name, const Target &target,
                                const std::vector<JITModule> &dependencies,
-                               const std::vector<std::string> &requested_exports) {
+                               const std::vector<std::string> &requested_exports,
+                               const std::string &cache_key) {
 
     // Ensure that LLVM is initialized
     CodeGen_LLVM::initialize_llvm();
@@ -265,6 +543,7 @@ void JITModule::compile_module(std::unique_ptr<llvm::Module> m, const string &fu
     string mattrs;
     llvm::TargetOptions options;
     get_target_options(*m, options, mcpu, mattrs);
+    CodeGenOpt::Level opt_level = get_codegen_opt_level(*m);
 
     DataLayout initial_module_data_layout = m->getDataLayout();
     string module_name = m->getModuleIdentifier();
@@ -276,7 +555,7 @@ void JITModule::compile_module(std::unique_ptr<llvm::Module> m, const string &fu
     HalideJITMemoryManager *memory_manager = new HalideJITMemoryManager(dependencies);
     engine_builder.setMCJITMemoryManager(std::unique_ptr<RTDyldMemoryManager>(memory_manager));
 
-    engine_builder.setOptLevel(CodeGenOpt::Aggressive);
+    engine_builder.setOptLevel(opt_level);
     if (!mcpu.empty()) {
         engine_builder.setMCPU(mcpu);
     }
@@ -301,6 +580,12 @@ void JITModule::compile_module(std::unique_ptr<llvm::Module> m, const string &fu
     if (!ee) std::cerr << error_string << "\n";
     internal_assert(ee) << "Couldn't create execution engine\n";
 
+    string cache_dir = jit_cache_dir();
+    if (!cache_key.empty() && !cache_dir.empty()) {
+        jit_module->object_cache.reset(new JITDiskCache(jit_cache_path(cache_dir, cache_key, target)));
+        ee->setObjectCache(jit_module->object_cache.get());
+    }
+
     // Do any target-specific initialization
     std::vector<llvm::JITEventListener *> listeners;
 
@@ -705,7 +990,13 @@ JITModule &make_module(llvm::Module *for_module, Target target,
 
         std::vector<std::string> halide_exports(halide_exports_unique.begin(), halide_exports_unique.end());
 
-        runtime.compile_module(std::move(module), "", target, deps, halide_exports);
+        // The runtime is built from the bitcode compiled into Halide,
+        // so it's determined by what it's built for.
+        string cache_key = module_name + "\n" + one_gpu.to_string();
+        if (for_module) {
+            cache_key += "\n" + for_module->getTargetTriple();
+        }
+        runtime.compile_module(std::move(module), "", target, deps, halide_exports, cache_key);
 
         if (runtime_kind == MainShared) {
             runtime_internal_handlers.custom_print =
@@ -763,6 +1054,17 @@ JITModule &make_module(llvm::Module *for_module, Target target,
     return runtime;
 }
 
+// Check whether a module calls any runtime function whose name starts
+// with the given prefix.
+bool module_calls_runtime(llvm::Module *m, const char *prefix) {
+    for (auto &f : *m) {
+        if (f.isDeclaration() && f.getName().startswith(prefix)) {
+            return true;
+        }
+    }
+    return false;
+}
+
 }  // anonymous namespace
 
 /* Shared runtimes are stored as global state. The set needed is
@@ -772,7 +1074,14 @@ JITModule &make_module(llvm::Module *for_module, Target target,
  * counted, but a global keeps one ref alive until shutdown or when
  * JITSharedRuntime::release_all is called. If
  * JITSharedRuntime::release_all is called, the global state is reset
- * and any newly compiled Funcs will get a new runtime. */
+ * and any newly compiled Funcs will get a new runtime.
+ *
+ * Device API runtimes are expensive to compile, and most pipelines
+ * jitted for a GPU target still have stages that don't use it, so a
+ * device API runtime is only made (or depended on) when the module
+ * being compiled calls into it. If there is no module, e.g. when
+ * getting a device interface for a Buffer, all the runtimes the
+ * target asks for are used. */
 std::vector<JITModule> JITSharedRuntime::get(llvm::Module *for_module, const Target &target, bool create) {
     std::lock_guard<std::mutex> lock(shared_runtimes_mutex);
 
@@ -783,39 +1092,42 @@ std::vector<JITModule> JITSharedRuntime::get(llvm::Module *for_module, const Tar
         result.push_back(m);
     }
 
-    // Add all requested GPU modules, each only depending on the main shared runtime.
-    std::vector<JITModule> gpu_modules;
-    if (target.has_feature(Target::OpenCL)) {
+    // Add all requested GPU modules that are used, each only
+    // depending on the main shared runtime.
+    auto used = [&](const char *prefix) {
+        return !for_module || module_calls_runtime(for_module, prefix);
+    };
+    if (target.has_feature(Target::OpenCL) && used("halide_opencl_")) {
         JITModule m = make_module(for_module, target, OpenCL, result, create);
         if (m.compiled()) {
             result.push_back(m);
         }
     }
-    if (target.has_feature(Target::Metal)) {
+    if (target.has_feature(Target::Metal) && used("halide_metal_")) {
         JITModule m = make_module(for_module, target, Metal, result, create);
         if (m.compiled()) {
             result.push_back(m);
         }
     }
-    if (target.has_feature(Target::CUDA)) {
+    if (target.has_feature(Target::CUDA) && used("halide_cuda_")) {
         JITModule m = make_module(for_module, target, CUDA, result, create);
         if (m.compiled()) {
             result.push_back(m);
         }
     }
-    if (target.has_feature(Target::OpenGL)) {
+    if (target.has_feature(Target::OpenGL) && used("halide_opengl_")) {
         JITModule m = make_module(for_module, target, OpenGL, result, create);
         if (m.compiled()) {
             result.push_back(m);
         }
     }
-    if (target.has_feature(Target::OpenGLCompute)) {
+    if (target.has_feature(Target::OpenGLCompute) && used("halide_openglcompute_")) {
         JITModule m = make_module(for_module, target, OpenGLCompute, result, create);
         if (m.compiled()) {
             result.push_back(m);
         }
     }
-    if (target.features_any_of({Target::HVX_64, Target::HVX_128})) {
+    if (target.features_any_of({Target::HVX_64, Target::HVX_128}) && used("halide_hexagon_")) {
         JITModule m = make_module(for_module, target, Hexagon, result, create);
         if (m.compiled()) {
             result.push_back(m);
@@ -107,11 +107,20 @@ struct JITModule {
     EXPORT Symbol find_symbol_by_name(const std::string &) const;
 
     /** Take an llvm module and compile it. The requested exports will
-        be available via the exports method. */
+        be available via the exports method. If the environment
+        variable HL_JIT_CACHE_DIR names a directory and a cache key is
+        given, the object code is kept in that directory under a hash
+        of the key and the target, and loaded from there instead of
+        being compiled again, by this or any later process. The key
+        must determine the module's code. The code of all modules is
+        packed into a few large shared regions; if the environment
+        variable HL_JIT_HUGE_PAGES is 1, they are backed by huge pages
+        where the OS allows it. */
     EXPORT void compile_module(std::unique_ptr<llvm::Module> mod,
                                const std::string &function_name, const Target &target,
                                const std::vector<JITModule> &dependencies = std::vector<JITModule>(),
-                               const std::vector<std::string> &requested_exports = std::vector<std::string>());
+                               const std::vector<std::string> &requested_exports = std::vector<std::string>(),
+                               const std::string &cache_key = std::string());
 
     /** Encapsulate device (GPU) and buffer interactions. */
     EXPORT int copy_to_device(struct buffer_t *buf) const;
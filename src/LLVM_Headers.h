@@ -22,6 +22,7 @@
 #include <llvm/ExecutionEngine/MCJIT.h>
 #include <llvm/ExecutionEngine/SectionMemoryManager.h>
 #include <llvm/ExecutionEngine/JITEventListener.h>
+#include <llvm/ExecutionEngine/ObjectCache.h>
 
 #include <llvm/IR/Verifier.h>
 #include <llvm/Linker/Linker.h>
@@ -56,6 +57,7 @@
 #include <llvm/Object/ObjectFile.h>
 
 #if LLVM_VERSION >= 39
+#include <llvm/Bitcode/BitcodeWriterPass.h>
 #include <llvm/Transforms/Scalar/GVN.h>
 #endif
 
@@ -5,6 +5,7 @@
 #include "CodeGen_C.h"
 #include "CodeGen_Internal.h"
 
+#include <chrono>
 #include <iostream>
 #include <fstream>
 
@@ -64,11 +65,19 @@ void emit_file(llvm::Module &module, Internal::LLVMOStream& out, llvm::TargetMac
     // Ask the target to add backend passes as necessary.
     target_machine->addPassesToEmitFile(pass_manager, out, file_type);
 
+    auto start = std::chrono::high_resolution_clock::now();
     pass_manager.run(module);
+    if (Internal::report_pass_times()) {
+        auto end = std::chrono::high_resolution_clock::now();
+        Internal::debug(0) << "LLVM times for " << module.getModuleIdentifier() << ": "
+                           << std::chrono::duration<double, std::milli>(end - start).count()
+                           << " ms emitting " << (file_type == llvm::TargetMachine::CGFT_ObjectFile ? "object code" : "assembly") << "\n";
+    }
 }
 
-std::unique_ptr<llvm::Module> compile_module_to_llvm_module(const Module &module, llvm::LLVMContext &context) {
-    return codegen_llvm(module, context);
+std::unique_ptr<llvm::Module> compile_module_to_llvm_module(const Module &module, llvm::LLVMContext &context,
+                                                            const std::string &pgo_profile) {
+    return codegen_llvm(module, context, pgo_profile);
 }
 
 void compile_llvm_module_to_object(llvm::Module &module, Internal::LLVMOStream& out) {
@@ -87,6 +96,29 @@ void compile_llvm_module_to_llvm_assembly(llvm::Module &module, Internal::LLVMOS
     module.print(out, nullptr);
 }
 
+void compile_llvm_module_to_thin_lto_bitcode(llvm::Module &module, Internal::LLVMOStream& out) {
+#if LLVM_VERSION >= 39
+    // Without these, the LTO backend would generate the pipeline for
+    // whatever cpu the link is for.
+    llvm::TargetOptions options;
+    std::string mcpu, mattrs;
+    Internal::get_target_options(module, options, mcpu, mattrs);
+    for (llvm::Function &f : module) {
+        if (!f.isDeclaration() && !f.hasFnAttribute("target-cpu")) {
+            f.addFnAttr("target-cpu", mcpu);
+            f.addFnAttr("target-features", mattrs);
+        }
+    }
+
+    llvm::legacy::PassManager pass_manager;
+    pass_manager.add(llvm::createBitcodeWriterPass(out, /* ShouldPreserveUseListOrder */ false,
+                                                   /* EmitSummaryIndex */ true, /* EmitModuleHash */ true));
+    pass_manager.run(module);
+#else
+    user_error << "ThinLTO bitcode output requires LLVM 3.9 or later\n";
+#endif
+}
+
 void create_static_library(const std::vector<std::string> &src_files, const Target &target,
                     const std::string &dst_file, bool deterministic) {
     internal_assert(!src_files.empty());
@@ -27,8 +27,11 @@ namespace Internal {
 typedef llvm::raw_pwrite_stream LLVMOStream;
 }
 
-/** Generate an LLVM module. */
-EXPORT std::unique_ptr<llvm::Module> compile_module_to_llvm_module(const Module &module, llvm::LLVMContext &context);
+/** Generate an LLVM module. If pgo_profile is not empty, it names a
+ * profile written by the module compiled with the pgo_instrument
+ * feature, to weight the branches by. */
+EXPORT std::unique_ptr<llvm::Module> compile_module_to_llvm_module(const Module &module, llvm::LLVMContext &context,
+                                                                   const std::string &pgo_profile = "");
 
 /** Construct an llvm output stream for writing to files. */
 std::unique_ptr<llvm::raw_fd_ostream> make_raw_fd_ostream(const std::string &filename);
@@ -45,6 +48,12 @@ EXPORT void compile_llvm_module_to_llvm_bitcode(llvm::Module &module, Internal::
 EXPORT void compile_llvm_module_to_llvm_assembly(llvm::Module &module, Internal::LLVMOStream& out);
 // @}
 
+/** Compile an LLVM module to bitcode with a ThinLTO summary. Each
+ * function in it is marked with the cpu and features of the module's
+ * target, so that the LTO backend generates code for them, and only
+ * inlines them into callers that have the same features. */
+EXPORT void compile_llvm_module_to_thin_lto_bitcode(llvm::Module &module, Internal::LLVMOStream& out);
+
 /**
  * Concatenate the list of src_files into dst_file, using the appropriate
  * static library format for the given target (e.g., .a or .lib).
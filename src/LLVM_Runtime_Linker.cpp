@@ -73,10 +73,13 @@ DECLARE_CPP_INITMOD(android_clock)
 DECLARE_CPP_INITMOD(android_host_cpu_count)
 DECLARE_CPP_INITMOD(android_io)
 DECLARE_CPP_INITMOD(android_opengl_context)
+DECLARE_CPP_INITMOD(android_perf_counters)
 DECLARE_CPP_INITMOD(android_tempfile)
+DECLARE_CPP_INITMOD(batch)
 DECLARE_CPP_INITMOD(buffer_t)
 DECLARE_CPP_INITMOD(cache)
 DECLARE_CPP_INITMOD(can_use_target)
+DECLARE_CPP_INITMOD(cancellation)
 DECLARE_CPP_INITMOD(cuda)
 DECLARE_CPP_INITMOD(destructors)
 DECLARE_CPP_INITMOD(device_interface)
@@ -89,7 +92,9 @@ DECLARE_CPP_INITMOD(hexagon_host)
 DECLARE_CPP_INITMOD(ios_io)
 DECLARE_CPP_INITMOD(linux_clock)
 DECLARE_CPP_INITMOD(linux_host_cpu_count)
+DECLARE_CPP_INITMOD(linux_huge_pages)
 DECLARE_CPP_INITMOD(linux_opengl_context)
+DECLARE_CPP_INITMOD(linux_perf_counters)
 DECLARE_CPP_INITMOD(matlab)
 DECLARE_CPP_INITMOD(metadata)
 DECLARE_CPP_INITMOD(mingw_math)
@@ -105,6 +110,7 @@ DECLARE_CPP_INITMOD(osx_clock)
 DECLARE_CPP_INITMOD(osx_get_symbol)
 DECLARE_CPP_INITMOD(osx_host_cpu_count)
 DECLARE_CPP_INITMOD(osx_opengl_context)
+DECLARE_CPP_INITMOD(pgo)
 DECLARE_CPP_INITMOD(posix_allocator)
 DECLARE_CPP_INITMOD(posix_clock)
 DECLARE_CPP_INITMOD(posix_error_handler)
@@ -112,6 +118,7 @@ DECLARE_CPP_INITMOD(posix_get_symbol)
 DECLARE_CPP_INITMOD(posix_io)
 DECLARE_CPP_INITMOD(posix_tempfile)
 DECLARE_CPP_INITMOD(posix_print)
+DECLARE_CPP_INITMOD(posix_shared_memory)
 DECLARE_CPP_INITMOD(posix_threads)
 DECLARE_CPP_INITMOD(profiler)
 DECLARE_CPP_INITMOD(profiler_inlined)
@@ -366,6 +373,9 @@ llvm::Triple get_triple_for_target(const Target &target) {
         if (target.os == Target::Android) {
             triple.setOS(llvm::Triple::Linux);
             triple.setEnvironment(llvm::Triple::Android);
+        } else if (target.os == Target::Linux) {
+            triple.setOS(llvm::Triple::Linux);
+            triple.setEnvironment(llvm::Triple::GNU);
         } else {
             user_error << "No mips support for this OS\n";
         }
@@ -439,11 +449,13 @@ void link_modules(std::vector<std::unique_ptr<llvm::Module>> &modules, Target t)
     // The symbols that we might want to call as a user even if not
     // used in the Halide-generated code must remain weak. This is
     // handled automatically by assuming any symbol starting with
-    // "halide_" that is weak will be retained. There are a few
-    // symbols for which this convention is not followed and these are
-    // in this array.
+    // "halide_" that is weak will be retained, unless the target asks
+    // for a minimal runtime in an AOT object, which keeps only what
+    // the pipeline calls. There are a few symbols for which this
+    // convention is not followed and these are in this array.
     vector<string> retain = {"__stack_chk_guard",
                              "__stack_chk_fail"};
+    bool minimal_runtime = t.has_feature(Target::MinimalRuntime) && !t.has_feature(Target::JIT);
 
     if (t.has_feature(Target::MinGW)) {
         retain.insert(retain.end(),
@@ -476,7 +488,7 @@ void link_modules(std::vector<std::unique_ptr<llvm::Module>> &modules, Target t)
         bool is_halide_extern_c_sym = Internal::starts_with(f.getName(), "halide_");
         internal_assert(t.os == Target::NoOS || !is_halide_extern_c_sym || f.isWeakForLinker() || f.isDeclaration())
             << " for function " << (std::string)f.getName() << "\n";
-        can_strip = can_strip && !is_halide_extern_c_sym;
+        can_strip = can_strip && (!is_halide_extern_c_sym || minimal_runtime);
 
         llvm::GlobalValue::LinkageTypes linkage = f.getLinkage();
         if (can_strip || t.os == Target::NoOS) {
@@ -632,12 +644,15 @@ std::unique_ptr<llvm::Module> get_initial_module_for_target(Target t, llvm::LLVM
                 modules.push_back(get_initmod_posix_print(c, bits_64, debug));
                 if (t.arch == Target::X86) {
                     modules.push_back(get_initmod_linux_clock(c, bits_64, debug));
+                    modules.push_back(get_initmod_linux_perf_counters(c, bits_64, debug));
                 } else {
                     modules.push_back(get_initmod_posix_clock(c, bits_64, debug));
                 }
                 modules.push_back(get_initmod_posix_io(c, bits_64, debug));
                 modules.push_back(get_initmod_posix_tempfile(c, bits_64, debug));
+                modules.push_back(get_initmod_posix_shared_memory(c, bits_64, debug));
                 modules.push_back(get_initmod_linux_host_cpu_count(c, bits_64, debug));
+                modules.push_back(get_initmod_linux_huge_pages(c, bits_64, debug));
                 modules.push_back(get_initmod_posix_threads(c, bits_64, debug));
                 modules.push_back(get_initmod_thread_pool(c, bits_64, debug));
                 modules.push_back(get_initmod_posix_get_symbol(c, bits_64, debug));
@@ -656,11 +671,17 @@ std::unique_ptr<llvm::Module> get_initial_module_for_target(Target t, llvm::LLVM
                 modules.push_back(get_initmod_posix_print(c, bits_64, debug));
                 if (t.arch == Target::ARM) {
                     modules.push_back(get_initmod_android_clock(c, bits_64, debug));
+                    modules.push_back(get_initmod_android_perf_counters(c, bits_64, debug));
                 } else {
                     modules.push_back(get_initmod_posix_clock(c, bits_64, debug));
                 }
+                if (t.arch == Target::X86) {
+                    // The x86 syscall numbers are the same as on Linux.
+                    modules.push_back(get_initmod_linux_perf_counters(c, bits_64, debug));
+                }
                 modules.push_back(get_initmod_android_io(c, bits_64, debug));
                 modules.push_back(get_initmod_android_tempfile(c, bits_64, debug));
+                modules.push_back(get_initmod_posix_shared_memory(c, bits_64, debug));
                 modules.push_back(get_initmod_android_host_cpu_count(c, bits_64, debug));
                 modules.push_back(get_initmod_posix_threads(c, bits_64, debug));
                 modules.push_back(get_initmod_thread_pool(c, bits_64, debug));
@@ -730,12 +751,18 @@ std::unique_ptr<llvm::Module> get_initial_module_for_target(Target t, llvm::LLVM
             modules.push_back(get_initmod_metadata(c, bits_64, debug));
             modules.push_back(get_initmod_float16_t(c, bits_64, debug));
             modules.push_back(get_initmod_errors(c, bits_64, debug));
+            modules.push_back(get_initmod_batch(c, bits_64, debug));
+            modules.push_back(get_initmod_cancellation(c, bits_64, debug));
 
             if (t.arch != Target::MIPS && t.os != Target::NoOS) {
                 // MIPS doesn't support the atomics the profiler requires.
                 modules.push_back(get_initmod_profiler(c, bits_64, debug));
             }
 
+            if (t.has_feature(Target::PGOInstrument)) {
+                modules.push_back(get_initmod_pgo(c, bits_64, debug));
+            }
+
             if (t.has_feature(Target::MSAN)) {
                 modules.push_back(get_initmod_msan(c, bits_64, debug));
             } else {
@@ -784,8 +811,9 @@ std::unique_ptr<llvm::Module> get_initial_module_for_target(Target t, llvm::LLVM
             }
         }
 
-        if (module_type == ModuleAOT) {
-            // These modules are only used for AOT compilation
+        if (module_type == ModuleAOT || module_type == ModuleJITShared) {
+            // These modules are used by multitarget AOT compilation,
+            // and by loops scheduled with multiversion.
             modules.push_back(get_initmod_can_use_target(c, bits_64, debug));
             if (t.arch == Target::X86) {
                 modules.push_back(get_initmod_x86_cpu_features(c, bits_64, debug));
@@ -898,7 +926,11 @@ std::unique_ptr<llvm::Module> get_initial_module_for_ptx_device(Target target, l
 
     // This table is based on the guidance at:
     // http://docs.nvidia.com/cuda/libdevice-users-guide/basic-usage.html#linking-with-libdevice
-    if (target.has_feature(Target::CUDACapability35)) {
+    if (target.features_any_of({Target::CUDACapability61,
+                                Target::CUDACapability70})) {
+        // Everything newer than sm_50 uses libdevice 30
+        module = get_initmod_ptx_compute_30_ll(c);
+    } else if (target.has_feature(Target::CUDACapability35)) {
         module = get_initmod_ptx_compute_35_ll(c);
     } else if (target.features_any_of({Target::CUDACapability32,
                                        Target::CUDACapability50})) {
@@ -116,6 +116,15 @@ void block_to_vector(Stmt s, vector<Stmt> &v) {
     }
 }
 
+/** Is a Stmt a Store, possibly wrapped in LetStmts? Unrolled loop
+ * bodies are runs of these. */
+bool is_store(Stmt s) {
+    while (const LetStmt *l = s.as<LetStmt>()) {
+        s = l->body;
+    }
+    return s.as<Store>() != nullptr;
+}
+
 /** Unpack a block into its component Stmts. */
 vector<Stmt> block_to_vector(Stmt s) {
     vector<Stmt> result;
@@ -192,6 +201,18 @@ class LoopCarryOverLoop : public IRMutator {
     const Scope<int> &in_consume;
 
     int max_carried_values;
+    int vector_bits;
+
+    /** The number of vector registers needed to hold a value of the
+     * given type. If we don't know the vector register width, every
+     * value costs one. */
+    int registers_for(Type t) const {
+        if (vector_bits <= 0) {
+            return 1;
+        }
+        int bits = t.bits() * t.lanes();
+        return std::max(1, (bits + vector_bits - 1) / vector_bits);
+    }
 
     using IRMutator::visit;
 
@@ -223,10 +244,12 @@ class LoopCarryOverLoop : public IRMutator {
     void visit(const Block *op) {
         vector<Stmt> v = block_to_vector(op);
 
+        // Consider runs of stores together, so that the copies of an
+        // unrolled loop body can share carried values.
         vector<Stmt> stores;
         vector<Stmt> result;
         for (size_t i = 0; i < v.size(); i++) {
-            if (v[i].as<Store>()) {
+            if (is_store(v[i])) {
                 stores.push_back(v[i]);
             } else {
                 if (!stores.empty()) {
@@ -343,24 +366,29 @@ class LoopCarryOverLoop : public IRMutator {
             }
         }
 
-        // Only keep the top N carried values. Otherwise we'll just
-        // spray stack spills everywhere. This is ugly, because we're
-        // relying on a heuristic.
+        // Only keep as many carried values as fit in the register
+        // budget. Otherwise we'll just spray stack spills
+        // everywhere. This is ugly, because we're relying on a
+        // heuristic. The longest chains go first, and shorter ones
+        // (e.g. the other rows of a stencil) fill in whatever budget
+        // is left over.
         vector<vector<int>> trimmed;
-        size_t sz = 0;
+        int used = 0;
         for (const vector<int> &c : chains) {
-            if (sz + c.size() > (size_t)max_carried_values) {
-                if (sz < (size_t)max_carried_values - 1) {
-                    // Take a partial chain
-                    trimmed.emplace_back(c.begin(), c.begin() + max_carried_values - sz);
-                }
-                break;
-            }
-            trimmed.push_back(c);
-            sz += c.size();
+            int cost = registers_for(loads[c.front()][0]->type);
+            int fit = std::min((int)c.size(), (max_carried_values - used) / cost);
+            // A chain of one value doesn't carry anything.
+            if (fit < 2) continue;
+            // Take as much of the chain as fits
+            trimmed.emplace_back(c.begin(), c.begin() + fit);
+            used += fit * cost;
         }
         chains.swap(trimmed);
 
+        if (chains.empty()) {
+            return orig_stmt;
+        }
+
         // We now have chains of the form:
         // f[x] <- f[x+1] <- ... <- f[x+N-1]
 
@@ -471,8 +499,8 @@ class LoopCarryOverLoop : public IRMutator {
     }
 
 public:
-    LoopCarryOverLoop(const string &var, const Scope<int> &s, int max_carried_values)
-        : in_consume(s), max_carried_values(max_carried_values) {
+    LoopCarryOverLoop(const string &var, const Scope<int> &s, int max_carried_values, int vector_bits)
+        : in_consume(s), max_carried_values(max_carried_values), vector_bits(vector_bits) {
         linear.push(var, 1);
     }
 
@@ -490,6 +518,8 @@ class LoopCarry : public IRMutator {
     using IRMutator::visit;
 
     int max_carried_values;
+    const std::set<string> *loops;
+    int vector_bits;
     Scope<int> in_consume;
 
     void visit(const ProducerConsumer *op) {
@@ -504,9 +534,10 @@ class LoopCarry : public IRMutator {
     }
 
     void visit(const For *op) {
-        if (op->for_type == ForType::Serial && !is_one(op->extent)) {
+        if (op->for_type == ForType::Serial && !is_one(op->extent) &&
+            (!loops || loops->count(op->name))) {
             Stmt body = mutate(op->body);
-            LoopCarryOverLoop carry(op->name, in_consume, max_carried_values);
+            LoopCarryOverLoop carry(op->name, in_consume, max_carried_values, vector_bits);
             body = carry.mutate(body);
             if (body.same_as(op->body)) {
                 stmt = op;
@@ -517,7 +548,7 @@ class LoopCarry : public IRMutator {
             // Inject the scratch buffer allocations.
             for (const auto &alloc : carry.allocs) {
                 stmt = Block::make(substitute(op->name, op->min, alloc.initial_stores), stmt);
-                stmt = Allocate::make(alloc.name, alloc.type, {alloc.size}, const_true(), stmt);
+                stmt = Allocate::make(alloc.name, alloc.type, MemoryType::Stack, {alloc.size}, const_true(), stmt);
             }
             if (!carry.allocs.empty()) {
                 stmt = IfThenElse::make(op->extent > 0, stmt);
@@ -529,14 +560,15 @@ class LoopCarry : public IRMutator {
     }
 
 public:
-    LoopCarry(int max_carried_values) : max_carried_values(max_carried_values) {}
+    LoopCarry(int max_carried_values, const std::set<string> *loops, int vector_bits)
+        : max_carried_values(max_carried_values), loops(loops), vector_bits(vector_bits) {}
 };
 
 }
 
 
-Stmt loop_carry(Stmt s, int max_carried_values) {
-    s = LoopCarry(max_carried_values).mutate(s);
+Stmt loop_carry(Stmt s, int max_carried_values, const std::set<std::string> *loops, int vector_bits) {
+    s = LoopCarry(max_carried_values, loops, vector_bits).mutate(s);
     return s;
 }
 
@@ -1,6 +1,9 @@
 #ifndef HALIDE_LOOP_CARRY_H
 #define HALIDE_LOOP_CARRY_H
 
+#include <set>
+#include <string>
+
 #include "Expr.h"
 
 namespace Halide {
@@ -10,8 +13,14 @@ namespace Internal {
  * induction variables instead of redoing the load. Can be an
  * optimization or pessimization depending on how good the L1 cache is
  * on the architecture and how many memory issue slots there
- * are. Currently only intended for Hexagon. */
-Stmt loop_carry(Stmt, int max_carried_values = 8);
+ * are. Currently only intended for Hexagon, and for the loops
+ * align_overlapping_loads rewrites. If loops is not null, only carry
+ * values across the loops with those names. max_carried_values is a
+ * budget of registers per loop body; if vector_bits is non-zero, a
+ * carried value costs as many registers of that width as it takes to
+ * hold it, otherwise each value costs one. */
+Stmt loop_carry(Stmt, int max_carried_values = 8, const std::set<std::string> *loops = nullptr,
+                int vector_bits = 0);
 
 }
 }
@@ -1,37 +1,51 @@
 #include <iostream>
+#include <iomanip>
+#include <chrono>
 #include <set>
 #include <sstream>
 #include <algorithm>
 
 #include "Lower.h"
 
+#include "AdaptiveParallel.h"
 #include "AddImageChecks.h"
 #include "AddParameterChecks.h"
+#include "AlignLoads.h"
 #include "AllocationBoundsInference.h"
+#include "AsyncProducers.h"
+#include "BoundSmallAllocations.h"
 #include "Bounds.h"
 #include "BoundsInference.h"
 #include "CSE.h"
+#include "CancellationChecks.h"
 #include "CanonicalizeGPUVars.h"
+#include "CodeSize.h"
 #include "Debug.h"
 #include "DebugToFile.h"
 #include "DeepCopy.h"
 #include "Deinterleave.h"
 #include "EarlyFree.h"
+#include "EmulateFloat16Math.h"
 #include "FindCalls.h"
 #include "Func.h"
 #include "Function.h"
 #include "FuseGPUThreadLoops.h"
 #include "FuzzFloatStores.h"
+#include "GPULaunchBounds.h"
 #include "HexagonOffload.h"
 #include "InjectHostDevBufferCopies.h"
 #include "InjectImageIntrinsics.h"
 #include "InjectOpenGLIntrinsics.h"
 #include "Inline.h"
+#include "IRArena.h"
 #include "IRMutator.h"
 #include "IROperator.h"
 #include "IRPrinter.h"
+#include "InvariantDivision.h"
 #include "LoopCarry.h"
+#include "LowerWarpShuffles.h"
 #include "Memoization.h"
+#include "MultiversionLoops.h"
 #include "PartitionLoops.h"
 #include "Prefetch.h"
 #include "Profiling.h"
@@ -42,13 +56,16 @@
 #include "RemoveUndef.h"
 #include "ScheduleFunctions.h"
 #include "SelectGPUAPI.h"
+#include "ShareAllocations.h"
 #include "SkipStages.h"
 #include "SlidingWindow.h"
+#include "SpecializeStrides.h"
 #include "Simplify.h"
 #include "SimplifySpecializations.h"
 #include "SplitTuples.h"
 #include "StorageFlattening.h"
 #include "StorageFolding.h"
+#include "StrengthReduction.h"
 #include "Substitute.h"
 #include "Tracing.h"
 #include "TrimNoOps.h"
@@ -68,9 +85,105 @@ using std::string;
 using std::vector;
 using std::map;
 
+namespace {
+
+// Counts the distinct IR nodes in a Stmt.
+class CountNodes : public IRGraphVisitor {
+public:
+    size_t count(const Stmt &s) {
+        if (s.defined()) {
+            include(s);
+        }
+        return visited.size();
+    }
+};
+
+// When HL_DEBUG_PASS_TIMES is set, records the wall time of each
+// lowering pass and the size of the IR before and after it, and
+// prints a report once lowering is done.
+class PassTimer {
+    struct Pass {
+        string name;
+        double ms;
+        size_t nodes_before, nodes_after;
+    };
+
+    bool enabled;
+    string pipeline_name;
+    vector<Pass> passes;
+    std::chrono::high_resolution_clock::time_point start;
+
+    size_t count_nodes(const Stmt &s) {
+        return CountNodes().count(s);
+    }
+
+    void finish_pass(const Stmt &s) {
+        if (passes.empty()) return;
+        auto end = std::chrono::high_resolution_clock::now();
+        Pass &p = passes.back();
+        p.ms = std::chrono::duration<double, std::milli>(end - start).count();
+        p.nodes_after = count_nodes(s);
+    }
+
+public:
+    PassTimer(const string &pipeline_name) : pipeline_name(pipeline_name) {
+        size_t defined = 0;
+        string value = get_env_variable("HL_DEBUG_PASS_TIMES", defined);
+        enabled = defined && value != "0";
+    }
+
+    // Start timing the named pass, ending the one before it. Counting
+    // the nodes isn't included in the times.
+    void next(const string &name, const Stmt &s) {
+        if (!enabled) return;
+        finish_pass(s);
+        Pass p = {name, 0, passes.empty() ? 0 : passes.back().nodes_after, 0};
+        if (passes.empty()) {
+            p.nodes_before = count_nodes(s);
+        }
+        passes.push_back(p);
+        start = std::chrono::high_resolution_clock::now();
+    }
+
+    void done(const Stmt &s) {
+        if (!enabled) return;
+        finish_pass(s);
+        double total = 0;
+        size_t name_width = 0;
+        for (const Pass &p : passes) {
+            total += p.ms;
+            name_width = std::max(name_width, p.name.size());
+        }
+        std::ostringstream report;
+        report << "Lowering pass times for " << pipeline_name << ": " << total << " ms\n";
+        for (const Pass &p : passes) {
+            report << "  " << p.name << ": " << string(name_width - p.name.size(), ' ')
+                   << std::fixed << std::setprecision(3) << std::setw(10) << p.ms << " ms "
+                   << std::setprecision(1) << std::setw(5) << (total > 0 ? 100 * p.ms / total : 0) << "%"
+                   << "  nodes: " << p.nodes_before << " -> " << p.nodes_after << "\n";
+            report.unsetf(std::ios::floatfield);
+        }
+        debug(0) << report.str();
+    }
+};
+
+}  // namespace
+
 Stmt lower(const vector<Function> &output_funcs, const string &pipeline_name,
            const Target &t, const vector<IRMutator *> &custom_passes) {
 
+    PassTimer timer(pipeline_name);
+    timer.next("Preparing Funcs", Stmt());
+
+    // Lowering makes and discards a great many IR nodes. Take them from
+    // an arena if one is enabled. This must outlive the simplifier's
+    // cache, which holds nodes too.
+    IRArenaScope ir_arena;
+
+    // Lowering simplifies many copies of the same Exprs, especially
+    // during bounds inference.
+    SimplifyCacheScope simplify_cache;
+
     // Compute an environment
     map<string, Function> env;
     for (Function f : output_funcs) {
@@ -99,15 +212,18 @@ Stmt lower(const vector<Function> &output_funcs, const string &pipeline_name,
 
     bool any_memoized = false;
 
+    timer.next("Creating initial loop nests", Stmt());
     debug(1) << "Creating initial loop nests...\n";
     Stmt s = schedule_functions(outputs, order, env, t, any_memoized);
     debug(2) << "Lowering after creating initial loop nests:\n" << s << '\n';
 
+    timer.next("Canonicalizing GPU var names", s);
     debug(1) << "Canonicalizing GPU var names...\n";
     s = canonicalize_gpu_vars(s);
     debug(2) << "Lowering after canonicalizing GPU var names:\n" << s << '\n';
 
     if (any_memoized) {
+        timer.next("Injecting memoization", s);
         debug(1) << "Injecting memoization...\n";
         s = inject_memoization(s, env, pipeline_name, outputs);
         debug(2) << "Lowering after injecting memoization:\n" << s << '\n';
@@ -115,25 +231,30 @@ Stmt lower(const vector<Function> &output_funcs, const string &pipeline_name,
         debug(1) << "Skipping injecting memoization...\n";
     }
 
+    timer.next("Injecting prefetches", s);
     debug(1) << "Injecting prefetches...\n";
     s = inject_prefetch(s, env);
     debug(2) << "Lowering after injecting prefetches:\n" << s << "\n\n";
 
+    timer.next("Injecting tracing", s);
     debug(1) << "Injecting tracing...\n";
     s = inject_tracing(s, pipeline_name, env, outputs);
     debug(2) << "Lowering after injecting tracing:\n" << s << '\n';
 
+    timer.next("Adding checks for parameters", s);
     debug(1) << "Adding checks for parameters\n";
     s = add_parameter_checks(s, t);
     debug(2) << "Lowering after injecting parameter checks:\n" << s << '\n';
 
     // Compute the maximum and minimum possible value of each
     // function. Used in later bounds inference passes.
+    timer.next("Computing bounds of each function's value", s);
     debug(1) << "Computing bounds of each function's value\n";
     FuncValueBounds func_bounds = compute_function_value_bounds(order, env);
 
     // The checks will be in terms of the symbols defined by bounds
     // inference.
+    timer.next("Adding checks for images", s);
     debug(1) << "Adding checks for images\n";
     s = add_image_checks(s, outputs, t, order, env, func_bounds);
     debug(2) << "Lowering after injecting image checks:\n" << s << '\n';
@@ -141,18 +262,27 @@ Stmt lower(const vector<Function> &output_funcs, const string &pipeline_name,
     // This pass injects nested definitions of variable names, so we
     // can't simplify statements from here until we fix them up. (We
     // can still simplify Exprs).
+    timer.next("Performing computation bounds inference", s);
     debug(1) << "Performing computation bounds inference...\n";
     s = bounds_inference(s, outputs, order, env, func_bounds, t);
     debug(2) << "Lowering after computation bounds inference:\n" << s << '\n';
 
+    timer.next("Fusing loops of stages computed with each other", s);
+    debug(1) << "Fusing loops of stages computed with each other...\n";
+    s = fuse_compute_with(s, order, env);
+    debug(2) << "Lowering after fusing loops:\n" << s << '\n';
+
+    timer.next("Performing sliding window optimization", s);
     debug(1) << "Performing sliding window optimization...\n";
     s = sliding_window(s, env);
     debug(2) << "Lowering after sliding window:\n" << s << '\n';
 
+    timer.next("Performing allocation bounds inference", s);
     debug(1) << "Performing allocation bounds inference...\n";
     s = allocation_bounds_inference(s, env, func_bounds);
     debug(2) << "Lowering after allocation bounds inference:\n" << s << '\n';
 
+    timer.next("Removing code that depends on undef values", s);
     debug(1) << "Removing code that depends on undef values...\n";
     s = remove_undef(s);
     debug(2) << "Lowering after removing code that depends on undef values:\n" << s << "\n\n";
@@ -160,41 +290,55 @@ Stmt lower(const vector<Function> &output_funcs, const string &pipeline_name,
     // This uniquifies the variable names, so we're good to simplify
     // after this point. This lets later passes assume syntactic
     // equivalence means semantic equivalence.
+    timer.next("Uniquifying variable names", s);
     debug(1) << "Uniquifying variable names...\n";
     s = uniquify_variable_names(s);
     debug(2) << "Lowering after uniquifying variable names:\n" << s << "\n\n";
 
+    timer.next("Performing storage folding optimization", s);
     debug(1) << "Performing storage folding optimization...\n";
     s = storage_folding(s, env);
     debug(2) << "Lowering after storage folding:\n" << s << '\n';
 
+    timer.next("Forking async producers", s);
+    debug(1) << "Forking async producers...\n";
+    s = fork_async_producers(s, env);
+    debug(2) << "Lowering after forking async producers:\n" << s << '\n';
+
+    timer.next("Injecting debug_to_file calls", s);
     debug(1) << "Injecting debug_to_file calls...\n";
     s = debug_to_file(s, outputs, env);
     debug(2) << "Lowering after injecting debug_to_file calls:\n" << s << '\n';
 
+    timer.next("Simplifying", s);
     debug(1) << "Simplifying...\n"; // without removing dead lets, because storage flattening needs the strides
     s = simplify(s, false);
     debug(2) << "Lowering after first simplification:\n" << s << "\n\n";
 
+    timer.next("Dynamically skipping stages", s);
     debug(1) << "Dynamically skipping stages...\n";
     s = skip_stages(s, order);
     debug(2) << "Lowering after dynamically skipping stages:\n" << s << "\n\n";
 
+    timer.next("Destructuring tuple-valued realizations", s);
     debug(1) << "Destructuring tuple-valued realizations...\n";
     s = split_tuples(s, env);
     debug(2) << "Lowering after destructuring tuple-valued realizations:\n" << s << "\n\n";
 
     if (t.has_feature(Target::OpenGL)) {
+        timer.next("Injecting image intrinsics", s);
         debug(1) << "Injecting image intrinsics...\n";
         s = inject_image_intrinsics(s, env);
         debug(2) << "Lowering after image intrinsics:\n" << s << "\n\n";
     }
 
+    timer.next("Performing storage flattening", s);
     debug(1) << "Performing storage flattening...\n";
     s = storage_flattening(s, outputs, env, t);
     debug(2) << "Lowering after storage flattening:\n" << s << "\n\n";
 
     if (any_memoized) {
+        timer.next("Rewriting memoized allocations", s);
         debug(1) << "Rewriting memoized allocations...\n";
         s = rewrite_memoized_allocations(s, env);
         debug(2) << "Lowering after rewriting memoized allocations:\n" << s << "\n\n";
@@ -206,16 +350,19 @@ Stmt lower(const vector<Function> &output_funcs, const string &pipeline_name,
         t.has_feature(Target::OpenGLCompute) ||
         t.has_feature(Target::OpenGL) ||
         (t.arch != Target::Hexagon && (t.features_any_of({Target::HVX_64, Target::HVX_128})))) {
+        timer.next("Selecting a GPU API for GPU loops", s);
         debug(1) << "Selecting a GPU API for GPU loops...\n";
         s = select_gpu_api(s, t);
         debug(2) << "Lowering after selecting a GPU API:\n" << s << "\n\n";
 
+        timer.next("Injecting host <-> dev buffer copies", s);
         debug(1) << "Injecting host <-> dev buffer copies...\n";
         s = inject_host_dev_buffer_copies(s, t);
         debug(2) << "Lowering after injecting host <-> dev buffer copies:\n" << s << "\n\n";
     }
 
     if (t.has_feature(Target::OpenGL)) {
+        timer.next("Injecting OpenGL texture intrinsics", s);
         debug(1) << "Injecting OpenGL texture intrinsics...\n";
         s = inject_opengl_intrinsics(s);
         debug(2) << "Lowering after OpenGL intrinsics:\n" << s << "\n\n";
@@ -223,87 +370,195 @@ Stmt lower(const vector<Function> &output_funcs, const string &pipeline_name,
 
     if (t.has_gpu_feature() ||
         t.has_feature(Target::OpenGLCompute)) {
+        timer.next("Lowering warp shuffles", s);
+        debug(1) << "Lowering warp shuffles...\n";
+        s = lower_warp_shuffles(s);
+        debug(2) << "Lowering after lowering warp shuffles:\n" << s << "\n\n";
+
+        timer.next("Injecting per-block gpu synchronization", s);
         debug(1) << "Injecting per-block gpu synchronization...\n";
         s = fuse_gpu_thread_loops(s);
         debug(2) << "Lowering after injecting per-block gpu synchronization:\n" << s << "\n\n";
     }
 
+    if (t.has_feature(Target::SpecializeStrides)) {
+        timer.next("Specializing on strides", s);
+        debug(1) << "Specializing on the innermost strides of buffers...\n";
+        s = specialize_strides(s, t);
+        debug(2) << "Lowering after specializing on strides:\n" << s << "\n\n";
+    }
+
+    timer.next("Simplifying", s);
     debug(1) << "Simplifying...\n";
     s = simplify(s);
     s = unify_duplicate_lets(s);
     s = remove_trivial_for_loops(s);
     debug(2) << "Lowering after second simplifcation:\n" << s << "\n\n";
 
+    // Unrolling and partitioning keep each Func's code within its
+    // budget, relative to its size now.
+    CodeSizeBudget code_size_budget(s, env, t);
+
+    timer.next("Unrolling", s);
     debug(1) << "Unrolling...\n";
-    s = unroll_loops(s);
+    s = unroll_loops(s, &code_size_budget);
     s = simplify(s);
     debug(2) << "Lowering after unrolling:\n" << s << "\n\n";
 
+    timer.next("Vectorizing", s);
     debug(1) << "Vectorizing...\n";
     s = vectorize_loops(s, t);
     s = simplify(s);
     debug(2) << "Lowering after vectorizing:\n" << s << "\n\n";
 
+    timer.next("Detecting vector interleavings", s);
     debug(1) << "Detecting vector interleavings...\n";
     s = rewrite_interleavings(s);
     s = simplify(s);
     debug(2) << "Lowering after rewriting vector interleavings:\n" << s << "\n\n";
 
+    timer.next("Partitioning loops to simplify boundary conditions", s);
     debug(1) << "Partitioning loops to simplify boundary conditions...\n";
-    s = partition_loops(s);
+    s = partition_loops(s, &code_size_budget);
     s = simplify(s);
     debug(2) << "Lowering after partitioning loops:\n" << s << "\n\n";
 
+    timer.next("Trimming loops to the region over which they do something", s);
     debug(1) << "Trimming loops to the region over which they do something...\n";
     s = trim_no_ops(s);
     debug(2) << "Lowering after loop trimming:\n" << s << "\n\n";
 
+    if (t.has_feature(Target::CUDA)) {
+        timer.next("Marking GPU launch bounds", s);
+        debug(1) << "Marking GPU launch bounds...\n";
+        s = mark_gpu_launch_bounds(s, env);
+        debug(2) << "Lowering after marking GPU launch bounds:\n" << s << "\n\n";
+    }
+
+    timer.next("Multiversioning loops", s);
+    debug(1) << "Multiversioning loops...\n";
+    s = multiversion_loops(s, env, t);
+    debug(2) << "Lowering after multiversioning loops:\n" << s << "\n\n";
+
+    timer.next("Strength reducing loop indices", s);
+    debug(1) << "Strength reducing loop indices...\n";
+    s = strength_reduce(s);
+    debug(2) << "Lowering after strength reducing loop indices:\n" << s << "\n\n";
+
+    // HVX has no 64-bit lanes to do the multiplies in.
+    if (t.arch != Target::Hexagon) {
+        timer.next("Dividing by loop invariants", s);
+        debug(1) << "Dividing by loop invariants...\n";
+        s = divide_by_invariants(s);
+        debug(2) << "Lowering after dividing by loop invariants:\n" << s << "\n\n";
+    }
+
+    if (t.has_feature(Target::LargeStack)) {
+        timer.next("Bounding small allocations", s);
+        debug(1) << "Bounding small allocations...\n";
+        s = bound_small_allocations(s, t);
+        debug(2) << "Lowering after bounding small allocations:\n" << s << "\n\n";
+    }
+
+    timer.next("Sharing allocations", s);
+    debug(1) << "Sharing allocations with disjoint lifetimes...\n";
+    s = share_allocations(s);
+    debug(2) << "Lowering after sharing allocations:\n" << s << "\n\n";
+
+    timer.next("Injecting early frees", s);
     debug(1) << "Injecting early frees...\n";
     s = inject_early_frees(s);
     debug(2) << "Lowering after injecting early frees:\n" << s << "\n\n";
 
     if (t.has_feature(Target::Profile)) {
+        timer.next("Injecting profiling", s);
         debug(1) << "Injecting profiling...\n";
-        s = inject_profiling(s, pipeline_name);
+        s = inject_profiling(s, pipeline_name, t);
         debug(2) << "Lowering after injecting profiling:\n" << s << "\n\n";
     }
 
+    if (t.has_feature(Target::Cancellable)) {
+        timer.next("Injecting cancellation checks", s);
+        debug(1) << "Injecting cancellation checks...\n";
+        s = inject_cancellation_checks(s);
+        debug(2) << "Lowering after injecting cancellation checks:\n" << s << "\n\n";
+    }
+
     if (t.has_feature(Target::FuzzFloatStores)) {
+        timer.next("Fuzzing floating point stores", s);
         debug(1) << "Fuzzing floating point stores...\n";
         s = fuzz_float_stores(s);
         debug(2) << "Lowering after fuzzing floating point stores:\n" << s << "\n\n";
     }
 
+    timer.next("Emulating half-precision arithmetic", s);
+    debug(1) << "Emulating half-precision arithmetic...\n";
+    s = emulate_float16_math(s, t);
+    debug(2) << "Lowering after emulating half-precision arithmetic:\n" << s << "\n\n";
+
+    // Hexagon does this itself, along with its other load
+    // optimizations, during codegen.
+    if (t.arch != Target::Hexagon) {
+        timer.next("Aligning overlapping loads", s);
+        debug(1) << "Aligning overlapping loads...\n";
+        // Carry values in about half the vector registers, leaving
+        // the rest for the arithmetic.
+        bool many_registers = ((t.arch == Target::ARM && t.bits == 64) ||
+                               t.has_feature(Target::AVX512) ||
+                               t.has_feature(Target::AVX512_KNL) ||
+                               t.has_feature(Target::AVX512_Skylake) ||
+                               t.has_feature(Target::AVX512_Cannonlake));
+        int vector_registers = many_registers ? 32 : 16;
+        s = align_overlapping_loads(s, t.natural_vector_size(Int(8)), vector_registers / 2);
+        debug(2) << "Lowering after aligning overlapping loads:\n" << s << "\n\n";
+    }
+
+    timer.next("Common subexpression elimination", s);
     debug(1) << "Simplifying...\n";
     s = common_subexpression_elimination(s);
 
     if (t.has_feature(Target::OpenGL)) {
+        timer.next("Detecting varying attributes", s);
         debug(1) << "Detecting varying attributes...\n";
         s = find_linear_expressions(s);
         debug(2) << "Lowering after detecting varying attributes:\n" << s << "\n\n";
 
+        timer.next("Moving varying attribute expressions out of the shader", s);
         debug(1) << "Moving varying attribute expressions out of the shader...\n";
         s = setup_gpu_vertex_buffer(s);
         debug(2) << "Lowering after removing varying attributes:\n" << s << "\n\n";
     }
 
+    timer.next("Final simplification", s);
     s = remove_dead_allocations(s);
     s = remove_trivial_for_loops(s);
     s = simplify(s);
     debug(1) << "Lowering after final simplification:\n" << s << "\n\n";
 
+    timer.next("Marking adaptive parallel loops", s);
+    debug(1) << "Marking adaptive parallel loops...\n";
+    s = mark_adaptive_parallel_loops(s, env);
+    debug(2) << "Lowering after marking adaptive parallel loops:\n" << s << "\n\n";
+
+    timer.next("Splitting off Hexagon offload", s);
     debug(1) << "Splitting off Hexagon offload...\n";
     s = inject_hexagon_rpc(s, t);
     debug(2) << "Lowering after splitting off Hexagon offload:\n" << s << '\n';
 
     if (!custom_passes.empty()) {
         for (size_t i = 0; i < custom_passes.size(); i++) {
+            timer.next("Custom lowering pass " + std::to_string(i), s);
             debug(1) << "Running custom lowering pass " << i << "...\n";
             s = custom_passes[i]->mutate(s);
             debug(1) << "Lowering after custom pass " << i << ":\n" << s << "\n\n";
         }
     }
 
+    timer.done(s);
+    if (report_code_size()) {
+        code_size_budget.report(s, pipeline_name);
+    }
+
     return s;
 }
 
@@ -0,0 +1,413 @@
+#include "LowerWarpShuffles.h"
+#include "CodeGen_GPU_Dev.h"
+#include "ExprUsesVar.h"
+#include "IRMutator.h"
+#include "IROperator.h"
+#include "Simplify.h"
+#include "Substitute.h"
+
+namespace Halide {
+namespace Internal {
+
+using std::map;
+using std::pair;
+using std::string;
+using std::vector;
+
+namespace {
+
+const int warp_size = 32;
+
+// The enclosing lets, outermost first. Indices and extents are
+// usually written in terms of lets, which hide both the lane variable
+// and the symbolic mins that cancel, so expand them before analysis.
+struct EnclosingLets {
+    vector<pair<string, Expr>> lets;
+
+    Expr expand(Expr e) const {
+        for (size_t i = lets.size(); i > 0; i--) {
+            if (expr_uses_var(e, lets[i - 1].first)) {
+                e = substitute(lets[i - 1].first, lets[i - 1].second, e);
+            }
+        }
+        return simplify(e);
+    }
+};
+
+// Find the x extent of the thread block of a kernel, which is the
+// largest extent of the loops over thread_id_x in it.
+class BlockXExtent : public IRVisitor {
+    using IRVisitor::visit;
+
+    EnclosingLets lets;
+
+    void visit(const LetStmt *op) {
+        op->value.accept(this);
+        lets.lets.push_back({op->name, op->value});
+        op->body.accept(this);
+        lets.lets.pop_back();
+    }
+
+    void visit(const For *op) {
+        if (ends_with(op->name, ".__thread_id_x")) {
+            const int64_t *e = as_const_int(lets.expand(op->extent));
+            if (e) {
+                extent = std::max(extent, (int)*e);
+            } else {
+                constant = false;
+            }
+        }
+        IRVisitor::visit(op);
+    }
+
+public:
+    BlockXExtent(const EnclosingLets &l) : lets(l) {}
+
+    int extent = 0;
+    bool constant = true;
+};
+
+// Find whether a Stmt touches an allocation, and whether it does so
+// anywhere outside a gpu_lanes loop.
+class FindLaneAccesses : public IRVisitor {
+    using IRVisitor::visit;
+
+    const string &name;
+    int lane_depth = 0;
+
+    void found() {
+        accessed = true;
+        outside_lanes |= (lane_depth == 0);
+    }
+
+    void visit(const For *op) {
+        bool lane = (op->for_type == ForType::GPULane);
+        lane_depth += lane;
+        IRVisitor::visit(op);
+        lane_depth -= lane;
+    }
+
+    void visit(const Load *op) {
+        if (op->name == name) {
+            found();
+        }
+        IRVisitor::visit(op);
+    }
+
+    void visit(const Store *op) {
+        if (op->name == name) {
+            found();
+        }
+        IRVisitor::visit(op);
+    }
+
+public:
+    FindLaneAccesses(const string &n) : name(n) {}
+
+    bool accessed = false, outside_lanes = false;
+};
+
+// The value of e on lane src of each segment of the warp that is
+// lanes wide, using the PTX shuffle. Everything is shuffled as 32-bit
+// words.
+Expr shuffle(Expr e, Expr src, int lanes) {
+    Type t = e.type();
+    user_assert(t.is_scalar() && !t.is_handle())
+        << "Can't shuffle " << e << " of type " << t << " between the lanes of a warp.\n";
+
+    // The segment mask and the clamp value, as for __shfl(e, src, lanes).
+    Expr c = make_const(Int(32), ((warp_size - lanes) << 8) | (warp_size - 1));
+
+    if (t == Float(32)) {
+        return Call::make(t, "llvm.nvvm.shfl.idx.f32", {e, src, c}, Call::Extern);
+    } else if (t.bits() == 64) {
+        Expr bits = reinterpret(UInt(64), e);
+        Expr lo = shuffle(cast(UInt(32), bits), src, lanes);
+        Expr hi = shuffle(cast(UInt(32), bits >> make_const(UInt(64), 32)), src, lanes);
+        bits = cast(UInt(64), lo) | (cast(UInt(64), hi) << make_const(UInt(64), 32));
+        return reinterpret(t, bits);
+    }
+
+    Expr word = t.is_float() ? reinterpret(UInt(t.bits()), e) : e;
+    word = (t == Int(32)) ? word : cast(Int(32), word);
+    Expr result = Call::make(Int(32), "llvm.nvvm.shfl.idx.i32", {word, src, c}, Call::Extern);
+    if (t == Int(32)) {
+        return result;
+    } else if (t.is_float()) {
+        return reinterpret(t, cast(UInt(t.bits()), result));
+    } else {
+        return cast(t, result);
+    }
+}
+
+class LowerWarpShuffles : public IRMutator {
+    using IRMutator::visit;
+
+    EnclosingLets lets;
+
+    // The x extent of the thread block of the enclosing kernel, or
+    // zero if it isn't constant.
+    int block_x_extent = 0;
+    bool in_kernel = false;
+
+    // The number of enclosing GPU thread loops, not counting gpu_lanes
+    // loops.
+    int thread_depth = 0;
+
+    // The enclosing gpu_lanes loop, the lane index within it, and its
+    // extent, or zero if that isn't constant.
+    string lane_loop;
+    Expr lane;
+    int lanes = 0;
+    DeviceAPI lane_device_api = DeviceAPI::None;
+
+    // Whether we're under control flow that varies across the lanes,
+    // where a shuffle would read lanes that aren't running.
+    bool divergent = false;
+
+    struct LaneAllocation {
+        int size;
+        // The extent of the gpu_lanes loops that access it. Zero until
+        // the first access.
+        int lanes;
+
+        int slots() const {
+            return (size + lanes - 1) / lanes;
+        }
+    };
+    map<string, LaneAllocation> allocations;
+
+    LaneAllocation &lane_allocation(const string &name) {
+        LaneAllocation &a = allocations[name];
+        user_assert(lane_device_api == DeviceAPI::CUDA)
+            << "Func " << name << " is computed and used within gpu_lanes loops, "
+            << "so it is stored in the lanes of a warp. "
+            << "This is only supported on CUDA.\n";
+        user_assert(lanes > 0 && lanes <= warp_size && (lanes & (lanes - 1)) == 0)
+            << "The gpu_lanes loop " << lane_loop << " accesses Func " << name
+            << ", which is stored in the lanes of a warp, so its extent must be "
+            << "a constant power of two no greater than " << warp_size << ".\n";
+        user_assert(block_x_extent > 0 && block_x_extent % lanes == 0)
+            << "The gpu_lanes loop " << lane_loop << " accesses Func " << name
+            << ", which is stored in the lanes of a warp, so the x extent of the "
+            << "GPU thread block must be a constant multiple of its extent ("
+            << lanes << ").\n";
+        if (a.lanes == 0) {
+            a.lanes = lanes;
+        }
+        user_assert(a.lanes == lanes)
+            << "Func " << name << " is stored in the lanes of a warp, but is accessed "
+            << "in gpu_lanes loops of different extents (" << a.lanes
+            << " and " << lanes << ").\n";
+        return a;
+    }
+
+    template<typename LetOrLetStmt, typename Body>
+    Body visit_let(const LetOrLetStmt *op, Body body) {
+        Expr value = mutate(op->value);
+        lets.lets.push_back({op->name, value});
+        Body new_body = mutate(body);
+        lets.lets.pop_back();
+        if (value.same_as(op->value) && new_body.same_as(body)) {
+            return op;
+        }
+        return LetOrLetStmt::make(op->name, value, new_body);
+    }
+
+    void visit(const Let *op) {
+        expr = visit_let(op, op->body);
+    }
+
+    void visit(const LetStmt *op) {
+        stmt = visit_let(op, op->body);
+    }
+
+    void visit(const For *op) {
+        if (op->for_type == ForType::GPUBlock && !in_kernel) {
+            BlockXExtent b(lets);
+            op->accept(&b);
+            block_x_extent = b.constant ? b.extent : 0;
+            in_kernel = true;
+            IRMutator::visit(op);
+            in_kernel = false;
+        } else if (op->for_type == ForType::GPUThread) {
+            thread_depth++;
+            IRMutator::visit(op);
+            thread_depth--;
+        } else if (op->for_type == ForType::GPULane) {
+            Expr min = mutate(op->min);
+            Expr extent = mutate(op->extent);
+
+            string old_lane_loop = lane_loop;
+            Expr old_lane = lane;
+            int old_lanes = lanes;
+            DeviceAPI old_device_api = lane_device_api;
+            bool old_divergent = divergent;
+
+            lane_loop = op->name;
+            lane = Variable::make(Int(32), op->name) - min;
+            const int64_t *e = as_const_int(lets.expand(extent));
+            lanes = e ? (int)*e : 0;
+            lane_device_api = op->device_api;
+            divergent = false;
+
+            Stmt body = mutate(op->body);
+
+            lane_loop = old_lane_loop;
+            lane = old_lane;
+            lanes = old_lanes;
+            lane_device_api = old_device_api;
+            divergent = old_divergent;
+
+            // From here on it's an ordinary GPU thread loop.
+            stmt = For::make(op->name, min, extent, ForType::GPUThread, op->device_api, body);
+        } else {
+            IRMutator::visit(op);
+        }
+    }
+
+    void visit(const IfThenElse *op) {
+        if (lane_loop.empty()) {
+            IRMutator::visit(op);
+            return;
+        }
+        Expr condition = mutate(op->condition);
+        bool old_divergent = divergent;
+        divergent |= expr_uses_var(lets.expand(condition), lane_loop);
+        Stmt then_case = mutate(op->then_case);
+        Stmt else_case = mutate(op->else_case);
+        divergent = old_divergent;
+        if (condition.same_as(op->condition) &&
+            then_case.same_as(op->then_case) &&
+            else_case.same_as(op->else_case)) {
+            stmt = op;
+        } else {
+            stmt = IfThenElse::make(condition, then_case, else_case);
+        }
+    }
+
+    void visit(const Allocate *op) {
+        if (!in_kernel || thread_depth == 0 || !lane_loop.empty()) {
+            IRMutator::visit(op);
+            return;
+        }
+
+        // Allocations inside GPU thread loops are private to each
+        // thread. If one is only used by gpu_lanes loops, the lanes
+        // of the warp share it instead.
+        FindLaneAccesses accesses(op->name);
+        op->body.accept(&accesses);
+        if (!accesses.accessed || accesses.outside_lanes) {
+            IRMutator::visit(op);
+            return;
+        }
+
+        int size = 1;
+        for (Expr e : op->extents) {
+            const int64_t *extent = as_const_int(lets.expand(e));
+            user_assert(extent)
+                << "Func " << op->name << " is computed and used within gpu_lanes loops, "
+                << "so it is stored in the lanes of a warp, and must have a constant size.\n";
+            size *= (int)*extent;
+        }
+
+        allocations[op->name] = {size, 0};
+        Stmt body = mutate(op->body);
+        LaneAllocation a = allocations[op->name];
+        allocations.erase(op->name);
+
+        debug(3) << "Storing " << op->name << " in the lanes of a warp, "
+                 << a.slots() << " elements per lane\n";
+
+        stmt = Allocate::make(op->name, op->type, op->memory_type, {a.slots()},
+                              op->condition, body, op->new_expr, op->free_function);
+    }
+
+    void visit(const Store *op) {
+        if (!allocations.count(op->name)) {
+            IRMutator::visit(op);
+            return;
+        }
+        const LaneAllocation &a = lane_allocation(op->name);
+
+        Expr value = mutate(op->value);
+        Expr index = mutate(op->index);
+
+        // Element i lives in slot i / lanes of lane i % lanes, so each
+        // lane can only store to its own elements.
+        Expr offset = lets.expand(index - lane);
+        user_assert(!expr_uses_var(offset, lane_loop) &&
+                    can_prove(offset % a.lanes == 0))
+            << "In the gpu_lanes loop " << lane_loop << ", Func " << op->name
+            << " is stored at index " << index << ", which doesn't belong to the "
+            << "storing lane. Funcs stored in the lanes of a warp must be computed "
+            << "with the element at index i on lane i % " << a.lanes << ". "
+            << "Try splitting the producer's gpu_lanes dimension by " << a.lanes
+            << " with TailStrategy::RoundUp.\n";
+
+        stmt = Store::make(op->name, value, simplify(offset / a.lanes), op->param);
+    }
+
+    void visit(const Load *op) {
+        if (!allocations.count(op->name)) {
+            IRMutator::visit(op);
+            return;
+        }
+        const LaneAllocation &a = lane_allocation(op->name);
+        const int slots = a.slots();
+
+        Expr index = mutate(op->index);
+        Expr offset = lets.expand(index - lane);
+
+        auto load = [&](Expr slot) {
+            return Load::make(op->type, op->name, slot, op->image, op->param);
+        };
+
+        if (!expr_uses_var(offset, lane_loop) &&
+            can_prove(offset % a.lanes == 0)) {
+            // The lane's own element.
+            expr = load(simplify(offset / a.lanes));
+            return;
+        }
+
+        user_assert(!divergent)
+            << "In the gpu_lanes loop " << lane_loop << ", Func " << op->name
+            << " is loaded from other lanes under a condition that varies across "
+            << "the lanes. Shuffles between the lanes of a warp need all of them.\n";
+
+        if (!expr_uses_var(offset, lane_loop)) {
+            // Every lane loads the same distance away, as in a
+            // stencil. The elements span at most two adjacent slots,
+            // split at the lane that wraps around.
+            Expr slot = simplify(offset / a.lanes);
+            Expr rotation = simplify(offset % a.lanes);
+            Expr src = (lane + rotation) % a.lanes;
+            Expr lo = shuffle(load(clamp(slot, 0, slots - 1)), src, a.lanes);
+            if (slots == 1) {
+                expr = lo;
+            } else {
+                Expr hi = shuffle(load(clamp(slot + 1, 0, slots - 1)), src, a.lanes);
+                expr = select(lane + rotation < a.lanes, lo, hi);
+            }
+        } else {
+            // Each lane may want a different slot, so shuffle all of
+            // them and pick.
+            Expr src = index % a.lanes;
+            Expr slot = index / a.lanes;
+            Expr result = shuffle(load(0), src, a.lanes);
+            for (int i = 1; i < slots; i++) {
+                result = select(slot == i, shuffle(load(i), src, a.lanes), result);
+            }
+            expr = result;
+        }
+    }
+};
+
+}  // anonymous namespace
+
+Stmt lower_warp_shuffles(Stmt s) {
+    return LowerWarpShuffles().mutate(s);
+}
+
+}
+}
@@ -0,0 +1,27 @@
+#ifndef HALIDE_LOWER_WARP_SHUFFLES_H
+#define HALIDE_LOWER_WARP_SHUFFLES_H
+
+/** \file
+ * Defines the lowering pass that stores Funcs computed by the lanes of
+ * a GPU warp in registers, and turns loads of them into warp shuffles.
+ */
+
+#include "IR.h"
+
+namespace Halide {
+namespace Internal {
+
+/** Find the allocations inside GPU thread loops that are only
+ * accessed within gpu_lanes loops, and distribute them across the
+ * lanes of the warp: element i lives in register slot i / lanes of
+ * lane i % lanes. Stores must address the storing lane's own
+ * elements. Loads of another lane's elements become shuffles. Then
+ * turn every gpu_lanes loop into an ordinary GPU thread loop. Must be
+ * called after storage flattening and after the GPU APIs have been
+ * selected, and before the GPU thread loops are fused. */
+Stmt lower_warp_shuffles(Stmt s);
+
+}
+}
+
+#endif
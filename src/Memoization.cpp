@@ -148,6 +148,8 @@ class KeyInfo {
     Expr key_size_expr;
     const std::string &top_level_name;
     const std::string &function_name;
+    int priority;
+    int64_t max_bytes;
 
     size_t parameters_alignment() {
         int32_t max_alignment = 0;
@@ -194,7 +196,9 @@ class KeyInfo {
 
 public:
   KeyInfo(const Function &function, const std::string &name)
-        : top_level_name(name), function_name(function.name())
+        : top_level_name(name), function_name(function.name()),
+          priority(function.schedule().memoize_priority()),
+          max_bytes(function.schedule().memoize_max_bytes())
     {
         dependencies.visit_function(function);
         size_t size_so_far = 0;
@@ -322,6 +326,10 @@ public:
         }
         args.push_back(Call::make(type_of<buffer_t **>(), Call::make_struct, buffers, Call::Intrinsic));
 
+        // Identify the Func for the cache statistics.
+        args.push_back(StringImm::make(top_level_name));
+        args.push_back(StringImm::make(function_name));
+
         return Call::make(Int(32), "halide_memoization_cache_lookup", args, Call::Extern);
     }
 
@@ -345,6 +353,12 @@ public:
         }
         args.push_back(Call::make(type_of<buffer_t **>(), Call::make_struct, buffers, Call::Intrinsic));
 
+        // Identify the Func, and pass its eviction priority and byte budget.
+        args.push_back(StringImm::make(top_level_name));
+        args.push_back(StringImm::make(function_name));
+        args.push_back(priority);
+        args.push_back(make_const(Int(64), max_bytes));
+
         // This is actually a void call. How to indicate that? Look at Extern_ stuff.
         return Evaluate::make(Call::make(Int(32), "halide_memoization_cache_store", args, Call::Extern));
     }
@@ -428,7 +442,7 @@ private:
 
             Stmt generate_key = Block::make(key_info.generate_key(cache_key_name), computed_bounds_let);
             Stmt cache_key_alloc =
-                Allocate::make(cache_key_name, UInt(8), {key_info.key_size()},
+                Allocate::make(cache_key_name, UInt(8), MemoryType::Auto, {key_info.key_size()},
                                const_true(), generate_key);
 
             stmt = Realize::make(op->name, op->types, op->bounds, op->condition, cache_key_alloc);
@@ -566,7 +580,7 @@ private:
                 const Allocate *allocation = allocations[i - 1];
 
                 // Make the allocation node
-                body = Allocate::make(allocation->name, allocation->type, allocation->extents, allocation->condition, body,
+                body = Allocate::make(allocation->name, allocation->type, allocation->memory_type, allocation->extents, allocation->condition, body,
                                       Call::make(Handle(), Call::buffer_get_host,
                                                  { Variable::make(type_of<struct buffer_t *>(), allocation->name + ".buffer") }, Call::Extern),
                                       "halide_memoization_cache_release");
@@ -0,0 +1,179 @@
+#include <map>
+
+#include "CodeSize.h"
+#include "IRVisitor.h"
+#include "MemoryTraffic.h"
+#include "Util.h"
+
+namespace Halide {
+namespace Internal {
+
+using std::map;
+using std::string;
+using std::vector;
+
+namespace {
+
+class CountTraffic : public IRVisitor {
+    using IRVisitor::visit;
+
+    // The Funcs whose produce nodes we are in, innermost last.
+    vector<string> funcs;
+
+    // The product of the trip counts of the enclosing loops.
+    double weight = 1;
+
+    // Whether we're in the loops of an update definition of the
+    // innermost Func, whose stores aren't points.
+    bool in_update = false;
+
+    // Whether we're computing a value to store, rather than an
+    // address or a loop bound.
+    bool in_value = false;
+
+    struct Totals {
+        double loaded = 0, stored = 0, ops = 0, points = 0;
+    };
+
+    Totals *current() {
+        return funcs.empty() ? nullptr : &totals[funcs.back()];
+    }
+
+    void count_op(const Type &t) {
+        Totals *c = current();
+        if (in_value && c) {
+            c->ops += weight * t.lanes();
+        }
+    }
+
+    void visit(const ProducerConsumer *op) {
+        if (!op->is_producer) {
+            // The code consuming a Func belongs to the Func it's in.
+            IRVisitor::visit(op);
+            return;
+        }
+        bool old_in_update = in_update;
+        funcs.push_back(op->name);
+        in_update = false;
+        op->body.accept(this);
+        funcs.pop_back();
+        in_update = old_in_update;
+    }
+
+    void visit(const For *op) {
+        bool old_in_update = in_update;
+        if (!funcs.empty()) {
+            const string prefix = funcs.back() + ".s";
+            if (starts_with(op->name, prefix)) {
+                in_update = !starts_with(op->name, prefix + "0.");
+            }
+        }
+        double old_weight = weight;
+        weight *= CodeSizeBudget::trip_count(op->extent);
+        op->body.accept(this);
+        weight = old_weight;
+        in_update = old_in_update;
+    }
+
+    void visit(const Load *op) {
+        Totals *c = current();
+        if (c) {
+            c->loaded += weight * op->type.bytes() * op->type.lanes();
+        }
+        bool old_in_value = in_value;
+        in_value = false;
+        op->index.accept(this);
+        in_value = old_in_value;
+    }
+
+    void visit(const Store *op) {
+        Totals *c = current();
+        if (c) {
+            const Type &t = op->value.type();
+            c->stored += weight * t.bytes() * t.lanes();
+            const string &f = funcs.back();
+            if (!in_update && (op->name == f || op->name == f + ".0")) {
+                c->points += weight * t.lanes();
+            }
+        }
+        in_value = true;
+        op->value.accept(this);
+        in_value = false;
+        op->index.accept(this);
+    }
+
+    void visit(const LetStmt *op) {
+        // Values computed ahead of the stores that use them (e.g. by
+        // CSE) are vectors or floats; scalar integers are mostly
+        // addresses and loop bounds.
+        Type t = op->value.type();
+        in_value = !t.is_scalar() || t.is_float();
+        op->value.accept(this);
+        in_value = false;
+        op->body.accept(this);
+    }
+
+    void visit(const Call *op) {
+        if ((op->call_type == Call::PureExtern || op->call_type == Call::PureIntrinsic) &&
+            !op->is_intrinsic(Call::likely) &&
+            !op->is_intrinsic(Call::likely_if_innermost) &&
+            !op->is_intrinsic(Call::reinterpret)) {
+            count_op(op->type);
+        }
+        IRVisitor::visit(op);
+    }
+
+#define COUNT_OP(T)                 \
+    void visit(const T *op) {       \
+        count_op(op->type);         \
+        IRVisitor::visit(op);       \
+    }
+
+    COUNT_OP(Add)
+    COUNT_OP(Sub)
+    COUNT_OP(Mul)
+    COUNT_OP(Div)
+    COUNT_OP(Mod)
+    COUNT_OP(Min)
+    COUNT_OP(Max)
+    COUNT_OP(EQ)
+    COUNT_OP(NE)
+    COUNT_OP(LT)
+    COUNT_OP(LE)
+    COUNT_OP(GT)
+    COUNT_OP(GE)
+    COUNT_OP(And)
+    COUNT_OP(Or)
+    COUNT_OP(Not)
+    COUNT_OP(Select)
+
+#undef COUNT_OP
+
+public:
+    map<string, Totals> totals;
+};
+
+}  // namespace
+
+vector<FuncTraffic> estimate_memory_traffic(const Stmt &s) {
+    CountTraffic counter;
+    s.accept(&counter);
+
+    vector<FuncTraffic> result;
+    for (const auto &iter : counter.totals) {
+        const double points = iter.second.points;
+        if (points <= 0) {
+            continue;
+        }
+        FuncTraffic t;
+        t.name = iter.first;
+        t.bytes_loaded = iter.second.loaded / points;
+        t.bytes_stored = iter.second.stored / points;
+        t.ops = iter.second.ops / points;
+        result.push_back(t);
+    }
+    return result;
+}
+
+}
+}
@@ -0,0 +1,41 @@
+#ifndef HALIDE_MEMORY_TRAFFIC_H
+#define HALIDE_MEMORY_TRAFFIC_H
+
+/** \file
+ * Defines a static estimate of the memory traffic and arithmetic of
+ * each Func in a lowered pipeline, for comparing the throughput each
+ * one achieves with the peak bandwidth and arithmetic throughput of a
+ * machine.
+ */
+
+#include <string>
+#include <vector>
+
+#include "IR.h"
+
+namespace Halide {
+namespace Internal {
+
+/** Estimates of the work done per point of a Func, where a point is
+ * one value stored by its pure definition (all the values of a Tuple
+ * together count as one). The bytes loaded and stored include those
+ * of its update definitions, and of the Funcs inlined into it. The
+ * ops are the arithmetic on the values it stores, counting each
+ * vector lane, but not the arithmetic on addresses. */
+struct FuncTraffic {
+    std::string name;
+    double bytes_loaded = 0, bytes_stored = 0, ops = 0;
+};
+
+/** Estimate the work per point of each Func computed in s, from the
+ * loads, stores and arithmetic in its produce nodes, weighted by the
+ * trip counts of the loops around them. Loops of unknown extent are
+ * assumed to run as many times as CodeSizeBudget::trip_count
+ * says. Returns an entry for each Func that stores any points, in
+ * order of name. */
+std::vector<FuncTraffic> estimate_memory_traffic(const Stmt &s);
+
+}
+}
+
+#endif
@@ -1,7 +1,13 @@
 #include "Module.h"
 
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <exception>
 #include <fstream>
+#include <functional>
+#include <mutex>
+#include <thread>
 
 #include "CodeGen_C.h"
 #include "CodeGen_Internal.h"
@@ -70,9 +76,11 @@ Outputs add_suffixes(const Outputs &in, const std::string &suffix) {
     if (!in.assembly_name.empty()) out.assembly_name = add_suffix(in.assembly_name, suffix);
     if (!in.bitcode_name.empty()) out.bitcode_name = add_suffix(in.bitcode_name, suffix);
     if (!in.llvm_assembly_name.empty()) out.llvm_assembly_name = add_suffix(in.llvm_assembly_name, suffix);
+    if (!in.thin_lto_bitcode_name.empty()) out.thin_lto_bitcode_name = add_suffix(in.thin_lto_bitcode_name, suffix);
     if (!in.c_source_name.empty()) out.c_source_name = add_suffix(in.c_source_name, suffix);
     if (!in.stmt_name.empty()) out.stmt_name = add_suffix(in.stmt_name, suffix);
     if (!in.stmt_html_name.empty()) out.stmt_html_name = add_suffix(in.stmt_html_name, suffix);
+    out.pgo_profile_name = in.pgo_profile_name;
     return out;
 }
 
@@ -169,9 +177,9 @@ Module link_modules(const std::string &name, const std::vector<Module> &modules)
 void Module::compile(const Outputs &output_files) const {
     if (!output_files.object_name.empty() || !output_files.assembly_name.empty() ||
         !output_files.bitcode_name.empty() || !output_files.llvm_assembly_name.empty() ||
-        !output_files.static_library_name.empty()) {
+        !output_files.thin_lto_bitcode_name.empty() || !output_files.static_library_name.empty()) {
         llvm::LLVMContext context;
-        std::unique_ptr<llvm::Module> llvm_module(compile_module_to_llvm_module(*this, context));
+        std::unique_ptr<llvm::Module> llvm_module(compile_module_to_llvm_module(*this, context, output_files.pgo_profile_name));
 
         if (!output_files.object_name.empty() || !output_files.static_library_name.empty()) {
             // We must always generate the object files here, either because they are
@@ -214,6 +222,11 @@ void Module::compile(const Outputs &output_files) const {
             auto out = make_raw_fd_ostream(output_files.llvm_assembly_name);
             compile_llvm_module_to_llvm_assembly(*llvm_module, *out);
         }
+        if (!output_files.thin_lto_bitcode_name.empty()) {
+            debug(1) << "Module.compile(): thin_lto_bitcode_name " << output_files.thin_lto_bitcode_name << "\n";
+            auto out = make_raw_fd_ostream(output_files.thin_lto_bitcode_name);
+            compile_llvm_module_to_thin_lto_bitcode(*llvm_module, *out);
+        }
     }
     if (!output_files.c_header_name.empty()) {
         debug(1) << "Module.compile(): c_header_name " << output_files.c_header_name << "\n";
@@ -245,9 +258,11 @@ void Module::compile(const Outputs &output_files) const {
 
 Outputs compile_standalone_runtime(const Outputs &output_files, Target t) {
     Module empty("standalone_runtime", t.without_feature(Target::NoRuntime).without_feature(Target::JIT));
-    // For runtime, it only makes sense to output object files or static_library, so ignore
-    // everything else.
-    Outputs actual_outputs = Outputs().object(output_files.object_name).static_library(output_files.static_library_name);
+    // For runtime, it only makes sense to output object files, static_library or ThinLTO
+    // bitcode, so ignore everything else.
+    Outputs actual_outputs = Outputs().object(output_files.object_name)
+                                      .static_library(output_files.static_library_name)
+                                      .thin_lto_bitcode(output_files.thin_lto_bitcode_name);
     empty.compile(actual_outputs);
     return actual_outputs;
 }
@@ -256,6 +271,62 @@ void compile_standalone_runtime(const std::string &object_filename, Target t) {
     compile_standalone_runtime(Outputs().object(object_filename), t);
 }
 
+namespace Internal {
+
+void compile_in_parallel(const std::vector<std::function<void()>> &jobs, bool serial) {
+    size_t defined = 0;
+    std::string threads_str = Internal::get_env_variable("HL_COMPILE_THREADS", defined);
+    size_t threads = std::thread::hardware_concurrency();
+    if (defined) {
+        threads = atoi(threads_str.c_str());
+    }
+    // LLVM's pass timers aren't thread-safe.
+    if (serial || threads < 1 || report_pass_times()) {
+        threads = 1;
+    }
+    threads = std::min(threads, jobs.size());
+
+    if (threads <= 1) {
+        for (const auto &job : jobs) {
+            job();
+        }
+        return;
+    }
+
+    debug(1) << "compile_in_parallel: running " << jobs.size() << " jobs on " << threads << " threads\n";
+
+    // Errors are reported by throwing, so carry the first one back to
+    // this thread.
+    std::atomic<size_t> next_job(0);
+    std::exception_ptr error;
+    std::mutex error_mutex;
+    auto worker = [&]() {
+        for (size_t i = next_job++; i < jobs.size(); i = next_job++) {
+            try {
+                jobs[i]();
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(error_mutex);
+                if (!error) {
+                    error = std::current_exception();
+                }
+            }
+        }
+    };
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < threads; i++) {
+        workers.emplace_back(worker);
+    }
+    worker();
+    for (auto &w : workers) {
+        w.join();
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+}  // namespace Internal
+
 void compile_multitarget(const std::string &fn_name,
                          const Outputs &output_files,
                          const std::vector<Target> &targets,
@@ -269,6 +340,7 @@ void compile_multitarget(const std::string &fn_name,
     // if different values for NoRuntime are specified)... so just forbid
     // it up front.
     user_assert(output_files.object_name.empty()) << "Cannot request object_name for compile_multitarget.\n";
+    user_assert(output_files.thin_lto_bitcode_name.empty()) << "Cannot request thin_lto_bitcode_name for compile_multitarget.\n";
 
     // The final target in the list is considered "baseline", and is used
     // for (e.g.) the runtime and shared code. It is often just os-arch-bits
@@ -288,6 +360,11 @@ void compile_multitarget(const std::string &fn_name,
     TemporaryObjectFileDir temp_dir;
     std::vector<Expr> wrapper_args;
     std::vector<LoweredArgument> base_target_args;
+    // Lowering isn't thread-safe, so produce the modules one at a time,
+    // then compile them concurrently.
+    std::vector<std::function<void()>> jobs;
+    // The Hexagon backend sets global LLVM options when it runs.
+    bool serial = false;
     for (const Target &target : targets) {
         // arch-bits-os must be identical across all targets.
         if (target.os != base_target.os ||
@@ -332,7 +409,8 @@ void compile_multitarget(const std::string &fn_name,
         if (sub_out.object_name.empty()) {
             sub_out.object_name = temp_dir.add_temp_object_file(output_files.static_library_name, suffix, target);
         }
-        module.compile(sub_out);
+        jobs.push_back([module, sub_out]() { module.compile(sub_out); });
+        serial = serial || target.features_any_of({Target::HVX_64, Target::HVX_128});
 
         static_assert(sizeof(uint64_t)*8 >= Target::FeatureEnd, "Features will not fit in uint64_t");
         uint64_t feature_bits = 0;
@@ -357,8 +435,8 @@ void compile_multitarget(const std::string &fn_name,
     // and add that to the result.
     if (!base_target.has_feature(Target::NoRuntime)) {
         const Target runtime_target = base_target.without_feature(Target::NoRuntime);
-        compile_standalone_runtime(Outputs().object(temp_dir.add_temp_object_file(output_files.static_library_name, "_runtime", runtime_target)),
-            runtime_target);
+        Outputs runtime_out = Outputs().object(temp_dir.add_temp_object_file(output_files.static_library_name, "_runtime", runtime_target));
+        jobs.push_back([runtime_out, runtime_target]() { compile_standalone_runtime(runtime_out, runtime_target); });
     }
 
     Expr indirect_result = Call::make(Int(32), Call::call_cached_indirect_function, wrapper_args, Call::Intrinsic);
@@ -376,10 +454,17 @@ void compile_multitarget(const std::string &fn_name,
     // does mean we get redundant check-for-null tests in the wrapper code for buffer_t*
     // arguments; this is regrettable but fairly minor in terms of both code size and speed,
     // at least for real-world code.)
+    //
+    // Always build without FastMath and MSAN: each sub-function sets up the
+    // float environment and annotates its outputs itself, and doing it again in
+    // the wrapper would cost more than the dispatch on every call, and keep the
+    // call to the sub-function from being a tail call.
     Target wrapper_target = base_target
         .with_feature(Target::NoRuntime)
         .with_feature(Target::NoBoundsQuery)
-        .without_feature(Target::NoAsserts);
+        .without_feature(Target::NoAsserts)
+        .without_feature(Target::FastMath)
+        .without_feature(Target::MSAN);
 
     // If the base target specified the Matlab target, we want the Matlab target
     // on the wrapper instead.
@@ -389,7 +474,10 @@ void compile_multitarget(const std::string &fn_name,
 
     Module wrapper_module(fn_name, wrapper_target);
     wrapper_module.append(LoweredFunc(fn_name, base_target_args, wrapper_body, LoweredFunc::External));
-    wrapper_module.compile(Outputs().object(temp_dir.add_temp_object_file(output_files.static_library_name, "_wrapper", base_target, /* in_front*/ true)));
+    Outputs wrapper_out = Outputs().object(temp_dir.add_temp_object_file(output_files.static_library_name, "_wrapper", base_target, /* in_front*/ true));
+    jobs.push_back([wrapper_module, wrapper_out]() { wrapper_module.compile(wrapper_out); });
+
+    compile_in_parallel(jobs, serial);
 
     if (!output_files.c_header_name.empty()) {
         debug(1) << "compile_multitarget: c_header_name " << output_files.c_header_name << "\n";
@@ -10,6 +10,7 @@
 
 #include "Argument.h"
 #include "IR.h"
+#include "MemoryTraffic.h"
 #include "ModulusRemainder.h"
 #include "Outputs.h"
 #include "Target.h"
@@ -54,10 +55,24 @@ struct LoweredFunc {
     /** The linkage of this function. */
     LinkageType linkage;
 
+    /** Estimates of the memory traffic and arithmetic of the Funcs
+     * this function computes, embedded in its metadata. Empty for
+     * functions that aren't pipelines. */
+    std::vector<FuncTraffic> traffic;
+
     LoweredFunc(const std::string &name, const std::vector<LoweredArgument> &args, Stmt body, LinkageType linkage);
     LoweredFunc(const std::string &name, const std::vector<Argument> &args, Stmt body, LinkageType linkage);
 };
 
+/** Run the given compilation jobs, several at a time, or one after
+ * the other if serial is true. Lowering, and LLVM code generation
+ * with one LLVMContext per job, are safe to run on several threads
+ * at once. The number of threads defaults to the number of cores,
+ * and can be limited with HL_COMPILE_THREADS, since each job can take
+ * a lot of memory. If any job throws, the first error is rethrown
+ * once all the jobs are done. */
+EXPORT void compile_in_parallel(const std::vector<std::function<void()>> &jobs, bool serial = false);
+
 }
 
 namespace Internal {
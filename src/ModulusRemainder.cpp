@@ -59,6 +59,7 @@ public:
     void visit(const IfThenElse *);
     void visit(const Free *);
     void visit(const Evaluate *);
+    void visit(const Atomic *);
 };
 
 ModulusRemainder modulus_remainder(Expr e) {
@@ -436,5 +437,9 @@ void ComputeModulusRemainder::visit(const Evaluate *) {
     internal_assert(false) << "modulus_remainder of statement\n";
 }
 
+void ComputeModulusRemainder::visit(const Atomic *) {
+    internal_assert(false) << "modulus_remainder of statement\n";
+}
+
 }
 }
@@ -89,6 +89,31 @@ class MonotonicVisitor : public IRVisitor {
         return Monotonic::Unknown;
     }
 
+    // The monotonicity of r times (or divided by) c, which is
+    // constant with respect to the var. Its sign needn't be a
+    // constant, so long as it's known, e.g. because it's unsigned or
+    // a clamped param.
+    Monotonic scale(Monotonic r, const Expr &c) {
+        if (r == Monotonic::Constant || r == Monotonic::Unknown) {
+            return r;
+        } else if (is_zero(c)) {
+            return Monotonic::Constant;
+        } else if (is_positive_const(c) || c.type().is_uint()) {
+            return r;
+        } else if (is_negative_const(c)) {
+            return flip(r);
+        } else if (is_const(c)) {
+            return Monotonic::Unknown;
+        }
+        Expr zero = make_zero(c.type());
+        if (can_prove(c >= zero)) {
+            return r;
+        } else if (can_prove(c <= zero)) {
+            return flip(r);
+        }
+        return Monotonic::Unknown;
+    }
+
     void visit(const Add *op) {
         op->a.accept(this);
         Monotonic ra = result;
@@ -113,18 +138,13 @@ class MonotonicVisitor : public IRVisitor {
 
         if (ra == Monotonic::Constant && rb == Monotonic::Constant) {
             result = Monotonic::Constant;
-        } else if (is_positive_const(op->a)) {
-            result = rb;
-        } else if (is_positive_const(op->b)) {
-            result = ra;
-        } else if (is_negative_const(op->a)) {
-            result = flip(rb);
-        } else if (is_negative_const(op->b)) {
-            result = flip(ra);
+        } else if (ra == Monotonic::Constant) {
+            result = scale(rb, op->a);
+        } else if (rb == Monotonic::Constant) {
+            result = scale(ra, op->b);
         } else {
             result = Monotonic::Unknown;
         }
-
     }
 
     void visit(const Div *op) {
@@ -135,17 +155,24 @@ class MonotonicVisitor : public IRVisitor {
 
         if (ra == Monotonic::Constant && rb == Monotonic::Constant) {
             result = Monotonic::Constant;
-        } else if (is_positive_const(op->b)) {
-            result = ra;
-        } else if (is_negative_const(op->b)) {
-            result = flip(ra);
+        } else if (rb == Monotonic::Constant) {
+            result = scale(ra, op->b);
         } else {
             result = Monotonic::Unknown;
         }
     }
 
     void visit(const Mod *op) {
-        result = Monotonic::Unknown;
+        op->a.accept(this);
+        Monotonic ra = result;
+        op->b.accept(this);
+        Monotonic rb = result;
+
+        if (ra == Monotonic::Constant && rb == Monotonic::Constant) {
+            result = Monotonic::Constant;
+        } else {
+            result = Monotonic::Unknown;
+        }
     }
 
     void visit(const Min *op) {
@@ -295,6 +322,19 @@ class MonotonicVisitor : public IRVisitor {
             return;
         }
 
+        // So are some math functions.
+        if (op->args.size() == 1 && op->call_type == Call::PureExtern &&
+            (op->name == "ceil_f32" || op->name == "ceil_f64" ||
+             op->name == "floor_f32" || op->name == "floor_f64" ||
+             op->name == "round_f32" || op->name == "round_f64" ||
+             op->name == "trunc_f32" || op->name == "trunc_f64" ||
+             op->name == "sqrt_f32" || op->name == "sqrt_f64" ||
+             op->name == "exp_f32" || op->name == "exp_f64" ||
+             op->name == "log_f32" || op->name == "log_f64")) {
+            op->args[0].accept(this);
+            return;
+        }
+
         for (size_t i = 0; i < op->args.size(); i++) {
             op->args[i].accept(this);
             if (result != Monotonic::Constant) {
@@ -367,6 +407,10 @@ class MonotonicVisitor : public IRVisitor {
         internal_error << "Monotonic of statement\n";
     }
 
+    void visit(const Atomic *op) {
+        internal_error << "Monotonic of statement\n";
+    }
+
 public:
     Monotonic result;
 
@@ -425,6 +469,20 @@ void is_monotonic_test() {
     check_unknown(x == y);
     check_unknown(x != y);
     check_unknown(x*y);
+    check_unknown(x % 4);
+    check_constant(y % 4);
+
+    // The sign of a factor needn't be a constant, if it's known.
+    check_increasing(x * max(y, 1));
+    check_decreasing(x * min(y, -1));
+    check_increasing(x / max(y, 1));
+    check_unknown(x * (y - 3));
+    check_increasing(cast<uint32_t>(x) * cast<uint32_t>(y));
+    check_constant(x * 0);
+
+    check_increasing(floor(cast<float>(x) / 4.0f));
+    check_decreasing(sqrt(cast<float>(-x)));
+    check_unknown(sin(cast<float>(x)));
 
     check_increasing(select(y == 2, x, x+4));
     check_decreasing(select(y == 2, -x, x*-4));
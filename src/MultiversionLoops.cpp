@@ -0,0 +1,142 @@
+#include <cstring>
+
+#include "MultiversionLoops.h"
+#include "Function.h"
+#include "IRMutator.h"
+#include "IROperator.h"
+#include "Substitute.h"
+
+namespace Halide {
+namespace Internal {
+
+using std::map;
+using std::string;
+using std::vector;
+
+namespace {
+
+const char *isa_marker = ".__isa_";
+
+// Add the features a feature implies, so that e.g. code compiled for
+// AVX2 can also use the AVX and SSE4.1 peephole optimizations.
+Target with_implied_features(Target t) {
+    const Target::Feature implies[][2] = {
+        {Target::AVX512_Cannonlake, Target::AVX512_Skylake},
+        {Target::AVX512_Skylake, Target::AVX512},
+        {Target::AVX512_KNL, Target::AVX512},
+        {Target::AVX512, Target::AVX2},
+        {Target::AVX2, Target::AVX},
+        {Target::AVX, Target::SSE41},
+    };
+    for (const auto &i : implies) {
+        if (t.has_feature(i[0])) {
+            t.set_feature(i[1]);
+        }
+    }
+    return t;
+}
+
+uint64_t feature_bits(const Target &t) {
+    static_assert(sizeof(uint64_t)*8 >= Target::FeatureEnd, "Features will not fit in uint64_t");
+    uint64_t bits = 0;
+    for (int i = 0; i < Target::FeatureEnd; i++) {
+        if (t.has_feature((Target::Feature)i)) {
+            bits |= (uint64_t)1 << i;
+        }
+    }
+    return bits;
+}
+
+class MultiversionLoops : public IRMutator {
+    const map<string, vector<Target::Feature>> &loops;
+    const Target &target;
+
+    using IRMutator::visit;
+
+    void visit(const For *op) {
+        IRMutator::visit(op);
+
+        auto it = loops.find(op->name);
+        if (it == loops.end() || op->device_api != DeviceAPI::Host) {
+            return;
+        }
+        const For *loop = stmt.as<For>();
+        internal_assert(loop);
+        user_assert(loop->for_type == ForType::Serial)
+            << "The loop over " << op->name << " is scheduled with multiversion, "
+            << "but it is not serial.\n";
+
+        // Try the variants in the order given, and fall back to the
+        // target's own loop.
+        Stmt result = stmt;
+        const vector<Target::Feature> &features = it->second;
+        for (size_t i = features.size(); i > 0; i--) {
+            Target variant = with_implied_features(target.with_feature(features[i-1]));
+            if (variant == target) {
+                continue;
+            }
+            uint64_t bits = feature_bits(variant);
+            string name = op->name + isa_marker + std::to_string(bits);
+            Stmt body = substitute(op->name, Variable::make(Int(32), name), loop->body);
+            Stmt copy = For::make(name, loop->min, loop->extent, loop->for_type, loop->device_api, body);
+            // halide_can_use_target_features caches the CPU features
+            // the first time it's called, so this check is cheap.
+            Expr can_use = Call::make(Int(32), "halide_can_use_target_features",
+                                      {UIntImm::make(UInt(64), bits)}, Call::Extern);
+            result = IfThenElse::make(can_use != 0, copy, result);
+        }
+        stmt = result;
+    }
+
+public:
+    MultiversionLoops(const map<string, vector<Target::Feature>> &l, const Target &t) :
+        loops(l), target(t) {}
+};
+
+}  // namespace
+
+Stmt multiversion_loops(Stmt s, const map<string, Function> &env, const Target &t) {
+    if (t.arch != Target::X86) {
+        return s;
+    }
+
+    // Find the names the loops scheduled with multiversion have by now.
+    map<string, vector<Target::Feature>> loops;
+    for (const auto &p : env) {
+        const Function &f = p.second;
+        vector<Definition> defs = {f.definition()};
+        for (const Definition &u : f.updates()) {
+            defs.push_back(u);
+        }
+        for (size_t i = 0; i < defs.size(); i++) {
+            const Multiversion &m = defs[i].schedule().multiversion();
+            if (m.defined()) {
+                loops[f.name() + ".s" + std::to_string(i) + "." + m.var] = m.features;
+            }
+        }
+    }
+    if (loops.empty()) {
+        return s;
+    }
+
+    return MultiversionLoops(loops, t).mutate(s);
+}
+
+bool is_multiversioned_loop(const string &name, const Target &t, Target *variant, string *original_name) {
+    size_t pos = name.rfind(isa_marker);
+    if (pos == string::npos) {
+        return false;
+    }
+    uint64_t bits = std::stoull(name.substr(pos + strlen(isa_marker)));
+    *variant = t;
+    for (int i = 0; i < Target::FeatureEnd; i++) {
+        if (bits & ((uint64_t)1 << i)) {
+            variant->set_feature((Target::Feature)i);
+        }
+    }
+    *original_name = name.substr(0, pos);
+    return true;
+}
+
+}
+}
@@ -0,0 +1,34 @@
+#ifndef HALIDE_MULTIVERSION_LOOPS_H
+#define HALIDE_MULTIVERSION_LOOPS_H
+
+/** \file
+ * Defines the lowering pass that compiles loops scheduled with
+ * multiversion for several instruction sets.
+ */
+
+#include <map>
+
+#include "IR.h"
+#include "Target.h"
+
+namespace Halide {
+namespace Internal {
+
+/** Replace each loop scheduled with Stage::multiversion by a chain of
+ * copies of it, one per set of target features, each guarded by a
+ * runtime check that the CPU has those features, and ending in the
+ * original loop. The loop variable of each copy is renamed to
+ * <loop>.__isa_<feature bits>, which tells codegen to compile that
+ * copy with those extra features. Only does anything for x86
+ * targets. */
+Stmt multiversion_loops(Stmt s, const std::map<std::string, Function> &env, const Target &t);
+
+/** If the loop variable name was made by multiversion_loops, return
+ * the target the loop should be compiled for, and the name of the
+ * loop before it was renamed. */
+bool is_multiversioned_loop(const std::string &name, const Target &t, Target *variant, std::string *original_name);
+
+}
+}
+
+#endif
@@ -30,6 +30,16 @@ struct Outputs {
      * output is desired. */
     std::string llvm_assembly_name;
 
+    /** The name of the emitted llvm bitcode with a ThinLTO summary,
+     * for linking into code built with -flto=thin, so that the linker
+     * can inline the pipeline into its callers (compiled for the same
+     * or more cpu features) and specialize it to the arguments they
+     * pass. The runtime is in it too unless the target has the
+     * no_runtime feature, in which case it can be compiled once, with
+     * compile_standalone_runtime, into a ThinLTO module of its own.
+     * Empty if no ThinLTO bitcode output is desired. */
+    std::string thin_lto_bitcode_name;
+
     /** The name of the emitted C header file. Empty if no C header file
      * output is desired. */
     std::string c_header_name;
@@ -50,6 +60,12 @@ struct Outputs {
      * output is desired. */
     std::string static_library_name;
 
+    /** The name of a profile written by a pipeline compiled with the
+     * pgo_instrument target feature, to lay out branches and loops by
+     * the frequencies in. This one is read rather than emitted. Empty
+     * if the code shouldn't be profile-guided. */
+    std::string pgo_profile_name;
+
     /** Make a new Outputs struct that emits everything this one does
      * and also an object file with the given name. */
     Outputs object(const std::string &object_name) const {
@@ -82,6 +98,15 @@ struct Outputs {
         return updated;
     }
 
+    /** Make a new Outputs struct that emits everything this one does
+     * and also llvm bitcode with a ThinLTO summary with the given
+     * name. */
+    Outputs thin_lto_bitcode(const std::string &thin_lto_bitcode_name) const {
+        Outputs updated = *this;
+        updated.thin_lto_bitcode_name = thin_lto_bitcode_name;
+        return updated;
+    }
+
     /** Make a new Outputs struct that emits everything this one does
      * and also a C header file with the given name. */
     Outputs c_header(const std::string &c_header_name) const {
@@ -121,6 +146,14 @@ struct Outputs {
         updated.static_library_name = static_library_name;
         return updated;
     }
+
+    /** Make a new Outputs struct that emits everything this one does,
+     * guided by the profile in the given file. */
+    Outputs pgo_profile(const std::string &pgo_profile_name) const {
+        Outputs updated = *this;
+        updated.pgo_profile_name = pgo_profile_name;
+        return updated;
+    }
 };
 
 }
@@ -7,6 +7,8 @@
 #include "Substitute.h"
 #include "CSE.h"
 #include "IREquality.h"
+#include "ModulusRemainder.h"
+#include "Function.h"
 
 namespace Halide {
 namespace Internal {
@@ -75,6 +77,92 @@ public:
 
 };
 
+/** Check whether an expression has the same value in every
+ * iteration of the update of a function, i.e. it doesn't depend on
+ * any free variables or on the function itself. */
+class IsInvariant : public IRVisitor {
+    using IRVisitor::visit;
+
+    const string &func;
+
+    void visit(const Variable *op) {
+        if (!op->param.defined() && !op->image.defined()) {
+            result = false;
+        }
+    }
+
+    void visit(const Call *op) {
+        if (op->name == func && op->call_type == Call::Halide) {
+            result = false;
+        }
+        IRVisitor::visit(op);
+    }
+
+public:
+    IsInvariant(const string &f) : func(f) {}
+
+    bool result = true;
+};
+
+bool is_invariant(const Expr &e, const string &f) {
+    IsInvariant check(f);
+    e.accept(&check);
+    return check.result;
+}
+
+/** Check whether an expression depends only on the variable v, and
+ * takes a different value for each value of v. */
+bool is_injective_in(const Expr &e, const string &v, const string &f) {
+    if (const Variable *var = e.as<Variable>()) {
+        return var->name == v;
+    } else if (const Add *add = e.as<Add>()) {
+        return ((is_invariant(add->a, f) && is_injective_in(add->b, v, f)) ||
+                (is_invariant(add->b, f) && is_injective_in(add->a, v, f)));
+    } else if (const Sub *sub = e.as<Sub>()) {
+        return ((is_invariant(sub->a, f) && is_injective_in(sub->b, v, f)) ||
+                (is_invariant(sub->b, f) && is_injective_in(sub->a, v, f)));
+    } else if (const Mul *mul = e.as<Mul>()) {
+        return ((is_const(mul->a) && !is_zero(mul->a) && is_injective_in(mul->b, v, f)) ||
+                (is_const(mul->b) && !is_zero(mul->b) && is_injective_in(mul->a, v, f)));
+    } else if (const Cast *cast = e.as<Cast>()) {
+        return cast->type.can_represent(cast->value.type()) && is_injective_in(cast->value, v, f);
+    } else if (const Call *call = e.as<Call>()) {
+        // A call to a function the user promised is injective, with
+        // one argument injective in v and the rest the same in every
+        // iteration.
+        if (call->call_type != Call::Halide || !call->func.defined() || call->name == f) {
+            return false;
+        }
+        Function g(call->func);
+        if (!g.is_assumed_injective() || g.outputs() != 1) {
+            return false;
+        }
+        bool injective = false;
+        for (const Expr &arg : call->args) {
+            if (!injective && is_injective_in(arg, v, f)) {
+                injective = true;
+            } else if (!is_invariant(arg, f)) {
+                return false;
+            }
+        }
+        return injective;
+    }
+    return false;
+}
+
+/** Check whether two integer expressions can't be equal, because
+ * their difference is never a multiple of some modulus. */
+bool provably_distinct(const Expr &a, const Expr &b) {
+    if (a.type() != Int(32) || b.type() != Int(32)) {
+        return false;
+    }
+    ModulusRemainder mod_rem = modulus_remainder(simplify(a - b));
+    if (mod_rem.modulus == 0) {
+        return mod_rem.remainder != 0;
+    }
+    return mod_rem.remainder % mod_rem.modulus != 0;
+}
+
 /** Substitute in boolean expressions. */
 class SubstituteInBooleanLets : public IRMutator {
     using IRMutator::visit;
@@ -115,9 +203,18 @@ bool can_parallelize_rvar(const string &v,
                        Variable::make(Int(32), renamer.get_new_name(v)));
 
     // Construct an expression which is true if there's a collision
-    // between this thread's store and the other thread's store.
+    // between this thread's store and the other thread's store. There
+    // can't be one if some coordinate of the store site is different
+    // for each value of v, or if the two threads' values of it always
+    // differ by something that isn't a multiple of some modulus.
     Expr hazard = const_true();
     for (size_t i = 0; i < args.size(); i++) {
+        if (is_injective_in(args[i], v, f) ||
+            provably_distinct(args[i], other_store[i])) {
+            debug(3) << "......stores are distinct in dimension " << i << "\n";
+            hazard = const_false();
+            break;
+        }
         hazard = hazard && (distinct_v && (args[i] == other_store[i]));
     }
 
@@ -127,7 +224,14 @@ bool can_parallelize_rvar(const string &v,
         internal_assert(find.loads[i].size() == other_store.size());
         Expr check = const_true();
         for (size_t j = 0; j < find.loads[i].size(); j++) {
-            check = check && (distinct_v && (find.loads[i][j] == other_store[j]));
+            const Expr &load = find.loads[i][j];
+            if ((equal(load, args[j]) && is_injective_in(load, v, f)) ||
+                provably_distinct(load, other_store[j])) {
+                debug(3) << "......load " << i << " is distinct from the stores in dimension " << j << "\n";
+                check = const_false();
+                break;
+            }
+            check = check && (distinct_v && (load == other_store[j]));
         }
         hazard = hazard || check;
     }
@@ -142,6 +142,22 @@ public:
     }
     // @}
 
+    /** Get or set an estimate of the typical value of this
+     * parameter, for tools such as Pipeline::auto_schedule. Unlike
+     * the range, this generates no runtime checks. */
+    // @{
+    void set_estimate(Expr value) {
+        if (value.type() != type_of<T>()) {
+            value = Internal::Cast::make(type_of<T>(), value);
+        }
+        param.set_estimate(value);
+    }
+
+    Expr get_estimate() const {
+        return param.get_estimate();
+    }
+    // @}
+
     /** You can use this parameter as an expression in a halide
      * function definition */
     operator Expr() const {
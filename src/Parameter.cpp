@@ -20,6 +20,9 @@ struct ParameterContents {
     Expr extent_constraint[4];
     Expr stride_constraint[4];
     Expr min_value, max_value;
+    Expr min_estimate[4];
+    Expr extent_estimate[4];
+    Expr estimate;
     const bool is_buffer;
     const bool is_explicit_name;
     const bool is_registered;
@@ -242,6 +245,31 @@ int Parameter::host_alignment() const {
     check_is_buffer();
     return contents->host_alignment;
 }
+
+void Parameter::set_min_estimate(int dim, Expr e) {
+    check_is_buffer();
+    check_dim_ok(dim);
+    contents->min_estimate[dim] = e;
+}
+
+void Parameter::set_extent_estimate(int dim, Expr e) {
+    check_is_buffer();
+    check_dim_ok(dim);
+    contents->extent_estimate[dim] = e;
+}
+
+Expr Parameter::min_estimate(int dim) const {
+    check_is_buffer();
+    check_dim_ok(dim);
+    return contents->min_estimate[dim];
+}
+
+Expr Parameter::extent_estimate(int dim) const {
+    check_is_buffer();
+    check_dim_ok(dim);
+    return contents->extent_estimate[dim];
+}
+
 void Parameter::set_min_value(Expr e) {
     check_is_scalar();
     user_assert(e.type() == contents->type)
@@ -272,6 +300,21 @@ Expr Parameter::get_max_value() const {
     return contents->max_value;
 }
 
+void Parameter::set_estimate(Expr e) {
+    check_is_scalar();
+    user_assert(!e.defined() || e.type() == contents->type)
+        << "Can't set parameter " << name()
+        << " of type " << contents->type
+        << " to have estimate " << e
+        << " of type " << e.type() << "\n";
+    contents->estimate = e;
+}
+
+Expr Parameter::get_estimate() const {
+    check_is_scalar();
+    return contents->estimate;
+}
+
 Dimension::Dimension(const Internal::Parameter &p, int d) : param(p), d(d) {
     user_assert(param.defined())
         << "Can't access the dimensions of an undefined Parameter\n";
@@ -324,6 +367,20 @@ Dimension Dimension::set_bounds(Expr min, Expr extent) {
     return set_min(min).set_extent(extent);
 }
 
+Dimension Dimension::set_bounds_estimate(Expr min, Expr extent) {
+    param.set_min_estimate(d, min);
+    param.set_extent_estimate(d, extent);
+    return *this;
+}
+
+Expr Dimension::min_estimate() const {
+    return param.min_estimate(d);
+}
+
+Expr Dimension::extent_estimate() const {
+    return param.extent_estimate(d);
+}
+
 Dimension Dimension::dim(int i) {
     return Dimension(param, i);
 }
@@ -130,6 +130,17 @@ public:
     EXPORT int host_alignment() const;
     //@}
 
+    /** Get and set estimates of the min and extent. Unlike the
+     * constraints above, these generate no runtime checks. They are
+     * only used by tools that reason about typical input sizes, such
+     * as Pipeline::auto_schedule. */
+    //@{
+    EXPORT void set_min_estimate(int dim, Expr e);
+    EXPORT void set_extent_estimate(int dim, Expr e);
+    EXPORT Expr min_estimate(int dim) const;
+    EXPORT Expr extent_estimate(int dim) const;
+    //@}
+
     /** Get and set constraints for scalar parameters. These are used
      * directly by Param, so they must be exported. */
     // @{
@@ -138,6 +149,13 @@ public:
     EXPORT void set_max_value(Expr e);
     EXPORT Expr get_max_value() const;
     // @}
+
+    /** Get and set an estimate of the typical value of a scalar
+     * parameter. Generates no runtime checks. */
+    // @{
+    EXPORT void set_estimate(Expr e);
+    EXPORT Expr get_estimate() const;
+    // @}
 };
 
 class Dimension {
@@ -195,6 +213,20 @@ public:
     /** Set the min and extent in one call. */
     EXPORT Dimension set_bounds(Expr min, Expr extent);
 
+    /** Set estimates of the min and extent in a given dimension,
+     * for tools that reason about typical input sizes, such as
+     * Pipeline::auto_schedule. Unlike set_bounds, these generate no
+     * runtime checks, and buffers of other sizes may be passed
+     * in. */
+    EXPORT Dimension set_bounds_estimate(Expr min, Expr extent);
+
+    /** Get the estimates of the min and extent in a given
+     * dimension, which are undefined if none were set. */
+    // @{
+    EXPORT Expr min_estimate() const;
+    EXPORT Expr extent_estimate() const;
+    // @}
+
     /** Get a different dimension of the same buffer */
     // @{
     EXPORT Dimension dim(int i);
@@ -2,6 +2,7 @@
 #include <numeric>
 
 #include "PartitionLoops.h"
+#include "CodeSize.h"
 #include "IRMutator.h"
 #include "IROperator.h"
 #include "Simplify.h"
@@ -21,6 +22,7 @@ using std::vector;
 using std::pair;
 using std::make_pair;
 using std::map;
+using std::set;
 
 namespace {
 
@@ -241,6 +243,80 @@ bool expr_uses_invalid_buffers(Expr e, const Scope<int> &invalid_buffers) {
     return uses.invalid;
 }
 
+// Get the smallest and largest lanes of a - b, if it is a broadcast
+// or a ramp with a constant stride. The difference must not overflow,
+// so this only applies to floats and 32 and 64-bit signed integers.
+bool lane_bounds(Expr a, Expr b, Expr *lo, Expr *hi) {
+    Type t = a.type().element_of();
+    if (!(t.is_float() || (t.is_int() && t.bits() >= 32))) {
+        return false;
+    }
+    Expr e = simplify(a - b);
+    if (const Broadcast *bc = e.as<Broadcast>()) {
+        *lo = *hi = bc->value;
+        return true;
+    } else if (const Ramp *r = e.as<Ramp>()) {
+        const int64_t *stride = as_const_int(r->stride);
+        if (!stride) {
+            return false;
+        }
+        Expr last = r->base + r->stride * (r->lanes - 1);
+        *lo = *stride >= 0 ? r->base : last;
+        *hi = *stride >= 0 ? last : r->base;
+        return true;
+    }
+    return false;
+}
+
+// Boundary conditions (see BoundaryConditions.h) test whether the
+// coordinates of each dimension are in the interior region of their
+// input. In vectorized loops those tests are comparisons of ramps,
+// and the simplifications they guard only apply if every lane is in
+// the interior. Find a scalar condition that is true if and only if
+// all lanes of the vector condition c are true, or an undefined Expr
+// if c is not built from comparisons of ramps and broadcasts. Unlike
+// and_condition_over_domain, this is exact, so the prologue and
+// epilogue can be simplified too.
+Expr all_lanes_true(Expr c) {
+    if (const Broadcast *b = c.as<Broadcast>()) {
+        return b->value;
+    } else if (const And *op = c.as<And>()) {
+        Expr a = all_lanes_true(op->a);
+        Expr b = all_lanes_true(op->b);
+        if (a.defined() && b.defined()) {
+            return a && b;
+        }
+    } else if (const Let *op = c.as<Let>()) {
+        if (op->value.type().is_scalar()) {
+            Expr body = all_lanes_true(op->body);
+            if (body.defined()) {
+                return Let::make(op->name, op->value, body);
+            }
+        }
+    } else if (const LT *op = c.as<LT>()) {
+        Expr lo, hi;
+        if (lane_bounds(op->a, op->b, &lo, &hi)) {
+            return hi < make_zero(hi.type());
+        }
+    } else if (const LE *op = c.as<LE>()) {
+        Expr lo, hi;
+        if (lane_bounds(op->a, op->b, &lo, &hi)) {
+            return hi <= make_zero(hi.type());
+        }
+    } else if (const GT *op = c.as<GT>()) {
+        Expr lo, hi;
+        if (lane_bounds(op->a, op->b, &lo, &hi)) {
+            return lo > make_zero(lo.type());
+        }
+    } else if (const GE *op = c.as<GE>()) {
+        Expr lo, hi;
+        if (lane_bounds(op->a, op->b, &lo, &hi)) {
+            return lo >= make_zero(lo.type());
+        }
+    }
+    return Expr();
+}
+
 // Then we define the visitor that hunts for them.
 class FindSimplifications : public IRVisitor {
     using IRVisitor::visit;
@@ -266,8 +342,9 @@ class FindSimplifications : public IRVisitor {
         Simplification s = {condition, old, likely_val, unlikely_val, true};
         if (s.condition.type().is_vector()) {
             s.condition = simplify(s.condition);
-            if (const Broadcast *b = s.condition.as<Broadcast>()) {
-                s.condition = b->value;
+            Expr all_lanes = all_lanes_true(s.condition);
+            if (all_lanes.defined()) {
+                s.condition = all_lanes;
             } else {
                 // Devectorize the condition
                 s.condition = and_condition_over_domain(s.condition, Scope<Interval>::empty_scope());
@@ -429,17 +506,52 @@ bool contains_thread_barrier(Stmt s) {
     return c.result;
 }
 
+// Find how much partitioning each loop would grow the code: by up to
+// a prologue and an epilogue, each a copy of its body.
+class FindPartitionGrowth : public IRVisitor {
+    using IRVisitor::visit;
+
+    double trip_count = 1;
+
+    void visit(const For *op) {
+        if (op->device_api == DeviceAPI::GLSL) {
+            return;
+        }
+        double old_trip_count = trip_count;
+        trip_count *= CodeSizeBudget::trip_count(op->extent);
+        FindSimplifications finder(op->name);
+        op->body.accept(&finder);
+        if (!finder.simplifications.empty()) {
+            growths.push_back({op->name, 2 * code_size(op->body), trip_count});
+        }
+        IRVisitor::visit(op);
+        trip_count = old_trip_count;
+    }
+
+public:
+    vector<CodeSizeBudget::Growth> growths;
+};
+
 class PartitionLoops : public IRMutator {
     using IRMutator::visit;
 
     bool in_gpu_loop = false;
 
+    // The loops not to partition, to stay within the code size budget.
+    const set<string> &denied;
+
     void visit(const For *op) {
         Stmt body = op->body;
 
         bool old_in_gpu_loop = in_gpu_loop;
         in_gpu_loop |= CodeGen_GPU_Dev::is_gpu_var(op->name);
 
+        if (denied.count(op->name)) {
+            IRMutator::visit(op);
+            in_gpu_loop = old_in_gpu_loop;
+            return;
+        }
+
         // If we're inside GPU kernel, and the body contains thread
         // barriers, it's not safe to duplicate code.
         if (in_gpu_loop && contains_thread_barrier(body)) {
@@ -691,6 +803,9 @@ class PartitionLoops : public IRMutator {
                  << "Old: " << Stmt(op) << "\n"
                  << "New: " << stmt << "\n";
     }
+
+public:
+    PartitionLoops(const set<string> &denied) : denied(denied) {}
 };
 
 class ExprContainsLoad : public IRVisitor {
@@ -804,7 +919,7 @@ class RenormalizeGPULoops : public IRMutator {
                 IRMutator::visit(op);
             } else {
                 Stmt inner = LetStmt::make(op->name, op->value, a->body);
-                inner = Allocate::make(a->name, a->type, a->extents, a->condition, inner);
+                inner = Allocate::make(a->name, a->type, a->memory_type, a->extents, a->condition, inner);
                 stmt = mutate(inner);
             }
         } else {
@@ -841,7 +956,7 @@ class RenormalizeGPULoops : public IRMutator {
             allocate_a->name == "__shared" &&
             allocate_b->name == "__shared") {
             Stmt inner = IfThenElse::make(op->condition, allocate_a->body, allocate_b->body);
-            inner = Allocate::make(allocate_a->name, allocate_a->type, allocate_a->extents, allocate_a->condition, inner);
+            inner = Allocate::make(allocate_a->name, allocate_a->type, allocate_a->memory_type, allocate_a->extents, allocate_a->condition, inner);
             stmt = mutate(inner);
         } else if (let_a && let_b && let_a->name == let_b->name) {
             string condition_name = unique_name('t');
@@ -981,11 +1096,17 @@ class LowerLikelyIfInnermost : public IRMutator {
 
 }
 
-Stmt partition_loops(Stmt s) {
+Stmt partition_loops(Stmt s, CodeSizeBudget *budget) {
     s = LowerLikelyIfInnermost().mutate(s);
     s = MarkClampedRampsAsLikely().mutate(s);
     s = ExpandSelects().mutate(s);
-    s = PartitionLoops().mutate(s);
+    set<string> denied;
+    if (budget && !budget->empty()) {
+        FindPartitionGrowth finder;
+        s.accept(&finder);
+        denied = budget->deny(s, finder.growths, "partitioning");
+    }
+    s = PartitionLoops(denied).mutate(s);
     s = RenormalizeGPULoops().mutate(s);
     s = RemoveLikelyTags().mutate(s);
     s = CollapseSelects().mutate(s);
@@ -12,10 +12,13 @@
 namespace Halide {
 namespace Internal {
 
+class CodeSizeBudget;
+
 /** Partitions loop bodies into a prologue, a steady state, and an
  * epilogue. Finds the steady state by hunting for use of clamped
- * ramps, or the 'likely' intrinsic. */
-EXPORT Stmt partition_loops(Stmt s);
+ * ramps, or the 'likely' intrinsic. If a budget is given, the loops
+ * that would take a Func over it aren't partitioned. */
+EXPORT Stmt partition_loops(Stmt s, CodeSizeBudget *budget = nullptr);
 
 }
 }
@@ -1,14 +1,26 @@
 #include <algorithm>
+#include <fstream>
+#include <functional>
+#include <sstream>
 
 #include "Pipeline.h"
+#include "AddImageChecks.h"
+#include "AffectedRegions.h"
 #include "Argument.h"
+#include "AutoSchedule.h"
+#include "DeepCopy.h"
+#include "FindCalls.h"
 #include "Func.h"
+#include "IRMutator.h"
 #include "IRVisitor.h"
 #include "LLVM_Headers.h"
 #include "LLVM_Output.h"
 #include "Lower.h"
+#include "MemoryTraffic.h"
 #include "Outputs.h"
 #include "PrintLoopNest.h"
+#include "ScheduleSerialization.h"
+#include "StmtToHtml.h"
 
 using namespace Halide::Internal;
 
@@ -71,12 +83,22 @@ struct PipelineContents {
     JITModule jit_module;
     Target jit_target;
 
+    // Versions of jit_module compiled for particular values of some
+    // scalar params, keyed by those values. See
+    // Pipeline::specialize_jit_on_values.
+    vector<Parameter> jit_value_params;
+    int jit_value_threshold = 0, jit_max_value_versions = 0;
+    std::map<string, int> jit_value_counts;
+    std::map<string, JITModule> jit_value_modules;
+
     /** Clear all cached state */
     void invalidate_cache() {
         module = Module("", Target());
         jit_module = JITModule();
         jit_target = Target();
         inferred_args.clear();
+        jit_value_counts.clear();
+        jit_value_modules.clear();
     }
 
     // The outputs
@@ -235,13 +257,45 @@ void Pipeline::print_loop_nest() {
     std::cerr << Halide::Internal::print_loop_nest(contents->outputs);
 }
 
+std::string Pipeline::auto_schedule(const Target &target,
+                                    const vector<OutputEstimate> &estimates,
+                                    const MachineParams &params) {
+    user_assert(defined()) << "Can't auto-schedule an undefined Pipeline.\n";
+    string schedule = Internal::generate_schedules(contents->outputs, target, estimates, params);
+    invalidate_cache();
+    return schedule;
+}
+
+void Pipeline::dump_schedule(const string &filename) {
+    user_assert(defined()) << "Can't dump the schedule of an undefined Pipeline.\n";
+    std::ofstream file(filename);
+    user_assert(file.is_open()) << "Failed to open " << filename << " to write a schedule to\n";
+    file << serialize_schedules(contents->outputs);
+    file.close();
+    user_assert(!file.fail()) << "Failed to write a schedule to " << filename << "\n";
+}
+
+void Pipeline::apply_schedule(const string &filename) {
+    user_assert(defined()) << "Can't apply a schedule to an undefined Pipeline.\n";
+    std::ifstream file(filename);
+    user_assert(file.is_open()) << "Failed to open schedule " << filename << "\n";
+    std::stringstream text;
+    text << file.rdbuf();
+    deserialize_schedules(text.str(), contents->outputs);
+    invalidate_cache();
+}
+
 void Pipeline::compile_to_lowered_stmt(const string &filename,
                                        const vector<Argument> &args,
                                        StmtOutputFormat fmt,
-                                       const Target &target) {
+                                       const Target &target,
+                                       const std::string &profile_report) {
     Module m = compile_to_module(args, "", target);
     Outputs outputs;
-    if (fmt == HTML) {
+    if (fmt == HTML && !profile_report.empty()) {
+        Internal::print_to_html(output_name(filename, m, ".html"), m, profile_report);
+        return;
+    } else if (fmt == HTML) {
         outputs = Outputs().stmt_html(output_name(filename, m, ".html"));
     } else {
         outputs = Outputs().stmt(output_name(filename, m, ".stmt"));
@@ -268,6 +322,11 @@ void Pipeline::compile_to_multitarget_static_library(const std::string &filename
     compile_multitarget(generate_function_name(), outputs, targets, module_producer);
 }
 
+void Pipeline::compile_runtime_to_static_library(const string &filename_prefix,
+                                                 const Target &target) {
+    compile_standalone_runtime(static_library_outputs(filename_prefix, target), target);
+}
+
 void Pipeline::compile_to_file(const string &filename_prefix,
                                const vector<Argument> &args,
                                const std::string &fn_name,
@@ -569,10 +628,10 @@ Module Pipeline::compile_to_module(const vector<Argument> &args,
     const Module &old_module = contents->module;
     if (!old_module.functions().empty() &&
         old_module.target() == target) {
-        internal_assert(old_module.functions().size() == 2);
+        internal_assert(old_module.functions().size() >= 2);
         // We can avoid relowering and just reuse the private body
-        // from the old module. We expect two functions in the old
-        // module: the private one then the public one.
+        // from the old module. We expect the private function to be
+        // first, and the public one last.
         private_body = old_module.functions().front().body;
         debug(2) << "Reusing old module\n";
     } else {
@@ -606,26 +665,51 @@ Module Pipeline::compile_to_module(const vector<Argument> &args,
                                         buf.type(), buf.dimensions()));
     }
 
+    // The metadata of each entry point describes the work done by the
+    // Funcs of the pipeline.
+    vector<FuncTraffic> traffic = estimate_memory_traffic(private_body);
+
+    // Generate a public function that calls a private one, adding
+    // arguments for the global images.
+    auto append_public_function = [&](const string &public_name, const string &private_name) {
+        vector<Expr> private_params;
+        for (Argument arg : private_args) {
+            if (arg.is_buffer()) {
+                private_params.push_back(Variable::make(type_of<void*>(), arg.name + ".buffer"));
+            } else {
+                private_params.push_back(Variable::make(arg.type, arg.name));
+            }
+        }
+        string private_result_name = unique_name(private_name + "_result");
+        Expr private_result_var = Variable::make(Int(32), private_result_name);
+        Expr call_private = Call::make(Int(32), private_name, private_params, Call::Extern);
+        Stmt public_body = AssertStmt::make(private_result_var == 0, private_result_var);
+        public_body = LetStmt::make(private_result_name, call_private, public_body);
+
+        LoweredFunc public_func(public_name, public_args, public_body, linkage_type);
+        public_func.traffic = traffic;
+        module.append(public_func);
+    };
+
+    // The private function for the pipeline goes first, and the
+    // public one last.
     module.append(LoweredFunc(private_name, private_args,
                               private_body, LoweredFunc::Internal));
 
-    // Generate a call to the private function, adding an arguments
-    // for the global images.
-    vector<Expr> private_params;
-    for (Argument arg : private_args) {
-        if (arg.is_buffer()) {
-            private_params.push_back(Variable::make(type_of<void*>(), arg.name + ".buffer"));
-        } else {
-            private_params.push_back(Variable::make(arg.type, arg.name));
-        }
+    // With the precheck feature, also add an entry point that only
+    // runs the checks on the arguments, and one that skips the checks
+    // on the buffers, for callers that have already run the first on
+    // buffers of the same shape.
+    if (target.has_feature(Target::Precheck) && !target.has_feature(Target::JIT)) {
+        module.append(LoweredFunc(private_name + "_precheck", private_args,
+                                  extract_image_checks(private_body), LoweredFunc::Internal));
+        append_public_function(new_fn_name + "_precheck", private_name + "_precheck");
+        module.append(LoweredFunc(private_name + "_prechecked", private_args,
+                                  strip_image_checks(private_body), LoweredFunc::Internal));
+        append_public_function(new_fn_name + "_prechecked", private_name + "_prechecked");
     }
-    string private_result_name = unique_name(private_name + "_result");
-    Expr private_result_var = Variable::make(Int(32), private_result_name);
-    Expr call_private = Call::make(Int(32), private_name, private_params, Call::Extern);
-    Stmt public_body = AssertStmt::make(private_result_var == 0, private_result_var);
-    public_body = LetStmt::make(private_result_name, call_private, public_body);
 
-    module.append(LoweredFunc(new_fn_name, public_args, public_body, linkage_type));
+    append_public_function(new_fn_name, private_name);
 
     contents->module = module;
 
@@ -662,6 +746,8 @@ void *Pipeline::compile_jit(const Target &target_arg) {
     }
 
     contents->jit_target = target;
+    contents->jit_value_counts.clear();
+    contents->jit_value_modules.clear();
 
     // Infer an arguments vector
     infer_arguments();
@@ -706,6 +792,148 @@ void *Pipeline::compile_jit(const Target &target_arg) {
     return jit_module.main_function();
 }
 
+void Pipeline::compile_jit_in_parallel(const vector<Pipeline> &pipelines, const Target &target) {
+    // Compiling the same pipeline twice at once would race, so only
+    // compile each one once.
+    set<const PipelineContents *> seen;
+    vector<std::function<void()>> jobs;
+    for (Pipeline p : pipelines) {
+        user_assert(p.defined()) << "Pipeline is undefined\n";
+        if (seen.insert(p.contents.get()).second) {
+            jobs.push_back([p, target]() mutable { p.compile_jit(target); });
+        }
+    }
+    compile_in_parallel(jobs);
+}
+
+void Pipeline::specialize_jit_on_values(const vector<Expr> &params, int threshold, int max_versions) {
+    user_assert(defined()) << "Pipeline is undefined\n";
+    user_assert(threshold >= 1 && max_versions >= 1)
+        << "specialize_jit_on_values needs a positive threshold and number of versions\n";
+    vector<Parameter> parameters;
+    for (Expr e : params) {
+        const Variable *v = e.as<Variable>();
+        user_assert(v && v->param.defined() && !v->param.is_buffer() && v->name == v->param.name())
+            << "Can't specialize a pipeline on the value of " << e << ", which is not a scalar Param\n";
+        user_assert(!v->type.is_handle())
+            << "Can't specialize a pipeline on the value of the handle " << e << "\n";
+        parameters.push_back(v->param);
+    }
+    contents->jit_value_params = parameters;
+    contents->jit_value_threshold = threshold;
+    contents->jit_max_value_versions = max_versions;
+    contents->jit_value_counts.clear();
+    contents->jit_value_modules.clear();
+}
+
+namespace {
+
+class SubstituteParamValues : public IRMutator {
+    using IRMutator::visit;
+
+    const std::map<string, Expr> &values;
+
+    void visit(const Variable *op) {
+        auto it = values.find(op->name);
+        if (op->param.defined() && !op->param.is_buffer() && it != values.end()) {
+            expr = it->second;
+        } else {
+            expr = op;
+        }
+    }
+
+public:
+    SubstituteParamValues(const std::map<string, Expr> &v) : values(v) {}
+};
+
+}  // namespace
+
+// The jit-compiled code to run for the current values of the params
+// passed to specialize_jit_on_values. The general version must have
+// been compiled already.
+JITModule &Pipeline::jit_module_for_values(const Target &target) {
+    if (contents->jit_value_params.empty()) {
+        return contents->jit_module;
+    }
+
+    std::map<string, Expr> values;
+    std::ostringstream key;
+    for (const Parameter &p : contents->jit_value_params) {
+        Expr value = p.get_scalar_expr();
+        values[p.name()] = value;
+        key << p.name() << '=' << value << ';';
+    }
+
+    auto it = contents->jit_value_modules.find(key.str());
+    if (it != contents->jit_value_modules.end()) {
+        return it->second;
+    }
+    if ((int)contents->jit_value_modules.size() >= contents->jit_max_value_versions) {
+        return contents->jit_module;
+    }
+    // Don't let values that never recur pile up.
+    if (contents->jit_value_counts.size() > 64) {
+        contents->jit_value_counts.clear();
+    }
+    if (++contents->jit_value_counts[key.str()] < contents->jit_value_threshold) {
+        return contents->jit_module;
+    }
+    contents->jit_value_counts.erase(key.str());
+
+    debug(1) << "Jit-compiling " << generate_function_name() << " for " << key.str() << "\n";
+
+    // Copy the Functions with the values substituted in, and compile
+    // the copies with the same arguments as the general version so
+    // that they can be called the same way.
+    std::map<string, Function> env;
+    for (Function f : contents->outputs) {
+        std::map<string, Function> more_funcs = find_transitive_calls(f);
+        env.insert(more_funcs.begin(), more_funcs.end());
+    }
+    vector<Function> outputs;
+    std::tie(outputs, env) = deep_copy(contents->outputs, env);
+    SubstituteParamValues substitute(values);
+    for (auto &iter : env) {
+        Function f = iter.second;
+        if (f.has_pure_definition()) {
+            f.definition().mutate(&substitute);
+            for (size_t i = 0; i < f.updates().size(); i++) {
+                f.update((int)i).mutate(&substitute);
+            }
+        }
+    }
+
+    vector<Func> funcs;
+    for (Function f : outputs) {
+        funcs.push_back(Func(f));
+    }
+    Pipeline specialized(funcs);
+    specialized.contents->jit_externs = contents->jit_externs;
+    for (CustomLoweringPass p : contents->custom_lowering_passes) {
+        // The passes still belong to this pipeline.
+        specialized.add_custom_lowering_pass(p.pass, nullptr);
+    }
+
+    vector<Argument> args;
+    for (const InferredArgument &arg : contents->inferred_args) {
+        args.push_back(arg.arg);
+    }
+    Module module = specialized.compile_to_module(args, generate_function_name(), contents->jit_target);
+
+    JITModule &result = contents->jit_value_modules[key.str()];
+    if (module.functions().back().args.size() !=
+        contents->module.functions().back().args.size()) {
+        // Compiling added arguments (e.g. buffers embedded for a GPU
+        // target) that the general version doesn't pass.
+        debug(1) << "Can't specialize " << generate_function_name() << " for " << key.str() << "\n";
+        result = contents->jit_module;
+    } else {
+        std::map<std::string, JITExtern> lowered_externs = contents->jit_externs;
+        result = JITModule(module, module.functions().back(),
+                           make_externs_jit_module(target, lowered_externs));
+    }
+    return result;
+}
 
 void Pipeline::set_error_handler(void (*handler)(void *, const char *)) {
     user_assert(defined()) << "Pipeline is undefined\n";
@@ -1076,6 +1304,7 @@ void Pipeline::realize(Realization dst, const Target &t) {
     }
 
     vector<const void *> args = prepare_jit_call_arguments(dst, target);
+    JITModule &compiled_module = jit_module_for_values(target);
 
     for (size_t i = 0; i < contents->inferred_args.size(); i++) {
         const InferredArgument &arg = contents->inferred_args[i];
@@ -1149,15 +1378,15 @@ void Pipeline::realize(Realization dst, const Target &t) {
     // exception.
 
     debug(2) << "Calling jitted function\n";
-    int exit_status = contents->jit_module.argv_function()(&(args[0]));
+    int exit_status = compiled_module.argv_function()(&(args[0]));
     debug(2) << "Back from jitted function. Exit status was " << exit_status << "\n";
 
     // If we're profiling, report runtimes and reset profiler stats.
     if (target.has_feature(Target::Profile)) {
         JITModule::Symbol report_sym =
-            contents->jit_module.find_symbol_by_name("halide_profiler_report");
+            compiled_module.find_symbol_by_name("halide_profiler_report");
         JITModule::Symbol reset_sym =
-            contents->jit_module.find_symbol_by_name("halide_profiler_reset");
+            compiled_module.find_symbol_by_name("halide_profiler_reset");
         if (report_sym.address && reset_sym.address) {
             void *uc = jit_context.user_context_param.get_scalar<void *>();
             void (*report_fn_ptr)(void *) = (void (*)(void *))(report_sym.address);
@@ -1171,6 +1400,170 @@ void Pipeline::realize(Realization dst, const Target &t) {
     jit_context.finalize(exit_status);
 }
 
+namespace {
+
+// The product of the constant split factors of each pure dimension
+// of a Func's schedule, so that regions of it can be rounded out to
+// whole tiles.
+vector<int> tile_sizes(const Function &f) {
+    std::map<string, int> dim_of_var;
+    vector<int> tile(f.args().size(), 1);
+    for (size_t i = 0; i < f.args().size(); i++) {
+        dim_of_var[f.args()[i]] = (int)i;
+    }
+    for (const Split &split : f.definition().schedule().splits()) {
+        auto it = dim_of_var.find(split.old_var);
+        if (it == dim_of_var.end()) {
+            continue;
+        }
+        int d = it->second;
+        if (split.is_split()) {
+            const int64_t *factor = as_const_int(split.factor);
+            if (factor) {
+                tile[d] *= (int)*factor;
+            }
+            dim_of_var[split.outer] = d;
+        } else if (split.is_rename()) {
+            dim_of_var[split.outer] = d;
+        }
+    }
+    return tile;
+}
+
+}  // namespace
+
+void Pipeline::realize_incremental(Realization dst, const string &input,
+                                   const vector<std::pair<int, int>> &dirty,
+                                   const Target &target) {
+    user_assert(defined()) << "Can't realize an undefined Pipeline\n";
+
+    Box changed;
+    for (const auto &r : dirty) {
+        user_assert(r.second > 0) << "The dirty region passed to realize_incremental is empty\n";
+        changed.push_back(Interval(r.first, r.first + r.second - 1));
+    }
+    std::map<string, Box> affected = boxes_affected(contents->outputs, {{input, changed}});
+
+    // Crop each output to the tiles of it that may have changed.
+    vector<Buffer<>> crops;
+    bool any_affected = false;
+    size_t dst_idx = 0;
+    for (const Function &out : contents->outputs) {
+        user_assert(dst_idx + out.outputs() <= dst.size())
+            << "Realization passed to realize_incremental has too few buffers\n";
+        auto it = affected.find(out.name());
+        any_affected |= it != affected.end();
+        const Buffer<> &first = dst[dst_idx];
+        vector<int> tile = tile_sizes(out);
+        vector<std::pair<int, int>> rect;
+        for (int d = 0; d < first.dimensions(); d++) {
+            int lo = first.dim(d).min(), hi = first.dim(d).max();
+            int t = d < (int)tile.size() ? tile[d] : 1;
+            int min = lo, max = hi;
+            if (it == affected.end()) {
+                // Outputs that don't depend on the dirty region still
+                // have to be realized along with the others, so
+                // recompute just their first tile.
+                max = lo + t - 1;
+            } else if (d < (int)it->second.size()) {
+                const Interval &i = it->second[d];
+                const int64_t *imin = i.has_lower_bound() ? as_const_int(i.min) : nullptr;
+                const int64_t *imax = i.has_upper_bound() ? as_const_int(i.max) : nullptr;
+                if (imin) {
+                    min = (int)std::min(std::max((int64_t)lo, *imin), (int64_t)hi);
+                }
+                if (imax) {
+                    max = (int)std::max(std::min((int64_t)hi, *imax), (int64_t)min);
+                }
+            }
+            // Round out to whole tiles counted from the min of the
+            // buffer. A tile cut short by the end of the buffer is
+            // shifted inwards instead, as the scheduled loops do.
+            min = lo + ((min - lo) / t) * t;
+            max = std::min(hi, lo + ((max - lo) / t + 1) * t - 1);
+            min = std::max(lo, std::min(min, max - t + 1));
+            rect.push_back({min, max - min + 1});
+        }
+        for (int k = 0; k < out.outputs(); k++) {
+            Buffer<> &b = dst[dst_idx + k];
+            b.copy_to_host();
+            b.device_free();
+            Runtime::Buffer<> crop = *b.get();
+            crop.crop(rect);
+            crops.push_back(Buffer<>(std::move(crop), b.name()));
+        }
+        dst_idx += out.outputs();
+    }
+    if (!any_affected) {
+        debug(2) << "realize_incremental: no output depends on the dirty region of " << input << "\n";
+        return;
+    }
+
+    Realization r(crops);
+    realize(r, target);
+    for (size_t i = 0; i < r.size(); i++) {
+        r[i].copy_to_host();
+    }
+}
+
+Callable Pipeline::compile_to_callable(const vector<Argument> &args, const Target &target) {
+    user_assert(defined()) << "Can't compile undefined Pipeline\n";
+
+    compile_jit(target);
+
+    Callable callable;
+    callable.pipeline = *this;
+    callable.jit_module = contents->jit_module;
+    callable.user_context_param = contents->user_context_arg.param;
+    callable.report_profile = contents->jit_target.has_feature(Target::Profile);
+    callable.args = args;
+
+    // Lay out the values to pass to the argv function the same way
+    // prepare_jit_call_arguments does: the inferred arguments,
+    // followed by the outputs.
+    vector<int> slot_of_arg(args.size(), -1);
+    for (const InferredArgument &arg : contents->inferred_args) {
+        size_t slot = callable.arg_values.size();
+        if (arg.buffer.defined()) {
+            callable.embedded_buffers.push_back(arg.buffer);
+            callable.arg_values.push_back(arg.buffer.raw_buffer());
+        } else if (arg.arg.name == contents->user_context_arg.arg.name) {
+            callable.arg_values.push_back(arg.param.get_scalar_address());
+        } else {
+            size_t i = 0;
+            while (i < args.size() && args[i].name != arg.arg.name) {
+                i++;
+            }
+            user_assert(i < args.size())
+                << "Can't make a Callable from the pipeline because "
+                << (arg.arg.is_buffer() ? "ImageParam " : "Param ")
+                << arg.arg.name << " is not in the argument list\n";
+            user_assert(args[i].is_buffer() == arg.arg.is_buffer() &&
+                        args[i].type == arg.arg.type)
+                << "Argument " << arg.arg.name << " to compile_to_callable does not match "
+                << "the argument of the same name used by the pipeline\n";
+            slot_of_arg[i] = (int)slot;
+            callable.arg_values.push_back(nullptr);
+        }
+    }
+    for (size_t i = 0; i < args.size(); i++) {
+        user_assert(slot_of_arg[i] >= 0)
+            << "Argument " << args[i].name << " to compile_to_callable is not used by the pipeline\n";
+        callable.arg_slots.push_back(slot_of_arg[i]);
+    }
+
+    for (Function f : contents->outputs) {
+        for (Parameter buf : f.output_buffers()) {
+            callable.args.push_back(Argument(buf.name(), Argument::OutputBuffer,
+                                             buf.type(), buf.dimensions()));
+            callable.arg_slots.push_back(callable.arg_values.size());
+            callable.arg_values.push_back(nullptr);
+        }
+    }
+
+    return callable;
+}
+
 void Pipeline::infer_input_bounds(Realization dst) {
 
     Target target = get_jit_target_from_environment();
@@ -1296,4 +1689,54 @@ JITExtern::JITExtern(const ExternCFunction &extern_c_function)
     : extern_c_function_(extern_c_function) {
 }
 
+void Callable::check_buffer_arg(size_t i, const Buffer<> &buf) const {
+    const Argument &arg = args[i];
+    user_assert(arg.is_buffer())
+        << "Argument " << i << " to Callable is a Buffer, but " << arg.name << " is a scalar\n";
+    user_assert(buf.defined())
+        << "Buffer passed to Callable for " << arg.name << " is undefined\n";
+    user_assert(buf.type() == arg.type && buf.dimensions() == arg.dimensions)
+        << "Buffer passed to Callable for " << arg.name << " is a " << buf.dimensions()
+        << "-dimensional buffer of " << buf.type() << ", but " << arg.name << " is a "
+        << (int)arg.dimensions << "-dimensional buffer of " << arg.type << "\n";
+}
+
+void Callable::check_scalar_arg(size_t i, Type t) const {
+    const Argument &arg = args[i];
+    user_assert(!arg.is_buffer())
+        << "Argument " << i << " to Callable is a scalar, but " << arg.name << " is a buffer\n";
+    user_assert(t == arg.type)
+        << "Argument " << i << " to Callable has type " << t
+        << ", but " << arg.name << " has type " << arg.type << "\n";
+}
+
+void Callable::call(vector<const void *> &values, size_t num_args) const {
+    user_assert(jit_module.argv_function()) << "Can't call an undefined Callable\n";
+    user_assert(num_args == args.size())
+        << "Callable called with " << num_args << " arguments instead of " << args.size() << "\n";
+
+    // See the comments in Pipeline::realize for how the handlers
+    // are reached through the user context.
+    Pipeline p = pipeline;
+    Parameter uc_param = user_context_param;
+    JITFuncCallContext jit_context(p.jit_handlers(), uc_param);
+
+    int exit_status = jit_module.argv_function()(&(values[0]));
+
+    if (report_profile) {
+        JITModule::Symbol report_sym = jit_module.find_symbol_by_name("halide_profiler_report");
+        JITModule::Symbol reset_sym = jit_module.find_symbol_by_name("halide_profiler_reset");
+        if (report_sym.address && reset_sym.address) {
+            void *uc = jit_context.user_context_param.get_scalar<void *>();
+            void (*report_fn_ptr)(void *) = (void (*)(void *))(report_sym.address);
+            report_fn_ptr(uc);
+
+            void (*reset_fn_ptr)() = (void (*)())(reset_sym.address);
+            reset_fn_ptr();
+        }
+    }
+
+    jit_context.finalize(exit_status);
+}
+
 }  // namespace Halide
@@ -7,17 +7,21 @@
  * pipeline.
  */
 
+#include <cstring>
+#include <type_traits>
 #include <vector>
 
 #include "IntrusivePtr.h"
 #include "JITModule.h"
 #include "Module.h"
+#include "Parameter.h"
 #include "Tuple.h"
 #include "Target.h"
 
 namespace Halide {
 
 struct Argument;
+class Callable;
 class Func;
 struct Outputs;
 struct PipelineContents;
@@ -51,6 +55,33 @@ struct CustomLoweringPass {
 
 struct JITExtern;
 
+/** The machine parameters that Pipeline::auto_schedule's cost model
+ * is tuned with. */
+struct MachineParams {
+    /** The number of cores available to parallel loops. */
+    int parallelism;
+    /** The size of the last-level cache, in bytes. */
+    uint64_t last_level_cache_size;
+    /** How many arithmetic operations a load that misses the
+     * last-level cache costs. */
+    float balance;
+
+    MachineParams(int parallelism, uint64_t llc, float balance) :
+        parallelism(parallelism), last_level_cache_size(llc), balance(balance) {}
+
+    /** Parameters for a generic multi-core CPU: 16 cores, a 16MB
+     * last-level cache, and a balance of 40. */
+    EXPORT static MachineParams generic();
+};
+
+/** The region of an output Func that a pipeline is expected to
+ * compute: a (min, extent) pair for each dimension of the Func with
+ * the given name, innermost first. See Pipeline::auto_schedule. */
+struct OutputEstimate {
+    std::string func;
+    std::vector<std::pair<int, int>> bounds;
+};
+
 /** A class representing a Halide pipeline. Constructed from the Func
  * or Funcs that it outputs. */
 class Pipeline {
@@ -59,6 +90,7 @@ class Pipeline {
     std::vector<Argument> infer_arguments(Internal::Stmt body);
     std::vector<Buffer<>> validate_arguments(const std::vector<Argument> &args, Internal::Stmt body);
     std::vector<const void *> prepare_jit_call_arguments(Realization dst, const Target &target);
+    Internal::JITModule &jit_module_for_values(const Target &target);
 
     static std::vector<Internal::JITModule> make_externs_jit_module(const Target &target,
                                                                     std::map<std::string, JITExtern> &externs_in_out);
@@ -138,7 +170,8 @@ public:
 
     /** Statically compile a pipeline to C source code. This is useful
      * for providing fallback code paths that will compile on many
-     * platforms. Vectorization will fail, and parallelization will
+     * platforms. Vectorized code uses the GCC/Clang vector extensions,
+     * so it needs one of those compilers, and parallelization will
      * produce serial code. */
     EXPORT void compile_to_c(const std::string &filename,
                              const std::vector<Argument> &,
@@ -147,17 +180,55 @@ public:
 
     /** Write out an internal representation of lowered code. Useful
      * for analyzing and debugging scheduling. Can emit html or plain
-     * text. */
+     * text. The html can be annotated with the time and memory each
+     * Func used, by passing the name of a file holding the JSON
+     * report from halide_profiler_format_report for a run of this
+     * pipeline compiled with the profile feature. */
     EXPORT void compile_to_lowered_stmt(const std::string &filename,
                                         const std::vector<Argument> &args,
                                         StmtOutputFormat fmt = Text,
-                                        const Target &target = get_target_from_environment());
+                                        const Target &target = get_target_from_environment(),
+                                        const std::string &profile_report = "");
 
     /** Write out the loop nests specified by the schedule for this
      * Pipeline's Funcs. Helpful for understanding what a schedule is
      * doing. */
     EXPORT void print_loop_nest();
 
+    /** Schedule every Func in this pipeline using a cost model, and
+     * return the schedule chosen as C++ source that can be checked in
+     * in place of the call. The cost model weighs inlining each Func
+     * against computing it at root or in tiles of its consumer, using
+     * the regions of each Func required to compute the given regions
+     * of the outputs. It then tiles, vectorizes and parallelizes the
+     * Funcs that aren't inlined. Every output needs an estimate,
+     * either passed in or set with set_bounds_estimate on its output
+     * buffer, and the schedule assumes the outputs are never smaller
+     * than estimated. Params and input buffers that the regions
+     * depend on are replaced by their estimates. The Funcs should not already be scheduled. The
+     * source refers to Funcs and Vars by C++ identifiers made from
+     * their names. */
+    EXPORT std::string auto_schedule(const Target &target,
+                                     const std::vector<OutputEstimate> &estimates,
+                                     const MachineParams &params = MachineParams::generic());
+
+    /** Write the complete schedule of every Func in this pipeline to
+     * a file: the splits, loops, compute and store levels, storage,
+     * bounds and other directives of every stage and specialization.
+     * It can be loaded with apply_schedule into this pipeline, or
+     * into the same algorithm built by another process, so that a
+     * JIT-compiled pipeline's schedule can be changed without
+     * recompiling the code that defines it. The Exprs in the schedule
+     * may only refer to constants and to the Params and input buffer
+     * shapes of the pipeline. Wrappers made by Func::in aren't
+     * written. */
+    EXPORT void dump_schedule(const std::string &filename);
+
+    /** Replace the schedules of the Funcs in this pipeline with those
+     * in a file written by dump_schedule. Funcs and stages the file
+     * doesn't mention keep their schedules. */
+    EXPORT void apply_schedule(const std::string &filename);
+
     /** Compile to object file and header pair, with the given
      * arguments. */
     EXPORT void compile_to_file(const std::string &filename_prefix,
@@ -183,6 +254,17 @@ public:
                                                       const std::vector<Argument> &args,
                                                       const std::vector<Target> &targets);
 
+    /** Compile just the runtime for a target to a static library, for
+     * linking with pipelines compiled with Target::NoRuntime. An
+     * application with many pipelines can compile all of them with
+     * no_runtime and link them with this one copy of the runtime,
+     * instead of carrying a copy in each of them. (Pipelines that
+     * need only part of the runtime, and whose application calls
+     * none of it directly, can instead carry just that part with
+     * Target::MinimalRuntime.) */
+    EXPORT static void compile_runtime_to_static_library(const std::string &filename_prefix,
+                                                         const Target &target = get_target_from_environment());
+
     /** Create an internal representation of lowered code as a self
      * contained Module suitable for further compilation. */
     EXPORT Module compile_to_module(const std::vector<Argument> &args,
@@ -197,9 +279,46 @@ public:
      * then you can call this ahead of time. Returns the raw function
      * pointer to the compiled pipeline. Default is to use the Target
      * returned from Halide::get_jit_target_from_environment()
+     *
+     * If the environment variable HL_JIT_CACHE_DIR names a writable
+     * directory, the machine code is also cached there, keyed by a
+     * hash of the lowered pipeline and the target, so that later
+     * processes compiling the same pipeline skip LLVM's code
+     * generator. Lowering still happens, to compute the key.
      */
      EXPORT void *compile_jit(const Target &target = get_jit_target_from_environment());
 
+    /** Jit compile several pipelines at once, on as many threads as
+     * there are cores (see Internal::compile_in_parallel). This is
+     * equivalent to calling compile_jit on each of them in turn. The
+     * pipelines may share Funcs, but none of them may be modified or
+     * realized until this returns. */
+    EXPORT static void compile_jit_in_parallel(const std::vector<Pipeline> &pipelines,
+                                               const Target &target = get_jit_target_from_environment());
+
+    /** Jit compile extra versions of the pipeline for the values that
+     * some scalar Params take most often. Once realize has been
+     * called threshold times with the same values of all of the given
+     * Params, the pipeline is compiled again with those values
+     * substituted in as constants, so that the loops and splits they
+     * size can be unrolled and vectorized, and later calls with the
+     * same values run that version. At most max_versions are kept;
+     * other values run the general version. An empty list of Params
+     * turns this off. */
+    EXPORT void specialize_jit_on_values(const std::vector<Expr> &params,
+                                         int threshold = 3, int max_versions = 4);
+
+    /** Jit compile the pipeline, and return a Callable that runs it
+     * with the given arguments, followed by one output buffer per
+     * tuple component per output Func. The argument layout is worked
+     * out once here, so calling the Callable costs little more than
+     * calling an AOT-compiled pipeline, which realize does not. Every
+     * Param and ImageParam the pipeline uses must be in args. The
+     * Callable keeps working if the pipeline is later recompiled or
+     * rescheduled, but runs the code compiled here. */
+    EXPORT Callable compile_to_callable(const std::vector<Argument> &args,
+                                        const Target &target = get_jit_target_from_environment());
+
     /** Set the error handler function that be called in the case of
      * runtime errors during halide pipelines. If you are compiling
      * statically, you can also just define your own function with
@@ -365,6 +484,25 @@ public:
      * back from the GPU. */
     EXPORT void realize(Realization dst, const Target &target = Target());
 
+    /** Bring the existing outputs in dst up to date after a region of
+     * one of the pipeline's inputs has changed, by recomputing only
+     * the parts of them that may depend on it. dst must hold
+     * everything computed by the previous realization, and all other
+     * inputs and params must be unchanged since then. input is the
+     * name of the ImageParam or Buffer that changed, and dirty is the
+     * rectangle of it that changed, as a (min, extent) pair per
+     * dimension. The points of each output that may depend on the
+     * dirty rectangle are found by following it forwards through
+     * the pipeline, then rounded out to whole tiles of the way the
+     * output is split, and only those points are recomputed. The
+     * intermediate Funcs are computed only as far as those tiles
+     * require. Nothing is recomputed if no output depends on the
+     * dirty rectangle. The outputs are copied to the host, and any
+     * device allocations they had are freed. */
+    EXPORT void realize_incremental(Realization dst, const std::string &input,
+                                    const std::vector<std::pair<int, int>> &dirty,
+                                    const Target &target = Target());
+
     /** For a given size of output, or a given set of output buffers,
      * determine the bounds required of all unbound ImageParams
      * referenced. Communicates the result by allocating new buffers
@@ -454,6 +592,84 @@ public:
     const ExternSignature &signature() const { return signature_; }
 };
 
+/** A jit-compiled Pipeline with a fixed argument list. See
+ * Pipeline::compile_to_callable. */
+class Callable {
+    friend class Pipeline;
+
+    // Keeps the pipeline, and the user context parameter that the
+    // handlers are reached through, alive.
+    Pipeline pipeline;
+    Internal::JITModule jit_module;
+    Internal::Parameter user_context_param;
+    bool report_profile = false;
+
+    // The arguments the Callable must be called with, in order.
+    std::vector<Argument> args;
+
+    // The values to pass to the argv function, with the slots for
+    // the arguments left null.
+    std::vector<const void *> arg_values;
+
+    // The index into arg_values of each argument.
+    std::vector<size_t> arg_slots;
+
+    // Buffers embedded in the pipeline, kept alive for the pointers
+    // in arg_values.
+    std::vector<Buffer<>> embedded_buffers;
+
+    EXPORT void call(std::vector<const void *> &values, size_t num_args) const;
+
+    EXPORT void check_buffer_arg(size_t i, const Buffer<> &buf) const;
+    EXPORT void check_scalar_arg(size_t i, Type t) const;
+
+    void fill_args(size_t i, std::vector<const void *> &values, halide_scalar_value_t *scalars) const {
+    }
+
+    template<typename T, typename ...Rest>
+    void fill_args(size_t i, std::vector<const void *> &values, halide_scalar_value_t *scalars,
+                   const Buffer<T> &first, Rest&&... rest) const {
+        if (i < args.size()) {
+            check_buffer_arg(i, first);
+            values[arg_slots[i]] = first.raw_buffer();
+        }
+        fill_args(i + 1, values, scalars, std::forward<Rest>(rest)...);
+    }
+
+    template<typename T, typename ...Rest,
+             typename = typename std::enable_if<std::is_arithmetic<typename std::decay<T>::type>::value>::type>
+    void fill_args(size_t i, std::vector<const void *> &values, halide_scalar_value_t *scalars,
+                   T &&first, Rest&&... rest) const {
+        typedef typename std::decay<T>::type scalar_type;
+        if (i < args.size()) {
+            check_scalar_arg(i, type_of<scalar_type>());
+            memcpy(&scalars[i], &first, sizeof(scalar_type));
+            values[arg_slots[i]] = &scalars[i];
+        }
+        fill_args(i + 1, values, scalars, std::forward<Rest>(rest)...);
+    }
+
+public:
+    /** Make an undefined Callable. */
+    Callable() {}
+
+    /** The arguments the Callable expects: the args passed to
+     * compile_to_callable, followed by the output buffers. */
+    const std::vector<Argument> &arguments() const { return args; }
+
+    /** Run the pipeline. Pass one Buffer for each buffer argument,
+     * and a value of exactly the right type for each scalar
+     * argument, in the order given by arguments(). Errors are
+     * reported as they are by Pipeline::realize. */
+    template<typename ...Args>
+    void operator()(Args&&... call_args) const {
+        std::vector<const void *> values(arg_values);
+        halide_scalar_value_t scalars[sizeof...(Args) + 1];
+        fill_args(0, values, scalars, std::forward<Args>(call_args)...);
+        call(values, sizeof...(Args));
+    }
+};
+
 struct JITExtern {
 private:
     // Note that exactly one of pipeline_ and extern_c_function_
@@ -5,7 +5,9 @@
 #include "Prefetch.h"
 #include "IRMutator.h"
 #include "Bounds.h"
+#include "IROperator.h"
 #include "Scope.h"
+#include "Substitute.h"
 #include "Util.h"
 
 namespace Halide {
@@ -63,6 +65,34 @@ Box buffer_bounds(const string &buf_name, int dims) {
     return bounds;
 }
 
+// The number of bytes of the buffer in a box of it read by s.
+Expr box_bytes(Stmt s, const string &buf_name, const Box &box) {
+    vector<Expr> mins;
+    for (size_t i = 0; i < box.size(); i++) {
+        mins.push_back(box[i].min);
+    }
+    Expr load = make_similar_load(s, buf_name, mins);
+    internal_assert(load.defined());
+    Expr bytes = load.type().bytes();
+    for (size_t i = 0; i < box.size(); i++) {
+        bytes *= box[i].max - box[i].min + 1;
+    }
+    return bytes;
+}
+
+// Replace the variable var with the value in the bounds of a box.
+Box shift_box(const Box &box, const string &var, Expr value) {
+    Box result = box;
+    for (size_t i = 0; i < result.size(); i++) {
+        result[i].min = substitute(var, value, result[i].min);
+        result[i].max = substitute(var, value, result[i].max);
+    }
+    if (result.used.defined()) {
+        result.used = substitute(var, value, result.used);
+    }
+    return result;
+}
+
 class InjectPrefetch : public IRMutator {
 public:
     InjectPrefetch(const map<string, Function> &e) : env(e) { }
@@ -176,9 +206,9 @@ private:
                 if (!ends_with(op->name, "." + p.var)) {
                     continue;
                 }
-                // Add loop variable + prefetch offset to interval scope for box computation
-                Expr fetch_at = loop_var + p.offset;
-                bounds.push(op->name, Interval(fetch_at, fetch_at));
+                // The boxes read by this iteration of the loop, in terms
+                // of the loop variable.
+                bounds.push(op->name, Interval(loop_var, loop_var));
                 map<string, Box> boxes_read = boxes_required(body, bounds);
                 bounds.pop(op->name);
 
@@ -206,9 +236,17 @@ private:
                 for (const auto &b : boxes_read) {
                     const string &buf_name = b.first;
 
+                    // Move the box the prefetch distance ahead.
+                    Expr offset = p.offset;
+                    if (p.unit == PrefetchUnit::Bytes) {
+                        Expr footprint = box_bytes(body, buf_name, b.second);
+                        offset = max(1, offset / max(1, footprint));
+                    }
+                    Box box = shift_box(b.second, op->name, loop_var + offset);
+
                     // Only prefetch the region that is in bounds.
-                    Box bounds = buffer_bounds(buf_name, b.second.size());
-                    Box prefetch_box = box_intersection(b.second, bounds);
+                    Box bounds = buffer_bounds(buf_name, box.size());
+                    Box prefetch_box = box_intersection(box, bounds);
 
                     body = add_prefetch(buf_name, prefetch_box, body);
                 }
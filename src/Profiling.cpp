@@ -7,10 +7,13 @@
 #include "CodeGen_Internal.h"
 #include "IRMutator.h"
 #include "IROperator.h"
+#include "IRVisitor.h"
+#include "MemoryTraffic.h"
 #include "Scope.h"
 #include "Simplify.h"
 #include "Substitute.h"
 #include "Util.h"
+#include "runtime/HalideRuntime.h"
 
 namespace Halide {
 namespace Internal {
@@ -25,9 +28,14 @@ public:
 
     vector<int> stack; // What produce nodes are we currently inside of.
 
+    vector<string> producers; // The names of the Funcs of those produce nodes.
+
     string pipeline_name;
 
-    InjectProfiling(const string &pipeline_name) : pipeline_name(pipeline_name) {
+    const Target &target;
+
+    InjectProfiling(const string &pipeline_name, const Target &target)
+        : pipeline_name(pipeline_name), target(target) {
         indices["overhead"] = 0;
         stack.push_back(0);
     }
@@ -35,6 +43,44 @@ public:
     map<int, uint64_t> func_stack_current; // map from func id -> current stack allocation
     map<int, uint64_t> func_stack_peak; // map from func id -> peak stack allocation
 
+    // Set the Func in the current thread's slot. With the
+    // profile_counters feature this also switches the thread's
+    // hardware counters, so it's a call into the runtime rather than
+    // a single store.
+    static Stmt set_thread_func(Expr tok, Expr idx, const Target &target) {
+        Expr slot = Variable::make(Handle(), "profiler_thread_slot");
+        Expr call;
+        if (target.has_feature(Target::ProfileCounters)) {
+            Expr profiler_pipeline_state = Variable::make(Handle(), "profiler_pipeline_state");
+            call = Call::make(Int(32), "halide_profiler_set_thread_func_counted",
+                              {profiler_pipeline_state, slot, tok, idx}, Call::Extern);
+        } else {
+            // This call gets inlined and becomes a single store instruction.
+            call = Call::make(Int(32), "halide_profiler_set_thread_func",
+                              {slot, tok, idx}, Call::Extern);
+        }
+        return Evaluate::make(call);
+    }
+
+    // Wrap a statement run by a thread in code that claims a slot for
+    // its current func, released when the enclosing function exits.
+    static Stmt claim_slot(Stmt s) {
+        Expr state = Variable::make(Handle(), "profiler_state");
+        Expr slot = Variable::make(Handle(), "profiler_thread_slot");
+        Expr claim = Call::make(Handle(), "halide_profiler_claim_thread_slot", {state}, Call::Extern);
+        Expr release = Call::make(Int(32), Call::register_destructor,
+                                  {Expr("halide_profiler_release_thread_slot"), slot}, Call::Intrinsic);
+        s = Block::make(Evaluate::make(release), s);
+        return LetStmt::make("profiler_thread_slot", claim, s);
+    }
+
+    // Strip down the tuple name, e.g. f.0 into f
+    static string normalize_name(const string &name) {
+        vector<string> v = split_string(name, ".");
+        internal_assert(v.size() > 0);
+        return v[0];
+    }
+
 private:
     using IRMutator::visit;
 
@@ -47,11 +93,38 @@ private:
 
     bool profiling_memory = true;
 
-    // Strip down the tuple name, e.g. f.0 into f
-    string normalize_name(const string &name) {
-        vector<string> v = split_string(name, ".");
-        internal_assert(v.size() > 0);
-        return v[0];
+    // Inside code offloaded to another device, which reports a single
+    // current func through the device's own copy of the profiler
+    // state, rather than one per thread.
+    bool in_offload = false;
+
+    // Set the Func the current thread is computing.
+    Stmt set_current_func(Expr idx) {
+        Expr profiler_token = Variable::make(Int(32), "profiler_token");
+        if (!in_offload) {
+            return set_thread_func(profiler_token, idx, target);
+        }
+        Expr profiler_state = Variable::make(Handle(), "profiler_state");
+        Expr call;
+        if (target.has_feature(Target::ProfileCounters)) {
+            // The Hexagon remote runtime also counts the cycles and
+            // packets of each func, for the host to collect after
+            // each run.
+            call = Call::make(Int(32), "halide_hexagon_profiler_set_current_func",
+                              {profiler_state, profiler_token, idx}, Call::Extern);
+        } else {
+            // This call gets inlined and becomes a single store instruction.
+            call = Call::make(Int(32), "halide_profiler_set_current_func",
+                              {profiler_state, profiler_token, idx}, Call::Extern);
+        }
+        return Evaluate::make(call);
+    }
+
+    // Mark the current thread as not computing anything, e.g. while
+    // it waits for the tasks of a parallel loop.
+    Stmt set_idle() {
+        internal_assert(!in_offload);
+        return set_thread_func(halide_profiler_outside_of_halide, 0, target);
     }
 
     int get_func_id(const string &name) {
@@ -70,6 +143,7 @@ private:
     Expr compute_allocation_size(const vector<Expr> &extents,
                                  const Expr &condition,
                                  const Type &type,
+                                 MemoryType memory_type,
                                  const std::string &name,
                                  bool &on_stack) {
         on_stack = true;
@@ -80,9 +154,12 @@ private:
         }
 
         int32_t constant_size = Allocate::constant_allocation_size(extents, name);
-        if (constant_size > 0) {
+        if (constant_size > 0 && memory_type != MemoryType::Heap &&
+            memory_type != MemoryType::VTCM) {
             int64_t stack_bytes = constant_size * type.bytes();
-            if (can_allocation_fit_on_stack(stack_bytes)) { // Allocation on stack
+            if (memory_type == MemoryType::Stack ||
+                memory_type == MemoryType::Register ||
+                can_allocation_fit_on_stack(stack_bytes, target)) { // Allocation on stack
                 return make_const(UInt(64), stack_bytes);
             }
         }
@@ -112,7 +189,7 @@ private:
         Expr condition = mutate(op->condition);
 
         bool on_stack;
-        Expr size = compute_allocation_size(new_extents, condition, op->type, op->name, on_stack);
+        Expr size = compute_allocation_size(new_extents, condition, op->type, op->memory_type, op->name, on_stack);
         internal_assert(size.type() == UInt(64));
         func_alloc_sizes.push(op->name, {on_stack, size});
 
@@ -139,7 +216,7 @@ private:
             new_expr.same_as(op->new_expr)) {
             stmt = op;
         } else {
-            stmt = Allocate::make(op->name, op->type, new_extents, condition, body, new_expr, op->free_function);
+            stmt = Allocate::make(op->name, op->type, op->memory_type, new_extents, condition, body, new_expr, op->free_function);
         }
 
         if (!is_zero(size) && !on_stack && profiling_memory) {
@@ -181,14 +258,71 @@ private:
         }
     }
 
+    // The number of values one run of s stores to the given Func (or
+    // to the first value of a Tuple-valued one), outside of any loops.
+    static int values_stored(const Stmt &s, const string &func) {
+        class CountStores : public IRVisitor {
+            using IRVisitor::visit;
+            const string &func;
+            void visit(const For *op) {
+            }
+            void visit(const Store *op) {
+                if (op->name == func || op->name == func + ".0") {
+                    count += op->value.type().lanes();
+                }
+            }
+        public:
+            int count = 0;
+            CountStores(const string &func) : func(func) {}
+        } counter(func);
+        s.accept(&counter);
+        return counter.count;
+    }
+
+    // Whether s contains a loop whose name starts with the given prefix.
+    static bool has_loop(const Stmt &s, const string &prefix) {
+        class FindLoop : public IRVisitor {
+            using IRVisitor::visit;
+            const string &prefix;
+            void visit(const For *op) {
+                found |= starts_with(op->name, prefix);
+                IRVisitor::visit(op);
+            }
+        public:
+            bool found = false;
+            FindLoop(const string &prefix) : prefix(prefix) {}
+        } finder(prefix);
+        s.accept(&finder);
+        return finder.found;
+    }
+
+    // Add to the number of points computed by a Func.
+    Stmt count_points(int idx, Expr points) {
+        internal_assert(!in_offload);
+        Expr profiler_pipeline_state = Variable::make(Handle(), "profiler_pipeline_state");
+        return Evaluate::make(Call::make(Int(32), "halide_profiler_count_points",
+                                         {profiler_pipeline_state, idx, cast<uint64_t>(points)},
+                                         Call::Extern));
+    }
+
     void visit(const ProducerConsumer *op) {
         int idx;
         Stmt body;
         if (op->is_producer) {
             idx = get_func_id(op->name);
             stack.push_back(idx);
+            producers.push_back(op->name);
             body = mutate(op->body);
+            producers.pop_back();
             stack.pop_back();
+
+            // Points stored outside of any loop, e.g. by a Func with
+            // no dimensions, are counted here. The others are counted
+            // at the innermost loops of the pure definition.
+            int points = values_stored(op->body, op->name);
+            if (points > 0 && !in_offload) {
+                body = Block::make(count_points(idx, points), body);
+            }
         } else {
             body = mutate(op->body);
             // At the beginning of the consume step, set the current task
@@ -196,14 +330,7 @@ private:
             idx = stack.back();
         }
 
-        Expr profiler_token = Variable::make(Int(32), "profiler_token");
-        Expr profiler_state = Variable::make(Handle(), "profiler_state");
-
-        // This call gets inlined and becomes a single store instruction.
-        Expr set_task = Call::make(Int(32), "halide_profiler_set_current_func",
-                                   {profiler_state, profiler_token, idx}, Call::Extern);
-
-        body = Block::make(Evaluate::make(set_task), body);
+        body = Block::make(set_current_func(idx), body);
 
         stmt = ProducerConsumer::make(op->name, op->is_producer, body);
     }
@@ -212,11 +339,15 @@ private:
         Stmt body = op->body;
 
         // The for loop indicates a device transition or a
-        // parallel job launch. Decrement the number of active
-        // threads outside the loop, and increment it inside the
-        // body.
+        // parallel job launch. For a device transition, decrement the
+        // number of active threads outside the loop, and increment it
+        // inside the body. Each task of a parallel loop on the host
+        // claims its own slot for its current func, while the
+        // launching thread marks itself idle.
         bool update_active_threads = (op->device_api == DeviceAPI::Hexagon ||
-                                      op->is_parallel());
+                                      (in_offload && op->is_parallel()));
+        bool claim_thread_slot = !in_offload && op->is_parallel() &&
+            (op->device_api == DeviceAPI::None || op->device_api == DeviceAPI::Host);
 
         Expr state = Variable::make(Handle(), "profiler_state");
         Stmt incr_active_threads =
@@ -237,9 +368,12 @@ private:
             // hexagon. We don't support per-func stats remotely,
             // which means we can't do memory accounting.
             bool old_profiling_memory = profiling_memory;
+            bool old_in_offload = in_offload;
             profiling_memory = false;
+            in_offload = true;
             body = mutate(body);
             profiling_memory = old_profiling_memory;
+            in_offload = old_in_offload;
 
             // Get the profiler state pointer from scratch inside the
             // kernel. There will be a separate copy of the state on
@@ -254,16 +388,40 @@ private:
             body = op->body;
         }
 
+        if (claim_thread_slot) {
+            body = Block::make(set_current_func(stack.back()), body);
+            body = claim_slot(body);
+        }
+
         stmt = For::make(op->name, op->min, op->extent, op->for_type, op->device_api, body);
 
         if (update_active_threads) {
             stmt = Block::make({decr_active_threads, stmt, incr_active_threads});
         }
+        if (claim_thread_slot) {
+            stmt = Block::make({set_idle(), stmt, set_current_func(stack.back())});
+        }
+
+        // Count the points of a Func at the innermost loops of its
+        // pure definition, once per run of the loop rather than per
+        // iteration.
+        if (!in_offload && !producers.empty() &&
+            (op->device_api == DeviceAPI::None || op->device_api == DeviceAPI::Host)) {
+            const string prefix = producers.back() + ".s0.";
+            if (starts_with(op->name, prefix) && !has_loop(op->body, prefix)) {
+                int points = values_stored(op->body, producers.back());
+                if (points > 0) {
+                    stmt = Block::make(count_points(stack.back(), op->extent * points), stmt);
+                }
+            }
+        }
     }
 };
 
-Stmt inject_profiling(Stmt s, string pipeline_name) {
-    InjectProfiling profiling(pipeline_name);
+Stmt inject_profiling(Stmt s, string pipeline_name, const Target &t) {
+    vector<FuncTraffic> traffic = estimate_memory_traffic(s);
+
+    InjectProfiling profiling(pipeline_name, t);
     s = profiling.mutate(s);
 
     int num_funcs = (int)(profiling.indices.size());
@@ -271,13 +429,19 @@ Stmt inject_profiling(Stmt s, string pipeline_name) {
     Expr func_names_buf = Load::make(Handle(), "profiling_func_names", 0, Buffer<>(), Parameter());
     func_names_buf = Call::make(Handle(), Call::address_of, {func_names_buf}, Call::Intrinsic);
 
+    // A global slot, in which the runtime caches the pipeline's stats
+    // the first time it runs, so that later runs don't need to look
+    // them up.
+    Buffer<void *> pipeline_state_slot = Buffer<void *>::make_scalar(pipeline_name + "_profiler_pipeline_state_buf");
+    pipeline_state_slot() = nullptr;
+    Expr get_pipeline_state = Load::make(Handle(), pipeline_state_slot.name(), 0, pipeline_state_slot, Parameter());
+    Expr pipeline_state_ptr = Call::make(Handle(), Call::address_of, {get_pipeline_state}, Call::Intrinsic);
+
     Expr start_profiler = Call::make(Int(32), "halide_profiler_pipeline_start",
-                                     {pipeline_name, num_funcs, func_names_buf}, Call::Extern);
+                                     {pipeline_name, num_funcs, func_names_buf, pipeline_state_ptr}, Call::Extern);
 
     Expr get_state = Call::make(Handle(), "halide_profiler_get_state", {}, Call::Extern);
 
-    Expr get_pipeline_state = Call::make(Handle(), "halide_profiler_get_pipeline_state", {pipeline_name}, Call::Extern);
-
     Expr profiler_token = Variable::make(Int(32), "profiler_token");
 
     Expr stop_profiler = Call::make(Int(32), Call::register_destructor,
@@ -294,14 +458,32 @@ Stmt inject_profiling(Stmt s, string pipeline_name) {
         s = Block::make(update_stack, s);
     }
 
-    Expr profiler_state = Variable::make(Handle(), "profiler_state");
-    Stmt incr_active_threads =
-        Evaluate::make(Call::make(Int(32), "halide_profiler_incr_active_threads",
-                                  {profiler_state}, Call::Extern));
-    Stmt decr_active_threads =
-        Evaluate::make(Call::make(Int(32), "halide_profiler_decr_active_threads",
-                                  {profiler_state}, Call::Extern));
-    s = Block::make({incr_active_threads, s, decr_active_threads});
+    // The compiler's estimates of the work per point of each func,
+    // three floats per func, in a constant buffer that the runtime
+    // copies into the func stats.
+    if (!traffic.empty()) {
+        Buffer<float> estimates(3 * num_funcs, pipeline_name + "_profiler_func_estimates_buf");
+        estimates.fill(0.0f);
+        for (const FuncTraffic &f : traffic) {
+            auto iter = profiling.indices.find(InjectProfiling::normalize_name(f.name));
+            if (iter != profiling.indices.end()) {
+                estimates(3 * iter->second) = (float)f.bytes_loaded;
+                estimates(3 * iter->second + 1) = (float)f.bytes_stored;
+                estimates(3 * iter->second + 2) = (float)f.ops;
+            }
+        }
+        Expr estimates_buf = Load::make(Float(32), estimates.name(), 0, estimates, Parameter());
+        estimates_buf = Call::make(Handle(), Call::address_of, {estimates_buf}, Call::Intrinsic);
+
+        Expr profiler_pipeline_state = Variable::make(Handle(), "profiler_pipeline_state");
+        Stmt set_estimates = Evaluate::make(Call::make(Int(32), "halide_profiler_set_func_estimates",
+                                                       {profiler_pipeline_state, estimates_buf}, Call::Extern));
+        s = Block::make(set_estimates, s);
+    }
+
+    // Time outside of any producer is billed to the overhead slot.
+    Stmt set_overhead = InjectProfiling::set_thread_func(profiler_token, 0, t);
+    s = InjectProfiling::claim_slot(Block::make(set_overhead, s));
 
     s = LetStmt::make("profiler_pipeline_state", get_pipeline_state, s);
     s = LetStmt::make("profiler_state", get_state, s);
@@ -318,7 +500,7 @@ Stmt inject_profiling(Stmt s, string pipeline_name) {
                                         i, Parameter()), s);
         }
         s = Block::make(s, Free::make("profiling_func_stack_peak_buf"));
-        s = Allocate::make("profiling_func_stack_peak_buf", UInt(64), {num_funcs}, const_true(), s);
+        s = Allocate::make("profiling_func_stack_peak_buf", UInt(64), MemoryType::Auto, {num_funcs}, const_true(), s);
     }
 
     for (std::pair<string, int> p : profiling.indices) {
@@ -326,7 +508,7 @@ Stmt inject_profiling(Stmt s, string pipeline_name) {
     }
 
     s = Block::make(s, Free::make("profiling_func_names"));
-    s = Allocate::make("profiling_func_names", Handle(), {num_funcs}, const_true(), s);
+    s = Allocate::make("profiling_func_names", Handle(), MemoryType::Auto, {num_funcs}, const_true(), s);
     s = Block::make(Evaluate::make(stop_profiler), s);
 
     return s;
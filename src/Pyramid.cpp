@@ -0,0 +1,173 @@
+#include <algorithm>
+
+#include "Pyramid.h"
+#include "IROperator.h"
+#include "Simplify.h"
+
+namespace Halide {
+
+using std::vector;
+
+Expr Pyramid::gaussian_downsample(std::function<Expr(Expr, Expr)> prev, Expr x, Expr y) {
+    const int weights[] = {1, 3, 3, 1};
+    Type t = prev(2 * x, 2 * y).type();
+    Type acc = (t.is_float() || t.bits() >= 32) ? t : Int(32);
+    Expr total;
+    for (int j = 0; j < 4; j++) {
+        for (int i = 0; i < 4; i++) {
+            Expr e = cast(acc, prev(2 * x + i - 1, 2 * y + j - 1)) * (weights[i] * weights[j]);
+            total = total.defined() ? total + e : e;
+        }
+    }
+    if (t.is_float()) {
+        return total * (1.0f / 64);
+    }
+    return cast(t, (total + 32) / 64);
+}
+
+Pyramid::Pyramid(Func base, Expr width, Expr height, int levels,
+                 Downsampler downsample, const std::string &name)
+    : packed_func(name) {
+    user_assert(base.defined())
+        << "Can't make a pyramid of the undefined Func " << base.name() << "\n";
+    user_assert(base.dimensions() >= 2)
+        << "Can't make a pyramid of " << base.name() << ", which has "
+        << base.dimensions() << " dimensions. It needs at least two.\n";
+    user_assert(base.outputs() == 1)
+        << "Can't make a pyramid of " << base.name() << ", which has "
+        << base.outputs() << " outputs.\n";
+    user_assert(levels >= 1)
+        << "A pyramid needs at least one level, not " << levels << "\n";
+
+    const vector<Var> args = base.args();
+    const Type t = base.output_types()[0];
+    const std::string prefix = name + "_level_";
+
+    // Level l starts at the right of level zero, and below all the
+    // levels between it and level zero.
+    for (int l = 0; l < levels; l++) {
+        widths.push_back(simplify((width + ((1 << l) - 1)) / (1 << l)));
+        heights.push_back(simplify((height + ((1 << l) - 1)) / (1 << l)));
+        if (l == 0) {
+            x_offsets.push_back(0);
+            y_offsets.push_back(0);
+        } else {
+            x_offsets.push_back(width);
+            y_offsets.push_back(l == 1 ? Expr(0) : simplify(y_offsets[l-1] + heights[l-1]));
+        }
+    }
+
+    // The levels fill the packed Func in place, so its pure
+    // definition only names the variables.
+    packed_func(args) = undef(t);
+
+    for (int l = 0; l < levels; l++) {
+        RDom r({{0, widths[l]}, {0, heights[l]}}, prefix + std::to_string(l));
+        vector<Expr> site(args.begin(), args.end());
+        site[0] = r.x + x_offsets[l];
+        site[1] = r.y + y_offsets[l];
+
+        Expr value;
+        if (l == 0) {
+            vector<Expr> coords(args.begin(), args.end());
+            coords[0] = r.x;
+            coords[1] = r.y;
+            value = base(coords);
+        } else {
+            // Read the previous level directly from the packed Func,
+            // rather than through its view, which would make the view
+            // and the packed Func call each other.
+            Func packed = packed_func;
+            Expr w = widths[l-1], h = heights[l-1];
+            Expr ox = x_offsets[l-1], oy = y_offsets[l-1];
+            auto prev = [=](Expr x, Expr y) {
+                vector<Expr> coords(args.begin(), args.end());
+                coords[0] = clamp(x, 0, w - 1) + ox;
+                coords[1] = clamp(y, 0, h - 1) + oy;
+                return packed(coords);
+            };
+            value = cast(t, downsample(prev, r.x, r.y));
+        }
+        packed_func(site) = value;
+        domains.push_back(r);
+
+        Func view(prefix + std::to_string(l));
+        vector<Expr> coords(args.begin(), args.end());
+        coords[0] = clamp(args[0], 0, widths[l] - 1) + x_offsets[l];
+        coords[1] = clamp(args[1], 0, heights[l] - 1) + y_offsets[l];
+        view(args) = packed_func(coords);
+        views.push_back(view);
+    }
+
+    // Nothing outside the levels is ever read, so there's no need to
+    // work out the region the consumers of the views need.
+    Expr packed_width = levels > 1 ? simplify(width + widths[1]) : width;
+    Expr packed_height = simplify(max(height, y_offsets.back() + heights.back()));
+    packed_func.bound(args[0], 0, packed_width).bound(args[1], 0, packed_height);
+
+    // Left inline, a Func with update definitions is computed in the
+    // innermost loop of its consumer, which for a whole pyramid is
+    // never what's wanted.
+    packed_func.compute_root();
+}
+
+Func Pyramid::operator[](int level) const {
+    user_assert(level >= 0 && level < levels())
+        << "Pyramid " << packed_func.name() << " has no level " << level
+        << ". It has " << levels() << " levels.\n";
+    return views[level];
+}
+
+Expr Pyramid::width(int level) const {
+    user_assert(level >= 0 && level < levels())
+        << "Pyramid " << packed_func.name() << " has no level " << level << "\n";
+    return widths[level];
+}
+
+Expr Pyramid::height(int level) const {
+    user_assert(level >= 0 && level < levels())
+        << "Pyramid " << packed_func.name() << " has no level " << level << "\n";
+    return heights[level];
+}
+
+Pyramid &Pyramid::schedule(int vector_width, int task_rows) {
+    user_assert(vector_width >= 1 && task_rows >= 1)
+        << "Can't schedule pyramid " << packed_func.name() << " with a vector width of "
+        << vector_width << " and " << task_rows << " rows per task\n";
+
+    const vector<Var> args = packed_func.args();
+    for (int l = 0; l < levels(); l++) {
+        Stage s = packed_func.update(l);
+        RVar rx = domains[l].x, ry = domains[l].y;
+        RVar ryo(ry.name() + "_task"), ryi(ry.name() + "_in_task");
+
+        // Each level only reads the one before it, which is in a
+        // different part of the packed Func, so the rows of a level
+        // can be computed in any order.
+        if (l > 0) {
+            s.allow_race_conditions();
+        }
+
+        // Levels known to be too small to fill a vector or a strip
+        // are computed serially.
+        const int rows = task_rows << std::min(l, 16);
+        const int64_t *w = Internal::as_const_int(widths[l]);
+        const int64_t *h = Internal::as_const_int(heights[l]);
+        if (!w || *w >= vector_width) {
+            s.vectorize(rx, vector_width);
+        }
+        if (!h || *h > rows) {
+            vector<VarOrRVar> order;
+            order.push_back(rx);
+            for (size_t i = 2; i < args.size(); i++) {
+                order.push_back(args[i]);
+            }
+            order.push_back(ryi);
+            order.push_back(ryo);
+            s.split(ry, ryo, ryi, rows).reorder(order).parallel(ryo);
+        }
+    }
+    return *this;
+}
+
+}
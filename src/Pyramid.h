@@ -0,0 +1,114 @@
+#ifndef HALIDE_PYRAMID_H
+#define HALIDE_PYRAMID_H
+
+/** \file
+ * Defines Pyramid, a multi-resolution image whose levels are all
+ * stored in one allocation and scheduled together.
+ */
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "Func.h"
+#include "RDom.h"
+
+namespace Halide {
+
+/** A Gaussian (or similar) image pyramid. Level zero is a copy of a
+ * base Func, and each subsequent level is half the size of the one
+ * before it in the first two dimensions, computed from it by a
+ * downsampling kernel. Any further dimensions of the base Func (e.g.
+ * color channels) are passed through unchanged.
+ *
+ * Rather than using one Func per level, all the levels are packed
+ * into a single Func: level zero at the origin, and the coarser
+ * levels stacked on top of each other to its right:
+ *
+ \code
+ +----------------+--------+
+ |                |   1    |
+ |                |        |
+ |       0        +----+---+
+ |                | 2  |
+ |                +--+-+
+ |                |3 |
+ +----------------+--+
+ \endcode
+ *
+ * Each level is an update definition of the packed Func, so the
+ * levels share one allocation, have no per-level boundary conditions
+ * or bounds queries, and can be scheduled jointly with \ref
+ * Pyramid::schedule. Consumers access a level through operator[],
+ * which clamps to the edges of the level:
+ *
+ \code
+ Func input;   // some Func of x, y and c
+ Pyramid gaussian(input, width, height, 8);
+ gaussian.schedule(8);
+ Func top = gaussian[7];
+ \endcode
+ */
+class Pyramid {
+public:
+    /** A downsampling kernel. It is given the previous level, which
+     * takes the coordinates in its first two dimensions and is clamped
+     * to its edges, and the coordinates in the new level at which to
+     * compute it. */
+    typedef std::function<Expr(std::function<Expr(Expr, Expr)>, Expr, Expr)> Downsampler;
+
+    /** The separable [1 3 3 1] / 8 kernel used by the local laplacian
+     * filter. Integer types are accumulated in 32 bits, and rounded. */
+    EXPORT static Expr gaussian_downsample(std::function<Expr(Expr, Expr)> prev, Expr x, Expr y);
+
+    /** Build a pyramid of the given number of levels over the region
+     * [0, width) x [0, height) of the first two dimensions of
+     * base. The base must have a single output, and the values of the
+     * downsampler are cast to its type. */
+    EXPORT Pyramid(Func base, Expr width, Expr height, int levels,
+                   Downsampler downsample = gaussian_downsample,
+                   const std::string &name = "pyramid");
+
+    /** The number of levels. */
+    int levels() const {
+        return (int)views.size();
+    }
+
+    /** A Func which reads the given level of the pyramid, clamping to
+     * its edges. It is inlined into its consumers by default, and
+     * shouldn't be scheduled otherwise. */
+    EXPORT Func operator[](int level) const;
+
+    /** The size of the given level. */
+    // @{
+    EXPORT Expr width(int level) const;
+    EXPORT Expr height(int level) const;
+    // @}
+
+    /** The packed Func that holds all the levels. It is computed at
+     * the root unless it is scheduled otherwise. Update definition l
+     * computes level l. */
+    Func packed() const {
+        return packed_func;
+    }
+
+    /** Schedule all the levels together, with each level vectorized
+     * by the given width and parallelized over strips of rows. The
+     * strips of level zero are task_rows high, and they double in
+     * height at each level, so that each task computes about the same
+     * number of pixels: the fine levels are streamed through many
+     * small tasks, and the coarse levels are computed in a few larger
+     * ones, down to a single task once a level is no taller than a
+     * strip. */
+    EXPORT Pyramid &schedule(int vector_width, int task_rows = 8);
+
+private:
+    Func packed_func;
+    std::vector<Func> views;
+    std::vector<Expr> widths, heights, x_offsets, y_offsets;
+    std::vector<RDom> domains;
+};
+
+}
+
+#endif
@@ -5,82 +5,79 @@
 namespace Halide {
 namespace Internal {
 
-using std::vector;
+using std::pair;
 using std::string;
+using std::vector;
 
 namespace {
 
-// Some randomly-generated integers.
-#define C0 576942909
-#define C1 1121052041
-#define C2 1040796640
-
-// Permute a 32-bit unsigned integer using a fixed psuedorandom
-// permutation.
-Expr rng32(Expr x) {
-    internal_assert(x.type() == UInt(32));
-
-    // A polynomial P with coefficients C0 .. CN induces a permutation
-    // modulo 2^d iff:
-    // 1) P(0) != P(1) modulo 2
-    // 2) sum(i * Ci) is odd
-
-    // (See http://en.wikipedia.org/wiki/Permutation_polynomial#Rings_Z.2FpkZ)
-
-    // For a quadratic, this is only satisfied by:
-    // C0 anything
-    // C1 odd
-    // C2 even
-
-    // The coefficients defined above were chosen to satisfy this
-    // property.
-
-    // It's pretty random, but note that the quadratic term disappears
-    // if inputs are the multiples of 2^16, and so you get a linear
-    // sequence.  However, *that* linear sequence probably varies in
-    // the low bits, so if you run in through the permutation again,
-    // you should break it up. All actual use of this runs it through
-    // multiple times in order to combine several inputs, so it should
-    // be ok. The other flaw is it's a permutation, so you get no
-    // collisions. Birthday paradox be damned.
-
-    // However, it's exceedingly cheap to compute, as it only uses
-    // vectorizable int32 muls and adds, and the resulting numbers:
-    // - Have the correct moments for a uniform distribution
-    // - Have no serial correlations in any of the bits
-    // - Have a completely flat power spectrum
-    // - Have no visible patterns
-
-    // So I declare this good enough for image processing.
-
-    // If it's just a const (which it often is), save the simplifier some work:
-    if (const uint64_t *i = as_const_uint(x)) {
-        return make_const(UInt(32), ((C2 * (*i)) + C1) * (*i) + C0);
+// The multiplier and key increment of Philox2x32, from "Parallel
+// Random Numbers: As Easy as 1, 2, 3" by Salmon et al.
+const uint32_t philox_m = 0xD256D193;
+const uint32_t philox_w = 0x9E3779B9;
+const int philox_rounds = 10;
+
+// Fold a term into a 32-bit key, with a widening multiply that mixes
+// the high half into the low half.
+Expr mix_into_key(Expr key, Expr term) {
+    if (!is_zero(key)) {
+        term = key ^ term;
     }
-
-    return (((C2 * x) + C1) * x) + C0;
+    Expr product = cast<uint64_t>(term) * make_const(UInt(64), philox_m);
+    string name = unique_name('R');
+    Expr p = Variable::make(UInt(64), name);
+    return Let::make(name, product, cast<uint32_t>(p >> 32) ^ cast<uint32_t>(p));
 }
 
 }
 
 Expr random_int(const vector<Expr> &e) {
     internal_assert(e.size());
-    internal_assert(e[0].type() == Int(32) || e[0].type() == UInt(32));
-    // Permute the first term
-    Expr result = rng32(cast(UInt(32), e[0]));
-    for (size_t i = 1; i < e.size(); i++) {
-        internal_assert(e[i].type() == Int(32) || e[i].type() == UInt(32));
-        // Add in the next term and permute again
+    for (const Expr &i : e) {
+        internal_assert(i.type() == Int(32) || i.type() == UInt(32));
+    }
+
+    // This is Philox2x32-10, a counter-based generator: a keyed
+    // bijection of a two-word counter, made of rounds of a 32x32->64
+    // bit multiply and some xors. The widening multiplies vectorize
+    // natively on x86 (pmuludq), arm (umull) and GPUs, and the result
+    // only depends on the inputs, not on how the loop that computes
+    // it is scheduled.
+
+    // The last two terms (usually the innermost pure vars) are the
+    // counter, and the rest are folded into the key.
+    size_t n = e.size();
+    Expr c0 = n > 1 ? cast<uint32_t>(e[n - 2]) : make_zero(UInt(32));
+    Expr c1 = cast<uint32_t>(e[n - 1]);
+    Expr key = make_zero(UInt(32));
+    for (size_t i = 0; i + 2 < n; i++) {
+        key = mix_into_key(key, cast<uint32_t>(e[i]));
+    }
+
+    // Each round uses the key, which could be a large Expr.
+    vector<pair<string, Expr>> lets;
+    if (!is_const(key)) {
         string name = unique_name('R');
-        // If it's a const, save the simplifier some work
-        const uint64_t *ir = as_const_uint(result);
-        const uint64_t *ie = as_const_uint(e[i]);
-        if (ir && ie) {
-            result = rng32(make_const(UInt(32), (*ir) + (*ie)));
-        } else {
-            result = Let::make(name, result + cast<uint32_t>(e[i]),
-                               rng32(Variable::make(UInt(32), name)));
-        }
+        lets.push_back({name, key});
+        key = Variable::make(UInt(32), name);
+    }
+
+    for (int i = 0; i < philox_rounds; i++) {
+        string name = unique_name('R');
+        lets.push_back({name, cast<uint64_t>(c0) * make_const(UInt(64), philox_m)});
+        Expr p = Variable::make(UInt(64), name);
+        uint32_t bump = philox_w * (uint32_t)i;
+        const uint64_t *const_key = as_const_uint(key);
+        Expr round_key = const_key ?
+            make_const(UInt(32), (uint32_t)(*const_key) + bump) :
+            key + make_const(UInt(32), bump);
+        c0 = cast<uint32_t>(p >> 32) ^ round_key ^ c1;
+        c1 = cast<uint32_t>(p);
+    }
+
+    Expr result = c0;
+    for (size_t i = lets.size(); i > 0; i--) {
+        result = Let::make(lets[i - 1].first, lets[i - 1].second, result);
     }
     return result;
 }
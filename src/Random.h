@@ -17,7 +17,9 @@ Expr random_float(const std::vector<Expr> &);
 
 /** Return a random unsigned integer between zero and 2^32-1 that
  * varies deterministically based on the input expressions (which must
- * be integers or unsigned integers). */
+ * be integers or unsigned integers). This is the Philox2x32-10
+ * generator, with the last two inputs as the counter and the rest
+ * folded into the key. */
 Expr random_int(const std::vector<Expr> &);
 
 /** Convert calls to random() to IR generated by random_float and
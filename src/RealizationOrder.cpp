@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <set>
 
 #include "RealizationOrder.h"
@@ -60,6 +61,43 @@ vector<string> realization_order(const vector<Function> &outputs,
         }
     }
 
+    // Realize each Func that is computed with another Func right
+    // after it, so that their loop nests can be fused. See
+    // Stage::compute_with.
+    vector<string> fused_children;
+    for (const string &fn : order) {
+        const FuseLoopLevel &fuse = env.find(fn)->second.schedule().fuse_level();
+        if (fuse.defined()) {
+            user_assert(env.count(fuse.func))
+                << "Func " << fn << " is computed with " << fuse.func
+                << ", which is not used in this pipeline.\n";
+            fused_children.push_back(fn);
+        }
+    }
+    map<string, string> last_fused;
+    for (const string &child : fused_children) {
+        const string &parent = env.find(child)->second.schedule().fuse_level().func;
+        const string &after = last_fused.count(parent) ? last_fused[parent] : parent;
+        order.erase(std::find(order.begin(), order.end(), child));
+        order.insert(std::find(order.begin(), order.end(), after) + 1, child);
+        last_fused[parent] = child;
+    }
+    if (!fused_children.empty()) {
+        map<string, size_t> position;
+        for (size_t i = 0; i < order.size(); i++) {
+            position[order[i]] = i;
+        }
+        for (const string &fn : order) {
+            for (const string &callee : graph[fn]) {
+                user_assert(callee == fn || position[callee] < position[fn])
+                    << "Func " << fn << " uses " << callee << ", which would be computed after it "
+                    << "once the Funcs scheduled with compute_with are moved next to the Funcs "
+                    << "they are computed with. A Func can't be computed with another Func "
+                    << "that it depends on, or that depends on it.\n";
+            }
+        }
+    }
+
     return order;
 }
 
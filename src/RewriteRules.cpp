@@ -0,0 +1,210 @@
+#include <algorithm>
+#include <iostream>
+
+#include "RewriteRules.h"
+#include "IREquality.h"
+#include "IRMatch.h"
+#include "IROperator.h"
+#include "Simplify.h"
+#include "Substitute.h"
+
+namespace Halide {
+namespace Internal {
+
+using std::map;
+using std::pair;
+using std::string;
+using std::vector;
+
+namespace {
+
+template<typename T>
+void binary_operands(const Expr &e, Expr *a, Expr *b) {
+    const T *op = e.as<T>();
+    *a = op->a;
+    *b = op->b;
+}
+
+// Get the first two operands of an Expr, if it has them.
+void operands(const Expr &e, Expr *a, Expr *b) {
+    switch (e->type_info()) {
+    case IRNodeType::Add: binary_operands<Add>(e, a, b); break;
+    case IRNodeType::Sub: binary_operands<Sub>(e, a, b); break;
+    case IRNodeType::Mul: binary_operands<Mul>(e, a, b); break;
+    case IRNodeType::Div: binary_operands<Div>(e, a, b); break;
+    case IRNodeType::Mod: binary_operands<Mod>(e, a, b); break;
+    case IRNodeType::Min: binary_operands<Min>(e, a, b); break;
+    case IRNodeType::Max: binary_operands<Max>(e, a, b); break;
+    case IRNodeType::EQ: binary_operands<EQ>(e, a, b); break;
+    case IRNodeType::NE: binary_operands<NE>(e, a, b); break;
+    case IRNodeType::LT: binary_operands<LT>(e, a, b); break;
+    case IRNodeType::LE: binary_operands<LE>(e, a, b); break;
+    case IRNodeType::GT: binary_operands<GT>(e, a, b); break;
+    case IRNodeType::GE: binary_operands<GE>(e, a, b); break;
+    case IRNodeType::And: binary_operands<And>(e, a, b); break;
+    case IRNodeType::Or: binary_operands<Or>(e, a, b); break;
+    case IRNodeType::Not: *a = e.as<Not>()->a; break;
+    case IRNodeType::Cast: *a = e.as<Cast>()->value; break;
+    case IRNodeType::Broadcast: *a = e.as<Broadcast>()->value; break;
+    case IRNodeType::Ramp:
+        *a = e.as<Ramp>()->base;
+        *b = e.as<Ramp>()->stride;
+        break;
+    case IRNodeType::Select:
+        *a = e.as<Select>()->condition;
+        *b = e.as<Select>()->true_value;
+        break;
+    default:
+        break;
+    }
+}
+
+int node_type(const Expr &e) {
+    return e.defined() ? (int)e->type_info() : -1;
+}
+
+}  // namespace
+
+void RewriteRules::add(Expr pattern, Expr result, Condition condition) {
+    internal_assert(pattern.defined() && result.defined());
+    internal_assert(!pattern.as<Variable>()) << "The pattern of a rewrite rule can't be a wildcard\n";
+
+    Rule rule;
+    rule.pattern = pattern;
+    rule.result = result;
+    rule.condition = condition;
+    Expr a, b;
+    operands(pattern, &a, &b);
+    rule.operands[0] = a.as<Variable>() ? -1 : node_type(a);
+    rule.operands[1] = b.as<Variable>() ? -1 : node_type(b);
+    if (result.as<Variable>()) {
+        rule.result_part = Rule::Wildcard;
+    } else if (a.defined() && equal(result, a)) {
+        rule.result_part = Rule::FirstOperand;
+    } else if (b.defined() && equal(result, b)) {
+        rule.result_part = Rule::SecondOperand;
+    } else {
+        rule.result_part = Rule::NotAPart;
+    }
+    rules.push_back(rule);
+
+    // Remake the lists of candidates for the node type of the pattern.
+    RulesForNodeType &r = index[node_type(pattern)];
+    for (int i = 0; i < 2; i++) {
+        vector<int> &types = r.operand_types[i];
+        if (rule.operands[i] >= 0 &&
+            std::find(types.begin(), types.end(), rule.operands[i]) == types.end()) {
+            types.push_back(rule.operands[i]);
+        }
+    }
+    r.candidates.clear();
+    vector<int> types_a = r.operand_types[0], types_b = r.operand_types[1];
+    types_a.push_back(-1);
+    types_b.push_back(-1);
+    for (int ta : types_a) {
+        for (int tb : types_b) {
+            vector<size_t> &candidates = r.candidates[{ta, tb}];
+            for (size_t i = 0; i < rules.size(); i++) {
+                const Rule &c = rules[i];
+                if (node_type(c.pattern) == node_type(pattern) &&
+                    (c.operands[0] < 0 || c.operands[0] == ta) &&
+                    (c.operands[1] < 0 || c.operands[1] == tb)) {
+                    candidates.push_back(i);
+                }
+            }
+        }
+    }
+}
+
+bool RewriteRules::rewrite(const Expr &e, Expr *result, bool *is_part) const {
+    auto iter = index.find(node_type(e));
+    if (iter == index.end()) {
+        return false;
+    }
+    const RulesForNodeType &r = iter->second;
+
+    Expr a, b;
+    operands(e, &a, &b);
+    int ta = node_type(a), tb = node_type(b);
+    if (std::find(r.operand_types[0].begin(), r.operand_types[0].end(), ta) == r.operand_types[0].end()) {
+        ta = -1;
+    }
+    if (std::find(r.operand_types[1].begin(), r.operand_types[1].end(), tb) == r.operand_types[1].end()) {
+        tb = -1;
+    }
+    auto candidates = r.candidates.find({ta, tb});
+    internal_assert(candidates != r.candidates.end());
+
+    for (size_t i : candidates->second) {
+        const Rule &rule = rules[i];
+        map<string, Expr> matches;
+        if (expr_match(rule.pattern, e, matches) &&
+            (!rule.condition || rule.condition(matches))) {
+            if (rule.result_part == Rule::FirstOperand) {
+                *result = a;
+            } else if (rule.result_part == Rule::SecondOperand) {
+                *result = b;
+            } else {
+                *result = substitute(matches, rule.result);
+            }
+            if (is_part) {
+                *is_part = rule.result_part != Rule::NotAPart;
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+void rewrite_rules_test() {
+    Expr a = Variable::make(Int(32), "a"), b = Variable::make(Int(32), "b");
+    Expr fa = Variable::make(Float(32), "fa");
+    Expr va = Variable::make(Int(32, 4), "va"), vb = Variable::make(Int(32, 4), "vb");
+
+    // Wildcards of any width
+    Expr x = Variable::make(Int(32, 0), "x");
+    Expr y = Variable::make(Int(32, 0), "y");
+    Expr z = Variable::make(Int(32, 0), "z");
+    // Constants in patterns need wildcards of the same type.
+    Expr sx = Variable::make(Int(32), "x"), sy = Variable::make(Int(32), "y");
+
+    RewriteRules rules;
+    rules.add(Min::make(Max::make(x, y), x), x);
+    rules.add(Min::make(Max::make(x, y), y), y);
+    rules.add(Min::make(Min::make(x, y), Min::make(x, z)), Min::make(Min::make(y, z), x));
+    rules.add(Min::make(Min::make(x, y), y), Min::make(x, y));
+    rules.add(sx * 2, sx + sx);
+    rules.add(sx * sy, sy * sx, [](const map<string, Expr> &m) { return is_const(m.at("x")); });
+    rules.add(Min::make(x, y), x, [](const map<string, Expr> &m) { return can_prove(m.at("x") <= m.at("y")); });
+
+    Expr result;
+    bool is_part = false;
+    internal_assert(rules.rewrite(Min::make(Max::make(a, b + 1), a), &result, &is_part) &&
+                    equal(result, a) && is_part);
+    internal_assert(rules.rewrite(Min::make(Max::make(a, b + 1), b + 1), &result, &is_part) &&
+                    equal(result, b + 1) && is_part);
+    internal_assert(rules.rewrite(Min::make(Max::make(va, vb), vb), &result) &&
+                    equal(result, vb));
+    internal_assert(rules.rewrite(Min::make(Min::make(a, b), Min::make(a, 3)), &result, &is_part) &&
+                    equal(result, Min::make(Min::make(b, 3), a)) && !is_part);
+    internal_assert(rules.rewrite(Min::make(Min::make(a, b), b), &result, &is_part) &&
+                    equal(result, Min::make(a, b)) && is_part);
+
+    // Later rules apply when the ones before them don't match.
+    internal_assert(rules.rewrite(a * 2, &result) && equal(result, a + a));
+    internal_assert(rules.rewrite(Mul::make(3, b), &result) && equal(result, b * 3));
+    internal_assert(!rules.rewrite(a * b, &result));
+    internal_assert(rules.rewrite(Min::make(a, a + 1), &result) && equal(result, a));
+    internal_assert(!rules.rewrite(Min::make(a, a - 1), &result));
+
+    // Wildcards only match their own type, and the uses of one must
+    // match equal Exprs.
+    internal_assert(!rules.rewrite(fa * 2.0f, &result));
+    internal_assert(!rules.rewrite(Min::make(Max::make(a, b), a + 0), &result));
+    internal_assert(!rules.rewrite(a + b, &result));
+
+    std::cout << "RewriteRules test passed" << std::endl;
+}
+
+}
+}
@@ -0,0 +1,84 @@
+#ifndef HALIDE_REWRITE_RULES_H
+#define HALIDE_REWRITE_RULES_H
+
+/** \file
+ * Defines a class for rewriting Exprs with a list of rules, each a
+ * pattern to match and what to replace it with.
+ */
+
+#include <functional>
+#include <map>
+#include <vector>
+
+#include "IR.h"
+
+namespace Halide {
+namespace Internal {
+
+/** A list of rules for rewriting Exprs, tried in the order they were
+ * added. The Variables in the pattern of a rule are wildcards, as in
+ * the second form of expr_match: each one matches any Expr of its type
+ * (where zero bits or lanes match any), and the uses of a name must
+ * all match equal Exprs. The result of a rule is the Expr that
+ * replaces a match, with the wildcards in it replaced by what they
+ * matched.
+ *
+ * The rules are sorted by the node type of their pattern and of its
+ * first two operands, into a list per shape of Expr of the rules that
+ * could match it. Rewriting an Expr only tries the rules in the list
+ * for its shape, so adding rules for other shapes costs nothing.
+ *
+ * For example:
+ \code
+ Expr x = Variable::make(Int(32), "x"), y = Variable::make(Int(32), "y");
+ RewriteRules rules;
+ rules.add(min(max(x, y), x), x);
+ rules.rewrite(min(max(a, b + 1), a), &result)
+ \endcode
+ * should return true and set result to a.
+ */
+class RewriteRules {
+public:
+    /** A further condition for a rule to apply, given what its
+     * wildcards matched. */
+    typedef std::function<bool(const std::map<std::string, Expr> &)> Condition;
+
+    /** Add a rule to the end of the list. */
+    EXPORT void add(Expr pattern, Expr result, Condition condition = nullptr);
+
+    /** Rewrite an Expr with the first rule that applies to it, and
+     * return whether there was one. If the rule's result is one of
+     * its wildcards or one of the operands of its pattern, so that
+     * the rewritten Expr is a part of the original one, *is_part is
+     * set to true. */
+    EXPORT bool rewrite(const Expr &e, Expr *result, bool *is_part = nullptr) const;
+
+private:
+    struct Rule {
+        Expr pattern, result;
+        Condition condition;
+        // The node types of the first two operands of the pattern, or
+        // -1 where it's a wildcard or there isn't one.
+        int operands[2];
+        // Whether the result is a part of what the pattern matches,
+        // and if it's an operand, which one.
+        enum { NotAPart, Wildcard, FirstOperand, SecondOperand } result_part;
+    };
+    std::vector<Rule> rules;
+
+    struct RulesForNodeType {
+        // The node types of each operand that some rule requires.
+        std::vector<int> operand_types[2];
+        // The rules to try for each pair of operand types, with -1
+        // for a type no rule requires.
+        std::map<std::pair<int, int>, std::vector<size_t>> candidates;
+    };
+    std::map<int, RulesForNodeType> index;
+};
+
+EXPORT void rewrite_rules_test();
+
+}
+}
+
+#endif
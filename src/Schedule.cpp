@@ -78,10 +78,29 @@ struct ScheduleContents {
     std::vector<Prefetch> prefetches;
     std::map<std::string, IntrusivePtr<Internal::FunctionContents>> wrappers;
     bool memoized;
+    int memoize_priority;
+    int64_t memoize_max_bytes;
+    float code_size_budget;
     bool touched;
     bool allow_race_conditions;
-
-    ScheduleContents() : memoized(false), touched(false), allow_race_conditions(false) {};
+    bool atomic;
+    int gpu_devices;
+    Expr host_fraction;
+    FuseLoopLevel fuse_level;
+    Multiversion multiversion;
+    GPULaunchBounds gpu_launch_bounds;
+    Distribution distribution;
+    std::vector<std::string> adaptive_parallel;
+    bool async;
+    bool tuple_interleaved;
+    bool storage_order_fixed;
+    Expr compute_condition;
+    MemoryType memory_type;
+
+    ScheduleContents() : memoized(false), memoize_priority(0), memoize_max_bytes(0), code_size_budget(0),
+                         touched(false), allow_race_conditions(false), atomic(false), gpu_devices(1),
+                         async(false), tuple_interleaved(false), storage_order_fixed(false),
+                         memory_type(MemoryType::Auto) {};
 
     // Pass an IRMutator through to all Exprs referenced in the ScheduleContents
     void mutate(IRMutator *mutator) {
@@ -117,6 +136,16 @@ struct ScheduleContents {
                 p.offset = mutator->mutate(p.offset);
             }
         }
+        if (compute_condition.defined()) {
+            compute_condition = mutator->mutate(compute_condition);
+        }
+        if (host_fraction.defined()) {
+            host_fraction = mutator->mutate(host_fraction);
+        }
+        if (distribution.defined()) {
+            distribution.rank = mutator->mutate(distribution.rank);
+            distribution.num_ranks = mutator->mutate(distribution.num_ranks);
+        }
     }
 };
 
@@ -147,8 +176,24 @@ Schedule Schedule::deep_copy(
     copy.contents->bounds = contents->bounds;
     copy.contents->prefetches = contents->prefetches;
     copy.contents->memoized = contents->memoized;
+    copy.contents->memoize_priority = contents->memoize_priority;
+    copy.contents->memoize_max_bytes = contents->memoize_max_bytes;
+    copy.contents->code_size_budget = contents->code_size_budget;
     copy.contents->touched = contents->touched;
     copy.contents->allow_race_conditions = contents->allow_race_conditions;
+    copy.contents->atomic = contents->atomic;
+    copy.contents->gpu_devices = contents->gpu_devices;
+    copy.contents->host_fraction = contents->host_fraction;
+    copy.contents->fuse_level = contents->fuse_level;
+    copy.contents->multiversion = contents->multiversion;
+    copy.contents->gpu_launch_bounds = contents->gpu_launch_bounds;
+    copy.contents->distribution = contents->distribution;
+    copy.contents->adaptive_parallel = contents->adaptive_parallel;
+    copy.contents->async = contents->async;
+    copy.contents->tuple_interleaved = contents->tuple_interleaved;
+    copy.contents->storage_order_fixed = contents->storage_order_fixed;
+    copy.contents->compute_condition = contents->compute_condition;
+    copy.contents->memory_type = contents->memory_type;
 
     // Deep-copy wrapper functions. If function has already been deep-copied before,
     // i.e. it's in the 'copied_map', use the deep-copied version from the map instead
@@ -174,6 +219,70 @@ bool Schedule::memoized() const {
     return contents->memoized;
 }
 
+bool &Schedule::async() {
+    return contents->async;
+}
+
+bool Schedule::async() const {
+    return contents->async;
+}
+
+bool &Schedule::tuple_interleaved() {
+    return contents->tuple_interleaved;
+}
+
+bool Schedule::tuple_interleaved() const {
+    return contents->tuple_interleaved;
+}
+
+bool &Schedule::storage_order_fixed() {
+    return contents->storage_order_fixed;
+}
+
+bool Schedule::storage_order_fixed() const {
+    return contents->storage_order_fixed;
+}
+
+Expr &Schedule::compute_condition() {
+    return contents->compute_condition;
+}
+
+Expr Schedule::compute_condition() const {
+    return contents->compute_condition;
+}
+
+MemoryType &Schedule::memory_type() {
+    return contents->memory_type;
+}
+
+MemoryType Schedule::memory_type() const {
+    return contents->memory_type;
+}
+
+int &Schedule::memoize_priority() {
+    return contents->memoize_priority;
+}
+
+int Schedule::memoize_priority() const {
+    return contents->memoize_priority;
+}
+
+int64_t &Schedule::memoize_max_bytes() {
+    return contents->memoize_max_bytes;
+}
+
+int64_t Schedule::memoize_max_bytes() const {
+    return contents->memoize_max_bytes;
+}
+
+float &Schedule::code_size_budget() {
+    return contents->code_size_budget;
+}
+
+float Schedule::code_size_budget() const {
+    return contents->code_size_budget;
+}
+
 bool &Schedule::touched() {
     return contents->touched;
 }
@@ -275,6 +384,70 @@ bool Schedule::allow_race_conditions() const {
     return contents->allow_race_conditions;
 }
 
+bool &Schedule::atomic() {
+    return contents->atomic;
+}
+
+bool Schedule::atomic() const {
+    return contents->atomic;
+}
+
+int &Schedule::gpu_devices() {
+    return contents->gpu_devices;
+}
+
+int Schedule::gpu_devices() const {
+    return contents->gpu_devices;
+}
+
+Expr &Schedule::host_fraction() {
+    return contents->host_fraction;
+}
+
+Expr Schedule::host_fraction() const {
+    return contents->host_fraction;
+}
+
+Multiversion &Schedule::multiversion() {
+    return contents->multiversion;
+}
+
+const Multiversion &Schedule::multiversion() const {
+    return contents->multiversion;
+}
+
+GPULaunchBounds &Schedule::gpu_launch_bounds() {
+    return contents->gpu_launch_bounds;
+}
+
+const GPULaunchBounds &Schedule::gpu_launch_bounds() const {
+    return contents->gpu_launch_bounds;
+}
+
+Distribution &Schedule::distribution() {
+    return contents->distribution;
+}
+
+const Distribution &Schedule::distribution() const {
+    return contents->distribution;
+}
+
+std::vector<std::string> &Schedule::adaptive_parallel() {
+    return contents->adaptive_parallel;
+}
+
+const std::vector<std::string> &Schedule::adaptive_parallel() const {
+    return contents->adaptive_parallel;
+}
+
+FuseLoopLevel &Schedule::fuse_level() {
+    return contents->fuse_level;
+}
+
+const FuseLoopLevel &Schedule::fuse_level() const {
+    return contents->fuse_level;
+}
+
 void Schedule::accept(IRVisitor *visitor) const {
     for (const ReductionVariable &r : rvars()) {
         if (r.min.defined()) {
@@ -308,6 +481,16 @@ void Schedule::accept(IRVisitor *visitor) const {
             p.offset.accept(visitor);
         }
     }
+    if (compute_condition().defined()) {
+        compute_condition().accept(visitor);
+    }
+    if (host_fraction().defined()) {
+        host_fraction().accept(visitor);
+    }
+    if (distribution().defined()) {
+        distribution().rank.accept(visitor);
+        distribution().num_ranks.accept(visitor);
+    }
 }
 
 void Schedule::mutate(IRMutator *mutator) {
@@ -6,6 +6,7 @@
  */
 
 #include "Expr.h"
+#include "Target.h"
 
 #include <map>
 
@@ -37,7 +38,10 @@ enum class TailStrategy {
      * redundant re-evaluation; does not constrain input our
      * output sizes. Cons: increases code size due to separate
      * tail-case handling; vectorization will scalarize in the tail
-     * case to handle the if statement. */
+     * case to handle the if statement. If the inner loop is
+     * unrolled, the unrolled copies share one check, and the tail
+     * case runs as a serial loop after them, so this is how to
+     * unroll a loop whose extent is only known at runtime. */
     GuardWithIf,
 
     /** Prevent evaluation beyond the original extent by shifting
@@ -64,6 +68,19 @@ enum class TailStrategy {
     Auto
 };
 
+/** The units of the distance ahead of the current loop iteration that
+ * a prefetch fetches. See \ref Func::prefetch */
+enum class PrefetchUnit {
+    /** The distance is a number of iterations of the loop. */
+    Iterations,
+
+    /** The distance is a number of bytes of each buffer read. The
+     * number of iterations ahead is the distance divided by the
+     * number of bytes of the buffer one iteration reads, rounded
+     * down, and at least one. */
+    Bytes
+};
+
 /** A reference to a site in a Halide statement at the top of the
  * body of a particular for loop. Evaluating a region of a halide
  * function is done by generating a loop nest that spans its
@@ -174,7 +191,8 @@ struct Dim {
     bool is_parallel() const {
         return (for_type == ForType::Parallel ||
                 for_type == ForType::GPUBlock ||
-                for_type == ForType::GPUThread);
+                for_type == ForType::GPUThread ||
+                for_type == ForType::GPULane);
     }
 };
 
@@ -195,10 +213,53 @@ struct StorageDim {
 struct Prefetch {
     std::string var;
     Expr offset;
+    PrefetchUnit unit;
 };
 
 struct FunctionContents;
 
+/** The loop nest of another Func's stage that this stage is computed
+ * with. The loops of the two stages are fused from the outermost
+ * down to and including the loop over var. See \ref Stage::compute_with */
+struct FuseLoopLevel {
+    std::string func, var;
+    int stage;
+
+    FuseLoopLevel() : stage(0) {}
+    FuseLoopLevel(const std::string &f, const std::string &v, int s) : func(f), var(v), stage(s) {}
+
+    bool defined() const {return !func.empty();}
+};
+
+/** A loop of a stage that is compiled once for each of several
+ * instruction sets, with the best one the CPU supports picked at
+ * runtime. See \ref Stage::multiversion */
+struct Multiversion {
+    std::string var;
+    std::vector<Target::Feature> features;
+
+    bool defined() const {return !var.empty();}
+};
+
+/** Hints for compiling and launching the GPU kernels of a stage,
+ * where zero means no hint. See \ref Stage::gpu_launch_bounds */
+struct GPULaunchBounds {
+    int max_threads, min_blocks, max_registers;
+
+    GPULaunchBounds() : max_threads(0), min_blocks(0), max_registers(0) {}
+    bool defined() const {return max_threads || min_blocks || max_registers;}
+};
+
+/** How a stage is partitioned across the ranks of a distributed
+ * job: this rank computes the num_ranks'th part of var numbered
+ * rank. See \ref Stage::distribute */
+struct Distribution {
+    std::string var;
+    Expr rank, num_ranks;
+
+    bool defined() const {return !var.empty();}
+};
+
 /** A schedule for a single stage of a Halide pipeline. Right now this
  * interface is basically a struct, offering mutable access to its
  * innards. In the future it may become more encapsulated. */
@@ -227,6 +288,62 @@ public:
     bool memoized() const;
     // @}
 
+    /** This flag is set to true if the Func is computed
+     * asynchronously with its consumer. See Func::async. */
+    // @{
+    bool &async();
+    bool async() const;
+    // @}
+
+    /** This flag is set to true if the elements of a Tuple-valued Func
+     * are stored interleaved in one allocation. See
+     * Func::store_tuple_interleaved. */
+    // @{
+    bool &tuple_interleaved();
+    bool tuple_interleaved() const;
+    // @}
+
+    /** This flag is set to true if the storage order was given by
+     * Func::reorder_storage. Otherwise storage flattening may choose
+     * a storage order for an intermediate Func from how it is
+     * accessed. */
+    // @{
+    bool &storage_order_fixed();
+    bool storage_order_fixed() const;
+    // @}
+
+    /** The data-dependent condition on which the Func is computed at
+     * its compute_level, or an undefined Expr if it always is. See
+     * Func::compute_if. */
+    // @{
+    Expr &compute_condition();
+    Expr compute_condition() const;
+    // @}
+
+    /** The type of memory the Func's storage is allocated in. See
+     * Func::store_in. */
+    // @{
+    MemoryType &memory_type();
+    MemoryType memory_type() const;
+    // @}
+
+    /** The eviction priority and per-Func byte budget passed to
+     * Func::memoize. A budget of zero means no per-Func limit. */
+    // @{
+    int &memoize_priority();
+    int memoize_priority() const;
+    int64_t &memoize_max_bytes();
+    int64_t memoize_max_bytes() const;
+    // @}
+
+    /** How much unrolling and loop partitioning may grow the code of
+     * the Func, as a multiple of its size without them. Zero means no
+     * budget. See Func::code_size_budget. */
+    // @{
+    float &code_size_budget();
+    float code_size_budget() const;
+    // @}
+
     /** This flag is set to true if the dims list has been manipulated
      * by the user (or if a ScheduleHandle was created that could have
      * been used to manipulate it). It controls the warning that
@@ -315,6 +432,62 @@ public:
     bool &allow_race_conditions();
     // @}
 
+    /** Is each update done atomically? See \ref Stage::atomic */
+    // @{
+    bool atomic() const;
+    bool &atomic();
+    // @}
+
+    /** Across how many GPU devices should the outermost gpu_blocks
+     * loop of this stage be split? See \ref Func::gpu_devices */
+    // @{
+    int gpu_devices() const;
+    int &gpu_devices();
+    // @}
+
+    /** The fraction of the outermost gpu_blocks loop of this stage to
+     * run on the host instead, or an undefined Expr if it all runs on
+     * the GPU. See \ref Func::gpu_host_split */
+    // @{
+    Expr host_fraction() const;
+    Expr &host_fraction();
+    // @}
+
+    /** Which stage of which other Func, if any, is this stage
+     * computed with? See \ref Stage::compute_with */
+    // @{
+    const FuseLoopLevel &fuse_level() const;
+    FuseLoopLevel &fuse_level();
+    // @}
+
+    /** Which loop of this stage, if any, is compiled for several
+     * instruction sets? See \ref Stage::multiversion */
+    // @{
+    const Multiversion &multiversion() const;
+    Multiversion &multiversion();
+    // @}
+
+    /** How should the GPU kernels of this stage be compiled and
+     * launched? See \ref Stage::gpu_launch_bounds */
+    // @{
+    const GPULaunchBounds &gpu_launch_bounds() const;
+    GPULaunchBounds &gpu_launch_bounds();
+    // @}
+
+    /** Is this stage partitioned across the ranks of a distributed
+     * job? See \ref Stage::distribute */
+    // @{
+    const Distribution &distribution() const;
+    Distribution &distribution();
+    // @}
+
+    /** The dimensions of this stage whose parallel loops are chunked
+     * by the runtime as they run. See \ref Stage::parallel_adaptive */
+    // @{
+    const std::vector<std::string> &adaptive_parallel() const;
+    std::vector<std::string> &adaptive_parallel();
+    // @}
+
     /** Pass an IRVisitor through to all Exprs referenced in the
      * Schedule. */
     void accept(IRVisitor *) const;
@@ -1,4 +1,5 @@
 #include "ScheduleFunctions.h"
+#include "Bounds.h"
 #include "IROperator.h"
 #include "Simplify.h"
 #include "Substitute.h"
@@ -12,6 +13,9 @@
 #include "IRPrinter.h"
 #include "Func.h"
 #include "ApplySplit.h"
+#include "DeviceInterface.h"
+#include "InjectHostDevBufferCopies.h"
+#include "Tracing.h"
 
 namespace Halide {
 namespace Internal {
@@ -58,6 +62,64 @@ bool contains_impure_call(const Expr &expr) {
     return is_not_pure.result;
 }
 
+// Split a GPU block loop into n contiguous slices, one per device,
+// each launched as its own kernel. The runtime is told which device
+// each slice belongs to before its launch, and all the slices are
+// joined before anything after the loop runs.
+Stmt split_gpu_loop_across_devices(const For *op, int n) {
+    string device_name = op->name + ".__gpu_device";
+    Expr device = Variable::make(Int(32), device_name);
+    Expr chunk = Variable::make(Int(32), op->name + ".device_chunk");
+    Expr device_min = Variable::make(Int(32), op->name + ".device_min");
+    Expr device_extent = Variable::make(Int(32), op->name + ".device_extent");
+
+    Stmt slice = For::make(op->name, device_min, device_extent, op->for_type, op->device_api, op->body);
+    slice = IfThenElse::make(device_extent > 0, slice);
+    slice = Block::make(call_extern_and_assert("halide_cuda_set_launch_device", {device}), slice);
+    slice = LetStmt::make(device_extent.as<Variable>()->name,
+                          min(chunk, op->extent - device * chunk), slice);
+    slice = LetStmt::make(device_min.as<Variable>()->name, op->min + device * chunk, slice);
+
+    Stmt stmt = For::make(device_name, 0, n, ForType::Serial, DeviceAPI::None, slice);
+    stmt = LetStmt::make(chunk.as<Variable>()->name, (op->extent + (n - 1)) / n, stmt);
+    return Block::make(stmt, call_extern_and_assert("halide_cuda_join_devices", {}));
+}
+
+// Turn the GPU loops within a block into serial host loops.
+class RunGPULoopsOnHost : public IRMutator {
+    using IRMutator::visit;
+
+    void visit(const For *op) {
+        IRMutator::visit(op);
+        if (op->for_type == ForType::GPUBlock ||
+            op->for_type == ForType::GPUThread ||
+            op->for_type == ForType::GPULane) {
+            op = stmt.as<For>();
+            stmt = For::make(op->name, op->min, op->extent, ForType::Serial, DeviceAPI::None, op->body);
+        }
+    }
+};
+
+// Split a GPU block loop in two. The first part of the blocks is
+// launched as a kernel, and the rest run as a parallel loop on the
+// host while it runs. The host loop is marked DeviceAPI::Host, so that
+// InjectHostDevBufferCopies knows to merge what it writes into the
+// device allocations instead of copying the GPU's results to the host
+// first.
+Stmt split_gpu_loop_with_host(const For *op, Expr host_fraction) {
+    string host_extent_name = op->name + ".host_extent";
+    Expr host_extent = Variable::make(Int(32), host_extent_name);
+    Expr device_extent = op->extent - host_extent;
+
+    Stmt device = For::make(op->name, op->min, device_extent, op->for_type, op->device_api, op->body);
+    device = IfThenElse::make(device_extent > 0, device);
+    Stmt host = RunGPULoopsOnHost().mutate(op->body);
+    host = For::make(op->name, op->min + device_extent, host_extent, ForType::Parallel, DeviceAPI::Host, host);
+
+    Expr e = cast<int>(cast<float>(op->extent) * cast<float>(host_fraction) + 0.5f);
+    return LetStmt::make(host_extent_name, clamp(e, 0, op->extent), Block::make(device, host));
+}
+
 // Build a loop nest about a provide node using a schedule
 Stmt build_provide_loop_nest_helper(string func_name,
                                     string prefix,
@@ -66,7 +128,8 @@ Stmt build_provide_loop_nest_helper(string func_name,
                                     const vector<Expr> &values,
                                     const vector<Expr> &predicates,
                                     const Schedule &s,
-                                    bool is_update) {
+                                    bool is_update,
+                                    const Target &target) {
 
 
     // We'll build it from inside out, starting from a store node,
@@ -74,6 +137,9 @@ Stmt build_provide_loop_nest_helper(string func_name,
 
     // Make the (multi-dimensional multi-valued) store node.
     Stmt stmt = Provide::make(func_name, values, site);
+    if (s.atomic()) {
+        stmt = Atomic::make(func_name, stmt);
+    }
 
     // A map of the dimensions for which we know the extent is a
     // multiple of some Expr. This can happen due to a bound, or
@@ -178,6 +244,56 @@ Stmt build_provide_loop_nest_helper(string func_name,
         }
     }
 
+    // Find the outermost GPU block loop, if it's to be split across
+    // several devices, or between the GPU and the host.
+    int split_across_devices = -1, split_with_host = -1;
+    if (s.gpu_devices() > 1) {
+        for (int i = 0; i < (int)nest.size(); i++) {
+            if (nest[i].type == Container::For &&
+                s.dims()[nest[i].dim_idx].for_type == ForType::GPUBlock) {
+                split_across_devices = i;
+                break;
+            }
+        }
+        user_assert(split_across_devices >= 0)
+            << "Func " << func_name << " is scheduled with gpu_devices, "
+            << "but has no gpu_blocks loop to split across devices.\n";
+        DeviceAPI api = s.dims()[nest[split_across_devices].dim_idx].device_api;
+        if (api == DeviceAPI::Default_GPU) {
+            api = get_default_device_api_for_target(target);
+        }
+        if (api == DeviceAPI::Host) {
+            // No GPU in the target; the block loop just runs in parallel.
+            split_across_devices = -1;
+        } else {
+            user_assert(api == DeviceAPI::CUDA)
+                << "Func " << func_name << " is scheduled with gpu_devices, "
+                << "which is only supported for CUDA.\n";
+        }
+    }
+    if (s.host_fraction().defined()) {
+        user_assert(s.gpu_devices() == 1)
+            << "Func " << func_name << " is scheduled with both gpu_devices and gpu_host_split.\n";
+        for (int i = 0; i < (int)nest.size(); i++) {
+            if (nest[i].type == Container::For &&
+                s.dims()[nest[i].dim_idx].for_type == ForType::GPUBlock) {
+                split_with_host = i;
+                break;
+            }
+        }
+        user_assert(split_with_host >= 0)
+            << "Func " << func_name << " is scheduled with gpu_host_split, "
+            << "but has no gpu_blocks loop to split.\n";
+        DeviceAPI api = s.dims()[nest[split_with_host].dim_idx].device_api;
+        if (api == DeviceAPI::Default_GPU) {
+            api = get_default_device_api_for_target(target);
+        }
+        if (api == DeviceAPI::Host) {
+            // No GPU in the target; the block loop already runs on the host.
+            split_with_host = -1;
+        }
+    }
+
     // Rewrap the statement in the containing lets and fors.
     for (int i = (int)nest.size() - 1; i >= 0; i--) {
         if (nest[i].type == Container::Let) {
@@ -192,6 +308,11 @@ Stmt build_provide_loop_nest_helper(string func_name,
             Expr min = Variable::make(Int(32), nest[i].name + ".loop_min");
             Expr extent = Variable::make(Int(32), nest[i].name + ".loop_extent");
             stmt = For::make(nest[i].name, min, extent, dim.for_type, dim.device_api, stmt);
+            if (i == split_across_devices) {
+                stmt = split_gpu_loop_across_devices(stmt.as<For>(), s.gpu_devices());
+            } else if (i == split_with_host) {
+                stmt = split_gpu_loop_with_host(stmt.as<For>(), s.host_fraction());
+            }
         }
     }
 
@@ -246,7 +367,8 @@ Stmt build_provide_loop_nest(string func_name,
                              string prefix,
                              const vector<string> &dims,
                              const Definition &def,
-                             bool is_update) {
+                             bool is_update,
+                             const Target &target) {
 
     internal_assert(!is_update == def.is_init());
 
@@ -270,7 +392,7 @@ Stmt build_provide_loop_nest(string func_name,
 
     // Default schedule/values if there is no specialization
     Stmt stmt = build_provide_loop_nest_helper(
-        func_name, prefix, dims, site, values, def.split_predicate(), def.schedule(), is_update);
+        func_name, prefix, dims, site, values, def.split_predicate(), def.schedule(), is_update, target);
 
     // Make any specialized copies
     const vector<Specialization> &specializations = def.specializations();
@@ -279,7 +401,7 @@ Stmt build_provide_loop_nest(string func_name,
         const Definition &s_def = specializations[i-1].definition;
 
         Stmt then_case =
-            build_provide_loop_nest(func_name, prefix, dims, s_def, is_update);
+            build_provide_loop_nest(func_name, prefix, dims, s_def, is_update, target);
 
         stmt = IfThenElse::make(c, then_case, stmt);
     }
@@ -287,6 +409,116 @@ Stmt build_provide_loop_nest(string func_name,
     return stmt;
 }
 
+// Does the schedule of an extern Func make loops over calls to it?
+bool extern_has_loops(const Function &f) {
+    const Schedule &s = f.definition().schedule();
+    if (!s.splits().empty()) {
+        return true;
+    }
+    for (const Dim &d : s.dims()) {
+        if (d.for_type != ForType::Extern && d.var != Var::outermost().name()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Wrap a call to an extern Func in the loops its schedule asks
+// for. Each iteration covers the region spanned by the dimensions that
+// are left as ForType::Extern, clamped to the region required, and
+// defines it as function_name.s0.arg_name.tile_min and .tile_max for
+// the call to use.
+Stmt build_extern_loop_nest(const Function &f, Stmt body) {
+    const string prefix = f.name() + ".s0.";
+    const Schedule &s = f.definition().schedule();
+    const vector<Dim> &dims = s.dims();
+
+    bool in_loops = false;
+    for (const Dim &d : dims) {
+        if (d.for_type == ForType::Extern) {
+            user_assert(!in_loops)
+                << "In schedule for extern Func " << f.name()
+                << ", the dimension " << d.var << " is traversed by the extern function,"
+                << " so it must be inside all of the loops over calls to it.\n";
+        } else {
+            in_loops = true;
+            user_assert((d.for_type == ForType::Serial || d.for_type == ForType::Parallel) &&
+                        (d.device_api == DeviceAPI::None || d.device_api == DeviceAPI::Host))
+                << "In schedule for extern Func " << f.name()
+                << ", the loop over " << d.var << " is " << d.for_type << " on " << d.device_api
+                << ", but loops over calls to an extern function can only be serial or parallel on the host.\n";
+        }
+    }
+
+    // Express the args in terms of the loop variables. Any predicates
+    // are subsumed by clamping each tile to the region required.
+    vector<Expr> site;
+    for (const string &arg : f.args()) {
+        site.push_back(Variable::make(Int(32), prefix + arg));
+    }
+    map<string, Expr> dim_extent_alignment;
+    for (const Split &split : s.splits()) {
+        for (const auto &res : apply_split(split, false, prefix, dim_extent_alignment)) {
+            if (!res.is_predicate()) {
+                for (Expr &e : site) {
+                    e = substitute(res.name, res.value, e);
+                }
+            }
+        }
+    }
+
+    Scope<Interval> extern_dims;
+    for (const Dim &d : dims) {
+        if (d.for_type == ForType::Extern) {
+            string var = prefix + d.var;
+            extern_dims.push(var, Interval(Variable::make(Int(32), var + ".loop_min"),
+                                           Variable::make(Int(32), var + ".loop_max")));
+        }
+    }
+    for (size_t i = 0; i < site.size(); i++) {
+        string var = prefix + f.args()[i];
+        Expr min = Variable::make(Int(32), var + ".min");
+        Expr max = Variable::make(Int(32), var + ".max");
+        Interval tile = bounds_of_expr_in_scope(site[i], extern_dims);
+        Expr tile_min = tile.has_lower_bound() ? Max::make(tile.min, min) : min;
+        Expr tile_max = tile.has_upper_bound() ? Min::make(tile.max, max) : max;
+        body = LetStmt::make(var + ".tile_max", tile_max, body);
+        body = LetStmt::make(var + ".tile_min", tile_min, body);
+    }
+
+    for (const Dim &d : dims) {
+        if (d.for_type != ForType::Extern) {
+            string var = prefix + d.var;
+            Expr min = Variable::make(Int(32), var + ".loop_min");
+            Expr extent = Variable::make(Int(32), var + ".loop_extent");
+            body = For::make(var, min, extent, d.for_type, d.device_api, body);
+        }
+    }
+
+    // Define the bounds of the loops as for any other Func.
+    for (size_t i = s.splits().size(); i > 0; i--) {
+        for (const auto &let : compute_loop_bounds_after_split(s.splits()[i-1], prefix)) {
+            body = LetStmt::make(let.first, let.second, body);
+        }
+    }
+    {
+        string o = prefix + Var::outermost().name();
+        body = LetStmt::make(o + ".loop_min", 0, body);
+        body = LetStmt::make(o + ".loop_max", 0, body);
+        body = LetStmt::make(o + ".loop_extent", 1, body);
+    }
+    for (const string &arg : f.args()) {
+        string var = prefix + arg;
+        Expr max = Variable::make(Int(32), var + ".max");
+        Expr min = Variable::make(Int(32), var + ".min");
+        body = LetStmt::make(var + ".loop_extent", (max + 1) - min, body);
+        body = LetStmt::make(var + ".loop_min", min, body);
+        body = LetStmt::make(var + ".loop_max", max, body);
+    }
+
+    return body;
+}
+
 // Turn a function into a loop nest that computes it. It will
 // refer to external vars of the form function_name.arg_name.min
 // and function_name.arg_name.extent to define the bounds over
@@ -352,11 +584,13 @@ Stmt build_produce(Function f, const Target &target) {
         }
 
         // Grab the buffer_ts representing the output. If the store
-        // level matches the compute level, then we can use the ones
+        // level matches the compute level, and there are no loops over
+        // calls to the extern function, then we can use the ones
         // already injected by allocation bounds inference. If it's
         // the output to the pipeline then it will similarly be in the
         // symbol table.
-        if (f.schedule().store_level() == f.schedule().compute_level()) {
+        bool has_loops = extern_has_loops(f);
+        if (!has_loops && f.schedule().store_level() == f.schedule().compute_level()) {
             for (int j = 0; j < f.outputs(); j++) {
                 string buf_name = f.name();
                 if (f.outputs() > 1) {
@@ -370,8 +604,11 @@ Stmt build_produce(Function f, const Target &target) {
                 buffers_to_annotate.push_back(buffer);
             }
         } else {
-            // Store level doesn't match compute level. Make an output
-            // buffer just for this subregion.
+            // Store level doesn't match compute level, or each call
+            // produces one tile. Make an output buffer just for this
+            // subregion.
+            string min_suffix = has_loops ? ".tile_min" : ".min";
+            string max_suffix = has_loops ? ".tile_max" : ".max";
             string stride_name = f.name();
             if (f.outputs() > 1) {
                 stride_name += ".0";
@@ -383,7 +620,7 @@ Stmt build_produce(Function f, const Target &target) {
                 vector<Expr> top_left;
                 for (int k = 0; k < f.dimensions(); k++) {
                     string var = stage_name + f_args[k];
-                    top_left.push_back(Variable::make(Int(32), var + ".min"));
+                    top_left.push_back(Variable::make(Int(32), var + min_suffix));
                 }
                 Expr host_ptr = Call::make(f, top_left, j);
                 host_ptr = Call::make(Handle(), Call::address_of, {host_ptr}, Call::Intrinsic);
@@ -395,8 +632,8 @@ Stmt build_produce(Function f, const Target &target) {
                 int k = 0;
                 for (const string arg : f.args()) {
                     string var = stage_name + arg;
-                    Expr min = Variable::make(Int(32), var + ".min");
-                    Expr max = Variable::make(Int(32), var + ".max");
+                    Expr min = Variable::make(Int(32), var + min_suffix);
+                    Expr max = Variable::make(Int(32), var + max_suffix);
                     Expr stride = Variable::make(Int(32), stride_name + ".stride." + std::to_string(k++));
                     builder.mins.push_back(min);
                     builder.extents.push_back(max - min + 1);
@@ -458,17 +695,21 @@ Stmt build_produce(Function f, const Target &target) {
         if (annotate.defined()) {
             check = Block::make(annotate, check);
         }
+
+        if (has_loops) {
+            check = build_extern_loop_nest(f, check);
+        }
         return check;
     } else {
 
         string prefix = f.name() + ".s0.";
         vector<string> dims = f.args();
-        return build_provide_loop_nest(f.name(), prefix, dims, f.definition(), false);
+        return build_provide_loop_nest(f.name(), prefix, dims, f.definition(), false, target);
     }
 }
 
 // Build the loop nests that update a function (assuming it's a reduction).
-vector<Stmt> build_update(Function f) {
+vector<Stmt> build_update(Function f, const Target &target) {
 
     vector<Stmt> updates;
 
@@ -478,7 +719,7 @@ vector<Stmt> build_update(Function f) {
         string prefix = f.name() + ".s" + std::to_string(i+1) + ".";
 
         vector<string> dims = f.args();
-        Stmt loop = build_provide_loop_nest(f.name(), prefix, dims, def, true);
+        Stmt loop = build_provide_loop_nest(f.name(), prefix, dims, def, true, target);
         updates.push_back(loop);
     }
 
@@ -487,7 +728,7 @@ vector<Stmt> build_update(Function f) {
 
 pair<Stmt, Stmt> build_production(Function func, const Target &target) {
     Stmt produce = build_produce(func, target);
-    vector<Stmt> updates = build_update(func);
+    vector<Stmt> updates = build_update(func, target);
 
     // Combine the update steps
     Stmt merged_updates = Block::make(updates);
@@ -563,6 +804,34 @@ bool function_is_used_in_stmt(Function f, Stmt s) {
 
 // Inject the allocation and realization of a function into an
 // existing loop nest using its schedule
+// Replace the Vars in a Func's compute_if condition with the innermost
+// loops they name that contain its compute_at site.
+class QualifyComputeCondition : public IRMutator {
+    using IRMutator::visit;
+
+    const string &func;
+    const vector<string> &loops;
+
+    void visit(const Variable *op) {
+        if (op->param.defined() || op->image.defined() || op->reduction_domain.defined()) {
+            expr = op;
+            return;
+        }
+        for (size_t i = loops.size(); i > 0; i--) {
+            if (loops[i-1] == op->name || ends_with(loops[i-1], "." + op->name)) {
+                expr = Variable::make(op->type, loops[i-1]);
+                return;
+            }
+        }
+        user_error << "The condition passed to compute_if for Func " << func
+                   << " refers to " << op->name
+                   << ", which isn't a loop containing the site it's computed at.\n";
+    }
+
+public:
+    QualifyComputeCondition(const string &f, const vector<string> &l) : func(f), loops(l) {}
+};
+
 class InjectRealization : public IRMutator {
 public:
     const Function &func;
@@ -578,6 +847,9 @@ private:
 
     string producing;
 
+    // The loops containing the current node. Outermost first.
+    vector<string> loops;
+
     Stmt build_pipeline(Stmt consumer) {
         pair<Stmt, Stmt> realization = build_production(func, target);
 
@@ -590,6 +862,11 @@ private:
             internal_assert(realization.second.defined());
             producer = realization.second;
         }
+        Expr condition = func.schedule().compute_condition();
+        if (condition.defined()) {
+            condition = QualifyComputeCondition(func.name(), loops).mutate(condition);
+            producer = IfThenElse::make(condition, producer);
+        }
         producer = ProducerConsumer::make_produce(func.name(), producer);
 
         // Outputs don't have consume nodes
@@ -676,6 +953,7 @@ private:
             return;
         }
 
+        loops.push_back(for_loop->name);
         body = mutate(body);
 
         if (compute_level.match(for_loop->name)) {
@@ -697,6 +975,7 @@ private:
 
             found_store_level = true;
         }
+        loops.pop_back();
 
         // Reinstate the let statements
         for (size_t i = lets.size(); i > 0; i--) {
@@ -927,8 +1206,184 @@ public:
     PrintUsesOfFunc(string f, std::ostream &s) : func(f), stream(s) {}
 };
 
+namespace {
+
+string stage_name(Function f, int stage) {
+    return stage == 0 ? f.name() : f.name() + ".update(" + std::to_string(stage - 1) + ")";
+}
+
+const Definition &stage_definition(Function f, int stage) {
+    return stage == 0 ? f.definition() : f.update(stage - 1);
+}
+
+// A stage of a Func computed with a stage of another Func, and the
+// pairs of loops (parent, child) that are fused, outermost first.
+struct FusedStage {
+    int child_stage, parent_stage;
+    vector<pair<string, string>> loops;
+};
+
+// Check that a Func scheduled with compute_with can be fused with the
+// Func it is computed with, and work out which loops are fused. Returns
+// nothing if the Func isn't computed with another Func.
+vector<FusedStage> fused_stages(Function child, const map<string, Function> &env) {
+    vector<FusedStage> result;
+    const FuseLoopLevel &fuse = child.schedule().fuse_level();
+    const int num_stages = 1 + (int)child.updates().size();
+    if (!fuse.defined()) {
+        for (int i = 1; i < num_stages; i++) {
+            user_assert(!stage_definition(child, i).schedule().fuse_level().defined())
+                << "Stage " << stage_name(child, i) << " is scheduled with compute_with, "
+                << "so " << child.name() << " must be too.\n";
+        }
+        return result;
+    }
+
+    auto it = env.find(fuse.func);
+    internal_assert(it != env.end());
+    Function parent = it->second;
+
+    user_assert(!child.has_extern_definition() && !parent.has_extern_definition())
+        << "Func " << child.name() << " can't be computed with " << parent.name()
+        << ", because extern Funcs have no loops to fuse.\n";
+    user_assert(!child.schedule().memoized() && !parent.schedule().memoized())
+        << "Func " << child.name() << " can't be computed with " << parent.name()
+        << ", because memoized Funcs can't be fused.\n";
+    user_assert(!parent.schedule().fuse_level().defined())
+        << "Func " << child.name() << " can't be computed with " << parent.name()
+        << ", because " << parent.name() << " is itself computed with "
+        << parent.schedule().fuse_level().func << ". Compute it with "
+        << parent.schedule().fuse_level().func << " instead.\n";
+
+    const LoopLevel &compute_at = parent.schedule().compute_level();
+    user_assert(!compute_at.is_inline() &&
+                child.schedule().compute_level() == compute_at &&
+                child.schedule().store_level() == compute_at &&
+                parent.schedule().store_level() == compute_at)
+        << "Func " << child.name() << " is computed with " << parent.name()
+        << ", so both must be computed and stored at the same loop level.\n";
+
+    int last_parent_stage = 0;
+    bool done = false;
+    for (int i = 0; i < num_stages; i++) {
+        const Definition &def = stage_definition(child, i);
+        const FuseLoopLevel &f = def.schedule().fuse_level();
+        if (!f.defined()) {
+            done = true;
+            continue;
+        }
+        user_assert(!done)
+            << "Stage " << stage_name(child, i) << " is computed with " << f.func
+            << ", so every earlier stage of " << child.name() << " must be too.\n";
+        user_assert(f.func == parent.name())
+            << "The stages of " << child.name() << " must all be computed with the same Func, but "
+            << stage_name(child, i) << " is computed with " << f.func << " instead of "
+            << parent.name() << ".\n";
+        user_assert(f.stage <= (int)parent.updates().size())
+            << "Stage " << stage_name(child, i) << " is computed with a stage of "
+            << parent.name() << " that doesn't exist.\n";
+        user_assert(f.stage >= last_parent_stage)
+            << "Stage " << stage_name(child, i) << " is computed with " << stage_name(parent, f.stage)
+            << ", which comes before the stage that " << stage_name(child, i - 1) << " is computed with.\n";
+        last_parent_stage = f.stage;
+
+        const Definition &parent_def = stage_definition(parent, f.stage);
+        user_assert(def.specializations().empty() && parent_def.specializations().empty())
+            << "Stage " << stage_name(child, i) << " can't be computed with "
+            << stage_name(parent, f.stage) << ", because stages with specializations can't be fused.\n";
+
+        const vector<Dim> &parent_dims = parent_def.schedule().dims();
+        const vector<Dim> &child_dims = def.schedule().dims();
+        internal_assert(!parent_dims.empty() && parent_dims.back().var == Var::outermost().name());
+        internal_assert(!child_dims.empty() && child_dims.back().var == Var::outermost().name());
+        int idx = -1;
+        for (size_t d = 0; d < parent_dims.size(); d++) {
+            if (parent_dims[d].var == f.var || ends_with(parent_dims[d].var, "." + f.var)) {
+                idx = (int)d;
+                break;
+            }
+        }
+        user_assert(idx >= 0)
+            << "Stage " << stage_name(child, i) << " is computed with " << stage_name(parent, f.stage)
+            << " at " << f.var << ", which isn't one of its loops.\n";
+        size_t fused = parent_dims.size() - idx;
+        user_assert(child_dims.size() >= fused)
+            << "Stage " << stage_name(child, i) << " is computed with " << stage_name(parent, f.stage)
+            << " at " << f.var << ", but has fewer loops to fuse than there are outside "
+            << f.var << ".\n";
+
+        FusedStage stage;
+        stage.child_stage = i;
+        stage.parent_stage = f.stage;
+        string parent_prefix = parent.name() + ".s" + std::to_string(f.stage) + ".";
+        string child_prefix = child.name() + ".s" + std::to_string(i) + ".";
+        // Skip the outermost loops, which are removed.
+        for (size_t k = 1; k < fused; k++) {
+            const Dim &pd = parent_dims[parent_dims.size() - 1 - k];
+            const Dim &cd = child_dims[child_dims.size() - 1 - k];
+            user_assert(pd.for_type == cd.for_type && pd.device_api == cd.device_api &&
+                        (pd.for_type == ForType::Serial || pd.for_type == ForType::Parallel))
+                << "Stage " << stage_name(child, i) << " can't be computed with "
+                << stage_name(parent, f.stage) << " at " << f.var << ", because the loops over "
+                << cd.var << " and " << pd.var << " differ. Fused loops must both be serial, "
+                << "or both be parallel.\n";
+            stage.loops.push_back({parent_prefix + pd.var, child_prefix + cd.var});
+        }
+        result.push_back(stage);
+    }
+    return result;
+}
+
+}  // namespace
+
+// The names of the Funcs an Expr calls.
+class FuncsCalled : public IRVisitor {
+    using IRVisitor::visit;
+
+    void visit(const Call *op) {
+        IRVisitor::visit(op);
+        if (op->call_type == Call::Halide) {
+            names.insert(op->name);
+        }
+    }
+
+public:
+    set<string> names;
+};
+
+set<string> funcs_called(Expr e) {
+    FuncsCalled calls;
+    e.accept(&calls);
+    return calls.names;
+}
+
+// Do the values or args of any of g's definitions call f?
+bool function_is_used_in_definitions(const Function &f, const Function &g) {
+    vector<Expr> exprs;
+    vector<Definition> definitions = {g.definition()};
+    definitions.insert(definitions.end(), g.updates().begin(), g.updates().end());
+    for (const Definition &def : definitions) {
+        exprs.insert(exprs.end(), def.values().begin(), def.values().end());
+        exprs.insert(exprs.end(), def.args().begin(), def.args().end());
+    }
+    for (const ExternFuncArgument &arg : g.extern_arguments()) {
+        if (arg.is_func() && Function(arg.func).same_as(f)) {
+            return true;
+        }
+    }
+    for (const Expr &e : exprs) {
+        if (funcs_called(e).count(f.name())) {
+            return true;
+        }
+    }
+    return false;
+}
+
 void validate_schedule(Function f, Stmt s, const Target &target, bool is_output, const map<string, Function> &env) {
 
+    // Check any fusion of its loops with another Func's.
+    fused_stages(f, env);
+
     // If f is extern, check that none of its inputs are scheduled inline.
     if (f.has_extern_definition()) {
         for (const ExternFuncArgument &arg : f.extern_arguments()) {
@@ -992,6 +1447,46 @@ void validate_schedule(Function f, Stmt s, const Target &target, bool is_output,
     LoopLevel store_at = f.schedule().store_level();
     LoopLevel compute_at = f.schedule().compute_level();
 
+    // The loops over calls to an extern Func have nothing in them but
+    // the call.
+    for (const LoopLevel &l : {store_at, compute_at}) {
+        if (!l.is_inline() && !l.is_root()) {
+            auto it = env.find(l.func());
+            if (it != env.end() && it->second.has_extern_definition()) {
+                user_error << "Func " << f.name() << " cannot be scheduled at "
+                           << l.to_string() << ", because " << l.func()
+                           << " is an extern Func, and only calls to the extern"
+                           << " function can be inside its loops.\n";
+            }
+        }
+    }
+
+    // The condition of a compute_if must be computable at the
+    // compute_at site, from Funcs complete by then.
+    Expr compute_condition = f.schedule().compute_condition();
+    if (compute_condition.defined()) {
+        user_assert(!compute_at.is_inline())
+            << "Func " << f.name() << " is computed inline, so it can't be computed"
+            << " on the condition passed to compute_if.\n";
+        user_assert(store_at == compute_at)
+            << "Func " << f.name() << " is computed on the condition passed to compute_if,"
+            << " so it must be stored at the same loop level it is computed at.\n";
+        for (const string &g : funcs_called(compute_condition)) {
+            const Function &callee = env.find(g)->second;
+            user_assert(callee.schedule().compute_level().is_root())
+                << "The condition passed to compute_if for Func " << f.name()
+                << " calls " << g << ", so " << g << " must be computed at root.\n";
+            bool used = false;
+            for (const auto &i : env) {
+                used = used || (i.first != f.name() && function_is_used_in_definitions(callee, i.second));
+            }
+            user_assert(used)
+                << "The condition passed to compute_if for Func " << f.name()
+                << " calls " << g << ", so " << g << " must also be used by the pipeline,"
+                << " to tell bounds inference what region of it to compute.\n";
+        }
+    }
+
     // Outputs must be compute_root and store_root. They're really
     // store_in_user_code, but store_root is close enough.
     if (is_output) {
@@ -1131,5 +1626,228 @@ Stmt schedule_functions(const vector<Function> &outputs,
 
 }
 
+namespace {
+
+void flatten_blocks(Stmt s, vector<Stmt> &result) {
+    if (const Block *b = s.as<Block>()) {
+        flatten_blocks(b->first, result);
+        flatten_blocks(b->rest, result);
+    } else {
+        result.push_back(s);
+    }
+}
+
+// Which stage of func a loop nest built by build_provide_loop_nest
+// computes, or -1 if it isn't one.
+int stage_of_loop_nest(Stmt s, const string &func) {
+    while (const LetStmt *l = s.as<LetStmt>()) {
+        s = l->body;
+    }
+    const For *loop = s.as<For>();
+    string prefix = func + ".s";
+    if (!loop || !starts_with(loop->name, prefix)) {
+        return -1;
+    }
+    size_t dot = loop->name.find('.', prefix.size());
+    if (dot == string::npos) {
+        return -1;
+    }
+    return atoi(loop->name.substr(prefix.size(), dot - prefix.size()).c_str());
+}
+
+// Wrap a Stmt in an if statement for each condition. Separate
+// comparisons are easier for bounds inference to understand than
+// their conjunction.
+Stmt guard_with(Stmt s, const vector<Expr> &conditions) {
+    for (size_t i = conditions.size(); i > 0; i--) {
+        s = IfThenElse::make(conditions[i - 1], s);
+    }
+    return s;
+}
+
+// Fuse the loop nest b into the loop nest a, from loop i of the
+// given pairs inwards. Each fused loop covers both ranges, and the
+// bodies are guarded by the conditions on the outer loops under
+// which each originally ran.
+Stmt fuse_loop_nests(Stmt a, Stmt b, const vector<pair<string, string>> &loops, size_t i,
+                     vector<Expr> cond_a, vector<Expr> cond_b, const string &child) {
+    vector<pair<string, Expr>> lets;
+    while (const LetStmt *l = a.as<LetStmt>()) {
+        lets.push_back({l->name, l->value});
+        a = l->body;
+    }
+    while (const LetStmt *l = b.as<LetStmt>()) {
+        lets.push_back({l->name, l->value});
+        b = l->body;
+    }
+    const For *fa = a.as<For>(), *fb = b.as<For>();
+    user_assert(fa && fb && fa->name == loops[i].first && fb->name == loops[i].second)
+        << "Can't fuse the loops of " << child << " down to " << loops.back().second
+        << ", because other Funcs are computed between the loops being fused. "
+        << "Fuse at an outer loop level instead.\n";
+
+    Expr v = Variable::make(Int(32), fa->name);
+    Stmt body_b = substitute(fb->name, v, fb->body);
+    cond_a.push_back(v >= fa->min);
+    cond_a.push_back(v < fa->min + fa->extent);
+    cond_b.push_back(v >= fb->min);
+    cond_b.push_back(v < fb->min + fb->extent);
+
+    Stmt body;
+    if (i + 1 == loops.size()) {
+        body = Block::make(guard_with(fa->body, cond_a), guard_with(body_b, cond_b));
+    } else {
+        body = fuse_loop_nests(fa->body, body_b, loops, i + 1, cond_a, cond_b, child);
+    }
+
+    Expr min = Min::make(fa->min, fb->min);
+    Expr extent = Max::make(fa->min + fa->extent, fb->min + fb->extent) - min;
+    Stmt result = For::make(fa->name, min, extent, fa->for_type, fa->device_api, body);
+    for (size_t j = lets.size(); j > 0; j--) {
+        result = LetStmt::make(lets[j - 1].first, lets[j - 1].second, result);
+    }
+    return result;
+}
+
+// Move the fused stages of child into the production of parent. The
+// realization of child moves outwards to enclose both.
+class FuseStages : public IRMutator {
+    Function parent, child;
+    const vector<FusedStage> &stages;
+
+    // Set while inside the consumer of parent, at the same loop level.
+    bool in_consumer = false;
+    map<int, Stmt> nests;
+    Stmt child_realize;
+
+    using IRMutator::visit;
+
+    void visit(const For *op) {
+        bool old_in_consumer = in_consumer;
+        in_consumer = false;
+        IRMutator::visit(op);
+        in_consumer = old_in_consumer;
+    }
+
+    void visit(const Realize *op) {
+        if (in_consumer && op->name == child.name()) {
+            child_realize = op;
+            stmt = mutate(op->body);
+        } else {
+            IRMutator::visit(op);
+        }
+    }
+
+    void visit(const ProducerConsumer *op) {
+        if (!(in_consumer && op->is_producer && op->name == child.name())) {
+            IRMutator::visit(op);
+            return;
+        }
+        vector<Stmt> parts, rest;
+        flatten_blocks(op->body, parts);
+        for (Stmt p : parts) {
+            int stage = stage_of_loop_nest(p, child.name());
+            bool is_fused = false;
+            for (const FusedStage &s : stages) {
+                is_fused |= (s.child_stage == stage);
+            }
+            if (is_fused) {
+                nests[stage] = p;
+            } else {
+                rest.push_back(p);
+            }
+        }
+        Stmt body = rest.empty() ? Evaluate::make(0) : Block::make(rest);
+        stmt = ProducerConsumer::make_produce(op->name, body);
+    }
+
+    void visit(const Block *op) {
+        const ProducerConsumer *produce = op->first.as<ProducerConsumer>();
+        if (!produce || !produce->is_producer || produce->name != parent.name()) {
+            IRMutator::visit(op);
+            return;
+        }
+
+        bool old_in_consumer = in_consumer;
+        map<int, Stmt> old_nests;
+        old_nests.swap(nests);
+        Stmt old_realize = child_realize;
+        child_realize = Stmt();
+
+        in_consumer = true;
+        Stmt rest = mutate(op->rest);
+        in_consumer = old_in_consumer;
+
+        Stmt body = produce->body;
+        if (!nests.empty()) {
+            internal_assert(nests.size() == stages.size())
+                << "Found only some of the stages of " << child.name() << " to fuse\n";
+            for (const FusedStage &s : stages) {
+                vector<Stmt> parts;
+                flatten_blocks(body, parts);
+                bool found_stage = false;
+                for (Stmt &p : parts) {
+                    if (stage_of_loop_nest(p, parent.name()) == s.parent_stage) {
+                        p = fuse_loop_nests(p, nests[s.child_stage], s.loops, 0, {}, {},
+                                            stage_name(child, s.child_stage));
+                        found_stage = true;
+                        break;
+                    }
+                }
+                internal_assert(found_stage)
+                    << "Couldn't find the loop nest of " << stage_name(parent, s.parent_stage) << "\n";
+                body = Block::make(parts);
+            }
+            found = true;
+        }
+
+        stmt = Block::make(ProducerConsumer::make_produce(parent.name(), body), rest);
+        if (const Realize *r = child_realize.as<Realize>()) {
+            stmt = Realize::make(r->name, r->types, r->bounds, r->condition, stmt);
+        }
+
+        old_nests.swap(nests);
+        child_realize = old_realize;
+    }
+
+public:
+    bool found = false;
+
+    FuseStages(Function p, Function c, const vector<FusedStage> &s) : parent(p), child(c), stages(s) {}
+};
+
+}  // namespace
+
+Stmt fuse_compute_with(Stmt s, const vector<string> &order,
+                       const map<string, Function> &env) {
+    for (const string &name : order) {
+        Function child = env.find(name)->second;
+        vector<FusedStage> stages = fused_stages(child, env);
+        if (stages.empty()) {
+            continue;
+        }
+        Function parent = env.find(child.schedule().fuse_level().func)->second;
+
+        // Tracing wraps each production in the definition of its
+        // trace id, so the loops can't be moved out of it.
+        bool tracing = tracing_level() > 0;
+        for (Function f : {parent, child}) {
+            tracing |= f.is_tracing_loads() || f.is_tracing_stores() || f.is_tracing_realizations();
+        }
+        if (tracing) {
+            user_warning << "Not fusing the loops of " << child.name() << " with " << parent.name()
+                         << ", because one of them is traced.\n";
+            continue;
+        }
+
+        debug(2) << "Fusing the loops of " << child.name() << " with " << parent.name() << "\n";
+        FuseStages fuser(parent, child, stages);
+        s = fuser.mutate(s);
+        internal_assert(fuser.found)
+            << "Couldn't find " << child.name() << " after the production of " << parent.name() << "\n";
+    }
+    return s;
+}
+
 }
 }
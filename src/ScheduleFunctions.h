@@ -28,6 +28,13 @@ Stmt schedule_functions(const std::vector<Function> &outputs,
                         const Target &target,
                         bool &any_memoized);
 
+/** Fuse the loop nests of the stages scheduled with compute_with into
+ * the loop nests of the stages they are computed with. Runs after
+ * bounds inference, which defines the loop bounds of both. */
+Stmt fuse_compute_with(Stmt s,
+                       const std::vector<std::string> &order,
+                       const std::map<std::string, Function> &env);
+
 
 }
 }
@@ -0,0 +1,593 @@
+#include <cctype>
+#include <cstdlib>
+#include <iomanip>
+#include <sstream>
+
+#include "ScheduleSerialization.h"
+#include "FindCalls.h"
+#include "Func.h"
+#include "IREquality.h"
+#include "IROperator.h"
+#include "IRVisitor.h"
+#include "Schedule.h"
+
+namespace Halide {
+namespace Internal {
+
+using std::map;
+using std::string;
+using std::vector;
+
+namespace {
+
+// The first line of the format. Bump the version when the meaning of
+// any line changes. Enums are written as their integer values.
+const char *const schedule_header = "halide_schedule 1";
+
+map<string, Function> environment(const vector<Function> &outputs) {
+    map<string, Function> env;
+    for (const Function &f : outputs) {
+        map<string, Function> more = find_transitive_calls(f);
+        env.insert(more.begin(), more.end());
+    }
+    return env;
+}
+
+// Find the Variables that refer to the scalar params and buffer
+// shapes of a pipeline, by name, so that Exprs that refer to them can
+// be read back.
+class FindParams : public IRVisitor {
+    using IRVisitor::visit;
+
+    void visit(const Variable *op) {
+        if (op->param.defined()) {
+            params[op->name] = op;
+        }
+    }
+
+    void visit(const Call *op) {
+        IRVisitor::visit(op);
+        // A schedule may refer to the shape of an input buffer the
+        // algorithm only loads from.
+        const Parameter &p = op->param;
+        if (p.defined() && p.is_buffer()) {
+            for (int i = 0; i < p.dimensions(); i++) {
+                for (const char *field : {".min.", ".extent.", ".stride."}) {
+                    string name = p.name() + field + std::to_string(i);
+                    params[name] = Variable::make(Int(32), name, p);
+                }
+            }
+        }
+    }
+
+public:
+    map<string, Expr> params;
+};
+
+// Exprs are written with no spaces, so that each is one token, and
+// with every binary operator parenthesized, so that they can be read
+// back without any precedence rules.
+string expr_to_string(const Expr &e) {
+    if (!e.defined()) {
+        return "_";
+    }
+
+    auto binary = [](const Expr &a, const char *op, const Expr &b) {
+        return "(" + expr_to_string(a) + op + expr_to_string(b) + ")";
+    };
+
+    if (const IntImm *op = e.as<IntImm>()) {
+        if (op->type == Int(32)) {
+            return std::to_string(op->value);
+        }
+    } else if (const UIntImm *op = e.as<UIntImm>()) {
+        if (op->type.is_bool()) {
+            return op->value ? "true" : "false";
+        }
+    } else if (const FloatImm *op = e.as<FloatImm>()) {
+        if (op->type == Float(32)) {
+            std::ostringstream s;
+            s << std::setprecision(9) << op->value << "f";
+            return s.str();
+        }
+    } else if (const Variable *op = e.as<Variable>()) {
+        if (op->param.defined()) {
+            return op->name;
+        }
+    } else if (const Add *op = e.as<Add>()) {
+        return binary(op->a, "+", op->b);
+    } else if (const Sub *op = e.as<Sub>()) {
+        return binary(op->a, "-", op->b);
+    } else if (const Mul *op = e.as<Mul>()) {
+        return binary(op->a, "*", op->b);
+    } else if (const Div *op = e.as<Div>()) {
+        return binary(op->a, "/", op->b);
+    } else if (const Mod *op = e.as<Mod>()) {
+        return binary(op->a, "%", op->b);
+    } else if (const EQ *op = e.as<EQ>()) {
+        return binary(op->a, "==", op->b);
+    } else if (const NE *op = e.as<NE>()) {
+        return binary(op->a, "!=", op->b);
+    } else if (const LT *op = e.as<LT>()) {
+        return binary(op->a, "<", op->b);
+    } else if (const LE *op = e.as<LE>()) {
+        return binary(op->a, "<=", op->b);
+    } else if (const GT *op = e.as<GT>()) {
+        return binary(op->a, ">", op->b);
+    } else if (const GE *op = e.as<GE>()) {
+        return binary(op->a, ">=", op->b);
+    } else if (const And *op = e.as<And>()) {
+        return binary(op->a, "&&", op->b);
+    } else if (const Or *op = e.as<Or>()) {
+        return binary(op->a, "||", op->b);
+    } else if (const Not *op = e.as<Not>()) {
+        return "!" + expr_to_string(op->a);
+    } else if (const Min *op = e.as<Min>()) {
+        return "min(" + expr_to_string(op->a) + "," + expr_to_string(op->b) + ")";
+    } else if (const Max *op = e.as<Max>()) {
+        return "max(" + expr_to_string(op->a) + "," + expr_to_string(op->b) + ")";
+    }
+    user_error << "Can't write out the schedule Expr " << e << ", since only int32 and"
+               << " float constants, params, and arithmetic and logic on them are supported\n";
+    return "";
+}
+
+class ExprParser {
+    const string &text;
+    const map<string, Expr> &params;
+    size_t pos;
+
+    bool consume(const string &s) {
+        if (text.compare(pos, s.size(), s) == 0) {
+            pos += s.size();
+            return true;
+        }
+        return false;
+    }
+
+    void expect(const string &s) {
+        user_assert(consume(s))
+            << "Expected \"" << s << "\" at position " << pos
+            << " of schedule Expr " << text << "\n";
+    }
+
+    Expr binary(Expr a, const string &op, Expr b) {
+        if (op == "+") return a + b;
+        if (op == "-") return a - b;
+        if (op == "*") return a * b;
+        if (op == "/") return a / b;
+        if (op == "%") return a % b;
+        if (op == "==") return a == b;
+        if (op == "!=") return a != b;
+        if (op == "<") return a < b;
+        if (op == "<=") return a <= b;
+        if (op == ">") return a > b;
+        if (op == ">=") return a >= b;
+        if (op == "&&") return a && b;
+        internal_assert(op == "||");
+        return a || b;
+    }
+
+    string parse_operator() {
+        // Two-character operators first, so that e.g. <= isn't read as <.
+        for (const char *op : {"==", "!=", "<=", ">=", "&&", "||", "+", "-", "*", "/", "%", "<", ">"}) {
+            if (consume(op)) {
+                return op;
+            }
+        }
+        user_error << "Expected an operator at position " << pos
+                   << " of schedule Expr " << text << "\n";
+        return "";
+    }
+
+    Expr parse_number() {
+        const char *start = text.c_str() + pos;
+        char *end = nullptr;
+        long long i = strtoll(start, &end, 10);
+        if (*end == '.' || *end == 'e' || *end == 'f') {
+            double d = strtod(start, &end);
+            user_assert(*end == 'f')
+                << "Expected a float ending in f at position " << pos
+                << " of schedule Expr " << text << "\n";
+            pos = end + 1 - text.c_str();
+            return Expr((float)d);
+        }
+        user_assert(end != start)
+            << "Expected a number at position " << pos
+            << " of schedule Expr " << text << "\n";
+        pos = end - text.c_str();
+        return Expr((int)i);
+    }
+
+    Expr parse_name() {
+        size_t start = pos;
+        while (pos < text.size() &&
+               (isalnum((unsigned char)text[pos]) || text[pos] == '_' ||
+                text[pos] == '$' || text[pos] == '.')) {
+            pos++;
+        }
+        string name = text.substr(start, pos - start);
+        if (name == "true") {
+            return const_true();
+        } else if (name == "false") {
+            return const_false();
+        }
+        auto it = params.find(name);
+        user_assert(it != params.end())
+            << "Schedule Expr " << text << " refers to " << name
+            << ", which isn't a param of the pipeline\n";
+        return it->second;
+    }
+
+public:
+    ExprParser(const string &text, const map<string, Expr> &params)
+        : text(text), params(params), pos(0) {}
+
+    Expr parse() {
+        if (consume("(")) {
+            Expr a = parse();
+            string op = parse_operator();
+            Expr b = parse();
+            expect(")");
+            return binary(a, op, b);
+        } else if (consume("!")) {
+            return !parse();
+        } else if (consume("min(") || consume("max(")) {
+            bool is_min = text.compare(pos - 4, 4, "min(") == 0;
+            Expr a = parse();
+            expect(",");
+            Expr b = parse();
+            expect(")");
+            return is_min ? min(a, b) : max(a, b);
+        } else if (pos < text.size() && (isdigit((unsigned char)text[pos]) || text[pos] == '-')) {
+            return parse_number();
+        } else {
+            return parse_name();
+        }
+    }
+
+    bool done() const {
+        return pos == text.size();
+    }
+};
+
+string level_to_string(const LoopLevel &level) {
+    if (level.is_inline()) {
+        return "inline";
+    } else if (level.is_root()) {
+        return "root";
+    }
+    VarOrRVar v = level.var();
+    return level.func() + " " + v.name() + " " + (v.is_rvar ? "1" : "0");
+}
+
+void write_definition(std::ostream &s, const Definition &def, const string &indent) {
+    const Schedule &sched = def.schedule();
+    s << indent << "store_level " << level_to_string(sched.store_level()) << "\n"
+      << indent << "compute_level " << level_to_string(sched.compute_level()) << "\n"
+      << indent << "memoized " << sched.memoized() << "\n"
+      << indent << "memoize_priority " << sched.memoize_priority() << "\n"
+      << indent << "memoize_max_bytes " << sched.memoize_max_bytes() << "\n"
+      << indent << "code_size_budget " << sched.code_size_budget() << "\n"
+      << indent << "allow_race_conditions " << sched.allow_race_conditions() << "\n"
+      << indent << "atomic " << sched.atomic() << "\n"
+      << indent << "async " << sched.async() << "\n"
+      << indent << "tuple_interleaved " << sched.tuple_interleaved() << "\n"
+      << indent << "storage_order_fixed " << sched.storage_order_fixed() << "\n"
+      << indent << "memory_type " << (int)sched.memory_type() << "\n"
+      << indent << "gpu_devices " << sched.gpu_devices() << "\n"
+      << indent << "host_fraction " << expr_to_string(sched.host_fraction()) << "\n"
+      << indent << "compute_condition " << expr_to_string(sched.compute_condition()) << "\n";
+    if (sched.fuse_level().defined()) {
+        const FuseLoopLevel &f = sched.fuse_level();
+        s << indent << "fuse_level " << f.func << " " << f.var << " " << f.stage << "\n";
+    }
+    if (sched.multiversion().defined()) {
+        const Multiversion &m = sched.multiversion();
+        s << indent << "multiversion " << m.var << " " << m.features.size();
+        for (Target::Feature f : m.features) {
+            s << " " << (int)f;
+        }
+        s << "\n";
+    }
+    if (sched.gpu_launch_bounds().defined()) {
+        const GPULaunchBounds &b = sched.gpu_launch_bounds();
+        s << indent << "gpu_launch_bounds " << b.max_threads << " "
+          << b.min_blocks << " " << b.max_registers << "\n";
+    }
+    if (sched.distribution().defined()) {
+        const Distribution &d = sched.distribution();
+        s << indent << "distribution " << d.var << " " << expr_to_string(d.rank)
+          << " " << expr_to_string(d.num_ranks) << "\n";
+    }
+    for (const string &v : sched.adaptive_parallel()) {
+        s << indent << "adaptive_parallel " << v << "\n";
+    }
+    for (const Split &split : sched.splits()) {
+        s << indent << "split " << split.old_var << " " << split.outer << " " << split.inner
+          << " " << expr_to_string(split.factor) << " " << split.exact
+          << " " << (int)split.tail << " " << (int)split.split_type << "\n";
+    }
+    for (const Dim &d : sched.dims()) {
+        s << indent << "dim " << d.var << " " << (int)d.for_type << " "
+          << (int)d.device_api << " " << (int)d.dim_type << "\n";
+    }
+    for (const StorageDim &d : sched.storage_dims()) {
+        s << indent << "storage_dim " << d.var << " " << expr_to_string(d.alignment)
+          << " " << expr_to_string(d.fold_factor) << " " << d.fold_forward << "\n";
+    }
+    for (const Bound &b : sched.bounds()) {
+        s << indent << "bound " << b.var << " " << expr_to_string(b.min)
+          << " " << expr_to_string(b.extent) << " " << expr_to_string(b.modulus)
+          << " " << expr_to_string(b.remainder) << "\n";
+    }
+    for (const Prefetch &p : sched.prefetches()) {
+        s << indent << "prefetch " << p.var << " " << expr_to_string(p.offset)
+          << " " << (int)p.unit << "\n";
+    }
+    for (const Specialization &spec : def.specializations()) {
+        s << indent << "specialization " << expr_to_string(spec.condition) << "\n";
+        write_definition(s, spec.definition, indent + "  ");
+        s << indent << "end\n";
+    }
+}
+
+// Clear the parts of a schedule the format lists element by element,
+// or leaves out when unset, before reading them.
+void reset_schedule(Schedule &sched) {
+    sched.splits().clear();
+    sched.dims().clear();
+    sched.storage_dims().clear();
+    sched.bounds().clear();
+    sched.prefetches().clear();
+    sched.adaptive_parallel().clear();
+    sched.fuse_level() = FuseLoopLevel();
+    sched.multiversion() = Multiversion();
+    sched.gpu_launch_bounds() = GPULaunchBounds();
+    sched.distribution() = Distribution();
+    sched.touched() = true;
+}
+
+}  // namespace
+
+string serialize_schedules(const vector<Function> &outputs) {
+    std::ostringstream s;
+    s << schedule_header << "\n";
+    for (const auto &p : environment(outputs)) {
+        const Function &f = p.second;
+        s << "stage " << f.name() << " 0\n";
+        write_definition(s, f.definition(), "  ");
+        s << "end\n";
+        for (size_t i = 0; i < f.updates().size(); i++) {
+            s << "stage " << f.name() << " " << i + 1 << "\n";
+            write_definition(s, f.updates()[i], "  ");
+            s << "end\n";
+        }
+    }
+    return s.str();
+}
+
+void deserialize_schedules(const string &text, const vector<Function> &outputs) {
+    map<string, Function> env = environment(outputs);
+    FindParams find_params;
+    for (const auto &p : env) {
+        p.second.accept(&find_params);
+    }
+
+    std::istringstream lines(text);
+    string line;
+    int line_number = 0;
+    // The stage, and then the specializations of it, being read.
+    vector<Definition> stack;
+    bool seen_header = false;
+
+    while (std::getline(lines, line)) {
+        line_number++;
+        std::istringstream tokens(line);
+        string key;
+        if (!(tokens >> key) || key[0] == '#') {
+            continue;
+        }
+        if (!seen_header) {
+            user_assert(line == schedule_header)
+                << "Schedule doesn't start with \"" << schedule_header << "\"\n";
+            seen_header = true;
+            continue;
+        }
+
+        auto token = [&]() {
+            string t;
+            user_assert((bool)(tokens >> t))
+                << "Line " << line_number << " of schedule is missing a field: " << line << "\n";
+            return t;
+        };
+        auto integer = [&]() {
+            string t = token();
+            char *end = nullptr;
+            long long i = strtoll(t.c_str(), &end, 10);
+            user_assert(*end == 0)
+                << "Line " << line_number << " of schedule has " << t
+                << " where it should have an integer: " << line << "\n";
+            return (int64_t)i;
+        };
+        auto real = [&]() {
+            string t = token();
+            char *end = nullptr;
+            double d = strtod(t.c_str(), &end);
+            user_assert(*end == 0)
+                << "Line " << line_number << " of schedule has " << t
+                << " where it should have a number: " << line << "\n";
+            return d;
+        };
+        auto expr = [&]() {
+            string t = token();
+            if (t == "_") {
+                return Expr();
+            }
+            ExprParser parser(t, find_params.params);
+            Expr e = parser.parse();
+            user_assert(parser.done())
+                << "Line " << line_number << " of schedule has trailing characters"
+                << " after the Expr " << t << "\n";
+            return e;
+        };
+        auto level = [&]() {
+            string f = token();
+            if (f == "inline") {
+                return LoopLevel();
+            } else if (f == "root") {
+                return LoopLevel::root();
+            }
+            auto it = env.find(f);
+            user_assert(it != env.end())
+                << "Line " << line_number << " of schedule refers to Func " << f
+                << ", which isn't in the pipeline\n";
+            string v = token();
+            bool is_rvar = integer() != 0;
+            return LoopLevel(it->second, VarOrRVar(v, is_rvar));
+        };
+
+        if (key == "stage") {
+            user_assert(stack.empty())
+                << "Line " << line_number << " of schedule starts a stage inside another one\n";
+            string name = token();
+            int64_t idx = integer();
+            auto it = env.find(name);
+            user_assert(it != env.end())
+                << "Schedule has a stage of Func " << name << ", which isn't in the pipeline\n";
+            Function f = it->second;
+            user_assert(idx >= 0 && idx <= (int64_t)f.updates().size())
+                << "Schedule has stage " << idx << " of Func " << name
+                << ", which only has " << f.updates().size() + 1 << " stages\n";
+            stack.push_back(idx == 0 ? f.definition() : f.update((int)idx - 1));
+            reset_schedule(stack.back().schedule());
+            continue;
+        }
+        if (key == "end") {
+            user_assert(!stack.empty())
+                << "Line " << line_number << " of schedule ends a stage that wasn't started\n";
+            stack.pop_back();
+            continue;
+        }
+
+        user_assert(!stack.empty())
+            << "Line " << line_number << " of schedule is outside of any stage: " << line << "\n";
+        Definition &def = stack.back();
+        Schedule &sched = def.schedule();
+        if (key == "specialization") {
+            Expr condition = expr();
+            const Specialization *spec = nullptr;
+            for (const Specialization &s : def.specializations()) {
+                if (equal(s.condition, condition)) {
+                    spec = &s;
+                }
+            }
+            if (!spec) {
+                spec = &def.add_specialization(condition);
+            }
+            Definition spec_def = spec->definition;
+            stack.push_back(spec_def);
+            reset_schedule(stack.back().schedule());
+        } else if (key == "store_level") {
+            sched.store_level() = level();
+        } else if (key == "compute_level") {
+            sched.compute_level() = level();
+        } else if (key == "memoized") {
+            sched.memoized() = integer() != 0;
+        } else if (key == "memoize_priority") {
+            sched.memoize_priority() = (int)integer();
+        } else if (key == "memoize_max_bytes") {
+            sched.memoize_max_bytes() = integer();
+        } else if (key == "code_size_budget") {
+            sched.code_size_budget() = (float)real();
+        } else if (key == "allow_race_conditions") {
+            sched.allow_race_conditions() = integer() != 0;
+        } else if (key == "atomic") {
+            sched.atomic() = integer() != 0;
+        } else if (key == "async") {
+            sched.async() = integer() != 0;
+        } else if (key == "tuple_interleaved") {
+            sched.tuple_interleaved() = integer() != 0;
+        } else if (key == "storage_order_fixed") {
+            sched.storage_order_fixed() = integer() != 0;
+        } else if (key == "memory_type") {
+            sched.memory_type() = (MemoryType)integer();
+        } else if (key == "gpu_devices") {
+            sched.gpu_devices() = (int)integer();
+        } else if (key == "host_fraction") {
+            sched.host_fraction() = expr();
+        } else if (key == "compute_condition") {
+            sched.compute_condition() = expr();
+        } else if (key == "fuse_level") {
+            string f = token(), v = token();
+            sched.fuse_level() = FuseLoopLevel(f, v, (int)integer());
+        } else if (key == "multiversion") {
+            Multiversion m;
+            m.var = token();
+            int64_t n = integer();
+            for (int64_t i = 0; i < n; i++) {
+                m.features.push_back((Target::Feature)integer());
+            }
+            sched.multiversion() = m;
+        } else if (key == "gpu_launch_bounds") {
+            GPULaunchBounds b;
+            b.max_threads = (int)integer();
+            b.min_blocks = (int)integer();
+            b.max_registers = (int)integer();
+            sched.gpu_launch_bounds() = b;
+        } else if (key == "distribution") {
+            Distribution d;
+            d.var = token();
+            d.rank = expr();
+            d.num_ranks = expr();
+            sched.distribution() = d;
+        } else if (key == "adaptive_parallel") {
+            sched.adaptive_parallel().push_back(token());
+        } else if (key == "split") {
+            Split s;
+            s.old_var = token();
+            s.outer = token();
+            s.inner = token();
+            s.factor = expr();
+            s.exact = integer() != 0;
+            s.tail = (TailStrategy)integer();
+            s.split_type = (Split::SplitType)integer();
+            sched.splits().push_back(s);
+        } else if (key == "dim") {
+            Dim d;
+            d.var = token();
+            d.for_type = (ForType)integer();
+            d.device_api = (DeviceAPI)integer();
+            d.dim_type = (Dim::Type)integer();
+            sched.dims().push_back(d);
+        } else if (key == "storage_dim") {
+            StorageDim d;
+            d.var = token();
+            d.alignment = expr();
+            d.fold_factor = expr();
+            d.fold_forward = integer() != 0;
+            sched.storage_dims().push_back(d);
+        } else if (key == "bound") {
+            Bound b;
+            b.var = token();
+            b.min = expr();
+            b.extent = expr();
+            b.modulus = expr();
+            b.remainder = expr();
+            sched.bounds().push_back(b);
+        } else if (key == "prefetch") {
+            Prefetch p;
+            p.var = token();
+            p.offset = expr();
+            p.unit = (PrefetchUnit)integer();
+            sched.prefetches().push_back(p);
+        } else {
+            user_error << "Line " << line_number << " of schedule has unknown field "
+                       << key << ": " << line << "\n";
+        }
+    }
+    user_assert(stack.empty()) << "Schedule ends in the middle of a stage\n";
+}
+
+}
+}
@@ -0,0 +1,35 @@
+#ifndef HALIDE_SCHEDULE_SERIALIZATION_H
+#define HALIDE_SCHEDULE_SERIALIZATION_H
+
+/** \file
+ * Defines a text format for the schedules of the Functions of a
+ * pipeline, so that a schedule can be saved and loaded at runtime
+ * instead of being compiled in. See Pipeline::dump_schedule.
+ */
+
+#include <string>
+#include <vector>
+
+#include "Function.h"
+
+namespace Halide {
+namespace Internal {
+
+/** Write out the schedule of every stage, and every specialization
+ * of a stage, of the Functions the given outputs depend on. The
+ * Exprs in a schedule may only be constants, the scalar params and
+ * buffer shapes of the pipeline, and arithmetic, comparisons and
+ * logic on them. Wrappers made by Func::in aren't written out. */
+std::string serialize_schedules(const std::vector<Function> &outputs);
+
+/** Replace the schedules of the Functions the given outputs depend on
+ * with ones written by serialize_schedules, as a whole or for some
+ * of the Functions. Each stage in the text replaces the schedule of
+ * the stage of the same Function. Specializations are matched by
+ * their condition, and added if the stage doesn't have them yet. */
+void deserialize_schedules(const std::string &text, const std::vector<Function> &outputs);
+
+}
+}
+
+#endif
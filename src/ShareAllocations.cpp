@@ -0,0 +1,387 @@
+#include <iostream>
+#include <set>
+
+#include "ShareAllocations.h"
+#include "ExprUsesVar.h"
+#include "IRMutator.h"
+#include "IROperator.h"
+#include "IRVisitor.h"
+#include "Scope.h"
+#include "Simplify.h"
+
+namespace Halide {
+namespace Internal {
+
+using std::set;
+using std::string;
+using std::vector;
+
+namespace {
+
+/** Find the names of all the Variables in a Stmt. */
+class FindVariables : public IRGraphVisitor {
+    using IRGraphVisitor::visit;
+
+    void visit(const Variable *op) {
+        names.insert(op->name);
+    }
+
+public:
+    set<string> names;
+};
+
+/** Does a Stmt load from or store to a buffer? */
+class UsesBuffer : public IRVisitor {
+    const string &buffer;
+
+    using IRVisitor::visit;
+
+    void visit(const Load *op) {
+        result = result || op->name == buffer;
+        IRVisitor::visit(op);
+    }
+
+    void visit(const Store *op) {
+        result = result || op->name == buffer;
+        IRVisitor::visit(op);
+    }
+
+public:
+    bool result = false;
+    UsesBuffer(const string &b) : buffer(b) {}
+};
+
+bool uses_buffer(Stmt s, const string &buffer) {
+    UsesBuffer uses(buffer);
+    s.accept(&uses);
+    return uses.result;
+}
+
+/** Is an Expr free of loads and side-effects, so that it can be
+ * evaluated earlier? */
+class IsPure : public IRVisitor {
+    using IRVisitor::visit;
+
+    void visit(const Load *op) {
+        result = false;
+    }
+
+    void visit(const Call *op) {
+        if (op->call_type != Call::PureIntrinsic &&
+            op->call_type != Call::PureExtern) {
+            result = false;
+        } else {
+            IRVisitor::visit(op);
+        }
+    }
+
+public:
+    bool result = true;
+};
+
+bool is_pure(Expr e) {
+    IsPure pure;
+    e.accept(&pure);
+    return pure.result;
+}
+
+/** Replace the loads and stores of one buffer with another. */
+class RenameBuffer : public IRMutator {
+    const string &from, &to;
+
+    using IRMutator::visit;
+
+    void visit(const Load *op) {
+        Expr index = mutate(op->index);
+        if (op->name == from) {
+            expr = Load::make(op->type, to, index, op->image, op->param);
+        } else if (index.same_as(op->index)) {
+            expr = op;
+        } else {
+            expr = Load::make(op->type, op->name, index, op->image, op->param);
+        }
+    }
+
+    void visit(const Store *op) {
+        Expr value = mutate(op->value);
+        Expr index = mutate(op->index);
+        if (op->name == from) {
+            stmt = Store::make(to, value, index, op->param);
+        } else if (value.same_as(op->value) && index.same_as(op->index)) {
+            stmt = op;
+        } else {
+            stmt = Store::make(op->name, value, index, op->param);
+        }
+    }
+
+public:
+    RenameBuffer(const string &from, const string &to) : from(from), to(to) {}
+};
+
+/** Can an allocation share its memory with others? */
+bool shareable(const Allocate *op, const set<string> &referenced) {
+    return ((op->memory_type == MemoryType::Auto && !op->extents.empty() &&
+             Allocate::constant_allocation_size(op->extents, op->name) == 0) ||
+            op->memory_type == MemoryType::Heap) &&
+        op->type.is_scalar() &&
+        !op->new_expr.defined() &&
+        op->free_function.empty() &&
+        !referenced.count(op->name) &&
+        !referenced.count(op->name + ".buffer");
+}
+
+/** Find the first allocation inside the body of another (the slab)
+ * that begins after the slab is last used, with only straight-line
+ * code between the two, and replace it with its body, with its loads
+ * and stores redirected to the slab. */
+class MergeLaterAllocation : public IRMutator {
+    const string &slab;
+    const set<string> &referenced;
+
+    // The lets between the allocation of the slab and the current
+    // Stmt. The slab is allocated before these are defined, so the
+    // extents of the merged allocation have them substituted in.
+    Scope<int> defined;
+    vector<std::pair<string, Expr>> containing_lets;
+
+    // Whether the slab is used after the current Stmt.
+    bool used_later = false;
+
+    using IRMutator::visit;
+
+    void visit(const Block *op) {
+        bool old_used_later = used_later;
+        used_later = used_later || uses_buffer(op->rest, slab);
+        Stmt first = mutate(op->first);
+        used_later = old_used_later;
+        Stmt rest = merged ? op->rest : mutate(op->rest);
+        if (first.same_as(op->first) && rest.same_as(op->rest)) {
+            stmt = op;
+        } else {
+            stmt = Block::make(first, rest);
+        }
+    }
+
+    void visit(const LetStmt *op) {
+        defined.push(op->name, 0);
+        containing_lets.push_back({op->name, op->value});
+        Stmt body = mutate(op->body);
+        containing_lets.pop_back();
+        defined.pop(op->name);
+        if (body.same_as(op->body)) {
+            stmt = op;
+        } else {
+            stmt = LetStmt::make(op->name, op->value, body);
+        }
+    }
+
+    /** Rewrite an Expr in terms of the variables defined outside
+     * the slab. Returns an undefined Expr if that isn't possible, or
+     * if it wouldn't be safe to evaluate it earlier. */
+    Expr hoist(Expr e) {
+        for (size_t i = containing_lets.size(); i > 0; i--) {
+            const auto &l = containing_lets[i-1];
+            if (expr_uses_var(e, l.first)) {
+                e = Let::make(l.first, l.second, e);
+            }
+        }
+        if (expr_uses_vars(e, defined) || !is_pure(e)) {
+            return Expr();
+        }
+        return simplify(e);
+    }
+
+    void visit(const Allocate *op) {
+        if (!used_later && shareable(op, referenced) &&
+            !uses_buffer(op->body, slab)) {
+            condition = hoist(op->condition);
+            extents.clear();
+            for (Expr e : op->extents) {
+                extents.push_back(hoist(e));
+                if (!extents.back().defined()) {
+                    condition = Expr();
+                }
+            }
+            if (condition.defined()) {
+                merged = op;
+                stmt = RenameBuffer(op->name, slab).mutate(op->body);
+                return;
+            }
+        }
+        Stmt body = mutate(op->body);
+        if (body.same_as(op->body)) {
+            stmt = op;
+        } else {
+            stmt = Allocate::make(op->name, op->type, op->memory_type, op->extents,
+                                  op->condition, body, op->new_expr, op->free_function);
+        }
+    }
+
+public:
+    MergeLaterAllocation(const string &slab, const set<string> &referenced)
+        : slab(slab), referenced(referenced) {}
+
+    // The allocation that was merged into the slab, and its condition
+    // and extents in terms of variables defined outside the slab.
+    const Allocate *merged = nullptr;
+    Expr condition;
+    vector<Expr> extents;
+
+    Stmt mutate(Stmt s) {
+        // Only look through straight-line code. Loops and branches
+        // end the search.
+        if (merged ||
+            !(s.as<Block>() || s.as<LetStmt>() ||
+              s.as<ProducerConsumer>() || s.as<Allocate>())) {
+            return s;
+        }
+        return IRMutator::mutate(s);
+    }
+};
+
+/** The total size in bytes of an allocation. */
+Expr allocation_bytes(Type t, const vector<Expr> &extents) {
+    Expr bytes = make_const(UInt(64), t.bytes());
+    for (Expr e : extents) {
+        bytes *= cast(UInt(64), e);
+    }
+    return bytes;
+}
+
+/** Convert the extents of an allocation of type from to enough extents
+ * of type to, which is at least as wide, to hold it. */
+vector<Expr> widen_extents(Type from, Type to, vector<Expr> extents) {
+    // Scalar type sizes are powers of two.
+    int ratio = to.bytes() / from.bytes();
+    if (ratio > 1) {
+        extents[0] = (extents[0] + ratio - 1) / ratio;
+    }
+    return extents;
+}
+
+class ShareAllocations : public IRMutator {
+    set<string> referenced;
+
+    using IRMutator::visit;
+
+    void visit(const Allocate *op) {
+        if (!shareable(op, referenced)) {
+            IRMutator::visit(op);
+            return;
+        }
+
+        Type type = op->type;
+        vector<Expr> extents = op->extents;
+        Expr condition = op->condition;
+        Stmt body = op->body;
+        while (true) {
+            MergeLaterAllocation merge(op->name, referenced);
+            body = merge.mutate(body);
+            const Allocate *b = merge.merged;
+            if (!b) break;
+
+            debug(3) << "Allocation " << b->name << " shares the memory of " << op->name << "\n";
+
+            // Grow the slab to the larger of the two, in units of the
+            // wider type. The alignment of the wider type, and the
+            // padding codegen adds for it, then suffice for both.
+            Type wide = type.bytes() >= b->type.bytes() ? type : b->type;
+            vector<Expr> a_extents = widen_extents(type, wide, extents);
+            vector<Expr> b_extents = widen_extents(b->type, wide, merge.extents);
+            Expr a_is_larger = (allocation_bytes(type, extents) >=
+                                allocation_bytes(b->type, merge.extents));
+            size_t dims = std::max(a_extents.size(), b_extents.size());
+            a_extents.resize(dims, 1);
+            b_extents.resize(dims, 1);
+            extents.clear();
+            for (size_t i = 0; i < dims; i++) {
+                extents.push_back(simplify(select(a_is_larger, a_extents[i], b_extents[i])));
+            }
+            type = wide;
+            condition = simplify(condition || merge.condition);
+        }
+        body = mutate(body);
+
+        if (body.same_as(op->body)) {
+            stmt = op;
+        } else {
+            stmt = Allocate::make(op->name, type, op->memory_type, extents, condition, body);
+        }
+    }
+
+    void visit(const For *op) {
+        // Leave the allocations of GPU kernels and other devices alone.
+        if (op->device_api != DeviceAPI::None &&
+            op->device_api != DeviceAPI::Host) {
+            stmt = op;
+        } else {
+            IRMutator::visit(op);
+        }
+    }
+
+public:
+    ShareAllocations(Stmt s) {
+        FindVariables find;
+        s.accept(&find);
+        referenced.swap(find.names);
+    }
+};
+
+}
+
+Stmt share_allocations(Stmt s) {
+    return ShareAllocations(s).mutate(s);
+}
+
+void share_allocations_test() {
+    Expr n = Variable::make(Int(32), "n");
+    Expr x = Variable::make(Int(32), "x");
+    auto loop = [&](const string &name, Expr value) {
+        return For::make("x", 0, n, ForType::Serial, DeviceAPI::None,
+                         Store::make(name, value, x, Parameter()));
+    };
+    auto load = [&](Type t, const string &name) {
+        return Load::make(t, name, x, Buffer<>(), Parameter());
+    };
+
+    // f is last used by g, so h can reuse its memory. g is still
+    // needed by h, so it gets its own. The size of h is defined after
+    // f is allocated, so it is substituted in.
+    Stmt h = ProducerConsumer::make("h", false, loop("out", load(Float(32), "h")));
+    h = Block::make(ProducerConsumer::make("h", true, loop("h", load(UInt(8), "g") * 2.0f)), h);
+    h = Allocate::make("h", Float(32), MemoryType::Auto, {Variable::make(Int(32), "h.extent")}, const_true(), h);
+    h = LetStmt::make("h.extent", n + 1, h);
+    h = ProducerConsumer::make("g", false, h);
+    Stmt g = Block::make(ProducerConsumer::make("g", true, loop("g", cast<uint8_t>(load(Int(16), "f")))), h);
+    g = Allocate::make("g", UInt(8), MemoryType::Auto, {n, 2}, const_true(), g);
+    g = ProducerConsumer::make("f", false, g);
+    Stmt f = Block::make(ProducerConsumer::make("f", true, loop("f", cast<int16_t>(x))), g);
+    f = Allocate::make("f", Int(16), MemoryType::Auto, {n}, const_true(), f);
+
+    Stmt result = share_allocations(f);
+
+    const Allocate *a = result.as<Allocate>();
+    internal_assert(a && a->name == "f" && a->type == Float(32))
+        << "Expected h to share the memory of f:\n" << result << "\n";
+    const Block *block = a->body.as<Block>();
+    const ProducerConsumer *consume_f = block ? block->rest.as<ProducerConsumer>() : nullptr;
+    const Allocate *b = consume_f ? consume_f->body.as<Allocate>() : nullptr;
+    internal_assert(!expr_uses_var(a->extents[0], "h.extent"))
+        << "Expected the size of h to be substituted in:\n" << result << "\n";
+    internal_assert(b && b->name == "g")
+        << "Expected g to keep its own allocation:\n" << result << "\n";
+    internal_assert(uses_buffer(b->body, "f") && !uses_buffer(b->body, "h"))
+        << "Expected the uses of h to use f instead:\n" << result << "\n";
+
+    // Allocations that are referenced by a halide_buffer_t (here, the
+    // Variable "h.buffer") are left alone.
+    Stmt ref = Block::make(f, Evaluate::make(Variable::make(Handle(), "h.buffer")));
+    result = share_allocations(ref);
+    internal_assert(result.same_as(ref))
+        << "Expected no allocations to be shared:\n" << result << "\n";
+
+    std::cout << "Share allocations test passed\n";
+}
+
+}
+}
@@ -0,0 +1,32 @@
+#ifndef HALIDE_SHARE_ALLOCATIONS_H
+#define HALIDE_SHARE_ALLOCATIONS_H
+
+/** \file
+ * Defines the lowering pass that lets allocations with disjoint
+ * lifetimes share memory.
+ */
+
+#include "IR.h"
+
+namespace Halide {
+namespace Internal {
+
+/** Find dynamically-sized heap allocations that only begin after an
+ * enclosing allocation is last used, such as two compute_root
+ * intermediates of a long pipeline, and have the later one reuse the
+ * memory of the earlier one. The earlier allocation grows to whichever
+ * of the two is larger, and the later one is replaced by it, so there
+ * is one call to the allocator instead of two, and peak memory is the
+ * larger of the two rather than their sum. Allocations that a
+ * halide_buffer_t refers to (for extern stages or devices), and
+ * constant-sized ones (which codegen already reuses on the stack), are
+ * left alone. Must be called after storage_flattening, and before
+ * inject_early_frees. */
+Stmt share_allocations(Stmt s);
+
+EXPORT void share_allocations_test();
+
+}
+}
+
+#endif
@@ -13,6 +13,7 @@
 #include "Var.h"
 #include "Debug.h"
 #include "ModulusRemainder.h"
+#include "RewriteRules.h"
 #include "Substitute.h"
 #include "Bounds.h"
 #include "Deinterleave.h"
@@ -165,6 +166,68 @@ bool expr_is_pure(Expr e) {
     return pure.result;
 }
 
+// The rules for min and max that depend only on which operands are
+// equal. Each rule is added for wildcards of every type of any
+// width. The ones not marked as needing no overflow hold for any
+// total order.
+template<typename Op, typename Other>
+RewriteRules make_min_max_rules() {
+    RewriteRules rules;
+    auto no_overflow_rule = [](const map<string, Expr> &m) { return no_overflow(m.at("x").type()); };
+    for (Type t : {Int(0, 0), UInt(0, 0), Float(0, 0)}) {
+        Expr x = Variable::make(t, "x"), y = Variable::make(t, "y"), z = Variable::make(t, "z");
+        Expr w = Variable::make(t, "w"), l = Variable::make(t, "l");
+        // min(max(x, y), min(x, y)) -> min(x, y)
+        rules.add(Op::make(Other::make(x, y), Op::make(x, y)), Op::make(x, y));
+        rules.add(Op::make(Other::make(x, y), Op::make(y, x)), Op::make(x, y));
+        // min(max(x, y), x) -> x
+        rules.add(Op::make(Other::make(x, y), x), x);
+        rules.add(Op::make(Other::make(x, y), y), y);
+        // min(min(x, y), y) -> min(x, y)
+        rules.add(Op::make(Op::make(x, y), y), Op::make(x, y));
+        rules.add(Op::make(Op::make(x, y), x), Op::make(x, y));
+        rules.add(Op::make(y, Op::make(x, y)), Op::make(x, y));
+        rules.add(Op::make(x, Op::make(x, y)), Op::make(x, y));
+        // min(min(min(x, y), z), y) -> min(min(x, y), z), and so on
+        rules.add(Op::make(Op::make(Op::make(x, y), z), y), Op::make(Op::make(x, y), z));
+        rules.add(Op::make(Op::make(Op::make(Op::make(x, y), z), w), y),
+                  Op::make(Op::make(Op::make(x, y), z), w));
+        rules.add(Op::make(Op::make(Op::make(Op::make(Op::make(x, y), z), w), l), y),
+                  Op::make(Op::make(Op::make(Op::make(x, y), z), w), l));
+        // Distributive law for min/max
+        // min(max(x, y), max(x, z)) -> max(min(y, z), x)
+        rules.add(Op::make(Other::make(x, y), Other::make(x, z)), Other::make(Op::make(y, z), x));
+        rules.add(Op::make(Other::make(x, y), Other::make(z, x)), Other::make(Op::make(y, z), x));
+        rules.add(Op::make(Other::make(y, x), Other::make(x, z)), Other::make(Op::make(y, z), x));
+        rules.add(Op::make(Other::make(y, x), Other::make(z, x)), Other::make(Op::make(y, z), x));
+        // min(min(x, y), min(x, z)) -> min(min(y, z), x)
+        rules.add(Op::make(Op::make(x, y), Op::make(x, z)), Op::make(Op::make(y, z), x));
+        rules.add(Op::make(Op::make(x, y), Op::make(z, x)), Op::make(Op::make(y, z), x));
+        rules.add(Op::make(Op::make(y, x), Op::make(x, z)), Op::make(Op::make(y, z), x));
+        rules.add(Op::make(Op::make(y, x), Op::make(z, x)), Op::make(Op::make(y, z), x));
+        // min(max(min(x, y), z), y) -> min(max(x, z), y)
+        rules.add(Op::make(Other::make(Op::make(x, y), z), y), Op::make(Other::make(x, z), y));
+        rules.add(Op::make(Other::make(Op::make(y, x), z), y), Op::make(Other::make(x, z), y));
+        // Distributive law for addition
+        // min(x + y, z + y) -> min(x, z) + y
+        rules.add(Op::make(Add::make(x, y), Add::make(z, y)), Add::make(Op::make(x, z), y), no_overflow_rule);
+        rules.add(Op::make(Add::make(y, x), Add::make(y, z)), Add::make(Op::make(x, z), y), no_overflow_rule);
+        rules.add(Op::make(Add::make(y, x), Add::make(z, y)), Add::make(Op::make(x, z), y), no_overflow_rule);
+        rules.add(Op::make(Add::make(x, y), Add::make(y, z)), Add::make(Op::make(x, z), y), no_overflow_rule);
+    }
+    return rules;
+}
+
+const RewriteRules &min_rules() {
+    static RewriteRules rules = make_min_max_rules<Min, Max>();
+    return rules;
+}
+
+const RewriteRules &max_rules() {
+    static RewriteRules rules = make_min_max_rules<Max, Min>();
+    return rules;
+}
+
 }
 
 class Simplify : public IRMutator {
@@ -184,6 +247,21 @@ public:
 
     }
 
+    // Rewrite op, with its operands simplified to a and b, with the
+    // first of the rules that applies, if any.
+    template<typename T>
+    bool rewrite(const RewriteRules &rules, const T *op, const Expr &a, const Expr &b) {
+        Expr e = (a.same_as(op->a) && b.same_as(op->b)) ? Expr(op) : T::make(a, b);
+        Expr result;
+        bool is_part = false;
+        if (!rules.rewrite(e, &result, &is_part)) {
+            return false;
+        }
+        // A part of the Expr is simplified already.
+        expr = is_part ? result : mutate(result);
+        return true;
+    }
+
     // Uncomment to debug all Expr mutations.
     /*
     Expr mutate(Expr e) {
@@ -2239,127 +2317,14 @@ private:
                    is_const(max_a->b, b_round_up_factor)) {
             // min(max(a, 4), ((a + 3)/4)*4) -> max(a, 4)
             expr = a;
-        } else if (max_a &&
-                   min_b &&
-                   equal(max_a->a, min_b->a) &&
-                   equal(max_a->b, min_b->b)) {
-            // min(max(x, y), min(x, y)) -> min(x, y)
-            expr = mutate(min(max_a->a, max_a->b));
-        } else if (max_a &&
-                   min_b &&
-                   equal(max_a->a, min_b->b) &&
-                   equal(max_a->b, min_b->a)) {
-            // min(max(x, y), min(y, x)) -> min(x, y)
-            expr = mutate(min(max_a->a, max_a->b));
-        } else if (max_a &&
-                   (equal(max_a->a, b) || equal(max_a->b, b))) {
-            // min(max(x, y), x) -> x
-            // min(max(x, y), y) -> y
-            expr = b;
-        } else if (min_a &&
-                   (equal(min_a->b, b) || equal(min_a->a, b))) {
-            // min(min(x, y), y) -> min(x, y)
-            expr = a;
-        } else if (min_b &&
-                   (equal(min_b->b, a) || equal(min_b->a, a))) {
-            // min(y, min(x, y)) -> min(x, y)
-            expr = b;
         } else if (min_a &&
                    broadcast_a_b &&
                    broadcast_b ) {
             // min(min(x, broadcast(y, n)), broadcast(z, n))) -> min(x, broadcast(min(y, z), n))
             expr = mutate(Min::make(min_a->a, Broadcast::make(Min::make(broadcast_a_b->value, broadcast_b->value), broadcast_b->lanes)));
-        } else if (min_a &&
-                   min_a_a &&
-                   equal(min_a_a->b, b)) {
-            // min(min(min(x, y), z), y) -> min(min(x, y), z)
-            expr = a;
-        } else if (min_a &&
-                   min_a_a_a &&
-                   equal(min_a_a_a->b, b)) {
-            // min(min(min(min(x, y), z), w), y) -> min(min(min(x, y), z), w)
-            expr = a;
-        } else if (min_a &&
-                   min_a_a_a_a &&
-                   equal(min_a_a_a_a->b, b)) {
-            // min(min(min(min(min(x, y), z), w), l), y) -> min(min(min(min(x, y), z), w), l)
-            expr = a;
-        } else if (max_a &&
-                   max_b &&
-                   equal(max_a->a, max_b->a)) {
-            // Distributive law for min/max
-            // min(max(x, y), max(x, z)) -> max(min(y, z), x)
-            expr = mutate(Max::make(Min::make(max_a->b, max_b->b), max_a->a));
-        } else if (max_a &&
-                   max_b &&
-                   equal(max_a->a, max_b->b)) {
-            // min(max(x, y), max(z, x)) -> max(min(y, z), x)
-            expr = mutate(Max::make(Min::make(max_a->b, max_b->a), max_a->a));
-        } else if (max_a &&
-                   max_b &&
-                   equal(max_a->b, max_b->a)) {
-            // min(max(y, x), max(x, z)) -> max(min(y, z), x)
-            expr = mutate(Max::make(Min::make(max_a->a, max_b->b), max_a->b));
-        } else if (max_a &&
-                   max_b &&
-                   equal(max_a->b, max_b->b)) {
-            // min(max(y, x), max(z, x)) -> max(min(y, z), x)
-            expr = mutate(Max::make(Min::make(max_a->a, max_b->a), max_a->b));
-        } else if (min_a &&
-                   min_b &&
-                   equal(min_a->a, min_b->a)) {
-            // min(min(x, y), min(x, z)) -> min(min(y, z), x)
-            expr = mutate(Min::make(Min::make(min_a->b, min_b->b), min_a->a));
-        } else if (min_a &&
-                   min_b &&
-                   equal(min_a->a, min_b->b)) {
-            // min(min(x, y), min(z, x)) -> min(min(y, z), x)
-            expr = mutate(Min::make(Min::make(min_a->b, min_b->a), min_a->a));
-        } else if (min_a &&
-                   min_b &&
-                   equal(min_a->b, min_b->a)) {
-            // min(min(y, x), min(x, z)) -> min(min(y, z), x)
-            expr = mutate(Min::make(Min::make(min_a->a, min_b->b), min_a->b));
-        } else if (min_a &&
-                   min_b &&
-                   equal(min_a->b, min_b->b)) {
-            // min(min(y, x), min(z, x)) -> min(min(y, z), x)
-            expr = mutate(Min::make(Min::make(min_a->a, min_b->a), min_a->b));
-        } else if (max_a &&
-                   min_a_a &&
-                   equal(min_a_a->b, b)) {
-            // min(max(min(x, y), z), y) -> min(max(x, z), y)
-            expr = mutate(min(max(min_a_a->a, max_a->b), b));
-        } else if (max_a &&
-                   min_a_a &&
-                   equal(min_a_a->a, b)) {
-            // min(max(min(y, x), z), y) -> min(max(x, z), y)
-            expr = mutate(min(max(min_a_a->b, max_a->b), b));
-        } else if (no_overflow(op->type) &&
-                   add_a &&
-                   add_b &&
-                   equal(add_a->b, add_b->b)) {
-            // Distributive law for addition
-            // min(a + b, c + b) -> min(a, c) + b
-            expr = mutate(min(add_a->a, add_b->a)) + add_a->b;
-        } else if (no_overflow(op->type) &&
-                   add_a &&
-                   add_b &&
-                   equal(add_a->a, add_b->a)) {
-            // min(b + a, b + c) -> min(a, c) + b
-            expr = mutate(min(add_a->b, add_b->b)) + add_a->a;
-        } else if (no_overflow(op->type) &&
-                   add_a &&
-                   add_b &&
-                   equal(add_a->a, add_b->b)) {
-            // min(b + a, c + b) -> min(a, c) + b
-            expr = mutate(min(add_a->b, add_b->a)) + add_a->a;
-        } else if (no_overflow(op->type) &&
-                   add_a &&
-                   add_b &&
-                   equal(add_a->b, add_b->a)) {
-            // min(a + b, b + c) -> min(a, c) + b
-            expr = mutate(min(add_a->a, add_b->b)) + add_a->b;
+        } else if (rewrite(min_rules(), op, a, b)) {
+            // The rules in min_rules() cover the cases that depend only on
+            // which operands are equal.
         } else if (min_a &&
                    is_simple_const(min_a->b)) {
             if (is_simple_const(b)) {
@@ -2602,125 +2567,14 @@ private:
             } else {
                 expr = b;
             }
-        } else if (min_a &&
-                   max_b &&
-                   equal(min_a->a, max_b->a) &&
-                   equal(min_a->b, max_b->b)) {
-            // max(min(x, y), max(x, y)) -> max(x, y)
-            expr = mutate(max(min_a->a, min_a->b));
-        } else if (min_a &&
-                   max_b &&
-                   equal(min_a->a, max_b->b) &&
-                   equal(min_a->b, max_b->a)) {
-            // max(min(x, y), max(y, x)) -> max(x, y)
-            expr = mutate(max(min_a->a, min_a->b));
-        } else if (min_a &&
-                   (equal(min_a->a, b) || equal(min_a->b, b))) {
-            // max(min(x, y), x) -> x
-            // max(min(x, y), y) -> y
-            expr = b;
-        } else if (max_a &&
-                   (equal(max_a->b, b) || equal(max_a->a, b))) {
-            // max(max(x, y), y) -> max(x, y)
-            expr = a;
-        } else if (max_b &&
-                   (equal(max_b->b, a) || equal(max_b->a, a))) {
-            // max(y, max(x, y)) -> max(x, y)
-            expr = b;
         } else if (max_a &&
                    broadcast_a_b &&
                    broadcast_b ) {
             // max(max(x, broadcast(y, n)), broadcast(z, n))) -> max(x, broadcast(max(y, z), n))
             expr = mutate(Max::make(max_a->a, Broadcast::make(Max::make(broadcast_a_b->value, broadcast_b->value), broadcast_b->lanes)));
-        } else if (max_a &&
-                   max_a_a &&
-                   equal(max_a_a->b, b)) {
-            // max(max(max(x, y), z), y) -> max(max(x, y), z)
-            expr = a;
-        } else if (max_a_a_a &&
-                   equal(max_a_a_a->b, b)) {
-            // max(max(max(max(x, y), z), w), y) -> max(max(max(x, y), z), w)
-            expr = a;
-        } else if (max_a_a_a_a &&
-                   equal(max_a_a_a_a->b, b)) {
-            // max(max(max(max(max(x, y), z), w), l), y) -> max(max(max(max(x, y), z), w), l)
-            expr = a;
-        } else if (max_a &&
-                   max_b &&
-                   equal(max_a->a, max_b->a)) {
-            // Distributive law for min/max
-            // max(max(x, y), max(x, z)) -> max(max(y, z), x)
-            expr = mutate(Max::make(Max::make(max_a->b, max_b->b), max_a->a));
-        } else if (max_a &&
-                   max_b &&
-                   equal(max_a->a, max_b->b)) {
-            // max(max(x, y), max(z, x)) -> max(max(y, z), x)
-            expr = mutate(Max::make(Max::make(max_a->b, max_b->a), max_a->a));
-        } else if (max_a &&
-                   max_b &&
-                   equal(max_a->b, max_b->a)) {
-            // max(max(y, x), max(x, z)) -> max(max(y, z), x)
-            expr = mutate(Max::make(Max::make(max_a->a, max_b->b), max_a->b));
-        } else if (max_a &&
-                   max_b &&
-                   equal(max_a->b, max_b->b)) {
-            // max(max(y, x), max(z, x)) -> max(max(y, z), x)
-            expr = mutate(Max::make(Max::make(max_a->a, max_b->a), max_a->b));
-        } else if (min_a &&
-                   min_b &&
-                   equal(min_a->a, min_b->a)) {
-            // max(min(x, y), min(x, z)) -> min(max(y, z), x)
-            expr = mutate(Min::make(Max::make(min_a->b, min_b->b), min_a->a));
-        } else if (min_a &&
-                   min_b &&
-                   equal(min_a->a, min_b->b)) {
-            // max(min(x, y), min(z, x)) -> min(max(y, z), x)
-            expr = mutate(Min::make(Max::make(min_a->b, min_b->a), min_a->a));
-        } else if (min_a &&
-                   min_b &&
-                   equal(min_a->b, min_b->a)) {
-            // max(min(y, x), min(x, z)) -> min(max(y, z), x)
-            expr = mutate(Min::make(Max::make(min_a->a, min_b->b), min_a->b));
-        } else if (min_a &&
-                   min_b &&
-                   equal(min_a->b, min_b->b)) {
-            // max(min(y, x), min(z, x)) -> min(max(y, z), x)
-            expr = mutate(Min::make(Max::make(min_a->a, min_b->a), min_a->b));
-        } else if (min_a &&
-                   max_a_a &&
-                   equal(max_a_a->b, b)) {
-            // max(min(max(x, y), z), y) -> max(min(x, z), y)
-            expr = mutate(max(min(max_a_a->a, min_a->b), b));
-        } else if (min_a &&
-                   max_a_a &&
-                   equal(max_a_a->a, b)) {
-            // max(min(max(y, x), z), y) -> max(min(x, z), y)
-            expr = mutate(max(min(max_a_a->b, min_a->b), b));
-        } else if (no_overflow(op->type) &&
-                   add_a &&
-                   add_b &&
-                   equal(add_a->b, add_b->b)) {
-            // Distributive law for addition
-            // max(a + b, c + b) -> max(a, c) + b
-            expr = mutate(max(add_a->a, add_b->a)) + add_a->b;
-        } else if (no_overflow(op->type) &&
-                   add_a &&
-                   add_b &&
-                   equal(add_a->a, add_b->a)) {
-            // max(b + a, b + c) -> max(a, c) + b
-            expr = mutate(max(add_a->b, add_b->b)) + add_a->a;
-        } else if (no_overflow(op->type) &&
-                   add_a &&
-                   add_b &&
-                   equal(add_a->a, add_b->b)) {
-            // max(b + a, c + b) -> max(a, c) + b
-            expr = mutate(max(add_a->b, add_b->a)) + add_a->a;
-        } else if (no_overflow(op->type) &&
-                   add_a &&
-                   add_b &&
-                   equal(add_a->b, add_b->a)) {
-            // max(a + b, b + c) -> max(a, c) + b
-            expr = mutate(max(add_a->a, add_b->b)) + add_a->b;
+        } else if (rewrite(max_rules(), op, a, b)) {
+            // The rules in max_rules() cover the cases that depend only on
+            // which operands are equal.
         } else if (max_a && is_simple_const(max_a->b)) {
             if (is_simple_const(b)) {
                 // max(max(x, 4), 5) -> max(x, 4)
@@ -4566,7 +4420,7 @@ private:
             equal(op->condition, body_if->condition)) {
             // We can move the allocation into the if body case. The
             // else case must not use it.
-            stmt = Allocate::make(op->name, op->type, new_extents,
+            stmt = Allocate::make(op->name, op->type, op->memory_type, new_extents,
                                   condition, body_if->then_case,
                                   new_expr, op->free_function);
             stmt = IfThenElse::make(body_if->condition, stmt, body_if->else_case);
@@ -4576,7 +4430,7 @@ private:
                    new_expr.same_as(op->new_expr)) {
             stmt = op;
         } else {
-            stmt = Allocate::make(op->name, op->type, new_extents,
+            stmt = Allocate::make(op->name, op->type, op->memory_type, new_extents,
                                   condition, body,
                                   new_expr, op->free_function);
         }
@@ -4665,10 +4519,101 @@ private:
     }
 };
 
+namespace {
+
+// The results of simplifying Exprs with no facts about the enclosing
+// scope, kept while a SimplifyCacheScope is alive on this
+// thread. Exprs are compared by value, so structurally identical
+// Exprs that aren't the same node share an entry.
+struct SimplifyCache {
+    IRCompareCache compare_cache;
+    map<ExprWithCompareCache, Expr> results[2];
+    size_t entries;
+
+    // Bound the memory held onto by a long lowering.
+    static const size_t max_entries = 1 << 16;
+
+    SimplifyCache() : compare_cache(8), entries(0) {}
+
+    void clear() {
+        results[0].clear();
+        results[1].clear();
+        compare_cache.clear();
+        entries = 0;
+    }
+};
+
+thread_local SimplifyCache *simplify_cache = nullptr;
+
+// Each poison value made during constant folding is distinct, so
+// results containing one can't be shared.
+class ContainsPoison : public IRVisitor {
+    using IRVisitor::visit;
+
+    void visit(const Call *op) {
+        if (op->is_intrinsic(Call::signed_integer_overflow) ||
+            op->is_intrinsic(Call::indeterminate_expression)) {
+            result = true;
+        } else {
+            IRVisitor::visit(op);
+        }
+    }
+
+public:
+    bool result = false;
+};
+
+bool contains_poison(Expr e) {
+    ContainsPoison c;
+    e.accept(&c);
+    return c.result;
+}
+
+}
+
+SimplifyCacheScope::SimplifyCacheScope() : owner(simplify_cache == nullptr) {
+    if (owner) {
+        simplify_cache = new SimplifyCache;
+    }
+}
+
+SimplifyCacheScope::~SimplifyCacheScope() {
+    if (owner) {
+        delete simplify_cache;
+        simplify_cache = nullptr;
+    }
+}
+
 Expr simplify(Expr e, bool simplify_lets,
               const Scope<Interval> &bounds,
               const Scope<ModulusRemainder> &alignment) {
-    return Simplify(simplify_lets, &bounds, &alignment).mutate(e);
+    SimplifyCache *cache = simplify_cache;
+    // Only results that depend on nothing but the Expr itself can be
+    // reused, and there's nothing to gain for leaves.
+    if (!cache ||
+        &bounds != &Scope<Interval>::empty_scope() ||
+        &alignment != &Scope<ModulusRemainder>::empty_scope() ||
+        !e.defined() || e.as<Variable>() || is_const(e)) {
+        return Simplify(simplify_lets, &bounds, &alignment).mutate(e);
+    }
+
+    map<ExprWithCompareCache, Expr> &results = cache->results[simplify_lets ? 1 : 0];
+    ExprWithCompareCache key(e, &cache->compare_cache);
+    map<ExprWithCompareCache, Expr>::iterator iter = results.find(key);
+    if (iter != results.end()) {
+        return iter->second;
+    }
+
+    Expr result = Simplify(simplify_lets, &bounds, &alignment).mutate(e);
+    if (contains_poison(result)) {
+        return result;
+    }
+    if (cache->entries >= SimplifyCache::max_entries) {
+        cache->clear();
+    }
+    results.emplace(key, result);
+    cache->entries++;
+    return result;
 }
 
 Stmt simplify(Stmt s, bool simplify_lets,
@@ -5868,6 +5813,28 @@ void simplify_test() {
     Expr yf = cast<float>(y);
     Expr t = const_true(), f = const_false();
 
+    {
+        // Structurally identical Exprs should share a cached result
+        // that matches what the uncached simplifier produces.
+        Expr e1 = (x + 3) * 2 - x * 2 + min(y, y + 1);
+        Expr e2 = (x + 3) * 2 - x * 2 + min(y, y + 1);
+        Expr expected = simplify(e1);
+        SimplifyCacheScope cache;
+        Expr r1 = simplify(e1), r2 = simplify(e2);
+        internal_assert(equal(r1, expected) && r1.same_as(r2))
+            << "Cached simplification of " << e1 << " gave " << r1 << " and " << r2
+            << " instead of " << expected << "\n";
+        {
+            SimplifyCacheScope nested;
+            internal_assert(simplify(e2).same_as(r1))
+                << "Nested SimplifyCacheScope didn't reuse the enclosing cache\n";
+        }
+        Scope<Interval> bounds;
+        bounds.push("x", Interval(0, 10));
+        internal_assert(is_one(simplify(x <= 10, true, bounds)) && !can_prove(x <= 10))
+            << "Simplification with bounds facts shouldn't be cached\n";
+    }
+
     check_indeterminate();
     check_casts();
     check_algebra();
@@ -29,6 +29,25 @@ EXPORT Expr simplify(Expr, bool simplify_lets = true,
                      const Scope<ModulusRemainder> &alignment = Scope<ModulusRemainder>::empty_scope());
 // @}
 
+/** While an object of this class is alive, calls to simplify(Expr)
+ * and can_prove on the current thread that pass no bounds or
+ * alignment facts remember their results, so that simplifying an
+ * Expr structurally equal to one seen before is a lookup. lower()
+ * holds one for the whole of lowering. Nested scopes share the
+ * outermost cache. Only use this where Exprs with the same name
+ * refer to the same thing, because the cache compares Variables,
+ * Loads and Calls by name. */
+class SimplifyCacheScope {
+    bool owner;
+
+    SimplifyCacheScope(const SimplifyCacheScope &) = delete;
+    SimplifyCacheScope &operator=(const SimplifyCacheScope &) = delete;
+
+public:
+    EXPORT SimplifyCacheScope();
+    EXPORT ~SimplifyCacheScope();
+};
+
 /** A common use of the simplifier is to prove boolean expressions are
  * true at compile time. Equivalent to is_one(simplify(e)) */
 EXPORT bool can_prove(Expr e);
@@ -482,18 +482,33 @@ class MightBeSkippable : public IRVisitor {
             result = true;
             op->body.accept(this);
             result = result || old_result;
+        } else if (op->is_producer) {
+            string old_producing = producing;
+            producing = op->name;
+            IRVisitor::visit(op);
+            producing = old_producing;
         } else {
             IRVisitor::visit(op);
         }
     }
 
-    string func;
+    // A production that also computes another Func, or a Func
+    // computed within another's production, can't be skipped on its
+    // own. See Stage::compute_with.
+    void visit(const Provide *op) {
+        IRVisitor::visit(op);
+        if ((op->name == func) != (producing == func)) {
+            fused = true;
+        }
+    }
+
+    string func, producing;
     bool guarded;
 
 public:
-    bool result;
+    bool result, fused;
 
-    MightBeSkippable(string f) : func(f), guarded(false), result(false) {}
+    MightBeSkippable(string f) : func(f), guarded(false), result(false), fused(false) {}
 };
 
 Stmt skip_stages(Stmt stmt, const vector<string> &order) {
@@ -503,7 +518,7 @@ Stmt skip_stages(Stmt stmt, const vector<string> &order) {
         debug(2) << "skip_stages checking " << order[i-1] << "\n";
         MightBeSkippable check(order[i-1]);
         stmt.accept(&check);
-        if (check.result) {
+        if (check.result && !check.fused) {
             debug(2) << "skip_stages can skip " << order[i-1] << "\n";
             StageSkipper skipper(order[i-1]);
             stmt = skipper.mutate(stmt);
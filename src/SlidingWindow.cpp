@@ -353,6 +353,135 @@ public:
     SlidingWindowOnFunction(Function f) : func(f) {}
 };
 
+// Does a statement compute or use a particular func?
+class UsesFunc : public IRVisitor {
+    const string &func;
+
+    using IRVisitor::visit;
+
+    void visit(const ProducerConsumer *op) {
+        if (op->name == func) {
+            result = true;
+        } else {
+            IRVisitor::visit(op);
+        }
+    }
+
+    void visit(const Provide *op) {
+        if (op->name == func) {
+            result = true;
+        } else {
+            IRVisitor::visit(op);
+        }
+    }
+
+    void visit(const Call *op) {
+        if (op->name == func) {
+            result = true;
+        } else {
+            IRVisitor::visit(op);
+        }
+    }
+
+public:
+    bool result = false;
+    UsesFunc(const string &f) : func(f) {}
+};
+
+bool uses_func(Stmt s, const string &func) {
+    UsesFunc uses(func);
+    s.accept(&uses);
+    return uses.result;
+}
+
+// Is there a serial loop around a production of a particular func?
+class SerialLoopAroundProduction : public IRVisitor {
+    const string &func;
+    int serial_loops = 0;
+
+    using IRVisitor::visit;
+
+    void visit(const For *op) {
+        bool serial = (op->for_type == ForType::Serial || op->for_type == ForType::Unrolled);
+        serial_loops += serial;
+        IRVisitor::visit(op);
+        serial_loops -= serial;
+    }
+
+    void visit(const ProducerConsumer *op) {
+        if (op->name == func && op->is_producer) {
+            result = result || serial_loops > 0;
+        } else {
+            IRVisitor::visit(op);
+        }
+    }
+
+public:
+    bool result = false;
+    SerialLoopAroundProduction(const string &f) : func(f) {}
+};
+
+// The number of strips a parallel loop is split into, so that its
+// tasks can slide. Each strip pays to warm up its sliding window, so
+// this trades that against the parallelism left over.
+const int max_strips = 16;
+
+// A func stored outside of a parallel loop and computed within it
+// can't slide along that loop, and all of the tasks share its
+// full-size storage. Instead give each task storage of its own, by
+// moving the realization into the loop. If there's then no serial
+// loop to slide along within a task, first split the parallel loop
+// into strips that each run serially, so that each strip warms up
+// once and then slides. Storage folding can then fold the storage of
+// each task down to a ring buffer. Returns an undefined Stmt if the
+// func isn't computed within a parallel loop inside its realization.
+Stmt realize_per_task(const Realize *op, Stmt s) {
+    if (const LetStmt *let = s.as<LetStmt>()) {
+        Stmt body = realize_per_task(op, let->body);
+        return body.defined() ? LetStmt::make(let->name, let->value, body) : body;
+    } else if (const ProducerConsumer *pc = s.as<ProducerConsumer>()) {
+        if (pc->name == op->name) return Stmt();
+        Stmt body = realize_per_task(op, pc->body);
+        return body.defined() ? ProducerConsumer::make(pc->name, pc->is_producer, body) : body;
+    } else if (const Block *b = s.as<Block>()) {
+        bool in_first = uses_func(b->first, op->name);
+        bool in_rest = uses_func(b->rest, op->name);
+        if (in_first && in_rest) {
+            return Stmt();
+        } else if (in_first) {
+            Stmt first = realize_per_task(op, b->first);
+            return first.defined() ? Block::make(first, b->rest) : first;
+        } else {
+            Stmt rest = realize_per_task(op, b->rest);
+            return rest.defined() ? Block::make(b->first, rest) : rest;
+        }
+    }
+
+    const For *loop = s.as<For>();
+    if (!loop || loop->for_type != ForType::Parallel) {
+        return Stmt();
+    }
+
+    SerialLoopAroundProduction serial(op->name);
+    loop->body.accept(&serial);
+    if (serial.result) {
+        debug(3) << "Realizing " << op->name << " per iteration of parallel loop " << loop->name << "\n";
+        Stmt body = Realize::make(op->name, op->types, op->bounds, op->condition, loop->body);
+        return For::make(loop->name, loop->min, loop->extent, loop->for_type, loop->device_api, body);
+    }
+
+    debug(3) << "Splitting parallel loop " << loop->name << " into strips for " << op->name << "\n";
+    string strip_name = loop->name + ".__strip";
+    Expr strip = Variable::make(Int(32), strip_name);
+    Expr strip_size = (loop->extent + (max_strips - 1)) / max_strips;
+    Expr num_strips = (loop->extent + strip_size - 1) / strip_size;
+    Expr strip_min = loop->min + strip * strip_size;
+    Expr strip_extent = min(strip_size, loop->min + loop->extent - strip_min);
+    Stmt body = For::make(loop->name, strip_min, strip_extent, ForType::Serial, loop->device_api, loop->body);
+    body = Realize::make(op->name, op->types, op->bounds, op->condition, body);
+    return For::make(strip_name, 0, num_strips, ForType::Parallel, loop->device_api, body);
+}
+
 // Perform sliding window optimization for all functions
 class SlidingWindow : public IRMutator {
     const map<string, Function> &env;
@@ -378,6 +507,14 @@ class SlidingWindow : public IRMutator {
             return;
         }
 
+        if (!sched.async() && !sched.fuse_level().defined()) {
+            Stmt per_task = realize_per_task(op, op->body);
+            if (per_task.defined()) {
+                stmt = mutate(per_task);
+                return;
+            }
+        }
+
         Stmt new_body = op->body;
 
         debug(3) << "Doing sliding window analysis on realization of " << op->name << "\n";
@@ -0,0 +1,164 @@
+#include <algorithm>
+
+#include "Sort.h"
+#include "IR.h"
+#include "IROperator.h"
+#include "Util.h"
+
+namespace Halide {
+
+using std::string;
+using std::vector;
+using std::pair;
+
+using namespace Internal;
+
+namespace {
+
+// Sizes up to this are sorted with a sorting network on the values at
+// each point. Larger ones get a pass over the whole range per step of
+// the network.
+const int max_network_size = 32;
+
+// Calls the given function with the chunk size of each step of a
+// bitonic sorting network on n elements, where n is a power of
+// two. Each step compares every element with a partner, and the lower
+// of the two keeps the min. The first step of each merge compares
+// elements mirrored around the middle of their chunk, which makes the
+// network sort in ascending order without any descending runs.
+template<typename F>
+void for_each_bitonic_step(int n, F step) {
+    for (int pass_size = 1; pass_size < n; pass_size <<= 1) {
+        for (int chunk_size = pass_size; chunk_size > 0; chunk_size >>= 1) {
+            step(chunk_size, chunk_size == pass_size);
+        }
+    }
+}
+
+// The partner of element i in a step of the network.
+template<typename T>
+T bitonic_partner(T i, int chunk_size, bool mirrored) {
+    T chunk_start = (i / (2 * chunk_size)) * (2 * chunk_size);
+    if (mirrored) {
+        return 2 * (chunk_start + chunk_size) - i - 1;
+    } else {
+        return chunk_start + (i - chunk_start + chunk_size) % (2 * chunk_size);
+    }
+}
+
+vector<Expr> other_args(const vector<Var> &args) {
+    return vector<Expr>(args.begin() + 1, args.end());
+}
+
+vector<Expr> with_first_arg(Expr first, const vector<Expr> &rest) {
+    vector<Expr> result = {first};
+    result.insert(result.end(), rest.begin(), rest.end());
+    return result;
+}
+
+Func sort_with_network(const Func &f, int size, int n) {
+    vector<Var> args = f.args();
+    vector<Expr> rest = other_args(args);
+    Type t = f.output_types()[0];
+
+    // Pad to a power of two with values that sort to the end.
+    vector<Expr> v(n);
+    for (int i = 0; i < n; i++) {
+        v[i] = i < size ? Expr(f(with_first_arg(i, rest))) : t.max();
+    }
+
+    // Bind the values after each step to lets, so that the network
+    // stays a DAG rather than an expression exponential in its depth.
+    vector<pair<string, Expr>> lets;
+    for_each_bitonic_step(n, [&](int chunk_size, bool mirrored) {
+        vector<Expr> next(n);
+        for (int i = 0; i < n; i++) {
+            int p = bitonic_partner(i, chunk_size, mirrored);
+            next[i] = i < p ? min(v[i], v[p]) : max(v[i], v[p]);
+        }
+        for (int i = 0; i < n; i++) {
+            string name = unique_name('s');
+            lets.push_back({name, next[i]});
+            v[i] = Variable::make(t, name);
+        }
+    });
+
+    Expr x = args[0];
+    Expr value = v[size - 1];
+    for (int i = size - 2; i >= 0; i--) {
+        value = select(x == i, v[i], value);
+    }
+    for (size_t i = lets.size(); i > 0; i--) {
+        value = Let::make(lets[i - 1].first, lets[i - 1].second, value);
+    }
+
+    Func sorted("sort");
+    sorted(args) = value;
+    return sorted;
+}
+
+Func sort_with_passes(const Func &f, int size, int n) {
+    vector<Var> args = f.args();
+    vector<Expr> rest = other_args(args);
+    Var x = args[0];
+    Type t = f.output_types()[0];
+    int vector_width = std::max(1, 16 / t.bytes());
+
+    Func prev("sort_input");
+    prev(args) = select(x < size, f(with_first_arg(clamp(x, 0, size - 1), rest)), t.max());
+
+    for_each_bitonic_step(n, [&](int chunk_size, bool mirrored) {
+        Expr partner = clamp(bitonic_partner(Expr(x), chunk_size, mirrored), 0, n - 1);
+        Expr a = prev(args), b = prev(with_first_arg(partner, rest));
+        Func next("sort_pass");
+        next(args) = select(x < partner, min(a, b), max(a, b));
+
+        // Every element of a step is independent of the others, so
+        // the whole range can be split across threads and vectors.
+        next.compute_root().bound(x, 0, n);
+        if (args.size() > 1) {
+            next.vectorize(x, vector_width).parallel(args.back());
+        } else {
+            Var xo, xi;
+            next.split(x, xo, xi, std::min(n, 4096)).parallel(xo).vectorize(xi, vector_width);
+        }
+        prev = next;
+    });
+
+    Func sorted("sort");
+    sorted(args) = prev(args);
+    return sorted;
+}
+
+}  // namespace
+
+Func sort(const Func &f, int size) {
+    user_assert(f.defined() && f.outputs() == 1 && f.dimensions() > 0)
+        << "Can't sort Func " << f.name()
+        << ", since it isn't a defined, single-valued Func of at least one dimension\n";
+    user_assert(size > 0)
+        << "Can't sort " << size << " values of Func " << f.name() << "\n";
+
+    int n = 1;
+    while (n < size) {
+        n <<= 1;
+    }
+    if (n <= max_network_size) {
+        return sort_with_network(f, size, n);
+    } else {
+        return sort_with_passes(f, size, n);
+    }
+}
+
+Func top_k(const Func &f, int size, int k) {
+    user_assert(k > 0 && k <= size)
+        << "Can't select the top " << k << " of " << size
+        << " values of Func " << f.name() << "\n";
+    Func sorted = sort(f, size);
+    vector<Var> args = sorted.args();
+    Func top("top_k");
+    top(args) = sorted(with_first_arg(size - 1 - args[0], other_args(args)));
+    return top;
+}
+
+}
@@ -0,0 +1,47 @@
+#ifndef HALIDE_SORT_H
+#define HALIDE_SORT_H
+
+#include "Func.h"
+
+/** \file
+ * Defines functions for sorting the values of a Func along one
+ * dimension.
+ */
+
+namespace Halide {
+
+/** Sort the values of a Func along its first dimension, over the
+ * range [0, size), into ascending order. The result is a new Func
+ * with the same dimensions, defined over the same range of its first
+ * dimension. The other dimensions are left as they are, so e.g. a
+ * Func of a window of values around each pixel can be sorted at every
+ * pixel at once:
+ \code
+ Func window;
+ Var i, x, y;
+ window(i, x, y) = input(x + i % 3 - 1, y + i / 3 - 1);
+ Func sorted = sort(window, 9);
+ Func median;
+ median(x, y) = sorted(4, x, y);
+ median.vectorize(x, 8);
+ \endcode
+ *
+ * Small sizes are sorted with a sorting network on the values at each
+ * point of the other dimensions, which the result is inlined into
+ * like any other Func. A use of a single element of the result, like
+ * the median above, then only computes the part of the network that
+ * element depends on, and it vectorizes across the other dimensions
+ * with the rest of the consumer. Larger sizes are sorted in one
+ * parallel, vectorized pass over the whole range per step of the
+ * network, each of which is computed at root. */
+EXPORT Func sort(const Func &f, int size);
+
+/** Select the k largest values of a Func along its first dimension,
+ * over the range [0, size), in descending order. The result is a new
+ * Func with the same dimensions, defined over [0, k) in its first
+ * dimension. It is computed as with \ref sort. */
+EXPORT Func top_k(const Func &f, int size, int k);
+
+}
+
+#endif
@@ -0,0 +1,105 @@
+#include <cstring>
+#include <set>
+
+#include "SpecializeStrides.h"
+#include "IRMutator.h"
+#include "IROperator.h"
+#include "Scope.h"
+#include "Substitute.h"
+
+namespace Halide {
+namespace Internal {
+
+using std::map;
+using std::set;
+using std::string;
+
+namespace {
+
+// Find the innermost strides of the buffers the pipeline is passed,
+// which are the free variables named <buffer>.stride.0. Buffers with
+// a constrained stride instead get a let named
+// <buffer>.stride.0.constrained, and are already specialized.
+class FindInnermostStrides : public IRVisitor {
+    Scope<int> defined;
+    set<string> constrained;
+
+    using IRVisitor::visit;
+
+    template<typename LetOrLetStmt>
+    void visit_let(const LetOrLetStmt *op) {
+        op->value.accept(this);
+        if (ends_with(op->name, ".stride.0.constrained")) {
+            constrained.insert(op->name.substr(0, op->name.size() - strlen(".constrained")));
+        }
+        defined.push(op->name, 0);
+        op->body.accept(this);
+        defined.pop(op->name);
+    }
+
+    void visit(const Let *op) {
+        visit_let(op);
+    }
+
+    void visit(const LetStmt *op) {
+        visit_let(op);
+    }
+
+    void visit(const For *op) {
+        if (op->device_api != DeviceAPI::None &&
+            op->device_api != DeviceAPI::Host) {
+            offloaded = true;
+        }
+        op->min.accept(this);
+        op->extent.accept(this);
+        defined.push(op->name, 0);
+        op->body.accept(this);
+        defined.pop(op->name);
+    }
+
+    void visit(const Variable *op) {
+        if (op->type == Int(32) &&
+            ends_with(op->name, ".stride.0") &&
+            !defined.contains(op->name)) {
+            strides.insert(op->name);
+        }
+    }
+
+public:
+    set<string> strides;
+    bool offloaded = false;
+
+    void remove_constrained() {
+        for (const string &s : constrained) {
+            strides.erase(s);
+        }
+    }
+};
+
+}
+
+Stmt specialize_strides(Stmt s, const Target &t) {
+    if (!t.has_feature(Target::SpecializeStrides)) {
+        return s;
+    }
+
+    FindInnermostStrides finder;
+    s.accept(&finder);
+    finder.remove_constrained();
+    if (finder.offloaded || finder.strides.empty()) {
+        return s;
+    }
+
+    Expr dense;
+    map<string, Expr> replacements;
+    for (const string &name : finder.strides) {
+        Expr is_one = Variable::make(Int(32), name) == 1;
+        dense = dense.defined() ? (dense && is_one) : is_one;
+        replacements[name] = 1;
+    }
+    debug(3) << "Specializing the pipeline on " << dense << "\n";
+    return IfThenElse::make(dense, substitute(replacements, s), s);
+}
+
+}
+}
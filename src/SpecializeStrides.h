@@ -0,0 +1,27 @@
+#ifndef HALIDE_SPECIALIZE_STRIDES_H
+#define HALIDE_SPECIALIZE_STRIDES_H
+
+/** \file
+ * Defines the lowering pass that versions a pipeline on the innermost
+ * strides of its buffers.
+ */
+
+#include "IR.h"
+#include "Target.h"
+
+namespace Halide {
+namespace Internal {
+
+/** If the target has the SpecializeStrides feature, find the input
+ * and output buffers whose innermost stride isn't constrained, and
+ * turn the pipeline into a branch between a copy that assumes those
+ * strides are all one, and the original. The copy can use dense
+ * vector loads and stores. Must be called after storage flattening
+ * and before vectorization. Leaves pipelines with GPU or other
+ * offloaded loops alone. */
+Stmt specialize_strides(Stmt s, const Target &t);
+
+}
+}
+
+#endif
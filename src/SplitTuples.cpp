@@ -1,5 +1,6 @@
 #include "SplitTuples.h"
 #include "Bounds.h"
+#include "ExprUsesVar.h"
 #include "IRMutator.h"
 
 namespace Halide {
@@ -39,7 +40,25 @@ class SplitTuples : public IRMutator {
 
     void visit(const Realize *op) {
         realizations.push(op->name, 0);
-        if (op->types.size() > 1) {
+        auto it = env.find(op->name);
+        bool interleave = (op->types.size() > 1 &&
+                           it != env.end() &&
+                           it->second.schedule().tuple_interleaved());
+        if (interleave) {
+            // Store the tuple elements in one realization, with the
+            // tuple index as an extra innermost dimension.
+            user_assert(!it->second.schedule().memoized())
+                << "Func " << op->name << " can't be both memoized and stored interleaved.\n";
+            interleaved.push(op->name, 0);
+            Stmt body = mutate(op->body);
+            interleaved.pop(op->name);
+            user_assert(!stmt_uses_var(body, op->name + ".0.buffer"))
+                << "Func " << op->name << " is stored interleaved, "
+                << "so it can't be used by an extern stage.\n";
+            Region bounds = op->bounds;
+            bounds.insert(bounds.begin(), Range(0, (int)op->types.size()));
+            stmt = Realize::make(op->name, {op->types[0]}, bounds, op->condition, body);
+        } else if (op->types.size() > 1) {
             // Make a nested set of realize nodes for each tuple element
             Stmt body = mutate(op->body);
             for (int i = (int)op->types.size() - 1; i >= 0; i--) {
@@ -58,10 +77,12 @@ class SplitTuples : public IRMutator {
             internal_assert(it != env.end());
             Function f = it->second;
             string name = op->name;
-            if (f.outputs() > 1) {
+            vector<Expr> args;
+            if (interleaved.contains(op->name)) {
+                args.push_back(op->value_index);
+            } else if (f.outputs() > 1) {
                 name += "." + std::to_string(op->value_index);
             }
-            vector<Expr> args;
             for (Expr e : op->args) {
                 args.push_back(mutate(e));
             }
@@ -125,7 +146,13 @@ class SplitTuples : public IRMutator {
                 lets.push_back(make_pair(var_name, val));
                 val = Variable::make(val.type(), var_name);
             }
-            provides.push_back(Provide::make(name, {val}, args));
+            if (interleaved.contains(op->name)) {
+                vector<Expr> element_args = args;
+                element_args.insert(element_args.begin(), (int)i);
+                provides.push_back(Provide::make(op->name, {val}, element_args));
+            } else {
+                provides.push_back(Provide::make(name, {val}, args));
+            }
         }
 
         Stmt result = Block::make(provides);        
@@ -141,6 +168,8 @@ class SplitTuples : public IRMutator {
     
     const map<string, Function> &env;
     Scope<int> realizations;
+    // The realizations whose tuple elements are stored interleaved.
+    Scope<int> interleaved;
     
 public:
 
@@ -2,8 +2,10 @@
 #include "IRVisitor.h"
 #include "IROperator.h"
 #include "Scope.h"
+#include "Util.h"
 
 #include <iterator>
+#include <map>
 #include <iostream>
 #include <fstream>
 #include <sstream>
@@ -22,6 +24,173 @@ std::string to_string(T value) {
     return os.str() ;
 }
 
+// What a profiler report says about a func, and about the pipeline it
+// belongs to.
+struct FuncProfile {
+    double time_ns = 0, threads = 0;
+    uint64_t memory_peak = 0, num_allocs = 0;
+};
+
+struct PipelineProfile {
+    string name;
+    double time_ns = 0;
+    uint64_t runs = 0;
+    std::map<string, FuncProfile> funcs;
+};
+
+// Reads the JSON profiler report written by
+// halide_profiler_format_report. It only understands as much JSON as
+// that produces, and skips the fields it doesn't use.
+class ProfileParser {
+    const string &filename, &text;
+    size_t pos = 0;
+
+    void skip_whitespace() {
+        while (pos < text.size() && isspace((unsigned char)text[pos])) pos++;
+    }
+
+    bool consume(char c) {
+        skip_whitespace();
+        if (pos < text.size() && text[pos] == c) {
+            pos++;
+            return true;
+        }
+        return false;
+    }
+
+    void expect(char c) {
+        user_assert(consume(c))
+            << "Could not parse profiler report " << filename
+            << ": expected '" << c << "' at offset " << pos << "\n";
+    }
+
+    string parse_string() {
+        expect('"');
+        string result;
+        while (pos < text.size() && text[pos] != '"') {
+            if (text[pos] == '\\' && pos + 1 < text.size()) {
+                pos++;
+            }
+            result += text[pos++];
+        }
+        expect('"');
+        return result;
+    }
+
+    double parse_number() {
+        skip_whitespace();
+        const char *start = text.c_str() + pos;
+        char *end = nullptr;
+        double result = strtod(start, &end);
+        user_assert(end != start)
+            << "Could not parse profiler report " << filename
+            << ": expected a number at offset " << pos << "\n";
+        pos += end - start;
+        return result;
+    }
+
+    void skip_value() {
+        skip_whitespace();
+        if (pos < text.size() && text[pos] == '"') {
+            parse_string();
+        } else if (pos < text.size() && text[pos] == '{') {
+            parse_object([&](const string &) { skip_value(); });
+        } else if (pos < text.size() && text[pos] == '[') {
+            parse_array([&]() { skip_value(); });
+        } else {
+            parse_number();
+        }
+    }
+
+    template<typename F>
+    void parse_object(F field) {
+        expect('{');
+        if (consume('}')) return;
+        do {
+            string key = parse_string();
+            expect(':');
+            field(key);
+        } while (consume(','));
+        expect('}');
+    }
+
+    template<typename F>
+    void parse_array(F element) {
+        expect('[');
+        if (consume(']')) return;
+        do {
+            element();
+        } while (consume(','));
+        expect(']');
+    }
+
+    FuncProfile parse_func(string *name) {
+        FuncProfile f;
+        parse_object([&](const string &key) {
+            if (key == "name") {
+                *name = parse_string();
+            } else if (key == "time_ns") {
+                f.time_ns = parse_number();
+            } else if (key == "average_threads") {
+                f.threads = parse_number();
+            } else if (key == "memory_peak") {
+                f.memory_peak = (uint64_t)parse_number();
+            } else if (key == "num_allocs") {
+                f.num_allocs = (uint64_t)parse_number();
+            } else {
+                skip_value();
+            }
+        });
+        return f;
+    }
+
+    PipelineProfile parse_pipeline() {
+        PipelineProfile p;
+        parse_object([&](const string &key) {
+            if (key == "name") {
+                p.name = parse_string();
+            } else if (key == "time_ns") {
+                p.time_ns = parse_number();
+            } else if (key == "runs") {
+                p.runs = (uint64_t)parse_number();
+            } else if (key == "funcs") {
+                parse_array([&]() {
+                    string name;
+                    FuncProfile f = parse_func(&name);
+                    p.funcs[name] = f;
+                });
+            } else {
+                skip_value();
+            }
+        });
+        return p;
+    }
+
+public:
+    ProfileParser(const string &filename, const string &text) : filename(filename), text(text) {}
+
+    std::vector<PipelineProfile> parse() {
+        std::vector<PipelineProfile> result;
+        parse_object([&](const string &key) {
+            if (key == "pipelines") {
+                parse_array([&]() { result.push_back(parse_pipeline()); });
+            } else {
+                skip_value();
+            }
+        });
+        return result;
+    }
+};
+
+std::vector<PipelineProfile> load_profile(const string &filename) {
+    std::ifstream file(filename.c_str());
+    user_assert(file.is_open()) << "Could not open profiler report " << filename << "\n";
+    std::stringstream text;
+    text << file.rdbuf();
+    string contents = text.str();
+    return ProfileParser(filename, contents).parse();
+}
+
 class StmtToHtml : public IRVisitor {
 
     static const std::string css, js;
@@ -88,6 +257,41 @@ private:
     string open_line() { return "<p class=WrapLine>"; }
     string close_line() { return "</p>"; }
 
+    // The profile of the function being printed, if there's one.
+    std::vector<PipelineProfile> profiles;
+    const PipelineProfile *profile = nullptr;
+    double profile_func_time_ns = 0;
+
+    // A comment with the time and memory a func used, shaded by its
+    // share of the time.
+    string profile_comment(const string &name) {
+        if (!profile || !profile->runs) {
+            return "";
+        }
+        // The profiler names funcs without their tuple or stage
+        // suffixes.
+        auto iter = profile->funcs.find(split_string(name, ".")[0]);
+        if (iter == profile->funcs.end()) {
+            return "";
+        }
+        const FuncProfile &f = iter->second;
+        double percent = profile_func_time_ns > 0 ? 100 * f.time_ns / profile_func_time_ns : 0;
+        std::stringstream s;
+        s << "<span class='Comment Profile' style='background-color: rgba(255, 64, 0, "
+          << percent / 200 << ");'>// "
+          << f.time_ns / (profile->runs * 1000000.0) << "ms/run ("
+          << (int)percent << "%)";
+        if (f.threads > 1) {
+            s << ", " << f.threads << " threads";
+        }
+        if (f.num_allocs) {
+            s << ", " << f.num_allocs / profile->runs << " allocations/run, peak "
+              << f.memory_peak << " bytes";
+        }
+        s << "</span>";
+        return s.str();
+    }
+
     string keyword(const string &x) { return span("Keyword", x); }
     string type(const string &x) { return span("Type", x); }
     string symbol(const string &x) { return span("Symbol", x); }
@@ -330,6 +534,9 @@ private:
         stream << var(op->name);
         stream << close_expand_button() << " {";
         stream << close_span();;
+        if (op->is_producer) {
+            stream << " " << profile_comment(op->name);
+        }
         stream << open_div(op->is_producer ? "ProduceBody Indent" : "ConsumeBody Indent", produce_id);
         print(op->body);
         stream << close_div();
@@ -356,6 +563,8 @@ private:
             stream << keyword("gpu_block");
         } else if (op->for_type == ForType::GPUThread) {
             stream << keyword("gpu_thread");
+        } else if (op->for_type == ForType::GPULane) {
+            stream << keyword("gpu_lane");
         } else {
             internal_assert(false) << "Unknown for type: " << ((int)op->for_type) << "\n";
         }
@@ -542,6 +751,22 @@ private:
         stream << close_div();
     }
 
+    void visit(const Atomic *op) {
+        stream << open_div("Atomic");
+        int id = unique_id();
+        stream << open_span("Matched");
+        stream << open_expand_button(id);
+        stream << keyword("atomic") << " ";
+        stream << var(op->name);
+        stream << close_expand_button() << " {";
+        stream << close_span();
+        stream << open_div("AtomicBody Indent", id);
+        print(op->body);
+        stream << close_div();
+        stream << matched("}");
+        stream << close_div();
+    }
+
 public:
     void print(Expr ir) {
         ir.accept(this);
@@ -552,6 +777,23 @@ public:
     }
 
     void print(const LoweredFunc &op) {
+        // Use the report's pipeline of the same name, or its only one.
+        profile = nullptr;
+        for (const PipelineProfile &p : profiles) {
+            if (p.name == op.name) {
+                profile = &p;
+            }
+        }
+        if (!profile && profiles.size() == 1) {
+            profile = &profiles[0];
+        }
+        profile_func_time_ns = 0;
+        if (profile) {
+            for (const auto &f : profile->funcs) {
+                profile_func_time_ns += f.second.time_ns;
+            }
+        }
+
         scope.push(op.name, unique_id());
         stream << open_div("Function");
 
@@ -570,6 +812,10 @@ public:
         stream << matched(")");
         stream << close_expand_button();
         stream << " " << matched("{");
+        if (profile && profile->runs) {
+            stream << " " << span("Comment Profile", "// " + to_string(profile->time_ns / (profile->runs * 1000000.0)) +
+                                  "ms/run over " + to_string(profile->runs) + " runs");
+        }
         stream << open_div("FunctionBody Indent", id);
         print(op.body);
         stream << close_div();
@@ -585,7 +831,10 @@ public:
         stream << close_div();
     }
 
-    StmtToHtml(string filename) : id_count(0), context_stack(1, 0) {
+    StmtToHtml(string filename, const string &profile_report = "") : id_count(0), context_stack(1, 0) {
+        if (!profile_report.empty()) {
+            profiles = load_profile(profile_report);
+        }
         stream.open(filename.c_str());
         stream << "<head>";
         stream << "<style type='text/css'>" << css << "</style>\n";
@@ -651,8 +900,8 @@ void print_to_html(string filename, Stmt s) {
     sth.print(s);
 }
 
-void print_to_html(string filename, const Module &m) {
-    StmtToHtml sth(filename);
+void print_to_html(string filename, const Module &m, const string &profile_report) {
+    StmtToHtml sth(filename, profile_report);
     for (const auto &b : m.buffers()) {
         sth.print(b);
     }
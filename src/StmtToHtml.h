@@ -15,8 +15,12 @@ namespace Internal {
  */
 EXPORT void print_to_html(std::string filename, Stmt s);
 
-/** Dump an HTML-formatted print of a Module to filename. */
-EXPORT void print_to_html(std::string filename, const Module &m);
+/** Dump an HTML-formatted print of a Module to filename. If
+ * profile_report names a file holding a JSON report from
+ * halide_profiler_format_report, each produce node is annotated with
+ * the time and memory the report says its Func used. */
+EXPORT void print_to_html(std::string filename, const Module &m,
+                          const std::string &profile_report = "");
 
 }}
 
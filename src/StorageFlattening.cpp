@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <sstream>
 
 #include "StorageFlattening.h"
@@ -6,6 +7,8 @@
 #include "Scope.h"
 #include "Bounds.h"
 #include "Parameter.h"
+#include "Simplify.h"
+#include "ExprUsesVar.h"
 
 namespace Halide {
 namespace Internal {
@@ -19,6 +22,103 @@ using std::set;
 
 namespace {
 
+// Count, for each dimension of a Func, how many of the loads and
+// stores of it inside vectorized loops have only that dimension
+// varying with the vector lane.
+class CountVectorAccesses : public IRVisitor {
+    const string &func;
+
+    // The innermost vectorized loop variable, and the variables that
+    // depend on it.
+    string vector_var;
+    Scope<int> varying;
+
+    using IRVisitor::visit;
+
+    void count(const vector<Expr> &args) {
+        if (vector_var.empty()) {
+            return;
+        }
+        int dim = -1;
+        for (size_t i = 0; i < args.size(); i++) {
+            if (expr_uses_vars(args[i], varying)) {
+                if (dim != -1) {
+                    // Varies along more than one dimension.
+                    return;
+                }
+                dim = (int)i;
+            }
+        }
+        if (dim != -1) {
+            votes[dim]++;
+        }
+    }
+
+    template<typename LetOrLetStmt>
+    void visit_let(const LetOrLetStmt *op) {
+        op->value.accept(this);
+        bool v = !vector_var.empty() && expr_uses_vars(op->value, varying);
+        if (v) {
+            varying.push(op->name, 0);
+        }
+        op->body.accept(this);
+        if (v) {
+            varying.pop(op->name);
+        }
+    }
+
+    void visit(const Let *op) {
+        visit_let(op);
+    }
+
+    void visit(const LetStmt *op) {
+        visit_let(op);
+    }
+
+    void visit(const For *op) {
+        op->min.accept(this);
+        op->extent.accept(this);
+        if (op->for_type == ForType::Vectorized) {
+            string old_vector_var = vector_var;
+            Scope<int> old_varying;
+            old_varying.swap(varying);
+            vector_var = op->name;
+            varying.push(op->name, 0);
+            op->body.accept(this);
+            vector_var = old_vector_var;
+            varying.swap(old_varying);
+        } else {
+            op->body.accept(this);
+        }
+    }
+
+    void visit(const Call *op) {
+        IRVisitor::visit(op);
+        if (op->name == func && op->call_type == Call::Halide) {
+            count(op->args);
+        }
+    }
+
+    void visit(const Provide *op) {
+        IRVisitor::visit(op);
+        if (op->name == func) {
+            count(op->args);
+        }
+    }
+
+    void visit(const Variable *op) {
+        if (op->name == func + ".buffer") {
+            uses_buffer = true;
+        }
+    }
+
+public:
+    vector<int> votes;
+    bool uses_buffer = false;
+
+    CountVectorAccesses(const string &f, int dims) : func(f), votes(dims, 0) {}
+};
+
 class FlattenDimensions : public IRMutator {
 public:
     FlattenDimensions(const map<string, pair<Function, int>> &e, const Target &t)
@@ -29,6 +129,35 @@ private:
     const Target &target;
     Scope<int> realizations;
 
+    // Whether we're inside the block loops of a GPU kernel, but
+    // outside the thread loops, i.e. where realizations go in shared
+    // memory.
+    bool in_gpu_blocks = false, in_gpu_threads = false;
+
+    // Shared memory is divided into 32 banks of 4 bytes each, and
+    // the threads of a warp that access different addresses in the
+    // same bank are serialized. If the rows of a shared allocation
+    // are an even number of words, accessing a column (e.g. in a
+    // transpose) hits the same few banks over and over. Return how
+    // many elements to pad the innermost dimension by to make the
+    // rows an odd number of words.
+    Expr shared_memory_padding(const Realize *op, Type t, Expr extent) {
+        if (!in_gpu_blocks || in_gpu_threads || op->bounds.size() < 2 ||
+            t.bytes() > 4) {
+            return Expr();
+        }
+        const int64_t *e = as_const_int(simplify(extent));
+        if (!e) {
+            return Expr();
+        }
+        int64_t row_bytes = *e * t.bytes();
+        // Small rows aren't worth the overhead.
+        if (row_bytes < 64 || row_bytes % 8 != 0) {
+            return Expr();
+        }
+        return 4 / t.bytes();
+    }
+
     Expr flatten_args(const string &name, const vector<Expr> &args) {
         bool internal = realizations.contains(name);
         Expr idx = target.has_feature(Target::LargeBuffers) ? make_zero(Int(64)) : 0;
@@ -101,23 +230,73 @@ private:
         realizations.pop(op->name);
 
         vector<int> storage_permutation;
+        MemoryType memory_type;
+        bool innermost_aligned = false;
         {
             auto iter = env.find(op->name);
-            Function f = iter->second.first;
             internal_assert(iter != env.end()) << "Realize node refers to function not in environment.\n";
+            Function f = iter->second.first;
+            memory_type = f.schedule().memory_type();
             const vector<StorageDim> &storage_dims = f.schedule().storage_dims();
             const vector<string> &args = f.args();
+            // Interleaved tuple elements have an extra innermost
+            // dimension for the tuple index (see split_tuples).
+            int tuple_dims = 0;
+            if (op->bounds.size() == args.size() + 1) {
+                internal_assert(f.schedule().tuple_interleaved());
+                tuple_dims = 1;
+                storage_permutation.push_back(0);
+                // The rows are already interleaved, so don't pad them.
+                innermost_aligned = true;
+            }
             for (size_t i = 0; i < storage_dims.size(); i++) {
                 for (size_t j = 0; j < args.size(); j++) {
                     if (args[j] == storage_dims[i].var) {
-                        storage_permutation.push_back((int)j);
+                        int d = (int)j + tuple_dims;
+                        storage_permutation.push_back(d);
                         Expr alignment = storage_dims[i].alignment;
                         if (alignment.defined()) {
-                            extents[j] = ((extents[j] + alignment - 1)/alignment)*alignment;
+                            extents[d] = ((extents[d] + alignment - 1)/alignment)*alignment;
+                            innermost_aligned |= (i == 0);
                         }
                     }
                 }
-                internal_assert(storage_permutation.size() == i+1);
+                internal_assert(storage_permutation.size() == i+1+tuple_dims);
+            }
+
+            // If the schedule didn't specify a storage order for an
+            // intermediate, and its vectorized loads and stores stride
+            // across some dimension other than the innermost one more
+            // often than not, store that dimension innermost
+            // instead. This turns e.g. the transposed reads of a
+            // separable filter into dense vector loads. Funcs whose
+            // buffer is passed elsewhere, e.g. to an extern stage,
+            // keep the default order.
+            bool aligned = false;
+            for (const StorageDim &d : storage_dims) {
+                aligned |= d.alignment.defined();
+            }
+            if (!f.schedule().storage_order_fixed() && !aligned && tuple_dims == 0 &&
+                !f.schedule().compute_level().is_root() && !f.schedule().memoized() &&
+                storage_permutation.size() > 1) {
+                CountVectorAccesses counter(op->name, (int)storage_permutation.size());
+                op->body.accept(&counter);
+                int innermost = storage_permutation[0];
+                int best = innermost;
+                for (int d : storage_permutation) {
+                    if (counter.votes[d] > counter.votes[best]) {
+                        best = d;
+                    }
+                }
+                if (best != innermost && !counter.uses_buffer) {
+                    debug(3) << "Storing dimension " << best << " of " << op->name
+                             << " innermost, because vector loops stride across it "
+                             << counter.votes[best] << " times, and across dimension "
+                             << innermost << " " << counter.votes[innermost] << " times\n";
+                    storage_permutation.erase(std::find(storage_permutation.begin(),
+                                                        storage_permutation.end(), best));
+                    storage_permutation.insert(storage_permutation.begin(), best);
+                }
             }
         }
 
@@ -126,6 +305,19 @@ private:
         stmt = body;
         internal_assert(op->types.size() == 1);
 
+        // Pad the rows of shared memory to avoid bank conflicts,
+        // unless the schedule asked for a particular alignment.
+        if (!innermost_aligned &&
+            (memory_type == MemoryType::Auto || memory_type == MemoryType::GPUShared)) {
+            int innermost = storage_permutation[0];
+            Expr padding = shared_memory_padding(op, op->types[0], extents[innermost]);
+            if (padding.defined()) {
+                debug(3) << "Padding rows of " << op->name << " by " << padding
+                         << " elements to avoid shared memory bank conflicts\n";
+                extents[innermost] += padding;
+            }
+        }
+
         // Make the names for the mins, extents, and strides
         int dims = op->bounds.size();
         vector<string> min_name(dims), extent_name(dims), stride_name(dims);
@@ -158,7 +350,7 @@ private:
         }
         
         // Make the allocation node
-        stmt = Allocate::make(op->name, op->types[0], extents, condition, stmt);
+        stmt = Allocate::make(op->name, op->types[0], memory_type, extents, condition, stmt);
 
         // Compute the strides
         for (int i = (int)op->bounds.size()-1; i > 0; i--) {
@@ -181,6 +373,17 @@ private:
         }
     }
 
+    void visit(const For *op) {
+        bool old_in_gpu_blocks = in_gpu_blocks;
+        bool old_in_gpu_threads = in_gpu_threads;
+        in_gpu_blocks |= (op->for_type == ForType::GPUBlock);
+        in_gpu_threads |= (op->for_type == ForType::GPUThread ||
+                           op->for_type == ForType::GPULane);
+        IRMutator::visit(op);
+        in_gpu_blocks = old_in_gpu_blocks;
+        in_gpu_threads = old_in_gpu_threads;
+    }
+
     void visit(const Provide *op) {
         internal_assert(op->values.size() == 1);
 
@@ -261,7 +464,7 @@ class PromoteToMemoryType : public IRMutator {
             for (Expr e : op->extents) {
                 extents.push_back(mutate(e));
             }
-            stmt = Allocate::make(op->name, t, extents,
+            stmt = Allocate::make(op->name, t, op->memory_type, extents,
                                   mutate(op->condition), mutate(op->body),
                                   mutate(op->new_expr), op->free_function);
         } else {
@@ -325,7 +528,8 @@ Stmt storage_flattening(Stmt s,
             for (int i = 0; i < p.second.outputs(); i++) {
                 tuple_env[p.first + "." + std::to_string(i)] = {p.second, i};
             }
-        } else {
+        }
+        if (p.second.outputs() == 1 || p.second.schedule().tuple_interleaved()) {
             tuple_env[p.first] = {p.second, 0};
         }
     }
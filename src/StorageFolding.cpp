@@ -50,6 +50,26 @@ int count_producers(Stmt in, const std::string &name) {
     return counter.count;
 }
 
+// Check if a statement computes a particular func.
+class ProvidesFunc : public IRVisitor {
+    const std::string &name;
+
+    void visit(const Provide *op) {
+        if (op->name == name) {
+            result = true;
+        } else {
+            IRVisitor::visit(op);
+        }
+    }
+
+    using IRVisitor::visit;
+
+public:
+    bool result = false;
+
+    ProvidesFunc(const std::string &name) : name(name) {}
+};
+
 // Fold the storage of a function in a particular dimension by a particular factor
 class FoldStorageOfFunction : public IRMutator {
     string func;
@@ -95,8 +115,13 @@ class AttemptStorageFoldingOfFunction : public IRMutator {
     using IRMutator::visit;
 
     void visit(const ProducerConsumer *op) {
-        if (op->name == func.name()) {
-            // Can't proceed into the pipeline for this func
+        ProvidesFunc provides(func.name());
+        if (op->is_producer && op->name != func.name()) {
+            op->body.accept(&provides);
+        }
+        if (op->name == func.name() || provides.result) {
+            // Can't proceed into the pipeline for this func, or into
+            // the pipeline of a func it is computed with.
             stmt = op;
         } else {
             IRMutator::visit(op);
@@ -179,6 +204,17 @@ class AttemptStorageFoldingOfFunction : public IRMutator {
             // variable, and should depend on the loop variable.
             if (min_monotonic_increasing || max_monotonic_decreasing) {
                 Expr extent = simplify(max - min + 1);
+                if (func.schedule().async()) {
+                    // The producer of an async Func runs up to one
+                    // iteration ahead of its consumer, so the fold
+                    // must hold two consecutive iterations at once.
+                    Expr next_var = Variable::make(Int(32), op->name) + 1;
+                    if (min_monotonic_increasing) {
+                        extent = simplify(substitute(op->name, next_var, max) - min + 1);
+                    } else {
+                        extent = simplify(max - substitute(op->name, next_var, min) + 1);
+                    }
+                }
                 Expr factor;
                 if (explicit_factor.defined()) {
                     Expr error = Call::make(Int(32), "halide_error_fold_factor_too_small",
@@ -239,8 +275,11 @@ class AttemptStorageFoldingOfFunction : public IRMutator {
 
         // If there's no communication of values from one loop
         // iteration to the next (which may happen due to sliding),
-        // then we're safe to fold an inner loop.
-        if (box_contains(provided, required)) {
+        // then we're safe to fold an inner loop. Not for async Funcs
+        // though: their producer may be at the start of the next
+        // iteration of this loop while the consumer is still at
+        // the end of the current one.
+        if (!func.schedule().async() && box_contains(provided, required)) {
             body = mutate(body);
         }
 
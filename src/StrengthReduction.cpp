@@ -0,0 +1,252 @@
+#include "StrengthReduction.h"
+#include "CodeGen_GPU_Dev.h"
+#include "ExprUsesVar.h"
+#include "IREquality.h"
+#include "IRMutator.h"
+#include "IROperator.h"
+#include "Scope.h"
+#include "Simplify.h"
+#include "Substitute.h"
+
+namespace Halide {
+namespace Internal {
+
+using std::pair;
+using std::string;
+using std::vector;
+
+namespace {
+
+/** If an integer expression varies linearly with the variables in
+ * the scope, return the linear term. Otherwise (including for
+ * anything that isn't pure integer arithmetic) return an undefined
+ * Expr. */
+Expr linear_step(Expr e, const Scope<Expr> &linear) {
+    if (e.type() != Int(32)) {
+        return Expr();
+    }
+    if (const Variable *v = e.as<Variable>()) {
+        if (linear.contains(v->name)) {
+            return linear.get(v->name);
+        } else {
+            return make_zero(v->type);
+        }
+    } else if (const IntImm *op = e.as<IntImm>()) {
+        return make_zero(op->type);
+    } else if (const Add *add = e.as<Add>()) {
+        Expr la = linear_step(add->a, linear);
+        Expr lb = linear_step(add->b, linear);
+        if (!la.defined() || !lb.defined()) {
+            return Expr();
+        } else if (is_zero(lb)) {
+            return la;
+        } else if (is_zero(la)) {
+            return lb;
+        } else {
+            return la + lb;
+        }
+    } else if (const Sub *sub = e.as<Sub>()) {
+        Expr la = linear_step(sub->a, linear);
+        Expr lb = linear_step(sub->b, linear);
+        if (!la.defined() || !lb.defined()) {
+            return Expr();
+        } else if (is_zero(lb)) {
+            return la;
+        } else {
+            return la - lb;
+        }
+    } else if (const Mul *mul = e.as<Mul>()) {
+        Expr la = linear_step(mul->a, linear);
+        Expr lb = linear_step(mul->b, linear);
+        if (!la.defined() || !lb.defined()) {
+            return Expr();
+        } else if (is_zero(la) && is_zero(lb)) {
+            return la;
+        } else if (is_zero(la)) {
+            return mul->a * lb;
+        } else if (is_zero(lb)) {
+            return la * mul->b;
+        } else {
+            return Expr();
+        }
+    } else {
+        return Expr();
+    }
+}
+
+/** Replace the products in the body of a single loop that step by a
+ * symbolic amount each iteration with loads of scratch values. */
+class StrengthReduceLoop : public IRMutator {
+    // The step of each variable defined inside the loop, with respect
+    // to the loop variable. Undefined for variables that don't vary
+    // linearly.
+    Scope<Expr> linear;
+    vector<pair<string, Expr>> containing_lets;
+
+    using IRMutator::visit;
+
+    bool invariant(Expr e) {
+        return !expr_uses_vars(e, linear);
+    }
+
+    void visit(const Mul *op) {
+        if (op->type != Int(32) || is_const(op->a) || is_const(op->b)) {
+            IRMutator::visit(op);
+            return;
+        }
+
+        Expr la = linear_step(op->a, linear);
+        Expr lb = linear_step(op->b, linear);
+        Expr step;
+        if (la.defined() && !is_zero(la) && invariant(la) &&
+            lb.defined() && invariant(op->b)) {
+            step = la * op->b;
+        } else if (lb.defined() && !is_zero(lb) && invariant(lb) &&
+                   la.defined() && invariant(op->a)) {
+            step = op->a * lb;
+        } else {
+            IRMutator::visit(op);
+            return;
+        }
+
+        for (const InductionVariable &iv : ivs) {
+            if (equal(iv.value, op)) {
+                expr = iv.load();
+                return;
+            }
+        }
+
+        // The initial value needs any lets in the loop body that
+        // the product uses.
+        Expr initial = op;
+        for (size_t i = containing_lets.size(); i > 0; i--) {
+            const auto &l = containing_lets[i-1];
+            if (expr_uses_var(initial, l.first)) {
+                initial = Let::make(l.first, l.second, initial);
+            }
+        }
+        InductionVariable iv = {unique_name('s'), op, initial, step};
+        ivs.push_back(iv);
+        expr = iv.load();
+    }
+
+    template<typename LetOrLetStmt, typename Body>
+    Body visit_let(const LetOrLetStmt *op, Body body) {
+        Expr value = mutate(op->value);
+        linear.push(op->name, linear_step(op->value, linear));
+        containing_lets.push_back({op->name, op->value});
+        Body new_body = mutate(body);
+        containing_lets.pop_back();
+        linear.pop(op->name);
+        if (value.same_as(op->value) && new_body.same_as(body)) {
+            return op;
+        }
+        return LetOrLetStmt::make(op->name, value, new_body);
+    }
+
+    void visit(const Let *op) {
+        expr = visit_let(op, op->body);
+    }
+
+    void visit(const LetStmt *op) {
+        stmt = visit_let(op, op->body);
+    }
+
+    void visit(const For *op) {
+        if (op->for_type != ForType::Serial) {
+            // Leave parallel loops and GPU kernels alone. Their
+            // bodies don't run in order.
+            stmt = op;
+            return;
+        }
+        // Inner loop variables aren't linear in the outer one.
+        Expr min = mutate(op->min);
+        Expr extent = mutate(op->extent);
+        linear.push(op->name, Expr());
+        Stmt body = mutate(op->body);
+        linear.pop(op->name);
+        if (min.same_as(op->min) && extent.same_as(op->extent) && body.same_as(op->body)) {
+            stmt = op;
+        } else {
+            stmt = For::make(op->name, min, extent, op->for_type, op->device_api, body);
+        }
+    }
+
+public:
+    StrengthReduceLoop(const string &var) {
+        linear.push(var, 1);
+    }
+
+    struct InductionVariable {
+        string name;
+        // The product the variable replaces, and its value on the
+        // first iteration, in terms of the loop variable.
+        Expr value, initial;
+        Expr step;
+
+        Expr load() const {
+            return Load::make(Int(32), name, 0, Buffer<>(), Parameter());
+        }
+    };
+
+    vector<InductionVariable> ivs;
+};
+
+class StrengthReduce : public IRMutator {
+    using IRMutator::visit;
+
+    void visit(const For *op) {
+        if (CodeGen_GPU_Dev::is_gpu_var(op->name)) {
+            stmt = op;
+            return;
+        }
+
+        Stmt body = mutate(op->body);
+        // Loops that get offloaded to other devices can't see the
+        // scratch values.
+        bool offloaded = (op->device_api != DeviceAPI::None &&
+                          op->device_api != DeviceAPI::Host);
+        if (op->for_type != ForType::Serial || is_one(op->extent) ||
+            offloaded || op->min.type() != Int(32)) {
+            if (body.same_as(op->body)) {
+                stmt = op;
+            } else {
+                stmt = For::make(op->name, op->min, op->extent, op->for_type, op->device_api, body);
+            }
+            return;
+        }
+
+        StrengthReduceLoop reduce(op->name);
+        body = reduce.mutate(body);
+
+        // Step the induction variables at the end of each iteration.
+        vector<Stmt> steps;
+        for (const auto &iv : reduce.ivs) {
+            steps.push_back(Store::make(iv.name, iv.load() + iv.step, 0, Parameter()));
+        }
+        if (!steps.empty()) {
+            body = Block::make(body, Block::make(steps));
+        }
+
+        if (body.same_as(op->body)) {
+            stmt = op;
+        } else {
+            stmt = For::make(op->name, op->min, op->extent, op->for_type, op->device_api, body);
+        }
+
+        for (const auto &iv : reduce.ivs) {
+            Expr initial = simplify(substitute(op->name, op->min, iv.initial));
+            stmt = Block::make(Store::make(iv.name, initial, 0, Parameter()), stmt);
+            stmt = Allocate::make(iv.name, Int(32), MemoryType::Stack, {1}, const_true(), stmt);
+        }
+    }
+};
+
+}
+
+Stmt strength_reduce(Stmt s) {
+    return StrengthReduce().mutate(s);
+}
+
+}
+}
@@ -0,0 +1,28 @@
+#ifndef HALIDE_STRENGTH_REDUCTION_H
+#define HALIDE_STRENGTH_REDUCTION_H
+
+/** \file
+ * Defines a lowering pass that replaces multiplications by symbolic
+ * strides with induction variables.
+ */
+
+#include "Expr.h"
+
+namespace Halide {
+namespace Internal {
+
+/** Flattened indices multiply loop variables by the (symbolic)
+ * strides of their buffers on every iteration. Replace each such
+ * product in a serial loop with a scratch value that is initialized
+ * before the loop and incremented by the stride at the end of each
+ * iteration. Once LLVM promotes the scratch values to registers,
+ * they're induction variables, and the multiplies are gone from the
+ * loop. Only touches products of pure integer arithmetic, so
+ * nothing unsafe is hoisted out of the loop, and leaves GPU kernels
+ * and parallel loops alone. */
+Stmt strength_reduce(Stmt s);
+
+}
+}
+
+#endif
@@ -0,0 +1,211 @@
+#include <cmath>
+
+#include "Tabulate.h"
+#include "Bounds.h"
+#include "IROperator.h"
+#include "Scope.h"
+#include "Simplify.h"
+
+namespace Halide {
+
+using std::vector;
+
+using namespace Internal;
+
+namespace {
+
+// The largest lookup table we're willing to make.
+const int64_t max_table_size = 1 << 16;
+
+// The tables of polynomial coefficients we'd like to fit in L1, and
+// the largest ones we're willing to make.
+const int small_coefficient_count = 1024;
+const int max_coefficient_count = 16384;
+const int max_degree = 8;
+
+// The number of points per segment at which we measure the error of
+// an approximation.
+const int samples_per_segment = 64;
+
+bool const_bound(Expr e, int64_t *result) {
+    e = simplify(e);
+    if (const int64_t *i = as_const_int(e)) {
+        *result = *i;
+        return true;
+    } else if (const uint64_t *u = as_const_uint(e)) {
+        if (*u <= (uint64_t)max_table_size) {
+            *result = (int64_t)*u;
+            return true;
+        }
+    }
+    return false;
+}
+
+// The coefficients, lowest degree first, of the polynomial in u in
+// [-1, 1] that interpolates f on [lo, hi], at the Chebyshev nodes.
+vector<double> chebyshev_fit(const std::function<double(double)> &f,
+                             double lo, double hi, int degree) {
+    const double pi = 3.14159265358979323846;
+    int n = degree + 1;
+    vector<double> values(n);
+    for (int j = 0; j < n; j++) {
+        double u = std::cos(pi * (j + 0.5) / n);
+        values[j] = f(lo + (u + 1) * 0.5 * (hi - lo));
+    }
+
+    // The coefficients of the Chebyshev series.
+    vector<double> series(n);
+    for (int k = 0; k < n; k++) {
+        double sum = 0;
+        for (int j = 0; j < n; j++) {
+            sum += values[j] * std::cos(pi * k * (j + 0.5) / n);
+        }
+        series[k] = sum * 2 / n;
+    }
+    series[0] /= 2;
+
+    // Convert to monomials, using T_{k+1}(u) = 2 u T_k(u) - T_{k-1}(u).
+    vector<double> result(n, 0), t_prev(n, 0), t_cur(n, 0);
+    t_prev[0] = 1;
+    result[0] = series[0];
+    if (n > 1) {
+        t_cur[1] = 1;
+        result[1] = series[1];
+    }
+    for (int k = 2; k < n; k++) {
+        vector<double> t_next(n, 0);
+        for (int i = 0; i < n; i++) {
+            t_next[i] = (i > 0 ? 2 * t_cur[i - 1] : 0) - t_prev[i];
+            result[i] += series[k] * t_next[i];
+        }
+        t_prev.swap(t_cur);
+        t_cur.swap(t_next);
+    }
+    return result;
+}
+
+// Evaluate a polynomial in float, the way the generated code will.
+float horner(const float *coeffs, int degree, float u) {
+    float result = coeffs[degree];
+    for (int k = degree - 1; k >= 0; k--) {
+        result = result * u + coeffs[k];
+    }
+    return result;
+}
+
+// Fit a piecewise polynomial with the given number of segments and
+// degree into coeffs. Returns whether the error is within tolerance.
+bool fit_segments(const std::function<double(double)> &f, double min, double max,
+                  double tolerance, int segments, int degree, vector<float> &coeffs) {
+    coeffs.resize((size_t)segments * (degree + 1));
+    float fmin = (float)min;
+    float scale = (float)(segments / (max - min));
+    for (int s = 0; s < segments; s++) {
+        double lo = min + (max - min) * s / segments;
+        double hi = min + (max - min) * (s + 1) / segments;
+        vector<double> c = chebyshev_fit(f, lo, hi, degree);
+        float *dst = &coeffs[(size_t)s * (degree + 1)];
+        for (int k = 0; k <= degree; k++) {
+            dst[k] = (float)c[k];
+        }
+
+        for (int j = 0; j <= samples_per_segment; j++) {
+            double x = lo + (hi - lo) * j / samples_per_segment;
+            // Find the segment and local coordinate as the generated
+            // code would. Rounding may put x in a neighboring segment.
+            float pos = ((float)x - fmin) * scale;
+            int seg = std::min(std::max((int)pos, 0), segments - 1);
+            if (seg > s) continue;
+            float u = (pos - (float)seg) * 2.0f - 1.0f;
+            float approx = horner(&coeffs[(size_t)seg * (degree + 1)], degree, u);
+            if (!(std::abs(approx - f(x)) <= tolerance)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+}  // namespace
+
+Expr lookup_table(Expr x, std::function<Expr(Expr)> f) {
+    user_assert(x.defined()) << "lookup_table of undefined Expr\n";
+    Interval bounds = bounds_of_expr_in_scope(x, Scope<Interval>());
+    int64_t min = 0, max = 0;
+    user_assert(bounds.is_bounded() &&
+                const_bound(bounds.min, &min) &&
+                const_bound(bounds.max, &max))
+        << "Could not find a constant range for the argument of lookup_table: " << x << "\n"
+        << "Pass the range explicitly.\n";
+    user_assert(max - min < max_table_size)
+        << "The argument of lookup_table: " << x << "\n"
+        << "has range [" << min << ", " << max << "], which is too large for a lookup table.\n";
+    return lookup_table(x, f, (int)min, (int)max);
+}
+
+Expr lookup_table(Expr x, std::function<Expr(Expr)> f, int min, int max) {
+    user_assert(x.defined()) << "lookup_table of undefined Expr\n";
+    user_assert(x.type().is_int() || x.type().is_uint())
+        << "The argument of lookup_table must be an integer: " << x << "\n";
+    user_assert(min <= max && (int64_t)max - min < max_table_size)
+        << "Bad range [" << min << ", " << max << "] for lookup_table argument " << x << "\n";
+
+    Type t = x.type().element_of();
+    Func table("lookup_table" + unique_name('_'));
+    Var i;
+    table(i) = f(cast(t, i + min));
+    table.compute_root();
+
+    Expr index = cast<int>(clamp(x, make_const(t, min), make_const(t, max))) - min;
+    return table(index);
+}
+
+Expr piecewise_polynomial(Expr x, std::function<double(double)> f,
+                          double min, double max, double tolerance) {
+    user_assert(x.defined()) << "piecewise_polynomial of undefined Expr\n";
+    user_assert(min < max) << "Bad range [" << min << ", " << max << "] for piecewise_polynomial\n";
+    user_assert(tolerance > 0) << "piecewise_polynomial tolerance must be positive\n";
+
+    // Use the lowest degree that meets the tolerance with a small
+    // table. Failing that, the lowest degree that meets it at all.
+    vector<float> coeffs;
+    int segments = 0, degree = 0;
+    for (int limit : {small_coefficient_count, max_coefficient_count}) {
+        for (int d = 1; d <= max_degree && !segments; d++) {
+            for (int s = 1; s * (d + 1) <= limit; s *= 2) {
+                if (fit_segments(f, min, max, tolerance, s, d, coeffs)) {
+                    segments = s;
+                    degree = d;
+                    break;
+                }
+            }
+        }
+        if (segments) break;
+    }
+    user_assert(segments)
+        << "Could not approximate a function on [" << min << ", " << max << "] "
+        << "to within " << tolerance << " with a piecewise polynomial of degree at most "
+        << max_degree << " and at most " << max_coefficient_count << " coefficients\n";
+
+    debug(2) << "piecewise_polynomial using " << segments
+             << " segments of degree " << degree << "\n";
+
+    Buffer<float> table(degree + 1, segments, unique_name("piecewise_polynomial"));
+    for (int s = 0; s < segments; s++) {
+        for (int k = 0; k <= degree; k++) {
+            table(k, s) = coeffs[(size_t)s * (degree + 1) + k];
+        }
+    }
+
+    Expr pos = (clamp(cast<float>(x), (float)min, (float)max) - (float)min) *
+        (float)(segments / (max - min));
+    Expr seg = clamp(cast<int>(pos), 0, segments - 1);
+    Expr u = (pos - cast<float>(seg)) * 2.0f - 1.0f;
+    Expr result = table(degree, seg);
+    for (int k = degree - 1; k >= 0; k--) {
+        result = result * u + table(k, seg);
+    }
+    return result;
+}
+
+}
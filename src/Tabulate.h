@@ -0,0 +1,52 @@
+#ifndef HALIDE_TABULATE_H
+#define HALIDE_TABULATE_H
+
+/** \file
+ * Support for replacing expensive unary functions of a bounded input
+ * with lookup tables and piecewise polynomials.
+ */
+
+#include <functional>
+
+#include "Func.h"
+#include "IR.h"
+#include "Util.h"
+
+namespace Halide {
+
+/** Replace f(x), for an integer x, with a lookup into a table of f
+ * evaluated at every value x can take. The table is a Func computed
+ * at root. The range of x is the one given, or in the first form, the
+ * range bounds inference can prove for x (e.g. the range of its type,
+ * if it is a load of an 8 or 16-bit image). Values of x outside the
+ * range are clamped to it. This makes tone curves and other
+ * per-value stages of narrow integer inputs about as cheap as a
+ * gather. For example:
+ \code
+ Func curved;
+ curved(x, y) = lookup_table(input(x, y), [](Expr v) {
+     return cast<uint8_t>(pow(cast<float>(v) / 255, 1 / 2.2f) * 255 + 0.5f);
+ });
+ \endcode
+ */
+// @{
+EXPORT Expr lookup_table(Expr x, std::function<Expr(Expr)> f);
+EXPORT Expr lookup_table(Expr x, std::function<Expr(Expr)> f, int min, int max);
+// @}
+
+/** Replace f(x), for x in [min, max], with a piecewise polynomial
+ * approximation whose absolute error is at most tolerance. f is
+ * evaluated on the host, in double precision, while building the
+ * approximation. The range is divided into equal segments, and on
+ * each one f is interpolated at the Chebyshev nodes, which is close
+ * to the minimax polynomial. The lowest degree whose table of
+ * coefficients stays small is used. x is clamped to [min, max], and
+ * the result is a float evaluated with one gather per coefficient
+ * and Horner's rule. It is an error if no small enough approximation
+ * meets the tolerance. */
+EXPORT Expr piecewise_polynomial(Expr x, std::function<double(double)> f,
+                                 double min, double max, double tolerance);
+
+}
+
+#endif
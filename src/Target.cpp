@@ -7,10 +7,20 @@
 #include "LLVM_Headers.h"
 #include "Util.h"
 
-#if defined(__powerpc__) && defined(__linux__)
+#if (defined(__powerpc__) || defined(__mips__) || defined(__aarch64__)) && defined(__linux__)
 // This uses elf.h and must be included after "LLVM_Headers.h", which
 // uses llvm/support/Elf.h.
 #include <sys/auxv.h>
+// Older C libraries don't know about POWER9.
+#ifndef PPC_FEATURE2_ARCH_3_00
+#define PPC_FEATURE2_ARCH_3_00 0x00800000
+#endif
+#ifndef HWCAP_MIPS_MSA
+#define HWCAP_MIPS_MSA (1 << 1)
+#endif
+#ifndef HWCAP_SVE
+#define HWCAP_SVE (1 << 22)
+#endif
 #endif
 
 namespace Halide {
@@ -68,11 +78,25 @@ Target calculate_host_target() {
 
 #if __mips__ || __mips || __MIPS__
     Target::Arch arch = Target::MIPS;
-    return Target(os, arch, bits);
+
+    std::vector<Target::Feature> initial_features;
+#ifdef __linux__
+    unsigned long hwcap = getauxval(AT_HWCAP);
+    if (hwcap & HWCAP_MIPS_MSA) initial_features.push_back(Target::MSA);
+#endif
+
+    return Target(os, arch, bits, initial_features);
 #else
 #if defined(__arm__) || defined(__aarch64__)
     Target::Arch arch = Target::ARM;
-    return Target(os, arch, bits);
+
+    std::vector<Target::Feature> initial_features;
+#if defined(__aarch64__) && defined(__linux__)
+    unsigned long hwcap = getauxval(AT_HWCAP);
+    if (hwcap & HWCAP_SVE) initial_features.push_back(Target::ARMSVE);
+#endif
+
+    return Target(os, arch, bits, initial_features);
 #else
 #if defined(__powerpc__) && defined(__linux__)
     Target::Arch arch = Target::POWERPC;
@@ -82,6 +106,7 @@ Target calculate_host_target() {
     bool have_altivec = (hwcap & PPC_FEATURE_HAS_ALTIVEC) != 0;
     bool have_vsx     = (hwcap & PPC_FEATURE_HAS_VSX) != 0;
     bool arch_2_07    = (hwcap2 & PPC_FEATURE2_ARCH_2_07) != 0;
+    bool arch_3_00    = (hwcap2 & PPC_FEATURE2_ARCH_3_00) != 0;
 
     user_assert(have_altivec)
         << "The POWERPC backend assumes at least AltiVec support. This machine does not appear to have AltiVec.\n";
@@ -89,6 +114,7 @@ Target calculate_host_target() {
     std::vector<Target::Feature> initial_features;
     if (have_vsx)     initial_features.push_back(Target::VSX);
     if (arch_2_07)    initial_features.push_back(Target::POWER_ARCH_2_07);
+    if (arch_3_00)    initial_features.push_back(Target::POWER_ARCH_3_00);
 
     return Target(os, arch, bits, initial_features);
 #else
@@ -276,6 +302,28 @@ const std::map<std::string, Target::Feature> feature_name_map = {
     {"avx512_knl", Target::AVX512_KNL},
     {"avx512_skylake", Target::AVX512_Skylake},
     {"avx512_cannonlake", Target::AVX512_Cannonlake},
+    {"large_stack", Target::LargeStack},
+    {"profile_counters", Target::ProfileCounters},
+    {"arm_dot_prod", Target::ARMDotProd},
+    {"arm_fp16", Target::ARMFp16},
+    {"pgo_instrument", Target::PGOInstrument},
+    {"power_arch_3_00", Target::POWER_ARCH_3_00},
+    {"msa", Target::MSA},
+    {"hexagon_async", Target::HexagonAsync},
+    {"cuda_capability_61", Target::CUDACapability61},
+    {"cuda_capability_70", Target::CUDACapability70},
+    {"specialize_strides", Target::SpecializeStrides},
+    {"precheck", Target::Precheck},
+    {"cancellable", Target::Cancellable},
+    {"minimal_runtime", Target::MinimalRuntime},
+    {"fast_math", Target::FastMath},
+    {"arm_sve", Target::ARMSVE},
+    {"small_code", Target::SmallCode},
+    {"llvm_opt_1", Target::LLVMOpt1},
+    {"llvm_opt_2", Target::LLVMOpt2},
+    {"no_llvm_loop_vectorize", Target::NoLLVMLoopVectorize},
+    {"no_llvm_slp_vectorize", Target::NoLLVMSLPVectorize},
+    {"no_llvm_unroll", Target::NoLLVMUnroll},
 };
 
 bool lookup_feature(const std::string &tok, Target::Feature &result) {
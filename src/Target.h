@@ -78,6 +78,28 @@ struct Target {
         AVX512_KNL = halide_target_feature_avx512_knl,
         AVX512_Skylake = halide_target_feature_avx512_skylake,
         AVX512_Cannonlake = halide_target_feature_avx512_cannonlake,
+        LargeStack = halide_target_feature_large_stack,
+        ProfileCounters = halide_target_feature_profile_counters,
+        ARMDotProd = halide_target_feature_arm_dot_prod,
+        ARMFp16 = halide_target_feature_arm_fp16,
+        PGOInstrument = halide_target_feature_pgo_instrument,
+        POWER_ARCH_3_00 = halide_target_feature_power_arch_3_00,
+        MSA = halide_target_feature_msa,
+        HexagonAsync = halide_target_feature_hexagon_async,
+        CUDACapability61 = halide_target_feature_cuda_capability61,
+        CUDACapability70 = halide_target_feature_cuda_capability70,
+        SpecializeStrides = halide_target_feature_specialize_strides,
+        Precheck = halide_target_feature_precheck,
+        Cancellable = halide_target_feature_cancellable,
+        MinimalRuntime = halide_target_feature_minimal_runtime,
+        FastMath = halide_target_feature_fast_math,
+        ARMSVE = halide_target_feature_arm_sve,
+        SmallCode = halide_target_feature_small_code,
+        LLVMOpt1 = halide_target_feature_llvm_opt_1,
+        LLVMOpt2 = halide_target_feature_llvm_opt_2,
+        NoLLVMLoopVectorize = halide_target_feature_no_llvm_loop_vectorize,
+        NoLLVMSLPVectorize = halide_target_feature_no_llvm_slp_vectorize,
+        NoLLVMUnroll = halide_target_feature_no_llvm_unroll,
         FeatureEnd = halide_target_feature_end
     };
     Target() : os(OSUnknown), arch(ArchUnknown), bits(0) {}
@@ -42,6 +42,45 @@ struct TraceEventBuilder {
     }
 };
 
+// The condition under which a load from or store to the given
+// coordinates of f should be traced, or an undefined Expr if they
+// all should be.
+Expr trace_filter(const Function &f, const vector<Expr> &coordinates) {
+    Expr cond;
+    const vector<Expr> &region = f.tracing_region();
+    for (size_t i = 0; 2 * i + 1 < region.size() && i < coordinates.size(); i++) {
+        Expr min = region[2 * i], extent = region[2 * i + 1];
+        if (!min.defined()) continue;
+        Expr c = coordinates[i];
+        Expr inside = (c >= min) && (c < min + extent);
+        cond = cond.defined() ? (cond && inside) : inside;
+    }
+
+    int n = f.tracing_sample_rate();
+    if (n > 1) {
+        // Hash the coordinates, so that which points get traced
+        // doesn't depend on the order they're computed in.
+        Expr h = make_const(UInt(32), 0);
+        for (Expr c : coordinates) {
+            h = (h + cast<uint32_t>(c)) * make_const(UInt(32), 0x9E3779B1);
+            h = h ^ (h >> 16);
+        }
+        Expr sampled = (h % make_const(UInt(32), n)) == 0;
+        cond = cond.defined() ? (cond && sampled) : sampled;
+    }
+    return cond;
+}
+
+// Only make the trace call if the filter passes. Vectorization
+// reduces a vector condition to whether any lane passes, so that a
+// vector still makes a single trace call.
+Expr filter_trace(Expr trace, Expr cond) {
+    if (!cond.defined()) {
+        return trace;
+    }
+    return Call::make(Int(32), Call::if_then_else, {cond, trace, 0}, Call::PureIntrinsic);
+}
+
 class InjectTracing : public IRMutator {
 public:
     const map<string, Function> &env;
@@ -54,6 +93,9 @@ public:
 private:
     using IRMutator::visit;
 
+    // The Func whose produce node we're inside, if any.
+    string producing;
+
     void visit(const Call *op) {
 
         // Calls inside of an address_of don't count, but we want to
@@ -102,13 +144,14 @@ private:
         internal_assert(op);
 
         bool trace_it = false;
-        Expr trace_parent;
+        Expr trace_parent, trace_cond;
         if (op->call_type == Call::Halide) {
             Function f = env.find(op->name)->second;
             internal_assert(!f.can_be_inlined() || !f.schedule().compute_level().is_inline());
 
             trace_it = f.is_tracing_loads() || (global_level > 2);
             trace_parent = Variable::make(Int(32), op->name + ".trace_id");
+            trace_cond = trace_filter(f, op->args);
         } else if (op->call_type == Call::Image) {
             trace_it = global_level > 2;
             trace_parent = Variable::make(Int(32), "pipeline.trace_id");
@@ -126,7 +169,7 @@ private:
             builder.event = halide_trace_load;
             builder.parent_id = trace_parent;
             builder.value_index = op->value_index;
-            Expr trace = builder.build();
+            Expr trace = filter_trace(builder.build(), trace_cond);
 
             expr = Let::make(value_var_name, op,
                              Call::make(op->type, Call::return_second,
@@ -156,6 +199,7 @@ private:
             builder.coordinates = op->args;
             builder.event = halide_trace_store;
             builder.parent_id = Variable::make(Int(32), op->name + ".trace_id");
+            Expr trace_cond = trace_filter(f, op->args);
             for (size_t i = 0; i < values.size(); i++) {
                 Type t = values[i].type();
                 string value_var_name = unique_name('t');
@@ -164,7 +208,7 @@ private:
                 builder.type = t;
                 builder.value_index = (int)i;
                 builder.value = {value_var};
-                Expr trace = builder.build();
+                Expr trace = filter_trace(builder.build(), trace_cond);
 
                 traces[i] = Let::make(value_var_name, values[i],
                                       Call::make(t, Call::return_second,
@@ -213,8 +257,38 @@ private:
 
     }
 
+    void visit(const For *op) {
+        IRMutator::visit(op);
+        if (op->for_type != ForType::Parallel || producing.empty()) return;
+        op = stmt.as<For>();
+        internal_assert(op);
+
+        Function f = env.find(producing)->second;
+        if (f.is_tracing_realizations() || global_level > 0) {
+            // Throw a tracing call around each parallel task, so that
+            // a timeline shows which thread ran it and when.
+            TraceEventBuilder builder;
+            builder.func = op->name;
+            builder.parent_id = Variable::make(Int(32), producing + ".trace_id");
+            builder.coordinates = {Variable::make(Int(32), op->name)};
+
+            builder.event = halide_trace_begin_task;
+            Stmt begin = Evaluate::make(builder.build());
+            builder.event = halide_trace_end_task;
+            Stmt end = Evaluate::make(builder.build());
+
+            Stmt new_body = Block::make(begin, Block::make(op->body, end));
+            stmt = For::make(op->name, op->min, op->extent, op->for_type, op->device_api, new_body);
+        }
+    }
+
     void visit(const ProducerConsumer *op) {
+        string old_producing = producing;
+        if (op->is_producer && env.count(op->name)) {
+            producing = op->name;
+        }
         IRMutator::visit(op);
+        producing = old_producing;
         op = stmt.as<ProducerConsumer>();
         internal_assert(op);
         map<string, Function>::const_iterator iter = env.find(op->name);
@@ -12,6 +12,11 @@
 namespace Halide {
 namespace Internal {
 
+/** The level of tracing of all Funcs requested with the HL_TRACE
+ * environment variable: 1 traces realizations, 2 also traces stores,
+ * and 3 also traces loads. */
+int tracing_level();
+
 /** Take a statement representing a halide pipeline, inject calls to
  * tracing functions at interesting points, such as
  * allocations. Should be done before storage flattening, but after
@@ -1,46 +1,246 @@
 #include "UnrollLoops.h"
+#include "CodeSize.h"
+#include "ExprUsesVar.h"
 #include "IRMutator.h"
 #include "IROperator.h"
+#include "IRVisitor.h"
+#include "Monotonic.h"
 #include "Simplify.h"
 #include "Substitute.h"
 
+using std::map;
+using std::set;
+using std::string;
 using std::vector;
 
 namespace Halide {
 namespace Internal {
 
+namespace {
+
+// Find how much unrolling each loop marked for unrolling would grow
+// the code, assuming the unrolled loops inside it are unrolled too.
+class FindUnrollGrowth : public IRVisitor {
+    using IRVisitor::visit;
+
+    double trip_count = 1;
+
+    void visit(const For *for_loop) {
+        double old_trip_count = trip_count;
+        trip_count *= CodeSizeBudget::trip_count(for_loop->extent);
+        if (for_loop->for_type == ForType::Unrolled) {
+            const int64_t *e = as_const_int(simplify(for_loop->extent));
+            if (e && *e > 1) {
+                FindUnrollGrowth inner;
+                inner.trip_count = trip_count;
+                for_loop->body.accept(&inner);
+                int64_t body_size = code_size(for_loop->body) + inner.total_growth;
+                growths.push_back({for_loop->name, (*e - 1) * body_size, trip_count});
+                growths.insert(growths.end(), inner.growths.begin(), inner.growths.end());
+                total_growth += (*e - 1) * body_size + inner.total_growth;
+                trip_count = old_trip_count;
+                return;
+            }
+        }
+        IRVisitor::visit(for_loop);
+        trip_count = old_trip_count;
+    }
+
+public:
+    vector<CodeSizeBudget::Growth> growths;
+    int64_t total_growth = 0;
+};
+
+// Check if a condition holds for every iteration of a loop of which
+// it holds for the last one: if it is a < b or a <= b, or a
+// conjunction of them, where b - a doesn't increase with the loop var.
+bool holds_before(Expr cond, const string &var) {
+    if (const And *a = cond.as<And>()) {
+        return holds_before(a->a, var) && holds_before(a->b, var);
+    }
+    Expr slack;
+    if (const LT *lt = cond.as<LT>()) {
+        slack = lt->b - lt->a;
+    } else if (const LE *le = cond.as<LE>()) {
+        slack = le->b - le->a;
+    } else {
+        return false;
+    }
+    Monotonic m = is_monotonic(slack, var);
+    return m == Monotonic::Constant || m == Monotonic::Decreasing;
+}
+
+class ContainsLoadOrImpureCall : public IRVisitor {
+    using IRVisitor::visit;
+
+    void visit(const Load *op) {
+        result = true;
+    }
+
+    void visit(const Call *op) {
+        if (!op->is_pure()) {
+            result = true;
+        }
+        IRVisitor::visit(op);
+    }
+
+public:
+    bool result = false;
+};
+
+// Find the likely ifs in the body of an unrolled loop whose
+// conditions can be checked once for all the unrolled copies, because
+// if they hold in the last copy they hold in all of them. These
+// include the guards that the GuardWithIf tail strategy adds. The
+// conditions are found with the lets they use substituted in, and
+// must not depend on loops inside the unrolled one, or read memory.
+class FindHoistableGuards : public IRVisitor {
+    using IRVisitor::visit;
+
+    const string &loop_var;
+    map<string, Expr> lets;
+    Scope<int> inner_loops;
+
+    void visit(const LetStmt *op) {
+        Expr old_value;
+        auto it = lets.find(op->name);
+        if (it != lets.end()) {
+            old_value = it->second;
+        }
+        lets[op->name] = substitute(lets, op->value);
+        op->body.accept(this);
+        if (old_value.defined()) {
+            lets[op->name] = old_value;
+        } else {
+            lets.erase(op->name);
+        }
+    }
+
+    void visit(const For *op) {
+        inner_loops.push(op->name, 0);
+        op->body.accept(this);
+        inner_loops.pop(op->name);
+    }
+
+    void visit(const IfThenElse *op) {
+        const Call *c = op->condition.as<Call>();
+        if (c && c->is_intrinsic(Call::likely)) {
+            Expr cond = substitute(lets, c->args[0]);
+            ContainsLoadOrImpureCall reads;
+            cond.accept(&reads);
+            if (!reads.result &&
+                !expr_uses_vars(cond, inner_loops) &&
+                holds_before(cond, loop_var)) {
+                guards.insert(op);
+                conditions.push_back(cond);
+            }
+        }
+        IRVisitor::visit(op);
+    }
+
+public:
+    set<const IfThenElse *> guards;
+    vector<Expr> conditions;
+
+    FindHoistableGuards(const string &v) : loop_var(v) {}
+};
+
+// Replace the given ifs with their then cases.
+class RemoveGuards : public IRMutator {
+    using IRMutator::visit;
+
+    const set<const IfThenElse *> &guards;
+
+    void visit(const IfThenElse *op) {
+        if (guards.count(op)) {
+            stmt = mutate(op->then_case);
+        } else {
+            IRMutator::visit(op);
+        }
+    }
+
+public:
+    RemoveGuards(const set<const IfThenElse *> &g) : guards(g) {}
+};
+
+}  // namespace
+
 class UnrollLoops : public IRMutator {
     using IRMutator::visit;
 
+    // The loops not to unroll, to stay within the code size budget.
+    const set<string> &denied;
+
     void visit(const For *for_loop) {
-        if (for_loop->for_type == ForType::Unrolled) {
+        if (for_loop->for_type == ForType::Unrolled && denied.count(for_loop->name)) {
+            Stmt body = mutate(for_loop->body);
+            stmt = For::make(for_loop->name, for_loop->min, for_loop->extent,
+                             ForType::Serial, for_loop->device_api, body);
+        } else if (for_loop->for_type == ForType::Unrolled) {
             // Give it one last chance to simplify to an int
             Expr extent = simplify(for_loop->extent);
             const IntImm *e = extent.as<IntImm>();
             user_assert(e)
                 << "Can only unroll for loops over a constant extent.\n"
-                << "Loop over " << for_loop->name << " has extent " << extent << ".\n";
+                << "Loop over " << for_loop->name << " has extent " << extent << ".\n"
+                << "To unroll a loop of unknown extent, split it by a constant "
+                << "factor with unroll(var, factor, TailStrategy::GuardWithIf).\n";
             Stmt body = mutate(for_loop->body);
 
             if (e->value == 1) {
                 user_warning << "Warning: Unrolling a for loop of extent 1: " << for_loop->name << "\n";
             }
 
+            // If the copies are guarded by conditions that hold for
+            // all of them when they hold for the last one (as when
+            // the loop is the inside of a split with GuardWithIf),
+            // check those once, and leave them out of the copies. If
+            // they don't hold, the loop runs serially with the
+            // guards instead, as an epilogue.
+            FindHoistableGuards hoistable(for_loop->name);
+            if (e->value > 1) {
+                body.accept(&hoistable);
+            }
+            Stmt unguarded = body;
+            if (!hoistable.guards.empty()) {
+                unguarded = RemoveGuards(hoistable.guards).mutate(body);
+            }
+
             vector<Stmt> iters;
             // Make n copies of the body, each wrapped in a let that defines the loop var for that body
             for (int i = 0; i < e->value; i++) {
-                iters.push_back(substitute(for_loop->name, for_loop->min + i, body));
+                iters.push_back(substitute(for_loop->name, for_loop->min + i, unguarded));
             }
             stmt = Block::make(iters);
 
+            if (!hoistable.guards.empty()) {
+                Expr last = for_loop->min + (int)(e->value - 1);
+                Expr cond = const_true();
+                for (Expr c : hoistable.conditions) {
+                    cond = cond && substitute(for_loop->name, last, c);
+                }
+                Stmt epilogue = For::make(for_loop->name, for_loop->min, for_loop->extent,
+                                          ForType::Serial, for_loop->device_api, body);
+                stmt = IfThenElse::make(likely(simplify(cond)), stmt, epilogue);
+            }
+
         } else {
             IRMutator::visit(for_loop);
         }
     }
+
+public:
+    UnrollLoops(const set<string> &denied) : denied(denied) {}
 };
 
-Stmt unroll_loops(Stmt s) {
-    return UnrollLoops().mutate(s);
+Stmt unroll_loops(Stmt s, CodeSizeBudget *budget) {
+    set<string> denied;
+    if (budget && !budget->empty()) {
+        FindUnrollGrowth finder;
+        s.accept(&finder);
+        denied = budget->deny(s, finder.growths, "unrolling");
+    }
+    return UnrollLoops(denied).mutate(s);
 }
 
 }
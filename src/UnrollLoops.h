@@ -10,10 +10,13 @@
 namespace Halide {
 namespace Internal {
 
+class CodeSizeBudget;
+
 /** Take a statement with for loops marked for unrolling, and convert
  * each into several copies of the innermost statement. I.e. unroll
- * the loop. */
-Stmt unroll_loops(Stmt);
+ * the loop. If a budget is given, the loops that would take a Func
+ * over it stay serial loops. */
+Stmt unroll_loops(Stmt, CodeSizeBudget *budget = nullptr);
 
 }
 }
@@ -5,8 +5,12 @@
 #include "CodeGen_GPU_Dev.h"
 
 #include "IRMutator.h"
+#include "IROperator.h"
 #include "CSE.h"
+#include "ExprUsesVar.h"
+#include "IREquality.h"
 #include "Simplify.h"
+#include "Substitute.h"
 
 namespace Halide {
 namespace Internal {
@@ -21,6 +25,62 @@ Stmt make_block(Stmt first, Stmt rest) {
     }
 }
 
+// This visitor removes glsl_varying intrinsics.
+class RemoveVaryingAttributeTags : public IRMutator {
+public:
+    using IRMutator::visit;
+
+    virtual void visit(const Call *op) {
+        if (op->name == Call::glsl_varying) {
+            // Replace the call expression with its wrapped argument expression
+            expr = op->args[1];
+        } else {
+            IRMutator::visit(op);
+        }
+    }
+};
+
+// Check that an expression is linear in the variable, without the piecewise
+// (min, max, select) or integer division terms that FindLinearExpressions
+// below also counts as linear.
+bool is_strictly_linear(Expr e, const std::string &var) {
+    if (!expr_uses_var(e, var) || e.as<Variable>()) {
+        return true;
+    } else if (const Add *op = e.as<Add>()) {
+        return is_strictly_linear(op->a, var) && is_strictly_linear(op->b, var);
+    } else if (const Sub *op = e.as<Sub>()) {
+        return is_strictly_linear(op->a, var) && is_strictly_linear(op->b, var);
+    } else if (const Mul *op = e.as<Mul>()) {
+        return ((!expr_uses_var(op->a, var) && is_strictly_linear(op->b, var)) ||
+                (!expr_uses_var(op->b, var) && is_strictly_linear(op->a, var)));
+    } else if (const Div *op = e.as<Div>()) {
+        return (op->type.is_float() &&
+                !expr_uses_var(op->b, var) && is_strictly_linear(op->a, var));
+    } else if (const Cast *op = e.as<Cast>()) {
+        return op->type.is_float() && is_strictly_linear(op->value, var);
+    }
+    return false;
+}
+
+// This visitor collects the arguments of the min and max nodes in an
+// expression.
+class FindMinMax : public IRVisitor {
+public:
+    using IRVisitor::visit;
+
+    virtual void visit(const Min *op) {
+        IRVisitor::visit(op);
+        args.push_back({op->a, op->b});
+    }
+
+    virtual void visit(const Max *op) {
+        IRVisitor::visit(op);
+        args.push_back({op->a, op->b});
+    }
+
+    std::vector<std::pair<Expr, Expr>> args;
+};
+
 // Find expressions that we can evaluate with interpolation hardware in the GPU
 //
 // This visitor keeps track of the "order" of the expression in terms of the
@@ -29,6 +89,13 @@ Stmt make_block(Stmt first, Stmt rest) {
 // the member found to determine which; order value 2 means non-linear, it
 // could be disqualified due to being quadratic, bilinear or the result of an
 // unknown function.
+//
+// The min or max of two linear expressions is piecewise linear. If it switches
+// from one argument to the other along a single loop variable, it is also
+// counted as linear, and the location of the switch (the breakpoint) is added
+// to the glsl_varying tag, so that setup_gpu_vertex_buffer can put a row or
+// column of vertices there. This keeps clamped coordinate expressions, like
+// those made by boundary conditions, out of the fragment shader.
 class FindLinearExpressions : public IRMutator {
 protected:
     using IRMutator::visit;
@@ -43,15 +110,73 @@ protected:
             return e;
         }
 
-        // Wrap the expression with an intrinsic to tag that it is a varying
-        // attribute. These tagged variables will be pulled out of the fragment
-        // shader during a subsequent pass
-        Expr intrinsic = Call::make(e.type(), Call::glsl_varying,
-                                    {name + ".varying", e},
-                                    Call::Intrinsic);
         ++total_found;
 
-        return intrinsic;
+        return make_varying_tag(name + ".varying", e);
+    }
+
+    // Wrap the expression with an intrinsic to tag that it is a varying
+    // attribute. These tagged variables will be pulled out of the fragment
+    // shader during a subsequent pass. The arguments after the expression are
+    // pairs of loop variable names and breakpoints along them.
+    Expr make_varying_tag(const std::string &name, Expr e) {
+        std::vector<Expr> args = {name, e};
+
+        FindMinMax find;
+        expand_lets(e).accept(&find);
+        for (const std::pair<Expr, Expr> &i : find.args) {
+            std::string var;
+            Expr location;
+            if (find_breakpoint(i.first, i.second, &var, &location)) {
+                args.push_back(var);
+                args.push_back(location);
+            }
+        }
+
+        return Call::make(e.type(), Call::glsl_varying, args, Call::Intrinsic);
+    }
+
+    // Remove the varying tags from an expression, and replace the variables
+    // defined by linear let expressions in the loops with their values.
+    Expr expand_lets(Expr e) {
+        e = RemoveVaryingAttributeTags().mutate(e);
+        e = substitute_in_all_lets(e);
+        return substitute(let_values, e);
+    }
+
+    // Find the value of the loop variable at which min(a, b) or max(a, b)
+    // switches from one argument to the other. The arguments must have been
+    // expanded by expand_lets. Returns false if there is not exactly one such
+    // loop variable, or if the location can't be computed on the host before
+    // the loops.
+    bool find_breakpoint(Expr a, Expr b, std::string *var, Expr *location) {
+        if (!a.type().is_scalar()) {
+            return false;
+        }
+
+        int vars_found = 0;
+        for (const std::string &v : loop_vars) {
+            if (expr_uses_var(a, v) || expr_uses_var(b, v)) {
+                *var = v;
+                ++vars_found;
+            }
+        }
+        if ((vars_found != 1) ||
+            expr_uses_vars(a, kernel_vars) || expr_uses_vars(b, kernel_vars) ||
+            !is_strictly_linear(a, *var) || !is_strictly_linear(b, *var)) {
+            return false;
+        }
+
+        // Solve a == b using the difference at the loop variable values 0 and
+        // 1. If the difference is constant, the breakpoint is not needed, but
+        // place it somewhere harmless.
+        Expr d0 = (cast<float>(substitute(*var, 0, a)) -
+                   cast<float>(substitute(*var, 0, b)));
+        Expr d1 = (cast<float>(substitute(*var, 1, a)) -
+                   cast<float>(substitute(*var, 1, b)));
+        Expr slope = d1 - d0;
+        *location = simplify(select(slope == 0.0f, 0.0f, -d0 / slope));
+        return true;
     }
 
     virtual void visit(const Call *op) {
@@ -94,22 +219,54 @@ protected:
         int value_order = order;
 
         scope.push(op->name, order);
+        push_kernel_var(op->name, mutated_value, value_order);
 
         Expr mutated_body = mutate(op->body);
 
         if ((value_order == 1) && (total_found < max_expressions)) {
             // Wrap the let value with a varying tag
-            mutated_value = Call::make(mutated_value.type(), Call::glsl_varying,
-                                       {op->name + ".varying", mutated_value},
-                                       Call::Intrinsic);
+            mutated_value = make_varying_tag(op->name + ".varying", mutated_value);
             ++total_found;
         }
 
         expr = Let::make(op->name, mutated_value, mutated_body);
 
+        pop_kernel_var(op->name);
         scope.pop(op->name);
     }
 
+    virtual void visit(const LetStmt *op) {
+        Expr mutated_value = mutate(op->value);
+
+        // The variable is still treated as constant, but its value is not
+        // known when computing breakpoints.
+        push_kernel_var(op->name, Expr(), 2);
+
+        Stmt mutated_body = mutate(op->body);
+
+        pop_kernel_var(op->name);
+
+        stmt = LetStmt::make(op->name, mutated_value, mutated_body);
+    }
+
+    // Track the variables defined within the GLSL loops, and the values of the
+    // linear ones.
+    void push_kernel_var(const std::string &name, Expr value, int value_order) {
+        if (in_glsl_loops) {
+            kernel_vars.push(name, 0);
+            if (value_order <= 1) {
+                let_values[name] = expand_lets(value);
+            }
+        }
+    }
+
+    void pop_kernel_var(const std::string &name) {
+        if (in_glsl_loops) {
+            kernel_vars.pop(name);
+            let_values.erase(name);
+        }
+    }
+
     virtual void visit(const For *op) {
         bool old_in_glsl_loops = in_glsl_loops;
         bool kernel_loop = op->device_api == DeviceAPI::GLSL;
@@ -121,6 +278,7 @@ protected:
         } else if (within_kernel_loop) {
             // The inner loop variable is non-linear w.r.t the glsl pixel coordinate.
             scope.push(op->name, 2);
+            kernel_vars.push(op->name, 0);
         }
 
         Stmt mutated_body = mutate(op->body);
@@ -129,6 +287,7 @@ protected:
             loop_vars.pop_back();
         } else if (within_kernel_loop) {
             scope.pop(op->name);
+            kernel_vars.pop(op->name);
         }
 
         in_glsl_loops = old_in_glsl_loops;
@@ -278,14 +437,35 @@ protected:
 
     virtual void visit(const Mod *op) { visit_binary(op); }
 
-    // Break the expression into a piecewise function, if the expressions are
-    // linear, we treat the piecewise behavior specially during codegen
+    // The min or max of linear expressions is linear, if a breakpoint between
+    // the pieces can be placed in the mesh
+    template<typename T>
+    void visit_min_or_max(T *op) {
+        Expr a = mutate(op->a);
+        unsigned int order_a = order;
+        Expr b = mutate(op->b);
+        unsigned int order_b = order;
 
-    // Once this is done, Min and Max should call visit_binary_linear and the code
-    // in setup_mesh will handle piecewise linear behavior introduced by these
-    // expressions
-    virtual void visit(const Min *op) { visit_binary(op); }
-    virtual void visit(const Max *op) { visit_binary(op); }
+        order = std::max(order_a, order_b);
+
+        std::string var;
+        Expr location;
+        if ((order == 1) && !find_breakpoint(expand_lets(a), expand_lets(b), &var, &location)) {
+            order = 2;
+        }
+
+        if ((order > 1) && (order_a == 1)) {
+            a = tag_linear_expression(a);
+        }
+        if ((order > 1) && (order_b == 1)) {
+            b = tag_linear_expression(b);
+        }
+
+        expr = T::make(a, b);
+    }
+
+    virtual void visit(const Min *op) { visit_min_or_max(op); }
+    virtual void visit(const Max *op) { visit_min_or_max(op); }
 
     virtual void visit(const EQ *op) { visit_binary(op); }
     virtual void visit(const NE *op) { visit_binary(op); }
@@ -364,6 +544,11 @@ public:
 
     Scope<int> scope;
 
+    // The variables defined within the GLSL loops, and the expanded values of
+    // the ones defined by linear let expressions.
+    Scope<int> kernel_vars;
+    std::map<std::string, Expr> let_values;
+
     unsigned int order;
     bool found;
 
@@ -385,7 +570,7 @@ Stmt find_linear_expressions(Stmt s) {
 }
 
 // This visitor produces a map containing name and expression pairs from varying
-// tagged intrinsics
+// tagged intrinsics, and the distinct breakpoints along each loop variable
 class FindVaryingAttributeTags : public IRVisitor
 {
 public:
@@ -397,26 +582,23 @@ public:
         if (op->name == Call::glsl_varying) {
             std::string name = op->args[0].as<StringImm>()->value;
             varyings[name] = op->args[1];
+
+            for (size_t i = 2; i + 1 < op->args.size(); i += 2) {
+                std::string var = op->args[i].as<StringImm>()->value;
+                std::vector<Expr> &locations = breakpoints[var];
+                Expr location = op->args[i + 1];
+                if (std::none_of(locations.begin(), locations.end(),
+                                 [&](const Expr &l) { return equal(l, location); })) {
+                    locations.push_back(location);
+                }
+            }
         }
         IRVisitor::visit(op);
     }
 
     std::map<std::string, Expr>& varyings;
-};
 
-// This visitor removes glsl_varying intrinsics.
-class RemoveVaryingAttributeTags : public IRMutator {
-public:
-    using IRMutator::visit;
-
-    virtual void visit(const Call *op) {
-        if (op->name == Call::glsl_varying) {
-            // Replace the call expression with its wrapped argument expression
-            expr = op->args[1];
-        } else {
-            IRMutator::visit(op);
-        }
-    }
+    std::map<std::string, std::vector<Expr>> breakpoints;
 };
 
 Stmt remove_varying_attributes(Stmt s)
@@ -529,9 +711,9 @@ protected:
 
         // Check to see if the variable matches a loop variable name
         if (std::find(names.begin(), names.end(), op->name) != names.end()) {
-            // This case is used by integer type loop variables. They are cast
-            // to float and offset.
-            expr = Expr(op) - 0.5f;
+            // This case is used by the loop variables, which hold the floating
+            // point vertex coordinates. They are offset to the pixel grid.
+            expr = Variable::make(Float(32), op->name) - 0.5f;
 
         } else if (scope.contains(op->name) && (op->type != scope.get(op->name).type())) {
             // Otherwise, check to see if it is defined by a modified let
@@ -984,10 +1166,10 @@ public:
             Expr loop_variable = Variable::make(Int(32),name);
             loop_variables.push_back(loop_variable);
 
-            // TODO: When support for piecewise linear expressions is added this
-            // expression must support more than two coordinates in each
-            // dimension.
-            Expr coord_expr = select(loop_variable == 0, dim[0], dim[1]);
+            Expr coord_expr = dim.back();
+            for (int i = (int)dim.size() - 2; i >= 0; --i) {
+                coord_expr = select(loop_variable == i, dim[i], coord_expr);
+            }
 
             // Visit the body of the for-loop
             Stmt mutated_body = mutate(op->body);
@@ -1003,8 +1185,8 @@ public:
                 Expr gpu_varying_offset = Variable::make(Int(32), "gpu.vertex_offset");
 
                 // Add expressions for the x and y vertex coordinates.
-                Expr coord1 = cast<float>(Variable::make(Int(32),for_loops[0]->name));
-                Expr coord0 = cast<float>(Variable::make(Int(32),for_loops[1]->name));
+                Expr coord1 = Variable::make(Float(32), for_loops[0]->name);
+                Expr coord0 = Variable::make(Float(32), for_loops[1]->name);
 
                 // Transform the vertex coordinates to GPU device coordinates on
                 // [-1,1]
@@ -1034,10 +1216,8 @@ public:
                                                        gpu_varying_offset + 0, Parameter()),
                                            mutated_body);
 
-                // TODO: The value 2 in this expression must be changed to reflect
-                // addition coordinate values in the fastest changing dimension when
-                // support for piecewise linear functions is added
-                Expr offset_expression = (loop_variables[0] * num_padded_attributes * 2) +
+                int num_coords_dim0 = (int)dims[for_loops[1]->name].size();
+                Expr offset_expression = (loop_variables[0] * num_padded_attributes * num_coords_dim0) +
                 (loop_variables[1] * num_padded_attributes);
                 mutated_body = LetStmt::make("gpu.vertex_offset",
                                              offset_expression, mutated_body);
@@ -1146,16 +1326,23 @@ public:
             attribute_order[loop0->name] = 0;
             attribute_order[loop1->name] = 1;
 
-            Expr loop0_max = Add::make(loop0->min, loop0->extent);
-            Expr loop1_max = Add::make(loop1->min, loop1->extent);
-
             std::vector<std::vector<Expr>> coords(2);
-
-            coords[0].push_back(loop0->min);
-            coords[0].push_back(loop0_max);
-
-            coords[1].push_back(loop1->min);
-            coords[1].push_back(loop1_max);
+            const For *loops[] = {loop0, loop1};
+            for (int i = 0; i < 2; i++) {
+                Expr loop_min = cast<float>(loops[i]->min);
+                Expr loop_max = cast<float>(Add::make(loops[i]->min, loops[i]->extent));
+                coords[i].push_back(loop_min);
+                coords[i].push_back(loop_max);
+
+                // The vertices are at the pixel edges, so the varying
+                // attributes at a vertex coordinate are evaluated half a pixel
+                // lower. Any breakpoints of piecewise linear expressions follow
+                // the two edges, in no particular order. The runtime sorts the
+                // coordinates before drawing the mesh.
+                for (Expr location : tag_finder.breakpoints[loops[i]->name]) {
+                    coords[i].push_back(clamp(location + 0.5f, loop_min, loop_max));
+                }
+            }
 
             // Count the two spatial x and y coordinates plus the number of
             // varying attribute expressions found
@@ -1215,7 +1402,7 @@ public:
             stmt = LetStmt::make("glsl.num_coords_dim0", dont_simplify((int)(coords[0].size())),
                    LetStmt::make("glsl.num_coords_dim1", dont_simplify((int)(coords[1].size())),
                    LetStmt::make("glsl.num_padded_attributes", dont_simplify(num_padded_attributes),
-                   Allocate::make(vs.vertex_buffer_name, Float(32), {vertex_buffer_size}, const_true(),
+                   Allocate::make(vs.vertex_buffer_name, Float(32), MemoryType::Auto, {vertex_buffer_size}, const_true(),
                    Block::make(vertex_setup,
                    Block::make(loop_stmt,
                    Block::make(used_in_codegen(Int(32), "glsl.num_coords_dim0"),
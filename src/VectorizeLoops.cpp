@@ -23,6 +23,30 @@ using std::pair;
 
 namespace {
 
+// Does an expression load from the named buffer?
+class UsesLoad : public IRVisitor {
+    const string &name;
+
+    using IRVisitor::visit;
+
+    void visit(const Load *op) {
+        if (op->name == name) {
+            result = true;
+        }
+        IRVisitor::visit(op);
+    }
+
+public:
+    bool result = false;
+    UsesLoad(const string &n) : name(n) {}
+};
+
+bool expr_uses_load(Expr e, const string &name) {
+    UsesLoad uses(name);
+    e.accept(&uses);
+    return uses.result;
+}
+
 // For a given var, replace expressions like shuffle_vector(var, 4)
 // with var.lane.4
 class ReplaceShuffleVectors : public IRMutator {
@@ -250,6 +274,17 @@ class PredicateLoadStore : public IRMutator {
                 << "We are inside a hexagon loop, but the target doesn't have hexagon's features\n";
             return true;
         } else if (target.arch == Target::X86) {
+            // AVX-512 has masked loads and stores of every lane size
+            // (8 and 16 bit lanes need AVX512BW), so vector tails
+            // can use them rather than scalarizing.
+            if (target.has_feature(Target::AVX512_Skylake) ||
+                target.has_feature(Target::AVX512_Cannonlake)) {
+                return lanes >= 4;
+            }
+            if (target.has_feature(Target::AVX512) ||
+                target.has_feature(Target::AVX512_KNL)) {
+                return (bit_size >= 32) && (lanes >= 4);
+            }
             // Should only attempt to predicate store/load if the lane size is
             // no less than 4
             return (bit_size == 32) && (lanes >= 4);
@@ -469,6 +504,29 @@ class VectorSubs : public IRMutator {
     }
 
     void visit(const Call *op) {
+        if (op->is_intrinsic(Call::if_then_else) &&
+            op->args[1].as<Call>() &&
+            op->args[1].as<Call>()->name == Call::trace) {
+            // A filtered trace call. Make the single trace call for
+            // the vector if any lane passes the filter.
+            Expr cond = mutate(op->args[0]);
+            Expr trace = mutate(op->args[1]);
+            if (cond.same_as(op->args[0]) && trace.same_as(op->args[1])) {
+                expr = op;
+                return;
+            }
+            if (cond.type().is_vector()) {
+                Expr any = extract_lane(cond, 0);
+                for (int i = 1; i < cond.type().lanes(); i++) {
+                    any = any || extract_lane(cond, i);
+                }
+                cond = any;
+            }
+            expr = Call::make(op->type, Call::if_then_else, {cond, trace, op->args[2]},
+                              op->call_type);
+            return;
+        }
+
         // Widen the call by changing the lanes of all of its
         // arguments and its return type
         vector<Expr> new_args(op->args.size());
@@ -657,6 +715,80 @@ class VectorSubs : public IRMutator {
         }
     }
 
+    void visit(const Atomic *op) {
+        // If every lane updates the same site, as when vectorizing
+        // over the RVar of a sum along a row, accumulate the lanes
+        // with a horizontal reduction and do one scalar update.
+        if (const Store *store = op->body.as<Store>()) {
+            Expr index = mutate(store->index);
+            Expr value = mutate(store->value);
+            if (index.type().is_scalar() && value.type().is_vector()) {
+                Expr reduced = reduce_vector_update(store->name, index, value);
+                if (reduced.defined()) {
+                    stmt = Atomic::make(op->name, Store::make(store->name, reduced, index, store->param));
+                    return;
+                }
+            }
+        }
+
+        // Otherwise each lane has to be a read-modify-write of its own.
+        stmt = scalarize(op);
+    }
+
+    // Given the vectorized value of an update of a single site,
+    // return the scalar value that applies all lanes of the update at
+    // once, if the update is an add, multiply, min or max of the old
+    // value of the site. Otherwise returns an undefined Expr.
+    Expr reduce_vector_update(const string &name, Expr index, Expr value) {
+        Expr a, b;
+        const char *reduce = nullptr;
+        if (const Add *add = value.as<Add>()) {
+            a = add->a;
+            b = add->b;
+            reduce = Call::vector_reduce_add;
+        } else if (const Mul *mul = value.as<Mul>()) {
+            a = mul->a;
+            b = mul->b;
+            reduce = Call::vector_reduce_mul;
+        } else if (const Min *min = value.as<Min>()) {
+            a = min->a;
+            b = min->b;
+            reduce = Call::vector_reduce_min;
+        } else if (const Max *max = value.as<Max>()) {
+            a = max->a;
+            b = max->b;
+            reduce = Call::vector_reduce_max;
+        } else {
+            return Expr();
+        }
+
+        // One side must be the old value of the site, broadcast
+        // across the lanes.
+        auto is_site = [&](Expr e) {
+            const Broadcast *bc = e.as<Broadcast>();
+            const Load *load = bc ? bc->value.as<Load>() : nullptr;
+            return load && load->name == name && equal(load->index, index);
+        };
+        if (is_site(b)) {
+            std::swap(a, b);
+        }
+        if (!is_site(a) || expr_uses_load(b, name)) {
+            return Expr();
+        }
+
+        Expr old_value = a.as<Broadcast>()->value;
+        Expr lanes = Call::make(old_value.type(), reduce, {b}, Call::PureIntrinsic);
+        if (reduce == Call::vector_reduce_add) {
+            return old_value + lanes;
+        } else if (reduce == Call::vector_reduce_mul) {
+            return old_value * lanes;
+        } else if (reduce == Call::vector_reduce_min) {
+            return Halide::min(old_value, lanes);
+        } else {
+            return Halide::max(old_value, lanes);
+        }
+    }
+
     void visit(const AssertStmt *op) {
         if (op->condition.type().lanes() > 1) {
             stmt = scalarize(op);
@@ -845,7 +977,7 @@ class VectorSubs : public IRMutator {
         // The variable itself could still exist inside an inner scalarized block.
         body = substitute(v, Variable::make(Int(32), var), body);
 
-        stmt = Allocate::make(op->name, op->type, new_extents, op->condition, body, new_expr, op->free_function);
+        stmt = Allocate::make(op->name, op->type, op->memory_type, new_extents, op->condition, body, new_expr, op->free_function);
     }
 
     Stmt scalarize(Stmt s) {
@@ -943,10 +1075,120 @@ public:
     VectorizeLoops(const Target &t) : target(t), in_hexagon(false) {}
 };
 
+// A horizontal reduction of every iteration of a serial loop into the
+// same site can wait until after the loop: accumulate the lanes in a
+// vector instead, and reduce that once at the end.
+class HoistVectorReductions : public IRMutator {
+    using IRMutator::visit;
+
+    void visit(const For *op) {
+        IRMutator::visit(op);
+        if (op->for_type != ForType::Serial) {
+            return;
+        }
+        op = stmt.as<For>();
+        internal_assert(op);
+
+        // Find the update, under any lets.
+        vector<pair<string, Expr>> lets;
+        Stmt body = op->body;
+        while (const LetStmt *let = body.as<LetStmt>()) {
+            lets.push_back({let->name, let->value});
+            body = let->body;
+        }
+        const Atomic *atomic = body.as<Atomic>();
+        const Store *store = atomic ? atomic->body.as<Store>() : nullptr;
+        if (!store) {
+            return;
+        }
+
+        Expr a, b;
+        if (const Add *add = store->value.as<Add>()) {
+            a = add->a;
+            b = add->b;
+        } else if (const Mul *mul = store->value.as<Mul>()) {
+            a = mul->a;
+            b = mul->b;
+        } else if (const Min *min = store->value.as<Min>()) {
+            a = min->a;
+            b = min->b;
+        } else if (const Max *max = store->value.as<Max>()) {
+            a = max->a;
+            b = max->b;
+        } else {
+            return;
+        }
+        const Load *site = a.as<Load>();
+        const Call *reduce = b.as<Call>();
+        if (!site || site->name != store->name || !equal(site->index, store->index) ||
+            !reduce || reduce->args.size() != 1 ||
+            !(reduce->is_intrinsic(Call::vector_reduce_add) ||
+              reduce->is_intrinsic(Call::vector_reduce_mul) ||
+              reduce->is_intrinsic(Call::vector_reduce_min) ||
+              reduce->is_intrinsic(Call::vector_reduce_max))) {
+            return;
+        }
+
+        // The site must be the same in every iteration.
+        if (expr_uses_var(store->index, op->name)) {
+            return;
+        }
+        for (const auto &let : lets) {
+            if (expr_uses_var(store->index, let.first)) {
+                return;
+            }
+        }
+
+        Expr lanes = reduce->args[0];
+        Type t = lanes.type();
+        string acc_name = store->name + "." + op->name + ".accumulator";
+        Expr acc_index = Ramp::make(0, 1, t.lanes());
+        Expr acc = Load::make(t, acc_name, acc_index, Buffer<>(), Parameter());
+
+        // Mins and maxes can start from the old value of the site,
+        // rather than an identity.
+        Expr init;
+        if (reduce->is_intrinsic(Call::vector_reduce_add)) {
+            init = make_zero(t);
+        } else if (reduce->is_intrinsic(Call::vector_reduce_mul)) {
+            init = make_one(t);
+        } else {
+            init = Broadcast::make(a, t.lanes());
+        }
+
+        Expr next;
+        if (reduce->is_intrinsic(Call::vector_reduce_add)) {
+            next = acc + lanes;
+        } else if (reduce->is_intrinsic(Call::vector_reduce_mul)) {
+            next = acc * lanes;
+        } else if (reduce->is_intrinsic(Call::vector_reduce_min)) {
+            next = min(acc, lanes);
+        } else {
+            next = max(acc, lanes);
+        }
+        Stmt loop_body = Store::make(acc_name, next, acc_index, Parameter());
+        for (size_t i = lets.size(); i > 0; i--) {
+            loop_body = LetStmt::make(lets[i-1].first, lets[i-1].second, loop_body);
+        }
+        Stmt loop = For::make(op->name, op->min, op->extent, op->for_type, op->device_api, loop_body);
+
+        Expr reduced = Call::make(reduce->type, reduce->name, {acc}, Call::PureIntrinsic);
+        Stmt update = Store::make(store->name, substitute(b, reduced, store->value),
+                                  store->index, store->param);
+        update = Atomic::make(atomic->name, update);
+
+        Stmt result = Block::make({Store::make(acc_name, init, acc_index, Parameter()), loop, update});
+        stmt = Allocate::make(acc_name, t.element_of(), MemoryType::Register, {t.lanes()},
+                              const_true(), result);
+    }
+};
+
 } // Anonymous namespace
 
 Stmt vectorize_loops(Stmt s, const Target &t) {
-    return VectorizeLoops(t).mutate(s);
+    s = VectorizeLoops(t).mutate(s);
+    s = HoistVectorReductions().mutate(s);
+    return s;
 }
 
 }
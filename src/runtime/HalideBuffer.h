@@ -11,6 +11,7 @@
 #include <cassert>
 #include <atomic>
 #include <algorithm>
+#include <type_traits>
 #include <stdint.h>
 #include <string.h>
 
@@ -41,13 +42,6 @@
 #pragma GCC diagnostic ignored "-Warray-bounds"
 #endif
 
-/** A C struct describing the shape of a single dimension of a halide
- * buffer. This will be a type in the runtime once halide_buffer_t is
- * merged. */
-struct halide_dimension_t {
-    int min, extent, stride;
-};
-
 namespace Halide {
 namespace Runtime {
 
@@ -455,6 +449,26 @@ public:
         initialize_from_buffer(buf);
     }
 
+    /** Make a buffer from a halide_buffer_t. Does not take ownership
+     * of the host or device allocations. */
+    explicit Buffer(const halide_buffer_t &b) : ty(b.type) {
+        if (!T_is_void) {
+            assert(static_halide_type() == b.type);
+        }
+        assert(b.dimensions <= D);
+        dims = b.dimensions;
+        buf.host = b.host;
+        buf.dev = b.device;
+        buf.elem_size = ty.bytes();
+        buf.host_dirty = (b.flags & halide_buffer_flag_host_dirty) != 0;
+        buf.dev_dirty = (b.flags & halide_buffer_flag_device_dirty) != 0;
+        for (int i = 0; i < b.dimensions; i++) {
+            buf.min[i] = b.dim[i].min;
+            buf.extent[i] = b.dim[i].extent;
+            buf.stride[i] = b.dim[i].stride;
+        }
+    }
+
     /** Give Buffers access to the members of Buffers of different dimensionalities and types. */
     template<typename T2, int D2> friend class Buffer;
 
@@ -843,6 +857,24 @@ public:
     }
     // @}
 
+    /** Describe this Buffer as a halide_buffer_t. The shape is written
+     * to the given array, which must have room for dimensions()
+     * entries, and which the halide_buffer_t refers to. */
+    halide_buffer_t make_halide_buffer_t(halide_dimension_t *shape) const {
+        halide_buffer_t b = {0};
+        b.type = ty;
+        b.dimensions = dimensions();
+        b.dim = shape;
+        b.host = buf.host;
+        b.device = buf.dev;
+        b.flags = ((buf.host_dirty ? halide_buffer_flag_host_dirty : 0) |
+                   (buf.dev_dirty ? halide_buffer_flag_device_dirty : 0));
+        for (int i = 0; i < dimensions(); i++) {
+            shape[i] = {dim(i).min(), dim(i).extent(), dim(i).stride()};
+        }
+        return b;
+    }
+
     /** Provide a cast operator to buffer_t *, so that instances can
      * be passed directly to Halide filters. */
     operator buffer_t *() {
@@ -933,6 +965,23 @@ public:
     */
     template<typename T2, int D2>
     void copy_from(const Buffer<T2, D2> &other) {
+        copy_from_helper(other, std::false_type(), nullptr);
+    }
+
+    /** Like copy_from, but split the copy into tasks on the Halide
+     * thread pool (via halide_do_par_for) when it's large enough to
+     * be worth it. Requires the Halide runtime, e.g. from an
+     * AOT-compiled pipeline, to be linked in. */
+    template<typename T2, int D2>
+    void parallel_copy_from(const Buffer<T2, D2> &other, void *ctx = nullptr) {
+        copy_from_helper(other, std::true_type(), ctx);
+    }
+
+private:
+    // Parallel is std::true_type or std::false_type, so that serial
+    // copies don't reference halide_do_par_for.
+    template<typename T2, int D2, typename Parallel>
+    void copy_from_helper(const Buffer<T2, D2> &other, Parallel parallel, void *ctx) {
         Buffer<const T, D> src(other);
         Buffer<T, D> dst(*this);
 
@@ -951,34 +1000,35 @@ public:
         }
 
         // If T is void, we need to do runtime dispatch to an
-        // appropriately-typed lambda. We're copying, so we only care
+        // appropriately-typed copy. We're copying, so we only care
         // about the element size.
         if (type().bytes() == 1) {
             using MemType = uint8_t;
             auto &typed_dst = (Buffer<MemType, D> &)dst;
             auto &typed_src = (Buffer<const MemType, D> &)src;
-            typed_dst.for_each_value([&](MemType &dst, MemType src) {dst = src;}, typed_src);
+            typed_dst.copy_values_from(typed_src, parallel, ctx);
         } else if (type().bytes() == 2) {
             using MemType = uint16_t;
             auto &typed_dst = (Buffer<MemType, D> &)dst;
             auto &typed_src = (Buffer<const MemType, D> &)src;
-            typed_dst.for_each_value([&](MemType &dst, MemType src) {dst = src;}, typed_src);
+            typed_dst.copy_values_from(typed_src, parallel, ctx);
         } else if (type().bytes() == 4) {
             using MemType = uint32_t;
             auto &typed_dst = (Buffer<MemType, D> &)dst;
             auto &typed_src = (Buffer<const MemType, D> &)src;
-            typed_dst.for_each_value([&](MemType &dst, MemType src) {dst = src;}, typed_src);
+            typed_dst.copy_values_from(typed_src, parallel, ctx);
         } else if (type().bytes() == 8) {
             using MemType = uint64_t;
             auto &typed_dst = (Buffer<MemType, D> &)dst;
             auto &typed_src = (Buffer<const MemType, D> &)src;
-            typed_dst.for_each_value([&](MemType &dst, MemType src) {dst = src;}, typed_src);
+            typed_dst.copy_values_from(typed_src, parallel, ctx);
         } else {
             assert(false && "type().bytes() must be 1, 2, 4, or 8");
         }
         set_host_dirty();
     }
 
+public:
     /** Make an image that refers to a sub-range of this image along
      * the given dimension. Does not assert the crop region is within
      * the existing bounds. The cropped image drops any device
@@ -1465,7 +1515,22 @@ public:
     // @}
 
     void fill(not_void_T val) {
-        for_each_value([=](T &v) {v = val;});
+        // If all the bytes of the value are the same (e.g. it's zero),
+        // fill each dense row with a memset.
+        const uint8_t *bytes = (const uint8_t *)(&val);
+        bool uniform = true;
+        for (size_t i = 1; i < sizeof(val); i++) {
+            uniform = uniform && bytes[i] == bytes[0];
+        }
+        for_each_value_task_dim<1> t[D+1];
+        if (uniform && make_for_each_value_task_dims(t)) {
+            uint8_t b = bytes[0];
+            for_each_row_helper<D-1>([=](const for_each_value_task_dim<1> *dims, T *row) {
+                    memset(row, b, dims[0].extent * sizeof(T));
+                }, t, begin());
+        } else {
+            for_each_value([=](T &v) {v = val;});
+        }
         set_host_dirty();
     }
 
@@ -1530,20 +1595,13 @@ private:
             }
         }
     }
-    // @}
-
-public:
-    /** Call a function on every value in the buffer, and the
-     * corresponding values in some number of other buffers of the
-     * same size. The function should take a reference, const
-     * reference, or value of the correct type for each buffer. This
-     * effectively lifts a function of scalars to an element-wise
-     * function of buffers. This produces code that the compiler can
-     * autovectorize. This is slightly cheaper than for_each_element,
-     * because it does not need to track the coordinates. */
-    template<typename Fn, typename ...Args, int N = sizeof...(Args) + 1>
-    void for_each_value(Fn &&f, Args... other_buffers) {
-        for_each_value_task_dim<N> t[D+1];
+    // Fill in the loop nest that traverses this buffer and some
+    // other buffers of the same size: ordered by the strides of this
+    // buffer, with dimensions flattened together where they're
+    // contiguous in all of them. Returns whether the innermost
+    // strides are all one.
+    template<int N, typename ...Args>
+    bool make_for_each_value_task_dims(for_each_value_task_dim<N> *t, Args... other_buffers) {
         for (int i = 0; i <= D; i++) {
             for (int j = 0; j < N; j++) {
                 t[i].stride[j] = 0;
@@ -1552,7 +1610,7 @@ public:
         }
 
         for (int i = 0; i < dimensions(); i++) {
-            extract_strides(i, t[i].stride, this, &other_buffers...);
+            extract_strides(i, t[i].stride, this, other_buffers...);
             t[i].extent = dim(i).extent();
             // Order the dimensions by stride, so that the traversal is cache-coherent.
             for (int j = i; j > 0 && t[j].stride[0] < t[j-1].stride[0]; j--) {
@@ -1585,6 +1643,113 @@ public:
                 innermost_strides_are_one &= t[0].stride[j] == 1;
             }
         }
+        return innermost_strides_are_one;
+    }
+
+    // Like for_each_value_helper, but stops at the innermost
+    // dimension and calls the function on the start of each row, for
+    // loop nests with dense rows. The function also gets the loop
+    // nest, to find the length of the row.
+    template<int d, typename Fn, typename... Ptrs>
+    static void for_each_row_helper(Fn &&f, const for_each_value_task_dim<sizeof...(Ptrs)> *t, Ptrs... ptrs) {
+        if (d <= 0) {
+            f(t, ptrs...);
+        } else {
+            for (int i = t[d].extent; i != 0; i--) {
+                for_each_row_helper<(d > 0 ? d - 1 : 0)>(f, t, ptrs...);
+                advance_ptrs(t[d].stride, (&ptrs)...);
+            }
+        }
+    }
+
+    // The state shared by the tasks of a parallel copy. Each task
+    // copies a slice of the outermost dimension of the loop nest.
+    struct copy_task_state {
+        for_each_value_task_dim<2> t[D+1];
+        int outer, slice_extent;
+        bool rows_are_dense;
+        T *dst;
+        const T *src;
+    };
+
+    static void copy_values(const for_each_value_task_dim<2> *t, bool rows_are_dense,
+                            T *dst, const T *src) {
+        if (rows_are_dense) {
+            for_each_row_helper<D-1>([](const for_each_value_task_dim<2> *dims, T *d, const T *s) {
+                    memcpy(d, s, dims[0].extent * sizeof(T));
+                }, t, dst, src);
+        } else {
+            for_each_value_helper<D-1, false>([](T &d, T s) {d = s;}, t, dst, src);
+        }
+    }
+
+    static int copy_task(void *user_context, int idx, uint8_t *closure) {
+        const copy_task_state *s = (const copy_task_state *)closure;
+        for_each_value_task_dim<2> t[D+1];
+        memcpy(t, s->t, sizeof(t));
+        int outer = s->outer;
+        int min = idx * s->slice_extent;
+        t[outer].extent = std::min(s->slice_extent, s->t[outer].extent - min);
+        copy_values(t, s->rows_are_dense,
+                    s->dst + (ptrdiff_t)min * t[outer].stride[0],
+                    s->src + (ptrdiff_t)min * t[outer].stride[1]);
+        return 0;
+    }
+
+    // Copy the values of a buffer with the same size and element
+    // type. Rows that are dense in both buffers are copied with
+    // memcpy, which is as fast as it gets.
+    void copy_values_from(const Buffer<const T, D> &src, std::false_type, void *) {
+        for_each_value_task_dim<2> t[D+1];
+        bool rows_are_dense = make_for_each_value_task_dims(t, &src);
+        copy_values(t, rows_are_dense, begin(), src.begin());
+    }
+
+    void copy_values_from(const Buffer<const T, D> &src, std::true_type, void *ctx) {
+        copy_task_state s;
+        s.rows_are_dense = make_for_each_value_task_dims(s.t, &src);
+        s.dst = begin();
+        s.src = src.begin();
+
+        // Split the outermost dimension of the loop nest into slices
+        // of at least a quarter of a megabyte.
+        const size_t min_task_bytes = 256 * 1024;
+        size_t bytes = number_of_elements() * sizeof(T);
+        int tasks = 1;
+        if (bytes >= 2 * min_task_bytes) {
+            s.outer = 0;
+            for (int i = 0; i < D; i++) {
+                if (s.t[i].extent > 1) {
+                    s.outer = i;
+                }
+            }
+            int64_t max_tasks = (int64_t)(bytes / min_task_bytes);
+            tasks = (int)std::min<int64_t>(max_tasks, s.t[s.outer].extent);
+            s.slice_extent = (s.t[s.outer].extent + tasks - 1) / tasks;
+            tasks = (s.t[s.outer].extent + s.slice_extent - 1) / s.slice_extent;
+        }
+
+        if (tasks > 1) {
+            halide_do_par_for(ctx, copy_task, 0, tasks, (uint8_t *)&s);
+        } else {
+            copy_values(s.t, s.rows_are_dense, s.dst, s.src);
+        }
+    }
+    // @}
+
+public:
+    /** Call a function on every value in the buffer, and the
+     * corresponding values in some number of other buffers of the
+     * same size. The function should take a reference, const
+     * reference, or value of the correct type for each buffer. This
+     * effectively lifts a function of scalars to an element-wise
+     * function of buffers. This produces code that the compiler can
+     * autovectorize. This is slightly cheaper than for_each_element,
+     * because it does not need to track the coordinates. */
+    template<typename Fn, typename ...Args, int N = sizeof...(Args) + 1>
+    void for_each_value(Fn &&f, Args... other_buffers) {
+        for_each_value_task_dim<N> t[D+1];
+        bool innermost_strides_are_one = make_for_each_value_task_dims(t, &other_buffers...);
 
         if (innermost_strides_are_one) {
             for_each_value_helper<D-1, true>(f, t, begin(), (other_buffers.begin())...);
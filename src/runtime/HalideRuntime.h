@@ -119,6 +119,20 @@ extern int halide_do_par_for(void *user_context,
 extern void halide_shutdown_thread_pool();
 //@}
 
+/** Run a parallel loop scheduled with Func::parallel_adaptive. Unlike
+ * halide_do_par_for, the task is given a range of iterations to run,
+ * and the runtime chooses how to chunk the loop while it runs: large
+ * chunks first, shrinking towards the end (guided
+ * self-scheduling). The time each chunk takes is measured, and
+ * remembered per loop to put a lower bound on the size of the chunks
+ * the next time the loop runs. The chunks are run as the tasks of a
+ * call to halide_do_par_for, so a custom do_par_for or do_task still
+ * applies. */
+typedef int (*halide_loop_task_t)(void *user_context, int min, int extent, uint8_t *closure);
+extern int halide_do_par_for_adaptive(void *user_context,
+                                      halide_loop_task_t task,
+                                      int min, int size, uint8_t *closure);
+
 /** Set a custom method for performing a parallel for loop. Returns
  * the old do_par_for handler. */
 typedef int (*halide_do_par_for_t)(void *, halide_task_t, int, int, uint8_t*);
@@ -161,6 +175,148 @@ extern void halide_join_thread(struct halide_thread *);
  */
 extern int halide_set_num_threads(int n);
 
+/** The type of the callback invoked when an asynchronous pipeline
+ * invocation completes. result is the return value of the pipeline:
+ * zero on success, or an error code. */
+typedef void (*halide_async_callback_t)(void *callback_context, int result);
+
+/** Schedule a call to a pipeline's argv entry point (e.g. foo_argv)
+ * onto the Halide thread pool, and return immediately. Once the
+ * pipeline has run, callback is called from a thread pool thread. The
+ * args array, and everything it points to, must stay valid until
+ * then. Returns zero if the call was scheduled, or an error code. AOT
+ * headers declare a foo_async wrapper that calls this with
+ * foo_argv. Asynchronous calls must all have completed before
+ * halide_shutdown_thread_pool is called. On OS X and iOS this uses
+ * grand central dispatch, and on platforms without a thread pool the
+ * pipeline runs synchronously before the callback is called. */
+extern int halide_do_async(int (*argv_func)(void **), void **args,
+                           halide_async_callback_t callback, void *callback_context);
+
+/** Call a pipeline's argv entry point (e.g. foo_argv) once for each of
+ * the count argument arrays in args, running the calls as the tasks of
+ * a single parallel loop on the Halide thread pool. This amortizes the
+ * cost of waking up the thread pool over the whole batch, which
+ * dominates for pipelines run on many small inputs. Parallel loops
+ * within the pipeline are still run in parallel, but usually find the
+ * pool already busy. If results is not NULL, the return value of each
+ * call is stored in it. A failing call doesn't stop the others. Returns
+ * zero if every call succeeded, otherwise the result of the first
+ * failing call. AOT headers declare a foo_batch wrapper that calls this
+ * with foo_argv. */
+extern int halide_do_batch(void *user_context, int (*argv_func)(void **),
+                           void **args[], int count, int *results);
+
+/** Set the priority and worker quota of parallel loops run by
+ * pipelines called with the given user_context. When choosing what to
+ * work on, thread pool workers pick the pending parallel loop with the
+ * highest priority, rather than the most recently launched one, and no
+ * more than max_threads workers (zero means no limit) work on any one
+ * such loop at once. The defaults are priority zero and no limit;
+ * setting both back to zero removes the entry. At most 16 distinct
+ * user_contexts may have non-default settings at once. Returns zero on
+ * success.
+ *
+ * On OS X and iOS, which use grand central dispatch, parallel loops
+ * run at the quality of service class of the calling thread by
+ * default. A priority of 2 or more runs them at user interactive, 1 at
+ * user initiated, -1 at utility, and -2 or less at background. A
+ * max_threads (or halide_set_num_threads) above one runs them on a
+ * concurrent queue of Halide's own with that many threads at most. */
+extern int halide_set_thread_pool_priority(void *user_context, int priority, int max_threads);
+
+/** Cancel the pipelines running with the given user_context. The
+ * thread pool stops handing out the remaining tasks of their parallel
+ * loops, and pipelines compiled with the cancellable target feature
+ * also check before each produce node, so the pipelines soon return
+ * halide_error_code_cancelled. Work already in flight is not
+ * interrupted. Cancellation is sticky: later pipelines run with the
+ * same user_context are cancelled too until
+ * halide_clear_cancellation is called. At most 16 distinct
+ * user_contexts may be cancelled or have a deadline at once. Returns
+ * zero on success. */
+extern int halide_cancel(void *user_context);
+
+/** Cancel the pipelines running with the given user_context once
+ * timeout_ns nanoseconds have passed from now, as if halide_cancel
+ * were called then. Setting a new deadline replaces the old one.
+ * Returns zero on success. */
+extern int halide_set_deadline(void *user_context, int64_t timeout_ns);
+
+/** Forget any cancellation or deadline for the given user_context. */
+extern void halide_clear_cancellation(void *user_context);
+
+/** Returns halide_error_code_cancelled if the given user_context has
+ * been cancelled or has passed its deadline, and zero otherwise. This
+ * is what the thread pool and cancellable pipelines call. It is cheap
+ * when nothing has been cancelled, and doesn't call halide_error. */
+extern int halide_cancellation_check(void *user_context);
+
+/** Set how many times an idle thread pool worker polls for new work
+ * (yielding its time slice in between) before going to sleep on a
+ * condition variable. Spinning lets back-to-back parallel loops reuse
+ * hot threads instead of paying for a wakeup, at the cost of burning
+ * some cpu while idle. Returns the old value. The default is zero, or
+ * the value of the environment variable HL_SPIN_COUNT. Passing a
+ * negative value restores the default. Has no effect on OS X and iOS,
+ * which use grand central dispatch. */
+extern int halide_set_thread_pool_spin_count(int n);
+
+/** Statistics about how idle thread pool workers waited for work. */
+struct halide_thread_pool_stats_t {
+    /** The number of times an idle thread found new work while spinning. */
+    uint64_t spin_wakeups;
+    /** The number of times an idle thread had to go to sleep. */
+    uint64_t sleep_wakeups;
+    /** The total time, summed over all threads, spent waiting for work. */
+    uint64_t wait_ns;
+};
+
+/** Get a snapshot of the thread pool statistics, which accumulate
+ * until halide_reset_thread_pool_stats is called. To attribute them
+ * to a single pipeline, reset them before calling it and read them
+ * afterwards. These are all zero on platforms that don't use Halide's
+ * own thread pool. */
+// @{
+extern void halide_get_thread_pool_stats(struct halide_thread_pool_stats_t *stats);
+extern void halide_reset_thread_pool_stats();
+// @}
+
+/** A counting semaphore, used to coordinate the producer and consumer
+ * tasks of a Func scheduled async. See Func::async. */
+struct halide_semaphore_t {
+    uint64_t _private[2];
+};
+
+/** Set the count of a semaphore. Must be called before any thread
+ * uses it. Returns zero. */
+extern int halide_semaphore_init(struct halide_semaphore_t *sem, int count);
+
+/** Add to the count of a semaphore. Returns zero. */
+extern int halide_semaphore_release(struct halide_semaphore_t *sem, int count);
+
+/** Wait until the count of a semaphore is at least the given amount,
+ * and then subtract it. Returns zero, or an error code if the
+ * semaphore was abandoned before then. */
+extern int halide_semaphore_acquire(struct halide_semaphore_t *sem, int count);
+
+/** Declare that a semaphore will not be released any further, so
+ * that anything waiting on it that can't be satisfied by what was
+ * already released fails rather than waiting forever. Registered as
+ * a destructor by the task that releases it, so that it's called when
+ * that task exits, whether or not it succeeded. */
+extern void halide_semaphore_abandon(void *user_context, void *sem);
+
+/** Run the tasks min to min + size - 1 all at once, each on its own
+ * thread, and wait for them all to finish. Unlike the tasks of
+ * halide_do_par_for, these may wait on each other through semaphores,
+ * so they are never queued behind one another on the thread pool. The
+ * first task runs on the calling thread. Returns zero if all the
+ * tasks return zero, or the return value of one of the tasks
+ * otherwise. Not available on platforms without threads. */
+extern int halide_do_concurrent_tasks(void *user_context, halide_task_t task,
+                                      int min, int size, uint8_t *closure);
+
 /** Halide calls these functions to allocate and free memory. To
  * replace in AOT code, use the halide_set_custom_malloc and
  * halide_set_custom_free, or (on platforms that support weak
@@ -183,6 +339,50 @@ extern halide_malloc_t halide_set_custom_malloc(halide_malloc_t user_malloc);
 extern halide_free_t halide_set_custom_free(halide_free_t user_free);
 //@}
 
+/** Give a user_context a workspace. While it has one, buffers that
+ * halide_malloc allocates with that user_context are kept when they
+ * are freed, and reused by later allocations of the same size with the
+ * same user_context. Calling a pipeline repeatedly with the same
+ * bounds and user_context then reuses its intermediate buffers rather
+ * than going back to the allocator, so that steady-state calls make
+ * no heap allocations. Concurrent calls sharing a user_context get
+ * distinct buffers. At most 16 workspaces may exist at once;
+ * halide_enable_workspace returns -1 if there are already that many,
+ * and 0 otherwise. halide_release_workspace frees the kept buffers
+ * and removes the workspace. */
+//@{
+extern int halide_enable_workspace(void *user_context);
+extern void halide_release_workspace(void *user_context);
+//@}
+
+/** Set how the default halide_malloc handles large allocations, such
+ * as compute_root intermediates. Allocations of at least
+ * huge_page_threshold bytes are made directly from the OS and backed
+ * by 2MB transparent huge pages where supported (currently Linux), to
+ * cut page faults and TLB misses. If prefault is true, their pages
+ * are also touched in parallel on the thread pool when allocated, so
+ * the page faults are not taken during the first pass over the
+ * buffer. A threshold of zero turns this off, which is the default
+ * unless the environment variable HL_HUGE_PAGE_THRESHOLD_MB is set
+ * (with HL_PREFAULT_LARGE_ALLOCATIONS=1 to prefault). */
+extern void halide_set_large_allocation_policy(int64_t huge_page_threshold, bool prefault);
+
+/** A pooling allocator that can be installed with
+ * halide_set_custom_malloc and halide_set_custom_free (or
+ * Func::set_custom_allocator). Freed blocks of up to 1MB are kept on
+ * per-size-class free lists, mostly private to each thread, and
+ * reused by later allocations instead of going back to the system
+ * allocator. This helps pipelines that allocate many scratch buffers
+ * inside parallel loops. The two must be installed together, before
+ * anything has been allocated with the previous allocator.
+ * halide_pool_allocator_release_unused returns all the cached blocks
+ * to the system. */
+//@{
+extern void *halide_pool_malloc(void *user_context, size_t x);
+extern void halide_pool_free(void *user_context, void *ptr);
+extern void halide_pool_allocator_release_unused();
+//@}
+
 /** Halide calls these functions to interact with the underlying
  * system runtime functions. To replace in AOT code on platforms that
  * support weak linking, define these functions yourself, or use
@@ -214,6 +414,22 @@ extern int32_t halide_debug_to_file(void *user_context, const char *filename,
                                     int32_t type_code,
                                     struct buffer_t *buf);
 
+/** Set whether halide_debug_to_file writes files asynchronously, and
+ * return the old setting. When enabled, each call copies the buffer
+ * and writes the copy in a thread of its own, so the pipeline doesn't
+ * wait for the file to be written. Writes to the same file still
+ * happen in order. If never called, Halide checks for an environment
+ * variable called HL_DEBUG_TO_FILE_ASYNC, and enables asynchronous
+ * writes if it is set to a nonzero value. */
+extern bool halide_set_debug_to_file_async(bool async);
+
+/** Wait for the asynchronous writes started by halide_debug_to_file
+ * to finish. Returns halide_error_code_debug_to_file_failed if any of
+ * them failed, and zero otherwise. Pipelines that use debug_to_file
+ * call this before they return, so the files are complete when the
+ * pipeline is. */
+extern int halide_debug_to_file_flush(void *user_context);
+
 /** Types in the halide type system. They can be ints, unsigned ints,
  * or floats (of various bit-widths), or a handle (which is always 64-bits).
  * Note that the int/uint/float values do not imply a specific bit width
@@ -297,7 +513,9 @@ enum halide_trace_event_code_t {halide_trace_load = 0,
                                 halide_trace_consume = 6,
                                 halide_trace_end_consume = 7,
                                 halide_trace_begin_pipeline = 8,
-                                halide_trace_end_pipeline = 9};
+                                halide_trace_end_pipeline = 9,
+                                halide_trace_begin_task = 10,
+                                halide_trace_end_task = 11};
 
 struct halide_trace_event_t {
     /** The name of the Func or Pipeline that this event refers to */
@@ -356,6 +574,7 @@ struct halide_trace_event_t {
  * +--begin_realization
  * |  +--produce
  * |  |  +--load/store
+ * |  |  +--begin_task/end_task
  * |  |  +--end_produce
  * |  +--consume
  * |  |  +--load
@@ -368,6 +587,11 @@ struct halide_trace_event_t {
  * function, or many active productions for a single
  * realization. Within a single production, the ordering of events is
  * meaningful.
+ *
+ * A Func traced with trace_realizations also emits a begin_task and
+ * end_task event around each iteration of its parallel loops, on the
+ * thread that runs it. The func of these events is the name of the
+ * loop, and the coordinate is the value of the loop variable.
  */
 // @}
 extern int32_t halide_trace(void *user_context, const struct halide_trace_event_t *event);
@@ -425,7 +649,9 @@ struct halide_trace_packet_t {
  * Halide checks the for existence of an environment variable called
  * HL_TRACE_FILE and opens that file. If HL_TRACE_FILE is not defined,
  * it outputs trace information to stdout in a human-readable
- * format. */
+ * format. Binary trace events are buffered in memory and written out
+ * in large blocks, at the latest at the end of each pipeline, when
+ * the file is changed, and in halide_shutdown_trace. */
 extern void halide_set_trace_file(int fd);
 
 /** Halide calls this to retrieve the file descriptor to write binary
@@ -436,6 +662,58 @@ extern void halide_set_trace_file(int fd);
  * information to stdout. */
 extern int halide_get_trace_file(void *user_context);
 
+/** Set the file descriptor that Halide should write a timeline of
+ * realizations, produce and consume nodes, and parallel tasks to, in
+ * the Chrome trace event format read by chrome://tracing and
+ * Perfetto. Each begin and end event is timestamped and put on the
+ * track of the thread it happened on, which shows idle workers and
+ * load imbalance between parallel tasks. Only Funcs traced with
+ * trace_realizations (or everything, with HL_TRACE set) appear. If
+ * never called, Halide checks for an environment variable called
+ * HL_TRACE_TIMELINE_FILE and creates that file. While writing a
+ * timeline, events not also going to a binary trace file aren't
+ * printed. Pass 0 to stop writing the timeline. */
+extern void halide_set_trace_timeline_file(int fd);
+
+/** The flags of a halide_trace_index_entry_t. */
+enum halide_trace_index_flags_t {
+    /** The chunk has packets other than loads and stores. */
+    halide_trace_index_other_events = 1,
+    /** The chunk loads or stores more Funcs than the entry names, so
+     * any Func may appear in it. */
+    halide_trace_index_names_incomplete = 2
+};
+
+/** An entry of the index of a binary trace file. The index describes
+ * the file in chunks of whole packets, one entry per chunk, in file
+ * order. This lets a reader skip over the parts of a trace it isn't
+ * interested in without parsing them. */
+struct halide_trace_index_entry_t {
+    /** The position of the chunk in the trace file, in bytes from where
+     * this process started writing to it. */
+    uint64_t offset;
+
+    /** The size of the chunk in bytes, and the number of packets in
+     * it. */
+    uint32_t size, packets;
+
+    /** A combination of halide_trace_index_flags_t. */
+    int32_t flags;
+
+    /** The size of the names that follow the entry, a multiple of
+     * four. They are the null-terminated names of the Funcs loaded or
+     * stored in the chunk, followed by zero padding. */
+    uint32_t names_size;
+};
+
+/** Set the file descriptor that Halide should write the index of the
+ * binary trace file to. If never called, Halide checks for an
+ * environment variable called HL_TRACE_INDEX_FILE and creates that
+ * file. The index is only written while tracing to the file set by
+ * halide_set_trace_file or HL_TRACE_FILE, a chunk at a time as the
+ * trace is. Pass 0 to stop writing the index. */
+extern void halide_set_trace_index_file(int fd);
+
 /** If tracing is writing to a file. This call closes that file
  * (flushing the trace). Returns zero on success. */
 extern int halide_shutdown_trace();
@@ -463,6 +741,42 @@ extern int halide_copy_to_host(void *user_context, struct buffer_t *buf);
 extern int halide_copy_to_device(void *user_context, struct buffer_t *buf,
                                  const struct halide_device_interface_t *device_interface);
 
+/** Copy the data in the region of dst (its mins and extents) from
+ * src, which must contain that region and have the same strides and
+ * element size, e.g. from a buffer to a crop of it, or between two
+ * pipelines' buffers of the same shape. If dst_device_interface is
+ * NULL the data ends up in dst's host memory, otherwise in its device
+ * allocation on that interface, which is made if need be. Copies
+ * between allocations of one device interface are done on the device
+ * where the runtime supports it; others go through host memory with
+ * a single copy each way. Passing the same buffer as src and dst moves
+ * it to dst_device_interface (or the host). */
+extern int halide_buffer_copy(void *user_context, struct buffer_t *src,
+                              const struct halide_device_interface_t *dst_device_interface,
+                              struct buffer_t *dst);
+
+/** Copy the part of a buffer's host data at element indices
+ * [min_index, max_index] (relative to the host pointer, as in a
+ * flattened load from the buffer) to the device, if it isn't already
+ * there. Halide calls this instead of halide_copy_to_device for
+ * inputs that device code only reads part of. Afterwards host_dirty
+ * is false, but the device allocation may only hold that part of the
+ * data; halide_copy_to_device copies the rest. Device runtimes
+ * without support for partial copies copy the whole buffer. */
+extern int halide_copy_to_device_region(void *user_context, struct buffer_t *buf,
+                                        const struct halide_device_interface_t *device_interface,
+                                        int64_t min_index, int64_t max_index);
+
+/** Merge the part of a buffer's host data at element indices
+ * [min_index, max_index] into its device allocation, which holds the
+ * rest of the data. Halide calls this after the host part of a loop
+ * split with Func::gpu_host_split, which writes that part on the host
+ * while the device writes the rest. Afterwards dev_dirty is true and
+ * host_dirty is false. */
+extern int halide_merge_host_region(void *user_context, struct buffer_t *buf,
+                                    const struct halide_device_interface_t *device_interface,
+                                    int64_t min_index, int64_t max_index);
+
 /** Wait for current GPU operations to complete. Calling this explicitly
  * should rarely be necessary, except maybe for profiling. */
 extern int halide_device_sync(void *user_context, struct buffer_t *buf);
@@ -473,6 +787,39 @@ extern int halide_device_malloc(void *user_context, struct buffer_t *buf, const
 /** Free device memory. */
 extern int halide_device_free(void *user_context, struct buffer_t *buf);
 
+/** Allocate the host side of buffers used on both the host and a GPU
+ * (those Halide allocates with halide_device_and_host_malloc) in
+ * page-locked memory, using cuMemHostAlloc on CUDA and an
+ * CL_MEM_ALLOC_HOST_PTR staging buffer on OpenCL. Copies between such
+ * buffers and the device go directly over DMA instead of through the
+ * driver's pageable staging path. Page-locked memory is a limited
+ * system resource, so this is off by default; allocations fall back to
+ * halide_malloc if it can't be had. */
+extern void halide_set_pinned_host_allocations(bool use_pinned);
+
+/** On GPUs that share physical memory with the host (integrated and
+ * mobile GPUs), let the device use host allocations in place instead
+ * of allocating separate device memory, so that copies between the
+ * host and the device cost nothing. On OpenCL, buffers Halide
+ * allocates with halide_device_and_host_malloc, and other host
+ * allocations aligned to 4096 bytes, are wrapped with
+ * CL_MEM_USE_HOST_PTR and handed between the host and the device by
+ * mapping and unmapping them. On CUDA, buffers Halide allocates with
+ * halide_device_and_host_malloc are made with mapped page-locked
+ * memory. Off by default; devices with their own memory are
+ * unaffected. Must be set before the buffers are allocated. */
+extern void halide_set_zero_copy_host_allocations(bool use_zero_copy);
+
+/** Set a directory in which the GPU runtimes keep the binaries the
+ * driver compiles from Halide's embedded kernels (cubins for CUDA,
+ * program binaries for OpenCL), and reuse them on later runs instead
+ * of compiling again. Entries are keyed by the kernel source, the
+ * device and the driver version, so a changed pipeline or driver just
+ * misses. Pass NULL to turn this off. If never called, Halide uses the
+ * environment variable HL_GPU_KERNEL_CACHE_DIR, and no cache if that's
+ * unset. The directory must already exist. */
+extern void halide_set_gpu_kernel_cache_dir(const char *path);
+
 /** Get a pointer to halide_device_free if a Halide runtime has been
  * linked in. Returns null if it has not. This requires a different
  * mechanism on different platforms. */
@@ -528,6 +875,63 @@ extern int halide_get_gpu_device(void *user_context);
  */
 extern void halide_memoization_cache_set_size(int64_t size);
 
+/** Set the total number of hash table buckets used by the memoization
+ * cache. The cache is divided into 16 independently locked shards,
+ * and the buckets are divided evenly between them. Existing entries
+ * are rehashed. Passing zero restores the default of 4096. Larger
+ * tables keep hash chains short when many results are cached. */
+extern void halide_memoization_cache_set_num_buckets(int32_t num_buckets);
+
+/** Also cache memoized results in a file of the given size in bytes,
+ * memory mapped and shared with every other process using the same
+ * file. Results stored by any of the processes can be looked up by
+ * all of them, and survive process restarts. The file is created if
+ * it doesn't exist; all processes must use the same size, and zero
+ * picks the default of 256MB. Nothing is evicted from the file: once
+ * it is full, new results are only cached in the calling process. A
+ * NULL path stops using the shared file. Returns 0 on success and -1
+ * if the file can't be used, e.g. on platforms without shared memory
+ * support.
+ *
+ * If this is never called, the file named by the environment variable
+ * HL_MEMOIZE_SHARED_CACHE is used if set, with a size in megabytes
+ * given by HL_MEMOIZE_SHARED_CACHE_MB. */
+extern int halide_memoization_cache_set_shared_file(void *user_context, const char *path, int64_t size);
+
+/** Statistics for one memoized Func, as reported by
+ * halide_memoization_cache_get_stats. */
+struct halide_memoization_cache_func_stats_t {
+    /** The name of the pipeline (its output Func) and of the memoized
+     * Func. These remain valid until halide_memoization_cache_cleanup
+     * is called. */
+    const char *pipeline_name;
+    const char *func_name;
+
+    /** The number of lookups that found a result in the cache, and
+     * the number that had to compute it. */
+    uint64_t hits, misses;
+
+    /** The number of this Func's results evicted from the cache. */
+    uint64_t evictions;
+
+    /** The total number of bytes of results ever stored into the
+     * cache, and the number currently held by it. */
+    uint64_t bytes_stored;
+    int64_t cached_bytes;
+
+    /** The total time spent hashing this Func's cache keys, in
+     * nanoseconds. Zero on platforms without a clock. */
+    uint64_t hash_time_ns;
+};
+
+/** Fill in statistics for up to max_stats memoized Funcs that have
+ * used the cache since the last halide_memoization_cache_cleanup.
+ * Returns the number of such Funcs, which may be more than
+ * max_stats. */
+extern int halide_memoization_cache_get_stats(void *user_context,
+                                              struct halide_memoization_cache_func_stats_t *stats,
+                                              int max_stats);
+
 /** Given a cache key for a memoized result, currently constructed
  *  from the Func name and top-level Func name plus the arguments of
  *  the computation, determine if the result is in the cache and
@@ -540,6 +944,13 @@ extern void halide_memoization_cache_set_size(int64_t size);
  *  return a Tuple, there will only be one buffer_t in the list. The
  *  tuple_count parameters determines the length of the list.
  *
+ * A result computed over realized_bounds or over a region
+ * containing it is a hit. In the second case the requested part of
+ * it is copied into newly allocated buffers of the shape asked for.
+ *
+ * The pipeline and Func names identify the memoized Func for the
+ * statistics reported by halide_memoization_cache_get_stats.
+ *
  * The return values are:
  * -1: Signals an error.
  *  0: Success and cache hit.
@@ -547,7 +958,8 @@ extern void halide_memoization_cache_set_size(int64_t size);
  */
 extern int halide_memoization_cache_lookup(void *user_context, const uint8_t *cache_key, int32_t size,
                                            struct buffer_t *realized_bounds, int32_t tuple_count,
-                                           struct buffer_t **tuple_buffers);
+                                           struct buffer_t **tuple_buffers,
+                                           const char *pipeline_name, const char *func_name);
 
 /** Given a cache key for a memoized result, currently constructed
  *  from the Func name and top-level Func name plus the arguments of
@@ -560,12 +972,22 @@ extern int halide_memoization_cache_lookup(void *user_context, const uint8_t *ca
  *  only be one buffer_t in the list. The tuple_count parameters
  *  determines the length of the list.
  *
+ * The pipeline and Func names identify which Func the result belongs
+ * to. When the cache is full, entries that took longer to recompute
+ * per byte are kept in preference to cheap ones, with the recompute
+ * cost scaled by 2^priority. If max_bytes is positive, the Func's
+ * results are limited to that many bytes of the cache in total, and
+ * the Func's older entries are evicted to make room; if that is not
+ * possible the result is not cached.
+ *
  * If there is a memory allocation failure, the store does not store
  * the data into the cache.
  */
 extern int halide_memoization_cache_store(void *user_context, const uint8_t *cache_key, int32_t size,
                                           struct buffer_t *realized_bounds, int32_t tuple_count,
-                                          struct buffer_t **tuple_buffers);
+                                          struct buffer_t **tuple_buffers,
+                                          const char *pipeline_name, const char *func_name,
+                                          int32_t priority, int64_t max_bytes);
 
 /** If halide_memoization_cache_lookup succeeds,
  * halide_memoization_cache_release must be called to signal the
@@ -739,6 +1161,19 @@ enum halide_error_code_t {
 
     /** At least one of the buffer's extents are negative. */
     halide_error_code_buffer_extents_negative = -28,
+
+    /** A halide_buffer_t with more than four dimensions was converted
+     * to a buffer_t. */
+    halide_error_code_too_many_dimensions = -29,
+
+    /** halide_buffer_copy was given buffers with different element
+     * sizes or strides, or a destination that isn't within the
+     * source. */
+    halide_error_code_bad_buffer_copy = -30,
+
+    /** The pipeline was cancelled with halide_cancel, or ran past the
+     * deadline set with halide_set_deadline. */
+    halide_error_code_cancelled = -31,
 };
 
 /** Halide calls the functions below on various error conditions. The
@@ -768,6 +1203,7 @@ extern int halide_error_access_out_of_bounds(void *user_context, const char *fun
 extern int halide_error_buffer_allocation_too_large(void *user_context, const char *buffer_name,
                                                     uint64_t allocation_size, uint64_t max_size);
 extern int halide_error_buffer_extents_negative(void *user_context, const char *buffer_name, int dimension, int extent);
+extern int halide_error_too_many_dimensions(void *user_context, const char *buffer_name, int dimensions);
 extern int halide_error_buffer_extents_too_large(void *user_context, const char *buffer_name,
                                                  int64_t actual_size, int64_t max_size);
 extern int halide_error_constraints_make_required_region_smaller(void *user_context, const char *buffer_name,
@@ -860,7 +1296,29 @@ typedef enum halide_target_feature_t {
     halide_target_feature_avx512_knl = 39, ///< Enable the AVX512 features supported by Knight's Landing chips, such as the Xeon Phi x200. This includes the base AVX512 set, and also AVX512-CD and AVX512-ER.
     halide_target_feature_avx512_skylake = 40, ///< Enable the AVX512 features supported by Skylake Xeon server processors. This adds AVX512-VL, AVX512-BW, and AVX512-DQ to the base set. The main difference from the base AVX512 set is better support for small integer ops. Note that this does not include the Knight's Landing features. Note also that these features are not available on Skylake desktop and mobile processors.
     halide_target_feature_avx512_cannonlake = 41, ///< Enable the AVX512 features expected to be supported by future Cannonlake processors. This includes all of the Skylake features, plus AVX512-IFMA and AVX512-VBMI.
-    halide_target_feature_end = 42 ///< A sentinel. Every target is considered to have this feature, and setting this feature does nothing.
+    halide_target_feature_large_stack = 42, ///< Place allocations of up to 256KB on the stack rather than 16KB, and give thread pool workers stacks of at least 8MB.
+    halide_target_feature_profile_counters = 43, ///< With profile, also count instructions, cycles and cache misses per Func with the CPU's hardware performance counters, where the OS allows it (currently Linux and Android), and packets and cycles per Func in code offloaded to Hexagon.
+    halide_target_feature_arm_dot_prod = 44, ///< Enable the ARMv8.2 dot product instructions SDOT and UDOT.
+    halide_target_feature_arm_fp16 = 45, ///< Enable the ARMv8.2 half-precision floating point arithmetic instructions.
+    halide_target_feature_pgo_instrument = 46, ///< Count the branches and loop trips taken, for profile-guided optimization. See halide_pgo_register.
+    halide_target_feature_power_arch_3_00 = 47, ///< Use POWER ISA 3.00 (POWER9) new instructions. Only relevant on POWERPC.
+    halide_target_feature_msa = 48, ///< Use the MIPS SIMD Architecture (MSA) 128-bit vector instructions. Only relevant on MIPS32r5 and later, and on MIPS64r6.
+    halide_target_feature_hexagon_async = 49, ///< Queue Hexagon offloads, and only wait for them when the host needs their results.
+    halide_target_feature_cuda_capability61 = 50,  ///< Enable CUDA compute capability 6.1 (Pascal)
+    halide_target_feature_cuda_capability70 = 51,  ///< Enable CUDA compute capability 7.0 (Volta). Requires LLVM 6.0 or later.
+    halide_target_feature_specialize_strides = 52, ///< Compile a second copy of the pipeline for when every buffer with an unconstrained innermost stride has a stride of one, and pick between them on entry.
+    halide_target_feature_precheck = 53, ///< Also generate foo_precheck, which only validates its arguments, and foo_prechecked, which skips the buffer checks that foo_precheck does.
+    halide_target_feature_cancellable = 54, ///< Check for cancellation with halide_cancellation_check before each parallel task and each produce node.
+    halide_target_feature_minimal_runtime = 55, ///< In AOT objects with the runtime, leave out the parts of it that the pipeline doesn't use, including the halide_* functions only an application would call.
+    halide_target_feature_fast_math = 56, ///< Let LLVM reassociate and contract floating-point math and assume there are no NaNs or infinities (so is_nan may not work), and on x86 flush denormals to zero while a pipeline runs.
+    halide_target_feature_arm_sve = 57, ///< Allow LLVM to use the ARM Scalable Vector Extension. Only relevant on 64-bit arm.
+    halide_target_feature_small_code = 58, ///< Limit how much unrolling and loop partitioning may grow the code of each Func. See Func::code_size_budget.
+    halide_target_feature_llvm_opt_1 = 59, ///< Optimize with LLVM at -O1 rather than -O3, with a lower inlining threshold. Compiles faster.
+    halide_target_feature_llvm_opt_2 = 60, ///< Optimize with LLVM at -O2 rather than -O3.
+    halide_target_feature_no_llvm_loop_vectorize = 61, ///< Don't run LLVM's loop vectorizer. Useful when the schedule already vectorizes.
+    halide_target_feature_no_llvm_slp_vectorize = 62, ///< Don't run LLVM's SLP vectorizer.
+    halide_target_feature_no_llvm_unroll = 63, ///< Don't let LLVM unroll loops. Unrolling in the schedule still happens.
+    halide_target_feature_end = 64 ///< A sentinel. Every target is considered to have this feature, and setting this feature does nothing.
 } halide_target_feature_t;
 
 /** This function is called internally by Halide in some situations to determine
@@ -972,6 +1430,73 @@ typedef struct buffer_t {
 
 #endif
 
+#ifndef HALIDE_BUFFER_T_DEFINED
+#define HALIDE_BUFFER_T_DEFINED
+
+/** The shape of a single dimension of a halide_buffer_t. */
+struct halide_dimension_t {
+    int32_t min, extent, stride;
+};
+
+/** Flags that may be set on a halide_buffer_t. */
+typedef enum {
+    halide_buffer_flag_host_dirty = 1,
+    halide_buffer_flag_device_dirty = 2
+} halide_buffer_flags;
+
+/**
+ * A variable-dimensionality description of an image. Unlike buffer_t,
+ * it isn't limited to four dimensions: the shape lives in an array of
+ * halide_dimension_t of length dimensions, which the creator of the
+ * buffer owns. Compiled pipelines still take buffer_t, so for now
+ * halide_buffer_t is converted to and from buffer_t at the boundary
+ * with halide_upgrade_buffer_t and halide_downgrade_buffer_t. */
+typedef struct halide_buffer_t {
+    /** A device-handle for e.g. GPU memory used to back this buffer. */
+    uint64_t device;
+
+    /** The interface used to interpret the above handle. */
+    const struct halide_device_interface_t *device_interface;
+
+    /** A pointer to the start of the data in main memory. In terms of
+     * the Halide coordinate system, this is the address of the min
+     * coordinates (defined below). */
+    uint8_t *host;
+
+    /** flags with various meanings, from halide_buffer_flags. */
+    uint64_t flags;
+
+    /** The type of each buffer element. */
+    struct halide_type_t type;
+
+    /** The dimensionality of the buffer. */
+    int32_t dimensions;
+
+    /** The shape of the buffer. Halide does not own this array - you
+     * must manage the memory for it yourself. */
+    struct halide_dimension_t *dim;
+
+    /** Pads the buffer up to a multiple of 8 bytes */
+    void *padding;
+} halide_buffer_t;
+
+#endif
+
+/** Fill in the host pointer, device handle, dirty bits, and shape of
+ * new_buf from old_buf. The caller sets the type and the
+ * dimensionality of new_buf and points its dim field at enough
+ * storage first. Returns halide_error_code_bad_elem_size if the
+ * element sizes don't match. */
+extern int halide_upgrade_buffer_t(void *user_context, const char *name,
+                                   const buffer_t *old_buf, halide_buffer_t *new_buf);
+
+/** Fill in the host pointer, device handle, dirty bits, element
+ * size, and shape of old_buf from new_buf. Returns
+ * halide_error_code_too_many_dimensions if new_buf has more than the
+ * four dimensions a buffer_t can describe. */
+extern int halide_downgrade_buffer_t(void *user_context, const char *name,
+                                     const halide_buffer_t *new_buf, buffer_t *old_buf);
+
 /** halide_scalar_value_t is a simple union able to represent all the well-known
  * scalar values in a filter argument. Note that it isn't tagged with a type;
  * you must ensure you know the proper type before accessing. Most user
@@ -1031,8 +1556,28 @@ struct halide_filter_argument_t {
     const struct halide_scalar_value_t *max;
 };
 
+/** Static estimates of the work done per point of one Func of a
+ * filter, where a point is one value stored by its pure definition (all
+ * the values of a Tuple together count as one). The bytes loaded and
+ * stored include those of its update definitions and of the Funcs
+ * inlined into it. The ops count the arithmetic on the values it
+ * stores, per vector lane, but not the arithmetic on addresses. The
+ * compiler makes them from the lowered code, assuming a trip count for
+ * loops of unknown extent, so they are most accurate for stages with
+ * no reductions of unknown size. */
+struct halide_filter_func_metadata_t {
+    /** The name of the Func. */
+    const char *name;
+
+    /** The bytes loaded, bytes stored, and arithmetic operations per
+     * point. */
+    float bytes_loaded, bytes_stored, ops;
+};
+
 struct halide_filter_metadata_t {
-    /** version of this metadata; currently always 0. */
+    /** version of this metadata; 1 for metadata with the num_funcs
+     * and funcs fields, 0 for metadata with only the fields before
+     * them. */
     int32_t version;
 
     /** The number of entries in the arguments field. This is always >= 1. */
@@ -1050,6 +1595,15 @@ struct halide_filter_metadata_t {
 
     /** The function name of the filter. */
     const char* name;
+
+    /** The number of entries in the funcs field. Only present if
+     * version is at least 1. */
+    int32_t num_funcs;
+
+    /** Estimates of the work done by each Func the filter computes,
+     * in order of name. Null if num_funcs is zero. Only present if
+     * version is at least 1. */
+    const struct halide_filter_func_metadata_t* funcs;
 };
 
 /** The functions below here are relevant for pipelines compiled with
@@ -1058,7 +1612,8 @@ struct halide_filter_metadata_t {
 
 /** Per-Func state tracked by the sampling profiler. */
 struct halide_profiler_func_stats {
-    /** Total time taken evaluating this Func (in nanoseconds). */
+    /** Total time taken evaluating this Func (in nanoseconds), summed
+     * over all the threads computing it. */
     uint64_t time;
 
     /** The current memory allocation of this Func. */
@@ -1070,12 +1625,40 @@ struct halide_profiler_func_stats {
     /** The total memory allocation of this Func. */
     uint64_t memory_total;
 
+    /** The memory allocation of this Func when the funcs of all
+     * pipelines together last reached their peak. See memory_peak in
+     * halide_profiler_state. */
+    uint64_t memory_at_peak;
+
     /** The peak stack allocation of this Func's threads. */
     uint64_t stack_peak;
 
-    /** The average number of thread pool worker threads active while computing this Func. */
+    /** The average number of threads computing this Func, over the
+     * samples in which at least one was. */
     uint64_t active_threads_numerator, active_threads_denominator;
 
+    /** Instructions retired, cycles and last-level cache misses while
+     * computing this Func, summed over its threads. Counted exactly
+     * rather than sampled, and only with the profile_counters target
+     * feature on platforms with hardware counters; zero otherwise. For
+     * code offloaded to Hexagon, these are the packets and cycles the
+     * DSP executed, counted on the DSP, and there are no cache
+     * misses. */
+    uint64_t instructions, cycles, cache_misses;
+
+    /** The compiler's estimates of the bytes loaded and stored, and of
+     * the arithmetic operations, per point of this Func (see
+     * halide_filter_func_metadata_t). Zero for the overhead slot, and
+     * for Funcs that store no points. */
+    float bytes_loaded_per_point, bytes_stored_per_point, ops_per_point;
+
+    /** The number of points of this Func computed, counted before each
+     * run of the innermost loop of its pure definition. Together with
+     * the estimates above, the time and the average threads, this gives
+     * the bandwidth and arithmetic throughput it achieved. Counts on
+     * the host only. */
+    uint64_t points;
+
     /** The name of this Func. A global constant string. */
     const char *name;
 
@@ -1083,10 +1666,35 @@ struct halide_profiler_func_stats {
     int num_allocs;
 };
 
+/** A heap allocation or free by a Func, as recorded in the memory
+ * timeline of its pipeline. */
+struct halide_profiler_memory_event {
+    /** When it happened, in nanoseconds since the run of the pipeline
+     * started. */
+    uint64_t time;
+
+    /** The size of the allocation. */
+    uint64_t bytes;
+
+    /** The memory allocation of the funcs in the pipeline just after
+     * it. */
+    uint64_t memory_current;
+
+    /** The index of the Func in the pipeline's funcs. */
+    int func;
+
+    /** Whether it was a free rather than an allocation. */
+    int is_free;
+};
+
+/** The number of allocations and frees the memory timeline of a
+ * pipeline holds. */
+enum { halide_profiler_max_memory_events = 1024 };
+
 /** Per-pipeline state tracked by the sampling profiler. These exist
  * in a linked list. */
 struct halide_profiler_pipeline_stats {
-    /** Total time spent inside this pipeline (in nanoseconds) */
+    /** Total wall-clock time spent inside this pipeline (in nanoseconds) */
     uint64_t time;
 
     /** The current memory allocation of funcs in this pipeline. */
@@ -1102,12 +1710,25 @@ struct halide_profiler_pipeline_stats {
      * work while computing this pipeline. */
     uint64_t active_threads_numerator, active_threads_denominator;
 
+    /** The hardware counters of all the funcs in this pipeline. See
+     * halide_profiler_func_stats. */
+    uint64_t instructions, cycles, cache_misses;
+
     /** The name of this pipeline. A global constant string. */
     const char *name;
 
     /** An array containing states for each Func in this pipeline. */
     struct halide_profiler_func_stats *funcs;
 
+    /** The heap allocations and frees of the last run of this pipeline
+     * to start, in order, up to halide_profiler_max_memory_events of
+     * them. If several runs overlap, their events are mixed. */
+    struct halide_profiler_memory_event *memory_events;
+
+    /** When the last run of this pipeline started, as returned by
+     * halide_current_time_ns. */
+    uint64_t run_start_time;
+
     /** The next pipeline_stats pointer. It's a void * because types
      * in the Halide runtime may not currently be recursive. */
     void *next;
@@ -1126,8 +1747,17 @@ struct halide_profiler_pipeline_stats {
 
     /** The total number of memory allocation of funcs in this pipeline. */
     int num_allocs;
+
+    /** The number of allocations and frees in the last run. Those past
+     * halide_profiler_max_memory_events are counted but not
+     * recorded. */
+    int num_memory_events;
 };
 
+/** The number of threads whose current Func the sampling profiler
+ * can follow at once. */
+enum { halide_profiler_max_threads = 256 };
+
 /** The global state of the profiler. */
 struct halide_profiler_state {
     /** Guards access to the fields below. If not locked, the sampling
@@ -1136,14 +1766,16 @@ struct halide_profiler_state {
     struct halide_mutex lock;
 
     /** The amount of time the profiler thread sleeps between samples
-     * in milliseconds. Defaults to 1 */
+     * in milliseconds. Defaults to 1. Ignored if sleep_time_us is
+     * set. */
     int sleep_time;
 
     /** An internal id used for bookkeeping. */
     int first_free_id;
 
-    /** The id of the current running Func. Set by the pipeline, read
-     * periodically by the profiler thread. */
+    /** The id of the current running Func. Set by code offloaded to
+     * another device, via get_remote_profiler_state below. Code running
+     * on the host uses thread_funcs instead. */
     int current_func;
 
     /** The number of threads currently doing work. */
@@ -1159,6 +1791,48 @@ struct halide_profiler_state {
 
     /** Is the profiler thread running. */
     bool started;
+
+    /** The id of the Func each thread running a pipeline is currently
+     * computing. A thread claims a slot when it enters a pipeline or
+     * starts a parallel task, and sets it to halide_profiler_outside_of_halide
+     * while it waits for tasks it launched. Every sample is billed to the
+     * Func in each claimed slot, so time in parallel loops is attributed to
+     * the Funcs each worker is actually running. Unclaimed slots hold
+     * halide_profiler_slot_free. */
+    int thread_funcs[halide_profiler_max_threads];
+
+    /** Where threads that find no free slot store their current
+     * Func. Never sampled. */
+    int overflow_thread_func;
+
+    /** If non-zero, the amount of time the profiler thread sleeps
+     * between samples in microseconds, for pipelines too short to
+     * sample every millisecond. Each sample costs the profiler thread
+     * a few microseconds, so values below about 10 mostly measure the
+     * profiler itself. */
+    int sleep_time_us;
+
+    /** The memory allocated by the funcs of all pipelines, and the
+     * most it has been. Whenever it reaches a new peak, the
+     * memory_current of every Func is copied to its
+     * memory_at_peak. */
+    uint64_t memory_current, memory_peak;
+
+    /** The pipeline whose allocation reached the peak, and when, in
+     * nanoseconds since the run of it started. */
+    uint64_t memory_peak_time;
+    struct halide_profiler_pipeline_stats *memory_peak_pipeline;
+
+    /** The peak memory bandwidth of the machine, in bytes per
+     * nanosecond (i.e. GB/s), and its peak arithmetic throughput, in
+     * operations per nanosecond, using all its cores, e.g. as measured
+     * by test/performance/roofline.cpp. If both are set, the report
+     * shows how much of the throughput attainable at its arithmetic
+     * intensity, under the roofline model, each Func achieved. If zero,
+     * they are read from the HL_PEAK_BANDWIDTH and HL_PEAK_OPS
+     * environment variables (as integers in the same units) when the
+     * report is made. */
+    double peak_bytes_per_ns, peak_ops_per_ns;
 };
 
 /** Profiler func ids with special meanings. */
@@ -1168,7 +1842,9 @@ enum {
     /// Set current_func to this value to tell the profiling thread to
     /// halt. It will start up again next time you run a pipeline with
     /// profiling enabled.
-    halide_profiler_please_stop = -2
+    halide_profiler_please_stop = -2,
+    /// An entry in thread_funcs that no thread has claimed.
+    halide_profiler_slot_free = -3
 };
 
 /** Get a pointer to the global profiler state for programmatic
@@ -1179,7 +1855,9 @@ extern struct halide_profiler_state *halide_profiler_get_state();
  * This function grabs the global profiler state's lock on entry. */
 extern struct halide_profiler_pipeline_stats *halide_profiler_get_pipeline_state(const char *pipeline_name);
 
-/** Reset all profiler state.
+/** Reset all profiler state. The pipelines stay registered, as
+ * generated code caches pointers to their stats, but with all their
+ * counts zeroed.
  * WARNING: Do NOT call this method while any halide pipeline is
  * running; halide_profiler_memory_allocate/free and
  * halide_profiler_stack_peak_update update the profiler pipeline's
@@ -1190,6 +1868,53 @@ extern void halide_profiler_reset();
  * reset. Also happens at process exit. */
 extern void halide_profiler_report(void *user_context);
 
+/** The machine-readable formats halide_profiler_format_report can
+ * produce. */
+typedef enum halide_profiler_report_format_t {
+    /** A JSON object with a "pipelines" array, holding the fields of
+     * each halide_profiler_pipeline_stats, and per pipeline a "funcs"
+     * array holding the fields of each halide_profiler_func_stats
+     * and a "memory_events" array holding its memory timeline. A
+     * "memory_peak" object holds the peak of all pipelines. Times are
+     * in nanoseconds. */
+    halide_profiler_report_json = 0,
+    /** The Chrome trace event format, as loaded by chrome://tracing
+     * and Perfetto. The profiler keeps totals rather than a timeline,
+     * so each pipeline is one event spanning its total time, with its
+     * Funcs laid out back to back on a track of their own below it,
+     * each spanning its time summed over threads. The memory timeline
+     * of each pipeline is a counter of its memory allocation. */
+    halide_profiler_report_chrome_trace = 1
+} halide_profiler_report_format_t;
+
+/** Write the statistics for everything run since the last reset to
+ * buf in the given format, as a null-terminated string. Like
+ * snprintf, returns the length of the full report (not counting the
+ * terminator) even if it didn't fit in size bytes, so call it with a
+ * NULL buf to find the size to allocate. Returns a negative error
+ * code if the format is unknown. This function grabs the global
+ * profiler state's lock on entry. */
+extern int halide_profiler_format_report(void *user_context, halide_profiler_report_format_t format,
+                                         char *buf, size_t size);
+
+/** Pipelines compiled with the pgo_instrument target feature count,
+ * for every branch and serial loop, how often it was reached and how
+ * often it was taken, and register their counters with this function
+ * when they run. name is the name of the function the counters belong
+ * to. At process exit, the counters are appended to the file named by
+ * the environment variable HL_PGO_PROFILE, or "halide.pgo" if it isn't
+ * set. Recompile with Outputs::pgo_profile naming that file to lay out
+ * the code for the branches seen. */
+extern int halide_pgo_register(void *user_context, const char *name,
+                               uint64_t *counters, int num_counters);
+
+/** Append the profile counted so far to the given file, in the form
+ * read by Outputs::pgo_profile. */
+extern int halide_pgo_write_profile(void *user_context, const char *filename);
+
+/** Zero all profile counters. */
+extern void halide_pgo_reset();
+
 /// \name "Float16" functions
 /// These functions operate of bits (``uint16_t``) representing a half
 /// precision floating point number (IEEE-754 2008 binary16).
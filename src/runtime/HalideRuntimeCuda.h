@@ -33,6 +33,30 @@ extern int halide_cuda_run(void *user_context,
                            int num_coords_dim1);
 // @}
 
+/** Get the CUDA context to run on behalf of this user_context in,
+ * creating it if create is true and it doesn't exist yet, and release
+ * it again. The default implementation shares one context between all
+ * user_contexts and threads, without serializing them. Override both
+ * to supply your own contexts, e.g. one per device, returning the one
+ * for the device a user_context should run on. They may be called
+ * from several threads at once. */
+// @{
+extern int halide_cuda_acquire_context(void *user_context, struct CUctx_st **ctx, bool create);
+extern int halide_cuda_release_context(void *user_context);
+// @}
+
+/** Get the CUDA stream that copies and kernel launches made on behalf
+ * of this user_context are issued to. Called with the context
+ * returned by halide_cuda_acquire_context current, possibly from
+ * several threads at once. The
+ * default implementation lazily creates one stream per user_context
+ * (a NULL user_context uses the legacy default stream), so that
+ * halide_device_sync only waits for the calling pipeline's work.
+ * Buffers handed between pipelines running with different
+ * user_contexts must be synchronized with halide_device_sync in
+ * between. Override this to issue work to a stream you own. */
+extern int halide_cuda_get_stream(void *user_context, struct CUctx_st *ctx, struct CUstream_st **stream);
+
 /** Set the underlying cuda device poiner for a buffer. The device
  * pointer should be allocated using cuMemAlloc or similar and must
  * have an extent large enough to cover that specified by the buffer_t
@@ -59,6 +83,26 @@ extern uintptr_t halide_cuda_detach_device_ptr(void *user_context, struct buffer
  */
 extern uintptr_t halide_cuda_get_device_ptr(void *user_context, struct buffer_t *buf);
 
+/** Free any device allocations the runtime has cached for reuse on
+ * the current context. Freed device buffers are normally kept, bucketed
+ * by size, and handed back out to later allocations to avoid the cost
+ * of going to the driver; they are also released by
+ * halide_device_release, and when an allocation fails for lack of
+ * device memory. */
+extern int halide_cuda_release_unused_device_allocations(void *user_context);
+
+/** Called by generated code around a gpu_blocks loop split across
+ * devices with Func::gpu_devices. halide_cuda_set_launch_device
+ * selects which slice the next halide_cuda_run belongs to: slice 0
+ * runs on the current context's device, and others run on peer
+ * devices round-robin, falling back to the current device if peer
+ * access isn't available. halide_cuda_join_devices makes later work
+ * issued by this user_context wait for the slices run on peers. */
+// @{
+extern int halide_cuda_set_launch_device(void *user_context, int device);
+extern int halide_cuda_join_devices(void *user_context);
+// @}
+
 #ifdef __cplusplus
 } // End extern "C"
 #endif
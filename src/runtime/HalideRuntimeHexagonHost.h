@@ -29,6 +29,26 @@ extern bool halide_is_hexagon_available(void *user_context);
 extern int halide_hexagon_wrap_device_handle(void *user_context, struct buffer_t *buf,
                                              void *ptr, uint64_t size);
 
+/** Wrap memory allocated by the caller from ION (e.g. a camera frame)
+ * as the device handle of a buffer_t, as with
+ * halide_hexagon_wrap_device_handle, and register it with FastRPC so
+ * that Hexagon can access it without a copy or a mapping on each
+ * call. fd is the ION file descriptor of the memory. If the host
+ * field of the buffer_t is NULL, it is set to ptr. The registration
+ * is cached, so wrapping the same memory again (e.g. each frame) is
+ * cheap. The memory still belongs to the caller;
+ * halide_hexagon_device_free only detaches it. The allocation should
+ * extend 128 bytes beyond the end of the buffer, as Hexagon code may
+ * load a vector past the last element. */
+extern int halide_hexagon_wrap_ion_buffer(void *user_context, struct buffer_t *buf,
+                                          void *ptr, uint64_t size, int fd);
+
+/** Release the registration of memory previously passed to
+ * halide_hexagon_wrap_ion_buffer. Call this before freeing the
+ * memory. All registrations are also released by
+ * halide_hexagon_device_release. */
+extern int halide_hexagon_release_ion_buffer(void *user_context, void *ptr);
+
 /** Disconnect this buffer_t from the device handle it was previously
  * wrapped around. Should only be called for a buffer_t that
  * halide_hexagon_wrap_device_handle was previously called on. Frees any
@@ -91,6 +111,41 @@ extern int halide_hexagon_power_hvx_off(void *user_context);
 extern void halide_hexagon_power_hvx_off_as_destructor(void *user_context, void * /* obj */);
 // @}
 
+/** A policy for powering HVX on automatically around pipeline runs,
+ * rather than with explicit calls to the functions above. While a
+ * policy is set, the runtime keeps HVX powered on from the first run
+ * until hold_time_us after the last one, so runs close together
+ * don't each pay to power it on. It picks a power mode for each
+ * pipeline from its recent run times: a pipeline starts in max_mode,
+ * steps down a mode (to no lower than min_mode) while its average
+ * run time is under step_down_percent of target_run_time_us, and
+ * steps back up while it's over the target. The gap between the two
+ * thresholds keeps it from switching modes on every run. With a
+ * target_run_time_us of 0, pipelines always run in max_mode. */
+typedef struct {
+    halide_hvx_power_mode_t min_mode, max_mode;
+    uint64_t target_run_time_us;
+    int step_down_percent;
+    uint64_t hold_time_us;
+} halide_hvx_power_policy_t;
+
+/** Set the policy for powering HVX on around pipeline runs, or
+ * remove it if policy is NULL. The policy is copied. A vote held by
+ * the caller with halide_hexagon_power_hvx_on* takes precedence over
+ * the policy's mode until it is released. */
+extern int halide_hexagon_set_power_policy(void *user_context, const halide_hvx_power_policy_t *policy);
+
+/** Set the size of the arenas that the DSP serves the allocations of
+ * offloaded code from (for example, of Funcs computed per scanline
+ * inside the offloaded loops). There is one arena per DSP thread
+ * running Halide code. Allocations that don't fit in an arena come
+ * from the DSP heap, so an arena a little larger than the working set
+ * of one thread makes repeated runs allocation-free on the DSP. The
+ * arenas are reserved the next time halide_hexagon_initialize_kernels
+ * is called, i.e. at the start of the next pipeline call that
+ * offloads to Hexagon. A size of 0 restores the default, 256KB. */
+extern int halide_hexagon_set_arena_size(void *user_context, uint64_t bytes_per_thread);
+
 /** These are forward declared here to allow clients to override the
  *  Halide Hexagon runtime. Do not call them. */
 // @{
@@ -104,6 +159,14 @@ extern int halide_hexagon_run(void *user_context,
                               uint64_t arg_sizes[],
                               void *args[],
                               int arg_flags[]);
+extern int halide_hexagon_run_async(void *user_context,
+                                    void *module_ptr,
+                                    const char *name,
+                                    halide_hexagon_handle_t *function,
+                                    uint64_t arg_sizes[],
+                                    void *args[],
+                                    int arg_flags[]);
+extern int halide_hexagon_wait(void *user_context);
 extern int halide_hexagon_device_release(void* user_context);
 // @}
 
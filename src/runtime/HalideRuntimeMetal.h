@@ -34,6 +34,13 @@ extern int halide_metal_run(void *user_context,
                             int num_coords_dim1);
 // @}
 
+// Kernel launches are batched into a shared command buffer, which is
+// committed only when a copy or device sync needs its results, or when
+// the buffer is detached. Call halide_device_sync with a NULL buffer
+// before encoding work of your own on the same queue that depends on
+// Halide's output without going through a copy. At most three
+// committed command buffers are in flight at a time.
+
 /** Set the underlying MTLBuffer for a buffer_t. This memory should be
  * allocated using newBufferWithLength:options or similar and must
  * have an extent large enough to cover that specified by the buffer_t
@@ -43,6 +50,20 @@ extern int halide_metal_run(void *user_context,
  * are left unmodified. */
 extern int halide_metal_wrap_buffer(void *user_context, struct buffer_t *buf, uintptr_t buffer);
 
+/** Use the host memory of a buffer_t in place as its device memory,
+ * by wrapping it in a shared-storage MTLBuffer made with
+ * newBufferWithBytesNoCopy. This is meant for memory such as the
+ * planes of a locked, IOSurface-backed CVPixelBuffer from the camera,
+ * so that frames reach Metal kernels without being copied. The host
+ * pointer must be page-aligned, the memory must extend to the end of
+ * the page holding the last element, and the strides must be
+ * non-negative. The memory still belongs to the caller and must stay
+ * valid (and the pixel buffer locked) until halide_device_free is
+ * called on the buffer_t, which releases the MTLBuffer but not the
+ * memory. The dev field of the buffer_t must be NULL when this routine
+ * is called. The device and host dirty bits are left unmodified. */
+extern int halide_metal_wrap_host_memory(void *user_context, struct buffer_t *buf);
+
 /** Disconnect a buffer_t from the memory it was previously wrapped
  * around. Should only be called for a buffer_t that
  * halide_metal_wrap_buffer was previously called on. Frees any
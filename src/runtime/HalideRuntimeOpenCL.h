@@ -61,6 +61,25 @@ extern void halide_opencl_set_device_type(const char *n);
  * halide_set_ocl_device_type. */
 extern const char *halide_opencl_get_device_type(void *user_context);
 
+/** Ask for an out-of-order command queue when the OpenCL context is
+ * created, if the device supports one. Must be called before the
+ * context is created to have any effect. Halide orders the commands
+ * it enqueues with events according to the buffers they use, so
+ * independent kernels and copies may then overlap. If never called,
+ * Halide uses the environment variable HL_OCL_OUT_OF_ORDER_QUEUE. */
+extern void halide_opencl_set_out_of_order_queue(bool enable);
+
+/** Choose whether halide_opencl_initialize_kernels builds the program
+ * of a pipeline on a background thread. If so, the pipeline returns
+ * from initializing its kernels straight away, and its first kernel
+ * launch waits only for whatever of the build is still left by then,
+ * so the build overlaps with the pipeline's host work. Build errors
+ * are then reported by the launch. Programs loaded from the kernel
+ * cache (see halide_set_gpu_kernel_cache_dir) need no build. If never
+ * called, background builds are on unless the environment variable
+ * HL_OCL_BACKGROUND_BUILD is set to 0. */
+extern void halide_opencl_set_background_build(bool enable);
+
 /** Set the underlying cl_mem for a buffer_t. This memory should be
  * allocated using clCreateBuffer or similar and must have an extent
  * large enough to cover that specified by the buffer_t extent
@@ -87,6 +106,33 @@ extern uintptr_t halide_opencl_detach_cl_mem(void *user_context, struct buffer_t
  */
 extern uintptr_t halide_opencl_get_cl_mem(void *user_context, struct buffer_t *buf);
 
+/** Use the host memory of a buffer_t in place as its device memory,
+ * by wrapping it in a CL_MEM_USE_HOST_PTR buffer. This is meant for
+ * memory the caller owns and refills, such as the planes of camera
+ * frames, on devices that share memory with the host; the strides may
+ * be anything non-negative (e.g. a YUV_420_888 chroma plane with a
+ * pixel stride of 2). The wrapping is kept after the buffer_t is
+ * freed, keyed by host pointer and size, so wrapping the same memory
+ * again (e.g. when the camera recycles a frame) reuses it, and treats
+ * whatever the host has written since as the new contents. The dev
+ * field of the buffer_t must be NULL when this routine is called. The
+ * device and host dirty bits are left unmodified. */
+extern int halide_opencl_wrap_host_memory(void *user_context, struct buffer_t *buf);
+
+/** Release the wrappings made by halide_opencl_wrap_host_memory for
+ * the given host pointer. Call this before the memory is freed, once
+ * no buffer_t uses it. All wrappings are also released by
+ * halide_device_release. */
+extern int halide_opencl_release_host_memory(void *user_context, void *host);
+
+/** Free any device allocations the runtime has cached for reuse on
+ * the current context. Freed device buffers are normally kept, bucketed
+ * by size, and handed back out to later allocations to avoid the cost
+ * of going to the driver; they are also released by
+ * halide_device_release, and when an allocation fails for lack of
+ * device memory. */
+extern int halide_opencl_release_unused_device_allocations(void *user_context);
+
 #ifdef __cplusplus
 } // End extern "C"
 #endif
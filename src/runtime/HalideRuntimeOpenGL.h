@@ -67,6 +67,16 @@ extern uintptr_t halide_opengl_detach_texture(void *user_context, struct buffer_
  */
 extern uintptr_t halide_opengl_get_texture(void *user_context, struct buffer_t *buf);
 
+/** Once the host has copied an output texture back, later kernels that
+ * write it start reading it into a pixel buffer object as soon as they
+ * are drawn, and halide_copy_to_host only waits for that read to
+ * finish (on OpenGL 3.2 and OpenGL ES 3.0 and later). By default each
+ * texture reads back into a single buffer. With double buffering,
+ * consecutive frames alternate between two, so that a frame's readback
+ * never has to wait for the driver to release the buffer the previous
+ * frame was read into. Must be set before the textures are read back. */
+extern void halide_opengl_set_double_buffered_readback(bool double_buffered);
+
 /** Forget all state associated with the previous OpenGL context.  This is
  * similar to halide_opengl_release, except that we assume that all OpenGL
  * resources have already been reclaimed by the OS. */
@@ -20,6 +20,14 @@ extern int halide_qurt_hvx_unlock(void *user_context);
 extern void halide_qurt_hvx_unlock_as_destructor(void *user_context, void * /*obj*/);
 // @}
 
+/** Allocate and free memory in VTCM (vector tightly coupled memory),
+ * used for Funcs stored in MemoryType::VTCM. If the DSP has no VTCM,
+ * or not enough of it is free, this falls back to halide_malloc. */
+// @{
+extern void *halide_vtcm_malloc(void *user_context, size_t x);
+extern void halide_vtcm_free(void *user_context, void *ptr);
+// @}
+
 #ifdef __cplusplus
 } // End extern "C"
 #endif
@@ -0,0 +1,179 @@
+#ifndef HALIDE_ADAPTIVE_PAR_FOR_H
+#define HALIDE_ADAPTIVE_PAR_FOR_H
+
+#include "scoped_spin_lock.h"
+
+// Guided self-scheduling of parallel loops scheduled with
+// Func::parallel_adaptive, shared by the thread pool
+// implementations. The loop is run by one task per worker on top of
+// halide_do_par_for. Each task repeatedly claims a chunk of the
+// remaining iterations, starting with large chunks and shrinking them
+// as the loop runs out, so that the workers finish at about the same
+// time without paying for a task per iteration. The time taken per
+// iteration is remembered for each loop, and puts a lower bound on
+// the chunk size the next time the loop runs, so that no chunk is too
+// small to be worth the overhead of claiming it.
+
+namespace Halide { namespace Runtime { namespace Internal {
+
+// The shortest chunk of work worth claiming, in nanoseconds.
+#define ADAPTIVE_MIN_CHUNK_NS 20000
+
+// The measured cost of each loop, keyed by its task function, which
+// is unique to the loop. A loop that doesn't fit in the table just
+// isn't measured.
+#define MAX_ADAPTIVE_SITES 64
+struct adaptive_site {
+    halide_loop_task_t f;
+    int64_t ns;
+    int64_t iterations;
+};
+
+WEAK adaptive_site adaptive_sites[MAX_ADAPTIVE_SITES];
+WEAK volatile int adaptive_sites_lock = 0;
+
+struct adaptive_loop {
+    halide_loop_task_t f;
+    uint8_t *closure;
+    // The next unclaimed iteration. Only advanced with a compare
+    // and swap.
+    volatile int next;
+    int end;
+    int num_workers;
+    int min_chunk;
+    volatile int exit_status;
+    adaptive_site *site;
+};
+
+// Find (or add) the entry for a loop. Returns NULL if the table is
+// full.
+WEAK adaptive_site *find_adaptive_site(halide_loop_task_t f) {
+    ScopedSpinLock lock(&adaptive_sites_lock);
+    uintptr_t h = (uintptr_t)f;
+    h ^= h >> 16;
+    for (int i = 0; i < MAX_ADAPTIVE_SITES; i++) {
+        adaptive_site *s = &adaptive_sites[(h + i) % MAX_ADAPTIVE_SITES];
+        if (s->f == f) {
+            return s;
+        }
+        if (s->f == NULL) {
+            s->f = f;
+            s->ns = 0;
+            s->iterations = 0;
+            return s;
+        }
+    }
+    return NULL;
+}
+
+WEAK void record_adaptive_site(adaptive_site *s, int64_t ns, int64_t iterations) {
+    if (s == NULL || iterations == 0) {
+        return;
+    }
+    ScopedSpinLock lock(&adaptive_sites_lock);
+    s->ns += ns;
+    s->iterations += iterations;
+    // Decay the old measurements, so that the estimate follows
+    // changes in the per-iteration cost, e.g. when the loop is run on
+    // inputs of a different size.
+    while (s->iterations > (1 << 20)) {
+        s->ns /= 2;
+        s->iterations /= 2;
+    }
+}
+
+WEAK int adaptive_min_chunk(adaptive_site *s) {
+    if (s == NULL) {
+        return 1;
+    }
+    ScopedSpinLock lock(&adaptive_sites_lock);
+    if (s->iterations == 0 || s->ns <= 0) {
+        return 1;
+    }
+    int64_t ns_per_iteration = s->ns / s->iterations;
+    if (ns_per_iteration < 1) {
+        ns_per_iteration = 1;
+    }
+    int64_t c = ADAPTIVE_MIN_CHUNK_NS / ns_per_iteration;
+    if (c < 1) c = 1;
+    if (c > 0x7fffffff) c = 0x7fffffff;
+    return (int)c;
+}
+
+// Claim the next chunk of the loop. Returns false once every
+// iteration has been claimed or some chunk has failed.
+WEAK bool claim_adaptive_chunk(adaptive_loop *loop, int *min, int *extent) {
+    while (true) {
+        int start = loop->next;
+        int remaining = loop->end - start;
+        if (remaining <= 0 || loop->exit_status) {
+            return false;
+        }
+        // Take a share of what's left, so that chunks shrink
+        // geometrically towards the end of the loop.
+        int n = loop->num_workers > 1 ? remaining / (2 * loop->num_workers) : remaining;
+        if (n < loop->min_chunk) n = loop->min_chunk;
+        if (n > remaining) n = remaining;
+        if (__sync_bool_compare_and_swap(&loop->next, start, start + n)) {
+            *min = start;
+            *extent = n;
+            return true;
+        }
+    }
+}
+
+WEAK int adaptive_loop_task(void *user_context, int idx, uint8_t *closure) {
+    adaptive_loop *loop = (adaptive_loop *)closure;
+    int64_t ns = 0, iterations = 0;
+    int min, extent, result = 0;
+    while (claim_adaptive_chunk(loop, &min, &extent)) {
+        result = halide_cancellation_check(user_context);
+        if (result == 0) {
+            int64_t t0 = halide_current_time_ns(user_context);
+            result = loop->f(user_context, min, extent, loop->closure);
+            ns += halide_current_time_ns(user_context) - t0;
+            iterations += extent;
+        }
+        if (result) {
+            loop->exit_status = result;
+            break;
+        }
+    }
+    record_adaptive_site(loop->site, ns, iterations);
+    return result;
+}
+
+WEAK int do_par_for_adaptive(void *user_context, halide_loop_task_t f,
+                             int min, int size, uint8_t *closure, int num_workers) {
+    if (size <= 0) {
+        return 0;
+    }
+    halide_start_clock(user_context);
+
+    adaptive_loop loop;
+    loop.f = f;
+    loop.closure = closure;
+    loop.next = min;
+    loop.end = min + size;
+    loop.exit_status = 0;
+    loop.site = find_adaptive_site(f);
+    loop.min_chunk = adaptive_min_chunk(loop.site);
+
+    // Don't wake up more workers than there are chunks worth running.
+    int tasks = (int)(((int64_t)size + loop.min_chunk - 1) / loop.min_chunk);
+    if (tasks > num_workers) tasks = num_workers;
+    if (tasks < 1) tasks = 1;
+    loop.num_workers = tasks;
+
+    int result;
+    if (tasks == 1) {
+        result = adaptive_loop_task(user_context, 0, (uint8_t *)&loop);
+    } else {
+        result = halide_do_par_for(user_context, adaptive_loop_task, 0, tasks, (uint8_t *)&loop);
+    }
+    return result ? result : loop.exit_status;
+}
+
+}}} // namespace Halide::Runtime::Internal
+
+#endif
@@ -1,12 +1,31 @@
 #include "HalideRuntime.h"
+#include "runtime_internal.h"
 
 extern "C" {
 
 extern long sysconf(int);
+extern int sched_setaffinity(int pid, size_t cpusetsize, const void *mask);
 
 WEAK int halide_host_cpu_count() {
     // Works for Android ARMv7. Probably bogus on other platforms.
     return sysconf(97);
 }
 
+WEAK int halide_host_cpu_numa_node(int cpu) {
+    // Android devices are single-node.
+    return 0;
+}
+
+WEAK int halide_pin_current_thread_to_cpu(int cpu) {
+    // Large enough for a cpu_set_t on 1024 cpus.
+    uint64_t mask[16];
+    if (cpu < 0 || cpu >= 1024) {
+        return -1;
+    }
+    memset(mask, 0, sizeof(mask));
+    mask[cpu / 64] = ((uint64_t)1) << (cpu % 64);
+    // A pid of zero means the calling thread.
+    return sched_setaffinity(0, sizeof(mask), mask);
+}
+
 }
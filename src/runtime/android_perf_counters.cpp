@@ -0,0 +1,11 @@
+#ifdef BITS_64
+#define SYS_PERF_EVENT_OPEN 241
+#define SYS_GETTID 178
+#endif
+
+#ifdef BITS_32
+#define SYS_PERF_EVENT_OPEN 364
+#define SYS_GETTID 224
+#endif
+
+#include "linux_perf_counters.cpp"
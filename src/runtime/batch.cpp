@@ -0,0 +1,65 @@
+#include "HalideRuntime.h"
+
+namespace Halide { namespace Runtime { namespace Internal {
+
+struct batch_closure {
+    int (*argv_func)(void **);
+    void ***args;
+    int *results;
+};
+
+WEAK int batch_task(void *user_context, int idx, uint8_t *closure) {
+    batch_closure *batch = (batch_closure *)closure;
+    int result = batch->argv_func(batch->args[idx]);
+    if (batch->results) {
+        batch->results[idx] = result;
+    }
+    // Don't let one failing call cancel the rest of the batch.
+    return 0;
+}
+
+}}} // namespace Halide::Runtime::Internal
+
+using namespace Halide::Runtime::Internal;
+
+extern "C" {
+
+WEAK int halide_do_batch(void *user_context, int (*argv_func)(void **),
+                         void **args[], int count, int *results) {
+    if (count <= 0) {
+        return 0;
+    }
+
+    // If the caller doesn't want the individual results, we still
+    // need somewhere to put them to find the first failure.
+    int stack_results[64];
+    int *heap_results = NULL;
+    int *r = results;
+    if (!r) {
+        if (count <= 64) {
+            r = stack_results;
+        } else {
+            heap_results = (int *)halide_malloc(user_context, count * sizeof(int));
+            if (!heap_results) {
+                return halide_error_code_out_of_memory;
+            }
+            r = heap_results;
+        }
+    }
+
+    batch_closure batch;
+    batch.argv_func = argv_func;
+    batch.args = args;
+    batch.results = r;
+    int result = halide_do_par_for(user_context, batch_task, 0, count, (uint8_t *)&batch);
+    for (int i = 0; result == 0 && i < count; i++) {
+        result = r[i];
+    }
+
+    if (heap_results) {
+        halide_free(user_context, heap_results);
+    }
+    return result;
+}
+
+}
@@ -58,4 +58,63 @@ buffer_t *_halide_buffer_init(buffer_t *dst, uint8_t *host, uint64_t dev, int /*
     return dst;
 }
     
+// The functions below convert between buffer_t and halide_buffer_t,
+// and are part of the public API.
+
+__attribute__((weak))
+int halide_upgrade_buffer_t(void *user_context, const char *name,
+                            const buffer_t *old_buf, halide_buffer_t *new_buf) {
+    int elem_size = (new_buf->type.bits + 7) / 8;
+    if (old_buf->elem_size != elem_size) {
+        return halide_error_bad_elem_size(user_context, name, "halide_buffer_t",
+                                          old_buf->elem_size, elem_size);
+    }
+    new_buf->host = old_buf->host;
+    new_buf->device = old_buf->dev;
+    new_buf->flags = 0;
+    if (old_buf->host_dirty) {
+        new_buf->flags |= halide_buffer_flag_host_dirty;
+    }
+    if (old_buf->dev_dirty) {
+        new_buf->flags |= halide_buffer_flag_device_dirty;
+    }
+    for (int i = 0; i < new_buf->dimensions; i++) {
+        if (i < 4) {
+            new_buf->dim[i].min = old_buf->min[i];
+            new_buf->dim[i].extent = old_buf->extent[i];
+            new_buf->dim[i].stride = old_buf->stride[i];
+        } else {
+            new_buf->dim[i].min = 0;
+            new_buf->dim[i].extent = 1;
+            new_buf->dim[i].stride = 0;
+        }
+    }
+    return 0;
+}
+
+__attribute__((weak))
+int halide_downgrade_buffer_t(void *user_context, const char *name,
+                              const halide_buffer_t *new_buf, buffer_t *old_buf) {
+    if (new_buf->dimensions > 4) {
+        return halide_error_too_many_dimensions(user_context, name, new_buf->dimensions);
+    }
+    old_buf->host = new_buf->host;
+    old_buf->dev = new_buf->device;
+    old_buf->elem_size = (new_buf->type.bits + 7) / 8;
+    old_buf->host_dirty = (new_buf->flags & halide_buffer_flag_host_dirty) != 0;
+    old_buf->dev_dirty = (new_buf->flags & halide_buffer_flag_device_dirty) != 0;
+    for (int i = 0; i < 4; i++) {
+        if (i < new_buf->dimensions) {
+            old_buf->min[i] = new_buf->dim[i].min;
+            old_buf->extent[i] = new_buf->dim[i].extent;
+            old_buf->stride[i] = new_buf->dim[i].stride;
+        } else {
+            old_buf->min[i] = 0;
+            old_buf->extent[i] = 0;
+            old_buf->stride[i] = 0;
+        }
+    }
+    return 0;
+}
+
 }
@@ -3,12 +3,11 @@
 #include "printer.h"
 #include "scoped_mutex_lock.h"
 
-// This is temporary code. In particular, the hash table is stupid and
-// currently thread safety is accomplished via large granularity spin
-// locks. It is mainly intended to prove the programming model and
-// runtime interface for memoization. We'll improve the implementation
-// later. In the meantime, on some platforms it can be replaced by a
-// platform specific LRU cache such as libcache from Apple.
+// A sharded LRU cache. Each shard has its own lock, so memoized stages
+// computed concurrently (e.g. inside parallel loops) only contend when
+// their keys land in the same shard. On some platforms it can be
+// replaced by a platform specific LRU cache such as libcache from
+// Apple.
 
 namespace Halide { namespace Runtime { namespace Internal {
 
@@ -75,6 +74,64 @@ WEAK bool bounds_equal(const buffer_t &buf1, const buffer_t &buf2) {
     return true;
 }
 
+// Whether the region of buf1 contains the region of buf2, in every
+// dimension either uses.
+WEAK bool bounds_contain(const buffer_t &buf1, const buffer_t &buf2) {
+    if (buf1.elem_size != buf2.elem_size)
+        return false;
+    for (size_t i = 0; i < 4; i++) {
+        if ((buf1.extent[i] == 0) != (buf2.extent[i] == 0) ||
+            buf1.min[i] > buf2.min[i] ||
+            buf1.min[i] + buf1.extent[i] < buf2.min[i] + buf2.extent[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Copy the elements in both src and dst from src to dst. The two may
+// have different strides.
+WEAK void copy_overlap(const buffer_t &src, const buffer_t &dst) {
+    int32_t lo[4], extent[4];
+    int64_t src_offset = 0, dst_offset = 0;
+    for (int i = 0; i < 4; i++) {
+        if (src.extent[i] == 0) {
+            lo[i] = 0;
+            extent[i] = 1;
+            continue;
+        }
+        lo[i] = max(src.min[i], dst.min[i]);
+        int32_t hi = min(src.min[i] + src.extent[i], dst.min[i] + dst.extent[i]);
+        if (hi <= lo[i]) {
+            return;
+        }
+        extent[i] = hi - lo[i];
+        src_offset += (int64_t)(lo[i] - src.min[i]) * src.stride[i];
+        dst_offset += (int64_t)(lo[i] - dst.min[i]) * dst.stride[i];
+    }
+    const int32_t elem_size = src.elem_size;
+    // Copy rows with memcpy when they're dense in both.
+    bool dense_rows = src.stride[0] == 1 && dst.stride[0] == 1;
+    for (int32_t w = 0; w < extent[3]; w++) {
+        for (int32_t z = 0; z < extent[2]; z++) {
+            for (int32_t y = 0; y < extent[1]; y++) {
+                const uint8_t *from = src.host + elem_size * (src_offset + (int64_t)y * src.stride[1] +
+                                                             (int64_t)z * src.stride[2] + (int64_t)w * src.stride[3]);
+                uint8_t *to = dst.host + elem_size * (dst_offset + (int64_t)y * dst.stride[1] +
+                                                     (int64_t)z * dst.stride[2] + (int64_t)w * dst.stride[3]);
+                if (dense_rows) {
+                    memcpy(to, from, (size_t)extent[0] * elem_size);
+                } else {
+                    for (int32_t x = 0; x < extent[0]; x++) {
+                        memcpy(to + (int64_t)x * dst.stride[0] * elem_size,
+                               from + (int64_t)x * src.stride[0] * elem_size, elem_size);
+                    }
+                }
+            }
+        }
+    }
+}
+
 // Each host block has extra space to store a header just before the contents.
 // 16 is chosen to keep that alignment.
 // The header holds the cache key hash and pointer to the hash entry.
@@ -83,6 +140,21 @@ WEAK bool bounds_equal(const buffer_t &buf1, const buffer_t &buf2) {
 // to operate.
 const size_t extra_bytes_host_bytes = 16;
 
+// Per-Func bookkeeping, shared by all cache entries of a Func. Never
+// freed before halide_memoization_cache_cleanup.
+struct MemoizedFunc {
+    MemoizedFunc *next;
+    char *pipeline_name;
+    char *func_name;
+    // Zero means no per-Func limit.
+    int64_t max_bytes;
+    // The total size of this Func's entries, and the statistics
+    // reported by halide_memoization_cache_get_stats. Only modified
+    // with atomic operations.
+    int64_t cached_bytes;
+    uint64_t hits, misses, evictions, bytes_stored, hash_time_ns;
+};
+
 struct CacheEntry {
     CacheEntry *next;
     CacheEntry *more_recent;
@@ -92,6 +164,12 @@ struct CacheEntry {
     uint32_t hash;
     uint32_t in_use_count; // 0 if none returned from halide_cache_lookup
     uint32_t tuple_count;
+    // Used to decide what to evict: entries that took longer to
+    // compute per byte of storage are kept longer.
+    MemoizedFunc *func;
+    int64_t size;
+    uint64_t compute_time_ns;
+    int32_t priority;
     buffer_t computed_bounds;
     buffer_t buf[1];
     // ADDITIONAL buffer_t STRUCTS HERE
@@ -107,6 +185,9 @@ struct CacheEntry {
 struct CacheBlockHeader {
     CacheEntry *entry;
     uint32_t hash;
+    // When the lookup that missed happened, in microseconds (modulo
+    // 2^32). Used to measure how long the result took to compute.
+    uint32_t start_time_us;
 };
 
 WEAK CacheBlockHeader *get_pointer_to_header(uint8_t * host) {
@@ -123,6 +204,10 @@ WEAK bool CacheEntry::init(const uint8_t *cache_key, size_t cache_key_size,
     hash = key_hash;
     in_use_count = 0;
     tuple_count = tuples;
+    func = NULL;
+    size = 0;
+    compute_time_ns = 0;
+    priority = 0;
 
     key = (uint8_t *)halide_malloc(NULL, key_size);
     if (key == NULL) {
@@ -161,34 +246,64 @@ WEAK uint32_t djb_hash(const uint8_t *key, size_t key_size)  {
     return h;
 }
 
-WEAK halide_mutex memoization_lock;
-
-const size_t kHashTableSize = 256;
-
-WEAK CacheEntry *cache_entries[kHashTableSize];
+// The cache is divided into shards, each with its own lock, hash
+// table, and LRU list, so that concurrent lookups of different keys
+// rarely contend. An entry's shard is chosen by the high bits of its
+// hash, and its bucket within the shard by the low bits.
+const size_t kNumShards = 16;
+const int32_t kDefaultNumBuckets = 4096;
+
+struct CacheShard {
+    halide_mutex lock;
+    // Allocated on first use, with num_buckets_per_shard entries.
+    CacheEntry **entries;
+    size_t num_buckets;
+    CacheEntry *most_recently_used;
+    CacheEntry *least_recently_used;
+};
 
-WEAK CacheEntry *most_recently_used = NULL;
-WEAK CacheEntry *least_recently_used = NULL;
+WEAK CacheShard cache_shards[kNumShards];
+WEAK size_t num_buckets_per_shard = kDefaultNumBuckets / kNumShards;
 
 const uint64_t kDefaultCacheSize = 1 << 20;
 WEAK int64_t max_cache_size = kDefaultCacheSize;
+// The total size of all shards. Only modified with atomic operations.
 WEAK int64_t current_cache_size = 0;
 
+WEAK CacheShard &shard_for_hash(uint32_t h) {
+    return cache_shards[(h >> 24) % kNumShards];
+}
+
+// Make sure the shard has a hash table. Returns false if it couldn't
+// be allocated. Must be called with the shard's lock held.
+WEAK bool ensure_buckets(CacheShard &shard) {
+    if (shard.entries == NULL) {
+        size_t bytes = num_buckets_per_shard * sizeof(CacheEntry *);
+        shard.entries = (CacheEntry **)halide_malloc(NULL, bytes);
+        if (shard.entries == NULL) {
+            return false;
+        }
+        memset(shard.entries, 0, bytes);
+        shard.num_buckets = num_buckets_per_shard;
+    }
+    return true;
+}
+
 #if CACHE_DEBUGGING
-WEAK void validate_cache() {
-    print(NULL) << "validating cache, "
-                << "current size " << current_cache_size
+WEAK void validate_cache(CacheShard &shard) {
+    print(NULL) << "validating cache shard, "
+                << "current total size " << current_cache_size
                 << " of maximum " << max_cache_size << "\n";
     int entries_in_hash_table = 0;
-    for (size_t i = 0; i < kHashTableSize; i++) {
-        CacheEntry *entry = cache_entries[i];
+    for (size_t i = 0; shard.entries && i < shard.num_buckets; i++) {
+        CacheEntry *entry = shard.entries[i];
         while (entry != NULL) {
             entries_in_hash_table++;
-            if (entry->more_recent == NULL && entry != most_recently_used) {
+            if (entry->more_recent == NULL && entry != shard.most_recently_used) {
                 halide_print(NULL, "cache invalid case 1\n");
                 __builtin_trap();
             }
-            if (entry->less_recent == NULL && entry != least_recently_used) {
+            if (entry->less_recent == NULL && entry != shard.least_recently_used) {
                 halide_print(NULL, "cache invalid case 2\n");
                 __builtin_trap();
             }
@@ -196,13 +311,13 @@ WEAK void validate_cache() {
         }
     }
     int entries_from_mru = 0;
-    CacheEntry *mru_chain = most_recently_used;
+    CacheEntry *mru_chain = shard.most_recently_used;
     while (mru_chain != NULL) {
         entries_from_mru++;
         mru_chain = mru_chain->less_recent;
     }
     int entries_from_lru = 0;
-    CacheEntry *lru_chain = least_recently_used;
+    CacheEntry *lru_chain = shard.least_recently_used;
     while (lru_chain != NULL) {
         entries_from_lru++;
         lru_chain = lru_chain->more_recent;
@@ -221,85 +336,496 @@ WEAK void validate_cache() {
 }
 #endif
 
-WEAK void prune_cache() {
+WEAK MemoizedFunc *memoized_funcs = NULL;
+WEAK halide_mutex memoized_funcs_lock;
+
+WEAK char *copy_string(const char *str) {
+    size_t len = strlen(str);
+    char *result = (char *)halide_malloc(NULL, len + 1);
+    if (result) {
+        memcpy(result, str, len + 1);
+    }
+    return result;
+}
+
+WEAK MemoizedFunc *find_memoized_func(MemoizedFunc *list, const char *pipeline_name, const char *func_name) {
+    for (MemoizedFunc *f = list; f != NULL; f = f->next) {
+        if (strcmp(f->func_name, func_name) == 0 &&
+            strcmp(f->pipeline_name, pipeline_name) == 0) {
+            return f;
+        }
+    }
+    return NULL;
+}
+
+// Find or make the record for a Func. Returns NULL on allocation
+// failure. Records are only ever pushed onto the front of the list,
+// so it can be searched without holding the lock.
+WEAK MemoizedFunc *get_memoized_func(const char *pipeline_name, const char *func_name) {
+    MemoizedFunc *head = (MemoizedFunc *)__sync_fetch_and_add(&memoized_funcs, 0);
+    MemoizedFunc *f = find_memoized_func(head, pipeline_name, func_name);
+    if (f != NULL) {
+        return f;
+    }
+
+    ScopedMutexLock lock(&memoized_funcs_lock);
+    f = find_memoized_func(memoized_funcs, pipeline_name, func_name);
+    if (f != NULL) {
+        return f;
+    }
+    f = (MemoizedFunc *)halide_malloc(NULL, sizeof(MemoizedFunc));
+    if (f == NULL) {
+        return NULL;
+    }
+    memset(f, 0, sizeof(MemoizedFunc));
+    f->pipeline_name = copy_string(pipeline_name);
+    f->func_name = copy_string(func_name);
+    if (f->pipeline_name == NULL || f->func_name == NULL) {
+        if (f->pipeline_name) halide_free(NULL, f->pipeline_name);
+        if (f->func_name) halide_free(NULL, f->func_name);
+        halide_free(NULL, f);
+        return NULL;
+    }
+    f->next = memoized_funcs;
+    // Publish the record only once it is fully initialized.
+    __sync_synchronize();
+    memoized_funcs = f;
+    return f;
+}
+
+WEAK uint32_t current_time_us() {
+    // Not every platform's runtime has a clock. Without one, all
+    // entries look equally cheap to recompute and eviction degrades
+    // to size-weighted LRU.
+    if (!halide_current_time_ns) {
+        return 0;
+    }
+    return (uint32_t)(halide_current_time_ns(NULL) / 1000);
+}
+
+// How valuable an entry is to keep: its recompute time per byte,
+// scaled by 2^priority.
+WEAK double retention_score(const CacheEntry *entry) {
+    double score = (double)(entry->compute_time_ns + 1) / (double)max(entry->size, (int64_t)1);
+    int p = entry->priority;
+    p = max(-30, min(p, 30));
+    if (p >= 0) {
+        score *= (double)(1 << p);
+    } else {
+        score /= (double)(1 << -p);
+    }
+    return score;
+}
+
+// Eviction considers this many of the least recently used entries at
+// a time, and evicts the one with the lowest retention score.
+const int kEvictionWindow = 8;
+
+// Pick an unused entry to evict from this shard, optionally
+// restricted to the entries of one Func. Returns NULL if there are
+// none. Must be called with the shard's lock held.
+WEAK CacheEntry *pick_victim(CacheShard &shard, MemoizedFunc *only_func) {
+    CacheEntry *victim = NULL;
+    double victim_score = 0;
+    int considered = 0;
+    for (CacheEntry *candidate = shard.least_recently_used;
+         candidate != NULL && considered < kEvictionWindow;
+         candidate = candidate->more_recent) {
+        if (candidate->in_use_count != 0 ||
+            (only_func != NULL && candidate->func != only_func)) {
+            continue;
+        }
+        considered++;
+        double score = retention_score(candidate);
+        if (victim == NULL || score < victim_score) {
+            victim = candidate;
+            victim_score = score;
+        }
+    }
+    return victim;
+}
+
+// Remove an entry from its shard and free it. Must be called with the
+// shard's lock held.
+WEAK void evict(CacheShard &shard, CacheEntry *entry) {
+    uint32_t index = entry->hash % shard.num_buckets;
+
+    // Remove from hash table
+    CacheEntry *prev_hash_entry = shard.entries[index];
+    if (prev_hash_entry == entry) {
+        shard.entries[index] = entry->next;
+    } else {
+        while (prev_hash_entry != NULL && prev_hash_entry->next != entry) {
+            prev_hash_entry = prev_hash_entry->next;
+        }
+        halide_assert(NULL, prev_hash_entry != NULL);
+        prev_hash_entry->next = entry->next;
+    }
+
+    // Remove from less recent chain.
+    CacheEntry *more_recent = entry->more_recent;
+    if (shard.least_recently_used == entry) {
+        shard.least_recently_used = more_recent;
+    }
+    if (more_recent != NULL) {
+        more_recent->less_recent = entry->less_recent;
+    }
+
+    // Remove from more recent chain.
+    if (shard.most_recently_used == entry) {
+        shard.most_recently_used = entry->less_recent;
+    }
+    if (entry->less_recent != NULL) {
+        entry->less_recent->more_recent = more_recent;
+    }
+
+    // Decrease cache used amount.
+    __sync_fetch_and_sub(&current_cache_size, entry->size);
+    if (entry->func) {
+        __sync_fetch_and_sub(&entry->func->cached_bytes, entry->size);
+        __sync_fetch_and_add(&entry->func->evictions, (uint64_t)1);
+    }
+
+    // Deallocate the entry.
+    entry->destroy();
+    halide_free(NULL, entry);
+}
+
+// Evict unused entries from this shard until the cache as a whole
+// fits in max_cache_size. Other shards are pruned when they are next
+// stored to. Must be called with the shard's lock held.
+WEAK void prune_cache(CacheShard &shard) {
 #if CACHE_DEBUGGING
-    validate_cache();
+    validate_cache(shard);
 #endif
-    CacheEntry *prune_candidate = least_recently_used;
-    while (current_cache_size > max_cache_size &&
-           prune_candidate != NULL) {
-        CacheEntry *more_recent = prune_candidate->more_recent;
-
-        if (prune_candidate->in_use_count == 0) {
-            uint32_t h = prune_candidate->hash;
-            uint32_t index = h % kHashTableSize;
-
-            // Remove from hash table
-            CacheEntry *prev_hash_entry = cache_entries[index];
-            if (prev_hash_entry == prune_candidate) {
-                cache_entries[index] = prune_candidate->next;
-            } else {
-                while (prev_hash_entry != NULL && prev_hash_entry->next != prune_candidate) {
-                    prev_hash_entry = prev_hash_entry->next;
-                }
-                halide_assert(NULL, prev_hash_entry != NULL);
-                prev_hash_entry->next = prune_candidate->next;
-            }
+    while (current_cache_size > max_cache_size) {
+        CacheEntry *victim = pick_victim(shard, NULL);
+        if (victim == NULL) {
+            break;
+        }
+        evict(shard, victim);
+    }
+#if CACHE_DEBUGGING
+    validate_cache(shard);
+#endif
+}
 
-            // Remove from less recent chain.
-            if (least_recently_used == prune_candidate) {
-                least_recently_used = more_recent;
-            }
-            if (more_recent != NULL) {
-                more_recent->less_recent = prune_candidate->less_recent;
-            }
+// An optional second level of the cache, shared between processes
+// through a memory mapped file. Results stored by any process can be
+// looked up by all of them, and persist across restarts.
+//
+// The file holds a header, an open addressing hash table of entry
+// offsets, and an append-only area of entries. Entries are written
+// before their offset is published into the table with a
+// compare-and-swap, and never change afterwards, so no lock is needed
+// to read or add them. Nothing is ever evicted: once the file is
+// full, new results are only cached locally. Delete the file to clear
+// it.
+
+const uint32_t kSharedCacheMagic = 0x4d454d4f; // "MEMO"
+const uint32_t kSharedCacheInitializing = 1;
+const uint32_t kSharedCacheVersion = 1;
+const int kSharedCacheMaxProbes = 32;
+const int64_t kDefaultSharedCacheSize = 256 << 20;
+
+struct SharedCacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t region_size;
+    uint64_t num_slots;
+    uint64_t data_tail;
+    // Followed by uint64_t slots[num_slots], each zero or the offset
+    // of a SharedCacheEntry, and then the entries themselves.
+};
 
-            // Remove from more recent chain.
-            if (most_recently_used == prune_candidate) {
-                most_recently_used = prune_candidate->less_recent;
-            }
-            if (prune_candidate->less_recent != NULL) {
-                prune_candidate->less_recent = more_recent;
+struct SharedCacheEntry {
+    uint32_t hash;
+    uint32_t key_size;
+    uint32_t tuple_count;
+    uint32_t padding;
+    buffer_t computed_bounds;
+    // Followed by the key, the tuple_count buffer_t shapes of the
+    // results, then their contents, each aligned to 8 bytes.
+};
+
+WEAK SharedCacheHeader *shared_cache = NULL;
+WEAK size_t shared_cache_size = 0;
+WEAK bool shared_cache_checked_env = false;
+WEAK halide_mutex shared_cache_lock;
+
+WEAK size_t align_to_8(size_t x) {
+    return (x + 7) & ~(size_t)7;
+}
+
+WEAK uint64_t *shared_cache_slots(SharedCacheHeader *c) {
+    return (uint64_t *)((uint8_t *)c + align_to_8(sizeof(SharedCacheHeader)));
+}
+
+WEAK uint8_t *shared_entry_key(SharedCacheEntry *e) {
+    return (uint8_t *)(e + 1);
+}
+
+WEAK buffer_t *shared_entry_shapes(SharedCacheEntry *e) {
+    return (buffer_t *)(shared_entry_key(e) + align_to_8(e->key_size));
+}
+
+WEAK uint8_t *shared_entry_data(SharedCacheEntry *e) {
+    return (uint8_t *)shared_entry_shapes(e) + align_to_8(e->tuple_count * sizeof(buffer_t));
+}
+
+// Map a shared cache file and check it is compatible with this
+// process, initializing it if this is the first process to use
+// it. Must be called with shared_cache_lock held.
+WEAK bool attach_shared_cache_already_locked(void *user_context, const char *path, int64_t size) {
+    size_t header_size = align_to_8(sizeof(SharedCacheHeader));
+    uint64_t num_slots = max((uint64_t)size / 4096, (uint64_t)1024);
+    size_t data_start = header_size + num_slots * sizeof(uint64_t);
+    if (!halide_map_shared_memory || size <= (int64_t)(data_start + 4096)) {
+        return false;
+    }
+
+    SharedCacheHeader *c = (SharedCacheHeader *)halide_map_shared_memory(user_context, path, (size_t)size);
+    if (c == NULL) {
+        return false;
+    }
+
+    if (__sync_bool_compare_and_swap(&c->magic, 0, kSharedCacheInitializing)) {
+        // A new file. The whole thing is already zero-filled, so the
+        // hash table is empty.
+        c->version = kSharedCacheVersion;
+        c->region_size = (uint64_t)size;
+        c->num_slots = num_slots;
+        c->data_tail = data_start;
+        __sync_synchronize();
+        c->magic = kSharedCacheMagic;
+    } else {
+        // Wait a little for another process to finish initializing it.
+        for (int i = 0; i < 1000 && *(volatile uint32_t *)&c->magic == kSharedCacheInitializing; i++) {
+            if (halide_sleep_ms) {
+                halide_sleep_ms(user_context, 1);
             }
+        }
+        __sync_synchronize();
+    }
+
+    if (c->magic != kSharedCacheMagic ||
+        c->version != kSharedCacheVersion ||
+        c->region_size != (uint64_t)size ||
+        c->num_slots != num_slots) {
+        debug(user_context) << "Memoization cache file " << path << " is not compatible, not using it\n";
+        halide_unmap_shared_memory(user_context, c, (size_t)size);
+        return false;
+    }
+
+    shared_cache = c;
+    shared_cache_size = (size_t)size;
+    return true;
+}
 
-            // Decrease cache used amount.
-            for (uint32_t i = 0; i < prune_candidate->tuple_count; i++) {
-                current_cache_size -= buf_size(&prune_candidate->buffer(i));
+WEAK void detach_shared_cache_already_locked(void *user_context) {
+    if (shared_cache) {
+        halide_unmap_shared_memory(user_context, shared_cache, shared_cache_size);
+        shared_cache = NULL;
+        shared_cache_size = 0;
+    }
+}
+
+// Returns the shared cache if one is in use, attaching the one named
+// by HL_MEMOIZE_SHARED_CACHE the first time this is called.
+WEAK SharedCacheHeader *get_shared_cache(void *user_context) {
+    if (!shared_cache_checked_env) {
+        ScopedMutexLock lock(&shared_cache_lock);
+        if (!shared_cache_checked_env) {
+            const char *path = getenv("HL_MEMOIZE_SHARED_CACHE");
+            if (path && *path) {
+                int64_t size = kDefaultSharedCacheSize;
+                const char *size_str = getenv("HL_MEMOIZE_SHARED_CACHE_MB");
+                if (size_str && atoi(size_str) > 0) {
+                    size = (int64_t)atoi(size_str) << 20;
+                }
+                attach_shared_cache_already_locked(user_context, path, size);
             }
+            __sync_synchronize();
+            shared_cache_checked_env = true;
+        }
+    }
+    return shared_cache;
+}
 
-            // Deallocate the entry.
-            prune_candidate->destroy();
-            halide_free(NULL, prune_candidate);
+WEAK bool shared_entry_matches(SharedCacheEntry *e, uint32_t h, const uint8_t *cache_key, int32_t size,
+                               const buffer_t *computed_bounds, int32_t tuple_count, buffer_t **tuple_buffers) {
+    if (e->hash != h || e->key_size != (uint32_t)size || e->tuple_count != (uint32_t)tuple_count ||
+        !keys_equal(shared_entry_key(e), cache_key, size) ||
+        !bounds_equal(e->computed_bounds, *computed_bounds)) {
+        return false;
+    }
+    buffer_t *shapes = shared_entry_shapes(e);
+    for (int32_t i = 0; i < tuple_count; i++) {
+        if (!bounds_equal(shapes[i], *tuple_buffers[i])) {
+            return false;
         }
+    }
+    return true;
+}
 
-        prune_candidate = more_recent;
+// Find a matching entry in the shared cache, or return NULL.
+WEAK SharedCacheEntry *shared_cache_find(SharedCacheHeader *c, uint32_t h, const uint8_t *cache_key, int32_t size,
+                                         const buffer_t *computed_bounds, int32_t tuple_count, buffer_t **tuple_buffers) {
+    uint64_t *slots = shared_cache_slots(c);
+    for (int i = 0; i < kSharedCacheMaxProbes; i++) {
+        uint64_t offset = __sync_fetch_and_add(&slots[(h + i) % c->num_slots], (uint64_t)0);
+        if (offset == 0) {
+            return NULL;
+        }
+        SharedCacheEntry *e = (SharedCacheEntry *)((uint8_t *)c + offset);
+        if (shared_entry_matches(e, h, cache_key, size, computed_bounds, tuple_count, tuple_buffers)) {
+            return e;
+        }
     }
-#if CACHE_DEBUGGING
-    validate_cache();
-#endif
+    return NULL;
 }
 
-}}} // namespace Halide::Runtime::Internal
+// The cache key starts with a pointer to a string naming the Func,
+// which differs between processes. The shared cache uses the names
+// instead. The result points either to stack_buf or to memory which
+// must be freed with halide_free, or is NULL on allocation failure.
+WEAK uint8_t *make_portable_key(void *user_context, const char *pipeline_name, const char *func_name,
+                                const uint8_t *cache_key, int32_t size,
+                                uint8_t *stack_buf, size_t stack_buf_size, int32_t *portable_size) {
+    size_t skip = min((size_t)size, sizeof(void *));
+    size_t pipeline_len = strlen(pipeline_name) + 1;
+    size_t func_len = strlen(func_name) + 1;
+    size_t total = pipeline_len + func_len + (size - skip);
+    uint8_t *result = stack_buf;
+    if (total > stack_buf_size) {
+        result = (uint8_t *)halide_malloc(user_context, total);
+        if (result == NULL) {
+            return NULL;
+        }
+    }
+    memcpy(result, pipeline_name, pipeline_len);
+    memcpy(result + pipeline_len, func_name, func_len);
+    memcpy(result + pipeline_len + func_len, cache_key + skip, size - skip);
+    *portable_size = (int32_t)total;
+    return result;
+}
 
-extern "C" {
+// Copy a result from the shared cache into the buffers allocated by a
+// local cache miss. Returns true if it was found. The key must come
+// from make_portable_key.
+WEAK bool shared_cache_lookup(SharedCacheHeader *c, const uint8_t *cache_key, int32_t size,
+                              const buffer_t *computed_bounds, int32_t tuple_count, buffer_t **tuple_buffers) {
+    uint32_t h = djb_hash(cache_key, size);
+    SharedCacheEntry *e = shared_cache_find(c, h, cache_key, size, computed_bounds, tuple_count, tuple_buffers);
+    if (e == NULL) {
+        return false;
+    }
+    const uint8_t *data = shared_entry_data(e);
+    for (int32_t i = 0; i < tuple_count; i++) {
+        size_t bytes = buf_size(tuple_buffers[i]);
+        memcpy(tuple_buffers[i]->host, data, bytes);
+        data += align_to_8(bytes);
+    }
+    return true;
+}
 
-WEAK void halide_memoization_cache_set_size(int64_t size) {
-    if (size == 0) {
-        size = kDefaultCacheSize;
+// Add a result to the shared cache, unless it is already there or
+// the cache is full. The key must come from make_portable_key.
+WEAK void shared_cache_store(SharedCacheHeader *c, const uint8_t *cache_key, int32_t size,
+                             const buffer_t *computed_bounds, int32_t tuple_count, buffer_t **tuple_buffers) {
+    uint32_t h = djb_hash(cache_key, size);
+    if (shared_cache_find(c, h, cache_key, size, computed_bounds, tuple_count, tuple_buffers)) {
+        return;
     }
 
-    ScopedMutexLock lock(&memoization_lock);
+    size_t entry_size = sizeof(SharedCacheEntry) + align_to_8(size) +
+        align_to_8(tuple_count * sizeof(buffer_t));
+    for (int32_t i = 0; i < tuple_count; i++) {
+        entry_size += align_to_8(buf_size(tuple_buffers[i]));
+    }
+    entry_size = align_to_8(entry_size);
 
-    max_cache_size = size;
-    prune_cache();
+    // Reserve space. If there isn't room, the reservation is left in
+    // place so that later, smaller results don't fragment the end.
+    uint64_t offset = __sync_fetch_and_add(&c->data_tail, (uint64_t)entry_size);
+    if (offset + entry_size > c->region_size) {
+        return;
+    }
+
+    SharedCacheEntry *e = (SharedCacheEntry *)((uint8_t *)c + offset);
+    e->hash = h;
+    e->key_size = size;
+    e->tuple_count = tuple_count;
+    e->padding = 0;
+    e->computed_bounds = *computed_bounds;
+    e->computed_bounds.host = NULL;
+    e->computed_bounds.dev = 0;
+    memcpy(shared_entry_key(e), cache_key, size);
+    buffer_t *shapes = shared_entry_shapes(e);
+    uint8_t *data = shared_entry_data(e);
+    for (int32_t i = 0; i < tuple_count; i++) {
+        shapes[i] = *tuple_buffers[i];
+        shapes[i].host = NULL;
+        shapes[i].dev = 0;
+        size_t bytes = buf_size(tuple_buffers[i]);
+        memcpy(data, tuple_buffers[i]->host, bytes);
+        data += align_to_8(bytes);
+    }
+    __sync_synchronize();
+
+    // Publish it.
+    uint64_t *slots = shared_cache_slots(c);
+    for (int i = 0; i < kSharedCacheMaxProbes; i++) {
+        uint64_t *slot = &slots[(h + i) % c->num_slots];
+        if (__sync_bool_compare_and_swap(slot, (uint64_t)0, offset)) {
+            return;
+        }
+        SharedCacheEntry *other = (SharedCacheEntry *)((uint8_t *)c + *slot);
+        if (shared_entry_matches(other, h, cache_key, size, computed_bounds, tuple_count, tuple_buffers)) {
+            // Another process stored the same result first.
+            return;
+        }
+    }
 }
 
-WEAK int halide_memoization_cache_lookup(void *user_context, const uint8_t *cache_key, int32_t size,
-                                         buffer_t *computed_bounds, int32_t tuple_count, buffer_t **tuple_buffers) {
+// Move an entry to the front of its shard's LRU list. Must be called
+// with the shard's lock held.
+WEAK void mark_most_recently_used(void *user_context, CacheShard &shard, CacheEntry *entry) {
+    if (entry == shard.most_recently_used) {
+        return;
+    }
+    halide_assert(user_context, entry->more_recent != NULL);
+    if (entry->less_recent != NULL) {
+        entry->less_recent->more_recent = entry->more_recent;
+    } else {
+        halide_assert(user_context, shard.least_recently_used == entry);
+        shard.least_recently_used = entry->more_recent;
+    }
+    entry->more_recent->less_recent = entry->less_recent;
+
+    entry->more_recent = NULL;
+    entry->less_recent = shard.most_recently_used;
+    if (shard.most_recently_used != NULL) {
+        shard.most_recently_used->more_recent = entry;
+    }
+    shard.most_recently_used = entry;
+}
+
+// Look up a result in this process's cache. Returns the same values
+// as halide_memoization_cache_lookup. A result computed over a larger
+// region also counts as a hit, and the part asked for is copied out
+// of it.
+WEAK int local_cache_lookup(void *user_context, const uint8_t *cache_key, int32_t size,
+                            buffer_t *computed_bounds, int32_t tuple_count, buffer_t **tuple_buffers,
+                            MemoizedFunc *func) {
+    uint64_t hash_start = halide_current_time_ns ? halide_current_time_ns(user_context) : 0;
     uint32_t h = djb_hash(cache_key, size);
-    uint32_t index = h % kHashTableSize;
+    if (func && halide_current_time_ns) {
+        __sync_fetch_and_add(&func->hash_time_ns, (uint64_t)(halide_current_time_ns(user_context) - hash_start));
+    }
+    CacheShard &shard = shard_for_hash(h);
 
-    ScopedMutexLock lock(&memoization_lock);
+    ScopedMutexLock lock(&shard.lock);
 
 #if CACHE_DEBUGGING
     debug_print_key(user_context, "halide_memoization_cache_lookup", cache_key, size);
@@ -314,50 +840,48 @@ WEAK int halide_memoization_cache_lookup(void *user_context, const uint8_t *cach
     }
 #endif
 
-    CacheEntry *entry = cache_entries[index];
+    // An entry computed over a region containing the one asked for,
+    // in case there's no exact match.
+    CacheEntry *containing = NULL;
+    CacheEntry *entry = shard.entries ? shard.entries[h % shard.num_buckets] : NULL;
     while (entry != NULL) {
         if (entry->hash == h && entry->key_size == (size_t)size &&
             keys_equal(entry->key, cache_key, size) &&
-            bounds_equal(entry->computed_bounds, *computed_bounds) &&
             entry->tuple_count == (uint32_t)tuple_count) {
 
-            bool all_bounds_equal = true;
+            if (bounds_equal(entry->computed_bounds, *computed_bounds)) {
+                bool all_bounds_equal = true;
 
-            {
-                for (int32_t i = 0; all_bounds_equal && i < tuple_count; i++) {
-                    buffer_t *buf = tuple_buffers[i];
-                    all_bounds_equal = bounds_equal(entry->buffer(i), *buf);
+                {
+                    for (int32_t i = 0; all_bounds_equal && i < tuple_count; i++) {
+                        buffer_t *buf = tuple_buffers[i];
+                        all_bounds_equal = bounds_equal(entry->buffer(i), *buf);
+                    }
                 }
-            }
 
-            if (all_bounds_equal) {
-                if (entry != most_recently_used) {
-                    halide_assert(user_context, entry->more_recent != NULL);
-                    if (entry->less_recent != NULL) {
-                        entry->less_recent->more_recent = entry->more_recent;
-                    } else {
-                        halide_assert(user_context, least_recently_used == entry);
-                        least_recently_used = entry->more_recent;
-                    }
-                    halide_assert(user_context, entry->more_recent != NULL);
-                    entry->more_recent->less_recent = entry->less_recent;
+                if (all_bounds_equal) {
+                    mark_most_recently_used(user_context, shard, entry);
 
-                    entry->more_recent = NULL;
-                    entry->less_recent = most_recently_used;
-                    if (most_recently_used != NULL) {
-                        most_recently_used->more_recent = entry;
+                    for (int32_t i = 0; i < tuple_count; i++) {
+                        buffer_t *buf = tuple_buffers[i];
+                        *buf = entry->buffer(i);
                     }
-                    most_recently_used = entry;
+
+                    entry->in_use_count += tuple_count;
+
+                    return 0;
                 }
+            }
 
+            if (containing == NULL &&
+                bounds_contain(entry->computed_bounds, *computed_bounds)) {
+                bool all_elem_sizes_equal = true;
                 for (int32_t i = 0; i < tuple_count; i++) {
-                    buffer_t *buf = tuple_buffers[i];
-                    *buf = entry->buffer(i);
+                    all_elem_sizes_equal &= entry->buffer(i).elem_size == tuple_buffers[i]->elem_size;
+                }
+                if (all_elem_sizes_equal) {
+                    containing = entry;
                 }
-
-                entry->in_use_count += tuple_count;
-
-                return 0;
             }
         }
         entry = entry->next;
@@ -379,24 +903,160 @@ WEAK int halide_memoization_cache_lookup(void *user_context, const uint8_t *cach
         CacheBlockHeader *header = get_pointer_to_header(buf->host);
         header->hash = h;
         header->entry = NULL;
+        header->start_time_us = current_time_us();
+    }
+
+    if (containing != NULL) {
+        // The pipeline indexes the buffers with the strides it asked
+        // for, so it can't use the entry's own, larger buffers. Copy
+        // the part asked for out of it instead. The new buffers have
+        // no cache entry, so halide_memoization_cache_release frees
+        // them.
+        for (int32_t i = 0; i < tuple_count; i++) {
+            copy_overlap(containing->buffer(i), *tuple_buffers[i]);
+        }
+        mark_most_recently_used(user_context, shard, containing);
+        return 0;
     }
 
 #if CACHE_DEBUGGING
-    validate_cache();
+    validate_cache(shard);
 #endif
 
     return 1;
 }
 
+}}} // namespace Halide::Runtime::Internal
+
+extern "C" {
+
+WEAK void halide_memoization_cache_set_size(int64_t size) {
+    if (size == 0) {
+        size = kDefaultCacheSize;
+    }
+
+    max_cache_size = size;
+    for (size_t i = 0; i < kNumShards; i++) {
+        ScopedMutexLock lock(&cache_shards[i].lock);
+        if (cache_shards[i].entries) {
+            prune_cache(cache_shards[i]);
+        }
+    }
+}
+
+WEAK void halide_memoization_cache_set_num_buckets(int32_t num_buckets) {
+    if (num_buckets <= 0) {
+        num_buckets = kDefaultNumBuckets;
+    }
+    size_t per_shard = (num_buckets + kNumShards - 1) / kNumShards;
+    num_buckets_per_shard = per_shard;
+
+    // Rehash the shards that already have a table.
+    for (size_t i = 0; i < kNumShards; i++) {
+        CacheShard &shard = cache_shards[i];
+        ScopedMutexLock lock(&shard.lock);
+        if (shard.entries == NULL || shard.num_buckets == per_shard) {
+            continue;
+        }
+        size_t bytes = per_shard * sizeof(CacheEntry *);
+        CacheEntry **new_entries = (CacheEntry **)halide_malloc(NULL, bytes);
+        if (new_entries == NULL) {
+            // Keep using the old table.
+            continue;
+        }
+        memset(new_entries, 0, bytes);
+        for (size_t j = 0; j < shard.num_buckets; j++) {
+            CacheEntry *entry = shard.entries[j];
+            while (entry != NULL) {
+                CacheEntry *next = entry->next;
+                uint32_t index = entry->hash % per_shard;
+                entry->next = new_entries[index];
+                new_entries[index] = entry;
+                entry = next;
+            }
+        }
+        halide_free(NULL, shard.entries);
+        shard.entries = new_entries;
+        shard.num_buckets = per_shard;
+    }
+}
+
+WEAK int halide_memoization_cache_lookup(void *user_context, const uint8_t *cache_key, int32_t size,
+                                         buffer_t *computed_bounds, int32_t tuple_count, buffer_t **tuple_buffers,
+                                         const char *pipeline_name, const char *func_name) {
+    MemoizedFunc *func = get_memoized_func(pipeline_name, func_name);
+
+    int result = local_cache_lookup(user_context, cache_key, size, computed_bounds,
+                                    tuple_count, tuple_buffers, func);
+
+    SharedCacheHeader *shared = (result == 1) ? get_shared_cache(user_context) : NULL;
+    uint8_t key_buf[256];
+    int32_t portable_size = 0;
+    uint8_t *portable_key = shared ? make_portable_key(user_context, pipeline_name, func_name, cache_key, size,
+                                                       key_buf, sizeof(key_buf), &portable_size) : NULL;
+    if (portable_key) {
+        bool found = shared_cache_lookup(shared, portable_key, portable_size, computed_bounds,
+                                         tuple_count, tuple_buffers);
+        if (portable_key != key_buf) {
+            halide_free(user_context, portable_key);
+        }
+        if (found) {
+            // Keep a local copy too, so later lookups don't have to
+            // copy it out of the shared cache again.
+            halide_memoization_cache_store(user_context, cache_key, size, computed_bounds, tuple_count, tuple_buffers,
+                                           pipeline_name, func_name, 0, func ? func->max_bytes : 0);
+            result = 0;
+        }
+    }
+
+    if (func && result == 0) {
+        __sync_fetch_and_add(&func->hits, (uint64_t)1);
+    } else if (func && result == 1) {
+        __sync_fetch_and_add(&func->misses, (uint64_t)1);
+    }
+
+    return result;
+}
+
 WEAK int halide_memoization_cache_store(void *user_context, const uint8_t *cache_key, int32_t size,
-                                        buffer_t *computed_bounds, int32_t tuple_count, buffer_t **tuple_buffers) {
+                                        buffer_t *computed_bounds, int32_t tuple_count, buffer_t **tuple_buffers,
+                                        const char *pipeline_name, const char *func_name,
+                                        int32_t priority, int64_t max_bytes) {
     debug(user_context) << "halide_memoization_cache_store\n";
 
-    uint32_t h = get_pointer_to_header(tuple_buffers[0]->host)->hash;
+    CacheBlockHeader *first_header = get_pointer_to_header(tuple_buffers[0]->host);
+    uint32_t h = first_header->hash;
+    uint64_t compute_time_ns = (uint64_t)(uint32_t)(current_time_us() - first_header->start_time_us) * 1000;
+    CacheShard &shard = shard_for_hash(h);
+    MemoizedFunc *func = get_memoized_func(pipeline_name, func_name);
+    if (func) {
+        func->max_bytes = max_bytes;
+    }
+
+    SharedCacheHeader *shared = get_shared_cache(user_context);
+    uint8_t key_buf[256];
+    int32_t portable_size = 0;
+    uint8_t *portable_key = shared ? make_portable_key(user_context, pipeline_name, func_name, cache_key, size,
+                                                       key_buf, sizeof(key_buf), &portable_size) : NULL;
+    if (portable_key) {
+        shared_cache_store(shared, portable_key, portable_size, computed_bounds, tuple_count, tuple_buffers);
+        if (portable_key != key_buf) {
+            halide_free(user_context, portable_key);
+        }
+    }
 
-    uint32_t index = h % kHashTableSize;
+    ScopedMutexLock lock(&shard.lock);
 
-    ScopedMutexLock lock(&memoization_lock);
+    if (!ensure_buckets(shard)) {
+        // Couldn't make a hash table. Don't cache this result, and
+        // mark it as having no cache entry so
+        // halide_memoization_cache_release can free the buffer.
+        for (int32_t i = 0; i < tuple_count; i++) {
+            get_pointer_to_header(tuple_buffers[i]->host)->entry = NULL;
+        }
+        return 0;
+    }
+    uint32_t index = h % shard.num_buckets;
 
 #if CACHE_DEBUGGING
     debug_print_key(user_context, "halide_memoization_cache_store", cache_key, size);
@@ -411,7 +1071,7 @@ WEAK int halide_memoization_cache_store(void *user_context, const uint8_t *cache
     }
 #endif
 
-    CacheEntry *entry = cache_entries[index];
+    CacheEntry *entry = shard.entries[index];
     while (entry != NULL) {
         if (entry->hash == h && entry->key_size == (size_t)size &&
             keys_equal(entry->key, cache_key, size) &&
@@ -450,12 +1110,31 @@ WEAK int halide_memoization_cache_store(void *user_context, const uint8_t *cache
             added_size += buf_size(buf);
         }
     }
-    current_cache_size += added_size;
-    prune_cache();
+
+    // Keep this Func within its own budget by evicting its own unused
+    // entries. If that isn't enough, don't cache this result.
+    if (func && func->max_bytes > 0) {
+        while (func->cached_bytes + (int64_t)added_size > func->max_bytes) {
+            CacheEntry *victim = pick_victim(shard, func);
+            if (victim == NULL) {
+                break;
+            }
+            evict(shard, victim);
+        }
+        if (func->cached_bytes + (int64_t)added_size > func->max_bytes) {
+            for (int32_t i = 0; i < tuple_count; i++) {
+                get_pointer_to_header(tuple_buffers[i]->host)->entry = NULL;
+            }
+            return 0;
+        }
+    }
+
+    __sync_fetch_and_add(&current_cache_size, added_size);
+    prune_cache(shard);
 
     void *entry_storage = halide_malloc(NULL, sizeof(CacheEntry) + sizeof(buffer_t) * (tuple_count - 1));
     if (entry_storage == NULL) {
-        current_cache_size -= added_size;
+        __sync_fetch_and_sub(&current_cache_size, added_size);
 
         // This entry is still in use by the caller. Mark it as having no cache entry
         // so halide_memoization_cache_release can free the buffer.
@@ -468,7 +1147,7 @@ WEAK int halide_memoization_cache_store(void *user_context, const uint8_t *cache
     CacheEntry *new_entry = (CacheEntry *)entry_storage;
     bool inited = new_entry->init(cache_key, size, h, *computed_bounds, tuple_count, tuple_buffers);
     if (!inited) {
-        current_cache_size -= added_size;
+        __sync_fetch_and_sub(&current_cache_size, added_size);
 
         // This entry is still in use by the caller. Mark it as having no cache entry
         // so halide_memoization_cache_release can free the buffer.
@@ -480,25 +1159,33 @@ WEAK int halide_memoization_cache_store(void *user_context, const uint8_t *cache
         return 0;
     }
 
-    new_entry->next = cache_entries[index];
-    new_entry->less_recent = most_recently_used;
-    if (most_recently_used != NULL) {
-        most_recently_used->more_recent = new_entry;
+    new_entry->next = shard.entries[index];
+    new_entry->less_recent = shard.most_recently_used;
+    if (shard.most_recently_used != NULL) {
+        shard.most_recently_used->more_recent = new_entry;
     }
-    most_recently_used = new_entry;
-    if (least_recently_used == NULL) {
-        least_recently_used = new_entry;
+    shard.most_recently_used = new_entry;
+    if (shard.least_recently_used == NULL) {
+        shard.least_recently_used = new_entry;
     }
-    cache_entries[index] = new_entry;
+    shard.entries[index] = new_entry;
 
     new_entry->in_use_count = tuple_count;
+    new_entry->func = func;
+    new_entry->size = added_size;
+    new_entry->compute_time_ns = compute_time_ns;
+    new_entry->priority = priority;
+    if (func) {
+        __sync_fetch_and_add(&func->cached_bytes, (int64_t)added_size);
+        __sync_fetch_and_add(&func->bytes_stored, added_size);
+    }
 
     for (int32_t i = 0; i < tuple_count; i++) {
         get_pointer_to_header(tuple_buffers[i]->host)->entry = new_entry;
     }
 
 #if CACHE_DEBUGGING
-    validate_cache();
+    validate_cache(shard);
 #endif
     debug(user_context) << "Exiting halide_memoization_cache_store\n";
 
@@ -513,32 +1200,94 @@ WEAK void halide_memoization_cache_release(void *user_context, void *host) {
     if (entry == NULL) {
         halide_free(user_context, header);
     } else {
-        ScopedMutexLock lock(&memoization_lock);
+        CacheShard &shard = shard_for_hash(entry->hash);
+        ScopedMutexLock lock(&shard.lock);
 
         halide_assert(user_context, entry->in_use_count > 0);
         entry->in_use_count--;
 #if CACHE_DEBUGGING
-        validate_cache();
+        validate_cache(shard);
 #endif
     }
 
     debug(user_context) << "Exited halide_memoization_cache_release.\n";
 }
 
+WEAK int halide_memoization_cache_set_shared_file(void *user_context, const char *path, int64_t size) {
+    ScopedMutexLock lock(&shared_cache_lock);
+    detach_shared_cache_already_locked(user_context);
+    // An explicit choice overrides HL_MEMOIZE_SHARED_CACHE.
+    shared_cache_checked_env = true;
+    if (path == NULL) {
+        return 0;
+    }
+    if (size <= 0) {
+        size = kDefaultSharedCacheSize;
+    }
+    return attach_shared_cache_already_locked(user_context, path, size) ? 0 : -1;
+}
+
+WEAK int halide_memoization_cache_get_stats(void *user_context,
+                                            struct halide_memoization_cache_func_stats_t *stats,
+                                            int max_stats) {
+    ScopedMutexLock lock(&memoized_funcs_lock);
+    int count = 0;
+    for (MemoizedFunc *f = memoized_funcs; f != NULL; f = f->next, count++) {
+        if (count >= max_stats) {
+            continue;
+        }
+        halide_memoization_cache_func_stats_t &s = stats[count];
+        s.pipeline_name = f->pipeline_name;
+        s.func_name = f->func_name;
+        s.hits = f->hits;
+        s.misses = f->misses;
+        s.evictions = f->evictions;
+        s.bytes_stored = f->bytes_stored;
+        s.cached_bytes = f->cached_bytes;
+        s.hash_time_ns = f->hash_time_ns;
+    }
+    return count;
+}
+
 WEAK void halide_memoization_cache_cleanup() {
     debug(NULL) << "halide_memoization_cache_cleanup\n";
-    for (size_t i = 0; i < kHashTableSize; i++) {
-        CacheEntry *entry = cache_entries[i];
-        cache_entries[i] = NULL;
-        while (entry != NULL) {
-            CacheEntry *next = entry->next;
-            entry->destroy();
-            halide_free(NULL, entry);
-            entry = next;
+    for (size_t s = 0; s < kNumShards; s++) {
+        CacheShard &shard = cache_shards[s];
+        for (size_t i = 0; shard.entries && i < shard.num_buckets; i++) {
+            CacheEntry *entry = shard.entries[i];
+            shard.entries[i] = NULL;
+            while (entry != NULL) {
+                CacheEntry *next = entry->next;
+                entry->destroy();
+                halide_free(NULL, entry);
+                entry = next;
+            }
         }
+        if (shard.entries) {
+            halide_free(NULL, shard.entries);
+            shard.entries = NULL;
+        }
+        shard.num_buckets = 0;
+        shard.most_recently_used = NULL;
+        shard.least_recently_used = NULL;
+        halide_mutex_destroy(&shard.lock);
     }
     current_cache_size = 0;
-    halide_mutex_destroy(&memoization_lock);
+
+    while (memoized_funcs != NULL) {
+        MemoizedFunc *next = memoized_funcs->next;
+        halide_free(NULL, memoized_funcs->pipeline_name);
+        halide_free(NULL, memoized_funcs->func_name);
+        halide_free(NULL, memoized_funcs);
+        memoized_funcs = next;
+    }
+    halide_mutex_destroy(&memoized_funcs_lock);
+
+    {
+        ScopedMutexLock lock(&shared_cache_lock);
+        detach_shared_cache_already_locked(NULL);
+        shared_cache_checked_env = false;
+    }
 }
 
 namespace {
@@ -0,0 +1,102 @@
+#include "HalideRuntime.h"
+#include "scoped_spin_lock.h"
+
+namespace Halide { namespace Runtime { namespace Internal {
+
+// The cancellation state of each user_context that has been
+// cancelled or given a deadline. There are few enough of these that a
+// linear search is fine.
+#define MAX_CANCELLATION_ENTRIES 16
+struct cancellation_entry {
+    void *user_context;
+    // An absolute time in terms of halide_current_time_ns, or zero
+    // for no deadline.
+    int64_t deadline_ns;
+    bool cancelled;
+};
+
+WEAK cancellation_entry cancellation_entries[MAX_CANCELLATION_ENTRIES];
+WEAK int num_cancellation_entries = 0;
+WEAK volatile int cancellation_lock = 0;
+
+// Find the entry for the given user_context, adding one if there is
+// none and add is true. Returns NULL on failure. Must be called with
+// the lock held.
+WEAK cancellation_entry *find_cancellation_entry_already_locked(void *user_context, bool add) {
+    for (int i = 0; i < num_cancellation_entries; i++) {
+        if (cancellation_entries[i].user_context == user_context) {
+            return &cancellation_entries[i];
+        }
+    }
+    if (!add || num_cancellation_entries == MAX_CANCELLATION_ENTRIES) {
+        return NULL;
+    }
+    cancellation_entry *e = &cancellation_entries[num_cancellation_entries++];
+    e->user_context = user_context;
+    e->deadline_ns = 0;
+    e->cancelled = false;
+    return e;
+}
+
+}}} // namespace Halide::Runtime::Internal
+
+using namespace Halide::Runtime::Internal;
+
+extern "C" {
+
+WEAK int halide_cancel(void *user_context) {
+    ScopedSpinLock lock(&cancellation_lock);
+    cancellation_entry *e = find_cancellation_entry_already_locked(user_context, true);
+    if (e == NULL) {
+        return halide_error_code_generic_error;
+    }
+    e->cancelled = true;
+    return 0;
+}
+
+WEAK int halide_set_deadline(void *user_context, int64_t timeout_ns) {
+    halide_start_clock(user_context);
+    int64_t deadline = halide_current_time_ns(user_context) + timeout_ns;
+    // Zero means no deadline, so nudge a deadline that lands on it.
+    if (deadline == 0) {
+        deadline = -1;
+    }
+    ScopedSpinLock lock(&cancellation_lock);
+    cancellation_entry *e = find_cancellation_entry_already_locked(user_context, true);
+    if (e == NULL) {
+        return halide_error_code_generic_error;
+    }
+    e->deadline_ns = deadline;
+    return 0;
+}
+
+WEAK void halide_clear_cancellation(void *user_context) {
+    ScopedSpinLock lock(&cancellation_lock);
+    for (int i = 0; i < num_cancellation_entries; i++) {
+        if (cancellation_entries[i].user_context == user_context) {
+            cancellation_entries[i] = cancellation_entries[--num_cancellation_entries];
+            return;
+        }
+    }
+}
+
+WEAK int halide_cancellation_check(void *user_context) {
+    // Most programs never cancel anything, so don't take the lock
+    // when there's nothing to find.
+    if (num_cancellation_entries == 0) {
+        return 0;
+    }
+    ScopedSpinLock lock(&cancellation_lock);
+    cancellation_entry *e = find_cancellation_entry_already_locked(user_context, false);
+    if (e == NULL) {
+        return 0;
+    }
+    if (!e->cancelled && e->deadline_ns != 0 &&
+        halide_current_time_ns(user_context) >= e->deadline_ns) {
+        // Once the deadline has passed, stay cancelled.
+        e->cancelled = true;
+    }
+    return e->cancelled ? halide_error_code_cancelled : 0;
+}
+
+}
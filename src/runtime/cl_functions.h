@@ -164,6 +164,15 @@ CL_FN(cl_program,
                                   const char **     /* strings */,
                                   const size_t *    /* lengths */,
                                   cl_int *          /* errcode_ret */));
+CL_FN(cl_program,
+      clCreateProgramWithBinary, (cl_context                     /* context */,
+                                  cl_uint                        /* num_devices */,
+                                  const cl_device_id *           /* device_list */,
+                                  const size_t *                 /* lengths */,
+                                  const unsigned char **         /* binaries */,
+                                  cl_int *                       /* binary_status */,
+                                  cl_int *                       /* errcode_ret */));
+
 CL_FN(cl_int,
       clRetainProgram, (cl_program /* program */));
 
@@ -178,6 +187,13 @@ CL_FN(cl_int,
                        void (CL_CALLBACK *  /* pfn_notify */)(cl_program /* program */, void * /* user_data */),
                        void *               /* user_data */));
 
+CL_FN(cl_int,
+      clGetProgramInfo, (cl_program         /* program */,
+                         cl_program_info    /* param_name */,
+                         size_t             /* param_value_size */,
+                         void *             /* param_value */,
+                         size_t *           /* param_value_size_ret */));
+
 CL_FN(cl_int,
       clGetProgramBuildInfo, (cl_program            /* program */,
                               cl_device_id          /* device */,
@@ -204,6 +220,17 @@ CL_FN(cl_int,
                        size_t       /* arg_size */,
                        const void * /* arg_value */));
 
+/* Event Object APIs */
+CL_FN(cl_int,
+      clWaitForEvents, (cl_uint             /* num_events */,
+                        const cl_event *    /* event_list */));
+
+CL_FN(cl_int,
+      clRetainEvent, (cl_event /* event */));
+
+CL_FN(cl_int,
+      clReleaseEvent, (cl_event /* event */));
+
 /* Flush and Finish APIs */
 CL_FN(cl_int,
       clFlush, (cl_command_queue /* command_queue */));
@@ -266,6 +293,17 @@ CL_FN(cl_int,
                                  const cl_event *    /* event_wait_list */,
                                  cl_event *          /* event */));
 
+CL_FN(cl_int,
+      clEnqueueCopyBuffer, (cl_command_queue    /* command_queue */,
+                            cl_mem              /* src_buffer */,
+                            cl_mem              /* dst_buffer */,
+                            size_t              /* src_offset */,
+                            size_t              /* dst_offset */,
+                            size_t              /* size */,
+                            cl_uint             /* num_events_in_wait_list */,
+                            const cl_event *    /* event_wait_list */,
+                            cl_event *          /* event */));
+
 CL_FN(cl_int,
       clEnqueueReadImage, (cl_command_queue     /* command_queue */,
                            cl_mem               /* image */,
@@ -0,0 +1,121 @@
+// Semaphores and concurrent tasks, used by Funcs scheduled
+// async. These are shared by every runtime with real threads. They
+// only need halide_spawn_thread, halide_join_thread and
+// halide_thread_yield from the platform.
+
+namespace Halide { namespace Runtime { namespace Internal {
+
+struct semaphore_impl {
+    int value;
+    int abandoned;
+};
+
+struct concurrent_tasks {
+    halide_task_t f;
+    void *user_context;
+    uint8_t *closure;
+    int exit_status;
+};
+
+struct concurrent_task {
+    concurrent_tasks *tasks;
+    int idx;
+    halide_thread *thread;
+};
+
+WEAK void run_concurrent_task(concurrent_task *t) {
+    concurrent_tasks *c = t->tasks;
+    int result = halide_do_task(c->user_context, c->f, t->idx, c->closure);
+    if (result) {
+        __sync_bool_compare_and_swap(&c->exit_status, 0, result);
+    }
+}
+
+WEAK void concurrent_task_thread(void *arg) {
+    run_concurrent_task((concurrent_task *)arg);
+}
+
+}}} // namespace Halide::Runtime::Internal
+
+using namespace Halide::Runtime::Internal;
+
+extern "C" {
+
+WEAK int halide_semaphore_init(halide_semaphore_t *s, int count) {
+    semaphore_impl *sem = (semaphore_impl *)s;
+    sem->value = count;
+    sem->abandoned = 0;
+    __sync_synchronize();
+    return 0;
+}
+
+WEAK int halide_semaphore_release(halide_semaphore_t *s, int count) {
+    semaphore_impl *sem = (semaphore_impl *)s;
+    __sync_fetch_and_add(&sem->value, count);
+    return 0;
+}
+
+WEAK int halide_semaphore_acquire(halide_semaphore_t *s, int count) {
+    semaphore_impl *sem = (semaphore_impl *)s;
+    // The tasks waiting on each other are only ever a short way apart
+    // (a producer runs at most one production ahead of its consumer),
+    // so spin rather than sleeping.
+    while (true) {
+        // Check for abandonment first: anything released before
+        // the semaphore was abandoned is then visible below.
+        int abandoned = __sync_fetch_and_add(&sem->abandoned, 0);
+        int value = __sync_fetch_and_add(&sem->value, 0);
+        if (value >= count) {
+            if (__sync_bool_compare_and_swap(&sem->value, value, value - count)) {
+                return 0;
+            }
+        } else if (abandoned) {
+            return halide_error_code_generic_error;
+        } else {
+            halide_thread_yield();
+        }
+    }
+}
+
+WEAK void halide_semaphore_abandon(void *user_context, void *s) {
+    semaphore_impl *sem = (semaphore_impl *)s;
+    __sync_fetch_and_add(&sem->abandoned, 1);
+}
+
+WEAK int halide_do_concurrent_tasks(void *user_context, halide_task_t f,
+                                    int min, int size, uint8_t *closure) {
+    if (size <= 0) return 0;
+
+    concurrent_tasks c;
+    c.f = f;
+    c.user_context = user_context;
+    c.closure = closure;
+    c.exit_status = 0;
+
+    concurrent_task *tasks = (concurrent_task *)malloc(size * sizeof(concurrent_task));
+    if (!tasks) {
+        return halide_error_code_out_of_memory;
+    }
+
+    // Spawn a thread for every task but the first, rather than
+    // queueing them on the thread pool, where a worker blocked on a
+    // semaphore could be the one the task it waits for is queued
+    // behind.
+    for (int i = 0; i < size; i++) {
+        tasks[i].tasks = &c;
+        tasks[i].idx = min + i;
+        tasks[i].thread = NULL;
+    }
+    for (int i = 1; i < size; i++) {
+        tasks[i].thread = halide_spawn_thread(concurrent_task_thread, &tasks[i]);
+    }
+    run_concurrent_task(&tasks[0]);
+    for (int i = 1; i < size; i++) {
+        halide_join_thread(tasks[i].thread);
+    }
+
+    free(tasks);
+    return c.exit_status;
+}
+
+}  // extern "C"
@@ -1,7 +1,10 @@
 #include "HalideRuntimeCuda.h"
 #include "device_buffer_utils.h"
 #include "device_interface.h"
+#include "device_memory_pool.h"
+#include "gpu_kernel_cache.h"
 #include "printer.h"
+#include "scoped_mutex_lock.h"
 #include "mini_cuda.h"
 
 #define INLINE inline __attribute__((always_inline))
@@ -72,9 +75,91 @@ extern WEAK halide_device_interface_t cuda_device_interface;
 WEAK const char *get_error_name(CUresult error);
 WEAK CUresult create_cuda_context(void *user_context, CUcontext *ctx);
 
-// A cuda context defined in this module with weak linkage
+// A cuda context defined in this module with weak linkage. Created
+// and destroyed under state_lock, and read without it.
 CUcontext WEAK context = 0;
-volatile int WEAK thread_lock = 0;
+
+// Guards the creation of the context above and the tables of runtime
+// state below. It is only held while they are read or updated, never
+// across a whole call, so that threads driving the GPU concurrently
+// don't serialize on it. CUDA contexts themselves may be current on
+// any number of threads at once.
+WEAK halide_mutex state_lock = { { 0 } };
+
+// Serializes launches on peer devices, which share the peers' streams
+// and events. Taken before state_lock, never while holding it.
+WEAK halide_mutex peer_launch_lock = { { 0 } };
+
+// Holds a mutex from when it's given one until it goes out of scope.
+struct ConditionalMutexLock {
+    halide_mutex *mutex;
+    INLINE ConditionalMutexLock() : mutex(NULL) {}
+    INLINE void lock(halide_mutex *m) {
+        mutex = m;
+        halide_mutex_lock(mutex);
+    }
+    INLINE ~ConditionalMutexLock() {
+        if (mutex) {
+            halide_mutex_unlock(mutex);
+        }
+    }
+};
+
+// The streams created by the default halide_cuda_get_stream, one per
+// (user_context, context) pair. Only touched while state_lock is
+// held. Once the table is full, further user_contexts fall back to
+// the legacy default stream, which is always correct, just not
+// concurrent.
+struct stream_entry {
+    void *user_context;
+    CUcontext context;
+    CUstream stream;
+};
+#define MAX_CUDA_STREAMS 16
+WEAK stream_entry streams[MAX_CUDA_STREAMS];
+WEAK int num_streams = 0;
+
+// Device allocations freed by halide_cuda_device_free, kept for reuse.
+// Only touched while state_lock is held.
+WEAK device_memory_pool memory_pool;
+
+WEAK void release_pooled_allocation(void *user_context, uint64_t handle) {
+    debug(user_context) << "    cuMemFree " << (void *)handle << "\n";
+    cuMemFree((CUdeviceptr)handle);
+}
+
+// Contexts on the other devices in the machine, used to run the slices
+// of a gpu_blocks loop split across devices by Func::gpu_devices.
+// Buffers stay on the main context's device and kernels on a peer
+// reach them through peer access. A slot with a NULL context but a
+// main_context is a device that can't access the main device's
+// memory; slices mapped to it run on the main device instead. Only
+// touched while state_lock is held.
+struct peer_device {
+    CUcontext main_context;
+    CUdevice device;
+    CUcontext context;
+    CUstream stream;
+    // Recorded on the main stream before each launch on the peer, and
+    // on the peer's stream after it. Like the stream, only used while
+    // peer_launch_lock is held.
+    CUevent ready, done;
+};
+#define MAX_CUDA_PEER_DEVICES 8
+WEAK peer_device peers[MAX_CUDA_PEER_DEVICES];
+
+// The device slice each user_context is currently launching, set by
+// halide_cuda_set_launch_device, and a bitmask of the peers it has
+// launched on since the last halide_cuda_join_devices. Only touched
+// while state_lock is held.
+struct launch_device_entry {
+    void *user_context;
+    int device;
+    uint32_t pending;
+};
+#define MAX_CUDA_LAUNCH_DEVICE_ENTRIES 16
+WEAK launch_device_entry launch_devices[MAX_CUDA_LAUNCH_DEVICE_ENTRIES];
+WEAK int num_launch_devices = 0;
 
 }}}} // namespace Halide::Runtime::Internal::Cuda
 
@@ -83,39 +168,89 @@ using namespace Halide::Runtime::Internal::Cuda;
 
 extern "C" {
 
-// The default implementation of halide_cuda_acquire_context uses the global
-// pointers above, and serializes access with a spin lock.
+// The default implementation of halide_cuda_acquire_context returns the
+// global context above, creating it on first use, and shares it between
+// all threads without serializing them: the runtime pushes the context
+// onto the calling thread with cuCtxPushCurrent for the duration of
+// each call, and guards its own tables with state_lock.
 // Overriding implementations of acquire/release must implement the following
 // behavior:
-// - halide_cuda_acquire_context should always store a valid context/command
-//   queue in ctx/q, or return an error code.
+// - halide_cuda_acquire_context should always store a valid context in
+//   ctx, or return an error code.
 // - A call to halide_cuda_acquire_context is followed by a matching call to
-//   halide_cuda_release_context. halide_cuda_acquire_context should block while a
-//   previous call (if any) has not yet been released via halide_cuda_release_context.
+//   halide_cuda_release_context.
+// - They may be called from several threads at once, and need not block.
+// To drive several devices, e.g. with one thread per device, give each
+// device its own context, and return the one belonging to the
+// user_context passed in. Each user_context then gets its own streams.
 WEAK int halide_cuda_acquire_context(void *user_context, CUcontext *ctx, bool create = true) {
     // TODO: Should we use a more "assertive" assert? these asserts do
     // not block execution on failure.
     halide_assert(user_context, ctx != NULL);
 
-    halide_assert(user_context, &thread_lock != NULL);
-    while (__sync_lock_test_and_set(&thread_lock, 1)) { }
-
     // If the context has not been initialized, initialize it now.
-    halide_assert(user_context, &context != NULL);
-    if (context == NULL && create) {
-        CUresult error = create_cuda_context(user_context, &context);
-        if (error != CUDA_SUCCESS) {
-            __sync_lock_release(&thread_lock);
-            return error;
+    CUcontext c = __atomic_load_n(&context, __ATOMIC_ACQUIRE);
+    if (c == NULL && create) {
+        ScopedMutexLock lock(&state_lock);
+        c = context;
+        if (c == NULL) {
+            CUresult error = create_cuda_context(user_context, &c);
+            if (error != CUDA_SUCCESS) {
+                return error;
+            }
+            __atomic_store_n(&context, c, __ATOMIC_RELEASE);
         }
     }
 
-    *ctx = context;
+    *ctx = c;
     return 0;
 }
 
 WEAK int halide_cuda_release_context(void *user_context) {
-    __sync_lock_release(&thread_lock);
+    return 0;
+}
+
+// The default implementation of halide_cuda_get_stream gives each
+// non-NULL user_context its own stream, created on first use. The
+// streams are created blocking with respect to the legacy default
+// stream, so work issued by code that doesn't know about them is
+// still ordered against Halide's. Overriding implementations must
+// return a stream belonging to ctx, may assume ctx is current, and
+// may be called from several threads at once.
+WEAK int halide_cuda_get_stream(void *user_context, CUcontext ctx, CUstream *stream) {
+    *stream = 0;
+    if (user_context == NULL) {
+        return 0;
+    }
+
+    ScopedMutexLock lock(&state_lock);
+
+    for (int i = 0; i < num_streams; i++) {
+        if (streams[i].user_context == user_context && streams[i].context == ctx) {
+            *stream = streams[i].stream;
+            return 0;
+        }
+    }
+
+    if (num_streams == MAX_CUDA_STREAMS) {
+        return 0;
+    }
+
+    CUstream s;
+    CUresult err = cuStreamCreate(&s, CU_STREAM_DEFAULT);
+    if (err != CUDA_SUCCESS) {
+        error(user_context) << "CUDA: cuStreamCreate failed: "
+                            << get_error_name(err);
+        return err;
+    }
+    debug(user_context) << "    cuStreamCreate " << (void *)s
+                        << " for user_context " << user_context << "\n";
+
+    streams[num_streams].user_context = user_context;
+    streams[num_streams].context = ctx;
+    streams[num_streams].stream = s;
+    num_streams++;
+    *stream = s;
     return 0;
 }
 
@@ -163,8 +298,27 @@ public:
 // Also used as a linked-list to keep track of all the different
 // modules that are attached to a context in order to release them all
 // when then context is released.
+// The kernels of a module already looked up, so that launching one
+// doesn't go back to the driver for it. Tiny kernels are dominated by
+// the CPU cost of the launch.
+struct cached_function {
+    const char *entry_name;
+    CUfunction function;
+};
+#define MAX_CUDA_CACHED_FUNCTIONS 64
+
 struct module_state {
     CUmodule module;
+    // The PTX the module was built from, and the same module loaded on
+    // each peer device, built when a kernel first runs there.
+    const char *ptx_src;
+    int size;
+    // The peer modules are only touched while peer_launch_lock is held.
+    CUmodule peer_modules[MAX_CUDA_PEER_DEVICES];
+    // The functions of module, which are forgotten whenever it's
+    // unloaded. Only touched while state_lock is held.
+    cached_function functions[MAX_CUDA_CACHED_FUNCTIONS];
+    int num_functions;
     module_state *next;
 };
 WEAK module_state *state_list = NULL;
@@ -321,7 +475,8 @@ WEAK CUresult create_cuda_context(void *user_context, CUcontext *ctx) {
     }
     // Creation automatically pushes the context, but we'll pop to allow the caller
     // to decide when to push.
-    err = cuCtxPopCurrent(&context);
+    CUcontext old;
+    err = cuCtxPopCurrent(&old);
     if (err != CUDA_SUCCESS) {
       error(user_context) << "CUDA: cuCtxPopCurrent failed: "
                           << get_error_name(err);
@@ -362,6 +517,301 @@ WEAK bool validate_device_pointer(void *user_context, buffer_t* buf, size_t size
 
 }}}} // namespace Halide::Runtime::Internal
 
+namespace Halide { namespace Runtime { namespace Internal { namespace Cuda {
+
+// The key for the on-disk kernel cache: the PTX, the JIT options, and
+// the device and driver the cubin is compiled for.
+WEAK uint64_t kernel_cache_key(const char *ptx_src, int size, unsigned int max_regs_per_thread) {
+    uint64_t h = kernel_cache_hash(kKernelCacheHashSeed, ptx_src, size);
+    h = kernel_cache_hash(h, &max_regs_per_thread, sizeof(max_regs_per_thread));
+    CUdevice dev;
+    if (cuCtxGetDevice(&dev) == CUDA_SUCCESS) {
+        char name[256];
+        name[0] = 0;
+        cuDeviceGetName(name, sizeof(name) - 1, dev);
+        name[sizeof(name) - 1] = 0;
+        h = kernel_cache_hash_string(h, name);
+        int cc[2] = {0, 0};
+        cuDeviceGetAttribute(&cc[0], CU_DEVICE_ATTRIBUTE_COMPUTE_CAPABILITY_MAJOR, dev);
+        cuDeviceGetAttribute(&cc[1], CU_DEVICE_ATTRIBUTE_COMPUTE_CAPABILITY_MINOR, dev);
+        h = kernel_cache_hash(h, cc, sizeof(cc));
+    }
+    int driver_version = 0;
+    cuDriverGetVersion(&driver_version);
+    return kernel_cache_hash(h, &driver_version, sizeof(driver_version));
+}
+
+// Load the module for this PTX from the on-disk kernel cache, or
+// compile it through the linker so that the resulting cubin can be
+// cached. Returns NULL, without raising an error, if either fails.
+WEAK CUmodule load_module_with_cache(void *user_context, const char *ptx_src, int size,
+                                     CUjit_option *options, void **optionValues, unsigned int max_regs_per_thread) {
+    uint64_t key = kernel_cache_key(ptx_src, size, max_regs_per_thread);
+
+    CUmodule module = NULL;
+    size_t cubin_size = 0;
+    void *cubin = kernel_cache_load(user_context, "cuda", key, &cubin_size);
+    if (cubin) {
+        debug(user_context) << "    cuModuleLoadData (cached cubin) " << (uint64_t)cubin_size << " bytes\n";
+        if (cuModuleLoadData(&module, cubin) != CUDA_SUCCESS) {
+            module = NULL;
+        }
+        free(cubin);
+        if (module) {
+            return module;
+        }
+    }
+
+    CUlinkState link;
+    if (cuLinkCreate(1, options, optionValues, &link) != CUDA_SUCCESS) {
+        return NULL;
+    }
+    void *image = NULL;
+    size_t image_size = 0;
+    debug(user_context) << "    cuLinkAddData " << (void *)ptx_src << ", " << size << "\n";
+    if (cuLinkAddData(link, CU_JIT_INPUT_PTX, (void *)ptx_src, size, "halide", 0, NULL, NULL) == CUDA_SUCCESS &&
+        cuLinkComplete(link, &image, &image_size) == CUDA_SUCCESS &&
+        cuModuleLoadData(&module, image) == CUDA_SUCCESS) {
+        kernel_cache_store(user_context, "cuda", key, image, image_size);
+    } else {
+        module = NULL;
+    }
+    // The cubin belongs to the linker state.
+    cuLinkDestroy(link);
+    return module;
+}
+
+// Load a module from PTX into the current context.
+WEAK CUresult load_module(void *user_context, const char *ptx_src, int size, CUmodule *module) {
+    debug(user_context) <<  "    cuModuleLoadData " << (void *)ptx_src << ", " << size << " -> ";
+
+    *module = NULL;
+    CUjit_option options[] = { CU_JIT_MAX_REGISTERS };
+    unsigned int max_regs_per_thread = 64;
+
+    // A hack to enable control over max register count for
+    // testing. This should be surfaced in the schedule somehow
+    // instead.
+    char *regs = getenv("HL_CUDA_JIT_MAX_REGISTERS");
+    if (regs) {
+        max_regs_per_thread = atoi(regs);
+    }
+    void *optionValues[] = { (void*)(uintptr_t) max_regs_per_thread };
+
+    // With a kernel cache directory configured, reuse the cubin the
+    // driver compiled for this PTX on an earlier run.
+    if (get_kernel_cache_dir()) {
+        *module = load_module_with_cache(user_context, ptx_src, size,
+                                         options, optionValues, max_regs_per_thread);
+    }
+
+    CUresult err = CUDA_SUCCESS;
+    if (!*module) {
+        err = cuModuleLoadDataEx(module, ptx_src, 1, options, optionValues);
+    }
+
+    if (err != CUDA_SUCCESS) {
+        debug(user_context) << get_error_name(err) << "\n";
+        error(user_context) << "CUDA: cuModuleLoadData failed: "
+                            << get_error_name(err);
+        *module = NULL;
+    } else {
+        debug(user_context) << (void *)(*module) << "\n";
+    }
+    return err;
+}
+
+#ifdef DEBUG_RUNTIME
+// Report how full a launch keeps each multiprocessor, and warn if the
+// driver thinks another block size would keep it fuller. The occupancy
+// API needs a CUDA 6.5 driver, so it's looked up here rather than
+// required by load_libcuda.
+WEAK void report_occupancy(void *user_context, CUfunction f, int block_size, int shared_mem_bytes) {
+    typedef CUresult (CUDAAPI *max_active_blocks_fn)(int *, CUfunction, int, size_t);
+    typedef CUresult (CUDAAPI *max_block_size_fn)(int *, int *, CUfunction, CUoccupancyB2DSize, size_t, int);
+    typedef CUresult (CUDAAPI *func_get_attribute_fn)(int *, CUfunction_attribute, CUfunction);
+    max_active_blocks_fn max_active_blocks =
+        (max_active_blocks_fn)halide_cuda_get_symbol(user_context, "cuOccupancyMaxActiveBlocksPerMultiprocessor");
+    max_block_size_fn max_block_size =
+        (max_block_size_fn)halide_cuda_get_symbol(user_context, "cuOccupancyMaxPotentialBlockSize");
+    func_get_attribute_fn func_get_attribute =
+        (func_get_attribute_fn)halide_cuda_get_symbol(user_context, "cuFuncGetAttribute");
+    if (!max_active_blocks || !max_block_size || !func_get_attribute) {
+        return;
+    }
+
+    CUdevice dev;
+    int regs = 0, blocks = 0, min_grid_size = 0, best_block_size = 0, best_blocks = 0, max_threads = 0;
+    if (func_get_attribute(&regs, CU_FUNC_ATTRIBUTE_NUM_REGS, f) != CUDA_SUCCESS ||
+        max_active_blocks(&blocks, f, block_size, shared_mem_bytes) != CUDA_SUCCESS ||
+        max_block_size(&min_grid_size, &best_block_size, f, NULL, shared_mem_bytes, 0) != CUDA_SUCCESS ||
+        max_active_blocks(&best_blocks, f, best_block_size, shared_mem_bytes) != CUDA_SUCCESS ||
+        cuCtxGetDevice(&dev) != CUDA_SUCCESS ||
+        cuDeviceGetAttribute(&max_threads, CU_DEVICE_ATTRIBUTE_MAX_THREADS_PER_MULTIPROCESSOR, dev) != CUDA_SUCCESS ||
+        max_threads <= 0) {
+        return;
+    }
+
+    int occupancy = (100 * blocks * block_size) / max_threads;
+    int best_occupancy = (100 * best_blocks * best_block_size) / max_threads;
+    debug(user_context) << "    " << regs << " registers per thread, "
+                        << blocks << " blocks per multiprocessor, "
+                        << occupancy << "% occupancy\n";
+    if (best_occupancy > occupancy) {
+        debug(user_context) << "    Warning: blocks of " << best_block_size << " threads would reach "
+                            << best_occupancy << "% occupancy. Try gpu_launch_bounds or "
+                            << "gpu_max_registers, or a different number of gpu_threads.\n";
+    }
+}
+#endif
+
+WEAK launch_device_entry *find_launch_device(void *user_context, bool create) {
+    for (int i = 0; i < num_launch_devices; i++) {
+        if (launch_devices[i].user_context == user_context) {
+            return &launch_devices[i];
+        }
+    }
+    if (!create || num_launch_devices == MAX_CUDA_LAUNCH_DEVICE_ENTRIES) {
+        return NULL;
+    }
+    launch_device_entry *e = &launch_devices[num_launch_devices++];
+    e->user_context = user_context;
+    e->device = 0;
+    e->pending = 0;
+    return e;
+}
+
+// Tear down a peer slot. The main context must be current.
+WEAK void release_peer_device(void *user_context, int i) {
+    peer_device *p = &peers[i];
+    if (p->context) {
+        cuCtxPushCurrent(p->context);
+        for (module_state *state = state_list; state; state = state->next) {
+            if (state->peer_modules[i]) {
+                debug(user_context) << "    cuModuleUnload " << state->peer_modules[i] << "\n";
+                cuModuleUnload(state->peer_modules[i]);
+                state->peer_modules[i] = NULL;
+            }
+        }
+        if (p->done) {
+            cuEventDestroy(p->done);
+        }
+        if (p->stream) {
+            cuStreamDestroy(p->stream);
+        }
+        CUcontext old;
+        cuCtxPopCurrent(&old);
+        debug(user_context) << "    cuCtxDestroy " << p->context << "\n";
+        cuCtxDestroy(p->context);
+    }
+    if (p->ready) {
+        cuEventDestroy(p->ready);
+    }
+    memset(p, 0, sizeof(peer_device));
+}
+
+// Find the peer slot that runs device slice 'device' of a split loop
+// for the current (main) context. Slices map onto the machine's
+// devices round-robin starting from the main one. Returns -1, with
+// *err set to CUDA_SUCCESS, if the slice should run on the main
+// device: because it maps there, because the device can't reach the
+// main device's memory, or because there are no free slots.
+WEAK int get_peer_device(void *user_context, CUcontext main_ctx, int device, CUresult *err) {
+    int count = 0;
+    CUdevice main_dev;
+    *err = cuDeviceGetCount(&count);
+    if (*err == CUDA_SUCCESS) {
+        *err = cuCtxGetDevice(&main_dev);
+    }
+    if (*err != CUDA_SUCCESS) {
+        error(user_context) << "CUDA: can't query devices: " << get_error_name(*err);
+        return -1;
+    }
+    int main_ordinal = 0;
+    for (int i = 0; i < count; i++) {
+        CUdevice d;
+        if (cuDeviceGet(&d, i) == CUDA_SUCCESS && d == main_dev) {
+            main_ordinal = i;
+            break;
+        }
+    }
+    CUdevice dev;
+    *err = cuDeviceGet(&dev, (main_ordinal + device) % count);
+    if (*err != CUDA_SUCCESS) {
+        error(user_context) << "CUDA: cuDeviceGet failed: " << get_error_name(*err);
+        return -1;
+    }
+    if (dev == main_dev) {
+        return -1;
+    }
+
+    int free_slot = -1;
+    for (int i = 0; i < MAX_CUDA_PEER_DEVICES; i++) {
+        if (peers[i].main_context == main_ctx && peers[i].device == dev) {
+            return peers[i].context ? i : -1;
+        }
+        if (free_slot < 0 && peers[i].main_context == NULL) {
+            free_slot = i;
+        }
+    }
+    if (free_slot < 0) {
+        return -1;
+    }
+
+    peer_device *p = &peers[free_slot];
+    p->main_context = main_ctx;
+    p->device = dev;
+
+    int can_access = 0;
+    *err = cuDeviceCanAccessPeer(&can_access, dev, main_dev);
+    if (*err != CUDA_SUCCESS) {
+        error(user_context) << "CUDA: cuDeviceCanAccessPeer failed: " << get_error_name(*err);
+        release_peer_device(user_context, free_slot);
+        return -1;
+    }
+    if (!can_access) {
+        debug(user_context) << "    Device " << dev << " can't access device " << main_dev
+                            << "; running its slices there instead\n";
+        return -1;
+    }
+
+    // Creating the context makes it current.
+    *err = cuCtxCreate(&p->context, 0, dev);
+    if (*err != CUDA_SUCCESS) {
+        error(user_context) << "CUDA: cuCtxCreate failed: " << get_error_name(*err);
+        p->context = NULL;
+        release_peer_device(user_context, free_slot);
+        return -1;
+    }
+    debug(user_context) << "    Created peer context " << p->context << " on device " << dev << "\n";
+    *err = cuCtxEnablePeerAccess(main_ctx, 0);
+    if (*err == CUDA_ERROR_PEER_ACCESS_ALREADY_ENABLED) {
+        *err = CUDA_SUCCESS;
+    }
+    if (*err == CUDA_SUCCESS) {
+        *err = cuStreamCreate(&p->stream, CU_STREAM_NON_BLOCKING);
+    }
+    if (*err == CUDA_SUCCESS) {
+        *err = cuEventCreate(&p->done, CU_EVENT_DISABLE_TIMING);
+    }
+    CUcontext old;
+    cuCtxPopCurrent(&old);
+    // The ready event is recorded on the main stream, so it belongs to
+    // the main context.
+    if (*err == CUDA_SUCCESS) {
+        *err = cuEventCreate(&p->ready, CU_EVENT_DISABLE_TIMING);
+    }
+    if (*err != CUDA_SUCCESS) {
+        error(user_context) << "CUDA: setting up peer device " << dev << " failed: "
+                            << get_error_name(*err);
+        release_peer_device(user_context, free_slot);
+        return -1;
+    }
+    return free_slot;
+}
+
+}}}} // namespace Halide::Runtime::Internal::Cuda
+
 extern "C" {
 WEAK int halide_cuda_initialize_kernels(void *user_context, void **state_ptr, const char* ptx_src, int size) {
     debug(user_context) << "CUDA: halide_cuda_initialize_kernels (user_context: " << user_context
@@ -383,37 +833,34 @@ WEAK int halide_cuda_initialize_kernels(void *user_context, void **state_ptr, co
     // halide_release traverses this list and releases the module objects, but
     // it does not modify the list nodes created/inserted here.
     module_state **state = (module_state**)state_ptr;
-    if (!(*state)) {
-        *state = (module_state*)malloc(sizeof(module_state));
-        (*state)->module = NULL;
-        (*state)->next = state_list;
-        state_list = *state;
-    }
-
-    // Create the module itself if necessary.
-    if (!(*state)->module) {
-        debug(user_context) <<  "    cuModuleLoadData " << (void *)ptx_src << ", " << size << " -> ";
-
-        CUjit_option options[] = { CU_JIT_MAX_REGISTERS };
-        unsigned int max_regs_per_thread = 64;
-
-        // A hack to enable control over max register count for
-        // testing. This should be surfaced in the schedule somehow
-        // instead.
-        char *regs = getenv("HL_CUDA_JIT_MAX_REGISTERS");
-        if (regs) {
-            max_regs_per_thread = atoi(regs);
+    bool loaded;
+    {
+        ScopedMutexLock lock(&state_lock);
+        if (!(*state)) {
+            *state = (module_state*)malloc(sizeof(module_state));
+            memset(*state, 0, sizeof(module_state));
+            (*state)->next = state_list;
+            state_list = *state;
         }
-        void *optionValues[] = { (void*)(uintptr_t) max_regs_per_thread };
-        CUresult err = cuModuleLoadDataEx(&(*state)->module, ptx_src, 1, options, optionValues);
+        (*state)->ptx_src = ptx_src;
+        (*state)->size = size;
+        loaded = (*state)->module != NULL;
+    }
 
+    // Create the module itself if necessary. Compiling the PTX can be
+    // slow, so it's done without holding the lock, and if another
+    // thread got there first, its module is used instead.
+    if (!loaded) {
+        CUmodule module;
+        CUresult err = load_module(user_context, ptx_src, size, &module);
         if (err != CUDA_SUCCESS) {
-            debug(user_context) << get_error_name(err) << "\n";
-            error(user_context) << "CUDA: cuModuleLoadData failed: "
-                                << get_error_name(err);
             return err;
+        }
+        ScopedMutexLock lock(&state_lock);
+        if ((*state)->module) {
+            cuModuleUnload(module);
         } else {
-            debug(user_context) << (void *)((*state)->module) << "\n";
+            (*state)->module = module;
         }
     }
 
@@ -425,6 +872,13 @@ WEAK int halide_cuda_initialize_kernels(void *user_context, void **state_ptr, co
     return 0;
 }
 
+// A buffer from halide_cuda_device_and_host_malloc on an integrated
+// device may use mapped host memory directly as its device memory, in
+// which case the host and device pointers are the same.
+WEAK bool is_zero_copy(buffer_t *buf) {
+    return buf->host && buf->dev && (uint64_t)buf->host == halide_get_device_handle(buf->dev);
+}
+
 WEAK int halide_cuda_device_free(void *user_context, buffer_t* buf) {
     // halide_device_free, at present, can be exposed to clients and they
     // should be allowed to call halide_device_free on any buffer_t
@@ -449,8 +903,33 @@ WEAK int halide_cuda_device_free(void *user_context, buffer_t* buf) {
 
     halide_assert(user_context, validate_device_pointer(user_context, buf));
 
-    debug(user_context) <<  "    cuMemFree " << (void *)(dev_ptr) << "\n";
-    CUresult err = cuMemFree(dev_ptr);
+    // Keep whole allocations for reuse rather than freeing them, which
+    // is slow and synchronizes the device. Record the stream the
+    // buffer was last used on, so that reuse from another stream can
+    // wait for it.
+    CUstream stream;
+    CUdeviceptr base;
+    size_t real_size;
+    CUresult err;
+    bool pooled = false;
+    if (is_zero_copy(buf)) {
+        // The memory is owned by halide_cuda_device_and_host_free.
+        debug(user_context) <<  "    zero-copy " << (void *)(dev_ptr) << "\n";
+        pooled = true;
+    } else if (halide_cuda_get_stream(user_context, ctx.context, &stream) == 0 &&
+        cuMemGetAddressRange(&base, &real_size, dev_ptr) == CUDA_SUCCESS &&
+        base == dev_ptr) {
+        ScopedMutexLock lock(&state_lock);
+        pooled = device_pool_put(user_context, &memory_pool, (uint64_t)dev_ptr, real_size,
+                                 ctx.context, stream, release_pooled_allocation);
+    }
+    if (pooled) {
+        debug(user_context) <<  "    pooled " << (void *)(dev_ptr) << " (" << (uint64_t)real_size << " bytes)\n";
+        err = CUDA_SUCCESS;
+    } else {
+        debug(user_context) <<  "    cuMemFree " << (void *)(dev_ptr) << "\n";
+        err = cuMemFree(dev_ptr);
+    }
     // If cuMemFree fails, it isn't likely to succeed later, so just drop
     // the reference.
     halide_delete_device_wrapper(buf->dev);
@@ -489,6 +968,37 @@ WEAK int halide_cuda_device_release(void *user_context) {
         }
         halide_assert(user_context, err == CUDA_SUCCESS || err == CUDA_ERROR_DEINITIALIZED);
 
+        // Other threads must not be using the context while it's torn
+        // down; the locks only keep the tables consistent.
+        ScopedMutexLock peer_lock(&peer_launch_lock);
+        ScopedMutexLock lock(&state_lock);
+
+        // Release the cached allocations belonging to this context.
+        device_pool_trim(user_context, &memory_pool, 0, ctx, release_pooled_allocation);
+
+        // Tear down the peer contexts used to split loops across
+        // devices, along with the modules loaded on them.
+        for (int i = 0; i < MAX_CUDA_PEER_DEVICES; i++) {
+            if (peers[i].main_context == ctx) {
+                release_peer_device(user_context, i);
+            }
+        }
+        num_launch_devices = 0;
+
+        // Destroy the streams created on this context by the default
+        // halide_cuda_get_stream.
+        int kept = 0;
+        for (int i = 0; i < num_streams; i++) {
+            if (streams[i].context == ctx) {
+                debug(user_context) << "    cuStreamDestroy " << (void *)streams[i].stream << "\n";
+                err = cuStreamDestroy(streams[i].stream);
+                halide_assert(user_context, err == CUDA_SUCCESS || err == CUDA_ERROR_DEINITIALIZED);
+            } else {
+                streams[kept++] = streams[i];
+            }
+        }
+        num_streams = kept;
+
         // Unload the modules attached to this context. Note that the list
         // nodes themselves are not freed, only the module objects are
         // released. Subsequent calls to halide_init_kernels might re-create
@@ -501,6 +1011,7 @@ WEAK int halide_cuda_device_release(void *user_context) {
                 err = cuModuleUnload(state->module);
                 halide_assert(user_context, err == CUDA_SUCCESS || err == CUDA_ERROR_DEINITIALIZED);
                 state->module = 0;
+                state->num_functions = 0;
             }
             state = state->next;
         }
@@ -514,7 +1025,7 @@ WEAK int halide_cuda_device_release(void *user_context) {
             err = cuProfilerStop();
             err = cuCtxDestroy(context);
             halide_assert(user_context, err == CUDA_SUCCESS || err == CUDA_ERROR_DEINITIALIZED);
-            context = NULL;
+            __atomic_store_n(&context, (CUcontext)NULL, __ATOMIC_RELEASE);
         }
     }
 
@@ -561,16 +1072,59 @@ WEAK int halide_cuda_device_malloc(void *user_context, buffer_t *buf) {
     uint64_t t_before = halide_current_time_ns(user_context);
     #endif
 
+    CUstream stream;
+    int result = halide_cuda_get_stream(user_context, ctx.context, &stream);
+    if (result != 0) {
+        return result;
+    }
+
     CUdeviceptr p;
-    debug(user_context) << "    cuMemAlloc " << (uint64_t)size << " -> ";
-    CUresult err = cuMemAlloc(&p, size);
-    if (err != CUDA_SUCCESS) {
-        debug(user_context) << get_error_name(err) << "\n";
-        error(user_context) << "CUDA: cuMemAlloc failed: "
-                            << get_error_name(err);
-        return err;
+    CUresult err;
+    device_pool_block *block;
+    {
+        ScopedMutexLock lock(&state_lock);
+        block = device_pool_take(&memory_pool, size, ctx.context, stream);
+    }
+    if (block) {
+        p = (CUdeviceptr)block->handle;
+        debug(user_context) << "    reusing pooled " << (void *)p
+                            << " (" << (uint64_t)block->size << " bytes)\n";
+        // The previous owner may still have work in flight on
+        // another stream.
+        if ((CUstream)block->queue != stream) {
+            err = cuStreamSynchronize((CUstream)block->queue);
+            if (err != CUDA_SUCCESS) {
+                free(block);
+                cuMemFree(p);
+                error(user_context) << "CUDA: cuStreamSynchronize failed: "
+                                    << get_error_name(err);
+                return err;
+            }
+        }
+        free(block);
     } else {
-        debug(user_context) << (void *)p << "\n";
+        // Round up to the pool's size class, so that the allocation can
+        // serve any later request in the same class.
+        size_t alloc_size = device_pool_round_up(size);
+        debug(user_context) << "    cuMemAlloc " << (uint64_t)alloc_size << " -> ";
+        err = cuMemAlloc(&p, alloc_size);
+        if (err == CUDA_ERROR_OUT_OF_MEMORY) {
+            // Give the cached allocations back to the driver and
+            // try again.
+            debug(user_context) << get_error_name(err) << ", releasing pool\n";
+            ScopedMutexLock lock(&state_lock);
+            device_pool_trim(user_context, &memory_pool, 0, ctx.context, release_pooled_allocation);
+            debug(user_context) << "    cuMemAlloc " << (uint64_t)alloc_size << " -> ";
+            err = cuMemAlloc(&p, alloc_size);
+        }
+        if (err != CUDA_SUCCESS) {
+            debug(user_context) << get_error_name(err) << "\n";
+            error(user_context) << "CUDA: cuMemAlloc failed: "
+                                << get_error_name(err);
+            return err;
+        } else {
+            debug(user_context) << (void *)p << "\n";
+        }
     }
     halide_assert(user_context, p);
     buf->dev = halide_new_device_wrapper((uint64_t)p, &cuda_device_interface);
@@ -588,10 +1142,10 @@ WEAK int halide_cuda_device_malloc(void *user_context, buffer_t *buf) {
     return 0;
 }
 
-WEAK int halide_cuda_copy_to_device(void *user_context, buffer_t* buf) {
+WEAK int halide_cuda_copy_to_device_region(void *user_context, buffer_t* buf, uint64_t begin, uint64_t end) {
     debug(user_context)
-        <<  "CUDA: halide_cuda_copy_to_device (user_context: " << user_context
-        << ", buf: " << buf << ")\n";
+        <<  "CUDA: halide_cuda_copy_to_device_region (user_context: " << user_context
+        << ", buf: " << buf << ", bytes: [" << begin << ", " << end << "))\n";
 
     Context ctx(user_context);
     if (ctx.error != CUDA_SUCCESS) {
@@ -605,7 +1159,20 @@ WEAK int halide_cuda_copy_to_device(void *user_context, buffer_t* buf) {
     halide_assert(user_context, buf->host && buf->dev);
     halide_assert(user_context, validate_device_pointer(user_context, buf));
 
+    CUstream stream;
+    int result = halide_cuda_get_stream(user_context, ctx.context, &stream);
+    if (result != 0) {
+        return result;
+    }
+    CUresult err;
+
+    if (is_zero_copy(buf)) {
+        // The device reads the host memory directly.
+        return 0;
+    }
+
     device_copy c = make_host_to_device_copy(buf);
+    crop_device_copy(&c, begin, end);
 
     // TODO: Is this 32-bit or 64-bit? Leaving signed for now
     // in case negative strides.
@@ -613,19 +1180,23 @@ WEAK int halide_cuda_copy_to_device(void *user_context, buffer_t* buf) {
         for (int z = 0; z < (int)c.extent[2]; z++) {
             for (int y = 0; y < (int)c.extent[1]; y++) {
                 for (int x = 0; x < (int)c.extent[0]; x++) {
-                    uint64_t off = (x * c.stride_bytes[0] +
+                    uint64_t off = (c.offset +
+                                    x * c.stride_bytes[0] +
                                     y * c.stride_bytes[1] +
                                     z * c.stride_bytes[2] +
                                     w * c.stride_bytes[3]);
                     void *src = (void *)(c.src + off);
                     CUdeviceptr dst = (CUdeviceptr)(c.dst + off);
                     uint64_t size = c.chunk_size;
-                    debug(user_context) << "    cuMemcpyHtoD "
+                    debug(user_context) << "    cuMemcpyHtoDAsync "
                                         << "(" << x << ", " << y << ", " << z << ", " << w << "), "
                                         << src << " -> " << (void *)dst << ", " << size << " bytes\n";
-                    CUresult err = cuMemcpyHtoD(dst, src, size);
+                    // From pageable host memory, the driver has staged
+                    // the data by the time this returns. From pinned
+                    // memory it's a true async DMA; see below.
+                    err = cuMemcpyHtoDAsync(dst, src, size, stream);
                     if (err != CUDA_SUCCESS) {
-                        error(user_context) << "CUDA: cuMemcpyHtoD failed: "
+                        error(user_context) << "CUDA: cuMemcpyHtoDAsync failed: "
                                             << get_error_name(err);
                         return err;
                     }
@@ -635,6 +1206,18 @@ WEAK int halide_cuda_copy_to_device(void *user_context, buffer_t* buf) {
     }
 
 
+    // Callers may overwrite the host buffer as soon as we return, so a
+    // DMA out of page-locked memory has to finish first.
+    unsigned int host_flags;
+    if (cuMemHostGetFlags(&host_flags, buf->host) == CUDA_SUCCESS) {
+        err = cuStreamSynchronize(stream);
+        if (err != CUDA_SUCCESS) {
+            error(user_context) << "CUDA: cuStreamSynchronize failed: "
+                                << get_error_name(err);
+            return err;
+        }
+    }
+
     #ifdef DEBUG_RUNTIME
     uint64_t t_after = halide_current_time_ns(user_context);
     debug(user_context) << "    Time: " << (t_after - t_before) / 1.0e6 << " ms\n";
@@ -643,6 +1226,10 @@ WEAK int halide_cuda_copy_to_device(void *user_context, buffer_t* buf) {
     return 0;
 }
 
+WEAK int halide_cuda_copy_to_device(void *user_context, buffer_t* buf) {
+    return halide_cuda_copy_to_device_region(user_context, buf, 0, buf_size(buf));
+}
+
 WEAK int halide_cuda_copy_to_host(void *user_context, buffer_t* buf) {
     debug(user_context)
         << "CUDA: halide_cuda_copy_to_host (user_context: " << user_context
@@ -660,7 +1247,18 @@ WEAK int halide_cuda_copy_to_host(void *user_context, buffer_t* buf) {
     halide_assert(user_context, buf->dev && buf->dev);
     halide_assert(user_context, validate_device_pointer(user_context, buf));
 
+    CUstream stream;
+    int result = halide_cuda_get_stream(user_context, ctx.context, &stream);
+    if (result != 0) {
+        return result;
+    }
+    CUresult err;
+
+    // A zero-copy buffer only needs the stream to drain.
     device_copy c = make_device_to_host_copy(buf);
+    if (is_zero_copy(buf)) {
+        c.extent[0] = c.extent[1] = c.extent[2] = c.extent[3] = 0;
+    }
 
     // TODO: Is this 32-bit or 64-bit? Leaving signed for now
     // in case negative strides.
@@ -676,13 +1274,85 @@ WEAK int halide_cuda_copy_to_host(void *user_context, buffer_t* buf) {
                     void *dst = (void *)(c.dst + off);
                     uint64_t size = c.chunk_size;
 
-                    debug(user_context) << "    cuMemcpyDtoH "
+                    debug(user_context) << "    cuMemcpyDtoHAsync "
                                         << "(" << x << ", " << y << ", " << z << ", " << w << "), "
                                         << (void *)src << " -> " << dst << ", " << size << " bytes\n";
 
-                    CUresult err = cuMemcpyDtoH(dst, src, size);
+                    err = cuMemcpyDtoHAsync(dst, src, size, stream);
+                    if (err != CUDA_SUCCESS) {
+                        error(user_context) << "CUDA: cuMemcpyDtoHAsync failed: "
+                                            << get_error_name(err);
+                        return err;
+                    }
+                }
+            }
+        }
+    }
+
+    // The host data must be valid when we return, but only this
+    // pipeline's stream needs to drain.
+    err = cuStreamSynchronize(stream);
+    if (err != CUDA_SUCCESS) {
+        error(user_context) << "CUDA: cuStreamSynchronize failed: "
+                            << get_error_name(err);
+        return err;
+    }
+
+    #ifdef DEBUG_RUNTIME
+    uint64_t t_after = halide_current_time_ns(user_context);
+    debug(user_context) << "    Time: " << (t_after - t_before) / 1.0e6 << " ms\n";
+    #endif
+
+    return 0;
+}
+
+WEAK int halide_cuda_buffer_copy(void *user_context, buffer_t *src, buffer_t *dst) {
+    debug(user_context)
+        << "CUDA: halide_cuda_buffer_copy (user_context: " << user_context
+        << ", src: " << src << ", dst: " << dst << ")\n";
+
+    Context ctx(user_context);
+    if (ctx.error != CUDA_SUCCESS) {
+        return ctx.error;
+    }
+
+    #ifdef DEBUG_RUNTIME
+    uint64_t t_before = halide_current_time_ns(user_context);
+    #endif
+
+    halide_assert(user_context, src->dev && dst->dev);
+    halide_assert(user_context, validate_device_pointer(user_context, src));
+    halide_assert(user_context, validate_device_pointer(user_context, dst));
+
+    CUstream stream;
+    int result = halide_cuda_get_stream(user_context, ctx.context, &stream);
+    if (result != 0) {
+        return result;
+    }
+
+    device_copy c = make_buffer_to_buffer_copy(src, halide_get_device_handle(src->dev),
+                                               dst, halide_get_device_handle(dst->dev));
+
+    // The copies are ordered with the kernels on the stream, so
+    // nothing needs to wait for them here.
+    for (int w = 0; w < (int)c.extent[3]; w++) {
+        for (int z = 0; z < (int)c.extent[2]; z++) {
+            for (int y = 0; y < (int)c.extent[1]; y++) {
+                for (int x = 0; x < (int)c.extent[0]; x++) {
+                    uint64_t off = (c.offset +
+                                    x * c.stride_bytes[0] +
+                                    y * c.stride_bytes[1] +
+                                    z * c.stride_bytes[2] +
+                                    w * c.stride_bytes[3]);
+                    CUdeviceptr from = (CUdeviceptr)(c.src + c.src_offset + off);
+                    CUdeviceptr to = (CUdeviceptr)(c.dst + off);
+                    uint64_t size = c.chunk_size;
+                    debug(user_context) << "    cuMemcpyDtoDAsync "
+                                        << "(" << x << ", " << y << ", " << z << ", " << w << "), "
+                                        << (void *)from << " -> " << (void *)to << ", " << size << " bytes\n";
+                    CUresult err = cuMemcpyDtoDAsync(to, from, size, stream);
                     if (err != CUDA_SUCCESS) {
-                        error(user_context) << "CUDA: cuMemcpyDtoH failed: "
+                        error(user_context) << "CUDA: cuMemcpyDtoDAsync failed: "
                                             << get_error_name(err);
                         return err;
                     }
@@ -713,9 +1383,17 @@ WEAK int halide_cuda_device_sync(void *user_context, struct buffer_t *) {
     uint64_t t_before = halide_current_time_ns(user_context);
     #endif
 
-    CUresult err = cuCtxSynchronize();
+    CUstream stream;
+    int result = halide_cuda_get_stream(user_context, ctx.context, &stream);
+    if (result != 0) {
+        return result;
+    }
+
+    // Only wait for the work issued on behalf of this user_context;
+    // other pipelines sharing the context keep running.
+    CUresult err = cuStreamSynchronize(stream);
     if (err != CUDA_SUCCESS) {
-        error(user_context) << "CUDA: cuCtxSynchronize failed: "
+        error(user_context) << "CUDA: cuStreamSynchronize failed: "
                             << get_error_name(err);
         return err;
     }
@@ -728,6 +1406,76 @@ WEAK int halide_cuda_device_sync(void *user_context, struct buffer_t *) {
     return 0;
 }
 
+WEAK int halide_cuda_release_unused_device_allocations(void *user_context) {
+    debug(user_context)
+        << "CUDA: halide_cuda_release_unused_device_allocations (user_context: " << user_context << ")\n";
+
+    Context ctx(user_context);
+    if (ctx.error != CUDA_SUCCESS) {
+        return ctx.error;
+    }
+
+    ScopedMutexLock lock(&state_lock);
+    device_pool_trim(user_context, &memory_pool, 0, ctx.context, release_pooled_allocation);
+    return 0;
+}
+
+WEAK int halide_cuda_set_launch_device(void *user_context, int device) {
+    debug(user_context)
+        << "CUDA: halide_cuda_set_launch_device (user_context: " << user_context
+        << ", device: " << device << ")\n";
+
+    Context ctx(user_context);
+    if (ctx.error != CUDA_SUCCESS) {
+        return ctx.error;
+    }
+
+    // If the table is full, every slice runs on the main device.
+    ScopedMutexLock lock(&state_lock);
+    launch_device_entry *launch = find_launch_device(user_context, device != 0);
+    if (launch) {
+        launch->device = device;
+    }
+    return 0;
+}
+
+WEAK int halide_cuda_join_devices(void *user_context) {
+    debug(user_context)
+        << "CUDA: halide_cuda_join_devices (user_context: " << user_context << ")\n";
+
+    Context ctx(user_context);
+    if (ctx.error != CUDA_SUCCESS) {
+        return ctx.error;
+    }
+
+    CUstream stream;
+    int result = halide_cuda_get_stream(user_context, ctx.context, &stream);
+    if (result != 0) {
+        return result;
+    }
+
+    ScopedMutexLock lock(&state_lock);
+    launch_device_entry *launch = find_launch_device(user_context, false);
+    if (!launch) {
+        return 0;
+    }
+    launch->device = 0;
+
+    // Later work on our stream waits for the slices run on peers.
+    for (int i = 0; i < MAX_CUDA_PEER_DEVICES; i++) {
+        if (launch->pending & (1u << i)) {
+            CUresult err = cuStreamWaitEvent(stream, peers[i].done, 0);
+            if (err != CUDA_SUCCESS) {
+                error(user_context) << "CUDA: cuStreamWaitEvent failed: "
+                                    << get_error_name(err);
+                return err;
+            }
+        }
+    }
+    launch->pending = 0;
+    return 0;
+}
+
 WEAK int halide_cuda_run(void *user_context,
                          void *state_ptr,
                          const char* entry_name,
@@ -762,13 +1510,100 @@ WEAK int halide_cuda_run(void *user_context,
     #endif
 
     halide_assert(user_context, state_ptr);
-    CUmodule mod = ((module_state*)state_ptr)->module;
+    module_state *state = (module_state*)state_ptr;
+    CUmodule mod = state->module;
     debug(user_context) << "Got module " << mod << "\n";
     halide_assert(user_context, mod);
-    CUfunction f;
-    err = cuModuleGetFunction(&f, mod, entry_name);
+
+    CUstream stream;
+    int result = halide_cuda_get_stream(user_context, ctx.context, &stream);
+    if (result != 0) {
+        return result;
+    }
+
+    // If this launch is a slice of a loop split across devices, it may
+    // belong on a peer. The peer's stream first waits for everything
+    // already issued on ours, so the slice sees its inputs. The peers'
+    // events are shared by everyone launching on them, so launches on
+    // peers are serialized by peer_launch_lock. Ordinary launches only
+    // hold state_lock while they look things up.
+    ConditionalMutexLock peer_lock;
+    launch_device_entry *launch;
+    int device;
+    {
+        ScopedMutexLock lock(&state_lock);
+        launch = find_launch_device(user_context, false);
+        device = launch ? launch->device : 0;
+    }
+    int peer = -1;
+    err = CUDA_SUCCESS;
+    if (device != 0) {
+        peer_lock.lock(&peer_launch_lock);
+        {
+            ScopedMutexLock lock(&state_lock);
+            peer = get_peer_device(user_context, ctx.context, device, &err);
+        }
+        if (err != CUDA_SUCCESS) {
+            return err;
+        }
+    }
+    CUstream launch_stream = stream;
+    if (peer >= 0) {
+        debug(user_context) << "    Launching device slice " << device
+                            << " on peer context " << peers[peer].context << "\n";
+        err = cuEventRecord(peers[peer].ready, stream);
+        if (err != CUDA_SUCCESS) {
+            error(user_context) << "CUDA: cuEventRecord failed: "
+                                << get_error_name(err);
+            return err;
+        }
+        cuCtxPushCurrent(peers[peer].context);
+        if (!state->peer_modules[peer]) {
+            err = load_module(user_context, state->ptx_src, state->size, &state->peer_modules[peer]);
+        }
+        if (err == CUDA_SUCCESS) {
+            err = cuStreamWaitEvent(peers[peer].stream, peers[peer].ready, 0);
+        }
+        if (err != CUDA_SUCCESS) {
+            CUcontext old;
+            cuCtxPopCurrent(&old);
+            error(user_context) << "CUDA: preparing peer launch failed: "
+                                << get_error_name(err);
+            return err;
+        }
+        mod = state->peer_modules[peer];
+        launch_stream = peers[peer].stream;
+    }
+
+    CUfunction f = NULL;
+    err = CUDA_SUCCESS;
+    if (peer < 0) {
+        ScopedMutexLock lock(&state_lock);
+        for (int i = 0; i < state->num_functions; i++) {
+            if (state->functions[i].entry_name == entry_name ||
+                strcmp(state->functions[i].entry_name, entry_name) == 0) {
+                f = state->functions[i].function;
+                break;
+            }
+        }
+    }
+    if (!f) {
+        err = cuModuleGetFunction(&f, mod, entry_name);
+        if (err == CUDA_SUCCESS && peer < 0) {
+            ScopedMutexLock lock(&state_lock);
+            if (state->num_functions < MAX_CUDA_CACHED_FUNCTIONS) {
+                state->functions[state->num_functions].entry_name = entry_name;
+                state->functions[state->num_functions].function = f;
+                state->num_functions++;
+            }
+        }
+    }
     debug(user_context) << "Got function " << f << "\n";
     if (err != CUDA_SUCCESS) {
+        if (peer >= 0) {
+            CUcontext old;
+            cuCtxPopCurrent(&old);
+        }
         error(user_context) << "CUDA: cuModuleGetFunction failed: "
                             << get_error_name(err);
         return err;
@@ -784,9 +1619,17 @@ WEAK int halide_cuda_run(void *user_context,
     }
 
     // We need storage for both the arg and the pointer to it if if
-    // has to be translated.
-    void** translated_args = (void **)malloc((num_args + 1) * sizeof(void *));
-    uint64_t *dev_handles = (uint64_t *)malloc(num_args * sizeof(uint64_t));
+    // has to be translated. Most kernels have few enough arguments to
+    // keep it on the stack.
+    const size_t max_stack_args = 32;
+    void *stack_args[max_stack_args + 1];
+    uint64_t stack_handles[max_stack_args + 1];
+    void **translated_args = stack_args;
+    uint64_t *dev_handles = stack_handles;
+    if (num_args > max_stack_args) {
+        translated_args = (void **)malloc((num_args + 1) * sizeof(void *));
+        dev_handles = (uint64_t *)malloc((num_args + 1) * sizeof(uint64_t));
+    }
     for (size_t i = 0; i <= num_args; i++) { // Get NULL at end.
         if (arg_is_buffer[i]) {
             halide_assert(user_context, arg_sizes[i] == sizeof(uint64_t));
@@ -799,15 +1642,30 @@ WEAK int halide_cuda_run(void *user_context,
         }
     }
 
+    #ifdef DEBUG_RUNTIME
+    report_occupancy(user_context, f, threadsX * threadsY * threadsZ, shared_mem_bytes);
+    #endif
+
     err = cuLaunchKernel(f,
                          blocksX,  blocksY,  blocksZ,
                          threadsX, threadsY, threadsZ,
                          shared_mem_bytes,
-                         NULL, // stream
+                         launch_stream,
                          translated_args,
                          NULL);
-    free(dev_handles);
-    free(translated_args);
+    if (translated_args != stack_args) {
+        free(dev_handles);
+        free(translated_args);
+    }
+    if (peer >= 0) {
+        if (err == CUDA_SUCCESS) {
+            err = cuEventRecord(peers[peer].done, launch_stream);
+            ScopedMutexLock lock(&state_lock);
+            launch->pending |= 1u << peer;
+        }
+        CUcontext old;
+        cuCtxPopCurrent(&old);
+    }
     if (err != CUDA_SUCCESS) {
         error(user_context) << "CUDA: cuLaunchKernel failed: "
                             << get_error_name(err);
@@ -815,9 +1673,9 @@ WEAK int halide_cuda_run(void *user_context,
     }
 
     #ifdef DEBUG_RUNTIME
-    err = cuCtxSynchronize();
+    err = cuStreamSynchronize(launch_stream);
     if (err != CUDA_SUCCESS) {
-        error(user_context) << "CUDA: cuCtxSynchronize failed: "
+        error(user_context) << "CUDA: cuStreamSynchronize failed: "
                             << get_error_name(err);
         return err;
     }
@@ -828,11 +1686,108 @@ WEAK int halide_cuda_run(void *user_context,
 }
 
 WEAK int halide_cuda_device_and_host_malloc(void *user_context, struct buffer_t *buf) {
-    return halide_default_device_and_host_malloc(user_context, buf, &cuda_device_interface);
+    if (!use_pinned_host_allocations && !use_zero_copy_host_allocations) {
+        return halide_default_device_and_host_malloc(user_context, buf, &cuda_device_interface);
+    }
+
+    debug(user_context)
+        << "CUDA: halide_cuda_device_and_host_malloc (user_context: " << user_context
+        << ", buf: " << buf << ")\n";
+
+    size_t size = buf_size(buf);
+    void *host = NULL;
+    {
+        // Pop the context before halide_device_malloc pushes it
+        // again.
+        Context ctx(user_context);
+        if (ctx.error != CUDA_SUCCESS) {
+            return ctx.error;
+        }
+
+        // On an integrated device, device memory is carved out of the
+        // same DRAM, so mapped host memory avoids the copies entirely.
+        // This needs unified addressing so that the host and device
+        // pointers agree; otherwise fall back to a separate allocation.
+        CUdevice dev;
+        int integrated = 0, can_map = 0;
+        if (use_zero_copy_host_allocations &&
+            cuCtxGetDevice(&dev) == CUDA_SUCCESS &&
+            cuDeviceGetAttribute(&integrated, CU_DEVICE_ATTRIBUTE_INTEGRATED, dev) == CUDA_SUCCESS &&
+            cuDeviceGetAttribute(&can_map, CU_DEVICE_ATTRIBUTE_CAN_MAP_HOST_MEMORY, dev) == CUDA_SUCCESS &&
+            integrated && can_map) {
+            debug(user_context) << "    cuMemHostAlloc (mapped) " << (uint64_t)size << " -> ";
+            CUdeviceptr dev_ptr = 0;
+            if (cuMemHostAlloc(&host, size, CU_MEMHOSTALLOC_PORTABLE | CU_MEMHOSTALLOC_DEVICEMAP) == CUDA_SUCCESS) {
+                if (cuMemHostGetDevicePointer(&dev_ptr, host, 0) != CUDA_SUCCESS ||
+                    (uint64_t)dev_ptr != (uint64_t)host) {
+                    cuMemFreeHost(host);
+                    host = NULL;
+                }
+            } else {
+                host = NULL;
+            }
+            debug(user_context) << host << "\n";
+            if (host) {
+                buf->dev = halide_new_device_wrapper((uint64_t)dev_ptr, &cuda_device_interface);
+                if (!buf->dev) {
+                    cuMemFreeHost(host);
+                    return -1;
+                }
+                buf->host = (uint8_t *)host;
+                return 0;
+            }
+        }
+        if (!use_pinned_host_allocations) {
+            return halide_default_device_and_host_malloc(user_context, buf, &cuda_device_interface);
+        }
+
+        debug(user_context) << "    cuMemHostAlloc " << (uint64_t)size << " -> ";
+        CUresult err = cuMemHostAlloc(&host, size, CU_MEMHOSTALLOC_PORTABLE);
+        if (err != CUDA_SUCCESS) {
+            // Page-locked memory is a limited resource; fall back to
+            // pageable memory rather than failing.
+            debug(user_context) << get_error_name(err) << "\n";
+            host = NULL;
+        } else {
+            debug(user_context) << host << "\n";
+        }
+    }
+    if (!host) {
+        return halide_default_device_and_host_malloc(user_context, buf, &cuda_device_interface);
+    }
+
+    buf->host = (uint8_t *)host;
+    int result = halide_device_malloc(user_context, buf, &cuda_device_interface);
+    if (result != 0) {
+        Context ctx(user_context);
+        cuMemFreeHost(host);
+        buf->host = NULL;
+    }
+    return result;
 }
 
 WEAK int halide_cuda_device_and_host_free(void *user_context, struct buffer_t *buf) {
-    return halide_default_device_and_host_free(user_context, buf, &cuda_device_interface);
+    int result = halide_device_free(user_context, buf);
+
+    bool pinned = false;
+    if (buf->host && cuInit != NULL) {
+        Context ctx(user_context);
+        if (ctx.error == CUDA_SUCCESS) {
+            unsigned int flags;
+            if (cuMemHostGetFlags(&flags, buf->host) == CUDA_SUCCESS) {
+                debug(user_context) << "    cuMemFreeHost " << (void *)buf->host << "\n";
+                cuMemFreeHost(buf->host);
+                pinned = true;
+            }
+        }
+    }
+    if (!pinned) {
+        halide_free(user_context, buf->host);
+    }
+    buf->host = NULL;
+    buf->host_dirty = false;
+    buf->dev_dirty = false;
+    return result;
 }
 
 WEAK int halide_cuda_wrap_device_ptr(void *user_context, struct buffer_t *buf, uintptr_t device_ptr) {
@@ -935,6 +1890,8 @@ WEAK halide_device_interface_t cuda_device_interface = {
     halide_cuda_copy_to_device,
     halide_cuda_device_and_host_malloc,
     halide_cuda_device_and_host_free,
+    halide_cuda_copy_to_device_region,
+    halide_cuda_buffer_copy,
 };
 
 }}}} // namespace Halide::Runtime::Internal::Cuda
@@ -23,14 +23,29 @@ CUDA_FN_3020(CUresult, cuCtxCreate, cuCtxCreate_v2, (CUcontext *pctx, unsigned i
 CUDA_FN_4000(CUresult, cuCtxDestroy, cuCtxDestroy_v2, (CUcontext pctx));
 CUDA_FN(CUresult, cuProfilerStop, ());
 CUDA_FN(CUresult, cuCtxGetApiVersion, (CUcontext ctx, unsigned int *version));
+CUDA_FN(CUresult, cuCtxGetDevice, (CUdevice *device));
+CUDA_FN(CUresult, cuDriverGetVersion, (int *driverVersion));
 CUDA_FN(CUresult, cuModuleLoadData, (CUmodule *module, const void *image));
 CUDA_FN(CUresult, cuModuleLoadDataEx, (CUmodule *module, const void *image, unsigned int numOptions, CUjit_option* options, void** optionValues));
 CUDA_FN(CUresult, cuModuleUnload, (CUmodule module));
+CUDA_FN(CUresult, cuLinkCreate, (unsigned int numOptions, CUjit_option *options, void **optionValues, CUlinkState *stateOut));
+CUDA_FN(CUresult, cuLinkAddData, (CUlinkState state, CUjitInputType type, void *data, size_t size, const char *name,
+                                  unsigned int numOptions, CUjit_option *options, void **optionValues));
+CUDA_FN(CUresult, cuLinkComplete, (CUlinkState state, void **cubinOut, size_t *sizeOut));
+CUDA_FN(CUresult, cuLinkDestroy, (CUlinkState state));
 CUDA_FN(CUresult, cuModuleGetFunction, (CUfunction *hfunc, CUmodule hmod, const char *name));
 CUDA_FN_3020(CUresult, cuMemAlloc, cuMemAlloc_v2, (CUdeviceptr *dptr, size_t bytesize));
 CUDA_FN_3020(CUresult, cuMemFree, cuMemFree_v2, (CUdeviceptr dptr));
+CUDA_FN(CUresult, cuMemHostAlloc, (void **pp, size_t bytesize, unsigned int Flags));
+CUDA_FN(CUresult, cuMemFreeHost, (void *p));
+CUDA_FN(CUresult, cuMemHostGetFlags, (unsigned int *pFlags, void *p));
+CUDA_FN_3020(CUresult, cuMemHostGetDevicePointer, cuMemHostGetDevicePointer_v2, (CUdeviceptr *pdptr, void *p, unsigned int Flags));
+CUDA_FN_3020(CUresult, cuMemGetAddressRange, cuMemGetAddressRange_v2, (CUdeviceptr *pbase, size_t *psize, CUdeviceptr dptr));
 CUDA_FN_3020(CUresult, cuMemcpyHtoD, cuMemcpyHtoD_v2, (CUdeviceptr dstDevice, const void *srcHost, size_t ByteCount));
 CUDA_FN_3020(CUresult, cuMemcpyDtoH, cuMemcpyDtoH_v2, (void *dstHost, CUdeviceptr srcDevice, size_t ByteCount));
+CUDA_FN_3020(CUresult, cuMemcpyHtoDAsync, cuMemcpyHtoDAsync_v2, (CUdeviceptr dstDevice, const void *srcHost, size_t ByteCount, CUstream hStream));
+CUDA_FN_3020(CUresult, cuMemcpyDtoHAsync, cuMemcpyDtoHAsync_v2, (void *dstHost, CUdeviceptr srcDevice, size_t ByteCount, CUstream hStream));
+CUDA_FN_3020(CUresult, cuMemcpyDtoDAsync, cuMemcpyDtoDAsync_v2, (CUdeviceptr dstDevice, CUdeviceptr srcDevice, size_t ByteCount, CUstream hStream));
 CUDA_FN_3020(CUresult, cuMemcpy3D, cuMemcpy3D_v2, (const CUDA_MEMCPY3D *pCopy));
 CUDA_FN(CUresult, cuLaunchKernel, (CUfunction f,
                                    unsigned int gridDimX,
@@ -44,6 +59,15 @@ CUDA_FN(CUresult, cuLaunchKernel, (CUfunction f,
                                    void **kernelParams,
                                    void **extra));
 CUDA_FN(CUresult, cuCtxSynchronize, ());
+CUDA_FN(CUresult, cuStreamCreate, (CUstream *pStream, unsigned int Flags));
+CUDA_FN_4000(CUresult, cuStreamDestroy, cuStreamDestroy_v2, (CUstream hStream));
+CUDA_FN(CUresult, cuStreamSynchronize, (CUstream hStream));
+CUDA_FN(CUresult, cuStreamWaitEvent, (CUstream hStream, CUevent hEvent, unsigned int Flags));
+CUDA_FN(CUresult, cuEventCreate, (CUevent *phEvent, unsigned int Flags));
+CUDA_FN(CUresult, cuEventRecord, (CUevent hEvent, CUstream hStream));
+CUDA_FN_4000(CUresult, cuEventDestroy, cuEventDestroy_v2, (CUevent hEvent));
+CUDA_FN(CUresult, cuDeviceCanAccessPeer, (int *canAccessPeer, CUdevice dev, CUdevice peerDev));
+CUDA_FN(CUresult, cuCtxEnablePeerAccess, (CUcontext peerContext, unsigned int Flags));
 
 CUDA_FN_4000(CUresult, cuCtxPushCurrent, cuCtxPushCurrent_v2, (CUcontext ctx));
 CUDA_FN_4000(CUresult, cuCtxPopCurrent, cuCtxPopCurrent_v2, (CUcontext *pctx));
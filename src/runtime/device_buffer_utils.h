@@ -52,6 +52,11 @@ WEAK size_t buf_size(const buffer_t *buf) {
 #define MAX_COPY_DIMS 4
 struct device_copy {
     uint64_t src, dst;
+    // The offset (in bytes) from src and dst of the first copy task.
+    uint64_t offset;
+    // A further offset (in bytes) of src only, for copies between two
+    // buffers whose data starts at different places.
+    uint64_t src_offset;
     // The multidimensional array of contiguous copy tasks that need to be done.
     uint64_t extent[MAX_COPY_DIMS];
     // The strides (in bytes) that separate adjacent copy tasks in each dimension.
@@ -64,7 +69,7 @@ struct device_copy {
 
 WEAK void device_copy::copy_memory(void *user_context) const {
     // If this is a zero copy buffer, these pointers will be the same.
-    if (src != dst) {
+    if (src + src_offset != dst) {
         debug(user_context) << "device_copy::copy_memory: copying "
             << (extent[0] * extent[1] * extent[2] * extent[3] * chunk_size)
             << " bytes.\n";
@@ -74,11 +79,12 @@ WEAK void device_copy::copy_memory(void *user_context) const {
             for (int z = 0; z < (int)extent[2]; z++) {
                 for (int y = 0; y < (int)extent[1]; y++) {
                     for (int x = 0; x < (int)extent[0]; x++) {
-                        uint64_t off = (x * stride_bytes[0] +
+                        uint64_t off = (offset +
+                                        x * stride_bytes[0] +
                                         y * stride_bytes[1] +
                                         z * stride_bytes[2] +
                                         w * stride_bytes[3]);
-                        const void *from = (void *)(src + off);
+                        const void *from = (void *)(src + src_offset + off);
                         void *to = (void *)(dst + off);
                         memcpy(to, from, chunk_size);
                     }
@@ -95,6 +101,8 @@ WEAK device_copy make_host_to_device_copy(const buffer_t *buf) {
     device_copy c;
     c.src = (uint64_t)buf->host;
     c.dst = halide_get_device_handle(buf->dev);
+    c.offset = 0;
+    c.src_offset = 0;
     c.chunk_size = buf->elem_size;
     for (int i = 0; i < MAX_COPY_DIMS; i++) {
         c.extent[i] = 1;
@@ -152,6 +160,48 @@ WEAK device_copy make_host_to_device_copy(const buffer_t *buf) {
     return c;
 }
 
+// Restrict a copy to the tasks covering bytes [begin, end) of the
+// buffer, measured from its host pointer. Only the outermost
+// dimension of tasks is cropped, so this may still copy bytes outside
+// of the range, but never fewer than asked for.
+WEAK void crop_device_copy(device_copy *c, uint64_t begin, uint64_t end) {
+    int outer = MAX_COPY_DIMS - 1;
+    while (outer >= 0 && c->extent[outer] <= 1) {
+        outer--;
+    }
+    if (outer < 0) {
+        // A single contiguous chunk.
+        if (end > c->chunk_size) {
+            end = c->chunk_size;
+        }
+        if (begin < end) {
+            c->offset += begin;
+            c->chunk_size = end - begin;
+        } else {
+            c->chunk_size = 0;
+        }
+        return;
+    }
+    uint64_t stride = c->stride_bytes[outer];
+    // The tasks in the outer dimension that start before end, and
+    // end after begin.
+    uint64_t inner_span = c->chunk_size;
+    for (int i = 0; i < outer; i++) {
+        inner_span += (c->extent[i] - 1) * c->stride_bytes[i];
+    }
+    uint64_t first = begin < inner_span ? 0 : (begin - inner_span) / stride + 1;
+    uint64_t last = (end + stride - 1) / stride;
+    if (last > c->extent[outer]) {
+        last = c->extent[outer];
+    }
+    if (first >= last) {
+        c->extent[outer] = 0;
+        return;
+    }
+    c->offset += first * stride;
+    c->extent[outer] = last - first;
+}
+
 WEAK device_copy make_device_to_host_copy(const buffer_t *buf) {
     // Just make a host to dev copy and swap src and dst
     device_copy c = make_host_to_device_copy(buf);
@@ -161,6 +211,23 @@ WEAK device_copy make_device_to_host_copy(const buffer_t *buf) {
     return c;
 }
 
+// Make a copy job that copies the region of dst from src, where both
+// buffers have the same strides and element size and src contains
+// dst's region, e.g. from a buffer to a crop of it. The handles are
+// host pointers or device handles of the two buffers.
+WEAK device_copy make_buffer_to_buffer_copy(const buffer_t *src, uint64_t src_handle,
+                                            const buffer_t *dst, uint64_t dst_handle) {
+    device_copy c = make_host_to_device_copy(dst);
+    c.src = src_handle;
+    c.dst = dst_handle;
+    int64_t off = 0;
+    for (int i = 0; i < 4 && dst->extent[i]; i++) {
+        off += (int64_t)(dst->min[i] - src->min[i]) * src->stride[i];
+    }
+    c.src_offset = off * dst->elem_size;
+    return c;
+}
+
 }}} // namespace Halide::Runtime::Internal
 
 #endif // HALIDE_DEVICE_BUFFER_UTILS_H
@@ -3,6 +3,7 @@
 #include "device_interface.h"
 #include "printer.h"
 #include "scoped_mutex_lock.h"
+#include "scoped_spin_lock.h"
 
 extern "C" {
 
@@ -26,6 +27,55 @@ struct device_handle_wrapper {
 // a copy internaly as well.
 WEAK halide_mutex device_copy_mutex;
 
+// Set by halide_set_pinned_host_allocations, and read by the GPU
+// runtimes' device_and_host_malloc.
+WEAK bool use_pinned_host_allocations = false;
+
+// Set by halide_set_zero_copy_host_allocations, and read by the GPU
+// runtimes' device_malloc and device_and_host_malloc.
+WEAK bool use_zero_copy_host_allocations = false;
+
+// Device allocations that only hold part of their buffer's host data,
+// because halide_copy_to_device_region copied just that part and
+// cleared host_dirty. A buffer that isn't host_dirty is only known to
+// be current on the device within [begin, end) (bytes from host) if
+// it has an entry here, and everywhere if it doesn't. Entries are
+// keyed by the device wrapper, so they go away with the device
+// allocation. If the table is full, the whole buffer is copied
+// instead.
+struct partial_device_copy {
+    uint64_t dev;
+    uint8_t *host;
+    uint64_t begin, end;
+};
+#define MAX_PARTIAL_DEVICE_COPIES 32
+WEAK partial_device_copy partial_device_copies[MAX_PARTIAL_DEVICE_COPIES];
+WEAK volatile int partial_device_copies_lock = 0;
+
+WEAK partial_device_copy *find_partial_device_copy(uint64_t dev) {
+    for (int i = 0; i < MAX_PARTIAL_DEVICE_COPIES; i++) {
+        if (partial_device_copies[i].dev == dev) {
+            return &partial_device_copies[i];
+        }
+    }
+    return NULL;
+}
+
+// Forget the partial copy of a device allocation, returning whether
+// there was one.
+WEAK bool forget_partial_device_copy(uint64_t dev) {
+    if (dev == 0) {
+        return false;
+    }
+    ScopedSpinLock lock(&partial_device_copies_lock);
+    partial_device_copy *p = find_partial_device_copy(dev);
+    if (p) {
+        p->dev = 0;
+        return true;
+    }
+    return false;
+}
+
 WEAK int copy_to_host_already_locked(void *user_context, struct buffer_t *buf) {
     if (!buf->dev_dirty) {
         return 0;  // my, that was easy
@@ -73,6 +123,7 @@ WEAK uint64_t halide_new_device_wrapper(uint64_t handle, const struct halide_dev
 
 WEAK void halide_delete_device_wrapper(uint64_t wrapper) {
     device_handle_wrapper *wrapper_ptr = (device_handle_wrapper *)wrapper;
+    forget_partial_device_copy(wrapper);
     wrapper_ptr->interface->release_module();
     debug(NULL) << "Deleting device wrapper for interface " << wrapper_ptr->interface << " device_handle " << (void *)wrapper_ptr->device_handle << " at addr " << wrapper_ptr << "\n";
     free(wrapper_ptr);
@@ -114,12 +165,56 @@ WEAK int halide_copy_to_host(void *user_context, struct buffer_t *buf) {
     return copy_to_host_already_locked(user_context, buf);
 }
 
-/** Copy image data from host memory to device memory. This should not be
- * called directly; Halide handles copying to the device automatically. */
-WEAK int halide_copy_to_device(void *user_context, struct buffer_t *buf, const halide_device_interface_t *device_interface) {
-    int result = 0;
+}
 
-    ScopedMutexLock lock(&device_copy_mutex);
+namespace Halide { namespace Runtime { namespace Internal {
+
+// Move the device allocation of a buffer with no host allocation to
+// another device interface, copying its data through a temporary host
+// buffer.
+WEAK int move_device_allocation_already_locked(void *user_context, struct buffer_t *buf,
+                                               const halide_device_interface_t *from,
+                                               const halide_device_interface_t *to) {
+    size_t size = buf_size(buf);
+    uint8_t *staging = (uint8_t *)halide_malloc(user_context, size);
+    if (staging == NULL) {
+        return halide_error_code_out_of_memory;
+    }
+
+    buffer_t view = *buf;
+    view.host = staging;
+    int result = from->copy_to_host(user_context, &view);
+    if (result != 0) {
+        debug(user_context) << "halide_copy_to_device " << buf << " moving buffer copy_to_host failed\n";
+        result = halide_error_code_copy_to_host_failed;
+    }
+    if (result == 0) {
+        result = halide_device_free(user_context, buf);
+    }
+    if (result == 0) {
+        result = halide_device_malloc(user_context, buf, to);
+    }
+    if (result == 0) {
+        view = *buf;
+        view.host = staging;
+        result = to->copy_to_device(user_context, &view);
+        if (result != 0) {
+            debug(user_context) << "halide_copy_to_device " << buf << " moving buffer copy_to_device failed\n";
+            result = halide_error_code_copy_to_device_failed;
+        }
+    }
+
+    halide_free(user_context, staging);
+    return result;
+}
+
+// Make sure buf has a device allocation belonging to
+// *device_interface, moving it from any other device first. Sets
+// *device_interface if it was NULL.
+WEAK int prepare_copy_to_device_already_locked(void *user_context, struct buffer_t *buf,
+                                               const halide_device_interface_t **interface) {
+    int result = 0;
+    const halide_device_interface_t *device_interface = *interface;
 
     debug(user_context) << "halide_copy_to_device " << buf << ", host: " << buf->host << ", dev: " << buf->dev << ", host_dirty: " << buf->host_dirty << ", dev_dirty:" << buf->dev_dirty << "\n";
     const halide_device_interface_t *buf_dev_interface = halide_get_device_interface(buf->dev);
@@ -130,6 +225,15 @@ WEAK int halide_copy_to_device(void *user_context, struct buffer_t *buf, const h
             return halide_error_code_no_device_interface;
         }
         device_interface = buf_dev_interface;
+        *interface = device_interface;
+    }
+
+    if (buf->dev && buf_dev_interface != device_interface && buf->host == NULL &&
+        buf_dev_interface != NULL) {
+        // The data only lives on the old device, so it's staged through
+        // a temporary host copy.
+        debug(user_context) << "halide_copy_to_device " << buf << " moving device-only buffer to new device\n";
+        return move_device_allocation_already_locked(user_context, buf, buf_dev_interface, device_interface);
     }
 
     if (buf->dev && buf_dev_interface != device_interface) {
@@ -159,7 +263,19 @@ WEAK int halide_copy_to_device(void *user_context, struct buffer_t *buf, const h
         }
     }
 
-    if (buf->host_dirty) {
+    return 0;
+}
+
+WEAK int copy_to_device_already_locked(void *user_context, struct buffer_t *buf,
+                                       const halide_device_interface_t *device_interface) {
+    int result = prepare_copy_to_device_already_locked(user_context, buf, &device_interface);
+    if (result != 0) {
+        return result;
+    }
+
+    // A device allocation holding only part of the data is completed.
+    bool partial = forget_partial_device_copy(buf->dev);
+    if (buf->host_dirty || partial) {
         debug(user_context) << "halide_copy_to_device " << buf << " host is dirty\n";
         if (buf->dev_dirty) {
             debug(user_context) << "halide_copy_to_device " << buf << " dev_dirty is true error\n";
@@ -176,6 +292,266 @@ WEAK int halide_copy_to_device(void *user_context, struct buffer_t *buf, const h
         }
     }
 
+    return result;
+}
+
+// Whether dst's region can be copied from src by halide_buffer_copy.
+WEAK bool buffer_copy_compatible(const buffer_t *src, const buffer_t *dst) {
+    if (src->elem_size != dst->elem_size) {
+        return false;
+    }
+    for (int i = 0; i < 4; i++) {
+        if ((src->extent[i] == 0) != (dst->extent[i] == 0)) {
+            return false;
+        }
+        if (dst->extent[i] == 0) {
+            break;
+        }
+        if (src->stride[i] != dst->stride[i] ||
+            dst->min[i] < src->min[i] ||
+            dst->min[i] + dst->extent[i] > src->min[i] + src->extent[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+}}} // namespace Halide::Runtime::Internal
+
+extern "C" {
+
+/** Copy image data from host memory to device memory. This should not be
+ * called directly; Halide handles copying to the device automatically. */
+WEAK int halide_copy_to_device(void *user_context, struct buffer_t *buf, const halide_device_interface_t *device_interface) {
+    ScopedMutexLock lock(&device_copy_mutex);
+
+    return copy_to_device_already_locked(user_context, buf, device_interface);
+}
+
+WEAK int halide_buffer_copy(void *user_context, struct buffer_t *src,
+                            const halide_device_interface_t *dst_device_interface,
+                            struct buffer_t *dst) {
+    ScopedMutexLock lock(&device_copy_mutex);
+
+    debug(user_context) << "halide_buffer_copy " << src << " -> " << dst
+                        << ", interface: " << dst_device_interface << "\n";
+
+    if (src == dst) {
+        if (dst_device_interface) {
+            return copy_to_device_already_locked(user_context, dst, dst_device_interface);
+        } else {
+            return copy_to_host_already_locked(user_context, dst);
+        }
+    }
+
+    if (!buffer_copy_compatible(src, dst)) {
+        debug(user_context) << "halide_buffer_copy " << src << " -> " << dst << " incompatible buffers\n";
+        return halide_error_code_bad_buffer_copy;
+    }
+
+    int result = 0;
+    const halide_device_interface_t *src_interface = halide_get_device_interface(src->dev);
+    bool src_on_device = src->dev && !src->host_dirty;
+    if (src_on_device && src->host) {
+        ScopedSpinLock partial_lock(&partial_device_copies_lock);
+        src_on_device = find_partial_device_copy(src->dev) == NULL;
+    }
+
+    if (dst_device_interface) {
+        result = prepare_copy_to_device_already_locked(user_context, dst, &dst_device_interface);
+        if (result != 0) {
+            return result;
+        }
+        // All of dst's data is about to be replaced.
+        forget_partial_device_copy(dst->dev);
+
+        if (src_on_device && src_interface == dst_device_interface &&
+            dst_device_interface->buffer_copy) {
+            result = dst_device_interface->buffer_copy(user_context, src, dst);
+            if (result != 0) {
+                debug(user_context) << "halide_buffer_copy " << src << " -> " << dst
+                                    << " device buffer_copy returned an error\n";
+                return halide_error_code_copy_to_device_failed;
+            }
+            dst->host_dirty = false;
+            dst->dev_dirty = true;
+            return 0;
+        }
+    }
+
+    // Otherwise the copy goes through host memory: src's host
+    // allocation if it has one, or a temporary one if not.
+    uint8_t *from = src->host;
+    uint8_t *staging = NULL;
+    if (src->host) {
+        result = copy_to_host_already_locked(user_context, src);
+    } else if (src_on_device) {
+        staging = (uint8_t *)halide_malloc(user_context, buf_size(src));
+        if (staging == NULL) {
+            return halide_error_code_out_of_memory;
+        }
+        buffer_t view = *src;
+        view.host = staging;
+        from = staging;
+        if (src_interface->copy_to_host(user_context, &view) != 0) {
+            result = halide_error_code_copy_to_host_failed;
+        }
+    } else {
+        result = halide_error_code_copy_to_host_failed;
+    }
+
+    if (result == 0) {
+        device_copy c = make_buffer_to_buffer_copy(src, (uint64_t)from, dst, (uint64_t)dst->host);
+        if (dst_device_interface) {
+            // Copy straight from the source data to the device,
+            // through a view of it shaped like dst.
+            buffer_t view = *dst;
+            view.host = from + c.src_offset;
+            if (dst_device_interface->copy_to_device(user_context, &view) != 0) {
+                result = halide_error_code_copy_to_device_failed;
+            } else {
+                dst->host_dirty = false;
+                dst->dev_dirty = true;
+            }
+        } else if (dst->host == NULL) {
+            result = halide_error_code_bad_buffer_copy;
+        } else {
+            c.copy_memory(user_context);
+            dst->host_dirty = dst->dev != 0;
+            dst->dev_dirty = false;
+        }
+    }
+
+    if (staging) {
+        halide_free(user_context, staging);
+    }
+    return result;
+}
+
+WEAK int halide_copy_to_device_region(void *user_context, struct buffer_t *buf,
+                                      const halide_device_interface_t *device_interface,
+                                      int64_t min_index, int64_t max_index) {
+    ScopedMutexLock lock(&device_copy_mutex);
+
+    debug(user_context) << "halide_copy_to_device_region " << buf
+                        << ", elements: [" << min_index << ", " << max_index << "]\n";
+
+    int result = prepare_copy_to_device_already_locked(user_context, buf, &device_interface);
+    if (result != 0) {
+        return result;
+    }
+
+    uint64_t size = buf_size(buf);
+    uint64_t begin = min_index < 0 ? 0 : (uint64_t)min_index * buf->elem_size;
+    uint64_t end = max_index < min_index ? begin : (uint64_t)(max_index + 1) * buf->elem_size;
+    if (end > size) {
+        end = size;
+    }
+
+    bool whole;
+    {
+        ScopedSpinLock partial_lock(&partial_device_copies_lock);
+        partial_device_copy *partial = find_partial_device_copy(buf->dev);
+        if (partial && partial->host != buf->host) {
+            // The buffer has moved; nothing on the device is known to be current.
+            partial->dev = 0;
+            partial = NULL;
+            buf->host_dirty = true;
+        }
+        if (!buf->host_dirty &&
+            (!partial || (partial->begin <= begin && end <= partial->end))) {
+            return 0;
+        }
+        if (buf->dev_dirty) {
+            debug(user_context) << "halide_copy_to_device_region " << buf << " dev_dirty is true error\n";
+            return halide_error_code_copy_to_device_failed;
+        }
+
+        // Work out what is current on the device after the copy. If
+        // the new range touches the old one, they merge; otherwise
+        // only the new range is remembered.
+        if (partial && !buf->host_dirty && begin <= partial->end && partial->begin <= end) {
+            begin = min(begin, partial->begin);
+            end = max(end, partial->end);
+        }
+        if (!partial) {
+            partial = find_partial_device_copy(0);
+        }
+        whole = (!device_interface->copy_to_device_region || !partial ||
+                 (begin == 0 && end == size));
+        if (partial) {
+            partial->dev = whole ? 0 : buf->dev;
+            partial->host = buf->host;
+            partial->begin = begin;
+            partial->end = end;
+        }
+    }
+
+    if (whole) {
+        result = device_interface->copy_to_device(user_context, buf);
+    } else {
+        result = device_interface->copy_to_device_region(user_context, buf, begin, end);
+    }
+    if (result != 0) {
+        forget_partial_device_copy(buf->dev);
+        debug(user_context) << "halide_copy_to_device_region "
+                            << buf << " device copy_to_device returned an error\n";
+        return halide_error_code_copy_to_device_failed;
+    }
+    buf->host_dirty = false;
+    return 0;
+}
+
+WEAK int halide_merge_host_region(void *user_context, struct buffer_t *buf,
+                                  const halide_device_interface_t *device_interface,
+                                  int64_t min_index, int64_t max_index) {
+    ScopedMutexLock lock(&device_copy_mutex);
+
+    debug(user_context) << "halide_merge_host_region " << buf
+                        << ", elements: [" << min_index << ", " << max_index << "]\n";
+
+    if (buf->dev == 0 || halide_get_device_interface(buf->dev) != device_interface) {
+        debug(user_context) << "halide_merge_host_region " << buf << " not on the device error\n";
+        return halide_error_code_copy_to_device_failed;
+    }
+
+    uint64_t size = buf_size(buf);
+    uint64_t begin = min_index < 0 ? 0 : (uint64_t)min_index * buf->elem_size;
+    uint64_t end = max_index < min_index ? begin : (uint64_t)(max_index + 1) * buf->elem_size;
+    if (end > size) {
+        end = size;
+    }
+
+    // The device now holds everything, and nothing is known to be
+    // current on the host apart from the merged region.
+    forget_partial_device_copy(buf->dev);
+
+    int result = 0;
+    if (begin < end && device_interface->copy_to_device_region) {
+        result = device_interface->copy_to_device_region(user_context, buf, begin, end);
+    } else if (begin < end) {
+        // Lay the host's region over a copy of what is on the device,
+        // and copy the lot back.
+        uint8_t *staging = (uint8_t *)halide_malloc(user_context, size);
+        if (staging == NULL) {
+            return halide_error_code_out_of_memory;
+        }
+        buffer_t view = *buf;
+        view.host = staging;
+        result = device_interface->copy_to_host(user_context, &view);
+        if (result == 0) {
+            memcpy(staging + begin, buf->host + begin, end - begin);
+            result = device_interface->copy_to_device(user_context, &view);
+        }
+        halide_free(user_context, staging);
+    }
+    if (result != 0) {
+        debug(user_context) << "halide_merge_host_region "
+                            << buf << " device copy returned an error\n";
+        return halide_error_code_copy_to_device_failed;
+    }
+    buf->host_dirty = false;
+    buf->dev_dirty = true;
     return 0;
 }
 
@@ -330,6 +706,14 @@ WEAK int halide_device_and_host_free(void *user_context, struct buffer_t *buf) {
     return 0;
 }
 
+WEAK void halide_set_pinned_host_allocations(bool use_pinned) {
+    use_pinned_host_allocations = use_pinned;
+}
+
+WEAK void halide_set_zero_copy_host_allocations(bool use_zero_copy) {
+    use_zero_copy_host_allocations = use_zero_copy;
+}
+
 WEAK int halide_default_device_and_host_malloc(void *user_context, struct buffer_t *buf, const halide_device_interface_t *device_interface) {
     size_t size = buf_size(buf);
     buf->host = (uint8_t *)halide_malloc(user_context, size);
@@ -19,6 +19,16 @@ struct halide_device_interface_t {
     int (*copy_to_device)(void *user_context, struct buffer_t *buf);
     int (*device_and_host_malloc)(void *user_context, struct buffer_t *buf);
     int (*device_and_host_free)(void *user_context, struct buffer_t *buf);
+    // Copy only the bytes [begin, end) of the buffer, measured from its
+    // host pointer, to the device, or a superset of them. Runtimes that
+    // leave this NULL always copy the whole buffer.
+    int (*copy_to_device_region)(void *user_context, struct buffer_t *buf, uint64_t begin, uint64_t end);
+    // Copy the region of dst from the device allocation of src to
+    // the device allocation of dst, both belonging to this interface,
+    // without going through the host. The buffers have the same
+    // strides and element size. Runtimes that leave this NULL copy
+    // between device allocations through host memory.
+    int (*buffer_copy)(void *user_context, struct buffer_t *src, struct buffer_t *dst);
 };
 
 extern WEAK uint64_t halide_new_device_wrapper(uint64_t handle, const struct halide_device_interface_t *device_interface);
@@ -33,4 +43,17 @@ extern WEAK int halide_default_device_and_host_free(void *user_context, struct b
 
 }
 
+namespace Halide { namespace Runtime { namespace Internal {
+
+// Whether device_and_host_malloc should allocate page-locked host
+// memory. See halide_set_pinned_host_allocations.
+extern WEAK bool use_pinned_host_allocations;
+
+// Whether GPUs that share memory with the host should use the host
+// allocation as the device allocation. See
+// halide_set_zero_copy_host_allocations.
+extern WEAK bool use_zero_copy_host_allocations;
+
+}}} // namespace Halide::Runtime::Internal
+
 #endif // HALIDE_DEVICE_INTERFACE_H
@@ -0,0 +1,183 @@
+#ifndef HALIDE_RUNTIME_DEVICE_MEMORY_POOL_H
+#define HALIDE_RUNTIME_DEVICE_MEMORY_POOL_H
+
+#include "HalideRuntime.h"
+#include "printer.h"
+
+namespace Halide { namespace Runtime { namespace Internal {
+
+// A cache of freed device allocations, shared in shape by the GPU
+// runtimes. Driver allocation and free calls are slow, and on some
+// drivers free implicitly synchronizes the device, so instead of
+// releasing memory in device_free we keep it here, bucketed by size,
+// and hand it back out to the next device_malloc that fits.
+//
+// The pool does no locking of its own: each runtime owns one pool and
+// only touches it while holding its context lock (in the CUDA
+// runtime, its state_lock).
+
+// Size classes are four steps per power of two, from 4KB up to 4GB,
+// so a reused allocation is at most 25% larger than requested.
+const size_t kDevicePoolMinSize = 4096;
+const int kDevicePoolMinLog2 = 12;
+const int kDevicePoolMaxLog2 = 32;
+const int kDevicePoolNumClasses = (kDevicePoolMaxLog2 - kDevicePoolMinLog2) * 4;
+
+// Never cache more than this in total; the least valuable (largest)
+// blocks are released first when it's exceeded.
+const size_t kDevicePoolMaxCachedBytes = (size_t)256 * 1024 * 1024;
+
+struct device_pool_block {
+    uint64_t handle;
+    size_t size;
+    // The context the allocation belongs to, and the queue or stream
+    // the buffer was last used on when it was freed.
+    void *context;
+    void *queue;
+    device_pool_block *next;
+};
+
+struct device_memory_pool {
+    device_pool_block *blocks[kDevicePoolNumClasses];
+    size_t cached_bytes;
+};
+
+// Called to really free an allocation the pool drops.
+typedef void (*device_pool_release_fn)(void *user_context, uint64_t handle);
+
+WEAK int device_pool_log2(size_t size) {
+    int l = 0;
+    while (size >>= 1) {
+        l++;
+    }
+    return l;
+}
+
+WEAK size_t device_pool_class_size(int c) {
+    int l = c / 4 + kDevicePoolMinLog2;
+    size_t base = (size_t)1 << l;
+    return base + (c % 4) * (base >> 2);
+}
+
+// The smallest class that can satisfy an allocation of this size, or
+// -1 if it's too large to pool.
+WEAK int device_pool_class_for_request(size_t size) {
+    if (size <= kDevicePoolMinSize) {
+        return 0;
+    }
+    int l = device_pool_log2(size);
+    if (l >= kDevicePoolMaxLog2) {
+        return -1;
+    }
+    size_t base = (size_t)1 << l;
+    size_t step = base >> 2;
+    int q = (int)((size - base + step - 1) / step);
+    int c = (l - kDevicePoolMinLog2) * 4 + q;
+    return c < kDevicePoolNumClasses ? c : -1;
+}
+
+// The largest class whose requests a block of this size satisfies, or
+// -1 if the block can't be pooled.
+WEAK int device_pool_class_for_block(size_t size) {
+    if (size < kDevicePoolMinSize) {
+        return -1;
+    }
+    int l = device_pool_log2(size);
+    if (l >= kDevicePoolMaxLog2) {
+        return -1;
+    }
+    size_t base = (size_t)1 << l;
+    int q = (int)((size - base) / (base >> 2));
+    return (l - kDevicePoolMinLog2) * 4 + q;
+}
+
+// The size device_malloc should actually ask the driver for, so that
+// the allocation can satisfy any later request in the same class.
+WEAK size_t device_pool_round_up(size_t size) {
+    int c = device_pool_class_for_request(size);
+    return c < 0 ? size : device_pool_class_size(c);
+}
+
+// Take a cached block that fits an allocation of the given size on
+// the given context. Blocks last used on the same queue are
+// preferred; the caller must synchronize with block->queue before
+// using a block from a different one. Returns NULL on a miss. The
+// caller frees the returned node.
+WEAK device_pool_block *device_pool_take(device_memory_pool *pool, size_t size,
+                                         void *context, void *queue) {
+    int c = device_pool_class_for_request(size);
+    if (c < 0) {
+        return NULL;
+    }
+    device_pool_block **fallback = NULL;
+    for (device_pool_block **b = &pool->blocks[c]; *b; b = &(*b)->next) {
+        if ((*b)->context != context) {
+            continue;
+        }
+        if ((*b)->queue == queue) {
+            fallback = b;
+            break;
+        }
+        if (!fallback) {
+            fallback = b;
+        }
+    }
+    if (!fallback) {
+        return NULL;
+    }
+    device_pool_block *result = *fallback;
+    *fallback = result->next;
+    pool->cached_bytes -= result->size;
+    return result;
+}
+
+// Release cached blocks, largest first, until no more than target
+// bytes remain. If context is non-NULL, only its blocks are released.
+WEAK void device_pool_trim(void *user_context, device_memory_pool *pool, size_t target,
+                           void *context, device_pool_release_fn release) {
+    for (int c = kDevicePoolNumClasses - 1; c >= 0 && pool->cached_bytes > target; c--) {
+        device_pool_block **b = &pool->blocks[c];
+        while (*b && pool->cached_bytes > target) {
+            device_pool_block *block = *b;
+            if (context && block->context != context) {
+                b = &block->next;
+                continue;
+            }
+            *b = block->next;
+            pool->cached_bytes -= block->size;
+            debug(user_context) << "    device pool releasing " << (void *)block->handle
+                                << " (" << (uint64_t)block->size << " bytes)\n";
+            release(user_context, block->handle);
+            free(block);
+        }
+    }
+}
+
+// Offer a freed allocation of the given real size to the pool. Returns
+// false if the caller should release it itself.
+WEAK bool device_pool_put(void *user_context, device_memory_pool *pool, uint64_t handle, size_t size,
+                          void *context, void *queue, device_pool_release_fn release) {
+    int c = device_pool_class_for_block(size);
+    if (c < 0 || size > kDevicePoolMaxCachedBytes) {
+        return false;
+    }
+    if (pool->cached_bytes + size > kDevicePoolMaxCachedBytes) {
+        device_pool_trim(user_context, pool, kDevicePoolMaxCachedBytes - size, NULL, release);
+    }
+    device_pool_block *block = (device_pool_block *)malloc(sizeof(device_pool_block));
+    if (!block) {
+        return false;
+    }
+    block->handle = handle;
+    block->size = size;
+    block->context = context;
+    block->queue = queue;
+    block->next = pool->blocks[c];
+    pool->blocks[c] = block;
+    pool->cached_bytes += size;
+    return true;
+}
+
+}}} // namespace Halide::Runtime::Internal
+
+#endif // HALIDE_RUNTIME_DEVICE_MEMORY_POOL_H
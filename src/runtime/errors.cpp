@@ -69,6 +69,14 @@ WEAK int halide_error_buffer_extents_negative(void *user_context, const char *bu
     return halide_error_code_buffer_extents_negative;
 }
 
+WEAK int halide_error_too_many_dimensions(void *user_context, const char *buffer_name, int dimensions) {
+    error(user_context)
+        << "Buffer " << buffer_name
+        << " has " << dimensions
+        << " dimensions, but a buffer_t can only have four";
+    return halide_error_code_too_many_dimensions;
+}
+
 WEAK int halide_error_buffer_extents_too_large(void *user_context, const char *buffer_name, int64_t actual_size, int64_t max_size) {
     error(user_context)
         << "Product of extents for buffer " << buffer_name
@@ -1,4 +1,5 @@
 #include "HalideRuntime.h"
+#include "adaptive_par_for.h"
 
 extern "C" {
 WEAK int halide_do_task(void *user_context, halide_task_t f, int idx,
@@ -15,7 +16,10 @@ WEAK int default_do_task(void *user_context, halide_task_t f, int idx,
 WEAK int default_do_par_for(void *user_context, halide_task_t f,
                            int min, int size, uint8_t *closure) {
     for (int x = min; x < min + size; x++) {
-        int result = halide_do_task(user_context, f, x, closure);
+        int result = halide_cancellation_check(user_context);
+        if (result == 0) {
+            result = halide_do_task(user_context, f, x, closure);
+        }
         if (result) {
             return result;
         }
@@ -55,6 +59,58 @@ WEAK int halide_set_num_threads(int n) {
     return 1;
 }
 
+WEAK int halide_do_async(int (*argv_func)(void **), void **args,
+                         halide_async_callback_t callback, void *callback_context) {
+    // There are no other threads to run it on.
+    callback(callback_context, argv_func(args));
+    return 0;
+}
+
+WEAK int halide_semaphore_init(halide_semaphore_t *s, int count) {
+    *(int *)s = count;
+    return 0;
+}
+
+WEAK int halide_semaphore_release(halide_semaphore_t *s, int count) {
+    *(int *)s += count;
+    return 0;
+}
+
+WEAK int halide_semaphore_acquire(halide_semaphore_t *s, int count) {
+    // There's nobody else to release it.
+    if (*(int *)s < count) {
+        return halide_error_code_generic_error;
+    }
+    *(int *)s -= count;
+    return 0;
+}
+
+WEAK void halide_semaphore_abandon(void *user_context, void *s) {
+}
+
+WEAK int halide_do_concurrent_tasks(void *user_context, halide_task_t f,
+                                    int min, int size, uint8_t *closure) {
+    // Concurrent tasks can wait on each other, so they can't be run
+    // one after the other.
+    halide_error(user_context, "halide_do_concurrent_tasks not implemented on this platform.");
+    return halide_error_code_generic_error;
+}
+
+WEAK int halide_set_thread_pool_priority(void *user_context, int priority, int max_threads) {
+    return 0;
+}
+
+WEAK int halide_set_thread_pool_spin_count(int n) {
+    return 0;
+}
+
+WEAK void halide_get_thread_pool_stats(halide_thread_pool_stats_t *stats) {
+    memset(stats, 0, sizeof(*stats));
+}
+
+WEAK void halide_reset_thread_pool_stats() {
+}
+
 WEAK halide_do_task_t halide_set_custom_do_task(halide_do_task_t f) {
     halide_do_task_t result = custom_do_task;
     custom_do_task = f;
@@ -77,4 +133,11 @@ WEAK int halide_do_par_for(void *user_context, halide_task_t f,
   return (*custom_do_par_for)(user_context, f, min, size, closure);
 }
 
+WEAK int halide_do_par_for_adaptive(void *user_context, halide_loop_task_t f,
+                                    int min, int size, uint8_t *closure) {
+    // There's only one worker, so this runs the whole loop as one
+    // chunk.
+    return do_par_for_adaptive(user_context, f, min, size, closure, 1);
+}
+
 }  // extern "C"
@@ -1,4 +1,5 @@
 #include "HalideRuntime.h"
+#include "adaptive_par_for.h"
 
 extern "C" {
 
@@ -15,6 +16,26 @@ extern void dispatch_apply_f(size_t iterations, dispatch_queue_t queue,
                              void *context, void (*work)(void *, size_t));
 extern void dispatch_async_f(dispatch_queue_t queue, void *context, void (*work)(void *));
 
+// Quality of service classes, from <sys/qos.h>. The global queues can
+// be looked up by QoS class as well as by priority.
+typedef unsigned int qos_class_t;
+#define QOS_CLASS_USER_INTERACTIVE 0x21
+#define QOS_CLASS_USER_INITIATED 0x19
+#define QOS_CLASS_DEFAULT 0x15
+#define QOS_CLASS_UTILITY 0x11
+#define QOS_CLASS_BACKGROUND 0x09
+#define QOS_CLASS_UNSPECIFIED 0x00
+
+extern qos_class_t qos_class_self();
+
+typedef struct dispatch_queue_attr_s *dispatch_queue_attr_t;
+extern struct dispatch_queue_attr_s _dispatch_queue_attr_concurrent;
+#define DISPATCH_QUEUE_CONCURRENT (&_dispatch_queue_attr_concurrent)
+
+extern dispatch_queue_attr_t dispatch_queue_attr_make_with_qos_class(
+    dispatch_queue_attr_t attr, qos_class_t qos_class, int relative_priority);
+extern dispatch_queue_t dispatch_queue_create(const char *label, dispatch_queue_attr_t attr);
+
 typedef struct dispatch_semaphore_s *dispatch_semaphore_t;
 typedef uint64_t dispatch_time_t;
 #define DISPATCH_TIME_FOREVER (~0ull)
@@ -24,6 +45,8 @@ extern long dispatch_semaphore_wait(dispatch_semaphore_t dsema, dispatch_time_t
 extern long dispatch_semaphore_signal(dispatch_semaphore_t dsema);
 extern void dispatch_release(void *object);
 
+extern int sched_yield();
+
 
 WEAK int halide_do_task(void *user_context, halide_task_t f, int idx,
                         uint8_t *closure);
@@ -41,6 +64,16 @@ WEAK void spawn_thread_helper(void *arg) {
     t->f(t->closure);
     dispatch_semaphore_signal(t->join_semaphore);
 }
+
+// The QoS class of the calling thread. Work queued on its behalf runs
+// at the same class, rather than at the default one of the queue, so
+// that a pipeline called from the main thread isn't starved by
+// background work, and one called from a background thread doesn't
+// compete with the UI.
+WEAK qos_class_t caller_qos_class() {
+    qos_class_t qos = qos_class_self();
+    return qos == QOS_CLASS_UNSPECIFIED ? QOS_CLASS_DEFAULT : qos;
+}
 }}} // namespace Halide::Runtime::Internal
 
 
@@ -49,10 +82,14 @@ WEAK halide_thread *halide_spawn_thread(void (*f)(void *), void *closure) {
     thread->f = f;
     thread->closure = closure;
     thread->join_semaphore = dispatch_semaphore_create(0);
-    dispatch_async_f(dispatch_get_global_queue(0, 0), thread, spawn_thread_helper);
+    dispatch_async_f(dispatch_get_global_queue(caller_qos_class(), 0), thread, spawn_thread_helper);
     return (halide_thread *)thread;
 }
 
+WEAK void halide_thread_yield() {
+    sched_yield();
+}
+
 WEAK void halide_join_thread(halide_thread *thread_arg) {
     spawned_thread *thread = (spawned_thread *)thread_arg;
     dispatch_semaphore_wait(thread->join_semaphore, DISPATCH_TIME_FOREVER);
@@ -87,24 +124,141 @@ struct halide_gcd_job {
     void *user_context;
     uint8_t *closure;
     int min;
-    int exit_status;
+    int size;
+    volatile int next;
+    volatile int exit_status;
 };
 
 // Take a call from grand-central-dispatch's parallel for loop, and
-// make a call to Halide's do task
+// make a call to Halide's do task. GCD can't be told to stop early, so
+// once a task has failed or the job has been cancelled, the remaining
+// tasks do nothing.
 WEAK void halide_do_gcd_task(void *job, size_t idx) {
     halide_gcd_job *j = (halide_gcd_job *)job;
-    j->exit_status = halide_do_task(j->user_context, j->f, j->min + (int)idx,
-                                    j->closure);
+    if (j->exit_status) {
+        return;
+    }
+    int result = halide_cancellation_check(j->user_context);
+    if (result == 0) {
+        result = halide_do_task(j->user_context, j->f, j->min + (int)idx,
+                                j->closure);
+    }
+    if (result) {
+        j->exit_status = result;
+    }
+}
+
+// Run tasks of a job until there are none left. Used when the number
+// of threads working on a parallel loop is limited: GCD runs one of
+// these per thread, rather than one call per task.
+WEAK void halide_do_gcd_worker(void *job, size_t) {
+    halide_gcd_job *j = (halide_gcd_job *)job;
+    while (true) {
+        int idx = __sync_fetch_and_add(&j->next, 1);
+        if (idx >= j->size) {
+            return;
+        }
+        halide_do_gcd_task(job, idx);
+    }
+}
+
+// The settings of halide_set_thread_pool_priority.
+#define MAX_PRIORITY_ENTRIES 16
+struct gcd_priority_entry {
+    void *user_context;
+    int priority;
+    int max_threads;
+};
+
+WEAK halide_mutex gcd_priorities_mutex;
+WEAK gcd_priority_entry gcd_priorities[MAX_PRIORITY_ENTRIES];
+WEAK int gcd_num_priorities = 0;
+
+// The QoS class of a priority set with halide_set_thread_pool_priority,
+// where zero means that of the calling thread.
+WEAK qos_class_t qos_class_of_priority(int priority) {
+    if (priority >= 2) {
+        return QOS_CLASS_USER_INTERACTIVE;
+    } else if (priority == 1) {
+        return QOS_CLASS_USER_INITIATED;
+    } else if (priority == -1) {
+        return QOS_CLASS_UTILITY;
+    } else if (priority <= -2) {
+        return QOS_CLASS_BACKGROUND;
+    }
+    return caller_qos_class();
+}
+
+// The QoS class to run the parallel loops of a pipeline called with the
+// given user_context at, and the most threads (zero means no limit)
+// that may work on each of them.
+WEAK void get_gcd_settings(void *user_context, qos_class_t *qos, int *max_threads) {
+    int priority = 0;
+    *max_threads = custom_num_threads;
+    if (gcd_num_priorities > 0) {
+        halide_mutex_lock(&gcd_priorities_mutex);
+        for (int i = 0; i < gcd_num_priorities; i++) {
+            if (gcd_priorities[i].user_context == user_context) {
+                priority = gcd_priorities[i].priority;
+                int m = gcd_priorities[i].max_threads;
+                if (m > 0 && (*max_threads == 0 || m < *max_threads)) {
+                    *max_threads = m;
+                }
+            }
+        }
+        halide_mutex_unlock(&gcd_priorities_mutex);
+    }
+    *qos = qos_class_of_priority(priority);
+}
+
+// A concurrent queue of our own for each QoS class, created the first
+// time it is used. The parallel loops with a limited number of threads
+// are dispatched to these rather than to the global queues, so they
+// are labelled as Halide's in Instruments and spindumps.
+struct gcd_dedicated_queue {
+    dispatch_once_t once;
+    qos_class_t qos;
+    dispatch_queue_t queue;
+};
+
+WEAK gcd_dedicated_queue gcd_dedicated_queues[] = {
+    {0, QOS_CLASS_USER_INTERACTIVE, NULL},
+    {0, QOS_CLASS_USER_INITIATED, NULL},
+    {0, QOS_CLASS_DEFAULT, NULL},
+    {0, QOS_CLASS_UTILITY, NULL},
+    {0, QOS_CLASS_BACKGROUND, NULL},
+};
+
+WEAK void init_dedicated_queue(void *arg) {
+    gcd_dedicated_queue *q = (gcd_dedicated_queue *)arg;
+    q->queue = dispatch_queue_create("org.halide-lang.thread_pool",
+                                     dispatch_queue_attr_make_with_qos_class(DISPATCH_QUEUE_CONCURRENT, q->qos, 0));
+}
+
+WEAK dispatch_queue_t get_dedicated_queue(qos_class_t qos) {
+    gcd_dedicated_queue *q = &gcd_dedicated_queues[2];
+    for (int i = 0; i < (int)(sizeof(gcd_dedicated_queues) / sizeof(gcd_dedicated_queues[0])); i++) {
+        if (gcd_dedicated_queues[i].qos == qos) {
+            q = &gcd_dedicated_queues[i];
+        }
+    }
+    dispatch_once_f(&q->once, q, init_dedicated_queue);
+    return q->queue;
 }
 
 WEAK int default_do_par_for(void *user_context, halide_task_t f,
                             int min, int size, uint8_t *closure) {
-    if (custom_num_threads == 1 || size == 1) {
-        // GCD doesn't really allow us to limit the threads,
-        // so ensure that there's no parallelism by executing serially.
+    qos_class_t qos;
+    int max_threads;
+    get_gcd_settings(user_context, &qos, &max_threads);
+
+    if (max_threads == 1 || size == 1) {
+        // Ensure that there's no parallelism by executing serially.
         for (int x = min; x < min + size; x++) {
-            int result = halide_do_task(user_context, f, x, closure);
+            int result = halide_cancellation_check(user_context);
+            if (result == 0) {
+                result = halide_do_task(user_context, f, x, closure);
+            }
             if (result) {
                 return result;
             }
@@ -117,15 +271,38 @@ WEAK int default_do_par_for(void *user_context, halide_task_t f,
     job.user_context = user_context;
     job.closure = closure;
     job.min = min;
+    job.size = size;
+    job.next = 0;
     job.exit_status = 0;
 
-    dispatch_apply_f(size, dispatch_get_global_queue(0, 0), &job, &halide_do_gcd_task);
+    if (max_threads > 1 && max_threads < size) {
+        // GCD can't be told how many threads to use, so limit them by
+        // giving it only max_threads things to do, each of which takes
+        // tasks until there are none left.
+        dispatch_apply_f(max_threads, get_dedicated_queue(qos), &job, &halide_do_gcd_worker);
+    } else {
+        dispatch_apply_f(size, dispatch_get_global_queue(qos, 0), &job, &halide_do_gcd_task);
+    }
     return job.exit_status;
 }
 
 WEAK halide_do_task_t custom_do_task = default_do_task;
 WEAK halide_do_par_for_t custom_do_par_for = default_do_par_for;
 
+struct halide_gcd_async_call {
+    int (*argv_func)(void **);
+    void **args;
+    halide_async_callback_t callback;
+    void *callback_context;
+};
+
+WEAK void halide_do_gcd_async_call(void *arg) {
+    halide_gcd_async_call *call = (halide_gcd_async_call *)arg;
+    int result = call->argv_func(call->args);
+    call->callback(call->callback_context, result);
+    free(call);
+}
+
 }}} // namespace Halide::Runtime::Internal
 
 extern "C" {
@@ -161,6 +338,63 @@ WEAK int halide_set_num_threads(int n) {
     return old_custom_num_threads;
 }
 
+WEAK int halide_do_async(int (*argv_func)(void **), void **args,
+                         halide_async_callback_t callback, void *callback_context) {
+    halide_gcd_async_call *call = (halide_gcd_async_call *)malloc(sizeof(halide_gcd_async_call));
+    if (!call) {
+        return halide_error_code_out_of_memory;
+    }
+    call->argv_func = argv_func;
+    call->args = args;
+    call->callback = callback;
+    call->callback_context = callback_context;
+    dispatch_async_f(dispatch_get_global_queue(caller_qos_class(), 0), call, halide_do_gcd_async_call);
+    return 0;
+}
+
+WEAK int halide_set_thread_pool_priority(void *user_context, int priority, int max_threads) {
+    if (max_threads < 0) {
+        halide_error(user_context, "halide_set_thread_pool_priority: max_threads must be >= 0.");
+        return halide_error_code_generic_error;
+    }
+    halide_mutex_lock(&gcd_priorities_mutex);
+    int i = 0;
+    while (i < gcd_num_priorities &&
+           gcd_priorities[i].user_context != user_context) {
+        i++;
+    }
+    int result = 0;
+    if (priority == 0 && max_threads == 0) {
+        // Back to the defaults. Remove the entry if there is one.
+        if (i < gcd_num_priorities) {
+            gcd_priorities[i] = gcd_priorities[--gcd_num_priorities];
+        }
+    } else if (i == MAX_PRIORITY_ENTRIES) {
+        halide_error(user_context, "halide_set_thread_pool_priority: too many distinct user_contexts.");
+        result = halide_error_code_generic_error;
+    } else {
+        gcd_priorities[i].user_context = user_context;
+        gcd_priorities[i].priority = priority;
+        gcd_priorities[i].max_threads = max_threads;
+        if (i == gcd_num_priorities) {
+            gcd_num_priorities++;
+        }
+    }
+    halide_mutex_unlock(&gcd_priorities_mutex);
+    return result;
+}
+
+WEAK int halide_set_thread_pool_spin_count(int n) {
+    return 0;
+}
+
+WEAK void halide_get_thread_pool_stats(halide_thread_pool_stats_t *stats) {
+    memset(stats, 0, sizeof(*stats));
+}
+
+WEAK void halide_reset_thread_pool_stats() {
+}
+
 WEAK halide_do_task_t halide_set_custom_do_task(halide_do_task_t f) {
     halide_do_task_t result = custom_do_task;
     custom_do_task = f;
@@ -183,4 +417,12 @@ WEAK int halide_do_par_for(void *user_context, halide_task_t f,
   return (*custom_do_par_for)(user_context, f, min, size, closure);
 }
 
+WEAK int halide_do_par_for_adaptive(void *user_context, halide_loop_task_t f,
+                                    int min, int size, uint8_t *closure) {
+    int num_workers = custom_num_threads > 0 ? custom_num_threads : halide_host_cpu_count();
+    return do_par_for_adaptive(user_context, f, min, size, closure, num_workers);
+}
+
 }
+
+#include "concurrent_tasks_common.h"
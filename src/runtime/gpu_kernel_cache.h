@@ -0,0 +1,175 @@
+#ifndef HALIDE_RUNTIME_GPU_KERNEL_CACHE_H
+#define HALIDE_RUNTIME_GPU_KERNEL_CACHE_H
+
+#include "HalideRuntime.h"
+#include "printer.h"
+#include "scoped_spin_lock.h"
+
+extern "C" {
+
+extern void *fopen(const char *, const char *);
+extern int fclose(void *);
+extern size_t fread(void *, size_t, size_t, void *);
+extern size_t fwrite(const void *, size_t, size_t, void *);
+extern int rename(const char *, const char *);
+
+}
+
+namespace Halide { namespace Runtime { namespace Internal {
+
+// An on-disk cache of driver-compiled GPU kernels (cubins, OpenCL
+// program binaries), so that a process doesn't pay for compiling the
+// embedded PTX or OpenCL C again on every start. Entries are keyed by
+// a hash of the kernel source together with whatever identifies the
+// device, driver and build options; a stale entry just fails to load
+// and is replaced.
+//
+// Each entry is a file in the cache directory holding a small header
+// and the binary. Files are written to a temporary name and renamed
+// into place, so concurrent processes never see a partial entry.
+
+WEAK char kernel_cache_dir[1024];
+WEAK int kernel_cache_dir_lock = 0;
+WEAK bool kernel_cache_dir_initialized = false;
+
+const uint32_t kKernelCacheMagic = 0x434b4c48;  // "HLKC"
+const uint32_t kKernelCacheVersion = 1;
+
+struct kernel_cache_header {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t key;
+    uint64_t size;
+};
+
+// FNV-1a, chained through h.
+WEAK uint64_t kernel_cache_hash(uint64_t h, const void *data, size_t size) {
+    const uint8_t *p = (const uint8_t *)data;
+    for (size_t i = 0; i < size; i++) {
+        h = (h ^ p[i]) * 1099511628211ULL;
+    }
+    return h;
+}
+
+WEAK uint64_t kernel_cache_hash_string(uint64_t h, const char *s) {
+    // Include the terminator so that adjacent strings can't run together.
+    return kernel_cache_hash(h, s, strlen(s) + 1);
+}
+
+const uint64_t kKernelCacheHashSeed = 14695981039346656037ULL;
+
+// The cache directory, or NULL if caching is off.
+WEAK const char *get_kernel_cache_dir() {
+    ScopedSpinLock lock(&kernel_cache_dir_lock);
+    if (!kernel_cache_dir_initialized) {
+        const char *dir = getenv("HL_GPU_KERNEL_CACHE_DIR");
+        if (dir) {
+            strncpy(kernel_cache_dir, dir, sizeof(kernel_cache_dir) - 1);
+        }
+        kernel_cache_dir_initialized = true;
+    }
+    return kernel_cache_dir[0] ? kernel_cache_dir : NULL;
+}
+
+WEAK void kernel_cache_path(char *dst, char *end, const char *dir, const char *kind, uint64_t key) {
+    dst = halide_string_to_string(dst, end, dir);
+    dst = halide_string_to_string(dst, end, "/halide_");
+    dst = halide_string_to_string(dst, end, kind);
+    dst = halide_string_to_string(dst, end, "_");
+    dst = halide_uint64_to_string(dst, end, key, 1);
+    halide_string_to_string(dst, end, ".bin");
+}
+
+// Load a cached binary. Returns a buffer allocated with malloc that
+// the caller frees, or NULL on a miss.
+WEAK void *kernel_cache_load(void *user_context, const char *kind, uint64_t key, size_t *size) {
+    const char *dir = get_kernel_cache_dir();
+    if (!dir) {
+        return NULL;
+    }
+    char path[1024 + 64];
+    kernel_cache_path(path, path + sizeof(path), dir, kind, key);
+
+    void *f = fopen(path, "rb");
+    if (!f) {
+        debug(user_context) << "    kernel cache miss: " << path << "\n";
+        return NULL;
+    }
+    kernel_cache_header header;
+    void *data = NULL;
+    if (fread(&header, sizeof(header), 1, f) == 1 &&
+        header.magic == kKernelCacheMagic &&
+        header.version == kKernelCacheVersion &&
+        header.key == key &&
+        header.size > 0) {
+        data = malloc(header.size);
+        if (data && fread(data, header.size, 1, f) != 1) {
+            free(data);
+            data = NULL;
+        }
+    }
+    fclose(f);
+    if (data) {
+        debug(user_context) << "    kernel cache hit: " << path << " (" << header.size << " bytes)\n";
+        *size = header.size;
+    } else {
+        debug(user_context) << "    kernel cache entry unreadable: " << path << "\n";
+    }
+    return data;
+}
+
+// Store a binary in the cache. Failures are silently ignored: the
+// cache is only an optimization.
+WEAK void kernel_cache_store(void *user_context, const char *kind, uint64_t key, const void *data, size_t size) {
+    const char *dir = get_kernel_cache_dir();
+    if (!dir || !data || !size) {
+        return;
+    }
+    char path[1024 + 64];
+    kernel_cache_path(path, path + sizeof(path), dir, kind, key);
+
+    // Make the temporary name unique to this process and thread by
+    // using the address of something on our stack.
+    char tmp_path[1024 + 96];
+    char *dst = halide_string_to_string(tmp_path, tmp_path + sizeof(tmp_path), path);
+    dst = halide_string_to_string(dst, tmp_path + sizeof(tmp_path), ".");
+    halide_uint64_to_string(dst, tmp_path + sizeof(tmp_path), (uint64_t)(uintptr_t)&dst, 1);
+
+    void *f = fopen(tmp_path, "wb");
+    if (!f) {
+        debug(user_context) << "    kernel cache can't create " << tmp_path << "\n";
+        return;
+    }
+    kernel_cache_header header;
+    header.magic = kKernelCacheMagic;
+    header.version = kKernelCacheVersion;
+    header.key = key;
+    header.size = size;
+    bool ok = (fwrite(&header, sizeof(header), 1, f) == 1 &&
+               fwrite(data, size, 1, f) == 1);
+    ok = (fclose(f) == 0) && ok;
+    if (!ok || rename(tmp_path, path) != 0) {
+        remove(tmp_path);
+        return;
+    }
+    debug(user_context) << "    kernel cache stored: " << path << " (" << (uint64_t)size << " bytes)\n";
+}
+
+}}} // namespace Halide::Runtime::Internal
+
+extern "C" {
+
+WEAK void halide_set_gpu_kernel_cache_dir(const char *path) {
+    using namespace Halide::Runtime::Internal;
+    ScopedSpinLock lock(&kernel_cache_dir_lock);
+    if (path) {
+        strncpy(kernel_cache_dir, path, sizeof(kernel_cache_dir) - 1);
+    } else {
+        kernel_cache_dir[0] = 0;
+    }
+    kernel_cache_dir_initialized = true;
+}
+
+}
+
+#endif // HALIDE_RUNTIME_GPU_KERNEL_CACHE_H
@@ -32,13 +32,16 @@ typedef int (*remote_run_fn)(halide_hexagon_handle_t, int,
 typedef int (*remote_release_kernels_fn)(halide_hexagon_handle_t, int);
 typedef int (*remote_poll_log_fn)(char *, int, int *);
 typedef void (*remote_poll_profiler_state_fn)(int *, int *);
+typedef int (*remote_poll_profiler_counters_fn)(unsigned char *, int, int *);
 typedef int (*remote_power_fn)();
 typedef int (*remote_power_mode_fn)(int);
 typedef int (*remote_power_perf_fn)(int, unsigned int, unsigned int, int, unsigned int, unsigned int, int, int);
+typedef int (*remote_set_arena_size_fn)(unsigned int);
 
 typedef void (*host_malloc_init_fn)();
 typedef void *(*host_malloc_fn)(size_t);
 typedef void (*host_free_fn)(void *);
+typedef void (*host_register_buf_fn)(void *, int, int);
 
 WEAK remote_initialize_kernels_fn remote_initialize_kernels = NULL;
 WEAK remote_get_symbol_fn remote_get_symbol = NULL;
@@ -46,15 +49,18 @@ WEAK remote_run_fn remote_run = NULL;
 WEAK remote_release_kernels_fn remote_release_kernels = NULL;
 WEAK remote_poll_log_fn remote_poll_log = NULL;
 WEAK remote_poll_profiler_state_fn remote_poll_profiler_state = NULL;
+WEAK remote_poll_profiler_counters_fn remote_poll_profiler_counters = NULL;
 WEAK remote_power_fn remote_power_hvx_on = NULL;
 WEAK remote_power_mode_fn remote_power_hvx_on_mode = NULL;
 WEAK remote_power_perf_fn remote_power_hvx_on_perf = NULL;
 WEAK remote_power_fn remote_power_hvx_off = NULL;
+WEAK remote_set_arena_size_fn remote_set_arena_size = NULL;
 
 WEAK host_malloc_init_fn host_malloc_init = NULL;
 WEAK host_malloc_init_fn host_malloc_deinit = NULL;
 WEAK host_malloc_fn host_malloc = NULL;
 WEAK host_free_fn host_free = NULL;
+WEAK host_register_buf_fn host_register_buf = NULL;
 
 // This checks if there are any log messages available on the remote
 // side. It should be called after every remote call.
@@ -89,6 +95,44 @@ WEAK void get_remote_profiler_state(int *func, int *threads) {
     remote_poll_profiler_state(func, threads);
 }
 
+// With the profile_counters feature, the remote side counts the
+// cycles and packets it executes per func. This collects them and
+// bills them to the funcs' hardware counters, packets as
+// instructions. It should be called after every run.
+WEAK void poll_profiler_counters(void *user_context) {
+    if (!remote_poll_profiler_counters) return;
+    halide_profiler_state *s = halide_profiler_get_state();
+    if (!s->pipelines) return;
+
+    // Room for all the funcs the remote side can count: triples of
+    // (func id + 1, cycles, packets).
+    uint64_t counters[256 * 3];
+    int count = 0;
+    int result = remote_poll_profiler_counters((unsigned char *)counters, sizeof(counters), &count);
+    if (result != 0) {
+        print(user_context) << "Hexagon: remote_poll_profiler_counters failed " << result << "\n";
+        return;
+    }
+
+    ScopedMutexLock lock(&s->lock);
+    for (int i = 0; i < count; i++) {
+        int func = (int)counters[i * 3] - 1;
+        uint64_t cycles = counters[i * 3 + 1];
+        uint64_t packets = counters[i * 3 + 2];
+        for (halide_profiler_pipeline_stats *p = s->pipelines; p;
+             p = (halide_profiler_pipeline_stats *)(p->next)) {
+            if (func >= p->first_func_id && func < p->first_func_id + p->num_funcs) {
+                halide_profiler_func_stats *f = p->funcs + func - p->first_func_id;
+                f->instructions += packets;
+                f->cycles += cycles;
+                p->instructions += packets;
+                p->cycles += cycles;
+                break;
+            }
+        }
+    }
+}
+
 template <typename T>
 __attribute__((always_inline)) void get_symbol(void *user_context, void *host_lib, const char* name, T &sym, bool required = true) {
     debug(user_context) << "    halide_get_library_symbol('" << name << "') -> \n";
@@ -136,6 +180,7 @@ WEAK int init_hexagon_runtime(void *user_context) {
     // These symbols are optional.
     get_symbol(user_context, host_lib, "halide_hexagon_remote_poll_log", remote_poll_log, /* required */ false);
     get_symbol(user_context, host_lib, "halide_hexagon_remote_poll_profiler_state", remote_poll_profiler_state, /* required */ false);
+    get_symbol(user_context, host_lib, "halide_hexagon_remote_poll_profiler_counters", remote_poll_profiler_counters, /* required */ false);
 
     // If these are unavailable, then the runtime always powers HVX on and so these are not necessary.
     get_symbol(user_context, host_lib, "halide_hexagon_remote_power_hvx_on", remote_power_hvx_on, /* required */ false);
@@ -143,11 +188,25 @@ WEAK int init_hexagon_runtime(void *user_context) {
     get_symbol(user_context, host_lib, "halide_hexagon_remote_power_hvx_on_perf", remote_power_hvx_on_perf, /* required */ false);
     get_symbol(user_context, host_lib, "halide_hexagon_remote_power_hvx_off", remote_power_hvx_off, /* required */ false);
 
+    // If this is unavailable, the remote side allocates the way it
+    // always has, and ignores halide_hexagon_set_arena_size.
+    get_symbol(user_context, host_lib, "halide_hexagon_remote_set_arena_size", remote_set_arena_size, /* required */ false);
+
+    // If this is unavailable, buffers allocated outside of
+    // host_malloc get mapped by FastRPC on every call.
+    get_symbol(user_context, host_lib, "halide_hexagon_host_register_buf", host_register_buf, /* required */ false);
+
     host_malloc_init();
 
     return 0;
 }
 
+// The size of the remote allocation arenas set by
+// halide_hexagon_set_arena_size, and whether it has changed since it
+// was last sent to the remote side.
+WEAK uint64_t arena_size = 0;
+WEAK bool arena_size_changed = false;
+
 // Structure to hold the state of a module attached to the context.
 // Also used as a linked-list to keep track of all the different
 // modules that are attached to a context in order to release them all
@@ -159,6 +218,37 @@ struct module_state {
 };
 WEAK module_state *state_list = NULL;
 
+// Buffers allocated by the caller (e.g. ION buffers from a camera
+// HAL) that have been registered with FastRPC by
+// halide_hexagon_wrap_ion_buffer. The registrations persist until
+// halide_hexagon_release_ion_buffer or halide_hexagon_device_release,
+// so wrapping the same buffer again (e.g. for each frame) doesn't map
+// it again. Protected by thread_lock.
+struct registered_buffer {
+    void *buf;
+    uint64_t size;
+    int fd;
+    registered_buffer *next;
+};
+WEAK registered_buffer *registered_buffers = NULL;
+
+WEAK registered_buffer *find_registered_buffer(void *buf) {
+    for (registered_buffer *i = registered_buffers; i; i = i->next) {
+        if (i->buf == buf) {
+            return i;
+        }
+    }
+    return NULL;
+}
+
+WEAK void unregister_buffer(void *user_context, registered_buffer *rec) {
+    debug(user_context) << "    host_register_buf " << rec->buf << " (unregister)\n";
+    if (host_register_buf) {
+        host_register_buf(rec->buf, rec->size, -1);
+    }
+    free(rec);
+}
+
 }}}}  // namespace Halide::Runtime::Internal::Hexagon
 
 using namespace Halide::Runtime::Internal;
@@ -206,6 +296,22 @@ WEAK int halide_hexagon_initialize_kernels(void *user_context, void **state_ptr,
         state_list = *state;
     }
 
+    // Size the remote allocation arenas before running anything, so
+    // the kernels' allocations come from them.
+    if (arena_size_changed && remote_set_arena_size) {
+        debug(user_context) << "    halide_remote_set_arena_size (" << arena_size << ") -> ";
+        int set_result = remote_set_arena_size((unsigned int)arena_size);
+        poll_log(user_context);
+        debug(user_context) << "        " << set_result << "\n";
+        if (set_result != 0) {
+            // The allocations that don't fit go to the heap, so this
+            // isn't fatal.
+            print(user_context) << "Hexagon: reserving allocation arenas of "
+                                << arena_size << " bytes failed\n";
+        }
+        arena_size_changed = false;
+    }
+
     // Create the module itself if necessary.
     if (!(*state)->module) {
         debug(user_context) << "    halide_remote_initialize_kernels -> ";
@@ -263,6 +369,241 @@ WEAK int map_arguments(void *user_context, int arg_count,
     return mapped_count;
 }
 
+struct mapped_arguments {
+    remote_buffer *input_buffers, *output_buffers, *input_scalars;
+    int input_buffer_count, output_buffer_count, input_scalar_count;
+};
+
+// Map all of the arguments into mapped_buffers, which must have room
+// for all of them, in the order the remote side expects: the input
+// buffers (bit 0 of flags is set), then the output buffers (bit 1 of
+// flags is set), then the input scalars (neither bit is set).
+WEAK int map_all_arguments(void *user_context, int arg_count,
+                           uint64_t arg_sizes[], void *args[], int arg_flags[],
+                           remote_buffer *mapped_buffers, mapped_arguments *result) {
+    result->input_buffers = mapped_buffers;
+    result->input_buffer_count = map_arguments(user_context, arg_count, arg_sizes, args, arg_flags, 0x3, 0x1,
+                                               result->input_buffers);
+    if (result->input_buffer_count < 0) return result->input_buffer_count;
+
+    result->output_buffers = result->input_buffers + result->input_buffer_count;
+    result->output_buffer_count = map_arguments(user_context, arg_count, arg_sizes, args, arg_flags, 0x2, 0x2,
+                                                result->output_buffers);
+    if (result->output_buffer_count < 0) return result->output_buffer_count;
+
+    result->input_scalars = result->output_buffers + result->output_buffer_count;
+    result->input_scalar_count = map_arguments(user_context, arg_count, arg_sizes, args, arg_flags, 0x3, 0x0,
+                                               result->input_scalars);
+    if (result->input_scalar_count < 0) return result->input_scalar_count;
+
+    return 0;
+}
+
+// If we haven't gotten the symbol for this function, do so now.
+WEAK int get_remote_function(void *user_context, halide_hexagon_handle_t module,
+                             const char *name, halide_hexagon_handle_t *function) {
+    if (*function == 0) {
+        debug(user_context) << "    halide_hexagon_remote_get_symbol " << name << " -> ";
+        *function = remote_get_symbol(module, name, strlen(name) + 1);
+        poll_log(user_context);
+        debug(user_context) << "        " << *function << "\n";
+        if (*function == 0) {
+            error(user_context) << "Failed to find function " << name << " in module.\n";
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// The power policy set by halide_hexagon_set_power_policy, if
+// any. While one is set, runs are preceded by a power vote of the
+// policy's own, in the mode it picked for the function being run,
+// which it holds until hold_time_us after the last run ends. Each
+// run still powers HVX on and off around itself on the remote side,
+// but with the policy's vote held that's only a reference count.
+WEAK halide_mutex power_policy_lock = { { 0 } };
+WEAK halide_cond power_policy_changed;
+WEAK bool power_policy_thread_started = false;
+WEAK bool power_policy_set = false;
+WEAK halide_hvx_power_policy_t power_policy;
+// The mode of the policy's vote, or -1 if it doesn't hold one.
+WEAK int power_policy_mode = -1;
+// The number of runs in progress, and when the last one ended.
+WEAK int power_policy_runs = 0;
+WEAK uint64_t power_policy_last_run_end = 0;
+
+// The recent run times of the functions the policy has run, and the
+// mode it picked for each. When the table is full, the oldest
+// function is forgotten.
+struct power_policy_function {
+    halide_hexagon_handle_t function;
+    // An exponential moving average of the run time, in microseconds.
+    uint64_t average_us;
+    int mode;
+};
+WEAK power_policy_function power_policy_functions[16];
+WEAK int power_policy_num_functions = 0;
+
+WEAK power_policy_function *find_power_policy_function(halide_hexagon_handle_t function) {
+    const int max_functions = sizeof(power_policy_functions) / sizeof(power_policy_functions[0]);
+    int count = power_policy_num_functions < max_functions ? power_policy_num_functions : max_functions;
+    for (int i = 0; i < count; i++) {
+        if (power_policy_functions[i].function == function) {
+            return &power_policy_functions[i];
+        }
+    }
+    // Start functions in the policy's fastest mode, so the first runs
+    // after a new pipeline (or a new policy) aren't slow.
+    power_policy_function *f = &power_policy_functions[power_policy_num_functions++ % max_functions];
+    f->function = function;
+    f->average_us = 0;
+    f->mode = power_policy.max_mode;
+    return f;
+}
+
+// Change the policy's vote to the given mode, or drop it if mode is
+// -1. The remote side only votes when HVX goes from off to on, so to
+// change modes, the old vote has to be dropped first. Must be called
+// with power_policy_lock held.
+WEAK int power_policy_vote(void *user_context, int mode) {
+    if (power_policy_mode == mode) return 0;
+    if (power_policy_mode >= 0) {
+        debug(user_context) << "    remote_power_hvx_off (power policy) -> ";
+        int result = remote_power_hvx_off();
+        debug(user_context) << "        " << result << "\n";
+        power_policy_mode = -1;
+        if (result != 0) return result;
+    }
+    if (mode >= 0) {
+        debug(user_context) << "    remote_power_hvx_on_mode " << mode << " (power policy) -> ";
+        int result = remote_power_hvx_on_mode(mode);
+        debug(user_context) << "        " << result << "\n";
+        if (result != 0) return result;
+        power_policy_mode = mode;
+    }
+    return 0;
+}
+
+// Drop the policy's vote once no run has needed it for the hold time,
+// or when the policy is removed.
+WEAK void power_policy_thread(void *) {
+    halide_mutex_lock(&power_policy_lock);
+    while (true) {
+        if (power_policy_mode < 0) {
+            halide_cond_wait(&power_policy_changed, &power_policy_lock);
+            continue;
+        }
+        uint64_t hold_ns = power_policy_set ? power_policy.hold_time_us * 1000 : 0;
+        uint64_t idle_ns = halide_current_time_ns(NULL) - power_policy_last_run_end;
+        if (power_policy_runs == 0 && idle_ns >= hold_ns) {
+            if (power_policy_vote(NULL, -1) != 0) {
+                print(NULL) << "Hexagon: power policy failed to power HVX off\n";
+            }
+            continue;
+        }
+        uint64_t sleep_ns = power_policy_runs == 0 ? hold_ns - idle_ns : hold_ns;
+        halide_mutex_unlock(&power_policy_lock);
+        halide_sleep_us(NULL, (int)(sleep_ns / 1000) + 1);
+        halide_mutex_lock(&power_policy_lock);
+    }
+}
+
+// Vote for the mode the policy picked for a function before it
+// runs. Returns the time the run started, or 0 if there's no policy.
+WEAK uint64_t power_policy_begin_run(void *user_context, halide_hexagon_handle_t function) {
+    ScopedMutexLock lock(&power_policy_lock);
+    if (!power_policy_set) return 0;
+    power_policy_function *f = find_power_policy_function(function);
+    if (power_policy_vote(user_context, f->mode) != 0) {
+        // The run powers HVX on itself anyway, so this isn't fatal.
+        print(user_context) << "Hexagon: power policy failed to power HVX on\n";
+    }
+    power_policy_runs++;
+    return halide_current_time_ns(user_context);
+}
+
+// Update the run time of a function after it ran, and step its mode
+// up if it's slower than the target, or down if it's faster than
+// step_down_percent of it.
+WEAK void power_policy_end_run(void *user_context, halide_hexagon_handle_t function, uint64_t t_start) {
+    if (t_start == 0) return;
+    uint64_t t_end = halide_current_time_ns(user_context);
+    ScopedMutexLock lock(&power_policy_lock);
+    power_policy_runs--;
+    power_policy_last_run_end = t_end;
+    halide_cond_broadcast(&power_policy_changed);
+    if (!power_policy_set) return;
+
+    power_policy_function *f = find_power_policy_function(function);
+    uint64_t run_us = (t_end - t_start) / 1000;
+    f->average_us = f->average_us == 0 ? run_us : (3 * f->average_us + run_us) / 4;
+    uint64_t target_us = power_policy.target_run_time_us;
+    if (target_us == 0) return;
+    if (f->average_us > target_us && f->mode < power_policy.max_mode) {
+        f->mode++;
+        debug(user_context) << "    power policy: " << (int)f->average_us << " us average, stepping up to mode " << f->mode << "\n";
+    } else if (f->average_us * 100 < target_us * power_policy.step_down_percent &&
+               f->mode > power_policy.min_mode) {
+        f->mode--;
+        debug(user_context) << "    power policy: " << (int)f->average_us << " us average, stepping down to mode " << f->mode << "\n";
+    }
+}
+
+// A run queued by halide_hexagon_run_async. The mapped arguments, and
+// copies of the scalars, are allocated along with it.
+struct queued_run {
+    void *user_context;
+    halide_hexagon_handle_t module;
+    halide_hexagon_handle_t function;
+    mapped_arguments args;
+    queued_run *next;
+};
+
+// The queue of runs, which run in order on a single thread. The
+// number pending includes the run in progress, if any. The result is
+// the first failure since the last halide_hexagon_wait.
+WEAK halide_mutex queue_lock = { { 0 } };
+WEAK halide_cond queue_changed;
+WEAK bool queue_initialized = false;
+WEAK queued_run *queue_head = NULL;
+WEAK queued_run *queue_tail = NULL;
+WEAK int queue_pending = 0;
+WEAK int queue_result = 0;
+
+WEAK void run_queued_runs(void *) {
+    halide_mutex_lock(&queue_lock);
+    while (true) {
+        while (!queue_head) {
+            halide_cond_wait(&queue_changed, &queue_lock);
+        }
+        queued_run *run = queue_head;
+        queue_head = run->next;
+        if (!queue_head) {
+            queue_tail = NULL;
+        }
+        halide_mutex_unlock(&queue_lock);
+
+        uint64_t t_policy = power_policy_begin_run(run->user_context, run->function);
+        debug(run->user_context) << "    halide_hexagon_remote_run (queued " << run << ") -> ";
+        int result = remote_run(run->module, run->function,
+                                run->args.input_buffers, run->args.input_buffer_count,
+                                run->args.output_buffers, run->args.output_buffer_count,
+                                run->args.input_scalars, run->args.input_scalar_count);
+        poll_log(run->user_context);
+        poll_profiler_counters(run->user_context);
+        debug(run->user_context) << "        " << result << "\n";
+        power_policy_end_run(run->user_context, run->function, t_policy);
+        free(run);
+
+        halide_mutex_lock(&queue_lock);
+        if (result != 0 && queue_result == 0) {
+            queue_result = result;
+        }
+        queue_pending--;
+        halide_cond_broadcast(&queue_changed);
+    }
+}
+
 }  // namespace
 
 WEAK int halide_hexagon_run(void *user_context,
@@ -284,17 +625,8 @@ WEAK int halide_hexagon_run(void *user_context,
                         << "name: " << name << ", "
                         << "function: " << function << " (" << *function << "))\n";
 
-    // If we haven't gotten the symbol for this function, do so now.
-    if (*function == 0) {
-        debug(user_context) << "    halide_hexagon_remote_get_symbol " << name << " -> ";
-        *function = remote_get_symbol(module, name, strlen(name) + 1);
-        poll_log(user_context);
-        debug(user_context) << "        " << *function << "\n";
-        if (*function == 0) {
-            error(user_context) << "Failed to find function " << name << " in module.\n";
-            return -1;
-        }
-    }
+    result = get_remote_function(user_context, module, name, function);
+    if (result != 0) return result;
 
     // Allocate some remote_buffer objects on the stack.
     int arg_count = 0;
@@ -303,23 +635,15 @@ WEAK int halide_hexagon_run(void *user_context,
         (remote_buffer *)__builtin_alloca(arg_count * sizeof(remote_buffer));
 
     // Map the arguments.
-    // First grab the input buffers (bit 0 of flags is set).
-    remote_buffer *input_buffers = mapped_buffers;
-    int input_buffer_count = map_arguments(user_context, arg_count, arg_sizes, args, arg_flags, 0x3, 0x1,
-                                           input_buffers);
-    if (input_buffer_count < 0) return input_buffer_count;
-
-    // Then the output buffers (bit 1 of flags is set).
-    remote_buffer *output_buffers = input_buffers + input_buffer_count;
-    int output_buffer_count = map_arguments(user_context, arg_count, arg_sizes, args, arg_flags, 0x2, 0x2,
-                                            output_buffers);
-    if (output_buffer_count < 0) return output_buffer_count;
-
-    // And the input scalars (neither bits 0 or 1 of flags is set).
-    remote_buffer *input_scalars = output_buffers + output_buffer_count;
-    int input_scalar_count = map_arguments(user_context, arg_count, arg_sizes, args, arg_flags, 0x3, 0x0,
-                                           input_scalars);
-    if (input_scalar_count < 0) return input_scalar_count;
+    mapped_arguments mapped;
+    result = map_all_arguments(user_context, arg_count, arg_sizes, args, arg_flags, mapped_buffers, &mapped);
+    if (result != 0) return result;
+    remote_buffer *input_buffers = mapped.input_buffers;
+    remote_buffer *output_buffers = mapped.output_buffers;
+    remote_buffer *input_scalars = mapped.input_scalars;
+    int input_buffer_count = mapped.input_buffer_count;
+    int output_buffer_count = mapped.output_buffer_count;
+    int input_scalar_count = mapped.input_scalar_count;
 
     #ifdef DEBUG_RUNTIME
     uint64_t t_before = halide_current_time_ns(user_context);
@@ -334,13 +658,16 @@ WEAK int halide_hexagon_run(void *user_context,
     }
 
     // Call the pipeline on the device side.
+    uint64_t t_policy = power_policy_begin_run(user_context, *function);
     debug(user_context) << "    halide_hexagon_remote_run -> ";
     result = remote_run(module, *function,
                         input_buffers, input_buffer_count,
                         output_buffers, output_buffer_count,
                         input_scalars, input_scalar_count);
     poll_log(user_context);
+    poll_profiler_counters(user_context);
     debug(user_context) << "        " << result << "\n";
+    power_policy_end_run(user_context, *function, t_policy);
     if (result != 0) {
         error(user_context) << "Hexagon pipeline failed.\n";
         return result;
@@ -356,10 +683,110 @@ WEAK int halide_hexagon_run(void *user_context,
     return result != 0 ? -1 : 0;
 }
 
+WEAK int halide_hexagon_run_async(void *user_context,
+                                  void *state_ptr,
+                                  const char *name,
+                                  halide_hexagon_handle_t* function,
+                                  uint64_t arg_sizes[],
+                                  void *args[],
+                                  int arg_flags[]) {
+    halide_assert(user_context, state_ptr != NULL);
+    halide_assert(user_context, function != NULL);
+    int result = init_hexagon_runtime(user_context);
+    if (result != 0) return result;
+
+    halide_hexagon_handle_t module = state_ptr ? ((module_state *)state_ptr)->module : 0;
+    debug(user_context) << "Hexagon: halide_hexagon_run_async ("
+                        << "user_context: " << user_context << ", "
+                        << "state_ptr: " << state_ptr << " (" << module << "), "
+                        << "name: " << name << ", "
+                        << "function: " << function << " (" << *function << "))\n";
+
+    result = get_remote_function(user_context, module, name, function);
+    if (result != 0) return result;
+
+    // The scalars are pointers to the caller's stack, so copy them
+    // into the same allocation as the run and its mapped arguments.
+    int arg_count = 0;
+    size_t scalar_size = 0;
+    for (; arg_sizes[arg_count] > 0; arg_count++) {
+        if (arg_flags[arg_count] == 0) {
+            scalar_size += arg_sizes[arg_count];
+        }
+    }
+    size_t size = sizeof(queued_run) + arg_count * sizeof(remote_buffer) + scalar_size;
+    queued_run *run = (queued_run *)malloc(size);
+    if (!run) {
+        error(user_context) << "Out of memory queueing Hexagon pipeline.\n";
+        return halide_error_code_out_of_memory;
+    }
+    run->user_context = user_context;
+    run->module = module;
+    run->function = *function;
+    run->next = NULL;
+    remote_buffer *mapped_buffers = (remote_buffer *)(run + 1);
+    result = map_all_arguments(user_context, arg_count, arg_sizes, args, arg_flags, mapped_buffers, &run->args);
+    if (result != 0) {
+        free(run);
+        return result;
+    }
+    uint8_t *scalars = (uint8_t *)(mapped_buffers + arg_count);
+    for (int i = 0; i < run->args.input_scalar_count; i++) {
+        remote_buffer &scalar = run->args.input_scalars[i];
+        memcpy(scalars, scalar.data, scalar.dataLen);
+        scalar.data = scalars;
+        scalars += scalar.dataLen;
+    }
+
+    ScopedMutexLock lock(&queue_lock);
+    if (!queue_initialized) {
+        halide_cond_init(&queue_changed);
+        halide_spawn_thread(run_queued_runs, NULL);
+        queue_initialized = true;
+    }
+    if (queue_tail) {
+        queue_tail->next = run;
+    } else {
+        queue_head = run;
+    }
+    queue_tail = run;
+    queue_pending++;
+    halide_cond_broadcast(&queue_changed);
+    debug(user_context) << "    queued " << run << " (" << queue_pending << " pending)\n";
+
+    return 0;
+}
+
+WEAK int halide_hexagon_wait(void *user_context) {
+    halide_mutex_lock(&queue_lock);
+    if (queue_pending > 0) {
+        debug(user_context) << "Hexagon: halide_hexagon_wait (" << queue_pending << " pending)\n";
+    }
+    while (queue_pending > 0) {
+        halide_cond_wait(&queue_changed, &queue_lock);
+    }
+    int result = queue_result;
+    queue_result = 0;
+    halide_mutex_unlock(&queue_lock);
+
+    if (result != 0) {
+        error(user_context) << "Hexagon pipeline failed.\n";
+    }
+    return result;
+}
+
 WEAK int halide_hexagon_device_release(void *user_context) {
     debug(user_context)
         << "Hexagon: halide_hexagon_device_release (user_context: " <<  user_context << ")\n";
 
+    halide_hexagon_wait(user_context);
+
+    // Drop the power policy's vote, if it holds one. The policy stays
+    // set, and votes again on the next run.
+    halide_mutex_lock(&power_policy_lock);
+    power_policy_vote(user_context, -1);
+    halide_mutex_unlock(&power_policy_lock);
+
     ScopedMutexLock lock(&thread_lock);
 
     // Release all of the remote side modules.
@@ -378,6 +805,13 @@ WEAK int halide_hexagon_device_release(void *user_context) {
     }
     state_list = NULL;
 
+    // Release the registrations of caller allocated buffers.
+    while (registered_buffers) {
+        registered_buffer *rec = registered_buffers;
+        registered_buffers = rec->next;
+        unregister_buffer(user_context, rec);
+    }
+
     return 0;
 }
 
@@ -480,13 +914,25 @@ WEAK int halide_hexagon_device_free(void *user_context, buffer_t* buf) {
         << "Hexagon: halide_hexagon_device_free (user_context: " << user_context
         << ", buf: " << buf << ")\n";
 
+    // Queued runs may still be using the buffer.
+    int result = halide_hexagon_wait(user_context);
+    if (result != 0) return result;
+
     #ifdef DEBUG_RUNTIME
     uint64_t t_before = halide_current_time_ns(user_context);
     #endif
 
     uint64_t size = halide_hexagon_get_device_size(user_context, buf);
     void *ion = halide_hexagon_detach_device_handle(user_context, buf);
-    if (size >= min_ion_allocation_size) {
+    bool wrapped;
+    {
+        ScopedMutexLock lock(&thread_lock);
+        wrapped = find_registered_buffer(ion) != NULL;
+    }
+    if (wrapped) {
+        // The caller owns this memory.
+        debug(user_context) << "    detached wrapped ion=" << ion << "\n";
+    } else if (size >= min_ion_allocation_size) {
         debug(user_context) << "    host_free ion=" << ion << "\n";
         host_free(ion);
     } else {
@@ -518,15 +964,25 @@ WEAK int halide_hexagon_copy_to_device(void *user_context, buffer_t* buf) {
         <<  "Hexagon: halide_hexagon_copy_to_device (user_context: " << user_context
         << ", buf: " << buf << ")\n";
 
+    // Queued runs may still be using the buffer.
+    err = halide_hexagon_wait(user_context);
+    if (err != 0) return err;
+
     #ifdef DEBUG_RUNTIME
     uint64_t t_before = halide_current_time_ns(user_context);
     #endif
 
     halide_assert(user_context, buf->host && buf->dev);
+    void *ion = halide_hexagon_get_device_handle(user_context, buf);
+    if (ion == buf->host) {
+        // The buffer is zero copy, so there's nothing to copy.
+        debug(user_context) << "    zero copy\n";
+        return 0;
+    }
     device_copy c = make_host_to_device_copy(buf);
 
     // Get the descriptor associated with the ion buffer.
-    c.dst = reinterpret<uintptr_t>(halide_hexagon_get_device_handle(user_context, buf));
+    c.dst = reinterpret<uintptr_t>(ion);
     c.copy_memory(user_context);
 
     #ifdef DEBUG_RUNTIME
@@ -542,15 +998,24 @@ WEAK int halide_hexagon_copy_to_host(void *user_context, buffer_t* buf) {
         << "Hexagon: halide_hexagon_copy_to_host (user_context: " << user_context
         << ", buf: " << buf << ")\n";
 
+    // Queued runs may still be using the buffer.
+    int result = halide_hexagon_wait(user_context);
+    if (result != 0) return result;
+
     #ifdef DEBUG_RUNTIME
     uint64_t t_before = halide_current_time_ns(user_context);
     #endif
 
     halide_assert(user_context, buf->host && buf->dev);
+    void *ion = halide_hexagon_get_device_handle(user_context, buf);
+    if (ion == buf->host) {
+        debug(user_context) << "    zero copy\n";
+        return 0;
+    }
     device_copy c = make_device_to_host_copy(buf);
 
     // Get the descriptor associated with the ion buffer.
-    c.src = reinterpret<uintptr_t>(halide_hexagon_get_device_handle(user_context, buf));
+    c.src = reinterpret<uintptr_t>(ion);
     c.copy_memory(user_context);
 
     #ifdef DEBUG_RUNTIME
@@ -564,8 +1029,7 @@ WEAK int halide_hexagon_copy_to_host(void *user_context, buffer_t* buf) {
 WEAK int halide_hexagon_device_sync(void *user_context, struct buffer_t *) {
     debug(user_context)
         << "Hexagon: halide_hexagon_device_sync (user_context: " << user_context << ")\n";
-    // Nothing to do.
-    return 0;
+    return halide_hexagon_wait(user_context);
 }
 
 WEAK int halide_hexagon_wrap_device_handle(void *user_context, struct buffer_t *buf,
@@ -589,6 +1053,84 @@ WEAK int halide_hexagon_wrap_device_handle(void *user_context, struct buffer_t *
     return 0;
 }
 
+WEAK int halide_hexagon_wrap_ion_buffer(void *user_context, struct buffer_t *buf,
+                                        void *ion_buf, uint64_t size, int fd) {
+    int result = init_hexagon_runtime(user_context);
+    if (result != 0) return result;
+
+    debug(user_context)
+        << "Hexagon: halide_hexagon_wrap_ion_buffer (user_context: " << user_context
+        << ", buf: " << buf << ", ion_buf: " << ion_buf << ", size: " << size
+        << ", fd: " << fd << ")\n";
+
+    {
+        ScopedMutexLock lock(&thread_lock);
+        registered_buffer *rec = find_registered_buffer(ion_buf);
+        if (rec && (rec->size != size || rec->fd != fd)) {
+            // The caller reused the address for a different
+            // allocation, so the registration is stale.
+            halide_hexagon_wait(user_context);
+            if (host_register_buf) {
+                host_register_buf(rec->buf, rec->size, -1);
+            }
+            rec->size = size;
+            rec->fd = fd;
+            rec->buf = NULL;
+        }
+        if (!rec) {
+            rec = (registered_buffer *)malloc(sizeof(registered_buffer));
+            if (!rec) {
+                error(user_context) << "Out of memory registering ion buffer.\n";
+                return halide_error_code_out_of_memory;
+            }
+            rec->buf = NULL;
+            rec->size = size;
+            rec->fd = fd;
+            rec->next = registered_buffers;
+            registered_buffers = rec;
+        }
+        if (!rec->buf) {
+            debug(user_context) << "    host_register_buf " << ion_buf << " -> fd " << fd << "\n";
+            if (host_register_buf) {
+                host_register_buf(ion_buf, size, fd);
+            }
+            rec->buf = ion_buf;
+        } else {
+            debug(user_context) << "    re-using registration of " << ion_buf << "\n";
+        }
+    }
+
+    result = halide_hexagon_wrap_device_handle(user_context, buf, ion_buf, size);
+    if (result != 0) return result;
+
+    if (!buf->host) {
+        // Make the buffer zero copy.
+        buf->host = (uint8_t *)ion_buf;
+        debug(user_context) << "    host <- " << buf->host << "\n";
+    }
+    return 0;
+}
+
+WEAK int halide_hexagon_release_ion_buffer(void *user_context, void *ion_buf) {
+    debug(user_context)
+        << "Hexagon: halide_hexagon_release_ion_buffer (user_context: " << user_context
+        << ", ion_buf: " << ion_buf << ")\n";
+
+    // Queued runs may still be using the buffer.
+    int result = halide_hexagon_wait(user_context);
+
+    ScopedMutexLock lock(&thread_lock);
+    for (registered_buffer **i = &registered_buffers; *i; i = &(*i)->next) {
+        if ((*i)->buf == ion_buf) {
+            registered_buffer *rec = *i;
+            *i = rec->next;
+            unregister_buffer(user_context, rec);
+            return result;
+        }
+    }
+    return result;
+}
+
 WEAK void *halide_hexagon_detach_device_handle(void *user_context, struct buffer_t *buf) {
     if (buf->dev == NULL) {
         return NULL;
@@ -743,6 +1285,7 @@ WEAK int halide_hexagon_power_hvx_off(void *user_context) {
     if (result != 0) return result;
 
     debug(user_context) << "halide_hexagon_power_hvx_off\n";
+    halide_hexagon_wait(user_context);
     if (!remote_power_hvx_off) {
         // The function is not available in this version of the
         // runtime, this runtime always powers HVX on.
@@ -773,6 +1316,51 @@ WEAK void halide_hexagon_power_hvx_off_as_destructor(void *user_context, void *
     halide_hexagon_power_hvx_off(user_context);
 }
 
+WEAK int halide_hexagon_set_arena_size(void *user_context, uint64_t bytes_per_thread) {
+    debug(user_context) << "halide_hexagon_set_arena_size (bytes_per_thread: " << bytes_per_thread << ")\n";
+    if (bytes_per_thread > 0x7fffffff) {
+        error(user_context) << "Hexagon: arena size " << bytes_per_thread << " is too large\n";
+        return -1;
+    }
+    ScopedMutexLock lock(&thread_lock);
+    arena_size = bytes_per_thread;
+    arena_size_changed = true;
+    return 0;
+}
+
+WEAK int halide_hexagon_set_power_policy(void *user_context, const halide_hvx_power_policy_t *policy) {
+    int result = init_hexagon_runtime(user_context);
+    if (result != 0) return result;
+
+    debug(user_context) << "halide_hexagon_set_power_policy (policy: " << (void *)policy << ")\n";
+    if (!remote_power_hvx_on_mode || !remote_power_hvx_off) {
+        // The power functions are not available in this version of
+        // the runtime, which always powers HVX on in turbo mode.
+        return 0;
+    }
+
+    halide_start_clock(user_context);
+    ScopedMutexLock lock(&power_policy_lock);
+    if (!power_policy_thread_started) {
+        halide_cond_init(&power_policy_changed);
+        halide_spawn_thread(power_policy_thread, NULL);
+        power_policy_thread_started = true;
+    }
+    power_policy_set = policy != NULL;
+    if (policy) {
+        power_policy = *policy;
+        if (power_policy.max_mode < power_policy.min_mode) {
+            power_policy.max_mode = power_policy.min_mode;
+        }
+        // Forget what the previous policy learned.
+        power_policy_num_functions = 0;
+    }
+    // Let the policy's thread drop its vote, if there's no policy any
+    // more, or the hold time got shorter.
+    halide_cond_broadcast(&power_policy_changed);
+    return 0;
+}
+
 WEAK const halide_device_interface_t *halide_hexagon_device_interface() {
     return &hexagon_device_interface;
 }
@@ -238,6 +238,15 @@ void halide_hexagon_host_free(void *ptr) {
     free(rec);
 }
 
+// Register memory allocated elsewhere (e.g. by a camera HAL) with
+// FastRPC so it is mapped once, rather than on every call. An fd of
+// -1 unregisters it.
+void halide_hexagon_host_register_buf(void *buf, int size, int fd) {
+    if (remote_register_buf) {
+        remote_register_buf(buf, size, fd);
+    }
+}
+
 // This is a shim for calling v2 from v1.
 handle_t halide_hexagon_remote_get_symbol(handle_t module_ptr,
                                           const char* name, int nameLen) {
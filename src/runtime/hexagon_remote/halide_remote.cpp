@@ -14,6 +14,8 @@ extern "C" {
 
 #include "elf.h"
 #include "pipeline_context.h"
+#include "profiler_counters.h"
+#include "pool_allocator.h"
 #include "log.h"
 
 const int stack_alignment = 128;
@@ -22,6 +24,9 @@ const int stack_size = 1024 * 1024;
 typedef halide_hexagon_remote_handle_t handle_t;
 typedef halide_hexagon_remote_buffer buffer;
 
+// Defined in thread_pool.cpp.
+int halide_host_cpu_count();
+
 extern "C" {
 
 // This is a basic implementation of the Halide runtime for Hexagon.
@@ -41,43 +46,16 @@ void halide_error(void *user_context, const char *str) {
     }
 }
 
-namespace {
-
-// We keep a small pool of small pre-allocated buffers for use by Halide
-// code; some kernels end up doing per-scanline allocations and frees,
-// which can cause a noticable performance impact on some workloads.
-// 'num_buffers' is the number of pre-allocated buffers and 'buffer_size' is
-// the size of each buffer. The pre-allocated buffers are shared among threads
-// and we use __sync_val_compare_and_swap primitive to synchronize the buffer
-// allocation.
-// TODO(psuriana): make num_buffers configurable by user
-const int num_buffers = 10;
-const int buffer_size = 1024 * 64;
-int buf_is_used[num_buffers];
-char mem_buf[num_buffers][buffer_size]
-    __attribute__((aligned(128))); /* Hexagon requires 128-byte alignment. */
-
-}
+// The arenas halide_malloc serves allocations from; see
+// pool_allocator.h.
+pool_state pool = { pool_default_arena_size };
 
 void *halide_malloc(void *user_context, size_t x) {
-    if (x <= buffer_size) {
-        for (int i = 0; i < num_buffers; ++i) {
-            if (__sync_val_compare_and_swap(buf_is_used+i, 0, 1) == 0) {
-                return mem_buf[i];
-            }
-        }
-    }
-    return memalign(128, x);
+    return pool_malloc(&pool, x);
 }
 
 void halide_free(void *user_context, void *ptr) {
-    for (int i = 0; i < num_buffers; ++i) {
-        if (mem_buf[i] == ptr) {
-            buf_is_used[i] = 0;
-            return;
-        }
-    }
-    free(ptr);
+    pool_free(&pool, ptr);
 }
 
 void *halide_get_symbol(const char *name) {
@@ -332,6 +310,11 @@ int halide_hexagon_remote_get_symbol_v2(handle_t module_ptr, const char* name, i
     return *sym_ptr != 0 ? 0 : -1;
 }
 
+profiler_counters_state profiler_counters;
+
+// Defined in thread_pool.cpp.
+void halide_hexagon_get_hvx_contention(int *tasks, int *contended);
+
 int halide_hexagon_remote_run(handle_t module_ptr, handle_t function,
                               const buffer *input_buffersPtrs, int input_buffersLen,
                               buffer *output_buffersPtrs, int output_buffersLen,
@@ -378,12 +361,37 @@ int halide_hexagon_remote_run(handle_t module_ptr, handle_t function,
     // Call the pipeline and return the result.
     result = run_context.run(pipeline, args);
 
+    // Stop counting the last func the pipeline computed, if it was
+    // counting.
+    profiler_switch_func(&profiler_counters, -1);
+
+    // The thread pool only uses as many threads as there are HVX
+    // units, so tasks waiting for a context means more tasks ran at
+    // once than that (e.g. from nested parallel loops). Report it,
+    // as it can cost a lot of time.
+    int hvx_tasks, hvx_contended_tasks;
+    halide_hexagon_get_hvx_contention(&hvx_tasks, &hvx_contended_tasks);
+    if (hvx_contended_tasks > 0) {
+        log_printf("%d of %d parallel tasks waited for an HVX context\n",
+                   hvx_contended_tasks, hvx_tasks);
+    }
+
     // Power HVX off.
     halide_hexagon_remote_power_hvx_off();
 
     return result;
 }
 
+int halide_hexagon_remote_set_arena_size(unsigned int arena_size) {
+    // Reserve an arena for each thread the thread pool runs, one of
+    // which is the thread pipelines run on.
+    int result = pool_set_arena_size(&pool, arena_size, halide_host_cpu_count());
+    if (result != 0) {
+        log_printf("Reserving arenas of %d bytes failed\n", (int)pool.arena_size);
+    }
+    return result;
+}
+
 int halide_hexagon_remote_release_kernels(handle_t module_ptr, int codeLen) {
     obj_dlclose(reinterpret_cast<elf_t*>(module_ptr));
     return 0;
@@ -400,6 +408,16 @@ halide_profiler_state *halide_profiler_get_state() {
     return &hvx_profiler_state;
 }
 
+int halide_hexagon_profiler_set_current_func(halide_profiler_state *state, int tok, int t) {
+    profiler_switch_func(&profiler_counters, tok + t);
+    state->current_func = tok + t;
+    return 0;
+}
+
+int halide_hexagon_remote_poll_profiler_counters(unsigned char *counters, int countersLen, int *count) {
+    return profiler_take_counters(&profiler_counters, counters, countersLen, count);
+}
+
 
 
 }  // extern "C"
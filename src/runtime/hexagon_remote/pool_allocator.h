@@ -0,0 +1,198 @@
+#ifndef HALIDE_HEXAGON_REMOTE_POOL_ALLOCATOR_H
+#define HALIDE_HEXAGON_REMOTE_POOL_ALLOCATOR_H
+
+#include <stdlib.h>
+#include <string.h>
+#include <qurt.h>
+
+// Offloaded code allocates with halide_malloc inside its loop nests,
+// often once per scanline or tile, and once per thread in parallel
+// loops. The DSP heap is small and slow, and fragments over long
+// sessions, so we serve these allocations from arenas reserved up
+// front, one per thread running Halide code. An arena carves blocks
+// with power-of-two sizes off its region as they are needed, and
+// keeps freed blocks on a free list per size, so once a pipeline has
+// run, running it again doesn't touch the heap. When all of an
+// arena's blocks are free, it starts over from the beginning of its
+// region. Allocations that don't fit in the arena go to the heap.
+
+// Blocks are aligned for HVX, and start with a header of that size.
+const size_t pool_alignment = 128;
+
+// The smallest block is 256 bytes, header included. There's a size
+// class for each power of two from there up to 2GB.
+const int pool_min_block_log2 = 8;
+const int pool_num_size_classes = 24;
+
+// This is enough for the thread pool's threads and the thread
+// pipelines run on. If more threads than this run Halide code, some
+// of them share an arena.
+const int pool_max_arenas = 8;
+
+// The size of the arenas if the host doesn't set one.
+const size_t pool_default_arena_size = 256 * 1024;
+
+struct pool_block_header {
+    // The next free block of the same size class, while this block
+    // is free.
+    pool_block_header *next;
+    // The arena the block belongs to, or -1 if it is from the heap.
+    int arena;
+    int size_class;
+};
+
+struct pool_arena {
+    // The thread the arena belongs to, or 0 if it is unclaimed.
+    volatile unsigned int owner;
+    int lock;
+    // The arena's region, or NULL if it isn't reserved yet, and the
+    // start of the part of it no block has used yet.
+    char *begin, *next, *end;
+    int live_blocks;
+    pool_block_header *free_blocks[pool_num_size_classes];
+};
+
+struct pool_state {
+    volatile size_t arena_size;
+    pool_arena arenas[pool_max_arenas];
+};
+
+inline void pool_lock(pool_arena *a) {
+    while (__sync_lock_test_and_set(&a->lock, 1)) {}
+}
+
+inline void pool_unlock(pool_arena *a) {
+    __sync_lock_release(&a->lock);
+}
+
+inline size_t pool_block_size(int size_class) {
+    return (size_t)1 << (size_class + pool_min_block_log2);
+}
+
+// Forget the blocks of an arena with no live blocks. If the arena
+// size has changed since its region was reserved, release the region,
+// to be reserved again at the new size. Call with the arena locked.
+inline void pool_reset_arena(pool_state *s, pool_arena *a) {
+    memset(a->free_blocks, 0, sizeof(a->free_blocks));
+    a->next = a->begin;
+    if (a->begin && (size_t)(a->end - a->begin) != s->arena_size) {
+        free(a->begin);
+        a->begin = a->next = a->end = NULL;
+    }
+}
+
+// Reserve the region of an arena, if it doesn't have one. Call with
+// the arena locked.
+inline bool pool_reserve_arena(pool_state *s, pool_arena *a) {
+    if (!a->begin && s->arena_size > 0) {
+        a->begin = (char *)memalign(pool_alignment, s->arena_size);
+        if (a->begin) {
+            a->next = a->begin;
+            a->end = a->begin + s->arena_size;
+        }
+    }
+    return a->begin != NULL;
+}
+
+// Find the calling thread's arena, claiming one for it if it doesn't
+// have one yet.
+inline pool_arena *pool_thread_arena(pool_state *s) {
+    unsigned int self = (unsigned int)qurt_thread_get_id();
+    for (int i = 0; i < pool_max_arenas; i++) {
+        if (s->arenas[i].owner == self) {
+            return &s->arenas[i];
+        }
+    }
+    for (int i = 0; i < pool_max_arenas; i++) {
+        if (__sync_bool_compare_and_swap(&s->arenas[i].owner, 0, self)) {
+            return &s->arenas[i];
+        }
+    }
+    return &s->arenas[self % pool_max_arenas];
+}
+
+inline void *pool_malloc(pool_state *s, size_t size) {
+    size_t total = size + pool_alignment;
+    int size_class = 0;
+    while (size_class < pool_num_size_classes && pool_block_size(size_class) < total) {
+        size_class++;
+    }
+
+    pool_block_header *b = NULL;
+    int arena = -1;
+    if (size_class < pool_num_size_classes && pool_block_size(size_class) <= s->arena_size) {
+        pool_arena *a = pool_thread_arena(s);
+        pool_lock(a);
+        if (pool_reserve_arena(s, a)) {
+            size_t block_size = pool_block_size(size_class);
+            if (a->free_blocks[size_class]) {
+                b = a->free_blocks[size_class];
+                a->free_blocks[size_class] = b->next;
+            } else if ((size_t)(a->end - a->next) >= block_size) {
+                b = (pool_block_header *)a->next;
+                a->next += block_size;
+            }
+            if (b) {
+                a->live_blocks++;
+                arena = a - s->arenas;
+            }
+        }
+        pool_unlock(a);
+    }
+
+    if (!b) {
+        b = (pool_block_header *)memalign(pool_alignment, total);
+        if (!b) {
+            return NULL;
+        }
+    }
+    b->next = NULL;
+    b->arena = arena;
+    b->size_class = size_class;
+    return (char *)b + pool_alignment;
+}
+
+inline void pool_free(pool_state *s, void *ptr) {
+    if (!ptr) {
+        return;
+    }
+    pool_block_header *b = (pool_block_header *)((char *)ptr - pool_alignment);
+    if (b->arena < 0) {
+        free(b);
+        return;
+    }
+    // The block may be freed by a thread other than the one that
+    // allocated it, so it goes back to the arena it came from.
+    pool_arena *a = &s->arenas[b->arena];
+    pool_lock(a);
+    b->next = a->free_blocks[b->size_class];
+    a->free_blocks[b->size_class] = b;
+    if (--a->live_blocks == 0) {
+        pool_reset_arena(s, a);
+    }
+    pool_unlock(a);
+}
+
+// Set the size of the arenas, or restore the default if it is 0, and
+// reserve the first count of them now. Arenas with live blocks keep
+// their region until those are freed. Returns -1 if reserving an
+// arena failed, in which case the allocations that would have used it
+// go to the heap.
+inline int pool_set_arena_size(pool_state *s, size_t arena_size, int count) {
+    s->arena_size = arena_size > 0 ? arena_size : pool_default_arena_size;
+    int result = 0;
+    for (int i = 0; i < pool_max_arenas; i++) {
+        pool_arena *a = &s->arenas[i];
+        pool_lock(a);
+        if (a->live_blocks == 0) {
+            pool_reset_arena(s, a);
+            if (i < count && !pool_reserve_arena(s, a)) {
+                result = -1;
+            }
+        }
+        pool_unlock(a);
+    }
+    return result;
+}
+
+#endif  // HALIDE_HEXAGON_REMOTE_POOL_ALLOCATOR_H
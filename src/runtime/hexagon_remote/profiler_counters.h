@@ -0,0 +1,106 @@
+#ifndef HALIDE_HEXAGON_REMOTE_PROFILER_COUNTERS_H
+#define HALIDE_HEXAGON_REMOTE_PROFILER_COUNTERS_H
+
+#include <stdint.h>
+#include <string.h>
+
+// With the profile_counters feature, offloaded code switches its
+// current func by calling halide_hexagon_profiler_set_current_func,
+// which bills the cycles and packets the DSP executed since the last
+// switch to the func that was computed. The counters are the DSP's
+// UPCYCLE and PKTCOUNT registers, which (like current_func) are
+// shared by all its threads, so the counts are exact for serial code,
+// and in parallel loops go to whichever func was switched to
+// last. The host collects the counts after each run with
+// poll_profiler_counters.
+
+// The counts of one func. The layout is the same on the host, which
+// reads these as an array of uint64_t.
+struct profiler_func_counters {
+    // The func id plus one, or zero if the entry is unused.
+    uint64_t func;
+    uint64_t cycles, packets;
+};
+
+struct profiler_counters_state {
+    int lock;
+    // The func being counted plus one, or zero if none, and the
+    // counter values when it started.
+    int current_func;
+    uint64_t start_cycles, start_packets;
+    // A hash table of the funcs with counts, by func id.
+    enum { max_funcs = 256 };
+    profiler_func_counters funcs[max_funcs];
+};
+
+// The function offloaded code calls to switch its current func. It
+// also sets the current_func of the remote profiler state.
+extern "C" int halide_hexagon_profiler_set_current_func(struct halide_profiler_state *state, int tok, int t);
+
+#ifdef __hexagon__
+
+inline uint64_t read_upcycle() {
+    uint64_t r;
+    asm volatile ("%0 = c15:14" : "=r"(r));
+    return r;
+}
+
+inline uint64_t read_pktcount() {
+    uint64_t r;
+    asm volatile ("%0 = c19:18" : "=r"(r));
+    return r;
+}
+
+inline void bill_profiler_counters(profiler_counters_state *s, int func, uint64_t cycles, uint64_t packets) {
+    unsigned h = (unsigned)func % profiler_counters_state::max_funcs;
+    for (int i = 0; i < profiler_counters_state::max_funcs; i++) {
+        profiler_func_counters *f = &s->funcs[(h + i) % profiler_counters_state::max_funcs];
+        if (f->func == 0) {
+            f->func = func + 1;
+        }
+        if (f->func == (uint64_t)func + 1) {
+            f->cycles += cycles;
+            f->packets += packets;
+            return;
+        }
+    }
+    // The table is full. Drop the counts; the host will still have
+    // the sampled time of the func.
+}
+
+// Bill the counts since the last switch to the func being counted,
+// and start counting the given one, or stop if it's -1.
+inline void profiler_switch_func(profiler_counters_state *s, int func) {
+    uint64_t cycles = read_upcycle();
+    uint64_t packets = read_pktcount();
+    while (__sync_lock_test_and_set(&s->lock, 1)) {}
+    if (s->current_func > 0) {
+        bill_profiler_counters(s, s->current_func - 1, cycles - s->start_cycles, packets - s->start_packets);
+    }
+    s->current_func = func + 1;
+    s->start_cycles = cycles;
+    s->start_packets = packets;
+    __sync_lock_release(&s->lock);
+}
+
+// Move the counts to out, which has room for size bytes, return the
+// number of entries moved in *count, and start over. The host's
+// buffer has room for max_funcs entries, so none are lost.
+inline int profiler_take_counters(profiler_counters_state *s, unsigned char *out, int size, int *count) {
+    int max_count = size / sizeof(profiler_func_counters);
+    *count = 0;
+    while (__sync_lock_test_and_set(&s->lock, 1)) {}
+    for (int i = 0; i < profiler_counters_state::max_funcs && *count < max_count; i++) {
+        if (s->funcs[i].func != 0) {
+            memcpy(out + *count * sizeof(profiler_func_counters), &s->funcs[i], sizeof(profiler_func_counters));
+            (*count)++;
+        }
+    }
+    memset(s->funcs, 0, sizeof(s->funcs));
+    __sync_lock_release(&s->lock);
+    return 0;
+}
+
+#endif  // __hexagon__
+
+#endif  // HALIDE_HEXAGON_REMOTE_PROFILER_COUNTERS_H
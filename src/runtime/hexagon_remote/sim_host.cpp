@@ -7,6 +7,7 @@
 #include <HexagonWrapper.h>
 
 #include "sim_protocol.h"
+#include "profiler_counters.h"
 
 typedef unsigned int handle_t;
 
@@ -436,6 +437,9 @@ void halide_hexagon_host_free(void *ptr) {
     free(((void**)ptr)[-1]);
 }
 
+void halide_hexagon_host_register_buf(void *buf, int size, int fd) {
+}
+
 int halide_hexagon_remote_poll_profiler_state(int *func, int *threads) {
     // The stepping code periodically grabs the remote value of
     // current_func for us.
@@ -444,4 +448,31 @@ int halide_hexagon_remote_poll_profiler_state(int *func, int *threads) {
     return 0;
 }
 
+int halide_hexagon_remote_poll_profiler_counters(unsigned char *counters, int countersLen, int *count) {
+    assert(sim);
+
+    // The simulation is stopped between messages, so we can read and
+    // reset the remote table of counters directly.
+    *count = 0;
+    HEX_4u_t remote_counters = 0;
+    HEXAPI_Status status = sim->ReadSymbolValue("profiler_counters", &remote_counters);
+    if (status != HEX_STAT_SUCCESS) {
+        printf("HexagonWrapper::ReadSymbolValue(profiler_counters) failed: %d\n", status);
+        return -1;
+    }
+    profiler_counters_state state;
+    if (read_memory(&state, remote_counters, sizeof(state))) {
+        return -1;
+    }
+    int max_count = countersLen / sizeof(profiler_func_counters);
+    for (int i = 0; i < profiler_counters_state::max_funcs && *count < max_count; i++) {
+        if (state.funcs[i].func != 0) {
+            memcpy(counters + *count * sizeof(profiler_func_counters), &state.funcs[i], sizeof(profiler_func_counters));
+            (*count)++;
+        }
+    }
+    memset(state.funcs, 0, sizeof(state.funcs));
+    return write_memory(remote_counters, &state, sizeof(state));
+}
+
 }  // extern "C"
@@ -9,6 +9,7 @@
 #include "sim_protocol.h"
 #include "log.h"
 #include "elf.h"
+#include "profiler_counters.h"
 
 typedef halide_hexagon_remote_handle_t handle_t;
 typedef halide_hexagon_remote_buffer buffer;
@@ -147,6 +148,7 @@ void *halide_get_symbol(const char *name) {
         {"memset", (char *)(&memset)},
         {"halide_mutex_destroy", (char *)(&halide_mutex_destroy)},
         {"halide_profiler_get_state", (char *)(&halide_profiler_get_state)},
+        {"halide_hexagon_profiler_set_current_func", (char *)(&halide_hexagon_profiler_set_current_func)},
         {"qurt_hvx_lock", (char *)(&qurt_hvx_lock)},
         {"qurt_hvx_unlock", (char *)(&qurt_hvx_unlock)},
         {"__hexagon_divdf3", (char *)(&__hexagon_divdf3)},
@@ -274,6 +276,24 @@ handle_t get_symbol(handle_t module_ptr, const char* name, int nameLen) {
     return reinterpret_cast<handle_t>(obj_dlsym(reinterpret_cast<elf_t*>(module_ptr), name));
 }
 
+extern "C" {
+halide_profiler_state profiler_state;
+int *profiler_current_func_addr = &profiler_state.current_func;
+
+// The simulator host reads and resets these directly after each run.
+profiler_counters_state profiler_counters;
+}
+
+halide_profiler_state *halide_profiler_get_state() {
+    return (halide_profiler_state *)(&profiler_state);
+}
+
+int halide_hexagon_profiler_set_current_func(halide_profiler_state *state, int tok, int t) {
+    profiler_switch_func(&profiler_counters, tok + t);
+    state->current_func = tok + t;
+    return 0;
+}
+
 int run(handle_t module_ptr, handle_t function,
         const buffer *input_buffersPtrs, int input_buffersLen,
         buffer *output_buffersPtrs, int output_buffersLen,
@@ -311,8 +331,11 @@ int run(handle_t module_ptr, handle_t function,
         *next_arg = input_scalarsPtrs[i].data;
     }
 
-    // Call the pipeline and return the result.
-    return pipeline(args);
+    // Call the pipeline, stop counting the last func it computed (if
+    // it was counting), and return the result.
+    int result = pipeline(args);
+    profiler_switch_func(&profiler_counters, -1);
+    return result;
 }
 
 int release_kernels(handle_t module_ptr, int codeLen) {
@@ -320,15 +343,6 @@ int release_kernels(handle_t module_ptr, int codeLen) {
     return 0;
 }
 
-extern "C" {
-halide_profiler_state profiler_state;
-int *profiler_current_func_addr = &profiler_state.current_func;
-}
-
-halide_profiler_state *halide_profiler_get_state() {
-    return (halide_profiler_state *)(&profiler_state);
-}
-
 extern "C" {
 
 // The global symbols with which we pass RPC commands and results.
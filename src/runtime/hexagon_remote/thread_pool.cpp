@@ -86,13 +86,46 @@ void halide_cond_wait(struct halide_cond *cond, struct halide_mutex *mutex) {
 #define WEAK
 #include "../thread_pool_common.h"
 
+// Older versions of QuRT don't have this.
+extern "C" __attribute__((weak)) int qurt_hvx_get_units();
+
 namespace {
 // We wrap the closure passed to jobs with extra info we
-// need. Currently just the hvx mode to use.
+// need. Currently the hvx mode to use, and the number of HVX units
+// available in that mode.
 struct wrapped_closure {
     uint8_t *closure;
     int hvx_mode;
+    int hvx_units;
 };
+
+// The number of HVX contexts available in the given mode. There's
+// no point using more threads than this for HVX code, the rest would
+// just wait for a context.
+int hvx_units(int hvx_mode) {
+    if (hvx_mode == -1) {
+        return halide_host_cpu_count();
+    }
+    if (qurt_hvx_get_units) {
+        // The low byte is the number of 64 byte units, the next byte
+        // the number of 128 byte units.
+        int units = qurt_hvx_get_units();
+        int count = (hvx_mode == QURT_HVX_MODE_128B) ? (units >> 8) & 0xff : units & 0xff;
+        if (count > 0) {
+            return count;
+        }
+    }
+    // Assume a Snapdragon 820.
+    return (hvx_mode == QURT_HVX_MODE_128B) ? 2 : 4;
+}
+
+// The number of tasks that have wanted an HVX context, the number of
+// those that had to wait for one because all the units were in use
+// (by this pipeline), and the number of contexts currently held or
+// waited for.
+volatile int hvx_tasks = 0;
+volatile int hvx_contended_tasks = 0;
+volatile int hvx_contexts_wanted = 0;
 }
 
 extern "C" {
@@ -117,12 +150,7 @@ int halide_do_par_for(void *user_context,
         // initializing this mutex.
         qurt_mutex_init(mutex);
     }
-    wrapped_closure c = {closure, qurt_hvx_get_mode()};
-
-    // Set the desired number of threads based on the current HVX
-    // mode.
-    int old_num_threads =
-        halide_set_num_threads((c.hvx_mode == QURT_HVX_MODE_128B) ? 2 : 4);
+    wrapped_closure c = {closure, qurt_hvx_get_mode(), 0};
 
     // We're about to acquire the thread-pool lock, so we must drop
     // the hvx context lock, even though we'll likely reacquire it
@@ -143,6 +171,11 @@ int halide_do_par_for(void *user_context,
             c.hvx_mode = -1;
         }
     }
+
+    // Size the thread pool to the number of HVX units for the
+    // current mode.
+    c.hvx_units = hvx_units(c.hvx_mode);
+    int old_num_threads = halide_set_num_threads(c.hvx_units);
     int ret = Halide::Runtime::Internal::default_do_par_for(user_context, task, min, size, (uint8_t *)&c);
     if (c.hvx_mode != -1) {
         qurt_hvx_lock((qurt_hvx_mode_t)c.hvx_mode);
@@ -161,13 +194,25 @@ int halide_do_task(void *user_context, halide_task_t f,
     // We don't own the thread-pool lock here, so we can safely
     // acquire the hvx context lock (if needed) to run some code.
     if (c->hvx_mode != -1) {
+        __sync_fetch_and_add(&hvx_tasks, 1);
+        if (__sync_fetch_and_add(&hvx_contexts_wanted, 1) >= c->hvx_units) {
+            __sync_fetch_and_add(&hvx_contended_tasks, 1);
+        }
         qurt_hvx_lock((qurt_hvx_mode_t)c->hvx_mode);
         int ret = f(user_context, idx, c->closure);
         qurt_hvx_unlock();
+        __sync_fetch_and_sub(&hvx_contexts_wanted, 1);
         return ret;
     } else {
         return f(user_context, idx, c->closure);
     }
 }
 
+// Get and reset the counts of tasks that needed an HVX context, and
+// of those that had to wait for one.
+void halide_hexagon_get_hvx_contention(int *tasks, int *contended) {
+    *tasks = __sync_fetch_and_and(&hvx_tasks, 0);
+    *contended = __sync_fetch_and_and(&hvx_contended_tasks, 0);
+}
+
 }
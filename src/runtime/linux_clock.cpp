@@ -76,4 +76,12 @@ WEAK void halide_sleep_ms(void *user_context, int ms) {
         usleep(ms * 1000);
 }
 
+extern int nanosleep(const timespec *req, timespec *rem);
+WEAK void halide_sleep_us(void *user_context, int us) {
+    timespec t;
+    t.tv_sec = us / 1000000;
+    t.tv_nsec = (us % 1000000) * 1000;
+    nanosleep(&t, NULL);
+}
+
 }
@@ -1,11 +1,43 @@
 #include "HalideRuntime.h"
+#include "runtime_internal.h"
 
 extern "C" {
 
 extern long sysconf(int);
+extern int access(const char *pathname, int mode);
+extern int sched_setaffinity(int pid, size_t cpusetsize, const void *mask);
 
 WEAK int halide_host_cpu_count() {
     return sysconf(84);
 }
 
+WEAK int halide_host_cpu_numa_node(int cpu) {
+    // sysfs has a link /sys/devices/system/cpu/cpuN/nodeM for the
+    // node M that cpu N belongs to.
+    for (int node = 0; node < 64; node++) {
+        char path[128];
+        char *dst = path, *end = path + sizeof(path);
+        dst = halide_string_to_string(dst, end, "/sys/devices/system/cpu/cpu");
+        dst = halide_int64_to_string(dst, end, cpu, 1);
+        dst = halide_string_to_string(dst, end, "/node");
+        dst = halide_int64_to_string(dst, end, node, 1);
+        if (access(path, 0) == 0) {
+            return node;
+        }
+    }
+    return -1;
+}
+
+WEAK int halide_pin_current_thread_to_cpu(int cpu) {
+    // Large enough for a cpu_set_t on 1024 cpus.
+    uint64_t mask[16];
+    if (cpu < 0 || cpu >= 1024) {
+        return -1;
+    }
+    memset(mask, 0, sizeof(mask));
+    mask[cpu / 64] = ((uint64_t)1) << (cpu % 64);
+    // A pid of zero means the calling thread.
+    return sched_setaffinity(0, sizeof(mask), mask);
+}
+
 }
@@ -0,0 +1,32 @@
+#include "HalideRuntime.h"
+#include "runtime_internal.h"
+
+extern "C" {
+
+#define PROT_READ 1
+#define PROT_WRITE 2
+#define MAP_PRIVATE 2
+#define MAP_ANONYMOUS 0x20
+#define MAP_FAILED ((void *)-1)
+#define MADV_HUGEPAGE 14
+
+extern void *mmap(void *addr, size_t length, int prot, int flags, int fd, long offset);
+extern int munmap(void *addr, size_t length);
+extern int madvise(void *addr, size_t length, int advice);
+
+WEAK void *halide_allocate_huge_pages(size_t size) {
+    void *result = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (result == MAP_FAILED) {
+        return NULL;
+    }
+    // Ask for transparent huge pages. This fails harmlessly if the
+    // kernel doesn't support them, leaving ordinary pages.
+    madvise(result, size, MADV_HUGEPAGE);
+    return result;
+}
+
+WEAK void halide_free_huge_pages(void *ptr, size_t size) {
+    munmap(ptr, size);
+}
+
+}  // extern "C"
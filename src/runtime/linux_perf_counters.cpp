@@ -0,0 +1,118 @@
+#include "HalideRuntime.h"
+#include "runtime_internal.h"
+
+// The syscall numbers vary across platforms:
+// -- x64 is 298 (perf_event_open) and 186 (gettid)
+// -- i386 is 336 and 224
+// android_perf_counters.cpp defines the arm ones and includes this file.
+#ifndef SYS_PERF_EVENT_OPEN
+
+#ifdef BITS_64
+#define SYS_PERF_EVENT_OPEN 298
+#define SYS_GETTID 186
+#endif
+
+#ifdef BITS_32
+#define SYS_PERF_EVENT_OPEN 336
+#define SYS_GETTID 224
+#endif
+
+#endif
+
+extern "C" {
+
+extern int syscall(int num, ...);
+extern ssize_t read(int fd, void *buf, size_t bytes);
+
+}
+
+namespace Halide { namespace Runtime { namespace Internal {
+
+#define PERF_TYPE_HARDWARE 0
+#define PERF_COUNT_HW_CPU_CYCLES 0
+#define PERF_COUNT_HW_INSTRUCTIONS 1
+#define PERF_COUNT_HW_CACHE_MISSES 3
+#define PERF_FORMAT_GROUP (1 << 3)
+#define PERF_FLAG_FD_CLOEXEC (1 << 3)
+
+// Only count user space work; with the default perf_event_paranoid
+// setting that's all an unprivileged process may count anyway.
+#define PERF_ATTR_EXCLUDE_KERNEL (1 << 5)
+#define PERF_ATTR_EXCLUDE_HV (1 << 6)
+
+// The leading part of struct perf_event_attr, up to
+// PERF_ATTR_SIZE_VER1. The kernel accepts any older size.
+struct perf_event_attr {
+    uint32_t type;
+    uint32_t size;
+    uint64_t config;
+    uint64_t sample_period;
+    uint64_t sample_type;
+    uint64_t read_format;
+    uint64_t flags;
+    uint32_t wakeup_events;
+    uint32_t bp_type;
+    uint64_t config1;
+    uint64_t config2;
+};
+
+WEAK int perf_event_open(uint64_t config, int group_fd) {
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = config;
+    attr.read_format = PERF_FORMAT_GROUP;
+    attr.flags = PERF_ATTR_EXCLUDE_KERNEL | PERF_ATTR_EXCLUDE_HV;
+    // This thread, on any cpu.
+    return syscall(SYS_PERF_EVENT_OPEN, &attr, 0, -1, group_fd, PERF_FLAG_FD_CLOEXEC);
+}
+
+}}} // namespace Halide::Runtime::Internal
+
+extern "C" {
+
+WEAK int halide_perf_counters_open() {
+    using namespace Halide::Runtime::Internal;
+    // The counters are opened as one group, so that they're scheduled
+    // onto the PMU together and can be read with a single call. The
+    // order matches halide_perf_counters_read.
+    int leader = perf_event_open(PERF_COUNT_HW_INSTRUCTIONS, -1);
+    if (leader < 0) {
+        return -1;
+    }
+    int cycles = perf_event_open(PERF_COUNT_HW_CPU_CYCLES, leader);
+    int misses = cycles < 0 ? -1 : perf_event_open(PERF_COUNT_HW_CACHE_MISSES, leader);
+    if (misses < 0) {
+        // Some PMUs (and most virtual machines) lack one of the
+        // events. A partial group is no use.
+        if (cycles >= 0) {
+            close(cycles);
+        }
+        close(leader);
+        return -1;
+    }
+    // The members stay open for as long as the thread is counted,
+    // which is until the process exits.
+    return leader;
+}
+
+WEAK int halide_perf_counters_read(int fd, uint64_t *values) {
+    // With PERF_FORMAT_GROUP, the kernel writes the number of counters
+    // followed by their values.
+    uint64_t buf[1 + halide_perf_num_counters];
+    if (read(fd, buf, sizeof(buf)) != (ssize_t)sizeof(buf) ||
+        buf[0] != halide_perf_num_counters) {
+        return -1;
+    }
+    for (int i = 0; i < halide_perf_num_counters; i++) {
+        values[i] = buf[1 + i];
+    }
+    return 0;
+}
+
+WEAK uint64_t halide_perf_counters_thread_id() {
+    return (uint64_t)syscall(SYS_GETTID);
+}
+
+}  // extern "C"
@@ -173,6 +173,45 @@ INLINE mxArray *create_numeric_matrix(size_t M, size_t N, mxClassID type, mxComp
     }
 }
 
+// The mex APIs may only be called from the Matlab thread, but Halide prints
+// and reports errors from the threads of its thread pool too. While a
+// pipeline runs, messages are kept here, and passed on to Matlab once it
+// returns.
+WEAK halide_mutex pending_messages_lock = { { 0 } };
+WEAK bool pipeline_running = false;
+WEAK char pending_messages[4096];
+WEAK char *pending_messages_end = pending_messages;
+
+// Pass a message on to Matlab, or keep it if a pipeline is running.
+WEAK void report_message(const char *msg) {
+    halide_mutex_lock(&pending_messages_lock);
+    if (pipeline_running) {
+        pending_messages_end = halide_string_to_string(pending_messages_end,
+                                                       pending_messages + sizeof(pending_messages),
+                                                       msg);
+    } else {
+        mexWarnMsgTxt(msg);
+    }
+    halide_mutex_unlock(&pending_messages_lock);
+}
+
+WEAK void flush_pending_messages() {
+    halide_mutex_lock(&pending_messages_lock);
+    pipeline_running = false;
+    if (pending_messages_end != pending_messages) {
+        mexWarnMsgTxt(pending_messages);
+        pending_messages_end = pending_messages;
+        pending_messages[0] = 0;
+    }
+    halide_mutex_unlock(&pending_messages_lock);
+}
+
+// Matlab calls this before unloading the mex file. The threads of the
+// thread pool run code in the mex file, so they must be stopped first.
+WEAK void shutdown_at_exit() {
+    halide_shutdown_thread_pool();
+}
+
 }  // namespace mex
 }  // namespace Runtime
 }  // namespace Halide
@@ -217,11 +256,11 @@ WEAK void halide_matlab_error(void *user_context, const char *msg) {
     // be a common problem, those APIs seem to be very fragile.
     stringstream error_msg(user_context);
     error_msg << "\nHalide Error: " << msg;
-    mexWarnMsgTxt(error_msg.str());
+    report_message(error_msg.str());
 }
 
 WEAK void halide_matlab_print(void *, const char *msg) {
-    mexWarnMsgTxt(msg);
+    report_message(msg);
 }
 
 WEAK int halide_matlab_init(void *user_context) {
@@ -247,6 +286,8 @@ WEAK int halide_matlab_init(void *user_context) {
     halide_set_custom_print(halide_matlab_print);
     halide_set_error_handler(halide_matlab_error);
 
+    mexAtExit(shutdown_at_exit);
+
     return halide_error_code_success;
 }
 
@@ -275,38 +316,56 @@ WEAK int halide_matlab_array_to_buffer_t(void *user_context,
     }
     // Validate that the dimensionality matches. Matlab is wierd
     // because matrices always have at least 2 dimensions, and it
-    // truncates trailing dimensions of extent 1. So, the only way
+    // truncates trailing dimensions of extent 1. Dimensions of
+    // extent 1 don't change the layout of the data, so the only way
     // to have an error here is to have more dimensions with
     // extent != 1 than the Halide pipeline expects.
-    while (dim_count > 0 && get_dimension(arr, dim_count - 1) == 1) {
-        dim_count--;
+    int rank = 0;
+    for (int i = 0; i < dim_count; i++) {
+        if (get_dimension(arr, i) != 1) {
+            rank++;
+        }
     }
-    if (dim_count > expected_dims) {
+    if (rank > expected_dims) {
         error(user_context) << "Expected array of rank " << expected_dims
                             << " for argument " << arg->name
-                            << ", got array of rank " << dim_count << ".\n";
+                            << ", got array of rank " << rank << ".\n";
         return halide_error_code_matlab_bad_param_type;
     }
 
+    // Use the data of the array in place. Only inputs need to be
+    // copied to a device.
     buf->host = (uint8_t *)mxGetData(arr);
-    buf->host_dirty = true;
+    buf->host_dirty = arg->kind == halide_argument_kind_input_buffer;
     buf->elem_size = mxGetElementSize(arr);
 
-    for (int i = 0; i < dim_count && i < expected_dims; i++) {
-        buf->extent[i] = static_cast<int32_t>(get_dimension(arr, i));
+    // Map the dimensions of the array to the buffer with their
+    // column-major strides. If there are too many, drop the
+    // trailing dimensions of extent 1 first, and then the leading
+    // ones (e.g. when a row vector is passed to a 1D buffer).
+    int dims_to_drop = max(dim_count - expected_dims, 0);
+    while (dims_to_drop > 0 && get_dimension(arr, dim_count - 1) == 1) {
+        dim_count--;
+        dims_to_drop--;
     }
-
-    // Add back the dimensions with extent 1.
-    for (int i = 2; i < expected_dims; i++) {
-        if (buf->extent[i] == 0) {
-            buf->extent[i] = 1;
+    int32_t stride = 1;
+    int d = 0;
+    for (int i = 0; i < dim_count; i++) {
+        int32_t extent = static_cast<int32_t>(get_dimension(arr, i));
+        if (extent == 1 && dims_to_drop > 0) {
+            dims_to_drop--;
+        } else {
+            buf->extent[d] = extent;
+            buf->stride[d] = stride;
+            d++;
         }
+        stride *= extent;
     }
 
-    // Compute dense strides.
-    buf->stride[0] = 1;
-    for (int i = 1; i < expected_dims; i++) {
-        buf->stride[i] = buf->extent[i - 1] * buf->stride[i - 1];
+    // Add back the dimensions with extent 1.
+    for (; d < expected_dims; d++) {
+        buf->extent[d] = 1;
+        buf->stride[d] = stride;
     }
 
     return halide_error_code_success;
@@ -434,8 +493,14 @@ WEAK int halide_matlab_call_pipeline(void *user_context,
         }
     }
 
+    halide_mutex_lock(&pending_messages_lock);
+    pipeline_running = true;
+    halide_mutex_unlock(&pending_messages_lock);
+
     result = pipeline(args);
 
+    flush_pending_messages();
+
     // Copy any GPU resident output buffers back to the CPU before returning.
     for (int i = 0; i < nrhs; i++) {
         const halide_filter_argument_t *arg_metadata = &metadata->arguments[i];
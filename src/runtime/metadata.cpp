@@ -3,8 +3,9 @@
 namespace Halide { namespace Runtime { namespace Internal {
 
 // This is unused and expected to be optimized away; it exists solely to ensure
-// that the halide_filter_metadata_t type is in the runtime module, so that
-// Codegen_LLVM can access its description.
+// that the halide_filter_metadata_t type (and the halide_filter_argument_t
+// and halide_filter_func_metadata_t types it points to) is in the runtime
+// module, so that Codegen_LLVM can access its description.
 WEAK const halide_filter_metadata_t *unused_function_to_get_halide_filter_metadata_t_declared() { return NULL; }
 
 } } }
@@ -11,6 +11,7 @@
 extern "C" {
 extern objc_id MTLCreateSystemDefaultDevice();
 extern struct ObjectiveCClass _NSConcreteGlobalBlock;
+extern int getpagesize();
 }
 
 namespace Halide { namespace Runtime { namespace Internal { namespace Metal {
@@ -33,6 +34,17 @@ WEAK mtl_buffer *new_buffer(mtl_device *device, size_t length) {
                      length, 0  /* MTLResourceCPUCacheModeDefaultCache | MTLResourceStorageModeShared */);
 }
 
+// Make a buffer that uses existing page-aligned memory in place. The
+// memory is not freed with the buffer.
+WEAK mtl_buffer *new_buffer_with_bytes_no_copy(mtl_device *device, void *bytes, size_t length) {
+    typedef mtl_buffer *(*new_buffer_method)(objc_id device, objc_sel sel, void *bytes, size_t length,
+                                             size_t options, void *deallocator);
+    new_buffer_method method = (new_buffer_method)&objc_msgSend;
+    return (*method)(device, sel_getUid("newBufferWithBytesNoCopy:length:options:deallocator:"),
+                     bytes, length, 0  /* MTLResourceCPUCacheModeDefaultCache | MTLResourceStorageModeShared */,
+                     NULL);
+}
+
 WEAK mtl_command_queue *new_command_queue(mtl_device *device) {
     return (mtl_command_queue *)objc_msgSend(device, sel_getUid("newCommandQueue"));
 }
@@ -317,6 +329,168 @@ WEAK command_buffer_completed_handler_block_literal command_buffer_completed_han
     &command_buffer_completed_handler_descriptor
 };
 
+// Kernel dispatches are encoded into a pending command buffer, which
+// is committed only at the next point that needs its results (a copy,
+// a device sync, or a buffer being handed back to the caller), or
+// once it holds kMaxDispatchesPerCommandBuffer dispatches. A whole
+// pipeline thus usually reaches the GPU as one command buffer, and the
+// CPU never waits for a kernel it doesn't need the output of.
+//
+// Committed command buffers are numbered in commit order and retained
+// until they're known to be complete. At most kMaxCommandBuffersInFlight
+// are outstanding: committing another first waits for the oldest. A
+// queue runs its command buffers in order, so waiting for one waits
+// for all those before it.
+//
+// All of this is only touched while the context lock is held.
+const int kMaxCommandBuffersInFlight = 3;
+const int kMaxDispatchesPerCommandBuffer = 64;
+
+WEAK mtl_command_buffer *pending_command_buffer = NULL;
+WEAK mtl_command_queue *pending_queue = NULL;
+WEAK int pending_dispatches = 0;
+
+// Command buffer number n is in_flight[(n - 1) % kMaxCommandBuffersInFlight]
+// for retired_count < n <= committed_count.
+WEAK mtl_command_buffer *in_flight[kMaxCommandBuffersInFlight];
+WEAK uint64_t committed_count = 0;
+WEAK uint64_t retired_count = 0;
+
+// The number of the last command buffer that used each device
+// buffer. The pending command buffer is number committed_count + 1.
+struct buffer_use {
+    mtl_buffer *buffer;
+    uint64_t command_buffer;
+    buffer_use *next;
+};
+WEAK buffer_use *buffer_uses = NULL;
+
+// Wait for every command buffer up to and including number n.
+WEAK void retire_command_buffers(uint64_t n) {
+    while (retired_count < n && retired_count < committed_count) {
+        mtl_command_buffer *command_buffer = in_flight[retired_count % kMaxCommandBuffersInFlight];
+        wait_until_completed(command_buffer);
+        release_ns_object(command_buffer);
+        retired_count++;
+    }
+}
+
+WEAK void commit_pending_command_buffer(void *user_context) {
+    if (!pending_command_buffer) {
+        return;
+    }
+    if (committed_count - retired_count == (uint64_t)kMaxCommandBuffersInFlight) {
+        retire_command_buffers(retired_count + 1);
+    }
+    debug(user_context) << "Metal - Committing command buffer " << committed_count + 1
+                        << " with " << pending_dispatches << " dispatches\n";
+    add_command_buffer_completed_handler(pending_command_buffer, &command_buffer_completed_handler_block);
+    commit_command_buffer(pending_command_buffer);
+    in_flight[committed_count % kMaxCommandBuffersInFlight] = pending_command_buffer;
+    committed_count++;
+    pending_command_buffer = NULL;
+    pending_queue = NULL;
+    pending_dispatches = 0;
+}
+
+// The command buffer to encode the next dispatch into, or NULL if one
+// can't be allocated.
+WEAK mtl_command_buffer *get_pending_command_buffer(void *user_context, mtl_command_queue *queue) {
+    if (pending_command_buffer && (pending_queue != queue ||
+                                   pending_dispatches >= kMaxDispatchesPerCommandBuffer)) {
+        commit_pending_command_buffer(user_context);
+    }
+    if (!pending_command_buffer) {
+        // The command buffer is autoreleased, and has to outlive the
+        // autorelease pool of the call that creates it.
+        pending_command_buffer = new_command_buffer(queue);
+        if (pending_command_buffer) {
+            retain_ns_object(pending_command_buffer);
+            pending_queue = queue;
+        }
+    }
+    return pending_command_buffer;
+}
+
+WEAK buffer_use *find_buffer_use(mtl_buffer *buffer) {
+    for (buffer_use *u = buffer_uses; u; u = u->next) {
+        if (u->buffer == buffer) {
+            return u;
+        }
+    }
+    return NULL;
+}
+
+WEAK void record_buffer_use(mtl_buffer *buffer) {
+    buffer_use *u = find_buffer_use(buffer);
+    if (!u) {
+        u = (buffer_use *)malloc(sizeof(buffer_use));
+        if (!u) {
+            // Without a record we can't wait for just this buffer, so
+            // don't leave its work pending.
+            commit_pending_command_buffer(NULL);
+            retire_command_buffers(committed_count);
+            return;
+        }
+        u->buffer = buffer;
+        u->next = buffer_uses;
+        buffer_uses = u;
+    }
+    u->command_buffer = committed_count + 1;
+}
+
+WEAK void forget_buffer_use(mtl_buffer *buffer) {
+    for (buffer_use **u = &buffer_uses; *u; u = &(*u)->next) {
+        if ((*u)->buffer == buffer) {
+            buffer_use *dead = *u;
+            *u = dead->next;
+            free(dead);
+            return;
+        }
+    }
+}
+
+// Commit the pending command buffer if it uses this buffer, so that
+// work encoded on the queue afterwards is ordered after ours.
+WEAK void flush_buffer_use(void *user_context, mtl_buffer *buffer) {
+    buffer_use *u = find_buffer_use(buffer);
+    if (u && u->command_buffer > committed_count) {
+        commit_pending_command_buffer(user_context);
+    }
+}
+
+// Wait for all work that uses this buffer, or for all work if buffer
+// is NULL.
+WEAK void wait_for_buffer(void *user_context, mtl_buffer *buffer) {
+    uint64_t n = committed_count + 1;
+    if (buffer) {
+        buffer_use *u = find_buffer_use(buffer);
+        n = u ? u->command_buffer : 0;
+    }
+    if (n > committed_count) {
+        commit_pending_command_buffer(user_context);
+    }
+    retire_command_buffers(n);
+}
+
+// Make the device's writes to a buffer visible to the host. Managed
+// buffers need an explicit blit to synchronize them.
+WEAK int sync_buffer_to_host(void *user_context, mtl_command_queue *queue, mtl_buffer *buffer) {
+    if (buffer && is_buffer_managed(buffer)) {
+        mtl_command_buffer *command_buffer = get_pending_command_buffer(user_context, queue);
+        if (command_buffer == 0) {
+            error(user_context) << "Metal: Could not allocate command buffer.\n";
+            return -1;
+        }
+        mtl_blit_command_encoder *blit_encoder = new_blit_command_encoder(command_buffer);
+        synchronize_resource(blit_encoder, buffer);
+        end_encoding(blit_encoder);
+        record_buffer_use(buffer);
+    }
+    wait_for_buffer(user_context, buffer);
+    return 0;
+}
+
 }}}} // namespace Halide::Runtime::Internal::Metal
 
 using namespace Halide::Runtime::Internal::Metal;
@@ -392,7 +566,15 @@ WEAK int halide_metal_device_free(void *user_context, buffer_t* buf) {
     uint64_t t_before = halide_current_time_ns(user_context);
     #endif
 
+    MetalContextHolder metal_context(user_context, false);
+    if (metal_context.error != 0) {
+        return metal_context.error;
+    }
+
+    // Command buffers retain the buffers they use, so there is no need
+    // to wait for pending work before releasing it.
     mtl_buffer *metal_buf = (mtl_buffer *)halide_get_device_handle(buf->dev);
+    forget_buffer_use(metal_buf);
     release_ns_object(metal_buf);
     halide_delete_device_wrapper(buf->dev);
     buf->dev = 0;
@@ -453,24 +635,6 @@ WEAK int halide_metal_initialize_kernels(void *user_context, void **state_ptr, c
     return 0;
 }
 
-namespace {
-
-WEAK void halide_metal_device_sync_internal(mtl_command_queue *queue, struct buffer_t *buffer) {
-    mtl_command_buffer *sync_command_buffer = new_command_buffer(queue);
-    if (buffer != NULL) {
-        mtl_buffer *metal_buffer = (mtl_buffer *)halide_get_device_handle(buffer->dev);
-        if (is_buffer_managed(metal_buffer)) {
-            mtl_blit_command_encoder *blit_encoder = new_blit_command_encoder(sync_command_buffer);
-            synchronize_resource(blit_encoder, metal_buffer);
-            end_encoding(blit_encoder);
-        }
-    }
-    commit_command_buffer(sync_command_buffer);
-    wait_until_completed(sync_command_buffer);
-}
-
-}
-
 WEAK int halide_metal_device_sync(void *user_context, struct buffer_t *buffer) {
     #ifdef DEBUG_RUNTIME
     uint64_t t_before = halide_current_time_ns(user_context);
@@ -481,7 +645,14 @@ WEAK int halide_metal_device_sync(void *user_context, struct buffer_t *buffer) {
         return metal_context.error;
     }
 
-    halide_metal_device_sync_internal(metal_context.queue, buffer);
+    mtl_buffer *metal_buffer = NULL;
+    if (buffer != NULL && buffer->dev != 0) {
+        metal_buffer = (mtl_buffer *)halide_get_device_handle(buffer->dev);
+    }
+    int result = sync_buffer_to_host(user_context, metal_context.queue, metal_buffer);
+    if (result != 0) {
+        return result;
+    }
 
     #ifdef DEBUG_RUNTIME
     uint64_t t_after = halide_current_time_ns(user_context);
@@ -503,7 +674,10 @@ WEAK int halide_metal_device_release(void *user_context) {
     }
 
     if (device) {
-        halide_metal_device_sync_internal(queue, NULL);
+        wait_for_buffer(user_context, NULL);
+        while (buffer_uses) {
+            forget_buffer_use(buffer_uses->buffer);
+        }
 
         // Unload the modules attached to this device. Note that the list
         // nodes themselves are not freed, only the program objects are
@@ -553,9 +727,16 @@ WEAK int halide_metal_copy_to_device(void *user_context, buffer_t* buffer) {
     mtl_buffer *metal_buffer = (mtl_buffer *)c.dst;
     c.dst = (uint64_t)buffer_contents(metal_buffer);
 
+    // Kernels still in flight may be reading the old contents.
+    wait_for_buffer(user_context, metal_buffer);
+
     debug(user_context) << "halide_metal_copy_to_device dev = " << (void*)buffer->dev << " metal_buffer = " << metal_buffer << " host = " << buffer->host << "\n";
 
-    c.copy_memory(user_context);
+    // Buffers from halide_metal_device_and_host_malloc or
+    // halide_metal_wrap_host_memory already share the host memory.
+    if (c.dst != c.src) {
+        c.copy_memory(user_context);
+    }
 
     if (is_buffer_managed(metal_buffer)) {
         size_t total_size = buf_size(buffer);
@@ -565,7 +746,6 @@ WEAK int halide_metal_copy_to_device(void *user_context, buffer_t* buffer) {
         total_extent.length = total_size;
         did_modify_range(metal_buffer, total_extent);
     }
-    halide_metal_device_sync_internal(metal_context.queue, buffer);
 
     #ifdef DEBUG_RUNTIME
     uint64_t t_after = halide_current_time_ns(user_context);
@@ -585,14 +765,20 @@ WEAK int halide_metal_copy_to_host(void *user_context, buffer_t* buffer) {
         return metal_context.error;
     }
 
-    halide_metal_device_sync_internal(metal_context.queue, buffer);
-
     halide_assert(user_context, buffer->host && buffer->dev);
 
+    int result = sync_buffer_to_host(user_context, metal_context.queue,
+                                     (mtl_buffer *)halide_get_device_handle(buffer->dev));
+    if (result != 0) {
+        return result;
+    }
+
     device_copy c = make_device_to_host_copy(buffer);
     c.src = (uint64_t)buffer_contents((mtl_buffer *)c.src);
 
-    c.copy_memory(user_context);
+    if (c.dst != c.src) {
+        c.copy_memory(user_context);
+    }
 
     #ifdef DEBUG_RUNTIME
     uint64_t t_after = halide_current_time_ns(user_context);
@@ -624,18 +810,12 @@ WEAK int halide_metal_run(void *user_context,
         return metal_context.error;
     }
 
-    mtl_command_buffer *command_buffer = new_command_buffer(metal_context.queue);
+    mtl_command_buffer *command_buffer = get_pending_command_buffer(user_context, metal_context.queue);
     if (command_buffer == 0) {
         error(user_context) << "Metal: Could not allocate command buffer.\n";
         return -1;
     }
 
-    mtl_compute_command_encoder *encoder = new_compute_command_encoder(command_buffer);
-    if (encoder == 0) {
-        error(user_context) << "Metal: Could not allocate compute command encoder.\n";
-        return -1;
-    }
-
     halide_assert(user_context, state_ptr);
     module_state *state = (module_state*)state_ptr;
 
@@ -651,6 +831,16 @@ WEAK int halide_metal_run(void *user_context,
         release_ns_object(function);
         return -1;
     }
+
+    // The command buffer is shared with other dispatches, so the
+    // encoder must be ended on every path from here on.
+    mtl_compute_command_encoder *encoder = new_compute_command_encoder(command_buffer);
+    if (encoder == 0) {
+        error(user_context) << "Metal: Could not allocate compute command encoder.\n";
+        release_ns_object(pipeline_state);
+        release_ns_object(function);
+        return -1;
+    }
     set_compute_pipeline_state(encoder, pipeline_state);
 
     size_t total_args_size = 0;
@@ -670,6 +860,7 @@ WEAK int halide_metal_run(void *user_context,
         mtl_buffer *args_buffer = new_buffer(metal_context.device, total_args_size);
         if (args_buffer == 0) {
             error(user_context) << "Metal: Could not allocate arguments buffer.\n";
+            end_encoding(encoder);
             release_ns_object(pipeline_state);
             release_ns_object(function);
             return -1;
@@ -694,6 +885,7 @@ WEAK int halide_metal_run(void *user_context,
             halide_assert(user_context, arg_sizes[i] == sizeof(uint64_t));
             mtl_buffer *metal_buffer = (mtl_buffer *)halide_get_device_handle(*(uint64_t *)args[i]);
             set_input_buffer(encoder, metal_buffer, buffer_index);
+            record_buffer_use(metal_buffer);
             buffer_index++;
         }
     }
@@ -712,10 +904,7 @@ WEAK int halide_metal_run(void *user_context,
                           blocksX, blocksY, blocksZ,
                           threadsX, threadsY, threadsZ);
     end_encoding(encoder);
-
-    add_command_buffer_completed_handler(command_buffer, &command_buffer_completed_handler_block);
-
-    commit_command_buffer(command_buffer);
+    pending_dispatches++;
 
     release_ns_object(pipeline_state);
     release_ns_object(function);
@@ -758,12 +947,61 @@ WEAK int halide_metal_wrap_buffer(void *user_context, struct buffer_t *buf, uint
     return 0;
 }
 
+WEAK int halide_metal_wrap_host_memory(void *user_context, struct buffer_t *buf) {
+    debug(user_context)
+        << "halide_metal_wrap_host_memory (user_context: " << user_context
+        << ", buf: " << buf << ", host: " << (void *)buf->host << ")\n";
+
+    halide_assert(user_context, buf->dev == 0);
+    if (buf->dev != 0) {
+        return -2;
+    }
+
+    // Metal can only use memory in place in whole pages.
+    size_t page_size = getpagesize();
+    if (!buf->host || ((uintptr_t)buf->host % page_size) != 0 ||
+        buf->stride[0] < 0 || buf->stride[1] < 0 || buf->stride[2] < 0 || buf->stride[3] < 0) {
+        error(user_context) << "Metal: halide_metal_wrap_host_memory needs a page-aligned host pointer "
+                            << "and non-negative strides.\n";
+        return -3;
+    }
+    size_t size = (buf_size(buf) + page_size - 1) & ~(page_size - 1);
+
+    MetalContextHolder metal_context(user_context, true);
+    if (metal_context.error != 0) {
+        return metal_context.error;
+    }
+
+    mtl_buffer *metal_buf = new_buffer_with_bytes_no_copy(metal_context.device, buf->host, size);
+    if (metal_buf == 0) {
+        error(user_context) << "Metal: Failed to wrap " << (uint64_t)size << " bytes of host memory.\n";
+        return -1;
+    }
+
+    buf->dev = halide_new_device_wrapper((uint64_t)metal_buf, &metal_device_interface);
+    if (buf->dev == 0) {
+        error(user_context) << "Metal: out of memory allocating device wrapper.\n";
+        release_ns_object(metal_buf);
+        return -1;
+    }
+    return 0;
+}
+
 WEAK uintptr_t halide_metal_detach_buffer(void *user_context, struct buffer_t *buf) {
     if (buf->dev == NULL) {
         return 0;
     }
     halide_assert(user_context, halide_get_device_interface(buf->dev) == &metal_device_interface);
     uint64_t buffer = halide_get_device_handle(buf->dev);
+    {
+        // The caller may go on to use the buffer on the same queue, so
+        // our pending work on it has to be committed first.
+        MetalContextHolder metal_context(user_context, false);
+        if (metal_context.error == 0) {
+            flush_buffer_use(user_context, (mtl_buffer *)buffer);
+            forget_buffer_use((mtl_buffer *)buffer);
+        }
+    }
     halide_delete_device_wrapper(buf->dev);
     buf->dev = 0;
     return (uintptr_t)buffer;
@@ -49,7 +49,7 @@ MEX_FN(void, mexWarnMsgTxt, (const char*));
 //MEX_FN(const char*, mexFunctionName, (void));
 //MEX_FN(int, mexEvalString, (const char*));
 //MEX_FN(mxArray*, mexEvalStringWithTrap, (const char*));
-//MEX_FN(int, mexAtExit, (mex_exit_fn));
+MEX_FN(int, mexAtExit, (mex_exit_fn));
 
 // matrix.h
 //MEX_FN(void*, mxMalloc, (size_t));
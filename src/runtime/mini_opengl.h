@@ -167,6 +167,9 @@ typedef void (*PFNGLGETVERTEXATTRIBIVPROC) (GLuint index, GLenum pname, GLint *p
 #define GL_RGB32F 0x8815
 #define GL_LUMINANCE32F 0x8818
 #define GL_VERTEX_ARRAY_BINDING 0x85B5
+#define GL_PIXEL_PACK_BUFFER 0x88EB
+#define GL_PIXEL_PACK_BUFFER_BINDING 0x88ED
+#define GL_STREAM_READ 0x88E1
 
 // GL_ARB_framebuffer_object
 #define GL_FRAMEBUFFER_COMPLETE 0x8CD5
@@ -186,6 +189,20 @@ typedef void (*PFNGLDELETEVERTEXARRAYS)(GLsizei n, const GLuint *arrays);
 typedef const GLubyte *(*PFNGLGETSTRINGI)(GLenum name, GLuint index);
 typedef void (*PFNDRAWBUFFERS)(GLsizei n, const GLenum *bufs);
 
+// ---------- OpenGL 3.2 / OpenGL ES 3.0 ----------
+
+#define GL_SYNC_GPU_COMMANDS_COMPLETE 0x9117
+#define GL_SYNC_FLUSH_COMMANDS_BIT 0x00000001
+#define GL_WAIT_FAILED 0x911D
+#define GL_TIMEOUT_IGNORED 0xFFFFFFFFFFFFFFFFull
+
+typedef struct __GLsync *GLsync;
+typedef uint64_t GLuint64;
+
+typedef GLsync (*PFNGLFENCESYNCPROC)(GLenum condition, unsigned int flags);
+typedef GLenum (*PFNGLCLIENTWAITSYNCPROC)(GLsync sync, unsigned int flags, GLuint64 timeout);
+typedef void (*PFNGLDELETESYNCPROC)(GLsync sync);
+
 // ---------- OpenGL ES 3.1 ----------
 
 #define GL_TEXTURE_BUFFER_EXT 0x8c2a
@@ -202,6 +219,7 @@ typedef void (*PFNDRAWBUFFERS)(GLsizei n, const GLenum *bufs);
 
 #define GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT 0x00000001
 #define GL_BUFFER_UPDATE_BARRIER_BIT      0x00000200
+#define GL_SHADER_STORAGE_BARRIER_BIT     0x00002000
 #define GL_ALL_BARRIER_BITS               0xFFFFFFFF
 
 typedef unsigned int  GLbitfield;
@@ -1,11 +1,21 @@
 #include "HalideRuntime.h"
 
+#define AT_HWCAP    16
+
+#define HWCAP_MIPS_MSA  (1 << 1)
+
+extern "C" unsigned long int getauxval(unsigned long int);
+
 namespace Halide { namespace Runtime { namespace Internal {
 
 WEAK CpuFeatures halide_get_cpu_features() {
-    // MIPS has no CPU-specific Features.
-    const uint64_t known = 0;
-    const uint64_t available = 0;
+    const unsigned long hwcap = getauxval(AT_HWCAP);
+
+    const uint64_t known = (1ULL << halide_target_feature_msa);
+    uint64_t available = 0;
+    if (hwcap & HWCAP_MIPS_MSA) {
+        available |= (1ULL << halide_target_feature_msa);
+    }
     CpuFeatures features = {known, available};
     return features;
 }
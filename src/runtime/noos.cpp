@@ -95,6 +95,36 @@ WEAK int halide_do_par_for(void *user_context, halide_task_t f,
 }
 
 
+WEAK int halide_semaphore_init(halide_semaphore_t *s, int count) {
+    *(int *)s = count;
+    return 0;
+}
+
+WEAK int halide_semaphore_release(halide_semaphore_t *s, int count) {
+    *(int *)s += count;
+    return 0;
+}
+
+WEAK int halide_semaphore_acquire(halide_semaphore_t *s, int count) {
+    // There's nobody else to release it.
+    if (*(int *)s < count) {
+        return halide_error_code_generic_error;
+    }
+    *(int *)s -= count;
+    return 0;
+}
+
+WEAK void halide_semaphore_abandon(void *user_context, void *s) {
+}
+
+WEAK int halide_do_concurrent_tasks(void *user_context, halide_task_t f,
+                                    int min, int size, uint8_t *closure) {
+    // Concurrent tasks can wait on each other, so they can't be run
+    // one after the other.
+    halide_error(user_context, "halide_do_concurrent_tasks not implemented on this platform.");
+    return halide_error_code_generic_error;
+}
+
 WEAK void halide_print(void *user_context, const char *msg) {
     (*custom_print)(user_context, msg);
 }
@@ -2,6 +2,8 @@
 #include "scoped_spin_lock.h"
 #include "device_buffer_utils.h"
 #include "device_interface.h"
+#include "device_memory_pool.h"
+#include "gpu_kernel_cache.h"
 #include "printer.h"
 
 #include "mini_cl.h"
@@ -84,6 +86,17 @@ WEAK char device_type[256];
 WEAK int device_type_lock = 0;
 WEAK bool device_type_initialized = false;
 
+// Whether create_opencl_context should make an out-of-order command
+// queue: 1 or 0 once set by halide_opencl_set_out_of_order_queue, -1
+// to consult HL_OCL_OUT_OF_ORDER_QUEUE.
+WEAK int out_of_order_queue = -1;
+
+// Whether halide_opencl_initialize_kernels should build programs on a
+// background thread: 1 or 0 once set by
+// halide_opencl_set_background_build, -1 to consult
+// HL_OCL_BACKGROUND_BUILD.
+WEAK int background_build = -1;
+
 }}}} // namespace Halide::Runtime::Internal::OpenCL
 
 using namespace Halide::Runtime::Internal::OpenCL;
@@ -121,6 +134,14 @@ WEAK void halide_opencl_set_device_type(const char *n) {
     device_type_initialized = true;
 }
 
+WEAK void halide_opencl_set_out_of_order_queue(bool enable) {
+    out_of_order_queue = enable ? 1 : 0;
+}
+
+WEAK void halide_opencl_set_background_build(bool enable) {
+    background_build = enable ? 1 : 0;
+}
+
 WEAK const char *halide_opencl_get_device_type(void *user_context) {
     ScopedSpinLock lock(&device_type_lock);
     if (!device_type_initialized) {
@@ -210,10 +231,13 @@ public:
 // when then context is released.
 struct module_state {
     cl_program program;
+    // The build of program, if it hasn't been waited for yet.
+    struct program_build *build;
     module_state *next;
 };
 WEAK module_state *state_list = NULL;
 
+
 WEAK bool validate_device_pointer(void *user_context, buffer_t* buf, size_t size=0) {
     if (buf->dev == 0) {
         return true;
@@ -240,6 +264,481 @@ WEAK bool validate_device_pointer(void *user_context, buffer_t* buf, size_t size
     return true;
 }
 
+// Dependencies between commands are tracked per cl_mem, so that an
+// out-of-order queue only orders the commands that touch the same
+// buffer. Each buffer remembers the last command that wrote it and
+// the commands that have read it since; a reader waits for the
+// writer, and a writer waits for both. Only touched while the context
+// lock is held.
+#define MAX_BUFFER_READERS 8
+struct buffer_events {
+    cl_mem mem;
+    cl_event writer;
+    cl_event readers[MAX_BUFFER_READERS];
+    int num_readers;
+    buffer_events *next;
+};
+WEAK buffer_events *buffer_events_list = NULL;
+
+WEAK buffer_events *find_buffer_events(cl_mem mem) {
+    for (buffer_events *e = buffer_events_list; e; e = e->next) {
+        if (e->mem == mem) {
+            return e;
+        }
+    }
+    buffer_events *e = (buffer_events *)malloc(sizeof(buffer_events));
+    if (e) {
+        e->mem = mem;
+        e->writer = NULL;
+        e->num_readers = 0;
+        e->next = buffer_events_list;
+        buffer_events_list = e;
+    }
+    return e;
+}
+
+WEAK void clear_buffer_events(buffer_events *e) {
+    if (e->writer) {
+        clReleaseEvent(e->writer);
+        e->writer = NULL;
+    }
+    for (int i = 0; i < e->num_readers; i++) {
+        clReleaseEvent(e->readers[i]);
+    }
+    e->num_readers = 0;
+}
+
+// Called when a cl_mem is released or handed back to the user.
+WEAK void forget_buffer_events(cl_mem mem) {
+    for (buffer_events **e = &buffer_events_list; *e; e = &(*e)->next) {
+        if ((*e)->mem == mem) {
+            buffer_events *dead = *e;
+            *e = dead->next;
+            clear_buffer_events(dead);
+            free(dead);
+            return;
+        }
+    }
+}
+
+// Append the events a command accessing this buffer must wait for to
+// wait[]. There must be room for MAX_BUFFER_READERS + 1 more.
+WEAK void add_buffer_dependencies(buffer_events *e, bool writes, cl_event *wait, cl_uint *num_wait) {
+    if (!e) {
+        return;
+    }
+    if (e->writer) {
+        wait[(*num_wait)++] = e->writer;
+    }
+    // A reader normally doesn't need to wait for other readers, but
+    // when the list is full it waits for them all so that it can
+    // stand in for them.
+    if (writes || e->num_readers == MAX_BUFFER_READERS) {
+        for (int i = 0; i < e->num_readers; i++) {
+            wait[(*num_wait)++] = e->readers[i];
+        }
+    }
+}
+
+// Record that ev, which was enqueued with the dependencies from
+// add_buffer_dependencies, accesses this buffer.
+WEAK void record_buffer_access(buffer_events *e, bool writes, cl_event ev) {
+    if (!e) {
+        return;
+    }
+    clRetainEvent(ev);
+    if (writes) {
+        clear_buffer_events(e);
+        e->writer = ev;
+    } else {
+        if (e->num_readers == MAX_BUFFER_READERS) {
+            for (int i = 0; i < e->num_readers; i++) {
+                clReleaseEvent(e->readers[i]);
+            }
+            e->num_readers = 0;
+        }
+        e->readers[e->num_readers++] = ev;
+    }
+}
+
+// Orders a sequence of commands so that the first waits for a set of
+// dependencies and each later one for its predecessor, then lets the
+// host wait for the whole sequence.
+struct command_chain {
+    const cl_event *deps;
+    cl_uint num_deps;
+    cl_event last;
+
+    INLINE command_chain(const cl_event *deps, cl_uint num_deps) :
+        deps(deps), num_deps(num_deps), last(NULL) {}
+
+    INLINE ~command_chain() {
+        if (last) {
+            clReleaseEvent(last);
+        }
+    }
+
+    INLINE cl_uint num_wait() const {
+        return last ? 1 : num_deps;
+    }
+
+    INLINE const cl_event *wait_list() const {
+        return last ? &last : (num_deps ? deps : NULL);
+    }
+
+    INLINE void push(cl_event ev) {
+        if (last) {
+            clReleaseEvent(last);
+        }
+        last = ev;
+    }
+
+    INLINE cl_int wait() {
+        return last ? clWaitForEvents(1, &last) : CL_SUCCESS;
+    }
+};
+
+// Device allocations freed by halide_opencl_device_free, kept for
+// reuse. Only touched while the context lock is held.
+WEAK device_memory_pool memory_pool;
+
+WEAK void release_pooled_allocation(void *user_context, uint64_t handle) {
+    debug(user_context) << "    clReleaseMemObject " << (void *)handle << "\n";
+    forget_buffer_events((cl_mem)handle);
+    clReleaseMemObject((cl_mem)handle);
+}
+
+// Host allocations made by halide_opencl_device_and_host_malloc when
+// pinned host allocations are enabled: a mapped CL_MEM_ALLOC_HOST_PTR
+// buffer, which drivers back with page-locked memory and can DMA from
+// directly. Only touched while the context lock is held.
+struct pinned_host_allocation {
+    void *host;
+    cl_mem mem;
+    cl_command_queue cmd_queue;
+    pinned_host_allocation *next;
+};
+WEAK pinned_host_allocation *pinned_host_allocations = NULL;
+
+// Device allocations made when zero-copy host allocations are enabled
+// and the device shares memory with the host: a CL_MEM_USE_HOST_PTR
+// buffer over the host allocation itself, so there is nothing to copy
+// between them. The host may use the memory while the buffer is mapped
+// and the device while it isn't, so copies to the host map it, and
+// kernels and device-side copies unmap it first. Only touched while
+// the context lock is held.
+struct zero_copy_allocation {
+    cl_mem mem;
+    uint8_t *host;
+    size_t size;
+    bool mapped;
+    // Set for memory wrapped with halide_opencl_wrap_host_memory, where
+    // the buffer outlives the buffer_t so that it can be reused.
+    bool registered;
+    zero_copy_allocation *next;
+};
+WEAK zero_copy_allocation *zero_copy_allocations = NULL;
+
+// Page-aligned host allocations made by
+// halide_opencl_device_and_host_malloc for zero-copy buffers. Only
+// touched while the context lock is held.
+struct aligned_host_allocation {
+    uint8_t *host;
+    void *alloc;
+    aligned_host_allocation *next;
+};
+WEAK aligned_host_allocation *aligned_host_allocations = NULL;
+
+// Whether the device shares physical memory with the host: 1 or 0,
+// or -1 until it has been asked.
+WEAK int host_unified_memory = -1;
+
+// Drivers can only wrap host memory without copying it if it is
+// aligned to a page.
+#define ZERO_COPY_ALIGNMENT 4096
+
+WEAK bool use_zero_copy(void *user_context, cl_command_queue q) {
+    if (!use_zero_copy_host_allocations) {
+        return false;
+    }
+    if (host_unified_memory < 0) {
+        cl_device_id dev;
+        cl_bool unified = CL_FALSE;
+        if (clGetCommandQueueInfo(q, CL_QUEUE_DEVICE, sizeof(dev), &dev, NULL) != CL_SUCCESS ||
+            clGetDeviceInfo(dev, CL_DEVICE_HOST_UNIFIED_MEMORY, sizeof(unified), &unified, NULL) != CL_SUCCESS) {
+            unified = CL_FALSE;
+        }
+        debug(user_context) << "    device host unified memory: " << (int)unified << "\n";
+        host_unified_memory = unified ? 1 : 0;
+    }
+    return host_unified_memory == 1;
+}
+
+WEAK zero_copy_allocation *find_zero_copy_allocation(cl_mem mem) {
+    for (zero_copy_allocation *a = zero_copy_allocations; a; a = a->next) {
+        if (a->mem == mem) {
+            return a;
+        }
+    }
+    return NULL;
+}
+
+// Hand a zero-copy buffer to the host, once the commands using it
+// have finished. Mapping with CL_MAP_WRITE_INVALIDATE_REGION tells the
+// driver the host has already replaced the contents.
+WEAK cl_int map_zero_copy_allocation(void *user_context, cl_command_queue q, zero_copy_allocation *a,
+                                     cl_map_flags flags = CL_MAP_READ | CL_MAP_WRITE) {
+    if (a->mapped) {
+        return CL_SUCCESS;
+    }
+    buffer_events *events = find_buffer_events(a->mem);
+    cl_event deps[MAX_BUFFER_READERS + 1];
+    cl_uint num_deps = 0;
+    add_buffer_dependencies(events, true, deps, &num_deps);
+
+    debug(user_context) << "    clEnqueueMapBuffer " << (void *)a->mem << "\n";
+    cl_int err;
+    void *host = clEnqueueMapBuffer(q, a->mem, CL_TRUE, flags, 0, a->size,
+                                    num_deps, num_deps ? deps : NULL, NULL, &err);
+    if (err != CL_SUCCESS) {
+        error(user_context) << "CL: clEnqueueMapBuffer failed: "
+                            << get_opencl_error_name(err);
+        return err;
+    }
+    // The map is blocking, so everything it waited for is done.
+    if (events) {
+        clear_buffer_events(events);
+    }
+    a->mapped = true;
+    if (host != a->host) {
+        error(user_context) << "CL: clEnqueueMapBuffer moved a CL_MEM_USE_HOST_PTR buffer\n";
+        return CL_MAP_FAILURE;
+    }
+    return CL_SUCCESS;
+}
+
+// Hand a zero-copy buffer to the device. Later commands using it are
+// ordered after the unmap.
+WEAK cl_int unmap_zero_copy_allocation(void *user_context, cl_command_queue q, zero_copy_allocation *a) {
+    if (!a->mapped) {
+        return CL_SUCCESS;
+    }
+    debug(user_context) << "    clEnqueueUnmapMemObject " << (void *)a->mem << "\n";
+    cl_event ev;
+    cl_int err = clEnqueueUnmapMemObject(q, a->mem, a->host, 0, NULL, &ev);
+    if (err != CL_SUCCESS) {
+        error(user_context) << "CL: clEnqueueUnmapMemObject failed: "
+                            << get_opencl_error_name(err);
+        return err;
+    }
+    record_buffer_access(find_buffer_events(a->mem), true, ev);
+    clReleaseEvent(ev);
+    a->mapped = false;
+    return CL_SUCCESS;
+}
+
+WEAK cl_int unmap_zero_copy_allocation(void *user_context, cl_command_queue q, cl_mem mem) {
+    zero_copy_allocation *a = zero_copy_allocations ? find_zero_copy_allocation(mem) : NULL;
+    return a ? unmap_zero_copy_allocation(user_context, q, a) : CL_SUCCESS;
+}
+
+// Wrap host memory in a zero-copy buffer, mapped for the host. Returns
+// NULL if the driver won't use the memory in place.
+WEAK cl_mem create_zero_copy_allocation(void *user_context, cl_context context, cl_command_queue q,
+                                        uint8_t *host, size_t size) {
+    zero_copy_allocation *a = (zero_copy_allocation *)malloc(sizeof(zero_copy_allocation));
+    if (!a) {
+        return NULL;
+    }
+    cl_int err;
+    debug(user_context) << "    clCreateBuffer (CL_MEM_USE_HOST_PTR) -> " << (int)size << " ";
+    a->mem = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_USE_HOST_PTR, size, host, &err);
+    if (err != CL_SUCCESS || !a->mem) {
+        debug(user_context) << get_opencl_error_name(err) << "\n";
+        free(a);
+        return NULL;
+    }
+    debug(user_context) << (void *)a->mem << "\n";
+    a->host = host;
+    a->size = size;
+    a->mapped = false;
+    a->registered = false;
+    if (map_zero_copy_allocation(user_context, q, a) != CL_SUCCESS) {
+        if (a->mapped) {
+            clEnqueueUnmapMemObject(q, a->mem, a->host, 0, NULL, NULL);
+            clFinish(q);
+        }
+        forget_buffer_events(a->mem);
+        clReleaseMemObject(a->mem);
+        free(a);
+        return NULL;
+    }
+    a->next = zero_copy_allocations;
+    zero_copy_allocations = a;
+    return a->mem;
+}
+
+// Release a zero-copy buffer once the device is done with it. The host
+// memory is left alone.
+WEAK cl_int release_zero_copy_allocation(void *user_context, cl_command_queue q, zero_copy_allocation *dead) {
+    for (zero_copy_allocation **a = &zero_copy_allocations; *a; a = &(*a)->next) {
+        if (*a == dead) {
+            *a = dead->next;
+            break;
+        }
+    }
+    cl_int err = map_zero_copy_allocation(user_context, q, dead);
+    if (dead->mapped) {
+        debug(user_context) << "    clEnqueueUnmapMemObject " << (void *)dead->mem << "\n";
+        clEnqueueUnmapMemObject(q, dead->mem, dead->host, 0, NULL, NULL);
+        clFinish(q);
+    }
+    debug(user_context) << "    clReleaseMemObject " << (void *)dead->mem << "\n";
+    forget_buffer_events(dead->mem);
+    cl_int release_err = clReleaseMemObject(dead->mem);
+    free(dead);
+    return err != CL_SUCCESS ? err : release_err;
+}
+
+// The key for the on-disk kernel cache: the source, the build
+// options, and the device and driver the binary is built for.
+WEAK uint64_t kernel_cache_key(cl_device_id dev, const char *src, int size, const char *options) {
+    uint64_t h = kernel_cache_hash(kKernelCacheHashSeed, src, size);
+    h = kernel_cache_hash_string(h, options);
+    const cl_device_info infos[] = { CL_DEVICE_NAME, CL_DEVICE_VERSION, CL_DRIVER_VERSION };
+    for (size_t i = 0; i < sizeof(infos) / sizeof(infos[0]); i++) {
+        char value[256];
+        value[0] = 0;
+        clGetDeviceInfo(dev, infos[i], sizeof(value) - 1, value, NULL);
+        value[sizeof(value) - 1] = 0;
+        h = kernel_cache_hash_string(h, value);
+    }
+    return h;
+}
+
+// Create and build a program from a binary in the on-disk kernel
+// cache. Returns NULL, without raising an error, on a miss or if the
+// binary is rejected.
+WEAK cl_program load_cached_program(void *user_context, cl_context context, cl_device_id dev,
+                                    uint64_t key, const char *options) {
+    size_t binary_size = 0;
+    unsigned char *binary = (unsigned char *)kernel_cache_load(user_context, "opencl", key, &binary_size);
+    if (!binary) {
+        return NULL;
+    }
+
+    cl_int err, binary_status;
+    const unsigned char *binaries[] = { binary };
+    debug(user_context) << "    clCreateProgramWithBinary " << (uint64_t)binary_size << " bytes -> ";
+    cl_program program = clCreateProgramWithBinary(context, 1, &dev, &binary_size, binaries, &binary_status, &err);
+    free(binary);
+    if (err != CL_SUCCESS || binary_status != CL_SUCCESS) {
+        debug(user_context) << get_opencl_error_name(err != CL_SUCCESS ? err : binary_status) << "\n";
+        if (err == CL_SUCCESS) {
+            clReleaseProgram(program);
+        }
+        return NULL;
+    }
+    debug(user_context) << (void *)program << "\n";
+
+    // Programs created from binaries still have to be built.
+    err = clBuildProgram(program, 1, &dev, options, NULL, NULL);
+    if (err != CL_SUCCESS) {
+        debug(user_context) << "    clBuildProgram of cached binary failed: " << get_opencl_error_name(err) << "\n";
+        clReleaseProgram(program);
+        return NULL;
+    }
+    return program;
+}
+
+WEAK void store_program_binary(void *user_context, cl_program program, uint64_t key) {
+    size_t binary_size = 0;
+    if (clGetProgramInfo(program, CL_PROGRAM_BINARY_SIZES, sizeof(binary_size), &binary_size, NULL) != CL_SUCCESS ||
+        binary_size == 0) {
+        return;
+    }
+    unsigned char *binary = (unsigned char *)malloc(binary_size);
+    if (!binary) {
+        return;
+    }
+    unsigned char *binaries[] = { binary };
+    if (clGetProgramInfo(program, CL_PROGRAM_BINARIES, sizeof(binaries), binaries, NULL) == CL_SUCCESS) {
+        kernel_cache_store(user_context, "opencl", key, binary, binary_size);
+    }
+    free(binary);
+}
+
+// A clBuildProgram call, which may be run on a background thread so
+// that the pipeline can get on with its host work while the driver
+// compiles the kernels.
+struct program_build {
+    cl_program program;
+    cl_device_id dev;
+    char *options;
+    bool use_cache;
+    uint64_t cache_key;
+    halide_thread *thread;
+    cl_int err;
+    bool have_log;
+    char log[8192];
+};
+
+WEAK void run_program_build(void *arg) {
+    program_build *b = (program_build *)arg;
+    b->err = clBuildProgram(b->program, 1, &b->dev, b->options, NULL, NULL);
+    if (b->err != CL_SUCCESS) {
+        b->have_log = clGetProgramBuildInfo(b->program, b->dev,
+                                            CL_PROGRAM_BUILD_LOG,
+                                            sizeof(b->log), b->log,
+                                            NULL) == CL_SUCCESS;
+    }
+}
+
+// Wait for the build of the program of a module to finish, if it
+// hasn't already been waited for, and report any failure. A program
+// that failed to build is released, so that the next
+// halide_opencl_initialize_kernels tries again. Must be called with
+// the context lock held.
+WEAK int finish_program_build(void *user_context, module_state *state) {
+    program_build *b = state->build;
+    if (!b) {
+        return CL_SUCCESS;
+    }
+    state->build = NULL;
+
+    if (b->thread) {
+        #ifdef DEBUG_RUNTIME
+        uint64_t t_before = halide_current_time_ns(user_context);
+        #endif
+        halide_join_thread(b->thread);
+        #ifdef DEBUG_RUNTIME
+        uint64_t t_after = halide_current_time_ns(user_context);
+        debug(user_context) << "    Waited " << (t_after - t_before) / 1.0e6
+                            << " ms for background clBuildProgram " << (void *)b->program << "\n";
+        #endif
+    }
+
+    cl_int err = b->err;
+    if (err != CL_SUCCESS) {
+        if (b->have_log) {
+            error(user_context) << "CL: clBuildProgram failed: "
+                                << get_opencl_error_name(err)
+                                << "\nBuild Log:\n "
+                                << b->log;
+        } else {
+            error(user_context) << "clGetProgramBuildInfo failed";
+        }
+        clReleaseProgram(state->program);
+        state->program = NULL;
+    } else if (b->use_cache) {
+        store_program_binary(user_context, state->program, b->cache_key);
+    }
+
+    free(b->options);
+    free(b);
+    return err;
+}
+
 // Initializes the context used by the default implementation
 // of halide_acquire_context.
 WEAK int create_opencl_context(void *user_context, cl_context *ctx, cl_command_queue *q) {
@@ -440,8 +939,26 @@ WEAK int create_opencl_context(void *user_context, cl_context *ctx, cl_command_q
         debug(user_context) << *ctx << "\n";
     }
 
+    // Commands are ordered by the per-buffer events below rather than
+    // by the queue, so an out-of-order queue is safe to use when the
+    // device supports one.
+    cl_command_queue_properties queue_properties = 0;
+    if (out_of_order_queue < 0) {
+        const char *ooo = getenv("HL_OCL_OUT_OF_ORDER_QUEUE");
+        out_of_order_queue = (ooo && atoi(ooo)) ? 1 : 0;
+    }
+    if (out_of_order_queue) {
+        cl_command_queue_properties supported = 0;
+        err = clGetDeviceInfo(dev, CL_DEVICE_QUEUE_PROPERTIES, sizeof(supported), &supported, NULL);
+        if (err == CL_SUCCESS && (supported & CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE)) {
+            queue_properties |= CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE;
+        } else {
+            debug(user_context) << "    device does not support out-of-order queues\n";
+        }
+    }
+
     debug(user_context) << "    clCreateCommandQueue ";
-    *q = clCreateCommandQueue(*ctx, dev, 0, &err);
+    *q = clCreateCommandQueue(*ctx, dev, queue_properties, &err);
     if (err != CL_SUCCESS) {
         debug(user_context) << get_opencl_error_name(err);
         error(user_context) << "CL: clCreateCommandQueue failed: "
@@ -482,8 +999,29 @@ WEAK int halide_opencl_device_free(void *user_context, buffer_t* buf) {
     #endif
 
     halide_assert(user_context, validate_device_pointer(user_context, buf));
-    debug(user_context) << "    clReleaseMemObject " << (void *)dev_ptr << "\n";
-    cl_int result = clReleaseMemObject((cl_mem)dev_ptr);
+
+    // Keep the buffer for reuse rather than releasing it. The command
+    // queue it was last used on is recorded, so that reuse from a
+    // different queue can wait for it. Zero-copy buffers belong to
+    // their host memory, so they are released instead.
+    size_t real_size;
+    cl_int result;
+    zero_copy_allocation *zero_copy = zero_copy_allocations ? find_zero_copy_allocation(dev_ptr) : NULL;
+    if (zero_copy && zero_copy->registered) {
+        debug(user_context) << "    keeping registered host memory " << (void *)zero_copy->host << "\n";
+        result = CL_SUCCESS;
+    } else if (zero_copy) {
+        result = release_zero_copy_allocation(user_context, ctx.cmd_queue, zero_copy);
+    } else if (clGetMemObjectInfo(dev_ptr, CL_MEM_SIZE, sizeof(size_t), &real_size, NULL) == CL_SUCCESS &&
+        device_pool_put(user_context, &memory_pool, (uint64_t)dev_ptr, real_size,
+                        ctx.context, ctx.cmd_queue, release_pooled_allocation)) {
+        debug(user_context) << "    pooled " << (void *)dev_ptr << " (" << (uint64_t)real_size << " bytes)\n";
+        result = CL_SUCCESS;
+    } else {
+        debug(user_context) << "    clReleaseMemObject " << (void *)dev_ptr << "\n";
+        forget_buffer_events(dev_ptr);
+        result = clReleaseMemObject((cl_mem)dev_ptr);
+    }
     // If clReleaseMemObject fails, it is unlikely to succeed in a later call, so
     // we just end our reference to it regardless.
     halide_delete_device_wrapper(buf->dev);
@@ -527,6 +1065,7 @@ WEAK int halide_opencl_initialize_kernels(void *user_context, void **state_ptr,
     if (!(*state)) {
         *state = (module_state*)malloc(sizeof(module_state));
         (*state)->program = NULL;
+        (*state)->build = NULL;
         (*state)->next = state_list;
         state_list = *state;
     }
@@ -545,8 +1084,6 @@ WEAK int halide_opencl_initialize_kernels(void *user_context, void **state_ptr,
             return err;
         }
 
-        cl_device_id devices[] = { dev };
-
         // Get the max constant buffer size supported by this OpenCL implementation.
         cl_ulong max_constant_buffer_size = 0;
         err = clGetDeviceInfo(dev, CL_DEVICE_MAX_CONSTANT_BUFFER_SIZE, sizeof(max_constant_buffer_size), &max_constant_buffer_size, NULL);
@@ -569,6 +1106,23 @@ WEAK int halide_opencl_initialize_kernels(void *user_context, void **state_ptr,
         options << "-D MAX_CONSTANT_BUFFER_SIZE=" << max_constant_buffer_size
                 << " -D MAX_CONSTANT_ARGS=" << max_constant_args;
 
+        // With a kernel cache directory configured, reuse the program
+        // binary the driver built for this source on an earlier run.
+        uint64_t cache_key = 0;
+        bool use_cache = get_kernel_cache_dir() != NULL;
+        if (use_cache) {
+            cache_key = kernel_cache_key(dev, src, size, options.str());
+            cl_program program = load_cached_program(user_context, ctx.context, dev, cache_key, options.str());
+            if (program) {
+                (*state)->program = program;
+                #ifdef DEBUG_RUNTIME
+                uint64_t t_after = halide_current_time_ns(user_context);
+                debug(user_context) << "    Time: " << (t_after - t_before) / 1.0e6 << " ms\n";
+                #endif
+                return 0;
+            }
+        }
+
         const char * sources[] = { src };
         debug(user_context) << "    clCreateProgramWithSource -> ";
         cl_program program = clCreateProgramWithSource(ctx.context, 1, &sources[0], NULL, &err );
@@ -582,28 +1136,47 @@ WEAK int halide_opencl_initialize_kernels(void *user_context, void **state_ptr,
         }
         (*state)->program = program;
 
-        debug(user_context) << "    clBuildProgram " << (void *)program
-                            << " " << options.str() << "\n";
-        err = clBuildProgram(program, 1, devices, options.str(), NULL, NULL );
-        if (err != CL_SUCCESS) {
-
-            // Allocate an appropriately sized buffer for the build log.
-            char buffer[8192];
-
-            // Get build log
-            if (clGetProgramBuildInfo(program, dev,
-                                      CL_PROGRAM_BUILD_LOG,
-                                      sizeof(buffer), buffer,
-                                      NULL) == CL_SUCCESS) {
-                error(user_context) << "CL: clBuildProgram failed: "
-                                    << get_opencl_error_name(err)
-                                    << "\nBuild Log:\n "
-                                    << buffer;
-            } else {
-                error(user_context) << "clGetProgramBuildInfo failed";
+        size_t options_size = strlen(options.str()) + 1;
+        program_build *b = (program_build *)malloc(sizeof(program_build));
+        char *options_copy = (char *)malloc(options_size);
+        if (!b || !options_copy) {
+            free(b);
+            free(options_copy);
+            clReleaseProgram(program);
+            (*state)->program = NULL;
+            error(user_context) << "CL: Out of memory allocating program build\n";
+            return CL_OUT_OF_HOST_MEMORY;
+        }
+        b->options = options_copy;
+        memcpy(b->options, options.str(), options_size);
+        b->program = program;
+        b->dev = dev;
+        b->use_cache = use_cache;
+        b->cache_key = cache_key;
+        b->thread = NULL;
+        b->err = CL_SUCCESS;
+        b->have_log = false;
+        (*state)->build = b;
+
+        // Unless asked not to, compile on a background thread, and
+        // only wait for it when the first kernel of the program is
+        // run, or when the context is released.
+        if (background_build < 0) {
+            const char *bg = getenv("HL_OCL_BACKGROUND_BUILD");
+            background_build = (bg && !atoi(bg)) ? 0 : 1;
+        }
+        if (background_build) {
+            debug(user_context) << "    clBuildProgram " << (void *)program
+                                << " " << options.str() << " (in the background)\n";
+            b->thread = halide_spawn_thread(run_program_build, b);
+        } else {
+            debug(user_context) << "    clBuildProgram " << (void *)program
+                                << " " << options.str() << "\n";
+            run_program_build(b);
+            err = finish_program_build(user_context, *state);
+            if (err != CL_SUCCESS) {
+                return err;
             }
-
-            return err;
         }
     }
 
@@ -659,6 +1232,24 @@ WEAK int halide_opencl_device_release(void *user_context) {
         err = clFinish(q);
         halide_assert(user_context, err == CL_SUCCESS);
 
+        // Release the host memory wrapped with
+        // halide_opencl_wrap_host_memory. Any other zero-copy buffers
+        // still belong to live buffer_ts.
+        for (zero_copy_allocation *a = zero_copy_allocations, *next; a; a = next) {
+            next = a->next;
+            if (a->registered) {
+                release_zero_copy_allocation(user_context, q, a);
+            }
+        }
+
+        // Everything has completed, so drop the dependency tracking.
+        while (buffer_events_list) {
+            forget_buffer_events(buffer_events_list->mem);
+        }
+
+        // Release the cached buffers belonging to this context.
+        device_pool_trim(user_context, &memory_pool, 0, ctx, release_pooled_allocation);
+
         // Unload the modules attached to this context. Note that the list
         // nodes themselves are not freed, only the program objects are
         // released. Subsequent calls to halide_init_kernels might re-create
@@ -666,6 +1257,7 @@ WEAK int halide_opencl_device_release(void *user_context) {
         // object.
         module_state *state = state_list;
         while (state) {
+            finish_program_build(user_context, state);
             if (state->program) {
                 debug(user_context) << "    clReleaseProgram " << state->program << "\n";
                 err = clReleaseProgram(state->program);
@@ -675,6 +1267,9 @@ WEAK int halide_opencl_device_release(void *user_context) {
             state = state->next;
         }
 
+        // The next context may be on another device.
+        host_unified_memory = -1;
+
         // Release the context itself, if we created it.
         if (ctx == context) {
             debug(user_context) << "    clReleaseCommandQueue " << command_queue << "\n";
@@ -694,6 +1289,19 @@ WEAK int halide_opencl_device_release(void *user_context) {
     return 0;
 }
 
+WEAK int halide_opencl_release_unused_device_allocations(void *user_context) {
+    debug(user_context)
+        << "CL: halide_opencl_release_unused_device_allocations (user_context: " << user_context << ")\n";
+
+    ClContext ctx(user_context);
+    if (ctx.error != CL_SUCCESS) {
+        return ctx.error;
+    }
+
+    device_pool_trim(user_context, &memory_pool, 0, ctx.context, release_pooled_allocation);
+    return 0;
+}
+
 WEAK int halide_opencl_device_malloc(void *user_context, buffer_t* buf) {
     debug(user_context)
         << "CL: halide_opencl_device_malloc (user_context: " << user_context
@@ -714,6 +1322,24 @@ WEAK int halide_opencl_device_malloc(void *user_context, buffer_t* buf) {
     halide_assert(user_context, buf->stride[0] >= 0 && buf->stride[1] >= 0 &&
                                 buf->stride[2] >= 0 && buf->stride[3] >= 0);
 
+    // Use suitably aligned host memory in place if the device shares
+    // memory with the host.
+    if (buf->host && ((uintptr_t)buf->host % ZERO_COPY_ALIGNMENT) == 0 &&
+        use_zero_copy(user_context, ctx.cmd_queue)) {
+        cl_mem mem = create_zero_copy_allocation(user_context, ctx.context, ctx.cmd_queue,
+                                                 buf->host, size);
+        if (mem) {
+            buf->dev = halide_new_device_wrapper((uint64_t)mem, &opencl_device_interface);
+            if (buf->dev == 0) {
+                error(user_context) << "CL: out of memory allocating device wrapper.\n";
+                release_zero_copy_allocation(user_context, ctx.cmd_queue, find_zero_copy_allocation(mem));
+                return -1;
+            }
+            debug(user_context) << "    Wrapped host memory of buffer " << buf << " in place\n";
+            return CL_SUCCESS;
+        }
+    }
+
     debug(user_context)
         << "    Allocating buffer of " << (int)size << " bytes,"
         << " extents: " << buf->extent[0] << "x" << buf->extent[1] << "x" << buf->extent[2] << "x" << buf->extent[3]
@@ -725,15 +1351,47 @@ WEAK int halide_opencl_device_malloc(void *user_context, buffer_t* buf) {
     #endif
 
     cl_int err;
-    debug(user_context) << "    clCreateBuffer -> " << (int)size << " ";
-    cl_mem dev_ptr = clCreateBuffer(ctx.context, CL_MEM_READ_WRITE, size, NULL, &err);
-    if (err != CL_SUCCESS || dev_ptr == 0) {
-        debug(user_context) << get_opencl_error_name(err) << "\n";
-        error(user_context) << "CL: clCreateBuffer failed: "
-                            << get_opencl_error_name(err);
-        return err;
+    cl_mem dev_ptr;
+    device_pool_block *block = device_pool_take(&memory_pool, size, ctx.context, ctx.cmd_queue);
+    if (block) {
+        dev_ptr = (cl_mem)block->handle;
+        debug(user_context) << "    reusing pooled " << (void *)dev_ptr
+                            << " (" << (uint64_t)block->size << " bytes)\n";
+        // The previous owner may still have work in flight on another
+        // command queue.
+        if ((cl_command_queue)block->queue != ctx.cmd_queue) {
+            err = clFinish((cl_command_queue)block->queue);
+            if (err != CL_SUCCESS) {
+                free(block);
+                clReleaseMemObject(dev_ptr);
+                error(user_context) << "CL: clFinish failed: "
+                                    << get_opencl_error_name(err);
+                return err;
+            }
+        }
+        free(block);
     } else {
-        debug(user_context) << (void *)dev_ptr << "\n";
+        // Round up to the pool's size class, so that the buffer can
+        // serve any later request in the same class.
+        size_t alloc_size = device_pool_round_up(size);
+        debug(user_context) << "    clCreateBuffer -> " << (int)alloc_size << " ";
+        dev_ptr = clCreateBuffer(ctx.context, CL_MEM_READ_WRITE, alloc_size, NULL, &err);
+        if ((err == CL_MEM_OBJECT_ALLOCATION_FAILURE || err == CL_OUT_OF_RESOURCES) &&
+            memory_pool.cached_bytes) {
+            // Give the cached buffers back to the driver and try again.
+            debug(user_context) << get_opencl_error_name(err) << ", releasing pool\n";
+            device_pool_trim(user_context, &memory_pool, 0, ctx.context, release_pooled_allocation);
+            debug(user_context) << "    clCreateBuffer -> " << (int)alloc_size << " ";
+            dev_ptr = clCreateBuffer(ctx.context, CL_MEM_READ_WRITE, alloc_size, NULL, &err);
+        }
+        if (err != CL_SUCCESS || dev_ptr == 0) {
+            debug(user_context) << get_opencl_error_name(err) << "\n";
+            error(user_context) << "CL: clCreateBuffer failed: "
+                                << get_opencl_error_name(err);
+            return err;
+        } else {
+            debug(user_context) << (void *)dev_ptr << "\n";
+        }
     }
     buf->dev = halide_new_device_wrapper((uint64_t)dev_ptr, &opencl_device_interface);
     if (buf->dev == 0) {
@@ -754,15 +1412,15 @@ WEAK int halide_opencl_device_malloc(void *user_context, buffer_t* buf) {
     return CL_SUCCESS;
 }
 
-WEAK int halide_opencl_copy_to_device(void *user_context, buffer_t* buf) {
+WEAK int halide_opencl_copy_to_device_region(void *user_context, buffer_t* buf, uint64_t begin, uint64_t end) {
     int err = halide_opencl_device_malloc(user_context, buf);
     if (err) {
         return err;
     }
 
     debug(user_context)
-        << "CL: halide_opencl_copy_to_device (user_context: " << user_context
-        << ", buf: " << buf << ")\n";
+        << "CL: halide_opencl_copy_to_device_region (user_context: " << user_context
+        << ", buf: " << buf << ", bytes: [" << begin << ", " << end << "))\n";
 
     // Acquire the context so we can use the command queue. This also avoids multiple
     // redundant calls to clEnqueueWriteBuffer when multiple threads are trying to copy
@@ -780,6 +1438,28 @@ WEAK int halide_opencl_copy_to_device(void *user_context, buffer_t* buf) {
     halide_assert(user_context, validate_device_pointer(user_context, buf));
 
     device_copy c = make_host_to_device_copy(buf);
+    crop_device_copy(&c, begin, end);
+
+    // A zero-copy buffer already holds the host's data. It only needs
+    // to be mapped, so that host writes are seen, until a kernel
+    // unmaps it. Data from other host memory is copied into it.
+    zero_copy_allocation *zero_copy = zero_copy_allocations ? find_zero_copy_allocation((cl_mem)c.dst) : NULL;
+    if (zero_copy) {
+        cl_int err = map_zero_copy_allocation(user_context, ctx.cmd_queue, zero_copy);
+        if (err == CL_SUCCESS && buf->host != zero_copy->host) {
+            c.dst = (uint64_t)zero_copy->host;
+            c.copy_memory(user_context);
+        }
+        return err;
+    }
+
+    // The copy overwrites the buffer, so it waits for everything still
+    // reading or writing it, and the writes are chained after that.
+    buffer_events *events = find_buffer_events((cl_mem)c.dst);
+    cl_event deps[MAX_BUFFER_READERS + 1];
+    cl_uint num_deps = 0;
+    add_buffer_dependencies(events, true, deps, &num_deps);
+    command_chain chain(deps, num_deps);
 
     // TODO: Is this 32-bit or 64-bit? Leaving signed for now
     // in case negative strides.
@@ -788,7 +1468,7 @@ WEAK int halide_opencl_copy_to_device(void *user_context, buffer_t* buf) {
 #ifdef ENABLE_OPENCL_11
             // OpenCL 1.1 supports stride-aware memory transfers up to 3D, so we
             // can deal with the 2 innermost strides with OpenCL.
-            uint64_t off = z * c.stride_bytes[2] + w * c.stride_bytes[3];
+            uint64_t off = c.offset + z * c.stride_bytes[2] + w * c.stride_bytes[3];
 
             size_t offset[3] = { off, 0, 0 };
             size_t region[3] = { c.chunk_size, c.extent[0], c.extent[1] };
@@ -799,22 +1479,25 @@ WEAK int halide_opencl_copy_to_device(void *user_context, buffer_t* buf) {
                 << (int)region[0] << "x" << (int)region[1] << "x" << (int)region[2] << " bytes, "
                 << c.stride_bytes[0] << "x" << c.stride_bytes[1] << ")\n";
 
+            cl_event ev;
             cl_int err = clEnqueueWriteBufferRect(ctx.cmd_queue, (cl_mem)c.dst, CL_FALSE,
                                                   offset, offset, region,
                                                   c.stride_bytes[0], c.stride_bytes[1],
                                                   c.stride_bytes[0], c.stride_bytes[1],
                                                   (void *)c.src,
-                                                  0, NULL, NULL);
+                                                  chain.num_wait(), chain.wait_list(), &ev);
 
             if (err != CL_SUCCESS) {
                 error(user_context) << "CL: clEnqueueWriteBufferRect failed: "
                                     << get_opencl_error_name(err);
                 return err;
             }
+            chain.push(ev);
 #else
             for (int y = 0; y < (int)c.extent[1]; y++) {
                 for (int x = 0; x < (int)c.extent[0]; x++) {
-                    uint64_t off = (x * c.stride_bytes[0] +
+                    uint64_t off = (c.offset +
+                                    x * c.stride_bytes[0] +
                                     y * c.stride_bytes[1] +
                                     z * c.stride_bytes[2] +
                                     w * c.stride_bytes[3]);
@@ -826,22 +1509,35 @@ WEAK int halide_opencl_copy_to_device(void *user_context, buffer_t* buf) {
                         << "    clEnqueueWriteBuffer  ((" << x << ", " << y << ", " << z << ", " << w << "), "
                         << size << " bytes, " << src << " -> " << (void *)dst << ")\n";
 
+                    cl_event ev;
                     cl_int err = clEnqueueWriteBuffer(ctx.cmd_queue, (cl_mem)c.dst,
-                                                      CL_FALSE, off, size, src, 0, NULL, NULL);
+                                                      CL_FALSE, off, size, src,
+                                                      chain.num_wait(), chain.wait_list(), &ev);
                     if (err != CL_SUCCESS) {
                         error(user_context) << "CL: clEnqueueWriteBuffer failed: "
                                             << get_opencl_error_name(err);
                         return err;
                     }
+                    chain.push(ev);
                 }
             }
 #endif
         }
     }
-    // The writes above are all non-blocking, so empty the command
-    // queue before we proceed so that other host code won't write
-    // to the buffer while the above writes are still running.
-    clFinish(ctx.cmd_queue);
+    // The writes above are all non-blocking, so wait for them before
+    // we proceed so that other host code won't write to the buffer
+    // while they are still running. Only the writes (and what they
+    // depended on) need to finish; independent work on the queue keeps
+    // running. Once they have, nothing is pending on the buffer.
+    cl_int wait_err = chain.wait();
+    if (wait_err != CL_SUCCESS) {
+        error(user_context) << "CL: clWaitForEvents failed: "
+                            << get_opencl_error_name(wait_err);
+        return wait_err;
+    }
+    if (events) {
+        clear_buffer_events(events);
+    }
 
     #ifdef DEBUG_RUNTIME
     uint64_t t_after = halide_current_time_ns(user_context);
@@ -851,6 +1547,10 @@ WEAK int halide_opencl_copy_to_device(void *user_context, buffer_t* buf) {
     return 0;
 }
 
+WEAK int halide_opencl_copy_to_device(void *user_context, buffer_t* buf) {
+    return halide_opencl_copy_to_device_region(user_context, buf, 0, buf_size(buf));
+}
+
 WEAK int halide_opencl_copy_to_host(void *user_context, buffer_t* buf) {
     debug(user_context)
         << "CL: halide_copy_to_host (user_context: " << user_context
@@ -873,6 +1573,27 @@ WEAK int halide_opencl_copy_to_host(void *user_context, buffer_t* buf) {
 
     device_copy c = make_device_to_host_copy(buf);
 
+    // The host can read a zero-copy buffer once it's mapped.
+    zero_copy_allocation *zero_copy = zero_copy_allocations ? find_zero_copy_allocation((cl_mem)c.src) : NULL;
+    if (zero_copy) {
+        cl_int err = map_zero_copy_allocation(user_context, ctx.cmd_queue, zero_copy);
+        if (err == CL_SUCCESS && buf->host != zero_copy->host) {
+            c.src = (uint64_t)zero_copy->host;
+            c.copy_memory(user_context);
+        }
+        return err;
+    }
+
+    // The copy only reads the buffer, so it just waits for the last
+    // command that wrote it.
+    buffer_events *events = find_buffer_events((cl_mem)c.src);
+    cl_event deps[1];
+    cl_uint num_deps = 0;
+    if (events && events->writer) {
+        deps[num_deps++] = events->writer;
+    }
+    command_chain chain(deps, num_deps);
+
     // TODO: Is this 32-bit or 64-bit? Leaving signed for now
     // in case negative strides.
     for (int w = 0; w < (int)c.extent[3]; w++) {
@@ -891,18 +1612,20 @@ WEAK int halide_opencl_copy_to_host(void *user_context, buffer_t* buf) {
                 << (int)region[0] << "x" << (int)region[1] << "x" << (int)region[2] << " bytes, "
                 << c.stride_bytes[0] << "x" << c.stride_bytes[1] << ")\n";
 
+            cl_event ev;
             cl_int err = clEnqueueReadBufferRect(ctx.cmd_queue, (cl_mem)c.src, CL_FALSE,
                                                  offset, offset, region,
                                                  c.stride_bytes[0], c.stride_bytes[1],
                                                  c.stride_bytes[0], c.stride_bytes[1],
                                                  (void *)c.dst,
-                                                 0, NULL, NULL);
+                                                 chain.num_wait(), chain.wait_list(), &ev);
 
             if (err != CL_SUCCESS) {
                 error(user_context) << "CL: clEnqueueReadBufferRect failed: "
                                     << get_opencl_error_name(err);
                 return err;
             }
+            chain.push(ev);
 #else
             for (int y = 0; y < (int)c.extent[1]; y++) {
                 for (int x = 0; x < (int)c.extent[0]; x++) {
@@ -918,22 +1641,122 @@ WEAK int halide_opencl_copy_to_host(void *user_context, buffer_t* buf) {
                         << "    clEnqueueReadBuffer  ((" << x << ", " << y << ", " << z << ", " << w << "), "
                         << size << " bytes, " << src << " -> " << dst << ")\n";
 
+                    cl_event ev;
                     cl_int err = clEnqueueReadBuffer(ctx.cmd_queue, (cl_mem)c.src,
-                                                     CL_FALSE, off, size, dst, 0, NULL, NULL);
+                                                     CL_FALSE, off, size, dst,
+                                                     chain.num_wait(), chain.wait_list(), &ev);
                     if (err != CL_SUCCESS) {
                         error(user_context) << "CL: clEnqueueReadBuffer failed: "
                                             << get_opencl_error_name(err);
                         return err;
                     }
+                    chain.push(ev);
                 }
             }
 #endif
         }
     }
-    // The writes above are all non-blocking, so empty the command
-    // queue before we proceed so that other host code won't read
-    // bad data.
-    clFinish(ctx.cmd_queue);
+    // The reads above are all non-blocking, so wait for them before
+    // we proceed so that other host code won't read bad data. This is
+    // a true host-read point, but only the reads and the commands
+    // producing the buffer need to have finished.
+    cl_int wait_err = chain.wait();
+    if (wait_err != CL_SUCCESS) {
+        error(user_context) << "CL: clWaitForEvents failed: "
+                            << get_opencl_error_name(wait_err);
+        return wait_err;
+    }
+
+    #ifdef DEBUG_RUNTIME
+    uint64_t t_after = halide_current_time_ns(user_context);
+    debug(user_context) << "    Time: " << (t_after - t_before) / 1.0e6 << " ms\n";
+    #endif
+
+    return 0;
+}
+
+WEAK int halide_opencl_buffer_copy(void *user_context, buffer_t *src, buffer_t *dst) {
+    debug(user_context)
+        << "CL: halide_opencl_buffer_copy (user_context: " << user_context
+        << ", src: " << src << ", dst: " << dst << ")\n";
+
+    ClContext ctx(user_context);
+    if (ctx.error != CL_SUCCESS) {
+        return ctx.error;
+    }
+
+    #ifdef DEBUG_RUNTIME
+    uint64_t t_before = halide_current_time_ns(user_context);
+    #endif
+
+    halide_assert(user_context, src->dev && dst->dev);
+    halide_assert(user_context, validate_device_pointer(user_context, src));
+    halide_assert(user_context, validate_device_pointer(user_context, dst));
+
+    device_copy c = make_buffer_to_buffer_copy(src, halide_get_device_handle(src->dev),
+                                               dst, halide_get_device_handle(dst->dev));
+
+    cl_int unmap_err = unmap_zero_copy_allocation(user_context, ctx.cmd_queue, (cl_mem)c.src);
+    if (unmap_err == CL_SUCCESS) {
+        unmap_err = unmap_zero_copy_allocation(user_context, ctx.cmd_queue, (cl_mem)c.dst);
+    }
+    if (unmap_err != CL_SUCCESS) {
+        return unmap_err;
+    }
+
+    // The copy reads src after its last writer, and writes dst after
+    // everything still using it. It is recorded as the new writer of
+    // dst, so later commands are ordered after it and nothing needs
+    // to wait for it here.
+    buffer_events *src_events = find_buffer_events((cl_mem)c.src);
+    buffer_events *dst_events = find_buffer_events((cl_mem)c.dst);
+    cl_event deps[MAX_BUFFER_READERS + 2];
+    cl_uint num_deps = 0;
+    if (src_events != dst_events) {
+        if (src_events && src_events->writer) {
+            deps[num_deps++] = src_events->writer;
+        }
+    }
+    add_buffer_dependencies(dst_events, true, deps, &num_deps);
+    command_chain chain(deps, num_deps);
+
+    for (int w = 0; w < (int)c.extent[3]; w++) {
+        for (int z = 0; z < (int)c.extent[2]; z++) {
+            for (int y = 0; y < (int)c.extent[1]; y++) {
+                for (int x = 0; x < (int)c.extent[0]; x++) {
+                    uint64_t off = (c.offset +
+                                    x * c.stride_bytes[0] +
+                                    y * c.stride_bytes[1] +
+                                    z * c.stride_bytes[2] +
+                                    w * c.stride_bytes[3]);
+                    uint64_t size = c.chunk_size;
+
+                    debug(user_context)
+                        << "    clEnqueueCopyBuffer  ((" << x << ", " << y << ", " << z << ", " << w << "), "
+                        << size << " bytes, " << (void *)c.src << " + " << (c.src_offset + off)
+                        << " -> " << (void *)c.dst << " + " << off << ")\n";
+
+                    cl_event ev;
+                    cl_int err = clEnqueueCopyBuffer(ctx.cmd_queue, (cl_mem)c.src, (cl_mem)c.dst,
+                                                     c.src_offset + off, off, size,
+                                                     chain.num_wait(), chain.wait_list(), &ev);
+                    if (err != CL_SUCCESS) {
+                        error(user_context) << "CL: clEnqueueCopyBuffer failed: "
+                                            << get_opencl_error_name(err);
+                        return err;
+                    }
+                    chain.push(ev);
+                }
+            }
+        }
+    }
+
+    if (chain.last) {
+        if (src_events != dst_events) {
+            record_buffer_access(src_events, false, chain.last);
+        }
+        record_buffer_access(dst_events, true, chain.last);
+    }
 
     #ifdef DEBUG_RUNTIME
     uint64_t t_after = halide_current_time_ns(user_context);
@@ -976,6 +1799,10 @@ WEAK int halide_opencl_run(void *user_context,
 
     // Create kernel object for entry_name from the program for this module.
     halide_assert(user_context, state_ptr);
+    err = finish_program_build(user_context, (module_state*)state_ptr);
+    if (err != CL_SUCCESS) {
+        return err;
+    }
     cl_program program = ((module_state*)state_ptr)->program;
 
     halide_assert(user_context, program);
@@ -1038,18 +1865,66 @@ WEAK int halide_opencl_run(void *user_context,
         return err;
     }
 
+    // Gather the commands the kernel depends on. Buffers the kernel
+    // only reads are marked 2 in arg_is_buffer (see
+    // CodeGen_GPU_Host); those wait only for their last writer.
+    // Zero-copy buffers are handed to the device first.
+    int num_buffers = 0;
+    for (int j = 0; j < i; j++) {
+        if (arg_is_buffer[j]) {
+            num_buffers++;
+            cl_mem mem = (cl_mem)halide_get_device_handle(*(uint64_t *)args[j]);
+            err = unmap_zero_copy_allocation(user_context, ctx.cmd_queue, mem);
+            if (err != CL_SUCCESS) {
+                clReleaseKernel(f);
+                return err;
+            }
+        }
+    }
+    buffer_events **arg_events = (buffer_events **)malloc((num_buffers + 1) * sizeof(buffer_events *));
+    cl_event *deps = (cl_event *)malloc((num_buffers * (MAX_BUFFER_READERS + 1) + 1) * sizeof(cl_event));
+    if (!arg_events || !deps) {
+        free(arg_events);
+        free(deps);
+        clReleaseKernel(f);
+        error(user_context) << "CL: out of memory tracking kernel dependencies\n";
+        return CL_OUT_OF_HOST_MEMORY;
+    }
+    cl_uint num_deps = 0;
+    for (int j = 0, b = 0; j < i; j++) {
+        if (arg_is_buffer[j]) {
+            cl_mem mem = (cl_mem)halide_get_device_handle(*(uint64_t *)args[j]);
+            arg_events[b] = find_buffer_events(mem);
+            add_buffer_dependencies(arg_events[b], arg_is_buffer[j] != 2, deps, &num_deps);
+            b++;
+        }
+    }
+
     // Launch kernel
     debug(user_context)
         << "    clEnqueueNDRangeKernel "
         << blocksX << "x" << blocksY << "x" << blocksZ << ", "
-        << threadsX << "x" << threadsY << "x" << threadsZ << " -> ";
+        << threadsX << "x" << threadsY << "x" << threadsZ << ", "
+        << (int)num_deps << " dependencies -> ";
+    cl_event ev;
     err = clEnqueueNDRangeKernel(ctx.cmd_queue, f,
                                  // NDRange
                                  3, NULL, global_dim, local_dim,
                                  // Events
-                                 0, NULL, NULL);
+                                 num_deps, num_deps ? deps : NULL, &ev);
     debug(user_context) << get_opencl_error_name(err) << "\n";
+    if (err == CL_SUCCESS) {
+        for (int j = 0, b = 0; j < i; j++) {
+            if (arg_is_buffer[j]) {
+                record_buffer_access(arg_events[b++], arg_is_buffer[j] != 2, ev);
+            }
+        }
+        clReleaseEvent(ev);
+    }
+    free(arg_events);
+    free(deps);
     if (err != CL_SUCCESS) {
+        clReleaseKernel(f);
         error(user_context) << "CL: clEnqueueNDRangeKernel failed: "
                             << get_opencl_error_name(err) << "\n";
         return err;
@@ -1071,12 +1946,150 @@ WEAK int halide_opencl_run(void *user_context,
     return 0;
 }
 
-WEAK int halide_opencl_device_and_host_malloc(void *user_context, struct buffer_t *buf) {
-    return halide_default_device_and_host_malloc(user_context, buf, &opencl_device_interface);
+WEAK int halide_opencl_device_and_host_free(void *user_context, struct buffer_t *buf) {
+    int result = halide_device_free(user_context, buf);
+
+    bool aligned = false;
+    if (buf->host && aligned_host_allocations) {
+        ClContext ctx(user_context);
+        for (aligned_host_allocation **a = &aligned_host_allocations; *a; a = &(*a)->next) {
+            aligned_host_allocation *alloc = *a;
+            if (alloc->host == buf->host) {
+                free(alloc->alloc);
+                *a = alloc->next;
+                free(alloc);
+                aligned = true;
+                break;
+            }
+        }
+    }
+    if (aligned) {
+        buf->host = NULL;
+        buf->host_dirty = false;
+        buf->dev_dirty = false;
+        return result;
+    }
+
+    bool pinned = false;
+    if (buf->host && pinned_host_allocations) {
+        ClContext ctx(user_context);
+        for (pinned_host_allocation **a = &pinned_host_allocations; *a; a = &(*a)->next) {
+            pinned_host_allocation *alloc = *a;
+            if (alloc->host == buf->host) {
+                debug(user_context) << "    clEnqueueUnmapMemObject " << (void *)alloc->mem << "\n";
+                clEnqueueUnmapMemObject(alloc->cmd_queue, alloc->mem, alloc->host, 0, NULL, NULL);
+                clFinish(alloc->cmd_queue);
+                debug(user_context) << "    clReleaseMemObject " << (void *)alloc->mem << "\n";
+                clReleaseMemObject(alloc->mem);
+                *a = alloc->next;
+                free(alloc);
+                pinned = true;
+                break;
+            }
+        }
+    }
+    if (!pinned) {
+        halide_free(user_context, buf->host);
+    }
+    buf->host = NULL;
+    buf->host_dirty = false;
+    buf->dev_dirty = false;
+    return result;
 }
 
-WEAK int halide_opencl_device_and_host_free(void *user_context, struct buffer_t *buf) {
-    return halide_default_device_and_host_free(user_context, buf, &opencl_device_interface);
+WEAK int halide_opencl_device_and_host_malloc(void *user_context, struct buffer_t *buf) {
+    if (use_zero_copy_host_allocations) {
+        // Allocate page-aligned host memory and let the device use it
+        // in place, if the device shares memory with the host.
+        ClContext ctx(user_context);
+        if (ctx.error != CL_SUCCESS) {
+            return ctx.error;
+        }
+        if (use_zero_copy(user_context, ctx.cmd_queue)) {
+            debug(user_context)
+                << "CL: halide_opencl_device_and_host_malloc (user_context: " << user_context
+                << ", buf: " << buf << ") zero-copy\n";
+            size_t size = buf_size(buf);
+            aligned_host_allocation *alloc = (aligned_host_allocation *)malloc(sizeof(aligned_host_allocation));
+            void *host_alloc = alloc ? malloc(size + ZERO_COPY_ALIGNMENT) : NULL;
+            uint8_t *host = (uint8_t *)(((uintptr_t)host_alloc + ZERO_COPY_ALIGNMENT - 1) &
+                                        ~(uintptr_t)(ZERO_COPY_ALIGNMENT - 1));
+            cl_mem mem = host_alloc ? create_zero_copy_allocation(user_context, ctx.context, ctx.cmd_queue,
+                                                                  host, size) : NULL;
+            if (mem) {
+                buf->dev = halide_new_device_wrapper((uint64_t)mem, &opencl_device_interface);
+                if (buf->dev) {
+                    alloc->host = host;
+                    alloc->alloc = host_alloc;
+                    alloc->next = aligned_host_allocations;
+                    aligned_host_allocations = alloc;
+                    buf->host = host;
+                    return CL_SUCCESS;
+                }
+                release_zero_copy_allocation(user_context, ctx.cmd_queue, find_zero_copy_allocation(mem));
+            }
+            free(host_alloc);
+            free(alloc);
+        }
+    }
+
+    if (!use_pinned_host_allocations) {
+        return halide_default_device_and_host_malloc(user_context, buf, &opencl_device_interface);
+    }
+
+    debug(user_context)
+        << "CL: halide_opencl_device_and_host_malloc (user_context: " << user_context
+        << ", buf: " << buf << ")\n";
+
+    size_t size = buf_size(buf);
+    void *host = NULL;
+    {
+        // The context must be released before halide_device_malloc
+        // acquires it again.
+        ClContext ctx(user_context);
+        if (ctx.error != CL_SUCCESS) {
+            return ctx.error;
+        }
+
+        pinned_host_allocation *alloc = (pinned_host_allocation *)malloc(sizeof(pinned_host_allocation));
+        if (alloc) {
+            cl_int err;
+            debug(user_context) << "    clCreateBuffer (CL_MEM_ALLOC_HOST_PTR) -> " << (int)size << " ";
+            alloc->mem = clCreateBuffer(ctx.context, CL_MEM_READ_WRITE | CL_MEM_ALLOC_HOST_PTR, size, NULL, &err);
+            if (err == CL_SUCCESS && alloc->mem) {
+                debug(user_context) << (void *)alloc->mem << "\n";
+                host = clEnqueueMapBuffer(ctx.cmd_queue, alloc->mem, CL_TRUE, CL_MAP_READ | CL_MAP_WRITE,
+                                          0, size, 0, NULL, NULL, &err);
+                if (err != CL_SUCCESS) {
+                    debug(user_context) << "    clEnqueueMapBuffer failed: " << get_opencl_error_name(err) << "\n";
+                    clReleaseMemObject(alloc->mem);
+                    host = NULL;
+                }
+            } else {
+                debug(user_context) << get_opencl_error_name(err) << "\n";
+            }
+            if (host) {
+                alloc->host = host;
+                alloc->cmd_queue = ctx.cmd_queue;
+                alloc->next = pinned_host_allocations;
+                pinned_host_allocations = alloc;
+            } else {
+                free(alloc);
+            }
+        }
+    }
+    if (!host) {
+        // Page-locked memory is a limited resource; fall back to
+        // pageable memory rather than failing.
+        return halide_default_device_and_host_malloc(user_context, buf, &opencl_device_interface);
+    }
+
+    buf->host = (uint8_t *)host;
+    int result = halide_device_malloc(user_context, buf, &opencl_device_interface);
+    if (result != 0) {
+        halide_opencl_device_and_host_free(user_context, buf);
+    }
+    return result;
 }
 
 WEAK int halide_opencl_wrap_cl_mem(void *user_context, struct buffer_t *buf, uintptr_t mem) {
@@ -1104,6 +2117,24 @@ WEAK uintptr_t halide_opencl_detach_cl_mem(void *user_context, struct buffer_t *
     }
     halide_assert(user_context, halide_get_device_interface(buf->dev) == &opencl_device_interface);
     uint64_t mem = halide_get_device_handle(buf->dev);
+    if (buffer_events_list || zero_copy_allocations) {
+        ClContext ctx(user_context);
+        // The caller takes over a zero-copy buffer unmapped, as the
+        // device's.
+        zero_copy_allocation *zero_copy = zero_copy_allocations ? find_zero_copy_allocation((cl_mem)mem) : NULL;
+        if (zero_copy) {
+            unmap_zero_copy_allocation(user_context, ctx.cmd_queue, zero_copy);
+            clFinish(ctx.cmd_queue);
+            for (zero_copy_allocation **a = &zero_copy_allocations; *a; a = &(*a)->next) {
+                if (*a == zero_copy) {
+                    *a = zero_copy->next;
+                    break;
+                }
+            }
+            free(zero_copy);
+        }
+        forget_buffer_events((cl_mem)mem);
+    }
     halide_delete_device_wrapper(buf->dev);
     buf->dev = 0;
     return (uintptr_t)mem;
@@ -1118,6 +2149,88 @@ WEAK uintptr_t halide_opencl_get_cl_mem(void *user_context, struct buffer_t *buf
     return (uintptr_t)mem;
 }
 
+WEAK int halide_opencl_wrap_host_memory(void *user_context, struct buffer_t *buf) {
+    debug(user_context)
+        << "CL: halide_opencl_wrap_host_memory (user_context: " << user_context
+        << ", buf: " << buf << ", host: " << (void *)buf->host << ")\n";
+
+    halide_assert(user_context, buf->dev == 0);
+    if (buf->dev != 0) {
+        return -2;
+    }
+    if (!buf->host || buf->stride[0] < 0 || buf->stride[1] < 0 ||
+        buf->stride[2] < 0 || buf->stride[3] < 0) {
+        error(user_context) << "CL: halide_opencl_wrap_host_memory needs a host pointer and non-negative strides.\n";
+        return -3;
+    }
+
+    ClContext ctx(user_context);
+    if (ctx.error != CL_SUCCESS) {
+        return ctx.error;
+    }
+
+    size_t size = buf_size(buf);
+    zero_copy_allocation *a = NULL;
+    for (zero_copy_allocation *i = zero_copy_allocations; i; i = i->next) {
+        if (i->registered && i->host == buf->host && i->size == size) {
+            a = i;
+            break;
+        }
+    }
+
+    cl_int err = CL_SUCCESS;
+    if (a) {
+        // The host has written new contents (e.g. the next camera frame
+        // in a recycled buffer), so the mapping must not bring back what
+        // the device last saw. OpenCL 1.1 lacks CL_MAP_WRITE_INVALIDATE_REGION.
+        debug(user_context) << "    re-using " << (void *)a->mem << "\n";
+        err = map_zero_copy_allocation(user_context, ctx.cmd_queue, a, CL_MAP_WRITE_INVALIDATE_REGION);
+        if (err == CL_INVALID_VALUE) {
+            err = map_zero_copy_allocation(user_context, ctx.cmd_queue, a, CL_MAP_WRITE);
+        }
+    } else {
+        cl_mem mem = create_zero_copy_allocation(user_context, ctx.context, ctx.cmd_queue, buf->host, size);
+        if (!mem) {
+            error(user_context) << "CL: clCreateBuffer with CL_MEM_USE_HOST_PTR failed\n";
+            return CL_INVALID_HOST_PTR;
+        }
+        a = find_zero_copy_allocation(mem);
+        a->registered = true;
+    }
+    if (err != CL_SUCCESS) {
+        return err;
+    }
+
+    buf->dev = halide_new_device_wrapper((uint64_t)a->mem, &opencl_device_interface);
+    if (buf->dev == 0) {
+        return -1;
+    }
+    return 0;
+}
+
+WEAK int halide_opencl_release_host_memory(void *user_context, void *host) {
+    debug(user_context)
+        << "CL: halide_opencl_release_host_memory (user_context: " << user_context
+        << ", host: " << host << ")\n";
+
+    ClContext ctx(user_context);
+    if (ctx.error != CL_SUCCESS) {
+        return ctx.error;
+    }
+
+    cl_int result = CL_SUCCESS;
+    for (zero_copy_allocation *a = zero_copy_allocations, *next; a; a = next) {
+        next = a->next;
+        if (a->registered && a->host == (uint8_t *)host) {
+            cl_int err = release_zero_copy_allocation(user_context, ctx.cmd_queue, a);
+            if (err != CL_SUCCESS) {
+                result = err;
+            }
+        }
+    }
+    return result;
+}
+
 WEAK const struct halide_device_interface_t *halide_opencl_device_interface() {
     return &opencl_device_interface;
 }
@@ -1196,6 +2309,8 @@ WEAK halide_device_interface_t opencl_device_interface = {
     halide_opencl_copy_to_device,
     halide_opencl_device_and_host_malloc,
     halide_opencl_device_and_host_free,
+    halide_opencl_copy_to_device_region,
+    halide_opencl_buffer_copy,
 };
 
 }}}} // namespace Halide::Runtime::Internal::OpenCL
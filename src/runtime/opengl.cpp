@@ -74,7 +74,12 @@
     GLFUNC(PFNGLGENVERTEXARRAYS, GenVertexArrays);                      \
     GLFUNC(PFNGLBINDVERTEXARRAY, BindVertexArray);                      \
     GLFUNC(PFNGLDELETEVERTEXARRAYS, DeleteVertexArrays);                \
-    GLFUNC(PFNDRAWBUFFERS, DrawBuffers)
+    GLFUNC(PFNDRAWBUFFERS, DrawBuffers);                                \
+    GLFUNC(PFNGLMAPBUFFERRANGEPROC, MapBufferRange);                    \
+    GLFUNC(PFNGLUNMAPBUFFERPROC, UnmapBuffer);                          \
+    GLFUNC(PFNGLFENCESYNCPROC, FenceSync);                              \
+    GLFUNC(PFNGLCLIENTWAITSYNCPROC, ClientWaitSync);                    \
+    GLFUNC(PFNGLDELETESYNCPROC, DeleteSync)
 
 // ---------- Types ----------
 
@@ -165,12 +170,29 @@ struct KernelInfo {
     GLuint program_id;
 };
 
+// The most pixel buffer objects a texture reads back into.
+#define MAX_READBACK_BUFFERS 2
+
 // Information about each known texture.
 struct TextureInfo {
     GLuint id;
     GLint min[4];
     GLint extent[4];
     bool halide_allocated;              // allocated by us or host app?
+
+    // Once the host has read a texture back, later kernels writing it
+    // start reading it into a pixel buffer object right away, and
+    // halide_opengl_copy_to_host only waits for that read to finish.
+    // These record how the host last read the texture.
+    bool readback_requested;
+    GLint readback_format, readback_type;
+    GLint readback_width, readback_height;
+    size_t readback_size;
+    GLuint readback_buffer[MAX_READBACK_BUFFERS];
+    GLsync readback_fence[MAX_READBACK_BUFFERS];
+    int readback_pending;               // buffer holding the latest read, or -1
+    int readback_next;                  // buffer the next read goes into
+
     TextureInfo *next;
 };
 
@@ -194,6 +216,7 @@ struct GlobalState {
     bool have_texture_rg;
     bool have_texture_float;
     bool have_texture_rgb8_rgba8;
+    bool have_pixel_buffer_objects;
 
     // Various objects shared by all filter kernels
     GLuint framebuffer_id;
@@ -239,6 +262,7 @@ class GLStateSaver {
     GLint framebuffer_binding;
     GLint program;
     GLint vertex_array_binding;
+    GLint pixel_pack_buffer_binding;
     GLint viewport[4];
     GLboolean cull_face;
     GLboolean depth_test;
@@ -280,6 +304,10 @@ WEAK void GLStateSaver::save()
         global_state.GetIntegerv(GL_VERTEX_ARRAY_BINDING, &vertex_array_binding);
     }
 
+    if (global_state.have_pixel_buffer_objects) {
+        global_state.GetIntegerv(GL_PIXEL_PACK_BUFFER_BINDING, &pixel_pack_buffer_binding);
+    }
+
 #ifdef DEBUG_RUNTIME
     debug(NULL) << "Saved OpenGL state\n";
 #endif
@@ -309,6 +337,10 @@ WEAK void GLStateSaver::restore()
         global_state.BindVertexArray(vertex_array_binding);
     }
 
+    if (global_state.have_pixel_buffer_objects) {
+        global_state.BindBuffer(GL_PIXEL_PACK_BUFFER, pixel_pack_buffer_binding);
+    }
+
     global_state.ActiveTexture(active_texture);
     global_state.BindFramebuffer(GL_FRAMEBUFFER, framebuffer_binding);
     global_state.BindBuffer(GL_ARRAY_BUFFER, array_buffer_binding);
@@ -319,6 +351,91 @@ WEAK void GLStateSaver::restore()
     (depth_test ? global_state.Enable : global_state.Disable)(GL_DEPTH_TEST);
 }
 
+// The number of pixel buffer objects each texture alternates between
+// for asynchronous readback. See halide_opengl_set_double_buffered_readback.
+WEAK int readback_buffer_count = 1;
+
+// Delete the pixel buffer objects and fences used to read a texture
+// back to the host.
+WEAK void release_readback_buffers(TextureInfo *texinfo) {
+    for (int i = 0; i < MAX_READBACK_BUFFERS; i++) {
+        if (texinfo->readback_fence[i]) {
+            global_state.DeleteSync(texinfo->readback_fence[i]);
+            texinfo->readback_fence[i] = NULL;
+        }
+        if (texinfo->readback_buffer[i]) {
+            global_state.DeleteBuffers(1, &texinfo->readback_buffer[i]);
+            texinfo->readback_buffer[i] = 0;
+        }
+    }
+    texinfo->readback_pending = -1;
+}
+
+// Start reading a texture that was just rendered into a pixel buffer
+// object, without waiting for the read. The texture must be attached
+// to the currently bound framebuffer.
+WEAK int start_readback(void *user_context, TextureInfo *texinfo) {
+    int i = texinfo->readback_next;
+    texinfo->readback_next = (i + 1) % readback_buffer_count;
+
+    GLuint &pbo = texinfo->readback_buffer[i];
+    if (!pbo) {
+        global_state.GenBuffers(1, &pbo);
+        global_state.BindBuffer(GL_PIXEL_PACK_BUFFER, pbo);
+        global_state.BufferData(GL_PIXEL_PACK_BUFFER, texinfo->readback_size, NULL, GL_STREAM_READ);
+        if (global_state.CheckAndReportError(user_context, "start_readback BufferData")) {
+            return 1;
+        }
+    } else {
+        global_state.BindBuffer(GL_PIXEL_PACK_BUFFER, pbo);
+    }
+    if (texinfo->readback_fence[i]) {
+        global_state.DeleteSync(texinfo->readback_fence[i]);
+        texinfo->readback_fence[i] = NULL;
+    }
+
+    global_state.PixelStorei(GL_PACK_ALIGNMENT, 1);
+    global_state.ReadPixels(0, 0, texinfo->readback_width, texinfo->readback_height,
+                            texinfo->readback_format, texinfo->readback_type, NULL);
+    texinfo->readback_fence[i] = global_state.FenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    global_state.BindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    if (global_state.CheckAndReportError(user_context, "start_readback ReadPixels")) {
+        return 1;
+    }
+    debug(user_context) << "start_readback: texture " << texinfo->id << " into buffer " << pbo << "\n";
+    texinfo->readback_pending = i;
+    return 0;
+}
+
+// Wait for the pending read of a texture into a pixel buffer object, and
+// map the buffer. Returns NULL if it fails.
+WEAK void *map_readback(void *user_context, TextureInfo *texinfo) {
+    int i = texinfo->readback_pending;
+    texinfo->readback_pending = -1;
+
+    GLenum status = global_state.ClientWaitSync(texinfo->readback_fence[i], GL_SYNC_FLUSH_COMMANDS_BIT,
+                                                GL_TIMEOUT_IGNORED);
+    global_state.DeleteSync(texinfo->readback_fence[i]);
+    texinfo->readback_fence[i] = NULL;
+    if (status == GL_WAIT_FAILED) {
+        global_state.CheckAndReportError(user_context, "map_readback ClientWaitSync");
+        return NULL;
+    }
+
+    global_state.BindBuffer(GL_PIXEL_PACK_BUFFER, texinfo->readback_buffer[i]);
+    void *ptr = global_state.MapBufferRange(GL_PIXEL_PACK_BUFFER, 0, texinfo->readback_size, GL_MAP_READ_BIT);
+    if (global_state.CheckAndReportError(user_context, "map_readback MapBufferRange") || !ptr) {
+        global_state.BindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        return NULL;
+    }
+    return ptr;
+}
+
+WEAK void unmap_readback() {
+    global_state.UnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    global_state.BindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
 // A list of module-specific state. Each module corresponds to a single Halide filter
 WEAK ModuleState *state_list;
 
@@ -583,6 +700,7 @@ WEAK void GlobalState::init() {
     have_vertex_array_objects = false;
     have_texture_rg = false;
     have_texture_rgb8_rgba8 = false;
+    have_pixel_buffer_objects = false;
     // Initialize all GL function pointers to NULL
 #define GLFUNC(type, name) name = NULL;
     USED_GL_FUNCTIONS;
@@ -634,6 +752,20 @@ WEAK void init_extensions(void *user_context) {
     }
     load_gl_func(user_context, "glDrawBuffers", (void**)&global_state.DrawBuffers, false);
 
+    // Pixel buffer objects, buffer mapping and fences are all in GL 3.2
+    // and GLES 3.0.
+    if (global_state.major_version >= 3) {
+        load_gl_func(user_context, "glMapBufferRange", (void**)&global_state.MapBufferRange, false);
+        load_gl_func(user_context, "glUnmapBuffer", (void**)&global_state.UnmapBuffer, false);
+        load_gl_func(user_context, "glFenceSync", (void**)&global_state.FenceSync, false);
+        load_gl_func(user_context, "glClientWaitSync", (void**)&global_state.ClientWaitSync, false);
+        load_gl_func(user_context, "glDeleteSync", (void**)&global_state.DeleteSync, false);
+        if (global_state.MapBufferRange && global_state.UnmapBuffer &&
+            global_state.FenceSync && global_state.ClientWaitSync && global_state.DeleteSync) {
+            global_state.have_pixel_buffer_objects = true;
+        }
+    }
+
     global_state.have_texture_rg =
         global_state.major_version >= 3 ||
         (global_state.profile == OpenGL &&
@@ -724,7 +856,8 @@ WEAK int halide_opengl_init(void *user_context) {
         << "  vertex_array_objects: " << (global_state.have_vertex_array_objects ? "yes\n" : "no\n")
         << "  texture_rg: " << (global_state.have_texture_rg ? "yes\n" : "no\n")
         << "  have_texture_rgb8_rgba8: " << (global_state.have_texture_rgb8_rgba8 ? "yes\n" : "no\n")
-        << "  texture_float: " << (global_state.have_texture_float ? "yes\n" : "no\n");
+        << "  texture_float: " << (global_state.have_texture_float ? "yes\n" : "no\n")
+        << "  pixel_buffer_objects: " << (global_state.have_pixel_buffer_objects ? "yes\n" : "no\n");
 
     // Initialize framebuffer.
     global_state.GenFramebuffers(1, &global_state.framebuffer_id);
@@ -783,6 +916,7 @@ WEAK int halide_opengl_device_release(void *user_context) {
     int freed_textures = 0;
     while (tex) {
         TextureInfo *next = tex->next;
+        release_readback_buffers(tex);
         if (tex->halide_allocated) {
             debug(user_context) << "halide_opengl_device_release: Deleting texture " << tex->id << "\n";
             global_state.DeleteTextures(1, &tex->id);
@@ -929,6 +1063,16 @@ WEAK TextureInfo *new_texture_info(GLuint tex, int32_t min[4], int32_t extent[4]
         texinfo->extent[i] = extent[i];
     }
     texinfo->halide_allocated = halide_allocated;
+    texinfo->readback_requested = false;
+    texinfo->readback_format = texinfo->readback_type = 0;
+    texinfo->readback_width = texinfo->readback_height = 0;
+    texinfo->readback_size = 0;
+    for (int i = 0; i < MAX_READBACK_BUFFERS; i++) {
+        texinfo->readback_buffer[i] = 0;
+        texinfo->readback_fence[i] = NULL;
+    }
+    texinfo->readback_pending = -1;
+    texinfo->readback_next = 0;
 
     texinfo->next = global_state.textures;
     global_state.textures = texinfo;
@@ -950,6 +1094,7 @@ WEAK TextureInfo *unlink_texture_info(GLuint tex) {
     }
     return NULL;
 }
+
 // Allocate a new texture matching the dimension and color format of the
 // specified buffer.
 WEAK int halide_opengl_device_malloc(void *user_context, buffer_t *buf) {
@@ -1081,6 +1226,8 @@ WEAK int halide_opengl_device_free(void *user_context, buffer_t *buf) {
         return 1;
     }
 
+    release_readback_buffers(texinfo);
+
     // Delete texture if it was allocated by us.
     int result = 0;
     if (texinfo->halide_allocated) {
@@ -1189,6 +1336,11 @@ WEAK int halide_opengl_copy_to_device(void *user_context, buffer_t *buf) {
     GLuint tex = (GLuint)handle;
     debug(user_context) << "halide_opengl_copy_to_device: " << tex << "\n";
 
+    // Any read of the texture in flight is now stale.
+    if (TextureInfo *texinfo = find_texture_info(tex)) {
+        texinfo->readback_pending = -1;
+    }
+
     global_state.BindTexture(GL_TEXTURE_2D, tex);
     if (global_state.CheckAndReportError(user_context, "halide_opengl_copy_to_device BindTexture")) {
         return 1;
@@ -1280,8 +1432,10 @@ WEAK int halide_opengl_copy_to_host(void *user_context, buffer_t *buf) {
 
 
     uint64_t handle = halide_get_device_handle(buf->dev);
+    TextureInfo *texinfo = NULL;
     if (handle != HALIDE_OPENGL_RENDER_TARGET) {
         GLuint tex = (GLuint)handle;
+        texinfo = find_texture_info(tex);
         debug(user_context) << "halide_copy_to_host: texture " << tex << "\n";
         global_state.BindFramebuffer(GL_FRAMEBUFFER, global_state.framebuffer_id);
         if (global_state.CheckAndReportError(user_context, "copy_to_host BindFramebuffer")) {
@@ -1330,7 +1484,61 @@ WEAK int halide_opengl_copy_to_host(void *user_context, buffer_t *buf) {
     // (Single-channel buffers are "interleaved" for our purposes here.)
     bool is_interleaved = (buffer_channels == 1) || (buf->stride[2] == 1 && buf->stride[0] == buf->extent[2]);
     bool is_packed = (buf->stride[1] == buf->extent[0] * buf->stride[0]);
-    if (is_interleaved && is_packed && texture_channels == buffer_channels) {
+    bool is_direct = is_interleaved && is_packed && texture_channels == buffer_channels;
+    size_t texture_size = width * height * texture_channels * buf->elem_size;
+
+    // If the kernel that last wrote the texture already started reading
+    // it back, just wait for that.
+    if (texinfo && texinfo->readback_pending >= 0 &&
+        texinfo->readback_format == format && texinfo->readback_type == type &&
+        texinfo->readback_width == width && texinfo->readback_height == height) {
+#ifdef DEBUG_RUNTIME
+        int64_t t1 = halide_current_time_ns(user_context);
+#endif
+        void *ptr = map_readback(user_context, texinfo);
+        if (!ptr) {
+            return 1;
+        }
+        if (is_direct) {
+            memcpy(buf->host, ptr, texture_size);
+        } else {
+            switch (type) {
+            case GL_UNSIGNED_BYTE:
+                interleaved_to_halide<uint8_t>(user_context, (uint8_t*)ptr, texture_channels, buf);
+                break;
+            case GL_UNSIGNED_SHORT:
+                interleaved_to_halide<uint16_t>(user_context, (uint16_t*)ptr, texture_channels, buf);
+                break;
+            case GL_FLOAT:
+                interleaved_to_halide<float>(user_context, (float*)ptr, texture_channels, buf);
+                break;
+            }
+        }
+        unmap_readback();
+#ifdef DEBUG_RUNTIME
+        int64_t t2 = halide_current_time_ns(user_context);
+        debug(user_context)<<"Asynchronous readback wait and copy time: "<<(t2-t1)/1e3<<"usec\n";
+#endif
+        return 0;
+    }
+
+    // Remember how the texture is read, so that the next kernel to
+    // write it can start the readback itself. Textures wrapped from the
+    // host application may be drawn into behind our back, so only do
+    // this for our own.
+    if (texinfo && texinfo->halide_allocated && global_state.have_pixel_buffer_objects) {
+        if (texinfo->readback_size != texture_size) {
+            release_readback_buffers(texinfo);
+        }
+        texinfo->readback_requested = true;
+        texinfo->readback_format = format;
+        texinfo->readback_type = type;
+        texinfo->readback_width = width;
+        texinfo->readback_height = height;
+        texinfo->readback_size = texture_size;
+    }
+
+    if (is_direct) {
         global_state.PixelStorei(GL_PACK_ALIGNMENT, 1);
         uint8_t *host_ptr = buf->host;
 #ifdef DEBUG_RUNTIME
@@ -1350,7 +1558,6 @@ WEAK int halide_opengl_copy_to_host(void *user_context, buffer_t *buf) {
         debug(user_context)
             << "Warning: In copy_to_host, host buffer is not interleaved, or not a native format. Doing slow deinterleave.\n";
 
-        size_t texture_size = width * height * texture_channels * buf->elem_size;
         HalideMalloc tmp(user_context, texture_size);
         if (!tmp.ptr) {
             error(user_context) << "halide_malloc failed inside copy_to_host";
@@ -1664,6 +1871,7 @@ WEAK int halide_opengl_run(void *user_context,
     global_state.Disable(GL_DEPTH_TEST);
 
     GLint num_output_textures = 0;
+    TextureInfo *readback_texinfo = NULL;
     kernel_arg = kernel->arguments;
     for (int i = 0; args[i]; i++, kernel_arg = kernel_arg->next) {
         if (kernel_arg->kind != Argument::Outbuf) continue;
@@ -1702,6 +1910,11 @@ WEAK int halide_opengl_run(void *user_context,
             error(user_context) << "Undefined output texture " << tex;
             return 1;
         }
+        // Any read of the texture in flight is about to be stale.
+        texinfo->readback_pending = -1;
+        if (num_output_textures == 0) {
+            readback_texinfo = texinfo;
+        }
         output_min[0] = texinfo->min[0];
         output_min[1] = texinfo->min[1];
         output_extent[0] = texinfo->extent[0];
@@ -1767,32 +1980,55 @@ WEAK int halide_opengl_run(void *user_context,
     debug(user_context) << "output_min: " << output_min[0] << "," << output_min[1] << "\n";
 #endif
 
-    // TODO(abestephensg): Sort coordinate dimensions when the linear solver is integrated
-    // Sort the coordinates
-
-    // Construct an element buffer using the sorted vertex order.
     // Note that this is "width" and "height" of the vertices, not the output image.
     int width = num_coords_dim0;
     int height = num_coords_dim1;
 
     int vertex_buffer_size = width*height*num_padded_attributes;
 
+    // Sort the coordinates. The vertices of the mesh are on a grid, but the
+    // coordinates after the first two in each dimension are breakpoints of
+    // piecewise linear varying attributes, which may be in any order. The x
+    // and y coordinates are the first two attributes of each vertex.
+    int column_order[width];
+    int row_order[height];
+    for (int w=0;w!=width;++w) {
+        float x = vertex_buffer[w*num_padded_attributes];
+        int i = w;
+        while (i > 0 && vertex_buffer[column_order[i-1]*num_padded_attributes] > x) {
+            column_order[i] = column_order[i-1];
+            --i;
+        }
+        column_order[i] = w;
+    }
+    for (int h=0;h!=height;++h) {
+        float y = vertex_buffer[h*width*num_padded_attributes + 1];
+        int i = h;
+        while (i > 0 && vertex_buffer[row_order[i-1]*width*num_padded_attributes + 1] > y) {
+            row_order[i] = row_order[i-1];
+            --i;
+        }
+        row_order[i] = h;
+    }
+
+    // Construct an element buffer using the sorted vertex order.
     int element_buffer_size = (width-1)*(height-1)*6;
     int element_buffer[element_buffer_size];
 
     int idx = 0;
     for (int h=0;h!=(height-1);++h) {
         for (int w=0;w!=(width-1);++w) {
-
-            // TODO(abestephensg): Use sorted coordinates when integrated
-            int v = w+h*width;
-            element_buffer[idx++] = v;
-            element_buffer[idx++] = v+1;
-            element_buffer[idx++] = v+width+1;
-
-            element_buffer[idx++] = v+width+1;
-            element_buffer[idx++] = v+width;
-            element_buffer[idx++] = v;
+            int v00 = column_order[w] + row_order[h]*width;
+            int v10 = column_order[w+1] + row_order[h]*width;
+            int v01 = column_order[w] + row_order[h+1]*width;
+            int v11 = column_order[w+1] + row_order[h+1]*width;
+            element_buffer[idx++] = v00;
+            element_buffer[idx++] = v10;
+            element_buffer[idx++] = v11;
+
+            element_buffer[idx++] = v11;
+            element_buffer[idx++] = v01;
+            element_buffer[idx++] = v00;
         }
     }
 
@@ -1887,6 +2123,16 @@ WEAK int halide_opengl_run(void *user_context,
         return 1;
     }
 
+    // If the host reads the output back, start that now rather than
+    // stalling the pipeline in halide_opengl_copy_to_host. Only the
+    // texture on the first color attachment can be read.
+    if (readback_texinfo && readback_texinfo->readback_requested &&
+        num_output_textures == 1 && bind_render_targets) {
+        if (start_readback(user_context, readback_texinfo)) {
+            return 1;
+        }
+    }
+
     // Cleanup
     if (global_state.have_vertex_array_objects) {
         global_state.DeleteVertexArrays(1, &vertex_array_object);
@@ -2062,6 +2308,10 @@ WEAK int halide_opengl_device_and_host_free(void *user_context, struct buffer_t
     return halide_default_device_and_host_free(user_context, buf, &opengl_device_interface);
 }
 
+WEAK void halide_opengl_set_double_buffered_readback(bool double_buffered) {
+    readback_buffer_count = double_buffered ? 2 : 1;
+}
+
 WEAK const halide_device_interface_t *halide_opengl_device_interface() {
     return &opengl_device_interface;
 }
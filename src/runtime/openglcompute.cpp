@@ -490,7 +490,9 @@ WEAK int halide_openglcompute_run(void *user_context, void *state_ptr,
     if (global_state.CheckAndReportError(user_context, "halide_openglcompute_run DispatchCompute")) {
         return -1;
     }
-    global_state.MemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+    // Make the kernel's writes to the storage buffers visible to the
+    // kernels that follow it and to copies back to the host.
+    global_state.MemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
     if (global_state.CheckAndReportError(user_context, "halide_openglcompute_run MemoryBarrier")) {
         return -1;
     }
@@ -0,0 +1,148 @@
+#include "HalideRuntime.h"
+#include "printer.h"
+#include "scoped_mutex_lock.h"
+
+extern "C" void *fopen(const char *, const char *);
+extern "C" int fclose(void *);
+extern "C" size_t fwrite(const void *, size_t, size_t, void *);
+
+// Profile counters of pipelines compiled with the pgo_instrument
+// feature. Generated code bumps the counters itself; all the runtime
+// does is remember where they are, so that they can be written out at
+// exit.
+
+namespace Halide { namespace Runtime { namespace Internal {
+
+struct pgo_counters {
+    pgo_counters *next;
+    const char *name;
+    uint64_t *counters;
+    int num_counters;
+};
+
+WEAK pgo_counters *pgo_registered = NULL;
+WEAK halide_mutex pgo_lock;
+
+// Appends to a file through a small buffer.
+struct pgo_writer {
+    void *f;
+    char buf[1024];
+    char *dst;
+    bool ok;
+
+    pgo_writer(void *f) : f(f), dst(buf), ok(true) {}
+
+    void flush() {
+        if (dst != buf && !fwrite(buf, dst - buf, 1, f)) {
+            ok = false;
+        }
+        dst = buf;
+    }
+
+    void reserve(size_t size) {
+        if (dst + size >= buf + sizeof(buf)) {
+            flush();
+        }
+    }
+
+    void write(const char *str) {
+        while (*str) {
+            reserve(1);
+            *dst++ = *str++;
+        }
+    }
+
+    void write(uint64_t x) {
+        // 20 digits holds any uint64_t.
+        reserve(21);
+        dst = halide_uint64_to_string(dst, buf + sizeof(buf), x, 1);
+    }
+};
+
+}}} // namespace Halide::Runtime::Internal
+
+using namespace Halide::Runtime::Internal;
+
+extern "C" {
+
+WEAK int halide_pgo_register(void *user_context, const char *name,
+                             uint64_t *counters, int num_counters) {
+    ScopedMutexLock lock(&pgo_lock);
+    for (pgo_counters *c = pgo_registered; c; c = c->next) {
+        if (c->counters == counters) {
+            return 0;
+        }
+    }
+    pgo_counters *c = (pgo_counters *)malloc(sizeof(pgo_counters));
+    if (!c) {
+        return halide_error_code_out_of_memory;
+    }
+    c->next = pgo_registered;
+    c->name = name;
+    c->counters = counters;
+    c->num_counters = num_counters;
+    pgo_registered = c;
+    return 0;
+}
+
+WEAK int halide_pgo_write_profile(void *user_context, const char *filename) {
+    ScopedMutexLock lock(&pgo_lock);
+    if (!pgo_registered) {
+        return 0;
+    }
+
+    // Append, so that the profiles of several runs add up.
+    void *f = fopen(filename, "ab");
+    if (!f) {
+        error(user_context) << "Could not open profile file " << filename << " for writing\n";
+        return halide_error_code_generic_error;
+    }
+    pgo_writer w(f);
+    for (pgo_counters *c = pgo_registered; c; c = c->next) {
+        w.write(c->name);
+        w.write(" ");
+        w.write((uint64_t)c->num_counters);
+        for (int i = 0; i < c->num_counters; i++) {
+            w.write(" ");
+            w.write(__sync_fetch_and_add(c->counters + i, 0));
+        }
+        w.write("\n");
+    }
+    w.flush();
+    fclose(f);
+    if (!w.ok) {
+        error(user_context) << "Could not write profile file " << filename << "\n";
+        return halide_error_code_generic_error;
+    }
+    return 0;
+}
+
+WEAK void halide_pgo_reset() {
+    ScopedMutexLock lock(&pgo_lock);
+    for (pgo_counters *c = pgo_registered; c; c = c->next) {
+        for (int i = 0; i < c->num_counters; i++) {
+            c->counters[i] = 0;
+        }
+    }
+}
+
+namespace {
+__attribute__((destructor))
+WEAK void halide_pgo_shutdown() {
+    if (!pgo_registered) return;
+    const char *filename = getenv("HL_PGO_PROFILE");
+    if (!filename) {
+        filename = "halide.pgo";
+    }
+    // Write once, then forget the counters, in case the destructor
+    // of more than one copy of the runtime gets here.
+    halide_pgo_write_profile(NULL, filename);
+    while (pgo_registered) {
+        pgo_counters *c = pgo_registered;
+        pgo_registered = c->next;
+        free(c);
+    }
+}
+}
+
+}
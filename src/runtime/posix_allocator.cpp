@@ -1,35 +1,343 @@
 #include "HalideRuntime.h"
+#include "runtime_internal.h"
 
-extern "C" {
+namespace Halide { namespace Runtime { namespace Internal {
+
+// Allocations of at least this many bytes come from huge pages where
+// the platform supports them, and are optionally pre-faulted on the
+// thread pool. Zero means never. Negative means not yet read from the
+// environment.
+WEAK int64_t large_allocation_threshold = -1;
+WEAK bool prefault_large_allocations = false;
 
-extern void *malloc(size_t);
-extern void free(void *);
+const size_t kHugePageSize = 2 << 20;
 
+WEAK int64_t get_large_allocation_threshold() {
+    if (large_allocation_threshold < 0) {
+        const char *threshold = getenv("HL_HUGE_PAGE_THRESHOLD_MB");
+        const char *prefault = getenv("HL_PREFAULT_LARGE_ALLOCATIONS");
+        prefault_large_allocations = prefault && atoi(prefault) != 0;
+        large_allocation_threshold = threshold ? (int64_t)atoi(threshold) << 20 : 0;
+    }
+    return large_allocation_threshold;
 }
 
-namespace Halide { namespace Runtime { namespace Internal {
+struct prefault_closure {
+    uint8_t *base;
+    size_t size;
+};
+
+// Touch every page of one huge page sized chunk.
+WEAK int prefault_task(void *user_context, int idx, uint8_t *closure) {
+    prefault_closure *c = (prefault_closure *)closure;
+    size_t begin = (size_t)idx * kHugePageSize;
+    size_t end = c->size - begin < kHugePageSize ? c->size : begin + kHugePageSize;
+    for (size_t i = begin; i < end; i += 4096) {
+        ((volatile uint8_t *)c->base)[i] = 0;
+    }
+    return 0;
+}
+
+// Take the page faults for a new allocation now, in parallel, rather
+// than during the first pass over it.
+WEAK void prefault(void *user_context, void *ptr, size_t size) {
+    prefault_closure c = {(uint8_t *)ptr, size};
+    int chunks = (int)((size + kHugePageSize - 1) / kHugePageSize);
+    halide_do_par_for(user_context, prefault_task, 0, chunks, (uint8_t *)&c);
+}
 
 WEAK void *default_malloc(void *user_context, size_t x) {
     // Allocate enough space for aligning the pointer we return.
     const size_t alignment = 128;
+
+    int64_t threshold = get_large_allocation_threshold();
+    bool large = threshold > 0 && (int64_t)x >= threshold;
+    if (large && halide_allocate_huge_pages) {
+        // Align the pointer we return to a huge page, keeping the
+        // mapping and its size just before it.
+        size_t mapped_size = x + kHugePageSize;
+        void *orig = halide_allocate_huge_pages(mapped_size);
+        if (orig != NULL) {
+            void *ptr = (void *)(((size_t)orig + kHugePageSize + 2 * sizeof(void*) - 1) & ~(kHugePageSize - 1));
+            ((void **)ptr)[-1] = orig;
+            ((size_t *)ptr)[-2] = mapped_size;
+            if (prefault_large_allocations) {
+                prefault(user_context, ptr, x);
+            }
+            return ptr;
+        }
+    }
+
     void *orig = malloc(x + alignment);
     if (orig == NULL) {
         // Will result in a failed assertion and a call to halide_error
         return NULL;
     }
-    // We want to store the original pointer prior to the pointer we return.
-    void *ptr = (void *)(((size_t)orig + alignment + sizeof(void*) - 1) & ~(alignment - 1));
+    // We want to store the original pointer prior to the pointer we
+    // return, and before that zero to say it came from malloc.
+    void *ptr = (void *)(((size_t)orig + alignment + 2 * sizeof(void*) - 1) & ~(alignment - 1));
     ((void **)ptr)[-1] = orig;
+    ((size_t *)ptr)[-2] = 0;
+    if (large && prefault_large_allocations) {
+        prefault(user_context, ptr, x);
+    }
     return ptr;
 }
 
 WEAK void default_free(void *user_context, void *ptr) {
+    size_t mapped_size = ((size_t *)ptr)[-2];
+    if (mapped_size) {
+        halide_free_huge_pages(((void**)ptr)[-1], mapped_size);
+    } else {
+        free(((void**)ptr)[-1]);
+    }
+}
+
+// A size-class pool allocator, for pipelines that allocate and free
+// many scratch buffers per run. Freed blocks are kept on free lists,
+// one per power-of-two size class, and reused by later allocations of
+// up to that size. Larger allocations go straight to the system.
+//
+// The free lists are sharded, and each thread uses the shard picked
+// by the address of its stack. Threads' stacks are far apart, so this
+// keeps threads mostly on their own shards without needing thread
+// local storage, which not all of our targets support.
+
+const int kPoolMinClassBits = 6;   // 64 bytes
+const int kPoolMaxClassBits = 20;  // 1MB
+const int kPoolNumClasses = kPoolMaxClassBits - kPoolMinClassBits + 1;
+const int kPoolNumShards = 16;
+// The most bytes of free blocks each shard keeps per size class.
+const size_t kPoolMaxCachedBytes = 4 << 20;
+
+struct PoolBlock {
+    PoolBlock *next;
+};
+
+// Aligned to a cache line, so that shards' locks don't share one.
+struct __attribute__((aligned(64))) PoolShard {
+    volatile int lock;
+    PoolBlock *free_list[kPoolNumClasses];
+    size_t cached_bytes[kPoolNumClasses];
+};
+
+WEAK PoolShard pool_shards[kPoolNumShards];
+
+WEAK PoolShard &this_threads_pool_shard() {
+    int on_stack;
+    return pool_shards[((size_t)&on_stack >> 16) % kPoolNumShards];
+}
+
+WEAK void pool_shard_lock(PoolShard &shard) {
+    while (__sync_lock_test_and_set(&shard.lock, 1)) {
+        while (shard.lock) { }
+    }
+}
+
+WEAK void pool_shard_unlock(PoolShard &shard) {
+    __sync_lock_release(&shard.lock);
+}
+
+// The size class that allocations of x bytes come from, or -1 if they
+// are too large to pool.
+WEAK int pool_size_class(size_t x) {
+    int bits = kPoolMinClassBits;
+    while (((size_t)1 << bits) < x) {
+        bits++;
+        if (bits > kPoolMaxClassBits) {
+            return -1;
+        }
+    }
+    return bits - kPoolMinClassBits;
+}
+
+WEAK size_t pool_class_size(int size_class) {
+    return (size_t)1 << (size_class + kPoolMinClassBits);
+}
+
+WEAK void *pool_malloc(void *user_context, size_t x) {
+    int size_class = pool_size_class(x);
+    if (size_class >= 0) {
+        PoolShard &shard = this_threads_pool_shard();
+        pool_shard_lock(shard);
+        PoolBlock *block = shard.free_list[size_class];
+        if (block) {
+            shard.free_list[size_class] = block->next;
+            shard.cached_bytes[size_class] -= pool_class_size(size_class);
+        }
+        pool_shard_unlock(shard);
+        if (block) {
+            return block;
+        }
+        x = pool_class_size(size_class);
+    }
+
+    // Allocate enough space for aligning the pointer we return, and
+    // for the original pointer and size class just before it.
+    const size_t alignment = 128;
+    void *orig = malloc(x + alignment);
+    if (orig == NULL) {
+        return NULL;
+    }
+    void *ptr = (void *)(((size_t)orig + alignment + 2 * sizeof(void*) - 1) & ~(alignment - 1));
+    ((void **)ptr)[-1] = orig;
+    ((intptr_t *)ptr)[-2] = size_class;
+    return ptr;
+}
+
+WEAK void pool_free(void *user_context, void *ptr) {
+    if (ptr == NULL) {
+        return;
+    }
+    int size_class = (int)((intptr_t *)ptr)[-2];
+    if (size_class >= 0) {
+        PoolShard &shard = this_threads_pool_shard();
+        size_t size = pool_class_size(size_class);
+        bool cached = false;
+        pool_shard_lock(shard);
+        if (shard.cached_bytes[size_class] + size <= kPoolMaxCachedBytes) {
+            PoolBlock *block = (PoolBlock *)ptr;
+            block->next = shard.free_list[size_class];
+            shard.free_list[size_class] = block;
+            shard.cached_bytes[size_class] += size;
+            cached = true;
+        }
+        pool_shard_unlock(shard);
+        if (cached) {
+            return;
+        }
+    }
     free(((void**)ptr)[-1]);
 }
 
 WEAK halide_malloc_t custom_malloc = default_malloc;
 WEAK halide_free_t custom_free = default_free;
 
+// Workspaces keep the allocations made with a particular user_context
+// when they are freed, and hand them back to later allocations of the
+// same size with the same user_context. A pipeline called repeatedly
+// with the same bounds then reuses its intermediate buffers instead
+// of allocating them afresh on each call.
+
+struct WorkspaceBlock {
+    WorkspaceBlock *next;
+    void *ptr;
+    size_t size;
+};
+
+struct Workspace {
+    void *user_context;
+    // Blocks currently allocated, and blocks freed and kept for
+    // reuse, most recently freed first. The list nodes move between
+    // the two, so reuse doesn't allocate.
+    WorkspaceBlock *in_use;
+    WorkspaceBlock *cached;
+    int num_cached;
+};
+
+#define MAX_WORKSPACES 16
+// Blocks beyond this many are freed, least recently used first, so
+// that changing bounds doesn't accumulate unusable blocks.
+const int kMaxCachedBlocksPerWorkspace = 64;
+
+WEAK Workspace workspaces[MAX_WORKSPACES];
+WEAK int num_workspaces = 0;
+WEAK volatile int workspaces_lock = 0;
+
+WEAK void workspaces_lock_acquire() {
+    while (__sync_lock_test_and_set(&workspaces_lock, 1)) {
+        while (workspaces_lock) { }
+    }
+}
+
+WEAK void workspaces_lock_release() {
+    __sync_lock_release(&workspaces_lock);
+}
+
+WEAK Workspace *find_workspace_already_locked(void *user_context) {
+    for (int i = 0; i < num_workspaces; i++) {
+        if (workspaces[i].user_context == user_context) {
+            return &workspaces[i];
+        }
+    }
+    return NULL;
+}
+
+WEAK void *workspace_malloc(void *user_context, size_t x) {
+    workspaces_lock_acquire();
+    Workspace *w = find_workspace_already_locked(user_context);
+    if (w == NULL) {
+        workspaces_lock_release();
+        return custom_malloc(user_context, x);
+    }
+    WorkspaceBlock **prev = &w->cached;
+    for (WorkspaceBlock *b = w->cached; b != NULL; prev = &b->next, b = b->next) {
+        if (b->size == x) {
+            *prev = b->next;
+            w->num_cached--;
+            b->next = w->in_use;
+            w->in_use = b;
+            workspaces_lock_release();
+            return b->ptr;
+        }
+    }
+    workspaces_lock_release();
+
+    void *ptr = custom_malloc(user_context, x);
+    WorkspaceBlock *b = ptr ? (WorkspaceBlock *)malloc(sizeof(WorkspaceBlock)) : NULL;
+    if (b == NULL) {
+        // Leave it untracked. Freeing it will then go straight to
+        // custom_free.
+        return ptr;
+    }
+    b->ptr = ptr;
+    b->size = x;
+
+    workspaces_lock_acquire();
+    w = find_workspace_already_locked(user_context);
+    if (w) {
+        b->next = w->in_use;
+        w->in_use = b;
+    }
+    workspaces_lock_release();
+    if (w == NULL) {
+        // The workspace was released meanwhile.
+        free(b);
+    }
+    return ptr;
+}
+
+WEAK void workspace_free(void *user_context, void *ptr) {
+    workspaces_lock_acquire();
+    Workspace *w = find_workspace_already_locked(user_context);
+    WorkspaceBlock *b = NULL, *evicted = NULL;
+    if (w) {
+        WorkspaceBlock **prev = &w->in_use;
+        for (b = w->in_use; b != NULL && b->ptr != ptr; prev = &b->next, b = b->next) { }
+        if (b) {
+            *prev = b->next;
+            b->next = w->cached;
+            w->cached = b;
+            if (++w->num_cached > kMaxCachedBlocksPerWorkspace) {
+                WorkspaceBlock **last = &w->cached;
+                while ((*last)->next) {
+                    last = &(*last)->next;
+                }
+                evicted = *last;
+                *last = NULL;
+                w->num_cached--;
+            }
+        }
+    }
+    workspaces_lock_release();
+    if (b == NULL) {
+        custom_free(user_context, ptr);
+    } else if (evicted) {
+        custom_free(user_context, evicted->ptr);
+        free(evicted);
+    }
+}
+
 }}} // namespace Halide::Runtime::Internal
 
 extern "C" {
@@ -46,12 +354,95 @@ WEAK halide_free_t halide_set_custom_free(halide_free_t user_free) {
     return result;
 }
 
+WEAK void halide_set_large_allocation_policy(int64_t huge_page_threshold, bool prefault) {
+    large_allocation_threshold = huge_page_threshold > 0 ? huge_page_threshold : 0;
+    prefault_large_allocations = prefault;
+}
+
+WEAK void *halide_pool_malloc(void *user_context, size_t x) {
+    return pool_malloc(user_context, x);
+}
+
+WEAK void halide_pool_free(void *user_context, void *ptr) {
+    pool_free(user_context, ptr);
+}
+
+WEAK void halide_pool_allocator_release_unused() {
+    for (int i = 0; i < kPoolNumShards; i++) {
+        PoolShard &shard = pool_shards[i];
+        pool_shard_lock(shard);
+        for (int c = 0; c < kPoolNumClasses; c++) {
+            PoolBlock *block = shard.free_list[c];
+            while (block) {
+                PoolBlock *next = block->next;
+                free(((void**)block)[-1]);
+                block = next;
+            }
+            shard.free_list[c] = NULL;
+            shard.cached_bytes[c] = 0;
+        }
+        pool_shard_unlock(shard);
+    }
+}
+
+WEAK int halide_enable_workspace(void *user_context) {
+    workspaces_lock_acquire();
+    int result = 0;
+    if (find_workspace_already_locked(user_context) == NULL) {
+        if (num_workspaces < MAX_WORKSPACES) {
+            Workspace &w = workspaces[num_workspaces++];
+            w.user_context = user_context;
+            w.in_use = NULL;
+            w.cached = NULL;
+            w.num_cached = 0;
+        } else {
+            result = -1;
+        }
+    }
+    workspaces_lock_release();
+    return result;
+}
+
+WEAK void halide_release_workspace(void *user_context) {
+    workspaces_lock_acquire();
+    Workspace *w = find_workspace_already_locked(user_context);
+    if (w == NULL) {
+        workspaces_lock_release();
+        return;
+    }
+    WorkspaceBlock *cached = w->cached;
+    WorkspaceBlock *in_use = w->in_use;
+    *w = workspaces[--num_workspaces];
+    workspaces_lock_release();
+
+    while (cached) {
+        WorkspaceBlock *next = cached->next;
+        custom_free(user_context, cached->ptr);
+        free(cached);
+        cached = next;
+    }
+    // Blocks still in use are freed normally when their owner frees
+    // them.
+    while (in_use) {
+        WorkspaceBlock *next = in_use->next;
+        free(in_use);
+        in_use = next;
+    }
+}
+
 WEAK void *halide_malloc(void *user_context, size_t x) {
-    return custom_malloc(user_context, x);
+    if (num_workspaces == 0) {
+        return custom_malloc(user_context, x);
+    }
+    return workspace_malloc(user_context, x);
 }
 
 WEAK void halide_free(void *user_context, void *ptr) {
-    custom_free(user_context, ptr);
+    if (num_workspaces == 0) {
+        custom_free(user_context, ptr);
+        return;
+    }
+    workspace_free(user_context, ptr);
 }
 
 }
@@ -1,5 +1,15 @@
 #include "HalideRuntime.h"
 
+#ifndef _STRUCT_TIMESPEC
+#define _STRUCT_TIMESPEC
+
+struct timespec {
+    long tv_sec;            /* Seconds.  */
+    long tv_nsec;           /* Nanoseconds.  */
+};
+
+#endif  // _STRUCT_TIMESPEC
+
 #ifndef _STRUCT_TIMEVAL
 #define _STRUCT_TIMEVAL
 
@@ -49,4 +59,12 @@ WEAK void halide_sleep_ms(void *user_context, int ms) {
         usleep(ms * 1000);
 }
 
+extern int nanosleep(const timespec *req, timespec *rem);
+WEAK void halide_sleep_us(void *user_context, int us) {
+    timespec t;
+    t.tv_sec = us / 1000000;
+    t.tv_nsec = (us % 1000000) * 1000;
+    nanosleep(&t, NULL);
+}
+
 }
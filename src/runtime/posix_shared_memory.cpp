@@ -0,0 +1,44 @@
+#include "HalideRuntime.h"
+#include "runtime_internal.h"
+
+extern "C" {
+
+#define O_CREAT 64
+#define PROT_READ 1
+#define PROT_WRITE 2
+#define MAP_SHARED 1
+#define MAP_FAILED ((void *)-1)
+#define SEEK_END 2
+
+extern long lseek(int fd, long offset, int whence);
+extern int ftruncate(int fd, long length);
+extern void *mmap(void *addr, size_t length, int prot, int flags, int fd, long offset);
+extern int munmap(void *addr, size_t length);
+
+WEAK void *halide_map_shared_memory(void *user_context, const char *path, size_t size) {
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (fd == -1) {
+        return NULL;
+    }
+    // Extending the file zero-fills it. Never shrink it, as other
+    // processes may have more of it mapped.
+    long current_size = lseek(fd, 0, SEEK_END);
+    if (current_size < 0 ||
+        (current_size < (long)size && ftruncate(fd, (long)size) != 0)) {
+        close(fd);
+        return NULL;
+    }
+    void *result = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    // The mapping stays valid after the file is closed.
+    close(fd);
+    if (result == MAP_FAILED) {
+        return NULL;
+    }
+    return result;
+}
+
+WEAK void halide_unmap_shared_memory(void *user_context, void *addr, size_t size) {
+    munmap(addr, size);
+}
+
+}  // extern "C"
@@ -19,6 +19,10 @@ extern "C" {
 typedef long pthread_t;
 extern int pthread_create(pthread_t *, const void * attr,
                           void *(*start_routine)(void *), void * arg);
+extern int pthread_attr_init(void *attr);
+extern int pthread_attr_getstacksize(const void *attr, size_t *stacksize);
+extern int pthread_attr_setstacksize(void *attr, size_t stacksize);
+extern int pthread_attr_destroy(void *attr);
 extern int pthread_join(pthread_t thread, void **retval);
 extern int pthread_cond_init(halide_cond *cond, const void *attr);
 extern int pthread_cond_wait(halide_cond *cond, halide_mutex *mutex);
@@ -28,6 +32,8 @@ extern int pthread_mutex_init(halide_mutex *mutex, const void *attr);
 extern int pthread_mutex_lock(halide_mutex *mutex);
 extern int pthread_mutex_unlock(halide_mutex *mutex);
 extern int pthread_mutex_destroy(halide_mutex *mutex);
+extern int sched_yield();
+extern pthread_t pthread_self();
 
 } // extern "C"
 
@@ -51,7 +57,19 @@ WEAK struct halide_thread *halide_spawn_thread(void (*f)(void *), void *closure)
     t->f = f;
     t->closure = closure;
     t->handle = 0;
-    pthread_create(&t->handle, NULL, spawn_thread_helper, t);
+    // Generated code may place large allocations on the stack (see
+    // the large_stack target feature), so make sure workers have at
+    // least 8MB of stack. Some platforms default to much less. The
+    // attribute is opaque, so use storage larger than any platform's.
+    uint64_t attr[16];
+    const size_t min_stack_size = 8 * 1024 * 1024;
+    size_t stack_size = 0;
+    pthread_attr_init(attr);
+    if (pthread_attr_getstacksize(attr, &stack_size) == 0 && stack_size < min_stack_size) {
+        pthread_attr_setstacksize(attr, min_stack_size);
+    }
+    pthread_create(&t->handle, attr, spawn_thread_helper, t);
+    pthread_attr_destroy(attr);
     return (halide_thread *)t;
 }
 
@@ -91,4 +109,12 @@ WEAK void halide_cond_wait(struct halide_cond *cond, struct halide_mutex *mutex)
     pthread_cond_wait(cond, mutex);
 }
 
+WEAK void halide_thread_yield() {
+    sched_yield();
+}
+
+WEAK uint64_t halide_current_thread_id() {
+    return (uint64_t)pthread_self();
+}
+
 } // extern "C"
@@ -1,6 +1,7 @@
 #include "HalideRuntime.h"
 #include "printer.h"
 #include "scoped_mutex_lock.h"
+#include "scoped_spin_lock.h"
 
 // Note: The profiler thread may out-live any valid user_context, or
 // be used across many different user_contexts, so nothing it calls
@@ -16,6 +17,39 @@ WEAK halide_profiler_state *halide_profiler_get_state() {
 
 namespace Halide { namespace Runtime { namespace Internal {
 
+// Zero the counts of a pipeline and its funcs.
+WEAK void clear_pipeline_stats(halide_profiler_pipeline_stats *p) {
+    p->runs = 0;
+    p->time = 0;
+    p->samples = 0;
+    p->memory_current = 0;
+    p->memory_peak = 0;
+    p->memory_total = 0;
+    p->num_allocs = 0;
+    p->active_threads_numerator = 0;
+    p->active_threads_denominator = 0;
+    p->instructions = 0;
+    p->cycles = 0;
+    p->cache_misses = 0;
+    p->run_start_time = 0;
+    p->num_memory_events = 0;
+    for (int i = 0; i < p->num_funcs; i++) {
+        p->funcs[i].time = 0;
+        p->funcs[i].memory_current = 0;
+        p->funcs[i].memory_peak = 0;
+        p->funcs[i].memory_total = 0;
+        p->funcs[i].memory_at_peak = 0;
+        p->funcs[i].num_allocs = 0;
+        p->funcs[i].stack_peak = 0;
+        p->funcs[i].active_threads_numerator = 0;
+        p->funcs[i].active_threads_denominator = 0;
+        p->funcs[i].instructions = 0;
+        p->funcs[i].cycles = 0;
+        p->funcs[i].cache_misses = 0;
+        p->funcs[i].points = 0;
+    }
+}
+
 WEAK halide_profiler_pipeline_stats *find_or_create_pipeline(const char *pipeline_name, int num_funcs, const uint64_t *func_names) {
     halide_profiler_state *s = halide_profiler_get_state();
 
@@ -36,37 +70,28 @@ WEAK halide_profiler_pipeline_stats *find_or_create_pipeline(const char *pipelin
     p->name = pipeline_name;
     p->first_func_id = s->first_free_id;
     p->num_funcs = num_funcs;
-    p->runs = 0;
-    p->time = 0;
-    p->samples = 0;
-    p->memory_current = 0;
-    p->memory_peak = 0;
-    p->memory_total = 0;
-    p->num_allocs = 0;
-    p->active_threads_numerator = 0;
-    p->active_threads_denominator = 0;
     p->funcs = (halide_profiler_func_stats *)malloc(num_funcs * sizeof(halide_profiler_func_stats));
-    if (!p->funcs) {
+    p->memory_events = (halide_profiler_memory_event *)malloc(halide_profiler_max_memory_events *
+                                                              sizeof(halide_profiler_memory_event));
+    if (!p->funcs || !p->memory_events) {
+        free(p->funcs);
+        free(p->memory_events);
         free(p);
         return NULL;
     }
     for (int i = 0; i < num_funcs; i++) {
-        p->funcs[i].time = 0;
         p->funcs[i].name = (const char *)(func_names[i]);
-        p->funcs[i].memory_current = 0;
-        p->funcs[i].memory_peak = 0;
-        p->funcs[i].memory_total = 0;
-        p->funcs[i].num_allocs = 0;
-        p->funcs[i].stack_peak = 0;
-        p->funcs[i].active_threads_numerator = 0;
-        p->funcs[i].active_threads_denominator = 0;
+        p->funcs[i].bytes_loaded_per_point = 0;
+        p->funcs[i].bytes_stored_per_point = 0;
+        p->funcs[i].ops_per_point = 0;
     }
+    clear_pipeline_stats(p);
     s->first_free_id += num_funcs;
     s->pipelines = p;
     return p;
 }
 
-WEAK void bill_func(halide_profiler_state *s, int func_id, uint64_t time, int active_threads) {
+WEAK halide_profiler_pipeline_stats *find_pipeline_for_func(halide_profiler_state *s, int func_id) {
     halide_profiler_pipeline_stats *p_prev = NULL;
     for (halide_profiler_pipeline_stats *p = s->pipelines; p;
          p = (halide_profiler_pipeline_stats *)(p->next)) {
@@ -77,19 +102,109 @@ WEAK void bill_func(halide_profiler_state *s, int func_id, uint64_t time, int ac
                 p->next = s->pipelines;
                 s->pipelines = p;
             }
-            halide_profiler_func_stats *f = p->funcs + func_id - p->first_func_id;
-            f->time += time;
-            f->active_threads_numerator += active_threads;
-            f->active_threads_denominator += 1;
-            p->time += time;
-            p->samples++;
-            p->active_threads_numerator += active_threads;
-            p->active_threads_denominator += 1;
-            return;
+            return p;
         }
         p_prev = p;
     }
-    // Someone must have called reset_state while a kernel was running. Do nothing.
+    // Someone must have called reset_state while a kernel was running.
+    return NULL;
+}
+
+// Append a heap allocation or free to the memory timeline of a
+// pipeline.
+WEAK void record_memory_event(void *user_context, halide_profiler_pipeline_stats *p, int func_id,
+                              uint64_t bytes, uint64_t memory_current, bool is_free) {
+    int i = __sync_fetch_and_add(&p->num_memory_events, 1);
+    if (i < halide_profiler_max_memory_events) {
+        halide_profiler_memory_event *e = p->memory_events + i;
+        e->time = halide_current_time_ns(user_context) - p->run_start_time;
+        e->bytes = bytes;
+        e->memory_current = memory_current;
+        e->func = func_id;
+        e->is_free = is_free;
+    }
+}
+
+// Record a new peak of the memory allocated by all pipelines, reached
+// by an allocation in the given one, along with what each func had
+// allocated at the time.
+WEAK void update_memory_peak(void *user_context, halide_profiler_state *s, halide_profiler_pipeline_stats *p) {
+    ScopedMutexLock lock(&s->lock);
+    // Another allocation may have got here first, or the memory may
+    // have been freed since.
+    uint64_t current = s->memory_current;
+    if (current <= s->memory_peak) {
+        return;
+    }
+    s->memory_peak = current;
+    s->memory_peak_time = halide_current_time_ns(user_context) - p->run_start_time;
+    s->memory_peak_pipeline = p;
+    for (halide_profiler_pipeline_stats *q = s->pipelines; q;
+         q = (halide_profiler_pipeline_stats *)(q->next)) {
+        for (int i = 0; i < q->num_funcs; i++) {
+            q->funcs[i].memory_at_peak = q->funcs[i].memory_current;
+        }
+    }
+}
+
+// Bill a sample of the given length to a pipeline in which the given
+// number of threads were running.
+WEAK void bill_pipeline(halide_profiler_pipeline_stats *p, uint64_t time, int active_threads) {
+    p->time += time;
+    p->samples++;
+    p->active_threads_numerator += active_threads;
+    p->active_threads_denominator += 1;
+}
+
+// Bill a sample of the given length to a func that the given number
+// of threads were computing.
+WEAK void bill_func(halide_profiler_pipeline_stats *p, int func_id, uint64_t time, int threads) {
+    halide_profiler_func_stats *f = p->funcs + func_id - p->first_func_id;
+    f->time += time * threads;
+    f->active_threads_numerator += threads;
+    f->active_threads_denominator += 1;
+}
+
+// Bill a sample to the funcs the threads in thread_funcs are running.
+WEAK void bill_thread_funcs(halide_profiler_state *s, uint64_t time) {
+    // Gather the running funcs, sorted, so that threads in the same
+    // func are adjacent, as are funcs of the same pipeline.
+    int funcs[halide_profiler_max_threads];
+    int n = 0;
+    for (int i = 0; i < halide_profiler_max_threads; i++) {
+        int f = s->thread_funcs[i];
+        if (f < 0) {
+            continue;
+        }
+        int j = n++;
+        while (j > 0 && funcs[j - 1] > f) {
+            funcs[j] = funcs[j - 1];
+            j--;
+        }
+        funcs[j] = f;
+    }
+
+    int i = 0;
+    while (i < n) {
+        halide_profiler_pipeline_stats *p = find_pipeline_for_func(s, funcs[i]);
+        if (!p) {
+            i++;
+            continue;
+        }
+        int pipeline_end = p->first_func_id + p->num_funcs;
+        int pipeline_threads = 0;
+        while (i < n && funcs[i] < pipeline_end) {
+            int f = funcs[i];
+            int threads = 0;
+            while (i < n && funcs[i] == f) {
+                threads++;
+                i++;
+            }
+            bill_func(p, f, time, threads);
+            pipeline_threads += threads;
+        }
+        bill_pipeline(p, time, pipeline_threads);
+    }
 }
 
 WEAK void sampling_profiler_thread(void *) {
@@ -103,29 +218,33 @@ WEAK void sampling_profiler_thread(void *) {
         uint64_t t1 = halide_current_time_ns(NULL);
         uint64_t t = t1;
         while (1) {
-            int func, active_threads;
+            uint64_t t_now = halide_current_time_ns(NULL);
+            if (s->current_func == halide_profiler_please_stop) {
+                break;
+            }
+            // Assume all time since I was last awake is due to the
+            // currently running funcs.
             if (s->get_remote_profiler_state) {
                 // Execution has disappeared into remote code running
                 // on an accelerator (e.g. Hexagon DSP)
+                int func, active_threads;
                 s->get_remote_profiler_state(&func, &active_threads);
+                halide_profiler_pipeline_stats *p = func >= 0 ? find_pipeline_for_func(s, func) : NULL;
+                if (p) {
+                    // The remote side reports a single func for all
+                    // of its threads.
+                    bill_func(p, func, t_now - t, 1);
+                    bill_pipeline(p, t_now - t, active_threads);
+                }
             } else {
-                func = s->current_func;
-                active_threads = s->active_threads;
-            }
-            uint64_t t_now = halide_current_time_ns(NULL);
-            if (func == halide_profiler_please_stop) {
-                break;
-            } else if (func >= 0) {
-                // Assume all time since I was last awake is due to
-                // the currently running func.
-                bill_func(s, func, t_now - t, active_threads);
+                bill_thread_funcs(s, t_now - t);
             }
             t = t_now;
 
             // Release the lock, sleep, reacquire.
-            int sleep_ms = s->sleep_time;
+            int sleep_us = s->sleep_time_us > 0 ? s->sleep_time_us : s->sleep_time * 1000;
             halide_mutex_unlock(&s->lock);
-            halide_sleep_ms(NULL, sleep_ms);
+            halide_sleep_us(NULL, sleep_us);
             halide_mutex_lock(&s->lock);
         }
     }
@@ -135,6 +254,419 @@ WEAK void sampling_profiler_thread(void *) {
     halide_mutex_unlock(&s->lock);
 }
 
+// With the profile_counters feature, each thread that runs a pipeline
+// opens its own group of hardware counters, and reads it whenever it
+// changes the func it's computing, billing the counts since the last
+// change to the func it was computing. Threads are told apart by OS
+// thread id, so a thread that dies and has its id reused by a new one
+// stops being counted.
+struct thread_counters {
+    uint64_t thread_id;
+    int fd;
+    // The func being counted, or -1 if none, its pipeline, and the
+    // counter values when it started.
+    int func;
+    halide_profiler_pipeline_stats *pipeline;
+    uint64_t start[halide_perf_num_counters];
+};
+
+WEAK thread_counters counted_threads[halide_profiler_max_threads];
+WEAK int num_counted_threads = 0;
+WEAK int counted_threads_lock = 0;
+
+// The calling thread's counters, opening them if this is its first
+// use. Returns NULL if there are no counters to read.
+WEAK thread_counters *get_thread_counters() {
+    if (!halide_perf_counters_open) {
+        return NULL;
+    }
+    uint64_t id = halide_perf_counters_thread_id();
+    // Entries are only ever appended, so this can search without the
+    // lock. A thread only ever finds its own entry.
+    int n = num_counted_threads;
+    for (int i = 0; i < n; i++) {
+        if (counted_threads[i].thread_id == id) {
+            return counted_threads[i].fd < 0 ? NULL : &counted_threads[i];
+        }
+    }
+    ScopedSpinLock lock(&counted_threads_lock);
+    if (num_counted_threads == halide_profiler_max_threads) {
+        return NULL;
+    }
+    thread_counters *c = &counted_threads[num_counted_threads];
+    c->thread_id = id;
+    c->fd = halide_perf_counters_open();
+    c->func = -1;
+    c->pipeline = NULL;
+    __sync_synchronize();
+    num_counted_threads++;
+    return c->fd < 0 ? NULL : c;
+}
+
+// Bill the counts since the last call to the func the thread was
+// computing, and start counting the given one (or none, if -1).
+WEAK void switch_thread_counters(thread_counters *c, halide_profiler_pipeline_stats *p, int func) {
+    if (c->func < 0 && func < 0) {
+        return;
+    }
+    uint64_t now[halide_perf_num_counters];
+    if (halide_perf_counters_read(c->fd, now) != 0) {
+        c->func = -1;
+        return;
+    }
+    if (c->func >= 0) {
+        halide_profiler_pipeline_stats *q = c->pipeline;
+        halide_profiler_func_stats *f = q->funcs + c->func;
+        uint64_t instructions = now[0] - c->start[0];
+        uint64_t cycles = now[1] - c->start[1];
+        uint64_t cache_misses = now[2] - c->start[2];
+        __sync_add_and_fetch(&f->instructions, instructions);
+        __sync_add_and_fetch(&f->cycles, cycles);
+        __sync_add_and_fetch(&f->cache_misses, cache_misses);
+        __sync_add_and_fetch(&q->instructions, instructions);
+        __sync_add_and_fetch(&q->cycles, cycles);
+        __sync_add_and_fetch(&q->cache_misses, cache_misses);
+    }
+    for (int i = 0; i < halide_perf_num_counters; i++) {
+        c->start[i] = now[i];
+    }
+    c->func = func;
+    c->pipeline = p;
+}
+
+// Print the memoization cache statistics of the memoized Funcs in a
+// pipeline.
+WEAK void print_memoization_stats(void *user_context, const char *pipeline_name) {
+    const int max_stats = 64;
+    halide_memoization_cache_func_stats_t stats[max_stats];
+    int num_stats = halide_memoization_cache_get_stats(user_context, stats, max_stats);
+    if (num_stats > max_stats) {
+        num_stats = max_stats;
+    }
+
+    char line_buf[1024];
+    Printer<StringStreamPrinter, sizeof(line_buf)> sstr(user_context, line_buf);
+    for (int i = 0; i < num_stats; i++) {
+        const halide_memoization_cache_func_stats_t &ms = stats[i];
+        if (strcmp(ms.pipeline_name, pipeline_name) != 0) continue;
+        sstr.clear();
+        sstr << "  memoized " << ms.func_name << ":"
+             << "  hits: " << ms.hits
+             << "  misses: " << ms.misses
+             << "  evictions: " << ms.evictions
+             << "  bytes stored: " << ms.bytes_stored
+             << "  cached: " << ms.cached_bytes
+             << "  hashing: " << (float)(ms.hash_time_ns / 1000000.0) << " ms\n";
+        halide_print(user_context, sstr.str());
+    }
+}
+
+// Accumulates a report in a caller-provided buffer, truncating it if
+// it doesn't fit but counting its full length, as snprintf does.
+struct report_writer {
+    char *buf;
+    size_t size;
+    size_t length;
+
+    report_writer(char *buf, size_t size) : buf(buf), size(buf ? size : 0), length(0) {
+        if (this->size) {
+            buf[0] = 0;
+        }
+    }
+
+    void append(const char *str) {
+        size_t n = strlen(str);
+        if (length + 1 < size) {
+            size_t space = size - 1 - length;
+            size_t k = n < space ? n : space;
+            memcpy(buf + length, str, k);
+            buf[length + k] = 0;
+        }
+        length += n;
+    }
+
+    void append_uint(uint64_t x) {
+        char tmp[32];
+        halide_uint64_to_string(tmp, tmp + sizeof(tmp), x, 1);
+        append(tmp);
+    }
+
+    void append_float(double x) {
+        char tmp[64];
+        halide_double_to_string(tmp, tmp + sizeof(tmp), x, 0);
+        append(tmp);
+    }
+
+    // Append a string escaped for use inside a JSON string.
+    void append_escaped(const char *str) {
+        char tmp[2] = {0, 0};
+        for (const char *c = str; *c; c++) {
+            if (*c == '"') {
+                append("\\\"");
+            } else if (*c == '\\') {
+                append("\\\\");
+            } else if ((unsigned char)*c < 0x20) {
+                // Func and pipeline names never contain control
+                // characters, but don't produce invalid JSON if they do.
+                append("?");
+            } else {
+                tmp[0] = *c;
+                append(tmp);
+            }
+        }
+    }
+
+    void append_quoted(const char *str) {
+        append("\"");
+        append_escaped(str);
+        append("\"");
+    }
+
+    // Append "name": for a field of a JSON object, preceded by a comma
+    // unless it's the first.
+    void key(const char *name, bool first = false) {
+        if (!first) {
+            append(", ");
+        }
+        append_quoted(name);
+        append(": ");
+    }
+};
+
+WEAK double average_threads(uint64_t numerator, uint64_t denominator) {
+    return denominator ? (double)numerator / denominator : 0.0;
+}
+
+// The peak bandwidth and arithmetic throughput of the machine, from
+// the state, or from the environment if they aren't set there.
+WEAK void get_roofline(halide_profiler_state *s, double *bytes_per_ns, double *ops_per_ns) {
+    *bytes_per_ns = s->peak_bytes_per_ns;
+    *ops_per_ns = s->peak_ops_per_ns;
+    if (*bytes_per_ns <= 0) {
+        const char *v = getenv("HL_PEAK_BANDWIDTH");
+        *bytes_per_ns = v ? atoi(v) : 0;
+    }
+    if (*ops_per_ns <= 0) {
+        const char *v = getenv("HL_PEAK_OPS");
+        *ops_per_ns = v ? atoi(v) : 0;
+    }
+}
+
+// The fields of a func's stats, common to both report formats.
+WEAK void write_func_fields(report_writer &w, halide_profiler_func_stats *fs) {
+    w.key("name", true);
+    w.append_quoted(fs->name);
+    w.key("time_ns");
+    w.append_uint(fs->time);
+    w.key("average_threads");
+    w.append_float(average_threads(fs->active_threads_numerator, fs->active_threads_denominator));
+    w.key("memory_peak");
+    w.append_uint(fs->memory_peak);
+    w.key("memory_total");
+    w.append_uint(fs->memory_total);
+    w.key("memory_at_peak");
+    w.append_uint(fs->memory_at_peak);
+    w.key("num_allocs");
+    w.append_uint(fs->num_allocs);
+    w.key("stack_peak");
+    w.append_uint(fs->stack_peak);
+    w.key("instructions");
+    w.append_uint(fs->instructions);
+    w.key("cycles");
+    w.append_uint(fs->cycles);
+    w.key("cache_misses");
+    w.append_uint(fs->cache_misses);
+    w.key("bytes_loaded_per_point");
+    w.append_float(fs->bytes_loaded_per_point);
+    w.key("bytes_stored_per_point");
+    w.append_float(fs->bytes_stored_per_point);
+    w.key("ops_per_point");
+    w.append_float(fs->ops_per_point);
+    w.key("points");
+    w.append_uint(fs->points);
+}
+
+WEAK void write_pipeline_fields(report_writer &w, halide_profiler_pipeline_stats *p) {
+    w.key("name", true);
+    w.append_quoted(p->name);
+    w.key("time_ns");
+    w.append_uint(p->time);
+    w.key("runs");
+    w.append_uint(p->runs);
+    w.key("samples");
+    w.append_uint(p->samples);
+    w.key("average_threads");
+    w.append_float(average_threads(p->active_threads_numerator, p->active_threads_denominator));
+    w.key("memory_peak");
+    w.append_uint(p->memory_peak);
+    w.key("memory_total");
+    w.append_uint(p->memory_total);
+    w.key("num_allocs");
+    w.append_uint(p->num_allocs);
+    w.key("instructions");
+    w.append_uint(p->instructions);
+    w.key("cycles");
+    w.append_uint(p->cycles);
+    w.key("cache_misses");
+    w.append_uint(p->cache_misses);
+}
+
+WEAK int recorded_memory_events(halide_profiler_pipeline_stats *p) {
+    return p->num_memory_events < halide_profiler_max_memory_events ?
+        p->num_memory_events : halide_profiler_max_memory_events;
+}
+
+WEAK void write_memory_event_fields(report_writer &w, halide_profiler_pipeline_stats *p,
+                                    halide_profiler_memory_event *e) {
+    w.key("time_ns", true);
+    w.append_uint(e->time);
+    w.key("func");
+    w.append_quoted(p->funcs[e->func].name);
+    w.key("bytes");
+    w.append_uint(e->bytes);
+    w.key("memory_current");
+    w.append_uint(e->memory_current);
+    w.key("free");
+    w.append(e->is_free ? "true" : "false");
+}
+
+WEAK void write_json_report(report_writer &w, halide_profiler_state *s) {
+    w.append("{\"pipelines\": [");
+    bool first_pipeline = true;
+    for (halide_profiler_pipeline_stats *p = s->pipelines; p;
+         p = (halide_profiler_pipeline_stats *)(p->next)) {
+        if (!p->runs) continue;
+        w.append(first_pipeline ? "\n  {" : ",\n  {");
+        first_pipeline = false;
+        write_pipeline_fields(w, p);
+        w.key("funcs");
+        w.append("[");
+        for (int i = 0; i < p->num_funcs; i++) {
+            w.append(i == 0 ? "\n    {" : ",\n    {");
+            write_func_fields(w, p->funcs + i);
+            w.append("}");
+        }
+        w.append("]");
+        w.key("num_memory_events");
+        w.append_uint(p->num_memory_events);
+        w.key("memory_events");
+        w.append("[");
+        for (int i = 0; i < recorded_memory_events(p); i++) {
+            w.append(i == 0 ? "\n    {" : ",\n    {");
+            write_memory_event_fields(w, p, p->memory_events + i);
+            w.append("}");
+        }
+        w.append("]}");
+    }
+    w.append("]");
+    w.key("memory_peak");
+    w.append("{");
+    w.key("bytes", true);
+    w.append_uint(s->memory_peak);
+    if (s->memory_peak_pipeline) {
+        w.key("pipeline");
+        w.append_quoted(s->memory_peak_pipeline->name);
+        w.key("time_ns");
+        w.append_uint(s->memory_peak_time);
+    }
+    w.append("}}\n");
+}
+
+WEAK void write_trace_event(report_writer &w, const char *name, const char *category, int tid,
+                            uint64_t ts_ns, uint64_t dur_ns) {
+    w.key("name", true);
+    w.append_quoted(name);
+    w.key("cat");
+    w.append_quoted(category);
+    w.key("ph");
+    w.append_quoted("X");
+    w.key("pid");
+    w.append_uint(0);
+    w.key("tid");
+    w.append_uint(tid);
+    // Trace timestamps are in microseconds.
+    w.key("ts");
+    w.append_float(ts_ns / 1000.0);
+    w.key("dur");
+    w.append_float(dur_ns / 1000.0);
+}
+
+WEAK void write_track_name(report_writer &w, int tid, const char *name, const char *suffix) {
+    w.append(",\n  {");
+    w.key("name", true);
+    w.append_quoted("thread_name");
+    w.key("ph");
+    w.append_quoted("M");
+    w.key("pid");
+    w.append_uint(0);
+    w.key("tid");
+    w.append_uint(tid);
+    w.key("args");
+    w.append("{");
+    w.key("name", true);
+    w.append("\"");
+    w.append_escaped(name);
+    w.append(suffix);
+    w.append("\"}}");
+}
+
+WEAK void write_chrome_trace_report(report_writer &w, halide_profiler_state *s) {
+    w.append("{\"displayTimeUnit\": \"ns\", \"traceEvents\": [");
+    bool first_event = true;
+    int tid = 0;
+    for (halide_profiler_pipeline_stats *p = s->pipelines; p;
+         p = (halide_profiler_pipeline_stats *)(p->next)) {
+        if (!p->runs) continue;
+        // Each pipeline gets two tracks: one for itself and one for
+        // its funcs.
+        w.append(first_event ? "\n  {" : ",\n  {");
+        first_event = false;
+        write_trace_event(w, p->name, "pipeline", tid, 0, p->time);
+        w.key("args");
+        w.append("{");
+        write_pipeline_fields(w, p);
+        w.append("}}");
+
+        uint64_t ts = 0;
+        for (int i = 0; i < p->num_funcs; i++) {
+            halide_profiler_func_stats *fs = p->funcs + i;
+            if (!fs->time) continue;
+            w.append(",\n  {");
+            write_trace_event(w, fs->name, "func", tid + 1, ts, fs->time);
+            w.key("args");
+            w.append("{");
+            write_func_fields(w, fs);
+            w.append("}}");
+            ts += fs->time;
+        }
+        for (int i = 0; i < recorded_memory_events(p); i++) {
+            halide_profiler_memory_event *e = p->memory_events + i;
+            w.append(",\n  {");
+            w.key("name", true);
+            w.append("\"");
+            w.append_escaped(p->name);
+            w.append(" memory\"");
+            w.key("ph");
+            w.append_quoted("C");
+            w.key("pid");
+            w.append_uint(0);
+            w.key("tid");
+            w.append_uint(tid);
+            w.key("ts");
+            w.append_float(e->time / 1000.0);
+            w.key("args");
+            w.append("{");
+            w.key("bytes", true);
+            w.append_uint(e->memory_current);
+            w.append("}}");
+        }
+        write_track_name(w, tid, p->name, "");
+        write_track_name(w, tid + 1, p->name, " funcs");
+        tid += 2;
+    }
+    w.append("]}\n");
+}
+
 }}}
 
 namespace {
@@ -171,16 +703,32 @@ WEAK halide_profiler_pipeline_stats *halide_profiler_get_pipeline_state(const ch
     return NULL;
 }
 
-// Returns a token identifying this pipeline instance.
+// Returns a token identifying this pipeline instance. pipeline_state
+// is a slot in the generated code, initially null, in which the
+// pipeline's stats are cached. Once it's set, and the profiler thread
+// is running, this doesn't need the lock.
 WEAK int halide_profiler_pipeline_start(void *user_context,
                                         const char *pipeline_name,
                                         int num_funcs,
-                                        const uint64_t *func_names) {
+                                        const uint64_t *func_names,
+                                        void **pipeline_state) {
     halide_profiler_state *s = halide_profiler_get_state();
 
+    halide_profiler_pipeline_stats *cached = *(halide_profiler_pipeline_stats * volatile *)pipeline_state;
+    if (cached && *(volatile bool *)&s->started) {
+        __sync_add_and_fetch(&cached->runs, 1);
+        cached->run_start_time = halide_current_time_ns(user_context);
+        cached->num_memory_events = 0;
+        return cached->first_func_id;
+    }
+
     ScopedMutexLock lock(&s->lock);
 
     if (!s->started) {
+        // No pipeline can be running, so no thread holds a slot.
+        for (int i = 0; i < halide_profiler_max_threads; i++) {
+            s->thread_funcs[i] = halide_profiler_slot_free;
+        }
         halide_start_clock(user_context);
         halide_spawn_thread(sampling_profiler_thread, NULL);
         s->started = true;
@@ -192,11 +740,76 @@ WEAK int halide_profiler_pipeline_start(void *user_context,
         // Allocating space to track the statistics failed.
         return halide_error_out_of_memory(user_context);
     }
-    p->runs++;
+    __sync_add_and_fetch(&p->runs, 1);
+    p->run_start_time = halide_current_time_ns(user_context);
+    p->num_memory_events = 0;
+
+    // Publish the stats only once they're initialized.
+    __sync_synchronize();
+    *(halide_profiler_pipeline_stats * volatile *)pipeline_state = p;
 
     return p->first_func_id;
 }
 
+// Claim a slot in thread_funcs for the calling thread, and return a
+// pointer to it. It is released by halide_profiler_release_thread_slot
+// (registered as a destructor by generated code).
+WEAK int *halide_profiler_claim_thread_slot(halide_profiler_state *s) {
+    for (int i = 0; i < halide_profiler_max_threads; i++) {
+        if (s->thread_funcs[i] == halide_profiler_slot_free &&
+            __sync_bool_compare_and_swap(&s->thread_funcs[i], halide_profiler_slot_free,
+                                         halide_profiler_outside_of_halide)) {
+            return &s->thread_funcs[i];
+        }
+    }
+    return &s->overflow_thread_func;
+}
+
+WEAK void halide_profiler_release_thread_slot(void *user_context, void *slot) {
+    halide_profiler_state *s = halide_profiler_get_state();
+    if (num_counted_threads) {
+        // Bill whatever the thread was computing when it finished.
+        thread_counters *c = get_thread_counters();
+        if (c) {
+            switch_thread_counters(c, NULL, -1);
+        }
+    }
+    if (slot != &s->overflow_thread_func) {
+        __sync_synchronize();
+        *(volatile int *)slot = halide_profiler_slot_free;
+    }
+}
+
+// The same as halide_profiler_set_thread_func, for the
+// profile_counters feature. Also switches the thread's hardware
+// counters to the new func, or stops them if tok is
+// halide_profiler_outside_of_halide.
+WEAK int halide_profiler_set_thread_func_counted(void *pipeline_state, int *slot, int tok, int t) {
+    thread_counters *c = get_thread_counters();
+    if (c) {
+        halide_profiler_pipeline_stats *p = (halide_profiler_pipeline_stats *)pipeline_state;
+        switch_thread_counters(c, p, tok < 0 ? -1 : t);
+    }
+    *(volatile int *)slot = tok + t;
+    return 0;
+}
+
+// Called by generated code at the start of each run of a pipeline, with
+// the compiler's estimates of the bytes loaded and stored and the ops
+// per point of each of its funcs, three floats per func.
+WEAK void halide_profiler_set_func_estimates(void *user_context,
+                                             void *pipeline_state,
+                                             const float *estimates) {
+    halide_profiler_pipeline_stats *p_stats = (halide_profiler_pipeline_stats *) pipeline_state;
+    halide_assert(user_context, p_stats != NULL);
+
+    for (int i = 0; i < p_stats->num_funcs; ++i) {
+        p_stats->funcs[i].bytes_loaded_per_point = estimates[3 * i];
+        p_stats->funcs[i].bytes_stored_per_point = estimates[3 * i + 1];
+        p_stats->funcs[i].ops_per_point = estimates[3 * i + 2];
+    }
+}
+
 WEAK void halide_profiler_stack_peak_update(void *user_context,
                                             void *pipeline_state,
                                             uint64_t *f_values) {
@@ -251,6 +864,16 @@ WEAK void halide_profiler_memory_allocate(void *user_context,
     __sync_add_and_fetch(&f_stats->memory_total, incr);
     uint64_t f_mem_current = __sync_add_and_fetch(&f_stats->memory_current, incr);
     sync_compare_max_and_swap(&f_stats->memory_peak, f_mem_current);
+
+    record_memory_event(user_context, p_stats, func_id, incr, p_mem_current, false);
+
+    // Update the memory stats of all pipelines. A new peak is rare
+    // once the first run has reached it, so it can take the lock.
+    halide_profiler_state *s = halide_profiler_get_state();
+    uint64_t s_mem_current = __sync_add_and_fetch(&s->memory_current, incr);
+    if (s_mem_current > s->memory_peak) {
+        update_memory_peak(user_context, s, p_stats);
+    }
 }
 
 WEAK void halide_profiler_memory_free(void *user_context,
@@ -277,10 +900,14 @@ WEAK void halide_profiler_memory_free(void *user_context,
     // unless user specifically calls halide_profiler_reset().
 
     // Update per-pipeline memory stats
-    __sync_sub_and_fetch(&p_stats->memory_current, decr);
+    uint64_t p_mem_current = __sync_sub_and_fetch(&p_stats->memory_current, decr);
 
     // Update per-func memory stats
     __sync_sub_and_fetch(&f_stats->memory_current, decr);
+
+    record_memory_event(user_context, p_stats, func_id, decr, p_mem_current, true);
+
+    __sync_sub_and_fetch(&halide_profiler_get_state()->memory_current, decr);
 }
 
 WEAK void halide_profiler_report_unlocked(void *user_context, halide_profiler_state *s) {
@@ -288,6 +915,9 @@ WEAK void halide_profiler_report_unlocked(void *user_context, halide_profiler_st
     char line_buf[1024];
     Printer<StringStreamPrinter, sizeof(line_buf)> sstr(user_context, line_buf);
 
+    double peak_bytes_per_ns, peak_ops_per_ns;
+    get_roofline(s, &peak_bytes_per_ns, &peak_ops_per_ns);
+
     for (halide_profiler_pipeline_stats *p = s->pipelines; p;
          p = (halide_profiler_pipeline_stats *)(p->next)) {
         float t = p->time / 1000000.0f;
@@ -309,6 +939,16 @@ WEAK void halide_profiler_report_unlocked(void *user_context, halide_profiler_st
         }
         sstr << " heap allocations: " << p->num_allocs
              << "  peak heap usage: " << p->memory_peak << " bytes\n";
+        if (p->instructions) {
+            sstr << " instructions/run: " << p->instructions / p->runs
+                 << "  ipc: " << (float)p->instructions / (p->cycles + 1e-10f);
+            // Code offloaded to Hexagon counts packets and cycles, but
+            // not cache misses.
+            if (p->cache_misses) {
+                sstr << "  llc misses/kinst: " << (1000.0f * p->cache_misses) / p->instructions;
+            }
+            sstr << "\n";
+        }
         halide_print(user_context, sstr.str());
 
         bool print_f_states = p->time || p->memory_total;
@@ -323,6 +963,12 @@ WEAK void halide_profiler_report_unlocked(void *user_context, halide_profiler_st
         }
 
         if (print_f_states) {
+            // Func times are summed over threads, so in parallel code
+            // they can add up to more than the pipeline's time.
+            uint64_t total_func_time = 0;
+            for (int i = 0; i < p->num_funcs; i++) {
+                total_func_time += p->funcs[i].time;
+            }
             for (int i = 0; i < p->num_funcs; i++) {
                 size_t cursor = 0;
                 sstr.clear();
@@ -345,8 +991,8 @@ WEAK void halide_profiler_report_unlocked(void *user_context, halide_profiler_st
                 while (sstr.size() < cursor) sstr << " ";
 
                 int percent = 0;
-                if (p->time != 0) {
-                    percent = (100*fs->time) / p->time;
+                if (total_func_time != 0) {
+                    percent = (100*fs->time) / total_func_time;
                 }
                 sstr << "(" << percent << "%)";
                 cursor += 8;
@@ -373,15 +1019,82 @@ WEAK void halide_profiler_report_unlocked(void *user_context, halide_profiler_st
                     cursor += 15;
                     while (sstr.size() < cursor) sstr << " ";
                     sstr << " avg: " << alloc_avg;
+                    if (fs->memory_at_peak) {
+                        sstr << " at peak: " << fs->memory_at_peak;
+                    }
                 }
                 if (fs->stack_peak > 0) {
                     sstr << " stack: " << fs->stack_peak;
                 }
+                if (fs->instructions) {
+                    // Each miss moves a cache line (assumed 64 bytes)
+                    // from memory. Dividing by the func's time, which
+                    // is summed over threads, gives the bandwidth per
+                    // thread.
+                    float ipc = (float)fs->instructions / (fs->cycles + 1e-10f);
+                    sstr << " ipc: " << ipc;
+                    sstr.erase(4);
+                    if (fs->cache_misses) {
+                        float mpki = (1000.0f * fs->cache_misses) / fs->instructions;
+                        float bandwidth = (64.0f * fs->cache_misses) / (fs->time + 1e-10f);
+                        sstr << " mpki: " << mpki;
+                        sstr.erase(4);
+                        sstr << " GB/s/thread: " << bandwidth;
+                        sstr.erase(4);
+                    }
+                }
+                if (fs->points && fs->time) {
+                    // The throughput the func achieved, going by the
+                    // compiler's estimates of its work per point. Its
+                    // time is summed over its threads, so divide by
+                    // their average number for its wall-clock time.
+                    double threads = average_threads(fs->active_threads_numerator, fs->active_threads_denominator);
+                    double wall_ns = fs->time / (threads > 1 ? threads : 1);
+                    double bytes = (double)(fs->bytes_loaded_per_point + fs->bytes_stored_per_point) * fs->points;
+                    double ops = (double)fs->ops_per_point * fs->points;
+                    sstr << " GB/s: " << (float)(bytes / wall_ns);
+                    sstr.erase(4);
+                    sstr << " Gop/s: " << (float)(ops / wall_ns);
+                    sstr.erase(4);
+                    if (peak_bytes_per_ns > 0 && peak_ops_per_ns > 0) {
+                        // Under the roofline model, the func takes at
+                        // least as long as moving its bytes at peak
+                        // bandwidth, and as doing its ops at peak
+                        // throughput.
+                        double bound_ns = bytes / peak_bytes_per_ns;
+                        if (ops / peak_ops_per_ns > bound_ns) {
+                            bound_ns = ops / peak_ops_per_ns;
+                        }
+                        sstr << " roofline: " << (int)(100 * bound_ns / wall_ns) << "%";
+                    }
+                }
                 sstr << "\n";
 
                 halide_print(user_context, sstr.str());
             }
         }
+
+        print_memoization_stats(user_context, p->name);
+    }
+
+    if (s->memory_peak_pipeline) {
+        // Which allocations set the high-water mark of the process.
+        sstr.clear();
+        sstr << "peak heap usage of all pipelines: " << s->memory_peak << " bytes, "
+             << (float)(s->memory_peak_time / 1000000.0) << " ms into a run of "
+             << s->memory_peak_pipeline->name << "\n";
+        halide_print(user_context, sstr.str());
+        for (halide_profiler_pipeline_stats *p = s->pipelines; p;
+             p = (halide_profiler_pipeline_stats *)(p->next)) {
+            for (int i = 0; i < p->num_funcs; i++) {
+                halide_profiler_func_stats *fs = p->funcs + i;
+                if (fs->memory_at_peak) {
+                    sstr.clear();
+                    sstr << "  " << p->name << "/" << fs->name << ": " << fs->memory_at_peak << " bytes\n";
+                    halide_print(user_context, sstr.str());
+                }
+            }
+        }
     }
 }
 
@@ -391,6 +1104,22 @@ WEAK void halide_profiler_report(void *user_context) {
     halide_profiler_report_unlocked(user_context, s);
 }
 
+WEAK int halide_profiler_format_report(void *user_context, halide_profiler_report_format_t format,
+                                       char *buf, size_t size) {
+    halide_profiler_state *s = halide_profiler_get_state();
+    ScopedMutexLock lock(&s->lock);
+    report_writer w(buf, size);
+    if (format == halide_profiler_report_json) {
+        write_json_report(w, s);
+    } else if (format == halide_profiler_report_chrome_trace) {
+        write_chrome_trace_report(w, s);
+    } else {
+        error(user_context) << "Unknown profiler report format: " << (int)format << "\n";
+        return halide_error_code_generic_error;
+    }
+    return (int)w.length;
+}
+
 
 WEAK void halide_profiler_reset() {
     // WARNING: Do not call this method while any other halide
@@ -401,13 +1130,16 @@ WEAK void halide_profiler_reset() {
 
     ScopedMutexLock lock(&s->lock);
 
-    while (s->pipelines) {
-        halide_profiler_pipeline_stats *p = s->pipelines;
-        s->pipelines = (halide_profiler_pipeline_stats *)(p->next);
-        free(p->funcs);
-        free(p);
+    // Generated code caches pointers to the pipeline stats, so they
+    // stay allocated, and keep their func ids.
+    for (halide_profiler_pipeline_stats *p = s->pipelines; p;
+         p = (halide_profiler_pipeline_stats *)(p->next)) {
+        clear_pipeline_stats(p);
     }
-    s->first_free_id = 0;
+    s->memory_current = 0;
+    s->memory_peak = 0;
+    s->memory_peak_time = 0;
+    s->memory_peak_pipeline = NULL;
 }
 
 namespace {
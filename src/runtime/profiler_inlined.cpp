@@ -12,6 +12,23 @@ WEAK __attribute__((always_inline)) int halide_profiler_set_current_func(halide_
     return 0;
 }
 
+// The same as above, for a thread's own slot in state->thread_funcs.
+WEAK __attribute__((always_inline)) int halide_profiler_set_thread_func(int *slot, int tok, int t) {
+    volatile int *ptr = slot;
+    asm volatile ("":::);
+    *ptr = tok + t;
+    asm volatile ("":::);
+    return 0;
+}
+
+// Add to the number of points computed by a func of the pipeline with
+// the given stats.
+WEAK __attribute__((always_inline)) int halide_profiler_count_points(void *pipeline_state, int func, uint64_t points) {
+    halide_profiler_pipeline_stats *p = (halide_profiler_pipeline_stats *)pipeline_state;
+    __sync_fetch_and_add(&(p->funcs[func].points), points);
+    return 0;
+}
+
 WEAK __attribute__((always_inline)) int halide_profiler_incr_active_threads(halide_profiler_state *state) {
     volatile int *ptr = &(state->active_threads);
     asm volatile ("":::);
@@ -52,6 +52,65 @@ WEAK void halide_qurt_hvx_unlock_as_destructor(void *user_context, void * /*obj*
     halide_qurt_hvx_unlock(user_context);
 }
 
+}
+
+namespace Halide { namespace Runtime { namespace Internal { namespace Qurt {
+
+// The VTCM manager is only available on v65 and later, so look it up
+// rather than linking against it.
+typedef void *(*request_vtcm_fn)(unsigned int, unsigned int);
+typedef int (*release_vtcm_fn)(void *);
+WEAK request_vtcm_fn request_vtcm = NULL;
+WEAK release_vtcm_fn release_vtcm = NULL;
+WEAK bool vtcm_initialized = false;
+
+// The live VTCM allocations, so halide_vtcm_free knows which
+// pointers came from the heap instead. There can't be many, as VTCM
+// is small.
+const int max_vtcm_allocations = 16;
+WEAK void *vtcm_allocations[max_vtcm_allocations];
+
+}}}}  // namespace Halide::Runtime::Internal::Qurt
+
+extern "C" {
+
+WEAK void *halide_vtcm_malloc(void *user_context, size_t x) {
+    if (!vtcm_initialized) {
+        request_vtcm = (request_vtcm_fn)halide_get_symbol("HAP_request_VTCM");
+        release_vtcm = (release_vtcm_fn)halide_get_symbol("HAP_release_VTCM");
+        debug(user_context) << "QuRT: HAP_request_VTCM -> " << (void *)request_vtcm << "\n";
+        vtcm_initialized = true;
+    }
+
+    if (request_vtcm && release_vtcm) {
+        for (int i = 0; i < max_vtcm_allocations; i++) {
+            if (vtcm_allocations[i]) continue;
+            // Only try to claim the slot once we have the memory.
+            void *ptr = request_vtcm(x, /* single_page_flag */ 1);
+            if (!ptr) break;
+            if (__sync_bool_compare_and_swap(vtcm_allocations + i, NULL, ptr)) {
+                debug(user_context) << "QuRT: halide_vtcm_malloc(" << (uint64_t)x << ") -> " << ptr << "\n";
+                return ptr;
+            }
+            release_vtcm(ptr);
+        }
+    }
+
+    debug(user_context) << "QuRT: no VTCM for " << (uint64_t)x << " bytes, falling back to halide_malloc\n";
+    return halide_malloc(user_context, x);
+}
+
+WEAK void halide_vtcm_free(void *user_context, void *ptr) {
+    for (int i = 0; i < max_vtcm_allocations; i++) {
+        if (ptr && vtcm_allocations[i] == ptr) {
+            release_vtcm(ptr);
+            vtcm_allocations[i] = NULL;
+            return;
+        }
+    }
+    halide_free(user_context, ptr);
+}
+
 WEAK int halide_prefetch_2d(const void *ptr, int width_bytes, int height, int stride_bytes) {
     // Notes:
     //  - Prefetches can be queued up to 3 deep (MAX_PREFETCH)
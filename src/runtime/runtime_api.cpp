@@ -15,22 +15,34 @@
 // cat src/runtime/runtime_internal.h src/runtime/HalideRuntime*.h | grep "^[^ ][^(]*halide_[^ ]*(" | grep -v '#define' | sed "s/[^(]*halide/halide/" | sed "s/(.*//" | sed "s/^h/    \(void *)\&h/" | sed "s/$/,/" | sort | uniq
 
 extern "C" __attribute__((used)) void *halide_runtime_api_functions[] = {
+    (void *)&halide_buffer_copy,
     (void *)&halide_can_use_target_features,
+    (void *)&halide_cancel,
+    (void *)&halide_cancellation_check,
+    (void *)&halide_clear_cancellation,
     (void *)&halide_cond_broadcast,
     (void *)&halide_cond_destroy,
     (void *)&halide_cond_init,
     (void *)&halide_cond_wait,
     (void *)&halide_copy_to_device,
+    (void *)&halide_copy_to_device_region,
     (void *)&halide_copy_to_host,
     (void *)&halide_create_temp_file,
+    (void *)&halide_cuda_acquire_context,
     (void *)&halide_cuda_detach_device_ptr,
     (void *)&halide_cuda_device_interface,
     (void *)&halide_cuda_get_device_ptr,
+    (void *)&halide_cuda_get_stream,
     (void *)&halide_cuda_initialize_kernels,
+    (void *)&halide_cuda_join_devices,
+    (void *)&halide_cuda_release_context,
+    (void *)&halide_cuda_release_unused_device_allocations,
     (void *)&halide_cuda_run,
+    (void *)&halide_cuda_set_launch_device,
     (void *)&halide_cuda_wrap_device_ptr,
     (void *)&halide_current_time_ns,
     (void *)&halide_debug_to_file,
+    (void *)&halide_debug_to_file_flush,
     (void *)&halide_default_can_use_target_features,
     (void *)&halide_device_and_host_free,
     (void *)&halide_device_and_host_free_as_destructor,
@@ -41,9 +53,15 @@ extern "C" __attribute__((used)) void *halide_runtime_api_functions[] = {
     (void *)&halide_device_malloc,
     (void *)&halide_device_release,
     (void *)&halide_device_sync,
+    (void *)&halide_do_async,
+    (void *)&halide_do_batch,
+    (void *)&halide_do_concurrent_tasks,
     (void *)&halide_do_par_for,
+    (void *)&halide_do_par_for_adaptive,
     (void *)&halide_do_task,
     (void *)&halide_double_to_string,
+    (void *)&halide_downgrade_buffer_t,
+    (void *)&halide_enable_workspace,
     (void *)&halide_error,
     (void *)&halide_error_access_out_of_bounds,
     (void *)&halide_error_bad_elem_size,
@@ -67,6 +85,7 @@ extern "C" __attribute__((used)) void *halide_runtime_api_functions[] = {
     (void *)&halide_error_param_too_small_i64,
     (void *)&halide_error_param_too_small_u64,
     (void *)&halide_error_requirement_failed,
+    (void *)&halide_error_too_many_dimensions,
     (void *)&halide_error_unaligned_host_ptr,
     (void *)&halide_float16_bits_to_double,
     (void *)&halide_float16_bits_to_float,
@@ -75,6 +94,7 @@ extern "C" __attribute__((used)) void *halide_runtime_api_functions[] = {
     (void *)&halide_get_gpu_device,
     (void *)&halide_get_library_symbol,
     (void *)&halide_get_symbol,
+    (void *)&halide_get_thread_pool_stats,
     (void *)&halide_get_trace_file,
     (void *)&halide_hexagon_detach_device_handle,
     (void *)&halide_hexagon_device_interface,
@@ -88,6 +108,8 @@ extern "C" __attribute__((used)) void *halide_runtime_api_functions[] = {
     (void *)&halide_hexagon_power_hvx_on_mode,
     (void *)&halide_hexagon_power_hvx_on_perf,
     (void *)&halide_hexagon_run,
+    (void *)&halide_hexagon_set_arena_size,
+    (void *)&halide_hexagon_set_power_policy,
     (void *)&halide_hexagon_wrap_device_handle,
     (void *)&halide_int64_to_string,
     (void *)&halide_join_thread,
@@ -95,10 +117,14 @@ extern "C" __attribute__((used)) void *halide_runtime_api_functions[] = {
     (void *)&halide_malloc,
     (void *)&halide_matlab_call_pipeline,
     (void *)&halide_memoization_cache_cleanup,
+    (void *)&halide_memoization_cache_get_stats,
     (void *)&halide_memoization_cache_lookup,
     (void *)&halide_memoization_cache_release,
+    (void *)&halide_memoization_cache_set_num_buckets,
+    (void *)&halide_memoization_cache_set_shared_file,
     (void *)&halide_memoization_cache_set_size,
     (void *)&halide_memoization_cache_store,
+    (void *)&halide_merge_host_region,
     (void *)&halide_metal_acquire_context,
     (void *)&halide_metal_detach_buffer,
     (void *)&halide_metal_device_interface,
@@ -107,6 +133,7 @@ extern "C" __attribute__((used)) void *halide_runtime_api_functions[] = {
     (void *)&halide_metal_release_context,
     (void *)&halide_metal_run,
     (void *)&halide_metal_wrap_buffer,
+    (void *)&halide_metal_wrap_host_memory,
     (void *)&halide_msan_annotate_buffer_is_initialized,
     (void *)&halide_msan_annotate_buffer_is_initialized_as_destructor,
     (void *)&halide_msan_annotate_memory_is_initialized,
@@ -119,10 +146,15 @@ extern "C" __attribute__((used)) void *halide_runtime_api_functions[] = {
     (void *)&halide_opencl_get_device_type,
     (void *)&halide_opencl_get_platform_name,
     (void *)&halide_opencl_initialize_kernels,
+    (void *)&halide_opencl_release_host_memory,
+    (void *)&halide_opencl_release_unused_device_allocations,
     (void *)&halide_opencl_run,
+    (void *)&halide_opencl_set_background_build,
     (void *)&halide_opencl_set_device_type,
+    (void *)&halide_opencl_set_out_of_order_queue,
     (void *)&halide_opencl_set_platform_name,
     (void *)&halide_opencl_wrap_cl_mem,
+    (void *)&halide_opencl_wrap_host_memory,
     (void *)&halide_opengl_context_lost,
     (void *)&halide_opengl_create_context,
     (void *)&halide_opengl_detach_texture,
@@ -131,25 +163,43 @@ extern "C" __attribute__((used)) void *halide_runtime_api_functions[] = {
     (void *)&halide_opengl_get_texture,
     (void *)&halide_opengl_initialize_kernels,
     (void *)&halide_opengl_run,
+    (void *)&halide_opengl_set_double_buffered_readback,
     (void *)&halide_opengl_wrap_render_target,
     (void *)&halide_opengl_wrap_texture,
     (void *)&halide_openglcompute_device_interface,
     (void *)&halide_openglcompute_initialize_kernels,
     (void *)&halide_openglcompute_run,
+    (void *)&halide_pgo_register,
+    (void *)&halide_pgo_reset,
+    (void *)&halide_pgo_write_profile,
     (void *)&halide_pointer_to_string,
+    (void *)&halide_pool_allocator_release_unused,
+    (void *)&halide_pool_free,
+    (void *)&halide_pool_malloc,
     (void *)&halide_print,
+    (void *)&halide_profiler_claim_thread_slot,
+    (void *)&halide_profiler_format_report,
     (void *)&halide_profiler_get_pipeline_state,
     (void *)&halide_profiler_get_state,
     (void *)&halide_profiler_memory_allocate,
     (void *)&halide_profiler_memory_free,
     (void *)&halide_profiler_pipeline_start,
+    (void *)&halide_profiler_release_thread_slot,
     (void *)&halide_profiler_report,
     (void *)&halide_profiler_reset,
+    (void *)&halide_profiler_set_func_estimates,
+    (void *)&halide_profiler_set_thread_func_counted,
     (void *)&halide_profiler_stack_peak_update,
     (void *)&halide_qurt_hvx_lock,
     (void *)&halide_qurt_hvx_unlock,
     (void *)&halide_qurt_hvx_unlock_as_destructor,
     (void *)&halide_release_jit_module,
+    (void *)&halide_release_workspace,
+    (void *)&halide_reset_thread_pool_stats,
+    (void *)&halide_semaphore_abandon,
+    (void *)&halide_semaphore_acquire,
+    (void *)&halide_semaphore_init,
+    (void *)&halide_semaphore_release,
     (void *)&halide_set_custom_can_use_target_features,
     (void *)&halide_set_custom_do_par_for,
     (void *)&halide_set_custom_do_task,
@@ -160,18 +210,30 @@ extern "C" __attribute__((used)) void *halide_runtime_api_functions[] = {
     (void *)&halide_set_custom_malloc,
     (void *)&halide_set_custom_print,
     (void *)&halide_set_custom_trace,
+    (void *)&halide_set_deadline,
+    (void *)&halide_set_debug_to_file_async,
     (void *)&halide_set_error_handler,
     (void *)&halide_set_gpu_device,
+    (void *)&halide_set_gpu_kernel_cache_dir,
+    (void *)&halide_set_large_allocation_policy,
     (void *)&halide_set_num_threads,
+    (void *)&halide_set_pinned_host_allocations,
+    (void *)&halide_set_thread_pool_priority,
+    (void *)&halide_set_thread_pool_spin_count,
     (void *)&halide_set_trace_file,
+    (void *)&halide_set_trace_index_file,
+    (void *)&halide_set_trace_timeline_file,
+    (void *)&halide_set_zero_copy_host_allocations,
     (void *)&halide_shutdown_thread_pool,
     (void *)&halide_shutdown_trace,
     (void *)&halide_sleep_ms,
+    (void *)&halide_sleep_us,
     (void *)&halide_spawn_thread,
     (void *)&halide_start_clock,
     (void *)&halide_string_to_string,
     (void *)&halide_trace,
     (void *)&halide_trace_helper,
     (void *)&halide_uint64_to_string,
+    (void *)&halide_upgrade_buffer_t,
     (void *)&halide_use_jit_module,
 };
@@ -103,9 +103,30 @@ WEAK void *halide_load_library(const char *name);
 // If lib is NULL, this call should be equivalent to halide_get_symbol(name).
 WEAK void *halide_get_library_symbol(void *lib, const char *name);
 
+// Map a file of the given size into memory, shared with any other
+// process that maps it. Creates the file if it doesn't exist. Returns
+// NULL on failure. Not available on all platforms.
+WEAK void *halide_map_shared_memory(void *user_context, const char *path, size_t size);
+WEAK void halide_unmap_shared_memory(void *user_context, void *addr, size_t size);
+
+// Allocate memory directly from the OS, backed by huge pages where
+// possible. Returns NULL on failure. Not available on all platforms.
+WEAK void *halide_allocate_huge_pages(size_t size);
+WEAK void halide_free_huge_pages(void *ptr, size_t size);
+
+// Open a group of hardware performance counters counting the calling
+// thread's instructions retired, cycles and last-level cache misses,
+// in that order. Returns the group's file descriptor, or -1 if the
+// counters aren't available. Not available on all platforms.
+enum { halide_perf_num_counters = 3 };
+WEAK int halide_perf_counters_open();
+WEAK int halide_perf_counters_read(int fd, uint64_t *values);
+WEAK uint64_t halide_perf_counters_thread_id();
+
 WEAK int halide_start_clock(void *user_context);
 WEAK int64_t halide_current_time_ns(void *user_context);
 WEAK void halide_sleep_ms(void *user_context, int ms);
+WEAK void halide_sleep_us(void *user_context, int us);
 WEAK void halide_device_free_as_destructor(void *user_context, void *obj);
 WEAK void halide_device_and_host_free_as_destructor(void *user_context, void *obj);
 WEAK void halide_device_host_nop_free(void *user_context, void *obj);
@@ -115,6 +136,9 @@ WEAK void halide_device_host_nop_free(void *user_context, void *obj);
 WEAK void halide_profiler_stack_peak_update(void *user_context,
                                             void *pipeline_state,
                                             uint64_t *f_values);
+WEAK void halide_profiler_set_func_estimates(void *user_context,
+                                             void *pipeline_state,
+                                             const float *estimates);
 WEAK void halide_profiler_memory_allocate(void *user_context,
                                           void *pipeline_state,
                                           int func_id,
@@ -126,8 +150,17 @@ WEAK void halide_profiler_memory_free(void *user_context,
 WEAK int halide_profiler_pipeline_start(void *user_context,
                                         const char *pipeline_name,
                                         int num_funcs,
-                                        const uint64_t *func_names);
+                                        const uint64_t *func_names,
+                                        void **pipeline_state);
+WEAK int *halide_profiler_claim_thread_slot(struct halide_profiler_state *s);
+WEAK void halide_profiler_release_thread_slot(void *user_context, void *slot);
+WEAK int halide_profiler_set_thread_func_counted(void *pipeline_state, int *slot, int tok, int t);
 WEAK int halide_host_cpu_count();
+// The NUMA node that the given cpu belongs to, or -1 if unknown.
+WEAK int halide_host_cpu_numa_node(int cpu);
+// Restrict the calling thread to run on the given cpu. Returns zero
+// on success. A no-op on platforms that don't support it.
+WEAK int halide_pin_current_thread_to_cpu(int cpu);
 
 WEAK int halide_device_and_host_malloc(void *user_context, struct buffer_t *buf,
                                        const struct halide_device_interface_t *device_interface);
@@ -151,6 +184,13 @@ WEAK void halide_cond_destroy(struct halide_cond *cond);
 WEAK void halide_cond_broadcast(struct halide_cond *cond);
 WEAK void halide_cond_wait(struct halide_cond *cond, struct halide_mutex *mutex);
 
+// Give up the rest of the calling thread's time slice.
+WEAK void halide_thread_yield();
+
+// An id for the calling thread, unique among the threads running. Not
+// available on all platforms.
+WEAK uint64_t halide_current_thread_id();
+
 WEAK int halide_trace_helper(void *user_context,
                              const char *func,
                              void *value, int *coords,
@@ -1,5 +1,7 @@
 #include "HalideRuntime.h"
 #include "thread_pool_common.h"
+#include "concurrent_tasks_common.h"
+#include "adaptive_par_for.h"
 
 extern "C" {
 
@@ -37,4 +39,13 @@ WEAK int halide_do_par_for(void *user_context, halide_task_t f,
   return (*custom_do_par_for)(user_context, f, min, size, closure);
 }
 
+WEAK int halide_do_par_for_adaptive(void *user_context, halide_loop_task_t f,
+                                    int min, int size, uint8_t *closure) {
+    halide_mutex_lock(&work_queue.mutex);
+    init_work_queue_already_locked();
+    int num_workers = work_queue.desired_num_threads;
+    halide_mutex_unlock(&work_queue.mutex);
+    return do_par_for_adaptive(user_context, f, min, size, closure, num_workers);
+}
+
 } // extern "C"
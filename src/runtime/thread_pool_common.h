@@ -1,19 +1,88 @@
 
 namespace Halide { namespace Runtime { namespace Internal {
 
+// The index range of each job is divided into contiguous slices, one
+// per participating thread (up to MAX_SLICES). Each thread claims
+// tasks from the front of its home slice with an atomic increment, so
+// claiming a task never takes the work queue lock. When its home
+// slice is empty, a thread steals from the other slices of the same
+// job.
+#define MAX_SLICES 64
+struct work_slice {
+    // The next unclaimed index in this slice. Only ever incremented
+    // atomically, so it may run past end.
+    int next;
+    int end;
+};
+
 struct work {
     work *next_job;
     int (*f)(void *, int, uint8_t *);
     void *user_context;
-    int next, max;
+    work_slice slices[MAX_SLICES];
+    int num_slices;
     uint8_t *closure;
     int active_workers;
     int exit_status;
-    bool running() { return next < max || active_workers > 0; }
+
+    // Set once a task fails or the job is cancelled. No more tasks
+    // are handed out after that, but tasks already running finish.
+    bool abandoned;
+
+    // Jobs pushed by halide_do_async have no owner waiting on
+    // them. Instead, whichever thread finishes them last calls this
+    // callback and then frees the job.
+    void (*completion)(void *completion_context, int result);
+    void *completion_context;
+
+    // Jobs with higher priority are picked first. At most
+    // max_workers threads work on the job at once (zero means no
+    // limit). See halide_set_thread_pool_priority.
+    int priority;
+    int max_workers;
+
+    // Claim an index to work on, starting with the given home slice
+    // and then stealing from the others. Returns false if every slice
+    // is exhausted or the job has been abandoned. Does not require the
+    // work queue lock.
+    bool claim(int home, int *idx) {
+        if (abandoned) return false;
+        for (int i = 0; i < num_slices; i++) {
+            work_slice &s = slices[(home + i) % num_slices];
+            // Cheap check first to avoid bumping the counters of
+            // exhausted slices.
+            if (s.next >= s.end) continue;
+            int n = __sync_fetch_and_add(&s.next, 1);
+            if (n < s.end) {
+                *idx = n;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool tasks_pending() {
+        if (abandoned) return false;
+        for (int i = 0; i < num_slices; i++) {
+            if (slices[i].next < slices[i].end) return true;
+        }
+        return false;
+    }
+
+    bool running() { return tasks_pending() || active_workers > 0; }
+};
+
+// The work queue and thread pool is weak, so one big work queue is
+// shared by all halide functions. The worker array grows on demand;
+// MAX_THREADS is only a sanity bound on halide_set_num_threads.
+#define MAX_THREADS 1024
+#define MAX_PRIORITY_ENTRIES 16
+struct priority_entry {
+    void *user_context;
+    int priority;
+    int max_workers;
 };
 
-// The work queue and thread pool is weak, so one big work queue is shared by all halide functions
-#define MAX_THREADS 64
 struct work_queue_t {
     // all fields are protected by this mutex.
     halide_mutex mutex;
@@ -39,12 +108,41 @@ struct work_queue_t {
     // more threads are required than are currently in the A team.
     halide_cond wakeup_b_team;
 
-    // Keep track of threads so they can be joined at shutdown
-    halide_thread *threads[MAX_THREADS];
+    // Keep track of threads so they can be joined at shutdown. Grown
+    // as desired_num_threads increases.
+    halide_thread **threads;
+    int threads_capacity;
 
     // The number threads created
     int threads_created;
 
+    // If set (via HL_NUMA_AWARE=1), worker threads are pinned to
+    // cores, ordered so that consecutive worker ids share a NUMA
+    // node. Since each worker's home slice of a job is chosen by
+    // worker id, contiguous ranges of a parallel loop then run on the
+    // same node, and first-touch allocations stay node-local.
+    bool numa_aware;
+
+    // The cpu each worker is pinned to when numa_aware is set,
+    // indexed by worker id modulo num_cpus.
+    int *worker_cpus;
+    int num_cpus;
+
+    // How many times an idle thread polls for new work (yielding in
+    // between) before going to sleep on a condition variable. Set via
+    // HL_SPIN_COUNT or halide_set_thread_pool_spin_count.
+    int spin_count;
+    bool spin_count_set;
+
+    // Statistics about how idle threads were woken. See
+    // halide_get_thread_pool_stats.
+    halide_thread_pool_stats_t stats;
+
+    // Priorities and worker quotas for jobs, keyed by the
+    // user_context they were launched with.
+    priority_entry priorities[MAX_PRIORITY_ENTRIES];
+    int num_priorities;
+
     // The desired number threads doing work.
     int desired_num_threads;
 
@@ -88,15 +186,170 @@ WEAK int default_desired_num_threads() {
     return desired_num_threads;
 }
 
-WEAK void worker_thread_already_locked(work *owned_job) {
+// Build the worker -> cpu mapping used in NUMA-aware mode: all the
+// cpus of node 0, then all the cpus of node 1, and so on. Must be
+// called with the work queue lock held.
+WEAK void init_worker_cpus_already_locked() {
+    int n = halide_host_cpu_count();
+    if (n < 1) {
+        work_queue.numa_aware = false;
+        return;
+    }
+    work_queue.worker_cpus = (int *)malloc(n * sizeof(int));
+    work_queue.num_cpus = n;
+    int *nodes = (int *)malloc(n * sizeof(int));
+    int max_node = 0;
+    for (int i = 0; i < n; i++) {
+        nodes[i] = halide_host_cpu_numa_node(i);
+        max_node = max(max_node, nodes[i]);
+    }
+    int k = 0;
+    for (int node = 0; node <= max_node; node++) {
+        for (int i = 0; i < n; i++) {
+            if (nodes[i] == node) {
+                work_queue.worker_cpus[k++] = i;
+            }
+        }
+    }
+    // Any cpus with an unknown (negative) node go at the end.
+    for (int i = 0; i < n; i++) {
+        if (nodes[i] < 0) {
+            work_queue.worker_cpus[k++] = i;
+        }
+    }
+    free(nodes);
+}
+
+WEAK int default_spin_count() {
+    char *spin_str = getenv("HL_SPIN_COUNT");
+    return spin_str ? atoi(spin_str) : 0;
+}
+
+// Release the lock and poll for a while for something to do, yielding
+// in between polls: a job being pushed, or for a job owner, its job
+// completing. Returns true if the wait ended without having to sleep. The
+// lock is held again on return. The unlocked reads here are only
+// hints; the caller rechecks everything with the lock held.
+WEAK bool spin_wait_already_locked(work *owned_job, int spins) {
+    if (spins <= 0) return false;
+    halide_mutex_unlock(&work_queue.mutex);
+    bool found = false;
+    for (int i = 0; i < spins && !found; i++) {
+        // The call to halide_thread_yield below is opaque to the
+        // compiler, so these loads are redone on every iteration.
+        found = work_queue.jobs != NULL || work_queue.shutdown ||
+            (owned_job != NULL && !owned_job->running());
+        if (!found) {
+            halide_thread_yield();
+        }
+    }
+    halide_mutex_lock(&work_queue.mutex);
+    return found;
+}
+
+// Find the highest priority job that still has unclaimed tasks and
+// room for another worker, unlinking any exhausted jobs from the stack
+// along the way. Among jobs of equal priority, the most recently
+// pushed one wins. Must be called with the work queue lock held.
+WEAK work *find_pending_job_already_locked() {
+    work *best = NULL;
+    work **prev = &work_queue.jobs;
+    while (*prev) {
+        work *job = *prev;
+        if (!job->tasks_pending()) {
+            // All the tasks of this job have been claimed. Remove it
+            // from the stack. Its owner will keep waiting until the
+            // active workers finish.
+            *prev = job->next_job;
+            continue;
+        }
+        if ((job->max_workers == 0 || job->active_workers < job->max_workers) &&
+            (best == NULL || job->priority > best->priority)) {
+            best = job;
+            if (work_queue.num_priorities == 0) {
+                // Everything has the same priority, so the top of the
+                // stack wins.
+                return best;
+            }
+        }
+        prev = &job->next_job;
+    }
+    return best;
+}
+
+// Look up the priority and worker quota for jobs launched with the
+// given user_context. Must be called with the work queue lock held.
+WEAK void get_priority_already_locked(void *user_context, int *priority, int *max_workers) {
+    *priority = 0;
+    *max_workers = 0;
+    for (int i = 0; i < work_queue.num_priorities; i++) {
+        if (work_queue.priorities[i].user_context == user_context) {
+            *priority = work_queue.priorities[i].priority;
+            *max_workers = work_queue.priorities[i].max_workers;
+            return;
+        }
+    }
+}
+
+// Unlink a job from the stack if it is still there. Must be called
+// with the work queue lock held.
+WEAK void remove_job_already_locked(work *job) {
+    for (work **prev = &work_queue.jobs; *prev; prev = &((*prev)->next_job)) {
+        if (*prev == job) {
+            *prev = job->next_job;
+            return;
+        }
+    }
+}
+
+// Run the completion callback of an asynchronous job and free it. The
+// lock is released during the callback so that it may call back into
+// Halide, and held again on return.
+WEAK void finish_async_job_already_locked(work *job) {
+    remove_job_already_locked(job);
+    halide_mutex_unlock(&work_queue.mutex);
+    job->completion(job->completion_context, job->exit_status);
+    free(job);
+    halide_mutex_lock(&work_queue.mutex);
+}
+
+WEAK void worker_thread_already_locked(work *owned_job, int worker_id) {
     // If I'm a job owner, then I was the thread that called
     // do_par_for, and I should only stay in this function until my
     // job is complete. If I'm a lowly worker thread, I should stay in
     // this function as long as the work queue is running.
+    int spins = work_queue.spin_count;
     while (owned_job != NULL ? owned_job->running()
            : work_queue.running()) {
 
-        if (work_queue.jobs == NULL) {
+        work *job = find_pending_job_already_locked();
+
+        if (job == NULL) {
+            // Spin for a bit before going to sleep, so that back to
+            // back parallel loops can reuse hot threads. The spin
+            // budget adapts: it halves every time a spin fails to find
+            // anything, and is restored when a spin succeeds or when
+            // we are woken shortly after going to sleep.
+            bool may_spin = owned_job != NULL ||
+                work_queue.a_team_size <= work_queue.target_a_team_size;
+            if (may_spin && work_queue.spin_count > 0) {
+                int64_t t0 = halide_current_time_ns(NULL);
+                if (spin_wait_already_locked(owned_job, spins)) {
+                    spins = work_queue.spin_count;
+                    work_queue.stats.spin_wakeups++;
+                    work_queue.stats.wait_ns += halide_current_time_ns(NULL) - t0;
+                    continue;
+                }
+                spins = spins / 2;
+                work_queue.stats.wait_ns += halide_current_time_ns(NULL) - t0;
+                // Things may have changed while we didn't hold the lock.
+                if (!(owned_job != NULL ? owned_job->running() : work_queue.running()) ||
+                    find_pending_job_already_locked() != NULL) {
+                    continue;
+                }
+            }
+
+            int64_t t0 = halide_current_time_ns(NULL);
             if (owned_job) {
                 // There are no jobs pending. Wait for the last worker
                 // to signal that the job is finished.
@@ -112,61 +365,84 @@ WEAK void worker_thread_already_locked(work *owned_job) {
                 halide_cond_wait(&work_queue.wakeup_b_team, &work_queue.mutex);
                 work_queue.a_team_size++;
             }
-        } else {
-            // Grab the next job.
-            work *job = work_queue.jobs;
-
-            // Claim a task from it.
-            work myjob = *job;
-            job->next++;
-
-            // If there were no more tasks pending for this job,
-            // remove it from the stack.
-            if (job->next == job->max) {
-                work_queue.jobs = job->next_job;
+            int64_t slept = halide_current_time_ns(NULL) - t0;
+            work_queue.stats.sleep_wakeups++;
+            work_queue.stats.wait_ns += slept;
+            if (slept < 1000000) {
+                spins = work_queue.spin_count;
             }
-
+        } else {
             // Increment the active_worker count so that other threads
             // are aware that this job is still in progress even
-            // though there are no outstanding tasks for it.
+            // though there may be no outstanding tasks for it.
             job->active_workers++;
 
-            // Release the lock and do the task.
+            // Release the lock and claim tasks from the job without
+            // it. A job owner helping out with someone else's job
+            // only takes one task at a time, so that it notices
+            // promptly when its own job completes.
             halide_mutex_unlock(&work_queue.mutex);
-            int result = halide_do_task(myjob.user_context, myjob.f, myjob.next,
-                                        myjob.closure);
-            halide_mutex_lock(&work_queue.mutex);
-
-            // If this task failed, set the exit status on the job.
-            if (result) {
-                job->exit_status = result;
+            // Map worker ids onto slices in contiguous blocks, so
+            // that neighbouring workers (which share a NUMA node in
+            // NUMA-aware mode) get neighbouring slices.
+            int home = (int)(((int64_t)worker_id * job->num_slices) / max(work_queue.desired_num_threads, 1)) % job->num_slices;
+            int idx;
+            while (job->claim(home, &idx)) {
+                int result = halide_cancellation_check(job->user_context);
+                if (result == 0) {
+                    result = halide_do_task(job->user_context, job->f, idx,
+                                            job->closure);
+                }
+                // If this task failed or the job was cancelled, set the
+                // exit status on the job and stop handing out its
+                // remaining tasks.
+                if (result) {
+                    job->exit_status = result;
+                    job->abandoned = true;
+                }
+                if (owned_job != NULL && job != owned_job) {
+                    break;
+                }
             }
+            halide_mutex_lock(&work_queue.mutex);
 
             // We are no longer active on this job
             job->active_workers--;
 
+            // If the job has a worker quota and still has tasks left,
+            // there's now room for someone else to work on it.
+            if (job->max_workers > 0 && job->tasks_pending()) {
+                halide_cond_broadcast(&work_queue.wakeup_owners);
+                halide_cond_broadcast(&work_queue.wakeup_a_team);
+            }
+
             // If the job is done and I'm not the owner of it, wake up
-            // the owner.
+            // the owner, or complete it if it has no owner.
             if (!job->running() && job != owned_job) {
-                halide_cond_broadcast(&work_queue.wakeup_owners);
+                if (job->completion) {
+                    finish_async_job_already_locked(job);
+                } else {
+                    halide_cond_broadcast(&work_queue.wakeup_owners);
+                }
             }
         }
     }
 }
 
 
-WEAK void worker_thread(void *) {
+WEAK void worker_thread(void *arg) {
+    int worker_id = (int)(intptr_t)arg;
     halide_mutex_lock(&work_queue.mutex);
-    worker_thread_already_locked(NULL);
+    if (work_queue.numa_aware) {
+        halide_pin_current_thread_to_cpu(work_queue.worker_cpus[worker_id % work_queue.num_cpus]);
+    }
+    worker_thread_already_locked(NULL, worker_id);
     halide_mutex_unlock(&work_queue.mutex);
 }
 
-WEAK int default_do_par_for(void *user_context, halide_task_t f,
-                            int min, int size, uint8_t *closure) {
-    // Grab the lock. If it hasn't been initialized yet, then the
-    // field will be zero-initialized because it's a static global.
-    halide_mutex_lock(&work_queue.mutex);
-
+// Initialize the work queue if it hasn't been already. Must be called
+// with the work queue lock held.
+WEAK void init_work_queue_already_locked() {
     if (!work_queue.initialized) {
         work_queue.shutdown = false;
         halide_cond_init(&work_queue.wakeup_owners);
@@ -183,28 +459,81 @@ WEAK int default_do_par_for(void *user_context, halide_task_t f,
         work_queue.desired_num_threads = clamp_num_threads(work_queue.desired_num_threads);
         work_queue.threads_created = 0;
 
+        if (!work_queue.spin_count_set) {
+            work_queue.spin_count = default_spin_count();
+            work_queue.spin_count_set = true;
+        }
+
+        char *numa_str = getenv("HL_NUMA_AWARE");
+        work_queue.numa_aware = numa_str && atoi(numa_str);
+        if (work_queue.numa_aware) {
+            init_worker_cpus_already_locked();
+        }
+
         // Everyone starts on the a team.
         work_queue.a_team_size = work_queue.desired_num_threads;
 
         work_queue.initialized = true;
     }
+}
 
-    while (work_queue.threads_created < work_queue.desired_num_threads - 1) {
+// Make sure there are at least num_workers worker threads. Must be
+// called with the work queue lock held.
+WEAK void spawn_threads_already_locked(int num_workers) {
+    if (work_queue.threads_capacity < num_workers) {
+        // Grow the array of thread handles.
+        int new_capacity = max(num_workers, 2 * work_queue.threads_capacity);
+        halide_thread **new_threads = (halide_thread **)malloc(new_capacity * sizeof(halide_thread *));
+        if (work_queue.threads) {
+            memcpy(new_threads, work_queue.threads, work_queue.threads_created * sizeof(halide_thread *));
+            free(work_queue.threads);
+        }
+        work_queue.threads = new_threads;
+        work_queue.threads_capacity = new_capacity;
+    }
+
+    while (work_queue.threads_created < num_workers) {
         // We might need to make some new threads, if work_queue.desired_num_threads has
         // increased.
+        // Worker ids start at one. The calling thread uses id zero.
+        int worker_id = work_queue.threads_created + 1;
         work_queue.threads[work_queue.threads_created++] =
-            halide_spawn_thread(worker_thread, NULL);
+            halide_spawn_thread(worker_thread, (void *)(intptr_t)worker_id);
     }
+}
+
+WEAK int default_do_par_for(void *user_context, halide_task_t f,
+                            int min, int size, uint8_t *closure) {
+    // Grab the lock. If it hasn't been initialized yet, then the
+    // field will be zero-initialized because it's a static global.
+    halide_mutex_lock(&work_queue.mutex);
+
+    init_work_queue_already_locked();
+    spawn_threads_already_locked(work_queue.desired_num_threads - 1);
 
     // Make the job.
     work job;
     job.f = f;               // The job should call this function. It takes an index and a closure.
     job.user_context = user_context;
-    job.next = min;          // Start at this index.
-    job.max  = min + size;   // Keep going until one less than this index.
     job.closure = closure;   // Use this closure.
     job.exit_status = 0;     // The job hasn't failed yet
+    job.abandoned = false;
     job.active_workers = 0;  // Nobody is working on this yet
+    job.completion = NULL;   // I'll wait for it myself
+    job.completion_context = NULL;
+    get_priority_already_locked(user_context, &job.priority, &job.max_workers);
+
+    // Divide [min, min + size) into contiguous slices, one per thread
+    // that might work on it.
+    int num_slices = size;
+    if (num_slices > work_queue.desired_num_threads) num_slices = work_queue.desired_num_threads;
+    if (num_slices > MAX_SLICES) num_slices = MAX_SLICES;
+    if (num_slices < 1) num_slices = 1;
+    job.num_slices = num_slices;
+    for (int i = 0; i < num_slices; i++) {
+        job.slices[i].next = min + (int)(((int64_t)size * i) / num_slices);
+        job.slices[i].end = min + (int)(((int64_t)size * (i + 1)) / num_slices);
+    }
 
     if (!work_queue.jobs && size < work_queue.desired_num_threads) {
         // If there's no nested parallelism happening and there are
@@ -234,7 +563,11 @@ WEAK int default_do_par_for(void *user_context, halide_task_t f,
     }
 
     // Do some work myself.
-    worker_thread_already_locked(&job);
+    worker_thread_already_locked(&job, 0);
+
+    // The job lives on this stack frame, so make sure nobody can find
+    // it once we return. It may still be linked below newer jobs.
+    remove_job_already_locked(&job);
 
     halide_mutex_unlock(&work_queue.mutex);
 
@@ -243,6 +576,19 @@ WEAK int default_do_par_for(void *user_context, halide_task_t f,
     return job.exit_status;
 }
 
+// An asynchronous pipeline invocation is a job with a single task,
+// followed in memory by the arguments of the call.
+struct async_call {
+    work job;
+    int (*argv_func)(void **);
+    void **args;
+};
+
+WEAK int async_call_task(void *user_context, int idx, uint8_t *closure) {
+    async_call *call = (async_call *)closure;
+    return call->argv_func(call->args);
+}
+
 }}} // namespace Halide::Runtime::Internal
 
 using namespace Halide::Runtime::Internal;
@@ -266,6 +612,106 @@ WEAK int halide_set_num_threads(int n) {
     return old;
 }
 
+WEAK int halide_do_async(int (*argv_func)(void **), void **args,
+                         halide_async_callback_t callback, void *callback_context) {
+    async_call *call = (async_call *)malloc(sizeof(async_call));
+    if (!call) {
+        return halide_error_code_out_of_memory;
+    }
+    call->argv_func = argv_func;
+    call->args = args;
+
+    work *job = &call->job;
+    job->f = async_call_task;
+    job->user_context = callback_context;
+    job->closure = (uint8_t *)call;
+    job->exit_status = 0;
+    job->abandoned = false;
+    job->active_workers = 0;
+    job->completion = callback;
+    job->completion_context = callback_context;
+    job->num_slices = 1;
+    job->slices[0].next = 0;
+    job->slices[0].end = 1;
+
+    halide_mutex_lock(&work_queue.mutex);
+    init_work_queue_already_locked();
+    get_priority_already_locked(callback_context, &job->priority, &job->max_workers);
+
+    // There's nobody to do the work if the calling thread doesn't, so
+    // we need at least one worker, even if desired_num_threads is one.
+    spawn_threads_already_locked(max(work_queue.desired_num_threads - 1, 1));
+    if (work_queue.target_a_team_size < 1) {
+        work_queue.target_a_team_size = 1;
+    }
+
+    job->next_job = work_queue.jobs;
+    work_queue.jobs = job;
+
+    halide_cond_broadcast(&work_queue.wakeup_a_team);
+    if (work_queue.target_a_team_size > work_queue.a_team_size) {
+        halide_cond_broadcast(&work_queue.wakeup_b_team);
+    }
+    halide_mutex_unlock(&work_queue.mutex);
+    return 0;
+}
+
+WEAK int halide_set_thread_pool_priority(void *user_context, int priority, int max_threads) {
+    if (max_threads < 0) {
+        halide_error(user_context, "halide_set_thread_pool_priority: max_threads must be >= 0.");
+        return halide_error_code_generic_error;
+    }
+    halide_mutex_lock(&work_queue.mutex);
+    int i = 0;
+    while (i < work_queue.num_priorities &&
+           work_queue.priorities[i].user_context != user_context) {
+        i++;
+    }
+    int result = 0;
+    if (priority == 0 && max_threads == 0) {
+        // Back to the defaults. Remove the entry if there is one.
+        if (i < work_queue.num_priorities) {
+            work_queue.priorities[i] = work_queue.priorities[--work_queue.num_priorities];
+        }
+    } else if (i == MAX_PRIORITY_ENTRIES) {
+        halide_error(user_context, "halide_set_thread_pool_priority: too many distinct user_contexts.");
+        result = halide_error_code_generic_error;
+    } else {
+        if (i == work_queue.num_priorities) {
+            work_queue.num_priorities++;
+        }
+        work_queue.priorities[i].user_context = user_context;
+        work_queue.priorities[i].priority = priority;
+        work_queue.priorities[i].max_workers = max_threads;
+    }
+    halide_mutex_unlock(&work_queue.mutex);
+    return result;
+}
+
+WEAK int halide_set_thread_pool_spin_count(int n) {
+    halide_mutex_lock(&work_queue.mutex);
+    if (n < 0) {
+        n = default_spin_count();
+    }
+    int old = work_queue.spin_count;
+    work_queue.spin_count = n;
+    work_queue.spin_count_set = true;
+    halide_mutex_unlock(&work_queue.mutex);
+    return old;
+}
+
+WEAK void halide_get_thread_pool_stats(halide_thread_pool_stats_t *stats) {
+    halide_mutex_lock(&work_queue.mutex);
+    *stats = work_queue.stats;
+    halide_mutex_unlock(&work_queue.mutex);
+}
+
+WEAK void halide_reset_thread_pool_stats() {
+    halide_mutex_lock(&work_queue.mutex);
+    memset(&work_queue.stats, 0, sizeof(work_queue.stats));
+    halide_mutex_unlock(&work_queue.mutex);
+}
+
 WEAK void halide_shutdown_thread_pool() {
     if (!work_queue.initialized) return;
 
@@ -288,6 +734,12 @@ WEAK void halide_shutdown_thread_pool() {
     halide_cond_destroy(&work_queue.wakeup_owners);
     halide_cond_destroy(&work_queue.wakeup_a_team);
     halide_cond_destroy(&work_queue.wakeup_b_team);
+    free(work_queue.threads);
+    work_queue.threads = NULL;
+    work_queue.threads_capacity = 0;
+    free(work_queue.worker_cpus);
+    work_queue.worker_cpus = NULL;
+    work_queue.num_cpus = 0;
     work_queue.initialized = false;
 }
 
@@ -8,6 +8,11 @@ typedef int32_t (*trace_fn)(void *, const halide_trace_event_t *);
 
 }
 
+#define O_APPEND 1024
+#define O_CREAT 64
+#define O_WRONLY 1
+#define O_TRUNC 512
+
 namespace Halide { namespace Runtime { namespace Internal {
 
 WEAK int halide_trace_file = 0;
@@ -15,11 +20,427 @@ WEAK int halide_trace_file_lock = 0;
 WEAK bool halide_trace_file_initialized = false;
 WEAK bool halide_trace_file_internally_opened = false;
 
+// Binary trace packets are collected in a ring of large buffers rather
+// than written out one field at a time. Threads reserve space for a
+// packet in the active buffer with an atomic add, and copy it in
+// without taking any lock. The thread whose packet doesn't fit retires
+// the buffer: it makes the next buffer active, so that other threads
+// can carry on tracing, then writes the full one out with one large
+// write. Buffers are written out in the order they're retired, so the
+// file is the same stream of packets as before.
+const uint32_t kTraceBufferSize = 1024 * 1024;
+const int kNumTraceBuffers = 4;
+
+struct trace_buffer {
+    // The number of bytes reserved. Goes past kTraceBufferSize once a
+    // packet doesn't fit.
+    uint32_t cursor;
+    // The end of the packets, once the buffer is retired.
+    uint32_t end;
+    // The number of threads between reserving space and finishing
+    // their copy.
+    int writers;
+    // Whether the buffer is retired and waiting to be written out, and
+    // its position in the order of retired buffers.
+    bool retired;
+    int sequence;
+    uint8_t data[kTraceBufferSize];
+};
+
+WEAK trace_buffer *trace_buffers = NULL;
+WEAK int trace_buffers_lock = 0;
+WEAK bool trace_buffers_failed = false;
+WEAK volatile int active_trace_buffer = 0;
+WEAK int retired_trace_buffers = 0;
+WEAK volatile int written_trace_buffers = 0;
+
+WEAK trace_buffer *get_trace_buffers() {
+    if (trace_buffers || trace_buffers_failed) {
+        return trace_buffers;
+    }
+    ScopedSpinLock lock(&trace_buffers_lock);
+    if (!trace_buffers && !trace_buffers_failed) {
+        trace_buffer *b = (trace_buffer *)malloc(kNumTraceBuffers * sizeof(trace_buffer));
+        if (b) {
+            memset(b, 0, kNumTraceBuffers * sizeof(trace_buffer));
+            __sync_synchronize();
+            trace_buffers = b;
+        } else {
+            trace_buffers_failed = true;
+        }
+    }
+    return trace_buffers;
+}
+
+// Write all of a block of memory to a file, retrying short writes, as
+// happen with pipes.
+WEAK bool write_fully(int fd, const void *data, size_t size) {
+    const uint8_t *p = (const uint8_t *)data;
+    while (size > 0) {
+        ssize_t written = write(fd, p, size);
+        if (written <= 0) {
+            return false;
+        }
+        p += written;
+        size -= written;
+    }
+    return true;
+}
+
+// The index of the trace file describes each chunk of it written out
+// at once: each retired buffer, and each packet written directly. It's
+// written by whoever writes the chunk, right after it, so it's in the
+// same order as the file.
+WEAK int halide_trace_index_file = 0;
+WEAK int halide_trace_index_lock = 0;
+WEAK bool halide_trace_index_initialized = false;
+WEAK bool halide_trace_index_internally_opened = false;
+// The bytes written to the trace file since the index started.
+WEAK uint64_t trace_file_offset = 0;
+
+WEAK int get_trace_index_file(void *user_context) {
+    if (halide_trace_index_initialized) {
+        return halide_trace_index_file;
+    }
+    ScopedSpinLock lock(&halide_trace_index_lock);
+    if (!halide_trace_index_initialized) {
+        const char *index_file_name = getenv("HL_TRACE_INDEX_FILE");
+        if (index_file_name) {
+            int fd = open(index_file_name, O_TRUNC | O_CREAT | O_WRONLY, 0644);
+            halide_assert(user_context, (fd > 0) && "Failed to open trace index file\n");
+            halide_trace_index_file = fd;
+            halide_trace_index_internally_opened = true;
+        }
+        __sync_synchronize();
+        halide_trace_index_initialized = true;
+    }
+    return halide_trace_index_file;
+}
+
+// Write the entry for the chunk of the trace file just written, of the
+// given size. names holds names_size bytes of null-terminated names,
+// and room for the padding.
+WEAK void write_trace_index_entry(void *user_context, uint32_t size, uint32_t packets, int32_t flags,
+                                  char *names, uint32_t names_size) {
+    int fd = get_trace_index_file(user_context);
+    uint64_t offset = trace_file_offset;
+    trace_file_offset += size;
+    if (fd <= 0) {
+        return;
+    }
+    uint32_t padded_size = (names_size + 3) & ~3;
+    memset(names + names_size, 0, padded_size - names_size);
+    halide_trace_index_entry_t entry;
+    entry.offset = offset;
+    entry.size = size;
+    entry.packets = packets;
+    entry.flags = flags;
+    entry.names_size = padded_size;
+    bool ok = (write_fully(fd, &entry, sizeof(entry)) &&
+               write_fully(fd, names, padded_size));
+    halide_assert(user_context, ok && "Can't write to trace index file");
+}
+
+// Write the entry for a chunk of packets just written, naming the
+// Funcs they load or store.
+WEAK void index_trace_chunk(void *user_context, const uint8_t *data, uint32_t size) {
+    if (get_trace_index_file(user_context) <= 0) {
+        trace_file_offset += size;
+        return;
+    }
+    const int kMaxNamesSize = 4096;
+    char names[kMaxNamesSize + 4];
+    uint32_t names_size = 0;
+    uint32_t packets = 0;
+    int32_t flags = 0;
+    const char *last_name = NULL;
+    for (uint32_t pos = 0; pos < size; packets++) {
+        const halide_trace_packet_t *p = (const halide_trace_packet_t *)(data + pos);
+        pos += p->size;
+        if (p->event != halide_trace_load && p->event != halide_trace_store) {
+            flags |= halide_trace_index_other_events;
+            continue;
+        }
+        // Runs of packets are usually of the same Func.
+        const char *name = p->func();
+        if (last_name && strcmp(name, last_name) == 0) {
+            continue;
+        }
+        last_name = name;
+        if (flags & halide_trace_index_names_incomplete) {
+            continue;
+        }
+        bool found = false;
+        for (uint32_t i = 0; i < names_size && !found; i += strlen(names + i) + 1) {
+            found = strcmp(names + i, name) == 0;
+        }
+        if (found) {
+            continue;
+        }
+        uint32_t len = strlen(name) + 1;
+        if (names_size + len > kMaxNamesSize) {
+            flags |= halide_trace_index_names_incomplete;
+            names_size = 0;
+            continue;
+        }
+        memcpy(names + names_size, name, len);
+        names_size += len;
+    }
+    write_trace_index_entry(user_context, size, packets, flags, names, names_size);
+}
+
+// Retire buffer i, whose packets end at the given offset, and write it
+// out. Called by only one thread per buffer, while it's the active one.
+WEAK void retire_trace_buffer(void *user_context, int i, uint32_t end) {
+    trace_buffer *b = trace_buffers + i;
+    b->end = end;
+    b->sequence = retired_trace_buffers++;
+    b->retired = true;
+
+    // Wait for the next buffer to be written out, if it's still pending
+    // from the last time round the ring, then make it the active one.
+    int next = (i + 1) % kNumTraceBuffers;
+    while (((volatile bool *)&trace_buffers[next].retired)[0]) {
+        __sync_synchronize();
+    }
+    __sync_synchronize();
+    active_trace_buffer = next;
+
+    // Wait for threads still copying into this buffer, and for the
+    // buffers retired before it to be written out.
+    while (((volatile int *)&b->writers)[0] != 0 ||
+           written_trace_buffers != b->sequence) {
+        __sync_synchronize();
+    }
+
+    bool ok = write_fully(halide_trace_file, b->data, b->end);
+    if (ok) {
+        index_trace_chunk(user_context, b->data, b->end);
+    }
+
+    b->cursor = 0;
+    b->end = 0;
+    __sync_synchronize();
+    b->retired = false;
+    __sync_fetch_and_add(&written_trace_buffers, 1);
+    halide_assert(user_context, ok && "Can't write to trace file");
+}
+
+// Copy a packet of the given size into the active buffer. Returns false
+// if there are no buffers to use.
+WEAK bool buffer_trace_packet(void *user_context, const halide_trace_packet_t &header,
+                              const halide_trace_event_t *e, uint32_t coords_bytes,
+                              uint32_t value_bytes, uint32_t name_bytes) {
+    if (!get_trace_buffers() || header.size > kTraceBufferSize) {
+        return false;
+    }
+    uint32_t size = header.size;
+    while (1) {
+        int i = active_trace_buffer;
+        trace_buffer *b = trace_buffers + i;
+        __sync_fetch_and_add(&b->writers, 1);
+        if (i != active_trace_buffer) {
+            // The buffer was retired after we read which was active.
+            __sync_fetch_and_sub(&b->writers, 1);
+            continue;
+        }
+        uint32_t offset = __sync_fetch_and_add(&b->cursor, size);
+        if (offset + size <= kTraceBufferSize) {
+            uint8_t *dst = b->data + offset;
+            memcpy(dst, &header, sizeof(header));
+            dst += sizeof(header);
+            if (e->coordinates) {
+                memcpy(dst, e->coordinates, coords_bytes);
+            }
+            dst += coords_bytes;
+            if (e->value) {
+                memcpy(dst, e->value, value_bytes);
+            }
+            dst += value_bytes;
+            memcpy(dst, e->func, name_bytes);
+            dst += name_bytes;
+            memset(dst, 0, b->data + offset + size - dst);
+            __sync_fetch_and_sub(&b->writers, 1);
+            return true;
+        }
+        __sync_fetch_and_sub(&b->writers, 1);
+        if (offset <= kTraceBufferSize) {
+            // Ours is the first packet that didn't fit, so the
+            // packets end where it would have started.
+            retire_trace_buffer(user_context, i, offset);
+        } else {
+            // Another thread is retiring this buffer.
+            while (active_trace_buffer == i) {
+                __sync_synchronize();
+            }
+        }
+    }
+}
+
+// Write out everything buffered so far.
+WEAK void flush_trace_buffers(void *user_context) {
+    if (!trace_buffers) {
+        return;
+    }
+    while (1) {
+        // Retire the active buffer early by reserving more than is
+        // left, following the same protocol as buffer_trace_packet.
+        int i = active_trace_buffer;
+        trace_buffer *b = trace_buffers + i;
+        __sync_fetch_and_add(&b->writers, 1);
+        if (i != active_trace_buffer) {
+            __sync_fetch_and_sub(&b->writers, 1);
+            continue;
+        }
+        uint32_t offset = b->cursor == 0 ? kTraceBufferSize + 1 :
+            __sync_fetch_and_add(&b->cursor, kTraceBufferSize + 1);
+        __sync_fetch_and_sub(&b->writers, 1);
+        if (offset <= kTraceBufferSize) {
+            retire_trace_buffer(user_context, i, offset);
+        }
+        break;
+    }
+    // Wait for buffers retired by other threads, too.
+    while (written_trace_buffers != retired_trace_buffers) {
+        __sync_synchronize();
+    }
+}
+
+// The timeline is written as the JSON array form of the Chrome trace
+// event format, one begin ("B") or end ("E") event per line. Viewers
+// accept the array without its closing bracket, so a timeline cut off
+// by a crash can still be read; halide_shutdown_trace closes it.
+WEAK int halide_trace_timeline_file = 0;
+WEAK int halide_trace_timeline_lock = 0;
+WEAK bool halide_trace_timeline_initialized = false;
+WEAK bool halide_trace_timeline_internally_opened = false;
+WEAK bool halide_trace_timeline_empty = true;
+
+// Chrome wants small integer thread ids, so number the threads in
+// the order they first trace something.
+const int kMaxTimelineThreads = 256;
+WEAK uint64_t timeline_thread_ids[kMaxTimelineThreads];
+WEAK int num_timeline_threads = 0;
+
+// Only called with the timeline lock held.
+WEAK int timeline_thread_index() {
+    if (!halide_current_thread_id) {
+        return 0;
+    }
+    uint64_t id = halide_current_thread_id();
+    for (int i = 0; i < num_timeline_threads; i++) {
+        if (timeline_thread_ids[i] == id) {
+            return i;
+        }
+    }
+    if (num_timeline_threads == kMaxTimelineThreads) {
+        return kMaxTimelineThreads;
+    }
+    timeline_thread_ids[num_timeline_threads] = id;
+    return num_timeline_threads++;
+}
+
+WEAK void write_timeline_event(void *user_context, int fd, const halide_trace_event_t *e) {
+    const char *category = NULL;
+    bool begin = false;
+    switch (e->event) {
+    case halide_trace_begin_realization:
+        begin = true;
+        // fall through
+    case halide_trace_end_realization:
+        category = "realize";
+        break;
+    case halide_trace_produce:
+        begin = true;
+        // fall through
+    case halide_trace_end_produce:
+        category = "produce";
+        break;
+    case halide_trace_consume:
+        begin = true;
+        // fall through
+    case halide_trace_end_consume:
+        category = "consume";
+        break;
+    case halide_trace_begin_pipeline:
+        begin = true;
+        // fall through
+    case halide_trace_end_pipeline:
+        category = "pipeline";
+        break;
+    case halide_trace_begin_task:
+        begin = true;
+        // fall through
+    case halide_trace_end_task:
+        category = "task";
+        break;
+    default:
+        // Loads and stores are far too many to put on a timeline.
+        return;
+    }
+
+    double us = halide_current_time_ns(user_context) / 1000.0;
+
+    char buffer[512];
+    Printer<StringStreamPrinter, sizeof(buffer)> ss(user_context, buffer);
+    ScopedSpinLock lock(&halide_trace_timeline_lock);
+    int tid = timeline_thread_index();
+    if (halide_trace_timeline_empty) {
+        ss << "[\n";
+        halide_trace_timeline_empty = false;
+    } else {
+        ss << ",\n";
+    }
+    ss << "{\"name\": \"" << e->func << "\", \"cat\": \"" << category
+       << "\", \"ph\": \"" << (begin ? "B" : "E")
+       << "\", \"pid\": 0, \"tid\": " << tid << ", \"ts\": " << us;
+    if (e->event == halide_trace_begin_task && e->dimensions > 0) {
+        ss << ", \"args\": {\"index\": " << e->coordinates[0] << "}";
+    }
+    ss << "}";
+    ss.msan_annotate_is_initialized();
+    bool ok = write_fully(fd, buffer, ss.size());
+    halide_assert(user_context, ok && "Can't write to trace timeline file");
+}
+
+WEAK void close_trace_timeline() {
+    ScopedSpinLock lock(&halide_trace_timeline_lock);
+    if (halide_trace_timeline_file && !halide_trace_timeline_empty) {
+        write_fully(halide_trace_timeline_file, "\n]\n", 3);
+    }
+    halide_trace_timeline_empty = true;
+}
+
+WEAK int get_trace_timeline_file(void *user_context) {
+    if (halide_trace_timeline_initialized) {
+        return halide_trace_timeline_file;
+    }
+    ScopedSpinLock lock(&halide_trace_file_lock);
+    if (!halide_trace_timeline_initialized) {
+        const char *timeline_file_name = getenv("HL_TRACE_TIMELINE_FILE");
+        if (timeline_file_name) {
+            int fd = open(timeline_file_name, O_TRUNC | O_CREAT | O_WRONLY, 0644);
+            halide_assert(user_context, (fd > 0) && "Failed to open trace timeline file\n");
+            halide_start_clock(user_context);
+            halide_trace_timeline_file = fd;
+            halide_trace_timeline_internally_opened = true;
+        }
+        __sync_synchronize();
+        halide_trace_timeline_initialized = true;
+    }
+    return halide_trace_timeline_file;
+}
+
 WEAK int32_t default_trace(void *user_context, const halide_trace_event_t *e) {
     static int32_t ids = 1;
 
     int32_t my_id = __sync_fetch_and_add(&ids, 1);
 
+    int timeline_fd = get_trace_timeline_file(user_context);
+    if (timeline_fd > 0) {
+        write_timeline_event(user_context, timeline_fd, e);
+    }
+
     // If we're dumping to a file, use a binary format
     int fd = halide_get_trace_file(user_context);
     if (fd > 0) {
@@ -42,9 +463,25 @@ WEAK int32_t default_trace(void *user_context, const halide_trace_event_t *e) {
         header.value_index = e->value_index;
         header.dimensions = e->dimensions;
 
+        // Buffers are written to halide_trace_file, so don't use them
+        // if halide_get_trace_file has been overridden to return
+        // another file.
+        if (fd == halide_trace_file &&
+            buffer_trace_packet(user_context, header, e, coords_bytes, value_bytes, name_bytes)) {
+            // Write out the trace at the end of each pipeline, so that
+            // a viewer reading from a pipe keeps up.
+            if (e->event == halide_trace_end_pipeline) {
+                flush_trace_buffers(user_context);
+            }
+            return my_id;
+        }
+
+        // Otherwise write the packet directly, after anything
+        // buffered.
         size_t written = 0;
         {
             ScopedSpinLock lock(&halide_trace_file_lock);
+            flush_trace_buffers(user_context);
             written += write(fd, &header, sizeof(header));
             if (e->coordinates) {
                 written += write(fd, e->coordinates, coords_bytes);
@@ -55,10 +492,24 @@ WEAK int32_t default_trace(void *user_context, const halide_trace_event_t *e) {
             written += write(fd, e->func, name_bytes);
             uint32_t zero = 0;
             written += write(fd, &zero, padding_bytes);
+            if (fd == halide_trace_file) {
+                char names[4096 + 4];
+                uint32_t names_size = 0;
+                int32_t flags = 0;
+                if (e->event != halide_trace_load && e->event != halide_trace_store) {
+                    flags = halide_trace_index_other_events;
+                } else if (name_bytes <= 4096) {
+                    memcpy(names, e->func, name_bytes);
+                    names_size = name_bytes;
+                } else {
+                    flags = halide_trace_index_names_incomplete;
+                }
+                write_trace_index_entry(user_context, total_size, 1, flags, names, names_size);
+            }
         }
         halide_assert(user_context, written == total_size && "Can't write to trace file");
 
-    } else {
+    } else if (timeline_fd <= 0) {
         uint8_t buffer[4096];
         Printer<StringStreamPrinter, sizeof(buffer)> ss(user_context, (char *)buffer);
 
@@ -77,7 +528,9 @@ WEAK int32_t default_trace(void *user_context, const halide_trace_event_t *e) {
                                      "Consume",
                                      "End consume",
                                      "Begin pipeline",
-                                     "End pipeline"};
+                                     "End pipeline",
+                                     "Begin task",
+                                     "End task"};
 
         // Only print out the value on stores and loads.
         bool print_value = (e->event < 2);
@@ -174,16 +627,21 @@ WEAK trace_fn halide_set_custom_trace(trace_fn t) {
 }
 
 WEAK void halide_set_trace_file(int fd) {
+    // Anything traced so far goes to the old file.
+    flush_trace_buffers(NULL);
     halide_trace_file = fd;
     halide_trace_file_initialized = true;
+    trace_file_offset = 0;
 }
 
 extern int errno;
 
-#define O_APPEND 1024
-#define O_CREAT 64
-#define O_WRONLY 1
 WEAK int halide_get_trace_file(void *user_context) {
+    // This is called for every event, so avoid the lock once the
+    // file is set.
+    if (halide_trace_file_initialized) {
+        return halide_trace_file;
+    }
     // Prevent multiple threads both trying to initialize the trace
     // file at the same time.
     ScopedSpinLock lock(&halide_trace_file_lock);
@@ -201,14 +659,44 @@ WEAK int halide_get_trace_file(void *user_context) {
     return halide_trace_file;
 }
 
+WEAK void halide_set_trace_timeline_file(int fd) {
+    close_trace_timeline();
+    halide_start_clock(NULL);
+    halide_trace_timeline_file = fd;
+    halide_trace_timeline_initialized = true;
+}
+
+WEAK void halide_set_trace_index_file(int fd) {
+    // Anything traced so far goes in the old index.
+    flush_trace_buffers(NULL);
+    halide_trace_index_file = fd;
+    halide_trace_index_initialized = true;
+    trace_file_offset = 0;
+}
+
 WEAK int32_t halide_trace(void *user_context, const halide_trace_event_t *e) {
     return (*halide_custom_trace)(user_context, e);
 }
 
 WEAK int halide_shutdown_trace() {
+    flush_trace_buffers(NULL);
+    close_trace_timeline();
+    if (halide_trace_index_internally_opened) {
+        close(halide_trace_index_file);
+        halide_trace_index_file = 0;
+        halide_trace_index_initialized = false;
+        halide_trace_index_internally_opened = false;
+    }
+    if (halide_trace_timeline_internally_opened) {
+        close(halide_trace_timeline_file);
+        halide_trace_timeline_file = 0;
+        halide_trace_timeline_initialized = false;
+        halide_trace_timeline_internally_opened = false;
+    }
     if (halide_trace_file_internally_opened) {
         int ret = close(halide_trace_file);
         halide_trace_file = 0;
+        trace_file_offset = 0;
         halide_trace_file_initialized = false;
         halide_trace_file_internally_opened = false;
         return ret;
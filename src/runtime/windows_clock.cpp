@@ -38,4 +38,10 @@ WEAK void halide_sleep_ms(void *user_context, int ms) {
     Sleep(ms);
 }
 
+// Sleep only has millisecond resolution (and by default the scheduler
+// rounds up to its 15.6ms tick), so shorter sleeps just yield.
+WEAK void halide_sleep_us(void *user_context, int us) {
+    Sleep(us / 1000);
+}
+
 }
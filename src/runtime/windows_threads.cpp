@@ -26,6 +26,8 @@ extern WIN32API void DeleteCriticalSection(CriticalSection *);
 extern WIN32API void EnterCriticalSection(CriticalSection *);
 extern WIN32API void LeaveCriticalSection(CriticalSection *);
 extern WIN32API int32_t WaitForSingleObject(Thread, int32_t timeout);
+extern WIN32API bool SwitchToThread();
+extern WIN32API int32_t GetCurrentThreadId();
 extern WIN32API bool InitOnceExecuteOnce(InitOnce *, bool WIN32API (*f)(InitOnce *, void *, void **), void *, void **);
 
 } // extern "C"
@@ -61,7 +63,13 @@ WEAK halide_thread *halide_spawn_thread(void(*f)(void *), void *closure) {
     spawned_thread *t = (spawned_thread *)malloc(sizeof(spawned_thread));
     t->f = f;
     t->closure = closure;
-    t->handle = CreateThread(NULL, 0, spawn_thread_helper, t, 0, NULL);
+    // Generated code may place large allocations on the stack (see
+    // the large_stack target feature), so give workers 8MB of stack
+    // rather than the 1MB default. Only reserve it; pages are
+    // committed as the stack grows.
+    const int32_t stack_size_param_is_a_reservation = 0x00010000;
+    t->handle = CreateThread(NULL, 8 * 1024 * 1024, spawn_thread_helper, t,
+                             stack_size_param_is_a_reservation, NULL);
     return (halide_thread *)t;
 }
 
@@ -112,6 +120,14 @@ WEAK void halide_cond_wait(struct halide_cond *cond_arg, struct halide_mutex *mu
     SleepConditionVariableCS(cond, &mutex->critical_section, -1);
 }
 
+WEAK void halide_thread_yield() {
+    SwitchToThread();
+}
+
+WEAK uint64_t halide_current_thread_id() {
+    return (uint64_t)(uint32_t)GetCurrentThreadId();
+}
+
 WEAK int halide_host_cpu_count() {
     // Apparently a standard windows environment variable
     char *num_cores = getenv("NUMBER_OF_PROCESSORS");
@@ -122,4 +138,14 @@ WEAK int halide_host_cpu_count() {
     }
 }
 
+WEAK int halide_host_cpu_numa_node(int cpu) {
+    // TODO: Query GetNumaProcessorNodeEx.
+    return -1;
+}
+
+WEAK int halide_pin_current_thread_to_cpu(int cpu) {
+    // TODO: Use SetThreadAffinityMask.
+    return -1;
+}
+
 } // extern "C"
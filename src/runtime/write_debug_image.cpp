@@ -1,4 +1,5 @@
 #include "HalideRuntime.h"
+#include "printer.h"
 
 extern "C" void *fopen(const char *, const char *);
 extern "C" int fclose(void *);
@@ -112,13 +113,8 @@ WEAK uint8_t *get_pointer_to_data(int32_t dim0, int32_t dim1, int32_t dim2, int3
     return ptr;
 }
 
-}}} // namespace Halide::Runtime::Internal
-
-WEAK extern "C" int32_t halide_debug_to_file(void *user_context, const char *filename,
-                                             int32_t type_code, struct buffer_t *buf) {
-
-    halide_copy_to_host(user_context, buf);
-
+// Write the contents of a buffer already on the host to a file.
+WEAK int write_debug_image(const char *filename, int32_t type_code, const struct buffer_t *buf) {
     void *f = fopen(filename, "wb");
     if (!f) return -1;
 
@@ -215,6 +211,23 @@ WEAK extern "C" int32_t halide_debug_to_file(void *user_context, const char *fil
         }
     }
 
+    if (buf->stride[0] == 1) {
+        // The rows are contiguous, so write them directly.
+        for (int32_t dim3 = 0; dim3 < s3; ++dim3) {
+            for (int32_t dim2 = 0; dim2 < s2; ++dim2) {
+                for (int32_t dim1 = 0; dim1 < s1; ++dim1) {
+                    uint8_t *row = get_pointer_to_data(0, dim1, dim2, dim3, buf);
+                    if (!fwrite((void *)row, s0*bytes_per_element, 1, f)) {
+                        fclose(f);
+                        return -1;
+                    }
+                }
+            }
+        }
+        fclose(f);
+        return 0;
+    }
+
     // Reorder the data according to the strides.
     const int TEMP_SIZE = 4*1024;
     uint8_t temp[TEMP_SIZE];
@@ -251,3 +264,181 @@ WEAK extern "C" int32_t halide_debug_to_file(void *user_context, const char *fil
 
     return 0;
 }
+
+// A copy of a buffer being written to a file by a thread of its own,
+// when debug_to_file writes are asynchronous. The data and the
+// filename are stored after the struct, in the same allocation.
+struct debug_to_file_job {
+    debug_to_file_job *next;
+    halide_thread *thread;
+    const char *filename;
+    int32_t type_code;
+    int result;
+    buffer_t buf;
+};
+
+// The jobs that have not been joined yet, oldest first.
+WEAK debug_to_file_job *debug_to_file_jobs = NULL;
+WEAK int debug_to_file_num_jobs = 0;
+WEAK bool debug_to_file_failed = false;
+WEAK halide_mutex debug_to_file_lock = { { 0 } };
+
+// -1 means not yet set, either by halide_set_debug_to_file_async or
+// by the environment.
+WEAK int debug_to_file_async = -1;
+
+// Limit the number of writes in flight, along with the memory held by
+// their copies of the data.
+WEAK int debug_to_file_max_jobs = 8;
+
+WEAK void debug_to_file_job_main(void *arg) {
+    debug_to_file_job *job = (debug_to_file_job *)arg;
+    job->result = write_debug_image(job->filename, job->type_code, &job->buf);
+}
+
+// Join the jobs writing to filename (if not NULL), and then the
+// oldest ones until at most max_jobs are left. Must be called with
+// debug_to_file_lock held.
+WEAK void join_debug_to_file_jobs(void *user_context, const char *filename, int max_jobs) {
+    debug_to_file_job **prev = &debug_to_file_jobs;
+    while (*prev) {
+        debug_to_file_job *job = *prev;
+        bool same_file = filename && strcmp(job->filename, filename) == 0;
+        if (!same_file && debug_to_file_num_jobs <= max_jobs) {
+            prev = &job->next;
+            continue;
+        }
+        halide_join_thread(job->thread);
+        if (job->result != 0) {
+            error(user_context) << "Failed to write " << job->filename
+                                << " asynchronously with error " << job->result;
+            debug_to_file_failed = true;
+        }
+        *prev = job->next;
+        debug_to_file_num_jobs--;
+        free(job);
+    }
+}
+
+// Copy the data of a buffer to dst densely, in the order in which
+// write_debug_image writes it, and make a buffer describing the copy.
+WEAK void copy_to_dense(const struct buffer_t *buf, uint8_t *dst, struct buffer_t *dense) {
+    int32_t s0 = max(1, buf->extent[0]), s1 = max(1, buf->extent[1]);
+    int32_t s2 = max(1, buf->extent[2]), s3 = max(1, buf->extent[3]);
+    int32_t elem_size = buf->elem_size;
+
+    *dense = *buf;
+    dense->host = dst;
+    dense->dev = 0;
+    dense->host_dirty = false;
+    dense->dev_dirty = false;
+    dense->stride[0] = 1;
+    dense->stride[1] = s0;
+    dense->stride[2] = s0 * s1;
+    dense->stride[3] = s0 * s1 * s2;
+
+    for (int32_t dim3 = 0; dim3 < s3; ++dim3) {
+        for (int32_t dim2 = 0; dim2 < s2; ++dim2) {
+            for (int32_t dim1 = 0; dim1 < s1; ++dim1) {
+                if (buf->stride[0] == 1) {
+                    memcpy(dst, get_pointer_to_data(0, dim1, dim2, dim3, buf), s0 * elem_size);
+                    dst += s0 * elem_size;
+                } else {
+                    for (int32_t dim0 = 0; dim0 < s0; ++dim0) {
+                        memcpy(dst, get_pointer_to_data(dim0, dim1, dim2, dim3, buf), elem_size);
+                        dst += elem_size;
+                    }
+                }
+            }
+        }
+    }
+}
+
+}}} // namespace Halide::Runtime::Internal
+
+extern "C" {
+
+WEAK bool halide_set_debug_to_file_async(bool async) {
+    halide_mutex_lock(&debug_to_file_lock);
+    bool old = debug_to_file_async > 0;
+    debug_to_file_async = async ? 1 : 0;
+    halide_mutex_unlock(&debug_to_file_lock);
+    return old;
+}
+
+WEAK int halide_debug_to_file_flush(void *user_context) {
+    halide_mutex_lock(&debug_to_file_lock);
+    join_debug_to_file_jobs(user_context, NULL, 0);
+    bool failed = debug_to_file_failed;
+    debug_to_file_failed = false;
+    halide_mutex_unlock(&debug_to_file_lock);
+    return failed ? halide_error_code_debug_to_file_failed : 0;
+}
+
+WEAK int32_t halide_debug_to_file(void *user_context, const char *filename,
+                                  int32_t type_code, struct buffer_t *buf) {
+
+    halide_copy_to_host(user_context, buf);
+
+    halide_mutex_lock(&debug_to_file_lock);
+    if (debug_to_file_async < 0) {
+        const char *async_str = getenv("HL_DEBUG_TO_FILE_ASYNC");
+        debug_to_file_async = (async_str && atoi(async_str) != 0) ? 1 : 0;
+    }
+    if (!debug_to_file_async) {
+        halide_mutex_unlock(&debug_to_file_lock);
+        return write_debug_image(filename, type_code, buf);
+    }
+
+    // Writes to the same file must happen in order.
+    join_debug_to_file_jobs(user_context, filename, debug_to_file_max_jobs - 1);
+
+    size_t data_size = buf->elem_size;
+    data_size *= max(1, buf->extent[0]);
+    data_size *= max(1, buf->extent[1]);
+    data_size *= max(1, buf->extent[2]);
+    data_size *= max(1, buf->extent[3]);
+    size_t filename_size = strlen(filename) + 1;
+
+    debug_to_file_job *job =
+        (debug_to_file_job *)malloc(sizeof(debug_to_file_job) + data_size + filename_size);
+    if (job) {
+        uint8_t *data = (uint8_t *)(job + 1);
+        char *job_filename = (char *)(data + data_size);
+        memcpy(job_filename, filename, filename_size);
+        job->next = NULL;
+        job->filename = job_filename;
+        job->type_code = type_code;
+        job->result = 0;
+        copy_to_dense(buf, data, &job->buf);
+        job->thread = halide_spawn_thread(debug_to_file_job_main, job);
+    }
+    if (!job || !job->thread) {
+        // Fall back to writing the file now.
+        free(job);
+        halide_mutex_unlock(&debug_to_file_lock);
+        return write_debug_image(filename, type_code, buf);
+    }
+
+    debug_to_file_job **last = &debug_to_file_jobs;
+    while (*last) {
+        last = &(*last)->next;
+    }
+    *last = job;
+    debug_to_file_num_jobs++;
+
+    halide_mutex_unlock(&debug_to_file_lock);
+    return 0;
+}
+
+namespace {
+
+// Finish any asynchronous writes before the process exits.
+__attribute__((destructor))
+WEAK void halide_debug_to_file_cleanup() {
+    halide_debug_to_file_flush(NULL);
+}
+
+}
+
+}  // extern "C"
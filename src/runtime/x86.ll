@@ -146,3 +146,13 @@ define weak_odr void @x86_cpuid_halide(i32* %info) nounwind uwtable {
 
   ret void
 }
+
+declare void @llvm.x86.sse.ldmxcsr(i8*) nounwind
+
+; Set MXCSR to the value obj points to. Fast-math pipelines set the
+; flush-to-zero and denormals-are-zero bits on entry, and register
+; this as a destructor to put back what was there.
+define weak_odr void @halide_x86_set_mxcsr_as_destructor(i8* %user_context, i8* %obj) nounwind uwtable {
+  call void @llvm.x86.sse.ldmxcsr(i8* %obj)
+  ret void
+}
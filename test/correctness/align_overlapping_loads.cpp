@@ -0,0 +1,38 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+
+int main(int argc, char **argv) {
+    Target t = get_jit_target_from_environment();
+    const int vec = t.natural_vector_size<uint8_t>();
+
+    Func f, g;
+    Var x, y;
+
+    f(x, y) = cast<uint8_t>(x * 7 + y * 3);
+    // Each vector of g loads three overlapping vectors of f. These
+    // should become aligned loads carried across iterations of x.
+    g(x, y) = f(x - 1, y) + f(x, y) * 2 + f(x + 1, y);
+
+    f.compute_at(g, y).store_root().align_storage(x, vec).vectorize(x, vec);
+    g.vectorize(x, vec);
+
+    const int W = vec * 16, H = 8;
+    Buffer<uint8_t> out = g.realize(W, H);
+    for (int j = 0; j < H; j++) {
+        for (int i = 0; i < W; i++) {
+            uint8_t a = (uint8_t)((i - 1) * 7 + j * 3);
+            uint8_t b = (uint8_t)(i * 7 + j * 3);
+            uint8_t c = (uint8_t)((i + 1) * 7 + j * 3);
+            uint8_t correct = (uint8_t)(a + b * 2 + c);
+            if (out(i, j) != correct) {
+                printf("out(%d, %d) = %d instead of %d\n", i, j, out(i, j), correct);
+                return -1;
+            }
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
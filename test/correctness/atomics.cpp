@@ -0,0 +1,90 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+
+// Atomic updates can be parallelized over their RVars without any
+// private copies of the result, and should still get the same answer.
+
+int main(int argc, char **argv) {
+    const int W = 128, H = 128;
+
+    Buffer<uint8_t> in(W, H);
+    int reference_hist[256] = {0};
+    float reference_sum[8] = {0};
+    int reference_min[8];
+    for (int i = 0; i < 8; i++) {
+        reference_min[i] = 256;
+    }
+    for (int y = 0; y < H; y++) {
+        for (int x = 0; x < W; x++) {
+            in(x, y) = (uint8_t)(rand() & 0xff);
+            reference_hist[in(x, y)]++;
+            reference_sum[in(x, y) % 8] += in(x, y) * 0.5f;
+            reference_min[x % 8] = std::min(reference_min[x % 8], (int)in(x, y) + y);
+        }
+    }
+
+    Target target = get_jit_target_from_environment();
+    Var x("x");
+    RDom r(in);
+
+    {
+        // A histogram, using an atomic add.
+        Func hist("hist");
+        hist(x) = 0;
+        hist(cast<int>(in(r.x, r.y))) += 1;
+        if (target.has_gpu_feature()) {
+            RVar rxo, ryo, rxi, ryi;
+            hist.update().atomic().gpu_tile(r.x, r.y, rxo, ryo, rxi, ryi, 16, 16);
+        } else {
+            hist.update().atomic().parallel(r.y);
+        }
+
+        Buffer<int> out = hist.realize(256);
+        for (int i = 0; i < 256; i++) {
+            if (out(i) != reference_hist[i]) {
+                printf("hist(%d) = %d instead of %d\n", i, out(i), reference_hist[i]);
+                return -1;
+            }
+        }
+    }
+
+    {
+        // A float sum, using a compare-and-swap loop. The order of
+        // the additions doesn't matter, because the values are all
+        // small multiples of a half.
+        Func sum("sum");
+        sum(x) = 0.0f;
+        sum(in(r.x, r.y) % 8) += in(r.x, r.y) * 0.5f;
+        sum.update().atomic().parallel(r.y);
+
+        Buffer<float> out = sum.realize(8);
+        for (int i = 0; i < 8; i++) {
+            if (out(i) != reference_sum[i]) {
+                printf("sum(%d) = %f instead of %f\n", i, out(i), reference_sum[i]);
+                return -1;
+            }
+        }
+    }
+
+    {
+        // A min, with the update vectorized too.
+        Func m("m");
+        m(x) = 256;
+        m(r.x % 8) = min(m(r.x % 8), cast<int>(in(r.x, r.y)) + r.y);
+        RVar rxo, rxi;
+        m.update().atomic().split(r.x, rxo, rxi, 8).vectorize(rxi).parallel(r.y);
+
+        Buffer<int> out = m.realize(8);
+        for (int i = 0; i < 8; i++) {
+            if (out(i) != reference_min[i]) {
+                printf("m(%d) = %d instead of %d\n", i, out(i), reference_min[i]);
+                return -1;
+            }
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
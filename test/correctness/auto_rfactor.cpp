@@ -0,0 +1,58 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+
+// Parallelizing over an RVar of an associative update rfactors it,
+// rather than raising a race condition error.
+
+int main(int argc, char **argv) {
+    const int W = 200, H = 300;
+
+    Buffer<uint8_t> in(W, H);
+    int reference_hist[256] = {0};
+    int64_t reference_sum = 0;
+    for (int y = 0; y < H; y++) {
+        for (int x = 0; x < W; x++) {
+            in(x, y) = (uint8_t)(rand() & 0xff);
+            reference_hist[in(x, y)]++;
+            reference_sum += in(x, y);
+        }
+    }
+
+    Var x("x");
+    RDom r(in);
+
+    {
+        // A full-image sum.
+        Func sum("sum");
+        sum() = cast<int64_t>(0);
+        sum() += cast<int64_t>(in(r.x, r.y));
+        sum.update().parallel(r.y);
+
+        Buffer<int64_t> out = sum.realize();
+        if (out() != reference_sum) {
+            printf("sum = %lld instead of %lld\n", (long long)out(), (long long)reference_sum);
+            return -1;
+        }
+    }
+
+    {
+        // A histogram.
+        Func hist("hist");
+        hist(x) = 0;
+        hist(cast<int>(in(r.x, r.y))) += 1;
+        hist.update().parallel(r.y);
+
+        Buffer<int> out = hist.realize(256);
+        for (int i = 0; i < 256; i++) {
+            if (out(i) != reference_hist[i]) {
+                printf("hist(%d) = %d instead of %d\n", i, out(i), reference_hist[i]);
+                return -1;
+            }
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
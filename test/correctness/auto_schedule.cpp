@@ -0,0 +1,55 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+
+// Auto-scheduling a pipeline shouldn't change what it computes, and
+// should describe the schedule it chose.
+
+int main(int argc, char **argv) {
+    const int W = 512, H = 256;
+
+    Buffer<uint16_t> input(W + 2, H + 2);
+    for (int y = 0; y < input.height(); y++) {
+        for (int x = 0; x < input.width(); x++) {
+            input(x, y) = (x * 17 + y * 31) & 0xfff;
+        }
+    }
+
+    Var x("x"), y("y");
+    Func blur_x("blur_x"), blur_y("blur_y"), hist("hist"), out("out");
+    blur_x(x, y) = (input(x, y) + input(x + 1, y) + input(x + 2, y)) / 3;
+    blur_y(x, y) = (blur_x(x, y) + blur_x(x, y + 1) + blur_x(x, y + 2)) / 3;
+
+    // A reduction, which can't be inlined.
+    RDom r(0, 16);
+    hist(x, y) = cast<uint32_t>(0);
+    hist(x, y) += cast<uint32_t>(blur_y(x, y) >> r);
+
+    out(x, y) = hist(x, y) + blur_y(x, y);
+
+    Buffer<uint32_t> reference = out.realize(W, H);
+
+    Pipeline p(out);
+    std::string schedule = p.auto_schedule(get_jit_target_from_environment(),
+                                           {{"out", {{0, W}, {0, H}}}});
+    printf("%s", schedule.c_str());
+    if (schedule.find("hist") == std::string::npos) {
+        printf("The schedule should compute hist somewhere\n");
+        return -1;
+    }
+
+    Buffer<uint32_t> result = p.realize(W, H);
+    for (int y = 0; y < H; y++) {
+        for (int x = 0; x < W; x++) {
+            if (result(x, y) != reference(x, y)) {
+                printf("result(%d, %d) = %d instead of %d\n",
+                       x, y, result(x, y), reference(x, y));
+                return -1;
+            }
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,85 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+using namespace Halide::Internal;
+
+// Check whether the vector loads of the given Func are dense.
+class CheckDenseLoads : public IRMutator {
+    std::string func;
+    bool dense;
+public:
+    CheckDenseLoads(const std::string &f, bool d) : func(f), dense(d) {}
+    using IRMutator::mutate;
+
+    Stmt mutate(Stmt s) {
+        class FindLoads : public IRVisitor {
+            using IRVisitor::visit;
+            void visit(const Load *op) {
+                if (op->name == func && op->type.is_vector()) {
+                    const Ramp *r = op->index.as<Ramp>();
+                    if (r && is_one(r->stride)) {
+                        dense_loads++;
+                    } else {
+                        other_loads++;
+                    }
+                }
+                IRVisitor::visit(op);
+            }
+        public:
+            std::string func;
+            int dense_loads = 0, other_loads = 0;
+        } finder;
+        finder.func = func;
+        s.accept(&finder);
+        if (dense && (finder.dense_loads == 0 || finder.other_loads != 0)) {
+            printf("Vector loads of %s should have been dense\n", func.c_str());
+            exit(-1);
+        }
+        if (!dense && finder.dense_loads != 0) {
+            printf("Vector loads of %s should not have been dense\n", func.c_str());
+            exit(-1);
+        }
+        return s;
+    }
+};
+
+int check(const Buffer<int> &out) {
+    for (int y = 0; y < out.height(); y++) {
+        for (int x = 0; x < out.width(); x++) {
+            int correct = (y * 3 + x) * 2;
+            if (out(x, y) != correct) {
+                printf("out(%d, %d) = %d instead of %d\n", x, y, out(x, y), correct);
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    Var x("x"), y("y"), xi("xi"), yi("yi");
+
+    for (int fixed = 0; fixed < 2; fixed++) {
+        Func f("f"), g("g");
+        f(x, y) = x * 3 + y;
+        g(x, y) = f(y, x) * 2;
+
+        // g reads f transposed, vectorized across the second
+        // dimension of f, and f is computed vectorized across that
+        // dimension too. Unless the storage order of f is given,
+        // that dimension should be stored innermost.
+        g.tile(x, y, xi, yi, 8, 8).vectorize(xi);
+        f.compute_at(g, x).vectorize(y, 8);
+        if (fixed) {
+            f.reorder_storage(x, y);
+        }
+        g.add_custom_lowering_pass(new CheckDenseLoads("f", !fixed));
+
+        Buffer<int> out = g.realize(32, 32);
+        if (check(out)) return -1;
+    }
+
+    printf("Success!\n");
+    return 0;
+}
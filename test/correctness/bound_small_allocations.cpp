@@ -0,0 +1,58 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+
+int heap_allocations = 0;
+
+void *my_malloc(void *user_context, size_t x) {
+    heap_allocations++;
+    void *orig = malloc(x + 32);
+    void *ptr = (void *)((((size_t)orig + 32) >> 5) << 5);
+    ((void **)ptr)[-1] = orig;
+    return ptr;
+}
+
+void my_free(void *user_context, void *ptr) {
+    free(((void **)ptr)[-1]);
+}
+
+int main(int argc, char **argv) {
+    Func f("f"), g("g");
+    Var x("x"), xo("xo"), xi("xi");
+    Param<int> p;
+
+    // The region of f needed per tile of g depends on p, so f's
+    // allocation has a dynamic size, but it is never more than 72
+    // elements.
+    f(x) = x * 2;
+    g(x) = f(x) + f(x + clamp(p, 0, 8));
+    g.split(x, xo, xi, 64);
+    f.compute_at(g, xo);
+
+    Target t = get_jit_target_from_environment().with_feature(Target::LargeStack);
+    g.compile_jit(t);
+    g.set_custom_allocator(&my_malloc, &my_free);
+
+    for (int v = 0; v < 12; v += 5) {
+        p.set(v);
+        Buffer<int> out = g.realize(200, t);
+        int offset = std::min(std::max(v, 0), 8);
+        for (int i = 0; i < 200; i++) {
+            int correct = i * 2 + (i + offset) * 2;
+            if (out(i) != correct) {
+                printf("out(%d) = %d instead of %d\n", i, out(i), correct);
+                return -1;
+            }
+        }
+    }
+
+    if (heap_allocations != 0) {
+        printf("f should have been placed on the stack, but there were %d heap allocations\n",
+               heap_allocations);
+        return -1;
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,68 @@
+#include "Halide.h"
+#include <stdio.h>
+#include <algorithm>
+
+using namespace Halide;
+
+// Estimates on Params and buffers feed auto_schedule, and unlike
+// constraints they aren't checked at runtime.
+
+int main(int argc, char **argv) {
+    ImageParam input(Float(32), 2, "input");
+    Param<int> taps("taps");
+    input.dim(0).set_bounds_estimate(0, 1024);
+    input.dim(1).set_bounds_estimate(0, 512);
+    taps.set_estimate(5);
+
+    if (!input.dim(0).extent_estimate().defined() ||
+        !taps.get_estimate().defined()) {
+        printf("Estimates weren't recorded\n");
+        return -1;
+    }
+
+    Var x("x"), y("y");
+    RDom r(0, taps);
+    Func clamped("clamped"), blur("blur"), out("out");
+    clamped(x, y) = input(clamp(x, 0, input.width() - 1), clamp(y, 0, input.height() - 1));
+    blur(x, y) = 0.0f;
+    blur(x, y) += clamped(x + r, y);
+    out(x, y) = blur(x, y) * 2;
+
+    // Estimate the output from the input estimates too.
+    out.output_buffer().dim(0).set_bounds_estimate(0, 1024);
+    out.output_buffer().dim(1).set_bounds_estimate(0, 512);
+
+    Pipeline p(out);
+    std::string schedule = p.auto_schedule(get_jit_target_from_environment(), {});
+    printf("%s", schedule.c_str());
+
+    // Use sizes other than the estimates, which must still work. The
+    // schedule assumes the output is no smaller than estimated.
+    const int W = 1030, H = 520, T = 3;
+    Buffer<float> in(W, H);
+    for (int y = 0; y < H; y++) {
+        for (int x = 0; x < W; x++) {
+            in(x, y) = (float)(x + y * W);
+        }
+    }
+    input.set(in);
+    taps.set(T);
+    Buffer<float> result = p.realize(W, H);
+
+    for (int y = 0; y < H; y++) {
+        for (int x = 0; x < W; x++) {
+            float correct = 0;
+            for (int i = 0; i < T; i++) {
+                correct += in(std::min(x + i, W - 1), y);
+            }
+            correct *= 2;
+            if (result(x, y) != correct) {
+                printf("result(%d, %d) = %f instead of %f\n", x, y, result(x, y), correct);
+                return -1;
+            }
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,56 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+
+int main(int argc, char **argv) {
+    ImageParam input(Float(32), 2, "input");
+    Param<float> scale("scale");
+    Param<int> offset("offset");
+    Func f("f");
+    Var x("x"), y("y");
+    f(x, y) = input(x, y) * scale + offset;
+
+    // Pass the arguments in a different order than the one
+    // infer_arguments would use.
+    Pipeline p(f);
+    Callable c = p.compile_to_callable({scale, input, offset});
+    if (c.arguments().size() != 4 ||
+        c.arguments()[0].name != "scale" ||
+        c.arguments()[3].kind != Argument::OutputBuffer) {
+        printf("Wrong arguments for Callable\n");
+        return -1;
+    }
+
+    const int W = 32, H = 16;
+    Buffer<float> in(W, H), out(W, H);
+    in.for_each_element([&](int x, int y) {
+        in(x, y) = x + y * 100.0f;
+    });
+
+    for (int i = 0; i < 100; i++) {
+        c(0.5f * i, in, i, out);
+        for (int y = 0; y < H; y++) {
+            for (int x = 0; x < W; x++) {
+                float correct = in(x, y) * (0.5f * i) + i;
+                if (out(x, y) != correct) {
+                    printf("out(%d, %d) = %f instead of %f\n", x, y, out(x, y), correct);
+                    return -1;
+                }
+            }
+        }
+    }
+
+    // The Callable keeps working after the pipeline is rescheduled
+    // and its cached code is discarded.
+    f.vectorize(x, 4);
+    p.invalidate_cache();
+    c(1.0f, in, 0, out);
+    if (out(3, 2) != in(3, 2)) {
+        printf("Callable stopped working after invalidate_cache\n");
+        return -1;
+    }
+
+    printf("Success!\n");
+    return 0;
+}
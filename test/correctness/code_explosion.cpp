@@ -33,6 +33,22 @@ int main(int argc, char **argv) {
 
     f.realize(10);
 
+    // Test a nest of highly connected index exprs. Bounds inference
+    // will barf if it visits this as a tree.
+    Buffer<int> input(size);
+    input.fill(0);
+    std::vector<Expr> idx(size);
+    idx[0] = x;
+    idx[1] = x;
+    for (size_t i = 2; i < idx.size(); i++) {
+        idx[i] = clamp(idx[i-1] + idx[i-2], 0, size - 1);
+    }
+
+    Func h;
+    h(x) = input(idx[idx.size()-1]);
+
+    h.realize(10);
+
     printf("Success!\n");
     return 0;
 }
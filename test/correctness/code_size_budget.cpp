@@ -0,0 +1,103 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+using namespace Halide::Internal;
+
+// Counts the loops over two variables in the lowered pipeline.
+class CountLoops : public IRMutator {
+    std::string a, b;
+    int *count_a, *count_b;
+public:
+    CountLoops(const std::string &a, const std::string &b, int *count_a, int *count_b)
+        : a(a), b(b), count_a(count_a), count_b(count_b) {}
+    using IRMutator::mutate;
+
+    Stmt mutate(Stmt s) {
+        class FindLoops : public IRVisitor {
+            using IRVisitor::visit;
+            void visit(const For *op) {
+                counts[op->name]++;
+                IRVisitor::visit(op);
+            }
+        public:
+            std::map<std::string, int> counts;
+        } finder;
+        s.accept(&finder);
+        *count_a = finder.counts[a];
+        *count_b = finder.counts[b];
+        return s;
+    }
+};
+
+// A pipeline with an unrolled loop and a boundary condition to
+// partition a loop for.
+Func make_pipeline(Buffer<int> in, float budget, Target t, int *unrolled_loops, int *partitioned_loops) {
+    Var x("x"), y("y"), xi("xi");
+    Func clamped = BoundaryConditions::repeat_edge(in);
+    Func f("f"), g("g");
+    f(x, y) = clamped(x - 1, y) + clamped(x, y) * 3 + clamped(x + 1, y);
+    g(x, y) = f(x, y) * 2 + f(x, y + 1);
+    f.compute_at(g, y).split(x, x, xi, 8).unroll(xi);
+    if (budget > 0) {
+        f.code_size_budget(budget);
+    }
+    g.add_custom_lowering_pass(new CountLoops("f.s0.x.xi", "f.s0.x.x", unrolled_loops, partitioned_loops));
+    g.compile_jit(t);
+    return g;
+}
+
+bool check(Func g, Buffer<int> in) {
+    Buffer<int> out = g.realize(in.width(), in.height() - 1);
+    for (int y = 0; y < out.height(); y++) {
+        for (int x = 0; x < out.width(); x++) {
+            auto f = [&](int x, int y) {
+                auto c = [&](int x) { return in(std::min(std::max(x, 0), in.width() - 1), y); };
+                return c(x - 1) + c(x) * 3 + c(x + 1);
+            };
+            int correct = f(x, y) * 2 + f(x, y + 1);
+            if (out(x, y) != correct) {
+                printf("out(%d, %d) = %d instead of %d\n", x, y, out(x, y), correct);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    Buffer<int> in(67, 20);
+    in.for_each_element([&](int x, int y) { in(x, y) = x * 7 + y * 13; });
+    Target t = get_jit_target_from_environment();
+
+    // Without a budget, the loop over xi is unrolled away, and the
+    // loop over x is split into a prologue, steady state and epilogue.
+    int unrolled = 0, partitioned = 0;
+    Func g = make_pipeline(in, 0, t, &unrolled, &partitioned);
+    if (unrolled != 0 || partitioned < 2) {
+        printf("Without a budget, there are %d loops over xi and %d over x\n", unrolled, partitioned);
+        return -1;
+    }
+    if (!check(g, in)) return -1;
+
+    // With no room to grow, neither happens.
+    g = make_pipeline(in, 1, t, &unrolled, &partitioned);
+    if (unrolled != 1 || partitioned != 1) {
+        printf("With a budget of 1, there are %d loops over xi and %d over x\n", unrolled, partitioned);
+        return -1;
+    }
+    if (!check(g, in)) return -1;
+
+    // With the small_code feature, the budget is twice the size of
+    // the code, which unrolling the loop around the body of f by 8
+    // doesn't fit in.
+    g = make_pipeline(in, 0, t.with_feature(Target::SmallCode), &unrolled, &partitioned);
+    if (unrolled != 1) {
+        printf("With small_code, there are %d loops over xi\n", unrolled);
+        return -1;
+    }
+    if (!check(g, in)) return -1;
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,42 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+
+int main(int argc, char **argv) {
+    Var x, y;
+
+    // A Func shared by all of the pipelines.
+    Func input;
+    input(x, y) = x * 3 + y;
+    input.compute_root();
+
+    const int count = 8;
+    std::vector<Pipeline> pipelines;
+    for (int i = 0; i < count; i++) {
+        Func blur;
+        blur(x, y) = input(x - 1, y) + input(x, y) * i + input(x + 1, y);
+        blur.vectorize(x, 8).parallel(y);
+        pipelines.push_back(blur);
+    }
+    // Pipelines that appear twice are only compiled once.
+    pipelines.push_back(pipelines[0]);
+
+    Pipeline::compile_jit_in_parallel(pipelines);
+
+    for (int i = 0; i < count; i++) {
+        Buffer<int> out = pipelines[i].realize(64, 16);
+        for (int j = 0; j < out.height(); j++) {
+            for (int k = 0; k < out.width(); k++) {
+                int correct = (2 + i) * (k * 3 + j);
+                if (out(k, j) != correct) {
+                    printf("out_%d(%d, %d) = %d instead of %d\n", i, k, j, out(k, j), correct);
+                    return -1;
+                }
+            }
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,41 @@
+#include "Halide.h"
+#include <stdio.h>
+#include <fstream>
+
+using namespace Halide;
+
+bool is_bitcode(const std::string &filename) {
+    std::ifstream f(filename, std::ios::binary);
+    unsigned char magic[4] = {0};
+    f.read((char *)magic, 4);
+    return magic[0] == 'B' && magic[1] == 'C' && magic[2] == 0xC0 && magic[3] == 0xDE;
+}
+
+int main(int argc, char **argv) {
+    Func f("f");
+    Var x("x");
+    Param<int> offset("offset");
+    f(x) = x * 2 + offset;
+
+    // The pipeline without the runtime, and the runtime in a module
+    // of its own.
+    Target target = get_host_target();
+    const char *pipeline_file = "compile_to_thin_lto_bitcode.thinlto.bc";
+    const char *runtime_file = "compile_to_thin_lto_bitcode_runtime.thinlto.bc";
+    Internal::ensure_no_file_exists(pipeline_file);
+    Internal::ensure_no_file_exists(runtime_file);
+
+    f.compile_to(Outputs().thin_lto_bitcode(pipeline_file), {offset}, "compile_to_thin_lto_bitcode",
+                 target.with_feature(Target::NoRuntime));
+    compile_standalone_runtime(Outputs().thin_lto_bitcode(runtime_file), target);
+
+    Internal::assert_file_exists(pipeline_file);
+    Internal::assert_file_exists(runtime_file);
+    if (!is_bitcode(pipeline_file) || !is_bitcode(runtime_file)) {
+        printf("ThinLTO output isn't llvm bitcode\n");
+        return -1;
+    }
+
+    printf("Success!\n");
+    return 0;
+}
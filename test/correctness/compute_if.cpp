@@ -0,0 +1,69 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+
+#ifdef _WIN32
+#define DLLEXPORT __declspec(dllexport)
+#else
+#define DLLEXPORT
+#endif
+
+int call_count = 0;
+extern "C" DLLEXPORT int call_counter(int x) {
+    call_count++;
+    return x;
+}
+HalideExtern_1(int, call_counter, int);
+
+int main(int argc, char **argv) {
+    const int W = 128, H = 64, T = 16;
+
+    // A mask with only a few non-empty tiles.
+    Buffer<uint8_t> mask(W, H);
+    mask.fill(0);
+    int nonempty_tiles = 0;
+    for (int ty = 0; ty < H / T; ty++) {
+        for (int tx = 0; tx < W / T; tx++) {
+            if ((tx + 3 * ty) % 7 == 0) {
+                mask(tx * T + (tx % T), ty * T + (ty % T)) = 1;
+                nonempty_tiles++;
+            }
+        }
+    }
+
+    Var x, y, xo, yo, xi, yi;
+    RDom r(0, T, 0, T);
+
+    Func empty, expensive, out;
+    empty(x, y) = maximum(mask(T * x + r.x, T * y + r.y)) == 0;
+    expensive(x, y) = call_counter(x + y * 3);
+    out(x, y) = select(empty(x / T, y / T), 0, expensive(x, y) + 1);
+
+    empty.compute_root();
+    out.tile(x, y, xo, yo, xi, yi, T, T, TailStrategy::GuardWithIf);
+    expensive.compute_at(out, xo).compute_if(!empty(xo, yo));
+
+    Buffer<int> result = out.realize(W, H);
+
+    for (int j = 0; j < H; j++) {
+        for (int i = 0; i < W; i++) {
+            int tx = i / T, ty = j / T;
+            int correct = ((tx + 3 * ty) % 7 == 0) ? i + j * 3 + 1 : 0;
+            if (result(i, j) != correct) {
+                printf("result(%d, %d) = %d instead of %d\n", i, j, result(i, j), correct);
+                return -1;
+            }
+        }
+    }
+
+    // Only the non-empty tiles were computed.
+    if (call_count != nonempty_tiles * T * T) {
+        printf("expensive was evaluated at %d points instead of %d\n",
+               call_count, nonempty_tiles * T * T);
+        return -1;
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,129 @@
+#include "Halide.h"
+#include <stdio.h>
+#include <string>
+
+using namespace Halide;
+using namespace Halide::Internal;
+
+// Stages computed with each other should share their loops down to
+// the fused level, and still compute the same thing.
+
+// Check that no loop over the child's fused var survived lowering.
+class CheckFused : public IRMutator {
+    std::string loop;
+public:
+    CheckFused(const std::string &l) : loop(l) {}
+    using IRMutator::mutate;
+
+    Stmt mutate(Stmt s) {
+        class FindLoop : public IRVisitor {
+            using IRVisitor::visit;
+            void visit(const For *op) {
+                if (starts_with(op->name, loop)) {
+                    found = true;
+                }
+                IRVisitor::visit(op);
+            }
+        public:
+            std::string loop;
+            bool found = false;
+        } finder;
+        finder.loop = loop;
+        s.accept(&finder);
+        if (finder.found) {
+            printf("There was still a loop over %s\n", loop.c_str());
+            exit(-1);
+        }
+        return s;
+    }
+};
+
+int main(int argc, char **argv) {
+    const int W = 67, H = 45;
+    Buffer<int> input(W + 4, H + 4);
+    for (int y = 0; y < input.height(); y++) {
+        for (int x = 0; x < input.width(); x++) {
+            input(x, y) = x * 7 + y * 3;
+        }
+    }
+
+    Var x("x"), y("y");
+
+    {
+        // Two siblings over different regions, fused at y. The loop
+        // over x within each is scheduled independently.
+        Func f("f"), g("g"), h("h");
+        f(x, y) = input(x, y) * 2;
+        g(x, y) = input(x, y) + 1;
+        h(x, y) = f(x, y) + g(x + 1, y + 2);
+
+        f.compute_root().vectorize(x, 8);
+        g.compute_root().compute_with(f, y);
+        h.add_custom_lowering_pass(new CheckFused("g.s0.y"));
+
+        Buffer<int> out = h.realize(W, H);
+        for (int y = 0; y < H; y++) {
+            for (int x = 0; x < W; x++) {
+                int correct = input(x, y) * 2 + input(x + 1, y + 2) + 1;
+                if (out(x, y) != correct) {
+                    printf("out(%d, %d) = %d instead of %d\n", x, y, out(x, y), correct);
+                    return -1;
+                }
+            }
+        }
+    }
+
+    {
+        // Update stages, fused with the update stage of the other Func.
+        Func f("f"), g("g"), h("h");
+        RDom r(0, 3);
+        f(x, y) = input(x, y);
+        f(x, y) += input(x + r, y);
+        g(x, y) = input(x, y) * 3;
+        g(x, y) += input(x, y + r);
+        h(x, y) = f(x, y) - g(x, y);
+
+        f.compute_root().parallel(y);
+        f.update(0).parallel(y);
+        g.compute_root().parallel(y).compute_with(f, y);
+        g.update(0).parallel(y).compute_with(f.update(0), y);
+        h.add_custom_lowering_pass(new CheckFused("g.s"));
+
+        Buffer<int> out = h.realize(W, H);
+        for (int y = 0; y < H; y++) {
+            for (int x = 0; x < W; x++) {
+                int fv = input(x, y), gv = input(x, y) * 3;
+                for (int i = 0; i < 3; i++) {
+                    fv += input(x + i, y);
+                    gv += input(x, y + i);
+                }
+                if (out(x, y) != fv - gv) {
+                    printf("out(%d, %d) = %d instead of %d\n", x, y, out(x, y), fv - gv);
+                    return -1;
+                }
+            }
+        }
+    }
+
+    {
+        // Two outputs of the same pipeline, fused down to x.
+        Func f("f"), g("g");
+        f(x, y) = input(x, y) - y;
+        g(x, y) = input(x, y) * x;
+        g.compute_with(f, x);
+
+        Buffer<int> fo(W, H), go(W, H);
+        Pipeline({f, g}).realize({fo, go});
+        for (int y = 0; y < H; y++) {
+            for (int x = 0; x < W; x++) {
+                if (fo(x, y) != input(x, y) - y || go(x, y) != input(x, y) * x) {
+                    printf("f(%d, %d) = %d, g(%d, %d) = %d\n", x, y, fo(x, y), x, y, go(x, y));
+                    return -1;
+                }
+            }
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,78 @@
+#include "Halide.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace Halide;
+
+// Read a file written by debug_to_file, and check its header and that
+// its values are given by the function 'correct'.
+template<typename F>
+bool check_file(const std::string &filename, int w, int h, F correct) {
+    FILE *file = fopen(filename.c_str(), "rb");
+    if (!file) {
+        printf("Can't open %s\n", filename.c_str());
+        return false;
+    }
+    int header[5];
+    std::vector<int> data(w * h);
+    bool ok = (fread(header, 4, 5, file) == 5 &&
+               header[0] == w && header[1] == h &&
+               header[2] == 1 && header[3] == 1 && header[4] == 7 &&
+               fread(&data[0], 4, w * h, file) == (size_t)(w * h));
+    fclose(file);
+    if (!ok) {
+        printf("Bad header or size in %s\n", filename.c_str());
+        return false;
+    }
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++) {
+            if (data[y * w + x] != correct(x, y)) {
+                printf("%s(%d, %d) = %d instead of %d\n",
+                       filename.c_str(), x, y, data[y * w + x], correct(x, y));
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+#ifdef _WIN32
+    printf("Skipping test because it uses setenv\n");
+    return 0;
+#else
+    setenv("HL_DEBUG_TO_FILE_ASYNC", "1", 1);
+
+    Internal::TemporaryFile f_file("f", "tmp"), g_file("g", "tmp");
+
+    const int W = 64, H = 32;
+    Func f("f"), g("g"), h("h");
+    Var x, y;
+    f(x, y) = x + y * 256;
+    g(x, y) = f(x, y) * 2;
+    h(x, y) = f(x, y) + g(x, y);
+
+    // f is written once per row of h, so the writes to its file must
+    // happen in order for the file to hold the last row. g is stored
+    // transposed, so its rows are not contiguous.
+    f.compute_at(h, y).debug_to_file(f_file.pathname());
+    g.compute_root().reorder_storage(y, x).debug_to_file(g_file.pathname());
+
+    Buffer<int> out = h.realize(W, H);
+
+    // The files must be complete when the pipeline returns.
+    if (!check_file(f_file.pathname(), W, 1,
+                    [&](int x, int y) { return x + (H - 1) * 256; })) {
+        return -1;
+    }
+    if (!check_file(g_file.pathname(), W, H,
+                    [&](int x, int y) { return (x + y * 256) * 2; })) {
+        return -1;
+    }
+
+    unsetenv("HL_DEBUG_TO_FILE_ASYNC");
+
+    printf("Success!\n");
+    return 0;
+#endif
+}
@@ -0,0 +1,75 @@
+#include "Halide.h"
+#include <stdio.h>
+#include <algorithm>
+
+using namespace Halide;
+
+int main(int argc, char **argv) {
+    const int W = 100, H = 37, ranks = 4;
+
+    ImageParam input(Int(32), 2);
+    Param<int> rank, num_ranks;
+    Func blur_x, blur_y;
+    Var x, y;
+
+    // A stencil, so that each rank needs a halo of the input and of
+    // blur_x around its own slice.
+    blur_x(x, y) = input(x - 1, y) + input(x, y) + input(x + 1, y);
+    blur_y(x, y) = blur_x(x, y - 1) + blur_x(x, y) + blur_x(x, y + 1);
+    blur_x.compute_root();
+    blur_y.distribute(y, rank, num_ranks);
+    num_ranks.set(ranks);
+
+    Buffer<int> in(W + 2, H + 2);
+    in.set_min(-1, -1);
+    in.for_each_element([&](int x, int y) { in(x, y) = x * 3 + y * 7; });
+
+    const int sentinel = 0x12345678;
+    Buffer<int> out(W, H);
+    out.fill(sentinel);
+    for (int r = 0; r < ranks; r++) {
+        rank.set(r);
+
+        // Each rank only needs its own rows of the input, plus a halo.
+        input.reset();
+        blur_y.infer_input_bounds(W, H);
+        Buffer<int> required = input.get();
+        int slice = (H + ranks - 1) / ranks;
+        int expected_min = r * slice - 1;
+        int expected_max = std::min((r + 1) * slice, H);
+        if (required.dim(1).min() != expected_min || required.dim(1).max() != expected_max) {
+            printf("Rank %d requires rows %d to %d of the input instead of %d to %d\n",
+                   r, required.dim(1).min(), required.dim(1).max(),
+                   expected_min, expected_max);
+            return -1;
+        }
+
+        input.set(in);
+        blur_y.realize(out);
+
+        // Only the rows of this rank and the ranks before it are
+        // written so far.
+        for (int j = 0; j < H; j++) {
+            bool written = j < std::min((r + 1) * slice, H);
+            for (int i = 0; i < W; i++) {
+                int correct = 0;
+                for (int dy = -1; dy <= 1; dy++) {
+                    for (int dx = -1; dx <= 1; dx++) {
+                        correct += in(i + dx, j + dy);
+                    }
+                }
+                if (!written) {
+                    correct = sentinel;
+                }
+                if (out(i, j) != correct) {
+                    printf("After rank %d: out(%d, %d) = %d instead of %d\n",
+                           r, i, j, out(i, j), correct);
+                    return -1;
+                }
+            }
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
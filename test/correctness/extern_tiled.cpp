@@ -0,0 +1,100 @@
+#include "Halide.h"
+#include <atomic>
+#include <stdio.h>
+
+using namespace Halide;
+
+#ifdef _WIN32
+#define DLLEXPORT __declspec(dllexport)
+#else
+#define DLLEXPORT
+#endif
+
+std::atomic<int> calls;
+std::atomic<int> max_extent_x, max_extent_y;
+
+void update_max(std::atomic<int> &m, int v) {
+    int old = m;
+    while (v > old && !m.compare_exchange_weak(old, v)) {}
+}
+
+// Fill in a region of a 2D image of ints.
+extern "C" DLLEXPORT int fill(buffer_t *out) {
+    if (!out->host) {
+        // It can produce any region asked for.
+        return 0;
+    }
+    calls++;
+    update_max(max_extent_x, out->extent[0]);
+    update_max(max_extent_y, out->extent[1]);
+    for (int y = 0; y < out->extent[1]; y++) {
+        int *dst = (int *)out->host + y * out->stride[1];
+        for (int x = 0; x < out->extent[0]; x++) {
+            dst[x] = (x + out->min[0]) + 100 * (y + out->min[1]);
+        }
+    }
+    return 0;
+}
+
+int check(Buffer<int> out, int scale, int expected_calls, int expected_x, int expected_y) {
+    for (int y = 0; y < out.height(); y++) {
+        for (int x = 0; x < out.width(); x++) {
+            int correct = scale * (x + 100 * y);
+            if (out(x, y) != correct) {
+                printf("out(%d, %d) = %d instead of %d\n", x, y, out(x, y), correct);
+                return -1;
+            }
+        }
+    }
+    if (calls != expected_calls || max_extent_x != expected_x || max_extent_y != expected_y) {
+        printf("%d calls of up to %d x %d instead of %d calls of up to %d x %d\n",
+               (int)calls, (int)max_extent_x, (int)max_extent_y,
+               expected_calls, expected_x, expected_y);
+        return -1;
+    }
+    calls = max_extent_x = max_extent_y = 0;
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    Var x, y, xo, yo, xi, yi;
+
+    {
+        // Call the extern function once per tile of a root Func.
+        Func f, g;
+        f.define_extern("fill", {}, Int(32), {x, y});
+        g(x, y) = f(x, y) * 2;
+        f.compute_root().tile(x, y, xo, yo, xi, yi, 16, 8);
+
+        if (check(g.realize(100, 40), 2, 7 * 5, 16, 8) != 0) {
+            return -1;
+        }
+    }
+
+    {
+        // Call it over parallel strips, within tiles of the consumer.
+        Func f, g;
+        f.define_extern("fill", {}, Int(32), {x, y});
+        g(x, y) = f(x, y) * 3;
+        g.split(y, yo, yi, 16).parallel(yo);
+        f.compute_at(g, yo).split(y, y, yi, 4).parallel(y);
+
+        if (check(g.realize(64, 64), 3, 16, 64, 4) != 0) {
+            return -1;
+        }
+    }
+
+    {
+        // An extern output, with a ragged last tile.
+        Func f;
+        f.define_extern("fill", {}, Int(32), {x, y});
+        f.split(x, xo, xi, 32, TailStrategy::GuardWithIf);
+
+        if (check(f.realize(100, 10), 1, 4, 32, 10) != 0) {
+            return -1;
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,60 @@
+#include "Halide.h"
+#include <stdio.h>
+#include <math.h>
+
+using namespace Halide;
+
+int main(int argc, char **argv) {
+    Target t = get_jit_target_from_environment();
+    Target fast = t.with_feature(Target::FastMath);
+
+    // A float reduction, which fast math lets LLVM vectorize by
+    // reassociating it. The result should still be close.
+    const int N = 1024;
+    Buffer<float> in(N);
+    in.for_each_element([&](int x) { in(x) = sinf(x * 0.1f); });
+
+    RDom r(0, N);
+    Func dot("dot");
+    dot() = 0.0f;
+    dot() += in(r) * in(r);
+
+    float strict = Buffer<float>(dot.realize(t))();
+    float relaxed = Buffer<float>(dot.realize(fast))();
+    if (fabs(strict - relaxed) > 1e-3f * fabs(strict)) {
+        printf("Sum with fast math is %f instead of %f\n", relaxed, strict);
+        return -1;
+    }
+
+    if (t.arch == Target::X86) {
+        // Denormal results are flushed to zero with fast math on x86.
+        Buffer<float> small(4);
+        small.for_each_element([&](int x) { small(x) = (x + 1) * 1e-20f; });
+        Func tiny("tiny");
+        Var x;
+        tiny(x) = small(x) * 1e-20f;
+
+        Buffer<float> strict_tiny = tiny.realize(4, t);
+        if (strict_tiny(0) == 0.0f) {
+            printf("Denormal result was flushed to zero without fast math\n");
+            return -1;
+        }
+        Buffer<float> fast_tiny = tiny.realize(4, fast);
+        for (int i = 0; i < 4; i++) {
+            if (fast_tiny(i) != 0.0f) {
+                printf("Denormal result %g wasn't flushed to zero with fast math\n", fast_tiny(i));
+                return -1;
+            }
+        }
+
+        // It only lasts while the pipeline runs.
+        volatile float a = 1e-20f;
+        if (a * a == 0.0f) {
+            printf("Denormals are still flushed to zero after the pipeline returned\n");
+            return -1;
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,80 @@
+#include "Halide.h"
+#include <stdio.h>
+#include <functional>
+#include <limits>
+
+using namespace Halide;
+
+// Check each fixed-point intrinsic, vectorized, against the same
+// arithmetic done in C++ at a wider type.
+template<typename T, typename W>
+bool test(const char *type_name) {
+    const int N = 256;
+    Buffer<T> a(N), b(N);
+    for (int i = 0; i < N; i++) {
+        // Cover the whole range of the type, including its extremes.
+        a(i) = (T)(i * 37 + 11);
+        b(i) = (T)(i * 101 - 7);
+    }
+
+    W lo = (W)std::numeric_limits<T>::min(), hi = (W)std::numeric_limits<T>::max();
+    auto clamp_to = [&](W x) { return (T)(x < lo ? lo : (x > hi ? hi : x)); };
+    auto floor_div2 = [](W x) { return (W)((x - (x < 0 ? 1 : 0)) / 2); };
+
+    struct {
+        const char *name;
+        std::function<Expr(Expr, Expr)> op;
+        std::function<W(T, T)> reference;
+    } ops[] = {
+        {"saturating_add", saturating_add, [&](T x, T y) { return (W)clamp_to((W)x + (W)y); }},
+        {"saturating_sub", saturating_sub, [&](T x, T y) { return (W)clamp_to((W)x - (W)y); }},
+        {"halving_add", halving_add, [&](T x, T y) { return floor_div2((W)x + (W)y); }},
+        {"rounding_halving_add", rounding_halving_add, [&](T x, T y) { return floor_div2((W)x + (W)y + 1); }},
+        {"widening_mul", widening_mul, [&](T x, T y) { return (W)((W)x * (W)y); }},
+    };
+
+    Var x;
+    for (auto &o : ops) {
+        Func f;
+        f(x) = cast<W>(o.op(a(x), b(x)));
+        f.vectorize(x, 16);
+        Buffer<W> result = f.realize(N);
+        for (int i = 0; i < N; i++) {
+            W correct = o.reference(a(i), b(i));
+            if (result(i) != correct) {
+                printf("%s(%s %d, %d) = %d instead of %d\n", o.name, type_name,
+                       (int)a(i), (int)b(i), (int)result(i), (int)correct);
+                return false;
+            }
+        }
+    }
+
+    // Rounding right shifts by every amount the type allows.
+    for (int shift = 0; shift < (int)sizeof(T) * 8; shift++) {
+        Func f;
+        f(x) = rounding_shift_right(a(x), cast<T>(shift));
+        f.vectorize(x, 16);
+        Buffer<T> result = f.realize(N);
+        for (int i = 0; i < N; i++) {
+            W wide = (W)a(i) + (shift ? ((W)1 << (shift - 1)) : 0);
+            T correct = (T)(wide >> shift);
+            if (result(i) != correct) {
+                printf("rounding_shift_right(%s %d, %d) = %d instead of %d\n", type_name,
+                       (int)a(i), shift, (int)result(i), (int)correct);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    if (!test<uint8_t, int32_t>("uint8") ||
+        !test<int8_t, int32_t>("int8") ||
+        !test<uint16_t, int64_t>("uint16") ||
+        !test<int16_t, int64_t>("int16")) {
+        return -1;
+    }
+    printf("Success!\n");
+    return 0;
+}
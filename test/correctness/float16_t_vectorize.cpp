@@ -0,0 +1,91 @@
+#include "Halide.h"
+#include <stdio.h>
+#include <string.h>
+#include <cmath>
+
+using namespace Halide;
+
+// Vectorized Float(16) Funcs should convert to and from float exactly
+// as float16_t does, and round their arithmetic to half-precision
+// after every operation, whether or not the target converts halfs in
+// hardware.
+
+int test(const Target &t) {
+    Var x("x");
+
+    // Every half.
+    Buffer<float16_t> in(65536);
+    for (int i = 0; i < 65536; i++) {
+        in(i) = float16_t::make_from_bits((uint16_t)i);
+    }
+
+    // Floats that cover the range of halfs, from below the smallest
+    // denormal to beyond the largest normal, with low mantissa bits
+    // just below, at, and just above the ties.
+    const uint32_t low_bits[] = {0, 0xfff, 0x1000, 0x1001, 0x1fff};
+    const int exponents = 144 - 102, N = exponents * 1024 * 5 * 2;
+    Buffer<float> in_f(N);
+    for (int i = 0; i < N; i++) {
+        uint32_t exponent = 102 + i % exponents;
+        uint32_t mantissa = (i / exponents) % 1024;
+        uint32_t low = low_bits[(i / (exponents * 1024)) % 5];
+        uint32_t sign = i / (exponents * 1024 * 5);
+        uint32_t bits = (sign << 31) | (exponent << 23) | (mantissa << 13) | low;
+        memcpy(&in_f(i), &bits, sizeof(bits));
+    }
+
+    Func widen("widen"), narrow("narrow"), arith("arith");
+    widen(x) = cast<float>(in(x));
+    narrow(x) = cast<float16_t>(in_f(x));
+    arith(x) = in(x) * in(65535 - x) + float16_t(1.5);
+    widen.vectorize(x, 8);
+    narrow.vectorize(x, 8);
+    arith.vectorize(x, 16);
+
+    Buffer<float> widened = widen.realize(65536, t);
+    for (int i = 0; i < 65536; i++) {
+        float correct = (float)in(i);
+        if (widened(i) != correct && !(in(i).is_nan() && std::isnan(widened(i)))) {
+            printf("%s: half 0x%04x widened to %f instead of %f\n",
+                   t.to_string().c_str(), i, widened(i), correct);
+            return -1;
+        }
+    }
+
+    Buffer<float16_t> narrowed = narrow.realize(N, t);
+    for (int i = 0; i < N; i++) {
+        uint16_t correct = float16_t(in_f(i)).to_bits();
+        if (narrowed(i).to_bits() != correct) {
+            printf("%s: float %g narrowed to 0x%04x instead of 0x%04x\n",
+                   t.to_string().c_str(), in_f(i), narrowed(i).to_bits(), correct);
+            return -1;
+        }
+    }
+
+    Buffer<float16_t> result = arith.realize(65536, t);
+    for (int i = 0; i < 65536; i++) {
+        float16_t correct = in(i) * in(65535 - i) + float16_t(1.5);
+        if (result(i).to_bits() != correct.to_bits() &&
+            !(correct.is_nan() && result(i).is_nan())) {
+            printf("%s: arith(%d) = 0x%04x instead of 0x%04x\n",
+                   t.to_string().c_str(), i, result(i).to_bits(), correct.to_bits());
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    Target t = get_jit_target_from_environment();
+    if (test(t)) return -1;
+
+    // Also check the integer conversions, if the target would
+    // otherwise use F16C.
+    if (t.has_feature(Target::F16C)) {
+        if (test(t.without_feature(Target::F16C))) return -1;
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,57 @@
+#include "Halide.h"
+#include <stdio.h>
+#include <thread>
+#include <vector>
+
+using namespace Halide;
+
+// Run a small GPU pipeline a few times, returning 0 if its output is
+// always correct.
+int run(const Target &target, int k) {
+    Func f, g;
+    Var x, y, xi, yi;
+    f(x, y) = x + y * k;
+    g(x, y) = f(x - 1, y) + f(x + 1, y);
+    g.gpu_tile(x, y, xi, yi, 16, 16);
+    g.compile_jit(target);
+
+    for (int iter = 0; iter < 10; iter++) {
+        Buffer<int> out = g.realize(256, 256);
+        for (int j = 0; j < out.height(); j++) {
+            for (int i = 0; i < out.width(); i++) {
+                int correct = 2 * (i + j * k);
+                if (out(i, j) != correct) {
+                    printf("out(%d, %d) = %d instead of %d\n", i, j, out(i, j), correct);
+                    return -1;
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    Target target = get_jit_target_from_environment();
+    if (!target.has_gpu_feature()) {
+        printf("Not running test because no gpu target enabled\n");
+        return 0;
+    }
+
+    // Several threads drive the GPU at once, sharing one context.
+    std::vector<std::thread> threads;
+    std::vector<int> results(4, 0);
+    for (int k = 0; k < 4; k++) {
+        threads.emplace_back([&, k]() { results[k] = run(target, k + 1); });
+    }
+    for (std::thread &t : threads) {
+        t.join();
+    }
+    for (int r : results) {
+        if (r != 0) {
+            return -1;
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
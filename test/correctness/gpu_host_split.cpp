@@ -0,0 +1,64 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+
+int main(int argc, char **argv) {
+    Target target = get_jit_target_from_environment();
+    if (!target.has_gpu_feature()) {
+        printf("Not running test because no gpu target enabled\n");
+        return 0;
+    }
+
+    Buffer<int> in(256, 256);
+    in.for_each_element([&](int x, int y) { in(x, y) = x + y * 256; });
+
+    ImageParam input(Int(32), 2);
+    Param<float> host_fraction;
+    Func f, g;
+    Var x, y, xi, yi;
+
+    // f is computed partly on the GPU and partly on the host, and g
+    // reads it back on the GPU, so the two parts must be merged.
+    f(x, y) = input(x, y) * 2;
+    f.compute_root().gpu_tile(x, y, xi, yi, 16, 16).gpu_host_split(host_fraction);
+    g(x, y) = f(x, y) + 1;
+    g.gpu_tile(x, y, xi, yi, 16, 16);
+    input.set(in);
+
+    // Try all on the GPU, all on the host, and splits that don't land
+    // on a whole number of blocks.
+    const float fractions[] = {0.0f, 0.5f, 1.0f, 0.3f, 0.95f};
+    for (float fraction : fractions) {
+        host_fraction.set(fraction);
+        Buffer<int> out = g.realize(256, 256, target);
+        for (int j = 0; j < out.height(); j++) {
+            for (int i = 0; i < out.width(); i++) {
+                int correct = (i + j * 256) * 2 + 1;
+                if (out(i, j) != correct) {
+                    printf("out(%d, %d) = %d instead of %d with host fraction %f\n",
+                           i, j, out(i, j), correct, fraction);
+                    return -1;
+                }
+            }
+        }
+    }
+
+    // The output of the pipeline itself can be split too.
+    Func h;
+    h(x, y) = input(x, y) - 3;
+    h.gpu_tile(x, y, xi, yi, 16, 16).gpu_host_split(0.25f);
+    Buffer<int> out = h.realize(256, 256, target);
+    for (int j = 0; j < out.height(); j++) {
+        for (int i = 0; i < out.width(); i++) {
+            int correct = i + j * 256 - 3;
+            if (out(i, j) != correct) {
+                printf("out(%d, %d) = %d instead of %d\n", i, j, out(i, j), correct);
+                return -1;
+            }
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,64 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+
+int check(const Buffer<int> &out, int dx, int dy, int k) {
+    for (int y = 0; y < out.height(); y++) {
+        for (int x = 0; x < out.width(); x++) {
+            int correct = ((x + dx) + (y + dy) * 1024) * k * 2 + 1;
+            if (out(x, y) != correct) {
+                printf("out(%d, %d) = %d instead of %d\n", x, y, out(x, y), correct);
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    Target target = get_jit_target_from_environment();
+    if (!target.has_gpu_feature()) {
+        printf("Not running test because no gpu target enabled\n");
+        return 0;
+    }
+
+    Buffer<int> in(1024, 1024);
+    in.for_each_element([&](int x, int y) { in(x, y) = x + y * 1024; });
+
+    ImageParam input(Int(32), 2);
+    Param<int> dx, dy;
+    Func f, g;
+    Var x, y, xi, yi;
+
+    // f only reads a small part of the input on the device, so only
+    // that part should be copied there.
+    f(x, y) = input(x + dx, y + dy) * 2;
+    f.compute_root().gpu_tile(x, y, xi, yi, 8, 8);
+    g(x, y) = f(x, y) + 1;
+    input.set(in);
+
+    // Read several different regions, so that the device copy of the
+    // input is partially valid when the later ones are read.
+    const int offsets[][2] = {{0, 0}, {100, 200}, {0, 0}, {96, 192}, {1000, 1000}};
+    for (auto o : offsets) {
+        dx.set(o[0]);
+        dy.set(o[1]);
+        Buffer<int> out = g.realize(24, 24, target);
+        if (check(out, o[0], o[1], 1)) return -1;
+    }
+
+    // Change the input on the host, which should invalidate
+    // everything on the device.
+    in.for_each_element([&](int x, int y) { in(x, y) = (x + y * 1024) * 3; });
+    in.set_host_dirty();
+    for (auto o : offsets) {
+        dx.set(o[0]);
+        dy.set(o[1]);
+        Buffer<int> out = g.realize(24, 24, target);
+        if (check(out, o[0], o[1], 3)) return -1;
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,45 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+
+int main(int argc, char **argv) {
+    Target target = get_jit_target_from_environment();
+    if (!target.has_feature(Target::CUDA)) {
+        printf("Not running test because cuda not enabled\n");
+        return 0;
+    }
+
+    Func f, g;
+    Var x, y, xi, yi;
+
+    // A stage with some register pressure, so that the hints matter
+    // to the code generated.
+    f(x, y) = x + y;
+    Expr e = 0;
+    for (int i = 0; i < 16; i++) {
+        e += f(x + i, y) * (i + 1) + f(x, y + i) * (i + 3);
+    }
+    g(x, y) = e;
+    f.compute_root();
+    g.gpu_tile(x, y, xi, yi, 16, 8)
+        .gpu_launch_bounds(128, 4)
+        .gpu_max_registers(32);
+
+    Buffer<int> out = g.realize(128, 128, target);
+    for (int j = 0; j < out.height(); j++) {
+        for (int i = 0; i < out.width(); i++) {
+            int correct = 0;
+            for (int k = 0; k < 16; k++) {
+                correct += (i + k + j) * (k + 1) + (i + j + k) * (k + 3);
+            }
+            if (out(i, j) != correct) {
+                printf("out(%d, %d) = %d instead of %d\n", i, j, out(i, j), correct);
+                return -1;
+            }
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
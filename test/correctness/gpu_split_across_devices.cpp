@@ -0,0 +1,38 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+
+int main(int argc, char **argv) {
+    Target target = get_jit_target_from_environment();
+    if (!target.has_feature(Target::CUDA)) {
+        printf("Not running CUDA. Skipping test.\n");
+        return 0;
+    }
+
+    Var x, y, xi, yi;
+    Func f, g;
+    f(x, y) = x * 3 + y;
+    g(x, y) = f(x, y) + f(x + 1, y) * 2;
+
+    // Split the producer and the consumer across more devices than
+    // most machines have, with an extent that doesn't divide evenly,
+    // so that some slices share a device and the last one is short.
+    f.compute_root().gpu_tile(x, y, xi, yi, 16, 16).gpu_devices(3);
+    g.gpu_tile(x, y, xi, yi, 16, 16).gpu_devices(4);
+
+    const int W = 250, H = 170;
+    Buffer<int> out = g.realize(W, H, target);
+    for (int y = 0; y < H; y++) {
+        for (int x = 0; x < W; x++) {
+            int correct = (x * 3 + y) + ((x + 1) * 3 + y) * 2;
+            if (out(x, y) != correct) {
+                printf("out(%d, %d) = %d instead of %d\n", x, y, out(x, y), correct);
+                return -1;
+            }
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
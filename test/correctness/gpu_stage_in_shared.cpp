@@ -0,0 +1,53 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+
+int main(int argc, char **argv) {
+    Target target = get_jit_target_from_environment();
+    if (!target.has_gpu_feature()) {
+        printf("Not running test because no gpu target enabled\n");
+        return 0;
+    }
+
+    const int W = 250, H = 130;
+    Buffer<float> in(W, H);
+    in.for_each_element([&](int x, int y) { in(x, y) = (float)((x * 17 + y * 31) % 101); });
+
+    Var x("x"), y("y"), xo("xo"), yo("yo"), xi("xi"), yi("yi");
+    Func clamped = BoundaryConditions::repeat_edge(in);
+    Func blur("blur");
+    blur(x, y) = (clamped(x - 1, y - 1) + clamped(x, y - 1) + clamped(x + 1, y - 1) +
+                  clamped(x - 1, y) + clamped(x, y) + clamped(x + 1, y) +
+                  clamped(x - 1, y + 1) + clamped(x, y + 1) + clamped(x + 1, y + 1));
+
+    blur.gpu_tile(x, y, xo, yo, xi, yi, 16, 8);
+    Func staged = clamped.in_gpu_shared(blur);
+
+    if (staged.function().schedule().memory_type() != MemoryType::GPUShared) {
+        printf("The staged input isn't stored in shared memory\n");
+        return -1;
+    }
+
+    Buffer<float> out = blur.realize(W, H, target);
+    out.copy_to_host();
+
+    for (int y = 0; y < H; y++) {
+        for (int x = 0; x < W; x++) {
+            float correct = 0;
+            for (int dy = -1; dy <= 1; dy++) {
+                for (int dx = -1; dx <= 1; dx++) {
+                    correct += in(std::min(std::max(x + dx, 0), W - 1),
+                                  std::min(std::max(y + dy, 0), H - 1));
+                }
+            }
+            if (out(x, y) != correct) {
+                printf("out(%d, %d) = %f instead of %f\n", x, y, out(x, y), correct);
+                return -1;
+            }
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
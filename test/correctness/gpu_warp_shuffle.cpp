@@ -0,0 +1,55 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+
+// Funcs computed and used within gpu_lanes loops live in the lanes of
+// a warp, and loads of other lanes' elements are warp shuffles. Check
+// a stencil, which loads at a constant distance, and a swap of
+// neighbouring lanes, which doesn't, for a float and a narrow type.
+
+int main(int argc, char **argv) {
+    Target target = get_jit_target_from_environment();
+    if (!target.has_feature(Target::CUDA)) {
+        printf("Not running test because no cuda target enabled\n");
+        return 0;
+    }
+
+    const int W = 256, H = 64;
+    Buffer<float> input(W + 2, H);
+    input.for_each_element([&](int x, int y) {
+        input(x, y) = (x * 17 + y * 3) % 101;
+    });
+
+    Var x, y, xo, yo, xi, yi;
+    Func g("g"), h("h"), f("f");
+    g(x, y) = input(x + 1, y) * 2.0f;
+    h(x, y) = cast<uint8_t>(x + y * 7);
+    Expr neighbour = select(x % 2 == 0, x + 1, x - 1);
+    f(x, y) = (g(x - 1, y) + g(x, y) + g(x + 1, y) +
+               g(neighbour, y) + cast<float>(h(neighbour, y)));
+
+    f.tile(x, y, xo, yo, xi, yi, 32, 4)
+        .gpu_blocks(xo, yo).gpu_threads(yi).gpu_lanes(xi);
+    g.compute_at(f, yi).split(x, xo, xi, 32, TailStrategy::RoundUp)
+        .gpu_lanes(xi).unroll(xo);
+    h.compute_at(f, yi).split(x, xo, xi, 32, TailStrategy::RoundUp)
+        .gpu_lanes(xi).unroll(xo);
+
+    Buffer<float> out = f.realize(W, H, target);
+    for (int y = 0; y < H; y++) {
+        for (int x = 0; x < W; x++) {
+            int n = (x % 2 == 0) ? x + 1 : x - 1;
+            float correct = ((input(x, y) + input(x + 1, y) + input(x + 2, y) +
+                              input(n + 1, y)) * 2.0f +
+                             (uint8_t)(n + y * 7));
+            if (out(x, y) != correct) {
+                printf("out(%d, %d) = %f instead of %f\n", x, y, out(x, y), correct);
+                return -1;
+            }
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
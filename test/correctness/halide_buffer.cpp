@@ -63,6 +63,48 @@ int main(int argc, char **argv) {
         check_equal(a_window, b_window);
     }
 
+    {
+        // Check the paths for dense rows: filling with memset, and
+        // copying between dense buffers, between buffers with dense
+        // rows, and between buffers with no dense dimension.
+        Buffer<int> a(64, 32, 3), b(64, 32, 3), c(80, 40, 3);
+        a.for_each_element([&](int x, int y, int c) {
+            a(x, y, c) = x + 1000 * y + 1000000 * c;
+        });
+        b.fill(0);
+        b.for_each_value([&](int v) {
+            if (v != 0) {
+                printf("fill(0) wrote %d\n", v);
+                abort();
+            }
+        });
+        b.copy_from(a);
+        check_equal(a, b);
+
+        c.fill(-1);
+        Buffer<int> c_window = c.cropped(0, 0, 64).cropped(1, 0, 32);
+        c_window.copy_from(a);
+        check_equal(a, c_window);
+        c.for_each_element([&](int x, int y, int ch) {
+            if ((x >= 64 || y >= 32) && c(x, y, ch) != -1) {
+                printf("copy_from wrote outside the region in common at %d %d %d\n", x, y, ch);
+                abort();
+            }
+        });
+
+        Buffer<int> t(3, 32, 64);
+        t.transpose(0, 2);
+        t.copy_from(a);
+        check_equal(a, t);
+        t.fill(0x01010101);
+        t.for_each_value([&](int v) {
+            if (v != 0x01010101) {
+                printf("fill(0x01010101) wrote %d\n", v);
+                abort();
+            }
+        });
+    }
+
     {
         // Check make a Buffer from a Buffer of a different type
         Buffer<float, 2> a(100, 80);
@@ -73,6 +115,25 @@ int main(int argc, char **argv) {
         Buffer<float, 2> f(e);       // runtime checks
     }
 
+    {
+        // Check converting to and from a halide_buffer_t
+        Buffer<float> a(100, 80, 3);
+        a.transpose(0, 1);
+        a.for_each_element([&](int x, int y, int c) {
+            a(x, y, c) = x + 100.0f * y + 100000.0f * c;
+        });
+        halide_dimension_t shape[3];
+        halide_buffer_t raw = a.make_halide_buffer_t(shape);
+        if (raw.dimensions != 3 || raw.dim != shape || raw.host != (uint8_t *)a.data()) {
+            printf("Bad halide_buffer_t\n");
+            abort();
+        }
+        Buffer<float> b(raw);
+        check_equal(a, b);
+        Buffer<const void> c(raw);
+        check_equal(a, Buffer<const float>(c));
+    }
+
     {
         // Check moving a buffer around
         Buffer<float> a(100, 80, 3);
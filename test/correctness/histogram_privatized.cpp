@@ -0,0 +1,53 @@
+#include "Halide.h"
+#include <stdio.h>
+#include <algorithm>
+
+using namespace Halide;
+
+int main(int argc, char **argv) {
+    // Sizes that don't divide into the tasks or the vectors evenly.
+    const int W = 203, H = 37;
+    Buffer<uint8_t> in(W, H);
+    in.for_each_element([&](int x, int y) { in(x, y) = (uint8_t)((x * 97 + y * 53 + x * y) & 0xff); });
+
+    int reference[256] = {0};
+    in.for_each_element([&](int x, int y) { reference[in(x, y)]++; });
+
+    for (int vector_width : {1, 8}) {
+        // Over a whole image.
+        {
+            RDom r(in);
+            Func hist = histogram(r, in(r.x, r.y), 256, vector_width);
+            Buffer<int> out = hist.realize(256);
+            for (int i = 0; i < 256; i++) {
+                if (out(i) != reference[i]) {
+                    printf("With vector width %d, bin %d is %d instead of %d\n",
+                           vector_width, i, out(i), reference[i]);
+                    return -1;
+                }
+            }
+        }
+
+        // Over one row, with fewer bins than values, so some of them
+        // are clamped into the last bin.
+        {
+            RDom r(0, W);
+            Func hist = histogram(r, in(r, 3) / 4, 50, vector_width);
+            Buffer<int> out = hist.realize(50);
+            int correct[50] = {0};
+            for (int x = 0; x < W; x++) {
+                correct[std::min(in(x, 3) / 4, 49)]++;
+            }
+            for (int i = 0; i < 50; i++) {
+                if (out(i) != correct[i]) {
+                    printf("With vector width %d, bin %d of row 3 is %d instead of %d\n",
+                           vector_width, i, out(i), correct[i]);
+                    return -1;
+                }
+            }
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -45,9 +45,63 @@ bool test_interleave() {
     return true;
 }
 
+// Make planar images from an interleaved one with the given number of
+// channels. Each channel is a strided load.
+template <typename T>
+bool test_deinterleave(int channels) {
+    Var x("x"), y("y"), c("c");
+
+    // Tell the pipeline the input is interleaved, so that each channel
+    // is a load with a constant stride.
+    ImageParam input(type_of<T>(), 3, "input");
+    input.dim(0).set_stride(channels);
+    input.dim(2).set_stride(1).set_bounds(0, channels);
+
+    Func planar("planar");
+    planar(x, y, c) = input(x, y, c);
+
+    Target target = get_jit_target_from_environment();
+    planar.bound(c, 0, channels).reorder(x, c, y).unroll(c);
+    if (target.has_gpu_feature()) {
+        Var xi("xi"), yi("yi");
+        planar.gpu_tile(x, y, xi, yi, 16, 16);
+    } else if (target.features_any_of({Target::HVX_64, Target::HVX_128})) {
+        planar.hexagon().vectorize(x, 128 / sizeof(T));
+    } else {
+        planar.vectorize(x, target.natural_vector_size<uint8_t>());
+    }
+
+    // Size the input exactly, so a load beyond the end of the last
+    // pixel would read outside the buffer.
+    Buffer<T> in = Buffer<T>::make_interleaved(256, 128, channels);
+    in.for_each_element([&](int x, int y, int c) {
+        in(x, y, c) = (T)(x * 3 + y * 5 + c);
+    });
+    input.set(in);
+
+    Buffer<T> buff = planar.realize(256, 128, channels, target);
+    buff.copy_to_host();
+    for (int y = 0; y < buff.height(); y++) {
+        for (int x = 0; x < buff.width(); x++) {
+            for (int c = 0; c < channels; c++) {
+                T correct = (T)(x * 3 + y * 5 + c);
+                if (buff(x, y, c) != correct) {
+                    printf("planar(%d, %d, %d) = %d instead of %d\n", x, y, c, buff(x, y, c), correct);
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
 int main(int argc, char **argv) {
     if (!test_interleave<uint8_t>()) return -1;
     if (!test_interleave<uint16_t>()) return -1;
+    for (int channels = 3; channels <= 4; channels++) {
+        if (!test_deinterleave<uint8_t>(channels)) return -1;
+        if (!test_deinterleave<uint16_t>(channels)) return -1;
+    }
 
     printf("Success!\n");
     return 0;
@@ -0,0 +1,71 @@
+#include "Halide.h"
+#include <limits>
+#include <stdio.h>
+
+using namespace Halide;
+
+// Halide's division rounds according to the sign of the divisor, so
+// that the remainder is always non-negative.
+int64_t div_ref(int64_t a, int64_t b) {
+    int64_t q = a / b;
+    if (a % b < 0) {
+        q += (b < 0) ? 1 : -1;
+    }
+    return q;
+}
+
+template<typename T>
+int test(bool vectorize) {
+    Param<T> p;
+    Var x, y;
+    Func f, g;
+
+    // The numerators cover the whole range of T.
+    Expr num = cast<T>(x * 65521 + y * 2147483);
+    f(x, y) = num / p;
+    g(x, y) = num % p;
+    if (vectorize) {
+        f.vectorize(x, 8);
+        g.vectorize(x, 8);
+    }
+
+    const T divisors[] = {1, 2, 3, 7, 10, 100, 127,
+                          std::numeric_limits<T>::max(),
+                          std::numeric_limits<T>::min(),
+                          (T)(-1), (T)(-3), (T)(-128)};
+    for (T d : divisors) {
+        if (d == 0) continue;
+        p.set(d);
+        Buffer<T> fast_div = f.realize(64, 64);
+        Buffer<T> fast_mod = g.realize(64, 64);
+        for (int j = 0; j < 64; j++) {
+            for (int i = 0; i < 64; i++) {
+                T n = (T)(i * 65521 + j * 2147483);
+                T q = (T)div_ref(n, d);
+                T r = (T)(n - q * d);
+                if (fast_div(i, j) != q || fast_mod(i, j) != r) {
+                    printf("%d / %d = %d, %d %% %d = %d, instead of %d and %d\n",
+                           (int)n, (int)d, (int)fast_div(i, j),
+                           (int)n, (int)d, (int)fast_mod(i, j), (int)q, (int)r);
+                    return -1;
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    for (bool vectorize : {false, true}) {
+        if (test<int32_t>(vectorize) != 0 ||
+            test<uint32_t>(vectorize) != 0 ||
+            test<int16_t>(vectorize) != 0 ||
+            test<uint16_t>(vectorize) != 0 ||
+            test<uint8_t>(vectorize) != 0) {
+            return -1;
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,60 @@
+#include "Halide.h"
+#include <stdio.h>
+#include <thread>
+#include <vector>
+
+using namespace Halide;
+
+// Compile and run a small pipeline, returning 0 if its output is correct.
+int run(int k) {
+    Func f, g;
+    Var x, y;
+    f(x, y) = x + y * k;
+    g(x, y) = f(x - 1, y) + f(x + 1, y);
+    f.compute_at(g, y).vectorize(x, 4);
+    g.parallel(y);
+
+    Buffer<int> out = g.realize(32, 32);
+    for (int j = 0; j < out.height(); j++) {
+        for (int i = 0; i < out.width(); i++) {
+            int correct = 2 * (i + j * k);
+            if (out(i, j) != correct) {
+                printf("out(%d, %d) = %d instead of %d\n", i, j, out(i, j), correct);
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    Internal::set_ir_arena_enabled(true);
+
+    // The IR made while lowering must stay valid after lower() returns,
+    // and after the Funcs that made it are gone.
+    for (int k = 0; k < 4; k++) {
+        if (run(k) != 0) {
+            return -1;
+        }
+    }
+
+    // Each thread lowering a pipeline has its own arena.
+    std::vector<std::thread> threads;
+    std::vector<int> results(4, 0);
+    for (int k = 0; k < 4; k++) {
+        threads.emplace_back([&, k]() { results[k] = run(k + 4); });
+    }
+    for (std::thread &t : threads) {
+        t.join();
+    }
+    for (int r : results) {
+        if (r != 0) {
+            return -1;
+        }
+    }
+
+    Internal::set_ir_arena_enabled(false);
+
+    printf("Success!\n");
+    return 0;
+}
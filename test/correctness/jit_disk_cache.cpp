@@ -0,0 +1,91 @@
+#include "Halide.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <dirent.h>
+#endif
+
+using namespace Halide;
+
+// With HL_JIT_CACHE_DIR set, JIT compilation should leave object
+// code in that directory, and pipelines should still work.
+
+#ifndef _WIN32
+std::vector<std::string> list_dir(const std::string &dir) {
+    std::vector<std::string> files;
+    DIR *d = opendir(dir.c_str());
+    if (!d) {
+        return files;
+    }
+    while (struct dirent *e = readdir(d)) {
+        std::string name = e->d_name;
+        if (name != "." && name != "..") {
+            files.push_back(dir + "/" + name);
+        }
+    }
+    closedir(d);
+    return files;
+}
+#endif
+
+int main(int argc, char **argv) {
+#ifdef _WIN32
+    printf("Skipping test because it uses setenv\n");
+    return 0;
+#else
+    std::string dir = Internal::dir_make_temp();
+    setenv("HL_JIT_CACHE_DIR", dir.c_str(), 1);
+
+    Var x, y;
+    Func f("f");
+    f(x, y) = x * 3 + y;
+    f.vectorize(x, 8);
+    Buffer<int> out = f.realize(64, 64);
+
+    std::vector<std::string> files = list_dir(dir);
+    int result = 0;
+    if (files.empty()) {
+        printf("No object code was cached in %s\n", dir.c_str());
+        result = -1;
+    }
+    for (const std::string &file : files) {
+        if (file.size() < 2 || file.substr(file.size() - 2) != ".o") {
+            printf("Unexpected file in the JIT cache: %s\n", file.c_str());
+            result = -1;
+        }
+    }
+
+    // A second pipeline may or may not be found in the cache,
+    // depending on whether it lowers to exactly the same code, but
+    // either way it must compute the right thing.
+    Func g("f");
+    g(x, y) = x * 3 + y;
+    g.vectorize(x, 8);
+    Buffer<int> out2 = g.realize(64, 64);
+
+    for (int y = 0; y < 64; y++) {
+        for (int x = 0; x < 64; x++) {
+            if (out(x, y) != x * 3 + y || out2(x, y) != x * 3 + y) {
+                printf("out(%d, %d) = %d, out2(%d, %d) = %d instead of %d\n",
+                       x, y, out(x, y), x, y, out2(x, y), x * 3 + y);
+                result = -1;
+                break;
+            }
+        }
+    }
+
+    unsetenv("HL_JIT_CACHE_DIR");
+    for (const std::string &file : list_dir(dir)) {
+        Internal::file_unlink(file);
+    }
+    Internal::dir_rmdir(dir);
+
+    if (result == 0) {
+        printf("Success!\n");
+    }
+    return result;
+#endif
+}
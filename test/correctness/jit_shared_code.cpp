@@ -0,0 +1,73 @@
+#include "Halide.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+using namespace Halide;
+
+// The code of JIT-compiled pipelines is packed into shared regions.
+// Compile many pipelines, some at once on several threads, free some
+// of them and compile more, and check they all still work and sit
+// close together.
+
+std::unique_ptr<Pipeline> make_pipeline(int i) {
+    Func f("f_" + std::to_string(i));
+    Var x;
+    f(x) = x * i + 1;
+    return std::unique_ptr<Pipeline>(new Pipeline(f));
+}
+
+bool check(Pipeline &p, int i) {
+    Buffer<int> out = p.realize(16);
+    for (int x = 0; x < 16; x++) {
+        if (out(x) != x * i + 1) {
+            printf("Pipeline %d computed %d at %d instead of %d\n", i, out(x), x, x * i + 1);
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    const int N = 32;
+    std::vector<std::unique_ptr<Pipeline>> pipelines;
+    std::vector<Pipeline> to_compile;
+    for (int i = 0; i < N; i++) {
+        pipelines.push_back(make_pipeline(i));
+        to_compile.push_back(*pipelines.back());
+    }
+    Pipeline::compile_jit_in_parallel(to_compile);
+    to_compile.clear();
+
+    uintptr_t lo = UINTPTR_MAX, hi = 0;
+    for (int i = 0; i < N; i++) {
+        uintptr_t entry = (uintptr_t)pipelines[i]->compile_jit();
+        lo = std::min(lo, entry);
+        hi = std::max(hi, entry);
+        if (!check(*pipelines[i], i)) {
+            return -1;
+        }
+    }
+    if (hi - lo > (32 << 20)) {
+        printf("The code of %d small pipelines is spread over %d MB\n", N, (int)((hi - lo) >> 20));
+        return -1;
+    }
+
+    // Free every other one, and make new ones in their place.
+    for (int i = 0; i < N; i += 2) {
+        pipelines[i].reset();
+    }
+    for (int i = 0; i < N; i += 2) {
+        pipelines[i] = make_pipeline(i + N);
+    }
+    for (int i = 0; i < N; i++) {
+        if (!check(*pipelines[i], i % 2 ? i : i + N)) {
+            return -1;
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,102 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+using namespace Halide::Internal;
+
+// A pipeline told to specialize on the values of some Params gets
+// compiled again for values it's run with repeatedly, with the values
+// folded in. Check when that happens, and that every version computes
+// the right thing.
+
+class CheckLowering : public IRMutator {
+    using IRMutator::visit;
+
+    void visit(const Variable *op) {
+        if (op->name == "radius") {
+            uses_radius = true;
+        }
+        IRMutator::visit(op);
+    }
+
+public:
+    int lowerings = 0;
+    bool uses_radius = false;
+
+    using IRMutator::mutate;
+    Stmt mutate(Stmt s) {
+        if (!count_next) {
+            return IRMutator::mutate(s);
+        }
+        count_next = false;
+        lowerings++;
+        uses_radius = false;
+        Stmt result = IRMutator::mutate(s);
+        count_next = true;
+        return result;
+    }
+
+private:
+    bool count_next = true;
+};
+
+int main(int argc, char **argv) {
+    const int W = 100;
+    Buffer<int> in(W + 16);
+    in.for_each_element([&](int x) { in(x) = (x * 17) % 23; });
+
+    Param<int> radius("radius"), offset("offset");
+    RDom r(-radius, 2 * radius + 1);
+    Var x("x");
+    Func blur("blur");
+    blur(x) = sum(in(x + r + 8)) + offset;
+    blur.vectorize(x, 4);
+
+    Pipeline p(blur);
+    CheckLowering *checker = new CheckLowering;
+    p.add_custom_lowering_pass(checker);
+    p.specialize_jit_on_values({radius}, 3, 2);
+
+    struct Run {
+        int radius, lowerings;
+        bool uses_radius;
+    };
+    // The general version is compiled first. The third run with a
+    // radius compiles a version for it, until there are two of them.
+    // The offset changes every run, but isn't specialized on.
+    const Run runs[] = {
+        {2, 1, true}, {2, 1, true}, {2, 2, false}, {2, 2, false},
+        {1, 2, false}, {1, 2, false}, {2, 2, false}, {1, 3, false},
+        {1, 3, false}, {3, 3, false}, {3, 3, false}, {3, 3, false},
+        {3, 3, false}, {2, 3, false},
+    };
+    int i = 0;
+    for (const Run &run : runs) {
+        radius.set(run.radius);
+        offset.set(i);
+        Buffer<int> out = p.realize(W);
+        for (int x = 0; x < W; x++) {
+            int correct = i;
+            for (int dx = -run.radius; dx <= run.radius; dx++) {
+                correct += in(x + dx + 8);
+            }
+            if (out(x) != correct) {
+                printf("Run %d: out(%d) = %d instead of %d\n", i, x, out(x), correct);
+                return -1;
+            }
+        }
+        if (checker->lowerings != run.lowerings) {
+            printf("Run %d: lowered %d times instead of %d\n", i, checker->lowerings, run.lowerings);
+            return -1;
+        }
+        if (checker->uses_radius != run.uses_radius) {
+            printf("Run %d: the last version compiled %s the radius\n", i,
+                   checker->uses_radius ? "uses" : "doesn't use");
+            return -1;
+        }
+        i++;
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,78 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+
+int main(int argc, char **argv) {
+    Var x("x"), y("y");
+
+    Buffer<float> in(67, 43);
+    for (int y = 0; y < in.height(); y++) {
+        for (int x = 0; x < in.width(); x++) {
+            in(x, y) = (float)((x * 17 + y * 31) % 23);
+        }
+    }
+
+    // The same pipeline compiled with each of the features that
+    // change how LLVM optimizes it should compute the same thing.
+    const std::vector<std::vector<Target::Feature>> feature_sets = {
+        {},
+        {Target::LLVMOpt1},
+        {Target::LLVMOpt2},
+        {Target::NoLLVMLoopVectorize, Target::NoLLVMSLPVectorize},
+        {Target::NoLLVMUnroll},
+        {Target::LLVMOpt1, Target::NoLLVMLoopVectorize, Target::NoLLVMSLPVectorize, Target::NoLLVMUnroll},
+    };
+
+    Buffer<float> correct;
+    for (const auto &features : feature_sets) {
+        Target t = get_jit_target_from_environment();
+        for (Target::Feature f : features) {
+            t.set_feature(f);
+        }
+
+        // The target string round-trips.
+        if (Target(t.to_string()) != t) {
+            printf("Target %s didn't round-trip\n", t.to_string().c_str());
+            return -1;
+        }
+
+        Func blur_x("blur_x"), blur_y("blur_y");
+        Func clamped = BoundaryConditions::repeat_edge(in);
+        blur_x(x, y) = (clamped(x - 1, y) + clamped(x, y) + clamped(x + 1, y)) / 3;
+        blur_y(x, y) = (blur_x(x, y - 1) + blur_x(x, y) + blur_x(x, y + 1)) / 3;
+
+        // The serial reduction is left for LLVM to vectorize and
+        // unroll, if it may.
+        RDom r(0, in.width());
+        Func row_sum("row_sum");
+        row_sum(y) = 0.0f;
+        row_sum(y) += blur_y(r, y);
+
+        Func out("out");
+        out(x, y) = blur_y(x, y) + row_sum(y);
+
+        blur_x.compute_at(out, y).vectorize(x, 8);
+        blur_y.compute_root().vectorize(x, 8);
+        row_sum.compute_root();
+
+        Buffer<float> result = out.realize(in.width(), in.height(), t);
+        if (!correct.defined()) {
+            correct = result;
+            continue;
+        }
+        for (int y = 0; y < result.height(); y++) {
+            for (int x = 0; x < result.width(); x++) {
+                float delta = result(x, y) - correct(x, y);
+                if (delta < -1e-3f || delta > 1e-3f) {
+                    printf("With %s, out(%d, %d) = %f instead of %f\n",
+                           t.to_string().c_str(), x, y, result(x, y), correct(x, y));
+                    return -1;
+                }
+            }
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
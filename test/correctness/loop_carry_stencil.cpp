@@ -0,0 +1,62 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+
+// Box filters up to 7x7, vectorized and unrolled, so that each row of taps
+// can be carried across iterations of the loop over x.
+int test(int radius, bool unroll) {
+    Target t = get_jit_target_from_environment();
+    const int vec = t.natural_vector_size<uint16_t>();
+
+    Func f, g;
+    Var x, y, xi;
+
+    f(x, y) = cast<uint16_t>(x * 3 + y * 5);
+
+    Expr sum = cast<uint16_t>(0);
+    for (int dy = -radius; dy <= radius; dy++) {
+        for (int dx = -radius; dx <= radius; dx++) {
+            sum += f(x + dx, y + dy);
+        }
+    }
+    g(x, y) = sum;
+
+    f.compute_root().align_storage(x, vec);
+    if (unroll) {
+        g.split(x, x, xi, vec * 2).vectorize(xi, vec).unroll(xi);
+    } else {
+        g.vectorize(x, vec);
+    }
+
+    const int W = vec * 16, H = 16;
+    Buffer<uint16_t> out = g.realize(W, H);
+    for (int j = 0; j < H; j++) {
+        for (int i = 0; i < W; i++) {
+            uint16_t correct = 0;
+            for (int dy = -radius; dy <= radius; dy++) {
+                for (int dx = -radius; dx <= radius; dx++) {
+                    correct += (uint16_t)((i + dx) * 3 + (j + dy) * 5);
+                }
+            }
+            if (out(i, j) != correct) {
+                printf("radius %d, unroll %d: out(%d, %d) = %d instead of %d\n",
+                       radius, unroll, i, j, out(i, j), correct);
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    for (int radius = 1; radius <= 3; radius++) {
+        if (test(radius, false) != 0 ||
+            test(radius, true) != 0) {
+            return -1;
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
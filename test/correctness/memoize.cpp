@@ -189,6 +189,33 @@ int main(int argc, char **argv) {
         assert(call_count_with_arg == 2);
     }
 
+    {
+        // A per-Func budget big enough for only one result.
+        Param<uint8_t> val;
+
+        Func count_calls;
+        count_calls.define_extern("count_calls_with_arg", {val}, UInt(8), 2);
+
+        Func f;
+        Var x, y;
+        f(x, y) = count_calls(x, y);
+        count_calls.compute_root().memoize(1, 256 * 256 * 3 / 2);
+
+        call_count_with_arg = 0;
+        const uint8_t vals[] = {1, 2, 2, 1};
+        for (uint8_t v : vals) {
+            val.set(v);
+            Buffer<uint8_t> out = f.realize(256, 256);
+            for (int32_t i = 0; i < 256; i++) {
+                for (int32_t j = 0; j < 256; j++) {
+                    assert(out(i, j) == v);
+                }
+            }
+        }
+        // The result for 2 evicts the one for 1.
+        assert(call_count_with_arg == 3);
+    }
+
     {
         Param<uint8_t> val1;
         Param<uint8_t> val2;
@@ -550,6 +577,42 @@ int main(int argc, char **argv) {
 
     }
 
+    {
+        // A region contained in one already computed is a hit, even
+        // though the buffer asked for has a different shape.
+        Param<float> val;
+
+        call_count_with_arg = 0;
+        Func count_calls;
+        count_calls.define_extern("count_calls_with_arg", {cast<uint8_t>(val)}, UInt(8), 2);
+
+        Func f, g;
+        Var x, y;
+        f(x, y) = count_calls(x, y) + cast<uint8_t>(x + y);
+        f.compute_root().memoize();
+        g(x, y) = f(x, y);
+
+        val.set(3.0f);
+        Buffer<uint8_t> whole = g.realize(64, 64);
+        assert(call_count_with_arg == 1);
+
+        Buffer<uint8_t> part(20, 10);
+        part.set_min(30, 40);
+        g.realize(part);
+        assert(call_count_with_arg == 1);
+        for (int32_t j = 40; j < 50; j++) {
+            for (int32_t i = 30; i < 50; i++) {
+                assert(part(i, j) == (uint8_t)(3 + i + j));
+            }
+        }
+
+        // One that isn't contained is computed.
+        Buffer<uint8_t> outside(20, 10);
+        outside.set_min(50, 0);
+        g.realize(outside);
+        assert(call_count_with_arg == 2);
+    }
+
     {
         // Test out of memory handling.
         Param<float> val;
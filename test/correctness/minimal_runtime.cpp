@@ -0,0 +1,51 @@
+#include "Halide.h"
+#include <stdio.h>
+#include <fstream>
+
+using namespace Halide;
+
+long file_size(const std::string &filename) {
+    std::ifstream f(filename, std::ios::binary | std::ios::ate);
+    return (long)f.tellg();
+}
+
+int main(int argc, char **argv) {
+    Target target = get_host_target();
+    std::string ext = (target.os == Target::Windows && !target.has_feature(Target::MinGW)) ? ".lib" : ".a";
+
+    Func f("f");
+    Var x("x");
+    f(x) = x * 2;
+
+    // The same pipeline with the whole runtime, with only the parts
+    // of it the pipeline uses, and with none of it.
+    struct {
+        std::string name;
+        Target target;
+    } libs[] = {
+        {"minimal_runtime_full", target},
+        {"minimal_runtime_minimal", target.with_feature(Target::MinimalRuntime)},
+        {"minimal_runtime_none", target.with_feature(Target::NoRuntime)},
+    };
+    long sizes[3];
+    for (int i = 0; i < 3; i++) {
+        std::string lib = libs[i].name + ext;
+        Internal::ensure_no_file_exists(lib);
+        f.compile_to_static_library(libs[i].name, {}, "f", libs[i].target);
+        Internal::assert_file_exists(lib);
+        sizes[i] = file_size(lib);
+    }
+    if (!(sizes[0] > sizes[1] && sizes[1] > sizes[2])) {
+        printf("Sizes with the full, minimal and no runtime: %ld %ld %ld\n", sizes[0], sizes[1], sizes[2]);
+        return -1;
+    }
+
+    // The runtime the last one needs, in a library of its own.
+    std::string runtime = "minimal_runtime_runtime" + ext;
+    Internal::ensure_no_file_exists(runtime);
+    Pipeline::compile_runtime_to_static_library("minimal_runtime_runtime", target);
+    Internal::assert_file_exists(runtime);
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,77 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+using namespace Halide::Internal;
+
+// A loop compiled for several instruction sets should compute the
+// same thing whichever one the machine ends up picking.
+
+// Count the copies of the loop made for other instruction sets.
+class CountVariants : public IRMutator {
+public:
+    int count = 0;
+    using IRMutator::mutate;
+
+    Stmt mutate(Stmt s) {
+        class FindLoops : public IRVisitor {
+            using IRVisitor::visit;
+            void visit(const For *op) {
+                if (op->name.find(".__isa_") != std::string::npos) {
+                    count++;
+                }
+                IRVisitor::visit(op);
+            }
+        public:
+            int count = 0;
+        } finder;
+        s.accept(&finder);
+        count = finder.count;
+        return s;
+    }
+};
+
+int main(int argc, char **argv) {
+    Target target = get_jit_target_from_environment();
+
+    Func f("f");
+    Var x("x"), y("y");
+    ImageParam in(UInt(8), 2);
+
+    f(x, y) = (cast<int>(in(x, y)) * 3 + cast<int>(in(x + 1, y)) * 5) / 7 +
+        cast<int>(sqrt(cast<float>(in(x, y))));
+    f.vectorize(x, 16).multiversion(y, {Target::AVX512_Skylake, Target::AVX2, Target::SSE41});
+
+    CountVariants *counter = new CountVariants;
+    f.add_custom_lowering_pass(counter);
+
+    const int W = 67, H = 20;
+    Buffer<uint8_t> input(W + 1, H);
+    for (int y = 0; y < H; y++) {
+        for (int x = 0; x < W + 1; x++) {
+            input(x, y) = (uint8_t)(x * 17 + y * 31);
+        }
+    }
+    in.set(input);
+
+    Buffer<int> out = f.realize(W, H);
+
+    for (int y = 0; y < H; y++) {
+        for (int x = 0; x < W; x++) {
+            int correct = (input(x, y) * 3 + input(x + 1, y) * 5) / 7 +
+                (int)std::sqrt((float)input(x, y));
+            if (out(x, y) != correct) {
+                printf("out(%d, %d) = %d instead of %d\n", x, y, out(x, y), correct);
+                return -1;
+            }
+        }
+    }
+
+    if (target.arch == Target::X86 && counter->count == 0) {
+        printf("The loop over y wasn't multiversioned\n");
+        return -1;
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,38 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+
+int main(int argc, char **argv) {
+    Target target = get_jit_target_from_environment();
+    if (!target.has_feature(Target::OpenGLCompute)) {
+        printf("Not running test because OpenGLCompute is not enabled in the target\n");
+        return 0;
+    }
+
+    Func f("f"), g("g");
+    Var x("x"), y("y"), xi("xi"), yi("yi");
+
+    f(x, y) = x + y * 2;
+    g(x, y) = f(x - 1, y) + f(x, y) + f(x + 1, y + 1);
+
+    // f is computed per workgroup into shared memory, and g reads it
+    // back after a barrier. The shared array is sized by the bounds
+    // of f within one tile, which are constant.
+    g.gpu_tile(x, y, xi, yi, 16, 8, TailStrategy::Auto, DeviceAPI::OpenGLCompute);
+    f.compute_at(g, x).gpu_threads(x, y);
+
+    Buffer<int> out = g.realize(64, 32, target);
+    for (int y = 0; y < out.height(); y++) {
+        for (int x = 0; x < out.width(); x++) {
+            int correct = (x - 1 + y * 2) + (x + y * 2) + (x + 1 + (y + 1) * 2);
+            if (out(x, y) != correct) {
+                printf("out(%d, %d) = %d instead of %d\n", x, y, out(x, y), correct);
+                return -1;
+            }
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
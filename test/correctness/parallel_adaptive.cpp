@@ -0,0 +1,58 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+
+int tasks = 0;
+int my_do_task(void *user_context, int (*f)(void *, int, uint8_t *), int idx, uint8_t *closure) {
+    __sync_fetch_and_add(&tasks, 1);
+    return f(user_context, idx, closure);
+}
+
+int main(int argc, char **argv) {
+    Func f, g, h;
+    Var x, y;
+
+    // A stage computed inside the adaptive loop, so that each chunk
+    // runs several iterations of a loop nest.
+    f(x, y) = x + y * 3;
+    g(x, y) = f(x, y) + f(x + 1, y);
+    f.compute_at(g, y);
+    g.parallel_adaptive(y);
+
+    // An update stage, chunked separately.
+    h(x, y) = g(x, y);
+    h(x, y) += x * y;
+    g.compute_root();
+    h.update().parallel_adaptive(y);
+    h.set_custom_do_task(my_do_task);
+
+    // Try extents from a single iteration up to many more than there
+    // are threads, several times each so that the runtime has
+    // measurements of the loop to use.
+    for (int H : {1, 7, 100, 1000}) {
+        for (int i = 0; i < 3; i++) {
+            tasks = 0;
+            Buffer<int> out = h.realize(16, H);
+            for (int yy = 0; yy < H; yy++) {
+                for (int xx = 0; xx < 16; xx++) {
+                    int correct = (xx + yy * 3) + (xx + 1 + yy * 3) + xx * yy;
+                    if (out(xx, yy) != correct) {
+                        printf("out(%d, %d) = %d instead of %d\n", xx, yy, out(xx, yy), correct);
+                        return -1;
+                    }
+                }
+            }
+
+            // Each loop is run by at most one task per thread, not one
+            // task per iteration.
+            if (H == 1000 && tasks >= H) {
+                printf("Ran %d tasks for %d iterations\n", tasks, H);
+                return -1;
+            }
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
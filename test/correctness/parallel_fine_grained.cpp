@@ -0,0 +1,71 @@
+#include <stdio.h>
+#include <atomic>
+#include "Halide.h"
+
+using namespace Halide;
+
+// Count the tasks dispatched by the thread pool, to check that every
+// index of every parallel loop is claimed exactly once, even when
+// worker threads steal work from each other.
+std::atomic<int> task_count(0);
+
+int my_do_task(void *user_context, int (*f)(void *, int, uint8_t *),
+               int idx, uint8_t *closure) {
+    task_count++;
+    return f(user_context, idx, closure);
+}
+
+int main(int argc, char **argv) {
+    Var x, y;
+
+    {
+        // Lots of tiny tasks.
+        Func f;
+        f(x, y) = x * y + 1;
+        f.parallel(y);
+
+        const int W = 8, H = 10000;
+        Buffer<int> im = f.realize(W, H);
+        for (int y = 0; y < H; y++) {
+            for (int x = 0; x < W; x++) {
+                if (im(x, y) != x * y + 1) {
+                    printf("im(%d, %d) = %d instead of %d\n", x, y, im(x, y), x * y + 1);
+                    return -1;
+                }
+            }
+        }
+    }
+
+    {
+        // Nested parallel loops with uneven amounts of work per task.
+        Func f, g;
+        f(x, y) = select(x % 7 == 0, sqrt(cast<float>(x * y)), 0.0f);
+        g(x, y) = f(x, y) + 1;
+        f.compute_at(g, y).parallel(x, 4);
+        g.parallel(y);
+        g.set_custom_do_task(my_do_task);
+
+        const int W = 256, H = 97;
+        task_count = 0;
+        Buffer<float> im = g.realize(W, H);
+        for (int y = 0; y < H; y++) {
+            for (int x = 0; x < W; x++) {
+                float correct = (x % 7 == 0 ? sqrtf((float)(x * y)) : 0.0f) + 1;
+                if (im(x, y) != correct) {
+                    printf("im(%d, %d) = %f instead of %f\n", x, y, im(x, y), correct);
+                    return -1;
+                }
+            }
+        }
+
+        // One task per row of g, plus W/4 tasks per row for f.
+        int expected_tasks = H + H * (W / 4);
+        if (task_count != expected_tasks) {
+            printf("Ran %d tasks instead of %d\n", (int)task_count, expected_tasks);
+            return -1;
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,50 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+
+int main(int argc, char **argv) {
+    Var x;
+    RDom r(0, 16);
+
+    // Each iteration stores to a different even site, and reads a
+    // different odd one.
+    Func f("f");
+    f(x) = x;
+    f(r * 2) = f(r * 2 + 1) * 3;
+    f.update().parallel(r);
+
+    // Permute the sites with a Func promised to be injective. It has
+    // to be promised before the update that uses it is defined.
+    Func idx("idx");
+    idx(x) = (x * 7) % 16;
+    idx.assume_injective();
+
+    Func g("g");
+    g(x) = x;
+    g(idx(r)) = g(idx(r)) * 2 + r;
+    g.update().parallel(r);
+
+    Buffer<int> f_result = f.realize(32);
+    Buffer<int> g_result = g.realize(16);
+
+    for (int i = 0; i < 32; i++) {
+        int correct = (i % 2 == 0) ? (i + 1) * 3 : i;
+        if (f_result(i) != correct) {
+            printf("f(%d) = %d instead of %d\n", i, f_result(i), correct);
+            return -1;
+        }
+    }
+
+    for (int i = 0; i < 16; i++) {
+        int j = (i * 7) % 16;
+        int correct = j * 2 + i;
+        if (g_result(j) != correct) {
+            printf("g(%d) = %d instead of %d\n", j, g_result(j), correct);
+            return -1;
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,85 @@
+#include "Halide.h"
+#include <stdio.h>
+#include <algorithm>
+
+using namespace Halide;
+
+int main(int argc, char **argv) {
+    const int W = 1000, H = 37;
+    Buffer<int> in(W, H);
+    in.for_each_element([&](int x, int y) { in(x, y) = ((x * 17 + y * 31) % 23) - 11; });
+
+    Var x, y;
+
+    // A cumulative sum along x, with blocks that don't divide the
+    // width.
+    {
+        Func f;
+        RDom r(1, W - 1);
+        f(x, y) = in(x, y);
+        f(r, y) += f(r - 1, y);
+        f.parallel_scan(r, 64, 8);
+
+        Buffer<int> out = f.realize(W, H);
+        for (int j = 0; j < H; j++) {
+            int correct = 0;
+            for (int i = 0; i < W; i++) {
+                correct += in(i, j);
+                if (out(i, j) != correct) {
+                    printf("sum(%d, %d) = %d instead of %d\n", i, j, out(i, j), correct);
+                    return -1;
+                }
+            }
+        }
+    }
+
+    // A running max along the other dimension.
+    {
+        Func f;
+        RDom r(1, H - 1);
+        f(x, y) = in(x, y) * 2;
+        f(x, r) = max(f(x, r - 1), f(x, r));
+        f.parallel_scan(r, 5, 4);
+
+        Buffer<int> out = f.realize(W, H);
+        for (int i = 0; i < W; i++) {
+            int correct = in(i, 0) * 2;
+            for (int j = 0; j < H; j++) {
+                correct = std::max(correct, in(i, j) * 2);
+                if (out(i, j) != correct) {
+                    printf("max(%d, %d) = %d instead of %d\n", i, j, out(i, j), correct);
+                    return -1;
+                }
+            }
+        }
+    }
+
+    // An integral image, from a scan in each dimension.
+    {
+        Func sum_x, sum_xy;
+        RDom rx(1, W - 1), ry(1, H - 1);
+        sum_x(x, y) = in(x, y);
+        sum_x(rx, y) = sum_x(rx - 1, y) + in(rx, y);
+        sum_x.compute_root().parallel_scan(rx, 100);
+        sum_xy(x, y) = sum_x(x, y);
+        sum_xy(x, ry) = sum_xy(x, ry - 1) + sum_xy(x, ry);
+        sum_xy.parallel_scan(ry, 8, 8);
+
+        Buffer<int> out = sum_xy.realize(W, H);
+        Buffer<int> correct(W, H);
+        for (int j = 0; j < H; j++) {
+            int row = 0;
+            for (int i = 0; i < W; i++) {
+                row += in(i, j);
+                correct(i, j) = row + (j > 0 ? correct(i, j - 1) : 0);
+                if (out(i, j) != correct(i, j)) {
+                    printf("integral(%d, %d) = %d instead of %d\n", i, j, out(i, j), correct(i, j));
+                    return -1;
+                }
+            }
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
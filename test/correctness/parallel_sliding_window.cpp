@@ -0,0 +1,84 @@
+#include "Halide.h"
+#include <stdio.h>
+#include <atomic>
+
+using namespace Halide;
+
+#ifdef _WIN32
+#define DLLEXPORT __declspec(dllexport)
+#else
+#define DLLEXPORT
+#endif
+
+// A Func stored outside a parallel loop should still slide within
+// each task, with storage of its own.
+
+std::atomic<int> count;
+extern "C" DLLEXPORT int call_counter(int x, int y) {
+    count++;
+    return 0;
+}
+HalideExtern_2(int, call_counter, int, int);
+
+int check(const Buffer<int> &out) {
+    for (int y = 0; y < out.height(); y++) {
+        for (int x = 0; x < out.width(); x++) {
+            int correct = 3 * (x + y);
+            if (out(x, y) != correct) {
+                printf("out(%d, %d) = %d instead of %d\n", x, y, out(x, y), correct);
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    const int W = 10, H = 160;
+    Var x("x"), y("y");
+
+    {
+        // The loop g is computed in is itself parallel, so it gets
+        // split into strips that each slide.
+        Func g("g"), f("f");
+        g(x, y) = call_counter(x, y) + x + y;
+        f(x, y) = g(x, y - 1) + g(x, y) + g(x, y + 1);
+        g.store_root().compute_at(f, y);
+        f.parallel(y);
+
+        count = 0;
+        Buffer<int> out = f.realize(W, H);
+        if (check(out)) return -1;
+
+        // Each of the 16 strips warms up with two extra rows.
+        int expected = (H + 2 * 16) * W;
+        if (count != expected) {
+            printf("g was called %d times instead of %d times\n", (int)count, expected);
+            return -1;
+        }
+    }
+
+    {
+        // There's already a serial loop within each task to slide
+        // along.
+        Func g("g"), f("f");
+        Var yo("yo"), yi("yi");
+        g(x, y) = call_counter(x, y) + x + y;
+        f(x, y) = g(x, y - 1) + g(x, y) + g(x, y + 1);
+        f.split(y, yo, yi, 8).parallel(yo);
+        g.store_root().compute_at(f, yi);
+
+        count = 0;
+        Buffer<int> out = f.realize(W, H);
+        if (check(out)) return -1;
+
+        int expected = (H + 2 * (H / 8)) * W;
+        if (count != expected) {
+            printf("g was called %d times instead of %d times\n", (int)count, expected);
+            return -1;
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
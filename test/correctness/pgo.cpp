@@ -0,0 +1,88 @@
+#include "Halide.h"
+#include <stdio.h>
+#include <fstream>
+#include <sstream>
+
+using namespace Halide;
+
+// Compile a pipeline with its branches counted, then again guided by
+// a profile of it, and check that the branch weights show up in the
+// LLVM IR.
+
+std::string read_file(const std::string &filename) {
+    std::ifstream f(filename);
+    std::stringstream s;
+    s << f.rdbuf();
+    return s.str();
+}
+
+int main(int argc, char **argv) {
+    Func f("f");
+    Var x("x"), y("y");
+    Param<int> p("p");
+    f(x, y) = x + y * p;
+    // The specialization is a branch on p.
+    f.specialize(p == 3);
+
+    Target t = get_host_target();
+    std::vector<Argument> args = {p};
+
+    const char *instrumented_ll = "pgo_instrumented.ll";
+    Internal::ensure_no_file_exists(instrumented_ll);
+    f.compile_to(Outputs().llvm_assembly(instrumented_ll), args, "pgo_test",
+                 t.with_feature(Target::PGOInstrument));
+    Internal::assert_file_exists(instrumented_ll);
+
+    std::string ir = read_file(instrumented_ll);
+    if (ir.find("halide_pgo_register") == std::string::npos) {
+        printf("The instrumented pipeline doesn't register its counters\n");
+        return -1;
+    }
+
+    // Find the number of counters.
+    const std::string counters = "@pgo_test.pgo_counters = private global [";
+    size_t pos = ir.find(counters);
+    if (pos == std::string::npos) {
+        printf("The instrumented pipeline has no counters\n");
+        return -1;
+    }
+    int num_counters = atoi(ir.c_str() + pos + counters.size());
+    if (num_counters < 2 || num_counters % 2) {
+        printf("Unexpected number of counters: %d\n", num_counters);
+        return -1;
+    }
+
+    // Write a profile in which every site was reached 1000 times,
+    // but only taken once, as two runs that add up.
+    const char *profile = "pgo_test.pgo";
+    {
+        std::ofstream out(profile);
+        for (int run = 0; run < 2; run++) {
+            out << "pgo_test " << num_counters;
+            for (int i = 0; i < num_counters; i++) {
+                out << " " << (i % 2 ? run : 500);
+            }
+            out << "\n";
+        }
+    }
+
+    const char *guided_ll = "pgo_guided.ll";
+    Internal::ensure_no_file_exists(guided_ll);
+    f.compile_to(Outputs().llvm_assembly(guided_ll).pgo_profile(profile), args, "pgo_test", t);
+    Internal::assert_file_exists(guided_ll);
+
+    ir = read_file(guided_ll);
+    if (ir.find("halide_pgo_register") != std::string::npos) {
+        printf("The profile-guided pipeline shouldn't be instrumented\n");
+        return -1;
+    }
+    // The specialization is taken once out of 1000 times. (The loops
+    // get weights too, but LLVM's loop passes rewrite those.)
+    if (ir.find("!\"branch_weights\", i32 1, i32 999}") == std::string::npos) {
+        printf("The profile-guided pipeline doesn't have the expected branch weights\n");
+        return -1;
+    }
+
+    printf("Success!\n");
+    return 0;
+}
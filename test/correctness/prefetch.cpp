@@ -0,0 +1,86 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+using namespace Halide::Internal;
+
+// Count the prefetches in the lowered code.
+class CountPrefetches : public IRMutator {
+    using IRMutator::visit;
+
+    void visit(const Call *op) {
+        if (op->is_intrinsic(Call::prefetch) || op->is_intrinsic(Call::prefetch_2d)) {
+            count++;
+        }
+        IRMutator::visit(op);
+    }
+
+public:
+    int count = 0;
+};
+
+int check(Func f, Buffer<float> in, CountPrefetches *counter) {
+    Buffer<float> out = f.realize(in.width(), in.height() - 1, in.channels());
+    if (counter->count == 0) {
+        printf("No prefetches found in %s\n", f.name().c_str());
+        return -1;
+    }
+    for (int k = 0; k < out.channels(); k++) {
+        for (int j = 0; j < out.height(); j++) {
+            for (int i = 0; i < out.width(); i++) {
+                float correct = in(i, j, k) + 2 * in(i, j + 1, k);
+                if (out(i, j, k) != correct) {
+                    printf("%s(%d, %d, %d) = %f instead of %f\n",
+                           f.name().c_str(), i, j, k, out(i, j, k), correct);
+                    return -1;
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    const int W = 500, H = 100, C = 3;
+    Buffer<float> in(W, H, C);
+    for (int k = 0; k < C; k++) {
+        for (int j = 0; j < H; j++) {
+            for (int i = 0; i < W; i++) {
+                in(i, j, k) = (float)(i + j * W + k * W * H);
+            }
+        }
+    }
+
+    Var x("x"), y("y"), c("c");
+
+    // Prefetch two rows, a couple of iterations ahead. The box
+    // prefetched is three dimensional, with an extent of one in c.
+    {
+        Func f("f_iterations");
+        f(x, y, c) = in(x, y, c) + 2 * in(x, y + 1, c);
+        f.vectorize(x, 8).prefetch(y, 2);
+
+        CountPrefetches *counter = new CountPrefetches;
+        f.add_custom_lowering_pass(counter);
+        if (check(f, in, counter) != 0) {
+            return -1;
+        }
+    }
+
+    // Prefetch 8KB ahead, which is about two iterations, as each one
+    // reads 2 rows of 500 floats.
+    {
+        Func f("f_bytes");
+        f(x, y, c) = in(x, y, c) + 2 * in(x, y + 1, c);
+        f.vectorize(x, 8).prefetch(y, 8192, PrefetchUnit::Bytes);
+
+        CountPrefetches *counter = new CountPrefetches;
+        f.add_custom_lowering_pass(counter);
+        if (check(f, in, counter) != 0) {
+            return -1;
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,85 @@
+#include "Halide.h"
+#include <stdio.h>
+#include <math.h>
+#include <vector>
+
+using namespace Halide;
+
+// Computes the pyramid the slow way, one level at a time.
+std::vector<Buffer<float>> reference_pyramid(Buffer<float> in, int levels) {
+    std::vector<Buffer<float>> result;
+    result.push_back(in);
+    const int weights[] = {1, 3, 3, 1};
+    for (int l = 1; l < levels; l++) {
+        Buffer<float> prev = result.back();
+        Buffer<float> next((prev.width() + 1) / 2, (prev.height() + 1) / 2, prev.channels());
+        next.for_each_element([&](int x, int y, int c) {
+            float total = 0;
+            for (int j = 0; j < 4; j++) {
+                for (int i = 0; i < 4; i++) {
+                    int px = std::min(std::max(2 * x + i - 1, 0), prev.width() - 1);
+                    int py = std::min(std::max(2 * y + j - 1, 0), prev.height() - 1);
+                    total += prev(px, py, c) * (weights[i] * weights[j]);
+                }
+            }
+            next(x, y, c) = total * (1.0f / 64);
+        });
+        result.push_back(next);
+    }
+    return result;
+}
+
+bool test(bool scheduled) {
+    const int W = 123, H = 77, C = 3, levels = 6;
+    Buffer<float> in(W, H, C);
+    in.for_each_element([&](int x, int y, int c) { in(x, y, c) = (float)((x * 7 + y * 13 + c * 29) % 64); });
+    std::vector<Buffer<float>> correct = reference_pyramid(in, levels);
+
+    Var x("x"), y("y"), c("c");
+    Func base("base");
+    base(x, y, c) = in(x, y, c);
+    Pyramid gaussian(base, W, H, levels);
+    if (scheduled) {
+        gaussian.schedule(8, 2);
+    }
+
+    // Read every level, so the whole pyramid is computed, and check
+    // each one separately.
+    Func out("out");
+    std::vector<Expr> values;
+    for (int l = 0; l < levels; l++) {
+        values.push_back(gaussian[l](x, y, c));
+    }
+    out(x, y, c) = Tuple(values);
+    Realization r = out.realize(W, H, C);
+
+    for (int l = 0; l < levels; l++) {
+        Buffer<float> level = r[l];
+        const Buffer<float> &ref = correct[l];
+        for (int c = 0; c < C; c++) {
+            for (int y = 0; y < H; y++) {
+                for (int x = 0; x < W; x++) {
+                    // Outside a level, its view repeats its edges.
+                    float expected = ref(std::min(x, ref.width() - 1),
+                                         std::min(y, ref.height() - 1), c);
+                    if (fabs(level(x, y, c) - expected) > 1e-3f) {
+                        printf("%s level %d at (%d, %d, %d) = %f instead of %f\n",
+                               scheduled ? "Scheduled" : "Unscheduled",
+                               l, x, y, c, level(x, y, c), expected);
+                        return false;
+                    }
+                }
+            }
+        }
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    if (!test(false) || !test(true)) {
+        return -1;
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -174,6 +174,37 @@ int main(int argc, char **argv) {
         }
     }
 
+    // The generator is Philox2x32-10, so check it against the
+    // published known-answer vectors, with a counter and key of all
+    // zeros and all ones. (A key of ~0 folds to itself.)
+    {
+        uint32_t zero = evaluate<uint32_t>(Internal::random_int({Expr(0), Expr(0)}));
+        uint32_t ones = evaluate<uint32_t>(Internal::random_int({Expr(-1), Expr(-1), Expr(-1)}));
+        if (zero != 0xff1dae59 || ones != 0x2c3f628b) {
+            printf("Known-answer tests gave %08x and %08x\n", zero, ones);
+            return -1;
+        }
+    }
+
+    // The values don't depend on the schedule.
+    {
+        Func f, g;
+        f(x, y) = random_uint();
+        g(x, y) = f(x, y);
+        Buffer<uint32_t> scalar = g.realize(64, 64);
+        f.compute_root().vectorize(x, 8).parallel(y);
+        Buffer<uint32_t> vector = g.realize(64, 64);
+        for (int yi = 0; yi < 64; yi++) {
+            for (int xi = 0; xi < 64; xi++) {
+                if (scalar(xi, yi) != vector(xi, yi)) {
+                    printf("Vectorized random_uint at %d, %d is %u instead of %u\n",
+                           xi, yi, vector(xi, yi), scalar(xi, yi));
+                    return -1;
+                }
+            }
+        }
+    }
+
     printf("Success!\n");
 
     return 0;
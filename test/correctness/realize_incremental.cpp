@@ -0,0 +1,74 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+
+int main(int argc, char **argv) {
+    const int W = 256, H = 256;
+    Buffer<int> in(W, H);
+    in.for_each_element([&](int x, int y) { in(x, y) = x + y * W; });
+
+    ImageParam input(Int(32), 2, "input");
+    Func clamped, blur_x, blur_y;
+    Var x, y, xo, yo, xi, yi;
+
+    clamped = BoundaryConditions::repeat_edge(input);
+    blur_x(x, y) = clamped(x - 1, y) + clamped(x, y) + clamped(x + 1, y);
+    blur_y(x, y) = blur_x(x, y - 1) + blur_x(x, y) + blur_x(x, y + 1);
+    blur_x.compute_at(blur_y, xo);
+    blur_y.tile(x, y, xo, yo, xi, yi, 16, 16);
+
+    Pipeline p(blur_y);
+    input.set(in);
+    Buffer<int> out(W, H);
+    p.realize(out);
+
+    // Change a small rectangle of the input, and mark everything the
+    // incremental realization shouldn't touch, well away from it.
+    for (int j = 100; j < 104; j++) {
+        for (int i = 40; i < 45; i++) {
+            in(i, j) = -in(i, j);
+        }
+    }
+    const int sentinel = 0x12345678;
+    for (int j = 0; j < H; j++) {
+        for (int i = 0; i < W; i++) {
+            if (i >= 64 || j < 80 || j >= 128) {
+                out(i, j) = sentinel;
+            }
+        }
+    }
+    p.realize_incremental(out, "input", {{40, 5}, {100, 4}});
+
+    Buffer<int> correct = p.realize(W, H);
+    for (int j = 0; j < H; j++) {
+        for (int i = 0; i < W; i++) {
+            if (i >= 64 || j < 80 || j >= 128) {
+                if (out(i, j) != sentinel) {
+                    printf("out(%d, %d) was recomputed, but doesn't depend on the dirty region\n", i, j);
+                    return -1;
+                }
+            } else if (out(i, j) != correct(i, j)) {
+                printf("out(%d, %d) = %d instead of %d\n", i, j, out(i, j), correct(i, j));
+                return -1;
+            }
+        }
+    }
+
+    // A change at the edge of the input reaches the outputs clamped
+    // to it too.
+    in(0, 0) = 1000;
+    p.realize_incremental(out, "input", {{0, 1}, {0, 1}});
+    correct = p.realize(W, H);
+    for (int j = 0; j < 16; j++) {
+        for (int i = 0; i < 16; i++) {
+            if (out(i, j) != correct(i, j)) {
+                printf("out(%d, %d) = %d instead of %d\n", i, j, out(i, j), correct(i, j));
+                return -1;
+            }
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,97 @@
+#include "Halide.h"
+#include <stdio.h>
+#include <fstream>
+#include <sstream>
+
+using namespace Halide;
+
+std::string read_file(const std::string &filename) {
+    std::ifstream f(filename);
+    std::stringstream s;
+    s << f.rdbuf();
+    return s.str();
+}
+
+struct Blur {
+    ImageParam input{Int(32), 2, "input"};
+    Param<int> scale{"scale"};
+    Func blur_x{"blur_x"}, blur_y{"blur_y"};
+    Var x{"x"}, y{"y"}, xo{"xo"}, xi{"xi"}, yo{"yo"}, yi{"yi"};
+
+    // The same algorithm is built twice, with the same names, as if
+    // by two different processes.
+    Blur() {
+        blur_x(x, y) = input(x, y) + input(x + 1, y) + input(x + 2, y);
+        blur_y(x, y) = (blur_x(x, y) + blur_x(x, y + 1) + blur_x(x, y + 2)) * scale;
+    }
+
+    void schedule() {
+        blur_y.split(y, yo, yi, input.height() / 4).parallel(yo);
+        blur_y.specialize(scale == 1).vectorize(x, 4);
+        blur_y.vectorize(x, 8);
+        blur_x.store_at(blur_y, yo).compute_at(blur_y, yi).vectorize(x, 8);
+        blur_y.bound(x, 0, 64);
+    }
+};
+
+int main(int argc, char **argv) {
+    const int W = 64, H = 32;
+    Buffer<int> in(W + 2, H + 2);
+    in.for_each_element([&](int x, int y) { in(x, y) = x * 3 + y * 5; });
+
+    const char *filename = "schedule_serialization.txt";
+    Internal::ensure_no_file_exists(filename);
+    std::string dumped;
+    {
+        Blur b;
+        b.schedule();
+        Pipeline p(b.blur_y);
+        p.dump_schedule(filename);
+        Internal::assert_file_exists(filename);
+        dumped = read_file(filename);
+    }
+
+    Blur b;
+    Pipeline p(b.blur_y);
+    p.apply_schedule(filename);
+
+    // The schedule loaded into the unscheduled copy of the pipeline is
+    // the one written from the scheduled one.
+    const char *reloaded = "schedule_serialization_reloaded.txt";
+    Internal::ensure_no_file_exists(reloaded);
+    p.dump_schedule(reloaded);
+    if (read_file(reloaded) != dumped) {
+        printf("Schedule applied:\n%s\nis not the schedule loaded:\n%s\n",
+               dumped.c_str(), read_file(reloaded).c_str());
+        return -1;
+    }
+    if (dumped.find("specialization (scale==1)") == std::string::npos ||
+        dumped.find("compute_level blur_y yi 0") == std::string::npos) {
+        printf("Schedule is missing the specialization or the compute level:\n%s\n", dumped.c_str());
+        return -1;
+    }
+
+    b.input.set(in);
+    for (int s : {1, 3}) {
+        b.scale.set(s);
+        Buffer<int> out = p.realize(W, H);
+        for (int y = 0; y < H; y++) {
+            for (int x = 0; x < W; x++) {
+                int correct = 0;
+                for (int dy = 0; dy < 3; dy++) {
+                    for (int dx = 0; dx < 3; dx++) {
+                        correct += in(x + dx, y + dy);
+                    }
+                }
+                correct *= s;
+                if (out(x, y) != correct) {
+                    printf("out(%d, %d) = %d instead of %d\n", x, y, out(x, y), correct);
+                    return -1;
+                }
+            }
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,75 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+
+int mallocs = 0;
+
+void *my_malloc(void *user_context, size_t x) {
+    mallocs++;
+    void *orig = malloc(x+32);
+    void *ptr = (void *)((((size_t)orig + 32) >> 5) << 5);
+    ((void **)ptr)[-1] = orig;
+    return ptr;
+}
+
+void my_free(void *user_context, void *ptr) {
+    free(((void**)ptr)[-1]);
+}
+
+int main(int argc, char **argv) {
+    // A chain of compute_root stages of various types, each used only
+    // by the next. Every other stage can reuse the memory of the one
+    // two before it, so there should only be two heap allocations.
+    Var x, y;
+    const int stages = 8;
+    std::vector<Func> f(stages);
+    f[0](x, y) = cast<uint8_t>(x + y);
+    for (int i = 1; i < stages; i++) {
+        Expr prev = (cast<float>(f[i-1](x, y)) + f[i-1](x + 1, y)) / 2;
+        switch (i % 3) {
+        case 0: f[i](x, y) = cast<uint8_t>(prev); break;
+        case 1: f[i](x, y) = cast<int16_t>(prev); break;
+        default: f[i](x, y) = cast<float>(prev); break;
+        }
+        f[i-1].compute_root();
+    }
+    Func out;
+    out(x, y) = cast<float>(f[stages-1](x, y));
+    out.set_custom_allocator(my_malloc, my_free);
+
+    const int W = 100, H = 37;
+    Buffer<float> result = out.realize(W, H);
+
+    // Compute the correct answer.
+    std::vector<float> correct(W + stages);
+    for (int j = 0; j < H; j++) {
+        for (int i = 0; i < W + stages; i++) {
+            correct[i] = (uint8_t)(i + j);
+        }
+        for (int s = 1; s < stages; s++) {
+            for (int i = 0; i + s < W + stages; i++) {
+                float prev = (correct[i] + correct[i + 1]) / 2;
+                switch (s % 3) {
+                case 0: correct[i] = (uint8_t)(prev); break;
+                case 1: correct[i] = (int16_t)(prev); break;
+                default: correct[i] = prev; break;
+                }
+            }
+        }
+        for (int i = 0; i < W; i++) {
+            if (result(i, j) != correct[i]) {
+                printf("result(%d, %d) = %f instead of %f\n", i, j, result(i, j), correct[i]);
+                return -1;
+            }
+        }
+    }
+
+    if (mallocs != 2) {
+        printf("There were %d heap allocations instead of 2\n", mallocs);
+        return -1;
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -12,6 +12,7 @@ int main(int argc, char **argv) {
 #include "Halide.h"
 
 #include <stdarg.h>
+#include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 #include <unistd.h>
@@ -27,10 +28,15 @@ bool failed = false;
 Var x("x"), y("y");
 
 bool use_ssse3, use_sse41, use_sse42, use_avx, use_avx2, use_avx512, use_avx512_knl, use_avx512_skylake, use_avx512_cannonlake;
-bool use_vsx, use_power_arch_2_07;
+bool use_vsx, use_power_arch_2_07, use_power_arch_3_00;
+bool use_msa;
 
 string filter = "*";
 
+// Also compile each vector Func on its own, for the benchmark driver
+// in apps/simd_op_check to time.
+bool emit_benchmarks = false;
+
 Target target;
 
 ImageParam in_f32, in_f64, in_i8, in_u8, in_i16, in_u16, in_i32, in_u32, in_i64, in_u64;
@@ -54,7 +60,8 @@ bool can_run_code() {
     for (Target::Feature f : {Target::SSE41, Target::AVX,
                 Target::AVX2, Target::AVX512,
                 Target::FMA, Target::FMA4, Target::F16C,
-                Target::VSX, Target::POWER_ARCH_2_07,
+                Target::VSX, Target::POWER_ARCH_2_07, Target::POWER_ARCH_3_00,
+                Target::MSA,
                 Target::ARMv7s, Target::NoNEON, Target::MinGW}) {
         if (target.has_feature(f) != host_target.has_feature(f)) {
             can_run_the_code = false;
@@ -176,6 +183,11 @@ void check(string op, int vector_width, Expr e) {
     std::string fn_name = "test_" + name;
     error.compile_to_file(fn_name, arg_types, fn_name, target);
 
+    if (emit_benchmarks) {
+        std::string bench_name = "bench_" + name;
+        f.compile_to_file(bench_name, arg_types, bench_name, target);
+    }
+
     bool can_run_the_code = can_run_code();
     if (can_run_the_code) {
         Realization r = error.realize(target.without_feature(Target::NoRuntime));
@@ -204,8 +216,10 @@ using namespace Halide::ConciseCasts;
 void check_sse_all() {
     #if LLVM_VERSION > 39
     #define YMM "*ymm"
+    #define ZMM "*zmm"
     #else
     #define YMM
+    #define ZMM
     #endif
 
     Expr f64_1 = in_f64(x), f64_2 = in_f64(x+16), f64_3 = in_f64(x+32);
@@ -582,6 +596,11 @@ void check_sse_all() {
         check("vpminuq", 8, min(u64_1, u64_2));
         check("vpmaxsq", 8, max(i64_1, i64_2));
         check("vpminsq", 8, min(i64_1, i64_2));
+
+        check("vpmaddwd" ZMM, 16, i32(i16_1) * 3 + i32(i16_2) * 4);
+        check("vpmaddwd" ZMM, 16, i32(i16_1) * i32(i16_2) - i32(i16_3) * 4);
+        check("vpmaddwd" ZMM, 16, i32(u8_1) * 3 + i32(u8_2) * 4);
+        check("vpermt2w", 32, in_u16(2*x) + in_u16(2*x + 1));
     }
 }
 
@@ -1350,6 +1369,22 @@ void check_neon_all() {
     // Interleave or deinterleave two vectors. Given that we use
     // interleaving loads and stores, it's hard to hit this op with
     // halide.
+
+    if (!arm32 && target.has_feature(Target::ARMDotProd)) {
+        for (int w = 1; w <= 4; w++) {
+            check("udot", 4*w, (i32(u8_1) * i32(u8_2) + i32(u8_2) * i32(u8_3) +
+                                i32(u8_3) * i32(u8_1) + i32(u8_1) * 3));
+            check("sdot", 4*w, (i32(i8_1) * i32(i8_2) + i32(i8_2) * i32(i8_3) +
+                                i32(i8_3) * i32(i8_1) + i32(i8_1) * -3 + i32_1));
+        }
+    }
+
+    if (!arm32 && target.has_feature(Target::ARMFp16)) {
+        Expr f16_1 = cast(Float(16), f32_1), f16_2 = cast(Float(16), f32_2);
+        check("fadd*.8h", 8, f16_1 + f16_2);
+        check("fmul*.8h", 8, f16_1 * f16_2);
+        check("fadd*.4h", 4, f16_1 + f16_2);
+    }
 }
 
 void check_hvx_all() {
@@ -1620,6 +1655,16 @@ void check_hvx_all() {
     check("vmin(v*.h,v*.h)", hvx_width/2, min(i16_1, i16_2));
     check("vmin(v*.w,v*.w)", hvx_width/4, min(i32_1, i32_2));
 
+    if (target.has_feature(Target::HVX_v62)) {
+        check("vmax(v*.b,v*.b)", hvx_width/1, max(i8_1, i8_2));
+        check("vmin(v*.b,v*.b)", hvx_width/1, min(i8_1, i8_2));
+
+        check("vadd(v*.b,v*.b):sat", hvx_width/1, i8_sat(i16(i8_1) + i16(i8_2)));
+        check("vadd(v*.uw,v*.uw):sat", hvx_width/4, u32_sat(u64(u32_1) + u64(u32_2)));
+        check("vsub(v*.b,v*.b):sat", hvx_width/1, i8_sat(i16(i8_1) - i16(i8_2)));
+        check("vsub(v*.uw,v*.uw):sat", hvx_width/4, u32_sat(i64(u32_1) - i64(u32_2)));
+    }
+
     check("vcmp.gt(v*.b,v*.b)", hvx_width/1, select(i8_1 < i8_2, i8_1, i8_2));
     check("vcmp.gt(v*.ub,v*.ub)", hvx_width/1, select(u8_1 < u8_2, u8_1, u8_2));
     check("vcmp.gt(v*.h,v*.h)", hvx_width/2, select(i16_1 < i16_2, i16_1, i16_2));
@@ -1829,6 +1874,14 @@ void check_altivec_all() {
         check("vsubuhs", 8*w, u16(max(i32(u16_1) - i32(u16_2), 0)));
         check("vsubuws", 4*w, u32(max(i64(u32_1) - i64(u32_2), 0)));
 
+        // Vector Integer Pack Saturate Instructions.
+        check("vpkshss", 16*w,  i8_sat(i16_1));
+        check("vpkshus", 16*w,  u8_sat(i16_1));
+        check("vpkuhus", 16*w,  u8_sat(u16_1));
+        check("vpkswss",  8*w, i16_sat(i32_1));
+        check("vpkswus",  8*w, u16_sat(i32_1));
+        check("vpkuwus",  8*w, u16_sat(u32_1));
+
         // Vector Integer Average Instructions.
         check("vavgsb", 16*w,  i8((i16( i8_1) + i16( i8_2) + 1)/2));
         check("vavgub", 16*w,  u8((u16( u8_1) + u16( u8_2) + 1)/2));
@@ -1888,10 +1941,79 @@ void check_altivec_all() {
             check("vmaxud",  2*w, max(u64_1, u64_2));
             check("vminsd",  2*w, min(i64_1, i64_2));
             check("vminud",  2*w, min(u64_1, u64_2));
+
+            check("vpksdss", 4*w, i32_sat(i64_1));
+            check("vpksdus", 4*w, u32_sat(i64_1));
+            check("vpkudus", 4*w, u32_sat(u64_1));
+        }
+    }
+
+    // Check these if target supports POWER ISA 3.00 and above.
+    if (use_power_arch_3_00) {
+        for (int w = 1; w <= 4; w++) {
+            // Vector Absolute Difference Instructions. Signed
+            // inputs have their sign bits flipped first.
+            check("vabsdub", 16*w, absd(u8_1, u8_2));
+            check("vabsduh",  8*w, absd(u16_1, u16_2));
+            check("vabsduw",  4*w, absd(u32_1, u32_2));
+            check("vabsdub", 16*w, absd(i8_1, i8_2));
+            check("vabsduh",  8*w, absd(i16_1, i16_2));
+            check("vabsduw",  4*w, absd(i32_1, i32_2));
         }
     }
 }
 
+void check_msa_all() {
+    if (!use_msa) return;
+
+    Expr i8_1  = in_i8(x),  i8_2  = in_i8(x+16),  i8_3  = in_i8(x+32),  i8_4  = in_i8(x+48);
+    Expr u8_1  = in_u8(x),  u8_2  = in_u8(x+16),  u8_3  = in_u8(x+32),  u8_4  = in_u8(x+48);
+    Expr i16_1 = in_i16(x), i16_2 = in_i16(x+16), i16_3 = in_i16(x+32), i16_4 = in_i16(x+48);
+    Expr u16_1 = in_u16(x), u16_2 = in_u16(x+16), u16_3 = in_u16(x+32), u16_4 = in_u16(x+48);
+    Expr i32_1 = in_i32(x), i32_2 = in_i32(x+16), i32_3 = in_i32(x+32), i32_4 = in_i32(x+48);
+    Expr u32_1 = in_u32(x), u32_2 = in_u32(x+16);
+
+    for (int w = 1; w <= 4; w++) {
+        // Saturating arithmetic.
+        check("adds_s.b", 16*w,  i8_sat(i16( i8_1) + i16( i8_2)));
+        check("adds_s.h",  8*w, i16_sat(i32(i16_1) + i32(i16_2)));
+        check("adds_s.w",  4*w, i32_sat(i64(i32_1) + i64(i32_2)));
+        check("adds_u.b", 16*w, u8(min(u16( u8_1) + u16( u8_2),  max_u8)));
+        check("adds_u.h",  8*w, u16(min(u32(u16_1) + u32(u16_2), max_u16)));
+        check("adds_u.w",  4*w, u32(min(u64(u32_1) + u64(u32_2), max_u32)));
+        check("subs_s.b", 16*w,  i8_sat(i16( i8_1) - i16( i8_2)));
+        check("subs_s.h",  8*w, i16_sat(i32(i16_1) - i32(i16_2)));
+        check("subs_s.w",  4*w, i32_sat(i64(i32_1) - i64(i32_2)));
+        check("subs_u.b", 16*w, u8(max(i16( u8_1) - i16( u8_2), 0)));
+        check("subs_u.h",  8*w, u16(max(i32(u16_1) - i32(u16_2), 0)));
+        check("subs_u.w",  4*w, u32(max(i64(u32_1) - i64(u32_2), 0)));
+
+        // Averaging.
+        check("aver_s.b", 16*w,  i8((i16( i8_1) + i16( i8_2) + 1)/2));
+        check("aver_u.b", 16*w,  u8((u16( u8_1) + u16( u8_2) + 1)/2));
+        check("aver_s.h",  8*w, i16((i32(i16_1) + i32(i16_2) + 1)/2));
+        check("aver_u.h",  8*w, u16((u32(u16_1) + u32(u16_2) + 1)/2));
+        check("aver_s.w",  4*w, i32((i64(i32_1) + i64(i32_2) + 1)/2));
+        check("aver_u.w",  4*w, u32((u64(u32_1) + u64(u32_2) + 1)/2));
+        check("ave_s.b",  16*w,  i8((i16( i8_1) + i16( i8_2))/2));
+        check("ave_u.b",  16*w,  u8((u16( u8_1) + u16( u8_2))/2));
+        check("ave_s.h",   8*w, i16((i32(i16_1) + i32(i16_2))/2));
+        check("ave_u.h",   8*w, u16((u32(u16_1) + u32(u16_2))/2));
+        check("ave_s.w",   4*w, i32((i64(i32_1) + i64(i32_2))/2));
+        check("ave_u.w",   4*w, u32((u64(u32_1) + u64(u32_2))/2));
+
+        // Widening multiplies.
+        check("mul_q.h",   8*w, i16_sat((i32(i16_1) * i32(i16_2)) / 32768));
+        check("mul_q.w",   4*w, i32_sat((i64(i32_1) * i64(i32_2)) / Expr((int64_t)1 << 31)));
+        check("mulr_q.h",  8*w, i16_sat((i32(i16_1) * i32(i16_2) + 16384) / 32768));
+        check("dotp_s.h",  8*w, i16(i8_1) * i16(i8_2) + i16(i8_3) * i16(i8_4));
+        check("dotp_u.h",  8*w, u16(u8_1) * u16(u8_2) + u16(u8_3) * u16(u8_4));
+        check("dotp_s.w",  4*w, i32(i16_1) * i32(i16_2) + i32(i16_3) * i32(i16_4));
+        check("dotp_u.w",  4*w, u32(u16_1) * u32(u16_2) + u32(u16_3) * u32(u16_4));
+        check("dotp_s.d",  2*w, i64(i32_1) * i64(i32_2) - i64(i32_3) * i64(i32_4));
+    }
+}
+
 int main(int argc, char **argv) {
     if (argc > 1) {
         num_processes = 1;
@@ -1915,6 +2037,7 @@ int main(int argc, char **argv) {
 
     target = get_target_from_environment();
     target.set_features({Target::NoBoundsQuery, Target::NoAsserts, Target::NoRuntime});
+    emit_benchmarks = getenv("HL_SIMD_OP_CHECK_BENCHMARKS") != NULL;
 
     use_avx512_knl = target.has_feature(Target::AVX512_KNL);
     use_avx512_cannonlake = target.has_feature(Target::AVX512_Cannonlake);
@@ -1933,6 +2056,8 @@ int main(int argc, char **argv) {
 
     use_vsx = target.has_feature(Target::VSX);
     use_power_arch_2_07 = target.has_feature(Target::POWER_ARCH_2_07);
+    use_power_arch_3_00 = target.has_feature(Target::POWER_ARCH_3_00);
+    use_msa = target.has_feature(Target::MSA);
 
 
     ImageParam image_params[] = {
@@ -1982,6 +2107,8 @@ int main(int argc, char **argv) {
         check_hvx_all();
     } else if (target.arch == Target::POWERPC) {
         check_altivec_all();
+    } else if (target.arch == Target::MIPS) {
+        check_msa_all();
     }
 
     // Compile a runtime for this target, for use in the static test.
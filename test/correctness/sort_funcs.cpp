@@ -0,0 +1,101 @@
+#include "Halide.h"
+#include <stdio.h>
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+using namespace Halide;
+
+int main(int argc, char **argv) {
+    Var i, x, y;
+
+    // A median filter, from a sorting network on each 3x3 window.
+    {
+        const int W = 64, H = 16;
+        Buffer<int> in(W + 2, H + 2);
+        in.set_min(-1, -1);
+        in.for_each_element([&](int x, int y) { in(x, y) = (x * 37 + y * 101) % 53; });
+
+        Func window;
+        window(i, x, y) = in(x + i % 3 - 1, y + i / 3 - 1);
+        Func sorted = sort(window, 9);
+        Func median;
+        median(x, y) = sorted(4, x, y);
+        median.vectorize(x, 8);
+
+        Buffer<int> out = median.realize(W, H);
+        for (int yy = 0; yy < H; yy++) {
+            for (int xx = 0; xx < W; xx++) {
+                std::vector<int> v;
+                for (int dy = -1; dy <= 1; dy++) {
+                    for (int dx = -1; dx <= 1; dx++) {
+                        v.push_back(in(xx + dx, yy + dy));
+                    }
+                }
+                std::sort(v.begin(), v.end());
+                if (out(xx, yy) != v[4]) {
+                    printf("median(%d, %d) = %d instead of %d\n", xx, yy, out(xx, yy), v[4]);
+                    return -1;
+                }
+            }
+        }
+    }
+
+    // Full sorts of rows, both of sizes sorted with a network and of
+    // sizes sorted in passes, none of them powers of two.
+    for (int size : {5, 27, 1000}) {
+        const int H = 3;
+        Buffer<float> in(size, H);
+        in.for_each_element([&](int x, int y) { in(x, y) = (float)((x * 7919 + y * 13) % 1009) - 500.0f; });
+
+        Func f;
+        f(x, y) = in(x, y);
+        Func sorted = sort(f, size);
+        Func top = top_k(f, size, 3);
+
+        Buffer<float> out = sorted.realize(size, H);
+        Buffer<float> out_top = top.realize(3, H);
+        for (int yy = 0; yy < H; yy++) {
+            std::vector<float> v;
+            for (int xx = 0; xx < size; xx++) {
+                v.push_back(in(xx, yy));
+            }
+            std::sort(v.begin(), v.end());
+            for (int xx = 0; xx < size; xx++) {
+                if (out(xx, yy) != v[xx]) {
+                    printf("sort of %d: out(%d, %d) = %f instead of %f\n",
+                           size, xx, yy, out(xx, yy), v[xx]);
+                    return -1;
+                }
+            }
+            for (int xx = 0; xx < 3; xx++) {
+                if (out_top(xx, yy) != v[size - 1 - xx]) {
+                    printf("top 3 of %d: out(%d, %d) = %f instead of %f\n",
+                           size, xx, yy, out_top(xx, yy), v[size - 1 - xx]);
+                    return -1;
+                }
+            }
+        }
+    }
+
+    // A one-dimensional sort large enough to be split across threads.
+    {
+        const int N = 10000;
+        Buffer<int> in(N);
+        in.for_each_element([&](int x) { in(x) = (x * 104729) % 10007; });
+        Func f;
+        f(x) = in(x);
+        Buffer<int> out = sort(f, N).realize(N);
+        std::vector<int> v(in.data(), in.data() + N);
+        std::sort(v.begin(), v.end());
+        for (int xx = 0; xx < N; xx++) {
+            if (out(xx) != v[xx]) {
+                printf("out(%d) = %d instead of %d\n", xx, out(xx), v[xx]);
+                return -1;
+            }
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
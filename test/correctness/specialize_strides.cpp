@@ -0,0 +1,80 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+using namespace Halide::Internal;
+
+// With the specialize_strides target feature, a pipeline whose inputs
+// and outputs may have any innermost stride gets a copy for when the
+// strides are all one. Check that copy has dense vector loads, and
+// that both copies compute the right thing.
+
+class CheckForDenseLoads : public IRMutator {
+    using IRMutator::visit;
+
+    void visit(const Load *op) {
+        const Ramp *r = op->index.as<Ramp>();
+        if (op->name == "input" && r && is_one(r->stride)) {
+            found = true;
+        }
+        IRMutator::visit(op);
+    }
+
+public:
+    bool found = false;
+};
+
+int main(int argc, char **argv) {
+    ImageParam input(Float(32), 2, "input");
+    input.dim(0).set_stride(Expr());
+
+    Var x("x"), y("y");
+    Func f("f");
+    f(x, y) = input(x, y) * 2.0f + input(x + 1, y);
+    f.output_buffer().dim(0).set_stride(Expr());
+    f.vectorize(x, 8, TailStrategy::GuardWithIf);
+
+    CheckForDenseLoads *checker = new CheckForDenseLoads;
+    f.add_custom_lowering_pass(checker);
+
+    Target t = get_jit_target_from_environment().with_feature(Target::SpecializeStrides);
+    f.compile_jit(t);
+    if (!checker->found) {
+        printf("There were no dense vector loads of the input\n");
+        return -1;
+    }
+
+    const int W = 67, H = 13;
+    for (int interleaved = 0; interleaved < 2; interleaved++) {
+        // An interleaved image has an innermost stride of three.
+        Buffer<float> in = interleaved ? Buffer<float>::make_interleaved(W + 1, H, 3)
+                                       : Buffer<float>(W + 1, H, 3);
+        in.for_each_element([&](int x, int y, int c) {
+            in(x, y, c) = x + y * 100 + c * 10000;
+        });
+        // Use channel 1 of the input and channel 0 of the output.
+        halide_dimension_t in_shape[] = {{0, W + 1, in.dim(0).stride()},
+                                         {0, H, in.dim(1).stride()}};
+        input.set(Buffer<float>(&in(0, 0, 1), 2, in_shape));
+
+        Buffer<float> out = interleaved ? Buffer<float>::make_interleaved(W, H, 2)
+                                        : Buffer<float>(W, H, 2);
+        halide_dimension_t out_shape[] = {{0, W, out.dim(0).stride()},
+                                          {0, H, out.dim(1).stride()}};
+        Buffer<float> out_view(&out(0, 0, 0), 2, out_shape);
+        f.realize(out_view, t);
+
+        for (int y = 0; y < H; y++) {
+            for (int x = 0; x < W; x++) {
+                float correct = in(x, y, 1) * 2.0f + in(x + 1, y, 1);
+                if (out(x, y, 0) != correct) {
+                    printf("out(%d, %d) = %f instead of %f\n", x, y, out(x, y, 0), correct);
+                    return -1;
+                }
+            }
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -1,5 +1,7 @@
 #include "Halide.h"
 #include <stdio.h>
+#include <fstream>
+#include <sstream>
 
 using namespace Halide;
 
@@ -43,6 +45,28 @@ int main() {
     tuple_func.compile_to_lowered_stmt(result_file_3, {}, Halide::HTML);
     Internal::assert_file_exists(result_file_3);
 
+    // Check annotating it with a profiler report.
+    const char *profile_file = "stmt_to_html_profile.json";
+    {
+        std::ofstream profile(profile_file);
+        profile << "{\"pipelines\": [\n"
+                << "  {\"name\": \"gradient_fast\", \"time_ns\": 2000000, \"runs\": 2, \"funcs\": [\n"
+                << "    {\"name\": \"overhead\", \"time_ns\": 0},\n"
+                << "    {\"name\": \"gradient_fast\", \"time_ns\": 2000000, \"average_threads\": 4}]}]}\n";
+    }
+    const char *result_file_4 = "stmt_to_html_dump_4.html";
+    Internal::ensure_no_file_exists(result_file_4);
+    gradient_fast.compile_to_lowered_stmt(result_file_4, {}, Halide::HTML,
+                                          get_target_from_environment(), profile_file);
+    Internal::assert_file_exists(result_file_4);
+    std::ifstream html(result_file_4);
+    std::stringstream contents;
+    contents << html.rdbuf();
+    if (contents.str().find("// 1ms/run (100%), 4 threads") == std::string::npos) {
+        printf("The profile wasn't shown in %s\n", result_file_4);
+        return -1;
+    }
+
     printf("Success!\n");
     return 0;
 }
@@ -0,0 +1,78 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+using namespace Halide::Internal;
+
+// Check that lowering allocated the given Func in the given type of memory.
+class CheckMemoryType : public IRMutator {
+    std::string func;
+    MemoryType memory_type;
+public:
+    CheckMemoryType(const std::string &f, MemoryType t) : func(f), memory_type(t) {}
+    using IRMutator::mutate;
+
+    Stmt mutate(Stmt s) {
+        class FindAllocation : public IRVisitor {
+            using IRVisitor::visit;
+            void visit(const Allocate *op) {
+                if (op->name == func) {
+                    found = true;
+                    memory_type = op->memory_type;
+                }
+                IRVisitor::visit(op);
+            }
+        public:
+            std::string func;
+            bool found = false;
+            MemoryType memory_type = MemoryType::Auto;
+        } finder;
+        finder.func = func;
+        s.accept(&finder);
+        if (!finder.found) {
+            printf("No allocation of %s\n", func.c_str());
+            exit(-1);
+        }
+        if (finder.memory_type != memory_type) {
+            std::cout << func << " was stored in " << finder.memory_type
+                      << " memory instead of " << memory_type << " memory\n";
+            exit(-1);
+        }
+        return s;
+    }
+};
+
+int check(const Buffer<int> &out) {
+    for (int y = 0; y < out.height(); y++) {
+        for (int x = 0; x < out.width(); x++) {
+            int correct = 2 * (x + y) + 1;
+            if (out(x, y) != correct) {
+                printf("out(%d, %d) = %d instead of %d\n", x, y, out(x, y), correct);
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    Var x("x"), y("y");
+
+    MemoryType types[] = {MemoryType::Heap, MemoryType::Stack, MemoryType::Register};
+    for (MemoryType t : types) {
+        Func g("g"), f("f");
+        g(x, y) = x + y;
+        f(x, y) = g(x, y) + g(x + 1, y);
+
+        // A constant-sized allocation, only accessed at constant
+        // indices once the loop over it is unrolled.
+        g.compute_at(f, x).unroll(x).store_in(t);
+        f.add_custom_lowering_pass(new CheckMemoryType("g", t));
+
+        Buffer<int> out = f.realize(16, 16);
+        if (check(out)) return -1;
+    }
+
+    printf("Success!\n");
+    return 0;
+}
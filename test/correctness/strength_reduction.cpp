@@ -0,0 +1,75 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+using namespace Halide::Internal;
+
+// The flattened indices in a loop over rows multiply the row by the
+// stride of each buffer. Check those multiplies are strength reduced
+// away, and that the results are still right.
+
+class CheckForStrideMultiplies : public IRMutator {
+    using IRMutator::visit;
+
+    std::string loop;
+
+    void visit(const For *op) {
+        if (ends_with(op->name, ".s0.y")) {
+            loop = op->name;
+            IRMutator::visit(op);
+            loop.clear();
+        } else {
+            IRMutator::visit(op);
+        }
+    }
+
+    void visit(const Mul *op) {
+        if (!loop.empty() && !is_const(op->a) && !is_const(op->b) &&
+            expr_uses_var(op, loop)) {
+            printf("Found multiply by the row in loop %s: %s\n",
+                   loop.c_str(), Expr(op).to_string().c_str());
+            found = true;
+        }
+        IRMutator::visit(op);
+    }
+
+public:
+    bool found = false;
+};
+
+int main(int argc, char **argv) {
+    const int W = 67, H = 33;
+    ImageParam input(Int(32), 2);
+    Func f("f");
+    Var x("x"), y("y");
+    f(x, y) = input(x, y) + input(x, y + 2) * 3 + y * 7;
+    f.vectorize(x, 8, TailStrategy::GuardWithIf);
+
+    CheckForStrideMultiplies *checker = new CheckForStrideMultiplies;
+    f.add_custom_lowering_pass(checker);
+
+    // Make the input wider than the output, so their strides differ.
+    Buffer<int> in(W + 5, H + 2);
+    in.for_each_element([&](int x, int y) {
+        in(x, y) = x * 1000 + y;
+    });
+    input.set(in);
+
+    Buffer<int> out = f.realize(W, H);
+    if (checker->found) {
+        return -1;
+    }
+
+    for (int y = 0; y < H; y++) {
+        for (int x = 0; x < W; x++) {
+            int correct = in(x, y) + in(x, y + 2) * 3 + y * 7;
+            if (out(x, y) != correct) {
+                printf("out(%d, %d) = %d instead of %d\n", x, y, out(x, y), correct);
+                return -1;
+            }
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
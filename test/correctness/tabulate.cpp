@@ -0,0 +1,87 @@
+#include "Halide.h"
+#include <cmath>
+#include <stdio.h>
+
+using namespace Halide;
+
+int main(int argc, char **argv) {
+    Var x, y;
+
+    // A gamma curve on 8-bit input, as a lookup table. The range of the
+    // argument comes from its type.
+    {
+        Buffer<uint8_t> input(256, 4);
+        for (int j = 0; j < input.height(); j++) {
+            for (int i = 0; i < input.width(); i++) {
+                input(i, j) = (uint8_t)(i ^ (j * 37));
+            }
+        }
+
+        auto curve = [](Expr v) {
+            return cast<uint8_t>(pow(cast<float>(v) / 255, 1 / 2.2f) * 255 + 0.5f);
+        };
+        Func f;
+        f(x, y) = lookup_table(input(x, y), curve);
+        f.vectorize(x, 8);
+
+        Buffer<uint8_t> out = f.realize(input.width(), input.height());
+        for (int j = 0; j < out.height(); j++) {
+            for (int i = 0; i < out.width(); i++) {
+                uint8_t correct = (uint8_t)(std::pow(input(i, j) / 255.0f, 1 / 2.2f) * 255 + 0.5f);
+                if (out(i, j) != correct) {
+                    printf("lookup_table: out(%d, %d) = %d instead of %d\n", i, j, out(i, j), correct);
+                    return -1;
+                }
+            }
+        }
+    }
+
+    // An explicit range, clamping values outside it.
+    {
+        Func f;
+        f(x) = lookup_table(x - 10, [](Expr v) { return v * v; }, 0, 20);
+        Buffer<int> out = f.realize(40);
+        for (int i = 0; i < out.width(); i++) {
+            int v = std::min(std::max(i - 10, 0), 20);
+            if (out(i) != v * v) {
+                printf("lookup_table: out(%d) = %d instead of %d\n", i, out(i), v * v);
+                return -1;
+            }
+        }
+    }
+
+    // Piecewise polynomials at a few tolerances.
+    for (double tolerance : {1e-2, 1e-4, 1e-6}) {
+        auto exp_ref = [](double v) { return std::exp(v); };
+        auto log_ref = [](double v) { return std::log(v); };
+        Func f, g;
+        f(x) = piecewise_polynomial(x / 1024.0f - 2, exp_ref, -2, 2, tolerance);
+        g(x) = piecewise_polynomial(x / 1024.0f, log_ref, 0.5, 4, tolerance);
+        f.vectorize(x, 8);
+        g.vectorize(x, 8);
+
+        Buffer<float> out_f = f.realize(4097);
+        Buffer<float> out_g = g.realize(4097);
+        for (int i = 0; i < out_f.width(); i++) {
+            double v = i / 1024.0f - 2;
+            double err = std::abs(out_f(i) - std::exp(v));
+            if (err > tolerance) {
+                printf("piecewise_polynomial(exp, %g): out(%d) = %f instead of %f\n",
+                       tolerance, i, out_f(i), std::exp(v));
+                return -1;
+            }
+
+            // Outside [0.5, 4], the argument is clamped.
+            v = std::min(std::max(i / 1024.0, 0.5), 4.0);
+            err = std::abs(out_g(i) - std::log(v));
+            if (err > tolerance) {
+                printf("piecewise_polynomial(log, %g): out(%d) = %f instead of %f\n",
+                       tolerance, i, out_g(i), std::log(v));
+                return -1;
+            }
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,79 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+
+#ifdef _WIN32
+#define DLLEXPORT __declspec(dllexport)
+#else
+#define DLLEXPORT
+#endif
+
+// Count the points of each iteration computed.
+int evaluations = 0;
+extern "C" DLLEXPORT int count_evaluation(int x) {
+    __sync_fetch_and_add(&evaluations, 1);
+    return x;
+}
+HalideExtern_1(int, count_evaluation, int);
+
+int main(int argc, char **argv) {
+    const int W = 128, H = 96, iterations = 6;
+    Buffer<int> in(W, H);
+    in.for_each_element([&](int x, int y) { in(x, y) = (x * 7 + y * 13) % 64; });
+
+    Var x, y, xo, yo, xi, yi;
+
+    // Smooth the input several times.
+    Func clamped = BoundaryConditions::repeat_edge(in);
+    std::vector<Func> steps;
+    Func prev = clamped;
+    for (int i = 0; i < iterations; i++) {
+        Func next;
+        next(x, y) = count_evaluation((prev(x - 1, y) + prev(x + 1, y) +
+                                       prev(x, y - 1) + prev(x, y + 1) + prev(x, y) * 4) / 8);
+        steps.push_back(next);
+        prev = next;
+    }
+    Func out;
+    out(x, y) = prev(x, y);
+
+    // The reference, a pass over the whole image per iteration.
+    for (Func f : steps) {
+        f.compute_root();
+    }
+    evaluations = 0;
+    Buffer<int> correct = out.realize(W, H);
+    if (evaluations != iterations * W * H) {
+        printf("Computed %d points instead of %d\n", evaluations, iterations * W * H);
+        return -1;
+    }
+
+    // The same iterations, tiled together. Each tile computes at
+    // most a trapezoid of each iteration, grown by the footprint of
+    // the iterations after it.
+    out.time_tile(steps, x, y, xo, yo, xi, yi, 32, 32);
+    evaluations = 0;
+    Buffer<int> tiled = out.realize(W, H);
+    for (int j = 0; j < H; j++) {
+        for (int i = 0; i < W; i++) {
+            if (tiled(i, j) != correct(i, j)) {
+                printf("tiled(%d, %d) = %d instead of %d\n", i, j, tiled(i, j), correct(i, j));
+                return -1;
+            }
+        }
+    }
+    int tiles = (W / 32) * (H / 32);
+    int max_evaluations = 0;
+    for (int i = 0; i < iterations; i++) {
+        int side = 32 + 2 * (iterations - 1 - i);
+        max_evaluations += tiles * side * side;
+    }
+    if (evaluations > max_evaluations) {
+        printf("Computed %d points, more than the %d expected\n", evaluations, max_evaluations);
+        return -1;
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,125 @@
+#include "Halide.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+using namespace Halide;
+
+// Tracing to a file buffers packets in memory. Trace enough stores,
+// from several threads, to go around the ring of buffers a few times,
+// and check that the file holds exactly the packets traced, and that
+// its index covers it.
+
+int main(int argc, char **argv) {
+#ifdef _WIN32
+    printf("Skipping test because it uses setenv\n");
+    return 0;
+#else
+    Internal::TemporaryFile trace_file("trace_file", "bin");
+    setenv("HL_TRACE_FILE", trace_file.pathname().c_str(), 1);
+    Internal::TemporaryFile index_file("trace_file_index", "bin");
+    setenv("HL_TRACE_INDEX_FILE", index_file.pathname().c_str(), 1);
+
+    const int W = 256, H = 1024;
+    Var x, y;
+    Func f("f");
+    f(x, y) = x + y * W;
+    f.parallel(y).trace_stores();
+    f.realize(W, H);
+
+    FILE *file = fopen(trace_file.pathname().c_str(), "rb");
+    if (!file) {
+        printf("Can't open the trace file\n");
+        return -1;
+    }
+    std::vector<uint8_t> data;
+    uint8_t chunk[4096];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+        data.insert(data.end(), chunk, chunk + n);
+    }
+    fclose(file);
+
+    std::vector<int> stores(W * H, 0);
+    int packets = 0;
+    int begin_pipelines = 0, end_pipelines = 0;
+    size_t pos = 0;
+    while (pos < data.size()) {
+        const halide_trace_packet_t *p = (const halide_trace_packet_t *)(&data[pos]);
+        if (p->size < sizeof(halide_trace_packet_t) || p->size % 4 != 0 || pos + p->size > data.size()) {
+            printf("Bad packet size %d at offset %d\n", (int)p->size, (int)pos);
+            return -1;
+        }
+        if (p->event == halide_trace_begin_pipeline) {
+            if (end_pipelines || pos != 0) {
+                printf("Begin pipeline event isn't first\n");
+                return -1;
+            }
+            begin_pipelines++;
+        } else if (p->event == halide_trace_end_pipeline) {
+            if (pos + p->size != data.size()) {
+                printf("End pipeline event isn't last\n");
+                return -1;
+            }
+            end_pipelines++;
+        } else if (p->event == halide_trace_store) {
+            const int *coords = p->coordinates();
+            int value = *(const int *)p->value();
+            int px = coords[0], py = coords[1];
+            if (px < 0 || px >= W || py < 0 || py >= H || value != px + py * W) {
+                printf("Bad store f(%d, %d) = %d\n", px, py, value);
+                return -1;
+            }
+            stores[px + py * W]++;
+        }
+        pos += p->size;
+        packets++;
+    }
+
+    if (begin_pipelines != 1 || end_pipelines != 1) {
+        printf("%d begin pipeline and %d end pipeline events\n", begin_pipelines, end_pipelines);
+        return -1;
+    }
+    for (int i = 0; i < W * H; i++) {
+        if (stores[i] != 1) {
+            printf("%d stores to f(%d, %d)\n", stores[i], i % W, i / W);
+            return -1;
+        }
+    }
+
+    // The index should describe contiguous chunks of the file, with
+    // the packets in them, and name f in the chunks of its stores.
+    file = fopen(index_file.pathname().c_str(), "rb");
+    if (!file) {
+        printf("Can't open the trace index file\n");
+        return -1;
+    }
+    uint64_t offset = 0;
+    int indexed_packets = 0;
+    bool named_f = false;
+    halide_trace_index_entry_t entry;
+    while (fread(&entry, sizeof(entry), 1, file) == 1) {
+        std::vector<char> names(entry.names_size + 1, 0);
+        if (entry.names_size && fread(&names[0], entry.names_size, 1, file) != 1) {
+            printf("Truncated trace index\n");
+            return -1;
+        }
+        if (entry.offset != offset || entry.names_size % 4 != 0) {
+            printf("Bad index entry at offset %d, expected %d\n", (int)entry.offset, (int)offset);
+            return -1;
+        }
+        named_f |= (std::string(&names[0]) == "f");
+        offset += entry.size;
+        indexed_packets += entry.packets;
+    }
+    fclose(file);
+    if (offset != data.size() || indexed_packets != packets || !named_f) {
+        printf("Index covers %d bytes and %d packets of %d and %d\n",
+               (int)offset, indexed_packets, (int)data.size(), packets);
+        return -1;
+    }
+
+    printf("Success!\n");
+    return 0;
+#endif
+}
@@ -0,0 +1,92 @@
+#include "Halide.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace Halide;
+
+// With HL_TRACE_TIMELINE_FILE set, the realizations, produce and
+// consume nodes and parallel tasks of Funcs traced with
+// trace_realizations should be written out as a Chrome trace, with
+// the begin and end events of each thread properly nested.
+
+int main(int argc, char **argv) {
+#ifdef _WIN32
+    printf("Skipping test because it uses setenv\n");
+    return 0;
+#else
+    Internal::TemporaryFile timeline_file("trace_timeline", "json");
+    setenv("HL_TRACE_TIMELINE_FILE", timeline_file.pathname().c_str(), 1);
+
+    const int H = 64;
+    Var x, y;
+    Func f("f"), g("g");
+    f(x, y) = x + y;
+    g(x, y) = f(x, y) + f(x + 1, y);
+    f.compute_at(g, y).trace_realizations();
+    g.parallel(y).trace_realizations();
+    g.realize(256, H);
+
+    FILE *file = fopen(timeline_file.pathname().c_str(), "r");
+    if (!file) {
+        printf("Can't open the timeline file\n");
+        return -1;
+    }
+
+    // Each event is on a line of its own.
+    std::map<int, std::vector<std::string>> open_events;
+    int tasks = 0, produces = 0;
+    char line[1024];
+    while (fgets(line, sizeof(line), file)) {
+        if (line[0] != '{') {
+            continue;
+        }
+        char name[256], cat[64], ph[8];
+        int pid, tid;
+        if (sscanf(line, "{\"name\": \"%255[^\"]\", \"cat\": \"%63[^\"]\", \"ph\": \"%7[^\"]\", \"pid\": %d, \"tid\": %d",
+                   name, cat, ph, &pid, &tid) != 5) {
+            printf("Can't parse timeline event: %s\n", line);
+            return -1;
+        }
+        std::string key = std::string(cat) + " " + name;
+        std::vector<std::string> &stack = open_events[tid];
+        if (strcmp(ph, "B") == 0) {
+            stack.push_back(key);
+            if (strcmp(cat, "task") == 0) {
+                tasks++;
+            } else if (strcmp(cat, "produce") == 0 && strcmp(name, "f") == 0) {
+                produces++;
+            }
+        } else if (strcmp(ph, "E") == 0) {
+            if (stack.empty() || stack.back() != key) {
+                printf("End of %s on thread %d doesn't match its begin\n", key.c_str(), tid);
+                return -1;
+            }
+            stack.pop_back();
+        } else {
+            printf("Unexpected phase %s\n", ph);
+            return -1;
+        }
+    }
+    fclose(file);
+
+    for (auto it : open_events) {
+        if (!it.second.empty()) {
+            printf("%s on thread %d never ended\n", it.second.back().c_str(), it.first);
+            return -1;
+        }
+    }
+
+    if (tasks != H || produces != H) {
+        printf("Timeline has %d tasks and %d productions of f, instead of %d each\n",
+               tasks, produces, H);
+        return -1;
+    }
+
+    printf("Success!\n");
+    return 0;
+#endif
+}
@@ -0,0 +1,115 @@
+#include "Halide.h"
+#include <stdio.h>
+#include <string.h>
+
+using namespace Halide;
+
+// Check that trace_region and trace_sample_rate restrict the loads
+// and stores traced.
+
+int loads = 0, stores = 0, bad = 0;
+int region_min[2], region_max[2];
+
+int my_trace(void *user_context, const halide_trace_event_t *e) {
+    if (strcmp(e->func, "f") != 0 ||
+        (e->event != halide_trace_load && e->event != halide_trace_store)) {
+        return 0;
+    }
+    if (e->event == halide_trace_load) {
+        loads++;
+    } else {
+        stores++;
+    }
+    // Each coordinate is a vector, so check that some lane is in the
+    // region in every dimension.
+    int lanes = e->type.lanes;
+    for (int d = 0; d < e->dimensions && d < 2; d++) {
+        bool inside = false;
+        for (int i = 0; i < lanes; i++) {
+            int c = e->coordinates[d * lanes + i];
+            inside = inside || (c >= region_min[d] && c <= region_max[d]);
+        }
+        if (!inside) {
+            bad++;
+        }
+    }
+    return 0;
+}
+
+void reset(int min_x, int max_x, int min_y, int max_y) {
+    loads = stores = bad = 0;
+    region_min[0] = min_x;
+    region_max[0] = max_x;
+    region_min[1] = min_y;
+    region_max[1] = max_y;
+}
+
+int main(int argc, char **argv) {
+    Var x("x"), y("y");
+
+    {
+        // A constant region on a scalar Func.
+        Func f("f"), g("g");
+        f(x, y) = x + y;
+        g(x, y) = f(x, y) * 2;
+        f.compute_root().trace_loads().trace_stores()
+            .trace_region(x, 10, 5).trace_region(y, 20, 3);
+        g.set_custom_trace(&my_trace);
+
+        reset(10, 14, 20, 22);
+        g.realize(64, 64);
+        if (loads != 15 || stores != 15 || bad) {
+            printf("Constant region: %d loads, %d stores, %d outside the region\n",
+                   loads, stores, bad);
+            return -1;
+        }
+    }
+
+    {
+        // A region given by Params, on a vectorized Func. Every vector
+        // with a lane inside the region should be traced once.
+        Param<int> min_x;
+        Func f("f"), g("g");
+        f(x, y) = x + y;
+        g(x, y) = f(x, y) * 2;
+        f.compute_root().vectorize(x, 8).trace_stores().trace_region(x, min_x, 2);
+        g.set_custom_trace(&my_trace);
+
+        min_x.set(15);
+        reset(15, 16, 0, 63);
+        g.realize(64, 64);
+        // x in [15, 16] touches the vectors starting at 8 and 16.
+        if (stores != 2 * 64 || bad) {
+            printf("Param region: %d stores, %d outside the region\n", stores, bad);
+            return -1;
+        }
+    }
+
+    {
+        // Sampling should trace about one in n points, and the same
+        // points for both loads and stores every time.
+        Func f("f"), g("g");
+        f(x, y) = x * y;
+        g(x, y) = f(x, y) + 1;
+        f.compute_root().trace_loads().trace_stores().trace_sample_rate(8);
+        g.set_custom_trace(&my_trace);
+
+        reset(0, 255, 0, 255);
+        g.realize(256, 256);
+        int first_stores = stores;
+        if (stores < 256 * 256 / 16 || stores > 256 * 256 / 4 || loads != stores || bad) {
+            printf("Sampling: %d loads and %d stores out of %d\n", loads, stores, 256 * 256);
+            return -1;
+        }
+
+        reset(0, 255, 0, 255);
+        g.realize(256, 256);
+        if (stores != first_stores) {
+            printf("Sampling traced %d stores, then %d\n", first_stores, stores);
+            return -1;
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
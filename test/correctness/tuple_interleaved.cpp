@@ -0,0 +1,102 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+
+int mallocs = 0;
+
+void *my_malloc(void *user_context, size_t x) {
+    mallocs++;
+    void *orig = malloc(x+32);
+    void *ptr = (void *)((((size_t)orig + 32) >> 5) << 5);
+    ((void **)ptr)[-1] = orig;
+    return ptr;
+}
+
+void my_free(void *user_context, void *ptr) {
+    free(((void**)ptr)[-1]);
+}
+
+// Square complex numbers stored as (re, im) tuples.
+int test_complex(bool interleave, int vector_width) {
+    Var x, y;
+    Func c, sq;
+    c(x, y) = Tuple(cast<float>(x) / 8, cast<float>(y) - x);
+    // An update that reads and writes every element.
+    c(x, y) = Tuple(c(x, y)[0] + 1, c(x, y)[1] * c(x, y)[0]);
+    Expr re = c(x, y)[0], im = c(x, y)[1];
+    sq(x, y) = Tuple(re * re - im * im, 2 * re * im);
+
+    c.compute_root().vectorize(x, vector_width);
+    c.update().vectorize(x, vector_width);
+    if (interleave) {
+        c.store_tuple_interleaved();
+    }
+    sq.vectorize(x, vector_width);
+    sq.set_custom_allocator(my_malloc, my_free);
+
+    mallocs = 0;
+    const int W = 64, H = 16;
+    Realization r = sq.realize(W, H);
+    Buffer<float> out_re = r[0], out_im = r[1];
+    for (int j = 0; j < H; j++) {
+        for (int i = 0; i < W; i++) {
+            float re = i / 8.0f + 1;
+            float im = ((float)j - i) * (i / 8.0f);
+            float correct_re = re * re - im * im;
+            float correct_im = 2 * re * im;
+            if (out_re(i, j) != correct_re || out_im(i, j) != correct_im) {
+                printf("sq(%d, %d) = (%f, %f) instead of (%f, %f)\n",
+                       i, j, out_re(i, j), out_im(i, j), correct_re, correct_im);
+                return -1;
+            }
+        }
+    }
+
+    int expected = interleave ? 1 : 2;
+    if (mallocs != expected) {
+        printf("%d allocations instead of %d\n", mallocs, expected);
+        return -1;
+    }
+    return 0;
+}
+
+// Blend RGBA pixels stored as four-element tuples.
+int test_rgba(int vector_width) {
+    Var x, y;
+    Func rgba, gray;
+    rgba(x, y) = Tuple(cast<uint8_t>(x), cast<uint8_t>(y),
+                       cast<uint8_t>(x + y), cast<uint8_t>(255 - x));
+    Expr sum = (cast<uint16_t>(rgba(x, y)[0]) + rgba(x, y)[1] + rgba(x, y)[2]) * rgba(x, y)[3];
+    gray(x, y) = cast<uint8_t>(sum / (3 * 255));
+
+    rgba.compute_root().store_tuple_interleaved().vectorize(x, vector_width);
+    gray.vectorize(x, vector_width);
+
+    const int W = 128, H = 8;
+    Buffer<uint8_t> out = gray.realize(W, H);
+    for (int j = 0; j < H; j++) {
+        for (int i = 0; i < W; i++) {
+            uint16_t r = (uint8_t)i, g = (uint8_t)j, b = (uint8_t)(i + j), a = (uint8_t)(255 - i);
+            uint8_t correct = (uint8_t)((uint16_t)((r + g + b) * a) / (3 * 255));
+            if (out(i, j) != correct) {
+                printf("gray(%d, %d) = %d instead of %d\n", i, j, out(i, j), correct);
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    for (int vector_width : {1, 4, 8}) {
+        if (test_complex(false, vector_width) != 0 ||
+            test_complex(true, vector_width) != 0 ||
+            test_rgba(vector_width) != 0) {
+            return -1;
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,99 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+
+int main(int argc, char **argv) {
+    Var x("x"), y("y");
+
+    const int W = 16, H = 13;
+    Buffer<int> in(W, H);
+    for (int y = 0; y < H; y++) {
+        for (int x = 0; x < W; x++) {
+            in(x, y) = (x * 7 + y * 3) % 11 - 5;
+        }
+    }
+
+    // A reduction over a runtime number of columns, unrolled by a
+    // factor that doesn't divide it. The unrolled copies share one
+    // check per group, and the remainder runs in a serial loop.
+    {
+        Param<int> n;
+        RDom r(0, n);
+        Func f("f");
+        f(y) = 0;
+        f(y) += in(r, y) * (r + 1);
+        f.update().unroll(r, 4);
+
+        for (int i = 0; i <= W; i++) {
+            n.set(i);
+            Buffer<int> out = f.realize(H);
+            for (int y = 0; y < H; y++) {
+                int correct = 0;
+                for (int x = 0; x < i; x++) {
+                    correct += in(x, y) * (x + 1);
+                }
+                if (out(y) != correct) {
+                    printf("f(%d) = %d instead of %d with n = %d\n", y, out(y), correct, i);
+                    return -1;
+                }
+            }
+        }
+    }
+
+    // Both dimensions of a tile unrolled with GuardWithIf, over an
+    // output of varying size.
+    {
+        Func g("g");
+        g(x, y) = in(x, y) * 2 + y;
+        Var xi("xi"), yi("yi");
+        g.tile(x, y, xi, yi, 3, 2, TailStrategy::GuardWithIf).unroll(xi).unroll(yi);
+
+        for (int w = 1; w <= W; w += 5) {
+            for (int h = 1; h <= H; h += 4) {
+                Buffer<int> out = g.realize(w, h);
+                for (int y = 0; y < h; y++) {
+                    for (int x = 0; x < w; x++) {
+                        int correct = in(x, y) * 2 + y;
+                        if (out(x, y) != correct) {
+                            printf("g(%d, %d) = %d instead of %d\n", x, y, out(x, y), correct);
+                            return -1;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // A reduction with a predicate that depends on the data, which
+    // stays in each copy.
+    {
+        Param<int> n;
+        RDom r(0, n);
+        r.where(in(r, 0) > 0);
+        Func h("h");
+        h(x) = 0;
+        h(x) += in(r, 0) + x;
+        h.update().unroll(r, 3, TailStrategy::GuardWithIf);
+
+        for (int i = 0; i <= W; i++) {
+            n.set(i);
+            Buffer<int> out = h.realize(4);
+            for (int x = 0; x < 4; x++) {
+                int correct = 0;
+                for (int j = 0; j < i; j++) {
+                    if (in(j, 0) > 0) {
+                        correct += in(j, 0) + x;
+                    }
+                }
+                if (out(x) != correct) {
+                    printf("h(%d) = %d instead of %d with n = %d\n", x, out(x), correct, i);
+                    return -1;
+                }
+            }
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
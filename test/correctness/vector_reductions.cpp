@@ -0,0 +1,121 @@
+#include "Halide.h"
+#include <stdio.h>
+#include <math.h>
+
+using namespace Halide;
+using namespace Halide::Internal;
+
+// Vectorizing the RVar of an atomic update of a single site turns it
+// into vector accumulation plus a horizontal reduction.
+
+// Check that lowering used a horizontal reduction.
+class CheckReduced : public IRMutator {
+public:
+    using IRMutator::mutate;
+
+    Stmt mutate(Stmt s) {
+        class FindReductions : public IRVisitor {
+            using IRVisitor::visit;
+            void visit(const Call *op) {
+                if (op->is_intrinsic(Call::vector_reduce_add) ||
+                    op->is_intrinsic(Call::vector_reduce_min)) {
+                    found = true;
+                }
+                IRVisitor::visit(op);
+            }
+        public:
+            bool found = false;
+        } finder;
+        s.accept(&finder);
+        if (!finder.found) {
+            printf("No horizontal reduction found\n");
+            exit(-1);
+        }
+        return s;
+    }
+};
+
+int main(int argc, char **argv) {
+    const int W = 256, H = 16;
+
+    Buffer<uint8_t> in(W, H);
+    Buffer<float> a(W), b(W);
+    for (int y = 0; y < H; y++) {
+        for (int x = 0; x < W; x++) {
+            in(x, y) = (uint8_t)(rand() & 0xff);
+        }
+    }
+    for (int x = 0; x < W; x++) {
+        a(x) = (rand() % 1000) / 100.0f;
+        b(x) = (rand() % 1000) / 100.0f;
+    }
+
+    Var x("x"), y("y");
+    RDom r(0, W);
+    RVar rxo("rxo"), rxi("rxi");
+
+    {
+        // Row sums of bytes.
+        Func sum("sum");
+        sum(y) = 0;
+        sum(y) += cast<int>(in(r, y));
+        sum.update().atomic().split(r, rxo, rxi, 16).vectorize(rxi).parallel(y);
+        sum.add_custom_lowering_pass(new CheckReduced);
+
+        Buffer<int> out = sum.realize(H);
+        for (int y = 0; y < H; y++) {
+            int correct = 0;
+            for (int x = 0; x < W; x++) {
+                correct += in(x, y);
+            }
+            if (out(y) != correct) {
+                printf("sum(%d) = %d instead of %d\n", y, out(y), correct);
+                return -1;
+            }
+        }
+    }
+
+    {
+        // A dot product. The additions are reassociated, so allow
+        // some rounding error.
+        Func dot("dot");
+        dot() = 0.0f;
+        dot() += a(r) * b(r);
+        dot.update().atomic().split(r, rxo, rxi, 8).vectorize(rxi);
+        dot.add_custom_lowering_pass(new CheckReduced);
+
+        Buffer<float> out = dot.realize();
+        double correct = 0;
+        for (int x = 0; x < W; x++) {
+            correct += (double)a(x) * b(x);
+        }
+        if (fabs(out() - correct) > 1e-3 * correct) {
+            printf("dot = %f instead of %f\n", out(), correct);
+            return -1;
+        }
+    }
+
+    {
+        // Row minimums.
+        Func m("m");
+        m(y) = cast<uint8_t>(255);
+        m(y) = min(m(y), in(r, y));
+        m.update().atomic().split(r, rxo, rxi, 16).vectorize(rxi);
+        m.add_custom_lowering_pass(new CheckReduced);
+
+        Buffer<uint8_t> out = m.realize(H);
+        for (int y = 0; y < H; y++) {
+            int correct = 255;
+            for (int x = 0; x < W; x++) {
+                correct = std::min(correct, (int)in(x, y));
+            }
+            if (out(y) != correct) {
+                printf("m(%d) = %d instead of %d\n", y, out(y), correct);
+                return -1;
+            }
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
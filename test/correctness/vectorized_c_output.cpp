@@ -0,0 +1,49 @@
+#include "Halide.h"
+#include <stdio.h>
+#include <fstream>
+#include <sstream>
+
+using namespace Halide;
+
+// Vectorized code compiled to C should keep its vectors, as GCC/Clang
+// vector extension types, rather than failing or being scalarized.
+
+int main(int argc, char **argv) {
+    ImageParam input(Float(32), 2, "input");
+    Func f("f"), g("g");
+    Var x("x"), y("y");
+
+    f(x, y) = sqrt(input(x, y)) * 2.0f;
+    g(x, y) = select(f(x, y) > 1.0f, f(x, y), f(x * 2, y)) + cast<float>(x & 3);
+    f.compute_root().vectorize(x, 8);
+    g.vectorize(x, 4);
+
+    const char *filename = "vectorized_c_output.cpp";
+    Internal::ensure_no_file_exists(filename);
+    g.compile_to_c(filename, {input}, "vectorized_c_output");
+    Internal::assert_file_exists(filename);
+
+    std::ifstream file(filename);
+    std::stringstream s;
+    s << file.rdbuf();
+    std::string src = s.str();
+
+    // The dense loads and stores, the gather from f at x * 2, and the
+    // select with a vector condition.
+    const char *expected[] = {
+        "halide_vector<float, 8>::type",
+        "halide_vector_load<float, 4>",
+        "halide_vector_store<float, 4>",
+        "halide_vector_gather<float, 4>",
+        "halide_vector_select<float, 4>",
+    };
+    for (const char *e : expected) {
+        if (src.find(e) == std::string::npos) {
+            printf("Didn't find %s in the C output\n", e);
+            return -1;
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,20 @@
+#include <stdio.h>
+#include "Halide.h"
+
+using namespace Halide;
+
+int main(int argc, char **argv) {
+    Func f;
+    Var x;
+    RDom r(0, 100);
+
+    f(x) = 0;
+    // Not associative, so it can't be made atomic.
+    f(r % 10) = f(r % 10) * 2 + r;
+    f.update().atomic().parallel(r);
+
+    f.realize(10);
+
+    printf("Should have gotten an error about atomic updates!\n");
+    return -1;
+}
@@ -0,0 +1,20 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+
+int main(int argc, char **argv) {
+    Func f("f"), g("g");
+    Var x("x"), y("y");
+
+    f(x, y) = x + y;
+    g(x, y) = f(x - 1, y) + f(x + 1, y);
+
+    // g runs on the CPU, so there are no GPU blocks to stage f for.
+    f.in_gpu_shared(g);
+
+    g.realize(16, 16);
+
+    printf("Success!\n");
+    return 0;
+}
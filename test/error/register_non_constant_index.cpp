@@ -0,0 +1,20 @@
+#include <stdio.h>
+#include "Halide.h"
+
+using namespace Halide;
+
+int main(int argc, char **argv) {
+    Var x, y;
+
+    Func f, g;
+
+    g(x, y) = x + y;
+    f(x, y) = g(x, y) + g(x + 1, y);
+    // g has a constant size, but isn't accessed at constant indices.
+    g.compute_at(f, y).bound_extent(x, 17).store_in(MemoryType::Register);
+
+    Buffer<int> im = f.realize(16, 16);
+
+    printf("Should have gotten an error about registers!\n");
+    return -1;
+}
@@ -0,0 +1,20 @@
+#include <stdio.h>
+#include "Halide.h"
+
+using namespace Halide;
+
+int main(int argc, char **argv) {
+    Var x, y;
+
+    Func f, g;
+
+    g(x, y) = x + y;
+    f(x, y) = g(x, y) + g(x + 1, y);
+    // f isn't offloaded to Hexagon, so g can't go in VTCM.
+    g.compute_at(f, y).store_in(MemoryType::VTCM);
+
+    Buffer<int> im = f.realize(16, 16);
+
+    printf("Should have gotten an error about VTCM!\n");
+    return -1;
+}
@@ -0,0 +1,124 @@
+#include "HalideRuntime.h"
+#include "HalideBuffer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "cancellation.h"
+
+using namespace Halide::Runtime;
+
+static int context_a, context_b;
+
+void my_halide_error(void *user_context, const char *msg) {
+    // Silently drop the error
+}
+
+// Count the tasks run, and cancel or fail the pipeline partway
+// through.
+static int tasks_run = 0;
+static int cancel_after = -1;
+static int fail_after = -1;
+
+int my_do_task(void *user_context, halide_task_t f, int idx, uint8_t *closure) {
+    tasks_run++;
+    int result = f(user_context, idx, closure);
+    if (tasks_run == cancel_after) {
+        halide_cancel(user_context);
+    }
+    if (tasks_run == fail_after) {
+        result = -1;
+    }
+    return result;
+}
+
+int main(int argc, char **argv) {
+    halide_set_error_handler(&my_halide_error);
+    halide_set_custom_do_task(&my_do_task);
+    // Run every task on this thread, so that the tasks run in a
+    // predictable order.
+    halide_set_num_threads(1);
+
+    const int W = 16, H = 32;
+    Buffer<int> in(W, H), out(W, H);
+    in.for_each_element([&](int x, int y) {
+        in(x, y) = x + y * W;
+    });
+
+    int result = cancellation(&context_a, in, out);
+    if (result != 0) {
+        printf("Pipeline returned %d before anything was cancelled\n", result);
+        return -1;
+    }
+    out.for_each_element([&](int x, int y) {
+        if (out(x, y) != in(x, y) * 2 + 1) {
+            printf("out(%d, %d) = %d instead of %d\n", x, y, out(x, y), in(x, y) * 2 + 1);
+            exit(-1);
+        }
+    });
+
+    // A cancelled user_context stays cancelled, but doesn't affect
+    // pipelines run with other user_contexts.
+    halide_cancel(&context_a);
+    for (int i = 0; i < 2; i++) {
+        tasks_run = 0;
+        result = cancellation(&context_a, in, out);
+        if (result != halide_error_code_cancelled || tasks_run != 0) {
+            printf("Cancelled pipeline returned %d after running %d tasks\n", result, tasks_run);
+            return -1;
+        }
+    }
+    result = cancellation(&context_b, in, out);
+    if (result != 0) {
+        printf("Pipeline with another user_context returned %d\n", result);
+        return -1;
+    }
+    halide_clear_cancellation(&context_a);
+    result = cancellation(&context_a, in, out);
+    if (result != 0) {
+        printf("Pipeline returned %d after clearing the cancellation\n", result);
+        return -1;
+    }
+
+    // So does one that has passed its deadline.
+    halide_set_deadline(&context_a, -1);
+    result = cancellation(&context_a, in, out);
+    if (result != halide_error_code_cancelled) {
+        printf("Pipeline returned %d after its deadline\n", result);
+        return -1;
+    }
+    halide_clear_cancellation(&context_a);
+    halide_set_deadline(&context_a, 60 * 1000000000LL);
+    result = cancellation(&context_a, in, out);
+    if (result != 0) {
+        printf("Pipeline returned %d before its deadline\n", result);
+        return -1;
+    }
+    halide_clear_cancellation(&context_a);
+
+    // Cancelling a running pipeline abandons the tasks that haven't
+    // started yet.
+    tasks_run = 0;
+    cancel_after = 3;
+    result = cancellation(&context_a, in, out);
+    if (result != halide_error_code_cancelled || tasks_run != 3) {
+        printf("Pipeline cancelled partway through returned %d after running %d tasks\n",
+               result, tasks_run);
+        return -1;
+    }
+    cancel_after = -1;
+    halide_clear_cancellation(&context_a);
+
+    // So does a failing task.
+    tasks_run = 0;
+    fail_after = 3;
+    result = cancellation(&context_a, in, out);
+    if (result != -1 || tasks_run != 3) {
+        printf("Pipeline with a failing task returned %d after running %d tasks\n",
+               result, tasks_run);
+        return -1;
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,26 @@
+#include "Halide.h"
+
+namespace {
+
+class Cancellation : public Halide::Generator<Cancellation> {
+public:
+    ImageParam input{ Int(32), 2, "input" };
+
+    Func build() {
+        Var x, y;
+
+        Func f;
+        f(x, y) = input(x, y) * 2;
+        f.compute_root().parallel(y);
+
+        Func g;
+        g(x, y) = f(x, y) + 1;
+        g.parallel(y);
+
+        return g;
+    }
+};
+
+Halide::RegisterGenerator<Cancellation> register_my_gen{"cancellation"};
+
+}  // namespace
@@ -726,6 +726,33 @@ void check_metadata(const halide_filter_metadata_t &md, bool expect_ucon_at_0) {
     }
 }
 
+const halide_filter_func_metadata_t *find_func(const halide_filter_metadata_t &md, const char *name) {
+    for (int i = 0; i < md.num_funcs; ++i) {
+        if (!strcmp(md.funcs[i].name, name)) {
+            return &md.funcs[i];
+        }
+    }
+    fprintf(stderr, "No metadata for Func %s\n", name);
+    exit(-1);
+    return nullptr;
+}
+
+void check_func_metadata(const halide_filter_metadata_t &md) {
+    EXPECT_EQ(1, md.version);
+
+    // typed_output_buffer loads a uint8 from each of input and the two
+    // array_inputs, and stores a float.
+    const halide_filter_func_metadata_t *f = find_func(md, "typed_output_buffer");
+    EXPECT_EQ(3, f->bytes_loaded);
+    EXPECT_EQ(4, f->bytes_stored);
+
+    // output_scalar stores a constant.
+    f = find_func(md, "output_scalar");
+    EXPECT_EQ(0, f->bytes_loaded);
+    EXPECT_EQ(4, f->bytes_stored);
+    EXPECT_EQ(0, f->ops);
+}
+
 int main(int argc, char **argv) {
     void* user_context = nullptr;
 
@@ -824,6 +851,7 @@ int main(int argc, char **argv) {
     verify(input, output0, output1, output_scalar, output_array[0], output_array[1]);
 
     check_metadata(*metadata_tester_metadata(), false);
+    check_func_metadata(*metadata_tester_metadata());
     if (!strcmp(metadata_tester_metadata()->name, "metadata_tester_metadata")) {
         fprintf(stderr, "Expected name %s\n", "metadata_tester_metadata");
         exit(-1);
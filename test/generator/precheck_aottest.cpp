@@ -0,0 +1,86 @@
+#include "HalideRuntime.h"
+#include "HalideBuffer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "precheck.h"
+
+using namespace Halide::Runtime;
+
+void my_halide_error(void *user_context, const char *msg) {
+    // Silently drop the error
+}
+
+int main(int argc, char **argv) {
+    halide_set_error_handler(&my_halide_error);
+
+    const int W = 64, H = 8;
+    Buffer<int> in(W + 1, H), out(W, H);
+    in.for_each_element([&](int x, int y) {
+        in(x, y) = x + y * 1000;
+    });
+
+    // The precheck should reject an input that is too small...
+    Buffer<int> small_in = in.cropped(0, 0, W);
+    int result = precheck_precheck(small_in, 3, out);
+    if (result != halide_error_code_access_out_of_bounds) {
+        printf("precheck returned %d for an input that is too small\n", result);
+        return -1;
+    }
+
+    // ...or a bad scalar parameter...
+    result = precheck_precheck(in, 200, out);
+    if (result != halide_error_code_param_too_large) {
+        printf("precheck returned %d for an out-of-range parameter\n", result);
+        return -1;
+    }
+
+    // ...and accept the real one, without touching the output.
+    out.fill(-1);
+    result = precheck_precheck(in, 3, out);
+    if (result != 0) {
+        printf("precheck returned %d for valid arguments\n", result);
+        return -1;
+    }
+    out.for_each_value([&](int v) {
+        if (v != -1) {
+            printf("precheck wrote to the output\n");
+            exit(-1);
+        }
+    });
+
+    // Once the shapes have been checked, we can call the entry point
+    // that doesn't check them many times.
+    for (int i = 0; i < 10; i++) {
+        result = precheck_prechecked(in, i, out);
+        if (result != 0) {
+            printf("prechecked returned %d\n", result);
+            return -1;
+        }
+        out.for_each_element([&](int x, int y) {
+            int correct = in(x + 1, y) + i;
+            if (out(x, y) != correct) {
+                printf("out(%d, %d) = %d instead of %d\n", x, y, out(x, y), correct);
+                exit(-1);
+            }
+        });
+    }
+
+    // It still checks scalar parameters.
+    result = precheck_prechecked(in, -1, out);
+    if (result != halide_error_code_param_too_small) {
+        printf("prechecked returned %d for an out-of-range parameter\n", result);
+        return -1;
+    }
+
+    // The ordinary entry point is unchanged.
+    result = precheck(small_in, 3, out);
+    if (result != halide_error_code_access_out_of_bounds) {
+        printf("precheck returned %d for an input that is too small\n", result);
+        return -1;
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,23 @@
+#include "Halide.h"
+
+namespace {
+
+class Precheck : public Halide::Generator<Precheck> {
+public:
+    ImageParam input { Int(32), 2, "input" };
+    Param<int> offset {"offset", 0, 0, 100};
+
+    Func build() {
+        Func f;
+        Var x, y;
+
+        f(x, y) = input(x + 1, y) + offset;
+        f.vectorize(x, 8);
+
+        return f;
+    }
+};
+
+Halide::RegisterGenerator<Precheck> register_my_gen{"precheck"};
+
+}  // namespace
@@ -0,0 +1,114 @@
+#include <stdio.h>
+#include <string.h>
+#include <string>
+
+#include "HalideRuntime.h"
+#include "HalideBuffer.h"
+#include "profiler_report.h"
+
+using namespace Halide::Runtime;
+
+std::string format_report(halide_profiler_report_format_t format) {
+    int size = halide_profiler_format_report(nullptr, format, nullptr, 0);
+    if (size <= 0) {
+        return "";
+    }
+    std::string result(size + 1, 0);
+    int written = halide_profiler_format_report(nullptr, format, &result[0], result.size());
+    if (written != size || (int)strlen(result.c_str()) != size) {
+        printf("Reported length %d doesn't match length %d\n", written, size);
+        return "";
+    }
+    result.resize(size);
+    return result;
+}
+
+bool contains(const std::string &s, const char *substr) {
+    if (s.find(substr) == std::string::npos) {
+        printf("Report doesn't contain %s:\n%s\n", substr, s.c_str());
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    // Pipelines of a few milliseconds need more than one sample per
+    // millisecond to be profiled usefully.
+    halide_profiler_state *state = halide_profiler_get_state();
+    state->sleep_time_us = 100;
+
+    Buffer<float> output(256, 256);
+    for (int i = 0; i < 20; i++) {
+        profiler_report(50, output);
+    }
+
+    halide_profiler_pipeline_stats *p = halide_profiler_get_pipeline_state("profiler_report");
+    if (!p) {
+        printf("No stats for the pipeline\n");
+        return -1;
+    }
+    uint64_t ms = p->time / 1000000;
+    if ((uint64_t)p->samples <= ms) {
+        printf("Only %d samples in %d ms\n", p->samples, (int)ms);
+        return -1;
+    }
+
+    // waves is the only heap allocation, so it sets the peak of the
+    // process, and each run allocates and frees it once.
+    const uint64_t waves_bytes = 257 * 257 * sizeof(float);
+    if (state->memory_peak != waves_bytes || state->memory_peak_pipeline != p ||
+        state->memory_current != 0) {
+        printf("Peak heap usage of all pipelines was %d instead of %d\n",
+               (int)state->memory_peak, (int)waves_bytes);
+        return -1;
+    }
+    for (int i = 0; i < p->num_funcs; i++) {
+        const halide_profiler_func_stats &fs = p->funcs[i];
+        uint64_t expected = strcmp(fs.name, "waves") == 0 ? waves_bytes : 0;
+        if (fs.memory_at_peak != expected) {
+            printf("%s had %d bytes at the peak instead of %d\n",
+                   fs.name, (int)fs.memory_at_peak, (int)expected);
+            return -1;
+        }
+    }
+    if (p->num_memory_events != 2 ||
+        p->memory_events[0].is_free || p->memory_events[0].bytes != waves_bytes ||
+        p->memory_events[0].memory_current != waves_bytes ||
+        !p->memory_events[1].is_free || p->memory_events[1].memory_current != 0 ||
+        p->memory_events[1].time < p->memory_events[0].time ||
+        strcmp(p->funcs[p->memory_events[0].func].name, "waves") != 0) {
+        printf("Bad memory timeline with %d events\n", p->num_memory_events);
+        return -1;
+    }
+
+    std::string json = format_report(halide_profiler_report_json);
+    if (!contains(json, "{\"pipelines\": [") ||
+        !contains(json, "\"name\": \"profiler_report\"") ||
+        !contains(json, "\"runs\": 20") ||
+        !contains(json, "\"name\": \"waves\"") ||
+        !contains(json, "\"name\": \"blur\"") ||
+        !contains(json, "\"memory_at_peak\": 264196") ||
+        !contains(json, "\"memory_peak\": {\"bytes\": 264196, \"pipeline\": \"profiler_report\"")) {
+        return -1;
+    }
+
+    std::string trace = format_report(halide_profiler_report_chrome_trace);
+    if (!contains(trace, "\"traceEvents\": [") ||
+        !contains(trace, "\"name\": \"waves\", \"cat\": \"func\", \"ph\": \"X\"") ||
+        !contains(trace, "\"name\": \"profiler_report funcs\"") ||
+        !contains(trace, "\"name\": \"profiler_report memory\", \"ph\": \"C\"")) {
+        return -1;
+    }
+
+    // A report that doesn't fit is truncated, but still terminated.
+    char small[16];
+    int size = halide_profiler_format_report(nullptr, halide_profiler_report_json, small, sizeof(small));
+    if (size != (int)json.size() || strlen(small) != sizeof(small) - 1 ||
+        json.compare(0, sizeof(small) - 1, small) != 0) {
+        printf("Truncated report is wrong: %s\n", small);
+        return -1;
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,30 @@
+#include "Halide.h"
+
+using namespace Halide;
+
+namespace {
+
+class ProfilerReport : public Generator<ProfilerReport> {
+public:
+    Param<int> iters{"iters"};
+
+    Func build() {
+        target.set(get_target().with_feature(Target::Profile));
+
+        Var x, y;
+        Func waves("waves"), blur("blur");
+
+        RDom r(0, iters);
+        waves(x, y) = 0.0f;
+        waves(x, y) = sin(waves(x, y) + cast<float>(x + y + r));
+
+        blur(x, y) = (waves(x, y) + waves(x + 1, y) + waves(x, y + 1)) / 3.0f;
+
+        waves.compute_root();
+        return blur;
+    }
+};
+
+RegisterGenerator<ProfilerReport> register_my_gen{"profiler_report"};
+
+}  // namespace
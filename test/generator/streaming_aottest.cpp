@@ -0,0 +1,75 @@
+#include <stdio.h>
+
+#include "HalideBuffer.h"
+#include "halide_streaming.h"
+#include "streaming.h"
+
+using namespace Halide::Runtime;
+using namespace Halide::Tools;
+
+int main(int argc, char **argv) {
+    const int W = 300, H = 200;
+
+    Buffer<uint16_t> input(W, H);
+    input.for_each_element([&](int x, int y) {
+        input(x, y) = (x * 17 + y * 31) % 1000;
+    });
+
+    Buffer<uint16_t> correct(W, H);
+    if (streaming(input, correct) != 0) {
+        printf("streaming failed\n");
+        return -1;
+    }
+
+    // Compute the same output in tiles that don't divide the image,
+    // reading each tile's input from the full input.
+    Buffer<uint16_t> output(W, H);
+    output.fill(0);
+    int tiles_read = 0, tiles_written = 0;
+    int result = stream_tiles<uint16_t, uint16_t>(
+        [&](Buffer<uint16_t> &in, Buffer<uint16_t> &out) {
+            return streaming(in, out);
+        },
+        {W, H}, {W, H}, 64, 48,
+        [&](Buffer<uint16_t> &in) {
+            // The repeat_edge boundary condition should keep the region
+            // required within the image.
+            for (int i = 0; i < 2; i++) {
+                if (in.dim(i).min() < 0 || in.dim(i).max() >= input.dim(i).extent()) {
+                    printf("Tile input outside the image in dimension %d: [%d, %d]\n",
+                           i, in.dim(i).min(), in.dim(i).max());
+                    return false;
+                }
+            }
+            in.copy_from(input);
+            tiles_read++;
+            return true;
+        },
+        [&](const Buffer<uint16_t> &out) {
+            output.copy_from(out);
+            tiles_written++;
+            return true;
+        });
+    if (result != 0) {
+        printf("stream_tiles failed: %d\n", result);
+        return -1;
+    }
+
+    const int tiles = ((W + 63) / 64) * ((H + 47) / 48);
+    if (tiles_read != tiles || tiles_written != tiles) {
+        printf("Read %d and wrote %d tiles instead of %d\n", tiles_read, tiles_written, tiles);
+        return -1;
+    }
+
+    for (int y = 0; y < H; y++) {
+        for (int x = 0; x < W; x++) {
+            if (output(x, y) != correct(x, y)) {
+                printf("output(%d, %d) = %d instead of %d\n", x, y, output(x, y), correct(x, y));
+                return -1;
+            }
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
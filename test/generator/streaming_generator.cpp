@@ -0,0 +1,28 @@
+#include "Halide.h"
+
+namespace {
+
+class Streaming : public Halide::Generator<Streaming> {
+public:
+    ImageParam input{ UInt(16), 2, "input" };
+
+    Func build() {
+        Var x, y;
+
+        Func clamped = Halide::BoundaryConditions::repeat_edge(input);
+
+        Func blur_x;
+        blur_x(x, y) = (clamped(x - 2, y) + clamped(x, y) + clamped(x + 2, y)) / 3;
+        blur_x.compute_root();
+
+        Func blur_y;
+        blur_y(x, y) = (blur_x(x, y - 2) + blur_x(x, y) + blur_x(x, y + 2)) / 3;
+        blur_y.parallel(y);
+
+        return blur_y;
+    }
+};
+
+Halide::RegisterGenerator<Streaming> register_my_gen{"streaming"};
+
+}  // namespace
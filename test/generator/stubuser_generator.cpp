@@ -52,21 +52,26 @@ public:
         calculated_output(x, y, c) = cast<uint8_t>(stub.tuple_output(x, y, c)[1] + kOffset);
 
         // Stub outputs that are Output<Buffer> (rather than Output<Func>)
-        // can really only be assigned to another Output<Buffer>; this is 
-        // nevertheless useful, as we can still set stride (etc) constraints
-        // on the Output.
+        // can be assigned to another Output<Buffer>; this is useful,
+        // as we can still set stride (etc) constraints on the Output.
         float32_buffer_output = stub.typed_buffer_output;
-        int32_buffer_output = stub.untyped_buffer_output;
+
+        // They can also be explicitly converted to ordinary Funcs, which
+        // fuses them into this pipeline instead of materializing them.
+        untyped_buffer_output = Func(stub.untyped_buffer_output);
+        int32_buffer_output(x, y, c) = untyped_buffer_output(x, y, c);
     }
 
     void schedule() {
         const bool vectorize = true;
         stub.schedule({ vectorize, LoopLevel(calculated_output, Var("y")) });
+        untyped_buffer_output.compute_at(int32_buffer_output, y);
     }
 
 private:
     Var x{"x"}, y{"y"}, c{"c"};
     StubTest stub;
+    Func untyped_buffer_output;
 };
 
 // Note that HALIDE_REGISTER_GENERATOR() with just two args is functionally
@@ -4,6 +4,10 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <algorithm>
+#include <cmath>
+#include <vector>
+#include <atomic>
+#include <thread>
 
 #include "variable_num_threads.h"
 
@@ -12,6 +16,16 @@ int max_threads = 1;
 
 using namespace Halide::Runtime;
 
+std::atomic<int> async_calls_completed(0);
+std::atomic<int> async_calls_failed(0);
+
+void async_done(void *context, int result) {
+    if (result != 0 || context != &async_calls_completed) {
+        async_calls_failed++;
+    }
+    async_calls_completed++;
+}
+
 void mess_with_num_threads(void *) {
     while (!stop) {
         halide_set_num_threads((rand() % max_threads) + 1);
@@ -45,6 +59,112 @@ int main(int argc, char **argv) {
     stop = true;
     halide_join_thread(t);
 
+    // Run some back-to-back pipelines with spinning enabled, and
+    // check that the wait statistics can be read and reset.
+    halide_set_num_threads(4);
+    halide_set_thread_pool_spin_count(1000);
+    halide_reset_thread_pool_stats();
+    for (int i = 0; i < 100; i++) {
+        int ret = variable_num_threads(out);
+        if (ret) {
+            printf("Non zero exit code: %d\n", ret);
+            return -1;
+        }
+    }
+    halide_thread_pool_stats_t stats;
+    halide_get_thread_pool_stats(&stats);
+    printf("Spin wakeups: %llu, sleep wakeups: %llu, wait time: %llu ns\n",
+           (unsigned long long)stats.spin_wakeups,
+           (unsigned long long)stats.sleep_wakeups,
+           (unsigned long long)stats.wait_ns);
+    halide_reset_thread_pool_stats();
+    halide_get_thread_pool_stats(&stats);
+    if (stats.spin_wakeups || stats.sleep_wakeups || stats.wait_ns) {
+        printf("Thread pool stats were not reset\n");
+        return -1;
+    }
+    halide_set_thread_pool_spin_count(-1);
+
+    // Cap the number of workers per parallel loop. This pipeline has
+    // no user_context argument, so it runs with a NULL user_context.
+    if (halide_set_thread_pool_priority(NULL, 1, 2) != 0) {
+        printf("halide_set_thread_pool_priority failed\n");
+        return -1;
+    }
+    for (int i = 0; i < 100; i++) {
+        int ret = variable_num_threads(out);
+        if (ret) {
+            printf("Non zero exit code: %d\n", ret);
+            return -1;
+        }
+    }
+    halide_set_thread_pool_priority(NULL, 0, 0);
+
+    // Launch a bunch of asynchronous invocations at once, and wait for
+    // all of them to complete.
+    const int num_async_calls = 16;
+    std::vector<Buffer<float>> async_outs;
+    std::vector<void *> async_args;
+    for (int i = 0; i < num_async_calls; i++) {
+        async_outs.emplace_back(64, 64);
+    }
+    for (int i = 0; i < num_async_calls; i++) {
+        async_args.push_back(async_outs[i].raw_buffer());
+    }
+    for (int i = 0; i < num_async_calls; i++) {
+        int ret = variable_num_threads_async(&async_args[i], async_done, &async_calls_completed);
+        if (ret) {
+            printf("Non zero exit code from async launch: %d\n", ret);
+            return -1;
+        }
+    }
+    while (async_calls_completed < num_async_calls) {
+        std::this_thread::yield();
+    }
+    if (async_calls_failed) {
+        printf("%d asynchronous calls failed\n", (int)async_calls_failed);
+        return -1;
+    }
+
+    // Run a batch of calls on small outputs as a single parallel loop.
+    const int batch_size = 100;
+    std::vector<Buffer<float>> batch_outs;
+    std::vector<void *> batch_buffers;
+    std::vector<void **> batch_args;
+    std::vector<int> batch_results(batch_size, -1);
+    for (int i = 0; i < batch_size; i++) {
+        batch_outs.emplace_back(16, 16);
+        batch_outs.back().fill(0.0f);
+    }
+    for (int i = 0; i < batch_size; i++) {
+        batch_buffers.push_back(batch_outs[i].raw_buffer());
+    }
+    for (int i = 0; i < batch_size; i++) {
+        batch_args.push_back(&batch_buffers[i]);
+    }
+    int ret = variable_num_threads_batch(NULL, batch_args.data(), batch_size, batch_results.data());
+    if (ret) {
+        printf("Non zero exit code from batch: %d\n", ret);
+        return -1;
+    }
+    for (int i = 0; i < batch_size; i++) {
+        if (batch_results[i] != 0) {
+            printf("Batch call %d returned %d\n", i, batch_results[i]);
+            return -1;
+        }
+        int errors = 0;
+        batch_outs[i].for_each_element([&](int x, int y) {
+            float correct = std::sqrt(std::sqrt((float)(x * y)));
+            if (std::abs(batch_outs[i](x, y) - correct) > 1e-5f) {
+                errors++;
+            }
+        });
+        if (errors) {
+            printf("Batch call %d computed the wrong result\n", i);
+            return -1;
+        }
+    }
+
     printf("Success\n");
     return 0;
 }
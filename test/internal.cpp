@@ -1,4 +1,5 @@
 #include "IR.h"
+#include "IRArena.h"
 #include "IRPrinter.h"
 #include "CodeGen_X86.h"
 #include "CodeGen_C.h"
@@ -17,6 +18,10 @@
 #include "Interval.h"
 #include "Associativity.h"
 #include "Generator.h"
+#include "InvariantDivision.h"
+#include "ShareAllocations.h"
+#include "RewriteRules.h"
+#include "FixedPointIntrinsics.h"
 
 using namespace Halide;
 using namespace Halide::Internal;
@@ -25,8 +30,10 @@ int main(int argc, const char **argv) {
     IRPrinter::test();
     CodeGen_C::test();
     ir_equality_test();
+    ir_arena_test();
     bounds_test();
     expr_match_test();
+    rewrite_rules_test();
     deinterleave_vector_test();
     modulus_remainder_test();
     cse_test();
@@ -39,6 +46,9 @@ int main(int argc, const char **argv) {
     interval_test();
     associativity_test();
     generator_test();
+    invariant_division_test();
+    share_allocations_test();
+    fixed_point_intrinsics_test();
 
     return 0;
 }
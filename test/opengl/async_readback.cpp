@@ -0,0 +1,44 @@
+#include "Halide.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace Halide;
+
+int main() {
+    // This test must be run with an OpenGL target.
+    const Target target = get_jit_target_from_environment().with_feature(Target::OpenGL);
+
+    Func gpu("gpu");
+    Var x, y, c;
+    Param<uint8_t> k;
+
+    gpu(x, y, c) = cast<uint8_t>(select(c == 0, 10*x + y,
+                                        c == 1, k,
+                                        12));
+    gpu.bound(c, 0, 3);
+    gpu.glsl(x, y, c);
+
+    // Realize into the same buffer repeatedly. After the first copy
+    // back to the host, the readback of the texture should be started
+    // by the kernel, and each frame should still see its own output.
+    Buffer<uint8_t> out(10, 10, 3);
+    for (int frame = 0; frame < 4; frame++) {
+        k.set(frame * 20);
+        gpu.realize(out, target);
+        out.copy_to_host();
+
+        for (int y=0; y<out.height(); y++) {
+            for (int x=0; x<out.width(); x++) {
+                if (!(out(x, y, 0) == 10*x+y && out(x, y, 1) == frame * 20 && out(x, y, 2) == 12)) {
+                    fprintf(stderr, "Incorrect pixel (%d, %d, %d) at x=%d y=%d in frame %d.\n",
+                            out(x, y, 0), out(x, y, 1), out(x, y, 2),
+                            x, y, frame);
+                    return 1;
+                }
+            }
+        }
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -322,6 +322,54 @@ int main() {
     }
     fprintf(stderr, "Passed!\n");
 
+    // The min or max of linear expressions is piecewise linear. These are
+    // evaluated with extra vertices at the breakpoints between the pieces, in
+    // any order, which the interpolated values must respect.
+    fprintf(stderr, "Test f4\n");
+
+    Func f4("f4");
+    f4(x, y, c) = select(c == 0, cast<float>(clamp(x * 2 - 3, 0, 9)),
+                         c == 1, min(y * 0.5f + p, 10.0f),
+                         max(5.0f - x, y - 2.0f));
+
+    f4.bound(c, 0, 3);
+    f4.glsl(x, y, c);
+
+    Buffer<float> out4(8, 8, 3);
+
+    // Run the test
+    f4.realize(out4, target);
+
+    // Check for correct result values
+    out4.copy_to_host();
+
+    for (int c=0; c != out4.extent(2); ++c) {
+        for (int y=0; y != out4.extent(1); ++y) {
+            for (int x=0; x != out4.extent(0); ++x) {
+                float expected;
+                switch (c) {
+                    case 0:
+                        expected = (float)std::min(std::max(x * 2 - 3, 0), 9);
+                        break;
+                    case 1:
+                        expected = std::min(y * 0.5f + p_value, 10.0f);
+                        break;
+                    default:
+                        expected = std::max(5.0f - x, y - 2.0f);
+
+                }
+                float result = out4(x, y, c);
+
+                if (fabs(result-expected) > 0.00001f) {
+                    fprintf(stderr, "Incorrect value: %f != %f at %d,%d,%d.\n",
+                            result, expected, x, y, c);
+                    return 1;
+                }
+            }
+        }
+    }
+    fprintf(stderr, "Passed!\n");
+
     // The test will return early on error.
     fprintf(stderr, "Success!\n");
 
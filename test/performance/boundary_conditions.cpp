@@ -13,6 +13,10 @@ Target target;
 struct Test {
     const char *name;
     Func f;
+
+    // The median time of the benchmark, in seconds. The median is
+    // compared between tests, because it is much less noisy than the
+    // best time.
     double time;
 
     // Test a small stencil
@@ -29,13 +33,13 @@ struct Test {
 
         Buffer<float> out = g.realize(W, H);
 
-        // best of 10 x 5 runs.
-        time = benchmark(10, 5, [&]() {
+        Tools::BenchmarkResult result = benchmark([&]() {
                 g.realize(out);
                 out.device_sync();
         });
+        time = result.median;
 
-        printf("%-20s: %f us\n", name, time * 1e6);
+        Tools::benchmark_report(std::string("boundary_conditions_stencil_") + name, result);
     }
 
     // Test a larger stencil using an RDom
@@ -55,13 +59,13 @@ struct Test {
 
         Buffer<float> out = g.realize(W, H);
 
-        // best of 3 x 3 runs.
-        time = benchmark(3, 3, [&]() {
+        Tools::BenchmarkResult result = benchmark([&]() {
                 g.realize(out);
                 out.device_sync();
         });
+        time = result.median;
 
-        printf("%-20s: %f us\n", name, time * 1e6);
+        Tools::benchmark_report(std::string("boundary_conditions_rdom_") + name, result);
     }
 };
 
@@ -0,0 +1,74 @@
+#include "Halide.h"
+#include <stdio.h>
+#include <string.h>
+
+using namespace Halide;
+
+// With profile_counters, the profiler report should include hardware
+// counters per Func, which should tell a Func that misses in the
+// cache all the time from one that never touches memory.
+
+float memory_bound_mpki = -1, compute_bound_mpki = -1;
+void my_print(void *, const char *msg) {
+    float *mpki = NULL;
+    if (strstr(msg, "  memory_bound: ") == msg) {
+        mpki = &memory_bound_mpki;
+    } else if (strstr(msg, "  compute_bound: ") == msg) {
+        mpki = &compute_bound_mpki;
+    }
+    const char *counters = strstr(msg, " mpki: ");
+    if (mpki && counters) {
+        sscanf(counters, " mpki: %f", mpki);
+    }
+}
+
+int main(int argc, char **argv) {
+    Target t = get_jit_target_from_environment();
+    if (t.os != Target::Linux || t.arch != Target::X86) {
+        printf("Hardware counters are only read on x86 Linux. Skipping test.\n");
+        return 0;
+    }
+    t = t.with_feature(Target::Profile).with_feature(Target::ProfileCounters);
+
+    const int N = 4096;
+    Buffer<float> in(N, N);
+    in.fill(1.0f);
+
+    Var x, y;
+    Func memory_bound("memory_bound"), compute_bound("compute_bound"), out("out");
+
+    // Read the input transposed, so that every access is to a
+    // different cache line.
+    memory_bound(x, y) = in(y, x);
+
+    Expr e = cast<float>(x + y);
+    for (int i = 0; i < 50; i++) {
+        e = sin(e);
+    }
+    compute_bound(x, y) = e;
+
+    out(x, y) = memory_bound(x, y) + compute_bound(x % 512, y % 512);
+    memory_bound.compute_root();
+    compute_bound.compute_root().bound(x, 0, 512).bound(y, 0, 512);
+    out.set_custom_print(&my_print);
+
+    out.realize(N, N, t);
+
+    if (memory_bound_mpki < 0 || compute_bound_mpki < 0) {
+        // perf_event_open is often forbidden in containers, and not
+        // all virtual machines expose the PMU.
+        printf("No hardware counters in the profiler report. Skipping test.\n");
+        return 0;
+    }
+
+    printf("llc misses per 1000 instructions: memory_bound: %f, compute_bound: %f\n",
+           memory_bound_mpki, compute_bound_mpki);
+
+    if (memory_bound_mpki <= compute_bound_mpki) {
+        printf("The memory bound Func should miss in the cache more often\n");
+        return -1;
+    }
+
+    printf("Success!\n");
+    return 0;
+}
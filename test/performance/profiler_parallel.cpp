@@ -0,0 +1,55 @@
+#include "Halide.h"
+#include <stdio.h>
+
+using namespace Halide;
+
+// The profiler should attribute time in parallel loops to the Func
+// each worker is actually computing. Here an expensive Func and a
+// cheap one are computed per row inside a parallel loop, so the
+// workers are nearly always all inside the expensive one.
+
+int expensive_percentage = -1, cheap_percentage = -1;
+void my_print(void *, const char *msg) {
+    float ms;
+    int percentage;
+    if (sscanf(msg, " expensive: %fms (%d", &ms, &percentage) == 2) {
+        expensive_percentage = percentage;
+    } else if (sscanf(msg, " cheap: %fms (%d", &ms, &percentage) == 2) {
+        cheap_percentage = percentage;
+    }
+}
+
+int main(int argc, char **argv) {
+    Var x, y;
+    Func expensive("expensive"), cheap("cheap"), out("out");
+
+    Expr e = cast<float>(x + y);
+    for (int i = 0; i < 200; i++) {
+        e = sin(e);
+    }
+    expensive(x, y) = e;
+    cheap(x, y) = expensive(x, y) + 1.0f;
+    out(x, y) = cheap(x, y) * 2.0f;
+
+    out.parallel(y).set_custom_print(&my_print);
+    expensive.compute_at(out, y);
+    cheap.compute_at(out, y);
+
+    Target t = get_jit_target_from_environment().with_feature(Target::Profile);
+    out.realize(1000, 1000, t);
+
+    printf("expensive: %d%%, cheap: %d%%\n", expensive_percentage, cheap_percentage);
+
+    if (expensive_percentage < 0 || cheap_percentage < 0) {
+        printf("Didn't find the profiler report for both Funcs\n");
+        return -1;
+    }
+
+    if (expensive_percentage < 80 || cheap_percentage > 10) {
+        printf("Time in the parallel loop was mis-attributed between Funcs\n");
+        return -1;
+    }
+
+    printf("Success!\n");
+    return 0;
+}
@@ -0,0 +1,119 @@
+#include "Halide.h"
+#include "benchmark.h"
+#include <stdio.h>
+#include <algorithm>
+#include <stdlib.h>
+#include <string>
+
+using namespace Halide;
+
+// Measures the peak memory bandwidth and arithmetic throughput of the
+// machine, and then profiles a pipeline against them, so that the
+// profiler report shows how close each of its Funcs gets to the
+// throughput attainable at its arithmetic intensity.
+
+std::string report;
+void my_print(void *, const char *msg) {
+    report += msg;
+}
+
+// The value after key on the report line of the given Func, or an empty
+// string.
+std::string report_field(const std::string &func, const std::string &key) {
+    size_t line = report.find("  " + func + ": ");
+    if (line == std::string::npos) {
+        return "";
+    }
+    size_t end = report.find('\n', line);
+    size_t field = report.find(key, line);
+    if (field == std::string::npos || field > end) {
+        return "";
+    }
+    field += key.size();
+    size_t field_end = report.find_first_of(" \n", field);
+    return report.substr(field, field_end - field);
+}
+
+int main(int argc, char **argv) {
+#ifdef _WIN32
+    printf("Skipping test because it uses setenv\n");
+    return 0;
+#else
+    Target t = get_jit_target_from_environment();
+    Var x("x"), xo("xo"), xi("xi"), y("y"), yi("yi");
+
+    // Peak bandwidth: stream a buffer much larger than the caches
+    // through all the cores.
+    const int stream_size = 1 << 24;
+    Buffer<float> stream_in(stream_size), stream_out(stream_size);
+    stream_in.fill(1.0f);
+    Func stream("stream");
+    stream(x) = stream_in(x);
+    stream.split(x, xo, xi, 1 << 16).parallel(xo).vectorize(xi, 8);
+    stream.compile_jit(t);
+    double stream_time = benchmark(10, 10, [&]() {
+        stream.realize(stream_out);
+    });
+    double peak_bytes_per_ns = 2.0 * sizeof(float) * stream_size / (stream_time * 1e9);
+
+    // Peak arithmetic throughput: a long chain of multiply-adds in
+    // registers, with several vectors in flight on each core to hide
+    // the latency.
+    const int chain = 64;
+    const int compute_size = 1 << 20;
+    const int vector_size = t.natural_vector_size<float>();
+    Buffer<float> compute_out(compute_size);
+    Func compute("compute");
+    Expr v = cast<float>(x);
+    for (int i = 0; i < chain; i++) {
+        v = v * 0.999f + 0.001f;
+    }
+    compute(x) = v;
+    compute.split(x, xo, xi, vector_size * 4).parallel(xo).vectorize(xi);
+    compute.compile_jit(t);
+    double compute_time = benchmark(10, 10, [&]() {
+        compute.realize(compute_out);
+    });
+    double peak_ops_per_ns = 2.0 * chain * compute_size / (compute_time * 1e9);
+
+    printf("Peak bandwidth: %.2f GB/s\n"
+           "Peak arithmetic throughput: %.2f Gop/s\n",
+           peak_bytes_per_ns, peak_ops_per_ns);
+
+    // The runtime reads the peaks from the environment when it makes
+    // the report.
+    setenv("HL_PEAK_BANDWIDTH", std::to_string(std::max(1, (int)peak_bytes_per_ns)).c_str(), 1);
+    setenv("HL_PEAK_OPS", std::to_string(std::max(1, (int)peak_ops_per_ns)).c_str(), 1);
+
+    // A bandwidth-bound blur, profiled against the peaks. It runs on
+    // one core, so that each Func runs long enough for the sampling
+    // profiler to time it.
+    Buffer<float> img(4096, 2048);
+    img.fill(1.0f);
+    Func blur_x("blur_x"), blur_y("blur_y");
+    blur_x(x, y) = (img(x, y) + img(x + 1, y) + img(x + 2, y)) / 3;
+    blur_y(x, y) = (blur_x(x, y) + blur_x(x, y + 1) + blur_x(x, y + 2)) / 3;
+    blur_y.split(y, y, yi, 32).vectorize(x, 8);
+    blur_x.store_at(blur_y, y).compute_at(blur_y, yi).vectorize(x, 8);
+    blur_y.set_custom_print(my_print);
+    blur_y.realize(img.width() - 2, img.height() - 2, t.with_feature(Target::Profile));
+
+    printf("%s", report.c_str());
+
+    unsetenv("HL_PEAK_BANDWIDTH");
+    unsetenv("HL_PEAK_OPS");
+
+    for (const char *f : {"blur_x", "blur_y"}) {
+        std::string bandwidth = report_field(f, "GB/s: ");
+        std::string roofline = report_field(f, "roofline: ");
+        if (bandwidth.empty() || roofline.empty()) {
+            printf("The report doesn't show the throughput of %s\n", f);
+            return -1;
+        }
+        printf("%s: %s GB/s, %s of the roofline\n", f, bandwidth.c_str(), roofline.c_str());
+    }
+
+    printf("Success!\n");
+    return 0;
+#endif
+}
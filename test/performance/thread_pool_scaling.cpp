@@ -0,0 +1,164 @@
+#include "Halide.h"
+#include <algorithm>
+#include <cstdio>
+#include <stdlib.h>
+#include <thread>
+#include <vector>
+#include "benchmark.h"
+
+using namespace Halide;
+
+// Measure how the thread pool scales from one thread to all of the
+// cores of the machine (and beyond), for a few different shapes of
+// parallel work:
+//
+// - dispatch: many tasks that do almost nothing, which measures the
+//   cost of handing out a task.
+// - large_tasks: a few rows of heavy math per thread.
+// - nested: fewer outer tasks than threads, each of which is itself a
+//   parallel loop.
+// - concurrent: several pipelines realized at once from different
+//   threads, all sharing the one thread pool.
+//
+// The work done is the same for every number of threads, so the
+// efficiency is (time with one thread) / (threads * time).
+
+namespace {
+
+Var x("x"), y("y");
+
+Expr heavy_math(int n) {
+    Expr math = cast<float>(x + y);
+    for (int i = 0; i < n; i++) {
+        math = sqrt(cos(sin(math)));
+    }
+    return math;
+}
+
+Tools::BenchmarkConfig config() {
+    Tools::BenchmarkConfig c;
+    c.min_time = 0.05;
+    c.max_time = 0.5;
+    c.min_samples = 5;
+    return c;
+}
+
+// The median time of one iteration of each scenario, with the number
+// of threads the thread pool was started with.
+double dispatch(int threads) {
+    const int tasks = 16384;
+    Func f("dispatch");
+    f(x, y) = x + y;
+    f.parallel(y);
+    Buffer<int> out(1, tasks);
+    f.realize(out);
+    Tools::BenchmarkResult r = benchmark([&]() { f.realize(out); }, config());
+    Tools::benchmark_report("thread_pool_scaling_dispatch_" + std::to_string(threads), r);
+    return r.median;
+}
+
+double large_tasks(int threads) {
+    Func f("large_tasks");
+    f(x, y) = heavy_math(20);
+    f.parallel(y);
+    Buffer<float> out(1024, 128);
+    f.realize(out);
+    Tools::BenchmarkResult r = benchmark([&]() { f.realize(out); }, config());
+    Tools::benchmark_report("thread_pool_scaling_large_tasks_" + std::to_string(threads), r);
+    return r.median;
+}
+
+double nested(int threads) {
+    Func f("nested");
+    Var xo("xo"), xi("xi");
+    f(x, y) = heavy_math(20);
+    f.split(x, xo, xi, 64).parallel(y).parallel(xo);
+    // Only two outer tasks, so this only scales if the inner loops
+    // are run in parallel too.
+    Buffer<float> out(1024 * 64, 2);
+    f.realize(out);
+    Tools::BenchmarkResult r = benchmark([&]() { f.realize(out); }, config());
+    Tools::benchmark_report("thread_pool_scaling_nested_" + std::to_string(threads), r);
+    return r.median;
+}
+
+double concurrent(int threads) {
+    const int pipelines = 4;
+    std::vector<Func> fs;
+    std::vector<Buffer<float>> outs;
+    for (int i = 0; i < pipelines; i++) {
+        Func f("concurrent_" + std::to_string(i));
+        f(x, y) = heavy_math(20) + i;
+        f.parallel(y);
+        fs.push_back(f);
+        outs.emplace_back(1024, 32);
+        f.realize(outs.back());
+    }
+    Tools::BenchmarkResult r = benchmark([&]() {
+        std::vector<std::thread> callers;
+        for (int i = 0; i < pipelines; i++) {
+            callers.emplace_back([&, i]() { fs[i].realize(outs[i]); });
+        }
+        for (std::thread &t : callers) {
+            t.join();
+        }
+    }, config());
+    Tools::benchmark_report("thread_pool_scaling_concurrent_" + std::to_string(threads), r);
+    return r.median;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+#ifdef _WIN32
+    printf("Skipping test because it uses setenv\n");
+    return 0;
+#else
+    int cores = std::max(1, (int)std::thread::hardware_concurrency());
+    std::vector<int> thread_counts;
+    for (int t = 1; t < cores; t *= 2) {
+        thread_counts.push_back(t);
+    }
+    thread_counts.push_back(cores);
+    // Also measure the cost of oversubscribing the machine.
+    thread_counts.push_back(cores * 2);
+
+    struct Scenario {
+        const char *name;
+        double (*run)(int threads);
+        // The number of tasks, summed over all levels of parallelism.
+        int tasks;
+    } scenarios[] = {
+        {"dispatch", dispatch, 16384},
+        {"large_tasks", large_tasks, 128},
+        {"nested", nested, 2 + 2 * 1024},
+        {"concurrent", concurrent, 4 * 32},
+    };
+
+    for (const Scenario &s : scenarios) {
+        printf("%s:\n", s.name);
+        double serial_time = 0;
+        for (int t : thread_counts) {
+            // The thread pool reads HL_NUM_THREADS when it starts, so
+            // start a new one. Pipelines keep the runtime they were
+            // compiled with, so each scenario defines new Funcs.
+            setenv("HL_NUM_THREADS", std::to_string(t).c_str(), 1);
+            Internal::JITSharedRuntime::release_all();
+
+            double time = s.run(t);
+            if (t == 1) {
+                serial_time = time;
+            }
+            double speedup = serial_time / time;
+            printf("    %3d threads: %10.3f ms, %10.0f ns per task, speedup %6.2f, efficiency %5.1f%%\n",
+                   t, time * 1e3, time * 1e9 / s.tasks, speedup, 100 * speedup / std::min(t, cores));
+        }
+    }
+
+    unsetenv("HL_NUM_THREADS");
+    Internal::JITSharedRuntime::release_all();
+
+    printf("Success!\n");
+    return 0;
+#endif
+}
@@ -0,0 +1,249 @@
+// A small benchmarking library, shared by test/performance and the
+// apps. The simplest use is
+//
+//   double t = benchmark(samples, iterations, [&]() { f.realize(out); });
+//
+// which returns the best time per iteration over the samples. For
+// results stable enough to compare between runs, use
+//
+//   BenchmarkResult r = benchmark([&]() { f.realize(out); });
+//   benchmark_report("my_pipeline", r);
+//
+// which warms up, picks the number of iterations per sample
+// adaptively, and reports the median and spread of the samples. If
+// the environment variable HL_BENCHMARK_JSON names a file,
+// benchmark_report appends each result to it as a line of JSON. If
+// HL_BENCHMARK_BASELINE names a file written that way by an earlier
+// run, benchmark_report also prints the change in the median relative
+// to the baseline of the same name.
+
+#ifndef HALIDE_BENCHMARK_H
+#define HALIDE_BENCHMARK_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+union _LARGE_INTEGER;
+typedef union _LARGE_INTEGER LARGE_INTEGER;
+extern "C" int __stdcall QueryPerformanceCounter(LARGE_INTEGER*);
+extern "C" int __stdcall QueryPerformanceFrequency(LARGE_INTEGER*);
+#else
+#include <chrono>
+#endif
+
+namespace Halide {
+namespace Tools {
+
+// The current time in seconds, from a monotonic clock.
+inline double benchmark_now() {
+#ifdef _WIN32
+    int64_t freq, t;
+    QueryPerformanceFrequency((LARGE_INTEGER*)&freq);
+    QueryPerformanceCounter((LARGE_INTEGER*)&t);
+    return t / static_cast<double>(freq);
+#else
+    auto t = std::chrono::steady_clock::now().time_since_epoch();
+    return std::chrono::duration<double>(t).count();
+#endif
+}
+
+// Benchmark the operation 'op'. The number of iterations refers to
+// how many times the operation is run for each time measurement, the
+// result is the minimum over a number of samples runs. The result is the
+// amount of time in seconds for one iteration.
+template <typename F>
+double benchmark(int samples, int iterations, F op) {
+    double best = std::numeric_limits<double>::infinity();
+    for (int i = 0; i < samples; i++) {
+        double t1 = benchmark_now();
+        for (int j = 0; j < iterations; j++) {
+            op();
+        }
+        double t2 = benchmark_now();
+        double dt = t2 - t1;
+        if (dt < best) best = dt;
+    }
+    return best / iterations;
+}
+
+struct BenchmarkConfig {
+    // Time to spend running the operation before taking any samples,
+    // so that caches, page tables, thread pools and clock speeds have
+    // settled, in seconds.
+    double warmup_time = 0.05;
+
+    // Each sample runs the operation enough times to take at least this
+    // long, so the resolution of the clock doesn't matter, in seconds.
+    double min_sample_time = 1e-3;
+
+    // Take samples until there are at least min_samples and min_time
+    // seconds have been spent sampling, but stop at max_samples or
+    // max_time seconds, whichever comes first.
+    int min_samples = 10;
+    int max_samples = 1000;
+    double min_time = 0.1;
+    double max_time = 2.0;
+};
+
+// The distribution of the time per iteration of the samples, in
+// seconds.
+struct BenchmarkResult {
+    double min = 0, median = 0, mean = 0, stddev = 0;
+    // The 10th and 90th percentiles.
+    double p10 = 0, p90 = 0;
+    int samples = 0;
+    int iterations_per_sample = 0;
+    // The number of samples more than 3 (scaled) median absolute
+    // deviations from the median.
+    int outliers = 0;
+};
+
+namespace Internal {
+
+// The p-th percentile of sorted, interpolating between samples.
+inline double benchmark_percentile(const std::vector<double> &sorted, double p) {
+    double pos = p / 100.0 * (sorted.size() - 1);
+    size_t i = (size_t)pos;
+    if (i + 1 >= sorted.size()) {
+        return sorted.back();
+    }
+    double f = pos - i;
+    return sorted[i] * (1 - f) + sorted[i + 1] * f;
+}
+
+}  // namespace Internal
+
+template <typename F>
+BenchmarkResult benchmark(F op, const BenchmarkConfig &config = BenchmarkConfig()) {
+    // Warm up, doubling the iterations per sample until a sample is
+    // long enough to time accurately.
+    int iterations = 1;
+    double warmup_start = benchmark_now();
+    while (true) {
+        double t1 = benchmark_now();
+        for (int j = 0; j < iterations; j++) {
+            op();
+        }
+        double t2 = benchmark_now();
+        bool long_enough = (t2 - t1) >= config.min_sample_time;
+        if (long_enough && t2 - warmup_start >= config.warmup_time) {
+            break;
+        }
+        if (!long_enough && iterations < (1 << 30)) {
+            iterations *= 2;
+        }
+    }
+
+    std::vector<double> times;
+    double start = benchmark_now();
+    while ((int)times.size() < config.max_samples) {
+        double t1 = benchmark_now();
+        for (int j = 0; j < iterations; j++) {
+            op();
+        }
+        double t2 = benchmark_now();
+        times.push_back((t2 - t1) / iterations);
+        double elapsed = t2 - start;
+        if (elapsed >= config.max_time ||
+            ((int)times.size() >= config.min_samples && elapsed >= config.min_time)) {
+            break;
+        }
+    }
+
+    BenchmarkResult r;
+    r.samples = (int)times.size();
+    r.iterations_per_sample = iterations;
+    std::sort(times.begin(), times.end());
+    r.min = times.front();
+    r.median = Internal::benchmark_percentile(times, 50);
+    r.p10 = Internal::benchmark_percentile(times, 10);
+    r.p90 = Internal::benchmark_percentile(times, 90);
+    double sum = 0, sum_sq = 0;
+    for (double t : times) {
+        sum += t;
+        sum_sq += t * t;
+    }
+    r.mean = sum / times.size();
+    r.stddev = std::sqrt(std::max(0.0, sum_sq / times.size() - r.mean * r.mean));
+
+    std::vector<double> deviations;
+    for (double t : times) {
+        deviations.push_back(std::abs(t - r.median));
+    }
+    std::sort(deviations.begin(), deviations.end());
+    // Scale the MAD to be comparable to a standard deviation.
+    double mad = 1.4826 * Internal::benchmark_percentile(deviations, 50);
+    for (double d : deviations) {
+        if (d > 3 * mad) {
+            r.outliers++;
+        }
+    }
+    return r;
+}
+
+// Find the median of the result with the given name in a file written
+// by benchmark_report. Returns 0 if there is no such result.
+inline double benchmark_baseline_median(const std::string &filename, const std::string &name) {
+    FILE *f = fopen(filename.c_str(), "r");
+    if (!f) {
+        return 0;
+    }
+    const std::string key = "{\"name\": \"" + name + "\",";
+    double median = 0;
+    char line[1024];
+    while (fgets(line, sizeof(line), f)) {
+        if (strncmp(line, key.c_str(), key.size()) != 0) {
+            continue;
+        }
+        const char *m = strstr(line, "\"median\": ");
+        if (m) {
+            // Later results of the same name replace earlier ones.
+            median = atof(m + strlen("\"median\": "));
+        }
+    }
+    fclose(f);
+    return median;
+}
+
+// Print a summary of the result, and record it as described at the
+// top of this file.
+inline void benchmark_report(const std::string &name, const BenchmarkResult &r) {
+    printf("%s: median %g ms, min %g ms, p10-p90 %g-%g ms, %d samples of %d iterations, %d outliers\n",
+           name.c_str(), r.median * 1e3, r.min * 1e3, r.p10 * 1e3, r.p90 * 1e3,
+           r.samples, r.iterations_per_sample, r.outliers);
+
+    const char *baseline = getenv("HL_BENCHMARK_BASELINE");
+    if (baseline) {
+        double base = benchmark_baseline_median(baseline, name);
+        if (base > 0) {
+            printf("%s: %+.1f%% relative to baseline median %g ms\n",
+                   name.c_str(), (r.median / base - 1) * 100, base * 1e3);
+        }
+    }
+
+    const char *json = getenv("HL_BENCHMARK_JSON");
+    if (json) {
+        FILE *f = fopen(json, "a");
+        if (f) {
+            fprintf(f, "{\"name\": \"%s\", \"median\": %.9g, \"min\": %.9g, \"mean\": %.9g, "
+                    "\"stddev\": %.9g, \"p10\": %.9g, \"p90\": %.9g, \"samples\": %d, "
+                    "\"iterations_per_sample\": %d, \"outliers\": %d}\n",
+                    name.c_str(), r.median, r.min, r.mean, r.stddev, r.p10, r.p90,
+                    r.samples, r.iterations_per_sample, r.outliers);
+            fclose(f);
+        }
+    }
+}
+
+}  // namespace Tools
+}  // namespace Halide
+
+#endif  // HALIDE_BENCHMARK_H
@@ -1,16 +1,29 @@
 // This simple PNG IO library works the Halide::Buffer<T> type or any
-// other image type with the same API.
+// other image type with the same API. On POSIX systems it can also map
+// uncompressed images into memory and wrap their pixels without
+// copying; see map_image.
 
 #ifndef HALIDE_IMAGE_IO_H
 #define HALIDE_IMAGE_IO_H
 
 #include <algorithm>
+#include <cctype>
 #include <cstdarg>
+#include <cstdint>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <string>
+#include <type_traits>
 #include <vector>
 
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 #ifndef HALIDE_NOPNG
 #include "png.h"
 #endif
@@ -137,6 +150,109 @@ struct PngRowPointers {
 };
 #endif // HALIDE_NOPNG
 
+#ifndef _WIN32
+// A file mapped into memory, shared with the file when writable, and
+// copy-on-write otherwise.
+struct MappedFile {
+    MappedFile() {}
+    ~MappedFile() {
+        unmap();
+    }
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    // Map an existing file. If new_size is non-zero, create or
+    // truncate the file to that size first.
+    bool map(const char *filename, bool writable, size_t new_size = 0) {
+        unmap();
+        int flags = writable ? O_RDWR : O_RDONLY;
+        if (new_size) {
+            flags |= O_CREAT | O_TRUNC;
+        }
+        int fd = open(filename, flags, 0644);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat st;
+        bool ok = new_size ? (ftruncate(fd, (off_t) new_size) == 0) : (fstat(fd, &st) == 0);
+        size_t length = new_size ? new_size : (ok ? (size_t) st.st_size : 0);
+        if (ok && length > 0) {
+            void *ptr = mmap(nullptr, length, PROT_READ | PROT_WRITE,
+                             writable ? MAP_SHARED : MAP_PRIVATE, fd, 0);
+            if (ptr != MAP_FAILED) {
+                data = (uint8_t *) ptr;
+                size = length;
+            }
+        }
+        close(fd);
+        return data != nullptr;
+    }
+
+    void unmap() {
+        if (data) {
+            munmap(data, size);
+            data = nullptr;
+            size = 0;
+        }
+    }
+
+    uint8_t *data = nullptr;
+    size_t size = 0;
+};
+
+// Parse the header of a binary PGM or PPM in memory. Returns the
+// offset of the pixels, or zero if the header is malformed.
+inline size_t parse_pnm_header(const uint8_t *p, size_t size, char *magic,
+                               int *width, int *height, int *maxval) {
+    size_t i = 0;
+    auto skip_space = [&]() {
+        while (i < size && (isspace(p[i]) || p[i] == '#')) {
+            if (p[i] == '#') {
+                while (i < size && p[i] != '\n') i++;
+            } else {
+                i++;
+            }
+        }
+    };
+    auto read_int = [&](int *result) {
+        skip_space();
+        if (i >= size || !isdigit(p[i])) return false;
+        *result = 0;
+        while (i < size && isdigit(p[i])) {
+            *result = *result * 10 + (p[i++] - '0');
+        }
+        return true;
+    };
+    if (size < 2) return 0;
+    magic[0] = p[0];
+    magic[1] = p[1];
+    magic[2] = 0;
+    i = 2;
+    if (!read_int(width) || !read_int(height) || !read_int(maxval)) return 0;
+    // Exactly one whitespace character separates the header from the
+    // pixels.
+    if (i >= size || !isspace(p[i])) return 0;
+    return i + 1;
+}
+
+// The header of the raw format that map_image and map_new_image
+// understand: 64 bytes, followed by the pixels densely packed with
+// the first dimension innermost, in the host's byte order.
+struct RawHeader {
+    char magic[4];        // "HRAW"
+    uint32_t type_code;   // 0 for signed ints, 1 for unsigned ints, 2 for floats
+    uint32_t bits;
+    uint32_t dimensions;  // 1 to 4
+    uint32_t extents[4];
+    uint8_t padding[32];
+};
+
+template<typename T>
+uint32_t raw_type_code() {
+    return std::is_floating_point<T>::value ? 2 : (std::is_signed<T>::value ? 0 : 1);
+}
+#endif // _WIN32
+
 }  // namespace Internal
 
 
@@ -607,6 +723,138 @@ bool save(ImageType &im, const std::string &filename) {
     }
 }
 
+#ifndef _WIN32
+// An image file mapped into memory. The image wraps the mapped pixels
+// directly, so it must not be used once the MappedImage is destroyed.
+template<typename ImageType>
+struct MappedImage {
+    ImageType image;
+    Internal::MappedFile file;
+};
+
+// Map a binary PGM or PPM with 8-bit samples, or a raw file (.raw, see
+// Internal::RawHeader), into memory, and wrap its pixels as an image
+// without copying or converting them. The element type must match the
+// file's samples. PPM pixels stay interleaved, so the image's channel
+// dimension has stride 1. If writable, writes to the image go to the
+// file; otherwise they're private to the mapping. Returns false upon
+// failure.
+template<typename ImageType, Internal::CheckFunc check = Internal::CheckReturn>
+bool map_image(const std::string &filename, MappedImage<ImageType> *im, bool writable = false) {
+    typedef typename ImageType::ElemType ElemType;
+    Internal::MappedFile &f = im->file;
+    if (!check(f.map(filename.c_str(), writable), "File %s could not be mapped\n", filename.c_str())) return false;
+
+    ElemType *data = nullptr;
+    size_t bytes = 0;
+    if (Internal::ends_with_ignore_case(filename, ".raw")) {
+        Internal::RawHeader h;
+        if (!check(f.size >= sizeof(h), "File %s is too small for a raw header\n", filename.c_str())) return false;
+        memcpy(&h, f.data, sizeof(h));
+        if (!check(memcmp(h.magic, "HRAW", 4) == 0 && h.dimensions >= 1 && h.dimensions <= 4,
+                   "File %s does not have a raw header\n", filename.c_str())) return false;
+        if (!check(h.type_code == Internal::raw_type_code<ElemType>() && h.bits == sizeof(ElemType) * 8,
+                   "The samples in %s don't match the image's element type\n", filename.c_str())) return false;
+        std::vector<int> extents(h.extents, h.extents + h.dimensions);
+        bytes = sizeof(ElemType);
+        for (int e : extents) {
+            bytes *= e;
+        }
+        data = (ElemType *) (f.data + sizeof(h));
+        im->image = ImageType(data, extents);
+    } else {
+        char magic[3];
+        int width, height, maxval;
+        size_t offset = Internal::parse_pnm_header(f.data, f.size, magic, &width, &height, &maxval);
+        if (!check(offset != 0, "Could not read the header of %s\n", filename.c_str())) return false;
+        int channels = 0;
+        if (magic == std::string("P5") || magic == std::string("p5")) {
+            channels = 1;
+        } else if (magic == std::string("P6") || magic == std::string("p6")) {
+            channels = 3;
+        }
+        if (!check(channels != 0, "%s is not a binary PGM or PPM\n", filename.c_str())) return false;
+        // Wider samples are big-endian, so they need converting; use
+        // load_pgm or load_ppm for those.
+        if (!check(maxval == 255 && sizeof(ElemType) == 1 && !std::is_signed<ElemType>::value,
+                   "Only 8-bit PGM and PPM files can be mapped into 8-bit unsigned images\n")) return false;
+        bytes = (size_t) width * height * channels;
+        data = (ElemType *) (f.data + offset);
+        if (!check(offset + bytes <= f.size, "File %s is truncated\n", filename.c_str())) return false;
+        if (channels == 1) {
+            im->image = ImageType(data, std::vector<int>{width, height});
+        } else {
+            // The channels are innermost in memory.
+            im->image = ImageType(data, std::vector<int>{channels, width, height});
+            im->image.transpose(0, 1);
+            im->image.transpose(1, 2);
+        }
+        return true;
+    }
+    return check((size_t) ((uint8_t *) data - f.data) + bytes <= f.size, "File %s is truncated\n", filename.c_str());
+}
+
+// Create a PGM, PPM or raw file (by extension) of the given size, and
+// map it into memory, so that a pipeline can write its output
+// straight to the file by realizing into im->image. PGM files have
+// one channel and PPM files three, of 8-bit samples; raw files have
+// the element type of the image, and are two-dimensional when they
+// have one channel. The file is complete once the MappedImage is
+// destroyed. Returns false upon failure.
+template<typename ImageType, Internal::CheckFunc check = Internal::CheckReturn>
+bool map_new_image(const std::string &filename, MappedImage<ImageType> *im,
+                   int width, int height, int channels = 1) {
+    typedef typename ImageType::ElemType ElemType;
+    bool raw = Internal::ends_with_ignore_case(filename, ".raw");
+    bool pgm = Internal::ends_with_ignore_case(filename, ".pgm");
+    bool ppm = Internal::ends_with_ignore_case(filename, ".ppm");
+    if (!check(raw || pgm || ppm, "[map_new_image] unsupported file extension (pgm|ppm|raw supported)\n")) return false;
+    if (!raw) {
+        if (!check(channels == (ppm ? 3 : 1), "PGM files have one channel, and PPM files three\n")) return false;
+        if (!check(sizeof(ElemType) == 1 && !std::is_signed<ElemType>::value,
+                   "Only 8-bit unsigned images can be mapped to PGM and PPM files\n")) return false;
+    }
+
+    char header[64];
+    size_t header_size;
+    std::vector<int> extents = {width, height};
+    if (channels > 1) {
+        extents.push_back(channels);
+    }
+    if (raw) {
+        Internal::RawHeader h;
+        memset(&h, 0, sizeof(h));
+        memcpy(h.magic, "HRAW", 4);
+        h.type_code = Internal::raw_type_code<ElemType>();
+        h.bits = sizeof(ElemType) * 8;
+        h.dimensions = extents.size();
+        for (size_t i = 0; i < extents.size(); i++) {
+            h.extents[i] = extents[i];
+        }
+        memcpy(header, &h, sizeof(h));
+        header_size = sizeof(h);
+    } else {
+        header_size = snprintf(header, sizeof(header), "%s\n%d %d\n255\n", ppm ? "P6" : "P5", width, height);
+    }
+
+    size_t bytes = (size_t) width * height * channels * sizeof(ElemType);
+    Internal::MappedFile &f = im->file;
+    if (!check(f.map(filename.c_str(), true, header_size + bytes),
+               "File %s could not be created and mapped\n", filename.c_str())) return false;
+    memcpy(f.data, header, header_size);
+    ElemType *data = (ElemType *) (f.data + header_size);
+    if (ppm) {
+        // The channels are innermost in memory.
+        im->image = ImageType(data, std::vector<int>{channels, width, height});
+        im->image.transpose(0, 1);
+        im->image.transpose(1, 2);
+    } else {
+        im->image = ImageType(data, extents);
+    }
+    return true;
+}
+#endif // _WIN32
+
 // Fancy wrapper to call load() with CheckFail, inferring the return type;
 // this allows you to simply use
 //
@@ -0,0 +1,148 @@
+// This header runs an ahead-of-time compiled pipeline over an image
+// too large to hold in memory, one tile of the output at a time. The
+// region of the input each tile needs is found with a bounds query
+// of the pipeline, read by a callback, and the finished tile is passed
+// to another callback to be written out. The input of the next tile
+// is read on a separate thread while the current tile is computed, so
+// at most two tiles of the input and one tile of the output are ever
+// resident.
+
+#ifndef HALIDE_STREAMING_H
+#define HALIDE_STREAMING_H
+
+#include <algorithm>
+#include <future>
+#include <utility>
+#include <vector>
+
+#include "HalideBuffer.h"
+
+namespace Halide {
+namespace Tools {
+
+namespace Internal {
+
+// The buffers for one tile of a streaming pipeline, and the error
+// code of finding and reading its input.
+template<typename InT, typename OutT>
+struct StreamingTile {
+    Halide::Runtime::Buffer<InT> input;
+    Halide::Runtime::Buffer<OutT> output;
+    int result = 0;
+};
+
+template<typename InT, typename OutT, typename Pipeline, typename Reader>
+StreamingTile<InT, OutT> prepare_streaming_tile(Pipeline &pipeline, Reader &read,
+                                                const std::vector<int> &input_sizes,
+                                                const std::vector<int> &min,
+                                                const std::vector<int> &extent) {
+    StreamingTile<InT, OutT> tile;
+
+    // Buffers with no host pointer make the pipeline do a bounds query,
+    // which replaces the shape of the input with the region this tile
+    // needs. The input starts out with the shape of the whole image, so
+    // that boundary conditions such as repeat_edge clamp to the image.
+    Halide::Runtime::Buffer<InT> input_query((InT *)nullptr, input_sizes);
+    Halide::Runtime::Buffer<OutT> output_query((OutT *)nullptr, extent);
+    output_query.translate(min);
+    tile.result = pipeline(input_query, output_query);
+    if (tile.result != 0) {
+        return tile;
+    }
+
+    std::vector<int> input_min, input_extent;
+    for (int i = 0; i < input_query.dimensions(); i++) {
+        input_min.push_back(input_query.dim(i).min());
+        input_extent.push_back(input_query.dim(i).extent());
+    }
+    tile.input = Halide::Runtime::Buffer<InT>(input_extent);
+    tile.input.translate(input_min);
+    if (!read(tile.input)) {
+        tile.result = -1;
+        return tile;
+    }
+
+    tile.output = Halide::Runtime::Buffer<OutT>(extent);
+    tile.output.translate(min);
+    return tile;
+}
+
+}  // namespace Internal
+
+// Compute the output of a pipeline with one input and one output,
+// which have the shapes input_sizes and output_sizes, in tiles of
+// tile_width x tile_height of the first two dimensions of the output.
+//
+// pipeline is called as pipeline(Buffer<InT> &in, Buffer<OutT> &out)
+// and should return the result of the AOT compiled function, e.g.
+//
+//   [&](Buffer<uint16_t> &in, Buffer<uint16_t> &out) {
+//       return local_laplacian(in, levels, alpha, beta, out);
+//   }
+//
+// read(Buffer<InT> &in) should fill in the region of the image that in
+// covers, and return false on failure. For pipelines that apply
+// boundary conditions relative to the bounds of their input, the
+// region is always within the image; otherwise the reader must handle
+// the edges itself. write(const Buffer<OutT> &out) is called with each
+// finished tile, in raster order, and should return false on failure.
+// read is called on a separate thread, and may run at the same time as
+// write and pipeline, but calls to read do not overlap each other.
+//
+// Returns 0 on success, the error code of the pipeline if it fails, or
+// -1 if read or write fails.
+template<typename InT, typename OutT, typename Pipeline, typename Reader, typename Writer>
+int stream_tiles(Pipeline pipeline,
+                 const std::vector<int> &input_sizes,
+                 const std::vector<int> &output_sizes,
+                 int tile_width, int tile_height,
+                 Reader read, Writer write) {
+    std::vector<std::pair<std::vector<int>, std::vector<int>>> tiles;
+    for (int y = 0; y < output_sizes[1]; y += tile_height) {
+        for (int x = 0; x < output_sizes[0]; x += tile_width) {
+            std::vector<int> min(output_sizes.size(), 0), extent(output_sizes);
+            min[0] = x;
+            min[1] = y;
+            extent[0] = std::min(tile_width, output_sizes[0] - x);
+            extent[1] = std::min(tile_height, output_sizes[1] - y);
+            tiles.emplace_back(min, extent);
+        }
+    }
+    if (tiles.empty()) {
+        return 0;
+    }
+
+    auto prepare = [&](size_t i) {
+        return Internal::prepare_streaming_tile<InT, OutT>(pipeline, read, input_sizes,
+                                                           tiles[i].first, tiles[i].second);
+    };
+
+    std::future<Internal::StreamingTile<InT, OutT>> next =
+        std::async(std::launch::async, prepare, (size_t)0);
+    for (size_t i = 0; i < tiles.size(); i++) {
+        Internal::StreamingTile<InT, OutT> tile = next.get();
+        if (tile.result != 0) {
+            return tile.result;
+        }
+
+        // Read the input of the next tile while computing this one.
+        if (i + 1 < tiles.size()) {
+            next = std::async(std::launch::async, prepare, i + 1);
+        }
+
+        int result = pipeline(tile.input, tile.output);
+        if (result != 0) {
+            return result;
+        }
+        if (!write(tile.output)) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+}  // namespace Tools
+}  // namespace Halide
+
+#endif  // HALIDE_STREAMING_H
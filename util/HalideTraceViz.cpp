@@ -11,6 +11,7 @@
 #include <queue>
 #include <iostream>
 #include <algorithm>
+#include <thread>
 #ifdef _MSC_VER
 #include <io.h>
 typedef int64_t ssize_t;
@@ -91,6 +92,22 @@ struct Packet : public halide_trace_packet_t {
         return (T)0;
     }
 
+    // Skip some number of bytes of stdin, seeking if it's a file.
+    static bool skip_stdin(uint64_t size) {
+        if (lseek(0, (off_t)size, SEEK_CUR) >= 0) {
+            return true;
+        }
+        uint8_t buf[4096];
+        while (size > 0) {
+            ssize_t s = read(0, buf, (size_t)std::min<uint64_t>(size, sizeof(buf)));
+            if (s <= 0) {
+                return false;
+            }
+            size -= s;
+        }
+        return true;
+    }
+
     // Grab a packet from stdin. Returns false when stdin closes.
     bool read_from_stdin() {
         uint32_t header_size = (uint32_t)sizeof(halide_trace_packet_t);
@@ -137,6 +154,80 @@ private:
     }
 };
 
+// The index of a trace file, written by the tracing runtime to
+// HL_TRACE_INDEX_FILE. It describes the trace in chunks, so the chunks
+// that don't draw anything can be skipped without parsing them.
+struct TraceIndex {
+    struct Chunk {
+        uint64_t size;
+        uint32_t packets;
+        int32_t flags;
+        vector<string> names;
+    };
+    vector<Chunk> chunks;
+
+    bool load(const char *filename) {
+        FILE *f = fopen(filename, "rb");
+        if (!f) {
+            fprintf(stderr, "Can't open trace index %s\n", filename);
+            return false;
+        }
+        halide_trace_index_entry_t entry;
+        while (fread(&entry, sizeof(entry), 1, f) == 1) {
+            vector<char> names(entry.names_size + 1, 0);
+            if (entry.names_size > 0 &&
+                fread(&names[0], entry.names_size, 1, f) != 1) {
+                fprintf(stderr, "Unexpected EOF in trace index\n");
+                fclose(f);
+                return false;
+            }
+            Chunk c = {entry.size, entry.packets, entry.flags, {}};
+            for (size_t i = 0; i < entry.names_size && names[i]; i += strlen(&names[i]) + 1) {
+                c.names.push_back(&names[i]);
+            }
+            chunks.push_back(c);
+        }
+        fclose(f);
+        return true;
+    }
+
+    // Whether a chunk only loads and stores Funcs that aren't drawn,
+    // given the names of the ones that are, optionally prefixed with
+    // their pipeline's name. Funcs that aren't drawn have no cost, so
+    // skipping the chunk doesn't change the frames.
+    static bool can_skip(const Chunk &c, const vector<string> &drawn) {
+        if (c.flags & (halide_trace_index_other_events | halide_trace_index_names_incomplete)) {
+            return false;
+        }
+        for (const string &name : c.names) {
+            for (const string &d : drawn) {
+                if (d == name ||
+                    (d.size() > name.size() &&
+                     d.compare(d.size() - name.size(), name.size(), name) == 0 &&
+                     d[d.size() - name.size() - 1] == ':')) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+};
+
+// Run f(y_min, y_max) over bands of the rows of a frame, one band per
+// thread.
+template<typename F>
+void for_each_row_band(int threads, int height, F f) {
+    int band = (height + threads - 1) / threads;
+    vector<std::thread> workers;
+    for (int y = band; y < height; y += band) {
+        workers.emplace_back(f, y, std::min(height, y + band));
+    }
+    f(0, std::min(height, band));
+    for (std::thread &w : workers) {
+        w.join();
+    }
+}
+
 // A struct specifying a text label that will appear on the screen at some point.
 struct Label {
     const char *text;
@@ -335,6 +426,16 @@ void usage() {
             "    Defaults to 250.\n"
             " -l func label x y n: When func is first touched, the label appears at\n"
             "    the given coordinates and fades in over n frames.\n"
+            " -w first last: Only output frames first to last (counting from zero).\n"
+            "    The frames before are still computed, but not written out, and\n"
+            "    the trace after is not read. A last of -1 means the end.\n"
+            " -i index_file: The index of the trace, written by the run to\n"
+            "    HL_TRACE_INDEX_FILE. Chunks of the trace that only touch Funcs\n"
+            "    that aren't drawn are skipped without parsing them; when the\n"
+            "    trace on stdin is a file rather than a pipe, without reading\n"
+            "    them either. The Func statistics then only cover what was read.\n"
+            " -j threads: How many threads to composite frames with. Defaults to\n"
+            "    the number of cores.\n"
             "\n"
             " For each Func you want to visualize, also specify:\n"
             " -f func_name min_value max_value color_dim blank zoom cost x y strides\n"
@@ -383,6 +484,12 @@ int run(int argc, char **argv) {
 
     int timestep = 10000;
     int hold_frames = 250;
+    int first_frame = 0, last_frame = -1;
+    int threads = std::max(1, (int)std::thread::hardware_concurrency());
+    TraceIndex index;
+    bool use_index = false;
+    // The names given to -f.
+    vector<string> drawn_funcs;
 
     // Parse command line args
     int i = 1;
@@ -417,6 +524,7 @@ int run(int argc, char **argv) {
             }
             fi.config.dims = d;
             fi.config.dump(func);
+            drawn_funcs.push_back(func);
 
         } else if (next == "-l") {
             if (i + 5 >= argc) {
@@ -453,6 +561,28 @@ int run(int argc, char **argv) {
             }
             assert(i + 1 < argc);
             hold_frames = atoi(argv[++i]);
+        } else if (next == "-w") {
+            if (i + 2 >= argc) {
+                usage();
+                return -1;
+            }
+            first_frame = atoi(argv[++i]);
+            last_frame = atoi(argv[++i]);
+        } else if (next == "-i") {
+            if (i + 1 >= argc) {
+                usage();
+                return -1;
+            }
+            if (!index.load(argv[++i])) {
+                return -1;
+            }
+            use_index = true;
+        } else if (next == "-j") {
+            if (i + 1 >= argc) {
+                usage();
+                return -1;
+            }
+            threads = std::max(1, atoi(argv[++i]));
         } else {
             usage();
             return -1;
@@ -488,7 +618,14 @@ int run(int argc, char **argv) {
 
     size_t end_counter = 0;
     size_t packet_clock = 0;
-    for (;;) {
+
+    // Where we are in the trace and in its index.
+    uint64_t trace_pos = 0, chunk_end = 0;
+    size_t next_chunk = 0;
+    uint64_t skipped_chunks = 0, skipped_packets = 0;
+
+    bool done = false;
+    while (!done) {
         // Hold for some number of frames once the trace has finished.
         if (end_counter) {
             halide_clock += timestep;
@@ -498,33 +635,68 @@ int run(int argc, char **argv) {
         }
 
         while (halide_clock >= video_clock) {
-            // Composite text over anim over image
-            for (int i = 0; i < frame_width * frame_height; i++) {
-                uint8_t *anim_px  = (uint8_t *)(anim + i);
-                uint8_t *image_px = (uint8_t *)(image + i);
-                uint8_t *text_px  = (uint8_t *)(text + i);
-                uint8_t *blend_px = (uint8_t *)(blend + i);
-                composite(image_px, anim_px, blend_px);
-                composite(blend_px, text_px, blend_px);
-            }
-
-            // Dump the frame
-            ssize_t bytes = 4 * frame_width * frame_height;
-            ssize_t bytes_written = write(1, blend, bytes);
-            if (bytes_written < bytes) {
-                fprintf(stderr, "Could not write frame to stdout.\n");
-                return -1;
+            int frame = (int)(video_clock / timestep);
+            if (frame >= first_frame) {
+                // Composite text over anim over image
+                for_each_row_band(threads, frame_height, [&](int y_min, int y_max) {
+                    for (int i = y_min * frame_width; i < y_max * frame_width; i++) {
+                        uint8_t *anim_px  = (uint8_t *)(anim + i);
+                        uint8_t *image_px = (uint8_t *)(image + i);
+                        uint8_t *text_px  = (uint8_t *)(text + i);
+                        uint8_t *blend_px = (uint8_t *)(blend + i);
+                        composite(image_px, anim_px, blend_px);
+                        composite(blend_px, text_px, blend_px);
+                    }
+                });
+
+                // Dump the frame
+                ssize_t bytes = 4 * frame_width * frame_height;
+                ssize_t bytes_written = write(1, blend, bytes);
+                if (bytes_written < bytes) {
+                    fprintf(stderr, "Could not write frame to stdout.\n");
+                    return -1;
+                }
             }
 
             video_clock += timestep;
 
+            if (last_frame >= 0 && frame >= last_frame) {
+                done = true;
+                break;
+            }
+
             // Decay the alpha channel on the anim
-            for (int i = 0; i < frame_width * frame_height; i++) {
-                uint32_t color = anim[i];
-                uint32_t rgb = color & 0x00ffffff;
-                uint8_t alpha = (color >> 24);
-                alpha /= decay_factor;
-                anim[i] = (alpha << 24) | rgb;
+            for_each_row_band(threads, frame_height, [&](int y_min, int y_max) {
+                for (int i = y_min * frame_width; i < y_max * frame_width; i++) {
+                    uint32_t color = anim[i];
+                    uint32_t rgb = color & 0x00ffffff;
+                    uint8_t alpha = (color >> 24);
+                    alpha /= decay_factor;
+                    anim[i] = (alpha << 24) | rgb;
+                }
+            });
+        }
+        if (done) {
+            break;
+        }
+
+        // Skip the chunks of the trace that don't draw anything.
+        if (use_index && trace_pos == chunk_end) {
+            while (next_chunk < index.chunks.size() &&
+                   TraceIndex::can_skip(index.chunks[next_chunk], drawn_funcs)) {
+                const TraceIndex::Chunk &c = index.chunks[next_chunk++];
+                if (!Packet::skip_stdin(c.size)) {
+                    break;
+                }
+                trace_pos += c.size;
+                skipped_chunks++;
+                skipped_packets += c.packets;
+            }
+            if (next_chunk < index.chunks.size()) {
+                chunk_end = trace_pos + index.chunks[next_chunk++].size;
+            } else {
+                // The trace goes on past the end of the index.
+                use_index = false;
             }
         }
 
@@ -535,6 +707,7 @@ int run(int argc, char **argv) {
             continue;
         }
         packet_clock++;
+        trace_pos += p.size;
 
         // It's a pipeline begin/end event
         if (p.event == halide_trace_begin_pipeline) {
@@ -708,6 +881,8 @@ int run(int argc, char **argv) {
             break;
         case halide_trace_begin_pipeline:
         case halide_trace_end_pipeline:
+        case halide_trace_begin_task:
+        case halide_trace_end_task:
             break;
         default:
             fprintf(stderr, "Unknown tracing event code: %d\n", p.event);
@@ -716,6 +891,10 @@ int run(int argc, char **argv) {
 
     }
 
+    if (skipped_chunks) {
+        fprintf(stderr, "Skipped %g packets in %g chunks of the trace\n",
+                (double)skipped_packets, (double)skipped_chunks);
+    }
     fprintf(stderr, "Total number of Funcs: %d\n", (int)func_info.size());
 
     // Print stats about the Func gleaned from the trace.